@@ -217,7 +217,8 @@ struct cfdisk_extra {
 /* line and extra partinfo list_head */
 struct cfdisk_line {
 	char			*data;		/* line data */
-	struct libscols_table	*extra;		/* extra info ('X') */
+	struct fdisk_partition	*pa;		/* partition (from cf->table) or NULL */
+	struct libscols_table	*extra;		/* extra info ('X'), on demand */
 	WINDOW			*w;		/* window with extra info */
 };
 
@@ -483,9 +484,16 @@ static void cfdisk_free_lines(struct cfdisk *cf)
 }
 /*
  * Read data about partitions from libfdisk and prepare output lines.
+ *
+ * The lines are kept until the next change of the partition table; the
+ * column widths depend on all the partitions, so the lines are always
+ * regenerated together. The partitions are cached in the lines, walking the
+ * table for every redrawn line is too expensive for large tables.
  */
 static int lines_refresh(struct cfdisk *cf)
 {
+	struct fdisk_partition *pa;
+	struct fdisk_iter *itr;
 	int rc;
 	char *p;
 	size_t i;
@@ -532,32 +540,39 @@ static int lines_refresh(struct cfdisk *cf)
 			*p = '\0';
 			p++;
 		}
-		cf->lines[i].extra = scols_new_table();
-		scols_table_enable_noheadings(cf->lines[i].extra, 1);
-		scols_table_new_column(cf->lines[i].extra, NULL, 0, SCOLS_FL_RIGHT);
-		scols_table_new_column(cf->lines[i].extra, NULL, 0, SCOLS_FL_TRUNC);
 	}
 
+	/* the first line is header */
+	itr = fdisk_new_iter(FDISK_ITER_FORWARD);
+	if (!itr)
+		return -ENOMEM;
+	for (i = 1; i < cf->nlines &&
+		    fdisk_table_next_partition(cf->table, itr, &pa) == 0; i++)
+		cf->lines[i].pa = pa;
+	fdisk_free_iter(itr);
+
 	return 0;
 }
 
-static struct fdisk_partition *get_current_partition(struct cfdisk *cf)
+/* returns partition for the table index @i (exclude header) */
+static struct fdisk_partition *get_partition(struct cfdisk *cf, size_t i)
 {
 	assert(cf);
 	assert(cf->table);
 
-	return fdisk_table_get_partition(cf->table, cf->lines_idx);
+	if (!cf->lines || i + 1 >= cf->nlines)
+		return NULL;
+	return cf->lines[i + 1].pa;
 }
 
-static int is_freespace(struct cfdisk *cf, size_t i)
+static struct fdisk_partition *get_current_partition(struct cfdisk *cf)
 {
-	struct fdisk_partition *pa;
-
-	assert(cf);
-	assert(cf->table);
+	return get_partition(cf, cf->lines_idx);
+}
 
-	pa = fdisk_table_get_partition(cf->table, i);
-	return fdisk_partition_is_freespace(pa);
+static int is_freespace(struct cfdisk *cf, size_t i)
+{
+	return fdisk_partition_is_freespace(get_partition(cf, i));
 }
 
 /* converts libfdisk FDISK_ASKTYPE_MENU to cfdisk menu and returns user's
@@ -1455,13 +1470,20 @@ static int ui_draw_extra(struct cfdisk *cf)
 
 	DBG(UI, ul_debug("draw extra"));
 
-	assert(ln->extra);
-
 	if (cf->act_win) {
 		wclear(cf->act_win);
 		touchwin(stdscr);
 	}
 
+	if (!ln->extra) {
+		ln->extra = scols_new_table();
+		if (!ln->extra)
+			return -ENOMEM;
+		scols_table_enable_noheadings(ln->extra, 1);
+		scols_table_new_column(ln->extra, NULL, 0, SCOLS_FL_RIGHT);
+		scols_table_new_column(ln->extra, NULL, 0, SCOLS_FL_TRUNC);
+	}
+
 	if (scols_table_is_empty(ln->extra)) {
 		extra_prepare_data(cf);
 		if (scols_table_is_empty(ln->extra))
@@ -1694,8 +1716,8 @@ static void ui_draw_partition(struct cfdisk *cf, size_t i)
 static int ui_draw_table(struct cfdisk *cf)
 {
 	int cl = ARROW_CURSOR_WIDTH;
-	size_t i, nparts = fdisk_table_get_nents(cf->table);
-	size_t curpg = cf->page_sz ? cf->lines_idx / cf->page_sz : 0;
+	size_t i, first, last, nparts = fdisk_table_get_nents(cf->table);
+	size_t curpg;
 
 	DBG(UI, ul_debug("draw table"));
 
@@ -1707,13 +1729,17 @@ static int ui_draw_table(struct cfdisk *cf)
 	if (nparts == 0 || (size_t) cf->lines_idx > nparts - 1)
 		cf->lines_idx = nparts ? nparts - 1 : 0;
 
+	curpg = cf->page_sz ? cf->lines_idx / cf->page_sz : 0;
+
 	/* print header */
 	attron(A_BOLD);
 	mvaddstr(TABLE_START_LINE, cl, cf->lines[0].data);
 	attroff(A_BOLD);
 
-	/* print partitions */
-	for (i = 0; i < nparts; i++)
+	/* print partitions on the current page only */
+	first = cf->page_sz ? curpg * cf->page_sz : 0;
+	last = cf->page_sz ? min(first + cf->page_sz, nparts) : nparts;
+	for (i = first; i < last; i++)
 		ui_draw_partition(cf, i);
 
 	if (curpg != 0) {
@@ -2461,7 +2487,7 @@ static int main_menu_action(struct cfdisk *cf, int key)
 		size = fdisk_partition_get_size(pa);
 
 		/* is the next freespace? */
-		next = fdisk_table_get_partition(cf->table, cf->lines_idx + 1);
+		next = get_partition(cf, cf->lines_idx + 1);
 		if (next && fdisk_partition_is_freespace(next))
 			size += fdisk_partition_get_size(next);
 
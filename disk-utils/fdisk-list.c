@@ -13,6 +13,12 @@
 #include "sysfs.h"
 #include "colors.h"
 #include "ttyutils.h"
+#include "jsonwrt.h"
+#include "strv.h"
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "fdisk-list.h"
 
@@ -426,6 +432,295 @@ void print_all_devices_freespace(struct fdisk_context *cxt)
 	}
 }
 
+/*
+ * JSON output for more devices, every device is probed by its own context
+ * (in a worker thread) and the per-device output is written to memory; the
+ * result is printed in the order of the devices.
+ */
+struct list_device {
+	char		*devname;
+	char		*data;		/* JSON object in memory */
+	size_t		datasz;
+	char		**warnings;	/* messages from libfdisk */
+	int		rc;
+};
+
+struct list_queue {
+	struct list_device	*devs;
+	size_t			ndevs;
+	size_t			next;		/* the next not probed device */
+	int			verify;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t		lock;		/* protects @next */
+#endif
+};
+
+static int json_ask_callback(struct fdisk_context *cxt __attribute__((__unused__)),
+			     struct fdisk_ask *ask,
+			     void *data)
+{
+	struct list_device *ld = (struct list_device *) data;
+	int rc = 0;
+
+	assert(ask);
+	assert(ld);
+
+	switch (fdisk_ask_get_type(ask)) {
+	case FDISK_ASKTYPE_INFO:
+		break;
+	case FDISK_ASKTYPE_WARNX:
+		rc = strv_extend(&ld->warnings, fdisk_ask_print_get_mesg(ask));
+		break;
+	case FDISK_ASKTYPE_WARN:
+		rc = strv_extendf(&ld->warnings, "%s: %s",
+				fdisk_ask_print_get_mesg(ask),
+				strerror(fdisk_ask_print_get_errno(ask)));
+		break;
+	case FDISK_ASKTYPE_YESNO:
+		fdisk_ask_yesno_set_result(ask, 0);
+		break;
+	default:
+		rc = -EINVAL;
+		break;
+	}
+	return rc;
+}
+
+static void json_partitions(struct fdisk_context *cxt, struct ul_jsonwrt *json)
+{
+	struct fdisk_table *tb = NULL;
+	struct fdisk_partition *pa = NULL;
+	struct fdisk_iter *itr = NULL;
+	struct fdisk_label *lb = fdisk_get_label(cxt, NULL);
+	int *ids = NULL;
+	size_t nids = 0, i;
+
+	if (fdisk_get_partitions(cxt, &tb) || fdisk_table_get_nents(tb) <= 0)
+		goto done;
+	if (fdisk_label_get_fields_ids(NULL, cxt, &ids, &nids))
+		goto done;
+	itr = fdisk_new_iter(FDISK_ITER_FORWARD);
+	if (!itr)
+		goto done;
+
+	ul_jsonwrt_array_open(json, "partitions");
+	while (fdisk_table_next_partition(tb, itr, &pa) == 0) {
+		ul_jsonwrt_object_open(json, NULL);
+		for (i = 0; i < nids; i++) {
+			const struct fdisk_field *field =
+					fdisk_label_get_field(lb, ids[i]);
+			char *data = NULL;
+
+			if (!field || fdisk_partition_to_string(pa, cxt, ids[i], &data))
+				continue;
+
+			switch (ids[i]) {
+			case FDISK_FIELD_START:
+			case FDISK_FIELD_END:
+			case FDISK_FIELD_SECTORS:
+			case FDISK_FIELD_CYLINDERS:
+				ul_jsonwrt_value_raw(json, fdisk_field_get_name(field), data);
+				break;
+			default:
+				ul_jsonwrt_value_s(json, fdisk_field_get_name(field), data);
+				break;
+			}
+			free(data);
+		}
+		ul_jsonwrt_object_close(json);
+	}
+	ul_jsonwrt_array_close(json);
+done:
+	free(ids);
+	fdisk_free_iter(itr);
+	fdisk_unref_table(tb);
+}
+
+static void json_device_pt(struct list_device *ld, int verify)
+{
+	struct fdisk_context *cxt;
+	struct ul_jsonwrt json;
+	FILE *out = NULL;
+	char *id = NULL;
+
+	cxt = fdisk_new_context();
+	if (!cxt) {
+		ld->rc = -ENOMEM;
+		return;
+	}
+	fdisk_set_ask(cxt, json_ask_callback, (void *) ld);
+	fdisk_enable_listonly(cxt, 1);
+	fdisk_enable_details(cxt, 1);
+
+	ld->rc = fdisk_assign_device(cxt, ld->devname, 1);	/* read-only */
+	if (ld->rc)
+		goto done;
+
+	if (verify && fdisk_has_label(cxt))
+		fdisk_verify_disklabel(cxt);
+
+	out = open_memstream(&ld->data, &ld->datasz);
+	if (!out) {
+		ld->rc = -errno;
+		goto done;
+	}
+
+	/* the leading comma is removed for the first device */
+	ul_jsonwrt_init(&json, out, 2);
+	json.after_close = 1;
+
+	ul_jsonwrt_object_open(&json, NULL);
+	ul_jsonwrt_value_s(&json, "device", fdisk_get_devname(cxt));
+	ul_jsonwrt_value_s(&json, "model", fdisk_get_devmodel(cxt));
+	ul_jsonwrt_value_u64(&json, "size",
+			fdisk_get_nsectors(cxt) * fdisk_get_sector_size(cxt));
+	ul_jsonwrt_value_u64(&json, "sectors", fdisk_get_nsectors(cxt));
+	ul_jsonwrt_value_u64(&json, "sector-size", fdisk_get_sector_size(cxt));
+	ul_jsonwrt_value_u64(&json, "physical-sector-size", fdisk_get_physector_size(cxt));
+	ul_jsonwrt_value_u64(&json, "minimum-io-size", fdisk_get_minimal_iosize(cxt));
+	ul_jsonwrt_value_u64(&json, "optimal-io-size", fdisk_get_optimal_iosize(cxt));
+	ul_jsonwrt_value_u64(&json, "alignment-offset", fdisk_get_alignment_offset(cxt));
+	ul_jsonwrt_value_u64(&json, "grain", fdisk_get_grain_size(cxt));
+	ul_jsonwrt_value_u64(&json, "first-lba", fdisk_get_first_lba(cxt));
+	ul_jsonwrt_value_u64(&json, "last-lba", fdisk_get_last_lba(cxt));
+
+	if (fdisk_has_label(cxt)) {
+		ul_jsonwrt_value_s(&json, "label",
+				fdisk_label_get_name(fdisk_get_label(cxt, NULL)));
+		if (fdisk_get_disklabel_id(cxt, &id) == 0 && id)
+			ul_jsonwrt_value_s(&json, "id", id);
+		json_partitions(cxt, &json);
+	} else
+		ul_jsonwrt_value_s(&json, "label", NULL);
+
+	if (ld->warnings) {
+		char **w;
+
+		ul_jsonwrt_array_open(&json, "warnings");
+		STRV_FOREACH(w, ld->warnings)
+			ul_jsonwrt_value_s(&json, NULL, *w);
+		ul_jsonwrt_array_close(&json);
+	}
+	ul_jsonwrt_object_close(&json);
+
+	if (fclose(out) != 0 && !ld->rc)
+		ld->rc = -errno;
+	fdisk_deassign_device(cxt, 1);
+done:
+	free(id);
+	fdisk_unref_context(cxt);
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *json_worker(void *data)
+{
+	struct list_queue *q = (struct list_queue *) data;
+
+	while (1) {
+		size_t idx;
+
+		pthread_mutex_lock(&q->lock);
+		idx = q->next++;
+		pthread_mutex_unlock(&q->lock);
+
+		if (idx >= q->ndevs)
+			break;
+		json_device_pt(&q->devs[idx], q->verify);
+	}
+	return NULL;
+}
+#endif
+
+/*
+ * Prints partition tables of the devices in JSON. The @nthreads is the
+ * maximal number of the worker threads, 0 means the number of CPUs. Returns
+ * number of the devices which cannot be listed.
+ */
+int print_devices_pt_json(char **devs, size_t ndevs, int warnme,
+			  int verify, size_t nthreads)
+{
+	struct list_queue q = { .ndevs = ndevs, .verify = verify };
+	struct ul_jsonwrt json;
+	size_t i, nrun = 0, nprinted = 0;
+	int fail = 0;
+
+	q.devs = xcalloc(max(ndevs, (size_t) 1), sizeof(struct list_device));
+	for (i = 0; i < ndevs; i++)
+		q.devs[i].devname = devs[i];
+
+#ifdef HAVE_LIBPTHREAD
+	if (!nthreads) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? (size_t) ncpus : 1;
+	}
+	nthreads = min(nthreads, ndevs);
+	if (nthreads > 1) {
+		pthread_t *threads = xcalloc(nthreads, sizeof(pthread_t));
+
+		pthread_mutex_init(&q.lock, NULL);
+		for (nrun = 0; nrun < nthreads; nrun++) {
+			if (pthread_create(&threads[nrun], NULL, json_worker, &q) != 0)
+				break;
+		}
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+		pthread_mutex_destroy(&q.lock);
+		free(threads);
+	}
+#else
+	(void) nthreads;
+#endif
+	if (!nrun) {
+		/* no thread started */
+		for (i = 0; i < ndevs; i++)
+			json_device_pt(&q.devs[i], verify);
+	}
+
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "devices");
+
+	for (i = 0; i < ndevs; i++) {
+		struct list_device *ld = &q.devs[i];
+
+		if (ld->rc) {
+			errno = -ld->rc;
+			if (warnme || errno == EACCES)
+				warn(_("cannot open %s"), ld->devname);
+			fail++;
+		} else if (ld->data && ld->datasz) {
+			if (nprinted++ == 0) {
+				ul_jsonwrt_indent(&json);
+				fwrite(ld->data + 1, 1, ld->datasz - 1, stdout);
+			} else
+				fwrite(ld->data, 1, ld->datasz, stdout);
+		}
+		free(ld->data);
+		strv_free(ld->warnings);
+	}
+
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+
+	free(q.devs);
+	return fail;
+}
+
+void print_all_devices_pt_json(int verify, size_t nthreads)
+{
+	FILE *f = NULL;
+	char **devs = NULL;
+	char *dev;
+
+	while ((dev = next_proc_partition(&f))) {
+		if (strv_consume(&devs, dev) < 0)
+			err_oom();
+	}
+
+	print_devices_pt_json(devs, strv_length(devs), 0, verify, nthreads);
+	strv_free(devs);
+}
+
 /* usable for example in usage() */
 void list_available_columns(FILE *out)
 {
@@ -13,6 +13,10 @@ extern int print_device_freespace(struct fdisk_context *cxt, char *device, int w
 extern void print_all_devices_pt(struct fdisk_context *cxt, int verify);
 extern void print_all_devices_freespace(struct fdisk_context *cxt);
 
+extern int print_devices_pt_json(char **devs, size_t ndevs, int warnme,
+				 int verify, size_t nthreads);
+extern void print_all_devices_pt_json(int verify, size_t nthreads);
+
 extern void list_available_columns(FILE *out);
 extern int *init_fields(struct fdisk_context *cxt, const char *str, size_t *n);
 
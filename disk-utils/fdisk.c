@@ -864,6 +864,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	        "                                 %s\n", USAGE_COLORS_DEFAULT);
 	fputs(_(" -l, --list                    display partitions and exit\n"), out);
 	fputs(_(" -x, --list-details            like --list but with more details\n"), out);
+	fputs(_(" -J, --json                    use JSON output format for --list\n"), out);
 
 	fputs(_(" -n, --noauto-pt               don't create default partition table on empty devices\n"), out);
 	fputs(_(" -o, --output <list>           output columns\n"), out);
@@ -902,7 +903,7 @@ enum {
 
 int main(int argc, char **argv)
 {
-	int rc, i, c, act = ACT_FDISK, noauto_pt = 0;
+	int rc, i, c, act = ACT_FDISK, noauto_pt = 0, json = 0;
 	int colormode = UL_COLORMODE_UNDEF;
 	struct fdisk_context *cxt;
 	char *outarg = NULL;
@@ -920,6 +921,7 @@ int main(int argc, char **argv)
 		{ "sectors",        required_argument, NULL, 'S' },
 		{ "getsz",          no_argument,       NULL, 's' },
 		{ "help",           no_argument,       NULL, 'h' },
+		{ "json",           no_argument,       NULL, 'J' },
 		{ "list",           no_argument,       NULL, 'l' },
 		{ "list-details",   no_argument,       NULL, 'x' },
 		{ "lock",           optional_argument, NULL, OPT_LOCK },
@@ -950,7 +952,7 @@ int main(int argc, char **argv)
 
 	fdisk_set_ask(cxt, ask_callback, NULL);
 
-	while ((c = getopt_long(argc, argv, "b:Bc::C:hH:lL::no:sS:t:u::vVw:W:x",
+	while ((c = getopt_long(argc, argv, "b:Bc::C:hH:JlL::no:sS:t:u::vVw:W:x",
 				longopts, NULL)) != -1) {
 		switch (c) {
 		case 'b':
@@ -1001,6 +1003,9 @@ int main(int argc, char **argv)
 				strtou32_or_err(optarg,
 					_("invalid sectors argument")));
 			break;
+		case 'J':
+			json = 1;
+			break;
 		case 'l':
 			act = ACT_LIST;
 			break;
@@ -1076,12 +1081,24 @@ int main(int argc, char **argv)
 		warnx(_("The device properties (sector size and geometry) should"
 			" be used with one specified device only."));
 
+	if (json && act != ACT_LIST && act != ACT_LIST_DETAILS)
+		errx(EXIT_FAILURE, _("--json is supported only with --list"));
+
 	colors_init(colormode, "fdisk");
 	is_interactive = isatty(STDIN_FILENO);
 
 	switch (act) {
 	case ACT_LIST:
 	case ACT_LIST_DETAILS:
+		if (json) {
+			/* all devices are probed in parallel by own contexts */
+			if (argc > optind) {
+				if (print_devices_pt_json(argv + optind, argc - optind, 1, 0, 0))
+					return EXIT_FAILURE;
+			} else
+				print_all_devices_pt_json(0, 0);
+			break;
+		}
 		fdisk_enable_listonly(cxt, 1);
 
 		if (act == ACT_LIST_DETAILS)
@@ -43,6 +43,7 @@
 #include <errno.h>
 #include <signal.h>
 #include <dirent.h>
+#include <poll.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <blkid.h>
@@ -55,6 +56,8 @@
 #include "fileutils.h"
 #include "monotonic.h"
 #include "strutils.h"
+#include "blkdev.h"
+#include "ttyutils.h"
 
 #define XALLOC_EXIT_CODE	FSCK_EX_ERROR
 #include "xalloc.h"
@@ -95,6 +98,7 @@ struct fsck_fs_data
 {
 	const char	*device;
 	dev_t		disk;
+	uint64_t	cost;		/* estimated check time for --jobs */
 	unsigned int	stacked:1,
 			done:1,
 			eval_device:1;
@@ -119,6 +123,13 @@ struct fsck_instance {
 	struct rusage rusage;
 	struct libmnt_fs *fs;
 	struct fsck_instance *next;
+
+	/* aggregated progress, see progress_read() */
+	int	progress_pipe;	/* read end of the checker -C pipe or -1 */
+	double	percent;
+	uint64_t cost;
+	char	progress_buf[128];
+	size_t	progress_len;
 };
 
 #define FLAG_DONE 1
@@ -142,12 +153,17 @@ static int notitle;
 static int parallel_root;
 static int progress;
 static int progress_fd;
+static int progress_aggregate;	/* -C for more checks at once */
+static uint64_t progress_cost_total, progress_cost_done;
+static struct timeval progress_last;
 static int force_all_parallel;
 static int report_stats;
 static FILE *report_stats_file;
 
 static int num_running;
 static int max_running;
+static int schedule;		/* --jobs */
+static struct timeval fsck_start_time;
 
 static volatile int cancel_requested;
 static int kill_sent;
@@ -163,6 +179,7 @@ static struct libmnt_table *fstab, *mtab;
 static struct libmnt_cache *mntcache;
 
 static int count_slaves(dev_t disk);
+static uint64_t fs_get_cost(struct libmnt_fs *fs);
 
 static int string_to_int(const char *s)
 {
@@ -421,6 +438,8 @@ static void free_instance(struct fsck_instance *i)
 {
 	if (lockdisk)
 		unlock_disk(i);
+	if (i->progress_pipe >= 0)
+		close(i->progress_pipe);
 	free(i->prog);
 	free(i->lockpath);
 	mnt_unref_fs(i->fs);
@@ -582,6 +601,186 @@ static int progress_active(void)
 	return 0;
 }
 
+static int is_progress_type(const char *type)
+{
+	return strcmp(type, "ext2") == 0 ||
+	       strcmp(type, "ext3") == 0 ||
+	       strcmp(type, "ext4") == 0 ||
+	       strcmp(type, "ext4dev") == 0;
+}
+
+/*
+ * The checker writes "<pass> <current> <max> <device>" lines to the -C
+ * file descriptor; use the same pass weights as e2fsck uses for its own
+ * progress bar.
+ */
+static double progress_percent(int pass, unsigned long cur, unsigned long max)
+{
+	static const int pass_pct[] = { 0, 70, 90, 92, 95, 100 };
+
+	if (pass <= 0)
+		return 0.0;
+	if (pass >= (int) ARRAY_SIZE(pass_pct) || max == 0)
+		return 100.0;
+	return pass_pct[pass - 1] +
+	       (double) cur / max * (pass_pct[pass] - pass_pct[pass - 1]);
+}
+
+static void progress_read(struct fsck_instance *inst)
+{
+	char *p, *end;
+	ssize_t sz;
+
+	while (inst->progress_pipe >= 0) {
+		sz = read(inst->progress_pipe,
+			  inst->progress_buf + inst->progress_len,
+			  sizeof(inst->progress_buf) - 1 - inst->progress_len);
+		if (sz < 0 && errno == EINTR)
+			continue;
+		if (sz <= 0) {
+			if (sz == 0 || errno != EAGAIN) {
+				close(inst->progress_pipe);
+				inst->progress_pipe = -1;
+			}
+			break;
+		}
+		inst->progress_len += sz;
+		inst->progress_buf[inst->progress_len] = '\0';
+
+		for (p = inst->progress_buf; (end = strchr(p, '\n')); p = end + 1) {
+			unsigned long cur, max;
+			int pass;
+
+			*end = '\0';
+			if (sscanf(p, "%d %lu %lu", &pass, &cur, &max) == 3)
+				inst->percent = progress_percent(pass, cur, max);
+		}
+		inst->progress_len = strlen(p);
+		if (inst->progress_len == sizeof(inst->progress_buf) - 1)
+			inst->progress_len = 0;		/* too long line */
+		memmove(inst->progress_buf, p, inst->progress_len);
+	}
+}
+
+/* Returns the estimated remaining time of the check in seconds or -1 */
+static double progress_eta(struct fsck_instance *inst, struct timeval *now)
+{
+	struct timeval delta;
+
+	if (inst->percent < 1.0)
+		return -1;
+
+	timersub(now, &inst->start_time, &delta);
+	return (delta.tv_sec + delta.tv_usec / 1e6)
+			* (100.0 - inst->percent) / inst->percent;
+}
+
+static void sprint_eta(char *buf, size_t bufsz, double eta)
+{
+	if (eta < 0)
+		snprintf(buf, bufsz, "--:--");
+	else
+		snprintf(buf, bufsz, "%d:%02d", (int) eta / 60, (int) eta % 60);
+}
+
+static size_t progress_width(void)
+{
+	return get_terminal_width(80) - 1;
+}
+
+/* Removes the progress line, used before any other output */
+static void progress_clear(void)
+{
+	printf("\r%*s\r", (int) progress_width(), "");
+}
+
+/*
+ * Draws one line with the aggregated progress of all the running checks
+ * (weighted by the filesystem size) and percentage and ETA for each check.
+ */
+static void progress_render(void)
+{
+	struct fsck_instance *inst;
+	struct timeval now, delta;
+	char line[512], eta[16];
+	uint64_t done = progress_cost_done;
+	double percent, maxeta = -1;
+	size_t width, len = 0, i;
+	int running = 0;
+
+	gettime_monotonic(&now);
+	timersub(&now, &progress_last, &delta);
+	if (delta.tv_sec == 0 && delta.tv_usec < 200000)
+		return;
+	progress_last = now;
+
+	width = min(progress_width(), sizeof(line) - 1);
+
+	for (inst = instance_list; inst; inst = inst->next) {
+		if (!inst->cost || (inst->flags & FLAG_DONE))
+			continue;
+		done += inst->cost * inst->percent / 100.0;
+		running++;
+	}
+	if (!running)
+		return;
+
+	/* the checks run in parallel, the slowest one is the ETA */
+	percent = progress_cost_total ? 100.0 * done / progress_cost_total : 0;
+	for (inst = instance_list; inst; inst = inst->next) {
+		if (inst->cost && !(inst->flags & FLAG_DONE))
+			maxeta = max(maxeta, progress_eta(inst, &now));
+	}
+	sprint_eta(eta, sizeof(eta), maxeta);
+
+	line[len++] = '|';
+	for (i = 0; i < 20; i++)
+		line[len++] = i < (size_t) (percent / 5) ? '=' : ' ';
+	len += snprintf(line + len, sizeof(line) - len, "| %5.1f%% ETA %s", percent, eta);
+
+	for (inst = instance_list; inst && len < width; inst = inst->next) {
+		const char *name;
+
+		if (!inst->cost || (inst->flags & FLAG_DONE))
+			continue;
+		name = fs_get_device(inst->fs);
+		if (name && startswith(name, "/dev/"))
+			name += 5;
+		sprint_eta(eta, sizeof(eta), progress_eta(inst, &now));
+		len += snprintf(line + len, sizeof(line) - len, "  %s %d%% %s",
+				name, (int) inst->percent, eta);
+	}
+	len = min(len, width);
+
+	printf("\r%-*.*s", (int) width, (int) len, line);
+}
+
+/*
+ * Waits for the checkers progress data, the timeout is in milliseconds.
+ */
+static void progress_poll(int timeout)
+{
+	struct fsck_instance *inst;
+	struct pollfd fds[32];
+	nfds_t nfds = 0;
+
+	for (inst = instance_list; inst && nfds < ARRAY_SIZE(fds); inst = inst->next) {
+		if (inst->progress_pipe < 0)
+			continue;
+		fds[nfds].fd = inst->progress_pipe;
+		fds[nfds].events = POLLIN;
+		nfds++;
+	}
+
+	if (poll(fds, nfds, timeout) > 0) {
+		for (inst = instance_list; inst; inst = inst->next) {
+			if (inst->progress_pipe >= 0)
+				progress_read(inst);
+		}
+	}
+	progress_render();
+}
+
 /*
  * Process run statistics for finished fsck instances.
  *
@@ -610,11 +809,17 @@ static void print_stats(struct fsck_instance *inst)
 			(int64_t)inst->rusage.ru_utime.tv_usec,
 			(int64_t)inst->rusage.ru_stime.tv_sec,
 			(int64_t)inst->rusage.ru_stime.tv_usec);
-	else
+	else {
+		struct timeval start;
+
+		/* the start of the check since fsck start */
+		timersub(&inst->start_time, &fsck_start_time, &start);
+
 		fprintf(stdout, "%s: status %d, rss %ld, "
 				"real %"PRId64".%06"PRId64", "
 				"user %"PRId64".%06"PRId64", "
-				"sys %"PRId64".%06"PRId64"\n",
+				"sys %"PRId64".%06"PRId64", "
+				"start +%"PRId64".%06"PRId64"\n",
 			fs_get_device(inst->fs),
 			inst->exit_status,
 			inst->rusage.ru_maxrss,
@@ -622,7 +827,9 @@ static void print_stats(struct fsck_instance *inst)
 			(int64_t)inst->rusage.ru_utime.tv_sec,
 			(int64_t)inst->rusage.ru_utime.tv_usec,
 			(int64_t)inst->rusage.ru_stime.tv_sec,
-			(int64_t)inst->rusage.ru_stime.tv_usec);
+			(int64_t)inst->rusage.ru_stime.tv_usec,
+			(int64_t)start.tv_sec, (int64_t)start.tv_usec);
+	}
 }
 
 /*
@@ -633,11 +840,12 @@ static int execute(const char *progname, const char *progpath,
 		   const char *type, struct libmnt_fs *fs, int interactive)
 {
 	char *argv[80];
-	int  argc, i;
+	int  argc, i, pfd[2] = { -1, -1 };
 	struct fsck_instance *inst, *p;
 	pid_t	pid;
 
 	inst = xcalloc(1, sizeof(*inst));
+	inst->progress_pipe = -1;
 
 	argv[0] = xstrdup(progname);
 	argc = 1;
@@ -645,12 +853,17 @@ static int execute(const char *progname, const char *progpath,
 	for (i=0; i <num_args; i++)
 		argv[argc++] = xstrdup(args[i]);
 
-	if (progress &&
-	       ((strcmp(type, "ext2") == 0) ||
-		(strcmp(type, "ext3") == 0) ||
-		(strcmp(type, "ext4") == 0) ||
-		(strcmp(type, "ext4dev") == 0))) {
+	if (progress && progress_aggregate && is_progress_type(type)) {
+		char tmp[80];
 
+		if (pipe(pfd) == 0) {
+			inst->progress_pipe = pfd[0];
+			fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+			fcntl(pfd[0], F_SETFL, O_NONBLOCK);
+			snprintf(tmp, sizeof(tmp), "-C%d", pfd[1]);
+			argv[argc++] = xstrdup(tmp);
+		}
+	} else if (progress && is_progress_type(type)) {
 		char tmp[80];
 		tmp[0] = 0;
 		if (!progress_active()) {
@@ -688,6 +901,8 @@ static int execute(const char *progname, const char *progpath,
 		pid = -1;
 	else if ((pid = fork()) < 0) {
 		warn(_("fork failed"));
+		if (pfd[1] >= 0)
+			close(pfd[1]);
 		free_instance(inst);
 		return errno;
 	} else if (pid == 0) {
@@ -697,6 +912,13 @@ static int execute(const char *progname, const char *progpath,
 		err(FSCK_EX_ERROR, _("%s: execute failed"), progpath);
 	}
 
+	/* the write end is used by the checker only */
+	if (pfd[1] >= 0) {
+		close(pfd[1]);
+		inst->cost = fs_get_cost(fs);
+		progress_cost_total += inst->cost;
+	}
+
 	for (i=0; i < argc; i++)
 		free(argv[i]);
 
@@ -771,11 +993,16 @@ static struct fsck_instance *wait_one(int flags)
 	inst = prev = NULL;
 
 	do {
-		pid = wait4(-1, &status, flags, &rusage);
+		pid = wait4(-1, &status,
+			    progress_aggregate ? flags | WNOHANG : flags, &rusage);
 		if (cancel_requested && !kill_sent) {
 			kill_all(SIGTERM);
 			kill_sent++;
 		}
+		if (pid == 0 && progress_aggregate && !(flags & WNOHANG)) {
+			progress_poll(200);
+			continue;
+		}
 		if ((pid == 0) && (flags & WNOHANG))
 			return NULL;
 		if (pid < 0) {
@@ -819,6 +1046,11 @@ static struct fsck_instance *wait_one(int flags)
 	gettime_monotonic(&inst->end_time);
 	memcpy(&inst->rusage, &rusage, sizeof(struct rusage));
 
+	if (inst->cost) {
+		progress_cost_done += inst->cost;
+		progress_clear();
+	}
+
 	if (progress && (inst->flags & FLAG_PROGRESS) &&
 	    !progress_active()) {
 		for (inst2 = instance_list; inst2; inst2 = inst2->next) {
@@ -1243,6 +1475,162 @@ static int disk_already_active(struct libmnt_fs *fs)
 	return 0;
 }
 
+/*
+ * Returns the estimated cost of the check; the device size is used, and
+ * rotational disks are expected to be slower.
+ */
+static uint64_t fs_get_cost(struct libmnt_fs *fs)
+{
+	struct fsck_fs_data *data = fs_create_data(fs);
+	const char *device;
+	dev_t disk;
+	int fd;
+
+	if (data->cost)
+		return data->cost;
+
+	data->cost = 1;
+	device = fs_get_device(fs);
+	if (!device)
+		return data->cost;
+
+	fd = open(device, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+	if (fd >= 0) {
+		unsigned long long sz = 0;
+
+		if (blkdev_get_size(fd, &sz) == 0 && sz)
+			data->cost = sz;
+		close(fd);
+	}
+
+	disk = fs_get_disk(fs, 1);
+	if (disk && !is_irrotational_disk(disk))
+		data->cost *= 4;
+	return data->cost;
+}
+
+static int fs_is_running(struct libmnt_fs *fs)
+{
+	struct fsck_instance *inst;
+
+	for (inst = instance_list; inst; inst = inst->next) {
+		if (inst->fs == fs)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Returns TRUE if a filesystem with lower pass number on the same disk is not
+ * checked yet. The filesystems on unknown or stacked devices depend on all
+ * the filesystems with lower pass number.
+ */
+static int fs_wait_lower_pass(struct libmnt_fs *fs, struct libmnt_fs **list,
+			      size_t nfs)
+{
+	int passno = mnt_fs_get_passno(fs);
+	dev_t disk = fs_get_disk(fs, 1);
+	size_t i;
+
+	for (i = 0; i < nfs; i++) {
+		struct libmnt_fs *x = list[i];
+		dev_t xdisk;
+
+		if (x == fs || mnt_fs_get_passno(x) >= passno)
+			continue;
+		if (fs_is_done(x) && !fs_is_running(x))
+			continue;
+		xdisk = fs_get_disk(x, 1);
+		if (!disk || !xdisk || fs_is_stacked(fs) || fs_is_stacked(x) ||
+		    disk == xdisk)
+			return 1;
+	}
+	return 0;
+}
+
+static int cmp_fs_cost(const void *a, const void *b)
+{
+	uint64_t x = fs_get_cost(*(struct libmnt_fs **) a),
+		 y = fs_get_cost(*(struct libmnt_fs **) b);
+
+	return x > y ? -1 : x < y ? 1 : 0;
+}
+
+/*
+ * The --jobs scheduler; the filesystems are not checked pass by pass, but the
+ * check starts when all filesystems with lower pass number on the same disk
+ * are checked. The most expensive checks are started first.
+ */
+static int check_all_scheduled(struct libmnt_iter *itr)
+{
+	struct libmnt_fs *fs, **list = NULL;
+	size_t i, nfs = 0, ndone = 0;
+	int status = FSCK_EX_OK;
+
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(fstab, itr, &fs) == 0) {
+		if (fs_is_done(fs))
+			continue;
+		list = xrealloc(list, (nfs + 1) * sizeof(struct libmnt_fs *));
+		list[nfs++] = fs;
+	}
+	if (!nfs)
+		return status;
+
+	for (i = 0; i < nfs; i++)
+		fs_get_cost(list[i]);
+	qsort(list, nfs, sizeof(struct libmnt_fs *), cmp_fs_cost);
+
+	while (ndone < nfs) {
+		int started = 0;
+
+		for (i = 0; i < nfs; i++) {
+			fs = list[i];
+
+			if (cancel_requested)
+				break;
+			if (max_running && num_running >= max_running)
+				break;
+			if (fs_is_done(fs))
+				continue;
+			if (ignore_mounted && is_mounted(fs)) {
+				fs_set_done(fs);
+				ndone++;
+				continue;
+			}
+			if (fs_wait_lower_pass(fs, list, nfs) ||
+			    disk_already_active(fs))
+				continue;
+
+			status |= fsck_device(fs, serialize);
+			fs_set_done(fs);
+			ndone++;
+			started++;
+		}
+		if (cancel_requested)
+			break;
+		if (!started && !instance_list) {
+			/* nothing to wait for; should not happen */
+			for (i = 0; i < nfs; i++) {
+				if (!fs_is_done(list[i])) {
+					fs_set_done(list[i]);
+					ndone++;
+				}
+			}
+			break;
+		}
+		if (verbose > 1)
+			printf(_("--waiting-- (%d running)\n"), num_running);
+
+		status |= wait_many(FLAG_WAIT_ATLEAST_ONE);
+	}
+
+	if (!cancel_requested)
+		status |= wait_many(FLAG_WAIT_ALL);
+	free(list);
+	return status;
+}
+
 /* Check all file systems, using the /etc/fstab table. */
 static int check_all(void)
 {
@@ -1307,6 +1695,11 @@ static int check_all(void)
 		}
 	}
 
+	if (schedule) {
+		status |= check_all_scheduled(itr);
+		not_done_yet = 0;
+	}
+
 	while (not_done_yet) {
 		not_done_yet = 0;
 		pass_done = 1;
@@ -1408,6 +1801,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -t <type>  specify filesystem types to be checked;\n"
 		"            <type> is allowed to be a comma-separated list\n"), out);
 	fputs(_(" -V         explain what is being done\n"), out);
+	fputs(_(" --jobs <num>  run up to <num> checks at once, independently on passes\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf( " -?, --help     %s\n", USAGE_OPTSTR_HELP);
@@ -1456,6 +1850,25 @@ static void parse_argv(int argc, char *argv[])
 		if (!opts_for_fsck && !strcmp(arg, "--version"))
 			print_version(FSCK_EX_OK);
 
+		/* not -j, it's used by fsck.ext* for external journal */
+		if (!opts_for_fsck && (!strcmp(arg, "--jobs") ||
+				       !strncmp(arg, "--jobs=", 7))) {
+			if (arg[6] == '=')
+				tmp = arg + 7;
+			else if (i + 1 < argc)
+				tmp = argv[++i];
+			else
+				errx(FSCK_EX_USAGE,
+					_("option '%s' requires an argument"), "--jobs");
+			schedule = strtou32_or_err(tmp, _("invalid argument of --jobs"));
+			if (!schedule) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+				schedule = n > 0 ? (int) n : 1;
+			}
+			continue;
+		}
+
 		if ((arg[0] == '/' && !opts_for_fsck) || strchr(arg, '=')) {
 			if (num_devices >= MAX_DEVICES)
 				errx(FSCK_EX_ERROR, _("too many devices"));
@@ -1606,6 +2019,8 @@ static void parse_argv(int argc, char *argv[])
 		force_all_parallel++;
 	if (ul_strtos32(getenv("FSCK_MAX_INST"), &max_running, 10) != 0)
 		max_running = 0;
+	if (schedule)
+		max_running = schedule;
 }
 
 int main(int argc, char *argv[])
@@ -1629,6 +2044,7 @@ int main(int argc, char *argv[])
 	mntcache = mnt_new_cache();	/* no fatal error if failed */
 
 	parse_argv(argc, argv);
+	gettime_monotonic(&fsck_start_time);
 
 	if (!notitle)
 		printf(UTIL_LINUX_VERSION);
@@ -1646,6 +2062,11 @@ int main(int argc, char *argv[])
 		lockdisk = 0;
 	}
 
+	/* Aggregate progress of the parallel checks to one line */
+	if (progress && !progress_fd && !serialize && max_running != 1 &&
+	    !noexecute && (doall || num_devices > 1) && isatty(STDOUT_FILENO))
+		progress_aggregate = 1;
+
 	/* If -A was specified ("check all"), do that! */
 	if (doall)
 		return check_all();
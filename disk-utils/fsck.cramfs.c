@@ -43,6 +43,9 @@
 #include <string.h>
 #include <getopt.h>
 #include <fcntl.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 /* We don't use our include/crc32.h, but crc32 from zlib!
  *
@@ -63,6 +66,8 @@
 #include "exitcodes.h"
 #include "strutils.h"
 #include "closestream.h"
+#include "monotonic.h"
+#include "all-io.h"
 
 #define XALLOC_EXIT_CODE FSCK_EX_ERROR
 #include "xalloc.h"
@@ -74,6 +79,13 @@ static int cramfs_is_big_endian = 0;	/* source is big endian */
 static int opt_verbose = 0;	/* 1 = verbose (-v), 2+ = very verbose (-vv) */
 static int opt_extract = 0;	/* extract cramfs (-x) */
 static char *extract_dir = "";		/* optional extraction directory (-x) */
+static unsigned int opt_parallel = 1;	/* number of threads (-j) */
+static int opt_stats = 0;		/* print throughput (--stats) */
+
+/* --stats */
+static size_t stat_files;		/* regular files with data */
+static unsigned long long stat_bytes;	/* uncompressed data */
+static unsigned long long stat_zbytes;	/* compressed data */
 
 #define PAD_SIZE 512
 
@@ -125,6 +137,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -y                       for compatibility only, ignored\n"), out);
 	fputs(_(" -b, --blocksize <size>   use this blocksize, defaults to page size\n"), out);
 	fputs(_("     --extract[=<dir>]    test uncompression, optionally extract into <dir>\n"), out);
+	fputs(_(" -j, --parallel <num>     uncompress files by <num> threads (0 means auto)\n"), out);
+	fputs(_("     --stats              print the amount of data and the throughput\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(26));
 
@@ -356,26 +370,41 @@ static struct cramfs_inode *read_super(void)
 	return root;
 }
 
-static int uncompress_block(void *src, size_t len)
+static int uncompress_block(z_stream *zs, char *out, void *src, size_t len)
 {
 	int err;
 
-	stream.next_in = src;
-	stream.avail_in = len;
+	zs->next_in = src;
+	zs->avail_in = len;
 
-	stream.next_out = (unsigned char *)outbuffer;
-	stream.avail_out = blksize * 2;
+	zs->next_out = (unsigned char *)out;
+	zs->avail_out = blksize * 2;
 
-	inflateReset(&stream);
+	inflateReset(zs);
 
 	if (len > blksize * 2)
 		errx(FSCK_EX_UNCORRECTED, _("data block too large"));
 
-	err = inflate(&stream, Z_FINISH);
+	err = inflate(zs, Z_FINISH);
 	if (err != Z_STREAM_END)
 		errx(FSCK_EX_UNCORRECTED, _("decompression error: %s"),
 		     zError(err));
-	return stream.total_out;
+	return zs->total_out;
+}
+
+/* @out is the uncompressed size of the block, @size is the rest of the file */
+static void check_block_size(unsigned long out, unsigned long size)
+{
+	if (size >= blksize) {
+		if (out != blksize)
+			errx(FSCK_EX_UNCORRECTED,
+			     _("non-block (%ld) bytes"), out);
+	} else {
+		if (out != size)
+			errx(FSCK_EX_UNCORRECTED,
+			     _("non-size (%ld vs %ld) bytes"), out,
+			     size);
+	}
 }
 
 #ifndef HAVE_LCHOWN
@@ -408,19 +437,13 @@ static void do_uncompress(char *path, int outfd, unsigned long offset,
 			if (opt_verbose > 1)
 				printf(_("  uncompressing block at %lu to %lu (%lu)\n"),
 				       curr, next, next - curr);
-			out = uncompress_block(romfs_read(curr), next - curr);
-		}
-		if (size >= blksize) {
-			if (out != blksize)
-				errx(FSCK_EX_UNCORRECTED,
-				     _("non-block (%ld) bytes"), out);
-		} else {
-			if (out != size)
-				errx(FSCK_EX_UNCORRECTED,
-				     _("non-size (%ld vs %ld) bytes"), out,
-				     size);
+			out = uncompress_block(&stream, outbuffer,
+					       romfs_read(curr), next - curr);
+			stat_zbytes += next - curr;
 		}
+		check_block_size(out, size);
 		size -= out;
+		stat_bytes += out;
 		if (*extract_dir != '\0' && write(outfd, outbuffer, out) < 0)
 			err(FSCK_EX_ERROR, _("write failed: %s"), path);
 		curr = next;
@@ -444,6 +467,193 @@ static void change_file_status(char *path, struct cramfs_inode *i)
 		err(FSCK_EX_ERROR, _("utimes failed: %s"), path);
 }
 
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Parallel mode (-j). The directory tree is walked (and the metadata are
+ * checked) by the main thread as usually, but the data of the regular files
+ * are only queued. The queue is processed by the threads after the walk;
+ * the blocks are read by pread() and every thread has its own buffers and
+ * zlib stream, so the files are uncompressed (and extracted) independently.
+ */
+struct fsck_job {
+	char *path;
+	struct cramfs_inode inode;
+};
+
+struct fsck_worker {
+	z_stream stream;
+	char *inbuf;
+	char *outbuf;
+	uint32_t *ptrs;			/* block pointers of the file */
+	size_t nptrs;
+
+	unsigned long end_data;
+	unsigned long long bytes;
+	unsigned long long zbytes;
+};
+
+static struct fsck_queue {
+	struct fsck_job *jobs;
+	size_t njobs;
+	size_t nalloc;
+
+	size_t next;			/* the next job for the threads */
+	pthread_mutex_t lock;
+} queue = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void queue_file(char *path, struct cramfs_inode *i)
+{
+	struct fsck_job *job;
+
+	if (queue.njobs == queue.nalloc) {
+		queue.nalloc = queue.nalloc ? queue.nalloc * 2 : 256;
+		queue.jobs = xrealloc(queue.jobs, queue.nalloc * sizeof(struct fsck_job));
+	}
+	job = &queue.jobs[queue.njobs++];
+	job->path = xstrdup(path);
+	job->inode = *i;
+}
+
+/* The same as romfs_read(), but without the shared buffer */
+static void read_image(void *buf, size_t sz, unsigned long offset)
+{
+	ssize_t x = pread(fd, buf, sz, offset);
+
+	if (x < 0) {
+		warn(_("read romfs failed"));
+		x = 0;
+	}
+	if ((size_t) x < sz)
+		memset((char *) buf + x, 0, sz - x);
+}
+
+static void uncompress_job(struct fsck_worker *w, struct fsck_job *job)
+{
+	struct cramfs_inode *i = &job->inode;
+	unsigned long offset = i->offset << 2;
+	unsigned long size = i->size;
+	size_t n, nblocks = (size + blksize - 1) / blksize;
+	unsigned long curr = offset + 4 * nblocks;
+	int outfd = -1;
+
+	if (*extract_dir != '\0') {
+		outfd = open(job->path, O_WRONLY | O_CREAT | O_TRUNC, i->mode);
+		if (outfd < 0)
+			err(FSCK_EX_ERROR, _("cannot open %s"), job->path);
+	}
+
+	if (w->nptrs < nblocks) {
+		w->nptrs = nblocks;
+		w->ptrs = xrealloc(w->ptrs, nblocks * sizeof(uint32_t));
+	}
+	read_image(w->ptrs, nblocks * sizeof(uint32_t), offset);
+
+	for (n = 0; n < nblocks; n++) {
+		unsigned long out = blksize;
+		unsigned long next = u32_toggle_endianness(cramfs_is_big_endian,
+							   w->ptrs[n]);
+		if (next > w->end_data)
+			w->end_data = next;
+
+		if (curr == next) {
+			if (size < blksize)
+				out = size;
+			memset(w->outbuf, 0x00, out);
+		} else {
+			if (next - curr > blksize * 2)
+				errx(FSCK_EX_UNCORRECTED, _("data block too large"));
+			read_image(w->inbuf, next - curr, curr);
+			out = uncompress_block(&w->stream, w->outbuf,
+					       w->inbuf, next - curr);
+			w->zbytes += next - curr;
+		}
+		check_block_size(out, size);
+		size -= out;
+		w->bytes += out;
+		if (outfd >= 0 && write_all(outfd, w->outbuf, out) != 0)
+			err(FSCK_EX_ERROR, _("write failed: %s"), job->path);
+		curr = next;
+	}
+
+	if (outfd >= 0) {
+		if (close_fd(outfd) != 0)
+			err(FSCK_EX_ERROR, _("write failed: %s"), job->path);
+		change_file_status(job->path, i);
+	}
+}
+
+static void *uncompress_worker(void *data)
+{
+	struct fsck_worker *w = (struct fsck_worker *) data;
+
+	while (1) {
+		size_t idx;
+
+		pthread_mutex_lock(&queue.lock);
+		idx = queue.next++;
+		pthread_mutex_unlock(&queue.lock);
+
+		if (idx >= queue.njobs)
+			break;
+		uncompress_job(w, &queue.jobs[idx]);
+	}
+	return NULL;
+}
+
+static void uncompress_queue(void)
+{
+	size_t i, nrun, nthreads = min((size_t) opt_parallel, queue.njobs);
+	struct fsck_worker *workers;
+	pthread_t *threads;
+
+	if (!queue.njobs)
+		return;
+
+	workers = xcalloc(nthreads, sizeof(struct fsck_worker));
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+
+	for (i = 0; i < nthreads; i++) {
+		struct fsck_worker *w = &workers[i];
+
+		w->inbuf = xmalloc(blksize * 2);
+		w->outbuf = xmalloc(blksize * 2);
+		if (inflateInit(&w->stream) != Z_OK)
+			errx(FSCK_EX_ERROR, _("failed to initialize zlib"));
+	}
+
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL,
+				   uncompress_worker, &workers[nrun]) != 0)
+			break;
+	}
+	if (!nrun)
+		uncompress_worker(&workers[0]);	/* no thread started */
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		struct fsck_worker *w = &workers[i];
+
+		if (w->end_data > end_data)
+			end_data = w->end_data;
+		stat_bytes += w->bytes;
+		stat_zbytes += w->zbytes;
+
+		inflateEnd(&w->stream);
+		free(w->inbuf);
+		free(w->outbuf);
+		free(w->ptrs);
+	}
+	for (i = 0; i < queue.njobs; i++)
+		free(queue.jobs[i].path);
+	free(queue.jobs);
+	free(workers);
+	free(threads);
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static void do_directory(char *path, struct cramfs_inode *i)
 {
 	int pathlen = strlen(path);
@@ -515,6 +725,14 @@ static void do_file(char *path, struct cramfs_inode *i)
 		start_data = offset;
 	if (opt_verbose)
 		print_node('f', i, path);
+	if (i->size)
+		stat_files++;
+#ifdef HAVE_LIBPTHREAD
+	if (opt_parallel > 1 && i->size) {
+		queue_file(path, i);
+		return;
+	}
+#endif
 	if (*extract_dir != '\0') {
 		outfd = open(path, O_WRONLY | O_CREAT | O_TRUNC, i->mode);
 		if (outfd < 0)
@@ -548,7 +766,7 @@ static void do_symlink(char *path, struct cramfs_inode *i)
 	if (next > end_data)
 		end_data = next;
 
-	size = uncompress_block(romfs_read(curr), next - curr);
+	size = uncompress_block(&stream, outbuffer, romfs_read(curr), next - curr);
 	if (size != i->size)
 		errx(FSCK_EX_UNCORRECTED, _("size error in symlink: %s"), path);
 	outbuffer[size] = 0;
@@ -634,6 +852,9 @@ static void test_fs(int start)
 	inflateInit(&stream);
 	expand_fs(extract_dir, root);
 	inflateEnd(&stream);
+#ifdef HAVE_LIBPTHREAD
+	uncompress_queue();
+#endif
 	if (start_data != ~0UL) {
 		if (start_data < (sizeof(struct cramfs_super) + start))
 			errx(FSCK_EX_UNCORRECTED,
@@ -650,18 +871,46 @@ static void test_fs(int start)
 	iput(root);		/* free(root) */
 }
 
+static void print_stats(struct timeval *begin)
+{
+	struct timeval now, diff;
+	double sec;
+	char *data, *zdata, *speed;
+
+	gettime_monotonic(&now);
+	timersub(&now, begin, &diff);
+	sec = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+	data = size_to_human_string(SIZE_SUFFIX_3LETTER, stat_bytes);
+	zdata = size_to_human_string(SIZE_SUFFIX_3LETTER, stat_zbytes);
+	speed = size_to_human_string(SIZE_SUFFIX_3LETTER,
+			sec > 0 ? (uint64_t) (stat_bytes / sec) : stat_bytes);
+
+	printf(_("%zu files, %s uncompressed from %s in %.3f seconds (%s/s)\n"),
+			stat_files, data, zdata, sec, speed);
+	free(data);
+	free(zdata);
+	free(speed);
+}
+
 int main(int argc, char **argv)
 {
 	int c;			/* for getopt */
 	int start = 0;
 	size_t length = 0;
+	struct timeval begin;
 
+	enum {
+		OPT_STATS = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{"verbose",   no_argument,       NULL, 'v'},
 		{"version",   no_argument,       NULL, 'V'},
 		{"help",      no_argument,       NULL, 'h'},
 		{"blocksize", required_argument, NULL, 'b'},
 		{"extract",   optional_argument, NULL, 'x'},
+		{"parallel",  required_argument, NULL, 'j'},
+		{"stats",     no_argument,       NULL, OPT_STATS},
 		{NULL, 0, NULL, 0},
 	};
 
@@ -674,7 +923,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(FSCK_EX_USAGE);
 
 	/* command line options */
-	while ((c = getopt_long(argc, argv, "ayvVhb:", longopts, NULL)) != EOF)
+	while ((c = getopt_long(argc, argv, "ayvVhb:j:", longopts, NULL)) != EOF)
 		switch (c) {
 		case 'a':		/* ignore */
 		case 'y':
@@ -695,6 +944,14 @@ int main(int argc, char **argv)
 		case 'b':
 			blksize = strtou32_or_err(optarg, _("invalid blocksize argument"));
 			break;
+		case 'j':
+			opt_parallel = strtou32_or_err(optarg, _("invalid number of threads argument"));
+			if (opt_parallel == 0)
+				opt_parallel = sysconf(_SC_NPROCESSORS_ONLN);
+			break;
+		case OPT_STATS:
+			opt_stats = 1;
+			break;
 		default:
 			errtryhelp(FSCK_EX_USAGE);
 		}
@@ -705,6 +962,15 @@ int main(int argc, char **argv)
 	}
 	filename = argv[optind];
 
+#ifndef HAVE_LIBPTHREAD
+	opt_parallel = 1;
+#endif
+	/* the block messages have to be in order */
+	if (opt_verbose > 1)
+		opt_parallel = 1;
+
+	gettime_monotonic(&begin);
+
 	test_super(&start, &length);
 	test_crc(start);
 
@@ -726,6 +992,8 @@ int main(int argc, char **argv)
 		test_fs(start);
 	}
 
+	if (opt_stats)
+		print_stats(&begin);
 	if (opt_verbose)
 		printf(_("%s: OK\n"), filename);
 
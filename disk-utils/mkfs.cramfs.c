@@ -36,6 +36,9 @@
 #include <string.h>
 #include <getopt.h>
 #include <zconf.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 /* We don't use our include/crc32.h, but crc32 from zlib!
  *
@@ -66,6 +69,7 @@ static unsigned int blksize = 0; /* settable via -b option, default page size */
 static long total_blocks = 0, total_nodes = 1; /* pre-count the root node */
 static int image_length = 0;
 static int cramfs_is_big_endian = 0; /* target is big endian */
+static unsigned int nthreads = 1; /* settable via -j option */
 
 /*
  * If opt_holes is set, then mkcramfs can create explicit holes in the
@@ -125,7 +129,7 @@ struct entry {
 static void __attribute__((__noreturn__)) usage(void)
 {
 	fputs(USAGE_HEADER, stdout);
-	printf(_(" %s [-h] [-v] [-b blksize] [-e edition] [-N endian] [-i file] [-n name] dirname outfile\n"),
+	printf(_(" %s [-h] [-v] [-b blksize] [-e edition] [-N endian] [-i file] [-j num] [-n name] dirname outfile\n"),
 		program_invocation_short_name);
 	fputs(USAGE_SEPARATOR, stdout);
 	puts(_("Make compressed ROM file system."));
@@ -136,6 +140,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	puts(_(  " -e edition     set edition number (part of fsid)"));
 	printf(_(" -N endian      set cramfs endianness (%s|%s|%s), default %s\n"), "big", "little", "host", "host");
 	puts(_(  " -i file        insert a file image into the filesystem"));
+	puts(_(  " -j num         compress by <num> threads (0 for number of CPUs)"));
 	puts(_(  " -n name        set name of cramfs filesystem"));
 	printf(_(" -p             pad by %d bytes for boot code\n"), PAD_SIZE);
 	puts(_(  " -s             sort directory entries (old option, ignored)"));
@@ -244,40 +249,133 @@ identical_file(struct entry *e1, struct entry *e2){
  */
 #define MAX_INPUT_NAMELEN 255
 
-static int find_identical_file(struct entry *orig, struct entry *new, loff_t *fslen_ub)
+/*
+ * Duplicate files index. The files are hashed by size and only files with
+ * the same size as any other file are hashed (and read) by MD5 too. Every
+ * chain keeps the entries in the order of the tree, so the file is always
+ * linked to the first identical file in the tree.
+ */
+struct dup_node {
+	struct entry *e;
+	struct dup_node *next;
+};
+
+struct dup_index {
+	struct dup_node **bysize;	/* the first file of the size */
+	struct dup_node **bymd5;	/* files with the same size as another file */
+	struct dup_node *nodes;
+	size_t nbuckets;
+	size_t nnodes;
+};
+
+static size_t dup_hash_size(const struct dup_index *di, unsigned int size)
 {
-	if (orig == new)
-		return 1;
-	if (!orig)
-		return 0;
-	if (orig->size == new->size && orig->path) {
-		if (!orig->flags)
-			mdfile(orig);
-		if (!new->flags)
-			mdfile(new);
-
-		if ((orig->flags & CRAMFS_EFLAG_MD5) &&
-		    (new->flags & CRAMFS_EFLAG_MD5) &&
+	return (size * 2654435761U) & (di->nbuckets - 1);
+}
+
+static size_t dup_hash_md5(const struct dup_index *di, const struct entry *e)
+{
+	uint32_t h;
+
+	memcpy(&h, e->md5sum, sizeof(h));
+	return (h ^ e->size) & (di->nbuckets - 1);
+}
+
+static struct dup_node *dup_add(struct dup_index *di, struct dup_node **bucket,
+				struct entry *e)
+{
+	struct dup_node *n = &di->nodes[di->nnodes++];
+
+	/* append, the chain is in the tree order */
+	while (*bucket)
+		bucket = &(*bucket)->next;
+	n->e = e;
+	n->next = NULL;
+	*bucket = n;
+	return n;
+}
+
+static void find_identical_file(struct dup_index *di, struct entry *new, loff_t *fslen_ub)
+{
+	struct dup_node *n, **bucket;
+
+	for (n = di->bysize[dup_hash_size(di, new->size)]; n; n = n->next)
+		if (n->e->size == new->size)
+			break;
+	if (!n) {
+		/* the first file of the size, MD5 is unnecessary */
+		dup_add(di, &di->bysize[dup_hash_size(di, new->size)], new);
+		return;
+	}
+
+	/* the first file of the size is hashed when the second one is found */
+	if (!n->e->flags) {
+		mdfile(n->e);
+		if (n->e->flags & CRAMFS_EFLAG_MD5)
+			dup_add(di, &di->bymd5[dup_hash_md5(di, n->e)], n->e);
+	}
+
+	mdfile(new);
+	if (!(new->flags & CRAMFS_EFLAG_MD5))
+		return;
+
+	bucket = &di->bymd5[dup_hash_md5(di, new)];
+	for (n = *bucket; n; n = n->next) {
+		struct entry *orig = n->e;
+
+		if (orig->size == new->size &&
 		    !memcmp(orig->md5sum, new->md5sum, UL_MD5LENGTH) &&
 		    identical_file(orig, new)) {
 			new->same = orig;
 			*fslen_ub -= new->size;
-			return 1;
+			return;
 		}
 	}
-	return find_identical_file(orig->child, new, fslen_ub) ||
-		   find_identical_file(orig->next, new, fslen_ub);
+	dup_add(di, bucket, new);
+}
+
+static size_t count_files(struct entry *e)
+{
+	size_t n = 0;
+
+	for (; e; e = e->next) {
+		if (e->size && e->path)
+			n++;
+		n += count_files(e->child);
+	}
+	return n;
 }
 
-static void eliminate_doubles(struct entry *root, struct entry *orig, loff_t *fslen_ub) {
-	if (orig) {
-		if (orig->size && orig->path)
-			find_identical_file(root,orig, fslen_ub);
-		eliminate_doubles(root,orig->child, fslen_ub);
-		eliminate_doubles(root,orig->next, fslen_ub);
+static void eliminate_doubles_walk(struct dup_index *di, struct entry *e, loff_t *fslen_ub)
+{
+	for (; e; e = e->next) {
+		if (e->size && e->path)
+			find_identical_file(di, e, fslen_ub);
+		eliminate_doubles_walk(di, e->child, fslen_ub);
 	}
 }
 
+static void eliminate_doubles(struct entry *root, loff_t *fslen_ub)
+{
+	struct dup_index di = { .nbuckets = 16 };
+	size_t nfiles = count_files(root);
+
+	if (nfiles < 2)
+		return;
+	while (di.nbuckets < nfiles)
+		di.nbuckets <<= 1;
+
+	di.bysize = xcalloc(di.nbuckets, sizeof(struct dup_node *));
+	di.bymd5 = xcalloc(di.nbuckets, sizeof(struct dup_node *));
+	di.nodes = xcalloc(nfiles * 2, sizeof(struct dup_node));	/* every file is twice at most */
+
+	eliminate_doubles_walk(&di, root, fslen_ub);
+
+	free(di.bysize);
+	free(di.bymd5);
+	free(di.nodes);
+}
+
 /*
  * We define our own sorting function instead of using alphasort which
  * uses strcoll and changes ordering based on locale information.
@@ -652,6 +750,243 @@ write_data(struct entry *entry, char *base, unsigned int offset) {
 	return offset;
 }
 
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Parallel compression (-j).
+ *
+ * The files are processed in windows of about CRAMFS_ZWINDOW bytes of input
+ * data. The blocks of all files in the window are compressed by the threads to
+ * separate output slots, and then the window is assembled to the image in the
+ * same order and with the same layout as do_compress() does, so the image is
+ * byte-identical to the serial one.
+ */
+#define CRAMFS_ZWINDOW	(32 * 1024 * 1024)
+#define CRAMFS_ZCHUNK	16	/* blocks per one worker step */
+
+struct cramfs_zblock {
+	Bytef		*in;
+	uLongf		insz;
+	uLongf		len;		/* compressed size */
+	unsigned int	hole : 1;
+};
+
+struct cramfs_zqueue {
+	struct entry		**ents;		/* entries with data in write order */
+	char			**starts;	/* mmapped data of the entries */
+	size_t			*firsts;	/* index of the first block */
+	size_t			nents;
+
+	struct cramfs_zblock	*blocks;
+	Bytef			*out;		/* 2 * blksize for every block */
+	size_t			nblocks;
+	size_t			nalloc;
+
+	pthread_mutex_t		lock;		/* protects @next */
+	size_t			next;
+};
+
+static void collect_data(struct entry *entry, struct entry ***ents,
+			 size_t *nents, size_t *nalloc)
+{
+	struct entry *e;
+
+	for (e = entry; e; e = e->next) {
+		if (e->path) {
+			if (!e->same && !e->size)
+				continue;
+			if (*nents == *nalloc) {
+				*nalloc = *nalloc ? *nalloc * 2 : 256;
+				*ents = xrealloc(*ents, *nalloc * sizeof(struct entry *));
+			}
+			(*ents)[(*nents)++] = e;
+		} else if (e->child)
+			collect_data(e->child, ents, nents, nalloc);
+	}
+}
+
+static void *compress_worker(void *data)
+{
+	struct cramfs_zqueue *q = data;
+
+	for (;;) {
+		size_t i, from, to;
+
+		pthread_mutex_lock(&q->lock);
+		from = q->next;
+		to = min(from + CRAMFS_ZCHUNK, q->nblocks);
+		q->next = to;
+		pthread_mutex_unlock(&q->lock);
+
+		if (from >= to)
+			break;
+
+		for (i = from; i < to; i++) {
+			struct cramfs_zblock *b = &q->blocks[i];
+
+			b->len = 2 * blksize;
+			if (is_zero(b->in, b->insz))
+				b->hole = 1;
+			else
+				compress(q->out + i * 2 * blksize, &b->len,
+					 b->in, b->insz);
+		}
+	}
+	return NULL;
+}
+
+static void compress_window(struct cramfs_zqueue *q)
+{
+	pthread_t *threads;
+	unsigned int i, nrun;
+
+	q->next = 0;
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, compress_worker, q) != 0)
+			break;
+	}
+	if (!nrun)
+		compress_worker(q);
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+/* add blocks of the @idx entry to the window */
+static void add_window_blocks(struct cramfs_zqueue *q, size_t idx)
+{
+	struct entry *e = q->ents[idx];
+	unsigned int size = e->size;
+	Bytef *p;
+
+	q->firsts[idx] = q->nblocks;
+	q->starts[idx] = do_mmap(e->path, e->size, e->mode);
+	if (!q->starts[idx])
+		return;
+
+	for (p = (Bytef *) q->starts[idx]; size; ) {
+		struct cramfs_zblock *b;
+		uLongf input = min(size, blksize);
+
+		if (q->nblocks == q->nalloc) {
+			q->nalloc *= 2;
+			q->blocks = xrealloc(q->blocks, q->nalloc * sizeof(struct cramfs_zblock));
+			q->out = xrealloc(q->out, q->nalloc * 2 * blksize);
+		}
+		b = &q->blocks[q->nblocks++];
+		b->in = p;
+		b->insz = input;
+		b->hole = 0;
+
+		p += input;
+		size -= input;
+	}
+}
+
+/* the same as do_compress(), but the blocks are already compressed */
+static unsigned int assemble_file(struct cramfs_zqueue *q, size_t idx,
+				  char *base, unsigned int offset)
+{
+	struct entry *e = q->ents[idx];
+	unsigned long original_offset = offset, new_size, blocks, curr, i;
+	long change;
+
+	if (!q->starts[idx])
+		return offset;
+
+	blocks = (e->size - 1) / blksize + 1;
+	curr = offset + 4 * blocks;
+	total_blocks += blocks;
+
+	for (i = 0; i < blocks; i++) {
+		size_t n = q->firsts[idx] + i;
+		struct cramfs_zblock *b = &q->blocks[n];
+
+		if (!b->hole) {
+			memcpy(base + curr, q->out + n * 2 * blksize, b->len);
+			curr += b->len;
+		}
+		if (b->len > blksize*2) {
+			printf(_("AIEEE: block \"compressed\" to > "
+				 "2*blocklength (%ld)\n"),
+			       b->len);
+			exit(MKFS_EX_ERROR);
+		}
+
+		*(uint32_t *) (base + offset) = u32_toggle_endianness(cramfs_is_big_endian, curr);
+		offset += 4;
+	}
+
+	do_munmap(q->starts[idx], e->size, e->mode);
+
+	curr = (curr + 3) & ~3;
+	new_size = curr - original_offset;
+	change = new_size - e->size;
+	if (verbose)
+		printf(_("%6.2f%% (%+ld bytes)\t%s\n"),
+		       (change * 100) / (double) e->size, change, e->name);
+
+	return curr;
+}
+
+/*
+ * The parallel version of write_data().
+ */
+static unsigned int
+write_data_parallel(struct entry *entry, char *base, unsigned int offset)
+{
+	struct cramfs_zqueue q = { .nents = 0 };
+	size_t nalloc = 0, i, first, last;
+
+	collect_data(entry, &q.ents, &q.nents, &nalloc);
+	if (!q.nents)
+		return offset;
+
+	q.starts = xcalloc(q.nents, sizeof(char *));
+	q.firsts = xcalloc(q.nents, sizeof(size_t));
+	q.nalloc = CRAMFS_ZWINDOW / blksize + 1;
+	q.blocks = xcalloc(q.nalloc, sizeof(struct cramfs_zblock));
+	q.out = xmalloc(q.nalloc * 2 * blksize);
+	pthread_mutex_init(&q.lock, NULL);
+
+	for (first = 0; first < q.nents; first = last) {
+		size_t insz = 0;
+
+		/* at least one file, the files are smaller than 16MiB */
+		q.nblocks = 0;
+		for (last = first; last < q.nents && insz < CRAMFS_ZWINDOW; last++) {
+			if (q.ents[last]->same)
+				continue;
+			add_window_blocks(&q, last);
+			insz += q.ents[last]->size;
+		}
+
+		compress_window(&q);
+
+		for (i = first; i < last; i++) {
+			struct entry *e = q.ents[i];
+
+			if (e->same) {
+				set_data_offset(e, base, e->same->offset);
+				e->offset = e->same->offset;
+			} else {
+				set_data_offset(e, base, offset);
+				e->offset = offset;
+				offset = assemble_file(&q, i, base, offset);
+			}
+		}
+	}
+
+	pthread_mutex_destroy(&q.lock);
+	free(q.ents);
+	free(q.starts);
+	free(q.firsts);
+	free(q.blocks);
+	free(q.out);
+	return offset;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static unsigned int write_file(char *file, char *base, unsigned int offset)
 {
 	int fd;
@@ -730,7 +1065,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(MKFS_EX_USAGE);
 
 	/* command line options */
-	while ((c = getopt(argc, argv, "hb:Ee:i:n:N:psVvz")) != EOF) {
+	while ((c = getopt(argc, argv, "hb:Ee:i:j:n:N:psVvz")) != EOF) {
 		switch (c) {
 		case 'h':
 			usage();
@@ -761,6 +1096,16 @@ int main(int argc, char **argv)
 			image_length = st.st_size; /* may be padded later */
 			fslen_ub += (image_length + 3); /* 3 is for padding */
 			break;
+		case 'j':
+			nthreads = strtou32_or_err(optarg, _("invalid number of threads"));
+			if (!nthreads) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+				nthreads = n > 0 ? n : 1;
+			}
+#ifndef HAVE_LIBPTHREAD
+			nthreads = 1;
+#endif
+			break;
 		case 'n':
 			opt_name = optarg;
 			break;
@@ -808,7 +1153,7 @@ int main(int argc, char **argv)
 	root_entry->size = parse_directory(root_entry, dirname, &root_entry->child, &fslen_ub);
 
 	/* find duplicate files */
-	eliminate_doubles(root_entry,root_entry, &fslen_ub);
+	eliminate_doubles(root_entry, &fslen_ub);
 
 	/* always allocate a multiple of blksize bytes because that's
 	   what we're going to write later on */
@@ -860,7 +1205,12 @@ int main(int argc, char **argv)
 	if (verbose)
 		printf(_("Directory data: %zd bytes\n"), offset);
 
-	offset = write_data(root_entry, rom_image, offset);
+#ifdef HAVE_LIBPTHREAD
+	if (nthreads > 1)
+		offset = write_data_parallel(root_entry, rom_image, offset);
+	else
+#endif
+		offset = write_data(root_entry, rom_image, offset);
 
 	/* We always write a multiple of blksize bytes, so that
 	   losetup works. */
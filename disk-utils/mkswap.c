@@ -29,6 +29,9 @@
 # include <linux/fs.h>
 # include <linux/fiemap.h>
 #endif
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "linux_version.h"
 #include "swapheader.h"
@@ -41,6 +44,7 @@
 #include "c.h"
 #include "closestream.h"
 #include "ismounted.h"
+#include "monotonic.h"
 
 #ifdef HAVE_LIBUUID
 # include <uuid.h>
@@ -52,6 +56,13 @@
 
 #define MIN_GOODPAGES	10
 
+/* --check reads */
+#define CHECK_CHUNK_SIZE	(1024 * 1024)
+#define CHECK_NQUEUES		4
+
+/* extents read by one FIEMAP ioctl */
+#define MAX_FIEMAP_EXTENTS	(64 * 1024)
+
 #define SELINUX_SWAPFILE_TYPE	"swapfile_t"
 
 struct mkswap_control {
@@ -73,6 +84,7 @@ struct mkswap_control {
 	unsigned char		*uuid;		/* UUID parsed by libbuuid */
 
 	size_t			nbad_extents;
+	uint64_t		prealloc_size;	/* --preallocate */
 
 	unsigned int		check:1,	/* --check */
 				verbose:1,      /* --verbose */
@@ -168,6 +180,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -L, --label LABEL         specify label\n"), out);
 	fputs(_(" -v, --swapversion NUM     specify swap-space version number\n"), out);
 	fputs(_(" -U, --uuid UUID           specify the uuid to use\n"), out);
+	fputs(_("     --preallocate SIZE    create swap file of SIZE by fallocate()\n"), out);
 	fputs(_("     --verbose             verbose output\n"), out);
 
 	fprintf(out,
@@ -178,6 +191,14 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
+static int cmp_pages(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a,
+		 y = *(const uint32_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
 static void page_bad(struct mkswap_control *ctl, unsigned int page)
 {
 	const unsigned long max_badpages =
@@ -190,31 +211,142 @@ static void page_bad(struct mkswap_control *ctl, unsigned int page)
 	ctl->nbadpages++;
 }
 
+/*
+ * The device is read by large chunks (by more threads to keep more requests
+ * in the device queue), only the failed chunks are read page by page to
+ * find the bad pages.
+ */
+struct check_queue {
+	struct mkswap_control	*ctl;
+	int			fd;		/* O_DIRECT or the swap fd */
+	size_t			chunk;		/* chunk size in pages */
+	unsigned long long	next;		/* the first unchecked page */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t		lock;		/* protects @next and bad pages */
+#endif
+};
+
+static void check_lock(struct check_queue *q __attribute__((__unused__)))
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&q->lock);
+#endif
+}
+
+static void check_unlock(struct check_queue *q __attribute__((__unused__)))
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&q->lock);
+#endif
+}
+
+static int check_read(struct check_queue *q, char *buf,
+		      unsigned long long page, size_t npages)
+{
+	size_t sz = npages * q->ctl->pagesize;
+	off_t offset = (off_t) page * q->ctl->pagesize;
+	ssize_t rc;
+
+	do {
+		rc = pread(q->fd, buf, sz, offset);
+	} while (rc < 0 && errno == EINTR);
+
+	return rc >= 0 && (size_t) rc == sz ? 0 : -1;
+}
+
+static void *check_worker(void *data)
+{
+	struct check_queue *q = (struct check_queue *) data;
+	struct mkswap_control *ctl = q->ctl;
+	char *buf;
+
+	if (posix_memalign((void **) &buf, getpagesize(),
+			   q->chunk * ctl->pagesize) != 0)
+		err_oom();
+
+	while (1) {
+		unsigned long long page;
+		size_t i, npages;
+
+		check_lock(q);
+		page = q->next;
+		npages = min((unsigned long long) q->chunk, ctl->npages - page);
+		q->next += npages;
+		check_unlock(q);
+
+		if (!npages)
+			break;
+		if (check_read(q, buf, page, npages) == 0)
+			continue;
+
+		/* find the bad pages in the failed chunk */
+		for (i = 0; i < npages; i++) {
+			if (check_read(q, buf, page + i, 1) == 0)
+				continue;
+			check_lock(q);
+			page_bad(ctl, page + i);
+			check_unlock(q);
+		}
+	}
+
+	free(buf);
+	return NULL;
+}
+
 static void check_blocks(struct mkswap_control *ctl)
 {
-	unsigned int current_page = 0;
-	int do_seek = 1;
-	char *buffer;
+	struct check_queue q = { .ctl = ctl, .fd = -1 };
+	struct timeval start, end, delta;
+	size_t nrun = 0;
+	double sec;
+	int sector;
 
 	assert(ctl);
 	assert(ctl->fd > -1);
 
-	buffer = xmalloc(ctl->pagesize);
-	while (current_page < ctl->npages) {
-		ssize_t rc;
-		off_t offset = (off_t) current_page * ctl->pagesize;
+	/* O_DIRECT to avoid page cache, the page size has to be aligned */
+	if (blkdev_get_sector_size(ctl->fd, &sector) == 0 &&
+	    ctl->pagesize % sector == 0)
+		q.fd = open(ctl->devname, O_RDONLY | O_DIRECT | O_CLOEXEC);
+	if (q.fd < 0)
+		q.fd = ctl->fd;
+
+	q.chunk = max(CHECK_CHUNK_SIZE / ctl->pagesize, 1);
+	gettime_monotonic(&start);
+
+#ifdef HAVE_LIBPTHREAD
+	{
+		pthread_t threads[CHECK_NQUEUES];
+		size_t i;
+
+		pthread_mutex_init(&q.lock, NULL);
+		for (nrun = 0; nrun < ARRAY_SIZE(threads); nrun++) {
+			if (pthread_create(&threads[nrun], NULL, check_worker, &q) != 0)
+				break;
+		}
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+		pthread_mutex_destroy(&q.lock);
+	}
+#endif
+	if (!nrun)
+		check_worker(&q);	/* no thread started */
+
+	gettime_monotonic(&end);
+	if (q.fd != ctl->fd)
+		close(q.fd);
 
-		if (do_seek && lseek(ctl->fd, offset, SEEK_SET) != offset)
-			errx(EXIT_FAILURE, _("seek failed in check_blocks"));
+	/* the threads found the bad pages in random order */
+	qsort(ctl->hdr->badpages, ctl->nbadpages, sizeof(uint32_t), cmp_pages);
 
-		rc = read(ctl->fd, buffer, ctl->pagesize);
-		do_seek = (rc < 0 || rc != ctl->pagesize);
-		if (do_seek)
-			page_bad(ctl, current_page);
-		current_page++;
-	}
 	printf(P_("%lu bad page\n", "%lu bad pages\n", ctl->nbadpages), ctl->nbadpages);
-	free(buffer);
+
+	timersub(&end, &start, &delta);
+	sec = delta.tv_sec + delta.tv_usec / 1e6;
+	if (ctl->verbose && sec > 0)
+		printf(_("checked %llu MiB in %.1f seconds (%.1f MiB/s)\n"),
+		       ctl->npages * ctl->pagesize / (1024 * 1024), sec,
+		       ctl->npages * ctl->pagesize / (1024 * 1024) / sec);
 }
 
 
@@ -244,14 +376,42 @@ static void warn_extent(struct mkswap_control *ctl, const char *msg, uint64_t of
 	ctl->nbad_extents++;
 }
 
+/*
+ * Returns a fiemap buffer for all the file extents (up to MAX_FIEMAP_EXTENTS,
+ * the rest is read by more ioctls), so the extents are usually read by one
+ * ioctl call also for large fragmented files.
+ */
+static struct fiemap *alloc_fiemap(struct mkswap_control *ctl, uint32_t *count)
+{
+	struct fiemap *fiemap = xcalloc(1, sizeof(struct fiemap));
+
+	/* fm_extent_count = 0 returns the number of extents only */
+	fiemap->fm_length = ~0ULL;
+	fiemap->fm_flags = FIEMAP_FLAG_SYNC;
+
+	if (ioctl(ctl->fd, FS_IOC_FIEMAP, (unsigned long) fiemap) < 0) {
+		free(fiemap);
+		return NULL;
+	}
+
+	/* one more to see FIEMAP_EXTENT_LAST for a file modified meanwhile */
+	*count = min(fiemap->fm_mapped_extents + 1, (uint32_t) MAX_FIEMAP_EXTENTS);
+	free(fiemap);
+
+	return xcalloc(1, sizeof(struct fiemap)
+			  + *count * sizeof(struct fiemap_extent));
+}
+
 static void check_extents(struct mkswap_control *ctl)
 {
-	char buf[BUFSIZ] = { 0 };
-	struct fiemap *fiemap = (struct fiemap *) buf;
+	struct fiemap *fiemap;
+	uint32_t count = 0;
 	int last = 0;
 	uint64_t last_logical = 0;
 
-	memset(fiemap, 0, sizeof(struct fiemap));
+	fiemap = alloc_fiemap(ctl, &count);
+	if (!fiemap)
+		return;
 
 	do {
 		int rc;
@@ -259,12 +419,11 @@ static void check_extents(struct mkswap_control *ctl)
 
 		fiemap->fm_length = ~0ULL;
 		fiemap->fm_flags = FIEMAP_FLAG_SYNC;
-		fiemap->fm_extent_count =
-			(sizeof(buf) - sizeof(*fiemap)) / sizeof(struct fiemap_extent);
+		fiemap->fm_extent_count = count;
 
 		rc = ioctl(ctl->fd, FS_IOC_FIEMAP, (unsigned long) fiemap);
 		if (rc < 0)
-			return;
+			goto done;
 
 		n = fiemap->fm_mapped_extents;
 		if (n == 0)
@@ -304,9 +463,59 @@ static void check_extents(struct mkswap_control *ctl)
 done:
 	if (ctl->nbad_extents)
 		fputc('\n', stderr);
+	free(fiemap);
 }
+
 #endif /* HAVE_LINUX_FIEMAP_H */
 
+/*
+ * --preallocate: creates (or resizes) the swap file by fallocate(), that's
+ * much faster than writing zeros to the file, and the extents are usually
+ * contiguous.
+ */
+static void preallocate_file(struct mkswap_control *ctl)
+{
+	struct stat st;
+	int fd;
+
+	fd = open(ctl->devname, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot open %s"), ctl->devname);
+	if (fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), ctl->devname);
+	if (!S_ISREG(st.st_mode))
+		errx(EXIT_FAILURE, _("%s: --preallocate is supported for regular files only"),
+				ctl->devname);
+
+#if defined(FS_IOC_GETFLAGS) && defined(FS_NOCOW_FL)
+	/* swap file cannot be copy-on-write (btrfs), it's possible to
+	 * change for an empty file only */
+	if (st.st_size == 0) {
+		int attr = 0;
+
+		if (ioctl(fd, FS_IOC_GETFLAGS, &attr) == 0 && !(attr & FS_NOCOW_FL)) {
+			attr |= FS_NOCOW_FL;
+			ioctl(fd, FS_IOC_SETFLAGS, &attr);
+		}
+	}
+#endif
+	if ((uint64_t) st.st_size > ctl->prealloc_size &&
+	    ftruncate(fd, ctl->prealloc_size) != 0)
+		err(EXIT_FAILURE, _("%s: failed to truncate the file"), ctl->devname);
+
+#ifdef HAVE_FALLOCATE
+	if (fallocate(fd, 0, 0, ctl->prealloc_size) != 0)
+#else
+	errno = posix_fallocate(fd, 0, ctl->prealloc_size);
+	if (errno)
+#endif
+		err(EXIT_FAILURE, _("%s: failed to preallocate %"PRIu64" bytes"),
+				ctl->devname, ctl->prealloc_size);
+
+	if (close(fd) != 0)
+		err(EXIT_FAILURE, _("%s: close failed"), ctl->devname);
+}
+
 /* return size in pages */
 static unsigned long long get_size(const struct mkswap_control *ctl)
 {
@@ -460,7 +669,8 @@ int main(int argc, char **argv)
 #endif
 	enum {
 		OPT_LOCK = CHAR_MAX + 1,
-		OPT_VERBOSE
+		OPT_VERBOSE,
+		OPT_PREALLOCATE
 	};
 	static const struct option longopts[] = {
 		{ "check",       no_argument,       NULL, 'c' },
@@ -473,6 +683,7 @@ int main(int argc, char **argv)
 		{ "help",        no_argument,       NULL, 'h' },
 		{ "lock",        optional_argument, NULL, OPT_LOCK },
 		{ "verbose",    no_argument,        NULL, OPT_VERBOSE },
+		{ "preallocate", required_argument, NULL, OPT_PREALLOCATE },
 		{ NULL,          0, NULL, 0 }
 	};
 
@@ -523,6 +734,10 @@ int main(int argc, char **argv)
 		case OPT_VERBOSE:
 			ctl.verbose = 1;
 			break;
+		case OPT_PREALLOCATE:
+			ctl.prealloc_size = strtosize_or_err(optarg,
+					_("invalid preallocate size argument"));
+			break;
 		case 'h':
 			usage();
 		default:
@@ -554,6 +769,11 @@ int main(int argc, char **argv)
 		warnx(_("error: Nowhere to set up swap on?"));
 		errtryhelp(EXIT_FAILURE);
 	}
+	if (ctl.prealloc_size) {
+		if (block_count)
+			errx(EXIT_FAILURE, _("--preallocate and size argument are mutually exclusive"));
+		preallocate_file(&ctl);
+	}
 	if (block_count) {
 		/* this silly user specified the number of blocks explicitly */
 		uint64_t blks = strtou64_or_err(block_count,
@@ -292,6 +292,57 @@ static int recount_range_by_pt(blkid_partlist ls, int *lower, int *upper)
 	return 0;
 }
 
+static int cmp_kernel_parts(const void *a, const void *b)
+{
+	const struct sysfs_blkdev_part *x = a, *y = b;
+
+	return x->partno - y->partno;
+}
+
+/*
+ * Returns the sorted kernel view of the partitions or NULL if sysfs is not
+ * available. The view is read only once, all the changes are calculated
+ * against it.
+ */
+static struct sysfs_blkdev_part *get_kernel_parts(const char *disk, dev_t devno,
+						  int *nparts)
+{
+	struct sysfs_blkdev_part *parts = NULL;
+	struct path_cxt *pc = NULL;
+	struct stat st;
+	int n = -1;
+
+	if (!devno && disk && !stat(disk, &st))
+		devno = st.st_rdev;
+	if (devno)
+		pc = ul_new_sysfs_path(devno, NULL, NULL);
+	if (pc) {
+		n = sysfs_blkdev_get_partitions(pc, &parts);
+		ul_unref_path(pc);
+	}
+	*nparts = n;
+	return n < 0 ? NULL : parts;
+}
+
+static struct sysfs_blkdev_part *get_kernel_part(struct sysfs_blkdev_part *kparts,
+						 int nkparts, int partno)
+{
+	struct sysfs_blkdev_part key = { .partno = partno };
+
+	if (!kparts || nkparts <= 0)
+		return NULL;
+	return bsearch(&key, kparts, nkparts, sizeof(*kparts), cmp_kernel_parts);
+}
+
+/* the highest partition number known by kernel */
+static int get_kernel_max_partno(const char *disk, dev_t devno,
+				 struct sysfs_blkdev_part *kparts, int nkparts)
+{
+	if (kparts)
+		return nkparts > 0 ? kparts[nkparts - 1].partno : 0;
+	return get_max_partno(disk, devno);
+}
+
 static void del_parts_warnx(const char *device, int first, int last)
 {
 	if (first == last)
@@ -304,16 +355,19 @@ static void del_parts_warnx(const char *device, int first, int last)
 static int del_parts(int fd, const char *device, dev_t devno,
 		     int lower, int upper)
 {
-	int rc = 0, i, errfirst = 0, errlast = 0;
+	int rc = 0, i, errfirst = 0, errlast = 0, nkparts;
+	struct sysfs_blkdev_part *kparts;
 
 	assert(fd >= 0);
 	assert(device);
 
+	kparts = get_kernel_parts(device, devno, &nkparts);
+
 	/* recount range by information in /sys */
 	if (!lower)
 		lower = 1;
 	if (!upper || lower < 0 || upper < 0) {
-		int n = get_max_partno(device, devno);
+		int n = get_kernel_max_partno(device, devno, kparts, nkparts);
 		if (!upper)
 			upper = n;
 		else if (upper < 0)
@@ -324,10 +378,17 @@ static int del_parts(int fd, const char *device, dev_t devno,
 	if (lower > upper) {
 		warnx(_("specified range <%d:%d> "
 			"does not make sense"), lower, upper);
+		free(kparts);
 		return -1;
 	}
 
 	for (i = lower; i <= upper; i++) {
+		/* don't call ioctl for partitions unknown by kernel */
+		if (kparts && !get_kernel_part(kparts, nkparts, i)) {
+			if (verbose)
+				printf(_("%s: partition #%d doesn't exist\n"), device, i);
+			continue;
+		}
 		if (partx_del_partition(fd, i) == 0) {
 			if (verbose)
 				printf(_("%s: partition #%d removed\n"), device, i);
@@ -354,6 +415,7 @@ static int del_parts(int fd, const char *device, dev_t devno,
 
 	if (errfirst)
 		del_parts_warnx(device, errfirst, errlast);
+	free(kparts);
 	return rc;
 }
 
@@ -450,24 +512,94 @@ static void upd_parts_warnx(const char *device, int first, int last)
 				device, first, last);
 }
 
+enum {
+	UPD_NONE = 0,
+	UPD_DEL,		/* removed from the partition table */
+	UPD_RESIZE,		/* the same start */
+	UPD_ADD,		/* unknown by kernel */
+	UPD_READD		/* delete and add (or resize if busy) */
+};
+
+struct upd_part {
+	int		partno;
+	int		action;
+	int		failed;
+	uintmax_t	start;
+	uintmax_t	size;
+};
+
+static void upd_parts_apply(int fd, const char *device, struct upd_part *up, int phase)
+{
+	int err;
+
+	switch (phase) {
+	case UPD_DEL:
+		if (up->action != UPD_DEL && up->action != UPD_READD)
+			return;
+		err = partx_del_partition(fd, up->partno);
+		if (err == -1 && errno == ENXIO && up->action == UPD_READD)
+			err = 0; /* good, it already doesn't exist */
+		if (err == -1 && errno == EBUSY && up->action == UPD_READD) {
+			/* used, try to resize */
+			up->action = UPD_RESIZE;
+			return;
+		}
+		if (err == 0 && up->action == UPD_DEL && verbose)
+			printf(_("%s: partition #%d removed\n"), device, up->partno);
+		break;
+	case UPD_RESIZE:
+		if (up->action != UPD_RESIZE)
+			return;
+		err = partx_resize_partition(fd, up->partno, up->start, up->size);
+		if (err == 0 && verbose)
+			printf(_("%s: partition #%d resized\n"), device, up->partno);
+		break;
+	case UPD_ADD:
+		if (up->action != UPD_ADD && up->action != UPD_READD)
+			return;
+		err = partx_add_partition(fd, up->partno, up->start, up->size);
+		if (err == 0 && verbose)
+			printf(_("%s: partition #%d added\n"), device, up->partno);
+		break;
+	default:
+		return;
+	}
+
+	if (err != 0) {
+		up->failed = 1;
+		up->action = UPD_NONE;
+		if (verbose)
+			warn(_("%s: updating partition #%d failed"), device, up->partno);
+	}
+}
+
+/*
+ * The partition table is compared with the kernel view first and then only
+ * the differences are applied, all deletions before resizes and additions,
+ * so a partition moved to the place of a removed one does not overlap.
+ * Unchanged partitions generate no ioctl and no uevent.
+ */
 static int upd_parts(int fd, const char *device, dev_t devno,
 		     blkid_partlist ls, int lower, int upper)
 {
-	int n, nparts, rc = 0, errfirst = 0, errlast = 0, err;
-	blkid_partition par;
-	uintmax_t start, size;
+	int n, nparts, rc = 0, errfirst = 0, errlast = 0, nkparts, phase;
+	struct sysfs_blkdev_part *kparts;
+	struct upd_part *ups;
+	size_t i, nups = 0;
 
 	assert(fd >= 0);
 	assert(device);
 	assert(ls);
 
+	kparts = get_kernel_parts(device, devno, &nkparts);
+
 	/* recount range by information in /sys, if on disk number of
 	 * partitions is greater than in /sys the use on-disk limit */
 	nparts = blkid_partlist_numof_partitions(ls);
 	if (!lower)
 		lower = 1;
 	if (!upper || lower < 0 || upper < 0) {
-		n = get_max_partno(device, devno);
+		n = get_kernel_max_partno(device, devno, kparts, nkparts);
 		if (!upper)
 			upper = n > nparts ? n : nparts;
 		else if (upper < 0)
@@ -478,49 +610,62 @@ static int upd_parts(int fd, const char *device, dev_t devno,
 	if (lower > upper) {
 		warnx(_("specified range <%d:%d> "
 			"does not make sense"), lower, upper);
+		free(kparts);
 		return -1;
 	}
 
+	ups = xcalloc(upper - lower + 1, sizeof(*ups));
+
 	for (n = lower; n <= upper; n++) {
+		struct sysfs_blkdev_part *kp = get_kernel_part(kparts, nkparts, n);
+		struct upd_part *up = &ups[nups];
+		blkid_partition par;
+
 		par = blkid_partlist_get_partition_by_partno(ls, n);
 		if (!par) {
-			if (verbose)
+			if (kp) {
+				up->partno = n;
+				up->action = UPD_DEL;
+				nups++;
+			} else if (verbose)
 				warn(_("%s: no partition #%d"), device, n);
 			continue;
 		}
 
-		start = blkid_partition_get_start(par);
-		size =  blkid_partition_get_size(par);
+		up->partno = n;
+		up->start = blkid_partition_get_start(par);
+		up->size =  blkid_partition_get_size(par);
 		if (blkid_partition_is_extended(par))
 			/*
 			 * Let's follow the Linux kernel and reduce
 			 * DOS extended partition to 1 or 2 sectors.
 			 */
-			size = min(size, (uintmax_t) 2);
+			up->size = min(up->size, (uintmax_t) 2);
 
-		err = partx_del_partition(fd, n);
-		if (err == -1 && errno == ENXIO)
-			err = 0; /* good, it already doesn't exist */
-		if (err == -1 && errno == EBUSY)
-		{
-			/* try to resize */
-			err = partx_resize_partition(fd, n, start, size);
+		if (kp && kp->start == up->start && kp->size == up->size) {
 			if (verbose)
-				printf(_("%s: partition #%d resized\n"), device, n);
-			if (err == 0)
-				continue;
-		}
-		if (err == 0 && partx_add_partition(fd, n, start, size) == 0) {
-			if (verbose)
-				printf(_("%s: partition #%d added\n"), device, n);
+				printf(_("%s: partition #%d unchanged\n"), device, n);
 			continue;
 		}
+		if (kp && kp->start == up->start)
+			up->action = UPD_RESIZE;
+		else if (kparts && !kp)
+			up->action = UPD_ADD;	/* good, kernel does not know it */
+		else
+			up->action = UPD_READD;
+		nups++;
+	}
 
-		if (err == 0)
+	for (phase = UPD_DEL; phase <= UPD_ADD; phase++) {
+		for (i = 0; i < nups; i++)
+			upd_parts_apply(fd, device, &ups[i], phase);
+	}
+
+	for (i = 0; i < nups; i++) {
+		n = ups[i].partno;
+		if (!ups[i].failed)
 			continue;
 		rc = -1;
-		if (verbose)
-			warn(_("%s: updating partition #%d failed"), device, n);
 		if (!errfirst)
 			errlast = errfirst = n;
 		else if (errlast + 1 == n)
@@ -533,6 +678,8 @@ static int upd_parts(int fd, const char *device, dev_t devno,
 
 	if (errfirst)
 		upd_parts_warnx(device, errfirst, errlast);
+	free(ups);
+	free(kparts);
 	return rc;
 }
 
@@ -765,6 +912,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --show           list partitions\n\n"), out);
 	fputs(_(" -b, --bytes          print SIZE in bytes rather than in human readable format\n"), out);
 	fputs(_(" -g, --noheadings     don't print headings for --show\n"), out);
+	fprintf(out,
+	      _("     --lock[=<mode>]  use exclusive device lock (%s, %s or %s)\n"), "yes", "no", "nonblock");
 	fputs(_(" -n, --nr <n:m>       specify the range of partitions (e.g. --nr 2:4)\n"), out);
 	fputs(_(" -o, --output <list>  define which output columns to use\n"), out);
 	fputs(_("     --output-all     output all columns\n"), out);
@@ -795,12 +944,14 @@ int main(int argc, char **argv)
 	char *device = NULL; /* pointer to argv[], ie: /dev/sda1 */
 	char *wholedisk = NULL; /* allocated, ie: /dev/sda */
 	char *outarg = NULL;
+	const char *lockmode = NULL;
 	dev_t disk_devno = 0, part_devno = 0;
 	unsigned int sector_size = 0;
 
 	enum {
 		OPT_LIST_TYPES = CHAR_MAX + 1,
-		OPT_OUTPUT_ALL
+		OPT_OUTPUT_ALL,
+		OPT_LOCK
 	};
 	static const struct option long_opts[] = {
 		{ "bytes",	no_argument,       NULL, 'b' },
@@ -813,6 +964,7 @@ int main(int argc, char **argv)
 		{ "update",     no_argument,       NULL, 'u' },
 		{ "type",	required_argument, NULL, 't' },
 		{ "list-types", no_argument,       NULL, OPT_LIST_TYPES },
+		{ "lock",	optional_argument, NULL, OPT_LOCK },
 		{ "nr",		required_argument, NULL, 'n' },
 		{ "output",	required_argument, NULL, 'o' },
 		{ "output-all", no_argument,       NULL, OPT_OUTPUT_ALL },
@@ -890,6 +1042,14 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose = 1;
 			break;
+		case OPT_LOCK:
+			lockmode = "1";
+			if (optarg) {
+				if (*optarg == '=')
+					optarg++;
+				lockmode = optarg;
+			}
+			break;
 		case OPT_LIST_TYPES:
 		{
 			size_t idx = 0;
@@ -1020,6 +1180,12 @@ int main(int argc, char **argv)
 	if ((fd = open(wholedisk, O_RDONLY)) == -1)
 		err(EXIT_FAILURE, _("cannot open %s"), wholedisk);
 
+	/* udevd skips events for a locked device, they are processed after
+	 * all the changes */
+	if ((what == ACT_ADD || what == ACT_DELETE || what == ACT_UPD)
+	    && blkdev_lock(fd, wholedisk, lockmode) != 0)
+		return EXIT_FAILURE;
+
 	if (what == ACT_DELETE)
 		rc = del_parts(fd, wholedisk, disk_devno, lower, upper);
 	else {
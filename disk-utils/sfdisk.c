@@ -38,6 +38,9 @@
 #endif
 #include <libgen.h>
 #include <sys/time.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "c.h"
 #include "xalloc.h"
@@ -88,7 +91,8 @@ enum {
 	ACT_PARTLABEL,
 	ACT_PARTATTRS,
 	ACT_DISKID,
-	ACT_DELETE
+	ACT_DELETE,
+	ACT_APPLY_MANY
 };
 
 struct sfdisk {
@@ -102,6 +106,7 @@ struct sfdisk {
 	const char	*backup_file;	/* -O <path> */
 	const char	*move_typescript; /* --movedata <typescript> */
 	char		*prompt;
+	size_t		nthreads;	/* --parallel <num>, 0 for one per device */
 
 	struct fdisk_context	*cxt;		/* libfdisk context */
 	struct fdisk_partition  *orig_pa;	/* -N <partno> before the change */
@@ -119,7 +124,8 @@ struct sfdisk {
 		     movedata: 1,	/* move data after resize */
 		     movefsync: 1,	/* use fsync() after each write() */
 		     notell : 1,	/* don't tell kernel aout new PT */
-		     noact  : 1;	/* do not write to device */
+		     noact  : 1,	/* do not write to device */
+		     verify_write : 1;	/* read back GPT after write */
 };
 
 #define SFDISK_PROMPT	">>> "
@@ -665,7 +671,11 @@ static int write_changes(struct sfdisk *sf)
 			 * related to the write to the device.
 			 */
 			xusleep(250000);
-			fdisk_reread_partition_table(sf->cxt);
+			if (fdisk_device_is_used(sf->cxt))
+				/* don't touch unmodified (maybe mounted) partitions */
+				fdisk_reread_changes(sf->cxt, NULL);
+			else
+				fdisk_reread_partition_table(sf->cxt);
 		}
 	}
 
@@ -676,11 +686,20 @@ static int write_changes(struct sfdisk *sf)
 }
 
 /*
- * sfdisk --list [<device ..]
+ * sfdisk --list [--json] [<device ..]
  */
 static int command_list_partitions(struct sfdisk *sf, int argc, char **argv)
 {
 	int fail = 0;
+
+	if (sf->json) {
+		if (argc)
+			fail = print_devices_pt_json(argv, argc, 1, sf->verify, sf->nthreads);
+		else
+			print_all_devices_pt_json(sf->verify, sf->nthreads);
+		return fail;
+	}
+
 	fdisk_enable_listonly(sf->cxt, 1);
 
 	if (argc) {
@@ -2005,6 +2024,334 @@ static int command_fdisk(struct sfdisk *sf, int argc, char **argv)
 	return rc;
 }
 
+/*
+ * sfdisk --apply-many <script> <device> [<device> ...]
+ *
+ * The script is read only once (with the sector size of the first device),
+ * and every device gets its own context and a copy of the script, so the
+ * copies are applied by worker threads in parallel. The kernel is informed
+ * about the new partitions after all the tables are written.
+ */
+struct apply_device {
+	const char		*devname;
+	struct fdisk_context	*cxt;
+	struct fdisk_script	*dp;
+	int			rc;
+
+	unsigned int		written : 1;	/* on-disk table modified */
+};
+
+struct apply_queue {
+	struct sfdisk		*sf;
+	struct apply_device	*devs;
+	size_t			ndevs;
+	size_t			next;
+	int			action;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t		lock;		/* protects @next */
+#endif
+};
+
+enum {
+	APPLY_WRITE = 0,
+	APPLY_REREAD
+};
+
+/* used for worker threads, the messages are not in order, so add device names */
+static int apply_ask_callback(struct fdisk_context *cxt __attribute__((__unused__)),
+			      struct fdisk_ask *ask,
+			      void *data)
+{
+	struct apply_device *dev = (struct apply_device *) data;
+	int rc = 0;
+
+	assert(ask);
+	assert(dev);
+
+	switch (fdisk_ask_get_type(ask)) {
+	case FDISK_ASKTYPE_INFO:
+		break;
+	case FDISK_ASKTYPE_WARNX:
+		fprintf(stderr, "%s: %s\n", dev->devname,
+				fdisk_ask_print_get_mesg(ask));
+		break;
+	case FDISK_ASKTYPE_WARN:
+		errno = fdisk_ask_print_get_errno(ask);
+		fprintf(stderr, "%s: %s: %m\n", dev->devname,
+				fdisk_ask_print_get_mesg(ask));
+		break;
+	case FDISK_ASKTYPE_YESNO:
+		fdisk_ask_yesno_set_result(ask, 0);
+		break;
+	default:
+		rc = -EINVAL;
+		break;
+	}
+	return rc;
+}
+
+static int apply_open_device(struct sfdisk *sf, struct apply_device *dev)
+{
+	int rc;
+
+	dev->cxt = fdisk_new_context();
+	if (!dev->cxt)
+		err(EXIT_FAILURE, _("failed to allocate libfdisk context"));
+	fdisk_set_ask(dev->cxt, apply_ask_callback, (void *) dev);
+
+	if (sf->wipemode != WIPEMODE_ALWAYS)
+		fdisk_enable_bootbits_protection(dev->cxt, 1);
+	if (sf->verify_write)
+		fdisk_gpt_enable_verify(fdisk_get_label(dev->cxt, "gpt"), 1);
+
+	rc = fdisk_assign_device(dev->cxt, dev->devname, 0);
+	if (rc) {
+		errno = -rc;
+		warn(_("cannot open %s"), dev->devname);
+		return rc;
+	}
+	if (blkdev_lock(fdisk_get_devfd(dev->cxt), dev->devname, sf->lockmode) != 0) {
+		fdisk_deassign_device(dev->cxt, 1);
+		return -EBUSY;
+	}
+
+	if (!sf->noact && !sf->noreread && fdisk_device_is_used(dev->cxt)) {
+		warnx(_("%s: this disk is currently in use"), dev->devname);
+		if (!sf->force) {
+			fdisk_deassign_device(dev->cxt, 1);
+			return -EBUSY;
+		}
+	}
+	if (sf->backup) {
+		struct sfdisk xsf = *sf;
+
+		xsf.cxt = dev->cxt;
+		backup_partition_table(&xsf, dev->devname);
+	}
+	return 0;
+}
+
+static int apply_write(struct sfdisk *sf, struct apply_device *dev)
+{
+	struct sfdisk xsf = *sf;
+	size_t i, nparts;
+	int rc;
+
+	/* non-interactive copy for the helpers */
+	xsf.cxt = dev->cxt;
+	xsf.quiet = 1;
+	xsf.interactive = 0;
+	xsf.prompt = NULL;
+
+	rc = fdisk_apply_script(dev->cxt, dev->dp);
+	if (rc) {
+		errno = -rc;
+		fdisk_warn(dev->cxt, _("failed to apply script"));
+		return rc;
+	}
+	if (fdisk_get_collision(dev->cxt))
+		follow_wipe_mode(&xsf);
+
+	/* all partitions are new, see wipe_partition() in command_fdisk() */
+	nparts = fdisk_get_npartitions(dev->cxt);
+	for (i = 0; rc == 0 && i < nparts; i++) {
+		if (fdisk_is_partition_used(dev->cxt, i))
+			rc = wipe_partition(&xsf, i);
+	}
+
+	if (rc == 0 && !sf->noact) {
+		rc = fdisk_write_disklabel(dev->cxt);
+		if (rc == 0)
+			dev->written = 1;
+	}
+	return rc;
+}
+
+static void apply_queue_item(struct apply_queue *q, struct apply_device *dev)
+{
+	if (dev->rc)
+		return;
+
+	switch (q->action) {
+	case APPLY_WRITE:
+		dev->rc = apply_write(q->sf, dev);
+		break;
+	case APPLY_REREAD:
+		if (dev->written && fdisk_device_is_used(dev->cxt))
+			fdisk_reread_changes(dev->cxt, NULL);
+		else if (dev->written)
+			fdisk_reread_partition_table(dev->cxt);
+		break;
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *apply_worker(void *data)
+{
+	struct apply_queue *q = (struct apply_queue *) data;
+
+	while (1) {
+		size_t idx;
+
+		pthread_mutex_lock(&q->lock);
+		idx = q->next++;
+		pthread_mutex_unlock(&q->lock);
+
+		if (idx >= q->ndevs)
+			break;
+		apply_queue_item(q, &q->devs[idx]);
+	}
+	return NULL;
+}
+#endif
+
+static void apply_queue_run(struct apply_queue *q, int action)
+{
+	size_t i, nrun = 0;
+
+	q->action = action;
+	q->next = 0;
+#ifdef HAVE_LIBPTHREAD
+	{
+		size_t nthreads = q->sf->nthreads ? min(q->sf->nthreads, q->ndevs) : q->ndevs;
+		pthread_t *threads = xcalloc(nthreads, sizeof(pthread_t));
+
+		for (nrun = 0; nthreads > 1 && nrun < nthreads; nrun++) {
+			if (pthread_create(&threads[nrun], NULL, apply_worker, q) != 0)
+				break;
+		}
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+	}
+#endif
+	if (!nrun) {
+		/* no thread started */
+		for (i = 0; i < q->ndevs; i++)
+			apply_queue_item(q, &q->devs[i]);
+	}
+}
+
+static int command_apply_many(struct sfdisk *sf, int argc, char **argv)
+{
+	struct apply_queue q = { .sf = sf };
+	struct fdisk_script *dp = NULL;
+	struct apply_device *first = NULL;
+	const char *filename;
+	size_t i, nwritten = 0, nfailed = 0, nlisted = 0;
+	FILE *f;
+	int rc;
+
+	if (argc < 1)
+		errx(EXIT_FAILURE, _("no script file specified"));
+	if (argc < 2)
+		errx(EXIT_FAILURE, _("no disk device specified"));
+	if (sf->partno >= 0 || sf->append || sf->label_nested)
+		errx(EXIT_FAILURE, _("--apply-many cannot be used with --partno, --append or --label-nested"));
+
+	filename = argv[0];
+	q.ndevs = argc - 1;
+	q.devs = xcalloc(q.ndevs, sizeof(struct apply_device));
+
+	for (i = 0; i < q.ndevs; i++) {
+		struct apply_device *dev = &q.devs[i];
+
+		dev->devname = argv[i + 1];
+		dev->rc = apply_open_device(sf, dev);
+		if (!dev->rc && !first)
+			first = dev;
+	}
+	if (!first)
+		errx(EXIT_FAILURE, _("no usable disk device"));
+
+	/* read the script only once, sizes in bytes depend on the first device */
+	f = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r" UL_CLOEXECSTR);
+	if (!f)
+		err(EXIT_FAILURE, _("cannot open %s"), filename);
+
+	dp = fdisk_new_script(first->cxt);
+	if (!dp)
+		err(EXIT_FAILURE, _("failed to allocate script handler"));
+	rc = fdisk_script_read_file(dp, f);
+	if (f != stdin)
+		fclose(f);
+	if (rc) {
+		errno = -rc;
+		err(EXIT_FAILURE, _("%s: failed to parse script"), filename);
+	}
+	if (sf->label)
+		fdisk_script_set_header(dp, "label", sf->label);
+	else if (!fdisk_script_get_header(dp, "label"))
+		fdisk_script_set_header(dp, "label", "dos");	/* see command_fdisk() */
+
+	for (i = 0; i < q.ndevs; i++) {
+		struct apply_device *dev = &q.devs[i];
+
+		if (dev->rc)
+			continue;
+		if (fdisk_get_sector_size(dev->cxt) != fdisk_get_sector_size(first->cxt)) {
+			warnx(_("%s: sector size differs from %s"),
+					dev->devname, first->devname);
+			dev->rc = -EINVAL;
+			continue;
+		}
+		dev->dp = fdisk_copy_script(dev->cxt, dp);
+		if (!dev->dp)
+			err(EXIT_FAILURE, _("failed to allocate script handler"));
+	}
+	fdisk_unref_script(dp);
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&q.lock, NULL);
+#endif
+	apply_queue_run(&q, APPLY_WRITE);
+
+	for (i = 0; i < q.ndevs; i++)
+		nwritten += q.devs[i].written;
+
+	if (nwritten && !sf->notell) {
+		/* one delay for all devices, see write_changes() */
+		xusleep(250000);
+		apply_queue_run(&q, APPLY_REREAD);
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_destroy(&q.lock);
+#endif
+
+	for (i = 0; i < q.ndevs; i++) {
+		struct apply_device *dev = &q.devs[i];
+
+		if (dev->rc)
+			nfailed++;
+		else if (!sf->quiet) {
+			fdisk_set_ask(dev->cxt, ask_callback, (void *) sf);
+			if (nlisted++)
+				fputs("\n\n", stdout);
+			list_disk_geometry(dev->cxt);
+			list_disklabel(dev->cxt);
+			if (sf->noact)
+				fdisk_info(dev->cxt, _("The partition table is unchanged (--no-act)."));
+			else
+				fdisk_info(dev->cxt, _("\nThe partition table has been altered."));
+		}
+
+		if (fdisk_get_devfd(dev->cxt) >= 0)
+			fdisk_deassign_device(dev->cxt, 1);
+		fdisk_unref_script(dev->dp);
+		fdisk_unref_context(dev->cxt);
+	}
+	if (nwritten && !sf->notell) {
+		if (!sf->quiet)
+			fputs(_("Syncing disks.\n"), stdout);
+		sync();
+	}
+	free(q.devs);
+
+	if (nfailed)
+		warnx(_("failed to apply script to %zu of %zu devices"), nfailed, q.ndevs);
+	return nfailed ? -EINVAL : 0;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -2023,12 +2370,15 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -J, --json <dev>                  dump partition table in JSON format\n"), out);
 	fputs(_(" -g, --show-geometry [<dev> ...]   list geometry of all or specified devices\n"), out);
 	fputs(_(" -l, --list [<dev> ...]            list partitions of each device\n"), out);
+	fputs(_(" -l, --list --json [<dev> ...]     list partitions in JSON format, probe in parallel\n"), out);
 	fputs(_(" -F, --list-free [<dev> ...]       list unpartitioned free areas of each device\n"), out);
 	fputs(_(" -r, --reorder <dev>               fix partitions order (by start offset)\n"), out);
 	fputs(_(" -s, --show-size [<dev> ...]       list sizes of all or specified devices\n"), out);
 	fputs(_(" -T, --list-types                  print the recognized types (see -X)\n"), out);
 	fputs(_(" -V, --verify [<dev> ...]          test whether partitions seem correct\n"), out);
 	fputs(_("     --delete <dev> [<part> ...]   delete all or specified partitions\n"), out);
+	fputs(_("     --apply-many <script> <dev> [<dev> ...]\n"
+		"                                   apply script to all devices in parallel\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_(" --part-label <dev> <part> [<str>] print or change partition label\n"), out);
@@ -2051,6 +2401,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --bytes               print SIZE in bytes rather than in human readable format\n"), out);
 	fputs(_("     --move-data[=<typescript>] move partition data after relocation (requires -N)\n"), out);
 	fputs(_("     --move-use-fsync      use fsync after each write when move data\n"), out);
+	fputs(_("     --verify-write        read back and compare the written GPT\n"), out);
 	fputs(_(" -f, --force               disable all consistency checking\n"), out);
 
 	fprintf(out,
@@ -2065,6 +2416,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --no-tell-kernel      do not tell kernel about changes\n"), out);
 	fputs(_(" -O, --backup-file <path>  override default backup file name\n"), out);
 	fputs(_(" -o, --output <list>       output columns\n"), out);
+	fputs(_("     --parallel <num>      number of threads for --apply-many and --list --json\n"), out);
 	fputs(_(" -q, --quiet               suppress extra info messages\n"), out);
 	fprintf(out,
 	      _(" -w, --wipe <mode>         wipe signatures (%s, %s or %s)\n"), "auto", "always", "never");
@@ -2118,11 +2470,15 @@ int main(int argc, char *argv[])
 		OPT_NOTELL,
 		OPT_RELOCATE,
 		OPT_LOCK,
+		OPT_VERIFYWRITE,
+		OPT_APPLYMANY,
+		OPT_PARALLEL,
 	};
 
 	static const struct option longopts[] = {
 		{ "activate",no_argument,	NULL, 'A' },
 		{ "append",  no_argument,       NULL, 'a' },
+		{ "apply-many", no_argument,    NULL, OPT_APPLYMANY },
 		{ "backup",  no_argument,       NULL, 'b' },
 		{ "backup-file", required_argument, NULL, 'O' },
 		{ "bytes",   no_argument,	NULL, OPT_BYTES },
@@ -2144,11 +2500,13 @@ int main(int argc, char *argv[])
 		{ "move-data", optional_argument, NULL, OPT_MOVEDATA },
 		{ "move-use-fsync", no_argument, NULL, OPT_MOVEFSYNC },
 		{ "output",  required_argument, NULL, 'o' },
+		{ "parallel", required_argument, NULL, OPT_PARALLEL },
 		{ "partno",  required_argument, NULL, 'N' },
 		{ "reorder", no_argument,       NULL, 'r' },
 		{ "show-geometry", no_argument, NULL, 'g' },
 		{ "quiet",   no_argument,       NULL, 'q' },
 		{ "verify",  no_argument,       NULL, 'V' },
+		{ "verify-write", no_argument,  NULL, OPT_VERIFYWRITE },
 		{ "version", no_argument,       NULL, 'v' },
 		{ "wipe",    required_argument, NULL, 'w' },
 		{ "wipe-partitions",    required_argument, NULL, 'W' },
@@ -2215,6 +2573,8 @@ int main(int argc, char *argv[])
 			break;
 		case 'J':
 			sf->json = 1;
+			if (sf->act == ACT_LIST)	/* --list --json */
+				break;
 			/* fallthrough */
 		case 'd':
 			sf->act = ACT_DUMP;
@@ -2325,9 +2685,18 @@ int main(int argc, char *argv[])
 		case OPT_MOVEFSYNC:
 			sf->movefsync = 1;
 			break;
+		case OPT_VERIFYWRITE:
+			sf->verify_write = 1;
+			break;
 		case OPT_DELETE:
 			sf->act = ACT_DELETE;
 			break;
+		case OPT_APPLYMANY:
+			sf->act = ACT_APPLY_MANY;
+			break;
+		case OPT_PARALLEL:
+			sf->nthreads = strtou32_or_err(optarg, _("invalid number of threads argument"));
+			break;
 		case OPT_NOTELL:
 			sf->notell = 1;
 			break;
@@ -2352,6 +2721,8 @@ int main(int argc, char *argv[])
 	sfdisk_init(sf);
 	if (bytes)
 		fdisk_set_size_unit(sf->cxt, FDISK_SIZEUNIT_BYTES);
+	if (sf->verify_write)
+		fdisk_gpt_enable_verify(fdisk_get_label(sf->cxt, "gpt"), 1);
 
 	if (outarg)
 		init_fields(NULL, outarg, NULL);
@@ -2389,6 +2760,10 @@ int main(int argc, char *argv[])
 		rc = command_fdisk(sf, argc - optind, argv + optind);
 		break;
 
+	case ACT_APPLY_MANY:
+		rc = command_apply_many(sf, argc - optind, argv + optind);
+		break;
+
 	case ACT_DUMP:
 		rc = command_dump(sf, argc - optind, argv + optind);
 		break;
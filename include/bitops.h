@@ -146,5 +146,14 @@
 # define isclr(a,i)	(((a)[(i)/NBBY] & (1<<((i)%NBBY))) == 0)
 #endif
 
+/*
+ * Word-at-a-time tests, true if any byte in the 64-bit word @x is ...
+ */
+#define WORD_ONES		((uint64_t) 0x0101010101010101ULL)
+#define WORD_HIGHS		((uint64_t) 0x8080808080808080ULL)
+#define word_hasless(x, n)	(((x) - WORD_ONES * (n)) & ~(x) & WORD_HIGHS)	/* < n, n <= 128 */
+#define word_hasmore(x, n)	((((x) + WORD_ONES * (127 - (n))) | (x)) & WORD_HIGHS) /* > n, n <= 127 */
+#define word_hasbyte(x, c)	word_hasless((x) ^ (WORD_ONES * (c)), 1)
+
 #endif /* BITOPS_H */
 
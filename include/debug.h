@@ -39,6 +39,7 @@
 
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 
 struct ul_debug_maskname {
 	const char *name;
@@ -178,4 +179,100 @@ static inline void ul_debug_print_masks(
 	}
 }
 
+/*
+ * util-linux statistics counters
+ *
+ * Every library has an array of counters <name>_stats[] indexed by
+ * <PREFIX>_STAT_<NAME> and an array of the counters names. The counters are
+ * disabled by default, enabled by the library API or by <NAME>_STATS=1 env.
+ * variable; in this case the counters are printed to stderr at exit.
+ *
+ * In the code is possible to use
+ *
+ *	STAT_ADD(FOO, 1);
+ *	STAT_TIME(FOO_NS, rc = foo());
+ *
+ * The counters are updated atomically, but the values are not consistent
+ * between each other when read from another thread.
+ */
+struct ul_stats_name {
+	const char *name;
+	const char *help;
+};
+#define UL_DEBUG_DEFINE_STATNAMES(m) static const struct ul_stats_name m ## _statnames[]
+#define UL_DEBUG_STATNAMES(m)	m ## _statnames
+
+#define UL_DEBUG_STATS(m)		m ## _stats
+#define UL_DEBUG_STATS_ENABLED(m)	m ## _stats_enabled
+#define UL_DEBUG_DEFINE_STATS(m, n) \
+	int UL_DEBUG_STATS_ENABLED(m); \
+	unsigned long long UL_DEBUG_STATS(m)[n]
+#define UL_DEBUG_DECLARE_STATS(m, n) \
+	extern int UL_DEBUG_STATS_ENABLED(m); \
+	extern unsigned long long UL_DEBUG_STATS(m)[n]
+
+/* l - library name, p - counter prefix, c - counter postfix, n - value */
+#define __UL_STAT_ADD(l, p, c, n) \
+	do { \
+		if (l ## _stats_enabled) \
+			__atomic_add_fetch(&l ## _stats[p ## c], (n), __ATOMIC_RELAXED); \
+	} while (0)
+
+/* adds time (in nanoseconds) spent in @x to the counter */
+#define __UL_STAT_TIME(l, p, c, x) \
+	do { \
+		if (l ## _stats_enabled) { \
+			struct timespec __ul_a, __ul_b; \
+			clock_gettime(CLOCK_MONOTONIC, &__ul_a); \
+			x; \
+			clock_gettime(CLOCK_MONOTONIC, &__ul_b); \
+			__atomic_add_fetch(&l ## _stats[p ## c], \
+				(__ul_b.tv_sec - __ul_a.tv_sec) * 1000000000ULL \
+				+ __ul_b.tv_nsec - __ul_a.tv_nsec, __ATOMIC_RELAXED); \
+		} else { \
+			x; \
+		} \
+	} while (0)
+
+/* @dump is called at exit if the env. variable is set */
+#define __UL_INIT_STATS_FROM_ENV(lib, env, dump) \
+	do { \
+		const char *envstr = getenv(# env); \
+		if (envstr && *envstr && strcmp(envstr, "0") != 0 && \
+		    !lib ## _stats_enabled) { \
+			lib ## _stats_enabled = 1; \
+			atexit(dump); \
+		} \
+	} while (0)
+
+static inline int ul_debug_get_stat(
+			const struct ul_stats_name statnames[],
+			const unsigned long long stats[],
+			size_t nstats, size_t idx,
+			const char **name, unsigned long long *value)
+{
+	if (idx >= nstats)
+		return 1;
+	if (name)
+		*name = statnames[idx].name;
+	if (value)
+		*value = __atomic_load_n(&stats[idx], __ATOMIC_RELAXED);
+	return 0;
+}
+
+static inline void ul_debug_print_stats(
+			const char *lib,
+			const struct ul_stats_name statnames[],
+			const unsigned long long stats[],
+			size_t nstats)
+{
+	size_t i;
+
+	for (i = 0; i < nstats; i++)
+		fprintf(stderr, "%d: %s: stats: %-16s %12llu  (%s)\n",
+				getpid(), lib, statnames[i].name,
+				__atomic_load_n(&stats[i], __ATOMIC_RELAXED),
+				statnames[i].help);
+}
+
 #endif /* UTIL_LINUX_DEBUG_H */
@@ -9,12 +9,19 @@
 struct identry {
 	unsigned long int	id;
 	char			*name;
-	struct identry		*next;
+	struct identry		*next;	/* next in the hash bucket */
+
+	unsigned int		prefetched : 1;	/* not added by add_{uid,gid}() yet */
 };
 
 struct idcache {
-	struct identry	*ent;	/* first entry */
-	int		width;	/* name width */
+	struct identry	**ents;		/* hash table */
+	size_t		nbuckets;	/* power of 2 */
+	size_t		nents;
+	size_t		nmisses;	/* number of get{pw,gr}{uid,gid}() calls */
+	int		width;		/* name width */
+
+	unsigned int	prefetched : 1;	/* whole database read */
 };
 
 
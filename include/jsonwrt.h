@@ -11,10 +11,12 @@ struct ul_jsonwrt {
 	FILE *out;
 	int indent;
 
-	unsigned int after_close :1;
+	unsigned int after_close :1,
+		     compact :1;	/* one line, no whitespace */
 };
 
 void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent);
+void ul_jsonwrt_enable_compact(struct ul_jsonwrt *fmt, int enable);
 void ul_jsonwrt_indent(struct ul_jsonwrt *fmt);
 void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type);
 void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type);
@@ -36,6 +38,8 @@ void ul_jsonwrt_value_raw(struct ul_jsonwrt *fmt,
 			const char *name, const char *data);
 void ul_jsonwrt_value_s(struct ul_jsonwrt *fmt,
 			const char *name, const char *data);
+void ul_jsonwrt_value_s_sized(struct ul_jsonwrt *fmt,
+			const char *name, const char *data, size_t size);
 void ul_jsonwrt_value_u64(struct ul_jsonwrt *fmt,
 			const char *name, uint64_t data);
 void ul_jsonwrt_value_boolean(struct ul_jsonwrt *fmt,
@@ -101,6 +101,11 @@ enum {
 	LOOPITER_FL_USED	= (1 << 1)
 };
 
+/*
+ * snapshot of the used loop devices, see loopcxt_find_overlap()
+ */
+struct loopdev_index_entry;
+
 /*
  * handler for work with loop devices
  */
@@ -109,6 +114,7 @@ struct loopdev_cxt {
 	char		*filename;	/* backing file for loopcxt_set_... */
 	int		fd;		/* open(/dev/looo<N>) */
 	int		mode;		/* fd mode O_{RDONLY,RDWR} */
+	int		ctl_fd;		/* open /dev/loop-control or -1 */
 	uint64_t	blocksize;	/* used by loopcxt_setup_device() */
 
 	int		flags;		/* LOOPDEV_FL_* flags */
@@ -120,9 +126,14 @@ struct loopdev_cxt {
 	struct path_cxt		*sysfs; /* pointer to /sys/dev/block/<maj:min>/ */
 	struct loop_config 	config;	/* for GET/SET ioctl */
 	struct loopdev_iter	iter;	/* scans /sys or /dev for used/free devices */
+
+	struct loopdev_index_entry *index;	/* used devices, sorted by backing inode */
+	size_t			nindex;		/* number of index entries */
+	size_t			nindex_st;	/* entries with devno and inode */
+	unsigned int		has_index:1;	/* index is ready */
 };
 
-#define UL_LOOPDEVCXT_EMPTY { .fd = -1  }
+#define UL_LOOPDEVCXT_EMPTY { .fd = -1, .ctl_fd = -1 }
 
 /*
  * loopdev_cxt.flags
@@ -153,6 +164,7 @@ extern int loopdev_is_used(const char *device, const char *filename,
 extern char *loopdev_find_by_backing_file(const char *filename,
 				uint64_t offset, uint64_t sizelimit, int flags);
 extern int loopcxt_find_unused(struct loopdev_cxt *lc);
+extern int loopcxt_open_control(struct loopdev_cxt *lc);
 extern int loopdev_delete(const char *device);
 extern int loopdev_count_by_backing_file(const char *filename, char **loopdev);
 
@@ -191,6 +203,7 @@ int loopcxt_set_sizelimit(struct loopdev_cxt *lc, uint64_t sizelimit);
 int loopcxt_set_blocksize(struct loopdev_cxt *lc, uint64_t blocksize);
 int loopcxt_set_flags(struct loopdev_cxt *lc, uint32_t flags);
 int loopcxt_set_backing_file(struct loopdev_cxt *lc, const char *filename);
+int loopcxt_autotune(struct loopdev_cxt *lc);
 
 extern char *loopcxt_get_backing_file(struct loopdev_cxt *lc);
 extern int loopcxt_get_backing_devno(struct loopdev_cxt *lc, dev_t *devno);
@@ -211,6 +224,7 @@ extern int loopcxt_find_by_backing_file(struct loopdev_cxt *lc,
 extern int loopcxt_find_overlap(struct loopdev_cxt *lc,
 				const char *filename,
 				uint64_t offset, uint64_t sizelimit);
+extern void loopcxt_reset_index(struct loopdev_cxt *lc);
 
 extern int loopcxt_is_used(struct loopdev_cxt *lc,
                     struct stat *st,
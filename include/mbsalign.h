@@ -50,6 +50,8 @@ extern size_t mbsalign_with_padding (const char *src, char *dest, size_t dest_si
 	               size_t *width, mbs_align_t align, int flags,
 		       int padchar);
 
+extern size_t mbs_printable_ascii_span(const char *s, size_t len);
+
 extern size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz);
 extern size_t mbs_safe_width(const char *s);
 
@@ -0,0 +1,191 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * listmount(2) and statmount(2) since Linux 6.8; the structs and constants
+ * are defined here, because the libc and kernel headers are usually older.
+ */
+#ifndef UTIL_LINUX_MOUNT_API_UTILS
+#define UTIL_LINUX_MOUNT_API_UTILS
+
+#if defined(__linux__)
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef __NR_statmount
+# if defined __alpha__
+#  define __NR_statmount	567
+# elif defined _MIPS_SIM
+#  if _MIPS_SIM == _MIPS_SIM_ABI32	/* o32 */
+#   define __NR_statmount	(457 + 4000)
+#  elif _MIPS_SIM == _MIPS_SIM_NABI32	/* n32 */
+#   define __NR_statmount	(457 + 6000)
+#  elif _MIPS_SIM == _MIPS_SIM_ABI64	/* n64 */
+#   define __NR_statmount	(457 + 5000)
+#  endif
+# else
+#  define __NR_statmount	457
+# endif
+#endif
+
+#ifndef __NR_listmount
+# if defined __alpha__
+#  define __NR_listmount	568
+# elif defined _MIPS_SIM
+#  if _MIPS_SIM == _MIPS_SIM_ABI32	/* o32 */
+#   define __NR_listmount	(458 + 4000)
+#  elif _MIPS_SIM == _MIPS_SIM_NABI32	/* n32 */
+#   define __NR_listmount	(458 + 6000)
+#  elif _MIPS_SIM == _MIPS_SIM_ABI64	/* n64 */
+#   define __NR_listmount	(458 + 5000)
+#  endif
+# else
+#  define __NR_listmount	458
+# endif
+#endif
+
+#if defined(__NR_statmount) && defined(__NR_listmount)
+# define HAVE_STATMOUNT_API 1
+
+/* request for statmount() and listmount() */
+struct ul_mnt_id_req {
+	uint32_t size;
+	uint32_t spare;
+	uint64_t mnt_id;
+	uint64_t param;
+};
+
+#define UL_MNT_ID_REQ_SIZE_VER0	24
+
+/* statmount() result, the [str] fields are offsets to str[] */
+struct ul_statmount {
+	uint32_t size;			/* total size, including strings */
+	uint32_t mnt_opts;		/* [str] fs options (since 6.10) */
+	uint64_t mask;			/* what results were written */
+	uint32_t sb_dev_major;
+	uint32_t sb_dev_minor;
+	uint64_t sb_magic;
+	uint32_t sb_flags;		/* SB_{RDONLY,SYNCHRONOUS,DIRSYNC,LAZYTIME} */
+	uint32_t fs_type;		/* [str] */
+	uint64_t mnt_id;		/* unique ID */
+	uint64_t mnt_parent_id;
+	uint32_t mnt_id_old;		/* ID used in /proc/self/mountinfo */
+	uint32_t mnt_parent_id_old;
+	uint64_t mnt_attr;		/* MOUNT_ATTR_* */
+	uint64_t mnt_propagation;	/* MS_{SHARED,SLAVE,PRIVATE,UNBINDABLE} */
+	uint64_t mnt_peer_group;
+	uint64_t mnt_master;
+	uint64_t propagate_from;
+	uint32_t mnt_root;		/* [str] */
+	uint32_t mnt_point;		/* [str] */
+	uint64_t mnt_ns_id;		/* since 6.11 */
+	uint32_t fs_subtype;		/* [str] since 6.13 */
+	uint32_t sb_source;		/* [str] since 6.13 */
+	uint32_t opt_num;
+	uint32_t opt_array;		/* [str] */
+	uint32_t opt_sec_num;
+	uint32_t opt_sec_array;		/* [str] NUL separated security options */
+	uint64_t __spare2[46];
+	char str[];
+};
+
+#ifndef STATMOUNT_SB_BASIC
+# define STATMOUNT_SB_BASIC		0x00000001U
+#endif
+#ifndef STATMOUNT_MNT_BASIC
+# define STATMOUNT_MNT_BASIC		0x00000002U
+#endif
+#ifndef STATMOUNT_PROPAGATE_FROM
+# define STATMOUNT_PROPAGATE_FROM	0x00000004U
+#endif
+#ifndef STATMOUNT_MNT_ROOT
+# define STATMOUNT_MNT_ROOT		0x00000008U
+#endif
+#ifndef STATMOUNT_MNT_POINT
+# define STATMOUNT_MNT_POINT		0x00000010U
+#endif
+#ifndef STATMOUNT_FS_TYPE
+# define STATMOUNT_FS_TYPE		0x00000020U
+#endif
+#ifndef STATMOUNT_MNT_OPTS
+# define STATMOUNT_MNT_OPTS		0x00000080U
+#endif
+#ifndef STATMOUNT_FS_SUBTYPE
+# define STATMOUNT_FS_SUBTYPE		0x00000100U
+#endif
+#ifndef STATMOUNT_SB_SOURCE
+# define STATMOUNT_SB_SOURCE		0x00000200U
+#endif
+#ifndef STATMOUNT_OPT_SEC_ARRAY
+# define STATMOUNT_OPT_SEC_ARRAY	0x00000800U
+#endif
+
+#ifndef LSMT_ROOT
+# define LSMT_ROOT		0xffffffffffffffffULL	/* root mount */
+#endif
+
+#ifndef MOUNT_ATTR_RDONLY
+# define MOUNT_ATTR_RDONLY	0x00000001
+#endif
+#ifndef MOUNT_ATTR_NOSUID
+# define MOUNT_ATTR_NOSUID	0x00000002
+#endif
+#ifndef MOUNT_ATTR_NODEV
+# define MOUNT_ATTR_NODEV	0x00000004
+#endif
+#ifndef MOUNT_ATTR_NOEXEC
+# define MOUNT_ATTR_NOEXEC	0x00000008
+#endif
+#ifndef MOUNT_ATTR__ATIME
+# define MOUNT_ATTR__ATIME	0x00000070
+#endif
+#ifndef MOUNT_ATTR_RELATIME
+# define MOUNT_ATTR_RELATIME	0x00000000
+#endif
+#ifndef MOUNT_ATTR_NOATIME
+# define MOUNT_ATTR_NOATIME	0x00000010
+#endif
+#ifndef MOUNT_ATTR_NODIRATIME
+# define MOUNT_ATTR_NODIRATIME	0x00000080
+#endif
+#ifndef MOUNT_ATTR_IDMAP
+# define MOUNT_ATTR_IDMAP	0x00100000
+#endif
+#ifndef MOUNT_ATTR_NOSYMFOLLOW
+# define MOUNT_ATTR_NOSYMFOLLOW	0x00200000
+#endif
+
+static inline int ul_statmount(uint64_t mnt_id, uint64_t mask,
+			       struct ul_statmount *buf, size_t bufsize,
+			       unsigned int flags)
+{
+	struct ul_mnt_id_req req = {
+		.size = UL_MNT_ID_REQ_SIZE_VER0,
+		.mnt_id = mnt_id,
+		.param = mask
+	};
+
+	return syscall(__NR_statmount, &req, buf, bufsize, flags);
+}
+
+/*
+ * Returns IDs of the mounts below @mnt_id, the list continues after @last_id
+ * (or from the beginning if @last_id is zero).
+ */
+static inline ssize_t ul_listmount(uint64_t mnt_id, uint64_t last_id,
+				   uint64_t list[], size_t num,
+				   unsigned int flags)
+{
+	struct ul_mnt_id_req req = {
+		.size = UL_MNT_ID_REQ_SIZE_VER0,
+		.mnt_id = mnt_id,
+		.param = last_id
+	};
+
+	return syscall(__NR_listmount, &req, list, num, flags);
+}
+
+#endif /* __NR_statmount && __NR_listmount */
+#endif /* __linux__ */
+#endif /* UTIL_LINUX_MOUNT_API_UTILS */
@@ -9,10 +9,22 @@
 
 #include "c.h"
 
+/* cached subdirectory, see ul_path_enable_subdirs() */
+struct ul_path_subdir {
+	char	*name;
+	int	fd;		/* -1 if the directory does not exist */
+};
+
+#define UL_PATH_NSUBDIRS	8
+
 struct path_cxt {
 	int	dir_fd;
 	char	*dir_path;
 
+	struct ul_path_subdir subdirs[UL_PATH_NSUBDIRS];
+	size_t	nsubdirs;	/* number of used subdirs[] */
+	size_t	subdirs_next;	/* the next subdirs[] entry to reuse */
+
 	int	refcount;
 
 	char *prefix;
@@ -21,6 +33,8 @@ struct path_cxt {
 	void	*dialect;
 	void	(*free_dialect)(struct path_cxt *);
 	int	(*redirect_on_enoent)(struct path_cxt *, const char *, int *);
+
+	unsigned int	cache_subdirs : 1;
 };
 
 struct path_cxt *ul_new_path(const char *dir, ...)
@@ -43,6 +57,7 @@ int ul_path_set_enoent_redirect(struct path_cxt *pc, int (*func)(struct path_cxt
 int ul_path_get_dirfd(struct path_cxt *pc);
 void ul_path_close_dirfd(struct path_cxt *pc);
 int ul_path_isopen_dirfd(struct path_cxt *pc);
+void ul_path_enable_subdirs(struct path_cxt *pc, int enable);
 int ul_path_is_accessible(struct path_cxt *pc);
 
 char *ul_path_get_abspath(struct path_cxt *pc, char *buf, size_t bufsz, const char *path, ...)
@@ -85,6 +100,8 @@ int ul_path_read_string(struct path_cxt *pc, char **str, const char *path);
 int ul_path_readf_string(struct path_cxt *pc, char **str, const char *path, ...)
 				__attribute__ ((__format__ (__printf__, 3, 4)));
 
+int ul_path_read_strings(struct path_cxt *pc, const char * const *paths, char **res, size_t n);
+
 int ul_path_read_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const char *path);
 int ul_path_readf_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const char *path, ...)
 				__attribute__ ((__format__ (__printf__, 4, 5)));
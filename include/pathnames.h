@@ -84,6 +84,9 @@
 
 #define _PATH_SD_UNITSLOAD	_PATH_RUNSTATEDIR "/systemd/systemd-units-load"
 
+#define _PATH_FSTRIM_STATEDIR	"/var/lib/fstrim"
+#define _PATH_FSTRIM_STATE	_PATH_FSTRIM_STATEDIR "/state"
+
 /* misc paths */
 #define _PATH_WORDS             "/usr/share/dict/words"
 #define _PATH_WORDS_ALT         "/usr/share/dict/web2"
@@ -115,9 +118,11 @@
 #define _PATH_SYS_DEVCHAR	"/sys/dev/char"
 #define _PATH_SYS_CLASS		"/sys/class"
 #define _PATH_SYS_SCSI		"/sys/bus/scsi"
+#define _PATH_SYS_UEVENT_SEQNUM	"/sys/kernel/uevent_seqnum"
 
 #define _PATH_SYS_SELINUX	"/sys/fs/selinux"
 #define _PATH_SYS_APPARMOR	"/sys/kernel/security/apparmor"
+#define _PATH_SYS_CGROUP	"/sys/fs/cgroup"
 
 #ifndef _PATH_MOUNTED
 # ifdef MOUNTED					/* deprecated */
@@ -156,6 +161,8 @@
 #define _PATH_DEV_BYPATH	"/dev/disk/by-path"
 #define _PATH_DEV_BYPARTLABEL	"/dev/disk/by-partlabel"
 #define _PATH_DEV_BYPARTUUID	"/dev/disk/by-partuuid"
+#define _PATH_UDEV_CONTROL	"/run/udev/control"
+#define _PATH_UDEV_DATA		"/run/udev/data"
 
 /* hwclock paths */
 #ifdef CONFIG_ADJTIME_PATH
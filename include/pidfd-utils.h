@@ -5,8 +5,15 @@
 # include <sys/syscall.h>
 # if defined(SYS_pidfd_send_signal) && defined(SYS_pidfd_open)
 #  include <sys/types.h>
+#  ifdef HAVE_SYS_PIDFD_H
+#   include <sys/pidfd.h>
+#  endif
 
-#  ifndef HAVE_PIDFD_SEND_SIGNAL
+/*
+ * The libc may provide the functions without the header (glibc < 2.36),
+ * use the wrappers also in this case to have the prototypes.
+ */
+#  if !defined(HAVE_PIDFD_SEND_SIGNAL) || !defined(HAVE_SYS_PIDFD_H)
 static inline int pidfd_send_signal(int pidfd, int sig, siginfo_t *info,
 				    unsigned int flags)
 {
@@ -14,7 +21,7 @@ static inline int pidfd_send_signal(int pidfd, int sig, siginfo_t *info,
 }
 #  endif
 
-#  ifndef HAVE_PIDFD_OPEN
+#  if !defined(HAVE_PIDFD_OPEN) || !defined(HAVE_SYS_PIDFD_H)
 static inline int pidfd_open(pid_t pid, unsigned int flags)
 {
 	return syscall(SYS_pidfd_open, pid, flags);
@@ -34,4 +34,42 @@ extern char *proc_get_command_name(pid_t pid);
 
 extern int proc_is_procfs(int fd);
 
+/*
+ * procsnapshot.c
+ */
+struct proc_snapshot;
+
+struct proc_entry {
+	pid_t	pid;
+	pid_t	ppid;		/* PROC_SNAP_STAT */
+	char	state;		/* PROC_SNAP_STAT */
+	uid_t	uid;		/* PROC_SNAP_UID */
+	char	*comm;		/* PROC_SNAP_COMM */
+
+	void	*data;		/* reader's private data */
+
+	unsigned int valid : 1;	/* successfully read */
+};
+
+enum {
+	PROC_SNAP_UID	= (1 << 0),	/* owner of /proc/<pid> */
+	PROC_SNAP_STAT	= (1 << 1),	/* ppid and state from /proc/<pid>/stat */
+	PROC_SNAP_COMM	= (1 << 2)	/* command name (from /proc/<pid>/stat) */
+};
+
+typedef int (*proc_snapshot_reader)(struct proc_snapshot *ps,
+				    struct proc_entry *ent,
+				    int dirfd, void *data);
+
+extern struct proc_snapshot *proc_new_snapshot(int fields);
+extern void proc_free_snapshot(struct proc_snapshot *ps);
+extern void proc_snapshot_set_reader(struct proc_snapshot *ps,
+				     proc_snapshot_reader fn, void *data);
+extern void proc_snapshot_enable_threads(struct proc_snapshot *ps, int enable);
+extern int proc_snapshot_add_pid(struct proc_snapshot *ps, pid_t pid);
+extern int proc_snapshot_read(struct proc_snapshot *ps);
+extern size_t proc_snapshot_get_nentries(struct proc_snapshot *ps);
+extern struct proc_entry *proc_snapshot_get_entry(struct proc_snapshot *ps, size_t idx);
+extern struct proc_entry *proc_snapshot_find(struct proc_snapshot *ps, pid_t pid);
+
 #endif /* UTIL_LINUX_PROCUTILS */
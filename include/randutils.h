@@ -14,4 +14,8 @@ extern int random_get_fd(void);
 extern int ul_random_get_bytes(void *buf, size_t nbytes);
 extern const char *random_tell_source(void);
 
+/* per-thread buffered ul_random_get_bytes() */
+extern int ul_random_pool_get_bytes(void *buf, size_t nbytes);
+extern void ul_random_pool_clear(void);
+
 #endif
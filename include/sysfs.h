@@ -64,7 +64,15 @@ struct sysfs_blkdev {
 			hctl_error : 1 ;
 };
 
+/* partition as known by kernel, in 512-byte sectors */
+struct sysfs_blkdev_part {
+	int		partno;
+	uint64_t	start;
+	uint64_t	size;
+};
+
 void ul_sysfs_init_debug(void);
+void sysfs_enable_devcache(int enable);
 
 struct path_cxt *ul_new_sysfs_path(dev_t devno, struct path_cxt *parent, const char *prefix);
 int sysfs_blkdev_init_path(struct path_cxt *pc, dev_t devno, struct path_cxt *parent);
@@ -76,6 +84,7 @@ char *sysfs_blkdev_get_name(struct path_cxt *pc, char *buf, size_t bufsiz);
 int sysfs_blkdev_is_partition_dirent(DIR *dir, struct dirent *d, const char *parent_name);
 int sysfs_blkdev_count_partitions(struct path_cxt *pc, const char *devname);
 dev_t sysfs_blkdev_partno_to_devno(struct path_cxt *pc, int partno);
+int sysfs_blkdev_get_partitions(struct path_cxt *pc, struct sysfs_blkdev_part **parts);
 char *sysfs_blkdev_get_slave(struct path_cxt *pc);
 char *sysfs_blkdev_get_path(struct path_cxt *pc, char *buf, size_t bufsiz);
 dev_t sysfs_blkdev_get_devno(struct path_cxt *pc);
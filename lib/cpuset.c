@@ -25,15 +25,6 @@
 #include "cpuset.h"
 #include "c.h"
 
-static inline int val_to_char(int v)
-{
-	if (v >= 0 && v < 10)
-		return '0' + v;
-	if (v >= 10 && v < 16)
-		return ('a' - 10) + v;
-	return -1;
-}
-
 static inline int char_to_val(int c)
 {
 	int cl;
@@ -143,6 +134,102 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 }
 #endif
 
+/*
+ * The cpu_set_t bits are stored in unsigned longs (see CPU_SET_S() in glibc
+ * and musl) and the set size is always a multiple of size of the long (see
+ * CPU_ALLOC_SIZE()), so the set is accessible word by word.
+ */
+#define CPUSET_WORD_BITS	(sizeof(unsigned long) * 8)
+
+static inline unsigned long *cpuset_words(const cpu_set_t *set)
+{
+	return (unsigned long *) set->__bits;
+}
+
+static inline size_t cpuset_nwords(size_t setsize)
+{
+	return setsize / sizeof(unsigned long);
+}
+
+static inline size_t word_ctz(unsigned long word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzl(word);
+#else
+	size_t n = 0;
+
+	while (!(word & 1UL)) {
+		word >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/*
+ * Returns the first CPU >= @from (or the first CPU not in the set if @isset
+ * is zero), or number of bits in the set if there is no such CPU.
+ */
+static size_t cpuset_next(const cpu_set_t *set, size_t setsize, size_t from, int isset)
+{
+	const unsigned long *words = cpuset_words(set);
+	size_t nwords = cpuset_nwords(setsize);
+	size_t w = from / CPUSET_WORD_BITS;
+	unsigned long word;
+
+	if (w >= nwords)
+		return cpuset_nbits(setsize);
+
+	word = isset ? words[w] : ~words[w];
+	word &= ~0UL << (from % CPUSET_WORD_BITS);
+
+	while (!word) {
+		if (++w >= nwords)
+			return cpuset_nbits(setsize);
+		word = isset ? words[w] : ~words[w];
+	}
+	return w * CPUSET_WORD_BITS + word_ctz(word);
+}
+
+/* sets CPUs from @from to @to (inclusive), the range has to fit into the set */
+static void cpuset_set_range(cpu_set_t *set, size_t from, size_t to)
+{
+	unsigned long *words = cpuset_words(set);
+	size_t fw = from / CPUSET_WORD_BITS;
+	size_t tw = to / CPUSET_WORD_BITS;
+	unsigned long fmask = ~0UL << (from % CPUSET_WORD_BITS);
+	unsigned long tmask = ~0UL >> (CPUSET_WORD_BITS - 1 - to % CPUSET_WORD_BITS);
+
+	if (fw == tw) {
+		words[fw] |= fmask & tmask;
+		return;
+	}
+	words[fw++] |= fmask;
+	while (fw < tw)
+		words[fw++] = ~0UL;
+	words[tw] |= tmask;
+}
+
+/* writes decimal @num to @str, returns number of bytes or -1 if no space */
+static int put_number(char *str, size_t len, size_t num, char sep)
+{
+	char tmp[sizeof(size_t) * 3];
+	size_t n = 0, i;
+
+	do {
+		tmp[n++] = '0' + num % 10;
+		num /= 10;
+	} while (num);
+
+	if (n + 1 >= len)
+		return -1;
+	for (i = 0; i < n; i++)
+		str[i] = tmp[n - i - 1];
+	str[n++] = sep;
+	str[n] = '\0';
+	return n;
+}
+
 /*
  * Returns human readable representation of the cpuset. The output format is
  * a list of CPUs with ranges (for example, "0,1,3-9").
@@ -150,36 +237,32 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 char *cpulist_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
-	size_t i;
+	size_t i = 0;
 	char *ptr = str;
 	int entry_made = 0;
 	size_t max = cpuset_nbits(setsize);
 
-	for (i = 0; i < max; i++) {
-		if (CPU_ISSET_S(i, setsize, set)) {
-			int rlen;
-			size_t j, run = 0;
-			entry_made = 1;
-			for (j = i + 1; j < max; j++) {
-				if (CPU_ISSET_S(j, setsize, set))
-					run++;
-				else
-					break;
-			}
-			if (!run)
-				rlen = snprintf(ptr, len, "%zu,", i);
-			else if (run == 1) {
-				rlen = snprintf(ptr, len, "%zu,%zu,", i, i + 1);
-				i++;
-			} else {
-				rlen = snprintf(ptr, len, "%zu-%zu,", i, i + run);
-				i += run;
-			}
-			if (rlen < 0 || (size_t) rlen >= len)
+	while ((i = cpuset_next(set, setsize, i, 1)) < max) {
+		size_t end = cpuset_next(set, setsize, i + 1, 0);
+		size_t run = end - i - 1;
+		int rlen, rlen2 = 0;
+
+		entry_made = 1;
+
+		if (!run)
+			rlen = put_number(ptr, len, i, ',');
+		else
+			rlen = put_number(ptr, len, i, run == 1 ? ',' : '-');
+		if (rlen < 0)
+			return NULL;
+		if (run) {
+			rlen2 = put_number(ptr + rlen, len - rlen, end - 1, ',');
+			if (rlen2 < 0)
 				return NULL;
-			ptr += rlen;
-			len -= rlen;
 		}
+		ptr += rlen + rlen2;
+		len -= rlen + rlen2;
+		i = end;
 	}
 	ptr -= entry_made;
 	*ptr = '\0';
@@ -193,28 +276,36 @@ char *cpulist_create(char *str, size_t len,
 char *cpumask_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
+	static const char hex[] = "0123456789abcdef";
+	const unsigned long *words = cpuset_words(set);
+	size_t nchars = cpuset_nbits(setsize) / 4, i;
 	char *ptr = str;
 	char *ret = NULL;
-	int cpu;
-
-	for (cpu = cpuset_nbits(setsize) - 4; cpu >= 0; cpu -= 4) {
-		char val = 0;
-
-		if (len == (size_t) (ptr - str))
-			break;
-
-		if (CPU_ISSET_S(cpu, setsize, set))
-			val |= 1;
-		if (CPU_ISSET_S(cpu + 1, setsize, set))
-			val |= 2;
-		if (CPU_ISSET_S(cpu + 2, setsize, set))
-			val |= 4;
-		if (CPU_ISSET_S(cpu + 3, setsize, set))
-			val |= 8;
 
+	if (!len)
+		return NULL;
+	if (nchars > len - 1)
+		nchars = len - 1;
+
+	/* from the most significant nibble */
+	for (i = 0; i < nchars; i++) {
+		size_t cpu = cpuset_nbits(setsize) - 4 * (i + 1);
+		unsigned long word = words[cpu / CPUSET_WORD_BITS];
+		int val;
+
+		if (!word && !ret && cpu % CPUSET_WORD_BITS == CPUSET_WORD_BITS - 4) {
+			/* skip zero word */
+			size_t n = min(nchars - i, CPUSET_WORD_BITS / 4);
+
+			memset(ptr, '0', n);
+			ptr += n;
+			i += n - 1;
+			continue;
+		}
+		val = (word >> (cpu % CPUSET_WORD_BITS)) & 0xf;
 		if (!ret && val)
 			ret = ptr;
-		*ptr++ = val_to_char(val);
+		*ptr++ = hex[val];
 	}
 	*ptr = '\0';
 	return ret ? ret : ptr - 1;
@@ -225,9 +316,11 @@ char *cpumask_create(char *str, size_t len,
  */
 int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 {
+	unsigned long *words = cpuset_words(set);
+	size_t max = cpuset_nbits(setsize);
 	int len = strlen(str);
 	const char *ptr = str + len - 1;
-	int cpu = 0;
+	size_t cpu = 0;
 
 	/* skip 0x, it's all hex anyway */
 	if (len > 1 && !memcmp(str, "0x", 2L))
@@ -236,23 +329,18 @@ int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 	CPU_ZERO_S(setsize, set);
 
 	while (ptr >= str) {
-		char val;
+		int val;
 
 		/* cpu masks in /sys uses comma as a separator */
 		if (*ptr == ',')
 			ptr--;
 
 		val = char_to_val(*ptr);
-		if (val == (char) -1)
+		if (val < 0)
 			return -1;
-		if (val & 1)
-			CPU_SET_S(cpu, setsize, set);
-		if (val & 2)
-			CPU_SET_S(cpu + 1, setsize, set);
-		if (val & 4)
-			CPU_SET_S(cpu + 2, setsize, set);
-		if (val & 8)
-			CPU_SET_S(cpu + 3, setsize, set);
+		if (val && cpu < max)
+			words[cpu / CPUSET_WORD_BITS] |=
+				(unsigned long) val << (cpu % CPUSET_WORD_BITS);
 		ptr--;
 		cpu += 4;
 	}
@@ -294,7 +382,7 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 		unsigned int a;	/* beginning of range */
 		unsigned int b;	/* end of range */
 		unsigned int s;	/* stride */
-		const char *c1, *c2;
+		const char *c;
 
 		if (nextnumber(p, &end, &a) != 0)
 			return 1;
@@ -302,17 +390,17 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 		s = 1;
 		p = end;
 
-		c1 = nexttoken(p, '-');
-		c2 = nexttoken(p, ',');
+		/* don't search behind the next entry */
+		c = strpbrk(p, "-,");
 
-		if (c1 != NULL && (c2 == NULL || c1 < c2)) {
-			if (nextnumber(c1, &end, &b) != 0)
+		if (c && *c == '-') {
+			if (nextnumber(c + 1, &end, &b) != 0)
 				return 1;
 
-			c1 = end && *end ? nexttoken(end, ':') : NULL;
+			c = end && *end ? strpbrk(end, ":,") : NULL;
 
-			if (c1 != NULL && (c2 == NULL || c1 < c2)) {
-				if (nextnumber(c1, &end, &s) != 0)
+			if (c && *c == ':') {
+				if (nextnumber(c + 1, &end, &s) != 0)
 					return 1;
 				if (s == 0)
 					return 1;
@@ -321,11 +409,24 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 
 		if (!(a <= b))
 			return 1;
-		while (a <= b) {
-			if (fail && (a >= max))
+
+		/* the last CPU in the range */
+		b = a + ((b - a) / s) * s;
+		if (b >= max) {
+			if (fail)
 				return 2;
-			CPU_SET_S(a, setsize, set);
-			a += s;
+			if (a >= max)
+				continue;
+			b = a + ((max - 1 - a) / s) * s;
+		}
+
+		if (s == 1)
+			cpuset_set_range(set, a, b);
+		else {
+			size_t cpu;
+
+			for (cpu = a; cpu <= b; cpu += s)
+				CPU_SET_S(cpu, setsize, set);
 		}
 	}
 
@@ -337,11 +438,89 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 #ifdef TEST_PROGRAM_CPUSET
 
 #include <getopt.h>
+#include <time.h>
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* round-trip all the functions for some typical sets */
+static int bench(int ncpus, size_t loops)
+{
+	static const char *const names[] = {
+		"empty", "full", "even", "half", "sparse", "random"
+	};
+	size_t setsize, nbits, n, i, k, buflen;
+	cpu_set_t *set, *res;
+	unsigned int seed = 1;
+	char *buf;
+
+	set = cpuset_alloc(ncpus, &setsize, &nbits);
+	res = cpuset_alloc(ncpus, NULL, NULL);
+	buflen = 7 * nbits;
+	buf = malloc(buflen);
+	if (!set || !res || !buf)
+		err(EXIT_FAILURE, "failed to allocate cpu set");
+
+	printf("%-8s %12s %12s %12s %12s  [us/call, %zu CPUs]\n", "set",
+		"list-create", "list-parse", "mask-create", "mask-parse", nbits);
+
+	for (n = 0; n < ARRAY_SIZE(names); n++) {
+		double t, res_lc, res_lp, res_mc, res_mp;
+		char *str;
+
+		CPU_ZERO_S(setsize, set);
+		for (i = 0; i < nbits; i++) {
+			if ((n == 1) ||
+			    (n == 2 && i % 2 == 0) ||
+			    (n == 3 && i < nbits / 2) ||
+			    (n == 4 && i % 97 == 0) ||
+			    (n == 5 && rand_r(&seed) % 3 == 0))
+				CPU_SET_S(i, setsize, set);
+		}
+
+		t = now();
+		for (k = 0; k < loops; k++)
+			str = cpulist_create(buf, buflen, set, setsize);
+		res_lc = (now() - t) * 1e6 / loops;
+
+		t = now();
+		for (k = 0; k < loops; k++)
+			cpulist_parse(str, res, setsize, 0);
+		res_lp = (now() - t) * 1e6 / loops;
+		if (!CPU_EQUAL_S(setsize, set, res))
+			errx(EXIT_FAILURE, "%s: list round-trip failed", names[n]);
+
+		t = now();
+		for (k = 0; k < loops; k++)
+			str = cpumask_create(buf, buflen, set, setsize);
+		res_mc = (now() - t) * 1e6 / loops;
+
+		t = now();
+		for (k = 0; k < loops; k++)
+			cpumask_parse(str, res, setsize);
+		res_mp = (now() - t) * 1e6 / loops;
+		if (!CPU_EQUAL_S(setsize, set, res))
+			errx(EXIT_FAILURE, "%s: mask round-trip failed", names[n]);
+
+		printf("%-8s %12.3f %12.3f %12.3f %12.3f\n", names[n],
+				res_lc, res_lp, res_mc, res_mp);
+	}
+
+	free(buf);
+	cpuset_free(set);
+	cpuset_free(res);
+	return EXIT_SUCCESS;
+}
 
 int main(int argc, char *argv[])
 {
 	cpu_set_t *set;
-	size_t setsize, buflen, nbits;
+	size_t setsize, buflen, nbits, loops = 0;
 	char *buf, *mask = NULL, *range = NULL;
 	int ncpus = 2048, rc, c;
 
@@ -349,11 +528,15 @@ int main(int argc, char *argv[])
 	    { "ncpus", 1, NULL, 'n' },
 	    { "mask",  1, NULL, 'm' },
 	    { "range", 1, NULL, 'r' },
+	    { "bench", 1, NULL, 'b' },
 	    { NULL,    0, NULL, 0 }
 	};
 
-	while ((c = getopt_long(argc, argv, "n:m:r:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "b:n:m:r:", longopts, NULL)) != -1) {
 		switch(c) {
+		case 'b':
+			loops = strtoul(optarg, NULL, 10);
+			break;
 		case 'n':
 			ncpus = atoi(optarg);
 			break;
@@ -368,6 +551,8 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (loops)
+		return bench(ncpus, loops);
 	if (!mask && !range)
 		goto usage_err;
 
@@ -406,7 +591,7 @@ int main(int argc, char *argv[])
 
 usage_err:
 	fprintf(stderr,
-		"usage: %s [--ncpus <num>] --mask <mask> | --range <list>\n",
+		"usage: %s [--ncpus <num>] --mask <mask> | --range <list> | --bench <loops>\n",
 		program_invocation_short_name);
 	exit(EXIT_FAILURE);
 }
@@ -39,9 +39,27 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
+#include "c.h"
 #include "crc32.h"
 
+/*
+ * The hardware accelerated versions are selected at runtime, see
+ * crc32_init(). The portable slice-by-8 version is the fallback.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+# define HAVE_CRC32_PCLMUL 1
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+# define HAVE_CRC32_ARM64 1
+# include <arm_acle.h>
+# include <sys/auxv.h>
+# ifndef HWCAP_CRC32
+#  define HWCAP_CRC32	(1 << 7)
+# endif
+#endif
+
 
 static const uint32_t crc32_tab[] = {
 	0x00000000L, 0x77073096L, 0xee0e612cL, 0x990951baL, 0x076dc419L,
@@ -103,40 +121,266 @@ static inline uint32_t crc32_add_char(uint32_t crc, unsigned char c)
 	return crc32_tab[(crc ^ c) & 0xff] ^ (crc >> 8);
 }
 
-/*
- * This a generic crc32() function, it takes seed as an argument,
- * and does __not__ xor at the end. Then individual users can do
- * whatever they need.
- */
-uint32_t ul_crc32(uint32_t seed, const unsigned char *buf, size_t len)
+static uint32_t crc32_bytewise(uint32_t crc, const unsigned char *p, size_t len)
 {
-	uint32_t crc = seed;
-	const unsigned char *p = buf;
-
 	while (len) {
 		crc = crc32_add_char(crc, *p++);
 		len--;
 	}
+	return crc;
+}
+
+/*
+ * Slice-by-8, crc32_slice[0] is crc32_tab[], the other tables are generated
+ * by crc32_init().
+ */
+static uint32_t crc32_slice[8][256];
+
+static void crc32_init_slice(void)
+{
+	size_t i, k;
+
+	for (i = 0; i < 256; i++)
+		crc32_slice[0][i] = crc32_tab[i];
+	for (k = 1; k < 8; k++) {
+		for (i = 0; i < 256; i++) {
+			uint32_t x = crc32_slice[k - 1][i];
+			crc32_slice[k][i] = (x >> 8) ^ crc32_tab[x & 0xff];
+		}
+	}
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len >= 8) {
+		uint32_t a = crc ^ ((uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+				    ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+
+		crc = crc32_slice[7][a & 0xff] ^
+		      crc32_slice[6][(a >> 8) & 0xff] ^
+		      crc32_slice[5][(a >> 16) & 0xff] ^
+		      crc32_slice[4][a >> 24] ^
+		      crc32_slice[3][p[4]] ^
+		      crc32_slice[2][p[5]] ^
+		      crc32_slice[1][p[6]] ^
+		      crc32_slice[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+	return crc32_bytewise(crc, p, len);
+}
+
+#ifdef HAVE_CRC32_PCLMUL
+/*
+ * Folding by carry-less multiplication, see Intel's "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" paper. The constants are
+ * for the bit-reflected CRC32 polynomial.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul(uint32_t crc, const unsigned char *p, size_t len)
+{
+	static const uint64_t __attribute__((aligned(16)))
+		k1k2[] = { 0x0154442bd4, 0x01c6e41596 },
+		k3k4[] = { 0x01751997d0, 0x00ccaa009e },
+		k5k0[] = { 0x0163cd6124, 0x0000000000 },
+		poly[] = { 0x01db710641, 0x01f7011641 };
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	if (len < 64)
+		return crc32_bytewise(crc, p, len);
+
+	x1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	x0 = _mm_load_si128((const __m128i *) k1k2);
+	p += 64;
+	len -= 64;
+
+	/* fold by 4 x 128 bits */
+	while (len >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		y5 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+		y6 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+		y7 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+		y8 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+		p += 64;
+		len -= 64;
+	}
+
+	/* fold 4 x 128 bits to 128 bits */
+	x0 = _mm_load_si128((const __m128i *) k3k4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	/* fold by 128 bits */
+	while (len >= 16) {
+		x2 = _mm_loadu_si128((const __m128i *) p);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		p += 16;
+		len -= 16;
+	}
+
+	/* fold 128 bits to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+	x0 = _mm_loadl_epi64((const __m128i *) k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x0 = _mm_load_si128((const __m128i *) poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	crc = _mm_extract_epi32(x1, 1);
+
+	return crc32_bytewise(crc, p, len);
+}
 
+static int crc32_has_hw(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+#endif /* HAVE_CRC32_PCLMUL */
+
+#ifdef HAVE_CRC32_ARM64
+# ifdef __clang__
+__attribute__((target("crc")))
+# else
+__attribute__((target("+crc")))
+# endif
+static uint32_t crc32_arm64(uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len >= 8) {
+		uint64_t v;
+
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32d(crc, v);
+		p += 8;
+		len -= 8;
+	}
+	while (len--)
+		crc = __crc32b(crc, *p++);
 	return crc;
 }
 
-uint32_t ul_crc32_exclude_offset(uint32_t seed, const unsigned char *buf, size_t len,
-			      size_t exclude_off, size_t exclude_len)
+static int crc32_has_hw(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#endif /* HAVE_CRC32_ARM64 */
+
+/* the byte-at-a-time version until crc32_init() is called */
+static uint32_t (*crc32_fn)(uint32_t, const unsigned char *, size_t) = crc32_bytewise;
+
+/*
+ * Verifies the accelerated version by the byte-at-a-time table based
+ * version. The test data are not aligned and the length is not multiple of
+ * the block size to test all code paths.
+ */
+static int crc32_selftest(uint32_t (*fn)(uint32_t, const unsigned char *, size_t))
 {
-	uint32_t crc = seed;
-	const unsigned char *p = buf;
+	unsigned char buf[1024 + 16];
 	size_t i;
 
-	for (i = 0; i < len; i++) {
-		unsigned char x = *p++;
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (unsigned char) (i * 131 + (i >> 8));
 
-		if (i >= exclude_off && i < exclude_off + exclude_len)
-			x = 0;
+	for (i = 0; i < 64; i += 7) {
+		size_t len = sizeof(buf) - 16 - i * 3;
 
-		crc = crc32_add_char(crc, x);
+		if (fn(~0U, buf + i, len) != crc32_bytewise(~0U, buf + i, len))
+			return -1;
 	}
+	return 0;
+}
 
-	return crc;
+/*
+ * Selects the implementation. It's called when the library or program is
+ * loaded, before any thread can use the function pointer or the tables.
+ */
+static void __attribute__((__constructor__)) crc32_init(void)
+{
+	uint32_t (*fn)(uint32_t, const unsigned char *, size_t) = NULL;
+
+#if defined(HAVE_CRC32_PCLMUL)
+	if (crc32_has_hw() && crc32_selftest(crc32_pclmul) == 0)
+		fn = crc32_pclmul;
+#elif defined(HAVE_CRC32_ARM64)
+	if (crc32_has_hw() && crc32_selftest(crc32_arm64) == 0)
+		fn = crc32_arm64;
+#endif
+	if (!fn) {
+		crc32_init_slice();
+		fn = crc32_slice8;
+	}
+	crc32_fn = fn;
+}
+
+/*
+ * This a generic crc32() function, it takes seed as an argument,
+ * and does __not__ xor at the end. Then individual users can do
+ * whatever they need.
+ */
+uint32_t ul_crc32(uint32_t seed, const unsigned char *buf, size_t len)
+{
+	return crc32_fn(seed, buf, len);
 }
 
+uint32_t ul_crc32_exclude_offset(uint32_t seed, const unsigned char *buf, size_t len,
+			      size_t exclude_off, size_t exclude_len)
+{
+	static const unsigned char zeros[256];
+	uint32_t crc;
+
+	if (exclude_off > len)
+		exclude_off = len;
+	if (exclude_len > len - exclude_off)
+		exclude_len = len - exclude_off;
+
+	crc = ul_crc32(seed, buf, exclude_off);
+	buf += exclude_off;
+	len -= exclude_off;
+
+	/* the excluded area is counted as zeros */
+	while (exclude_len) {
+		size_t sz = min(exclude_len, sizeof(zeros));
+
+		crc = ul_crc32(crc, zeros, sz);
+		exclude_len -= sz;
+		buf += sz;
+		len -= sz;
+	}
+
+	return ul_crc32(crc, buf, len);
+}
@@ -1,8 +1,8 @@
 /*
  * This code is from freebsd/sys/libkern/crc32.c
  *
- * Simplest table-based crc32c.  Performance is not important
- * for checking crcs on superblocks
+ * Table-based crc32c, the SSE4.2 or ARMv8 crc32c instructions are used
+ * if available.
  */
 
 /*-
@@ -10,8 +10,23 @@
  *  code or tables extracted from it, as desired without restriction.
  */
 
+#include <string.h>
+
+#include "c.h"
 #include "crc32c.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+# define HAVE_CRC32C_SSE42 1
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+# define HAVE_CRC32C_ARM64 1
+# include <arm_acle.h>
+# include <sys/auxv.h>
+# ifndef HWCAP_CRC32
+#  define HWCAP_CRC32	(1 << 7)
+# endif
+#endif
+
 static const uint32_t crc32Table[256] = {
 	0x00000000L, 0xF26B8303L, 0xE13B70F7L, 0x1350F3F4L,
 	0xC79A971FL, 0x35F1141CL, 0x26A1E7E8L, 0xD4CA64EBL,
@@ -79,6 +94,151 @@ static const uint32_t crc32Table[256] = {
 	0xBE2DA0A5L, 0x4C4623A6L, 0x5F16D052L, 0xAD7D5351L
 };
 
+static uint32_t crc32c_bytewise(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size--)
+		crc = crc32Table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+/*
+ * Slice-by-8, the tables are generated from crc32Table[] by crc32c_init().
+ */
+static uint32_t crc32cSlice[8][256];
+
+static void crc32c_init_slice(void)
+{
+	size_t i, k;
+
+	for (i = 0; i < 256; i++)
+		crc32cSlice[0][i] = crc32Table[i];
+	for (k = 1; k < 8; k++) {
+		for (i = 0; i < 256; i++) {
+			uint32_t x = crc32cSlice[k - 1][i];
+			crc32cSlice[k][i] = (x >> 8) ^ crc32Table[x & 0xff];
+		}
+	}
+}
+
+static uint32_t crc32c_slice8(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size >= 8) {
+		uint32_t a = crc ^ ((uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+				    ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+
+		crc = crc32cSlice[7][a & 0xff] ^
+		      crc32cSlice[6][(a >> 8) & 0xff] ^
+		      crc32cSlice[5][(a >> 16) & 0xff] ^
+		      crc32cSlice[4][a >> 24] ^
+		      crc32cSlice[3][p[4]] ^
+		      crc32cSlice[2][p[5]] ^
+		      crc32cSlice[1][p[6]] ^
+		      crc32cSlice[0][p[7]];
+		p += 8;
+		size -= 8;
+	}
+	return crc32c_bytewise(crc, p, size);
+}
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t size)
+{
+	uint64_t crc64 = crc;
+
+	while (size >= 8) {
+		uint64_t v;
+
+		memcpy(&v, p, sizeof(v));
+		crc64 = _mm_crc32_u64(crc64, v);
+		p += 8;
+		size -= 8;
+	}
+	crc = (uint32_t) crc64;
+	while (size--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+
+static int crc32c_has_hw(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.2");
+}
+#endif /* HAVE_CRC32C_SSE42 */
+
+#ifdef HAVE_CRC32C_ARM64
+# ifdef __clang__
+__attribute__((target("crc")))
+# else
+__attribute__((target("+crc")))
+# endif
+static uint32_t crc32c_arm64(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size >= 8) {
+		uint64_t v;
+
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+		p += 8;
+		size -= 8;
+	}
+	while (size--)
+		crc = __crc32cb(crc, *p++);
+	return crc;
+}
+
+static int crc32c_has_hw(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#endif /* HAVE_CRC32C_ARM64 */
+
+/* the byte-at-a-time version until crc32c_init() is called */
+static uint32_t (*crc32c_fn)(uint32_t, const uint8_t *, size_t) = crc32c_bytewise;
+
+/*
+ * Verifies the accelerated version by the byte-at-a-time version.
+ */
+static int crc32c_selftest(uint32_t (*fn)(uint32_t, const uint8_t *, size_t))
+{
+	uint8_t buf[1024 + 16];
+	size_t i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (uint8_t) (i * 131 + (i >> 8));
+
+	for (i = 0; i < 64; i += 7) {
+		size_t len = sizeof(buf) - 16 - i * 3;
+
+		if (fn(~0U, buf + i, len) != crc32c_bytewise(~0U, buf + i, len))
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Selects the implementation. It's called when the library or program is
+ * loaded, before any thread can use the function pointer or the tables.
+ */
+static void __attribute__((__constructor__)) crc32c_init(void)
+{
+	uint32_t (*fn)(uint32_t, const uint8_t *, size_t) = NULL;
+
+#if defined(HAVE_CRC32C_SSE42)
+	if (crc32c_has_hw() && crc32c_selftest(crc32c_sse42) == 0)
+		fn = crc32c_sse42;
+#elif defined(HAVE_CRC32C_ARM64)
+	if (crc32c_has_hw() && crc32c_selftest(crc32c_arm64) == 0)
+		fn = crc32c_arm64;
+#endif
+	if (!fn) {
+		crc32c_init_slice();
+		fn = crc32c_slice8;
+	}
+	crc32c_fn = fn;
+}
+
 /*
  *This was singletable_crc32c() in bsd
  *
@@ -93,10 +253,5 @@ static const uint32_t crc32Table[256] = {
 uint32_t
 crc32c(uint32_t crc, const void *buf, size_t size)
 {
-	const uint8_t *p = buf;
-
-	while (size--)
-		crc = crc32Table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
-
-	return crc;
+	return crc32c_fn(crc, buf, size);
 }
@@ -12,21 +12,50 @@
 #include "c.h"
 #include "idcache.h"
 
-struct identry *get_id(struct idcache *ic, unsigned long int id)
+#define IDCACHE_NBUCKETS_MIN	64
+
+/*
+ * The whole passwd or group database is read by one get{pw,gr}ent()
+ * enumeration after so many cache misses; it is cheaper than many
+ * get{pw,gr}{uid,gid}() calls for remote (LDAP, SSSD, ...) databases.
+ */
+#define IDCACHE_PREFETCH_MISSES	64
+
+static inline size_t id_hash(const struct idcache *ic, unsigned long int id)
+{
+	return (size_t) (((uint64_t) id * 0x9E3779B97F4A7C15ULL) >> 32)
+			& (ic->nbuckets - 1);
+}
+
+static struct identry *find_id(struct idcache *ic, unsigned long int id)
 {
 	struct identry *ent;
 
-	if (!ic)
+	if (!ic->nbuckets)
 		return NULL;
 
-	for (ent = ic->ent; ent; ent = ent->next) {
+	for (ent = ic->ents[id_hash(ic, id)]; ent; ent = ent->next) {
 		if (ent->id == id)
 			return ent;
 	}
-
 	return NULL;
 }
 
+struct identry *get_id(struct idcache *ic, unsigned long int id)
+{
+	struct identry *ent;
+
+	if (!ic)
+		return NULL;
+
+	ent = find_id(ic, id);
+
+	/* prefetched, but never added by add_uid() or add_gid() */
+	if (ent && ent->prefetched)
+		return NULL;
+	return ent;
+}
+
 struct idcache *new_idcache(void)
 {
 	return calloc(1, sizeof(struct idcache));
@@ -34,84 +63,176 @@ struct idcache *new_idcache(void)
 
 void free_idcache(struct idcache *ic)
 {
-	struct identry *ent = ic->ent;
+	size_t i;
+
+	for (i = 0; i < ic->nbuckets; i++) {
+		struct identry *ent = ic->ents[i];
 
-	while (ent) {
-		struct identry *next = ent->next;
-		free(ent->name);
-		free(ent);
-		ent = next;
+		while (ent) {
+			struct identry *next = ent->next;
+			free(ent->name);
+			free(ent);
+			ent = next;
+		}
 	}
 
+	free(ic->ents);
 	free(ic);
 }
 
-static void add_id(struct idcache *ic, char *name, unsigned long int id)
+static int resize_idcache(struct idcache *ic)
+{
+	struct identry **old = ic->ents;
+	size_t i, oldsz = ic->nbuckets;
+	size_t sz = oldsz ? oldsz * 2 : IDCACHE_NBUCKETS_MIN;
+
+	ic->ents = calloc(sz, sizeof(struct identry *));
+	if (!ic->ents) {
+		ic->ents = old;
+		return -ENOMEM;
+	}
+	ic->nbuckets = sz;
+
+	for (i = 0; i < oldsz; i++) {
+		struct identry *ent = old[i];
+
+		while (ent) {
+			struct identry *next = ent->next;
+			size_t h = id_hash(ic, ent->id);
+
+			ent->next = ic->ents[h];
+			ic->ents[h] = ent;
+			ent = next;
+		}
+	}
+
+	free(old);
+	return 0;
+}
+
+static int name_width(const char *name)
+{
+#ifdef HAVE_WIDECHAR
+	wchar_t wc[LOGIN_NAME_MAX + 1];
+
+	if (mbstowcs(wc, name, LOGIN_NAME_MAX) > 0) {
+		wc[LOGIN_NAME_MAX] = '\0';
+		return wcswidth(wc, LOGIN_NAME_MAX);
+	}
+#endif
+	return strlen(name);
+}
+
+/* count the entry name to the cache width */
+static void use_id(struct idcache *ic, struct identry *ent)
+{
+	int w = name_width(ent->name);
+
+	if (w <= 0)
+		w = strlen(ent->name);
+	ic->width = ic->width < w ? w : ic->width;
+	ent->prefetched = 0;
+}
+
+static struct identry *add_id(struct idcache *ic, char *name,
+			      unsigned long int id, int prefetched)
 {
-	struct identry *ent, *x;
+	struct identry *ent;
+	size_t h;
 	int w = 0;
 
+	if (ic->nents >= ic->nbuckets && resize_idcache(ic) != 0
+	    && !ic->nbuckets)
+		return NULL;
+
 	ent = calloc(1, sizeof(struct identry));
 	if (!ent)
-		return;
+		return NULL;
 	ent->id = id;
 
-	if (name) {
-#ifdef HAVE_WIDECHAR
-		wchar_t wc[LOGIN_NAME_MAX + 1];
-
-		if (mbstowcs(wc, name, LOGIN_NAME_MAX) > 0) {
-			wc[LOGIN_NAME_MAX] = '\0';
-			w = wcswidth(wc, LOGIN_NAME_MAX);
-		}
-		else
-#endif
-			w = strlen(name);
-	}
+	if (name)
+		w = name_width(name);
 
 	/* note, we ignore names with non-printable widechars */
 	if (w > 0) {
 		ent->name = strdup(name);
 		if (!ent->name) {
 			free(ent);
-			return;
+			return NULL;
 		}
 	} else {
 		if (asprintf(&ent->name, "%lu", id) < 0) {
 			free(ent);
-			return;
+			return NULL;
 		}
 	}
 
-	for (x = ic->ent; x && x->next; x = x->next);
+	h = id_hash(ic, id);
+	ent->next = ic->ents[h];
+	ic->ents[h] = ent;
+	ic->nents++;
+
+	ent->prefetched = prefetched ? 1 : 0;
+	if (!prefetched)
+		use_id(ic, ent);
+	return ent;
+}
+
+static void prefetch_uids(struct idcache *ic)
+{
+	struct passwd *pw;
+
+	setpwent();
+	while ((pw = getpwent())) {
+		if (!find_id(ic, pw->pw_uid))
+			add_id(ic, pw->pw_name, pw->pw_uid, 1);
+	}
+	endpwent();
+	ic->prefetched = 1;
+}
+
+static void prefetch_gids(struct idcache *ic)
+{
+	struct group *gr;
 
-	if (x)
-		x->next = ent;
-	else
-		ic->ent = ent;
+	setgrent();
+	while ((gr = getgrent())) {
+		if (!find_id(ic, gr->gr_gid))
+			add_id(ic, gr->gr_name, gr->gr_gid, 1);
+	}
+	endgrent();
+	ic->prefetched = 1;
+}
 
-	if (w <= 0)
-		w = ent->name ? strlen(ent->name) : 0;
-	ic->width = ic->width < w ? w : ic->width;
+/* returns 1 if @id is in the cache (perhaps after prefetch) */
+static int lookup_id(struct idcache *ic, unsigned long int id,
+		     void (*prefetch)(struct idcache *))
+{
+	struct identry *ent = find_id(ic, id);
+
+	if (!ent && !ic->prefetched && ++ic->nmisses > IDCACHE_PREFETCH_MISSES) {
+		prefetch(ic);
+		ent = find_id(ic, id);
+	}
+	if (!ent)
+		return 0;
+	if (ent->prefetched)
+		use_id(ic, ent);
+	return 1;
 }
 
 void add_uid(struct idcache *cache, unsigned long int id)
 {
-	struct identry *ent= get_id(cache, id);
-
-	if (!ent) {
+	if (!lookup_id(cache, id, prefetch_uids)) {
 		struct passwd *pw = getpwuid((uid_t) id);
-		add_id(cache, pw ? pw->pw_name : NULL, id);
+		add_id(cache, pw ? pw->pw_name : NULL, id, 0);
 	}
 }
 
 void add_gid(struct idcache *cache, unsigned long int id)
 {
-	struct identry *ent = get_id(cache, id);
-
-	if (!ent) {
+	if (!lookup_id(cache, id, prefetch_gids)) {
 		struct group *gr = getgrgid((gid_t) id);
-		add_id(cache, gr ? gr->gr_name : NULL, id);
+		add_id(cache, gr ? gr->gr_name : NULL, id, 0);
 	}
 }
-
@@ -7,13 +7,80 @@
  * Written by Karel Zak <kzak@redhat.com>
  */
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <cctype.h>
 
 #include "c.h"
+#include "bitops.h"
 #include "jsonwrt.h"
 
+/*
+ * The escaped string is composed in a small buffer and written by fwrite(),
+ * the chars which need no escaping are copied in bulk.
+ */
+struct json_buffer {
+	FILE	*out;
+	size_t	len;
+	char	data[256];
+};
+
+static void json_buffer_flush(struct json_buffer *jb)
+{
+	if (jb->len)
+		fwrite(jb->data, 1, jb->len, jb->out);
+	jb->len = 0;
+}
+
+static inline void json_buffer_putc(struct json_buffer *jb, char c)
+{
+	if (jb->len == sizeof(jb->data))
+		json_buffer_flush(jb);
+	jb->data[jb->len++] = c;
+}
+
+static void json_buffer_write(struct json_buffer *jb, const char *str, size_t sz)
+{
+	if (jb->len + sz > sizeof(jb->data)) {
+		json_buffer_flush(jb);
+		if (sz > sizeof(jb->data) / 2) {
+			fwrite(str, 1, sz, jb->out);
+			return;
+		}
+	}
+	memcpy(jb->data + jb->len, str, sz);
+	jb->len += sz;
+}
+
+#define json_buffer_puts(_jb, _s)	json_buffer_write(_jb, _s, sizeof(_s) - 1)
+
+/*
+ * Returns number of the leading bytes in the @len bytes of @p which need no
+ * escaping; the string is tested per 8 bytes.
+ */
+static size_t json_clean_span(const char *p, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t x;
+
+		memcpy(&x, p + i, sizeof(x));
+		if (word_hasless(x, 0x20) || word_hasbyte(x, '"')
+		    || word_hasbyte(x, '\\'))
+			break;
+	}
+	for (; i < len; i++) {
+		const unsigned char c = (unsigned char) p[i];
+
+		if (c < 0x20 || c == '"' || c == '\\')
+			break;
+	}
+	return i;
+}
+
 /*
  * Requirements enumerated via testing (V8, Firefox, IE11):
  *
@@ -26,15 +93,32 @@
  *	}
  * }
  */
-static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
+static void fputs_quoted_case_json(const char *data, size_t size, FILE *out, int dir)
 {
-	const char *p;
+	struct json_buffer jb = { .out = out };
+	const char *p, *end;
+
+	json_buffer_putc(&jb, '"');
 
-	fputc('"', out);
-	for (p = data; p && *p; p++) {
+	p = data;
+	end = data ? data + size : NULL;
+
+	while (p && p < end) {
 
 		const unsigned int c = (unsigned int) *p;
 
+		/* no case swap, copy all the chars until the next special char */
+		if (dir == 0) {
+			size_t sz = json_clean_span(p, end - p);
+
+			if (sz) {
+				json_buffer_write(&jb, p, sz);
+				p += sz;
+				continue;
+			}
+		}
+		p++;
+
 		/* From http://www.json.org
 		 *
 		 * The double-quote and backslashes would break out a string or
@@ -44,8 +128,8 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
 		 * in the JSON spec, don't break double-quoted strings.
 		 */
 		if (c == '"' || c == '\\') {
-			fputc('\\', out);
-			fputc(c, out);
+			json_buffer_putc(&jb, '\\');
+			json_buffer_putc(&jb, c);
 			continue;
 		}
 
@@ -57,11 +141,11 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
 			 * (aka LANG=tr_TR.UTF-8) toupper('I') returns 'I'.
 			 */
 			if (c <= 127)
-				fputc(dir ==  1 ? c_toupper(c) :
-				      dir == -1 ? c_tolower(c) : *p, out);
+				json_buffer_putc(&jb, dir ==  1 ? c_toupper(c) :
+						      dir == -1 ? c_tolower(c) : (int) c);
 			else
-				fputc(dir ==  1 ? toupper(c) :
-				      dir == -1 ? tolower(c) : *p, out);
+				json_buffer_putc(&jb, dir ==  1 ? toupper(c) :
+						      dir == -1 ? tolower(c) : (int) c);
 			continue;
 		}
 
@@ -75,44 +159,62 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
 			 * should probably be using it.
 			 */
 			case '\b':
-				fputs("\\b", out);
+				json_buffer_puts(&jb, "\\b");
 				break;
 			case '\t':
-				fputs("\\t", out);
+				json_buffer_puts(&jb, "\\t");
 				break;
 			case '\n':
-				fputs("\\n", out);
+				json_buffer_puts(&jb, "\\n");
 				break;
 			case '\f':
-				fputs("\\f", out);
+				json_buffer_puts(&jb, "\\f");
 				break;
 			case '\r':
-				fputs("\\r", out);
+				json_buffer_puts(&jb, "\\r");
 				break;
 			default:
+			{
 				/* Other assorted control characters */
-				fprintf(out, "\\u00%02x", c);
+				char tmp[8];
+
+				snprintf(tmp, sizeof(tmp), "\\u00%02x", c);
+				json_buffer_write(&jb, tmp, 6);
 				break;
+			}
 		}
 	}
-	fputc('"', out);
+	json_buffer_putc(&jb, '"');
+	json_buffer_flush(&jb);
 }
 
-#define fputs_quoted_json(_d, _o)       fputs_quoted_case_json(_d, _o, 0)
-#define fputs_quoted_json_upper(_d, _o) fputs_quoted_case_json(_d, _o, 1)
-#define fputs_quoted_json_lower(_d, _o) fputs_quoted_case_json(_d, _o, -1)
+#define fputs_quoted_json(_d, _o)       fputs_quoted_case_json(_d, strlen(_d), _o, 0)
+#define fputs_quoted_json_upper(_d, _o) fputs_quoted_case_json(_d, strlen(_d), _o, 1)
+#define fputs_quoted_json_lower(_d, _o) fputs_quoted_case_json(_d, strlen(_d), _o, -1)
 
 void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent)
 {
 	fmt->out = out;
 	fmt->indent = indent;
 	fmt->after_close = 0;
+	fmt->compact = 0;
+}
+
+/*
+ * The compact output is all on one line, the root object is terminated by
+ * a new line. It's usable for streams with one object per line (NDJSON).
+ */
+void ul_jsonwrt_enable_compact(struct ul_jsonwrt *fmt, int enable)
+{
+	fmt->compact = enable ? 1 : 0;
 }
 
 void ul_jsonwrt_indent(struct ul_jsonwrt *fmt)
 {
 	int i;
 
+	if (fmt->compact)
+		return;
 	for (i = 0; i < fmt->indent; i++)
 		fputs("   ", fmt->out);
 }
@@ -121,7 +223,7 @@ void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 {
 	if (name) {
 		if (fmt->after_close)
-			fputs(",\n", fmt->out);
+			fputs(fmt->compact ? "," : ",\n", fmt->out);
 		ul_jsonwrt_indent(fmt);
 		fputs_quoted_json_lower(name, fmt->out);
 	} else {
@@ -131,6 +233,19 @@ void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 			ul_jsonwrt_indent(fmt);
 	}
 
+	if (fmt->compact) {
+		if (name)
+			fputc(':', fmt->out);
+		if (type == UL_JSON_OBJECT)
+			fputc('{', fmt->out);
+		else if (type == UL_JSON_ARRAY)
+			fputc('[', fmt->out);
+		if (type != UL_JSON_VALUE)
+			fmt->indent++;
+		fmt->after_close = 0;
+		return;
+	}
+
 	switch (type) {
 	case UL_JSON_OBJECT:
 		fputs(name ? ": {\n" : "{\n", fmt->out);
@@ -149,14 +264,25 @@ void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 
 void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 {
-	if (fmt->indent == 1) {
-		fputs("\n}\n", fmt->out);
+	if (fmt->indent == 1 && type != UL_JSON_VALUE) {
+		fputs(fmt->compact ? "}\n" : "\n}\n", fmt->out);
 		fmt->indent--;
-		fmt->after_close = 1;
+		fmt->after_close = fmt->compact ? 0 : 1;	/* the next line */
 		return;
 	}
 	assert(fmt->indent > 0);
 
+	if (fmt->compact) {
+		if (type == UL_JSON_OBJECT)
+			fputc('}', fmt->out);
+		else if (type == UL_JSON_ARRAY)
+			fputc(']', fmt->out);
+		if (type != UL_JSON_VALUE)
+			fmt->indent--;
+		fmt->after_close = 1;
+		return;
+	}
+
 	switch (type) {
 	case UL_JSON_OBJECT:
 		fmt->indent--;
@@ -199,6 +325,18 @@ void ul_jsonwrt_value_s(struct ul_jsonwrt *fmt,
 	ul_jsonwrt_value_close(fmt);
 }
 
+/* the @data does not have to be terminated by zero */
+void ul_jsonwrt_value_s_sized(struct ul_jsonwrt *fmt,
+			const char *name, const char *data, size_t size)
+{
+	ul_jsonwrt_value_open(fmt, name);
+	if (data && size)
+		fputs_quoted_case_json(data, size, fmt->out, 0);
+	else
+		fputs("null", fmt->out);
+	ul_jsonwrt_value_close(fmt);
+}
+
 void ul_jsonwrt_value_u64(struct ul_jsonwrt *fmt,
 			const char *name, uint64_t data)
 {
@@ -214,6 +214,12 @@ void loopcxt_deinit(struct loopdev_cxt *lc)
 
 	ignore_result( loopcxt_set_device(lc, NULL) );
 	loopcxt_deinit_iterator(lc);
+	loopcxt_reset_index(lc);
+
+	if (lc->ctl_fd >= 0) {
+		close(lc->ctl_fd);
+		lc->ctl_fd = -1;
+	}
 
 	errno = errsv;
 }
@@ -1097,6 +1103,243 @@ found:
 	return 1;
 }
 
+/*
+ * The index is a snapshot of the used loop devices. It is built by one scan
+ * on the first loopcxt_find_by_backing_file() or loopcxt_find_overlap() call
+ * and then used for all lookups within the context. The devices set up or
+ * deleted by the context are added to (or removed from) the snapshot, use
+ * loopcxt_reset_index() to drop it and read the current state again.
+ *
+ * The entries with backing devno and inode are sorted by devno and inode,
+ * the rest (LOOP_GET_STATUS64 failed) is at the end of the array and it is
+ * searched by backing filename only.
+ */
+struct loopdev_index_entry {
+	char		*device;	/* device path */
+	char		*filename;	/* backing file */
+	dev_t		devno;		/* backing file devno */
+	ino_t		ino;		/* backing file inode */
+	uint64_t	offset;
+	uint64_t	sizelimit;
+	int		rc;		/* failed to read offset or sizelimit */
+	unsigned int	has_st:1;	/* devno and ino are valid */
+};
+
+static void loopdev_index_entry_free(struct loopdev_index_entry *ent)
+{
+	free(ent->device);
+	free(ent->filename);
+}
+
+static int cmp_index_entries(const void *a, const void *b)
+{
+	const struct loopdev_index_entry *x = a, *y = b;
+
+	if (x->has_st != y->has_st)
+		return x->has_st ? -1 : 1;
+	if (x->has_st) {
+		if (x->devno != y->devno)
+			return x->devno < y->devno ? -1 : 1;
+		if (x->ino != y->ino)
+			return x->ino < y->ino ? -1 : 1;
+	}
+	/* keep the devices in the kernel order for the same backing file */
+	if (strlen(x->device) != strlen(y->device))
+		return strlen(x->device) < strlen(y->device) ? -1 : 1;
+	return strcmp(x->device, y->device);
+}
+
+static void loopcxt_sort_index(struct loopdev_cxt *lc)
+{
+	size_t i;
+
+	qsort(lc->index, lc->nindex, sizeof(*lc->index), cmp_index_entries);
+
+	for (i = 0; i < lc->nindex && lc->index[i].has_st; i++);
+	lc->nindex_st = i;
+}
+
+static struct loopdev_index_entry *loopcxt_new_index_entry(struct loopdev_cxt *lc)
+{
+	struct loopdev_index_entry *ent;
+
+	if (lc->nindex % 32 == 0) {
+		ent = realloc(lc->index, (lc->nindex + 32) * sizeof(*lc->index));
+		if (!ent)
+			return NULL;
+		lc->index = ent;
+	}
+
+	ent = &lc->index[lc->nindex++];
+	memset(ent, 0, sizeof(*ent));
+	return ent;
+}
+
+/*
+ * @lc: context
+ *
+ * Drops the snapshot of the used loop devices, the next lookup
+ * scans the devices again.
+ */
+void loopcxt_reset_index(struct loopdev_cxt *lc)
+{
+	size_t i;
+
+	if (!lc)
+		return;
+	for (i = 0; i < lc->nindex; i++)
+		loopdev_index_entry_free(&lc->index[i]);
+	free(lc->index);
+	lc->index = NULL;
+	lc->nindex = lc->nindex_st = 0;
+	lc->has_index = 0;
+}
+
+static int loopcxt_build_index(struct loopdev_cxt *lc)
+{
+	int rc;
+
+	if (lc->has_index)
+		return 0;
+
+	DBG(CXT, ul_debugobj(lc, "building index"));
+
+	rc = loopcxt_init_iterator(lc, LOOPITER_FL_USED);
+	if (rc)
+		return rc;
+
+	while ((rc = loopcxt_next(lc)) == 0) {
+		struct loopdev_index_entry *ent = loopcxt_new_index_entry(lc);
+
+		if (!ent) {
+			rc = -ENOMEM;
+			break;
+		}
+		ent->device = strdup(lc->device);
+		if (!ent->device) {
+			lc->nindex--;
+			rc = -ENOMEM;
+			break;
+		}
+		ent->filename = loopcxt_get_backing_file(lc);
+
+		if (loopcxt_get_backing_inode(lc, &ent->ino) == 0 &&
+		    loopcxt_get_backing_devno(lc, &ent->devno) == 0)
+			ent->has_st = 1;
+
+		ent->rc = loopcxt_get_offset(lc, &ent->offset);
+		if (!ent->rc)
+			ent->rc = loopcxt_get_sizelimit(lc, &ent->sizelimit);
+	}
+
+	loopcxt_deinit_iterator(lc);
+	ignore_result( loopcxt_set_device(lc, NULL) );
+
+	if (rc < 0) {
+		loopcxt_reset_index(lc);
+		return rc;
+	}
+
+	loopcxt_sort_index(lc);
+	lc->has_index = 1;
+
+	DBG(CXT, ul_debugobj(lc, "index: %zu devices (%zu by inode)",
+				lc->nindex, lc->nindex_st));
+	return 0;
+}
+
+/* add the device set up by loopcxt_setup_device() to the index */
+static void loopcxt_index_add(struct loopdev_cxt *lc, int file_fd)
+{
+	struct loopdev_index_entry *ent;
+	struct stat st;
+
+	if (!lc->has_index)
+		return;
+
+	ent = loopcxt_new_index_entry(lc);
+	if (ent) {
+		ent->device = strdup(lc->device);
+		ent->filename = strdup(lc->filename);
+	}
+	if (!ent || !ent->device || !ent->filename) {
+		/* incomplete index is worse than no index */
+		loopcxt_reset_index(lc);
+		return;
+	}
+	if (fstat(file_fd, &st) == 0) {
+		ent->devno = st.st_dev;
+		ent->ino = st.st_ino;
+		ent->has_st = 1;
+	}
+	ent->offset = lc->config.info.lo_offset;
+	ent->sizelimit = lc->config.info.lo_sizelimit;
+
+	loopcxt_sort_index(lc);
+}
+
+/* remove the device deleted by loopcxt_delete_device() from the index */
+static void loopcxt_index_remove(struct loopdev_cxt *lc)
+{
+	size_t i;
+
+	for (i = 0; i < lc->nindex; i++) {
+		if (strcmp(lc->index[i].device, lc->device) != 0)
+			continue;
+		loopdev_index_entry_free(&lc->index[i]);
+		memmove(&lc->index[i], &lc->index[i + 1],
+			(lc->nindex - i - 1) * sizeof(*lc->index));
+		lc->nindex--;
+		loopcxt_sort_index(lc);
+		break;
+	}
+}
+
+/*
+ * Returns the first index entry associated with the backing file, for the
+ * next entry use @ent from the previous call. The filename is compared only
+ * for the entries without devno and inode if @st is not NULL.
+ */
+static struct loopdev_index_entry *loopcxt_index_next(struct loopdev_cxt *lc,
+				struct loopdev_index_entry *ent,
+				struct stat *st, const char *filename)
+{
+	struct loopdev_index_entry *end = lc->index + lc->nindex;
+
+	if (!ent && st) {
+		/* lower bound of the devno and inode */
+		size_t lo = 0, hi = lc->nindex_st;
+
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			struct loopdev_index_entry *x = &lc->index[mid];
+
+			if (x->devno < st->st_dev ||
+			    (x->devno == st->st_dev && x->ino < st->st_ino))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		ent = lc->index + lo;
+	} else if (!ent)
+		ent = lc->index;
+	else
+		ent++;
+
+	for (; ent < end; ent++) {
+		if (ent->has_st && st) {
+			if (ent->devno == st->st_dev && ent->ino == st->st_ino)
+				return ent;
+			/* don't use filename if we have devno and inode */
+			ent = lc->index + lc->nindex_st - 1;
+			continue;
+		}
+		if (ent->filename && strcmp(ent->filename, filename) == 0)
+			return ent;
+	}
+	return NULL;
+}
+
 /*
  * The setting is removed by loopcxt_set_device() loopcxt_next()!
  */
@@ -1170,6 +1413,7 @@ int loopcxt_set_backing_file(struct loopdev_cxt *lc, const char *filename)
 	if (!lc)
 		return -EINVAL;
 
+	free(lc->filename);
 	lc->filename = canonicalize_path(filename);
 	if (!lc->filename)
 		return -errno;
@@ -1180,6 +1424,111 @@ int loopcxt_set_backing_file(struct loopdev_cxt *lc, const char *filename)
 	return 0;
 }
 
+/*
+ * Returns the direct I/O offset alignment for the backing file or 0 if the
+ * file does not support direct I/O (or the alignment is unknown).
+ */
+static unsigned int get_dio_alignment(int fd, struct stat *st)
+{
+	unsigned int align = 0;
+
+	if (S_ISBLK(st->st_mode)) {
+		int sz = 0;
+
+		if (blkdev_get_sector_size(fd, &sz) == 0)
+			align = sz;
+		return align;
+	}
+	if (!S_ISREG(st->st_mode))
+		return 0;
+
+#ifdef STATX_DIOALIGN
+	{
+		/* since Linux v6.1, 0 if direct I/O is not supported */
+		struct statx stx;
+
+		if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 &&
+		    (stx.stx_mask & STATX_DIOALIGN))
+			return stx.stx_dio_offset_align;
+	}
+#endif
+	/* the logical sector size of the device with the filesystem */
+	if (major(st->st_dev)) {
+		dev_t disk = 0;
+		struct path_cxt *pc;
+		int sz = 0;
+
+		if (sysfs_devno_to_wholedisk(st->st_dev, NULL, 0, &disk) != 0)
+			disk = st->st_dev;
+		pc = ul_new_sysfs_path(disk, NULL, NULL);
+		if (pc && ul_path_read_s32(pc, &sz, "queue/logical_block_size") == 0
+		    && sz > 0)
+			align = sz;
+		ul_unref_path(pc);
+	}
+	return align;
+}
+
+/*
+ * @lc: context
+ *
+ * Probes the backing file (see loopcxt_set_backing_file()) and enables direct
+ * I/O for loopcxt_setup_device() if the file supports it. The logical block
+ * size is never changed, a different sector size would break the existing
+ * images (partition tables, filesystems). Direct I/O is not enabled if the
+ * direct I/O alignment of the backing file is larger than the block size (512
+ * bytes, or set by loopcxt_set_blocksize()), or if the offset or sizelimit are
+ * not aligned to the block size.
+ *
+ * Call it after loopcxt_set_{offset,sizelimit,blocksize}().
+ *
+ * Returns: <0 on error, 1 if direct I/O enabled, 0 if not.
+ */
+int loopcxt_autotune(struct loopdev_cxt *lc)
+{
+	unsigned int align;
+	uint64_t bsz;
+	struct stat st;
+	int fd;
+
+	if (!lc || !lc->filename)
+		return -EINVAL;
+
+	fd = open(lc->filename, O_RDONLY | O_CLOEXEC | O_DIRECT);
+	if (fd < 0) {
+		DBG(CXT, ul_debugobj(lc, "autotune: O_DIRECT open failed: %m"));
+		return errno == EINVAL ? 0 : -errno;
+	}
+	if (fstat(fd, &st) != 0) {
+		int rc = -errno;
+
+		close(fd);
+		return rc;
+	}
+	align = get_dio_alignment(fd, &st);
+	close(fd);
+
+	DBG(CXT, ul_debugobj(lc, "autotune: direct I/O alignment %u", align));
+
+	if (!align || (align & (align - 1)) || align > (unsigned int) getpagesize())
+		return 0;
+
+	bsz = lc->blocksize ? lc->blocksize : 512;
+	if (bsz < align) {
+		DBG(CXT, ul_debugobj(lc, "autotune: blocksize %ju too small", bsz));
+		return 0;
+	}
+	if (lc->config.info.lo_offset % bsz || lc->config.info.lo_sizelimit % bsz) {
+		DBG(CXT, ul_debugobj(lc, "autotune: offset or sizelimit unaligned"));
+		return 0;
+	}
+
+	lc->config.info.lo_flags |= LO_FLAGS_DIRECT_IO;
+
+	DBG(CXT, ul_debugobj(lc, "autotune: direct I/O, blocksize=%ju", bsz));
+	return 1;
+}
+
 /*
  * In kernels prior to v3.9, if the offset or sizelimit options
  * are used, the block device's size won't be synced automatically.
@@ -1357,6 +1706,7 @@ int loopcxt_setup_device(struct loopdev_cxt *lc)
 	 * -- since Linux v5.8-rc1, commit 3448914e8cc550ba792d4ccc74471d1ca4293aae
 	 */
 	lc->config.fd = file_fd;
+	lc->config.block_size = lc->blocksize;
 	if (ioctl(dev_fd, LOOP_CONFIGURE, &lc->config) < 0) {
 		rc = -errno;
 		errsv = errno;
@@ -1365,14 +1715,8 @@ int loopcxt_setup_device(struct loopdev_cxt *lc)
 			goto err;
 		}
 		fallback = 1;
-	} else {
-		if (lc->blocksize > 0
-			&& (rc = loopcxt_ioctl_blocksize(lc, lc->blocksize)) < 0) {
-			errsv = -rc;
-			goto err;
-		}
+	} else
 		DBG(SETUP, ul_debugobj(lc, "LOOP_CONFIGURE: OK"));
-	}
 
 	/*
 	 * Old deprecated way; first assign backing file FD and then in the
@@ -1409,11 +1753,17 @@ int loopcxt_setup_device(struct loopdev_cxt *lc)
 		}
 
 		DBG(SETUP, ul_debugobj(lc, "LOOP_SET_STATUS64: OK"));
+
+		/* not accepted by LOOP_SET_STATUS64, see loopcxt_autotune() */
+		if ((lc->config.info.lo_flags & LO_FLAGS_DIRECT_IO)
+		    && loopcxt_ioctl_dio(lc, 1) < 0)
+			DBG(SETUP, ul_debugobj(lc, "direct I/O ignored"));
 	}
 
 	if ((rc = loopcxt_check_size(lc, file_fd)))
 		goto err;
 
+	loopcxt_index_add(lc, file_fd);
 	close(file_fd);
 
 	memset(&lc->config, 0, sizeof(lc->config));
@@ -1544,6 +1894,7 @@ int loopcxt_delete_device(struct loopdev_cxt *lc)
 		return -errno;
 	}
 
+	loopcxt_index_remove(lc);
 	DBG(CXT, ul_debugobj(lc, "device removed"));
 	return 0;
 }
@@ -1579,6 +1930,33 @@ done:
 	return rc;
 }
 
+/*
+ * @lc: context
+ *
+ * Opens /dev/loop-control and keeps it open for all next
+ * loopcxt_find_unused() calls until loopcxt_deinit(). This is recommended
+ * when more devices are set up, the next free device is returned by kernel
+ * when the previous one is configured by loopcxt_setup_device().
+ *
+ * Returns: <0 on error, 0 on success.
+ */
+int loopcxt_open_control(struct loopdev_cxt *lc)
+{
+	if (!lc)
+		return -EINVAL;
+	if (lc->ctl_fd >= 0)
+		return 0;
+	if (!(lc->flags & LOOPDEV_FL_CONTROL))
+		return -ENOSYS;
+
+	lc->ctl_fd = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
+	if (lc->ctl_fd < 0)
+		return -errno;
+
+	DBG(CXT, ul_debugobj(lc, "loop-control open"));
+	return 0;
+}
+
 /*
  * Note that LOOP_CTL_GET_FREE ioctl is supported since kernel 3.1. In older
  * kernels we have to check all loop devices to found unused one.
@@ -1592,11 +1970,12 @@ int loopcxt_find_unused(struct loopdev_cxt *lc)
 	DBG(CXT, ul_debugobj(lc, "find_unused requested"));
 
 	if (lc->flags & LOOPDEV_FL_CONTROL) {
-		int ctl;
+		int ctl = lc->ctl_fd;
 
 		DBG(CXT, ul_debugobj(lc, "using loop-control"));
 
-		ctl = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
+		if (ctl < 0)
+			ctl = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
 		if (ctl >= 0)
 			rc = ioctl(ctl, LOOP_CTL_GET_FREE);
 		if (rc >= 0) {
@@ -1606,7 +1985,7 @@ int loopcxt_find_unused(struct loopdev_cxt *lc)
 			rc = loopiter_set_device(lc, name);
 		}
 		lc->control_ok = ctl >= 0 && rc == 0 ? 1 : 0;
-		if (ctl >= 0)
+		if (ctl >= 0 && ctl != lc->ctl_fd)
 			close(ctl);
 		DBG(CXT, ul_debugobj(lc, "find_unused by loop-control [rc=%d]", rc));
 	}
@@ -1723,27 +2102,33 @@ int loopdev_delete(const char *device)
 int loopcxt_find_by_backing_file(struct loopdev_cxt *lc, const char *filename,
 				 uint64_t offset, uint64_t sizelimit, int flags)
 {
+	struct loopdev_index_entry *ent = NULL;
 	int rc, hasst;
 	struct stat st;
 
-	if (!filename)
+	if (!lc || !filename)
 		return -EINVAL;
 
 	hasst = !stat(filename, &st);
 
-	rc = loopcxt_init_iterator(lc, LOOPITER_FL_USED);
+	rc = loopcxt_build_index(lc);
 	if (rc)
 		return rc;
 
-	while ((rc = loopcxt_next(lc)) == 0) {
-
-		if (loopcxt_is_used(lc, hasst ? &st : NULL,
-				    filename, offset, sizelimit, flags))
+	while ((ent = loopcxt_index_next(lc, ent, hasst ? &st : NULL, filename))) {
+		if (!(flags & LOOPDEV_FL_OFFSET))
+			break;
+		if (ent->rc || ent->offset != offset)
+			continue;
+		if (!(flags & LOOPDEV_FL_SIZELIMIT) || ent->sizelimit == sizelimit)
 			break;
 	}
 
-	loopcxt_deinit_iterator(lc);
-	return rc;
+	if (!ent)
+		return 1;
+
+	DBG(CXT, ul_debugobj(lc, "found %s backed by %s", ent->device, filename));
+	return loopcxt_set_device(lc, ent->device);
 }
 
 /*
@@ -1752,69 +2137,57 @@ int loopcxt_find_by_backing_file(struct loopdev_cxt *lc, const char *filename,
 int loopcxt_find_overlap(struct loopdev_cxt *lc, const char *filename,
 			   uint64_t offset, uint64_t sizelimit)
 {
+	struct loopdev_index_entry *ent = NULL;
 	int rc, hasst;
 	struct stat st;
 
-	if (!filename)
+	if (!lc || !filename)
 		return -EINVAL;
 
 	DBG(CXT, ul_debugobj(lc, "find_overlap requested"));
 	hasst = !stat(filename, &st);
 
-	rc = loopcxt_init_iterator(lc, LOOPITER_FL_USED);
+	rc = loopcxt_build_index(lc);
 	if (rc)
 		return rc;
 
-	while ((rc = loopcxt_next(lc)) == 0) {
-		uint64_t lc_sizelimit, lc_offset;
-
-		rc = loopcxt_is_used(lc, hasst ? &st : NULL,
-				     filename, offset, sizelimit, 0);
-		if (!rc)
-			continue;	/* unused */
-		if (rc < 0)
-			break;		/* error */
-
+	while ((ent = loopcxt_index_next(lc, ent, hasst ? &st : NULL, filename))) {
 		DBG(CXT, ul_debugobj(lc, "found %s backed by %s",
-			loopcxt_get_device(lc), filename));
+			ent->device, filename));
 
-		rc = loopcxt_get_offset(lc, &lc_offset);
-		if (rc) {
-			DBG(CXT, ul_debugobj(lc, "failed to get offset for device %s",
-				loopcxt_get_device(lc)));
-			break;
-		}
-		rc = loopcxt_get_sizelimit(lc, &lc_sizelimit);
-		if (rc) {
-			DBG(CXT, ul_debugobj(lc, "failed to get sizelimit for device %s",
-				loopcxt_get_device(lc)));
-			break;
+		if (ent->rc) {
+			DBG(CXT, ul_debugobj(lc, "failed to get offset or sizelimit for device %s",
+				ent->device));
+			rc = ent->rc;
+			goto done;
 		}
 
 		/* full match */
-		if (lc_sizelimit == sizelimit && lc_offset == offset) {
+		if (ent->sizelimit == sizelimit && ent->offset == offset) {
 			DBG(CXT, ul_debugobj(lc, "overlapping loop device %s (full match)",
-						loopcxt_get_device(lc)));
+						ent->device));
 			rc = 2;
-			goto found;
+			break;
 		}
 
 		/* overlap */
-		if (lc_sizelimit != 0 && offset >= lc_offset + lc_sizelimit)
+		if (ent->sizelimit != 0 && offset >= ent->offset + ent->sizelimit)
 			continue;
-		if (sizelimit != 0 && offset + sizelimit <= lc_offset)
+		if (sizelimit != 0 && offset + sizelimit <= ent->offset)
 			continue;
 
 		DBG(CXT, ul_debugobj(lc, "overlapping loop device %s",
-			loopcxt_get_device(lc)));
-			rc = 1;
-			goto found;
+			ent->device));
+		rc = 1;
+		break;
 	}
 
-	if (rc == 1)
-		rc = 0;	/* not found */
-found:
-	loopcxt_deinit_iterator(lc);
+	if (ent) {
+		int xrc = loopcxt_set_device(lc, ent->device);
+		if (xrc)
+			rc = xrc;
+	}
+done:
 	DBG(CXT, ul_debugobj(lc, "find_overlap done [rc=%d]", rc));
 	return rc;
 }
@@ -21,13 +21,76 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <stdint.h>
 #include <ctype.h>
 
 #include "c.h"
+#include "bitops.h"
 #include "mbsalign.h"
 #include "strutils.h"
 #include "widechar.h"
 
+/*
+ * The printable ASCII runs are scanned by SSE2 (always available on x86_64)
+ * per 16 bytes, the portable version uses 8-byte words.
+ */
+#if defined(__GNUC__) && defined(__SSE2__)
+# define HAVE_MBS_SPAN_SSE2 1
+# include <emmintrin.h>
+#endif
+
+/* printable ASCII char which needs no encoding */
+static inline int is_safe_ascii(unsigned char c)
+{
+	return c >= 0x20 && c <= 0x7e && c != '\\';
+}
+
+/*
+ * Returns number of the leading bytes of @s which are printable ASCII chars
+ * (except backslash). Such chars need no encoding and every char is one cell
+ * in all locales. The @len is the number of bytes to check, the @s has to have
+ * @len bytes at least.
+ *
+ * The string is tested per 16 (SSE2) or 8 bytes, it's cheap for long ASCII
+ * strings.
+ */
+size_t mbs_printable_ascii_span(const char *s, size_t len)
+{
+	const unsigned char *p = (const unsigned char *) s;
+	size_t i = 0;
+
+	if (!s)
+		return 0;
+
+#ifdef HAVE_MBS_SPAN_SSE2
+	for (; i + sizeof(__m128i) <= len; i += sizeof(__m128i)) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (p + i));
+		/* the signed compare is fine, non-ASCII bytes are negative */
+		__m128i ok = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(0x1f)),
+					   _mm_cmplt_epi8(x, _mm_set1_epi8(0x7f)));
+		unsigned int mask;
+
+		ok = _mm_andnot_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\\')), ok);
+		mask = _mm_movemask_epi8(ok);
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+#endif
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t x;
+
+		memcpy(&x, p + i, sizeof(x));
+		if (word_hasless(x, 0x20) || word_hasmore(x, 0x7e)
+		    || word_hasbyte(x, '\\'))
+			break;
+	}
+	for (; i < len; i++) {
+		if (p[i] < 0x20 || p[i] > 0x7e || p[i] == '\\')
+			break;
+	}
+	return i;
+}
+
 /*
  * Counts number of cells in multibyte string. All control and
  * non-printable chars are ignored.
@@ -66,12 +129,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 
 		if (len == 0)
 			break;
-		if (len > 0 && iswprint(wc)) {
+		if (len == (size_t) -1 || len == (size_t) -2)
+			len = 1;
+		else if (iswprint(wc)) {
 			int x = wcwidth(wc);
 			if (x > 0)
 				width += x;
-		} else if (len == (size_t) -1 || len == (size_t) -2)
-			len = 1;
+		}
 		p += len;
 #else
 		if (isprint((unsigned char) *p))
@@ -85,9 +149,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 
 size_t mbs_width(const char *s)
 {
+	size_t sz, n;
+
 	if (!s || !*s)
 		return 0;
-	return mbs_nwidth(s, strlen(s));
+	sz = strlen(s);
+	n = mbs_printable_ascii_span(s, sz);
+	return n == sz ? sz : n + mbs_nwidth(s + n, sz - n);
 }
 
 /*
@@ -110,6 +178,14 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		if (is_safe_ascii(*p)) {
+			/* ASCII run, one byte is one cell */
+			size_t n = mbs_printable_ascii_span(p, last - p + 1);
+
+			width += n, bytes += n;
+			p += n;
+			continue;
+		}
 		if ((p < last && *p == '\\' && *(p + 1) == 'x')
 		    || iscntrl((unsigned char) *p)) {
 			width += 4, bytes += 4;		/* *p encoded to \x?? */
@@ -157,9 +233,13 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 
 size_t mbs_safe_width(const char *s)
 {
+	size_t sz, n;
+
 	if (!s || !*s)
 		return 0;
-	return mbs_safe_nwidth(s, strlen(s), NULL);
+	sz = strlen(s);
+	n = mbs_printable_ascii_span(s, sz);
+	return n == sz ? sz : n + mbs_safe_nwidth(s + n, sz - n, NULL);
 }
 
 /*
@@ -172,9 +252,10 @@ size_t mbs_safe_width(const char *s)
  */
 char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf, const char *safechars)
 {
-	const char *p = s;
+	const char *p = s, *c;
 	char *r;
 	size_t sz = s ? strlen(s) : 0;
+	bool fast = true;
 
 #ifdef HAVE_WIDECHAR
 	mbstate_t st;
@@ -183,10 +264,31 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf, const c
 	if (!sz || !buf)
 		return NULL;
 
-	r = buf;
-	*width = 0;
+	/* the ASCII runs may be copied at once, unless the @safechars
+	 * (not counted in @width) are printable ASCII chars too */
+	for (c = safechars; c && *c && fast; c++)
+		fast = !is_safe_ascii(*c);
+
+	/* ASCII prefix, nothing to encode (the @safechars are not counted
+	 * in @width, so stop on them too) */
+	*width = mbs_printable_ascii_span(s, sz);
+	if (!fast)
+		*width = min(*width, strcspn(s, safechars));
+	memcpy(buf, s, *width);
+	p += *width;
+	r = buf + *width;
 
 	while (p && *p) {
+		if (fast && is_safe_ascii(*p)) {
+			/* ASCII run, nothing to encode */
+			size_t n = mbs_printable_ascii_span(p, sz - (p - s));
+
+			memcpy(r, p, n);
+			r += n;
+			p += n;
+			*width += n;
+			continue;
+		}
 		if (safechars && strchr(safechars, *p)) {
 			*r++ = *p++;
 			continue;
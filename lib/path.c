@@ -33,6 +33,9 @@
 static UL_DEBUG_DEFINE_MASK(ulpath);
 UL_DEBUG_DEFINE_MASKNAMES(ulpath) = UL_DEBUG_EMPTY_MASKNAMES;
 
+/* buffer for files with a number (or maj:min) */
+#define UL_PATH_NUMBUFSZ	128
+
 #define ULPATH_DEBUG_INIT	(1 << 1)
 #define ULPATH_DEBUG_CXT	(1 << 2)
 
@@ -135,10 +138,7 @@ int ul_path_set_dir(struct path_cxt *pc, const char *dir)
 			return -ENOMEM;
 	}
 
-	if (pc->dir_fd >= 0) {
-		close(pc->dir_fd);
-		pc->dir_fd = -1;
-	}
+	ul_path_close_dirfd(pc);
 
 	free(pc->dir_path);
 	pc->dir_path = p;
@@ -226,11 +226,30 @@ int ul_path_get_dirfd(struct path_cxt *pc)
 	return pc->dir_fd;
 }
 
+static void free_subdirs(struct path_cxt *pc)
+{
+	size_t i;
+
+	for (i = 0; i < pc->nsubdirs; i++) {
+		struct ul_path_subdir *sub = &pc->subdirs[i];
+
+		if (sub->fd >= 0)
+			close(sub->fd);
+		free(sub->name);
+	}
+	pc->nsubdirs = 0;
+	pc->subdirs_next = 0;
+}
+
 /* Note that next ul_path_get_dirfd() will reopen the directory */
 void ul_path_close_dirfd(struct path_cxt *pc)
 {
 	assert(pc);
 
+	if (pc->nsubdirs) {
+		DBG(CXT, ul_debugobj(pc, "closing subdirs"));
+		free_subdirs(pc);
+	}
 	if (pc->dir_fd >= 0) {
 		DBG(CXT, ul_debugobj(pc, "closing dir"));
 		close(pc->dir_fd);
@@ -243,6 +262,68 @@ int ul_path_isopen_dirfd(struct path_cxt *pc)
 	return pc && pc->dir_fd >= 0;
 }
 
+/*
+ * Keep open file descriptors for subdirectories (e.g. "queue" for
+ * "queue/rotational"), so the next open in the same subdirectory does not
+ * need to resolve the whole path. This is useful for sysfs, where a lot of
+ * small files is read from a few directories. The descriptors are closed
+ * by ul_path_close_dirfd(), and it's up to the caller to care about number
+ * of open files (up to UL_PATH_NSUBDIRS per context).
+ */
+void ul_path_enable_subdirs(struct path_cxt *pc, int enable)
+{
+	assert(pc);
+
+	if (!enable && pc->nsubdirs)
+		free_subdirs(pc);
+	pc->cache_subdirs = enable ? 1 : 0;
+}
+
+/*
+ * Returns file descriptor for the directory part of the @path (relative to
+ * @dir), or -1 if the path has no directory part or the directory does not
+ * exist. The @name is set to the last path component.
+ */
+static int get_subdir_fd(struct path_cxt *pc, int dir, const char *path, const char **name)
+{
+	struct ul_path_subdir *sub;
+	const char *p = strrchr(path, '/');
+	char *subname;
+	size_t i, sz;
+
+	if (!p || p == path || !*(p + 1))
+		return -1;
+	sz = p - path;
+
+	for (i = 0; i < pc->nsubdirs; i++) {
+		sub = &pc->subdirs[i];
+		if (strncmp(sub->name, path, sz) == 0 && sub->name[sz] == '\0')
+			goto found;
+	}
+
+	subname = strndup(path, sz);
+	if (!subname)
+		return -1;
+
+	/* add a new entry or replace the oldest one */
+	if (pc->nsubdirs < UL_PATH_NSUBDIRS)
+		sub = &pc->subdirs[pc->nsubdirs++];
+	else {
+		sub = &pc->subdirs[pc->subdirs_next];
+		pc->subdirs_next = (pc->subdirs_next + 1) % UL_PATH_NSUBDIRS;
+		if (sub->fd >= 0)
+			close(sub->fd);
+		free(sub->name);
+	}
+	sub->name = subname;
+	sub->fd = openat(dir, sub->name, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	DBG(CXT, ul_debugobj(pc, "opening subdir '%s' [fd=%d]", sub->name, sub->fd));
+found:
+	if (sub->fd >= 0)
+		*name = p + 1;
+	return sub->fd;
+}
+
 static const char *ul_path_mkpath(struct path_cxt *pc, const char *path, va_list ap)
 {
 	int rc;
@@ -381,7 +462,15 @@ int ul_path_open(struct path_cxt *pc, int flags, const char *path)
 		if (*path == '/')
 			path++;
 
-		fdx = fd = openat(dir, path, flags);
+		if (pc->cache_subdirs) {
+			const char *name = NULL;
+			int sub = get_subdir_fd(pc, dir, path, &name);
+
+			fdx = fd = sub >= 0 ?
+				openat(sub, name, flags) :
+				openat(dir, path, flags);
+		} else
+			fdx = fd = openat(dir, path, flags);
 
 		if (fd < 0 && errno == ENOENT
 		    && pc->redirect_on_enoent
@@ -663,6 +752,55 @@ int ul_path_readf_string(struct path_cxt *pc, char **str, const char *path, ...)
 	return !p ? -errno : ul_path_read_string(pc, str, p);
 }
 
+/*
+ * Reads files @paths[] to newly allocated strings @res[] (see
+ * ul_path_read_string()), the result is NULL for missing and empty files.
+ * All files are read by one buffer, and the subdirectories are cached
+ * during the call (see ul_path_enable_subdirs()).
+ *
+ * Returns number of the read files, or negative errno.
+ */
+int ul_path_read_strings(struct path_cxt *pc, const char * const *paths, char **res, size_t n)
+{
+	char buf[BUFSIZ];
+	size_t i;
+	int count = 0, cached;
+
+	if (!paths || !res)
+		return -EINVAL;
+
+	cached = pc && pc->cache_subdirs;
+	if (pc)
+		ul_path_enable_subdirs(pc, 1);
+
+	for (i = 0; i < n; i++) {
+		int rc;
+
+		res[i] = NULL;
+		rc = ul_path_read(pc, buf, sizeof(buf) - 1, paths[i]);
+		if (rc > 0 && *(buf + rc - 1) == '\n')
+			--rc;
+		if (rc <= 0)
+			continue;
+
+		buf[rc] = '\0';
+		res[i] = strdup(buf);
+		if (!res[i]) {
+			while (i > 0) {
+				free(res[--i]);
+				res[i] = NULL;
+			}
+			count = -ENOMEM;
+			break;
+		}
+		count++;
+	}
+
+	if (pc && !cached)
+		ul_path_enable_subdirs(pc, 0);
+	return count;
+}
+
 int ul_path_read_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const char *path)
 {
 	int rc = ul_path_read(pc, buf, bufsz - 1, path);
@@ -732,12 +870,29 @@ int ul_path_scanff(struct path_cxt *pc, const char *path, va_list ap, const char
 }
 
 
+/*
+ * Reads a short file (number, devno, ...) into @buf and terminates it. This
+ * is cheaper than ul_path_scanf(), no FILE is allocated.
+ */
+static int read_number_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const char *path)
+{
+	int rc = ul_path_read(pc, buf, bufsz - 1, path);
+
+	if (rc < 0)
+		return rc;
+	buf[rc] = '\0';
+	return 0;
+}
+
 int ul_path_read_s64(struct path_cxt *pc, int64_t *res, const char *path)
 {
+	char buf[UL_PATH_NUMBUFSZ];
 	int64_t x = 0;
 	int rc;
 
-	rc = ul_path_scanf(pc, path, "%"SCNd64, &x);
+	if (read_number_buffer(pc, buf, sizeof(buf), path) != 0)
+		return -1;
+	rc = sscanf(buf, "%"SCNd64, &x);
 	if (rc != 1)
 		return -1;
 	if (res)
@@ -759,10 +914,13 @@ int ul_path_readf_s64(struct path_cxt *pc, int64_t *res, const char *path, ...)
 
 int ul_path_read_u64(struct path_cxt *pc, uint64_t *res, const char *path)
 {
+	char buf[UL_PATH_NUMBUFSZ];
 	uint64_t x = 0;
 	int rc;
 
-	rc = ul_path_scanf(pc, path, "%"SCNu64, &x);
+	if (read_number_buffer(pc, buf, sizeof(buf), path) != 0)
+		return -1;
+	rc = sscanf(buf, "%"SCNu64, &x);
 	if (rc != 1)
 		return -1;
 	if (res)
@@ -784,9 +942,12 @@ int ul_path_readf_u64(struct path_cxt *pc, uint64_t *res, const char *path, ...)
 
 int ul_path_read_s32(struct path_cxt *pc, int *res, const char *path)
 {
+	char buf[UL_PATH_NUMBUFSZ];
 	int rc, x = 0;
 
-	rc = ul_path_scanf(pc, path, "%d", &x);
+	if (read_number_buffer(pc, buf, sizeof(buf), path) != 0)
+		return -1;
+	rc = sscanf(buf, "%d", &x);
 	if (rc != 1)
 		return -1;
 	if (res)
@@ -808,10 +969,13 @@ int ul_path_readf_s32(struct path_cxt *pc, int *res, const char *path, ...)
 
 int ul_path_read_u32(struct path_cxt *pc, unsigned int *res, const char *path)
 {
+	char buf[UL_PATH_NUMBUFSZ];
 	int rc;
 	unsigned int x;
 
-	rc = ul_path_scanf(pc, path, "%u", &x);
+	if (read_number_buffer(pc, buf, sizeof(buf), path) != 0)
+		return -1;
+	rc = sscanf(buf, "%u", &x);
 	if (rc != 1)
 		return -1;
 	if (res)
@@ -833,9 +997,12 @@ int ul_path_readf_u32(struct path_cxt *pc, unsigned int *res, const char *path,
 
 int ul_path_read_majmin(struct path_cxt *pc, dev_t *res, const char *path)
 {
+	char buf[UL_PATH_NUMBUFSZ];
 	int rc, maj, min;
 
-	rc = ul_path_scanf(pc, path, "%d:%d", &maj, &min);
+	if (read_number_buffer(pc, buf, sizeof(buf), path) != 0)
+		return -1;
+	rc = sscanf(buf, "%d:%d", &maj, &min);
 	if (rc != 2)
 		return -1;
 	if (res)
@@ -1072,6 +1239,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" read-string <file>         read string  from file\n", stdout);
 	fputs(" read-majmin <file>         read devno from file\n", stdout);
 	fputs(" read-link <file>           read symlink\n", stdout);
+	fputs(" read-strings <file> ...    read strings from files\n", stdout);
 	fputs(" write-string <file> <str>  write string from file\n", stdout);
 	fputs(" write-u64 <file> <str>     write uint64_t from file\n", stdout);
 
@@ -1224,6 +1392,24 @@ int main(int argc, char *argv[])
 			err(EXIT_FAILURE, "readf symlink failed");
 		printf("readf: %s: %s\n", file, res);
 
+	} else if (strcmp(command, "read-strings") == 0) {
+		size_t i, n = argc - optind;
+		char **res;
+
+		if (!n)
+			errx(EXIT_FAILURE, "<file> not defined");
+		res = calloc(n, sizeof(char *));
+		if (!res)
+			err(EXIT_FAILURE, "cannot allocate");
+
+		if (ul_path_read_strings(pc, (const char * const *) &argv[optind], res, n) < 0)
+			err(EXIT_FAILURE, "read strings failed");
+		for (i = 0; i < n; i++) {
+			printf("read:  %s: %s\n", argv[optind + i], res[i] ? res[i] : "<none>");
+			free(res[i]);
+		}
+		free(res);
+
 	} else if (strcmp(command, "write-string") == 0) {
 		char *str;
 
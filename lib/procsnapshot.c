@@ -0,0 +1,459 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * procsnapshot.c: read selected attributes of many processes in one pass.
+ *
+ * The engine opens /proc once and all the per-process files are opened
+ * relative to the /proc/<pid> directory file descriptor. The common fields
+ * (uid, ppid, state and command name) are read by the engine, everything
+ * else is up to the optional per-process reader callback. For large number
+ * of processes the entries may be read by more threads; the reader has to be
+ * thread-safe if the threads are enabled.
+ *
+ * The snapshot is separated from procutils.c to keep the pthread dependence
+ * out of the other procutils users.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <ctype.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#include "procutils.h"
+#include "all-io.h"
+#include "c.h"
+
+/* use threads for at least this number of processes */
+#define PROC_SNAP_PARALLEL_MIN		256
+#define PROC_SNAP_PARALLEL_MAXTHREADS	16
+#define PROC_SNAP_PARALLEL_CHUNK	32
+
+struct proc_snapshot {
+	int			procfd;		/* /proc */
+	int			fields;		/* PROC_SNAP_* */
+
+	struct proc_entry	*ents;		/* sorted by PID */
+	size_t			nents;
+	size_t			nalloc;
+
+	proc_snapshot_reader	reader;		/* caller's callback */
+	void			*reader_data;
+
+	unsigned int		threads : 1;	/* parallel read allowed */
+};
+
+/*
+ * @fields: PROC_SNAP_* mask of the attributes to read
+ *
+ * Returns: new snapshot or NULL on error
+ */
+struct proc_snapshot *proc_new_snapshot(int fields)
+{
+	struct proc_snapshot *ps;
+
+	ps = calloc(1, sizeof(*ps));
+	if (!ps)
+		return NULL;
+
+	ps->procfd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (ps->procfd < 0) {
+		free(ps);
+		return NULL;
+	}
+	ps->fields = fields;
+	return ps;
+}
+
+/*
+ * Note that proc_entry->data is owned by the caller.
+ */
+void proc_free_snapshot(struct proc_snapshot *ps)
+{
+	size_t i;
+
+	if (!ps)
+		return;
+	for (i = 0; i < ps->nents; i++)
+		free(ps->ents[i].comm);
+	free(ps->ents);
+	if (ps->procfd >= 0)
+		close(ps->procfd);
+	free(ps);
+}
+
+/*
+ * @fn: called for every process with the /proc/<pid> directory fd
+ * @data: private data for @fn
+ *
+ * The reader returns 0 on success; -ENOENT, -ESRCH and -EACCES mark the entry
+ * as invalid (process is gone or not accessible), other errors stop the read.
+ */
+void proc_snapshot_set_reader(struct proc_snapshot *ps,
+			      proc_snapshot_reader fn, void *data)
+{
+	ps->reader = fn;
+	ps->reader_data = data;
+}
+
+/*
+ * Allows to read the processes by more threads. It's used only if the library
+ * has been compiled with pthreads and there is enough processes.
+ */
+void proc_snapshot_enable_threads(struct proc_snapshot *ps, int enable)
+{
+	ps->threads = enable ? 1 : 0;
+}
+
+/*
+ * Adds @pid to the snapshot. If no PID is added, then proc_snapshot_read()
+ * reads all processes from /proc.
+ */
+int proc_snapshot_add_pid(struct proc_snapshot *ps, pid_t pid)
+{
+	if (ps->nents == ps->nalloc) {
+		size_t n = ps->nalloc ? ps->nalloc * 2 : 64;
+		struct proc_entry *tmp;
+
+		tmp = realloc(ps->ents, n * sizeof(struct proc_entry));
+		if (!tmp)
+			return -ENOMEM;
+		ps->ents = tmp;
+		ps->nalloc = n;
+	}
+
+	memset(&ps->ents[ps->nents], 0, sizeof(struct proc_entry));
+	ps->ents[ps->nents++].pid = pid;
+	return 0;
+}
+
+static int scan_pids(struct proc_snapshot *ps)
+{
+	struct dirent *d;
+	DIR *dir;
+	int fd, rc = 0;
+
+	/* readdir() needs its own file position */
+	fd = openat(ps->procfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	dir = fdopendir(fd);
+	if (!dir) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+
+	while (rc == 0 && (d = readdir(dir))) {
+		char *end = NULL;
+		long num;
+
+		if (!isdigit((unsigned char) *d->d_name))
+			continue;
+		errno = 0;
+		num = strtol(d->d_name, &end, 10);
+		if (errno || end == d->d_name || *end || num <= 0)
+			continue;
+		rc = proc_snapshot_add_pid(ps, (pid_t) num);
+	}
+
+	closedir(dir);
+	return rc;
+}
+
+static int cmp_entries(const void *a, const void *b)
+{
+	pid_t x = ((const struct proc_entry *) a)->pid,
+	      y = ((const struct proc_entry *) b)->pid;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* sort and remove duplicate PIDs */
+static void sort_entries(struct proc_snapshot *ps)
+{
+	size_t i, n;
+
+	if (ps->nents < 2)
+		return;
+
+	qsort(ps->ents, ps->nents, sizeof(struct proc_entry), cmp_entries);
+
+	for (i = 1, n = 1; i < ps->nents; i++) {
+		if (ps->ents[i].pid != ps->ents[n - 1].pid)
+			ps->ents[n++] = ps->ents[i];
+	}
+	ps->nents = n;
+}
+
+/*
+ * The command name is stored in the stat file too, so it's parsed from there
+ * rather than to open the comm file.
+ */
+static int read_stat(int dir, struct proc_snapshot *ps, struct proc_entry *e)
+{
+	char buf[BUFSIZ], *op, *cl;
+	ssize_t sz;
+	int fd;
+
+	fd = openat(dir, "stat", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	sz = read_all(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (sz <= 0)
+		return sz < 0 ? -errno : -EINVAL;
+	buf[sz] = '\0';
+
+	op = strchr(buf, '(');
+	cl = strrchr(buf, ')');
+	if (!op || !cl || cl < op)
+		return -EINVAL;
+
+	if ((ps->fields & PROC_SNAP_STAT)
+	    && sscanf(cl, ") %c %d", &e->state, &e->ppid) != 2)
+		return -EINVAL;
+
+	if (ps->fields & PROC_SNAP_COMM) {
+		e->comm = strndup(op + 1, cl - op - 1);
+		if (!e->comm)
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+/* returns 0 for valid and ignored entries, <0 on fatal error */
+static int read_entry(struct proc_snapshot *ps, struct proc_entry *e)
+{
+	char name[32];
+	int fd, rc = 0;
+
+	snprintf(name, sizeof(name), "%d", (int) e->pid);
+	fd = openat(ps->procfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		rc = -errno;
+		goto done;
+	}
+
+	if (ps->fields & PROC_SNAP_UID) {
+		struct stat st;
+
+		if (fstat(fd, &st) != 0) {
+			rc = -errno;
+			goto done;
+		}
+		e->uid = st.st_uid;
+	}
+
+	if (ps->fields & (PROC_SNAP_STAT | PROC_SNAP_COMM)) {
+		rc = read_stat(fd, ps, e);
+		if (rc)
+			goto done;
+	}
+
+	if (ps->reader)
+		rc = ps->reader(ps, e, fd, ps->reader_data);
+done:
+	if (fd >= 0)
+		close(fd);
+	if (rc == 0)
+		e->valid = 1;
+	else {
+		free(e->comm);
+		e->comm = NULL;
+	}
+
+	if (rc == -ENOENT || rc == -ESRCH || rc == -EACCES)
+		rc = 0;
+	return rc;
+}
+
+#ifdef HAVE_LIBPTHREAD
+struct proc_snap_workers {
+	struct proc_snapshot	*ps;
+
+	pthread_mutex_t		lock;	/* protects @next and @rc */
+	size_t			next;
+	int			rc;
+};
+
+static void *proc_snap_worker(void *data)
+{
+	struct proc_snap_workers *wrk = data;
+	struct proc_snapshot *ps = wrk->ps;
+
+	for (;;) {
+		size_t i, from, to;
+		int rc = 0;
+
+		pthread_mutex_lock(&wrk->lock);
+		if (wrk->rc || wrk->next >= ps->nents) {
+			pthread_mutex_unlock(&wrk->lock);
+			break;
+		}
+		from = wrk->next;
+		to = min(from + PROC_SNAP_PARALLEL_CHUNK, ps->nents);
+		wrk->next = to;
+		pthread_mutex_unlock(&wrk->lock);
+
+		for (i = from; rc == 0 && i < to; i++)
+			rc = read_entry(ps, &ps->ents[i]);
+
+		if (rc) {
+			pthread_mutex_lock(&wrk->lock);
+			if (!wrk->rc)
+				wrk->rc = rc;
+			pthread_mutex_unlock(&wrk->lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns 1 if the entries have been read by threads, or 0 if the caller has
+ * to read them.
+ */
+static int read_entries_parallel(struct proc_snapshot *ps, int *rc)
+{
+	struct proc_snap_workers wrk = { .ps = ps };
+	pthread_t *threads;
+	size_t i, nthreads, nrun;
+	long ncpus;
+
+	if (!ps->threads || ps->nents < PROC_SNAP_PARALLEL_MIN)
+		return 0;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus < 2)
+		return 0;
+	nthreads = min((size_t) ncpus, (size_t) PROC_SNAP_PARALLEL_MAXTHREADS);
+
+	threads = calloc(nthreads, sizeof(pthread_t));
+	if (!threads)
+		return 0;
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, proc_snap_worker, &wrk) != 0)
+			break;
+	}
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+
+	if (!nrun)
+		return 0;	/* no thread started, read it serially */
+	*rc = wrk.rc;
+	return 1;
+}
+#else
+static int read_entries_parallel(
+			struct proc_snapshot *ps __attribute__((__unused__)),
+			int *rc __attribute__((__unused__)))
+{
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
+/*
+ * Reads the added PIDs, or all processes if no PID has been added. The
+ * entries are sorted by PID; use proc_entry->valid to check whether the
+ * process has been successfully read.
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int proc_snapshot_read(struct proc_snapshot *ps)
+{
+	size_t i;
+	int rc = 0;
+
+	if (!ps->nents) {
+		rc = scan_pids(ps);
+		if (rc)
+			return rc;
+	}
+	sort_entries(ps);
+
+	if (!read_entries_parallel(ps, &rc)) {
+		for (i = 0; rc == 0 && i < ps->nents; i++)
+			rc = read_entry(ps, &ps->ents[i]);
+	}
+	return rc;
+}
+
+size_t proc_snapshot_get_nentries(struct proc_snapshot *ps)
+{
+	return ps->nents;
+}
+
+struct proc_entry *proc_snapshot_get_entry(struct proc_snapshot *ps, size_t idx)
+{
+	return idx < ps->nents ? &ps->ents[idx] : NULL;
+}
+
+/*
+ * Returns: the entry for @pid (valid or not), or NULL if not in snapshot.
+ */
+struct proc_entry *proc_snapshot_find(struct proc_snapshot *ps, pid_t pid)
+{
+	struct proc_entry key = { .pid = pid };
+
+	if (!ps->nents)
+		return NULL;
+	return bsearch(&key, ps->ents, ps->nents,
+		       sizeof(struct proc_entry), cmp_entries);
+}
+
+#ifdef TEST_PROGRAM_PROCSNAPSHOT
+int main(int argc, char *argv[])
+{
+	struct proc_snapshot *ps;
+	size_t i;
+	int rc, c;
+
+	ps = proc_new_snapshot(PROC_SNAP_UID | PROC_SNAP_STAT | PROC_SNAP_COMM);
+	if (!ps)
+		err(EXIT_FAILURE, "cannot open /proc");
+
+	while ((c = getopt(argc, argv, "t")) != -1) {
+		switch (c) {
+		case 't':
+			proc_snapshot_enable_threads(ps, 1);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t] [<pid> ...]\n",
+					program_invocation_short_name);
+			return EXIT_FAILURE;
+		}
+	}
+	for (; optind < argc; optind++)
+		proc_snapshot_add_pid(ps, (pid_t) atoi(argv[optind]));
+
+	rc = proc_snapshot_read(ps);
+	if (rc)
+		errx(EXIT_FAILURE, "read failed: %s", strerror(-rc));
+
+	for (i = 0; i < proc_snapshot_get_nentries(ps); i++) {
+		struct proc_entry *e = proc_snapshot_get_entry(ps, i);
+
+		if (!e->valid)
+			continue;
+		printf("%8d %8d %c %6u %s\n", (int) e->pid, (int) e->ppid,
+				e->state, (unsigned) e->uid, e->comm);
+	}
+
+	proc_free_snapshot(ps);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_PROCSNAPSHOT */
@@ -16,6 +16,9 @@
 #ifdef __linux__
 #include <sys/syscall.h>
 #endif
+#ifdef HAVE_PTHREAD_ATFORK
+#include <pthread.h>
+#endif
 #include "c.h"
 #include "randutils.h"
 #include "nls.h"
@@ -163,9 +166,14 @@ int ul_random_get_bytes(void *buf, size_t nbytes)
 		}
 	}
 	/*
-	 * We do this all the time, but this is the only source of
-	 * randomness if /dev/random/urandom is out to lunch.
+	 * This is the only source of randomness if getrandom() and
+	 * /dev/random/urandom are out to lunch. It's expensive (two libc
+	 * PRNG calls for every byte) and it adds nothing to the kernel
+	 * random bytes, so don't do it if we have them.
 	 */
+	if (n == 0)
+		return 0;
+
 	crank_random();
 	for (cp = buf, i = 0; i < nbytes; i++)
 		*cp++ ^= (rand() >> 7) & 0xFF;
@@ -186,6 +194,129 @@ int ul_random_get_bytes(void *buf, size_t nbytes)
 	return n != 0;
 }
 
+/*
+ * The random bytes of the pool are read in large chunks to a per-thread
+ * buffer, ul_random_get_bytes() is expensive for small requests (getrandom()
+ * or more syscalls for every call). The buffer has to be dropped after
+ * fork(), otherwise the parent and the child would return the same bytes.
+ */
+#define UL_RANDOM_POOLSZ	4096
+
+struct ul_random_pool {
+	unsigned char	data[UL_RANDOM_POOLSZ];
+	size_t		used;		/* already used bytes in data[] */
+	int		weak;		/* data[] is not high-quality randomness */
+#ifdef HAVE_PTHREAD_ATFORK
+	unsigned int	generation;
+#endif
+	pid_t		pid;
+};
+
+THREAD_LOCAL struct ul_random_pool random_pool = {
+	.used = UL_RANDOM_POOLSZ
+};
+
+#ifdef HAVE_PTHREAD_ATFORK
+static volatile unsigned int fork_generation = 1;
+static volatile int atfork_registered;
+
+static void random_pool_atfork(void)
+{
+	fork_generation++;
+}
+
+/*
+ * The fork handlers are not called for a child created by raw clone(), so
+ * the process ID is checked too.
+ */
+static int random_pool_is_forked(struct ul_random_pool *pl)
+{
+	pid_t pid = getpid();
+
+	if (!atfork_registered) {
+		/* it does not matter if more threads register the handler */
+		atfork_registered = 1;
+		pthread_atfork(NULL, NULL, random_pool_atfork);
+	}
+	if (pl->generation != fork_generation || pl->pid != pid) {
+		pl->generation = fork_generation;
+		pl->pid = pid;
+		return 1;
+	}
+	return 0;
+}
+#else
+static int random_pool_is_forked(struct ul_random_pool *pl)
+{
+	pid_t pid = getpid();
+
+	if (pl->pid != pid) {
+		pl->pid = pid;
+		return 1;
+	}
+	return 0;
+}
+#endif
+
+/*
+ * Drop the unused bytes of the pool of the current thread. It's not
+ * necessary after fork() or clone() (that's detected), but it's useful if
+ * the bytes should not stay in memory.
+ */
+void ul_random_pool_clear(void)
+{
+	struct ul_random_pool *pl = &random_pool;
+
+	memset(pl->data, 0, sizeof(pl->data));
+	pl->used = UL_RANDOM_POOLSZ;
+}
+
+/*
+ * Write @nbytes random bytes from the per-thread pool into @buf. The large
+ * requests (bulk) are read directly to @buf, only the rest is copied from the
+ * pool.
+ *
+ * Returns 0 for good quality of random bytes or 1 for weak quality.
+ */
+int ul_random_pool_get_bytes(void *buf, size_t nbytes)
+{
+	struct ul_random_pool *pl = &random_pool;
+	unsigned char *cp = (unsigned char *) buf;
+	int rc = 0;
+
+	if (random_pool_is_forked(pl))
+		ul_random_pool_clear();
+
+	while (nbytes) {
+		size_t sz;
+
+		if (pl->used == UL_RANDOM_POOLSZ) {
+			if (nbytes >= UL_RANDOM_POOLSZ) {
+				/* large request, don't copy via pool */
+				sz = nbytes - (nbytes % UL_RANDOM_POOLSZ);
+				if (ul_random_get_bytes(cp, sz))
+					rc = 1;
+				cp += sz;
+				nbytes -= sz;
+				continue;
+			}
+			pl->weak = ul_random_get_bytes(pl->data, sizeof(pl->data));
+			pl->used = 0;
+		}
+
+		sz = min(nbytes, UL_RANDOM_POOLSZ - pl->used);
+		memcpy(cp, pl->data + pl->used, sz);
+		/* don't keep already returned bytes in memory */
+		memset(pl->data + pl->used, 0, sz);
+		pl->used += sz;
+		cp += sz;
+		nbytes -= sz;
+		if (pl->weak)
+			rc = 1;
+	}
+
+	return rc;
+}
 
 /*
  * Tell source of randomness.
@@ -240,6 +371,12 @@ int main(int argc, char *argv[])
 		printf("#%02zu: %25"PRIu64"\n", i, *vp);
 	}
 
+	printf("Multiple pool calls:\n");
+	for (i = 0; i < n; i++) {
+		ul_random_pool_get_bytes(&v, sizeof(v));
+		printf("#%02zu: %25"PRIu64"\n", i, v);
+	}
+
 	return EXIT_SUCCESS;
 }
 #endif /* TEST_PROGRAM_RANDUTILS */
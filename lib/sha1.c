@@ -6,6 +6,9 @@
  * 1) "abc": A9993E36 4706816A BA3E2571 7850C26C 9CD0D89D
  * 2) "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq":  84983E44 1C3BD26E BAAE4AA1 F95129E5 E54670F1
  * 3) A million repetitions of "a":  34AA973C D4C4DAA4 F61EEB2B DBAD2731 6534016F
+ *
+ * The SHA extensions (x86_64) or the ARMv8 crypto extensions are used if
+ * available.
  */
 
 #define UL_SHA1HANDSOFF
@@ -16,6 +19,19 @@
 
 #include "sha1.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+# define HAVE_SHA1_SHANI 1
+# include <immintrin.h>
+# include <cpuid.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+# define HAVE_SHA1_ARM64 1
+# include <arm_neon.h>
+# include <sys/auxv.h>
+# ifndef HWCAP_SHA1
+#  define HWCAP_SHA1	(1 << 5)
+# endif
+#endif
+
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
 /* blk0() and blk() perform the initial expand. */
@@ -38,7 +54,7 @@
 
 /* Hash a single 512-bit block. This is the core of the algorithm. */
 
-void ul_SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
+static void sha1_transform_generic(uint32_t state[5], const unsigned char buffer[64])
 {
 	uint32_t a, b, c, d, e;
 
@@ -159,6 +175,205 @@ void ul_SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
 #endif
 }
 
+static void sha1_blocks_generic(uint32_t state[5], const unsigned char *data, size_t nblocks)
+{
+	for (; nblocks; nblocks--, data += 64)
+		sha1_transform_generic(state, data);
+}
+
+#ifdef HAVE_SHA1_SHANI
+/* four rounds, the next message words are prepared at the same time */
+#define SHANI_ROUNDS4(ein, eout, m0, m1, m2, m3, f) \
+	do { \
+		ein = _mm_sha1nexte_epu32(ein, m0); \
+		eout = abcd; \
+		m1 = _mm_sha1msg2_epu32(m1, m0); \
+		abcd = _mm_sha1rnds4_epu32(abcd, ein, f); \
+		m3 = _mm_sha1msg1_epu32(m3, m0); \
+		m2 = _mm_xor_si128(m2, m0); \
+	} while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_blocks_shani(uint32_t state[5], const unsigned char *data, size_t nblocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e1, m0, m1, m2, m3;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; nblocks; nblocks--, data += 64) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) data), bswap);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16)), bswap);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 32)), bswap);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 48)), bswap);
+
+		/* rounds 0-11, the message schedule is not complete yet */
+		e0 = _mm_add_epi32(e0, m0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		e1 = _mm_sha1nexte_epu32(e1, m1);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		m0 = _mm_sha1msg1_epu32(m0, m1);
+
+		e0 = _mm_sha1nexte_epu32(e0, m2);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		m1 = _mm_sha1msg1_epu32(m1, m2);
+		m0 = _mm_xor_si128(m0, m2);
+
+		/* rounds 12-79 */
+		SHANI_ROUNDS4(e1, e0, m3, m0, m1, m2, 0);
+		SHANI_ROUNDS4(e0, e1, m0, m1, m2, m3, 0);
+		SHANI_ROUNDS4(e1, e0, m1, m2, m3, m0, 1);
+		SHANI_ROUNDS4(e0, e1, m2, m3, m0, m1, 1);
+		SHANI_ROUNDS4(e1, e0, m3, m0, m1, m2, 1);
+		SHANI_ROUNDS4(e0, e1, m0, m1, m2, m3, 1);
+		SHANI_ROUNDS4(e1, e0, m1, m2, m3, m0, 1);
+		SHANI_ROUNDS4(e0, e1, m2, m3, m0, m1, 2);
+		SHANI_ROUNDS4(e1, e0, m3, m0, m1, m2, 2);
+		SHANI_ROUNDS4(e0, e1, m0, m1, m2, m3, 2);
+		SHANI_ROUNDS4(e1, e0, m1, m2, m3, m0, 2);
+		SHANI_ROUNDS4(e0, e1, m2, m3, m0, m1, 2);
+		SHANI_ROUNDS4(e1, e0, m3, m0, m1, m2, 3);
+		SHANI_ROUNDS4(e0, e1, m0, m1, m2, m3, 3);
+		SHANI_ROUNDS4(e1, e0, m1, m2, m3, m0, 3);
+		SHANI_ROUNDS4(e0, e1, m2, m3, m0, m1, 3);
+		SHANI_ROUNDS4(e1, e0, m3, m0, m1, m2, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+static int sha1_has_hw(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+		return 0;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return (ebx & bit_SHA) != 0;
+}
+#endif /* HAVE_SHA1_SHANI */
+
+#ifdef HAVE_SHA1_ARM64
+# ifdef __clang__
+__attribute__((target("sha2")))
+# else
+__attribute__((target("+crypto")))
+# endif
+static void sha1_blocks_arm64(uint32_t state[5], const unsigned char *data, size_t nblocks)
+{
+	static const uint32_t k[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+	uint32x4_t abcd = vld1q_u32(state);
+	uint32_t e = state[4];
+
+	for (; nblocks; nblocks--, data += 64) {
+		uint32x4_t abcd_save = abcd, w[4];
+		uint32_t e_save = e;
+		int i;
+
+		for (i = 0; i < 4; i++)
+			w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+
+		/* 20 times four rounds, w[] is the ring of the next 16 words */
+		for (i = 0; i < 20; i++) {
+			uint32x4_t wk = vaddq_u32(w[i & 3], vdupq_n_u32(k[i / 5]));
+			uint32_t e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+
+			if (i < 5)
+				abcd = vsha1cq_u32(abcd, e, wk);
+			else if (i < 10 || i >= 15)
+				abcd = vsha1pq_u32(abcd, e, wk);
+			else
+				abcd = vsha1mq_u32(abcd, e, wk);
+			e = e_next;
+
+			if (i < 16)
+				w[i & 3] = vsha1su1q_u32(
+					vsha1su0q_u32(w[i & 3], w[(i + 1) & 3], w[(i + 2) & 3]),
+					w[(i + 3) & 3]);
+		}
+		abcd = vaddq_u32(abcd, abcd_save);
+		e += e_save;
+	}
+
+	vst1q_u32(state, abcd);
+	state[4] = e;
+}
+
+static int sha1_has_hw(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+}
+#endif /* HAVE_SHA1_ARM64 */
+
+static void sha1_blocks_dispatch(uint32_t state[5], const unsigned char *data, size_t nblocks);
+
+static void (*sha1_blocks)(uint32_t [5], const unsigned char *, size_t) = sha1_blocks_dispatch;
+
+#if defined(HAVE_SHA1_SHANI) || defined(HAVE_SHA1_ARM64)
+/*
+ * Verifies the accelerated version by the portable version.
+ */
+static int sha1_selftest(void (*fn)(uint32_t [5], const unsigned char *, size_t))
+{
+	uint32_t a[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+	uint32_t b[5];
+	unsigned char buf[3 * 64];
+	size_t i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (unsigned char) (i * 131 + (i >> 3));
+
+	memcpy(b, a, sizeof(b));
+	sha1_blocks_generic(a, buf, 3);
+	fn(b, buf, 3);
+	return memcmp(a, b, sizeof(a)) == 0 ? 0 : -1;
+}
+#endif
+
+/*
+ * Selects the implementation. The function may be called by more threads at
+ * the same time, but the result is always the same.
+ */
+static void sha1_init(void)
+{
+	void (*fn)(uint32_t [5], const unsigned char *, size_t) = NULL;
+
+#if defined(HAVE_SHA1_SHANI)
+	if (sha1_has_hw() && sha1_selftest(sha1_blocks_shani) == 0)
+		fn = sha1_blocks_shani;
+#elif defined(HAVE_SHA1_ARM64)
+	if (sha1_has_hw() && sha1_selftest(sha1_blocks_arm64) == 0)
+		fn = sha1_blocks_arm64;
+#endif
+	if (!fn)
+		fn = sha1_blocks_generic;
+	sha1_blocks = fn;
+}
+
+static void sha1_blocks_dispatch(uint32_t state[5], const unsigned char *data, size_t nblocks)
+{
+	sha1_init();
+	sha1_blocks(state, data, nblocks);
+}
+
+void ul_SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
+{
+	sha1_blocks(state, buffer, 1);
+}
+
 /* SHA1Init - Initialize new context */
 
 void ul_SHA1Init(UL_SHA1_CTX *context)
@@ -186,10 +401,16 @@ void ul_SHA1Update(UL_SHA1_CTX *context, const unsigned char *data, uint32_t len
 	context->count[1] += (len >> 29);
 	j = (j >> 3) & 63;
 	if ((j + len) > 63) {
+		uint32_t n;
+
 		memcpy(&context->buffer[j], data, (i = 64 - j));
-		ul_SHA1Transform(context->state, context->buffer);
-		for (; i + 63 < len; i += 64) {
-			ul_SHA1Transform(context->state, &data[i]);
+		sha1_blocks(context->state, context->buffer, 1);
+
+		/* all the complete blocks at once */
+		n = (len - i) / 64;
+		if (n) {
+			sha1_blocks(context->state, &data[i], n);
+			i += n * 64;
 		}
 		j = 0;
 	} else
@@ -201,12 +422,11 @@ void ul_SHA1Update(UL_SHA1_CTX *context, const unsigned char *data, uint32_t len
 
 void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
 {
+	static const unsigned char padding[64] = { 0200 };
 	unsigned i;
 
 	unsigned char finalcount[8];
 
-	unsigned char c;
-
 #if 0				/* untested "improvement" by DHR */
 	/* Convert context->count to a sequence of bytes
 	 * in finalcount.  Second element first, but
@@ -227,12 +447,9 @@ void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
 		finalcount[i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)] >> ((3 - (i & 3)) * 8)) & 255);	/* Endian independent */
 	}
 #endif
-	c = 0200;
-	ul_SHA1Update(context, &c, 1);
-	while ((context->count[0] & 504) != 448) {
-		c = 0000;
-		ul_SHA1Update(context, &c, 1);
-	}
+	/* pad to 56 mod 64 bytes */
+	i = (context->count[0] >> 3) & 63;
+	ul_SHA1Update(context, padding, i < 56 ? 56 - i : 120 - i);
 	ul_SHA1Update(context, finalcount, 8);	/* Should cause a SHA1Transform() */
 	for (i = 0; i < 20; i++) {
 		digest[i] = (unsigned char)
@@ -246,11 +463,9 @@ void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
 void ul_SHA1(char *hash_out, const char *str, unsigned len)
 {
 	UL_SHA1_CTX ctx;
-	unsigned int ii;
 
 	ul_SHA1Init(&ctx);
-	for (ii = 0; ii < len; ii += 1)
-		ul_SHA1Update(&ctx, (const unsigned char *)str + ii, 1);
+	ul_SHA1Update(&ctx, (const unsigned char *)str, len);
 	ul_SHA1Final((unsigned char *)hash_out, &ctx);
 	hash_out[20] = '\0';
 }
@@ -26,6 +26,38 @@ void strutils_set_exitcode(int ex) {
 	STRTOXX_EXIT_CODE = ex;
 }
 
+/*
+ * Hand-rolled parser for plain decimal numbers, the most common input. Returns
+ * 0 on success (@end points after the last digit), 1 if the string is not a
+ * plain decimal number in the @base (the caller should use strto*()), or
+ * -ERANGE on overflow.
+ */
+static int parse_dec_u64(const char *str, int base, uint64_t *num, const char **end)
+{
+	const char *p = str;
+	uint64_t x = 0;
+
+	if (base != 10 && base != 0)
+		return 1;
+	if (*p < '0' || *p > '9')
+		return 1;		/* sign, white-spaces, ... */
+	if (base == 0 && *p == '0'
+	    && ((p[1] >= '0' && p[1] <= '9') || p[1] == 'x' || p[1] == 'X'))
+		return 1;		/* octal or hex */
+
+	for (; *p >= '0' && *p <= '9'; p++) {
+		unsigned int d = *p - '0';
+
+		if (x > (UINT64_MAX - d) / 10)
+			return -ERANGE;
+		x = x * 10 + d;
+	}
+
+	*num = x;
+	*end = p;
+	return 0;
+}
+
 static int do_scale_by_power (uintmax_t *x, int base, int power)
 {
 	while (power--) {
@@ -96,7 +128,21 @@ int parse_size(const char *str, uintmax_t *res, int *power)
 	}
 
 	errno = 0, end = NULL;
-	x = strtoumax(str, &end, 0);
+	{
+		const char *dend;
+		uint64_t num;
+
+		rc = parse_dec_u64(str, 0, &num, &dend);
+		if (rc < 0)
+			goto err;
+		if (rc == 0) {
+			x = num;
+			end = (char *) dend;
+		} else {
+			rc = 0;
+			x = strtoumax(str, &end, 0);
+		}
+	}
 
 	if (end == str ||
 	    (errno != 0 && (x == UINTMAX_MAX || x == 0))) {
@@ -325,10 +371,29 @@ char *strndup(const char *s, size_t n)
 int ul_strtos64(const char *str, int64_t *num, int base)
 {
 	char *end = NULL;
+	const char *dend;
+	uint64_t x;
+	int rc, neg;
 
 	errno = 0;
 	if (str == NULL || *str == '\0')
 		return -EINVAL;
+
+	neg = *str == '-';
+	rc = parse_dec_u64(str + neg, base, &x, &dend);
+	if (rc == 0 && *dend == '\0') {
+		if (x > (uint64_t) INT64_MAX + neg)
+			rc = -ERANGE;
+		else {
+			*num = neg ? (int64_t) -x : (int64_t) x;
+			return 0;
+		}
+	}
+	if (rc < 0) {
+		errno = ERANGE;
+		return -EINVAL;
+	}
+
 	*num = (int64_t) strtoimax(str, &end, base);
 
 	if (errno || str == end || (end && *end))
@@ -339,12 +404,22 @@ int ul_strtos64(const char *str, int64_t *num, int base)
 int ul_strtou64(const char *str, uint64_t *num, int base)
 {
 	char *end = NULL;
+	const char *dend;
 	int64_t tmp;
+	int rc;
 
 	errno = 0;
 	if (str == NULL || *str == '\0')
 		return -EINVAL;
 
+	rc = parse_dec_u64(str, base, num, &dend);
+	if (rc == 0 && *dend == '\0')
+		return 0;
+	if (rc < 0) {
+		errno = ERANGE;
+		return -EINVAL;
+	}
+
 	/* we need to ignore negative numbers, note that for invalid negative
 	 * number strtoimax() returns negative number too, so we do not
 	 * need to check errno here */
@@ -694,36 +769,32 @@ char *size_to_human_string(int options, uint64_t bytes)
 int string_to_idarray(const char *list, int ary[], size_t arysz,
 			int (name2id)(const char *, size_t))
 {
-	const char *begin = NULL, *p;
+	const char *begin;
 	size_t n = 0;
 
 	if (!list || !*list || !ary || !arysz || !name2id)
 		return -1;
 
-	for (p = list; p && *p; p++) {
-		const char *end = NULL;
+	for (begin = list; *begin; ) {
+		const char *end;
 		int id;
 
 		if (n >= arysz)
 			return -2;
-		if (!begin)
-			begin = p;		/* begin of the column name */
-		if (*p == ',')
-			end = p;		/* terminate the name */
-		if (*(p + 1) == '\0')
-			end = p + 1;		/* end of string */
-		if (!begin || !end)
-			continue;
-		if (end <= begin)
+
+		/* terminate the name */
+		for (end = begin; *end && *end != ','; end++);
+		if (end == begin)
 			return -1;
 
 		id = name2id(begin, end - begin);
 		if (id == -1)
 			return -1;
 		ary[ n++ ] = id;
-		begin = NULL;
-		if (end && !*end)
+
+		if (!*end)
 			break;
+		begin = end + 1;
 	}
 	return n;
 }
@@ -1153,6 +1224,38 @@ static int test_strutils_sizes(int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
+static int test_strutils_bench(int argc, char *argv[])
+{
+	struct timespec a, b;
+	unsigned long i, count;
+	uintmax_t size = 0;
+	uint64_t u64 = 0;
+	double ns;
+
+	if (argc < 3)
+		return EXIT_FAILURE;
+
+	count = strtou64_or_err(argv[2], "failed to parse count");
+	if (!count)
+		return EXIT_FAILURE;
+
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (i = 0; i < count; i++)
+		parse_size(argv[1], &size, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	ns = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / count;
+	printf("parse_size:  %-20s %8.1f ns/call\n", argv[1], ns);
+
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (i = 0; i < count; i++)
+		ul_strtou64(argv[1], &u64, 10);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	ns = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / count;
+	printf("ul_strtou64: %-20s %8.1f ns/call\n", argv[1], ns);
+
+	return EXIT_SUCCESS;
+}
+
 static int test_strutils_cmp_paths(int argc, char *argv[])
 {
 	int rc = streq_paths(argv[1], argv[2]);
@@ -1186,6 +1289,9 @@ int main(int argc, char *argv[])
 	if (argc == 3 && strcmp(argv[1], "--size") == 0) {
 		return test_strutils_sizes(argc - 1, argv + 1);
 
+	} else if (argc == 4 && strcmp(argv[1], "--bench") == 0) {
+		return test_strutils_bench(argc - 1, argv + 1);
+
 	} else if (argc == 4 && strcmp(argv[1], "--cmp-paths") == 0) {
 		return test_strutils_cmp_paths(argc - 1, argv + 1);
 
@@ -1221,6 +1327,7 @@ int main(int argc, char *argv[])
 
 	} else {
 		fprintf(stderr, "usage: %1$s --size <number>[suffix]\n"
+				"       %1$s --bench <number>[suffix] <count>\n"
 				"       %1$s --cmp-paths <path> <path>\n"
 				"       %1$s --strdup-member <str> <str>\n"
 				"       %1$s --stralnumcmp <str> <str>\n"
@@ -43,6 +43,210 @@ void ul_sysfs_init_debug(void)
 	__UL_INIT_DEBUG_FROM_ENV(ulsysfs, ULSYSFS_DEBUG_, 0, ULSYSFS_DEBUG);
 }
 
+/*
+ * Process-wide cache of the block devices (devno, name and whole-disk) for
+ * tools which ask for many devices. The cache is populated by one scan of
+ * /sys/dev/block on the first query; all the queries for devices unknown
+ * in the cache are answered from sysfs as without the cache. The cache is
+ * used only for the system root (not for paths with prefix).
+ */
+struct sysfs_devcache_entry {
+	dev_t	devno;
+	dev_t	disk;		/* whole-disk devno for partitions, or 0 */
+	char	*name;		/* name as encoded in sysfs */
+	char	*link;		/* /sys/dev/block/<maj:min> symlink */
+};
+
+static struct sysfs_devcache {
+	struct sysfs_devcache_entry	*ents;		/* sorted by devno */
+	struct sysfs_devcache_entry	**names;	/* sorted by name */
+	size_t				nents;
+
+	unsigned int	enabled : 1,
+			scanned : 1;
+} devcache;
+
+static void free_devcache(void)
+{
+	size_t i;
+
+	for (i = 0; i < devcache.nents; i++) {
+		free(devcache.ents[i].name);
+		free(devcache.ents[i].link);
+	}
+	free(devcache.ents);
+	free(devcache.names);
+
+	devcache.ents = NULL;
+	devcache.names = NULL;
+	devcache.nents = 0;
+	devcache.scanned = 0;
+}
+
+/*
+ * Enables (or disables and deallocates) the cache. It's up to the caller to
+ * care about changes in the system after the cache is populated.
+ */
+void sysfs_enable_devcache(int enable)
+{
+	if (!enable)
+		free_devcache();
+	devcache.enabled = enable ? 1 : 0;
+}
+
+static int cmp_devcache_devno(const void *a, const void *b)
+{
+	dev_t x = ((const struct sysfs_devcache_entry *) a)->devno,
+	      y = ((const struct sysfs_devcache_entry *) b)->devno;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int cmp_devcache_name(const void *a, const void *b)
+{
+	return strcmp((*(struct sysfs_devcache_entry * const *) a)->name,
+		      (*(struct sysfs_devcache_entry * const *) b)->name);
+}
+
+static struct sysfs_devcache_entry *devcache_get_name(const char *name)
+{
+	struct sysfs_devcache_entry x = { .name = (char *) name }, *px = &x, **res;
+
+	res = bsearch(&px, devcache.names, devcache.nents,
+			sizeof(struct sysfs_devcache_entry *), cmp_devcache_name);
+	return res ? *res : NULL;
+}
+
+static void scan_devcache(void)
+{
+	DIR *dir;
+	struct dirent *d;
+	size_t i, nalloc = 0;
+
+	devcache.scanned = 1;
+
+	dir = opendir(_PATH_SYS_DEVBLOCK);
+	if (!dir)
+		return;
+
+	DBG(CXT, ul_debug("scanning " _PATH_SYS_DEVBLOCK " for cache"));
+
+	while ((d = readdir(dir))) {
+		struct sysfs_devcache_entry *ent;
+		char link[PATH_MAX], *name, *p;
+		unsigned int maj, min;
+		ssize_t sz;
+
+		if (sscanf(d->d_name, "%u:%u", &maj, &min) != 2)
+			continue;
+		sz = readlinkat(dirfd(dir), d->d_name, link, sizeof(link) - 1);
+		if (sz <= 0)
+			continue;
+		link[sz] = '\0';
+
+		name = strrchr(link, '/');
+		if (!name || !*(name + 1))
+			continue;
+
+		if (devcache.nents == nalloc) {
+			struct sysfs_devcache_entry *tmp;
+
+			nalloc = nalloc ? nalloc * 2 : 64;
+			tmp = realloc(devcache.ents, nalloc * sizeof(*tmp));
+			if (!tmp)
+				goto fail;
+			devcache.ents = tmp;
+		}
+		ent = &devcache.ents[devcache.nents];
+		memset(ent, 0, sizeof(*ent));
+
+		ent->devno = makedev(maj, min);
+		ent->link = strdup(link);
+		ent->name = strdup(name + 1);
+		devcache.nents++;
+		if (!ent->link || !ent->name)
+			goto fail;
+
+		/* "../../devices/.../block/sda/sda1" -- mark partitions by
+		 * devno 1, the real whole-disk devno is resolved later */
+		*name = '\0';
+		p = strrchr(link, '/');
+		if (p && strcmp(p + 1, "block") != 0)
+			ent->disk = 1;
+	}
+	closedir(dir);
+	dir = NULL;
+
+	if (!devcache.nents)
+		return;
+
+	qsort(devcache.ents, devcache.nents, sizeof(struct sysfs_devcache_entry),
+			cmp_devcache_devno);
+
+	devcache.names = malloc(devcache.nents * sizeof(struct sysfs_devcache_entry *));
+	if (!devcache.names)
+		goto fail;
+	for (i = 0; i < devcache.nents; i++)
+		devcache.names[i] = &devcache.ents[i];
+	qsort(devcache.names, devcache.nents, sizeof(struct sysfs_devcache_entry *),
+			cmp_devcache_name);
+
+	for (i = 0; i < devcache.nents; i++) {
+		struct sysfs_devcache_entry *ent = &devcache.ents[i], *disk;
+		char link[PATH_MAX], *p;
+
+		if (!ent->disk)
+			continue;
+		ent->disk = 0;
+
+		xstrncpy(link, ent->link, sizeof(link));
+		p = strrchr(link, '/');
+		*p = '\0';
+		p = strrchr(link, '/');
+		disk = devcache_get_name(p + 1);
+		if (disk)
+			ent->disk = disk->devno;
+	}
+
+	DBG(CXT, ul_debug("cached %zu devices", devcache.nents));
+	return;
+fail:
+	if (dir)
+		closedir(dir);
+	free_devcache();
+	devcache.scanned = 1;		/* don't try it again */
+}
+
+static struct sysfs_devcache_entry *devcache_get_devno(dev_t devno)
+{
+	struct sysfs_devcache_entry x = { .devno = devno };
+
+	if (!devcache.enabled)
+		return NULL;
+	if (!devcache.scanned)
+		scan_devcache();
+
+	return bsearch(&x, devcache.ents, devcache.nents,
+			sizeof(struct sysfs_devcache_entry), cmp_devcache_devno);
+}
+
+static struct sysfs_devcache_entry *devcache_get(struct path_cxt *pc)
+{
+	if (!devcache.enabled || ul_path_get_prefix(pc))
+		return NULL;
+	return devcache_get_devno(sysfs_blkdev_get_devno(pc));
+}
+
+/* @name is a name as encoded in sysfs */
+static struct sysfs_devcache_entry *devcache_get_sysname(const char *prefix, const char *name)
+{
+	if (!devcache.enabled || (prefix && *prefix))
+		return NULL;
+	if (!devcache.scanned)
+		scan_devcache();
+	return devcache.names ? devcache_get_name(name) : NULL;
+}
+
 struct path_cxt *ul_new_sysfs_path(dev_t devno, struct path_cxt *parent, const char *prefix)
 {
 	struct path_cxt *pc = ul_new_path(NULL);
@@ -177,10 +381,20 @@ static int sysfs_blkdev_enoent_redirect(struct path_cxt *pc, const char *path, i
 
 char *sysfs_blkdev_get_name(struct path_cxt *pc, char *buf, size_t bufsiz)
 {
+	struct sysfs_devcache_entry *ent = devcache_get(pc);
 	char link[PATH_MAX];
 	char *name;
 	ssize_t	sz;
 
+	if (ent) {
+		sz = strlen(ent->name);
+		if ((size_t) sz + 1 > bufsiz)
+			return NULL;
+		memcpy(buf, ent->name, sz + 1);
+		sysfs_devname_sys_to_dev(buf);
+		return buf;
+	}
+
         /* read /sys/dev/block/<maj:min> link */
 	sz = ul_path_readlink(pc, link, sizeof(link), NULL);
 	if (sz < 0)
@@ -298,6 +512,63 @@ dev_t sysfs_blkdev_partno_to_devno(struct path_cxt *pc, int partno)
 	return devno;
 }
 
+static int cmp_blkdev_parts(const void *a, const void *b)
+{
+	const struct sysfs_blkdev_part *x = a, *y = b;
+
+	return x->partno - y->partno;
+}
+
+/*
+ * Reads partitions of the wholedisk @pc as known by kernel. It's one readdir()
+ * rather than sysfs_blkdev_partno_to_devno() for each partition. The result
+ * is sorted by partition number and should be deallocated by free().
+ *
+ * Returns number of partitions or <0 on error.
+ */
+int sysfs_blkdev_get_partitions(struct path_cxt *pc, struct sysfs_blkdev_part **parts)
+{
+	struct sysfs_blkdev_part *res = NULL;
+	DIR *dir;
+	struct dirent *d;
+	size_t n = 0, nalloc = 0;
+
+	*parts = NULL;
+	dir = ul_path_opendir(pc, NULL);
+	if (!dir)
+		return -errno;
+
+	while ((d = xreaddir(dir))) {
+		struct sysfs_blkdev_part *x;
+
+		if (!sysfs_blkdev_is_partition_dirent(dir, d, NULL))
+			continue;
+		if (n == nalloc) {
+			nalloc += 16;
+			x = realloc(res, nalloc * sizeof(*res));
+			if (!x) {
+				free(res);
+				closedir(dir);
+				return -ENOMEM;
+			}
+			res = x;
+		}
+		x = &res[n];
+		if (ul_path_readf_s32(pc, &x->partno, "%s/partition", d->d_name) ||
+		    ul_path_readf_u64(pc, &x->start, "%s/start", d->d_name) ||
+		    ul_path_readf_u64(pc, &x->size, "%s/size", d->d_name))
+			continue;
+		n++;
+	}
+	closedir(dir);
+
+	if (n)
+		qsort(res, n, sizeof(*res), cmp_blkdev_parts);
+	DBG(CXT, ul_debugobj(pc, "kernel knows %zu partitions", n));
+
+	*parts = res;
+	return (int) n;
+}
 
 /*
  * Returns slave name if there is only one slave, otherwise returns NULL.
@@ -386,10 +657,19 @@ static char *get_subsystem(char *chain, char *buf, size_t bufsz)
  */
 char *sysfs_blkdev_get_devchain(struct path_cxt *pc, char *buf, size_t bufsz)
 {
-	/* read /sys/dev/block/<maj>:<min> symlink */
-	ssize_t sz = ul_path_readlink(pc, buf, bufsz, NULL);
+	struct sysfs_devcache_entry *ent = devcache_get(pc);
 	const char *prefix;
 	size_t psz = 0;
+	ssize_t sz;
+
+	if (ent) {
+		sz = strlen(ent->link);
+		if ((size_t) sz + 1 > bufsz)
+			return NULL;
+		memcpy(buf, ent->link, sz + 1);
+	} else
+		/* read /sys/dev/block/<maj>:<min> symlink */
+		sz = ul_path_readlink(pc, buf, bufsz, NULL);
 
 	if (sz <= 0 || sz + sizeof(_PATH_SYS_DEVBLOCK "/") > bufsz)
 		return NULL;
@@ -513,11 +793,29 @@ int sysfs_blkdev_get_wholedisk(	struct path_cxt *pc,
 				size_t len,
 				dev_t *diskdevno)
 {
+    struct sysfs_devcache_entry *ent;
     int is_part = 0;
 
     if (!pc)
         return -1;
 
+    /* the device-mapper partitions are not in the cache */
+    ent = devcache_get(pc);
+    if (ent && (ent->disk || strncmp(ent->name, "dm-", 3) != 0)) {
+        struct sysfs_devcache_entry *disk = ent->disk ?
+			devcache_get_devno(ent->disk) : ent;
+
+        if (!disk)
+            return -1;
+        if (diskname && len) {
+            xstrncpy(diskname, disk->name, len);
+            sysfs_devname_sys_to_dev(diskname);
+        }
+        if (diskdevno)
+            *diskdevno = disk->devno;
+        return 0;
+    }
+
     is_part = ul_path_access(pc, F_OK, "partition") == 0;
     if (!is_part) {
         /*
@@ -874,6 +1172,7 @@ dev_t __sysfs_devname_to_devno(const char *prefix, const char *name, const char
 {
 	char buf[PATH_MAX];
 	char *_name = NULL, *_parent = NULL;	/* name as encoded in sysfs */
+	struct sysfs_devcache_entry *ent;
 	dev_t dev = 0;
 	int len;
 
@@ -904,13 +1203,27 @@ dev_t __sysfs_devname_to_devno(const char *prefix, const char *name, const char
 		_parent = strdup(parent);
 		if (!_parent)
 			goto done;
+		sysfs_devname_dev_to_sys(_parent);
+	}
+
+	ent = devcache_get_sysname(prefix, _name);
+	if (ent) {
+		struct sysfs_devcache_entry *disk = ent->disk ?
+				devcache_get_devno(ent->disk) : NULL;
+
+		/* the same as below, <parent>/<name> for non-dm partitions
+		 * and /sys/block/<name> for others; the rest is up to sysfs */
+		if (parent && strncmp("dm-", name, 3) != 0 ?
+		    (disk && strcmp(disk->name, _parent) == 0) : !ent->disk) {
+			dev = ent->devno;
+			goto done;
+		}
 	}
 
 	if (parent && strncmp("dm-", name, 3) != 0) {
 		/*
 		 * Create path to /sys/block/<parent>/<name>/dev
 		 */
-		sysfs_devname_dev_to_sys(_parent);
 		len = snprintf(buf, sizeof(buf),
 				"%s" _PATH_SYS_BLOCK "/%s/%s/dev",
 				prefix,	_parent, _name);
@@ -1055,8 +1368,12 @@ int main(int argc, char *argv[])
 	int i, is_part, rc = EXIT_SUCCESS;
 	uint64_t u64;
 
+	if (argc == 3 && strcmp(argv[1], "--cache") == 0) {
+		sysfs_enable_devcache(1);
+		argc--, argv++;
+	}
 	if (argc != 2)
-		errx(EXIT_FAILURE, "usage: %s <devname>", argv[0]);
+		errx(EXIT_FAILURE, "usage: %s [--cache] <devname>", argv[0]);
 
 	ul_sysfs_init_debug();
 
@@ -1133,6 +1450,7 @@ int main(int argc, char *argv[])
 	rc = EXIT_SUCCESS;
 done:
 	ul_unref_path(pc);
+	sysfs_enable_devcache(0);
 	return rc;
 }
 #endif /* TEST_PROGRAM_SYSFS */
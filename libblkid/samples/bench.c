@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Reports time spent to probe a device or image, the number of read/write
+ * syscalls (from /proc/self/io) and the minor page faults. Without the device
+ * argument a synthetic image with swap signature is generated; use --empty to
+ * benchmark probing of the device without any signature (the worst case, all
+ * probers are tried).
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+
+#include <blkid.h>
+
+#include "c.h"
+#include "all-io.h"
+#include "nls.h"
+#include "strutils.h"
+
+/* usage at the beginning of a phase */
+struct usage {
+	double		time;
+	unsigned long long syscalls;
+	long		minflt;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* read and write syscalls, 0 if the kernel does not account it */
+static unsigned long long count_syscalls(void)
+{
+	unsigned long long n = 0, x;
+	char buf[128];
+	FILE *f = fopen("/proc/self/io", "r" UL_CLOEXECSTR);
+
+	if (!f)
+		return 0;
+	while (fgets(buf, sizeof(buf), f)) {
+		if (sscanf(buf, "syscr: %llu", &x) == 1 ||
+		    sscanf(buf, "syscw: %llu", &x) == 1)
+			n += x;
+	}
+	fclose(f);
+	return n;
+}
+
+static void start(struct usage *u)
+{
+	struct rusage ru;
+
+	u->syscalls = count_syscalls();
+	u->minflt = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_minflt : 0;
+	u->time = now();
+}
+
+static void report(const char *phase, struct usage *u, size_t loops)
+{
+	double t = now() - u->time;
+	unsigned long long sc = count_syscalls();
+	struct rusage ru;
+	long minflt = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_minflt : 0;
+
+	/* count_syscalls() itself calls read() twice */
+	sc = sc > u->syscalls + 2 ? sc - u->syscalls - 2 : 0;
+
+	fprintf(stderr, "%-14s %10.3f ms %10.3f us/probe %8.1f syscalls/probe %10ld faults\n",
+			phase, t * 1000.0, t * 1e6 / loops,
+			(double) sc / loops, minflt - u->minflt);
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fprintf(out,
+		"\n %s [options] [<device>]\n",
+		program_invocation_short_name);
+
+	fputs(" -l, --loops <num>      number of probes (default 1000)\n", out);
+	fputs(" -s, --size <size>      size of the generated image (default 64MiB)\n", out);
+	fputs(" -e, --empty            generate image without any signature\n", out);
+	fputs(" -h, --help             this help\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+/* Swap v1 with label, see libblkid/src/superblocks/swap.c */
+static void write_swap(int fd, uint64_t size)
+{
+	unsigned char hdr[4096] = { 0 };
+	uint32_t version = 1, lastpage = size / sizeof(hdr) - 1;
+
+	memcpy(hdr + 1024, &version, sizeof(version));
+	memcpy(hdr + 1028, &lastpage, sizeof(lastpage));
+	memset(hdr + 1036, 0xaa, 16);			/* UUID */
+	memcpy(hdr + 1052, "bench", 5);			/* LABEL */
+	memcpy(hdr + sizeof(hdr) - 10, "SWAPSPACE2", 10);
+
+	if (write_all(fd, hdr, sizeof(hdr)) != 0)
+		err(EXIT_FAILURE, "write failed");
+}
+
+static char *generate(char *path, uint64_t size, int empty)
+{
+	int fd = mkstemp(path);
+
+	if (fd < 0)
+		err(EXIT_FAILURE, "cannot create temporary file");
+	if (!empty)
+		write_swap(fd, size);
+	if (ftruncate(fd, size) != 0)
+		err(EXIT_FAILURE, "cannot resize %s", path);
+	close(fd);
+	return path;
+}
+
+static blkid_probe new_probe(const char *devname)
+{
+	blkid_probe pr = blkid_new_probe_from_filename(devname);
+
+	if (!pr)
+		err(EXIT_FAILURE, "%s: failed to create a new libblkid probe",
+				devname);
+	return pr;
+}
+
+int main(int argc, char *argv[])
+{
+	char tmpname[] = "/tmp/blkid-bench-XXXXXX";
+	char *devname = NULL;
+	const char *type = NULL;
+	uint64_t size = 64 * 1024 * 1024;
+	size_t i, loops = 1000;
+	struct rusage ru;
+	struct usage u;
+	blkid_probe pr;
+	int c, rc, empty = 0;
+
+	static const struct option longopts[] = {
+		{ "loops", 1, NULL, 'l' },
+		{ "size",  1, NULL, 's' },
+		{ "empty", 0, NULL, 'e' },
+		{ "help",  0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	while((c = getopt_long(argc, argv, "ehl:s:", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'l':
+			loops = strtou32_or_err(optarg, "failed to parse number of loops");
+			if (!loops)
+				errx(EXIT_FAILURE, "at least 1 loop required");
+			break;
+		case 's':
+			size = strtosize_or_err(optarg, "failed to parse size");
+			if (size < 2 * 4096)
+				errx(EXIT_FAILURE, "image too small");
+			break;
+		case 'e':
+			empty = 1;
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (optind < argc)
+		devname = argv[optind];
+	else
+		devname = generate(tmpname, size, empty);
+
+	/* blkid -p, a new probe for every device */
+	start(&u);
+	for (i = 0; i < loops; i++) {
+		pr = new_probe(devname);
+		blkid_probe_enable_partitions(pr, TRUE);
+		blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+		rc = blkid_do_safeprobe(pr);
+		if (rc < 0)
+			errx(EXIT_FAILURE, "%s: safeprobe failed", devname);
+		if (i == 0 && rc == 0)
+			blkid_probe_lookup_value(pr, "TYPE", &type, NULL);
+		if (i == 0)
+			fprintf(stderr, "%-14s %s\n", "type",
+					type ? type : rc == 1 ? "(none)" : "(ambivalent)");
+		blkid_free_probe(pr);
+	}
+	report("safeprobe", &u, loops);
+
+	/* wipefs, all signatures */
+	start(&u);
+	for (i = 0; i < loops; i++) {
+		pr = new_probe(devname);
+		blkid_probe_enable_partitions(pr, TRUE);
+		blkid_probe_set_superblocks_flags(pr, BLKID_SUBLKS_MAGIC |
+				BLKID_SUBLKS_TYPE | BLKID_SUBLKS_BADCSUM);
+		blkid_probe_set_partitions_flags(pr, BLKID_PARTS_MAGIC);
+
+		while ((rc = blkid_do_probe(pr)) == 0)
+			;
+		if (rc < 0)
+			errx(EXIT_FAILURE, "%s: probe failed", devname);
+		blkid_free_probe(pr);
+	}
+	report("probe-all", &u, loops);
+
+	/* the same probe, reset only; the buffers are reused */
+	pr = new_probe(devname);
+	start(&u);
+	for (i = 0; i < loops; i++) {
+		blkid_reset_probe(pr);
+		if (blkid_do_safeprobe(pr) < 0)
+			errx(EXIT_FAILURE, "%s: safeprobe failed", devname);
+	}
+	report("reprobe", &u, loops);
+	blkid_free_probe(pr);
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		fprintf(stderr, "%-14s %10ld kB\n", "maxrss", ru.ru_maxrss);
+
+	if (devname == tmpname)
+		unlink(tmpname);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+/*
+ * arena.c - per-probe memory arena
+ *
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The probing results (and the read buffers) are never released one by one
+ * in the usual case -- all of them are released together when the probe is
+ * reset or assigned to another device. The arena allocates them from large
+ * chunks and releases everything in one step. The first chunk is kept for
+ * the next probing, so probing more devices by the same probe does not use
+ * malloc() at all in the usual case.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blkidP.h"
+
+struct blkid_arena_chunk {
+	struct list_head	chunks;
+	size_t			size;		/* size of data[] */
+	size_t			used;
+	unsigned char		data[];
+};
+
+void blkid_init_arena(struct blkid_arena *ar, size_t chunksz)
+{
+	INIT_LIST_HEAD(&ar->chunks);
+	ar->chunksz = chunksz;
+	ar->last = NULL;
+}
+
+static void *chunk_alloc(struct blkid_arena_chunk *ch, size_t len, size_t align)
+{
+	uintptr_t begin = (uintptr_t) ch->data + ch->used;
+	uintptr_t end;
+
+	if (align > 1)
+		begin = (begin + align - 1) & ~((uintptr_t) align - 1);
+	end = begin + len;
+
+	if (end < begin || end > (uintptr_t) ch->data + ch->size)
+		return NULL;
+
+	ch->used = end - (uintptr_t) ch->data;
+	return (void *) begin;
+}
+
+/*
+ * Returns uninitialized memory aligned to @align (power of 2, or 0 for the
+ * default alignment). The memory is valid until blkid_reset_arena().
+ */
+void *blkid_arena_alloc(struct blkid_arena *ar, size_t len, size_t align)
+{
+	struct blkid_arena_chunk *ch = NULL;
+	struct list_head *p;
+	size_t sz;
+	void *res;
+
+	if (align < sizeof(max_align_t))
+		align = sizeof(max_align_t);
+
+	/* the last chunk is the current, others are full or oversized */
+	if (!list_empty(&ar->chunks)) {
+		ch = list_entry(ar->chunks.prev, struct blkid_arena_chunk, chunks);
+		res = chunk_alloc(ch, len, align);
+		if (res)
+			goto done;
+	}
+
+	if (len > SIZE_MAX - sizeof(*ch) - align)
+		return NULL;
+
+	sz = max(ar->chunksz, len + align);
+	ch = malloc(sizeof(*ch) + sz);
+	if (!ch)
+		return NULL;
+	ch->size = sz;
+	ch->used = 0;
+
+	/* keep the current chunk at the end of the list if the new chunk
+	 * is used for one large allocation only */
+	p = &ar->chunks;
+	if (sz > ar->chunksz && !list_empty(&ar->chunks))
+		p = ar->chunks.prev;
+	list_add_tail(&ch->chunks, p);
+
+	res = chunk_alloc(ch, len, align);
+done:
+	ar->last = res;
+	return res;
+}
+
+/*
+ * Returns zeroized memory with the default alignment.
+ */
+void *blkid_arena_calloc(struct blkid_arena *ar, size_t len)
+{
+	void *res = blkid_arena_alloc(ar, len, 0);
+
+	if (res)
+		memset(res, 0, len);
+	return res;
+}
+
+/*
+ * Releases @ptr if it is the last allocation, otherwise the memory is released
+ * by blkid_reset_arena().
+ */
+void blkid_arena_free(struct blkid_arena *ar, void *ptr)
+{
+	struct list_head *p;
+
+	if (!ptr || ptr != ar->last)
+		return;
+
+	list_for_each(p, &ar->chunks) {
+		struct blkid_arena_chunk *ch = list_entry(p,
+					struct blkid_arena_chunk, chunks);
+
+		if ((unsigned char *) ptr >= ch->data
+		    && (unsigned char *) ptr < ch->data + ch->size) {
+			ch->used = (unsigned char *) ptr - ch->data;
+			break;
+		}
+	}
+	ar->last = NULL;
+}
+
+/*
+ * Releases all allocations. The first standard sized chunk is kept for the
+ * next allocations.
+ */
+void blkid_reset_arena(struct blkid_arena *ar)
+{
+	struct list_head *p, *pnext;
+	struct blkid_arena_chunk *keep = NULL;
+
+	list_for_each_safe(p, pnext, &ar->chunks) {
+		struct blkid_arena_chunk *ch = list_entry(p,
+					struct blkid_arena_chunk, chunks);
+
+		list_del(&ch->chunks);
+		if (!keep && ch->size == ar->chunksz) {
+			keep = ch;
+			continue;
+		}
+		free(ch);
+	}
+
+	INIT_LIST_HEAD(&ar->chunks);
+	if (keep) {
+		keep->used = 0;
+		list_add(&keep->chunks, &ar->chunks);
+	}
+	ar->last = NULL;
+}
+
+void blkid_free_arena(struct blkid_arena *ar)
+{
+	blkid_reset_arena(ar);
+
+	while (!list_empty(&ar->chunks)) {
+		struct blkid_arena_chunk *ch = list_entry(ar->chunks.next,
+					struct blkid_arena_chunk, chunks);
+		list_del(&ch->chunks);
+		free(ch);
+	}
+}
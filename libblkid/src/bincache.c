@@ -0,0 +1,516 @@
+/*
+ * bincache.c - binary (mmap-able) version of the cache file
+ *
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The binary cache is an optional copy of the text cache file (see save.c and
+ * read.c). The text file is always the primary format. The binary file is
+ * written after the text file and it is used only if it is not older than
+ * the text file.
+ *
+ * File layout (native byte order, the file is not portable):
+ *
+ *	struct bincache_hdr
+ *	struct bincache_dev	devs[ndevs]
+ *	struct bincache_tag	tags[ntags]	(grouped by devices)
+ *	uint32_t		index[ntags]	(tags sorted by name and value)
+ *	char			strings[strsz]	(NUL-terminated strings)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include "all-io.h"
+#include "fileutils.h"
+
+#include "blkidP.h"
+
+#define BINCACHE_MAGIC		"BLKIDBIN"
+#define BINCACHE_VERSION	1
+#define BINCACHE_ENDIAN		0x01020304
+#define BINCACHE_SUFFIX		".bin"
+
+struct bincache_hdr {
+	char		magic[8];	/* BINCACHE_MAGIC */
+	uint32_t	version;	/* BINCACHE_VERSION */
+	uint32_t	endian;		/* BINCACHE_ENDIAN */
+	uint32_t	ndevs;
+	uint32_t	ntags;
+	uint32_t	strsz;		/* size of strings table */
+	uint32_t	reserved;
+};
+
+struct bincache_dev {
+	uint64_t	devno;
+	int64_t		time;
+	int64_t		utime;
+	int32_t		pri;
+	uint32_t	name;		/* offset in strings table */
+	uint32_t	tags;		/* index of the first tag */
+	uint32_t	ntags;
+};
+
+struct bincache_tag {
+	uint32_t	name;		/* offset in strings table */
+	uint32_t	value;		/* offset in strings table */
+	uint32_t	dev;		/* index of the device */
+	uint32_t	reserved;
+};
+
+/* mapped binary cache */
+struct bincache {
+	void				*map;
+	size_t				mapsz;
+
+	const struct bincache_hdr	*hdr;
+	const struct bincache_dev	*devs;
+	const struct bincache_tag	*tags;
+	const uint32_t			*index;
+	const char			*strings;
+};
+
+char *blkid_get_bincache_filename(const char *filename)
+{
+	char *res = malloc(strlen(filename) + sizeof(BINCACHE_SUFFIX));
+
+	if (res)
+		sprintf(res, "%s" BINCACHE_SUFFIX, filename);
+	return res;
+}
+
+static void unmap_bincache(struct bincache *bc)
+{
+	if (bc->map)
+		munmap(bc->map, bc->mapsz);
+	memset(bc, 0, sizeof(*bc));
+}
+
+static inline const char *bincache_str(struct bincache *bc, uint32_t off)
+{
+	return bc->strings + off;
+}
+
+/*
+ * Maps binary cache for text cache @filename and verifies the file header and
+ * all offsets. Returns 0 on success.
+ */
+static int map_bincache(struct bincache *bc, const char *filename)
+{
+	struct stat st, txt;
+	char *binname;
+	uint64_t sz;
+	size_t i;
+	int fd, rc = -BLKID_ERR_CACHE;
+
+	memset(bc, 0, sizeof(*bc));
+
+	binname = blkid_get_bincache_filename(filename);
+	if (!binname)
+		return -BLKID_ERR_MEM;
+
+	fd = open(binname, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		goto done;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		goto done;
+
+	/* text file has been modified after binary file */
+	if (stat(filename, &txt) == 0 &&
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	    (txt.st_mtim.tv_sec > st.st_mtim.tv_sec ||
+	     (txt.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+	      txt.st_mtim.tv_nsec > st.st_mtim.tv_nsec))
+#else
+	    txt.st_mtime > st.st_mtime
+#endif
+	    ) {
+		DBG(CACHE, ul_debug("%s: older than %s, ignore", binname, filename));
+		goto done;
+	}
+
+	if ((size_t) st.st_size < sizeof(struct bincache_hdr))
+		goto done;
+
+	bc->mapsz = st.st_size;
+	bc->map = mmap(NULL, bc->mapsz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (bc->map == MAP_FAILED) {
+		bc->map = NULL;
+		goto done;
+	}
+
+	bc->hdr = bc->map;
+	if (memcmp(bc->hdr->magic, BINCACHE_MAGIC, sizeof(bc->hdr->magic)) != 0
+	    || bc->hdr->version != BINCACHE_VERSION
+	    || bc->hdr->endian != BINCACHE_ENDIAN) {
+		DBG(CACHE, ul_debug("%s: unsupported file format", binname));
+		goto done;
+	}
+
+	sz = sizeof(struct bincache_hdr)
+	     + (uint64_t) bc->hdr->ndevs * sizeof(struct bincache_dev)
+	     + (uint64_t) bc->hdr->ntags * sizeof(struct bincache_tag)
+	     + (uint64_t) bc->hdr->ntags * sizeof(uint32_t)
+	     + bc->hdr->strsz;
+	if (sz != bc->mapsz || !bc->hdr->strsz)
+		goto done;
+
+	bc->devs = (const struct bincache_dev *) (bc->hdr + 1);
+	bc->tags = (const struct bincache_tag *) (bc->devs + bc->hdr->ndevs);
+	bc->index = (const uint32_t *) (bc->tags + bc->hdr->ntags);
+	bc->strings = (const char *) (bc->index + bc->hdr->ntags);
+
+	/* the last string has to be terminated */
+	if (bc->strings[bc->hdr->strsz - 1] != '\0')
+		goto done;
+
+	for (i = 0; i < bc->hdr->ndevs; i++) {
+		const struct bincache_dev *d = &bc->devs[i];
+
+		if (d->name >= bc->hdr->strsz
+		    || d->tags > bc->hdr->ntags
+		    || d->ntags > bc->hdr->ntags - d->tags)
+			goto done;
+	}
+	for (i = 0; i < bc->hdr->ntags; i++) {
+		const struct bincache_tag *t = &bc->tags[i];
+
+		if (t->name >= bc->hdr->strsz
+		    || t->value >= bc->hdr->strsz
+		    || t->dev >= bc->hdr->ndevs
+		    || bc->index[i] >= bc->hdr->ntags)
+			goto done;
+	}
+
+	DBG(CACHE, ul_debug("%s: mapped [devs=%u, tags=%u]", binname,
+				bc->hdr->ndevs, bc->hdr->ntags));
+	rc = 0;
+done:
+	if (rc)
+		unmap_bincache(bc);
+	if (fd >= 0)
+		close(fd);
+	free(binname);
+	return rc;
+}
+
+/*
+ * Reads binary cache to @cache. Returns 0 on success, or <0 if the binary
+ * cache is not available (the text cache file should be used).
+ */
+int blkid_read_bincache(blkid_cache cache)
+{
+	struct bincache bc;
+	size_t i, j;
+	int empty;
+
+	if (!cache->bic_filename || map_bincache(&bc, cache->bic_filename) != 0)
+		return -BLKID_ERR_CACHE;
+
+	/* blkid_get_dev() lookup is necessary only if the cache already
+	 * contains any devices */
+	empty = list_empty(&cache->bic_devs);
+
+	for (i = 0; i < bc.hdr->ndevs; i++) {
+		const struct bincache_dev *d = &bc.devs[i];
+		const char *name = bincache_str(&bc, d->name);
+		blkid_dev dev;
+
+		if (*name != '/')
+			continue;
+		if (empty) {
+			dev = blkid_new_dev();
+			if (!dev)
+				break;
+			dev->bid_name = strdup(name);
+			if (!dev->bid_name) {
+				blkid_free_dev(dev);
+				break;
+			}
+			dev->bid_cache = cache;
+			list_add_tail(&dev->bid_devs, &cache->bic_devs);
+		} else {
+			dev = blkid_get_dev(cache, name, BLKID_DEV_CREATE);
+			if (!dev)
+				continue;
+		}
+
+		dev->bid_devno = d->devno;
+		dev->bid_time = d->time;
+		dev->bid_utime = d->utime;
+		dev->bid_pri = d->pri;
+
+		for (j = d->tags; j < (size_t) d->tags + d->ntags; j++) {
+			const char *val = bincache_str(&bc, bc.tags[j].value);
+
+			blkid_set_tag(dev, bincache_str(&bc, bc.tags[j].name),
+					val, strlen(val));
+		}
+
+		if (dev->bid_type == NULL) {
+			DBG(READ, ul_debug("blkid: device %s has no TYPE", dev->bid_name));
+			blkid_free_dev(dev);
+		}
+	}
+
+	unmap_bincache(&bc);
+	return 0;
+}
+
+/*
+ * Returns name of the device with the highest priority which has the tag
+ * @type=@value. The function does not read the whole cache; it searches
+ * in the sorted tags index of the binary cache. The device is not verified.
+ */
+char *blkid_bincache_lookup(const char *filename, const char *type,
+			    const char *value)
+{
+	struct bincache bc;
+	const struct bincache_dev *res = NULL;
+	size_t lo, hi;
+	char *name = NULL;
+
+	if (map_bincache(&bc, filename) != 0)
+		return NULL;
+
+	/* find the first tag >= type=value */
+	lo = 0;
+	hi = bc.hdr->ntags;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		const struct bincache_tag *t = &bc.tags[bc.index[mid]];
+		int cmp = strcmp(bincache_str(&bc, t->name), type);
+
+		if (!cmp)
+			cmp = strcmp(bincache_str(&bc, t->value), value);
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for ( ; lo < bc.hdr->ntags; lo++) {
+		const struct bincache_tag *t = &bc.tags[bc.index[lo]];
+		const struct bincache_dev *d = &bc.devs[t->dev];
+
+		if (strcmp(bincache_str(&bc, t->name), type) != 0 ||
+		    strcmp(bincache_str(&bc, t->value), value) != 0)
+			break;
+		if (res && res->pri >= d->pri)
+			continue;
+		if (access(bincache_str(&bc, d->name), F_OK) != 0)
+			continue;
+		res = d;
+	}
+
+	if (res) {
+		name = strdup(bincache_str(&bc, res->name));
+		DBG(TAG, ul_debug("%s=%s found in binary cache: %s", type, value, name));
+	}
+
+	unmap_bincache(&bc);
+	return name;
+}
+
+/*
+ * Returns 1 if the device is saved to the cache file, see blkid_flush_cache()
+ * and save_dev().
+ */
+static inline int is_saved_dev(blkid_dev dev)
+{
+	return dev->bid_type && dev->bid_name[0] == '/'
+		&& !(dev->bid_flags & BLKID_BID_FL_REMOVABLE);
+}
+
+struct index_entry {
+	const char	*name;
+	const char	*value;
+	uint32_t	tag;
+};
+
+static int cmp_index(const void *a, const void *b)
+{
+	const struct index_entry *x = a, *y = b;
+	int rc = strcmp(x->name, y->name);
+
+	return rc ? rc : strcmp(x->value, y->value);
+}
+
+static uint32_t add_string(char *strings, uint32_t *strsz, const char *str)
+{
+	uint32_t off = *strsz;
+	size_t len = strlen(str) + 1;
+
+	memcpy(strings + off, str, len);
+	*strsz += len;
+	return off;
+}
+
+static int sort_index(uint32_t *index, const struct bincache_tag *tags,
+		      uint32_t ntags, const char *strings)
+{
+	struct index_entry *ents;
+	uint32_t i;
+
+	if (!ntags)
+		return 0;
+	ents = malloc(ntags * sizeof(*ents));
+	if (!ents)
+		return -BLKID_ERR_MEM;
+
+	for (i = 0; i < ntags; i++) {
+		ents[i].name = strings + tags[i].name;
+		ents[i].value = strings + tags[i].value;
+		ents[i].tag = i;
+	}
+	qsort(ents, ntags, sizeof(*ents), cmp_index);
+
+	for (i = 0; i < ntags; i++)
+		index[i] = ents[i].tag;
+	free(ents);
+	return 0;
+}
+
+/*
+ * Writes binary copy of the @cache to the binary file for text cache
+ * @filename. The file is replaced atomically.
+ */
+int blkid_write_bincache(blkid_cache cache, const char *filename)
+{
+	struct bincache_hdr *hdr;
+	struct bincache_dev *devs;
+	struct bincache_tag *tags;
+	uint32_t *index;
+	char *strings, *data = NULL, *binname = NULL, *tmp = NULL;
+	uint64_t strsz = 0, ndevs = 0, ntags = 0, sz;
+	uint32_t i = 0, t = 0, off = 0;
+	struct list_head *p, *tp;
+	int fd = -1, rc = -BLKID_ERR_MEM;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (!is_saved_dev(dev))
+			continue;
+		ndevs++;
+		strsz += strlen(dev->bid_name) + 1;
+
+		list_for_each(tp, &dev->bid_tags) {
+			blkid_tag tag = list_entry(tp, struct blkid_struct_tag, bit_tags);
+
+			ntags++;
+			strsz += strlen(tag->bit_name) + strlen(tag->bit_val) + 2;
+		}
+	}
+	if (!strsz)
+		strsz = 1;
+	if (strsz > UINT32_MAX || ndevs > UINT32_MAX || ntags > UINT32_MAX)
+		return -BLKID_ERR_PARAM;
+
+	sz = sizeof(struct bincache_hdr)
+	     + ndevs * sizeof(struct bincache_dev)
+	     + ntags * sizeof(struct bincache_tag)
+	     + ntags * sizeof(uint32_t)
+	     + strsz;
+
+	data = calloc(1, sz);
+	binname = blkid_get_bincache_filename(filename);
+	if (!data || !binname)
+		goto done;
+
+	hdr = (struct bincache_hdr *) data;
+	devs = (struct bincache_dev *) (hdr + 1);
+	tags = (struct bincache_tag *) (devs + ndevs);
+	index = (uint32_t *) (tags + ntags);
+	strings = (char *) (index + ntags);
+
+	memcpy(hdr->magic, BINCACHE_MAGIC, sizeof(hdr->magic));
+	hdr->version = BINCACHE_VERSION;
+	hdr->endian = BINCACHE_ENDIAN;
+	hdr->ndevs = ndevs;
+	hdr->ntags = ntags;
+	hdr->strsz = strsz;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (!is_saved_dev(dev))
+			continue;
+
+		devs[i].devno = dev->bid_devno;
+		devs[i].time = dev->bid_time;
+		devs[i].utime = dev->bid_utime;
+		devs[i].pri = dev->bid_pri;
+		devs[i].name = add_string(strings, &off, dev->bid_name);
+		devs[i].tags = t;
+
+		list_for_each(tp, &dev->bid_tags) {
+			blkid_tag tag = list_entry(tp, struct blkid_struct_tag, bit_tags);
+
+			tags[t].name = add_string(strings, &off, tag->bit_name);
+			tags[t].value = add_string(strings, &off, tag->bit_val);
+			tags[t].dev = i;
+			t++;
+		}
+		devs[i].ntags = t - devs[i].tags;
+		i++;
+	}
+
+	if (sort_index(index, tags, ntags, strings) != 0)
+		goto done;
+
+	tmp = malloc(strlen(binname) + 8);
+	if (!tmp)
+		goto done;
+	sprintf(tmp, "%s-XXXXXX", binname);
+
+	rc = -BLKID_ERR_IO;
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0) {
+		free(tmp);
+		tmp = NULL;
+		goto done;
+	}
+	if (fchmod(fd, 0644) != 0 || write_all(fd, data, sz) != 0) {
+		DBG(SAVE, ul_debug("%s: write failed", tmp));
+		goto done;
+	}
+	if (close(fd) != 0) {
+		fd = -1;
+		goto done;
+	}
+	fd = -1;
+
+	if (rename(tmp, binname) != 0) {
+		DBG(SAVE, ul_debug("can't rename %s to %s", tmp, binname));
+		goto done;
+	}
+
+	DBG(SAVE, ul_debug("binary cache %s written [devs=%u, tags=%u]",
+				binname, hdr->ndevs, hdr->ntags));
+	free(tmp);
+	tmp = NULL;
+	rc = 0;
+done:
+	if (fd >= 0)
+		close(fd);
+	if (tmp) {
+		unlink(tmp);
+		free(tmp);
+	}
+	free(binname);
+	free(data);
+	return rc;
+}
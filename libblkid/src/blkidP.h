@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <time.h>
 
 #ifndef UUID_STR_LEN
 # define UUID_STR_LEN   37
@@ -62,6 +63,7 @@ struct blkid_struct_dev
 #define BLKID_BID_FL_VERIFIED	0x0001	/* Device data validated from disk */
 #define BLKID_BID_FL_INVALID	0x0004	/* Device is invalid */
 #define BLKID_BID_FL_REMOVABLE	0x0008	/* Device added by blkid_probe_all_removable() */
+#define BLKID_BID_FL_PENDING	0x0010	/* Device probing postponed, see BLKID_BIC_FL_DEFER */
 
 /*
  * Each tag defines a NAME=value pair for a particular device.  The tags
@@ -74,6 +76,7 @@ struct blkid_struct_tag
 {
 	struct list_head	bit_tags;	/* All tags for this device */
 	struct list_head	bit_names;	/* All tags with given NAME */
+	struct list_head	bit_hash;	/* Cache NAME=value index (tag.c) */
 	char			*bit_name;	/* NAME of tag (shared) */
 	char			*bit_val;	/* value of tag */
 	blkid_dev		bit_dev;	/* pointer to device */
@@ -184,6 +187,52 @@ struct blkid_bufinfo {
 	struct list_head	bufs;	/* list of buffers */
 };
 
+/*
+ * Low-level I/O statistics, see blkid_probe_get_buffer()
+ */
+struct blkid_iostat {
+	uint64_t		hits;	/* requests served from cached buffers */
+	uint64_t		misses;	/* requests which required read() */
+	uint64_t		reads;	/* number of read() calls */
+	uint64_t		bytes;	/* number of bytes read from device */
+};
+
+/*
+ * Per-prober statistics, see blkid_probe_enable_stats()
+ */
+struct blkid_prstat {
+	uint64_t		calls;		/* number of prober calls */
+	uint64_t		matches;	/* number of successful calls */
+	uint64_t		nsec;		/* time spent in the prober */
+	uint64_t		reads;		/* number of read() calls */
+	uint64_t		bytes;		/* number of bytes read from device */
+	uint64_t		hits;		/* requests served from cached buffers */
+};
+
+struct blkid_prstat_ctx {
+	struct blkid_prstat	*prev;		/* for nested probers */
+	struct blkid_prstat	*cur;
+	struct timespec		start;
+};
+
+/*
+ * The minimal read() size; small requests are extended to the aligned window
+ * to read all the nearby superblocks by one syscall.
+ */
+#define BLKID_PROBE_READAHEAD	(64 * 1024)
+
+/*
+ * Per-probe memory arena, see arena.c
+ */
+struct blkid_arena {
+	struct list_head	chunks;
+	size_t			chunksz;	/* standard chunk size */
+	void			*last;		/* the last allocation */
+};
+
+#define BLKID_VALS_ARENASZ	(2 * 1024)
+#define BLKID_BUFS_ARENASZ	(4 * BLKID_PROBE_READAHEAD)
+
 /*
  * Probing hint
  */
@@ -199,6 +248,7 @@ struct blkid_hint {
 struct blkid_struct_probe
 {
 	int			fd;		/* device file descriptor */
+	int			dio_fd;		/* O_DIRECT fd, -1 unused, -2 unsupported */
 	uint64_t		off;		/* begin of data on the device */
 	uint64_t		size;		/* end of data on the device */
 
@@ -214,13 +264,23 @@ struct blkid_struct_probe
 	uint64_t		wipe_size;	/* size of the wiped area */
 	struct blkid_chain	*wipe_chain;	/* superblock, partition, ... */
 
-	struct list_head	buffers;	/* list of buffers */
+	struct list_head	buffers;	/* list of buffers (sorted by offset) */
+	struct blkid_arena	bufs_arena;	/* memory for buffers */
+	struct blkid_iostat	iostat;		/* buffers statistics */
+	struct blkid_prstat	*prstats[BLKID_NCHAINS];	/* per-prober statistics or NULL */
+	struct blkid_prstat	*cur_prstat;	/* statistics of the running prober */
+
+	uint64_t		io_budget;	/* max bytes read from device or 0 */
+	uint64_t		io_budget_reads; /* max read() calls or 0 */
+	uint64_t		io_bytes;	/* bytes read since blkid_probe_set_device() */
+	uint64_t		io_reads;	/* read() calls since blkid_probe_set_device() */
 	struct list_head	hints;
 
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
 	struct blkid_chain	*cur_chain;		/* current chain */
 
 	struct list_head	values;		/* results */
+	struct blkid_arena	vals_arena;	/* memory for results */
 
 	struct blkid_struct_probe *parent;	/* for clones */
 	struct blkid_struct_probe *disk_probe;	/* whole-disk probing */
@@ -232,10 +292,34 @@ struct blkid_struct_probe
 #define BLKID_FL_CDROM_DEV	(1 << 3)	/* is a CD/DVD drive */
 #define BLKID_FL_NOSCAN_DEV	(1 << 4)	/* do not scan this device */
 #define BLKID_FL_MODIF_BUFF	(1 << 5)	/* cached buffers has been modified */
+#define BLKID_FL_PARTIAL	(1 << 7)	/* read refused by I/O budget */
+#define BLKID_FL_DIRECTIO	(1 << 8)	/* see blkid_probe_enable_directio() */
 
 /* private per-probing flags */
 #define BLKID_PROBE_FL_IGNORE_PT (1 << 1)	/* ignore partition table */
 
+extern void blkid_probe_stats_begin(blkid_probe pr, struct blkid_chain *chn,
+			const struct blkid_idinfo *id, struct blkid_prstat_ctx *ctx)
+			__attribute__((nonnull));
+extern void blkid_probe_stats_end(blkid_probe pr, struct blkid_prstat_ctx *ctx, int rc)
+			__attribute__((nonnull));
+
+/* arena.c */
+extern void blkid_init_arena(struct blkid_arena *ar, size_t chunksz)
+			__attribute__((nonnull));
+extern void *blkid_arena_alloc(struct blkid_arena *ar, size_t len, size_t align)
+			__attribute__((nonnull))
+			__attribute__((warn_unused_result));
+extern void *blkid_arena_calloc(struct blkid_arena *ar, size_t len)
+			__attribute__((nonnull))
+			__attribute__((warn_unused_result));
+extern void blkid_arena_free(struct blkid_arena *ar, void *ptr)
+			__attribute__((nonnull(1)));
+extern void blkid_reset_arena(struct blkid_arena *ar)
+			__attribute__((nonnull));
+extern void blkid_free_arena(struct blkid_arena *ar)
+			__attribute__((nonnull));
+
 extern blkid_probe blkid_clone_probe(blkid_probe parent);
 extern blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr);
 
@@ -257,6 +341,8 @@ struct blkid_config {
 	int nevals;			/* number of elems in eval array */
 	int uevent;			/* SEND_UEVENT=<yes|not> option */
 	char *cachefile;		/* CACHE_FILE=<path> option */
+	int cachebin;			/* CACHE_BINARY=<yes|no> option */
+	int directio;			/* PROBE_DIRECTIO=<yes|no> option */
 };
 
 extern struct blkid_config *blkid_read_config(const char *filename)
@@ -292,10 +378,23 @@ struct blkid_struct_cache
 	unsigned int		bic_flags;	/* Status flags of the cache */
 	char			*bic_filename;	/* filename of cache */
 	blkid_probe		probe;		/* low-level probing stuff */
+
+	struct list_head	*bic_hash;	/* NAME=value index of device tags */
+	size_t			bic_hashsz;	/* number of buckets */
+	size_t			bic_nhashed;	/* number of tags in the index */
+
+	int			bic_monitor_fd;	/* uevent monitor (monitor.c) */
+
+	struct blkid_dm_table	*bic_dmtab;	/* device-mapper devices, during probe_all() */
 };
 
+#define BLKID_BIC_HASHSZ	64	/* initial number of index buckets */
+
 #define BLKID_BIC_FL_PROBED	0x0002	/* We probed /proc/partition devices */
 #define BLKID_BIC_FL_CHANGED	0x0004	/* Cache has changed from disk */
+#define BLKID_BIC_FL_DEFER	0x0008	/* Postpone devices probing (blkid_verify()) */
+#define BLKID_BIC_FL_BINARY	0x0010	/* Maintain binary cache file (bincache.c) */
+#define BLKID_BIC_FL_DIRECTIO	0x0020	/* Probe devices by O_DIRECT */
 
 /* config file */
 #define BLKID_CONFIG_FILE	"/etc/blkid.conf"
@@ -351,6 +450,26 @@ UL_DEBUG_DECLARE_MASK(libblkid);
 #define UL_DEBUG_CURRENT_MASK	UL_DEBUG_MASK(libblkid)
 #include "debugobj.h"
 
+/*
+ * Statistics, see blkid_enable_stats()
+ */
+enum {
+	BLKID_STAT_PROBE_ALLOC = 0,
+	BLKID_STAT_PROBE_NS,
+	BLKID_STAT_PROBER_CALLS,
+	BLKID_STAT_READS,
+	BLKID_STAT_READ_BYTES,
+	BLKID_STAT_BUFFER_HITS,
+	BLKID_STAT_CACHE_HITS,
+	BLKID_STAT_CACHE_REVALIDATE,
+
+	__BLKID_STAT_COUNT
+};
+
+UL_DEBUG_DECLARE_STATS(libblkid, __BLKID_STAT_COUNT);
+#define STAT_ADD(c, n)	__UL_STAT_ADD(libblkid, BLKID_STAT_, c, n)
+#define STAT_TIME(c, x)	__UL_STAT_TIME(libblkid, BLKID_STAT_, c, x)
+
 extern void blkid_debug_dump_dev(blkid_dev dev);
 
 
@@ -364,13 +483,30 @@ extern void blkid__scan_dir(char *, dev_t, struct dir_list **, char **)
 extern int blkid_driver_has_major(const char *drvname, int drvmaj)
 			__attribute__((warn_unused_result));
 
+/* verify.c */
+extern int blkid__verify_probe(blkid_probe pr, int fd)
+			__attribute__((nonnull));
+extern void blkid__verify_apply(blkid_probe pr, blkid_dev dev, dev_t devno)
+			__attribute__((nonnull));
+extern void blkid__verify_reset(blkid_probe pr)
+			__attribute__((nonnull));
+
 /* read.c */
 extern void blkid_read_cache(blkid_cache cache)
 			__attribute__((nonnull));
 
-/* save.c */
-extern int blkid_flush_cache(blkid_cache cache)
+/* bincache.c */
+extern char *blkid_get_bincache_filename(const char *filename)
+			__attribute__((nonnull))
+			__attribute__((warn_unused_result));
+extern int blkid_read_bincache(blkid_cache cache)
 			__attribute__((nonnull));
+extern int blkid_write_bincache(blkid_cache cache, const char *filename)
+			__attribute__((nonnull));
+extern char *blkid_bincache_lookup(const char *filename, const char *type,
+				   const char *value)
+			__attribute__((nonnull))
+			__attribute__((warn_unused_result));
 
 /* cache */
 extern char *blkid_safe_getenv(const char *arg)
@@ -387,6 +523,14 @@ extern blkid_tag blkid_find_tag_dev(blkid_dev dev, const char *type)
 			__attribute__((nonnull))
 			__attribute__((warn_unused_result));
 
+extern int blkid_init_tag_hash(blkid_cache cache);
+
+/* devname.c */
+extern void blkid__probe_devno(blkid_cache cache, const char *ptname, dev_t devno);
+
+/* monitor.c */
+extern void blkid__close_monitor(blkid_cache cache);
+
 extern int blkid_set_tag(blkid_dev dev, const char *name,
 			 const char *value, const int vlength)
 			__attribute__((nonnull(1,2)));
@@ -411,6 +555,10 @@ extern unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 			__attribute__((nonnull))
 			__attribute__((warn_unused_result));
 
+extern int blkid_probe_prefetch_buffers(blkid_probe pr, uint64_t *offs,
+				size_t noffs, uint64_t len)
+			__attribute__((nonnull));
+
 extern unsigned char *blkid_probe_get_sector(blkid_probe pr, unsigned int sector)
 			__attribute__((nonnull))
 			__attribute__((warn_unused_result));
@@ -423,6 +571,9 @@ extern int blkid_probe_set_dimension(blkid_probe pr,
 	                uint64_t off, uint64_t size)
 			__attribute__((nonnull));
 
+extern uint64_t blkid_probe_get_idmag_off(blkid_probe pr, const struct blkid_idmag *mag)
+			__attribute__((nonnull));
+
 extern int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 			uint64_t *offset, const struct blkid_idmag **res)
 			__attribute__((nonnull(1)));
@@ -488,14 +639,16 @@ extern void *blkid_probe_get_binary_data(blkid_probe pr, struct blkid_chain *chn
 			__attribute__((nonnull))
 			__attribute__((warn_unused_result));
 
-extern struct blkid_prval *blkid_probe_new_val(void)
-			__attribute__((warn_unused_result));
 extern int blkid_probe_set_value(blkid_probe pr, const char *name,
 				const unsigned char *data, size_t len)
 			__attribute__((nonnull));
-extern int blkid_probe_value_set_data(struct blkid_prval *v,
+extern int blkid_probe_value_set_data(blkid_probe pr, struct blkid_prval *v,
 				const unsigned char *data, size_t len)
 			__attribute__((nonnull));
+extern unsigned char *blkid_probe_value_alloc_data(blkid_probe pr,
+				struct blkid_prval *v, size_t len)
+			__attribute__((nonnull))
+			__attribute__((warn_unused_result));
 
 extern int blkid_probe_vsprintf_value(blkid_probe pr, const char *name,
 				const char *fmt, va_list ap)
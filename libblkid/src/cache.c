@@ -92,6 +92,7 @@ char *blkid_get_cache_filename(struct blkid_config *conf)
  */
 int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 {
+	struct blkid_config *conf;
 	blkid_cache cache;
 
 	if (!ret_cache)
@@ -105,13 +106,27 @@ int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 	DBG(CACHE, ul_debugobj(cache, "alloc (from %s)", filename ? filename : "default cache"));
 	INIT_LIST_HEAD(&cache->bic_devs);
 	INIT_LIST_HEAD(&cache->bic_tags);
+	cache->bic_monitor_fd = -1;
+
+	if (blkid_init_tag_hash(cache) != 0) {
+		free(cache);
+		return -BLKID_ERR_MEM;
+	}
 
 	if (filename && !*filename)
 		filename = NULL;
+
+	conf = blkid_read_config(NULL);
+	if (conf && conf->cachebin)
+		cache->bic_flags |= BLKID_BIC_FL_BINARY;
+	if (conf && conf->directio)
+		cache->bic_flags |= BLKID_BIC_FL_DIRECTIO;
+
 	if (filename)
 		cache->bic_filename = strdup(filename);
 	else
-		cache->bic_filename = blkid_get_cache_filename(NULL);
+		cache->bic_filename = blkid_get_cache_filename(conf);
+	blkid_free_config(conf);
 
 	blkid_read_cache(cache);
 	*ret_cache = cache;
@@ -161,7 +176,9 @@ void blkid_put_cache(blkid_cache cache)
 	}
 
 	blkid_free_probe(cache->probe);
+	blkid__close_monitor(cache);
 
+	free(cache->bic_hash);
 	free(cache->bic_filename);
 	free(cache);
 }
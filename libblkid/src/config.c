@@ -100,6 +100,18 @@ static int parse_next(FILE *fd, struct blkid_config *conf)
 			conf->cachefile = strdup(s);
 		else
 			conf->cachefile = NULL;
+	} else if (!strncmp(s, "CACHE_BINARY=", 13)) {
+		s += 13;
+		if (*s && !strcasecmp(s, "yes"))
+			conf->cachebin = TRUE;
+		else if (*s)
+			conf->cachebin = FALSE;
+	} else if (!strncmp(s, "PROBE_DIRECTIO=", 15)) {
+		s += 15;
+		if (*s && !strcasecmp(s, "yes"))
+			conf->directio = TRUE;
+		else if (*s)
+			conf->directio = FALSE;
 	} else if (!strncmp(s, "EVALUATE=", 9)) {
 		s += 9;
 		if (*s && parse_evaluate(conf, s) == -1)
@@ -194,6 +206,8 @@ int main(int argc, char *argv[])
 
 	printf("SEND UEVENT: %s\n", conf->uevent ? "TRUE" : "FALSE");
 	printf("CACHE_FILE:  %s\n", conf->cachefile);
+	printf("CACHE_BINARY: %s\n", conf->cachebin ? "TRUE" : "FALSE");
+	printf("PROBE_DIRECTIO: %s\n", conf->directio ? "TRUE" : "FALSE");
 
 	blkid_free_config(conf);
 	return EXIT_SUCCESS;
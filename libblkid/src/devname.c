@@ -33,6 +33,9 @@
 #include <errno.h>
 #endif
 #include <time.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "blkidP.h"
 
@@ -41,6 +44,39 @@
 #include "sysfs.h"
 #include "fileutils.h"
 
+/*
+ * If the device is verified, then search the blkid cache for any entries
+ * that match on the type, uuid, and label, and verify them; if a cache entry
+ * can not be verified, then it's stale and so we remove it.
+ */
+static void free_stale_devs(blkid_cache cache, blkid_dev dev)
+{
+	struct list_head *p, *pnext;
+
+	list_for_each_safe(p, pnext, &cache->bic_devs) {
+		blkid_dev dev2 = list_entry(p, struct blkid_struct_dev, bid_devs);
+		if (dev2->bid_flags & BLKID_BID_FL_VERIFIED)
+			continue;
+		if (!dev->bid_type || !dev2->bid_type ||
+		    strcmp(dev->bid_type, dev2->bid_type) != 0)
+			continue;
+		if (dev->bid_label && dev2->bid_label &&
+		    strcmp(dev->bid_label, dev2->bid_label) != 0)
+			continue;
+		if (dev->bid_uuid && dev2->bid_uuid &&
+		    strcmp(dev->bid_uuid, dev2->bid_uuid) != 0)
+			continue;
+		if ((dev->bid_label && !dev2->bid_label) ||
+		    (!dev->bid_label && dev2->bid_label) ||
+		    (dev->bid_uuid && !dev2->bid_uuid) ||
+		    (!dev->bid_uuid && dev2->bid_uuid))
+			continue;
+		dev2 = blkid_verify(cache, dev2);
+		if (dev2 && !(dev2->bid_flags & BLKID_BID_FL_VERIFIED))
+			blkid_free_dev(dev2);
+	}
+}
+
 /*
  * Find a dev struct in the cache by device name, if available.
  *
@@ -50,7 +86,7 @@
 blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 {
 	blkid_dev dev = NULL, tmp;
-	struct list_head *p, *pnext;
+	struct list_head *p;
 	char *cn = NULL;
 
 	if (!cache || !devname)
@@ -109,35 +145,7 @@ blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 		dev = blkid_verify(cache, dev);
 		if (!dev || !(dev->bid_flags & BLKID_BID_FL_VERIFIED))
 			goto done;
-		/*
-		 * If the device is verified, then search the blkid
-		 * cache for any entries that match on the type, uuid,
-		 * and label, and verify them; if a cache entry can
-		 * not be verified, then it's stale and so we remove
-		 * it.
-		 */
-		list_for_each_safe(p, pnext, &cache->bic_devs) {
-			blkid_dev dev2 = list_entry(p, struct blkid_struct_dev, bid_devs);
-			if (dev2->bid_flags & BLKID_BID_FL_VERIFIED)
-				continue;
-			if (!dev->bid_type || !dev2->bid_type ||
-			    strcmp(dev->bid_type, dev2->bid_type) != 0)
-				continue;
-			if (dev->bid_label && dev2->bid_label &&
-			    strcmp(dev->bid_label, dev2->bid_label) != 0)
-				continue;
-			if (dev->bid_uuid && dev2->bid_uuid &&
-			    strcmp(dev->bid_uuid, dev2->bid_uuid) != 0)
-				continue;
-			if ((dev->bid_label && !dev2->bid_label) ||
-			    (!dev->bid_label && dev2->bid_label) ||
-			    (dev->bid_uuid && !dev2->bid_uuid) ||
-			    (!dev->bid_uuid && dev2->bid_uuid))
-				continue;
-			dev2 = blkid_verify(cache, dev2);
-			if (dev2 && !(dev2->bid_flags & BLKID_BID_FL_VERIFIED))
-				blkid_free_dev(dev2);
-		}
+		free_stale_devs(cache, dev);
 	}
 done:
 	if (dev)
@@ -181,6 +189,131 @@ static int is_dm_leaf(const char *devname)
 	return ret;
 }
 
+/*
+ * Device-mapper devices, read by one pass over /sys/block before the devices
+ * are probed. It replaces is_dm_leaf() (a scan of all dm-<N>/slaves for
+ * every dm device) and the dm-<N> to /dev/mapper/<name> translation for
+ * every device.
+ */
+struct blkid_dm_dev {
+	char		*kname;		/* dm-<N> */
+	char		*mapper;	/* /dev/mapper/<name> or NULL */
+	dev_t		devno;
+	unsigned int	used : 1;	/* slave of another dm device */
+};
+
+struct blkid_dm_table {
+	struct blkid_dm_dev	*devs;	/* sorted by kname */
+	size_t			ndevs;
+};
+
+static int cmp_dm_devs(const void *a, const void *b)
+{
+	const struct blkid_dm_dev *x = a, *y = b;
+
+	return strcmp(x->kname, y->kname);
+}
+
+static struct blkid_dm_dev *dm_table_find(struct blkid_dm_table *tab,
+					  const char *kname)
+{
+	struct blkid_dm_dev key = { .kname = (char *) kname };
+
+	if (!tab || !tab->ndevs)
+		return NULL;
+	return bsearch(&key, tab->devs, tab->ndevs, sizeof(key), cmp_dm_devs);
+}
+
+static void dm_table_free(struct blkid_dm_table *tab)
+{
+	size_t i;
+
+	if (!tab)
+		return;
+	for (i = 0; i < tab->ndevs; i++) {
+		free(tab->devs[i].kname);
+		free(tab->devs[i].mapper);
+	}
+	free(tab->devs);
+	free(tab);
+}
+
+static struct blkid_dm_table *dm_table_read(void)
+{
+	struct blkid_dm_table *tab;
+	struct dirent *de;
+	DIR *dir;
+	size_t i, nalloc = 0;
+
+	if ((dir = opendir(_PATH_SYS_BLOCK)) == NULL)
+		return NULL;
+	tab = calloc(1, sizeof(*tab));
+	if (!tab)
+		goto fail;
+
+	while ((de = xreaddir(dir))) {
+		struct blkid_dm_dev *x;
+
+		if (strncmp(de->d_name, "dm-", 3) != 0 || !isdigit(de->d_name[3]))
+			continue;
+		if (tab->ndevs == nalloc) {
+			nalloc += 32;
+			x = realloc(tab->devs, nalloc * sizeof(*x));
+			if (!x)
+				goto fail;
+			tab->devs = x;
+		}
+		x = &tab->devs[tab->ndevs];
+		memset(x, 0, sizeof(*x));
+		x->kname = strdup(de->d_name);
+		if (!x->kname)
+			goto fail;
+		tab->ndevs++;
+		x->devno = sysfs_devname_to_devno(x->kname);
+		x->mapper = canonicalize_dm_name(x->kname);
+	}
+	closedir(dir);
+	dir = NULL;
+
+	if (tab->ndevs)
+		qsort(tab->devs, tab->ndevs, sizeof(*tab->devs), cmp_dm_devs);
+
+	/* mark the devices used by another dm device */
+	for (i = 0; i < tab->ndevs; i++) {
+		char path[NAME_MAX + sizeof(_PATH_SYS_BLOCK) + 8];
+		DIR *slaves;
+
+		snprintf(path, sizeof(path), _PATH_SYS_BLOCK "/%s/slaves",
+				tab->devs[i].kname);
+		if ((slaves = opendir(path)) == NULL)
+			continue;
+		while ((de = xreaddir(slaves))) {
+			struct blkid_dm_dev *x = dm_table_find(tab, de->d_name);
+			if (x)
+				x->used = 1;
+		}
+		closedir(slaves);
+	}
+
+	DBG(DEVNAME, ul_debug("read %zu device-mapper devices", tab->ndevs));
+	return tab;
+fail:
+	if (dir)
+		closedir(dir);
+	dm_table_free(tab);
+	return NULL;
+}
+
+/* returns 1 if @ptname is not used by any other device-mapper device */
+static int dm_is_leaf(blkid_cache cache, const char *ptname)
+{
+	struct blkid_dm_dev *dm = dm_table_find(cache->bic_dmtab, ptname);
+
+	if (dm)
+		return !dm->used;
+	return is_dm_leaf(ptname);
+}
+
 /*
  * Probe a single block device to add to the device cache.
  */
@@ -212,7 +345,12 @@ static void probe_one(blkid_cache cache, const char *ptname,
 	 * to standard /dev/mapper/<name>.
 	 */
 	if (!strncmp(ptname, "dm-", 3) && isdigit(ptname[3])) {
-		devname = canonicalize_dm_name(ptname);
+		struct blkid_dm_dev *dm = dm_table_find(cache->bic_dmtab, ptname);
+
+		if (dm && dm->devno == devno)
+			devname = dm->mapper ? strdup(dm->mapper) : NULL;
+		else
+			devname = canonicalize_dm_name(ptname);
 		if (!devname)
 			blkid__scan_dir("/dev/mapper", devno, NULL, &devname);
 		if (devname)
@@ -261,7 +399,7 @@ set_pri:
 			dev->bid_pri = pri;
 		else if (!strncmp(dev->bid_name, "/dev/mapper/", 12)) {
 			dev->bid_pri = BLKID_PRI_DM;
-			if (is_dm_leaf(ptname))
+			if (dm_is_leaf(cache, ptname))
 				dev->bid_pri += 5;
 		} else if (!strncmp(ptname, "md", 2))
 			dev->bid_pri = BLKID_PRI_MD;
@@ -270,6 +408,15 @@ set_pri:
 	}
 }
 
+/*
+ * Probes (or verifies) one device, @ptname is the kernel name of the device
+ * (e.g. "sda1" or "dm-0").
+ */
+void blkid__probe_devno(blkid_cache cache, const char *ptname, dev_t devno)
+{
+	probe_one(cache, ptname, devno, 0, 0, 0);
+}
+
 #define PROC_PARTITIONS "/proc/partitions"
 #define VG_DIR		"/proc/lvm/VGs"
 
@@ -557,10 +704,153 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 	return 0;
 }
 
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Parallel probing of the devices postponed by blkid_verify()
+ */
+struct probe_workers {
+	blkid_cache	cache;
+	blkid_dev	*devs;		/* postponed devices */
+	int		*failed;	/* devices to remove from cache */
+	size_t		ndevs;
+	size_t		next;		/* the next device to probe */
+
+	pthread_mutex_t	lock;		/* protects @next and @cache */
+};
+
+static void *probe_worker(void *data)
+{
+	struct probe_workers *wrk = (struct probe_workers *) data;
+	blkid_probe pr = blkid_new_probe();
+
+	if (pr && (wrk->cache->bic_flags & BLKID_BIC_FL_DIRECTIO))
+		blkid_probe_enable_directio(pr, 1);
+
+	while (1) {
+		blkid_dev dev;
+		struct stat st;
+		size_t idx;
+		int fd, rc = -1;
+
+		pthread_mutex_lock(&wrk->lock);
+		idx = wrk->next++;
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (idx >= wrk->ndevs)
+			break;
+
+		dev = wrk->devs[idx];
+		fd = open(dev->bid_name, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+		if (fd < 0) {
+			DBG(PROBE, ul_debug("%s: open failed: %m", dev->bid_name));
+			/* keep cache data, see blkid_verify() */
+			if (errno != EPERM && errno != EACCES && errno != ENOENT)
+				wrk->failed[idx] = 1;
+			continue;
+		}
+
+		if (pr && fstat(fd, &st) == 0)
+			rc = blkid__verify_probe(pr, fd);
+
+		pthread_mutex_lock(&wrk->lock);
+		if (rc == 0)
+			blkid__verify_apply(pr, dev, st.st_rdev);
+		else
+			wrk->failed[idx] = 1;
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (pr)
+			blkid__verify_reset(pr);
+		close(fd);
+	}
+
+	blkid_free_probe(pr);
+	return NULL;
+}
+
+static void probe_postponed(blkid_cache cache, size_t nthreads)
+{
+	struct probe_workers wrk = { .cache = cache };
+	struct list_head *p, *pnext;
+	pthread_t *threads = NULL;
+	size_t i, nrun = 0;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		if (dev->bid_flags & BLKID_BID_FL_PENDING)
+			wrk.ndevs++;
+	}
+	if (!wrk.ndevs)
+		return;
+
+	wrk.devs = calloc(wrk.ndevs, sizeof(blkid_dev));
+	wrk.failed = calloc(wrk.ndevs, sizeof(int));
+	if (nthreads > wrk.ndevs)
+		nthreads = wrk.ndevs;
+	threads = calloc(nthreads, sizeof(pthread_t));
+
+	if (!wrk.devs || !wrk.failed || !threads)
+		goto serial;
+
+	i = 0;
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		if (dev->bid_flags & BLKID_BID_FL_PENDING)
+			wrk.devs[i++] = dev;
+	}
+
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	DBG(PROBE, ul_debug("probing %zu devices by %zu threads", wrk.ndevs, nthreads));
+
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, probe_worker, &wrk) != 0)
+			break;
+	}
+	if (!nrun)
+		probe_worker(&wrk);
+
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wrk.lock);
+
+	for (i = 0; i < wrk.ndevs; i++) {
+		wrk.devs[i]->bid_flags &= ~BLKID_BID_FL_PENDING;
+		if (wrk.failed[i])
+			blkid_free_dev(wrk.devs[i]);
+		if (wrk.failed[i] || !(wrk.devs[i]->bid_flags & BLKID_BID_FL_VERIFIED))
+			wrk.devs[i] = NULL;
+	}
+
+	/*
+	 * The same as blkid_get_dev() does for the verified devices. The
+	 * cleanup frees only unverified entries, so it never frees @devs.
+	 */
+	for (i = 0; i < wrk.ndevs; i++) {
+		if (wrk.devs[i])
+			free_stale_devs(cache, wrk.devs[i]);
+	}
+serial:
+	/* nothing probed in threads (ENOMEM) */
+	list_for_each_safe(p, pnext, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		if (dev->bid_flags & BLKID_BID_FL_PENDING) {
+			dev->bid_flags &= ~BLKID_BID_FL_PENDING;
+			blkid_verify(cache, dev);
+		}
+	}
+
+	free(threads);
+	free(wrk.devs);
+	free(wrk.failed);
+}
+#endif /* HAVE_LIBPTHREAD */
+
 /*
  * Read the device data for all available block devices in the system.
  */
-static int probe_all(blkid_cache cache, int only_if_new)
+static int probe_all(blkid_cache cache, int only_if_new, size_t nthreads)
 {
 	if (!cache)
 		return -BLKID_ERR_PARAM;
@@ -571,6 +861,13 @@ static int probe_all(blkid_cache cache, int only_if_new)
 
 	blkid_read_cache(cache);
 
+	cache->bic_dmtab = dm_table_read();
+
+#ifdef HAVE_LIBPTHREAD
+	/* collect devices, the probing is postponed */
+	if (nthreads > 1)
+		cache->bic_flags |= BLKID_BIC_FL_DEFER;
+#endif
 	evms_probe_all(cache, only_if_new);
 #ifdef VG_DIR
 	lvm_probe_all(cache, only_if_new);
@@ -579,6 +876,15 @@ static int probe_all(blkid_cache cache, int only_if_new)
 
 	sysfs_probe_all(cache, only_if_new, 0);
 
+#ifdef HAVE_LIBPTHREAD
+	if (cache->bic_flags & BLKID_BIC_FL_DEFER) {
+		cache->bic_flags &= ~BLKID_BIC_FL_DEFER;
+		probe_postponed(cache, nthreads);
+	}
+#endif
+	dm_table_free(cache->bic_dmtab);
+	cache->bic_dmtab = NULL;
+
 	blkid_flush_cache(cache);
 	return 0;
 }
@@ -596,7 +902,7 @@ int blkid_probe_all(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all()"));
-	ret = probe_all(cache, 0);
+	ret = probe_all(cache, 0, 1);
 	if (ret == 0) {
 		cache->bic_time = time(NULL);
 		cache->bic_flags |= BLKID_BIC_FL_PROBED;
@@ -605,6 +911,41 @@ int blkid_probe_all(blkid_cache cache)
 	return ret;
 }
 
+/**
+ * blkid_probe_all_parallel:
+ * @cache: cache handler
+ * @nthreads: number of threads or 0
+ *
+ * The same as blkid_probe_all(), but the devices are probed by @nthreads
+ * threads. If @nthreads is 0 then the number of online CPUs is used. The
+ * function falls back to blkid_probe_all() if the library has been compiled
+ * without threads support.
+ *
+ * Since: ext-1
+ *
+ * Returns: 0 on success, or number less than zero in case of error.
+ */
+int blkid_probe_all_parallel(blkid_cache cache, int nthreads)
+{
+	int ret;
+
+	if (nthreads < 0)
+		return -BLKID_ERR_PARAM;
+	if (nthreads == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = n > 0 ? (int) n : 1;
+	}
+
+	DBG(PROBE, ul_debug("Begin blkid_probe_all_parallel() [threads=%d]", nthreads));
+	ret = probe_all(cache, 0, nthreads);
+	if (ret == 0) {
+		cache->bic_time = time(NULL);
+		cache->bic_flags |= BLKID_BIC_FL_PROBED;
+	}
+	DBG(PROBE, ul_debug("End blkid_probe_all_parallel() [rc=%d]", ret));
+	return ret;
+}
+
 /**
  * blkid_probe_all_new:
  * @cache: cache handler
@@ -618,7 +959,7 @@ int blkid_probe_all_new(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all_new()"));
-	ret = probe_all(cache, 1);
+	ret = probe_all(cache, 1, 1);
 	DBG(PROBE, ul_debug("End blkid_probe_all_new() [rc=%d]", ret));
 	return ret;
 }
@@ -135,14 +135,11 @@ int blkid_send_uevent(const char *devname, const char *action)
 	return rc;
 }
 
-static char *evaluate_by_udev(const char *token, const char *value, int uevent)
+/* composes /dev/disk/by-* path for the tag */
+static int get_udev_link(const char *token, const char *value,
+			 char *dev, size_t sz)
 {
-	char dev[PATH_MAX];
-	char *path = NULL;
 	size_t len;
-	struct stat st;
-
-	DBG(EVALUATE, ul_debug("evaluating by udev %s=%s", token, value));
 
 	if (!strcmp(token, "UUID"))
 		strcpy(dev, _PATH_DEV_BYUUID "/");
@@ -156,14 +153,27 @@ static char *evaluate_by_udev(const char *token, const char *value, int uevent)
 		strcpy(dev, _PATH_DEV_BYID "/");
 	else {
 		DBG(EVALUATE, ul_debug("unsupported token %s", token));
-		return NULL;	/* unsupported tag */
+		return -EINVAL;	/* unsupported tag */
 	}
 
 	len = strlen(dev);
-	if (blkid_encode_string(value, &dev[len], sizeof(dev) - len) != 0)
-		return NULL;
+	if (blkid_encode_string(value, &dev[len], sz - len) != 0)
+		return -EINVAL;
 
 	DBG(EVALUATE, ul_debug("expected udev link: %s", dev));
+	return 0;
+}
+
+static char *evaluate_by_udev(const char *token, const char *value, int uevent)
+{
+	char dev[PATH_MAX];
+	char *path = NULL;
+	struct stat st;
+
+	DBG(EVALUATE, ul_debug("evaluating by udev %s=%s", token, value));
+
+	if (get_udev_link(token, value, dev, sizeof(dev)) != 0)
+		return NULL;
 
 	if (stat(dev, &st))
 		goto failed;	/* link or device does not exist */
@@ -190,6 +200,37 @@ failed:
 	return NULL;
 }
 
+/*
+ * Looks up the tag in the binary cache file without reading the whole cache.
+ * The device is verified by a temporary cache which is not saved.
+ */
+static char *evaluate_by_bincache(const char *token, const char *value,
+		const char *cachefile)
+{
+	blkid_cache c = NULL;
+	blkid_dev dev;
+	char *res;
+
+	res = blkid_bincache_lookup(cachefile, token, value);
+	if (!res)
+		return NULL;
+
+	if (blkid_get_cache(&c, "/dev/null") != 0)
+		goto fail;
+
+	dev = blkid_get_dev(c, res, BLKID_DEV_NORMAL);
+	if (!dev || !blkid_dev_has_tag(dev, token, value))
+		goto fail;
+
+	blkid_put_cache(c);
+	return res;
+fail:
+	DBG(EVALUATE, ul_debug("binary cache %s=%s: %s not verified", token, value, res));
+	blkid_put_cache(c);
+	free(res);
+	return NULL;
+}
+
 static char *evaluate_by_scan(const char *token, const char *value,
 		blkid_cache *cache, struct blkid_config *conf)
 {
@@ -200,6 +241,14 @@ static char *evaluate_by_scan(const char *token, const char *value,
 
 	if (!c) {
 		char *cachefile = blkid_get_cache_filename(conf);
+
+		if (cachefile && conf && conf->cachebin && !cache) {
+			res = evaluate_by_bincache(token, value, cachefile);
+			if (res) {
+				free(cachefile);
+				return res;
+			}
+		}
 		blkid_get_cache(&c, cachefile);
 		free(cachefile);
 	}
@@ -272,6 +321,198 @@ out:
 	return ret;
 }
 
+/*
+ * Evaluates all unresolved tags by udev links. The same as
+ * evaluate_by_udev(), the links are verified by probing only if
+ * CONFIG_BLKID_VERIFY_UDEV; every device is probed only once.
+ */
+static void evaluate_tags_by_udev(char **tokens, char **values, char *res[],
+				  size_t ntags, int uevent)
+{
+	blkid_cache c = NULL;
+#ifdef CONFIG_BLKID_VERIFY_UDEV
+	int verify = 1;
+#else
+	int verify = 0;
+#endif
+	size_t i;
+
+	DBG(EVALUATE, ul_debug("evaluating %zu tags by udev (%s)", ntags,
+				verify ? "verify" : "trust links"));
+
+	for (i = 0; i < ntags; i++) {
+		char dev[PATH_MAX];
+		struct stat st;
+		blkid_dev bdev;
+		char *path;
+
+		if (res[i] || !tokens[i])
+			continue;
+		if (get_udev_link(tokens[i], values[i], dev, sizeof(dev)) != 0
+		    || stat(dev, &st) != 0 || !S_ISBLK(st.st_mode))
+			continue;
+
+		path = canonicalize_path(dev);
+		if (!path)
+			continue;
+
+		/* "ID" is a not content tag, the link cannot be verified */
+		if (!verify || strcmp(tokens[i], "ID") == 0) {
+			res[i] = path;
+			continue;
+		}
+
+		if (!c && blkid_get_cache(&c, "/dev/null") != 0) {
+			free(path);
+			break;
+		}
+
+		/* every device is probed only once */
+		bdev = blkid_get_dev(c, path, BLKID_DEV_FIND);
+		if (!bdev)
+			bdev = blkid_get_dev(c, path, BLKID_DEV_NORMAL);
+
+		if (bdev && blkid_dev_has_tag(bdev, tokens[i], values[i])) {
+			res[i] = path;
+			continue;
+		}
+
+		DBG(EVALUATE, ul_debug("%s=%s: %s not verified",
+					tokens[i], values[i], path));
+		if (uevent)
+			blkid_send_uevent(path, "change");
+		free(path);
+	}
+
+	blkid_put_cache(c);
+}
+
+/* evaluates all unresolved tags by one cache */
+static void evaluate_tags_by_scan(char **tokens, char **values, char *res[],
+				  size_t ntags, blkid_cache *cache,
+				  struct blkid_config *conf)
+{
+	blkid_cache c = cache ? *cache : NULL;
+	size_t i;
+
+	DBG(EVALUATE, ul_debug("evaluating %zu tags by blkid scan", ntags));
+
+	if (!c) {
+		char *cachefile = blkid_get_cache_filename(conf);
+
+		blkid_get_cache(&c, cachefile);
+		free(cachefile);
+	}
+	if (!c)
+		return;
+
+	for (i = 0; i < ntags; i++) {
+		if (res[i] || !tokens[i])
+			continue;
+		res[i] = blkid_get_devname(c, tokens[i], values[i]);
+	}
+
+	if (cache)
+		*cache = c;
+	else
+		blkid_put_cache(c);
+}
+
+/**
+ * blkid_evaluate_tags:
+ * @tags: array of unparsed tags (e.g. "LABEL=foo")
+ * @res: array for the results
+ * @ntags: number of tags
+ * @cache: pointer to cache (or NULL when you don't want to re-use the cache)
+ *
+ * Evaluates all tags at once; it's more effective than blkid_evaluate_tag()
+ * called for every tag, because the config file and cache are read only once
+ * and every device is probed only once. The udev links are verified the same
+ * way as by blkid_evaluate_tag().
+ *
+ * The @res array is filled with allocated device names, or NULL for tags
+ * which cannot be evaluated. Strings without '=' are returned as they are.
+ * All the @res entries are NULL in case of error.
+ *
+ * Returns: number of evaluated tags, or <0 in case of error.
+ *
+ * Since: ext-1
+ */
+int blkid_evaluate_tags(const char *tags[], char *res[], size_t ntags,
+			blkid_cache *cache)
+{
+	struct blkid_config *conf = NULL;
+	char **tokens, **values;
+	size_t i;
+	int rc = 0;
+
+	if (!tags || !res)
+		return -EINVAL;
+	if (!cache || !*cache)
+		blkid_init_debug(0);
+
+	memset(res, 0, ntags * sizeof(char *));
+	if (!ntags)
+		return 0;
+
+	tokens = calloc(ntags, sizeof(char *));
+	values = calloc(ntags, sizeof(char *));
+	if (!tokens || !values) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < ntags; i++) {
+		if (!tags[i])
+			continue;
+		if (!strchr(tags[i], '='))
+			res[i] = strdup(tags[i]);
+		else if (blkid_parse_tag_string(tags[i], &tokens[i], &values[i]) != 0
+			 || !tokens[i] || !values[i]) {
+			free(tokens[i]);
+			free(values[i]);
+			tokens[i] = values[i] = NULL;
+		}
+	}
+
+	conf = blkid_read_config(NULL);
+	if (!conf) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < (size_t) conf->nevals; i++) {
+		if (conf->eval[i] == BLKID_EVAL_UDEV)
+			evaluate_tags_by_udev(tokens, values, res, ntags, conf->uevent);
+		else if (conf->eval[i] == BLKID_EVAL_SCAN)
+			evaluate_tags_by_scan(tokens, values, res, ntags, cache, conf);
+	}
+
+	for (i = 0; i < ntags; i++) {
+		if (res[i])
+			rc++;
+	}
+	DBG(EVALUATE, ul_debug("evaluated %d from %zu tags", rc, ntags));
+out:
+	if (tokens && values) {
+		for (i = 0; i < ntags; i++) {
+			free(tokens[i]);
+			free(values[i]);
+		}
+	}
+	free(tokens);
+	free(values);
+	blkid_free_config(conf);
+
+	if (rc < 0) {
+		for (i = 0; i < ntags; i++) {
+			free(res[i]);
+			res[i] = NULL;
+		}
+	}
+	return rc;
+}
+
 /**
  * blkid_evaluate_spec:
  * @spec: unparsed tag (e.g. "LABEL=foo") or path (e.g. /dev/dm-0)
@@ -311,12 +552,30 @@ int main(int argc, char *argv[])
 	char *res;
 
 	if (argc < 2) {
-		fprintf(stderr, "usage: %s <tag> | <spec>\n", argv[0]);
+		fprintf(stderr, "usage: %s <tag> | <spec> | <tag> <tag> ...\n", argv[0]);
 		return EXIT_FAILURE;
 	}
 
 	blkid_init_debug(0);
 
+	if (argc > 2) {
+		char **res = calloc(argc - 1, sizeof(char *));
+		int i, rc;
+
+		if (!res)
+			return EXIT_FAILURE;
+		rc = blkid_evaluate_tags((const char **) argv + 1, res,
+					 argc - 1, &cache);
+		for (i = 0; i < argc - 1; i++) {
+			printf("%s: %s\n", argv[i + 1], res[i] ? res[i] : "<none>");
+			free(res[i]);
+		}
+		free(res);
+		if (cache)
+			blkid_put_cache(cache);
+		return rc == argc - 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	res = blkid_evaluate_spec(argv[1], &cache);
 	if (res)
 		printf("%s\n", res);
@@ -8,7 +8,7 @@
 /**
  * SECTION: init
  * @title: Library initialization
- * @short_description: initialize debugging
+ * @short_description: initialize debugging and statistics
  */
 
 #include <stdarg.h>
@@ -35,6 +35,25 @@ UL_DEBUG_DEFINE_MASKNAMES(libblkid) =
 	{ NULL, 0, NULL }
 };
 
+UL_DEBUG_DEFINE_STATS(libblkid, __BLKID_STAT_COUNT);
+UL_DEBUG_DEFINE_STATNAMES(libblkid) =
+{
+	[BLKID_STAT_PROBE_ALLOC]      = { "probe-alloc",	"allocated probes" },
+	[BLKID_STAT_PROBE_NS]	      = { "probe-ns",		"nanoseconds spent in safe and full probing" },
+	[BLKID_STAT_PROBER_CALLS]     = { "prober-calls",	"called probing functions" },
+	[BLKID_STAT_READS]	      = { "reads",		"read(2) calls" },
+	[BLKID_STAT_READ_BYTES]	      = { "read-bytes",		"bytes read from devices" },
+	[BLKID_STAT_BUFFER_HITS]      = { "buffer-hits",	"requests served from read buffers" },
+	[BLKID_STAT_CACHE_HITS]	      = { "cache-hits",		"cached devices valid without probing" },
+	[BLKID_STAT_CACHE_REVALIDATE] = { "cache-revalidate",	"cached devices probed again" },
+};
+
+static void blkid_print_stats(void)
+{
+	ul_debug_print_stats("libblkid", UL_DEBUG_STATNAMES(libblkid),
+			UL_DEBUG_STATS(libblkid), __BLKID_STAT_COUNT);
+}
+
 /**
  * blkid_init_debug:
  * @mask: debug mask (0xffff to enable full debugging)
@@ -44,6 +63,10 @@ UL_DEBUG_DEFINE_MASKNAMES(libblkid) =
  *
  * Already initialized debugging stuff cannot be changed. It does not
  * have effect to call this function twice.
+ *
+ * The function also reads the LIBBLKID_STATS environment variable; if set
+ * to a non-zero value, the statistics are enabled (see blkid_enable_stats())
+ * and printed to stderr at exit.
  */
 void blkid_init_debug(int mask)
 {
@@ -51,6 +74,7 @@ void blkid_init_debug(int mask)
 		return;
 
 	__UL_INIT_DEBUG_FROM_ENV(libblkid, BLKID_DEBUG_, mask, LIBBLKID_DEBUG);
+	__UL_INIT_STATS_FROM_ENV(libblkid, LIBBLKID_STATS, blkid_print_stats);
 
 	if (libblkid_debug_mask != BLKID_DEBUG_INIT
 	    && libblkid_debug_mask != (BLKID_DEBUG_HELP|BLKID_DEBUG_INIT)) {
@@ -65,3 +89,58 @@ void blkid_init_debug(int mask)
 	ON_DBG(HELP, ul_debug_print_masks("LIBBLKID_DEBUG",
 				UL_DEBUG_MASKNAMES(libblkid)));
 }
+
+/**
+ * blkid_enable_stats:
+ * @enable: TRUE or FALSE
+ *
+ * Enables or disables the library statistics counters. The counters are
+ * global for all probes and caches and all threads; see
+ * blkid_probe_enable_stats() for per-prober statistics. The counters are
+ * not reset, see blkid_reset_stats().
+ *
+ * Returns: 0 on success.
+ *
+ * Since: ext-1
+ */
+int blkid_enable_stats(int enable)
+{
+	libblkid_stats_enabled = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * blkid_reset_stats:
+ *
+ * Sets all the statistics counters to zero.
+ *
+ * Since: ext-1
+ */
+void blkid_reset_stats(void)
+{
+	size_t i;
+
+	for (i = 0; i < __BLKID_STAT_COUNT; i++)
+		__atomic_store_n(&libblkid_stats[i], 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * blkid_get_stat:
+ * @idx: counter number
+ * @name: returns name of the counter (or NULL)
+ * @value: returns value of the counter (or NULL)
+ *
+ * Returns the statistics counter, see blkid_enable_stats(). The names are
+ * the same as printed for the LIBBLKID_STATS environment variable, the
+ * counters with "-ns" suffix are in nanoseconds.
+ *
+ * Returns: 0 on success, 1 if @idx is out of range.
+ *
+ * Since: ext-1
+ */
+int blkid_get_stat(size_t idx, const char **name, unsigned long long *value)
+{
+	return ul_debug_get_stat(UL_DEBUG_STATNAMES(libblkid),
+			UL_DEBUG_STATS(libblkid), __BLKID_STAT_COUNT,
+			idx, name, value);
+}
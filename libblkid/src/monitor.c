@@ -0,0 +1,211 @@
+/*
+ * monitor.c - keep the cache up to date by kernel block device uevents
+ *
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#ifdef __linux__
+# include <linux/netlink.h>
+#endif
+
+#include "blkidP.h"
+
+#ifndef NETLINK_KOBJECT_UEVENT
+# define NETLINK_KOBJECT_UEVENT	15
+#endif
+
+#define UEVENT_BUFFER_SIZE	8192
+#define UEVENT_KERNEL_GROUP	1
+
+/**
+ * blkid_cache_get_monitor_fd:
+ * @cache: cache handler
+ *
+ * Returns file descriptor of the cache monitor. The monitor listens to kernel
+ * block devices uevents (add, change, remove). The file descriptor is
+ * non-blocking and it is usable for poll() or epoll. Call
+ * blkid_cache_process_events() when it's readable; only the devices
+ * mentioned in the events are re-probed.
+ *
+ * The monitor is closed by blkid_put_cache().
+ *
+ * Returns: file descriptor or <0 in case of error.
+ *
+ * Since: ext-1
+ */
+int blkid_cache_get_monitor_fd(blkid_cache cache)
+{
+#ifdef __linux__
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = UEVENT_KERNEL_GROUP
+	};
+	int fd;
+
+	if (!cache)
+		return -EINVAL;
+	if (cache->bic_monitor_fd >= 0)
+		return cache->bic_monitor_fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		int rc = -errno;
+
+		DBG(CACHE, ul_debugobj(cache, "failed to bind uevent socket"));
+		close(fd);
+		return rc;
+	}
+
+	DBG(CACHE, ul_debugobj(cache, "uevent monitor fd=%d", fd));
+	cache->bic_monitor_fd = fd;
+	return fd;
+#else
+	return -ENOSYS;
+#endif
+}
+
+void blkid__close_monitor(blkid_cache cache)
+{
+	if (cache->bic_monitor_fd < 0)
+		return;
+	close(cache->bic_monitor_fd);
+	cache->bic_monitor_fd = -1;
+}
+
+static blkid_dev find_dev_by_devno(blkid_cache cache, dev_t devno)
+{
+	struct list_head *p;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (dev->bid_devno == devno)
+			return dev;
+	}
+	return NULL;
+}
+
+/*
+ * Applies one uevent to the cache. The message is "<action>@<devpath>"
+ * followed by NUL-separated KEY=value pairs.
+ *
+ * Returns 1 if the cache has been modified.
+ */
+static int process_uevent(blkid_cache cache, const char *buf, size_t sz)
+{
+	const char *p, *end = buf + sz;
+	const char *action = NULL, *subsystem = NULL, *devname = NULL;
+	const char *maj = NULL, *min = NULL;
+	blkid_dev dev;
+	dev_t devno;
+
+	for (p = buf; p < end; p += strlen(p) + 1) {
+		if (!strncmp(p, "ACTION=", 7))
+			action = p + 7;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			subsystem = p + 10;
+		else if (!strncmp(p, "DEVNAME=", 8))
+			devname = p + 8;
+		else if (!strncmp(p, "MAJOR=", 6))
+			maj = p + 6;
+		else if (!strncmp(p, "MINOR=", 6))
+			min = p + 6;
+	}
+
+	if (!action || !subsystem || !maj || !min
+	    || strcmp(subsystem, "block") != 0)
+		return 0;
+
+	devno = makedev(strtoul(maj, NULL, 10), strtoul(min, NULL, 10));
+	dev = find_dev_by_devno(cache, devno);
+
+	DBG(CACHE, ul_debugobj(cache, "uevent %s %s [%u:%u]%s", action,
+				devname ? devname : "", major(devno), minor(devno),
+				dev ? " (cached)" : ""));
+
+	if (!strcmp(action, "remove")) {
+		if (!dev)
+			return 0;
+		blkid_free_dev(dev);
+		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
+		return 1;
+	}
+
+	if (strcmp(action, "add") != 0 && strcmp(action, "change") != 0
+	    && strcmp(action, "move") != 0)
+		return 0;
+
+	if (dev) {
+		/* force re-probe in blkid_verify() */
+		dev->bid_flags &= ~BLKID_BID_FL_VERIFIED;
+		dev->bid_time = 0;
+	}
+	if (devname)
+		blkid__probe_devno(cache, devname, devno);
+	else if (dev)
+		blkid_verify(cache, dev);
+	return 1;
+}
+
+/**
+ * blkid_cache_process_events:
+ * @cache: cache handler
+ *
+ * Reads all pending events from the cache monitor (see
+ * blkid_cache_get_monitor_fd()) and re-probes or removes the affected
+ * devices. The function does not block.
+ *
+ * Returns: number of events which modified the cache, or <0 in case of error.
+ *
+ * Since: ext-1
+ */
+int blkid_cache_process_events(blkid_cache cache)
+{
+	char buf[UEVENT_BUFFER_SIZE];
+	int count = 0;
+
+	if (!cache || cache->bic_monitor_fd < 0)
+		return -EINVAL;
+
+	do {
+#ifdef __linux__
+		struct sockaddr_nl addr;
+#else
+		struct sockaddr addr;
+#endif
+		socklen_t addrlen = sizeof(addr);
+		ssize_t sz;
+
+		sz = recvfrom(cache->bic_monitor_fd, buf, sizeof(buf) - 1,
+				MSG_DONTWAIT, (struct sockaddr *) &addr, &addrlen);
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+#ifdef __linux__
+		/* accept kernel messages only */
+		if (addr.nl_pid != 0)
+			continue;
+#endif
+		buf[sz] = '\0';
+		count += process_uevent(cache, buf, sz);
+	} while (1);
+
+	return count;
+}
@@ -311,7 +311,7 @@ static int probe_gpt_pt(blkid_probe pr,
 	blkid_parttable tab = NULL;
 	blkid_partlist ls;
 	uint64_t fu, lu;
-	uint32_t ssf, i;
+	uint32_t ssf, i, n;
 	efi_guid_t guid;
 	int ret;
 
@@ -368,6 +368,14 @@ static int probe_gpt_pt(blkid_probe pr,
 	fu = le64_to_cpu(h->first_usable_lba);
 	lu = le64_to_cpu(h->last_usable_lba);
 
+	/* allocate the list for all used entries at once */
+	for (i = 0, n = 0; i < le32_to_cpu(h->num_partition_entries); i++) {
+		if (guidcmp(e[i].partition_type_guid, GPT_UNUSED_ENTRY_GUID))
+			n++;
+	}
+	if (n && blkid_partlist_reserve(ls, (int) n) == -ENOMEM)
+		goto err;
+
 	for (i = 0; i < le32_to_cpu(h->num_partition_entries); i++, e++) {
 
 		blkid_partition par;
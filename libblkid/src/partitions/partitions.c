@@ -199,6 +199,10 @@ struct blkid_struct_partlist {
 	int		nparts_max;	/* max.number of partitions */
 	blkid_partition	parts;		/* array of partitions */
 
+	int		nindexed;	/* number of partitions in indexes */
+	blkid_partition	*by_partno;	/* sorted by partno (see partlist_index()) */
+	blkid_partition	*by_start;	/* sorted by start */
+
 	struct list_head l_tabs;	/* list of partition tables */
 };
 
@@ -354,11 +358,15 @@ static void reset_partlist(blkid_partlist ls)
 		/* already initialized - reset */
 		int tmp_nparts = ls->nparts_max;
 		blkid_partition tmp_parts = ls->parts;
+		blkid_partition *tmp_partno = ls->by_partno;
+		blkid_partition *tmp_start = ls->by_start;
 
 		memset(ls, 0, sizeof(struct blkid_struct_partlist));
 
 		ls->nparts_max = tmp_nparts;
 		ls->parts = tmp_parts;
+		ls->by_partno = tmp_partno;
+		ls->by_start = tmp_start;
 	}
 
 	ls->nparts = 0;
@@ -400,6 +408,8 @@ static void partitions_free_data(blkid_probe pr __attribute__((__unused__)),
 
 	/* deallocate partitions and partlist */
 	free(ls->parts);
+	free(ls->by_partno);
+	free(ls->by_start);
 	free(ls);
 }
 
@@ -423,21 +433,56 @@ blkid_parttable blkid_partlist_new_parttable(blkid_partlist ls,
 	return tab;
 }
 
+/* grows the list of partitions, the partitions may be moved in memory */
+static int grow_partlist(blkid_partlist ls, int nparts)
+{
+	void *tmp;
+
+	if (nparts <= 0 || nparts > INT_MAX - ls->nparts)
+		return -EINVAL;
+	if (ls->nparts + nparts <= ls->nparts_max)
+		return 0;
+
+	nparts += ls->nparts;
+	if ((size_t) nparts > SIZE_MAX / sizeof(struct blkid_struct_partition))
+		return -ENOMEM;
+
+	tmp = realloc(ls->parts, nparts * sizeof(struct blkid_struct_partition));
+	if (!tmp)
+		return -ENOMEM;
+
+	DBG(LOWPROBE, ul_debug("parts: reserved %d partitions", nparts));
+	ls->parts = tmp;
+	ls->nparts_max = nparts;
+	ls->nindexed = 0;		/* the indexes point to the old array */
+	return 0;
+}
+
+/*
+ * Makes sure there is space for @nparts partitions in the list. It's usable
+ * for partition tables where the number of entries is known in advance
+ * (e.g. GPT), to avoid repeated realloc() for large tables.
+ *
+ * The list may be reallocated, so it's allowed only before the first
+ * partition is added; returns -EBUSY otherwise.
+ */
+int blkid_partlist_reserve(blkid_partlist ls, int nparts)
+{
+	if (ls->nparts)
+		return -EBUSY;
+	return grow_partlist(ls, nparts);
+}
+
 static blkid_partition new_partition(blkid_partlist ls, blkid_parttable tab)
 {
 	blkid_partition par;
 
-	if (ls->nparts + 1 > ls->nparts_max) {
-		/* Linux kernel has DISK_MAX_PARTS=256, but it's too much for
-		 * generic Linux machine -- let start with 32 partitions.
-		 */
-		void *tmp = realloc(ls->parts, (ls->nparts_max + 32) *
-					sizeof(struct blkid_struct_partition));
-		if (!tmp)
-			return NULL;
-		ls->parts = tmp;
-		ls->nparts_max += 32;
-	}
+	/* Linux kernel has DISK_MAX_PARTS=256, but it's too much for
+	 * generic Linux machine -- let start with 32 partitions.
+	 */
+	if (ls->nparts + 1 > ls->nparts_max
+	    && grow_partlist(ls, 32) != 0)
+		return NULL;
 
 	par = &ls->parts[ls->nparts++];
 	memset(par, 0, sizeof(struct blkid_struct_partition));
@@ -530,7 +575,7 @@ int blkid_is_nested_dimension(blkid_partition par,
 	return 1;
 }
 
-static int idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
+static int __idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
 			struct blkid_chain *chn)
 {
 	const struct blkid_idmag *mag = NULL;
@@ -572,6 +617,21 @@ nothing:
 	return BLKID_PROBE_NONE;
 }
 
+static int idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
+			struct blkid_chain *chn)
+{
+	struct blkid_prstat_ctx stats;
+	int rc;
+
+	if (!chn)
+		return __idinfo_probe(pr, id, chn);
+
+	blkid_probe_stats_begin(pr, chn, id, &stats);
+	rc = __idinfo_probe(pr, id, chn);
+	blkid_probe_stats_end(pr, &stats, rc);
+	return rc;
+}
+
 /*
  * The blkid_do_probe() backend.
  */
@@ -957,11 +1017,116 @@ blkid_partition blkid_partlist_get_partition(blkid_partlist ls, int n)
 	return &ls->parts[n];
 }
 
+static int cmp_partno(const void *a, const void *b)
+{
+	const struct blkid_struct_partition *x = *(blkid_partition const *) a;
+	const struct blkid_struct_partition *y = *(blkid_partition const *) b;
+
+	if (x->partno != y->partno)
+		return x->partno < y->partno ? -1 : 1;
+	return x < y ? -1 : x > y ? 1 : 0;	/* keep the list order */
+}
+
+static int cmp_start(const void *a, const void *b)
+{
+	const struct blkid_struct_partition *x = *(blkid_partition const *) a;
+	const struct blkid_struct_partition *y = *(blkid_partition const *) b;
+
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * The small lists are searched linearly, the indexes are useful for large
+ * partition tables only (for example GPT with hundreds of entries).
+ */
+#define PARTLIST_INDEX_MIN	16
+
+/*
+ * Updates partno and start indexes. The partitions are never modified after
+ * blkid_partlist_add_partition(), so the indexes are valid until a new
+ * partition is added.
+ *
+ * Returns 0 if indexes are usable, or <0 (small list or ENOMEM).
+ */
+static int partlist_index(blkid_partlist ls)
+{
+	blkid_partition *x, *y;
+	int i;
+
+	if (ls->nparts < PARTLIST_INDEX_MIN)
+		return -EINVAL;
+	if (ls->nindexed == ls->nparts)
+		return 0;
+
+	ls->nindexed = 0;
+
+	x = realloc(ls->by_partno, ls->nparts * sizeof(blkid_partition));
+	if (!x)
+		return -ENOMEM;
+	ls->by_partno = x;
+
+	y = realloc(ls->by_start, ls->nparts * sizeof(blkid_partition));
+	if (!y)
+		return -ENOMEM;
+	ls->by_start = y;
+
+	for (i = 0; i < ls->nparts; i++)
+		x[i] = y[i] = &ls->parts[i];
+
+	qsort(x, ls->nparts, sizeof(blkid_partition), cmp_partno);
+	qsort(y, ls->nparts, sizeof(blkid_partition), cmp_start);
+
+	DBG(LOWPROBE, ul_debug("parts: indexed %d partitions", ls->nparts));
+	ls->nindexed = ls->nparts;
+	return 0;
+}
+
+/* returns index of the first partition with start >= @start */
+static int index_lookup_start(blkid_partlist ls, uint64_t start)
+{
+	int lo = 0, hi = ls->nindexed;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (ls->by_start[mid]->start < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* returns index of the first partition with partno >= @partno */
+static int index_lookup_partno(blkid_partlist ls, int partno)
+{
+	int lo = 0, hi = ls->nindexed;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (ls->by_partno[mid]->partno < partno)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 blkid_partition blkid_partlist_get_partition_by_start(blkid_partlist ls, uint64_t start)
 {
 	int i, nparts;
 	blkid_partition par;
 
+	if (partlist_index(ls) == 0) {
+		i = index_lookup_start(ls, start);
+		if (i < ls->nindexed && ls->by_start[i]->start == start)
+			return ls->by_start[i];
+		return NULL;
+	}
+
 	nparts = blkid_partlist_numof_partitions(ls);
 	for (i = 0; i < nparts; i++) {
 		par = blkid_partlist_get_partition(ls, i);
@@ -987,6 +1152,13 @@ blkid_partition blkid_partlist_get_partition_by_partno(blkid_partlist ls, int n)
 	int i, nparts;
 	blkid_partition par;
 
+	if (partlist_index(ls) == 0) {
+		i = index_lookup_partno(ls, n);
+		if (i < ls->nindexed && ls->by_partno[i]->partno == n)
+			return ls->by_partno[i];
+		return NULL;
+	}
+
 	nparts = blkid_partlist_numof_partitions(ls);
 	for (i = 0; i < nparts; i++) {
 		par = blkid_partlist_get_partition(ls, i);
@@ -1065,11 +1237,17 @@ blkid_partition blkid_partlist_devno_to_partition(blkid_partlist ls, dev_t devno
 		 * that we can probably make the relation between the device
 		 * and an entry in partition table.
 		 */
-		 for (i = 0; i < ls->nparts; i++) {
-			 blkid_partition par = &ls->parts[i];
+		 int indexed = partlist_index(ls) == 0;
+
+		 for (i = indexed ? index_lookup_partno(ls, partno) : 0;
+		      i < ls->nparts; i++) {
+			 blkid_partition par = indexed ? ls->by_partno[i] : &ls->parts[i];
 
-			 if (partno != blkid_partition_get_partno(par))
+			 if (partno != blkid_partition_get_partno(par)) {
+				 if (indexed)
+					 break;
 				 continue;
+			 }
 
 			 if (size == (uint64_t)blkid_partition_get_size(par) ||
 			     (blkid_partition_is_extended(par) && size <= 1024ULL))
@@ -1081,6 +1259,21 @@ blkid_partition blkid_partlist_devno_to_partition(blkid_partlist ls, dev_t devno
 
 	DBG(LOWPROBE, ul_debug("searching by offset/size"));
 
+	if (partlist_index(ls) == 0) {
+		for (i = index_lookup_start(ls, start); i < ls->nindexed; i++) {
+			blkid_partition par = ls->by_start[i];
+
+			if (par->start != start)
+				break;
+			if (par->size == size ||
+			    (blkid_partition_is_extended(par) && size <= 1024ULL))
+				return par;
+		}
+
+		DBG(LOWPROBE, ul_debug("not found partition for device"));
+		return NULL;
+	}
+
 	for (i = 0; i < ls->nparts; i++) {
 		blkid_partition par = &ls->parts[i];
 
@@ -1131,9 +1324,7 @@ int blkid_partitions_set_ptuuid(blkid_probe pr, unsigned char *uuid)
 	if (!v)
 		return -ENOMEM;
 
-	v->len = UUID_STR_LEN;
-	v->data = calloc(1, v->len);
-	if (v->data) {
+	if (blkid_probe_value_alloc_data(pr, v, UUID_STR_LEN)) {
 		blkid_unparse_uuid(uuid, (char *) v->data, v->len);
 		return 0;
 	}
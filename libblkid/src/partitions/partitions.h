@@ -16,6 +16,7 @@ extern blkid_partition blkid_partlist_add_partition(blkid_partlist ls,
 				blkid_parttable tab,
 				uint64_t start, uint64_t size);
 
+extern int blkid_partlist_reserve(blkid_partlist ls, int nparts);
 extern int blkid_partlist_set_partno(blkid_partlist ls, int partno);
 extern int blkid_partlist_increment_partno(blkid_partlist ls);
 
@@ -121,6 +121,7 @@ static const struct blkid_chaindrv *chains_drvs[] = {
 };
 
 static void blkid_probe_reset_values(blkid_probe pr);
+static void close_direct_fd(blkid_probe pr);
 
 /**
  * blkid_new_probe:
@@ -137,6 +138,7 @@ blkid_probe blkid_new_probe(void)
 	if (!pr)
 		return NULL;
 
+	STAT_ADD(PROBE_ALLOC, 1);
 	DBG(LOWPROBE, ul_debug("allocate a new probe"));
 
 	/* initialize chains */
@@ -148,6 +150,9 @@ blkid_probe blkid_new_probe(void)
 	INIT_LIST_HEAD(&pr->buffers);
 	INIT_LIST_HEAD(&pr->values);
 	INIT_LIST_HEAD(&pr->hints);
+	blkid_init_arena(&pr->bufs_arena, BLKID_BUFS_ARENASZ);
+	blkid_init_arena(&pr->vals_arena, BLKID_VALS_ARENASZ);
+	pr->dio_fd = -1;
 	return pr;
 }
 
@@ -245,27 +250,33 @@ void blkid_free_probe(blkid_probe pr)
 		free(ch->fltr);
 	}
 
+	blkid_probe_reset_buffers(pr);
+	close_direct_fd(pr);
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
 		close(pr->fd);
-	blkid_probe_reset_buffers(pr);
 	blkid_probe_reset_values(pr);
 	blkid_probe_reset_hints(pr);
+	blkid_probe_enable_stats(pr, 0);
 	blkid_free_probe(pr->disk_probe);
+	blkid_free_arena(&pr->bufs_arena);
+	blkid_free_arena(&pr->vals_arena);
 
 	DBG(LOWPROBE, ul_debug("free probe"));
 	free(pr);
 }
 
+/*
+ * Removes the value from the list of results. The memory is allocated by the
+ * probe arena and it's released by blkid_probe_reset_values().
+ */
 void blkid_probe_free_value(struct blkid_prval *v)
 {
 	if (!v)
 		return;
 
 	list_del(&v->prvals);
-	free(v->data);
 
 	DBG(LOWPROBE, ul_debug(" free value %s", v->name));
-	free(v);
 }
 
 /*
@@ -532,11 +543,138 @@ int __blkid_probe_filter_types(blkid_probe pr, int chain, int flag, char *names[
 	return 0;
 }
 
+/*
+ * Opens the probed device by O_DIRECT. The device is reopened by /proc/self/fd,
+ * because the flag cannot be set for the already open file descriptor without
+ * affecting the caller.
+ */
+static int get_direct_fd(blkid_probe pr)
+{
+#ifdef O_DIRECT
+	char path[sizeof("/proc/self/fd/") + sizeof(stringify_value(INT_MAX))];
+
+	if (pr->dio_fd != -1)
+		return pr->dio_fd;
+
+	pr->dio_fd = -2;
+	if (pr->fd < 0 || S_ISCHR(pr->mode))
+		return -1;
+
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", pr->fd);
+	pr->dio_fd = open(path, O_RDONLY|O_DIRECT|O_CLOEXEC|O_NONBLOCK);
+	if (pr->dio_fd < 0) {
+		DBG(LOWPROBE, ul_debug("O_DIRECT unsupported: %m"));
+		pr->dio_fd = -2;
+	}
+	return pr->dio_fd;
+#else
+	pr->dio_fd = -2;
+	return -1;
+#endif
+}
+
+static void close_direct_fd(blkid_probe pr)
+{
+	if (pr->dio_fd >= 0)
+		close(pr->dio_fd);
+	pr->dio_fd = -1;
+}
+
+/*
+ * Reads the area by O_DIRECT. The area is extended to the device sector size
+ * (at least 4KiB) boundaries, the buffer data are aligned in the same way.
+ */
+static struct blkid_bufinfo *read_buffer_direct(blkid_probe pr, uint64_t real_off, uint64_t len)
+{
+	struct blkid_bufinfo *bf;
+	uint64_t begin, end, align;
+	ssize_t ret;
+	unsigned char *mem;
+
+	align = max(blkid_probe_get_sectorsize(pr), 4096U);
+	begin = real_off - (real_off % align);
+	end = real_off + len + align - 1;
+	end -= end % align;
+
+	if (end - begin > ULONG_MAX - align) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* the first aligned block is for struct blkid_bufinfo */
+	mem = blkid_arena_alloc(&pr->bufs_arena, align + (end - begin), align);
+	if (!mem) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	bf = (struct blkid_bufinfo *) mem;
+	memset(bf, 0, sizeof(*bf));
+	bf->data = mem + align;
+	bf->off = begin;
+	INIT_LIST_HEAD(&bf->bufs);
+
+	DBG(LOWPROBE, ul_debug("\tdirect read: off=%"PRIu64" len=%"PRIu64"",
+	                       begin, end - begin));
+
+	ret = pread(pr->dio_fd, bf->data, end - begin, begin);
+	if (ret < 0 && errno == EINVAL) {
+		/* unsupported alignment or filesystem */
+		DBG(LOWPROBE, ul_debug("\tdirect read failed, disable O_DIRECT"));
+		blkid_arena_free(&pr->bufs_arena, bf);
+		close_direct_fd(pr);
+		pr->dio_fd = -2;
+		return NULL;
+	}
+
+	STAT_ADD(READS, 1);
+	if (ret > 0)
+		STAT_ADD(READ_BYTES, ret);
+	pr->iostat.reads++;
+	pr->io_reads++;
+	if (ret > 0) {
+		pr->iostat.bytes += ret;
+		pr->io_bytes += ret;
+	}
+	if (pr->cur_prstat) {
+		pr->cur_prstat->reads++;
+		if (ret > 0)
+			pr->cur_prstat->bytes += ret;
+	}
+
+	/* the aligned end may be behind end of the file */
+	if (ret < 0 || (uint64_t) ret < real_off + len - begin) {
+		DBG(LOWPROBE, ul_debug("\tdirect read failed: %m"));
+		blkid_arena_free(&pr->bufs_arena, bf);
+		if (ret >= 0 || blkid_probe_is_cdrom(pr))
+			errno = 0;
+		return NULL;
+	}
+
+	bf->len = ret;
+	return bf;
+}
+
 static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
 {
 	ssize_t ret;
 	struct blkid_bufinfo *bf = NULL;
 
+	if ((pr->io_budget && pr->io_bytes + len > pr->io_budget) ||
+	    (pr->io_budget_reads && pr->io_reads + 1 > pr->io_budget_reads)) {
+		DBG(LOWPROBE, ul_debug("\tread: off=%"PRIu64" len=%"PRIu64" refused "
+				"by I/O budget", real_off, len));
+		pr->flags |= BLKID_FL_PARTIAL;
+		errno = 0;
+		return NULL;
+	}
+
+	if ((pr->flags & BLKID_FL_DIRECTIO) && get_direct_fd(pr) >= 0) {
+		bf = read_buffer_direct(pr, real_off, len);
+		if (bf || pr->dio_fd >= 0)
+			return bf;
+		/* O_DIRECT unsupported, continue with the standard read() */
+	}
+
 	if (lseek(pr->fd, real_off, SEEK_SET) == (off_t) -1) {
 		errno = 0;
 		return NULL;
@@ -548,12 +686,13 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 		return NULL;
 	}
 
-	/* allocate info and space for data by one malloc call */
-	bf = calloc(1, sizeof(struct blkid_bufinfo) + len);
+	/* allocate info and space for data by one allocation */
+	bf = blkid_arena_alloc(&pr->bufs_arena, sizeof(struct blkid_bufinfo) + len, 0);
 	if (!bf) {
 		errno = ENOMEM;
 		return NULL;
 	}
+	memset(bf, 0, sizeof(*bf));
 
 	bf->data = ((unsigned char *) bf) + sizeof(struct blkid_bufinfo);
 	bf->len = len;
@@ -564,9 +703,24 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 	                       real_off, len));
 
 	ret = read(pr->fd, bf->data, len);
+	STAT_ADD(READS, 1);
+	if (ret > 0)
+		STAT_ADD(READ_BYTES, ret);
+	pr->iostat.reads++;
+	pr->io_reads++;
+	if (ret > 0) {
+		pr->iostat.bytes += ret;
+		pr->io_bytes += ret;
+	}
+	if (pr->cur_prstat) {
+		pr->cur_prstat->reads++;
+		if (ret > 0)
+			pr->cur_prstat->bytes += ret;
+	}
+
 	if (ret != (ssize_t) len) {
 		DBG(LOWPROBE, ul_debug("\tread failed: %m"));
-		free(bf);
+		blkid_arena_free(&pr->bufs_arena, bf);
 
 		/* I/O errors on CDROMs are non-fatal to work with hybrid
 		 * audio+data disks */
@@ -578,6 +732,58 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 	return bf;
 }
 
+/*
+ * Extends the requested area to the aligned read-ahead window. The window is
+ * limited by the probing area and by already cached buffers, so the same data
+ * are not read more than once. The pr->buffers list is sorted by offset.
+ */
+static void get_readahead_window(blkid_probe pr, uint64_t real_off, uint64_t len,
+				 uint64_t *win_off, uint64_t *win_len)
+{
+	uint64_t begin, end;
+	uint64_t area_end = pr->off + pr->size;
+	struct list_head *p;
+
+	*win_off = real_off;
+	*win_len = len;
+
+	/* unknown size (tapes, ...), too large request, or limited I/O */
+	if (S_ISCHR(pr->mode) || len >= BLKID_PROBE_READAHEAD
+	    || UINT64_MAX - BLKID_PROBE_READAHEAD < area_end
+	    || pr->io_budget)
+		return;
+
+	begin = real_off - (real_off % BLKID_PROBE_READAHEAD);
+	end = real_off + len + BLKID_PROBE_READAHEAD - 1;
+	end -= end % BLKID_PROBE_READAHEAD;
+
+	if (begin < pr->off)
+		begin = pr->off;
+	if (end > area_end)
+		end = area_end;
+
+	list_for_each(p, &pr->buffers) {
+		struct blkid_bufinfo *x =
+				list_entry(p, struct blkid_bufinfo, bufs);
+		uint64_t x_end = x->off + x->len;
+
+		if (x->off >= end)
+			break;
+		/* cached data before the request */
+		if (x_end <= real_off && x_end > begin)
+			begin = x_end;
+		/* cached data behind the request */
+		else if (x->off >= real_off + len && x->off < end)
+			end = x->off;
+	}
+
+	if (begin > real_off || end < real_off + len)
+		return;
+
+	*win_off = begin;
+	*win_len = end - begin;
+}
+
 /*
  * Search in buffers we already have in memory
  */
@@ -590,7 +796,9 @@ static struct blkid_bufinfo *get_cached_buffer(blkid_probe pr, uint64_t off, uin
 		struct blkid_bufinfo *x =
 				list_entry(p, struct blkid_bufinfo, bufs);
 
-		if (real_off >= x->off && real_off + len <= x->off + x->len) {
+		if (x->off > real_off)
+			break;
+		if (real_off + len <= x->off + x->len) {
 			DBG(BUFFER, ul_debug("\treuse: off=%"PRIu64" len=%"PRIu64" (for off=%"PRIu64" len=%"PRIu64")",
 						x->off, x->len, real_off, len));
 			return x;
@@ -599,6 +807,23 @@ static struct blkid_bufinfo *get_cached_buffer(blkid_probe pr, uint64_t off, uin
 	return NULL;
 }
 
+/*
+ * Add buffer to the list, the list is sorted by offset
+ */
+static void add_buffer(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	struct list_head *p;
+
+	list_for_each(p, &pr->buffers) {
+		struct blkid_bufinfo *x =
+				list_entry(p, struct blkid_bufinfo, bufs);
+		if (x->off > bf->off)
+			break;
+	}
+	/* add before @p (or at the end of the list) */
+	list_add_tail(&bf->bufs, p);
+}
+
 /*
  * Zeroize in-memory data in already read buffer. The next blkid_probe_get_buffer()
  * will return modified buffer. This is usable when you want to call the same probing
@@ -617,23 +842,26 @@ static int hide_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 		return -EINVAL;
 	}
 
+	/* The buffers may overlap (see get_readahead_window()), so zeroize
+	 * the range in all buffers where the range is (partially) cached.
+	 */
 	list_for_each(p, &pr->buffers) {
 		struct blkid_bufinfo *x =
 			list_entry(p, struct blkid_bufinfo, bufs);
-		unsigned char *data;
+		uint64_t begin, end;
 
-		if (real_off >= x->off && real_off + len <= x->off + x->len) {
-
-			assert(x->off <= real_off);
-			assert(x->off + x->len >= real_off + len);
+		if (x->off >= real_off + len)
+			break;
+		if (x->off + x->len <= real_off)
+			continue;
 
-			data = real_off ? x->data + (real_off - x->off) : x->data;
+		begin = max(x->off, real_off);
+		end = min(x->off + x->len, real_off + len);
 
-			DBG(BUFFER, ul_debug("\thiding: off=%"PRIu64" len=%"PRIu64,
-						off, len));
-			memset(data, 0, len);
-			ct++;
-		}
+		DBG(BUFFER, ul_debug("\thiding: off=%"PRIu64" len=%"PRIu64,
+					begin - pr->off, end - begin));
+		memset(x->data + (begin - x->off), 0, end - begin);
+		ct++;
 	}
 	return ct == 0 ? -EINVAL : 0;
 }
@@ -688,11 +916,25 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64_t len
 	/* try buffers we already have in memory or read from device */
 	bf = get_cached_buffer(pr, off, len);
 	if (!bf) {
-		bf = read_buffer(pr, real_off, len);
+		uint64_t win_off, win_len;
+
+		pr->iostat.misses++;
+
+		get_readahead_window(pr, real_off, len, &win_off, &win_len);
+		bf = read_buffer(pr, win_off, win_len);
+
+		/* read-ahead failed, try only the requested area */
+		if (!bf && win_len != len)
+			bf = read_buffer(pr, real_off, len);
 		if (!bf)
 			return NULL;
 
-		list_add_tail(&bf->bufs, &pr->buffers);
+		add_buffer(pr, bf);
+	} else {
+		STAT_ADD(BUFFER_HITS, 1);
+		pr->iostat.hits++;
+		if (pr->cur_prstat)
+			pr->cur_prstat->hits++;
 	}
 
 	assert(bf->off <= real_off);
@@ -702,6 +944,98 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64_t len
 	return real_off ? bf->data + (real_off - bf->off) : bf->data;
 }
 
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * Reads areas @offs[] (offsets within probing area, every area is @len bytes)
+ * to the buffers by the minimal number of read() calls. The areas are
+ * coalesced to the read-ahead windows and the kernel is advised about all
+ * the windows before the first read(), so the I/O may be submitted in
+ * parallel.
+ *
+ * This is only optimization, the errors are ignored and the subsequent
+ * blkid_probe_get_buffer() calls read the data again. Note that @offs[] is
+ * modified (sorted).
+ */
+int blkid_probe_prefetch_buffers(blkid_probe pr, uint64_t *offs, size_t noffs,
+				 uint64_t len)
+{
+	struct blkid_bufinfo *bf;
+	uint64_t *wins;
+	size_t i, nwins = 0;
+
+	if (!noffs || !len || pr->size == 0 || S_ISCHR(pr->mode))
+		return 0;
+
+	/* read only the really requested data if I/O is limited */
+	if (pr->io_budget || pr->io_budget_reads)
+		return 0;
+
+	if (pr->parent &&
+	    pr->parent->devno == pr->devno &&
+	    pr->parent->off <= pr->off &&
+	    pr->parent->off + pr->parent->size >= pr->off + pr->size) {
+		/* buffers are shared with parent, see blkid_probe_get_buffer() */
+		for (i = 0; i < noffs; i++)
+			offs[i] += pr->off - pr->parent->off;
+		return blkid_probe_prefetch_buffers(pr->parent, offs, noffs, len);
+	}
+
+	/* begin and end for each window */
+	wins = malloc(noffs * 2 * sizeof(uint64_t));
+	if (!wins)
+		return -ENOMEM;
+
+	qsort(offs, noffs, sizeof(uint64_t), cmp_u64);
+
+	for (i = 0; i < noffs; i++) {
+		uint64_t win_off, win_len;
+
+		if (UINT64_MAX - len < offs[i]
+		    || pr->size < offs[i] + len)
+			continue;
+		if (get_cached_buffer(pr, offs[i], len))
+			continue;
+
+		get_readahead_window(pr, pr->off + offs[i], len, &win_off, &win_len);
+
+		/* merge with the previous window */
+		if (nwins && win_off <= wins[(nwins - 1) * 2 + 1]) {
+			if (win_off + win_len > wins[(nwins - 1) * 2 + 1])
+				wins[(nwins - 1) * 2 + 1] = win_off + win_len;
+			continue;
+		}
+		wins[nwins * 2] = win_off;
+		wins[nwins * 2 + 1] = win_off + win_len;
+		nwins++;
+	}
+
+	DBG(BUFFER, ul_debug("prefetch: %zu areas in %zu windows", noffs, nwins));
+
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	if (nwins > 1 && !(pr->flags & BLKID_FL_DIRECTIO)) {
+		for (i = 0; i < nwins; i++)
+			ignore_result( posix_fadvise(pr->fd, wins[i * 2],
+					wins[i * 2 + 1] - wins[i * 2],
+					POSIX_FADV_WILLNEED) );
+	}
+#endif
+	for (i = 0; i < nwins; i++) {
+		bf = read_buffer(pr, wins[i * 2], wins[i * 2 + 1] - wins[i * 2]);
+		if (bf)
+			add_buffer(pr, bf);
+	}
+
+	free(wins);
+	errno = 0;
+	return 0;
+}
+
 /**
  * blkid_probe_reset_buffers:
  * @pr: prober
@@ -717,8 +1051,6 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64_t len
  */
 int blkid_probe_reset_buffers(blkid_probe pr)
 {
-	uint64_t ct = 0, len = 0;
-
 	pr->flags &= ~BLKID_FL_MODIF_BUFF;
 
 	if (list_empty(&pr->buffers))
@@ -729,19 +1061,26 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 	while (!list_empty(&pr->buffers)) {
 		struct blkid_bufinfo *bf = list_entry(pr->buffers.next,
 						struct blkid_bufinfo, bufs);
-		ct++;
-		len += bf->len;
 		list_del(&bf->bufs);
 
 		DBG(BUFFER, ul_debug(" remove buffer: [off=%"PRIu64", len=%"PRIu64"]",
 		                     bf->off, bf->len));
-		free(bf);
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+		/* O_DIRECT unsupported, don't keep the data in page cache */
+		if ((pr->flags & BLKID_FL_DIRECTIO) && pr->dio_fd < 0 && pr->fd >= 0)
+			ignore_result( posix_fadvise(pr->fd, bf->off, bf->len,
+						POSIX_FADV_DONTNEED) );
+#endif
 	}
+	blkid_reset_arena(&pr->bufs_arena);
 
-	DBG(LOWPROBE, ul_debug(" buffers summary: %"PRIu64" bytes by %"PRIu64" read() calls",
-			len, ct));
+	DBG(LOWPROBE, ul_debug(" buffers summary: %"PRIu64" bytes by %"PRIu64" read() calls "
+			       "(%"PRIu64" hits, %"PRIu64" misses)",
+			pr->iostat.bytes, pr->iostat.reads,
+			pr->iostat.hits, pr->iostat.misses));
 
 	INIT_LIST_HEAD(&pr->buffers);
+	memset(&pr->iostat, 0, sizeof(pr->iostat));
 
 	return 0;
 }
@@ -777,18 +1116,19 @@ int blkid_probe_hide_range(blkid_probe pr, uint64_t off, uint64_t len)
 
 static void blkid_probe_reset_values(blkid_probe pr)
 {
-	if (list_empty(&pr->values))
-		return;
+	if (!list_empty(&pr->values)) {
+		DBG(LOWPROBE, ul_debug("resetting results"));
 
-	DBG(LOWPROBE, ul_debug("resetting results"));
-
-	while (!list_empty(&pr->values)) {
-		struct blkid_prval *v = list_entry(pr->values.next,
-						struct blkid_prval, prvals);
-		blkid_probe_free_value(v);
+		while (!list_empty(&pr->values)) {
+			struct blkid_prval *v = list_entry(pr->values.next,
+							struct blkid_prval, prvals);
+			blkid_probe_free_value(v);
+		}
+		INIT_LIST_HEAD(&pr->values);
 	}
 
-	INIT_LIST_HEAD(&pr->values);
+	/* release also values removed by blkid_probe_free_value() */
+	blkid_reset_arena(&pr->vals_arena);
 }
 
 /*
@@ -889,6 +1229,7 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 
 	blkid_reset_probe(pr);
 	blkid_probe_reset_buffers(pr);
+	close_direct_fd(pr);
 
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
 		close(pr->fd);
@@ -901,7 +1242,10 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	pr->flags &= ~BLKID_FL_PRIVATE_FD;
 	pr->flags &= ~BLKID_FL_TINY_DEV;
 	pr->flags &= ~BLKID_FL_CDROM_DEV;
+	pr->flags &= ~BLKID_FL_PARTIAL;
 	pr->prob_flags = 0;
+	pr->io_bytes = 0;
+	pr->io_reads = 0;
 	pr->fd = fd;
 	pr->off = (uint64_t) off;
 	pr->size = 0;
@@ -1060,6 +1404,19 @@ unsigned char *_blkid_probe_get_sb(blkid_probe pr, const struct blkid_idmag *mag
 	return blkid_probe_get_buffer(pr, hint_offset + (mag->kboff << 10), size);
 }
 
+/*
+ * Returns offset of the 1KiB buffer where is @mag magic string
+ */
+uint64_t blkid_probe_get_idmag_off(blkid_probe pr, const struct blkid_idmag *mag)
+{
+	uint64_t hint_offset;
+
+	if (!mag->hoff || blkid_probe_get_hint(pr, mag->hoff, &hint_offset) < 0)
+		hint_offset = 0;
+
+	return hint_offset + ((mag->kboff + (mag->sboff >> 10)) << 10);
+}
+
 /*
  * Check for matching magic value.
  * Returns BLKID_PROBE_OK if found, BLKID_PROBE_NONE if not found
@@ -1079,12 +1436,8 @@ int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 	/* try to detect by magic string */
 	while(mag && mag->magic) {
 		unsigned char *buf;
-		uint64_t hint_offset;
 
-		if (!mag->hoff || blkid_probe_get_hint(pr, mag->hoff, &hint_offset) < 0)
-			hint_offset = 0;
-
-		off = hint_offset + ((mag->kboff + (mag->sboff >> 10)) << 10);
+		off = blkid_probe_get_idmag_off(pr, mag);
 		buf = blkid_probe_get_buffer(pr, off, 1024);
 
 		if (!buf && errno)
@@ -1116,6 +1469,7 @@ static inline void blkid_probe_start(blkid_probe pr)
 	DBG(LOWPROBE, ul_debug("start probe"));
 	pr->cur_chain = NULL;
 	pr->prob_flags = 0;
+	pr->flags &= ~BLKID_FL_PARTIAL;
 	blkid_probe_set_wiper(pr, 0, 0);
 }
 
@@ -1417,25 +1771,7 @@ int blkid_probe_step_back(blkid_probe pr)
 	return 0;
 }
 
-/**
- * blkid_do_safeprobe:
- * @pr: prober
- *
- * This function gathers probing results from all enabled chains and checks
- * for ambivalent results (e.g. more filesystems on the device).
- *
- * This is string-based NAME=value interface only.
- *
- * Note about superblocks chain -- the function does not check for filesystems
- * when a RAID signature is detected.  The function also does not check for
- * collision between RAIDs. The first detected RAID is returned. The function
- * checks for collision between partition table and RAID signature -- it's
- * recommended to enable partitions chain together with superblocks chain.
- *
- * Returns: 0 on success, 1 if nothing is detected, -2 if ambivalent result is
- * detected and -1 on case of error.
- */
-int blkid_do_safeprobe(blkid_probe pr)
+static int do_safeprobe(blkid_probe pr)
 {
 	int i, count = 0, rc = 0;
 
@@ -1478,18 +1814,32 @@ done:
 }
 
 /**
- * blkid_do_fullprobe:
+ * blkid_do_safeprobe:
  * @pr: prober
  *
- * This function gathers probing results from all enabled chains. Same as
- * blkid_do_safeprobe() but does not check for collision between probing
- * result.
+ * This function gathers probing results from all enabled chains and checks
+ * for ambivalent results (e.g. more filesystems on the device).
  *
  * This is string-based NAME=value interface only.
  *
- * Returns: 0 on success, 1 if nothing is detected or -1 on case of error.
+ * Note about superblocks chain -- the function does not check for filesystems
+ * when a RAID signature is detected.  The function also does not check for
+ * collision between RAIDs. The first detected RAID is returned. The function
+ * checks for collision between partition table and RAID signature -- it's
+ * recommended to enable partitions chain together with superblocks chain.
+ *
+ * Returns: 0 on success, 1 if nothing is detected, -2 if ambivalent result is
+ * detected and -1 on case of error.
  */
-int blkid_do_fullprobe(blkid_probe pr)
+int blkid_do_safeprobe(blkid_probe pr)
+{
+	int rc;
+
+	STAT_TIME(PROBE_NS, rc = do_safeprobe(pr));
+	return rc;
+}
+
+static int do_fullprobe(blkid_probe pr)
 {
 	int i, count = 0, rc = 0;
 
@@ -1531,6 +1881,253 @@ done:
 	return count ? 0 : 1;
 }
 
+/**
+ * blkid_do_fullprobe:
+ * @pr: prober
+ *
+ * This function gathers probing results from all enabled chains. Same as
+ * blkid_do_safeprobe() but does not check for collision between probing
+ * result.
+ *
+ * This is string-based NAME=value interface only.
+ *
+ * Returns: 0 on success, 1 if nothing is detected or -1 on case of error.
+ */
+int blkid_do_fullprobe(blkid_probe pr)
+{
+	int rc;
+
+	STAT_TIME(PROBE_NS, rc = do_fullprobe(pr));
+	return rc;
+}
+
+/**
+ * blkid_probe_enable_directio:
+ * @pr: probe
+ * @enable: TRUE/FALSE
+ *
+ * Enables or disables direct I/O. If enabled, the device is read by a private
+ * O_DIRECT file descriptor and the probing does not pollute the page cache.
+ * The file descriptor specified by blkid_probe_set_device() is not modified.
+ *
+ * If O_DIRECT is unsupported for the device (e.g. some filesystems), the
+ * standard read() is used and the data are dropped from the page cache
+ * (POSIX_FADV_DONTNEED) when the buffers are released. Note that the advice
+ * also drops the pages cached by other processes.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: ext-1
+ */
+int blkid_probe_enable_directio(blkid_probe pr, int enable)
+{
+	if (!pr)
+		return -1;
+	if (enable)
+		pr->flags |= BLKID_FL_DIRECTIO;
+	else {
+		pr->flags &= ~BLKID_FL_DIRECTIO;
+		close_direct_fd(pr);
+	}
+	return 0;
+}
+
+/**
+ * blkid_probe_set_io_budget:
+ * @pr: probe
+ * @bytes: maximal number of bytes read from the device, or 0 (unlimited)
+ * @reads: maximal number of read() calls, or 0 (unlimited)
+ *
+ * Limits I/O for each device assigned to the probe by blkid_probe_set_device().
+ * Already read data do not count again. If a prober needs more data than
+ * allowed, the read is refused and the prober does not detect anything;
+ * the probing result is marked as partial (see blkid_probe_is_partial()).
+ *
+ * The magic strings prefetch is disabled when any budget is set, and the
+ * read-ahead is disabled when @bytes is set; only the requested data are read.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: ext-1
+ */
+int blkid_probe_set_io_budget(blkid_probe pr, uint64_t bytes, uint64_t reads)
+{
+	if (!pr)
+		return -1;
+
+	pr->io_budget = bytes;
+	pr->io_budget_reads = reads;
+
+	DBG(LOWPROBE, ul_debug("I/O budget: %"PRIu64" bytes, %"PRIu64" reads",
+				bytes, reads));
+	return 0;
+}
+
+/**
+ * blkid_probe_is_partial:
+ * @pr: probe
+ *
+ * Returns: 1 if the I/O budget (see blkid_probe_set_io_budget()) refused
+ * any read during the last probing, so the result may be incomplete,
+ * otherwise 0.
+ *
+ * Since: ext-1
+ */
+int blkid_probe_is_partial(blkid_probe pr)
+{
+	for ( ; pr; pr = pr->parent) {
+		if (pr->flags & BLKID_FL_PARTIAL)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * blkid_probe_enable_stats:
+ * @pr: probe
+ * @enable: TRUE/FALSE
+ *
+ * Enables or disables per-prober statistics. The statistics are accumulated
+ * for all devices probed by @pr (see blkid_probe_set_device()) until the
+ * statistics are disabled. Enabling the statistics again resets the numbers.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: ext-1
+ */
+int blkid_probe_enable_stats(blkid_probe pr, int enable)
+{
+	size_t i;
+
+	if (!pr)
+		return -1;
+
+	pr->cur_prstat = NULL;
+
+	for (i = 0; i < BLKID_NCHAINS; i++) {
+		size_t n = pr->chains[i].driver->nidinfos;
+
+		free(pr->prstats[i]);
+		pr->prstats[i] = NULL;
+
+		if (!enable || !n)
+			continue;
+		pr->prstats[i] = calloc(n, sizeof(struct blkid_prstat));
+		if (!pr->prstats[i]) {
+			blkid_probe_enable_stats(pr, 0);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * blkid_probe_get_stats:
+ * @pr: probe
+ * @idx: prober number (all chains, superblocks, topology and then partitions)
+ * @name: returns name of the prober
+ * @calls: returns number of the prober calls (or NULL)
+ * @matches: returns number of detected signatures (or NULL)
+ * @nsec: returns time spent in the prober in nanoseconds (or NULL)
+ * @reads: returns number of read() calls (or NULL)
+ * @bytes: returns number of bytes read from the device (or NULL)
+ * @hits: returns number of requests served from already read data (or NULL)
+ *
+ * Returns statistics of the prober, see blkid_probe_enable_stats(). Note that
+ * the superblocks chain calls probers only when the magic string matches
+ * the device. The time and I/O include the magic string reads.
+ *
+ * Returns: 0 on success, 1 if @idx is out of range, or -1 in case of error.
+ *
+ * Since: ext-1
+ */
+int blkid_probe_get_stats(blkid_probe pr, size_t idx, const char **name,
+			uint64_t *calls, uint64_t *matches, uint64_t *nsec,
+			uint64_t *reads, uint64_t *bytes, uint64_t *hits)
+{
+	size_t i;
+
+	if (!pr || !pr->prstats[0])
+		return -1;
+
+	for (i = 0; i < BLKID_NCHAINS; i++) {
+		const struct blkid_chaindrv *drv = pr->chains[i].driver;
+		const struct blkid_prstat *st;
+
+		if (idx >= drv->nidinfos) {
+			idx -= drv->nidinfos;
+			continue;
+		}
+
+		st = &pr->prstats[i][idx];
+		if (name)
+			*name = drv->idinfos[idx]->name;
+		if (calls)
+			*calls = st->calls;
+		if (matches)
+			*matches = st->matches;
+		if (nsec)
+			*nsec = st->nsec;
+		if (reads)
+			*reads = st->reads;
+		if (bytes)
+			*bytes = st->bytes;
+		if (hits)
+			*hits = st->hits;
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Starts statistics for the prober @id. The prober does not have to be the
+ * current chain prober (e.g. nested partition tables).
+ */
+void blkid_probe_stats_begin(blkid_probe pr, struct blkid_chain *chn,
+			const struct blkid_idinfo *id, struct blkid_prstat_ctx *ctx)
+{
+	const struct blkid_chaindrv *drv = chn->driver;
+	struct blkid_prstat *stats = pr->prstats[drv->id];
+	size_t i;
+
+	ctx->prev = pr->cur_prstat;
+	ctx->cur = NULL;
+
+	STAT_ADD(PROBER_CALLS, 1);
+	if (!stats)
+		return;
+
+	if (chn->idx >= 0 && (size_t) chn->idx < drv->nidinfos
+	    && drv->idinfos[chn->idx] == id)
+		i = chn->idx;
+	else {
+		for (i = 0; i < drv->nidinfos; i++) {
+			if (drv->idinfos[i] == id)
+				break;
+		}
+		if (i == drv->nidinfos)
+			return;
+	}
+
+	ctx->cur = pr->cur_prstat = &stats[i];
+	ctx->cur->calls++;
+	clock_gettime(CLOCK_MONOTONIC, &ctx->start);
+}
+
+void blkid_probe_stats_end(blkid_probe pr, struct blkid_prstat_ctx *ctx, int rc)
+{
+	struct timespec end;
+
+	if (ctx->cur) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ctx->cur->nsec += (end.tv_sec - ctx->start.tv_sec) * 1000000000ULL
+				  + end.tv_nsec - ctx->start.tv_nsec;
+		if (rc == BLKID_PROBE_OK)
+			ctx->cur->matches++;
+	}
+	pr->cur_prstat = ctx->prev;
+}
+
 /* same sa blkid_probe_get_buffer() but works with 512-sectors */
 unsigned char *blkid_probe_get_sector(blkid_probe pr, unsigned int sector)
 {
@@ -1541,7 +2138,7 @@ struct blkid_prval *blkid_probe_assign_value(blkid_probe pr, const char *name)
 {
 	struct blkid_prval *v;
 
-	v = calloc(1, sizeof(struct blkid_prval));
+	v = blkid_arena_calloc(&pr->vals_arena, sizeof(struct blkid_prval));
 	if (!v)
 		return NULL;
 
@@ -1559,18 +2156,29 @@ struct blkid_prval *blkid_probe_assign_value(blkid_probe pr, const char *name)
  * to set proper value length (for strings we count terminator to the length,
  * for binary data it's without terminator).
  */
-int blkid_probe_value_set_data(struct blkid_prval *v,
+int blkid_probe_value_set_data(blkid_probe pr, struct blkid_prval *v,
 		const unsigned char *data, size_t len)
 {
-	v->data = calloc(1, len + 1);	/* always terminate by \0 */
-
-	if (!v->data)
+	/* always terminate by \0 */
+	if (!blkid_probe_value_alloc_data(pr, v, len + 1))
 		return -ENOMEM;
 	memcpy(v->data, data, len);
 	v->len = len;
 	return 0;
 }
 
+/*
+ * Allocates zeroized @len bytes for the value data. The data are released
+ * together with the other probing results.
+ */
+unsigned char *blkid_probe_value_alloc_data(blkid_probe pr,
+		struct blkid_prval *v, size_t len)
+{
+	v->data = blkid_arena_calloc(&pr->vals_arena, len);
+	v->len = v->data ? len : 0;
+	return v->data;
+}
+
 int blkid_probe_set_value(blkid_probe pr, const char *name,
 		const unsigned char *data, size_t len)
 {
@@ -1580,26 +2188,32 @@ int blkid_probe_set_value(blkid_probe pr, const char *name,
 	if (!v)
 		return -1;
 
-	return blkid_probe_value_set_data(v, data, len);
+	return blkid_probe_value_set_data(pr, v, data, len);
 }
 
 int blkid_probe_vsprintf_value(blkid_probe pr, const char *name,
 		const char *fmt, va_list ap)
 {
 	struct blkid_prval *v;
-	ssize_t len;
+	va_list cp;
+	int len;
+
+	va_copy(cp, ap);
+	len = vsnprintf(NULL, 0, fmt, cp);
+	va_end(cp);
+
+	if (len <= 0)
+		return len == 0 ? -EINVAL : -ENOMEM;
 
 	v = blkid_probe_assign_value(pr, name);
 	if (!v)
 		return -ENOMEM;
 
-	len = vasprintf((char **) &v->data, fmt, ap);
-
-	if (len <= 0) {
+	if (!blkid_probe_value_alloc_data(pr, v, len + 1)) {
 		blkid_probe_free_value(v);
-		return len == 0 ? -EINVAL : -ENOMEM;
+		return -ENOMEM;
 	}
-	v->len = len + 1;
+	vsnprintf((char *) v->data, len + 1, fmt, ap);
 	return 0;
 }
 
@@ -391,6 +391,13 @@ void blkid_read_cache(blkid_cache cache)
 		goto errout;
 	}
 
+	if ((cache->bic_flags & BLKID_BIC_FL_BINARY) &&
+	    blkid_read_bincache(cache) == 0) {
+		DBG(CACHE, ul_debug("binary cache for %s used",
+					cache->bic_filename));
+		goto done;
+	}
+
 	DBG(CACHE, ul_debug("reading cache file %s",
 				cache->bic_filename));
 
@@ -419,16 +426,16 @@ void blkid_read_cache(blkid_cache cache)
 		}
 	}
 	fclose(file);
-
+	fd = -1;
+done:
 	/*
 	 * Initially we do not need to write out the cache file.
 	 */
 	cache->bic_flags &= ~BLKID_BIC_FL_CHANGED;
 	cache->bic_ftime = st.st_mtime;
-
-	return;
 errout:
-	close(fd);
+	if (fd >= 0)
+		close(fd);
 }
 
 #ifdef TEST_PROGRAM
@@ -73,8 +73,19 @@ static int save_dev(blkid_dev dev, FILE *file)
 	return 0;
 }
 
-/*
- * Write out the cache struct to the cache file on disk.
+/**
+ * blkid_flush_cache:
+ * @cache: cache handler
+ *
+ * Writes the cache to the cache file if it has been modified. The file is
+ * written by blkid_put_cache() too; this function is useful for long-running
+ * processes which keep the cache up to date, for example by
+ * blkid_cache_process_events().
+ *
+ * Returns: 1 if the file has been written, 0 if it was not necessary (or
+ * the file is not writable), or an error code.
+ *
+ * Since: ext-1
  */
 int blkid_flush_cache(blkid_cache cache)
 {
@@ -86,6 +97,9 @@ int blkid_flush_cache(blkid_cache cache)
 	int fd, ret = 0;
 	struct stat st;
 
+	if (!cache)
+		return -BLKID_ERR_PARAM;
+
 	if (list_empty(&cache->bic_devs) ||
 	    !(cache->bic_flags & BLKID_BIC_FL_CHANGED)) {
 		DBG(SAVE, ul_debug("skipping cache file write"));
@@ -199,6 +213,11 @@ int blkid_flush_cache(blkid_cache cache)
 		}
 	}
 
+	/* the binary cache is only a copy, the text file is always written */
+	if (ret == 1 && (cache->bic_flags & BLKID_BIC_FL_BINARY)
+	    && stat(filename, &st) == 0 && S_ISREG(st.st_mode))
+		blkid_write_bincache(cache, filename);
+
 errout:
 	free(tmp);
 	if (filename != cache->bic_filename)
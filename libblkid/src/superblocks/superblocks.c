@@ -85,6 +85,7 @@
 
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn);
 static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn);
+static void superblocks_free_data(blkid_probe pr, void *data);
 
 static int blkid_probe_set_usage(blkid_probe pr, int usage);
 
@@ -190,6 +191,33 @@ const struct blkid_chaindrv superblocks_drv = {
 	.has_fltr     = TRUE,
 	.probe        = superblocks_probe,
 	.safeprobe    = superblocks_safeprobe,
+	.free_data    = superblocks_free_data
+};
+
+/*
+ * Magic strings dispatch index (private chain data)
+ *
+ * All magic strings (without hints) sorted by offset and by the first byte
+ * of the magic. It's enough to read one byte for each offset to know which
+ * probers have any chance to match; the other probers are skipped.
+ */
+struct sb_magic {
+	uint64_t	off;		/* magic string offset */
+	unsigned char	byte;		/* the first byte of the magic string */
+	size_t		idx;		/* index in idinfos[] */
+};
+
+struct sb_dispatch {
+	struct sb_magic	*magics;
+	size_t		nmagics;
+
+	unsigned long	*always;	/* probers to call always */
+	unsigned long	*wanted;	/* candidates for the current device */
+
+	int		valid;		/* wanted[] is up to date for: */
+	dev_t		devno;
+	uint64_t	off;
+	uint64_t	size;
 };
 
 /**
@@ -341,11 +369,210 @@ int blkid_superblocks_get_name(size_t idx, const char **name, int *usage)
 	return -1;
 }
 
+/*
+ * Returns 1 if the idinfos[@i] prober should be used for the device.
+ */
+static int is_idinfo_wanted(blkid_probe pr, struct blkid_chain *chn, size_t i)
+{
+	const struct blkid_idinfo *id = idinfos[i];
+
+	if (chn->fltr && blkid_bmp_get_item(chn->fltr, i)) {
+		DBG(LOWPROBE, ul_debug("filter out: %s", id->name));
+		return 0;
+	}
+
+	if (id->minsz && (unsigned)id->minsz > pr->size)
+		return 0;	/* the device is too small */
+
+	/* don't probe for RAIDs, swap or journal on CD/DVDs */
+	if ((id->usage & (BLKID_USAGE_RAID | BLKID_USAGE_OTHER)) &&
+	    blkid_probe_is_cdrom(pr))
+		return 0;
+
+	/* don't probe for RAIDs on floppies */
+	if ((id->usage & BLKID_USAGE_RAID) && blkid_probe_is_tiny(pr))
+		return 0;
+
+	return 1;
+}
+
+static int cmp_sb_magic(const void *a, const void *b)
+{
+	const struct sb_magic *x = a, *y = b;
+
+	if (x->off != y->off)
+		return x->off < y->off ? -1 : 1;
+	if (x->byte != y->byte)
+		return x->byte < y->byte ? -1 : 1;
+	return x->idx < y->idx ? -1 : x->idx > y->idx ? 1 : 0;
+}
+
+static void superblocks_free_data(blkid_probe pr __attribute__((__unused__)),
+				  void *data)
+{
+	struct sb_dispatch *sbd = data;
+
+	if (!sbd)
+		return;
+	free(sbd->magics);
+	free(sbd->always);
+	free(sbd->wanted);
+	free(sbd);
+}
+
+static struct sb_dispatch *new_dispatch(void)
+{
+	struct sb_dispatch *sbd;
+	size_t i, n = 0;
+
+	sbd = calloc(1, sizeof(*sbd));
+	if (!sbd)
+		return NULL;
+
+	sbd->always = calloc(1, blkid_bmp_nbytes(ARRAY_SIZE(idinfos)));
+	sbd->wanted = calloc(1, blkid_bmp_nbytes(ARRAY_SIZE(idinfos)));
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++)
+			n++;
+	}
+	sbd->magics = n ? calloc(n, sizeof(struct sb_magic)) : NULL;
+
+	if (!sbd->always || !sbd->wanted || (n && !sbd->magics)) {
+		superblocks_free_data(NULL, sbd);
+		return NULL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+		size_t first = sbd->nmagics;
+		int always = idinfos[i]->magics[0].magic == NULL;
+
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++) {
+			/* Hidden areas are zeroized, so the magic strings
+			 * which start with zero may appear later. The offset
+			 * of the hinted magic strings is unknown. */
+			if (mag->hoff || mag->kboff < 0 || mag->len < 1 ||
+			    *((const unsigned char *) mag->magic) == 0) {
+				always = 1;
+				break;
+			}
+			sbd->magics[sbd->nmagics].off = (mag->kboff << 10) + mag->sboff;
+			sbd->magics[sbd->nmagics].byte = *((const unsigned char *) mag->magic);
+			sbd->magics[sbd->nmagics].idx = i;
+			sbd->nmagics++;
+		}
+		if (always) {
+			sbd->nmagics = first;
+			blkid_bmp_set_item(sbd->always, i);
+		}
+	}
+
+	qsort(sbd->magics, sbd->nmagics, sizeof(struct sb_magic), cmp_sb_magic);
+
+	DBG(LOWPROBE, ul_debug("magic dispatch index: %zu magics", sbd->nmagics));
+	return sbd;
+}
+
+/*
+ * Updates the wanted[] bitmap for the current device -- reads one byte for
+ * each magic string offset and marks the probers where the byte matches.
+ */
+static void update_dispatch(blkid_probe pr, struct sb_dispatch *sbd)
+{
+	size_t i, j;
+
+	memcpy(sbd->wanted, sbd->always, blkid_bmp_nbytes(ARRAY_SIZE(idinfos)));
+
+	for (i = 0; i < sbd->nmagics; i = j) {
+		uint64_t off = sbd->magics[i].off;
+		unsigned char *buf;
+
+		/* end of the group with the same offset */
+		for (j = i + 1; j < sbd->nmagics && sbd->magics[j].off == off; j++);
+
+		errno = 0;
+		buf = blkid_probe_get_buffer(pr, off - (off & 0x3ff), 1024);
+		if (!buf && !errno)
+			continue;	/* out of the device */
+
+		for ( ; i < j; i++) {
+			/* I/O error -- let blkid_probe_get_idmag() report it */
+			if (!buf || buf[off & 0x3ff] == sbd->magics[i].byte)
+				blkid_bmp_set_item(sbd->wanted, sbd->magics[i].idx);
+		}
+	}
+	errno = 0;
+
+	sbd->devno = pr->devno;
+	sbd->off = pr->off;
+	sbd->size = pr->size;
+	sbd->valid = 1;
+}
+
+/*
+ * Returns the magic dispatch index for the current device or NULL
+ */
+static struct sb_dispatch *superblocks_get_dispatch(blkid_probe pr,
+						    struct blkid_chain *chn)
+{
+	struct sb_dispatch *sbd = chn->data;
+
+	if (!sbd) {
+		sbd = new_dispatch();
+		if (!sbd)
+			return NULL;
+		chn->data = sbd;
+	}
+
+	if (chn->idx < 0 || !sbd->valid || sbd->devno != pr->devno
+	    || sbd->off != pr->off || sbd->size != pr->size)
+		update_dispatch(pr, sbd);
+
+	return sbd;
+}
+
+/*
+ * Reads all magic strings areas of the wanted probers by one batch, see
+ * blkid_probe_prefetch_buffers().
+ */
+static void superblocks_prefetch(blkid_probe pr, struct blkid_chain *chn)
+{
+	uint64_t *offs;
+	size_t i, n = 0, sz = 0;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++)
+			sz++;
+	}
+
+	offs = malloc(sz * sizeof(uint64_t));
+	if (!offs)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		if (!is_idinfo_wanted(pr, chn, i))
+			continue;
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++)
+			offs[n++] = blkid_probe_get_idmag_off(pr, mag);
+	}
+
+	blkid_probe_prefetch_buffers(pr, offs, n, 1024);
+	free(offs);
+}
+
 /*
  * The blkid_do_probe() backend.
  */
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 {
+	struct sb_dispatch *sbd;
 	size_t i;
 	int rc = BLKID_PROBE_NONE;
 
@@ -370,60 +597,53 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 	DBG(LOWPROBE, ul_debug("--> starting probing loop [SUBLKS idx=%d]",
 		chn->idx));
 
+	if (chn->idx < 0)
+		superblocks_prefetch(pr, chn);
+
+	sbd = superblocks_get_dispatch(pr, chn);
+
 	i = chn->idx < 0 ? 0 : chn->idx + 1U;
 
 	for ( ; i < ARRAY_SIZE(idinfos); i++) {
 		const struct blkid_idinfo *id;
 		const struct blkid_idmag *mag = NULL;
+		struct blkid_prstat_ctx stats;
 		uint64_t off = 0;
 
 		chn->idx = i;
 		id = idinfos[i];
 
-		if (chn->fltr && blkid_bmp_get_item(chn->fltr, i)) {
-			DBG(LOWPROBE, ul_debug("filter out: %s", id->name));
+		if (sbd && !blkid_bmp_get_item(sbd->wanted, i)) {
 			rc = BLKID_PROBE_NONE;
-			continue;
-		}
-
-		if (id->minsz && (unsigned)id->minsz > pr->size) {
-			rc = BLKID_PROBE_NONE;
-			continue;	/* the device is too small */
+			continue;	/* magic does not match */
 		}
 
-		/* don't probe for RAIDs, swap or journal on CD/DVDs */
-		if ((id->usage & (BLKID_USAGE_RAID | BLKID_USAGE_OTHER)) &&
-		    blkid_probe_is_cdrom(pr)) {
-			rc = BLKID_PROBE_NONE;
-			continue;
-		}
-
-		/* don't probe for RAIDs on floppies */
-		if ((id->usage & BLKID_USAGE_RAID) && blkid_probe_is_tiny(pr)) {
+		if (!is_idinfo_wanted(pr, chn, i)) {
 			rc = BLKID_PROBE_NONE;
 			continue;
 		}
 
 		DBG(LOWPROBE, ul_debug("[%zd] %s:", i, id->name));
 
+		blkid_probe_stats_begin(pr, chn, id, &stats);
+
 		rc = blkid_probe_get_idmag(pr, id, &off, &mag);
-		if (rc < 0)
-			break;
-		if (rc != BLKID_PROBE_OK)
-			continue;
 
 		/* final check by probing function */
-		if (id->probefunc) {
+		if (rc == BLKID_PROBE_OK && id->probefunc) {
 			DBG(LOWPROBE, ul_debug("\tcall probefunc()"));
 			rc = id->probefunc(pr, mag);
-			if (rc != BLKID_PROBE_OK) {
+			if (rc != BLKID_PROBE_OK)
 				blkid_probe_chain_reset_values(pr, chn);
-				if (rc < 0)
-					break;
-				continue;
-			}
 		}
 
+		blkid_probe_stats_end(pr, &stats, rc);
+
+		if (rc < 0)
+			break;
+		if (rc != BLKID_PROBE_OK)
+			continue;
+
 		/* all checks passed */
 		if (chn->flags & BLKID_SUBLKS_TYPE)
 			rc = blkid_probe_set_value(pr, "TYPE",
@@ -640,7 +860,7 @@ int blkid_probe_set_id_label(blkid_probe pr, const char *name,
 	if (!v)
 		return -ENOMEM;
 
-	rc = blkid_probe_value_set_data(v, data, len);
+	rc = blkid_probe_value_set_data(pr, v, data, len);
 	if (!rc) {
 		/* remove white spaces */
 		v->len = blkid_rtrim_whitespace(v->data) + 1;
@@ -670,8 +890,7 @@ int blkid_probe_set_utf8_id_label(blkid_probe pr, const char *name,
 		return -ENOMEM;
 
 	v->len = (len * 3) + 1;
-	v->data = calloc(1, v->len);
-	if (!v->data)
+	if (!blkid_probe_value_alloc_data(pr, v, v->len))
 		rc = -ENOMEM;
 
 	if (!rc) {
@@ -704,7 +923,7 @@ int blkid_probe_set_label(blkid_probe pr, const unsigned char *label, size_t len
 	if (!v)
 		return -ENOMEM;
 
-	rc = blkid_probe_value_set_data(v, label, len);
+	rc = blkid_probe_value_set_data(pr, v, label, len);
 	if (!rc) {
 		v->len = blkid_rtrim_whitespace(v->data) + 1;
 		if (v->len > 1)
@@ -734,8 +953,7 @@ int blkid_probe_set_utf8label(blkid_probe pr, const unsigned char *label,
 		return -ENOMEM;
 
 	v->len = (len * 3) + 1;
-	v->data = calloc(1, v->len);
-	if (!v->data)
+	if (!blkid_probe_value_alloc_data(pr, v, v->len))
 		rc = -ENOMEM;
 	if (!rc) {
 		ul_encode_to_utf8(enc, v->data, v->len, label, len);
@@ -796,7 +1014,7 @@ int blkid_probe_strncpy_uuid(blkid_probe pr, const unsigned char *str, size_t le
 	if (!v)
 		rc= -ENOMEM;
 	if (!rc)
-		rc = blkid_probe_value_set_data(v, str, len);
+		rc = blkid_probe_value_set_data(pr, v, str, len);
 	if (!rc) {
 		v->len = blkid_rtrim_whitespace(v->data) + 1;
 		if (v->len > 1)
@@ -833,8 +1051,7 @@ int blkid_probe_set_uuid_as(blkid_probe pr, const unsigned char *uuid, const cha
 		return -ENOMEM;
 
 	v->len = UUID_STR_LEN;
-	v->data = calloc(1, v->len);
-	if (!v->data)
+	if (!blkid_probe_value_alloc_data(pr, v, v->len))
 		rc = -ENOMEM;
 
 	if (!rc) {
@@ -19,6 +19,7 @@
 #define VDEV_LABEL_UBERBLOCK	(128 * 1024ULL)
 #define VDEV_LABEL_NVPAIR	( 16 * 1024ULL)
 #define VDEV_LABEL_SIZE		(256 * 1024ULL)
+#define VDEV_UBERBLOCK_RING	(128 * 1024ULL)
 #define UBERBLOCK_SIZE		1024ULL
 #define UBERBLOCKS_COUNT   128
 
@@ -153,7 +154,7 @@ static void zfs_extract_guid_name(blkid_probe pr, loff_t offset)
 	size_t left = 4096;
 	unsigned directory_level = 0;
 
-	offset = (offset & ~(VDEV_LABEL_SIZE - 1)) + VDEV_LABEL_NVPAIR;
+	offset += VDEV_LABEL_NVPAIR;
 
 	/* Note that we currently assume that the desired fields are within
 	 * the first 4k (left) of the nvlist.  This is true for all pools
@@ -221,7 +222,11 @@ cont:
 	}
 }
 
-static int find_uberblocks(const void *label, loff_t *ub_offset, int *swap_endian)
+/*
+ * @ring is the uberblock area of the label; the returned @ub_offset is
+ * relative to the begin of the label.
+ */
+static int find_uberblocks(const void *ring, loff_t *ub_offset, int *swap_endian)
 {
 	uint64_t swab_magic = swab64((uint64_t)UBERBLOCK_MAGIC);
 	const struct zfs_uberblock *ub;
@@ -229,7 +234,8 @@ static int find_uberblocks(const void *label, loff_t *ub_offset, int *swap_endia
 	loff_t offset = VDEV_LABEL_UBERBLOCK;
 
 	for (i = 0; i < UBERBLOCKS_COUNT; i++, offset += UBERBLOCK_SIZE) {
-		ub = (const struct zfs_uberblock *)((const char *) label + offset);
+		ub = (const struct zfs_uberblock *)((const char *) ring +
+				(offset - VDEV_LABEL_UBERBLOCK));
 
 		if (ub->ub_magic == UBERBLOCK_MAGIC) {
 			*ub_offset = offset;
@@ -251,15 +257,20 @@ static int find_uberblocks(const void *label, loff_t *ub_offset, int *swap_endia
 
 /* ZFS has 128x1kB host-endian root blocks, stored in 2 areas at the start
  * of the disk, and 2 areas at the end of the disk.  Check only some of them...
- * #4 (@ 132kB) is the first one written on a new filesystem. */
+ * #4 (@ 132kB) is the first one written on a new filesystem.
+ *
+ * Only the uberblock ring (the second half of the label) is read for every
+ * label, in one read. The labels at the end of the device are read only if
+ * the labels at the begin are not enough, and the nvlist is read only for
+ * the label with the valid uberblocks. */
 static int probe_zfs(blkid_probe pr,
 	const struct blkid_idmag *mag  __attribute__((__unused__)))
 {
 	int swab_endian = 0;
 	struct zfs_uberblock *ub = NULL;
-	loff_t offset = 0, ub_offset = 0;
+	loff_t offset = 0, ub_offset = 0, nvl_offset = 0;
 	int label_no, found = 0, found_in_label;
-	void *label;
+	unsigned char *ring;
 	loff_t blk_align = (pr->size % (256 * 1024ULL));
 
 	DBG(PROBE, ul_debug("probe_zfs\n"));
@@ -286,15 +297,18 @@ static int probe_zfs(blkid_probe pr,
 			 * we are working with whole-disk now */
 			continue;
 
-		label = blkid_probe_get_buffer(pr, offset, VDEV_LABEL_SIZE);
-		if (label == NULL)
+		ring = blkid_probe_get_buffer(pr, offset + VDEV_LABEL_UBERBLOCK,
+					      VDEV_UBERBLOCK_RING);
+		if (ring == NULL)
 			return errno ? -errno : 1;
 
-		found_in_label = find_uberblocks(label, &ub_offset, &swab_endian);
+		found_in_label = find_uberblocks(ring, &ub_offset, &swab_endian);
 
 		if (found_in_label > 0) {
 			found+= found_in_label;
-			ub = (struct zfs_uberblock *)((char *) label + ub_offset);
+			ub = (struct zfs_uberblock *)(ring +
+					(ub_offset - VDEV_LABEL_UBERBLOCK));
+			nvl_offset = offset;
 			ub_offset += offset;
 
 			if (found >= ZFS_WANT)
@@ -310,7 +324,7 @@ static int probe_zfs(blkid_probe pr,
 	blkid_probe_sprintf_version(pr, "%" PRIu64, swab_endian ?
 				    swab64(ub->ub_version) : ub->ub_version);
 
-	zfs_extract_guid_name(pr, offset);
+	zfs_extract_guid_name(pr, nvl_offset);
 
 	if (blkid_probe_set_magic(pr, ub_offset,
 				sizeof(ub->ub_magic),
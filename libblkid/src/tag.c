@@ -27,10 +27,90 @@ static blkid_tag blkid_new_tag(void)
 	DBG(TAG, ul_debugobj(tag, "alloc"));
 	INIT_LIST_HEAD(&tag->bit_tags);
 	INIT_LIST_HEAD(&tag->bit_names);
+	INIT_LIST_HEAD(&tag->bit_hash);
 
 	return tag;
 }
 
+/*
+ * The cache maintains NAME=value index of all device tags (the tag type
+ * heads are not indexed). The index is used by blkid_find_dev_with_tag().
+ */
+static size_t tag_hash(const char *name, const char *value)
+{
+	size_t h = 5381;
+
+	while (*name)
+		h = (h << 5) + h + (unsigned char) *name++;
+	h = (h << 5) + h + '=';
+	while (*value)
+		h = (h << 5) + h + (unsigned char) *value++;
+	return h;
+}
+
+int blkid_init_tag_hash(blkid_cache cache)
+{
+	size_t i;
+
+	cache->bic_hash = malloc(BLKID_BIC_HASHSZ * sizeof(struct list_head));
+	if (!cache->bic_hash)
+		return -BLKID_ERR_MEM;
+	for (i = 0; i < BLKID_BIC_HASHSZ; i++)
+		INIT_LIST_HEAD(&cache->bic_hash[i]);
+	cache->bic_hashsz = BLKID_BIC_HASHSZ;
+	cache->bic_nhashed = 0;
+	return 0;
+}
+
+/* keep the average chain length below 2 */
+static void grow_tag_hash(blkid_cache cache)
+{
+	struct list_head *hash;
+	size_t i, sz = cache->bic_hashsz * 4;
+
+	hash = malloc(sz * sizeof(struct list_head));
+	if (!hash)
+		return;		/* use the current index */
+	for (i = 0; i < sz; i++)
+		INIT_LIST_HEAD(&hash[i]);
+
+	for (i = 0; i < cache->bic_hashsz; i++) {
+		while (!list_empty(&cache->bic_hash[i])) {
+			blkid_tag t = list_entry(cache->bic_hash[i].next,
+						struct blkid_struct_tag, bit_hash);
+			list_del(&t->bit_hash);
+			list_add_tail(&t->bit_hash,
+				&hash[tag_hash(t->bit_name, t->bit_val) % sz]);
+		}
+	}
+
+	DBG(TAG, ul_debug("tags index resized %zu -> %zu", cache->bic_hashsz, sz));
+	free(cache->bic_hash);
+	cache->bic_hash = hash;
+	cache->bic_hashsz = sz;
+}
+
+static void hash_tag(blkid_cache cache, blkid_tag t)
+{
+	if (!cache->bic_hash)
+		return;
+	if (cache->bic_nhashed >= cache->bic_hashsz * 2)
+		grow_tag_hash(cache);
+
+	list_add_tail(&t->bit_hash,
+		&cache->bic_hash[tag_hash(t->bit_name, t->bit_val) % cache->bic_hashsz]);
+	cache->bic_nhashed++;
+}
+
+static void unhash_tag(blkid_tag t)
+{
+	if (list_empty(&t->bit_hash))
+		return;
+	list_del_init(&t->bit_hash);
+	if (t->bit_dev && t->bit_dev->bid_cache)
+		t->bit_dev->bid_cache->bic_nhashed--;
+}
+
 void blkid_free_tag(blkid_tag tag)
 {
 	if (!tag)
@@ -40,6 +120,7 @@ void blkid_free_tag(blkid_tag tag)
 
 	list_del(&tag->bit_tags);	/* list of tags for this device */
 	list_del(&tag->bit_names);	/* list of tags with this type */
+	unhash_tag(tag);		/* cache NAME=value index */
 
 	free(tag->bit_name);
 	free(tag->bit_val);
@@ -139,8 +220,11 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 			return 0;
 		}
 		DBG(TAG, ul_debugobj(t, "update (%s) '%s' -> '%s'", t->bit_name, t->bit_val, val));
+		unhash_tag(t);
 		free(t->bit_val);
 		t->bit_val = val;
+		if (dev->bid_cache)
+			hash_tag(dev->bid_cache, t);
 	} else {
 		/* Existing tag not present, add to device */
 		if (!(t = blkid_new_tag()))
@@ -168,6 +252,7 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 					      &dev->bid_cache->bic_tags);
 			}
 			list_add_tail(&t->bit_names, &head->bit_names);
+			hash_tag(dev->bid_cache, t);
 		}
 	}
 
@@ -322,10 +407,9 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 					 const char *type,
 					 const char *value)
 {
-	blkid_tag	head;
 	blkid_dev	dev;
 	int		pri;
-	struct list_head *p;
+	struct list_head *p, *bucket;
 	int		probe_new = 0;
 
 	if (!cache || !type || !value)
@@ -338,19 +422,17 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 try_again:
 	pri = -1;
 	dev = NULL;
-	head = blkid_find_head_cache(cache, type);
-
-	if (head) {
-		list_for_each(p, &head->bit_names) {
-			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
-						   bit_names);
-
-			if (!strcmp(tmp->bit_val, value) &&
-			    (tmp->bit_dev->bid_pri > pri) &&
-			    !access(tmp->bit_dev->bid_name, F_OK)) {
-				dev = tmp->bit_dev;
-				pri = dev->bid_pri;
-			}
+	bucket = &cache->bic_hash[tag_hash(type, value) % cache->bic_hashsz];
+
+	list_for_each(p, bucket) {
+		blkid_tag tmp = list_entry(p, struct blkid_struct_tag, bit_hash);
+
+		if (!strcmp(tmp->bit_val, value) &&
+		    !strcmp(tmp->bit_name, type) &&
+		    (tmp->bit_dev->bid_pri > pri) &&
+		    !access(tmp->bit_dev->bid_name, F_OK)) {
+			dev = tmp->bit_dev;
+			pri = dev->bid_pri;
 		}
 	}
 	if (dev && !(dev->bid_flags & BLKID_BID_FL_VERIFIED)) {
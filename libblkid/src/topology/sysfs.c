@@ -16,6 +16,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "sysfs.h"
 #include "topology.h"
@@ -40,12 +44,120 @@ static struct topology_val {
 	{ "queue/dax", blkid_topology_set_dax },
 };
 
+#define NTOPOLOGY_VALS	ARRAY_SIZE(topology_vals)
+
+/*
+ * Cache of the whole-disk values. The "queue/" attributes are not available
+ * for partitions and they are read from the whole-disk device; the cache
+ * allows to read them only once if all partitions of the disk are probed
+ * (for example by more probes, see blkid_probe_get_wholedisk_probe()). The
+ * entries are valid for TPCACHE_MAXAGE seconds only.
+ */
+#define TPCACHE_SIZE	8
+#define TPCACHE_MAXAGE	2
+
+struct tpcache_entry {
+	dev_t		disk;
+	time_t		stamp;			/* CLOCK_MONOTONIC */
+	int		exists[NTOPOLOGY_VALS];	/* attribute is available */
+	int64_t		data[NTOPOLOGY_VALS];
+};
+
+static struct tpcache_entry tpcache[TPCACHE_SIZE];
+static size_t tpcache_next;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t tpcache_lock = PTHREAD_MUTEX_INITIALIZER;
+# define tpcache_lock()		pthread_mutex_lock(&tpcache_lock)
+# define tpcache_unlock()	pthread_mutex_unlock(&tpcache_lock)
+#else
+# define tpcache_lock()
+# define tpcache_unlock()
+#endif
+
+static time_t tpcache_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return ts.tv_sec;
+}
+
+/* returns 0 and copies the entry to @res if the @disk values are cached */
+static int tpcache_lookup(dev_t disk, struct tpcache_entry *res)
+{
+	time_t now = tpcache_now();
+	size_t i;
+	int rc = 1;
+
+	if (!now)
+		return 1;
+
+	tpcache_lock();
+	for (i = 0; i < TPCACHE_SIZE; i++) {
+		struct tpcache_entry *e = &tpcache[i];
+
+		if (e->disk == disk && e->stamp && now - e->stamp < TPCACHE_MAXAGE) {
+			*res = *e;
+			rc = 0;
+			break;
+		}
+	}
+	tpcache_unlock();
+
+	DBG(LOWPROBE, ul_debug("topology cache %u:%u: %s", major(disk), minor(disk),
+				rc == 0 ? "hit" : "miss"));
+	return rc;
+}
+
+static void tpcache_store(struct tpcache_entry *ent)
+{
+	size_t i;
+
+	ent->stamp = tpcache_now();
+	if (!ent->stamp)
+		return;
+
+	tpcache_lock();
+	for (i = 0; i < TPCACHE_SIZE; i++) {
+		if (tpcache[i].disk == ent->disk)
+			break;
+	}
+	if (i == TPCACHE_SIZE) {
+		i = tpcache_next;
+		tpcache_next = (tpcache_next + 1) % TPCACHE_SIZE;
+	}
+	tpcache[i] = *ent;
+	tpcache_unlock();
+}
+
+/* reads the attribute from sysfs */
+static int read_topology_val(struct path_cxt *pc, size_t idx, int64_t *data)
+{
+	struct topology_val *val = &topology_vals[idx];
+
+	if (ul_path_access(pc, F_OK, val->attr) != 0)
+		return -ENOENT;	/* attribute does not exist */
+
+	if (val->set_ulong) {
+		uint64_t x;
+
+		if (ul_path_read_u64(pc, &x, val->attr) != 0)
+			return -EINVAL;
+		*data = (int64_t) x;
+		return 0;
+	}
+	return ul_path_read_s64(pc, data, val->attr) != 0 ? -EINVAL : 0;
+}
+
 static int probe_sysfs_tp(blkid_probe pr,
 		const struct blkid_idmag *mag __attribute__((__unused__)))
 {
-	dev_t dev;
-	int rc, set_parent = 1;
-	struct path_cxt *pc;
+	dev_t dev, disk = 0;
+	int rc, get_disk = 1, cached = 0;
+	struct path_cxt *pc, *parent = NULL;
+	struct tpcache_entry ent = { .disk = 0 };
 	size_t i, count = 0;
 
 	dev = blkid_probe_get_devno(pr);
@@ -57,50 +169,45 @@ static int probe_sysfs_tp(blkid_probe pr,
 
 	rc = 1;		/* nothing (default) */
 
-	for (i = 0; i < ARRAY_SIZE(topology_vals); i++) {
+	for (i = 0; i < NTOPOLOGY_VALS; i++) {
 		struct topology_val *val = &topology_vals[i];
-		int ok = ul_path_access(pc, F_OK, val->attr) == 0;
+		int64_t data;
 
 		rc = 1;	/* nothing */
 
-		if (!ok && set_parent) {
-			dev_t disk = blkid_probe_get_wholedisk_devno(pr);
-			set_parent = 0;
-
+		if (read_topology_val(pc, i, &data) != 0) {
 			/*
 			 * Read attributes from "disk" if the current device is
-			 * a partition. Note that sysfs ul_path_* API is able
-			 * to redirect requests to attributes if parent is set.
+			 * a partition.
 			 */
-			if (disk && disk != dev) {
-				struct path_cxt *parent = ul_new_sysfs_path(disk, NULL, NULL);
-				if (!parent)
-					goto done;
-
-				sysfs_blkdev_set_parent(pc, parent);
-				ul_unref_path(parent);
-
-				/* try it again */
-				ok = ul_path_access(pc, F_OK, val->attr) == 0;
+			if (get_disk) {
+				get_disk = 0;
+				disk = blkid_probe_get_wholedisk_devno(pr);
+				if (!disk || disk == dev)
+					disk = 0;
+				else if (tpcache_lookup(disk, &ent) == 0)
+					cached = 1;
+				else {
+					parent = ul_new_sysfs_path(disk, NULL, NULL);
+					if (!parent)
+						goto done;
+					ent.disk = disk;
+				}
 			}
+			if (!disk)
+				continue;
+			if (!cached)
+				ent.exists[i] = read_topology_val(parent, i,
+							&ent.data[i]) == 0;
+			if (!ent.exists[i])
+				continue;	/* attribute does not exist */
+			data = ent.data[i];
 		}
-		if (!ok)
-			continue;	/* attribute does not exist */
-
-		if (val->set_ulong) {
-			uint64_t data;
 
-			if (ul_path_read_u64(pc, &data, val->attr) != 0)
-				continue;
+		if (val->set_ulong)
 			rc = val->set_ulong(pr, (unsigned long) data);
-
-		} else if (val->set_int) {
-			int64_t data;
-
-			if (ul_path_read_s64(pc, &data, val->attr) != 0)
-				continue;
+		else if (val->set_int)
 			rc = val->set_int(pr, (int) data);
-		}
 
 		if (rc < 0)
 			goto done;	/* error */
@@ -108,8 +215,11 @@ static int probe_sysfs_tp(blkid_probe pr,
 			count++;
 	}
 
+	if (parent)
+		tpcache_store(&ent);
 done:
-	ul_unref_path(pc);		/* unref pc and parent */
+	ul_unref_path(parent);
+	ul_unref_path(pc);
 	if (count)
 		return 0;		/* success */
 	return rc;			/* error or nothing */
@@ -179,8 +179,14 @@ static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 		chn->idx = i;
 
 		if (id->probefunc) {
+			struct blkid_prstat_ctx stats;
+			int rc;
+
 			DBG(LOWPROBE, ul_debug("%s: call probefunc()", id->name));
-			if (id->probefunc(pr, NULL) != 0)
+			blkid_probe_stats_begin(pr, chn, id, &stats);
+			rc = id->probefunc(pr, NULL);
+			blkid_probe_stats_end(pr, &stats, rc);
+			if (rc != 0)
 				continue;
 		}
 
@@ -49,6 +49,74 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	}
 }
 
+/*
+ * Low-level part of blkid_verify(); probes device @fd by @pr. The result is
+ * kept in @pr, see blkid__verify_apply() and blkid__verify_reset().
+ *
+ * Returns: 0 on success, 1 if nothing found, <0 on error.
+ */
+int blkid__verify_probe(blkid_probe pr, int fd)
+{
+	if (blkid_probe_set_device(pr, fd, 0, 0))
+		return -1;	/* failed to read the device */
+
+	/* enable superblocks probing */
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+
+	/* enable partitions probing */
+	blkid_probe_enable_partitions(pr, TRUE);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	/* probe */
+	return blkid_do_safeprobe(pr);
+}
+
+/*
+ * Replaces @dev tags with the result from @pr and marks the device as
+ * verified. The cache has to be locked if used in more threads.
+ */
+void blkid__verify_apply(blkid_probe pr, blkid_dev dev, dev_t devno)
+{
+	blkid_tag_iterate iter;
+	const char *type, *value;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	struct timeval tv;
+#endif
+
+	/* remove old cache info */
+	iter = blkid_tag_iterate_begin(dev);
+	while (blkid_tag_next(iter, &type, &value) == 0)
+		blkid_set_tag(dev, type, NULL, 0);
+	blkid_tag_iterate_end(iter);
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	if (!gettimeofday(&tv, NULL)) {
+		dev->bid_time = tv.tv_sec;
+		dev->bid_utime = tv.tv_usec;
+	} else
+#endif
+		dev->bid_time = time(NULL);
+
+	dev->bid_devno = devno;
+	dev->bid_flags |= BLKID_BID_FL_VERIFIED;
+	if (dev->bid_cache)
+		dev->bid_cache->bic_flags |= BLKID_BIC_FL_CHANGED;
+
+	blkid_probe_to_tags(pr, dev);
+
+	DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
+		   dev->bid_name, (long long)devno, dev->bid_type));
+}
+
+void blkid__verify_reset(blkid_probe pr)
+{
+	blkid_probe_reset_superblocks_filter(pr);
+	blkid_probe_set_device(pr, -1, 0, 0);
+}
+
 /*
  * Verify that the data in dev is consistent with what is on the actual
  * block device (using the devname field only).  Normally this will be
@@ -60,8 +128,6 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
  */
 blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 {
-	blkid_tag_iterate iter;
-	const char *type, *value;
 	struct stat st;
 	time_t diff, now;
 	int fd;
@@ -69,6 +135,11 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 	if (!dev || !cache)
 		return NULL;
 
+	/* already postponed, see blkid_probe_all_parallel() */
+	if ((dev->bid_flags & BLKID_BID_FL_PENDING) &&
+	    (cache->bic_flags & BLKID_BIC_FL_DEFER))
+		return dev;
+
 	now = time(NULL);
 	diff = (uintmax_t)now - dev->bid_time;
 
@@ -97,6 +168,7 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 #endif
 	    diff >= 0 && diff < BLKID_PROBE_MIN) {
 		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
+		STAT_ADD(CACHE_HITS, 1);
 		return dev;
 	}
 
@@ -118,14 +190,24 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		blkid_free_dev(dev);
 		return NULL;
 	}
+
+	if (cache->bic_flags & BLKID_BIC_FL_DEFER) {
+		DBG(PROBE, ul_debug("%s: probing postponed", dev->bid_name));
+		dev->bid_flags |= BLKID_BID_FL_PENDING;
+		return dev;
+	}
+
 	if (!cache->probe) {
 		cache->probe = blkid_new_probe();
 		if (!cache->probe) {
 			blkid_free_dev(dev);
 			return NULL;
 		}
+		if (cache->bic_flags & BLKID_BIC_FL_DIRECTIO)
+			blkid_probe_enable_directio(cache->probe, 1);
 	}
 
+	STAT_ADD(CACHE_REVALIDATE, 1);
 	fd = open(dev->bid_name, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
 	if (fd < 0) {
 		DBG(PROBE, ul_debug("blkid_verify: error %s (%d) while "
@@ -134,59 +216,16 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		goto open_err;
 	}
 
-	if (blkid_probe_set_device(cache->probe, fd, 0, 0)) {
-		/* failed to read the device */
-		close(fd);
-		blkid_free_dev(dev);
-		return NULL;
-	}
-
-	/* remove old cache info */
-	iter = blkid_tag_iterate_begin(dev);
-	while (blkid_tag_next(iter, &type, &value) == 0)
-		blkid_set_tag(dev, type, NULL, 0);
-	blkid_tag_iterate_end(iter);
-
-	/* enable superblocks probing */
-	blkid_probe_enable_superblocks(cache->probe, TRUE);
-	blkid_probe_set_superblocks_flags(cache->probe,
-		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
-
-	/* enable partitions probing */
-	blkid_probe_enable_partitions(cache->probe, TRUE);
-	blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
-
-	/* probe */
-	if (blkid_do_safeprobe(cache->probe)) {
-		/* found nothing or error */
+	if (blkid__verify_probe(cache->probe, fd) == 0)
+		blkid__verify_apply(cache->probe, dev, st.st_rdev);
+	else {
+		/* failed to read the device, found nothing or error */
 		blkid_free_dev(dev);
 		dev = NULL;
 	}
 
-	if (dev) {
-#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-		struct timeval tv;
-		if (!gettimeofday(&tv, NULL)) {
-			dev->bid_time = tv.tv_sec;
-			dev->bid_utime = tv.tv_usec;
-		} else
-#endif
-			dev->bid_time = time(NULL);
-
-		dev->bid_devno = st.st_rdev;
-		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
-		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
-
-		blkid_probe_to_tags(cache->probe, dev);
-
-		DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
-			   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
-	}
-
 	/* reset prober */
-	blkid_probe_reset_superblocks_filter(cache->probe);
-	blkid_probe_set_device(cache->probe, -1, 0, 0);
+	blkid__verify_reset(cache->probe);
 	close(fd);
 
 	return dev;
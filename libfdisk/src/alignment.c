@@ -2,6 +2,7 @@
 #ifdef HAVE_LIBBLKID
 #include <blkid.h>
 #endif
+#include <time.h>
 #include "blkdev.h"
 
 #include "fdiskP.h"
@@ -33,31 +34,88 @@
  * The alignment setting may be modified by disk label driver.
  */
 
+static void update_alignment(struct fdisk_context *cxt)
+{
+	struct fdisk_alignment *al = &cxt->align;
+
+	al->grain = cxt->grain;
+	al->sector_size = cxt->sector_size;
+	al->phy_sector_size = cxt->phy_sector_size;
+	al->min_io_size = cxt->min_io_size;
+	al->alignment_offset = cxt->alignment_offset;
+
+	al->phy_granularity = max(cxt->phy_sector_size, cxt->min_io_size);
+	al->granularity = max(al->phy_granularity, cxt->grain);
+
+	if (cxt->sector_size) {
+		al->grain_sectors = cxt->grain / cxt->sector_size;
+		al->offset_sectors = cxt->alignment_offset / cxt->sector_size;
+		al->compensation = (al->phy_granularity - cxt->alignment_offset)
+						/ cxt->sector_size;
+	} else
+		al->grain_sectors = al->offset_sectors = al->compensation = 0;
+
+	al->pow2 = !cxt->alignment_offset
+		   && al->granularity && is_power_of_2(al->granularity)
+		   && al->phy_granularity && is_power_of_2(al->phy_granularity);
+	al->valid = 1;
+
+	DBG(CXT, ul_debugobj(cxt, "alignment: granularity=%lu, phy-granularity=%lu, "
+				"grain=%ju sectors, offset=%ju sectors%s",
+				al->granularity, al->phy_granularity,
+				(uintmax_t) al->grain_sectors,
+				(uintmax_t) al->offset_sectors,
+				al->pow2 ? " [pow2]" : ""));
+}
+
 /*
- * Alignment according to logical granularity (usually 1MiB)
+ * Returns the alignment descriptor, the label drivers and the user settings
+ * modify the grain and topology directly, so compare the source values.
  */
-static int lba_is_aligned(struct fdisk_context *cxt, uintmax_t lba)
+static inline const struct fdisk_alignment *get_alignment(struct fdisk_context *cxt)
+{
+	struct fdisk_alignment *al = &cxt->align;
+
+	if (!al->valid
+	    || al->grain != cxt->grain
+	    || al->sector_size != cxt->sector_size
+	    || al->phy_sector_size != cxt->phy_sector_size
+	    || al->min_io_size != cxt->min_io_size
+	    || al->alignment_offset != cxt->alignment_offset)
+		update_alignment(cxt);
+	return al;
+}
+
+static inline int is_aligned_to(struct fdisk_context *cxt, uintmax_t lba,
+				unsigned long granularity, int pow2)
 {
-	unsigned long granularity = max(cxt->phy_sector_size, cxt->min_io_size);
 	uintmax_t offset;
 
-	if (cxt->grain > granularity)
-		granularity = cxt->grain;
+	if (pow2)
+		return ((lba * cxt->sector_size) & (granularity - 1)) == 0;
 
 	offset = (lba * cxt->sector_size) % granularity;
-
 	return !((granularity + cxt->alignment_offset - offset) % granularity);
 }
 
+/*
+ * Alignment according to logical granularity (usually 1MiB)
+ */
+static int lba_is_aligned(struct fdisk_context *cxt, uintmax_t lba)
+{
+	const struct fdisk_alignment *al = get_alignment(cxt);
+
+	return is_aligned_to(cxt, lba, al->granularity, al->pow2);
+}
+
 /*
  * Alignment according to physical device topology (usually minimal i/o size)
  */
 static int lba_is_phy_aligned(struct fdisk_context *cxt, fdisk_sector_t lba)
 {
-	unsigned long granularity = max(cxt->phy_sector_size, cxt->min_io_size);
-	uintmax_t offset = (lba * cxt->sector_size) % granularity;
+	const struct fdisk_alignment *al = get_alignment(cxt);
 
-	return !((granularity + cxt->alignment_offset - offset) % granularity);
+	return is_aligned_to(cxt, lba, al->phy_granularity, al->pow2);
 }
 
 /**
@@ -74,12 +132,13 @@ static int lba_is_phy_aligned(struct fdisk_context *cxt, fdisk_sector_t lba)
  */
 fdisk_sector_t fdisk_align_lba(struct fdisk_context *cxt, fdisk_sector_t lba, int direction)
 {
+	const struct fdisk_alignment *al = get_alignment(cxt);
 	fdisk_sector_t res;
 
-	if (lba_is_aligned(cxt, lba))
+	if (is_aligned_to(cxt, lba, al->granularity, al->pow2))
 		res = lba;
 	else {
-		fdisk_sector_t sects_in_phy = cxt->grain / cxt->sector_size;
+		fdisk_sector_t sects_in_phy = al->grain_sectors;
 
 		if (lba < cxt->first_lba)
 			res = cxt->first_lba;
@@ -94,7 +153,7 @@ fdisk_sector_t fdisk_align_lba(struct fdisk_context *cxt, fdisk_sector_t lba, in
 			res = ((lba + sects_in_phy / 2) / sects_in_phy) * sects_in_phy;
 
 		if (cxt->alignment_offset && !lba_is_aligned(cxt, res) &&
-		    res > cxt->alignment_offset / cxt->sector_size) {
+		    res > al->offset_sectors) {
 			/*
 			 * apply alignment_offset
 			 *
@@ -103,8 +162,7 @@ fdisk_sector_t fdisk_align_lba(struct fdisk_context *cxt, fdisk_sector_t lba, in
 			 * according the offset to be on the physical boundary.
 			 */
 			/* fprintf(stderr, "LBA: %llu apply alignment_offset\n", res); */
-			res -= (max(cxt->phy_sector_size, cxt->min_io_size) -
-					cxt->alignment_offset) / cxt->sector_size;
+			res -= al->compensation;
 
 			if (direction == FDISK_ALIGN_UP && res < lba)
 				res += sects_in_phy;
@@ -138,16 +196,16 @@ fdisk_sector_t fdisk_align_lba(struct fdisk_context *cxt, fdisk_sector_t lba, in
 fdisk_sector_t fdisk_align_lba_in_range(struct fdisk_context *cxt,
 				  fdisk_sector_t lba, fdisk_sector_t start, fdisk_sector_t stop)
 {
-	fdisk_sector_t res;
+	fdisk_sector_t res, grain = get_alignment(cxt)->grain_sectors;
 
 	/*DBG(CXT, ul_debugobj(cxt, "LBA: align in range <%ju..%ju>", (uintmax_t) start, (uintmax_t) stop));*/
 
-	if (start + (cxt->grain / cxt->sector_size) <= stop) {
+	if (start + grain <= stop) {
 		start = fdisk_align_lba(cxt, start, FDISK_ALIGN_UP);
 		stop = fdisk_align_lba(cxt, stop, FDISK_ALIGN_DOWN);
 	}
 
-	if (start + (cxt->grain / cxt->sector_size) > stop) {
+	if (start + grain > stop) {
 		DBG(CXT, ul_debugobj(cxt, "LBA: area smaller than grain, don't align"));
 		res = lba;
 		goto done;
@@ -459,6 +517,7 @@ int fdisk_reset_device_properties(struct fdisk_context *cxt)
 
 	DBG(CXT, ul_debugobj(cxt, "*** resetting device properties"));
 
+	cxt->topology.stamp = 0;	/* don't use cached topology */
 	fdisk_zeroize_device_properties(cxt);
 	fdisk_discover_topology(cxt);
 	fdisk_discover_geometry(cxt);
@@ -513,50 +572,97 @@ int fdisk_discover_geometry(struct fdisk_context *cxt)
 	return 0;
 }
 
+static time_t topology_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return ts.tv_sec;
+}
+
+/* returns 0 if the topology of the current device is cached */
+static int topology_from_cache(struct fdisk_context *cxt)
+{
+	struct fdisk_topology_cache *tc = &cxt->topology;
+	time_t now;
+
+	if (!S_ISBLK(cxt->dev_st.st_mode) || !tc->stamp
+	    || tc->devno != cxt->dev_st.st_rdev)
+		return 1;
+
+	now = topology_now();
+	if (!now || now - tc->stamp >= FDISK_TOPOLOGY_MAXAGE)
+		return 1;
+
+	cxt->min_io_size = tc->min_io_size;
+	cxt->optimal_io_size = tc->optimal_io_size;
+	cxt->phy_sector_size = tc->phy_sector_size;
+	cxt->alignment_offset = tc->alignment_offset;
+
+	DBG(CXT, ul_debugobj(cxt, "topology cached"));
+	return 0;
+}
+
+static void topology_to_cache(struct fdisk_context *cxt)
+{
+	struct fdisk_topology_cache *tc = &cxt->topology;
+
+	tc->stamp = S_ISBLK(cxt->dev_st.st_mode) ? topology_now() : 0;
+	tc->devno = cxt->dev_st.st_rdev;
+	tc->min_io_size = cxt->min_io_size;
+	tc->optimal_io_size = cxt->optimal_io_size;
+	tc->phy_sector_size = cxt->phy_sector_size;
+	tc->alignment_offset = cxt->alignment_offset;
+}
+
 int fdisk_discover_topology(struct fdisk_context *cxt)
 {
-#ifdef HAVE_LIBBLKID
-	blkid_probe pr;
-#endif
 	assert(cxt);
 	assert(cxt->sector_size == 0);
 
 	DBG(CXT, ul_debugobj(cxt, "%s: discovering topology...", cxt->dev_path));
+
+	if (topology_from_cache(cxt) != 0) {
 #ifdef HAVE_LIBBLKID
-	DBG(CXT, ul_debugobj(cxt, "initialize libblkid prober"));
-
-	pr = blkid_new_probe();
-	if (pr && blkid_probe_set_device(pr, cxt->dev_fd, 0, 0) == 0) {
-		blkid_topology tp = blkid_probe_get_topology(pr);
-
-		if (tp) {
-			cxt->min_io_size = blkid_topology_get_minimum_io_size(tp);
-			cxt->optimal_io_size = blkid_topology_get_optimal_io_size(tp);
-			cxt->phy_sector_size = blkid_topology_get_physical_sector_size(tp);
-			cxt->alignment_offset = blkid_topology_get_alignment_offset(tp);
-
-			/* I/O size used by fdisk */
-			cxt->io_size = cxt->optimal_io_size;
-			if (!cxt->io_size)
-				/* optimal I/O is optional, default to minimum IO */
-				cxt->io_size = cxt->min_io_size;
-
-			if (cxt->io_size && cxt->phy_sector_size) {
-				if (cxt->io_size == 33553920) {
-					/* 33553920 (32 MiB - 512) is always a controller error */
-					DBG(CXT, ul_debugobj(cxt, "ignore bad I/O size 33553920"));
-					cxt->io_size = cxt->phy_sector_size;
-				} else if ((cxt->io_size % cxt->phy_sector_size) != 0) {
-					/* ignore optimal I/O if not aligned to phy.sector size */
-					DBG(CXT, ul_debugobj(cxt, "ignore misaligned I/O size"));
-					cxt->io_size = cxt->phy_sector_size;
-				}
+		/* the prober is kept in the context, the buffers are reset by
+		 * blkid_probe_set_device() */
+		if (!cxt->topology_pr) {
+			DBG(CXT, ul_debugobj(cxt, "initialize libblkid prober"));
+			cxt->topology_pr = blkid_new_probe();
+		}
+		if (cxt->topology_pr
+		    && blkid_probe_set_device(cxt->topology_pr, cxt->dev_fd, 0, 0) == 0) {
+			blkid_topology tp = blkid_probe_get_topology(cxt->topology_pr);
+
+			if (tp) {
+				cxt->min_io_size = blkid_topology_get_minimum_io_size(tp);
+				cxt->optimal_io_size = blkid_topology_get_optimal_io_size(tp);
+				cxt->phy_sector_size = blkid_topology_get_physical_sector_size(tp);
+				cxt->alignment_offset = blkid_topology_get_alignment_offset(tp);
 			}
+		}
+#endif
+		topology_to_cache(cxt);
+	}
 
+	/* I/O size used by fdisk */
+	cxt->io_size = cxt->optimal_io_size;
+	if (!cxt->io_size)
+		/* optimal I/O is optional, default to minimum IO */
+		cxt->io_size = cxt->min_io_size;
+
+	if (cxt->io_size && cxt->phy_sector_size) {
+		if (cxt->io_size == 33553920) {
+			/* 33553920 (32 MiB - 512) is always a controller error */
+			DBG(CXT, ul_debugobj(cxt, "ignore bad I/O size 33553920"));
+			cxt->io_size = cxt->phy_sector_size;
+		} else if ((cxt->io_size % cxt->phy_sector_size) != 0) {
+			/* ignore optimal I/O if not aligned to phy.sector size */
+			DBG(CXT, ul_debugobj(cxt, "ignore misaligned I/O size"));
+			cxt->io_size = cxt->phy_sector_size;
 		}
 	}
-	blkid_free_probe(pr);
-#endif
 
 	cxt->sector_size = get_sector_size(cxt);
 	if (!cxt->phy_sector_size) /* could not discover physical size */
@@ -698,6 +804,7 @@ int fdisk_reset_alignment(struct fdisk_context *cxt)
 
 	/* overwrite default by label stuff */
 	rc = fdisk_apply_label_device_properties(cxt);
+	update_alignment(cxt);
 
 	DBG(CXT, ul_debugobj(cxt, "alignment reset to: "
 			    "first LBA=%ju, last LBA=%ju, grain=%lu [rc=%d]",
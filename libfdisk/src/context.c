@@ -54,6 +54,7 @@ struct fdisk_context *fdisk_new_context(void)
 		return NULL;
 
 	DBG(CXT, ul_debugobj(cxt, "alloc"));
+	STAT_ADD(CONTEXT_ALLOC, 1);
 	cxt->dev_fd = -1;
 	cxt->refcount = 1;
 
@@ -538,8 +539,14 @@ static void reset_context(struct fdisk_context *cxt)
 		/* we close device only in primary context */
 		if (cxt->dev_fd > -1 && cxt->is_priv)
 			close(cxt->dev_fd);
-		DBG(CXT, ul_debugobj(cxt, "  freeing firstsector"));
-		free(cxt->firstsector);
+
+		/* keep the buffer for the next device */
+		if (cxt->firstsector) {
+			DBG(CXT, ul_debugobj(cxt, "  keeping firstsector as spare"));
+			free(cxt->spare_sector);
+			cxt->spare_sector = cxt->firstsector;
+			cxt->spare_sector_bufsz = cxt->firstsector_bufsz;
+		}
 	}
 
 	free(cxt->dev_path);
@@ -871,18 +878,157 @@ int fdisk_reread_partition_table(struct fdisk_context *cxt)
 }
 
 #ifdef __linux__
-static inline int add_to_partitions_array(
-			struct fdisk_partition ***ary,
-			struct fdisk_partition *pa,
-			size_t *n, size_t nmax)
-{
-	if (!*ary) {
-		*ary = calloc(nmax, sizeof(struct fdisk_partition *));
-		if (!*ary)
-			return -ENOMEM;
+/* one BLKPG_* ioctl, start and size in 512-byte sectors */
+struct reread_op {
+	int		action;
+	size_t		partno;
+	uint64_t	start;
+	uint64_t	size;
+};
+
+static inline void add_reread_op(struct reread_op *ops, size_t *n, int action,
+				 size_t partno, uint64_t start, uint64_t size)
+{
+	struct reread_op *op = &ops[(*n)++];
+
+	op->action = action;
+	op->partno = partno;
+	op->start = start;
+	op->size = size;
+}
+
+static int cmp_kernel_parts(const void *a, const void *b)
+{
+	const struct sysfs_blkdev_part *x = a, *y = b;
+
+	return x->partno - y->partno;
+}
+
+/* the partition as it should be known by kernel */
+static void get_kernel_range(struct fdisk_context *cxt, struct fdisk_partition *pa,
+			     uint64_t *start, uint64_t *size)
+{
+	/* sector size factor -- used to recount from real to 512-byte sectors */
+	unsigned int ssf = cxt->sector_size / 512;
+
+	*start = pa->start * ssf;
+	*size = pa->size * ssf;
+
+	if (fdisk_is_label(cxt, DOS) && fdisk_partition_is_container(pa))
+		/* Let's follow the Linux kernel and reduce
+		 * DOS extended partition to 1 or 2 sectors.
+		 */
+		*size = min(*size, (uint64_t) 2);
+}
+
+/*
+ * Compares the new layout @tb with the partitions known by kernel. Only
+ * the differences are added to @ops. Returns <0 if the kernel view is not
+ * available.
+ */
+static int diff_kernel_partitions(struct fdisk_context *cxt, struct fdisk_table *tb,
+				  struct reread_op **ops, size_t *nops)
+{
+	struct sysfs_blkdev_part *kp = NULL;
+	struct fdisk_partition *pa;
+	struct fdisk_iter itr;
+	struct path_cxt *pc;
+	size_t i, nk;
+	int rc;
+
+	if (!S_ISBLK(cxt->dev_st.st_mode))
+		return -EINVAL;
+	pc = ul_new_sysfs_path(cxt->dev_st.st_rdev, NULL, NULL);
+	if (!pc)
+		return -errno;
+	rc = sysfs_blkdev_get_partitions(pc, &kp);
+	ul_unref_path(pc);
+	if (rc < 0)
+		return rc;
+	nk = rc;
+
+	/* every partition is removed, added, or removed and added */
+	*ops = calloc(2 * (nk + fdisk_table_get_nents(tb)) + 1, sizeof(struct reread_op));
+	if (!*ops) {
+		free(kp);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nk; i++) {
+		uint64_t start, size;
+
+		if (kp[i].partno < 1)
+			continue;
+		pa = fdisk_table_get_partition_by_partno(tb, kp[i].partno - 1);
+		if (!pa) {
+			add_reread_op(*ops, nops, BLKPG_DEL_PARTITION, kp[i].partno, 0, 0);
+			continue;
+		}
+		get_kernel_range(cxt, pa, &start, &size);
+
+		if (start == kp[i].start && size == kp[i].size)
+			continue;				/* unchanged */
+		if (start == kp[i].start)
+			add_reread_op(*ops, nops, BLKPG_RESIZE_PARTITION, kp[i].partno, start, size);
+		else {
+			add_reread_op(*ops, nops, BLKPG_DEL_PARTITION, kp[i].partno, 0, 0);
+			add_reread_op(*ops, nops, BLKPG_ADD_PARTITION, kp[i].partno, start, size);
+		}
+	}
+
+	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
+	while (fdisk_table_next_partition(tb, &itr, &pa) == 0) {
+		struct sysfs_blkdev_part key = { .partno = pa->partno + 1 };
+		uint64_t start, size;
+
+		if (nk && bsearch(&key, kp, nk, sizeof(*kp), cmp_kernel_parts))
+			continue;
+		get_kernel_range(cxt, pa, &start, &size);
+		add_reread_op(*ops, nops, BLKPG_ADD_PARTITION, pa->partno + 1, start, size);
+	}
+
+	free(kp);
+	return 0;
+}
+
+/* the old way, compare with the original on-disk layout */
+static int diff_layouts(struct fdisk_context *cxt, struct fdisk_table *org,
+			struct fdisk_table *tb, struct reread_op **ops, size_t *nops)
+{
+	struct fdisk_partition *pa;
+	struct fdisk_iter itr;
+	int change;
+
+	*ops = calloc(2 * (fdisk_table_get_nents(tb) + fdisk_table_get_nents(org)) + 1,
+			sizeof(struct reread_op));
+	if (!*ops)
+		return -ENOMEM;
+
+	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
+
+	while (fdisk_diff_tables(org, tb, &itr, &pa, &change) == 0) {
+		uint64_t start, size;
+
+		if (change == FDISK_DIFF_UNCHANGED)
+			continue;
+		get_kernel_range(cxt, pa, &start, &size);
+
+		switch (change) {
+		case FDISK_DIFF_REMOVED:
+			add_reread_op(*ops, nops, BLKPG_DEL_PARTITION, pa->partno + 1, 0, 0);
+			break;
+		case FDISK_DIFF_ADDED:
+			add_reread_op(*ops, nops, BLKPG_ADD_PARTITION, pa->partno + 1, start, size);
+			break;
+		case FDISK_DIFF_RESIZED:
+			add_reread_op(*ops, nops, BLKPG_RESIZE_PARTITION, pa->partno + 1, start, size);
+			break;
+		case FDISK_DIFF_MOVED:
+			add_reread_op(*ops, nops, BLKPG_DEL_PARTITION, pa->partno + 1, 0, 0);
+			add_reread_op(*ops, nops, BLKPG_ADD_PARTITION, pa->partno + 1, start, size);
+			break;
+		}
 	}
-	(*ary)[*n] = pa;
-	(*n)++;
 	return 0;
 }
 #endif
@@ -890,12 +1036,18 @@ static inline int add_to_partitions_array(
 /**
  * fdisk_reread_changes:
  * @cxt: context
- * @org: original layout (on disk)
+ * @org: original layout (on disk) or NULL
  *
  * Like fdisk_reread_partition_table() but don't forces kernel re-read all
  * partition table. The BLKPG_* ioctls are used for individual partitions. The
  * advantage is that unmodified partitions maybe mounted.
  *
+ * The current layout is compared with the partitions known by kernel (from
+ * /sys), so only the really changed partitions are removed, resized or added
+ * and the unchanged partitions don't generate any uevent. The @org layout is
+ * used only if the kernel view is not available; if @org is NULL in this case
+ * then fdisk_reread_partition_table() is used.
+ *
  * The function behaves like fdisk_reread_partition_table() on systems where
  * are no available BLKPG_* ioctls.
  *
@@ -905,82 +1057,60 @@ static inline int add_to_partitions_array(
 int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
 {
 	struct fdisk_table *tb = NULL;
-	struct fdisk_iter itr;
-	struct fdisk_partition *pa;
-	struct fdisk_partition **rem = NULL, **add = NULL, **upd = NULL;
-	int change, rc = 0, err = 0;
-	size_t nparts, i, nadds = 0, nupds = 0, nrems = 0;
-	unsigned int ssf;
+	struct reread_op *ops = NULL;
+	size_t i, nops = 0;
+	int rc, err = 0;
 
 	DBG(CXT, ul_debugobj(cxt, "rereading changes"));
 
-	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
-
 	/* the current layout */
-	fdisk_get_partitions(cxt, &tb);
-	/* maximal number of partitions */
-	nparts = max(fdisk_table_get_nents(tb), fdisk_table_get_nents(org));
+	rc = fdisk_get_partitions(cxt, &tb);
+	if (rc)
+		return rc;
 
-	while (fdisk_diff_tables(org, tb, &itr, &pa, &change) == 0) {
-		if (change == FDISK_DIFF_UNCHANGED)
-			continue;
-		switch (change) {
-		case FDISK_DIFF_REMOVED:
-			rc = add_to_partitions_array(&rem, pa, &nrems, nparts);
-			break;
-		case FDISK_DIFF_ADDED:
-			rc = add_to_partitions_array(&add, pa, &nadds, nparts);
-			break;
-		case FDISK_DIFF_RESIZED:
-			rc = add_to_partitions_array(&upd, pa, &nupds, nparts);
-			break;
-		case FDISK_DIFF_MOVED:
-			rc = add_to_partitions_array(&rem, pa, &nrems, nparts);
-			if (!rc)
-				rc = add_to_partitions_array(&add, pa, &nadds, nparts);
-			break;
+	rc = diff_kernel_partitions(cxt, tb, &ops, &nops);
+	if (rc == -ENOMEM)
+		goto done;
+	if (rc < 0) {
+		DBG(CXT, ul_debugobj(cxt, "kernel view not available [rc=%d]", rc));
+		if (!org) {
+			fdisk_unref_table(tb);
+			return fdisk_reread_partition_table(cxt);
 		}
-		if (rc != 0)
+		rc = diff_layouts(cxt, org, tb, &ops, &nops);
+		if (rc)
 			goto done;
 	}
 
-	/* sector size factor -- used to recount from real to 512-byte sectors */
-	ssf = cxt->sector_size / 512;
+	DBG(CXT, ul_debugobj(cxt, "%zu BLKPG operations", nops));
 
-	for (i = 0; i < nrems; i++) {
-		pa = rem[i];
-		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_DEL_PARTITION", pa->partno));
-		if (partx_del_partition(cxt->dev_fd, pa->partno + 1) != 0) {
-			fdisk_warn(cxt, _("Failed to remove partition %zu from system"), pa->partno + 1);
+	/* removed partitions first, the added ones may overlap them */
+	for (i = 0; i < nops; i++) {
+		if (ops[i].action != BLKPG_DEL_PARTITION)
+			continue;
+		DBG(CXT, ul_debugobj(cxt, "#%zu calling BLKPG_DEL_PARTITION", ops[i].partno));
+		if (partx_del_partition(cxt->dev_fd, ops[i].partno) != 0 && errno != ENXIO) {
+			fdisk_warn(cxt, _("Failed to remove partition %zu from system"), ops[i].partno);
 			err++;
 		}
 	}
-	for (i = 0; i < nupds; i++) {
-		pa = upd[i];
-		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_RESIZE_PARTITION", pa->partno));
-		if (partx_resize_partition(cxt->dev_fd, pa->partno + 1,
-					   pa->start * ssf, pa->size * ssf) != 0) {
-			fdisk_warn(cxt, _("Failed to update system information about partition %zu"), pa->partno + 1);
+	for (i = 0; i < nops; i++) {
+		if (ops[i].action != BLKPG_RESIZE_PARTITION)
+			continue;
+		DBG(CXT, ul_debugobj(cxt, "#%zu calling BLKPG_RESIZE_PARTITION", ops[i].partno));
+		if (partx_resize_partition(cxt->dev_fd, ops[i].partno,
+					   ops[i].start, ops[i].size) != 0) {
+			fdisk_warn(cxt, _("Failed to update system information about partition %zu"), ops[i].partno);
 			err++;
 		}
 	}
-	for (i = 0; i < nadds; i++) {
-		uint64_t sz;
-
-		pa = add[i];
-		sz = pa->size * ssf;
-
-		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_ADD_PARTITION", pa->partno));
-
-		if (fdisk_is_label(cxt, DOS) && fdisk_partition_is_container(pa))
-			/* Let's follow the Linux kernel and reduce
-                         * DOS extended partition to 1 or 2 sectors.
-			 */
-			sz = min(sz, (uint64_t) 2);
-
-		if (partx_add_partition(cxt->dev_fd, pa->partno + 1,
-					pa->start * ssf, sz) != 0) {
-			fdisk_warn(cxt, _("Failed to add partition %zu to system"), pa->partno + 1);
+	for (i = 0; i < nops; i++) {
+		if (ops[i].action != BLKPG_ADD_PARTITION)
+			continue;
+		DBG(CXT, ul_debugobj(cxt, "#%zu calling BLKPG_ADD_PARTITION", ops[i].partno));
+		if (partx_add_partition(cxt->dev_fd, ops[i].partno,
+					ops[i].start, ops[i].size) != 0) {
+			fdisk_warn(cxt, _("Failed to add partition %zu to system"), ops[i].partno);
 			err++;
 		}
 	}
@@ -989,9 +1119,7 @@ int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
 			"The kernel still uses the old partitions. The new "
 			"table will be used at the next reboot. "));
 done:
-	free(rem);
-	free(add);
-	free(upd);
+	free(ops);
 	fdisk_unref_table(tb);
 	return rc;
 }
@@ -1072,6 +1200,11 @@ void fdisk_unref_context(struct fdisk_context *cxt)
 
 		reset_context(cxt);	/* this is sensitive to parent<->child relationship! */
 
+		free(cxt->spare_sector);
+#ifdef HAVE_LIBBLKID
+		blkid_free_probe(cxt->topology_pr);
+#endif
+
 		/* deallocate label's private stuff */
 		for (i = 0; i < cxt->nlabels; i++) {
 			if (!cxt->labels[i])
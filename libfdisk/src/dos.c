@@ -249,6 +249,9 @@ static int read_sector(struct fdisk_context *cxt, fdisk_sector_t secno,
 		return rc;
 
 	r = read(cxt->dev_fd, buf, cxt->sector_size);
+	STAT_ADD(READS, 1);
+	if (r > 0)
+		STAT_ADD(READ_BYTES, r);
 	if (r == (ssize_t) cxt->sector_size)
 		return 0;
 	if (r < 0)
@@ -17,6 +17,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <uuid.h>
+#ifdef HAVE_LIBBLKID
+# include <blkid.h>
+#endif
 
 #include "c.h"
 #include "libfdisk.h"
@@ -51,6 +54,24 @@ UL_DEBUG_DECLARE_MASK(libfdisk);
 #define UL_DEBUG_CURRENT_MASK	UL_DEBUG_MASK(libfdisk)
 #include "debugobj.h"
 
+/*
+ * Statistics, see fdisk_enable_stats()
+ */
+enum {
+	FDISK_STAT_CONTEXT_ALLOC = 0,
+	FDISK_STAT_LABEL_PROBES,
+	FDISK_STAT_LABEL_PROBE_NS,
+	FDISK_STAT_READS,
+	FDISK_STAT_READ_BYTES,
+	FDISK_STAT_LABEL_WRITES,
+
+	__FDISK_STAT_COUNT
+};
+
+UL_DEBUG_DECLARE_STATS(libfdisk, __FDISK_STAT_COUNT);
+#define STAT_ADD(c, n)	__UL_STAT_ADD(libfdisk, FDISK_STAT_, c, n)
+#define STAT_TIME(c, x)	__UL_STAT_TIME(libfdisk, FDISK_STAT_, c, x)
+
 /*
  * NLS -- the library has to be independent on main program, so define
  * UL_TEXTDOMAIN_EXPLICIT before you include nls.h.
@@ -377,6 +398,45 @@ struct fdisk_ask {
 	} data;
 };
 
+/*
+ * The topology as returned by libblkid for the last device, see
+ * fdisk_discover_topology(). The values are reused if the same device is
+ * assigned again within FDISK_TOPOLOGY_MAXAGE seconds.
+ */
+#define FDISK_TOPOLOGY_MAXAGE	2
+
+struct fdisk_topology_cache {
+	dev_t		devno;
+	time_t		stamp;			/* CLOCK_MONOTONIC */
+	unsigned long	optimal_io_size;
+	unsigned long	min_io_size;
+	unsigned long	phy_sector_size;
+	unsigned long	alignment_offset;
+};
+
+/*
+ * Alignment values derived from the topology and grain, used by
+ * fdisk_align_lba() and friends. The descriptor is recalculated by
+ * fdisk_reset_alignment() or when any of the source values is changed.
+ */
+struct fdisk_alignment {
+	/* source values */
+	unsigned long	grain;
+	unsigned long	sector_size;
+	unsigned long	phy_sector_size;
+	unsigned long	min_io_size;
+	unsigned long	alignment_offset;
+
+	unsigned long	phy_granularity;	/* max(phy_sector_size, min_io_size) */
+	unsigned long	granularity;		/* max(phy_granularity, grain) */
+	fdisk_sector_t	grain_sectors;		/* grain in sectors */
+	fdisk_sector_t	offset_sectors;		/* alignment_offset in sectors */
+	fdisk_sector_t	compensation;		/* phy_granularity - alignment_offset in sectors */
+
+	unsigned int	valid : 1,
+			pow2 : 1;		/* power of 2 granularities, no offset */
+};
+
 struct fdisk_context {
 	int dev_fd;         /* device descriptor */
 	char *dev_path;     /* device path */
@@ -388,6 +448,14 @@ struct fdisk_context {
 	unsigned char *firstsector; /* buffer with master boot record */
 	unsigned long firstsector_bufsz;
 
+	unsigned char *spare_sector;	/* the last firstsector, reused for the next device */
+	unsigned long spare_sector_bufsz;
+
+	struct fdisk_topology_cache topology;
+#ifdef HAVE_LIBBLKID
+	blkid_probe topology_pr;	/* reused for all assigned devices */
+#endif
+
 
 	/* topology */
 	unsigned long io_size;		/* I/O size used by fdisk */
@@ -417,6 +485,7 @@ struct fdisk_context {
 	unsigned long grain;		/* alignment unit */
 	fdisk_sector_t first_lba;		/* recommended begin of the first partition */
 	fdisk_sector_t last_lba;		/* recommended end of last partition */
+	struct fdisk_alignment align;	/* see get_alignment() */
 
 	/* geometry */
 	fdisk_sector_t total_sectors;	/* in logical sectors */
@@ -522,6 +591,9 @@ int fdisk_info_new_partition(
 			int num, fdisk_sector_t start, fdisk_sector_t stop,
 			struct fdisk_parttype *t);
 
+/* partition.c */
+extern struct fdisk_partition *__fdisk_copy_partition(struct fdisk_partition *o);
+
 /* dos.c */
 extern struct dos_partition *fdisk_dos_get_partition(
 				struct fdisk_context *cxt,
@@ -14,6 +14,7 @@
 #include <sys/stat.h>
 #include <sys/utsname.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -186,7 +187,8 @@ struct fdisk_gpt_label {
 	unsigned char *ents;			/* entries (partitions) */
 
 	unsigned int no_relocate :1,		/* do not fix backup location */
-		     minimize :1;
+		     minimize :1,
+		     verify :1;			/* read back after write */
 };
 
 static void gpt_deinit(struct fdisk_label *lb);
@@ -954,7 +956,7 @@ static int valid_pmbr(struct fdisk_context *cxt)
 					   "will be corrected by write."),
 					sz_lba, cxt->total_sectors - (uint64_t) 1);
 
-			/* Note that gpt_write_pmbr() overwrites PMBR, but we want to keep it valid already
+			/* Note that gpt_update_pmbr() overwrites PMBR, but we want to keep it valid already
 			 * in memory too to disable warnings when valid_pmbr() called next time */
 			pmbr->partition_record[part].size_in_lba  =
 				cpu_to_le32((uint32_t) min( cxt->total_sectors - 1ULL, 0xFFFFFFFFULL) );
@@ -995,10 +997,15 @@ static ssize_t read_lba(struct fdisk_context *cxt, uint64_t lba,
 			void *buffer, const size_t bytes)
 {
 	off_t offset = lba * cxt->sector_size;
+	ssize_t r;
 
 	if (lseek(cxt->dev_fd, offset, SEEK_SET) == (off_t) -1)
 		return -1;
-	return (size_t)read(cxt->dev_fd, buffer, bytes) != bytes;
+	r = read(cxt->dev_fd, buffer, bytes);
+	STAT_ADD(READS, 1);
+	if (r > 0)
+		STAT_ADD(READ_BYTES, r);
+	return (size_t) r != bytes;
 }
 
 
@@ -1034,6 +1041,9 @@ static unsigned char *gpt_read_entries(struct fdisk_context *cxt,
 		goto fail;
 
 	ssz = read(cxt->dev_fd, ret, sz);
+	STAT_ADD(READS, 1);
+	if (ssz > 0)
+		STAT_ADD(READ_BYTES, ssz);
 	if (ssz < 0 || (size_t) ssz != sz)
 		goto fail;
 
@@ -1406,224 +1416,280 @@ static uint32_t check_start_after_end_partitions(struct fdisk_gpt_label *gpt)
 }
 
 /*
- * Check if partition e1 overlaps with partition e2.
+ * Used partitions sorted by start, built by gpt_init_extents() for one
+ * operation (the table must not be modified while the map is used).
  */
-static inline int partition_overlap(struct gpt_entry *e1, struct gpt_entry *e2)
+struct gpt_extent {
+	uint64_t	start;
+	uint64_t	end;
+	size_t		partno;
+};
+
+struct gpt_extents {
+	struct gpt_extent *parts;	/* all used partitions */
+	size_t		nparts;
+	struct gpt_extent *areas;	/* merged partitions; disjoint, sorted */
+	size_t		nareas;
+	uint64_t	first_usable;
+	uint64_t	last_usable;
+};
+
+static int cmp_extents(const void *a, const void *b)
 {
-	uint64_t start1 = gpt_partition_start(e1);
-	uint64_t end1   = gpt_partition_end(e1);
-	uint64_t start2 = gpt_partition_start(e2);
-	uint64_t end2   = gpt_partition_end(e2);
+	const struct gpt_extent *x = a, *y = b;
 
-	return (start1 && start2 && (start1 <= end2) != (end1 < start2));
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+	return x->partno < y->partno ? -1 : x->partno > y->partno ? 1 : 0;
 }
 
-/*
- * Find any partitions that overlap.
- */
-static uint32_t check_overlap_partitions(struct fdisk_gpt_label *gpt)
+static void gpt_free_extents(struct gpt_extents *ex)
 {
-	size_t i, j;
+	free(ex->parts);
+	free(ex->areas);
+	memset(ex, 0, sizeof(*ex));
+}
+
+static int gpt_init_extents(struct fdisk_gpt_label *gpt, struct gpt_extents *ex)
+{
+	size_t i, n = gpt_get_nentries(gpt);
 
 	assert(gpt);
 	assert(gpt->pheader);
 	assert(gpt->ents);
 
-	for (i = 0; i < gpt_get_nentries(gpt); i++)
-		for (j = 0; j < i; j++) {
-			struct gpt_entry *ei = gpt_get_entry(gpt, i);
-			struct gpt_entry *ej = gpt_get_entry(gpt, j);
+	memset(ex, 0, sizeof(*ex));
+	ex->first_usable = le64_to_cpu(gpt->pheader->first_usable_lba);
+	ex->last_usable = le64_to_cpu(gpt->pheader->last_usable_lba);
 
-			if (!gpt_entry_is_used(ei) || !gpt_entry_is_used(ej))
-				continue;
-			if (partition_overlap(ei, ej)) {
-				DBG(GPT, ul_debug("partitions overlap detected [%zu vs. %zu]", i, j));
-				return i + 1;
-			}
-		}
+	if (!n)
+		return 0;
+	ex->parts = malloc(n * sizeof(struct gpt_extent));
+	ex->areas = malloc(n * sizeof(struct gpt_extent));
+	if (!ex->parts || !ex->areas) {
+		gpt_free_extents(ex);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct gpt_entry *e = gpt_get_entry(gpt, i);
 
+		if (!gpt_entry_is_used(e))
+			continue;
+		ex->parts[ex->nparts++] = (struct gpt_extent) {
+			.start = gpt_partition_start(e),
+			.end = gpt_partition_end(e),
+			.partno = i };
+	}
+	qsort(ex->parts, ex->nparts, sizeof(struct gpt_extent), cmp_extents);
+
+	/* merge overlapping and adjacent partitions */
+	for (i = 0; i < ex->nparts; i++) {
+		struct gpt_extent *p = &ex->parts[i];
+		struct gpt_extent *last = ex->nareas ? &ex->areas[ex->nareas - 1] : NULL;
+
+		if (last && p->start <= last->end + 1ULL) {
+			if (p->end > last->end)
+				last->end = p->end;
+		} else
+			ex->areas[ex->nareas++] = *p;
+	}
+
+	DBG(GPT, ul_debug("extents: %zu partitions, %zu areas", ex->nparts, ex->nareas));
 	return 0;
 }
 
+/* Returns the last area which starts before or at @lba (or NULL) */
+static struct gpt_extent *extents_area_before(struct gpt_extents *ex, uint64_t lba)
+{
+	size_t lo = 0, hi = ex->nareas;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (ex->areas[mid].start <= lba)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo ? &ex->areas[lo - 1] : NULL;
+}
+
 /*
- * Find the first available block after the starting point; returns 0 if
- * there are no available blocks left, or error. From gdisk.
+ * Find the overlapping partitions, the partitions are sorted by start, so it
+ * is enough to compare each partition with the farthest end of the previous
+ * partitions. Returns the faulting partition number, otherwise 0.
  */
-static uint64_t find_first_available(struct fdisk_gpt_label *gpt, uint64_t start)
+static uint32_t check_overlap_partitions(struct fdisk_gpt_label *gpt)
 {
-	int first_moved = 0;
-	uint64_t first;
-	uint64_t fu, lu;
+	struct gpt_extents ex;
+	const struct gpt_extent *far = NULL;
+	size_t i, res = 0;
 
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	if (gpt_init_extents(gpt, &ex) != 0)
+		return 0;
 
-	fu = le64_to_cpu(gpt->pheader->first_usable_lba);
-	lu = le64_to_cpu(gpt->pheader->last_usable_lba);
+	for (i = 0; i < ex.nparts; i++) {
+		const struct gpt_extent *p = &ex.parts[i];
+
+		if (!p->start)
+			continue;
+		if (far && p->start <= far->end) {
+			size_t x = max(p->partno, far->partno);
+
+			DBG(GPT, ul_debug("partitions overlap detected [%zu vs. %zu]",
+						p->partno, far->partno));
+			if (!res || x + 1 < res)
+				res = x + 1;
+		}
+		if (!far || p->end > far->end)
+			far = p;
+	}
+
+	gpt_free_extents(&ex);
+	return res;
+}
+
+/*
+ * Find the first available block after the starting point; returns 0 if
+ * there are no available blocks left, or error.
+ */
+static uint64_t find_first_available(struct gpt_extents *ex, uint64_t start)
+{
+	struct gpt_extent *a;
+	uint64_t first;
 
 	/*
 	 * Begin from the specified starting point or from the first usable
 	 * LBA, whichever is greater...
 	 */
-	first = start < fu ? fu : start;
+	first = start < ex->first_usable ? ex->first_usable : start;
 
-	/*
-	 * Now search through all partitions; if first is within an
-	 * existing partition, move it to the next sector after that
-	 * partition and repeat. If first was moved, set firstMoved
-	 * flag; repeat until firstMoved is not set, so as to catch
-	 * cases where partitions are out of sequential order....
-	 */
-	do {
-		size_t i;
+	/* the areas are merged, the sector behind the area is free */
+	a = extents_area_before(ex, first);
+	if (a && first <= a->end)
+		first = a->end + 1ULL;
 
-		first_moved = 0;
-		for (i = 0; i < gpt_get_nentries(gpt); i++) {
-			struct gpt_entry *e = gpt_get_entry(gpt, i);
-
-			if (!gpt_entry_is_used(e))
-				continue;
-			if (first < gpt_partition_start(e))
-				continue;
-			if (first <= gpt_partition_end(e)) {
-				first = gpt_partition_end(e) + 1;
-				first_moved = 1;
-			}
-		}
-	} while (first_moved == 1);
-
-	if (first > lu)
+	if (first > ex->last_usable)
 		first = 0;
 
 	return first;
 }
 
-
-/* Returns last available sector in the free space pointed to by start. From gdisk. */
-static uint64_t find_last_free(struct fdisk_gpt_label *gpt, uint64_t start)
+/* Returns last available sector in the free space pointed to by start. */
+static uint64_t find_last_free(struct gpt_extents *ex, uint64_t start)
 {
-	size_t i;
-	uint64_t nearest_start;
-
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	size_t lo = 0, hi = ex->nparts;
 
-	nearest_start = le64_to_cpu(gpt->pheader->last_usable_lba);
+	/* the first partition which starts behind @start */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
 
-	for (i = 0; i < gpt_get_nentries(gpt); i++) {
-		struct gpt_entry *e = gpt_get_entry(gpt, i);
-		uint64_t ps = gpt_partition_start(e);
-
-		if (nearest_start > ps && ps > start)
-			nearest_start = ps - 1ULL;
+		if (ex->parts[mid].start <= start)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	if (lo < ex->nparts && ex->parts[lo].start <= ex->last_usable)
+		return ex->parts[lo].start - 1ULL;
 
-	return nearest_start;
+	return ex->last_usable;
 }
 
-/* Returns the last free sector on the disk. From gdisk. */
-static uint64_t find_last_free_sector(struct fdisk_gpt_label *gpt)
+/* Returns the last free sector on the disk. */
+static uint64_t find_last_free_sector(struct gpt_extents *ex)
 {
-	int last_moved;
-	uint64_t last = 0;
-
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	uint64_t last = ex->last_usable;
+	struct gpt_extent *a = extents_area_before(ex, last);
 
 	/* start by assuming the last usable LBA is available */
-	last = le64_to_cpu(gpt->pheader->last_usable_lba);
-	do {
-		size_t i;
-
-		last_moved = 0;
-		for (i = 0; i < gpt_get_nentries(gpt); i++) {
-			struct gpt_entry *e = gpt_get_entry(gpt, i);
-
-			if (last >= gpt_partition_start(e) &&
-			    last <= gpt_partition_end(e)) {
-				last = gpt_partition_start(e) - 1ULL;
-				last_moved = 1;
-			}
-		}
-	} while (last_moved == 1);
+	if (a && last <= a->end)
+		last = a->start - 1ULL;
 
 	return last;
 }
 
 /*
- * Finds the first available sector in the largest block of unallocated
- * space on the disk. Returns 0 if there are no available blocks left.
- * From gdisk.
+ * Find the total number of free sectors, the number of segments in which
+ * they reside, the size of the largest of those segments and the first
+ * sector of the largest segment.
  */
-static uint64_t find_first_in_largest(struct fdisk_gpt_label *gpt)
+static uint64_t count_free_sectors(struct gpt_extents *ex,
+				   uint32_t *nsegments,
+				   uint64_t *largest_segment,
+				   uint64_t *largest_start)
 {
-	uint64_t start = 0, first_sect, last_sect;
-	uint64_t segment_size, selected_size = 0, selected_segment = 0;
+	uint32_t num = 0;
+	uint64_t largest_seg = 0, largest_first = 0, totfound = 0;
+	uint64_t first = ex->first_usable;
+	size_t i = 0;
 
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	/* gaps between the merged areas within the usable range */
+	while (first && first <= ex->last_usable) {
+		uint64_t last = ex->last_usable, sz;
 
-	do {
-		first_sect = find_first_available(gpt, start);
-		if (first_sect != 0) {
-			last_sect = find_last_free(gpt, first_sect);
-			segment_size = last_sect - first_sect + 1ULL;
+		for (; i < ex->nareas && ex->areas[i].end < first; i++);
+		if (i < ex->nareas && ex->areas[i].start <= first) {
+			first = ex->areas[i].end + 1ULL;	/* used */
+			continue;
+		}
+		if (i < ex->nareas && ex->areas[i].start <= last)
+			last = ex->areas[i].start - 1ULL;
 
-			if (segment_size > selected_size) {
-				selected_size = segment_size;
-				selected_segment = first_sect;
-			}
-			start = last_sect + 1ULL;
+		sz = last - first + 1ULL;
+		if (sz > largest_seg) {
+			largest_seg = sz;
+			largest_first = first;
 		}
-	} while (first_sect != 0);
+		totfound += sz;
+		num++;
+		first = last + 1ULL;
+	}
 
-	return selected_segment;
+	if (nsegments)
+		*nsegments = num;
+	if (largest_segment)
+		*largest_segment = largest_seg;
+	if (largest_start)
+		*largest_start = largest_first;
+
+	return totfound;
+}
+
+/*
+ * Finds the first available sector in the largest block of unallocated
+ * space on the disk. Returns 0 if there are no available blocks left.
+ */
+static uint64_t find_first_in_largest(struct gpt_extents *ex)
+{
+	uint64_t first = 0;
+
+	count_free_sectors(ex, NULL, NULL, &first);
+	return first;
 }
 
 /*
  * Find the total number of free sectors, the number of segments in which
- * they reside, and the size of the largest of those segments. From gdisk.
+ * they reside, and the size of the largest of those segments.
  */
 static uint64_t get_free_sectors(struct fdisk_context *cxt,
 				 struct fdisk_gpt_label *gpt,
 				 uint32_t *nsegments,
 				 uint64_t *largest_segment)
 {
-	uint32_t num = 0;
-	uint64_t first_sect, last_sect;
-	uint64_t largest_seg = 0, segment_sz;
-	uint64_t totfound = 0, start = 0; /* starting point for each search */
-
-	if (!cxt->total_sectors)
-		goto done;
+	struct gpt_extents ex;
+	uint64_t totfound = 0;
 
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
-
-	do {
-		first_sect = find_first_available(gpt, start);
-		if (first_sect) {
-			last_sect = find_last_free(gpt, first_sect);
-			segment_sz = last_sect - first_sect + 1;
-
-			if (segment_sz > largest_seg)
-				largest_seg = segment_sz;
-			totfound += segment_sz;
-			num++;
-			start = last_sect + 1ULL;
-		}
-	} while (first_sect);
-
-done:
 	if (nsegments)
-		*nsegments = num;
+		*nsegments = 0;
 	if (largest_segment)
-		*largest_segment = largest_seg;
+		*largest_segment = 0;
+
+	if (!cxt->total_sectors || gpt_init_extents(gpt, &ex) != 0)
+		return 0;
+
+	totfound = count_free_sectors(&ex, nsegments, largest_segment, NULL);
+	gpt_free_extents(&ex);
 
 	return totfound;
 }
@@ -2015,59 +2081,156 @@ static int gpt_set_partition(struct fdisk_context *cxt, size_t n,
 	return rc;
 }
 
-static int gpt_write(struct fdisk_context *cxt, off_t offset, void *buf, size_t count)
+/* on-disk area written by one call, see gpt_write_copy() */
+struct gpt_area {
+	uint64_t	offset;		/* in bytes */
+	void		*buf;
+	size_t		size;
+};
+
+static int cmp_areas(const void *a, const void *b)
 {
-	if (offset != lseek(cxt->dev_fd, offset, SEEK_SET))
-		return -errno;
+	const struct gpt_area *x = a, *y = b;
 
-	if (write_all(cxt->dev_fd, buf, count))
-		return -errno;
+	return x->offset < y->offset ? -1 : x->offset > y->offset ? 1 : 0;
+}
 
-	fsync(cxt->dev_fd);
+/* write @iovcnt buffers by pwritev(), restart on short write */
+static int gpt_write_iov(struct fdisk_context *cxt, off_t offset,
+			 struct iovec *iov, int iovcnt)
+{
+	while (iovcnt > 0) {
+		ssize_t n = pwritev(cxt->dev_fd, iov, iovcnt, offset);
 
-	DBG(GPT, ul_debug("  write OK [offset=%zu, size=%zu]",
-				(size_t) offset, count));
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -errno;
+		}
+		if (n == 0)
+			return -EIO;
+
+		DBG(GPT, ul_debug("  write OK [offset=%zu, size=%zd, buffers=%d]",
+					(size_t) offset, n, iovcnt));
+		offset += n;
+		while (n > 0 && iovcnt > 0) {
+			if ((size_t) n >= iov->iov_len) {
+				n -= iov->iov_len;
+				iov++;
+				iovcnt--;
+			} else {
+				iov->iov_base = (char *) iov->iov_base + n;
+				iov->iov_len -= n;
+				n = 0;
+			}
+		}
+	}
 	return 0;
 }
 
 /*
- * Write partitions.
+ * Write one copy of the GPT (header and entries, and the protective MBR
+ * for the primary copy). The adjacent areas are written by one vectored
+ * write; the device is synced after the whole copy only.
+ *
  * Returns 0 on success, or corresponding error otherwise.
  */
-static int gpt_write_partitions(struct fdisk_context *cxt,
-				struct gpt_header *header, unsigned char *ents)
+static int gpt_write_copy(struct fdisk_context *cxt, struct gpt_header *header,
+			  uint64_t lba, unsigned char *ents, void *pmbr)
 {
-	size_t esz = 0;
+	struct gpt_area areas[3];
+	struct iovec iov[3];
+	size_t esz = 0, nareas = 0, i, n;
 	int rc;
 
 	rc = gpt_sizeof_entries(header, &esz);
 	if (rc)
 		return rc;
 
-	return gpt_write(cxt,
-			(off_t) le64_to_cpu(header->partition_entry_lba) * cxt->sector_size,
-			ents, esz);
+	/* We read all sector, so we have to write all sector back
+	 * to the device -- never ever rely on sizeof(struct gpt_header)! */
+	areas[nareas++] = (struct gpt_area) {
+		.offset = lba * cxt->sector_size,
+		.buf = header, .size = cxt->sector_size };
+	areas[nareas++] = (struct gpt_area) {
+		.offset = le64_to_cpu(header->partition_entry_lba) * cxt->sector_size,
+		.buf = ents, .size = esz };
+	if (pmbr)
+		areas[nareas++] = (struct gpt_area) {
+			.offset = GPT_PMBR_LBA * cxt->sector_size,
+			.buf = pmbr, .size = cxt->sector_size };
+
+	qsort(areas, nareas, sizeof(struct gpt_area), cmp_areas);
+
+	for (i = 0; i < nareas; i += n) {
+		uint64_t end = areas[i].offset;
+
+		for (n = 0; i + n < nareas && areas[i + n].offset == end; n++) {
+			iov[n].iov_base = areas[i + n].buf;
+			iov[n].iov_len = areas[i + n].size;
+			end += areas[i + n].size;
+		}
+		rc = gpt_write_iov(cxt, (off_t) areas[i].offset, iov, (int) n);
+		if (rc)
+			return rc;
+	}
+
+	if (fsync(cxt->dev_fd) != 0)
+		return -errno;
+	return 0;
 }
 
 /*
- * Write a GPT header to a specified LBA.
- *
- * We read all sector, so we have to write all sector back
- * to the device -- never ever rely on sizeof(struct gpt_header)!
+ * Read the copy back by one read() and compare it with the in-memory data.
+ * The cached pages are dropped to read the data from the device.
  *
- * Returns 0 on success, or corresponding error otherwise.
+ * Returns 0 on success, -EIO if the data differ.
  */
-static int gpt_write_header(struct fdisk_context *cxt,
-			    struct gpt_header *header, uint64_t lba)
+static int gpt_verify_copy(struct fdisk_context *cxt, struct gpt_header *header,
+			   uint64_t lba, unsigned char *ents, void *pmbr)
 {
-	return gpt_write(cxt, lba * cxt->sector_size, header, cxt->sector_size);
+	uint64_t hdr = lba * cxt->sector_size,
+		 ent = le64_to_cpu(header->partition_entry_lba) * cxt->sector_size,
+		 begin, end;
+	size_t esz = 0;
+	unsigned char *buf;
+	ssize_t sz;
+	int rc = 0;
+
+	if (gpt_sizeof_entries(header, &esz))
+		return -EINVAL;
+
+	begin = pmbr ? GPT_PMBR_LBA * cxt->sector_size : min(hdr, ent);
+	end = max(hdr + cxt->sector_size, ent + esz);
+	if (end - begin > 16 * 1024 * 1024)	/* far away entries */
+		return -EINVAL;
+
+	buf = malloc(end - begin);
+	if (!buf)
+		return -ENOMEM;
+
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+	ignore_result( posix_fadvise(cxt->dev_fd, (off_t) begin,
+				(off_t) (end - begin), POSIX_FADV_DONTNEED) );
+#endif
+	sz = pread(cxt->dev_fd, buf, end - begin, (off_t) begin);
+	if (sz < 0 || (uint64_t) sz != end - begin)
+		rc = sz < 0 ? -errno : -EIO;
+	else if (memcmp(buf + (hdr - begin), header, cxt->sector_size) != 0
+		 || memcmp(buf + (ent - begin), ents, esz) != 0
+		 || (pmbr && memcmp(buf, pmbr, cxt->sector_size) != 0))
+		rc = -EIO;
+
+	DBG(GPT, ul_debug("  verify [offset=%ju, size=%ju]: rc=%d",
+				begin, end - begin, rc));
+	free(buf);
+	return rc;
 }
 
 /*
- * Write the protective MBR.
- * Returns 0 on success, or corresponding error otherwise.
+ * Update the protective MBR in the first sector buffer.
  */
-static int gpt_write_pmbr(struct fdisk_context *cxt)
+static void gpt_update_pmbr(struct fdisk_context *cxt)
 {
 	struct gpt_legacy_mbr *pmbr;
 
@@ -2097,10 +2260,6 @@ static int gpt_write_pmbr(struct fdisk_context *cxt)
 	else
 		pmbr->partition_record[0].size_in_lba =
 			cpu_to_le32((uint32_t) (cxt->total_sectors - 1ULL));
-
-	/* pMBR covers the first sector (LBA) of the disk */
-	return gpt_write(cxt, GPT_PMBR_LBA * cxt->sector_size,
-			 pmbr, cxt->sector_size);
 }
 
 /*
@@ -2111,7 +2270,9 @@ static int gpt_write_pmbr(struct fdisk_context *cxt)
 static int gpt_write_disklabel(struct fdisk_context *cxt)
 {
 	struct fdisk_gpt_label *gpt;
-	int mbr_type;
+	void *pmbr = NULL;
+	uint64_t altlba;
+	int mbr_type, rc;
 
 	assert(cxt);
 	assert(cxt->label);
@@ -2140,6 +2301,15 @@ static int gpt_write_disklabel(struct fdisk_context *cxt)
 	gpt_recompute_crc(gpt->pheader, gpt->ents);
 	gpt_recompute_crc(gpt->bheader, gpt->ents);
 
+	altlba = le64_to_cpu(gpt->pheader->alternative_lba);
+
+	if (mbr_type == GPT_MBR_HYBRID)
+		fdisk_warnx(cxt, _("The device contains hybrid MBR -- writing GPT only."));
+	else {
+		gpt_update_pmbr(cxt);
+		pmbr = cxt->firstsector;
+	}
+
 	/*
 	 * UEFI requires writing in this specific order:
 	 *   1) backup partition tables
@@ -2148,22 +2318,27 @@ static int gpt_write_disklabel(struct fdisk_context *cxt)
 	 *   4) primary GPT header
 	 *   5) protective MBR
 	 *
-	 * If any write fails, we abort the rest.
+	 * The backup copy is synced before the primary copy is written, so
+	 * there is always at least one valid copy on the disk. If any write
+	 * fails, we abort the rest.
 	 */
-	if (gpt_write_partitions(cxt, gpt->bheader, gpt->ents) != 0)
-		goto err1;
-	if (gpt_write_header(cxt, gpt->bheader,
-			     le64_to_cpu(gpt->pheader->alternative_lba)) != 0)
-		goto err1;
-	if (gpt_write_partitions(cxt, gpt->pheader, gpt->ents) != 0)
-		goto err1;
-	if (gpt_write_header(cxt, gpt->pheader, GPT_PRIMARY_PARTITION_TABLE_LBA) != 0)
+	rc = gpt_write_copy(cxt, gpt->bheader, altlba, gpt->ents, NULL);
+	if (!rc)
+		rc = gpt_write_copy(cxt, gpt->pheader,
+				GPT_PRIMARY_PARTITION_TABLE_LBA, gpt->ents, pmbr);
+	if (rc)
 		goto err1;
 
-	if (mbr_type == GPT_MBR_HYBRID)
-		fdisk_warnx(cxt, _("The device contains hybrid MBR -- writing GPT only."));
-	else if (gpt_write_pmbr(cxt) != 0)
-		goto err1;
+	if (gpt->verify) {
+		rc = gpt_verify_copy(cxt, gpt->bheader, altlba, gpt->ents, NULL);
+		if (!rc)
+			rc = gpt_verify_copy(cxt, gpt->pheader,
+				GPT_PRIMARY_PARTITION_TABLE_LBA, gpt->ents, pmbr);
+		if (rc) {
+			fdisk_warnx(cxt, _("Failed to verify the written partition table."));
+			goto err1;
+		}
+	}
 
 	DBG(GPT, ul_debug("...write success"));
 	return 0;
@@ -2172,8 +2347,9 @@ err0:
 	errno = EINVAL;
 	return -EINVAL;
 err1:
-	DBG(GPT, ul_debug("...write failed: %m"));
-	return -errno;
+	DBG(GPT, ul_debug("...write failed [rc=%d]", rc));
+	errno = -rc;
+	return rc;
 }
 
 /*
@@ -2343,6 +2519,7 @@ static int gpt_add_partition(
 	struct gpt_header *pheader;
 	struct gpt_entry *e;
 	struct fdisk_ask *ask = NULL;
+	struct gpt_extents ex = { .parts = NULL };
 	size_t partnum;
 	int rc;
 
@@ -2375,18 +2552,24 @@ static int gpt_add_partition(
 		fdisk_warnx(cxt, _("All partitions are already in use."));
 		return -ENOSPC;
 	}
-	if (!get_free_sectors(cxt, gpt, NULL, NULL)) {
-		fdisk_warnx(cxt, _("No free sectors available."));
-		return -ENOSPC;
-	}
-
 	rc = string_to_guid(pa && pa->type && pa->type->typestr ?
 				pa->type->typestr:
 				GPT_DEFAULT_ENTRY_TYPE, &typeid);
 	if (rc)
 		return rc;
 
-	disk_f = find_first_available(gpt, le64_to_cpu(pheader->first_usable_lba));
+	/* the table is not modified until the new entry is set */
+	rc = gpt_init_extents(gpt, &ex);
+	if (rc)
+		return rc;
+
+	if (!cxt->total_sectors || !count_free_sectors(&ex, NULL, NULL, NULL)) {
+		fdisk_warnx(cxt, _("No free sectors available."));
+		rc = -ENOSPC;
+		goto done;
+	}
+
+	disk_f = find_first_available(&ex, le64_to_cpu(pheader->first_usable_lba));
 	e = gpt_get_entry(gpt, 0);
 
 	/* if first sector no explicitly defined then ignore small gaps before
@@ -2398,10 +2581,10 @@ static int gpt_add_partition(
 		do {
 			uint64_t x;
 			DBG(GPT, ul_debug("testing first sector %"PRIu64"", disk_f));
-			disk_f = find_first_available(gpt, disk_f);
+			disk_f = find_first_available(&ex, disk_f);
 			if (!disk_f)
 				break;
-			x = find_last_free(gpt, disk_f);
+			x = find_last_free(&ex, disk_f);
 			if (x - disk_f >= cxt->grain / cxt->sector_size)
 				break;
 			DBG(GPT, ul_debug("first sector %"PRIu64" addresses to small space, continue...", disk_f));
@@ -2409,15 +2592,15 @@ static int gpt_add_partition(
 		} while(1);
 
 		if (disk_f == 0)
-			disk_f = find_first_available(gpt, le64_to_cpu(pheader->first_usable_lba));
+			disk_f = find_first_available(&ex, le64_to_cpu(pheader->first_usable_lba));
 	}
 
 	e = NULL;
-	disk_l = find_last_free_sector(gpt);
+	disk_l = find_last_free_sector(&ex);
 
 	/* the default is the largest free space */
-	dflt_f = find_first_in_largest(gpt);
-	dflt_l = find_last_free(gpt, dflt_f);
+	dflt_f = find_first_in_largest(&ex);
+	dflt_l = find_last_free(&ex, dflt_f);
 
 	/* align the default in range <dflt_f,dflt_l>*/
 	dflt_f = fdisk_align_lba_in_range(cxt, dflt_f, dflt_f, dflt_l);
@@ -2428,9 +2611,10 @@ static int gpt_add_partition(
 
 	} else if (pa && fdisk_partition_has_start(pa)) {
 		DBG(GPT, ul_debug("first sector defined: %ju",  (uintmax_t)pa->start));
-		if (pa->start != find_first_available(gpt, pa->start)) {
+		if (pa->start != find_first_available(&ex, pa->start)) {
 			fdisk_warnx(cxt, _("Sector %ju already used."),  (uintmax_t)pa->start);
-			return -ERANGE;
+			rc = -ERANGE;
+			goto done;
 		}
 		user_f = pa->start;
 	} else {
@@ -2440,8 +2624,10 @@ static int gpt_add_partition(
 				ask = fdisk_new_ask();
 			else
 				fdisk_reset_ask(ask);
-			if (!ask)
-				return -ENOMEM;
+			if (!ask) {
+				rc = -ENOMEM;
+				goto done;
+			}
 
 			/* First sector */
 			fdisk_ask_set_query(ask, _("First sector"));
@@ -2455,7 +2641,7 @@ static int gpt_add_partition(
 				goto done;
 
 			user_f = fdisk_ask_number_get_result(ask);
-			if (user_f != find_first_available(gpt, user_f)) {
+			if (user_f != find_first_available(&ex, user_f)) {
 				fdisk_warnx(cxt, _("Sector %ju already used."), user_f);
 				continue;
 			}
@@ -2465,7 +2651,7 @@ static int gpt_add_partition(
 
 
 	/* Last sector */
-	dflt_l = find_last_free(gpt, user_f);
+	dflt_l = find_last_free(&ex, user_f);
 
 	if (pa && pa->end_follow_default) {
 		user_l = dflt_l;
@@ -2490,8 +2676,10 @@ static int gpt_add_partition(
 				ask = fdisk_new_ask();
 			else
 				fdisk_reset_ask(ask);
-			if (!ask)
-				return -ENOMEM;
+			if (!ask) {
+				rc = -ENOMEM;
+				goto done;
+			}
 
 			fdisk_ask_set_query(ask, _("Last sector, +/-sectors or +/-size{K,M,G,T,P}"));
 			fdisk_ask_set_type(ask, FDISK_ASKTYPE_OFFSET);
@@ -2601,6 +2789,7 @@ static int gpt_add_partition(
 	if (partno)
 		*partno = partnum;
 done:
+	gpt_free_extents(&ex);
 	fdisk_unref_ask(ask);
 	return rc;
 }
@@ -3266,6 +3455,25 @@ void fdisk_gpt_enable_minimize(struct fdisk_label *lb, int enable)
 	gpt->minimize = enable ? 1 : 0;
 }
 
+/**
+ * fdisk_gpt_enable_verify
+ * @lb: label
+ * @enable: 0 or 1
+ *
+ * Force libfdisk to read back both GPT copies after fdisk_write_disklabel()
+ * and compare them with the written data. Each copy is read by one read()
+ * call.
+ *
+ * Since: ext-1
+ */
+void fdisk_gpt_enable_verify(struct fdisk_label *lb, int enable)
+{
+	struct fdisk_gpt_label *gpt = (struct fdisk_gpt_label *) lb;
+
+	assert(gpt);
+	gpt->verify = enable ? 1 : 0;
+}
+
 #ifdef TEST_PROGRAM
 static int test_getattr(struct fdisk_test *ts, int argc, char *argv[])
 {
@@ -5,7 +5,7 @@
 /**
  * SECTION: init
  * @title: Library initialization
- * @short_description: initialize debug stuff
+ * @short_description: initialize debug stuff and statistics
  *
  */
 
@@ -27,6 +27,23 @@ UL_DEBUG_DEFINE_MASKNAMES(libfdisk) =
 	{ NULL, 0 }
 };
 
+UL_DEBUG_DEFINE_STATS(libfdisk, __FDISK_STAT_COUNT);
+UL_DEBUG_DEFINE_STATNAMES(libfdisk) =
+{
+	[FDISK_STAT_CONTEXT_ALLOC]  = { "context-alloc",	"allocated contexts" },
+	[FDISK_STAT_LABEL_PROBES]   = { "label-probes",	"called label probing functions" },
+	[FDISK_STAT_LABEL_PROBE_NS] = { "label-probe-ns",	"nanoseconds spent in label probing" },
+	[FDISK_STAT_READS]	    = { "reads",		"read(2) calls" },
+	[FDISK_STAT_READ_BYTES]	    = { "read-bytes",		"bytes read from devices" },
+	[FDISK_STAT_LABEL_WRITES]   = { "label-writes",	"written disk labels" },
+};
+
+static void fdisk_print_stats(void)
+{
+	ul_debug_print_stats("libfdisk", UL_DEBUG_STATNAMES(libfdisk),
+			UL_DEBUG_STATS(libfdisk), __FDISK_STAT_COUNT);
+}
+
 /**
  * fdisk_init_debug:
  * @mask: debug mask (0xffff to enable full debugging)
@@ -38,6 +55,10 @@ UL_DEBUG_DEFINE_MASKNAMES(libfdisk) =
  * have effect to call this function twice.
  *
  * It's strongly recommended to use fdisk_init_debug(0) in your code.
+ *
+ * The function also reads the LIBFDISK_STATS environment variable; if set
+ * to a non-zero value, the statistics are enabled (see fdisk_enable_stats())
+ * and printed to stderr at exit.
  */
 void fdisk_init_debug(int mask)
 {
@@ -45,6 +66,7 @@ void fdisk_init_debug(int mask)
 		return;
 
 	__UL_INIT_DEBUG_FROM_ENV(libfdisk, LIBFDISK_DEBUG_, mask, LIBFDISK_DEBUG);
+	__UL_INIT_STATS_FROM_ENV(libfdisk, LIBFDISK_STATS, fdisk_print_stats);
 
 
 	if (libfdisk_debug_mask != LIBFDISK_DEBUG_INIT
@@ -60,3 +82,57 @@ void fdisk_init_debug(int mask)
 	ON_DBG(HELP, ul_debug_print_masks("LIBFDISK_DEBUG",
 				UL_DEBUG_MASKNAMES(libfdisk)));
 }
+
+/**
+ * fdisk_enable_stats:
+ * @enable: TRUE or FALSE
+ *
+ * Enables or disables the library statistics counters. The counters are
+ * global for all the contexts and all threads. The counters are not reset,
+ * see fdisk_reset_stats().
+ *
+ * Returns: 0 on success.
+ *
+ * Since: ext-1
+ */
+int fdisk_enable_stats(int enable)
+{
+	libfdisk_stats_enabled = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * fdisk_reset_stats:
+ *
+ * Sets all the statistics counters to zero.
+ *
+ * Since: ext-1
+ */
+void fdisk_reset_stats(void)
+{
+	size_t i;
+
+	for (i = 0; i < __FDISK_STAT_COUNT; i++)
+		__atomic_store_n(&libfdisk_stats[i], 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * fdisk_get_stat:
+ * @idx: counter number
+ * @name: returns name of the counter (or NULL)
+ * @value: returns value of the counter (or NULL)
+ *
+ * Returns the statistics counter, see fdisk_enable_stats(). The names are
+ * the same as printed for the LIBFDISK_STATS environment variable, the
+ * counters with "-ns" suffix are in nanoseconds.
+ *
+ * Returns: 0 on success, 1 if @idx is out of range.
+ *
+ * Since: ext-1
+ */
+int fdisk_get_stat(size_t idx, const char **name, unsigned long long *value)
+{
+	return ul_debug_get_stat(UL_DEBUG_STATNAMES(libfdisk),
+			UL_DEBUG_STATS(libfdisk), __FDISK_STAT_COUNT,
+			idx, name, value);
+}
@@ -46,7 +46,8 @@ int fdisk_probe_labels(struct fdisk_context *cxt)
 		DBG(CXT, ul_debugobj(cxt, "probing for %s", lb->name));
 
 		cxt->label = lb;
-		rc = lb->op->probe(cxt);
+		STAT_ADD(LABEL_PROBES, 1);
+		STAT_TIME(LABEL_PROBE_NS, rc = lb->op->probe(cxt));
 		cxt->label = org;
 
 		if (rc != 1) {
@@ -260,6 +261,7 @@ int fdisk_write_disklabel(struct fdisk_context *cxt)
 		return -ENOSYS;
 
 	fdisk_do_wipe(cxt);
+	STAT_ADD(LABEL_WRITES, 1);
 	return cxt->label->op->write(cxt);
 }
 
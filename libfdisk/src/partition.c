@@ -79,7 +79,7 @@ void fdisk_reset_partition(struct fdisk_partition *pa)
 	init_partition(pa);
 }
 
-static struct fdisk_partition *__copy_partition(struct fdisk_partition *o)
+struct fdisk_partition *__fdisk_copy_partition(struct fdisk_partition *o)
 {
 	struct fdisk_partition *n = fdisk_new_partition();
 	int rc;
@@ -1327,7 +1327,7 @@ int fdisk_set_partition(struct fdisk_context *cxt, size_t partno,
 	}
 
 	if (pa->resize || fdisk_partition_has_start(pa) || fdisk_partition_has_size(pa)) {
-		xpa = __copy_partition(pa);
+		xpa = __fdisk_copy_partition(pa);
 		if (!xpa) {
 			rc = -ENOMEM;
 			goto done;
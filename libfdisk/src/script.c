@@ -61,6 +61,8 @@ struct fdisk_script {
 	/* parser's state */
 	size_t			nlines;
 	struct fdisk_label	*label;
+	char			*typestr;	/* last parsed type string */
+	struct fdisk_parttype	*type;		/* ... and the (static) type */
 
 	unsigned int		json : 1,		/* JSON output */
 				force_label : 1;	/* label: <name> specified */
@@ -149,6 +151,93 @@ done:
 	return res;
 }
 
+/**
+ * fdisk_copy_script:
+ * @cxt: context
+ * @dp: script to copy
+ *
+ * Allocates a new script for the context @cxt with a copy of the headers and
+ * partitions from @dp. The new script does not share any data with @dp, so
+ * the copies may be applied to different devices in parallel.
+ *
+ * Note that sizes specified with a suffix (e.g. "size=1GiB") are converted
+ * to sectors when the script is read, so the sector size of @cxt should be
+ * the same as for the context used to read @dp.
+ *
+ * Returns: new script instance or NULL in case of error.
+ *
+ * Since: ext-1
+ */
+struct fdisk_script *fdisk_copy_script(struct fdisk_context *cxt,
+				       struct fdisk_script *dp)
+{
+	struct fdisk_script *res;
+	struct fdisk_partition *pa;
+	struct fdisk_iter itr;
+	struct list_head *p;
+	int rc = 0;
+
+	if (!cxt || !dp) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	DBG(SCRIPT, ul_debugobj(dp, "copy to context %p", cxt));
+
+	res = fdisk_new_script(cxt);
+	if (!res)
+		return NULL;
+
+	list_for_each(p, &dp->headers) {
+		struct fdisk_scriptheader *fi = list_entry(p, struct fdisk_scriptheader, headers);
+
+		rc = fdisk_script_set_header(res, fi->name, fi->data);
+		if (rc)
+			goto fail;
+	}
+	res->json = dp->json;
+	res->force_label = dp->force_label;
+
+	if (!dp->table)
+		return res;
+
+	res->table = fdisk_new_table();
+	if (!res->table) {
+		rc = -ENOMEM;
+		goto fail;
+	}
+
+	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
+	while (fdisk_table_next_partition(dp->table, &itr, &pa) == 0) {
+		struct fdisk_partition *n = __fdisk_copy_partition(pa);
+
+		if (!n) {
+			rc = -ENOMEM;
+			goto fail;
+		}
+		/* don't share reference counted types between the copies */
+		if (n->type && fdisk_parttype_is_allocated(n->type)) {
+			struct fdisk_parttype *t = fdisk_copy_parttype(n->type);
+
+			fdisk_unref_parttype(n->type);
+			n->type = t;
+			if (!t)
+				rc = -ENOMEM;
+		}
+		if (!rc)
+			rc = fdisk_table_add_partition(res->table, n);
+		fdisk_unref_partition(n);
+		if (rc)
+			goto fail;
+	}
+
+	return res;
+fail:
+	fdisk_unref_script(res);
+	errno = -rc;
+	return NULL;
+}
+
 /**
  * fdisk_ref_script:
  * @dp: script pointer
@@ -170,6 +259,10 @@ static void fdisk_reset_script(struct fdisk_script *dp)
 	if (dp->table)
 		fdisk_reset_table(dp->table);
 
+	free(dp->typestr);
+	dp->typestr = NULL;
+	dp->type = NULL;
+
 	while (!list_empty(&dp->headers)) {
 		struct fdisk_scriptheader *fi = list_entry(dp->headers.next,
 						  struct fdisk_scriptheader, headers);
@@ -331,8 +424,10 @@ int fdisk_script_set_header(struct fdisk_script *dp,
 		fi->data = x;
 	}
 
-	if (strcmp(name, "label") == 0)
+	if (strcmp(name, "label") == 0) {
 		dp->label = NULL;
+		dp->type = NULL;	/* types are label specific */
+	}
 
 	return 0;
 }
@@ -945,16 +1040,102 @@ static int partno_from_devname(char *s)
 	 FDISK_PARTTYPE_PARSE_NAME | \
 	 FDISK_PARTTYPE_PARSE_DEPRECATED)
 
+/*
+ * The generated scripts usually use the same type for many partitions, so
+ * remember the last result. Only the static types (from the label) are
+ * cached, the unknown types are allocated for each partition.
+ */
+static struct fdisk_parttype *script_parse_parttype(struct fdisk_script *dp,
+						    const char *str)
+{
+	struct fdisk_parttype *type;
+
+	if (dp->type && dp->typestr && strcmp(dp->typestr, str) == 0)
+		return dp->type;
+
+	type = fdisk_label_advparse_parttype(script_get_label(dp),
+				str, FDISK_SCRIPT_PARTTYPE_PARSE_FLAGS);
+
+	if (type && !fdisk_parttype_is_allocated(type)) {
+		char *x = strdup(str);
+
+		if (x) {
+			free(dp->typestr);
+			dp->typestr = x;
+			dp->type = type;
+		}
+	}
+	return type;
+}
+
+/* reads <num>[<suffix>] and converts the sizes with a suffix to sectors */
+static int next_sectors(struct fdisk_script *dp, char **s, uint64_t *num, int *power)
+{
+	int rc = next_number(s, num, power);
+
+	if (rc == 0 && *power) {	/* specified as <num><suffix> */
+		if (!dp->cxt->sector_size)
+			return -EINVAL;
+		*num /= dp->cxt->sector_size;
+	}
+	return rc;
+}
+
+enum {
+	SCRIPT_KEY_START,
+	SCRIPT_KEY_SIZE,
+	SCRIPT_KEY_BOOTABLE,
+	SCRIPT_KEY_ATTRS,
+	SCRIPT_KEY_UUID,
+	SCRIPT_KEY_NAME,
+	SCRIPT_KEY_TYPE
+};
+
+struct script_key {
+	const char	*name;
+	size_t		namesz;
+	int		id;
+};
+
+static const struct script_key script_keys[] = {
+	{ "start=",	6, SCRIPT_KEY_START },
+	{ "size=",	5, SCRIPT_KEY_SIZE },
+	{ "type=",	5, SCRIPT_KEY_TYPE },
+	{ "uuid=",	5, SCRIPT_KEY_UUID },
+	{ "name=",	5, SCRIPT_KEY_NAME },
+	{ "attrs=",	6, SCRIPT_KEY_ATTRS },
+	{ "bootable",	8, SCRIPT_KEY_BOOTABLE },
+	{ "Id=",	3, SCRIPT_KEY_TYPE },		/* backward compatibility */
+};
+
+static const struct script_key *script_get_key(const char *p)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(script_keys); i++) {
+		const struct script_key *k = &script_keys[i];
+
+		/* the first char is enough to skip the most of the keys */
+		if (tolower(*p) == tolower(*k->name)
+		    && strncasecmp(p, k->name, k->namesz) == 0)
+			return k;
+	}
+	return NULL;
+}
+
 /* dump format
  * <device>: start=<num>, size=<num>, type=<string>, ...
+ *
+ * The line is tokenized in place, only the strings stored in the partition
+ * (name, uuid and attrs) are allocated.
  */
 static int parse_line_nameval(struct fdisk_script *dp, char *s)
 {
-	char *p, *x;
+	char *p, *x, *tk;
 	struct fdisk_partition *pa;
 	int rc = 0;
 	uint64_t num;
-	int pno;
+	int pno, pow;
 
 	assert(dp);
 	assert(s);
@@ -986,95 +1167,77 @@ static int parse_line_nameval(struct fdisk_script *dp, char *s)
 		p = s;
 
 	while (rc == 0 && p && *p) {
+		const struct script_key *key;
 
 		DBG(SCRIPT, ul_debugobj(dp, " parsing '%s'", p));
 		p = (char *) skip_blank(p);
 
-		if (!strncasecmp(p, "start=", 6)) {
-			int pow = 0;
+		key = script_get_key(p);
+		if (!key) {
+			DBG(SCRIPT, ul_debugobj(dp, "script parse error: unknown field '%s'", p));
+			rc = -EINVAL;
+			break;
+		}
 
-			p += 6;
-			if (!*p)
+		/* we use next_token() to skip possible extra space after "bootable" */
+		if (key->id != SCRIPT_KEY_BOOTABLE) {
+			p += key->namesz;
+			if (!*p && (key->id == SCRIPT_KEY_START || key->id == SCRIPT_KEY_SIZE))
 				continue;
+		}
 
-			rc = next_number(&p, &num, &pow);
+		switch (key->id) {
+		case SCRIPT_KEY_START:
+			pow = 0;
+			rc = next_sectors(dp, &p, &num, &pow);
 			if (!rc) {
-				if (pow) {	/* specified as <num><suffix> */
-					if (!dp->cxt->sector_size) {
-						rc = -EINVAL;
-						break;
-					}
-					num /= dp->cxt->sector_size;
-				}
 				fdisk_partition_set_start(pa, num);
 				fdisk_partition_start_follow_default(pa, 0);
 			}
-		} else if (!strncasecmp(p, "size=", 5)) {
-			int pow = 0;
-
-			p += 5;
-			if (!*p)
-				continue;
-
-			rc = next_number(&p, &num, &pow);
+			break;
+		case SCRIPT_KEY_SIZE:
+			pow = 0;
+			rc = next_sectors(dp, &p, &num, &pow);
 			if (!rc) {
-				if (pow) {	/* specified as <num><suffix> */
-					if (!dp->cxt->sector_size) {
-						rc = -EINVAL;
-						break;
-					}
-					num /= dp->cxt->sector_size;
-				} else		/* specified as number of sectors */
+				if (!pow)	/* specified as number of sectors */
 					fdisk_partition_size_explicit(pa, 1);
 				fdisk_partition_set_size(pa, num);
 				fdisk_partition_end_follow_default(pa, 0);
 			}
-
-		} else if (!strncasecmp(p, "bootable", 8)) {
-			/* we use next_token() to skip possible extra space */
-			char *tk = next_token(&p);
+			break;
+		case SCRIPT_KEY_BOOTABLE:
+			tk = next_token(&p);
 			if (tk && strcasecmp(tk, "bootable") == 0)
 				pa->boot = 1;
 			else
 				rc = -EINVAL;
-
-		} else if (!strncasecmp(p, "attrs=", 6)) {
-			p += 6;
+			break;
+		case SCRIPT_KEY_ATTRS:
 			free(pa->attrs);
 			rc = next_string(&p, &pa->attrs);
-
-		} else if (!strncasecmp(p, "uuid=", 5)) {
-			p += 5;
+			break;
+		case SCRIPT_KEY_UUID:
 			free(pa->uuid);
 			rc = next_string(&p, &pa->uuid);
-
-		} else if (!strncasecmp(p, "name=", 5)) {
-			p += 5;
+			break;
+		case SCRIPT_KEY_NAME:
 			free(pa->name);
 			rc = next_string(&p, &pa->name);
 			if (!rc)
 				unhexmangle_string(pa->name);
-
-		} else if (!strncasecmp(p, "type=", 5) ||
-			   !strncasecmp(p, "Id=", 3)) {		/* backward compatibility */
-			char *type = NULL;
-
+			break;
+		case SCRIPT_KEY_TYPE:
 			fdisk_unref_parttype(pa->type);
 			pa->type = NULL;
 
-			p += ((*p == 'I' || *p == 'i') ? 3 : 5); /* "Id=", "type=" */
-
-			rc = next_string(&p, &type);
-			if (rc == 0) {
-				pa->type = fdisk_label_advparse_parttype(script_get_label(dp),
-					type, FDISK_SCRIPT_PARTTYPE_PARSE_FLAGS);
-				if (!pa->type)
-					rc = -EINVAL;
+			tk = next_token(&p);
+			if (!tk) {
+				rc = -EINVAL;
+				break;
 			}
-			free(type);
-		} else {
-			DBG(SCRIPT, ul_debugobj(dp, "script parse error: unknown field '%s'", p));
-			rc = -EINVAL;
+			pa->type = script_parse_parttype(dp, tk);
+			if (!pa->type)
+				rc = -EINVAL;
 			break;
 		}
 	}
@@ -1140,15 +1303,8 @@ static int parse_line_valcommas(struct fdisk_script *dp, char *s)
 			else {
 				int pow = 0;
 
-				rc = next_number(&p, &num, &pow);
+				rc = next_sectors(dp, &p, &num, &pow);
 				if (!rc) {
-					if (pow) {	/* specified as <num><suffix> */
-						if (!dp->cxt->sector_size) {
-							rc = -EINVAL;
-							break;
-						}
-						num /= dp->cxt->sector_size;
-					}
 					fdisk_partition_set_start(pa, num);
 					pa->movestart = sign == TK_MINUS ? FDISK_MOVE_DOWN :
 							sign == TK_PLUS  ? FDISK_MOVE_UP :
@@ -1165,15 +1321,10 @@ static int parse_line_valcommas(struct fdisk_script *dp, char *s)
 					pa->resize = FDISK_RESIZE_ENLARGE;
 			} else {
 				int pow = 0;
-				rc = next_number(&p, &num, &pow);
+
+				rc = next_sectors(dp, &p, &num, &pow);
 				if (!rc) {
-					if (pow) { /* specified as <size><suffix> */
-						if (!dp->cxt->sector_size) {
-							rc = -EINVAL;
-							break;
-						}
-						num /= dp->cxt->sector_size;
-					} else	 /* specified as number of sectors */
+					if (!pow)	/* specified as number of sectors */
 						fdisk_partition_size_explicit(pa, 1);
 					fdisk_partition_set_size(pa, num);
 					pa->resize = sign == TK_MINUS ? FDISK_RESIZE_REDUCE :
@@ -1185,19 +1336,19 @@ static int parse_line_valcommas(struct fdisk_script *dp, char *s)
 			break;
 		case ITEM_TYPE:
 		{
-			char *str = NULL;
+			char *str;
 
 			if (*p == ',' || *p == ';' || alone_sign(sign, p))
 				break;	/* use default type */
 
-			rc = next_string(&p, &str);
-			if (rc)
+			str = next_token(&p);
+			if (!str) {
+				rc = -EINVAL;
 				break;
+			}
 
 			fdisk_unref_parttype(pa->type);
-			pa->type = fdisk_label_advparse_parttype(script_get_label(dp),
-						str, FDISK_SCRIPT_PARTTYPE_PARSE_FLAGS);
-			free(str);
+			pa->type = script_parse_parttype(dp, str);
 			if (!pa->type)
 				rc = -EINVAL;
 			break;
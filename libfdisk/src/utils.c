@@ -30,6 +30,9 @@ static int read_from_device(struct fdisk_context *cxt,
 	}
 
 	r = read(cxt->dev_fd, buf, size);
+	STAT_ADD(READS, 1);
+	if (r > 0)
+		STAT_ADD(READ_BYTES, r);
 	if (r < 0 || (size_t)r != size) {
 		if (!errno)
 			errno = EINVAL;	/* probably too small file/device */
@@ -62,7 +65,15 @@ int fdisk_init_firstsector_buffer(struct fdisk_context *cxt,
 
 		DBG(CXT, ul_debugobj(cxt, "initialize in-memory first sector "
 				"buffer [sector_size=%lu]", cxt->sector_size));
-		cxt->firstsector = calloc(1, cxt->sector_size);
+
+		if (cxt->spare_sector && cxt->spare_sector_bufsz == cxt->sector_size) {
+			/* buffer from the previous device, see reset_context() */
+			cxt->firstsector = cxt->spare_sector;
+			memset(cxt->firstsector, 0, cxt->sector_size);
+			cxt->spare_sector = NULL;
+			cxt->spare_sector_bufsz = 0;
+		} else
+			cxt->firstsector = calloc(1, cxt->sector_size);
 		if (!cxt->firstsector)
 			return -ENOMEM;
 
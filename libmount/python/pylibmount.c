@@ -274,6 +274,7 @@ PyMODINIT_FUNC initpylibmount(void)
 	PyModule_AddIntConstant(m, "MNT_MS_FEC_OFFSET", MNT_MS_FEC_OFFSET);
 	PyModule_AddIntConstant(m, "MNT_MS_FEC_ROOTS", MNT_MS_FEC_ROOTS);
 	PyModule_AddIntConstant(m, "MNT_MS_ROOT_HASH_SIG", MNT_MS_ROOT_HASH_SIG);
+	PyModule_AddIntConstant(m, "MNT_MS_LOOP_AUTOTUNE", MNT_MS_LOOP_AUTOTUNE);
 
 	/*
 	 * mount(2) MS_* masks (MNT_MAP_LINUX map)
@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Generates synthetic mountinfo and fstab files and reports time spent to
+ * parse them, to compare two mountinfo versions and to look up the fstab
+ * entries in the mountinfo (as mount -a does). Every phase reports the wall
+ * time, the number of read/write syscalls (from /proc/self/io) and the minor
+ * page faults. Use --save to keep the files for end-to-end tests, e.g.
+ *
+ *	findmnt --tab-file <dir>/mountinfo
+ *	findmnt --verify --tab-file <dir>/fstab
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "c.h"
+#include "closestream.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+
+#include "libmount.h"
+
+struct bench_entry {
+	char		*target;
+	char		*source;
+	const char	*type;
+	size_t		parent;
+};
+
+struct bench {
+	size_t		nentries;	/* mountinfo entries */
+	size_t		nfstab;		/* fstab entries */
+	size_t		nchanges;	/* differences in the second mountinfo */
+	uint64_t	seed;
+
+	struct bench_entry *ents;	/* the generated tree */
+
+	char		*dir;		/* where are the files */
+	char		*mountinfo;
+	char		*mountinfo2;
+	char		*fstab;
+};
+
+/* usage at the beginning of a phase */
+struct usage {
+	double		time;
+	unsigned long long syscalls;
+	long		minflt;
+};
+
+static uint64_t rnd(struct bench *b)
+{
+	/* xorshift64, the same files for the same --seed */
+	b->seed ^= b->seed << 13;
+	b->seed ^= b->seed >> 7;
+	b->seed ^= b->seed << 17;
+	return b->seed;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* read and write syscalls, 0 if the kernel does not account it */
+static unsigned long long count_syscalls(void)
+{
+	unsigned long long n = 0, x;
+	char buf[128];
+	FILE *f = fopen("/proc/self/io", "r" UL_CLOEXECSTR);
+
+	if (!f)
+		return 0;
+	while (fgets(buf, sizeof(buf), f)) {
+		if (sscanf(buf, "syscr: %llu", &x) == 1 ||
+		    sscanf(buf, "syscw: %llu", &x) == 1)
+			n += x;
+	}
+	fclose(f);
+	return n;
+}
+
+static void start(struct usage *u)
+{
+	struct rusage ru;
+
+	u->syscalls = count_syscalls();
+	u->minflt = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_minflt : 0;
+	u->time = now();
+}
+
+static void report(const char *phase, struct usage *u)
+{
+	double t = now() - u->time;
+	unsigned long long sc = count_syscalls();
+	struct rusage ru;
+	long minflt = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_minflt : 0;
+
+	/* count_syscalls() itself calls read() twice */
+	fprintf(stderr, "%-14s %10.3f ms %10llu syscalls %10ld faults\n",
+			phase, t * 1000.0,
+			sc > u->syscalls + 2 ? sc - u->syscalls - 2 : 0,
+			minflt - u->minflt);
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fprintf(out,
+		"\n %s [options]\n",
+		program_invocation_short_name);
+
+	fputs(" -n, --nentries <num>   number of mountinfo entries (default 10000)\n", out);
+	fputs(" -f, --fstab <num>      number of fstab entries (default 1000)\n", out);
+	fputs(" -d, --changes <num>    number of changes for the diff (default 100)\n", out);
+	fputs(" -c, --cache            use paths cache for the lookups\n", out);
+	fputs(" -S, --seed <num>       random seed\n", out);
+	fputs(" -s, --save <dir>       keep generated files in the directory\n", out);
+	fputs(" -h, --help             this help\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+static FILE *create_file(struct bench *b, const char *name, char **path)
+{
+	FILE *f;
+
+	xasprintf(path, "%s/%s", b->dir, name);
+	f = fopen(*path, "w" UL_CLOEXECSTR);
+	if (!f)
+		err(EXIT_FAILURE, "cannot open %s", *path);
+	return f;
+}
+
+static void close_file(FILE *f, const char *path)
+{
+	if (close_stream(f) != 0)
+		err(EXIT_FAILURE, "write failed: %s", path);
+}
+
+static const char *const fstypes[] = { "ext4", "xfs", "tmpfs", "nfs4", "overlay" };
+
+/*
+ * The tree, the entry 0 is the root filesystem and parent of an entry is one
+ * of the previous entries. All other targets are below /bench.
+ */
+static void generate_tree(struct bench *b)
+{
+	size_t i;
+
+	b->ents = xcalloc(b->nentries, sizeof(struct bench_entry));
+	b->ents[0].target = xstrdup("/");
+	b->ents[0].source = xstrdup("/dev/sda1");
+	b->ents[0].type = "ext4";
+
+	for (i = 1; i < b->nentries; i++) {
+		struct bench_entry *e = &b->ents[i];
+
+		e->parent = rnd(b) % i;
+		e->type = fstypes[rnd(b) % ARRAY_SIZE(fstypes)];
+
+		if (e->parent)
+			xasprintf(&e->target, "%s/m%zu", b->ents[e->parent].target, i);
+		else
+			xasprintf(&e->target, "/bench/m%zu", i);
+
+		if (strcmp(e->type, "nfs4") == 0)
+			xasprintf(&e->source, "server%zu:/export/%zu", i % 16, i);
+		else if (strcmp(e->type, "tmpfs") == 0 || strcmp(e->type, "overlay") == 0)
+			e->source = xstrdup(e->type);
+		else
+			xasprintf(&e->source, "/dev/bench%zu", i);
+	}
+}
+
+static void free_tree(struct bench *b)
+{
+	size_t i;
+
+	for (i = 0; i < b->nentries; i++) {
+		free(b->ents[i].target);
+		free(b->ents[i].source);
+	}
+	free(b->ents);
+}
+
+/*
+ * Mount ID is 100 + index. With @changes about --changes entries are
+ * modified: the same mount ID with other options (remount) or a new mount ID
+ * (umount and mount).
+ */
+static void write_mountinfo(struct bench *b, FILE *f, int changes)
+{
+	size_t i;
+
+	for (i = 0; i < b->nentries; i++) {
+		struct bench_entry *e = &b->ents[i];
+		size_t id = 100 + i;
+		const char *opts = "rw,relatime";
+
+		if (changes && i && rnd(b) % b->nentries < b->nchanges) {
+			if (rnd(b) % 2)
+				opts = "ro,relatime";
+			else
+				id += b->nentries;
+		}
+
+		fprintf(f, "%zu %zu %zu:%zu / %s %s shared:%zu - %s %s rw\n",
+				id, i ? 100 + e->parent : 1,
+				8 + i / 256, i % 256,
+				e->target, opts, i + 1, e->type, e->source);
+	}
+}
+
+/* 10% of the fstab entries are not mounted */
+static void write_fstab(struct bench *b, FILE *f)
+{
+	size_t i;
+
+	for (i = 0; i < b->nfstab; i++) {
+		struct bench_entry *e = &b->ents[rnd(b) % b->nentries];
+
+		if (rnd(b) % 10 == 0)
+			fprintf(f, "/dev/nobench%zu /bench/none%zu ext4 defaults 0 2\n", i, i);
+		else
+			fprintf(f, "%s %s %s defaults 0 2\n", e->source, e->target, e->type);
+	}
+}
+
+static void generate(struct bench *b)
+{
+	FILE *f;
+
+	generate_tree(b);
+
+	f = create_file(b, "mountinfo", &b->mountinfo);
+	write_mountinfo(b, f, 0);
+	close_file(f, b->mountinfo);
+
+	f = create_file(b, "mountinfo2", &b->mountinfo2);
+	write_mountinfo(b, f, 1);
+	close_file(f, b->mountinfo2);
+
+	f = create_file(b, "fstab", &b->fstab);
+	write_fstab(b, f);
+	close_file(f, b->fstab);
+
+	free_tree(b);
+}
+
+static struct libmnt_table *parse(const char *filename, struct libmnt_cache *cache)
+{
+	struct libmnt_table *tb = mnt_new_table();
+
+	if (!tb)
+		err(EXIT_FAILURE, "failed to allocate table");
+	mnt_table_set_cache(tb, cache);
+	if (mnt_table_parse_file(tb, filename) != 0)
+		errx(EXIT_FAILURE, "%s: failed to parse", filename);
+	return tb;
+}
+
+int main(int argc, char *argv[])
+{
+	struct libmnt_table *mi, *mi2, *fstab;
+	struct libmnt_tabdiff *df;
+	struct libmnt_iter *itr;
+	struct libmnt_cache *cache = NULL;
+	struct libmnt_fs *fs;
+	struct rusage ru;
+	struct usage u;
+	struct bench b = {
+		.nentries = 10000,
+		.nfstab = 1000,
+		.nchanges = 100,
+		.seed = 0x2545F4914F6CDD1DULL
+	};
+	char tmpdir[] = "/tmp/mount-bench-XXXXXX";
+	size_t nfound;
+	int c, use_cache = 0, save = 0;
+
+	static const struct option longopts[] = {
+		{ "nentries", 1, NULL, 'n' },
+		{ "fstab",    1, NULL, 'f' },
+		{ "changes",  1, NULL, 'd' },
+		{ "cache",    0, NULL, 'c' },
+		{ "seed",     1, NULL, 'S' },
+		{ "save",     1, NULL, 's' },
+		{ "help",     0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	setlocale(LC_ALL, "");
+	mnt_init_debug(0);
+
+	while((c = getopt_long(argc, argv, "cd:f:hn:S:s:", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'n':
+			b.nentries = strtou32_or_err(optarg, "failed to parse number of entries");
+			if (!b.nentries)
+				errx(EXIT_FAILURE, "at least 1 entry required");
+			break;
+		case 'f':
+			b.nfstab = strtou32_or_err(optarg, "failed to parse number of fstab entries");
+			break;
+		case 'd':
+			b.nchanges = strtou32_or_err(optarg, "failed to parse number of changes");
+			break;
+		case 'c':
+			use_cache = 1;
+			break;
+		case 'S':
+			b.seed = strtou64_or_err(optarg, "failed to parse seed");
+			if (!b.seed)
+				b.seed = 1;
+			break;
+		case 's':
+			b.dir = optarg;
+			save = 1;
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (!b.dir) {
+		b.dir = mkdtemp(tmpdir);
+		if (!b.dir)
+			err(EXIT_FAILURE, "cannot create temporary directory");
+	} else if (mkdir(b.dir, 0755) != 0 && errno != EEXIST)
+		err(EXIT_FAILURE, "cannot create %s", b.dir);
+
+	if (use_cache) {
+		cache = mnt_new_cache();
+		if (!cache)
+			err(EXIT_FAILURE, "failed to allocate cache");
+	}
+
+	start(&u);
+	generate(&b);
+	report("generate", &u);
+
+	start(&u);
+	mi = parse(b.mountinfo, cache);
+	report("parse", &u);
+
+	mi2 = parse(b.mountinfo2, cache);
+
+	start(&u);
+	fstab = parse(b.fstab, cache);
+	report("parse-fstab", &u);
+
+	start(&u);
+	df = mnt_new_tabdiff();
+	if (!df)
+		err(EXIT_FAILURE, "failed to allocate tabdiff");
+	if (mnt_diff_tables(df, mi, mi2) < 0)
+		errx(EXIT_FAILURE, "failed to compare tables");
+	report("diff", &u);
+	mnt_free_tabdiff(df);
+
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, "failed to allocate iterator");
+
+	start(&u);
+	nfound = 0;
+	while (mnt_table_next_fs(fstab, itr, &fs) == 0) {
+		if (mnt_table_find_target(mi, mnt_fs_get_target(fs), MNT_ITER_BACKWARD))
+			nfound++;
+	}
+	report("find-target", &u);
+
+	start(&u);
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(fstab, itr, &fs) == 0)
+		mnt_table_find_srcpath(mi, mnt_fs_get_srcpath(fs), MNT_ITER_BACKWARD);
+	report("find-srcpath", &u);
+
+	start(&u);
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(fstab, itr, &fs) == 0)
+		mnt_table_is_fs_mounted(mi, fs);
+	report("is-mounted", &u);
+
+	start(&u);
+	mnt_unref_table(mi);
+	mnt_unref_table(mi2);
+	mnt_unref_table(fstab);
+	mnt_unref_cache(cache);
+	report("free", &u);
+
+	mnt_free_iter(itr);
+
+	fprintf(stderr, "%-14s %10zu of %zu\n", "found", nfound, b.nfstab);
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		fprintf(stderr, "%-14s %10ld kB\n", "maxrss", ru.ru_maxrss);
+
+	if (save)
+		fprintf(stderr, "%-14s %s\n", "files", b.dir);
+	else {
+		unlink(b.mountinfo);
+		unlink(b.mountinfo2);
+		unlink(b.fstab);
+		rmdir(b.dir);
+	}
+	free(b.mountinfo);
+	free(b.mountinfo2);
+	free(b.fstab);
+	return EXIT_SUCCESS;
+}
@@ -173,3 +173,145 @@ out:
 	closedir(dirstream);
 	return found;
 }
+
+/*
+ * Default subvolume IDs cache. The ID is read by ioctl() for every btrfs
+ * entry when fstab is compared with mountinfo (e.g. mount -a), and it's
+ * expensive for thousands of subvolume mounts. The result is cached in the
+ * table for the (devno, mountpoint) pair (including errors), the devno is
+ * the device of the filesystem mounted on the mountpoint. The cache is
+ * dropped with the table index, see mnt_table_reset_index().
+ */
+struct btrfs_subvol_ent {
+	char			*path;
+	dev_t			devno;
+	uint64_t		id;
+	struct btrfs_subvol_ent	*next;
+};
+
+struct libmnt_btrfs_cache {
+	struct btrfs_subvol_ent	**buckets;
+	size_t			nbuckets;	/* power of 2 */
+	size_t			nents;
+};
+
+static uint64_t btrfs_cache_hash(const char *path, dev_t devno)
+{
+	return mnt_tabidx_hash_path(path) ^ mnt_tabidx_hash_devno(devno);
+}
+
+static int btrfs_cache_resize(struct libmnt_btrfs_cache *bc, size_t nbuckets)
+{
+	struct btrfs_subvol_ent **buckets;
+	size_t i;
+
+	buckets = calloc(nbuckets, sizeof(struct btrfs_subvol_ent *));
+	if (!buckets)
+		return -ENOMEM;
+
+	for (i = 0; i < bc->nbuckets; i++) {
+		struct btrfs_subvol_ent *e, *next;
+
+		for (e = bc->buckets[i]; e; e = next) {
+			size_t b = btrfs_cache_hash(e->path, e->devno) & (nbuckets - 1);
+
+			next = e->next;
+			e->next = buckets[b];
+			buckets[b] = e;
+		}
+	}
+	free(bc->buckets);
+	bc->buckets = buckets;
+	bc->nbuckets = nbuckets;
+	return 0;
+}
+
+static void btrfs_cache_add(struct libmnt_table *tb, const char *path,
+			    dev_t devno, uint64_t id)
+{
+	struct libmnt_btrfs_cache *bc = tb->btrfs;
+	struct btrfs_subvol_ent *e;
+	size_t b;
+
+	if (!bc) {
+		bc = tb->btrfs = calloc(1, sizeof(*bc));
+		if (!bc)
+			return;
+	}
+	if (bc->nents >= bc->nbuckets
+	    && btrfs_cache_resize(bc, bc->nbuckets ? bc->nbuckets << 1 : 64) != 0)
+		return;
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return;
+	e->path = strdup(path);
+	if (!e->path) {
+		free(e);
+		return;
+	}
+	e->devno = devno;
+	e->id = id;
+
+	b = btrfs_cache_hash(path, devno) & (bc->nbuckets - 1);
+	e->next = bc->buckets[b];
+	bc->buckets[b] = e;
+	bc->nents++;
+}
+
+/*
+ * The same as btrfs_get_default_subvol_id(), but the result is cached in
+ * @tb. The @devno is the device mounted on @path (or 0).
+ */
+uint64_t mnt_table_get_btrfs_default_subvol_id(struct libmnt_table *tb,
+					       const char *path, dev_t devno)
+{
+	struct libmnt_btrfs_cache *bc;
+	uint64_t id;
+	int errsv;
+
+	if (!tb || !path)
+		return btrfs_get_default_subvol_id(path);
+
+	bc = tb->btrfs;
+	if (bc && bc->nbuckets) {
+		struct btrfs_subvol_ent *e;
+		size_t b = btrfs_cache_hash(path, devno) & (bc->nbuckets - 1);
+
+		for (e = bc->buckets[b]; e; e = e->next) {
+			if (e->devno == devno && strcmp(e->path, path) == 0) {
+				DBG(BTRFS, ul_debugobj(tb, "cached default id for %s", path));
+				return e->id;
+			}
+		}
+	}
+
+	id = btrfs_get_default_subvol_id(path);
+	errsv = errno;
+	btrfs_cache_add(tb, path, devno, id);
+	errno = errsv;
+	return id;
+}
+
+void mnt_table_reset_btrfs_cache(struct libmnt_table *tb)
+{
+	struct libmnt_btrfs_cache *bc;
+	size_t i;
+
+	if (!tb || !tb->btrfs)
+		return;
+
+	bc = tb->btrfs;
+	for (i = 0; i < bc->nbuckets; i++) {
+		struct btrfs_subvol_ent *e, *next;
+
+		for (e = bc->buckets[i]; e; e = next) {
+			next = e->next;
+			free(e->path);
+			free(e);
+		}
+	}
+	free(bc->buckets);
+	free(bc);
+	tb->btrfs = NULL;
+}
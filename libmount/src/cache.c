@@ -20,9 +20,17 @@
  * paths. The cache uses libblkid as a backend for TAGs resolution.
  *
  * All returned paths are always canonicalized.
+ *
+ * The cache content may be saved to a snapshot file and preloaded by the next
+ * process, see mnt_cache_read_snapshot(). If $LIBMOUNT_CACHE_SNAPSHOT is set
+ * (and the process is not setuid), then all caches preload the file and
+ * update it when deallocated. The snapshot /run/mount/cache maintained by the
+ * mntcached(8) daemon is only preloaded, never written by the caches.
  */
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <ctype.h>
 #include <limits.h>
 #include <sys/stat.h>
@@ -34,6 +42,9 @@
 #include "mountP.h"
 #include "loopdev.h"
 #include "strutils.h"
+#include "mangle.h"
+#include "env.h"
+#include "pathnames.h"
 
 /*
  * Canonicalized (resolved) paths & tags cache
@@ -43,12 +54,20 @@
 #define MNT_CACHE_ISTAG		(1 << 1) /* entry is TAG */
 #define MNT_CACHE_ISPATH	(1 << 2) /* entry is path */
 #define MNT_CACHE_TAGREAD	(1 << 3) /* tag read by mnt_cache_read_tags() */
+#define MNT_CACHE_SNAPSHOT	(1 << 4) /* not verified path from snapshot */
+#define MNT_CACHE_MTAB		(1 << 5) /* target from mtab, see mnt_resolve_target() */
+
+#define MNT_CACHE_SNAPSHOT_MAGIC	"# libmount cache snapshot 1"
+#define MNT_CACHE_SNAPSHOT_MAXENTS	16384
 
 /* path cache entry */
 struct mnt_cache_entry {
 	char			*key;	/* search key (e.g. uncanonicalized path) */
 	char			*value;	/* value (e.g. canonicalized path) */
 	int			flag;
+
+	dev_t			st_dev;	/* snapshot paths only */
+	ino_t			st_ino;
 };
 
 struct libmnt_cache {
@@ -57,6 +76,13 @@ struct libmnt_cache {
 	size_t			nallocs;
 	int			refcount;
 
+	int			*buckets;	/* paths hashed by key */
+	int			*hnext;		/* next entry in the bucket */
+	size_t			nbuckets;
+
+	char			*snapshot;	/* $LIBMOUNT_CACHE_SNAPSHOT */
+	unsigned int		modified : 1;	/* new entries since snapshot read */
+
 	/* blkid_evaluate_tag() works in two ways:
 	 *
 	 * 1/ all tags are evaluated by udev /dev/disk/by-* symlinks,
@@ -79,10 +105,19 @@ struct libmnt_cache {
 struct libmnt_cache *mnt_new_cache(void)
 {
 	struct libmnt_cache *cache = calloc(1, sizeof(*cache));
+	const char *p;
+
 	if (!cache)
 		return NULL;
 	DBG(CACHE, ul_debugobj(cache, "alloc"));
 	cache->refcount = 1;
+
+	p = safe_getenv("LIBMOUNT_CACHE_SNAPSHOT");
+	if (p && *p) {
+		cache->snapshot = strdup(p);
+		if (cache->snapshot)
+			mnt_cache_read_snapshot(cache, cache->snapshot);
+	}
 	return cache;
 }
 
@@ -102,6 +137,12 @@ void mnt_free_cache(struct libmnt_cache *cache)
 
 	DBG(CACHE, ul_debugobj(cache, "free [refcount=%d]", cache->refcount));
 
+	/* don't overwrite the file maintained by daemon */
+	if (cache->snapshot && cache->modified
+	    && strcmp(cache->snapshot, MNT_PATH_CACHE) != 0)
+		mnt_cache_write_snapshot(cache, cache->snapshot);
+	free(cache->snapshot);
+
 	for (i = 0; i < cache->nents; i++) {
 		struct mnt_cache_entry *e = &cache->ents[i];
 		if (e->value != e->key)
@@ -109,6 +150,8 @@ void mnt_free_cache(struct libmnt_cache *cache)
 		free(e->key);
 	}
 	free(cache->ents);
+	free(cache->buckets);
+	free(cache->hnext);
 	if (cache->bc)
 		blkid_put_cache(cache->bc);
 	free(cache);
@@ -171,6 +214,47 @@ int mnt_cache_set_targets(struct libmnt_cache *cache,
 }
 
 
+static void cache_hash_entry(struct libmnt_cache *cache, size_t idx)
+{
+	size_t bk = mnt_tabidx_hash_path(cache->ents[idx].key) & (cache->nbuckets - 1);
+
+	/* the last added entry is the first in the bucket */
+	cache->hnext[idx] = cache->buckets[bk];
+	cache->buckets[bk] = idx;
+}
+
+static int cache_resize(struct libmnt_cache *cache)
+{
+	size_t i, sz = cache->nallocs ? cache->nallocs * 2 : MNT_CACHE_CHUNKSZ;
+	struct mnt_cache_entry *e;
+	int *b, *n;
+
+	e = realloc(cache->ents, sz * sizeof(struct mnt_cache_entry));
+	if (!e)
+		return -ENOMEM;
+	cache->ents = e;
+
+	n = realloc(cache->hnext, sz * sizeof(int));
+	if (!n)
+		return -ENOMEM;
+	cache->hnext = n;
+
+	b = realloc(cache->buckets, sz * sizeof(int));
+	if (!b)
+		return -ENOMEM;
+	cache->buckets = b;
+	cache->nbuckets = sz;
+	cache->nallocs = sz;
+
+	for (i = 0; i < cache->nbuckets; i++)
+		cache->buckets[i] = -1;
+	for (i = 0; i < cache->nents; i++) {
+		if (cache->ents[i].flag & MNT_CACHE_ISPATH)
+			cache_hash_entry(cache, i);
+	}
+	return 0;
+}
+
 /* note that the @key could be the same pointer as @value */
 static int cache_add_entry(struct libmnt_cache *cache, char *key,
 					char *value, int flag)
@@ -181,21 +265,19 @@ static int cache_add_entry(struct libmnt_cache *cache, char *key,
 	assert(value);
 	assert(key);
 
-	if (cache->nents == cache->nallocs) {
-		size_t sz = cache->nallocs + MNT_CACHE_CHUNKSZ;
-
-		e = realloc(cache->ents, sz * sizeof(struct mnt_cache_entry));
-		if (!e)
-			return -ENOMEM;
-		cache->ents = e;
-		cache->nallocs = sz;
-	}
+	if (cache->nents == cache->nallocs && cache_resize(cache) != 0)
+		return -ENOMEM;
 
 	e = &cache->ents[cache->nents];
 	e->key = key;
 	e->value = value;
 	e->flag = flag;
+	e->st_dev = 0;
+	e->st_ino = 0;
+	if (flag & MNT_CACHE_ISPATH)
+		cache_hash_entry(cache, cache->nents);
 	cache->nents++;
+	cache->modified = 1;
 
 	DBG(CACHE, ul_debugobj(cache, "add entry [%2zd] (%s): %s: %s",
 			cache->nents,
@@ -241,25 +323,61 @@ static int cache_add_tag(struct libmnt_cache *cache, const char *tagname,
 
 
 /*
- * Returns cached canonicalized path or NULL.
+ * The path from the snapshot is valid if both the key and the canonicalized
+ * path still point to the same inode.
  */
-static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
+static int cache_verify_entry(struct mnt_cache_entry *e)
 {
-	size_t i;
+	struct stat st;
 
-	if (!cache || !path)
+	if (stat(e->value, &st) != 0
+	    || st.st_dev != e->st_dev || st.st_ino != e->st_ino)
+		return 0;
+	if (e->key != e->value
+	    && (stat(e->key, &st) != 0
+		|| st.st_dev != e->st_dev || st.st_ino != e->st_ino))
+		return 0;
+	return 1;
+}
+
+/*
+ * Returns cached canonicalized path or NULL. The paths from the snapshot are
+ * verified by stat(2) on the first use, or ignored if @verify is 0.
+ */
+static const char *cache_lookup_path(struct libmnt_cache *cache,
+				     const char *path, int verify)
+{
+	int i;
+
+	if (!cache || !path || !cache->nbuckets)
 		return NULL;
 
-	for (i = 0; i < cache->nents; i++) {
+	i = cache->buckets[mnt_tabidx_hash_path(path) & (cache->nbuckets - 1)];
+	for (; i >= 0; i = cache->hnext[i]) {
 		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_ISPATH))
+
+		if (!(e->flag & MNT_CACHE_ISPATH) || !streq_paths(path, e->key))
 			continue;
-		if (streq_paths(path, e->key))
-			return e->value;
+		if (e->flag & MNT_CACHE_SNAPSHOT) {
+			if (!verify)
+				return NULL;
+			if (!cache_verify_entry(e)) {
+				DBG(CACHE, ul_debugobj(cache, "snapshot: %s outdated", e->key));
+				e->flag &= ~MNT_CACHE_ISPATH;
+				continue;
+			}
+			e->flag &= ~MNT_CACHE_SNAPSHOT;
+		}
+		return e->value;
 	}
 	return NULL;
 }
 
+static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
+{
+	return cache_lookup_path(cache, path, 1);
+}
+
 /*
  * Returns cached path or NULL.
  */
@@ -500,6 +618,7 @@ static char *canonicalize_path_and_cache(const char *path,
 	char *value;
 
 	DBG(CACHE, ul_debugobj(cache, "canonicalize path %s", path));
+	STAT_ADD(CANONICALIZE, 1);
 	p = canonicalize_path(path);
 
 	if (p && cache) {
@@ -544,7 +663,9 @@ char *mnt_resolve_path(const char *path, struct libmnt_cache *cache)
 		return NULL;
 	if (cache)
 		p = (char *) cache_find_path(cache, path);
-	if (!p)
+	if (p)
+		STAT_ADD(CACHE_HITS, 1);
+	else
 		p = canonicalize_path_and_cache(path, cache);
 
 	return p;
@@ -575,7 +696,8 @@ char *mnt_resolve_target(const char *path, struct libmnt_cache *cache)
 	if (!cache || !cache->mtab)
 		return mnt_resolve_path(path, cache);
 
-	p = (char *) cache_find_path(cache, path);
+	/* don't stat() the snapshot paths before the mtab is checked */
+	p = (char *) cache_lookup_path(cache, path, 0);
 	if (p)
 		return p;
 
@@ -595,7 +717,7 @@ char *mnt_resolve_target(const char *path, struct libmnt_cache *cache)
 			if (!p)
 				return NULL;	/* ENOMEM */
 
-			if (cache_add_entry(cache, p, p, MNT_CACHE_ISPATH)) {
+			if (cache_add_entry(cache, p, p, MNT_CACHE_ISPATH | MNT_CACHE_MTAB)) {
 				free(p);
 				return NULL;	/* ENOMEM */
 			}
@@ -603,6 +725,8 @@ char *mnt_resolve_target(const char *path, struct libmnt_cache *cache)
 		}
 	}
 
+	if (!p)
+		p = (char *) cache_find_path(cache, path);
 	if (!p)
 		p = canonicalize_path_and_cache(path, cache);
 	return p;
@@ -724,6 +848,367 @@ char *mnt_resolve_spec(const char *spec, struct libmnt_cache *cache)
 	return cn;
 }
 
+/*
+ * Resolves all tags used by @tb in one blkid_evaluate_tags() call and adds
+ * the results to @cache, so the later mnt_resolve_tag() calls for the table
+ * entries are answered by the cache (mount -a). Swap areas and noauto
+ * entries are skipped, the same as by mount -a.
+ *
+ * Returns: number of cached tags or <0 in case of error.
+ */
+int mnt_cache_resolve_table_tags(struct libmnt_cache *cache,
+				 struct libmnt_table *tb)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs, **fss = NULL;
+	const char **tags = NULL;
+	char **res = NULL;
+	size_t i, ntags = 0, nents;
+	int rc = 0;
+
+	if (!cache || !tb)
+		return -EINVAL;
+	nents = mnt_table_get_nents(tb);
+	if (!nents)
+		return 0;
+
+	tags = calloc(nents, sizeof(char *));
+	fss = calloc(nents, sizeof(struct libmnt_fs *));
+	if (!tags || !fss) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		const char *t, *v, *o = mnt_fs_get_user_options(fs);
+
+		if (mnt_fs_get_tag(fs, &t, &v) != 0 ||
+		    mnt_fs_is_swaparea(fs) ||
+		    (o && mnt_optstr_get_option(o, "noauto", NULL, NULL) == 0) ||
+		    cache_find_tag(cache, t, v))
+			continue;
+		fss[ntags] = fs;
+		tags[ntags++] = mnt_fs_get_source(fs);
+	}
+	if (!ntags)
+		goto done;
+
+	DBG(CACHE, ul_debugobj(cache, "resolving %zu tags", ntags));
+
+	res = calloc(ntags, sizeof(char *));
+	if (!res) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	rc = blkid_evaluate_tags(tags, res, ntags, &cache->bc);
+	if (rc <= 0)
+		goto done;
+
+	rc = 0;
+	for (i = 0; i < ntags; i++) {
+		const char *t, *v;
+
+		if (!res[i])
+			continue;
+		mnt_fs_get_tag(fss[i], &t, &v);
+
+		/* the same tag used by more entries */
+		if (!cache_find_tag(cache, t, v) &&
+		    cache_add_tag(cache, t, v, res[i], 0) == 0)
+			rc++;
+		else
+			free(res[i]);
+	}
+done:
+	free(res);
+	free(fss);
+	free(tags);
+	return rc;
+}
+
+/*
+ * The snapshot is usable only in the same mount namespace and root directory,
+ * the tags only if no uevent has been generated since the snapshot was
+ * written (udev maintains /dev/disk/by-* links, the blkid cache is updated
+ * on uevents too).
+ */
+struct snapshot_id {
+	ino_t		ns;
+	dev_t		root_dev;
+	ino_t		root_ino;
+	uint64_t	seqnum;		/* 0 if unknown */
+};
+
+static void get_snapshot_id(struct snapshot_id *id)
+{
+	struct stat st;
+	FILE *f;
+
+	memset(id, 0, sizeof(*id));
+
+	if (stat("/proc/self/ns/mnt", &st) == 0)
+		id->ns = st.st_ino;
+	if (stat("/", &st) == 0) {
+		id->root_dev = st.st_dev;
+		id->root_ino = st.st_ino;
+	}
+	f = fopen(_PATH_SYS_UEVENT_SEQNUM, "r" UL_CLOEXECSTR);
+	if (f) {
+		if (fscanf(f, "%" SCNu64, &id->seqnum) != 1)
+			id->seqnum = 0;
+		fclose(f);
+	}
+}
+
+static int read_snapshot_entry(struct libmnt_cache *cache, char *line,
+			       int tags_valid)
+{
+	char *key = NULL, *value = NULL, *tagval = NULL;
+	const char *p = line + 1;
+	size_t sz = strlen(line);
+	int rc = 0;
+
+	if (sz && line[sz - 1] == '\n')
+		line[sz - 1] = '\0';
+
+	if (*line == 'P') {
+		unsigned long long dev, ino;
+		int n = 0;
+
+		if (sscanf(p, " %llu %llu %n", &dev, &ino, &n) != 2 || !n)
+			return 0;
+		key = unmangle(p + n, &p);
+		value = key ? unmangle(skip_blank(p), &p) : NULL;
+		if (!key || !value || *key != '/' || *value != '/')
+			goto done;
+
+		if (strcmp(key, value) == 0) {
+			free(value);
+			value = key;
+		}
+		rc = cache_add_entry(cache, key, value,
+				MNT_CACHE_ISPATH | MNT_CACHE_SNAPSHOT);
+		if (rc == 0) {
+			struct mnt_cache_entry *e = &cache->ents[cache->nents - 1];
+
+			e->st_dev = dev;
+			e->st_ino = ino;
+			return 0;
+		}
+
+	} else if ((*line == 'T' || *line == 'R') && tags_valid) {
+		key = unmangle(skip_blank(p), &p);
+		tagval = key ? unmangle(skip_blank(p), &p) : NULL;
+		value = tagval ? unmangle(skip_blank(p), &p) : NULL;
+		if (!value || !mnt_valid_tagname(key))
+			goto done;
+
+		rc = cache_add_tag(cache, key, tagval, value,
+				*line == 'R' ? MNT_CACHE_TAGREAD : 0);
+		if (rc == 0)
+			value = NULL;
+	}
+done:
+	if (value != key)
+		free(value);
+	free(key);
+	free(tagval);
+	return rc;
+}
+
+/**
+ * mnt_cache_read_snapshot:
+ * @cache: pointer to struct libmnt_cache instance
+ * @filename: snapshot file (e.g. /run/mount/cache)
+ *
+ * Preloads @cache from the file written by mnt_cache_write_snapshot(). It
+ * allows to reuse canonicalized paths and evaluated tags from the previous
+ * processes, for example for "umount" called in a loop.
+ *
+ * The snapshot is ignored if it has been written in another mount namespace
+ * or root directory. The tags are ignored if a device has been added, removed
+ * or changed since the snapshot was written (kernel uevent sequence number).
+ * The paths are verified by stat(2) on the first use. The file has to be owned
+ * by root or by the current user, and not writable by others.
+ *
+ * Returns: 0 on success, 1 if the snapshot is outdated, negative number in case
+ * of error.
+ *
+ * Since: ext-1
+ */
+int mnt_cache_read_snapshot(struct libmnt_cache *cache, const char *filename)
+{
+	struct snapshot_id cur, id;
+	unsigned long long ns = 0, rdev = 0, rino = 0;
+	uint64_t seqnum = 0;
+	char *line = NULL;
+	size_t linesz = 0;
+	unsigned int modified;
+	struct stat st;
+	FILE *f;
+	int fd, rc = 0;
+
+	if (!cache || !filename)
+		return -EINVAL;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+	    || (st.st_uid != 0 && st.st_uid != geteuid())
+	    || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		DBG(CACHE, ul_debugobj(cache, "snapshot: %s: insecure file", filename));
+		close(fd);
+		return -EPERM;
+	}
+	f = fdopen(fd, "r" UL_CLOEXECSTR);
+	if (!f) {
+		close(fd);
+		return -errno;
+	}
+
+	if (getline(&line, &linesz, f) < 0
+	    || strcmp(line, MNT_CACHE_SNAPSHOT_MAGIC "\n") != 0
+	    || fscanf(f, "ns %llu\nroot %llu %llu\nseqnum %" SCNu64 "\n",
+			&ns, &rdev, &rino, &seqnum) != 4) {
+		rc = -EINVAL;
+		goto done;
+	}
+
+	id.ns = ns;
+	id.root_dev = rdev;
+	id.root_ino = rino;
+	get_snapshot_id(&cur);
+
+	if (id.ns != cur.ns || id.root_dev != cur.root_dev || id.root_ino != cur.root_ino) {
+		DBG(CACHE, ul_debugobj(cache, "snapshot: %s: another namespace", filename));
+		rc = 1;
+		goto done;
+	}
+
+	modified = cache->modified;
+	while (rc == 0 && getline(&line, &linesz, f) >= 0)
+		rc = read_snapshot_entry(cache, line,
+				seqnum && seqnum == cur.seqnum);
+	cache->modified = modified;
+
+	DBG(CACHE, ul_debugobj(cache, "snapshot: %s: read [entries=%zu, tags=%s, rc=%d]",
+				filename, cache->nents,
+				seqnum && seqnum == cur.seqnum ? "valid" : "outdated", rc));
+done:
+	free(line);
+	fclose(f);
+	return rc;
+}
+
+static int write_snapshot_entry(FILE *f, struct mnt_cache_entry *e, int tags)
+{
+	char *k = NULL, *v = NULL, *t = NULL;
+	int rc = 0;
+
+	if (e->flag & MNT_CACHE_ISPATH) {
+		if (e->flag & MNT_CACHE_MTAB)
+			return 0;
+		if (!(e->flag & MNT_CACHE_SNAPSHOT)) {
+			struct stat st, sk;
+
+			/* don't save not existing paths */
+			if (stat(e->value, &st) != 0)
+				return 0;
+			if (e->key != e->value
+			    && (stat(e->key, &sk) != 0
+			        || sk.st_dev != st.st_dev || sk.st_ino != st.st_ino))
+				return 0;
+			e->st_dev = st.st_dev;
+			e->st_ino = st.st_ino;
+		}
+		k = mangle(e->key);
+		v = mangle(e->value);
+		if (k && v)
+			rc = fprintf(f, "P %llu %llu %s %s\n",
+					(unsigned long long) e->st_dev,
+					(unsigned long long) e->st_ino, k, v);
+
+	} else if ((e->flag & MNT_CACHE_ISTAG) && tags) {
+		k = mangle(e->key);
+		t = mangle(e->key + strlen(e->key) + 1);
+		v = mangle(e->value);
+		if (k && t && v)
+			rc = fprintf(f, "%c %s %s %s\n",
+					e->flag & MNT_CACHE_TAGREAD ? 'R' : 'T', k, t, v);
+	} else
+		return 0;
+
+	if (!k || !v)
+		rc = -ENOMEM;
+	free(k);
+	free(v);
+	free(t);
+	return rc < 0 ? rc : 0;
+}
+
+/**
+ * mnt_cache_write_snapshot:
+ * @cache: pointer to struct libmnt_cache instance
+ * @filename: snapshot file (e.g. /run/mount/cache)
+ *
+ * Writes the canonicalized paths and evaluated tags from @cache to @filename,
+ * see mnt_cache_read_snapshot(). The file is replaced atomically.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: ext-1
+ */
+int mnt_cache_write_snapshot(struct libmnt_cache *cache, const char *filename)
+{
+	struct snapshot_id id;
+	char *uq = NULL;
+	size_t i = 0;
+	FILE *f;
+	int fd, rc = 0;
+
+	if (!cache || !filename)
+		return -EINVAL;
+
+	fd = mnt_open_uniq_filename(filename, &uq);
+	if (fd < 0)
+		return fd;
+
+	f = fdopen(fd, "w" UL_CLOEXECSTR);
+	if (!f) {
+		rc = -errno;
+		close(fd);
+		goto done;
+	}
+
+	get_snapshot_id(&id);
+	fprintf(f, MNT_CACHE_SNAPSHOT_MAGIC "\nns %llu\nroot %llu %llu\nseqnum %" PRIu64 "\n",
+			(unsigned long long) id.ns,
+			(unsigned long long) id.root_dev,
+			(unsigned long long) id.root_ino, id.seqnum);
+
+	/* the oldest entries are dropped */
+	if (cache->nents > MNT_CACHE_SNAPSHOT_MAXENTS)
+		i = cache->nents - MNT_CACHE_SNAPSHOT_MAXENTS;
+	for (; rc == 0 && i < cache->nents; i++)
+		rc = write_snapshot_entry(f, &cache->ents[i], id.seqnum != 0);
+
+	if (!rc && fflush(f) != 0)
+		rc = -errno;
+	if (!rc)
+		rc = fchmod(fd, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH) ? -errno : 0;
+	fclose(f);
+
+	if (!rc)
+		rc = rename(uq, filename) ? -errno : 0;
+done:
+	unlink(uq);	/* be paranoid */
+	free(uq);
+
+	DBG(CACHE, ul_debugobj(cache, "snapshot: %s: written [rc=%d]", filename, rc));
+	return rc;
+}
 
 #ifdef TEST_PROGRAM
 
@@ -58,6 +58,7 @@ struct libmnt_context *mnt_new_context(void)
 		return NULL;
 
 	INIT_LIST_HEAD(&cxt->addmounts);
+	INIT_LIST_HEAD(&cxt->helpers);
 
 	ruid = getuid();
 	euid = geteuid();
@@ -88,6 +89,9 @@ struct libmnt_context *mnt_new_context(void)
  */
 void mnt_free_context(struct libmnt_context *cxt)
 {
+	size_t j;
+	int i;
+
 	if (!cxt)
 		return;
 
@@ -107,8 +111,24 @@ void mnt_free_context(struct libmnt_context *cxt)
 
 	mnt_context_set_target_ns(cxt, NULL);
 
+	while (!list_empty(&cxt->helpers)) {
+		struct libmnt_helper *hl = list_entry(cxt->helpers.next,
+						struct libmnt_helper, helpers);
+		list_del(&hl->helpers);
+		free(hl->name);
+		free(hl->type);
+		free(hl->path);
+		free(hl);
+	}
+
+	for (i = 0; i < cxt->nchildren; i++)
+		mnt_unref_fs(cxt->children[i].fs);
 	free(cxt->children);
 
+	for (j = 0; j < cxt->npending; j++)
+		mnt_unref_fs(cxt->pending[j]);
+	free(cxt->pending);
+
 	DBG(CXT, ul_debugobj(cxt, "<---- free"));
 	free(cxt);
 }
@@ -590,6 +610,36 @@ int mnt_context_is_fork(struct libmnt_context *cxt)
 	return cxt->flags & MNT_FL_FORK ? 1 : 0;
 }
 
+/**
+ * mnt_context_set_parallel:
+ * @cxt: mount context
+ * @nprocs: maximal number of parallel mounts or 0
+ *
+ * Enables fork(2) in mnt_context_next_mount() (see mnt_context_enable_fork())
+ * and limits the number of running children to @nprocs. Contrary to the
+ * plain fork mode, a filesystem is not mounted while a dependent filesystem
+ * is being mounted by another child: when one target is below the other,
+ * when the source path is below the other target (e.g. bind mount or loop
+ * device image), or when both use the same source device. The independent
+ * filesystems are mounted concurrently, the dependent in the fstab order. A
+ * filesystem which has to wait is deferred and does not delay the
+ * independent filesystems after it in fstab.
+ *
+ * The value 0 disables the limit and dependency ordering.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: ext-1
+ */
+int mnt_context_set_parallel(struct libmnt_context *cxt, int nprocs)
+{
+	if (!cxt || nprocs < 0)
+		return -EINVAL;
+
+	cxt->max_children = nprocs;
+	return nprocs ? mnt_context_enable_fork(cxt, TRUE) : 0;
+}
+
 /**
  * mnt_context_is_parent:
  * @cxt: mount context
@@ -916,6 +966,11 @@ int mnt_context_set_fs(struct libmnt_context *cxt, struct libmnt_fs *fs)
 		return -EINVAL;
 
 	DBG(CXT, ul_debugobj(cxt, "setting new FS"));
+
+	/* the context modifies the strings in place */
+	if (fs && __mnt_fs_unshare(fs))
+		return -ENOMEM;
+
 	mnt_ref_fs(fs);			/* new */
 	mnt_unref_fs(cxt->fs);		/* old */
 	cxt->fs = fs;
@@ -2081,10 +2136,53 @@ none:
 	return mnt_fs_set_fstype(cxt->fs, "none");
 }
 
+static struct libmnt_helper *get_cached_helper(struct libmnt_context *cxt,
+					const char *name, const char *type)
+{
+	struct list_head *p;
+
+	list_for_each(p, &cxt->helpers) {
+		struct libmnt_helper *hl = list_entry(p, struct libmnt_helper, helpers);
+
+		if (strcmp(hl->name, name) == 0 && strcmp(hl->type, type) == 0)
+			return hl;
+	}
+	return NULL;
+}
+
+/* @path is NULL if not found */
+static void add_cached_helper(struct libmnt_context *cxt, const char *name,
+			      const char *type, const char *path)
+{
+	struct libmnt_helper *hl = calloc(1, sizeof(*hl));
+
+	if (!hl)
+		return;		/* the cache is optional */
+
+	INIT_LIST_HEAD(&hl->helpers);
+	hl->name = strdup(name);
+	hl->type = strdup(type);
+	if (path)
+		hl->path = strdup(path);
+
+	if (!hl->name || !hl->type || (path && !hl->path)) {
+		free(hl->name);
+		free(hl->type);
+		free(hl->path);
+		free(hl);
+		return;
+	}
+	list_add_tail(&hl->helpers, &cxt->helpers);
+}
+
 /*
  * The default is to use fstype from cxt->fs, this could be overwritten by
  * @type. The @act is MNT_ACT_{MOUNT,UMOUNT}.
  *
+ * The result of the lookup is cached in the context (it's not reset by
+ * mnt_reset_context()), so the helpers search path is scanned only once
+ * for every FS type if the context is used for more mounts.
+ *
  * Returns: 0 on success or negative number in case of error. Note that success
  * does not mean that there is any usable helper, you have to check cxt->helper.
  */
@@ -2094,6 +2192,7 @@ int mnt_context_prepare_helper(struct libmnt_context *cxt, const char *name,
 	char search_path[] = FS_SEARCH_PATH;		/* from config.h */
 	char *p = NULL, *path;
 	struct libmnt_ns *ns_old;
+	struct libmnt_helper *hl;
 	int rc = 0;
 
 	assert(cxt);
@@ -2118,6 +2217,13 @@ int mnt_context_prepare_helper(struct libmnt_context *cxt, const char *name,
 	    || mnt_fs_is_swaparea(cxt->fs))
 		return 0;
 
+	hl = get_cached_helper(cxt, name, type);
+	if (hl) {
+		DBG(CXT, ul_debugobj(cxt, "%s.%s helper cached: %s", name, type,
+					hl->path ? hl->path : "not found"));
+		return hl->path ? strdup_to_struct_member(cxt, helper, hl->path) : 0;
+	}
+
 	ns_old = mnt_context_switch_origin_ns(cxt);
 	if (!ns_old)
 		return -MNT_ERR_NAMESPACE;
@@ -2164,7 +2270,8 @@ int mnt_context_prepare_helper(struct libmnt_context *cxt, const char *name,
 	if (rc) {
 		free(cxt->helper);
 		cxt->helper = NULL;
-	}
+	} else
+		add_cached_helper(cxt, name, type, cxt->helper);
 	return rc;
 }
 
@@ -2922,25 +3029,31 @@ int mnt_context_is_fs_mounted(struct libmnt_context *cxt,
 	return 0;
 }
 
-static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid)
+static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid,
+				 struct libmnt_fs *fs)
 {
-	pid_t *pids;
+	struct libmnt_child *ch;
 
 	if (!cxt)
 		return -EINVAL;
 
-	pids = realloc(cxt->children, sizeof(pid_t) * cxt->nchildren + 1);
-	if (!pids)
+	ch = realloc(cxt->children, sizeof(*ch) * (cxt->nchildren + 1));
+	if (!ch)
 		return -ENOMEM;
 
 	DBG(CXT, ul_debugobj(cxt, "add new child %d", pid));
-	cxt->children = pids;
-	cxt->children[cxt->nchildren++] = pid;
-
+	cxt->children = ch;
+
+	ch = &cxt->children[cxt->nchildren++];
+	ch->pid = pid;
+	ch->status = 0;
+	ch->fs = fs;
+	mnt_ref_fs(fs);
+	cxt->nrunning++;
 	return 0;
 }
 
-int mnt_fork_context(struct libmnt_context *cxt)
+int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs)
 {
 	int rc = 0;
 	pid_t pid;
@@ -2967,16 +3080,255 @@ int mnt_fork_context(struct libmnt_context *cxt)
 		break;
 
 	default:
-		rc = mnt_context_add_child(cxt, pid);
+		rc = mnt_context_add_child(cxt, pid, fs);
 		break;
 	}
 
 	return rc;
 }
 
+static struct libmnt_child *get_running_child(struct libmnt_context *cxt, pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < cxt->nchildren; i++) {
+		if (cxt->children[i].fs && cxt->children[i].pid == pid)
+			return &cxt->children[i];
+	}
+	return NULL;
+}
+
+/*
+ * Waits for the child (if not finished yet) and saves its wait status.
+ */
+static int wait_for_child(struct libmnt_context *cxt, struct libmnt_child *ch)
+{
+	int rc;
+
+	do {
+		DBG(CXT, ul_debugobj(cxt, "waiting for child %d [%s]",
+					ch->pid, mnt_fs_get_target(ch->fs)));
+		errno = 0;
+		rc = waitpid(ch->pid, &ch->status, 0);
+
+	} while (rc == -1 && errno == EINTR);
+
+	if (rc == -1)
+		ch->status = -1;
+
+	mnt_unref_fs(ch->fs);
+	ch->fs = NULL;		/* not running */
+	cxt->nrunning--;
+	return rc == -1 ? -errno : 0;
+}
+
+/*
+ * Returns canonicalized @path if the cache is available, or @path.
+ */
+static const char *child_path(struct libmnt_cache *cache, const char *path)
+{
+	const char *p = cache && path ? mnt_resolve_path(path, cache) : NULL;
+
+	return p ? p : path;
+}
+
+static const char *child_srcpath(struct libmnt_cache *cache, struct libmnt_fs *fs)
+{
+	const char *p = mnt_fs_get_srcpath(fs);
+
+	if (!p && cache)
+		p = mnt_resolve_spec(mnt_fs_get_source(fs), cache);
+	else
+		p = child_path(cache, p);
+
+	return p && *p == '/' ? p : NULL;
+}
+
+static int is_subpath(const char *path, const char *dir)
+{
+	size_t sz;
+
+	if (!path || !dir)
+		return 0;
+
+	sz = strlen(dir);
+	while (sz > 0 && dir[sz - 1] == '/')
+		sz--;
+
+	return strncmp(path, dir, sz) == 0 && (path[sz] == '\0' || path[sz] == '/');
+}
+
+/*
+ * Returns 1 if @a and @b cannot be mounted in parallel -- one of the targets
+ * is below the other, the source is below the other target (bind mounts,
+ * loop devices), or both use the same source device.
+ */
+static int fs_depends_on(struct libmnt_cache *cache,
+			 struct libmnt_fs *a, struct libmnt_fs *b)
+{
+	const char *at = child_path(cache, mnt_fs_get_target(a)),
+		   *bt = child_path(cache, mnt_fs_get_target(b)),
+		   *as = child_srcpath(cache, a),
+		   *bs = child_srcpath(cache, b);
+
+	return is_subpath(at, bt) || is_subpath(bt, at)
+	       || is_subpath(as, bt) || is_subpath(bs, at)
+	       || (as && bs && strcmp(as, bs) == 0);
+}
+
+/*
+ * Waits for any running child. The children which are not ours are not
+ * reaped.
+ */
+static int wait_for_any_child(struct libmnt_context *cxt)
+{
+	struct libmnt_child *ch = NULL;
+	siginfo_t si = { .si_pid = 0 };
+	int i, rc;
+
+	do {
+		errno = 0;
+		rc = waitid(P_ALL, 0, &si, WEXITED | WNOWAIT);
+	} while (rc == -1 && errno == EINTR);
+
+	if (rc == 0)
+		ch = get_running_child(cxt, si.si_pid);
+
+	/* unknown child (or error), wait for the first running */
+	for (i = 0; !ch && i < cxt->nchildren; i++) {
+		if (cxt->children[i].fs)
+			ch = &cxt->children[i];
+	}
+	return ch ? wait_for_child(cxt, ch) : 0;
+}
+
+/*
+ * Returns 1 if @fs depends on a running child or on one of the first
+ * @npending deferred filesystems.
+ */
+static int is_blocked(struct libmnt_context *cxt, struct libmnt_cache *cache,
+		      struct libmnt_fs *fs, size_t npending)
+{
+	size_t i;
+	int n;
+
+	for (n = 0; n < cxt->nchildren; n++) {
+		struct libmnt_child *ch = &cxt->children[n];
+
+		if (ch->fs && fs_depends_on(cache, fs, ch->fs)) {
+			DBG(CXT, ul_debugobj(cxt, "%s blocked by running %s",
+					mnt_fs_get_target(fs),
+					mnt_fs_get_target(ch->fs)));
+			return 1;
+		}
+	}
+	for (i = 0; i < npending; i++) {
+		if (fs_depends_on(cache, fs, cxt->pending[i])) {
+			DBG(CXT, ul_debugobj(cxt, "%s blocked by deferred %s",
+					mnt_fs_get_target(fs),
+					mnt_fs_get_target(cxt->pending[i])));
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * "mount -a --parallel": defers @fs if it depends on a running child or on
+ * a filesystem deferred before. The deferred filesystems are started by
+ * mnt_context_next_deferred() in the fstab order, the independent
+ * filesystems after them in fstab are not delayed.
+ *
+ * Returns: 1 if deferred, 0 if @fs can be mounted now, <0 on error.
+ */
+int mnt_context_defer_mount(struct libmnt_context *cxt, struct libmnt_fs *fs)
+{
+	struct libmnt_fs **pe;
+
+	assert(cxt);
+	assert(mnt_context_is_parent(cxt));
+
+	if (!is_blocked(cxt, mnt_context_get_cache(cxt), fs, cxt->npending))
+		return 0;
+
+	pe = realloc(cxt->pending, sizeof(*pe) * (cxt->npending + 1));
+	if (!pe)
+		return -ENOMEM;
+	cxt->pending = pe;
+	cxt->pending[cxt->npending++] = fs;
+	mnt_ref_fs(fs);
+
+	DBG(CXT, ul_debugobj(cxt, "%s deferred [pending=%zu]",
+				mnt_fs_get_target(fs), cxt->npending));
+	return 1;
+}
+
+/*
+ * "mount -a --parallel": returns the first deferred filesystem which does not
+ * depend on running children and the filesystems deferred before it. If
+ * @wait is true and all the deferred filesystems are blocked, then waits for
+ * the running children.
+ *
+ * Returns: 0 and @fs, 1 if nothing is ready (or deferred), <0 on error.
+ */
+int mnt_context_next_deferred(struct libmnt_context *cxt,
+			      struct libmnt_fs **fs, int wait)
+{
+	struct libmnt_cache *cache = mnt_context_get_cache(cxt);
+
+	assert(cxt);
+	assert(fs);
+
+	while (cxt->npending) {
+		size_t i;
+		int rc;
+
+		for (i = 0; i < cxt->npending; i++) {
+			if (is_blocked(cxt, cache, cxt->pending[i], i))
+				continue;
+
+			*fs = cxt->pending[i];
+			cxt->npending--;
+			memmove(&cxt->pending[i], &cxt->pending[i + 1],
+				(cxt->npending - i) * sizeof(*cxt->pending));
+			/* still referenced by fstab */
+			mnt_unref_fs(*fs);
+			return 0;
+		}
+		if (!wait || cxt->nrunning == 0)
+			break;
+		rc = wait_for_any_child(cxt);
+		if (rc)
+			return rc;
+	}
+	return 1;
+}
+
+/*
+ * "mount -a --parallel": waits until the number of running children is below
+ * the limit.
+ */
+int mnt_context_wait_for_slot(struct libmnt_context *cxt)
+{
+	assert(cxt);
+	assert(mnt_context_is_parent(cxt));
+
+	while (cxt->nrunning > 0 && cxt->nrunning >= cxt->max_children) {
+		int rc;
+
+		DBG(CXT, ul_debugobj(cxt, "waiting for slot [running=%d]",
+					cxt->nrunning));
+		rc = wait_for_any_child(cxt);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
 int mnt_context_wait_for_children(struct libmnt_context *cxt,
 				  int *nchildren, int *nerrs)
 {
+	size_t j;
 	int i;
 
 	if (!cxt)
@@ -2985,35 +3337,32 @@ int mnt_context_wait_for_children(struct libmnt_context *cxt,
 	assert(mnt_context_is_parent(cxt));
 
 	for (i = 0; i < cxt->nchildren; i++) {
-		pid_t pid = cxt->children[i];
-		int rc = 0, ret = 0;
+		struct libmnt_child *ch = &cxt->children[i];
 
-		if (!pid)
-			continue;
-		do {
-			DBG(CXT, ul_debugobj(cxt,
-					"waiting for child (%d/%d): %d",
-					i + 1, cxt->nchildren, pid));
-			errno = 0;
-			rc = waitpid(pid, &ret, 0);
-
-		} while (rc == -1 && errno == EINTR);
+		if (ch->fs)
+			wait_for_child(cxt, ch);
 
 		if (nchildren)
 			(*nchildren)++;
 
-		if (rc != -1 && nerrs) {
-			if (WIFEXITED(ret))
-				(*nerrs) += WEXITSTATUS(ret) == 0 ? 0 : 1;
+		if (ch->status != -1 && nerrs) {
+			if (WIFEXITED(ch->status))
+				(*nerrs) += WEXITSTATUS(ch->status) == 0 ? 0 : 1;
 			else
 				(*nerrs)++;
 		}
-		cxt->children[i] = 0;
 	}
 
 	cxt->nchildren = 0;
+	cxt->nrunning = 0;
 	free(cxt->children);
 	cxt->children = NULL;
+
+	for (j = 0; j < cxt->npending; j++)
+		mnt_unref_fs(cxt->pending[j]);
+	cxt->npending = 0;
+	free(cxt->pending);
+	cxt->pending = NULL;
 	return 0;
 }
 
@@ -40,7 +40,8 @@ int mnt_context_is_loopdev(struct libmnt_context *cxt)
 
 	if (cxt->user_mountflags & (MNT_MS_LOOP |
 				    MNT_MS_OFFSET |
-				    MNT_MS_SIZELIMIT)) {
+				    MNT_MS_SIZELIMIT |
+				    MNT_MS_LOOP_AUTOTUNE)) {
 
 		DBG(LOOP, ul_debugobj(cxt, "loopdev specific options detected"));
 		return 1;
@@ -334,6 +335,10 @@ int mnt_context_setup_loopdev(struct libmnt_context *cxt)
 			DBG(LOOP, ul_debugobj(cxt, "failed to set loop attributes"));
 			goto done;
 		}
+		/* not fatal, the device is set up without direct I/O */
+		if ((cxt->user_mountflags & MNT_MS_LOOP_AUTOTUNE) &&
+		    loopcxt_autotune(&lc) < 0)
+			DBG(LOOP, ul_debugobj(cxt, "failed to probe direct I/O"));
 
 		/* setup the device */
 		rc = loopcxt_setup_device(&lc);
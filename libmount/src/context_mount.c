@@ -738,6 +738,7 @@ static int do_mount_additional(struct libmnt_context *cxt,
 				ad->mountflags,
 				ad->mountflags & MS_REC ? " (recursive)" : ""));
 
+		STAT_ADD(MOUNT, 1);
 		rc = mount("none", target, NULL,
 				ad->mountflags | (flags & MS_SILENT), NULL);
 		if (rc) {
@@ -829,6 +830,7 @@ static int do_mount(struct libmnt_context *cxt, const char *try_type)
 		/*
 		 * regular mount
 		 */
+		STAT_ADD(MOUNT, 1);
 		if (mount(src, target, type, flags, cxt->mountdata)) {
 			cxt->syscall_status = -errno;
 			DBG(CXT, ul_debugobj(cxt, "mount(2) failed [errno=%d %m]",
@@ -1359,7 +1361,29 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 	if (rc)
 		return rc;
 
+	/* the first call, resolve all fstab tags at once */
+	if (!itr->head && mnt_context_get_cache(cxt))
+		mnt_cache_resolve_table_tags(mnt_context_get_cache(cxt), fstab);
+
+again:
+	/* mount -a --parallel: start the deferred filesystems first */
+	if (cxt->npending) {
+		rc = mnt_context_next_deferred(cxt, fs, FALSE);
+		if (rc < 0)
+			return rc;
+		if (rc == 0)
+			goto start;
+	}
+
 	rc = mnt_table_next_fs(fstab, itr, fs);
+	if (rc == 1 && cxt->npending) {
+		/* end of fstab, wait until a deferred filesystem is ready */
+		rc = mnt_context_next_deferred(cxt, fs, TRUE);
+		if (rc == 0)
+			goto start;
+		if (rc == 1)
+			rc = -EINVAL;	/* deferred, but nothing is running */
+	}
 	if (rc != 0)
 		return rc;	/* more filesystems (or error) */
 
@@ -1416,6 +1440,15 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 		mnt_context_save_template(cxt);
 	}
 
+	/* mount -a --parallel: don't wait for the dependencies here */
+	if (cxt->max_children && mnt_context_is_parent(cxt)) {
+		rc = mnt_context_defer_mount(cxt, *fs);
+		if (rc < 0)
+			return rc;
+		if (rc == 1)
+			goto again;
+	}
+start:
 	/* reset context, but protect mtab */
 	mtab = cxt->mtab;
 	cxt->mtab = NULL;
@@ -1423,7 +1456,12 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 	cxt->mtab = mtab;
 
 	if (mnt_context_is_fork(cxt)) {
-		rc = mnt_fork_context(cxt);
+		if (cxt->max_children) {
+			rc = mnt_context_wait_for_slot(cxt);
+			if (rc)
+				return rc;
+		}
+		rc = mnt_fork_context(cxt, *fs);
 		if (rc)
 			return rc;		/* fork error */
 
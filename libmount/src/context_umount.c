@@ -225,8 +225,7 @@ static int has_utab_entry(struct libmnt_context *cxt, const char *target)
 		cxt->utab = mnt_new_table();
 		if (!cxt->utab)
 			return 0;
-		cxt->utab->fmt = MNT_FMT_UTAB;
-		if (mnt_table_parse_file(cxt->utab, path))
+		if (mnt_table_parse_utab(cxt->utab, path))
 			return 0;
 	}
 
@@ -867,6 +866,7 @@ static int do_umount(struct libmnt_context *cxt)
 	if (mnt_context_is_fake(cxt))
 		rc = 0;
 	else {
+		STAT_ADD(UMOUNT, 1);
 		rc = flags ? umount2(target, flags) : umount(target);
 		if (rc < 0)
 			cxt->syscall_status = -errno;
@@ -1223,6 +1223,220 @@ int mnt_context_next_umount(struct libmnt_context *cxt,
 	return 0;
 }
 
+/* entry of the umount batch, see mnt_context_umount_recursive() */
+struct umount_ent {
+	struct libmnt_fs	*fs;
+	size_t			pos;	/* position in the table */
+	int			parent;	/* index of the parent entry or -1 */
+	int			depth;	/* in the subtree, -1 outside, -2 unknown */
+};
+
+struct umount_id {
+	int	id;
+	int	idx;
+};
+
+static int cmp_umount_id(const void *a, const void *b)
+{
+	const struct umount_id *x = a, *y = b;
+
+	return x->id < y->id ? -1 : x->id > y->id ? 1 : 0;
+}
+
+/* descendants before ancestors, the last mounted first */
+static int cmp_umount_order(const void *a, const void *b)
+{
+	const struct umount_ent *x = *(const struct umount_ent **) a,
+				*y = *(const struct umount_ent **) b;
+
+	if (x->depth != y->depth)
+		return x->depth > y->depth ? -1 : 1;
+	return x->pos > y->pos ? -1 : x->pos < y->pos ? 1 : 0;
+}
+
+/*
+ * Returns @root and all filesystems mounted below @root (including
+ * overmounts) in the umount order.
+ */
+static int get_umount_batch(struct libmnt_table *tb, struct libmnt_fs *root,
+			    struct libmnt_fs ***batch, size_t *nbatch)
+{
+	struct umount_ent *ents = NULL, **order = NULL;
+	struct umount_id *ids = NULL;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	size_t i, n, nents = mnt_table_get_nents(tb);
+	int rc = 0;
+
+	ents = calloc(nents, sizeof(*ents));
+	ids = calloc(nents, sizeof(*ids));
+	order = calloc(nents, sizeof(*order));
+	if (!ents || !ids || !order) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	for (n = 0; n < nents && mnt_table_next_fs(tb, &itr, &fs) == 0; n++) {
+		if (!mnt_fs_get_id(fs)) {
+			rc = -EINVAL;	/* no IDs in mtab file */
+			goto done;
+		}
+		ents[n].fs = fs;
+		ents[n].pos = n;
+		ents[n].depth = fs == root ? 0 : -2;
+		ids[n].id = mnt_fs_get_id(fs);
+		ids[n].idx = n;
+	}
+	nents = n;
+
+	qsort(ids, nents, sizeof(*ids), cmp_umount_id);
+
+	for (i = 0; i < nents; i++) {
+		struct umount_id key = { .id = mnt_fs_get_parent_id(ents[i].fs) },
+				 *p = bsearch(&key, ids, nents, sizeof(*ids), cmp_umount_id);
+
+		ents[i].parent = p && p->idx != (int) i ? p->idx : -1;
+	}
+
+	/* depth in the subtree; walk to the first entry with known depth and
+	 * then again to assign the depths to the path */
+	for (i = 0; i < nents; i++) {
+		int x, depth, len = 0;
+
+		for (x = i; x >= 0 && ents[x].depth == -2 && (size_t) len <= nents;
+		     x = ents[x].parent)
+			len++;
+
+		depth = x < 0 || ents[x].depth < 0 || (size_t) len > nents ? -1 :
+			ents[x].depth + len;
+
+		for (x = i; len > 0; x = ents[x].parent, len--)
+			ents[x].depth = depth < 0 ? -1 : depth--;
+	}
+
+	for (i = 0, n = 0; i < nents; i++) {
+		if (ents[i].depth >= 0)
+			order[n++] = &ents[i];
+	}
+	qsort(order, n, sizeof(*order), cmp_umount_order);
+
+	*batch = calloc(n, sizeof(struct libmnt_fs *));
+	if (!*batch) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	for (i = 0; i < n; i++) {
+		(*batch)[i] = order[i]->fs;
+		mnt_ref_fs(order[i]->fs);
+	}
+	*nbatch = n;
+done:
+	free(ents);
+	free(ids);
+	free(order);
+	return rc;
+}
+
+/**
+ * mnt_context_umount_recursive:
+ * @cxt: context
+ * @target: mountpoint
+ * @cb: callback or NULL
+ *
+ * Umounts @target and all filesystems mounted below it (see umount --recursive).
+ * The mount table is read only once for all the filesystems. The filesystems
+ * are umounted in the reverse topological order (overmounts and submounts
+ * before the parent, the last mounted first).
+ *
+ * The @cb is called after each umount with the current filesystem and the
+ * mnt_context_umount() return code; the context is not reset yet, so the
+ * callback can use mnt_context_get_excode() or mnt_context_get_status(). The
+ * filesystems already umounted by propagation are skipped silently. The
+ * non-zero return code of the callback (or of mnt_context_umount() if the
+ * callback is not specified) stops the batch, except for lazy umount
+ * (mnt_context_enable_lazy()) where all the filesystems are detached and the
+ * first error is returned.
+ *
+ * The context is reset when the function returns.
+ *
+ * Returns: 0 on success, -ENOENT if @target is not mounted, <0 in case of
+ *          error, or non-zero return code of the failed umount (or of @cb).
+ *
+ * Since: ext-1
+ */
+int mnt_context_umount_recursive(struct libmnt_context *cxt,
+				 const char *target,
+				 int (*cb)(struct libmnt_context *, struct libmnt_fs *, int))
+{
+	struct libmnt_table *mtab = NULL;
+	struct libmnt_fs *root, **batch = NULL;
+	struct libmnt_ns *ns_old;
+	size_t i, nbatch = 0;
+	int rc, res = 0;
+
+	if (!cxt || !target)
+		return -EINVAL;
+
+	DBG(CXT, ul_debugobj(cxt, "umount: recursive %s", target));
+
+	rc = mnt_context_get_mtab(cxt, &mtab);
+	if (rc)
+		return rc;
+	mnt_ref_table(mtab);
+
+	ns_old = mnt_context_switch_target_ns(cxt);
+	if (!ns_old) {
+		rc = -MNT_ERR_NAMESPACE;
+		goto done;
+	}
+	root = mnt_table_find_target(mtab, target, MNT_ITER_BACKWARD);
+	if (root)
+		rc = get_umount_batch(mtab, root, &batch, &nbatch);
+	else
+		rc = -ENOENT;
+	if (!mnt_context_switch_ns(cxt, ns_old) && !rc)
+		rc = -MNT_ERR_NAMESPACE;
+	if (rc)
+		goto done;
+
+	DBG(CXT, ul_debugobj(cxt, "umount: batch of %zu filesystems", nbatch));
+
+	for (i = 0; i < nbatch; i++) {
+		struct libmnt_fs *fs = batch[i];
+
+		/* keep mtab for the next mnt_context_umount() */
+		mnt_ref_table(mtab);
+		mnt_reset_context(cxt);
+		cxt->mtab = mtab;
+
+		rc = mnt_context_set_fs(cxt, fs);
+		if (!rc)
+			rc = mnt_context_umount(cxt);
+
+		if (rc && fs != root
+		    && mnt_context_syscall_called(cxt)
+		    && mnt_context_get_syscall_errno(cxt) == EINVAL) {
+			DBG(CXT, ul_debugobj(cxt, "umount: %s already umounted",
+						mnt_fs_get_target(fs)));
+			continue;
+		}
+		if (cb)
+			rc = cb(cxt, fs, rc);
+		if (rc && !res)
+			res = rc;
+		if (rc && !mnt_context_is_lazy(cxt))
+			break;
+	}
+	rc = res;
+done:
+	for (i = 0; i < nbatch; i++)
+		mnt_unref_fs(batch[i]);
+	free(batch);
+	mnt_unref_table(mtab);
+	mnt_reset_context(cxt);
+	return rc;
+}
 
 int mnt_context_get_umount_excode(
 			struct libmnt_context *cxt,
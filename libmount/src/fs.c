@@ -40,9 +40,90 @@ struct libmnt_fs *mnt_new_fs(void)
 	fs->refcount = 1;
 	INIT_LIST_HEAD(&fs->ents);
 	DBG(FS, ul_debugobj(fs, "alloc"));
+	STAT_ADD(FS_ALLOC, 1);
 	return fs;
 }
 
+/*
+ * The string buffer is used by the mountinfo parser -- the strings of the
+ * parsed entries point to one buffer (see __mnt_fs_unshare()). The buffer is
+ * deallocated when the last entry is deallocated.
+ */
+struct libmnt_strbuf *mnt_new_strbuf(char *data, size_t size)
+{
+	struct libmnt_strbuf *sb = calloc(1, sizeof(*sb));
+
+	if (!sb)
+		return NULL;
+	sb->refcount = 1;
+	sb->data = data;
+	sb->size = size;
+	return sb;
+}
+
+void mnt_ref_strbuf(struct libmnt_strbuf *sb)
+{
+	if (sb)
+		sb->refcount++;
+}
+
+void mnt_unref_strbuf(struct libmnt_strbuf *sb)
+{
+	if (sb && --sb->refcount <= 0) {
+		free(sb->data);
+		free(sb);
+	}
+}
+
+static inline int is_shared_str(struct libmnt_fs *fs, const char *str)
+{
+	return fs->strbuf && str
+		&& str >= fs->strbuf->data
+		&& str < fs->strbuf->data + fs->strbuf->size;
+}
+
+/* free() for @fs strings */
+static inline void free_str(struct libmnt_fs *fs, char *str)
+{
+	if (!is_shared_str(fs, str))
+		free(str);
+}
+
+static int merge_lazy_options(struct libmnt_fs *fs);
+
+/*
+ * Allocates private copies of the strings from the shared string buffer, must
+ * be called before any in-place modification of the strings.
+ */
+int __mnt_fs_unshare(struct libmnt_fs *fs)
+{
+	char **strs[] = {
+		&fs->source, &fs->root, &fs->target, &fs->fstype, &fs->optstr,
+		&fs->vfs_optstr, &fs->opt_fields, &fs->fs_optstr
+	};
+	size_t i;
+
+	if (merge_lazy_options(fs) != 0)
+		return -ENOMEM;
+	if (!fs->strbuf)
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(strs); i++) {
+		char *p;
+
+		if (!is_shared_str(fs, *strs[i]))
+			continue;
+		p = strdup(*strs[i]);
+		if (!p)
+			return -ENOMEM;
+		*strs[i] = p;
+	}
+
+	mnt_unref_strbuf(fs->strbuf);
+	fs->strbuf = NULL;
+	return 0;
+}
+
 /**
  * mnt_free_fs:
  * @fs: fs pointer
@@ -78,22 +159,25 @@ void mnt_reset_fs(struct libmnt_fs *fs)
 
 	ref = fs->refcount;
 
+	mnt_table_reset_index(fs->tab);
 	list_del(&fs->ents);
-	free(fs->source);
+	free_str(fs, fs->source);
 	free(fs->bindsrc);
 	free(fs->tagname);
 	free(fs->tagval);
-	free(fs->root);
+	free_str(fs, fs->root);
 	free(fs->swaptype);
-	free(fs->target);
-	free(fs->fstype);
-	free(fs->optstr);
-	free(fs->vfs_optstr);
-	free(fs->fs_optstr);
+	free_str(fs, fs->target);
+	free_str(fs, fs->fstype);
+	free_str(fs, fs->optstr);
+	free_str(fs, fs->vfs_optstr);
+	free_str(fs, fs->fs_optstr);
 	free(fs->user_optstr);
 	free(fs->attrs);
-	free(fs->opt_fields);
+	mnt_free_opttoks(fs->opttoks);
+	free_str(fs, fs->opt_fields);
 	free(fs->comment);
+	mnt_unref_strbuf(fs->strbuf);
 
 	memset(fs, 0, sizeof(*fs));
 	INIT_LIST_HEAD(&fs->ents);
@@ -192,10 +276,12 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 			return NULL;
 
 		dest->tab	 = NULL;
-	}
+	} else
+		mnt_table_reset_index(dest->tab);
 
 	dest->id         = src->id;
 	dest->parent     = src->parent;
+	dest->uniq_id    = src->uniq_id;
 	dest->devno      = src->devno;
 	dest->tid        = src->tid;
 
@@ -233,6 +319,8 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 	dest->usedsize   = src->usedsize;
 	dest->priority   = src->priority;
 
+	if (merge_lazy_options(dest) != 0)
+		goto err;
 	return dest;
 err:
 	if (!org)
@@ -287,7 +375,7 @@ struct libmnt_fs *mnt_copy_mtab_fs(const struct libmnt_fs *fs)
 
 	n->freq       = fs->freq;
 	n->passno     = fs->passno;
-	n->flags      = fs->flags;
+	n->flags      = fs->flags & ~MNT_FS_LAZYOPTS;
 
 	return n;
 err:
@@ -380,7 +468,9 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	}
 
 	if (fs->source != source)
-		free(fs->source);
+		free_str(fs, fs->source);
+
+	mnt_table_reset_index(fs->tab);
 
 	free(fs->tagname);
 	free(fs->tagval);
@@ -549,6 +639,11 @@ const char *mnt_fs_get_target(struct libmnt_fs *fs)
  */
 int mnt_fs_set_target(struct libmnt_fs *fs, const char *tgt)
 {
+	if (!fs)
+		return -EINVAL;
+	mnt_table_reset_index(fs->tab);
+	if (__mnt_fs_unshare(fs))
+		return -ENOMEM;
 	return strdup_to_struct_member(fs, target, tgt);
 }
 
@@ -653,7 +748,7 @@ int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 	assert(fs);
 
 	if (fstype != fs->fstype)
-		free(fs->fstype);
+		free_str(fs, fs->fstype);
 
 	fs->fstype = fstype;
 	fs->flags &= ~MNT_FS_PSEUDO;
@@ -695,6 +790,40 @@ int mnt_fs_set_fstype(struct libmnt_fs *fs, const char *fstype)
 	return  __mnt_fs_set_fstype_ptr(fs, p);
 }
 
+/*
+ * Merges @vfs and @fs to @res (see merge_optstr()), the @res buffer has to
+ * be at least strlen(vfs) + strlen(fs) + 5 bytes.
+ */
+static char *merge_optstr_to(const char *vfs, const char *fs, char *res)
+{
+	size_t vsz = strlen(vfs), fsz = strlen(fs);
+	char *p;
+	int ro = 0, rw = 0;
+
+	p = res + 3;			/* make a room for rw/ro flag */
+
+	memcpy(p, vfs, vsz);
+	p[vsz] = ',';
+	memcpy(p + vsz + 1, fs, fsz + 1);
+
+	/* remove 'rw' flags */
+	rw += !mnt_optstr_remove_option(&p, "rw");	/* from vfs */
+	rw += !mnt_optstr_remove_option(&p, "rw");	/* from fs */
+
+	/* remove 'ro' flags if necessary */
+	if (rw != 2) {
+		ro += !mnt_optstr_remove_option(&p, "ro");
+		if (ro + rw < 2)
+			ro += !mnt_optstr_remove_option(&p, "ro");
+	}
+
+	if (!strlen(p))
+		memcpy(res, ro ? "ro" : "rw", 3);
+	else
+		memcpy(res, ro ? "ro," : "rw,", 3);
+	return res;
+}
+
 /*
  * Merges @vfs and @fs options strings into a new string.
  * This function cares about 'ro/rw' options. The 'ro' is
@@ -711,9 +840,8 @@ int mnt_fs_set_fstype(struct libmnt_fs *fs, const char *fstype)
  */
 static char *merge_optstr(const char *vfs, const char *fs)
 {
-	char *res, *p;
+	char *res;
 	size_t sz;
-	int ro = 0, rw = 0;
 
 	if (!vfs && !fs)
 		return NULL;
@@ -727,26 +855,29 @@ static char *merge_optstr(const char *vfs, const char *fs)
 	res = malloc(sz);
 	if (!res)
 		return NULL;
-	p = res + 3;			/* make a room for rw/ro flag */
+	return merge_optstr_to(vfs, fs, res);
+}
 
-	snprintf(p, sz - 3, "%s,%s", vfs, fs);
+/*
+ * The mountinfo parser does not merge VFS and FS options, the merged options
+ * string is generated on the first access (see MNT_FS_LAZYOPTS).
+ */
+static int merge_lazy_options(struct libmnt_fs *fs)
+{
+	char *p;
 
-	/* remove 'rw' flags */
-	rw += !mnt_optstr_remove_option(&p, "rw");	/* from vfs */
-	rw += !mnt_optstr_remove_option(&p, "rw");	/* from fs */
+	if (!(fs->flags & MNT_FS_LAZYOPTS))
+		return 0;
 
-	/* remove 'ro' flags if necessary */
-	if (rw != 2) {
-		ro += !mnt_optstr_remove_option(&p, "ro");
-		if (ro + rw < 2)
-			ro += !mnt_optstr_remove_option(&p, "ro");
-	}
+	errno = 0;
+	p = merge_optstr(fs->vfs_optstr, fs->fs_optstr);
+	if (!p && errno)
+		return -ENOMEM;
 
-	if (!strlen(p))
-		memcpy(res, ro ? "ro" : "rw", 3);
-	else
-		memcpy(res, ro ? "ro," : "rw,", 3);
-	return res;
+	free_str(fs, fs->optstr);
+	fs->optstr = p;
+	fs->flags &= ~MNT_FS_LAZYOPTS;
+	return 0;
 }
 
 /**
@@ -788,7 +919,9 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_options(struct libmnt_fs *fs)
 {
-	return fs ? fs->optstr : NULL;
+	if (!fs || merge_lazy_options(fs) != 0)
+		return NULL;
+	return fs->optstr;
 }
 
 /**
@@ -832,15 +965,16 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 		}
 	}
 
-	free(fs->fs_optstr);
-	free(fs->vfs_optstr);
+	free_str(fs, fs->fs_optstr);
+	free_str(fs, fs->vfs_optstr);
 	free(fs->user_optstr);
-	free(fs->optstr);
+	free_str(fs, fs->optstr);
 
 	fs->fs_optstr = f;
 	fs->vfs_optstr = v;
 	fs->user_optstr = u;
 	fs->optstr = n;
+	fs->flags &= ~MNT_FS_LAZYOPTS;
 
 	return 0;
 }
@@ -866,6 +1000,8 @@ int mnt_fs_append_options(struct libmnt_fs *fs, const char *optstr)
 		return -EINVAL;
 	if (!optstr)
 		return 0;
+	if (__mnt_fs_unshare(fs))
+		return -ENOMEM;
 
 	rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
 	if (rc)
@@ -908,6 +1044,8 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
 		return -EINVAL;
 	if (!optstr)
 		return 0;
+	if (__mnt_fs_unshare(fs))
+		return -ENOMEM;
 
 	rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
 	if (rc)
@@ -1134,6 +1272,10 @@ const char *mnt_fs_get_root(struct libmnt_fs *fs)
  */
 int mnt_fs_set_root(struct libmnt_fs *fs, const char *path)
 {
+	if (!fs)
+		return -EINVAL;
+	if (__mnt_fs_unshare(fs))
+		return -ENOMEM;
 	return strdup_to_struct_member(fs, root, path);
 }
 
@@ -1243,6 +1385,22 @@ int mnt_fs_get_parent_id(struct libmnt_fs *fs)
 	return fs ? fs->parent : -EINVAL;
 }
 
+/**
+ * mnt_fs_get_unique_id:
+ * @fs: filesystem from mnt_table_parse_listmount()
+ *
+ * The unique mount ID is never reused by the kernel. It's not available in
+ * /proc/self/mountinfo.
+ *
+ * Returns: unique mount ID or 0 if not available.
+ *
+ * Since: ext-1
+ */
+uint64_t mnt_fs_get_unique_id(struct libmnt_fs *fs)
+{
+	return fs ? fs->uniq_id : 0;
+}
+
 /**
  * mnt_fs_get_devno:
  * @fs: /proc/self/mountinfo entry
@@ -1516,7 +1674,11 @@ int mnt_fs_match_fstype(struct libmnt_fs *fs, const char *types)
  */
 int mnt_fs_match_options(struct libmnt_fs *fs, const char *options)
 {
-	return mnt_match_options(mnt_fs_get_options(fs), options);
+	if (!fs)
+		return mnt_match_options(NULL, options);
+
+	return mnt_opttoks_match_options(&fs->opttoks,
+				mnt_fs_get_options(fs), options);
 }
 
 /**
@@ -13,7 +13,7 @@
 /**
  * SECTION: init
  * @title: Library initialization
- * @short_description: initialize debugging
+ * @short_description: initialize debugging and statistics
  */
 
 #include <stdarg.h>
@@ -42,6 +42,28 @@ UL_DEBUG_DEFINE_MASKNAMES(libmount) =
 	{ NULL, 0 }
 };
 
+UL_DEBUG_DEFINE_STATS(libmount, __MNT_STAT_COUNT);
+UL_DEBUG_DEFINE_STATNAMES(libmount) =
+{
+	[MNT_STAT_TAB_ALLOC]	  = { "tab-alloc",	"allocated tables" },
+	[MNT_STAT_FS_ALLOC]	  = { "fs-alloc",	"allocated filesystem entries" },
+	[MNT_STAT_TAB_PARSE]	  = { "tab-parse",	"parsed files and streams" },
+	[MNT_STAT_TAB_PARSE_NS]	  = { "tab-parse-ns",	"nanoseconds spent in parser" },
+	[MNT_STAT_TAB_READ_BYTES] = { "tab-read-bytes",	"bytes read by parser" },
+	[MNT_STAT_LISTMOUNT]	  = { "listmount",	"listmount(2) calls" },
+	[MNT_STAT_STATMOUNT]	  = { "statmount",	"statmount(2) calls" },
+	[MNT_STAT_CACHE_HITS]	  = { "cache-hits",	"paths resolved by cache" },
+	[MNT_STAT_CANONICALIZE]	  = { "canonicalize",	"canonicalized paths" },
+	[MNT_STAT_MOUNT]	  = { "mount",		"mount(2) calls" },
+	[MNT_STAT_UMOUNT]	  = { "umount",		"umount(2) calls" },
+};
+
+static void mnt_print_stats(void)
+{
+	ul_debug_print_stats("libmount", UL_DEBUG_STATNAMES(libmount),
+			UL_DEBUG_STATS(libmount), __MNT_STAT_COUNT);
+}
+
 /**
  * mnt_init_debug:
  * @mask: debug mask (0xffff to enable full debugging)
@@ -51,6 +73,10 @@ UL_DEBUG_DEFINE_MASKNAMES(libmount) =
  *
  * Already initialized debugging stuff cannot be changed. Calling
  * this function twice has no effect.
+ *
+ * The function also reads the LIBMOUNT_STATS environment variable; if set
+ * to a non-zero value, the statistics are enabled (see mnt_enable_stats())
+ * and printed to stderr at exit.
  */
 void mnt_init_debug(int mask)
 {
@@ -58,6 +84,7 @@ void mnt_init_debug(int mask)
 		return;
 
 	__UL_INIT_DEBUG_FROM_ENV(libmount, MNT_DEBUG_, mask, LIBMOUNT_DEBUG);
+	__UL_INIT_STATS_FROM_ENV(libmount, LIBMOUNT_STATS, mnt_print_stats);
 
 	if (libmount_debug_mask != MNT_DEBUG_INIT
 	    && libmount_debug_mask != (MNT_DEBUG_HELP|MNT_DEBUG_INIT)) {
@@ -78,6 +105,60 @@ void mnt_init_debug(int mask)
 				UL_DEBUG_MASKNAMES(libmount)));
 }
 
+/**
+ * mnt_enable_stats:
+ * @enable: TRUE or FALSE
+ *
+ * Enables or disables the library statistics counters. The counters are
+ * global for all the library objects (tables, contexts, caches, ...) and
+ * all threads. The counters are not reset, see mnt_reset_stats().
+ *
+ * Returns: 0 on success.
+ *
+ * Since: ext-1
+ */
+int mnt_enable_stats(int enable)
+{
+	libmount_stats_enabled = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * mnt_reset_stats:
+ *
+ * Sets all the statistics counters to zero.
+ *
+ * Since: ext-1
+ */
+void mnt_reset_stats(void)
+{
+	size_t i;
+
+	for (i = 0; i < __MNT_STAT_COUNT; i++)
+		__atomic_store_n(&libmount_stats[i], 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * mnt_get_stat:
+ * @idx: counter number
+ * @name: returns name of the counter (or NULL)
+ * @value: returns value of the counter (or NULL)
+ *
+ * Returns the statistics counter, see mnt_enable_stats(). The names are
+ * the same as printed for the LIBMOUNT_STATS environment variable, the
+ * counters with "-ns" suffix are in nanoseconds.
+ *
+ * Returns: 0 on success, 1 if @idx is out of range.
+ *
+ * Since: ext-1
+ */
+int mnt_get_stat(size_t idx, const char **name, unsigned long long *value)
+{
+	return ul_debug_get_stat(UL_DEBUG_STATNAMES(libmount),
+			UL_DEBUG_STATS(libmount), __MNT_STAT_COUNT,
+			idx, name, value);
+}
+
 #ifdef TEST_PROGRAM
 
 #include <errno.h>
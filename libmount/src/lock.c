@@ -40,10 +40,12 @@ struct libmnt_lock {
 	char	*lockfile;	/* path to lock file (e.g. /etc/mtab~) */
 	char	*linkfile;	/* path to link file (e.g. /etc/mtab~.<id>) */
 	int	lockfile_fd;	/* lock file descriptor */
+	unsigned long wait_usec;	/* time spent waiting for the lock */
 
 	unsigned int	locked :1,	/* do we own the lock? */
 			sigblock :1,	/* block signals when locked */
-			simplelock :1;	/* use flock rather than normal mtab lock */
+			simplelock :1,	/* use flock rather than normal mtab lock */
+			shared :1;	/* shared flock for readers */
 
 	sigset_t oldsigmask;
 };
@@ -207,6 +209,34 @@ int mnt_lock_use_simplelock(struct libmnt_lock *ml, int enable)
 	return 0;
 }
 
+/* don't export this to API
+ *
+ * The shared lock is usable for flock only (see mnt_lock_use_simplelock()).
+ * It's used by the utab readers to not read the file while an updater
+ * appends to the file. The readers don't create the lock file and don't
+ * block signals.
+ */
+int mnt_lock_use_shared(struct libmnt_lock *ml, int enable)
+{
+	if (!ml)
+		return -EINVAL;
+	if (enable && !ml->simplelock)
+		return -EINVAL;
+
+	DBG(LOCKS, ul_debugobj(ml, "shared: %s", enable ? "ENABLED" : "DISABLED"));
+	ml->shared = enable ? 1 : 0;
+	return 0;
+}
+
+static unsigned long usec_since(const struct timeval *start)
+{
+	struct timeval now = { 0 }, diff;
+
+	gettime_monotonic(&now);
+	timersub(&now, start, &diff);
+	return (unsigned long) diff.tv_sec * 1000000UL + diff.tv_usec;
+}
+
 /*
  * Returns path to lockfile.
  */
@@ -244,8 +274,9 @@ static void unlock_simplelock(struct libmnt_lock *ml)
 static int lock_simplelock(struct libmnt_lock *ml)
 {
 	const char *lfile;
-	int rc;
+	int rc, op = ml->shared ? LOCK_SH : LOCK_EX;
 	struct stat sb;
+	struct timeval start = { 0 };
 	const mode_t lock_mask = S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH;
 
 	assert(ml);
@@ -253,37 +284,51 @@ static int lock_simplelock(struct libmnt_lock *ml)
 
 	lfile = mnt_lock_get_lockfile(ml);
 
-	DBG(LOCKS, ul_debugobj(ml, "%s: locking", lfile));
+	DBG(LOCKS, ul_debugobj(ml, "%s: locking (%s)", lfile,
+				ml->shared ? "shared" : "exclusive"));
 
-	if (ml->sigblock) {
+	if (ml->sigblock && !ml->shared) {
 		sigset_t sigs;
 		sigemptyset(&ml->oldsigmask);
 		sigfillset(&sigs);
 		sigprocmask(SIG_BLOCK, &sigs, &ml->oldsigmask);
 	}
 
-	ml->lockfile_fd = open(lfile, O_RDONLY|O_CREAT|O_CLOEXEC,
+	if (ml->shared)
+		/* readers don't create the file, it's usually not writable */
+		ml->lockfile_fd = open(lfile, O_RDONLY|O_CLOEXEC);
+	else
+		ml->lockfile_fd = open(lfile, O_RDONLY|O_CREAT|O_CLOEXEC,
 				      S_IWUSR|S_IRUSR|S_IRGRP|S_IROTH);
 	if (ml->lockfile_fd < 0) {
 		rc = -errno;
 		goto err;
 	}
 
-	rc = fstat(ml->lockfile_fd, &sb);
-	if (rc < 0) {
-		rc = -errno;
-		goto err;
-	}
-
-	if ((sb.st_mode & lock_mask) != lock_mask) {
-		rc = fchmod(ml->lockfile_fd, lock_mask);
+	if (!ml->shared) {
+		rc = fstat(ml->lockfile_fd, &sb);
 		if (rc < 0) {
 			rc = -errno;
 			goto err;
 		}
+
+		if ((sb.st_mode & lock_mask) != lock_mask) {
+			rc = fchmod(ml->lockfile_fd, lock_mask);
+			if (rc < 0) {
+				rc = -errno;
+				goto err;
+			}
+		}
 	}
 
-	while (flock(ml->lockfile_fd, LOCK_EX) < 0) {
+	/* don't measure anything if the lock is not used by another process */
+	if (flock(ml->lockfile_fd, op | LOCK_NB) == 0)
+		goto locked;
+
+	gettime_monotonic(&start);
+	DBG(LOCKS, ul_debugobj(ml, "%s: contention, waiting", lfile));
+
+	while (flock(ml->lockfile_fd, op) < 0) {
 		int errsv;
 		if ((errno == EAGAIN) || (errno == EINTR))
 			continue;
@@ -293,10 +338,17 @@ static int lock_simplelock(struct libmnt_lock *ml)
 		rc = -errsv;
 		goto err;
 	}
+	ml->wait_usec = usec_since(&start);
+	DBG(LOCKS, ul_debugobj(ml, "%s: locked after %lu usec", lfile, ml->wait_usec));
+locked:
 	ml->locked = 1;
 	return 0;
 err:
-	if (ml->sigblock)
+	if (ml->lockfile_fd >= 0) {
+		close(ml->lockfile_fd);
+		ml->lockfile_fd = -1;
+	}
+	if (ml->sigblock && !ml->shared)
 		sigprocmask(SIG_SETMASK, &ml->oldsigmask, NULL);
 	return rc;
 }
@@ -434,9 +486,9 @@ static void unlock_mtab(struct libmnt_lock *ml)
 
 static int lock_mtab(struct libmnt_lock *ml)
 {
-	int i, rc = -1;
+	int i, rc = -1, waited = 0;
 	struct timespec waittime = { 0 };;
-	struct timeval maxtime = { 0 };
+	struct timeval maxtime = { 0 }, start = { 0 };
 	const char *lockfile, *linkfile;
 
 	if (!ml)
@@ -476,7 +528,8 @@ static int lock_mtab(struct libmnt_lock *ml)
 	}
 	close(i);
 
-	gettime_monotonic(&maxtime);
+	gettime_monotonic(&start);
+	maxtime = start;
 	maxtime.tv_sec += MOUNTLOCK_MAXTIME;
 
 	waittime.tv_sec = 0;
@@ -531,6 +584,7 @@ static int lock_mtab(struct libmnt_lock *ml)
 		/* Someone else made the link. Wait. */
 		int err = mnt_wait_mtab_lock(ml, &flock, maxtime.tv_sec);
 
+		waited = 1;
 		if (err == 1) {
 			DBG(LOCKS, ul_debugobj(ml,
 				"%s: can't create link: time out (perhaps "
@@ -546,6 +600,11 @@ static int lock_mtab(struct libmnt_lock *ml)
 		close(ml->lockfile_fd);
 		ml->lockfile_fd = -1;
 	}
+	if (waited) {
+		ml->wait_usec = usec_since(&start);
+		DBG(LOCKS, ul_debugobj(ml, "%s: locked after %lu usec",
+					lockfile, ml->wait_usec));
+	}
 	DBG(LOCKS, ul_debugobj(ml, "%s: (%d) successfully locked",
 					lockfile, getpid()));
 	unlink(linkfile);
@@ -575,7 +634,10 @@ failed:
  *
  * Note that when the lock is used by mnt_update_table() interface then libmount
  * uses flock() for private library file /run/mount/utab. The fcntl(2) is used only
- * for backwardly compatible stuff like /etc/mtab.
+ * for backwardly compatible stuff like /etc/mtab. The utab readers use a shared
+ * flock(), so they wait for updaters only and not for other readers.
+ *
+ * The time spent waiting for the lock is reported by LIBMOUNT_DEBUG=locks.
  *
  * Returns: 0 on success or negative number in case of error (-ETIMEOUT is case
  * of stale lock file).
@@ -585,6 +647,7 @@ int mnt_lock_file(struct libmnt_lock *ml)
 	if (!ml)
 		return -EINVAL;
 
+	ml->wait_usec = 0;
 	if (ml->simplelock)
 		return lock_simplelock(ml);
 
@@ -614,7 +677,7 @@ void mnt_unlock_file(struct libmnt_lock *ml)
 	ml->locked = 0;
 	ml->lockfile_fd = -1;
 
-	if (ml->sigblock) {
+	if (ml->sigblock && !ml->shared) {
 		DBG(LOCKS, ul_debugobj(ml, "restoring sigmask"));
 		sigprocmask(SIG_SETMASK, &ml->oldsigmask, NULL);
 	}
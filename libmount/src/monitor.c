@@ -38,7 +38,10 @@
 #include "fileutils.h"
 #include "mountP.h"
 #include "pathnames.h"
+#include "monotonic.h"
+#include "strutils.h"
 
+#include <inttypes.h>
 #include <sys/inotify.h>
 #include <sys/epoll.h>
 
@@ -65,6 +68,9 @@ struct libmnt_monitor {
 
 	struct list_head	ents;
 
+	uint64_t		coalesce_usec;	/* see mnt_monitor_set_coalesce_usec() */
+	uint64_t		nsuppressed;	/* number of coalesced events */
+
 	unsigned int		kernel_veiled: 1;
 };
 
@@ -583,6 +589,53 @@ int mnt_monitor_veil_kernel(struct libmnt_monitor *mn, int enable)
 	return 0;
 }
 
+/**
+ * mnt_monitor_set_coalesce_usec:
+ * @mn: monitor instance
+ * @usec: coalescing window in microseconds, or 0 to disable
+ *
+ * Many mount operations in a short time (for example, when containers are
+ * started) generate an event for each operation. If the window is set, then
+ * mnt_monitor_wait() does not return immediately after the first event, but
+ * it collects all events within @usec microseconds after the first event and
+ * returns only once. The repeated events for the same monitored file are
+ * reported by mnt_monitor_next_change() only once, see
+ * mnt_monitor_get_suppressed().
+ *
+ * The window is not part of the mnt_monitor_wait() timeout and it's not used
+ * if the top-level monitor file descriptor is used by the application
+ * directly.
+ *
+ * Return: 0 on success and <0 on error.
+ *
+ * Since: ext-1
+ */
+int mnt_monitor_set_coalesce_usec(struct libmnt_monitor *mn, uint64_t usec)
+{
+	if (!mn)
+		return -EINVAL;
+
+	mn->coalesce_usec = usec;
+	return 0;
+}
+
+/**
+ * mnt_monitor_get_suppressed:
+ * @mn: monitor instance
+ *
+ * Returns the number of events merged to already pending changes by the
+ * coalescing window (see mnt_monitor_set_coalesce_usec()) since the monitor
+ * has been created.
+ *
+ * Return: number of events.
+ *
+ * Since: ext-1
+ */
+uint64_t mnt_monitor_get_suppressed(struct libmnt_monitor *mn)
+{
+	return mn ? mn->nsuppressed : 0;
+}
+
 /*
  * Add/Remove monitor entry to/from monitor epoll.
  */
@@ -720,6 +773,49 @@ err:
 	return rc;
 }
 
+/*
+ * Collects all events within the coalescing window after the first event.
+ */
+static void monitor_coalesce_events(struct libmnt_monitor *mn)
+{
+	struct timeval now, end, wait = {
+		.tv_sec = mn->coalesce_usec / 1000000,
+		.tv_usec = mn->coalesce_usec % 1000000
+	};
+
+	gettime_monotonic(&now);
+	timeradd(&now, &wait, &end);
+
+	while (timercmp(&now, &end, <)) {
+		struct monitor_entry *me;
+		struct epoll_event events[1];
+		int rc, timeout;
+
+		timersub(&end, &now, &wait);
+		timeout = wait.tv_sec * 1000 + (wait.tv_usec + 999) / 1000;
+
+		rc = epoll_wait(mn->fd, events, 1, timeout);
+		if (rc < 0 && errno != EINTR)
+			break;
+		if (rc == 0)
+			break;			/* window expired */
+
+		gettime_monotonic(&now);
+		if (rc < 0)
+			continue;
+
+		me = (struct monitor_entry *) events[0].data.ptr;
+		if (!me || (me->opers->op_event_verify &&
+			    me->opers->op_event_verify(mn, me) != 1))
+			continue;
+		if (me->changed)
+			mn->nsuppressed++;
+		me->changed = 1;
+	}
+
+	DBG(MONITOR, ul_debugobj(mn, "coalesced (%" PRIu64 " suppressed)", mn->nsuppressed));
+}
+
 /**
  * mnt_monitor_wait:
  * @mn: monitor
@@ -727,7 +823,9 @@ err:
  *
  * Waits for the next change, after the event it's recommended to use
  * mnt_monitor_next_change() to get more details about the change and to
- * avoid false positive events.
+ * avoid false positive events. If the coalescing window is set (see
+ * mnt_monitor_set_coalesce_usec()), then the function returns after the
+ * window.
  *
  * Returns: 1 success (something changed), 0 timeout, <0 error.
  */
@@ -765,6 +863,9 @@ int mnt_monitor_wait(struct libmnt_monitor *mn, int timeout)
 		}
 	} while (1);
 
+	if (mn->coalesce_usec)
+		monitor_coalesce_events(mn);
+
 	return 1;			/* success */
 }
 
@@ -892,6 +993,9 @@ static struct libmnt_monitor *create_test_monitor(int argc, char *argv[])
 			}
 		} else if (strcmp(argv[i], "veil") == 0) {
 			mnt_monitor_veil_kernel(mn, 1);
+		} else if (strncmp(argv[i], "coalesce=", 9) == 0) {
+			mnt_monitor_set_coalesce_usec(mn,
+				strtou64_or_err(argv[i] + 9, "failed to parse window"));
 		}
 	}
 	if (i == 1) {
@@ -1002,6 +1106,9 @@ static int test_wait(struct libmnt_test *ts, int argc, char *argv[])
 		while (mnt_monitor_next_change(mn, &filename, NULL) == 0)
 			printf(" %s: change detected\n", filename);
 
+		if (mnt_monitor_get_suppressed(mn))
+			printf(" %" PRIu64 " events suppressed\n",
+					mnt_monitor_get_suppressed(mn));
 		printf("waiting for changes...\n");
 	}
 	mnt_unref_monitor(mn);
@@ -1013,7 +1120,7 @@ int main(int argc, char *argv[])
 	struct libmnt_test tss[] = {
 		{ "--epoll", test_epoll, "<userspace kernel veil ...>  monitor in epoll" },
 		{ "--epoll-clean", test_epoll_cleanup, "<userspace kernel veil ...>  monitor in epoll and clean events" },
-		{ "--wait",  test_wait,  "<userspace kernel veil ...>  monitor wait function" },
+		{ "--wait",  test_wait,  "<userspace kernel veil coalesce=<usec> ...>  monitor wait function" },
 		{ NULL }
 	};
 
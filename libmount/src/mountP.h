@@ -58,6 +58,29 @@ UL_DEBUG_DECLARE_MASK(libmount);
 #define UL_DEBUG_CURRENT_MASK	UL_DEBUG_MASK(libmount)
 #include "debugobj.h"
 
+/*
+ * Statistics, see mnt_enable_stats()
+ */
+enum {
+	MNT_STAT_TAB_ALLOC = 0,
+	MNT_STAT_FS_ALLOC,
+	MNT_STAT_TAB_PARSE,
+	MNT_STAT_TAB_PARSE_NS,
+	MNT_STAT_TAB_READ_BYTES,
+	MNT_STAT_LISTMOUNT,
+	MNT_STAT_STATMOUNT,
+	MNT_STAT_CACHE_HITS,
+	MNT_STAT_CANONICALIZE,
+	MNT_STAT_MOUNT,
+	MNT_STAT_UMOUNT,
+
+	__MNT_STAT_COUNT
+};
+
+UL_DEBUG_DECLARE_STATS(libmount, __MNT_STAT_COUNT);
+#define STAT_ADD(c, n)	__UL_STAT_ADD(libmount, MNT_STAT_, c, n)
+#define STAT_TIME(c, x)	__UL_STAT_TIME(libmount, MNT_STAT_, c, x)
+
 /*
  * NLS -- the library has to be independent on main program, so define
  * UL_TEXTDOMAIN_EXPLICIT before you include nls.h.
@@ -80,6 +103,9 @@ UL_DEBUG_DECLARE_MASK(libmount);
 #define MNT_PATH_UTAB		MNT_RUNTIME_TOPDIR "/mount/utab"
 #define MNT_PATH_UTAB_OLD	MNT_RUNTIME_TOPDIR_OLD "/.mount/utab"
 
+/* cache snapshot maintained by mntcached(8) */
+#define MNT_PATH_CACHE		MNT_RUNTIME_TOPDIR "/mount/cache"
+
 #define MNT_UTAB_HEADER	"# libmount utab file\n"
 
 #ifdef TEST_PROGRAM
@@ -124,15 +150,23 @@ extern char *mnt_get_kernel_cmdline_option(const char *name);
 extern int mnt_stat_mountpoint(const char *target, struct stat *st);
 extern int mnt_lstat_mountpoint(const char *target, struct stat *st);
 
+/* cache.c */
+extern int mnt_cache_resolve_table_tags(struct libmnt_cache *cache,
+					struct libmnt_table *tb);
+
 /* tab.c */
 extern int is_mountinfo(struct libmnt_table *tb);
 extern int mnt_table_set_parser_fltrcb(	struct libmnt_table *tb,
 					int (*cb)(struct libmnt_fs *, void *),
 					void *data);
+extern int mnt_table_insert_fs_before(struct libmnt_table *tb,
+				      struct libmnt_fs *pos,
+				      struct libmnt_fs *fs);
 
 extern int __mnt_table_parse_mtab(struct libmnt_table *tb,
 					const char *filename,
 					struct libmnt_table *u_tb);
+extern int mnt_table_parse_utab(struct libmnt_table *tb, const char *filename);
 
 extern struct libmnt_fs *mnt_table_get_fs_root(struct libmnt_table *tb,
 					struct libmnt_fs *fs,
@@ -170,6 +204,15 @@ struct libmnt_iter {
 	} while(0)
 
 
+/*
+ * Shared buffer for strings of the libmnt_fs entries (see __mnt_fs_unshare())
+ */
+struct libmnt_strbuf {
+	int		refcount;
+	char		*data;
+	size_t		size;
+};
+
 /*
  * This struct represents one entry in a mtab/fstab/mountinfo file.
  * (note that fstab[1] means the first column from fstab, and so on...)
@@ -182,6 +225,7 @@ struct libmnt_fs {
 	int		id;		/* mountinfo[1]: ID */
 	int		parent;		/* mountinfo[2]: parent */
 	dev_t		devno;		/* mountinfo[3]: st_dev */
+	uint64_t	uniq_id;	/* statmount(2): unique mount ID */
 
 	char		*bindsrc;	/* utab, full path from fstab[1] for bind mounts */
 
@@ -201,6 +245,8 @@ struct libmnt_fs {
 	char		*user_optstr;	/* userspace mount options */
 	char		*attrs;		/* mount attributes */
 
+	struct libmnt_opttoks *opttoks;	/* tokenized optstr (cache) */
+
 	int		freq;		/* fstab[5]: dump frequency in days */
 	int		passno;		/* fstab[6]: pass number on parallel fsck */
 
@@ -215,6 +261,8 @@ struct libmnt_fs {
 
 	char		*comment;	/* fstab comment */
 
+	struct libmnt_strbuf *strbuf;	/* mountinfo strings or NULL */
+
 	void		*userdata;	/* library independent data */
 };
 
@@ -226,6 +274,7 @@ struct libmnt_fs {
 #define MNT_FS_SWAP	(1 << 3) /* swap device */
 #define MNT_FS_KERNEL	(1 << 4) /* data from /proc/{mounts,self/mountinfo} */
 #define MNT_FS_MERGED	(1 << 5) /* already merged data from /run/mount/utab */
+#define MNT_FS_LAZYOPTS	(1 << 6) /* optstr is merged on the first access */
 
 #define mnt_fs_is_regular(_f)	(!(mnt_fs_is_pseudofs(_f) \
 				   || mnt_fs_is_netfs(_f) \
@@ -250,9 +299,21 @@ struct libmnt_table {
 	int		(*fltrcb)(struct libmnt_fs *fs, void *data);
 	void		*fltrcb_data;
 
+	int		pf_id;		/* parser pre-filter, see mnt_table_set_parser_prefilter() */
+	char		*pf_fstypes;
+	char		*pf_target;
+
+	uint64_t	lsmt_id;	/* listmount() subtree, see mnt_table_parse_listmount() */
+	uint64_t	lsmt_mask;	/* statmount() mask, 0 if not read by listmount() */
+
 
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
 	void		*userdata;
+
+	struct libmnt_tabidx	*idx;	/* lookup index, see tab_index.c */
+	int		idx_lookups;	/* lookups since the last index reset */
+
+	struct libmnt_btrfs_cache *btrfs; /* default subvolumes, see btrfs.c */
 };
 
 extern struct libmnt_table *__mnt_new_table_from_file(const char *filename, int fmt, int empty_for_enoent);
@@ -283,6 +344,26 @@ struct libmnt_ns {
 	struct libmnt_cache *cache;	/* paths cache associated with NS */
 };
 
+/*
+ * Cached /sbin/[u]mount.<type> lookup, see mnt_context_prepare_helper()
+ */
+struct libmnt_helper {
+	char		*name;		/* "mount" or "umount" */
+	char		*type;		/* FS type */
+	char		*path;		/* NULL if there is no helper */
+
+	struct list_head helpers;
+};
+
+/*
+ * "mount -a --fork" child
+ */
+struct libmnt_child {
+	pid_t		pid;
+	int		status;		/* wait(2) status, -1 if unknown */
+	struct libmnt_fs *fs;		/* NULL if finished */
+};
+
 /*
  * Mount context -- high-level API
  */
@@ -335,13 +416,18 @@ struct libmnt_context
 	int	flags;		/* private context flags */
 
 	char	*helper;	/* name of the used /sbin/[u]mount.<type> helper */
+	struct list_head helpers; /* cached helper lookups (struct libmnt_helper) */
 	int	helper_status;	/* helper wait(2) status */
 	int	helper_exec_status; /* 1: not called yet, 0: success, <0: -errno */
 
 	char	*orig_user;	/* original (non-fixed) user= option */
 
-	pid_t	*children;	/* "mount -a --fork" PIDs */
+	struct libmnt_child *children;	/* "mount -a --fork" children */
 	int	nchildren;	/* number of children */
+	int	nrunning;	/* number of not finished children */
+	int	max_children;	/* mount -a --parallel limit, see mnt_context_set_parallel() */
+	struct libmnt_fs **pending;	/* mount -a --parallel deferred filesystems */
+	size_t	npending;
 	pid_t	pid;		/* 0=parent; PID=child */
 
 
@@ -387,8 +473,41 @@ struct libmnt_context
 /* Flags usable with MS_BIND|MS_REMOUNT */
 #define MNT_BIND_SETTABLE	(MS_NOSUID|MS_NODEV|MS_NOEXEC|MS_NOATIME|MS_NODIRATIME|MS_RELATIME|MS_RDONLY)
 
+/* tab_index.c */
+enum {
+	MNT_TABIDX_TARGET = 0,
+	MNT_TABIDX_SRCPATH,
+	MNT_TABIDX_DEVNO,
+
+	MNT_TABIDX_NKEYS
+};
+
+struct libmnt_tabidx_iter {
+	int	key;		/* MNT_TABIDX_* */
+	int	direction;	/* MNT_ITER_* */
+	int	cur;
+};
+
+extern uint64_t mnt_tabidx_hash_path(const char *path);
+extern uint64_t mnt_tabidx_hash_devno(dev_t devno);
+extern void mnt_table_reset_index(struct libmnt_table *tb);
+extern void mnt_table_index_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs);
+extern int mnt_table_index_get_ntags(struct libmnt_table *tb);
+extern int mnt_table_index_init_iter(struct libmnt_table *tb,
+				     struct libmnt_tabidx_iter *itr,
+				     int key, uint64_t hash, int direction);
+extern struct libmnt_fs *mnt_table_index_next(struct libmnt_table *tb,
+					      struct libmnt_tabidx_iter *itr);
+
+/* tab_diff.c */
+extern int __mnt_tabdiff_reset(struct libmnt_tabdiff *df);
+extern int __mnt_tabdiff_add_entry(struct libmnt_tabdiff *df,
+				   struct libmnt_fs *old,
+				   struct libmnt_fs *new, int oper);
+
 /* lock.c */
 extern int mnt_lock_use_simplelock(struct libmnt_lock *ml, int enable);
+extern int mnt_lock_use_shared(struct libmnt_lock *ml, int enable);
 
 /* optmap.c */
 extern const struct libmnt_optmap *mnt_optmap_get_entry(
@@ -407,6 +526,13 @@ extern int mnt_optstr_fix_uid(char **optstr, char *value, size_t valsz, char **n
 extern int mnt_optstr_fix_secontext(char **optstr, char *value, size_t valsz, char **next);
 extern int mnt_optstr_fix_user(char **optstr);
 
+struct libmnt_opttoks;
+extern void mnt_free_opttoks(struct libmnt_opttoks *tk);
+extern int mnt_opttoks_get_option(struct libmnt_opttoks **tk, const char *optstr,
+			const char *name, char **value, size_t *valsz);
+extern int mnt_opttoks_match_options(struct libmnt_opttoks **tk, const char *optstr,
+			const char *pattern);
+
 /* fs.c */
 extern struct libmnt_fs *mnt_copy_mtab_fs(const struct libmnt_fs *fs)
 			__attribute__((nonnull));
@@ -414,6 +540,11 @@ extern int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 			__attribute__((nonnull(1)));
 extern int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 			__attribute__((nonnull(1)));
+extern struct libmnt_strbuf *mnt_new_strbuf(char *data, size_t size);
+extern void mnt_ref_strbuf(struct libmnt_strbuf *sb);
+extern void mnt_unref_strbuf(struct libmnt_strbuf *sb);
+extern int __mnt_fs_unshare(struct libmnt_fs *fs)
+			__attribute__((nonnull));
 
 /* context.c */
 extern struct libmnt_context *mnt_copy_context(struct libmnt_context *o);
@@ -451,7 +582,11 @@ extern int mnt_context_setup_loopdev(struct libmnt_context *cxt);
 extern int mnt_context_delete_loopdev(struct libmnt_context *cxt);
 extern int mnt_context_clear_loopdev(struct libmnt_context *cxt);
 
-extern int mnt_fork_context(struct libmnt_context *cxt);
+extern int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs);
+extern int mnt_context_wait_for_slot(struct libmnt_context *cxt);
+extern int mnt_context_defer_mount(struct libmnt_context *cxt, struct libmnt_fs *fs);
+extern int mnt_context_next_deferred(struct libmnt_context *cxt,
+				     struct libmnt_fs **fs, int wait);
 
 extern int mnt_context_set_tabfilter(struct libmnt_context *cxt,
 				     int (*fltr)(struct libmnt_fs *, void *),
@@ -485,5 +620,12 @@ extern int mnt_update_end(struct libmnt_update *upd);
 /* btrfs.c */
 extern uint64_t btrfs_get_default_subvol_id(const char *path);
 #endif
+#ifdef HAVE_BTRFS_SUPPORT
+extern uint64_t mnt_table_get_btrfs_default_subvol_id(struct libmnt_table *tb,
+						const char *path, dev_t devno);
+extern void mnt_table_reset_btrfs_cache(struct libmnt_table *tb);
+#else
+# define mnt_table_reset_btrfs_cache(_tb)	do { } while (0)
+#endif
 
 #endif /* _LIBMOUNT_PRIVATE_H */
@@ -176,6 +176,7 @@ static const struct libmnt_optmap userspace_opts_map[] =
    { "offset=", MNT_MS_OFFSET, MNT_NOHLPS | MNT_NOMTAB },		   /* loop device offset */
    { "sizelimit=", MNT_MS_SIZELIMIT, MNT_NOHLPS | MNT_NOMTAB },	   /* loop device size limit */
    { "encryption=", MNT_MS_ENCRYPTION, MNT_NOHLPS | MNT_NOMTAB },	   /* loop device encryption */
+   { "loop.autotune", MNT_MS_LOOP_AUTOTUNE, MNT_NOHLPS | MNT_NOMTAB }, /* loop device direct I/O */
 
    { "nofail",  MNT_MS_NOFAIL, MNT_NOMTAB },               /* Do not fail if ENOENT on dev */
 
@@ -218,6 +219,139 @@ const struct libmnt_optmap *mnt_get_builtin_optmap(int id)
 	return NULL;
 }
 
+/*
+ * Hash index for the built-in maps. The maps are searched for every option of
+ * every mount table entry, so the linear scan is expensive for large tables.
+ * The index is built on the first lookup (the maps are compiled-in and never
+ * modified) and it returns the same entry as the linear scan -- the first
+ * entry with the name, or an earlier MNT_PREFIX entry.
+ */
+#define OPTMAP_NBUCKETS		256	/* power of 2, more than 2x entries */
+#define OPTMAP_MAXPREFIXES	4
+
+struct optmap_index {
+	short	buckets[OPTMAP_NBUCKETS];	/* entry index + 1, 0 for empty */
+	short	prefixes[OPTMAP_MAXPREFIXES];	/* MNT_PREFIX entries */
+	size_t	nprefixes;
+};
+
+static struct optmap_index *builtin_index[2];
+
+/* the option name is terminated by '=' or '[' in the map */
+static size_t optmap_namelen(const char *name)
+{
+	return strcspn(name, "=[");
+}
+
+static uint32_t optmap_hash(const char *name, size_t namelen)
+{
+	uint32_t h = 2166136261U;
+
+	while (namelen--) {
+		h ^= (unsigned char) *name++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static struct optmap_index *build_index(const struct libmnt_optmap *map)
+{
+	struct optmap_index *idx = calloc(1, sizeof(*idx));
+	const struct libmnt_optmap *ent;
+
+	if (!idx)
+		return NULL;
+
+	for (ent = map; ent->name; ent++) {
+		size_t len, bk;
+		short i = ent - map;
+
+		if (ent->mask & MNT_PREFIX) {
+			if (idx->nprefixes == OPTMAP_MAXPREFIXES)
+				goto fail;
+			idx->prefixes[idx->nprefixes++] = i;
+			continue;
+		}
+		if (i + 1 >= OPTMAP_NBUCKETS / 2)
+			goto fail;
+
+		len = optmap_namelen(ent->name);
+		bk = optmap_hash(ent->name, len) & (OPTMAP_NBUCKETS - 1);
+
+		for (; idx->buckets[bk]; bk = (bk + 1) & (OPTMAP_NBUCKETS - 1)) {
+			const char *x = map[idx->buckets[bk] - 1].name;
+
+			if (optmap_namelen(x) == len && strncmp(x, ent->name, len) == 0)
+				break;	/* duplicate, keep the first */
+		}
+		if (!idx->buckets[bk])
+			idx->buckets[bk] = i + 1;
+	}
+	return idx;
+fail:
+	free(idx);
+	return NULL;
+}
+
+static struct optmap_index *get_index(const struct libmnt_optmap *map)
+{
+	struct optmap_index *idx, **pidx;
+
+	if (map == linux_flags_map)
+		pidx = &builtin_index[0];
+	else if (map == userspace_opts_map)
+		pidx = &builtin_index[1];
+	else
+		return NULL;
+
+	idx = __atomic_load_n(pidx, __ATOMIC_ACQUIRE);
+	if (idx)
+		return idx;
+
+	idx = build_index(map);
+	if (idx) {
+		struct optmap_index *old = NULL;
+
+		/* another thread has been faster */
+		if (!__atomic_compare_exchange_n(pidx, &old, idx, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			free(idx);
+			idx = old;
+		}
+	}
+	return idx;
+}
+
+static const struct libmnt_optmap *index_get_entry(
+				const struct optmap_index *idx,
+				const struct libmnt_optmap *map,
+				const char *name,
+				size_t namelen)
+{
+	const struct libmnt_optmap *res = NULL;
+	size_t i, bk = optmap_hash(name, namelen) & (OPTMAP_NBUCKETS - 1);
+
+	for (; idx->buckets[bk]; bk = (bk + 1) & (OPTMAP_NBUCKETS - 1)) {
+		const struct libmnt_optmap *ent = &map[idx->buckets[bk] - 1];
+
+		if (optmap_namelen(ent->name) == namelen
+		    && strncmp(ent->name, name, namelen) == 0) {
+			res = ent;
+			break;
+		}
+	}
+
+	for (i = 0; i < idx->nprefixes; i++) {
+		const struct libmnt_optmap *ent = &map[idx->prefixes[i]];
+
+		if (res && ent > res)
+			break;
+		if (startswith(name, ent->name))
+			return ent;
+	}
+	return res;
+}
+
 /*
  * Looks up the @name in @maps and returns a map and in @mapent
  * returns the map entry
@@ -242,8 +376,20 @@ const struct libmnt_optmap *mnt_optmap_get_entry(
 	for (i = 0; i < nmaps; i++) {
 		const struct libmnt_optmap *map = maps[i];
 		const struct libmnt_optmap *ent;
+		const struct optmap_index *idx;
 		const char *p;
 
+		idx = get_index(map);
+		if (idx) {
+			ent = index_get_entry(idx, map, name, namelen);
+			if (ent) {
+				if (mapent)
+					*mapent = ent;
+				return map;
+			}
+			continue;
+		}
+
 		for (ent = map; ent && ent->name; ent++) {
 			if (ent->mask & MNT_PREFIX) {
 				if (startswith(name, ent->name)) {
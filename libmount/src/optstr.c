@@ -1172,37 +1172,124 @@ fail:
 	return rc;
 }
 
-/**
- * mnt_match_options:
- * @optstr: options string
- * @pattern: comma delimited list of options
- *
- * The "no" could be used for individual items in the @options list. The "no"
- * prefix does not have a global meaning.
- *
- * Unlike fs type matching, nonetdev,user and nonetdev,nouser have
- * DIFFERENT meanings; each option is matched explicitly as specified.
- *
- * The "no" prefix interpretation could be disabled by the "+" prefix, for example
- * "+noauto" matches if @optstr literally contains the "noauto" string.
- *
- * "xxx,yyy,zzz" : "nozzz"	-> False
- *
- * "xxx,yyy,zzz" : "xxx,noeee"	-> True
- *
- * "bar,zzz"     : "nofoo"      -> True		(does not contain "foo")
- *
- * "nofoo,bar"   : "nofoo"      -> True		(does not contain "foo")
- *
- * "nofoo,bar"   : "+nofoo"     -> True		(contains "nofoo")
- *
- * "bar,zzz"     : "+nofoo"     -> False	(does not contain "nofoo")
- *
+/*
+ * Pre-tokenized options string. The tokens point to the private copy of the
+ * string, so the tokens are valid until the original string is modified (in
+ * place or reallocated); the copy is used to detect the modification. It's
+ * cached in struct libmnt_fs for repeated lookups (e.g. findmnt -O or
+ * mount -a -O for many entries).
+ */
+struct libmnt_opttok {
+	char	*name;
+	size_t	namesz;
+	char	*value;
+	size_t	valsz;
+};
+
+struct libmnt_opttoks {
+	char			*str;	/* copy of the options string */
+	int			rc;	/* parse error behind the last token */
+	size_t			ntoks;
+	struct libmnt_opttok	toks[];
+};
+
+void mnt_free_opttoks(struct libmnt_opttoks *tk)
+{
+	free(tk);
+}
+
+static struct libmnt_opttoks *new_opttoks(const char *optstr)
+{
+	struct libmnt_opttoks *tk;
+	size_t n = 1, len = strlen(optstr);
+	const char *p;
+	char *str;
+	int rc;
+
+	/* number of the items is never greater than number of commas + 1 */
+	for (p = optstr; (p = strchr(p, ',')); p++)
+		n++;
+
+	tk = malloc(sizeof(*tk) + n * sizeof(struct libmnt_opttok) + len + 1);
+	if (!tk)
+		return NULL;
+
+	tk->str = (char *) &tk->toks[n];
+	memcpy(tk->str, optstr, len + 1);
+	tk->ntoks = 0;
+
+	str = tk->str;
+	while (tk->ntoks < n) {
+		struct libmnt_opttok *t = &tk->toks[tk->ntoks];
+
+		rc = mnt_optstr_parse_next(&str, &t->name, &t->namesz,
+					   &t->value, &t->valsz);
+		if (rc)
+			break;
+		tk->ntoks++;
+	}
+	tk->rc = rc < 0 ? rc : 1;
+	return tk;
+}
+
+/*
+ * Returns tokens for @optstr, the old tokens are replaced if @optstr has been
+ * modified. Returns NULL on ENOMEM.
+ */
+static struct libmnt_opttoks *get_opttoks(struct libmnt_opttoks **tk,
+					  const char *optstr)
+{
+	if (*tk && strcmp((*tk)->str, optstr) == 0)
+		return *tk;
+
+	mnt_free_opttoks(*tk);
+	*tk = new_opttoks(optstr);
+	return *tk;
+}
+
+/* like mnt_optstr_locate_option() */
+static int opttoks_locate_option(struct libmnt_opttoks *tk, const char *name,
+				 size_t namesz, char **value, size_t *valsz)
+{
+	size_t i;
+
+	if (!namesz)
+		return 1;
+
+	for (i = 0; i < tk->ntoks; i++) {
+		struct libmnt_opttok *t = &tk->toks[i];
+
+		if (t->namesz == namesz && strncmp(t->name, name, namesz) == 0) {
+			if (value)
+				*value = t->value;
+			if (valsz)
+				*valsz = t->valsz;
+			return 0;
+		}
+	}
+	return tk->rc;
+}
+
+/*
+ * Same as mnt_optstr_get_option(), but @optstr is parsed only once for all
+ * the calls with the same @tk. The @tk is allocated by the function (keep it
+ * NULL for the first call) and deallocated by mnt_free_opttoks().
  *
- * Returns: 1 if pattern is matching, else 0. This function also returns 0
- *          if @pattern is NULL and @optstr is non-NULL.
+ * Note that @value points to the private copy of @optstr.
  */
-int mnt_match_options(const char *optstr, const char *pattern)
+int mnt_opttoks_get_option(struct libmnt_opttoks **tk, const char *optstr,
+			   const char *name, char **value, size_t *valsz)
+{
+	if (!optstr || !name || !tk)
+		return -EINVAL;
+	if (!get_opttoks(tk, optstr))
+		return mnt_optstr_get_option(optstr, name, value, valsz);
+
+	return opttoks_locate_option(*tk, name, strlen(name), value, valsz);
+}
+
+static int match_options(const char *optstr, struct libmnt_opttoks *tk,
+			 const char *pattern)
 {
 	char *name, *pat = (char *) pattern;
 	char *buf, *patval;
@@ -1222,8 +1309,8 @@ int mnt_match_options(const char *optstr, const char *pattern)
 	 */
 	while (match && !mnt_optstr_next_option(&pat, &name, &namesz,
 						&patval, &patvalsz)) {
-		char *val;
-		size_t sz;
+		char *val = NULL;
+		size_t sz = 0;
 		int no = 0, rc;
 
 		if (*name == '+')
@@ -1231,9 +1318,12 @@ int mnt_match_options(const char *optstr, const char *pattern)
 		else if ((no = (startswith(name, "no") != NULL)))
 			name += 2, namesz -= 2;
 
-		xstrncpy(buf, name, namesz + 1);
-
-		rc = mnt_optstr_get_option(optstr, buf, &val, &sz);
+		if (tk)
+			rc = opttoks_locate_option(tk, name, namesz, &val, &sz);
+		else {
+			xstrncpy(buf, name, namesz + 1);
+			rc = mnt_optstr_get_option(optstr, buf, &val, &sz);
+		}
 
 		/* check also value (if the pattern is "foo=value") */
 		if (rc == 0 && patvalsz > 0 &&
@@ -1258,6 +1348,54 @@ int mnt_match_options(const char *optstr, const char *pattern)
 	return match;
 }
 
+/*
+ * Same as mnt_match_options(), but @optstr is parsed only once for all
+ * the calls with the same @tk, see mnt_opttoks_get_option().
+ */
+int mnt_opttoks_match_options(struct libmnt_opttoks **tk, const char *optstr,
+			      const char *pattern)
+{
+	if (!tk || !optstr)
+		return mnt_match_options(optstr, pattern);
+
+	return match_options(optstr, get_opttoks(tk, optstr), pattern);
+}
+
+/**
+ * mnt_match_options:
+ * @optstr: options string
+ * @pattern: comma delimited list of options
+ *
+ * The "no" could be used for individual items in the @options list. The "no"
+ * prefix does not have a global meaning.
+ *
+ * Unlike fs type matching, nonetdev,user and nonetdev,nouser have
+ * DIFFERENT meanings; each option is matched explicitly as specified.
+ *
+ * The "no" prefix interpretation could be disabled by the "+" prefix, for example
+ * "+noauto" matches if @optstr literally contains the "noauto" string.
+ *
+ * "xxx,yyy,zzz" : "nozzz"	-> False
+ *
+ * "xxx,yyy,zzz" : "xxx,noeee"	-> True
+ *
+ * "bar,zzz"     : "nofoo"      -> True		(does not contain "foo")
+ *
+ * "nofoo,bar"   : "nofoo"      -> True		(does not contain "foo")
+ *
+ * "nofoo,bar"   : "+nofoo"     -> True		(contains "nofoo")
+ *
+ * "bar,zzz"     : "+nofoo"     -> False	(does not contain "nofoo")
+ *
+ *
+ * Returns: 1 if pattern is matching, else 0. This function also returns 0
+ *          if @pattern is NULL and @optstr is non-NULL.
+ */
+int mnt_match_options(const char *optstr, const char *pattern)
+{
+	return match_options(optstr, NULL, pattern);
+}
+
 #ifdef TEST_PROGRAM
 
 static int test_append(struct libmnt_test *ts, int argc, char *argv[])
@@ -88,7 +88,9 @@ struct libmnt_table *mnt_new_table(void)
 		return NULL;
 
 	DBG(TAB, ul_debugobj(tb, "alloc"));
+	STAT_ADD(TAB_ALLOC, 1);
 	tb->refcount = 1;
+	tb->pf_id = -1;
 	INIT_LIST_HEAD(&tb->ents);
 	return tb;
 }
@@ -109,6 +111,7 @@ int mnt_reset_table(struct libmnt_table *tb)
 
 	DBG(TAB, ul_debugobj(tb, "reset"));
 
+	mnt_table_reset_index(tb);
 	while (!list_empty(&tb->ents)) {
 		struct libmnt_fs *fs = list_entry(tb->ents.next,
 				                  struct libmnt_fs, ents);
@@ -172,6 +175,8 @@ void mnt_free_table(struct libmnt_table *tb)
 	mnt_unref_cache(tb->cache);
 	free(tb->comm_intro);
 	free(tb->comm_tail);
+	free(tb->pf_fstypes);
+	free(tb->pf_target);
 	free(tb);
 }
 
@@ -452,6 +457,7 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	list_add_tail(&fs->ents, &tb->ents);
 	fs->tab = tb;
 	tb->nents++;
+	mnt_table_index_add_fs(tb, fs);
 
 	DBG(TAB, ul_debugobj(tb, "add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -471,6 +477,7 @@ static int __table_insert_fs(
 
 	fs->tab = tb;
 	tb->nents++;
+	mnt_table_reset_index(tb);
 
 	DBG(TAB, ul_debugobj(tb, "insert entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -542,6 +549,7 @@ int mnt_table_move_fs(struct libmnt_table *src, struct libmnt_table *dst,
 	/* remove from source */
 	list_del_init(&fs->ents);
 	src->nents--;
+	mnt_table_reset_index(src);
 
 	/* insert to the destination */
 	return __table_insert_fs(dst, before, pos, fs);
@@ -569,9 +577,27 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 	mnt_unref_fs(fs);
 	tb->nents--;
+	mnt_table_reset_index(tb);
 	return 0;
 }
 
+/*
+ * Adds @fs before @pos, or to the tail of @tb if @pos is NULL.
+ */
+int mnt_table_insert_fs_before(struct libmnt_table *tb, struct libmnt_fs *pos,
+			       struct libmnt_fs *fs)
+{
+	if (!tb || !fs)
+		return -EINVAL;
+	if (fs->tab)
+		return -EBUSY;
+	if (pos && pos->tab != tb)
+		return -ENOENT;
+
+	mnt_ref_fs(fs);
+	return __table_insert_fs(tb, 0, pos, fs);	/* list_add_tail() to @pos */
+}
+
 static inline struct libmnt_fs *get_parent_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 {
 	struct libmnt_iter itr;
@@ -1048,6 +1074,31 @@ struct libmnt_fs *mnt_table_find_mountpoint(struct libmnt_table *tb,
  *
  * Returns: a tab entry or NULL.
  */
+/* returns the first entry with the target equal to @path (no canonicalization) */
+static struct libmnt_fs *find_target_str(struct libmnt_table *tb,
+					 const char *path, int direction)
+{
+	struct libmnt_tabidx_iter ix;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs = NULL;
+
+	if (mnt_table_index_init_iter(tb, &ix, MNT_TABIDX_TARGET,
+				mnt_tabidx_hash_path(path), direction) == 0) {
+		while ((fs = mnt_table_index_next(tb, &ix))) {
+			if (mnt_fs_streq_target(fs, path))
+				return fs;
+		}
+		return NULL;
+	}
+
+	mnt_reset_iter(&itr, direction);
+	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_streq_target(fs, path))
+			return fs;
+	}
+	return NULL;
+}
+
 struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *path, int direction)
 {
 	struct libmnt_iter itr;
@@ -1062,23 +1113,17 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup TARGET: '%s'", path));
 
 	/* native @target */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, path))
-			return fs;
-	}
+	fs = find_target_str(tb, path, direction);
+	if (fs)
+		return fs;
 
 	/* try absolute path */
 	if (is_relative_path(path) && (cn = absolute_path(path))) {
 		DBG(TAB, ul_debugobj(tb, "lookup absolute TARGET: '%s'", cn));
-		mnt_reset_iter(&itr, direction);
-		while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_target(fs, cn)) {
-				free(cn);
-				return fs;
-			}
-		}
+		fs = find_target_str(tb, cn, direction);
 		free(cn);
+		if (fs)
+			return fs;
 	}
 
 	if (!tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -1087,11 +1132,9 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup canonical TARGET: '%s'", cn));
 
 	/* canonicalized paths in struct libmnt_table */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, cn))
-			return fs;
-	}
+	fs = find_target_str(tb, cn, direction);
+	if (fs)
+		return fs;
 
 	/* non-canonical path in struct libmnt_table
 	 * -- note that mountpoint in /proc/self/mountinfo is already
@@ -1115,6 +1158,38 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	return NULL;
 }
 
+/*
+ * For btrfs returns 1 if @fs is the default subvolume (or the subvolume is
+ * not specified).
+ */
+static int is_default_subvol(struct libmnt_table *tb,
+			     struct libmnt_fs *fs __attribute__((__unused__)))
+{
+#ifdef HAVE_BTRFS_SUPPORT
+	if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
+		uint64_t default_id = mnt_table_get_btrfs_default_subvol_id(tb,
+						mnt_fs_get_target(fs), fs->devno);
+		char *val;
+		size_t len;
+
+		if (default_id == UINT64_MAX)
+			DBG(TAB, ul_debug("not found btrfs volume setting"));
+
+		else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
+			uint64_t subvol_id;
+
+			if (mnt_parse_offset(val, len, &subvol_id)) {
+				DBG(TAB, ul_debugobj(tb, "failed to parse subvolid="));
+				return 0;
+			}
+			if (subvol_id != default_id)
+				return 0;
+		}
+	}
+#endif /* HAVE_BTRFS_SUPPORT */
+	return 1;
+}
+
 /**
  * mnt_table_find_srcpath:
  * @tb: tab pointer
@@ -1137,6 +1212,7 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
  */
 struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *path, int direction)
 {
+	struct libmnt_tabidx_iter ix;
 	struct libmnt_iter itr;
 	struct libmnt_fs *fs = NULL;
 	int ntags = 0, nents;
@@ -1151,36 +1227,24 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 	DBG(TAB, ul_debugobj(tb, "lookup SRCPATH: '%s'", path));
 
 	/* native paths */
-	mnt_reset_iter(&itr, direction);
-
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-
-		if (mnt_fs_streq_srcpath(fs, path)) {
-#ifdef HAVE_BTRFS_SUPPORT
-			if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
-				uint64_t default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
-				char *val;
-				size_t len;
-
-				if (default_id == UINT64_MAX)
-					DBG(TAB, ul_debug("not found btrfs volume setting"));
-
-				else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
-					uint64_t subvol_id;
+	if (mnt_table_index_init_iter(tb, &ix, MNT_TABIDX_SRCPATH,
+				mnt_tabidx_hash_path(path), direction) == 0) {
+		while ((fs = mnt_table_index_next(tb, &ix))) {
+			if (mnt_fs_streq_srcpath(fs, path)
+			    && is_default_subvol(tb, fs))
+				return fs;
+		}
+		ntags = mnt_table_index_get_ntags(tb);
+	} else {
+		mnt_reset_iter(&itr, direction);
 
-					if (mnt_parse_offset(val, len, &subvol_id)) {
-						DBG(TAB, ul_debugobj(tb, "failed to parse subvolid="));
-						continue;
-					}
-					if (subvol_id != default_id)
-						continue;
-				}
-			}
-#endif /* HAVE_BTRFS_SUPPORT */
-			return fs;
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (mnt_fs_streq_srcpath(fs, path)
+			    && is_default_subvol(tb, fs))
+				return fs;
+			if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
+				ntags++;
 		}
-		if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
-			ntags++;
 	}
 
 	if (!path || !tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -1192,10 +1256,18 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 
 	/* canonicalized paths in struct libmnt_table */
 	if (ntags < nents) {
-		mnt_reset_iter(&itr, direction);
-		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_srcpath(fs, cn))
-				return fs;
+		if (mnt_table_index_init_iter(tb, &ix, MNT_TABIDX_SRCPATH,
+					mnt_tabidx_hash_path(cn), direction) == 0) {
+			while ((fs = mnt_table_index_next(tb, &ix))) {
+				if (mnt_fs_streq_srcpath(fs, cn))
+					return fs;
+			}
+		} else {
+			mnt_reset_iter(&itr, direction);
+			while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+				if (mnt_fs_streq_srcpath(fs, cn))
+					return fs;
+			}
 		}
 	}
 
@@ -1394,6 +1466,7 @@ struct libmnt_fs *mnt_table_find_source(struct libmnt_table *tb,
 struct libmnt_fs *mnt_table_find_pair(struct libmnt_table *tb, const char *source,
 				      const char *target, int direction)
 {
+	struct libmnt_tabidx_iter ix;
 	struct libmnt_fs *fs = NULL;
 	struct libmnt_iter itr;
 
@@ -1404,6 +1477,19 @@ struct libmnt_fs *mnt_table_find_pair(struct libmnt_table *tb, const char *sourc
 
 	DBG(TAB, ul_debugobj(tb, "lookup SOURCE: %s TARGET: %s", source, target));
 
+	/* the cache may match a different path, so the index is usable
+	 * for native paths only */
+	if (!tb->cache
+	    && mnt_table_index_init_iter(tb, &ix, MNT_TABIDX_TARGET,
+				mnt_tabidx_hash_path(target), direction) == 0) {
+		while ((fs = mnt_table_index_next(tb, &ix))) {
+			if (mnt_fs_match_target(fs, target, NULL) &&
+			    mnt_fs_match_source(fs, source, NULL))
+				return fs;
+		}
+		return NULL;
+	}
+
 	mnt_reset_iter(&itr, direction);
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
 
@@ -1429,6 +1515,7 @@ struct libmnt_fs *mnt_table_find_pair(struct libmnt_table *tb, const char *sourc
 struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 				       dev_t devno, int direction)
 {
+	struct libmnt_tabidx_iter ix;
 	struct libmnt_fs *fs = NULL;
 	struct libmnt_iter itr;
 
@@ -1439,6 +1526,15 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "lookup DEVNO: %d", (int) devno));
 
+	if (mnt_table_index_init_iter(tb, &ix, MNT_TABIDX_DEVNO,
+				mnt_tabidx_hash_devno(devno), direction) == 0) {
+		while ((fs = mnt_table_index_next(tb, &ix))) {
+			if (mnt_fs_get_devno(fs) == devno)
+				return fs;
+		}
+		return NULL;
+	}
+
 	mnt_reset_iter(&itr, direction);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1514,9 +1610,20 @@ static int get_btrfs_fs_root(struct libmnt_table *tb, struct libmnt_fs *fs, char
 
 		DBG(BTRFS, ul_debug(" subvolid/subvol not found, checking default"));
 
-		default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
-		if (default_id == UINT64_MAX)
+		target = mnt_resolve_target(mnt_fs_get_target(fs), tb->cache);
+		if (!target)
+			goto err;
+
+		/* the cache key is the filesystem on the top of the target */
+		f = mnt_table_find_target(tb, target, MNT_ITER_BACKWARD);
+
+		default_id = mnt_table_get_btrfs_default_subvol_id(tb,
+					mnt_fs_get_target(fs), f ? f->devno : 0);
+		if (default_id == UINT64_MAX) {
+			if (!tb->cache)
+				free(target);
 			goto not_found;
+		}
 
 		/* Volume has default subvolume. Check if it matches to
 		 * the one in mountinfo.
@@ -1525,9 +1632,6 @@ static int get_btrfs_fs_root(struct libmnt_table *tb, struct libmnt_fs *fs, char
 		 * kernels, there is no reasonable way to detect which
 		 * subvolume was mounted.
 		 */
-		target = mnt_resolve_target(mnt_fs_get_target(fs), tb->cache);
-		if (!target)
-			goto err;
 
 		snprintf(default_id_str, sizeof(default_id_str), "%llu",
 				(unsigned long long int) default_id);
@@ -1709,6 +1813,69 @@ err:
 }
 
 
+/*
+ * Returns 1 if the mountinfo entry @fs matches @src (or @devno) and @root of
+ * the @fstab_fs.
+ */
+static int is_source_matching(struct libmnt_fs *fs, struct libmnt_fs *fstab_fs,
+			      const char *src, dev_t devno, const char *root)
+{
+	int eq = mnt_fs_streq_srcpath(fs, src);
+
+	if (!eq && devno && mnt_fs_get_devno(fs) == devno)
+		eq = 1;
+
+	if (!eq) {
+		/* The source does not match. Maybe the source is a loop
+		 * device backing file.
+		 */
+		uint64_t offset = 0;
+		char *val;
+		size_t len;
+		int flags = 0;
+
+		if (!mnt_fs_get_srcpath(fs) ||
+		    !startswith(mnt_fs_get_srcpath(fs), "/dev/loop"))
+			return 0;	/* does not look like loopdev */
+
+		if (mnt_fs_get_option(fstab_fs, "offset", &val, &len) == 0) {
+			if (mnt_parse_offset(val, len, &offset)) {
+				DBG(FS, ul_debugobj(fstab_fs, "failed to parse offset="));
+				return 0;
+			}
+			flags = LOOPDEV_FL_OFFSET;
+		}
+
+		DBG(FS, ul_debugobj(fs, "checking for loop: src=%s", mnt_fs_get_srcpath(fs)));
+#if __linux__
+		if (!loopdev_is_used(mnt_fs_get_srcpath(fs), src, offset, 0, flags))
+			return 0;
+
+		DBG(FS, ul_debugobj(fs, "used loop"));
+#endif
+	}
+
+	if (root) {
+		const char *fstype = mnt_fs_get_fstype(fs);
+
+		if (fstype && (strcmp(fstype, "cifs") == 0 ||
+			       strcmp(fstype, "smb3") == 0)) {
+
+			const char *sub = get_cifs_unc_subdir_path(src);
+			const char *r = mnt_fs_get_root(fs);
+
+			if (!sub || !r || (!streq_paths(sub, r) &&
+					   !streq_paths("/", r)))
+				return 0;
+		} else {
+			const char *r = mnt_fs_get_root(fs);
+			if (!r || strcmp(r, root) != 0)
+				return 0;
+		}
+	}
+	return 1;
+}
+
 int __mnt_table_is_fs_mounted(struct libmnt_table *tb, struct libmnt_fs *fstab_fs,
 			      const char *tgt_prefix)
 {
@@ -1778,61 +1945,29 @@ int __mnt_table_is_fs_mounted(struct libmnt_table *tb, struct libmnt_fs *fstab_f
 
 	DBG(FS, ul_debugobj(fstab_fs, "mnt_table_is_fs_mounted: src=%s, tgt=%s, root=%s", src, tgt, root));
 
-	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-
-		int eq = mnt_fs_streq_srcpath(fs, src);
-
-		if (!eq && devno && mnt_fs_get_devno(fs) == devno)
-			eq = 1;
-
-		if (!eq) {
-			/* The source does not match. Maybe the source is a loop
-			 * device backing file.
-			 */
-			uint64_t offset = 0;
-			char *val;
-			size_t len;
-			int flags = 0;
-
-			if (!mnt_fs_get_srcpath(fs) ||
-			    !startswith(mnt_fs_get_srcpath(fs), "/dev/loop"))
-				continue;	/* does not look like loopdev */
-
-			if (mnt_fs_get_option(fstab_fs, "offset", &val, &len) == 0) {
-				if (mnt_parse_offset(val, len, &offset)) {
-					DBG(FS, ul_debugobj(fstab_fs, "failed to parse offset="));
-					continue;
-				}
-				flags = LOOPDEV_FL_OFFSET;
+	/* The entry has to match the target, so check the entries with the
+	 * same target first. Without the cache (no target canonicalization)
+	 * the result is final.
+	 */
+	if (!tgt_prefix) {
+		struct libmnt_tabidx_iter ix;
+
+		if (mnt_table_index_init_iter(tb, &ix, MNT_TABIDX_TARGET,
+				mnt_tabidx_hash_path(tgt), MNT_ITER_FORWARD) == 0) {
+			while ((fs = mnt_table_index_next(tb, &ix))) {
+				if (mnt_fs_streq_target(fs, tgt)
+				    && is_source_matching(fs, fstab_fs, src, devno, root))
+					break;
 			}
-
-			DBG(FS, ul_debugobj(fs, "checking for loop: src=%s", mnt_fs_get_srcpath(fs)));
-#if __linux__
-			if (!loopdev_is_used(mnt_fs_get_srcpath(fs), src, offset, 0, flags))
-				continue;
-
-			DBG(FS, ul_debugobj(fs, "used loop"));
-#endif
+			if (fs || !tb->cache)
+				goto found;
 		}
+	}
 
-		if (root) {
-			const char *fstype = mnt_fs_get_fstype(fs);
-
-			if (fstype && (strcmp(fstype, "cifs") == 0 ||
-				       strcmp(fstype, "smb3") == 0)) {
-
-				const char *sub = get_cifs_unc_subdir_path(src);
-				const char *r = mnt_fs_get_root(fs);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
 
-				if (!sub || !r || (!streq_paths(sub, r) &&
-						   !streq_paths("/", r)))
-					continue;
-			} else {
-				const char *r = mnt_fs_get_root(fs);
-				if (!r || strcmp(r, root) != 0)
-					continue;
-			}
-		}
+		if (!is_source_matching(fs, fstab_fs, src, devno, root))
+			continue;
 
 		/*
 		 * Compare target, try to minimize the number of situations when we
@@ -1862,6 +1997,7 @@ int __mnt_table_is_fs_mounted(struct libmnt_table *tb, struct libmnt_fs *fstab_f
 			break;
 	}
 
+found:
 	if (fs)
 		rc = 1;		/* success */
 done:
@@ -1997,6 +2133,96 @@ done:
 	return rc;
 }
 
+static int test_listmount(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb;
+	struct libmnt_iter *itr = NULL;
+	struct libmnt_fs *fs;
+	uint64_t id = 0;
+	int rc;
+
+	if (argc == 2)
+		id = strtou64_or_err(argv[1], "failed to parse mount ID");
+
+	tb = mnt_new_table();
+	if (!tb)
+		return -1;
+
+	rc = mnt_table_parse_listmount(tb, id, 0);
+	if (rc) {
+		warnx("listmount failed [rc=%d]", rc);
+		goto done;
+	}
+
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!itr)
+		goto done;
+
+	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+		mnt_fs_print_debug(fs, stdout);
+		printf("uniq-id:   %" PRIu64 "\n", mnt_fs_get_unique_id(fs));
+	}
+done:
+	mnt_free_iter(itr);
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static int test_refresh(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb;
+	struct libmnt_tabdiff *df = NULL;
+	struct libmnt_monitor *mn = NULL;
+	struct libmnt_iter *itr = NULL;
+	int rc = -ENOMEM;
+
+	tb = mnt_new_table();
+	if (!tb)
+		return -1;
+	if (argc == 2 && strcmp(argv[1], "--mountinfo") == 0)
+		rc = mnt_table_parse_file(tb, _PATH_PROC_MOUNTINFO);
+	else
+		rc = mnt_table_parse_listmount(tb,
+				argc == 2 ? strtou64_or_err(argv[1], "failed to parse mount ID") : 0, 0);
+	if (rc)
+		goto done;
+
+	rc = -ENOMEM;
+	df = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	mn = mnt_new_monitor();
+	if (!df || !itr || !mn)
+		goto done;
+	rc = mnt_monitor_enable_kernel(mn, 1);
+	if (rc)
+		goto done;
+
+	printf("%d entries, waiting for changes\n", mnt_table_get_nents(tb));
+	while (mnt_monitor_wait(mn, -1) > 0) {
+		struct libmnt_fs *old, *new;
+		int oper;
+
+		while (mnt_monitor_next_change(mn, NULL, NULL) == 0)
+			;
+		rc = mnt_table_refresh_listmount(tb, df);
+		if (rc < 0)
+			break;
+		printf("%d changes, %d entries\n", rc, mnt_table_get_nents(tb));
+
+		mnt_reset_iter(itr, MNT_ITER_FORWARD);
+		while (mnt_tabdiff_next_change(df, itr, &old, &new, &oper) == 0)
+			printf(" %d %s %s\n", oper,
+				mnt_fs_get_source(new ? new : old),
+				mnt_fs_get_target(new ? new : old));
+	}
+done:
+	mnt_unref_monitor(mn);
+	mnt_free_iter(itr);
+	mnt_free_tabdiff(df);
+	mnt_unref_table(tb);
+	return rc < 0 ? rc : 0;
+}
+
 static int test_find_idx(struct libmnt_test *ts, int argc, char *argv[])
 {
 	struct libmnt_table *tb;
@@ -2250,6 +2476,8 @@ int main(int argc, char *argv[])
 	{ "--find-pair",     test_find_pair, "<file> <source> <target>" },
 	{ "--find-fs",       test_find_idx, "<file> <target>" },
 	{ "--find-mountpoint", test_find_mountpoint, "<path>" },
+	{ "--listmount",     test_listmount, "[<unique-id>]  read mounts by listmount(2)" },
+	{ "--refresh",       test_refresh, "[--mountinfo | <unique-id>]  update table on kernel changes" },
 	{ "--copy-fs",       test_copy_fs, "<file>  copy root FS from the file" },
 	{ "--is-mounted",    test_is_mounted, "<fstab> check what from fstab is already mounted" },
 	{ NULL }
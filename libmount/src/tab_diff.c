@@ -17,6 +17,8 @@
  */
 #include "mountP.h"
 
+#define TABDIFF_NOPERS	(MNT_TABDIFF_PROPAGATION + 1)
+
 struct tabdiff_entry {
 	int	oper;			/* MNT_TABDIFF_* flags; */
 
@@ -24,13 +26,18 @@ struct tabdiff_entry {
 	struct libmnt_fs *new_fs;	/* pointer to the new FS */
 
 	struct list_head changes;
+	struct tabdiff_entry *id_next;	/* next in mounts[] bucket */
 };
 
 struct libmnt_tabdiff {
 	int nchanges;			/* number of changes */
+	int nopers[TABDIFF_NOPERS];	/* number of changes per MNT_TABDIFF_* */
 
 	struct list_head changes;	/* list with modified entries */
 	struct list_head unused;	/* list with unused entries */
+
+	struct tabdiff_entry **mounts;	/* MNT_TABDIFF_MOUNT entries hashed by ID */
+	size_t nbuckets;
 };
 
 /**
@@ -82,7 +89,13 @@ void mnt_free_tabdiff(struct libmnt_tabdiff *df)
 			                  struct tabdiff_entry, changes);
 		free_tabdiff_entry(de);
 	}
+	while (!list_empty(&df->unused)) {
+		struct tabdiff_entry *de = list_entry(df->unused.next,
+			                  struct tabdiff_entry, changes);
+		free_tabdiff_entry(de);
+	}
 
+	free(df->mounts);
 	free(df);
 }
 
@@ -124,7 +137,28 @@ int mnt_tabdiff_next_change(struct libmnt_tabdiff *df, struct libmnt_iter *itr,
 	return rc;
 }
 
-static int tabdiff_reset(struct libmnt_tabdiff *df)
+/**
+ * mnt_tabdiff_get_nchanges:
+ * @df: tabdiff pointer
+ * @oper: MNT_TABDIFF_{MOVE,UMOUNT,REMOUNT,MOUNT} or 0
+ *
+ * Returns the result of the last mnt_diff_tables() call without walking
+ * the list of changes.
+ *
+ * Returns: number of changes of the @oper type (or all changes if @oper is
+ * zero), negative number in case of error.
+ *
+ * Since: ext-1
+ */
+int mnt_tabdiff_get_nchanges(struct libmnt_tabdiff *df, int oper)
+{
+	if (!df || oper < 0 || oper >= TABDIFF_NOPERS)
+		return -EINVAL;
+
+	return oper ? df->nopers[oper] : df->nchanges;
+}
+
+int __mnt_tabdiff_reset(struct libmnt_tabdiff *df)
 {
 	assert(df);
 
@@ -147,11 +181,16 @@ static int tabdiff_reset(struct libmnt_tabdiff *df)
 	}
 
 	df->nchanges = 0;
+	memset(df->nopers, 0, sizeof(df->nopers));
+
+	free(df->mounts);
+	df->mounts = NULL;
+	df->nbuckets = 0;
 	return 0;
 }
 
-static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
-			     struct libmnt_fs *new, int oper)
+int __mnt_tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
+			    struct libmnt_fs *new, int oper)
 {
 	struct tabdiff_entry *de;
 
@@ -183,6 +222,43 @@ static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
 
 	list_add_tail(&de->changes, &df->changes);
 	df->nchanges++;
+	df->nopers[oper]++;
+	return 0;
+}
+
+static inline size_t id_to_bucket(struct libmnt_tabdiff *df, int id)
+{
+	return ((unsigned int) id * 2654435761U) & (df->nbuckets - 1);
+}
+
+/*
+ * Hashes the MNT_TABDIFF_MOUNT entries by mount ID, the buckets keep the
+ * order of the changes.
+ */
+static int tabdiff_hash_mounts(struct libmnt_tabdiff *df)
+{
+	struct list_head *p;
+	size_t n = 64;
+
+	while (n < (size_t) df->nopers[MNT_TABDIFF_MOUNT])
+		n <<= 1;
+
+	df->mounts = calloc(n, sizeof(struct tabdiff_entry *));
+	if (!df->mounts)
+		return -ENOMEM;
+	df->nbuckets = n;
+
+	list_for_each_backwardly(p, &df->changes) {
+		struct tabdiff_entry *de, **bk;
+
+		de = list_entry(p, struct tabdiff_entry, changes);
+		if (de->oper != MNT_TABDIFF_MOUNT)
+			continue;
+
+		bk = &df->mounts[id_to_bucket(df, mnt_fs_get_id(de->new_fs))];
+		de->id_next = *bk;
+		*bk = de;
+	}
 	return 0;
 }
 
@@ -190,15 +266,16 @@ static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
 					       const char *src,
 					       int id)
 {
-	struct list_head *p;
+	struct tabdiff_entry *de;
 
 	assert(df);
 
-	list_for_each(p, &df->changes) {
-		struct tabdiff_entry *de;
-
-		de = list_entry(p, struct tabdiff_entry, changes);
+	if (!df->nopers[MNT_TABDIFF_MOUNT])
+		return NULL;
+	if (!df->mounts && tabdiff_hash_mounts(df) != 0)
+		return NULL;
 
+	for (de = df->mounts[id_to_bucket(df, id)]; de; de = de->id_next) {
 		if (de->oper == MNT_TABDIFF_MOUNT && de->new_fs &&
 		    mnt_fs_get_id(de->new_fs) == id) {
 
@@ -234,7 +311,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	if (!df || !old_tab || !new_tab)
 		return -EINVAL;
 
-	tabdiff_reset(df);
+	__mnt_tabdiff_reset(df);
 
 	no = mnt_table_get_nents(old_tab);
 	nn = mnt_table_get_nents(new_tab);
@@ -251,12 +328,12 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	/* all mounted or umounted */
 	if (!no && nn) {
 		while(mnt_table_next_fs(new_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+			__mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
 		goto done;
 
 	} else if (no && !nn) {
 		while(mnt_table_next_fs(old_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+			__mnt_tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		goto done;
 	}
 
@@ -269,7 +346,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 		o_fs = mnt_table_find_pair(old_tab, src, tgt, MNT_ITER_FORWARD);
 		if (!o_fs)
 			/* 'fs' is not in the old table -- so newly mounted */
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+			__mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
 		else {
 			/* is modified? */
 			const char *v1 = mnt_fs_get_vfs_options(o_fs),
@@ -278,7 +355,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 				   *f2 = mnt_fs_get_fs_options(fs);
 
 			if ((v1 && v2 && strcmp(v1, v2) != 0) || (f1 && f2 && strcmp(f1, f2) != 0))
-				tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
+				__mnt_tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
 		}
 	}
 
@@ -297,8 +374,10 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 				mnt_unref_fs(de->old_fs);
 				de->oper = MNT_TABDIFF_MOVE;
 				de->old_fs = fs;
+				df->nopers[MNT_TABDIFF_MOUNT]--;
+				df->nopers[MNT_TABDIFF_MOVE]++;
 			} else
-				tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+				__mnt_tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		}
 	}
 done:
@@ -0,0 +1,311 @@
+/*
+ * tab_index.c - hashed lookup index for libmnt_table
+ *
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The mnt_table_find_{target,srcpath,devno}() functions scan the whole table.
+ * It's expensive for tables with many thousands of entries and callers which
+ * search the table in a loop (e.g. "mount -a" or findmnt --verify). The index
+ * maps the target, source path and device number to the table entries. It's
+ * built on demand (on the second lookup after a table modification, a single
+ * lookup is cheaper than the index), appended by mnt_table_add_fs() and
+ * dropped by all the other table modifications.
+ *
+ * The index returns candidates only, the caller has to compare the entries.
+ * The candidates are returned in the table order (or in the reverse order),
+ * so the lookups return the same entry as the linear scan.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "mountP.h"
+
+/* don't index small tables */
+#define MNT_TABIDX_MINENTS	32
+
+struct tabidx_link {
+	int	next;
+	int	prev;
+};
+
+struct tabidx_bucket {
+	int	head;
+	int	tail;
+};
+
+struct libmnt_tabidx {
+	size_t			nbuckets;	/* power of 2 */
+	int			nents;		/* number of indexed entries */
+	int			nalloc;		/* size of ents[] and links[] */
+	int			ntags;		/* number of entries with TAG= source */
+
+	struct libmnt_fs	**ents;		/* in the table order */
+	struct tabidx_link	*links[MNT_TABIDX_NKEYS];
+	struct tabidx_bucket	*buckets[MNT_TABIDX_NKEYS];
+};
+
+#define FNV_INIT	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+/*
+ * Hash for streq_paths() -- the redundant slashes are ignored, so equal
+ * paths return the same hash.
+ */
+uint64_t mnt_tabidx_hash_path(const char *path)
+{
+	uint64_t h = FNV_INIT;
+	const char *p;
+
+	for (p = path; p && *p; p++) {
+		if (*p == '/' && (*(p + 1) == '/' || *(p + 1) == '\0'))
+			continue;
+		h ^= (unsigned char) *p;
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+uint64_t mnt_tabidx_hash_devno(dev_t devno)
+{
+	uint64_t h = (uint64_t) devno;
+
+	/* 64-bit finalizer from MurmurHash3 */
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static int get_key_hash(struct libmnt_fs *fs, int key, uint64_t *hash)
+{
+	const char *str;
+
+	switch (key) {
+	case MNT_TABIDX_TARGET:
+		str = mnt_fs_get_target(fs);
+		break;
+	case MNT_TABIDX_SRCPATH:
+		str = mnt_fs_get_srcpath(fs);
+		break;
+	case MNT_TABIDX_DEVNO:
+		*hash = mnt_tabidx_hash_devno(mnt_fs_get_devno(fs));
+		return 0;
+	default:
+		return -EINVAL;
+	}
+
+	if (!str)
+		return 1;	/* not indexed */
+	*hash = mnt_tabidx_hash_path(str);
+	return 0;
+}
+
+static void free_index(struct libmnt_tabidx *idx)
+{
+	size_t i;
+
+	if (!idx)
+		return;
+	for (i = 0; i < MNT_TABIDX_NKEYS; i++) {
+		free(idx->links[i]);
+		free(idx->buckets[i]);
+	}
+	free(idx->ents);
+	free(idx);
+}
+
+/*
+ * Drops the index; called on all table modifications and when any indexed
+ * item of the table entry is modified.
+ */
+void mnt_table_reset_index(struct libmnt_table *tb)
+{
+	if (!tb)
+		return;
+	if (tb->idx) {
+		DBG(TAB, ul_debugobj(tb, "index: reset"));
+		free_index(tb->idx);
+		tb->idx = NULL;
+	}
+	tb->idx_lookups = 0;
+
+	/* the cached btrfs default subvolumes depend on the table too */
+	mnt_table_reset_btrfs_cache(tb);
+}
+
+static int index_resize(struct libmnt_tabidx *idx, int nalloc)
+{
+	struct libmnt_fs **ents;
+	size_t i;
+
+	ents = realloc(idx->ents, nalloc * sizeof(*ents));
+	if (!ents)
+		return -ENOMEM;
+	idx->ents = ents;
+
+	for (i = 0; i < MNT_TABIDX_NKEYS; i++) {
+		struct tabidx_link *links;
+
+		links = realloc(idx->links[i], nalloc * sizeof(*links));
+		if (!links)
+			return -ENOMEM;
+		idx->links[i] = links;
+	}
+	idx->nalloc = nalloc;
+	return 0;
+}
+
+static int index_append(struct libmnt_tabidx *idx, struct libmnt_fs *fs)
+{
+	int n = idx->nents;
+	size_t i;
+
+	if (n == idx->nalloc && index_resize(idx, n * 2) != 0)
+		return -ENOMEM;
+
+	idx->ents[n] = fs;
+
+	for (i = 0; i < MNT_TABIDX_NKEYS; i++) {
+		struct tabidx_link *ln = &idx->links[i][n];
+		struct tabidx_bucket *bk;
+		uint64_t hash;
+
+		ln->next = ln->prev = -1;
+		if (get_key_hash(fs, i, &hash) != 0)
+			continue;
+
+		bk = &idx->buckets[i][hash & (idx->nbuckets - 1)];
+		if (bk->tail < 0)
+			bk->head = n;
+		else {
+			idx->links[i][bk->tail].next = n;
+			ln->prev = bk->tail;
+		}
+		bk->tail = n;
+	}
+
+	if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
+		idx->ntags++;
+	idx->nents++;
+	return 0;
+}
+
+static struct libmnt_tabidx *build_index(struct libmnt_table *tb)
+{
+	struct libmnt_tabidx *idx;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	size_t i, k;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+
+	idx->nbuckets = 64;
+	while (idx->nbuckets < (size_t) tb->nents)
+		idx->nbuckets <<= 1;
+
+	for (i = 0; i < MNT_TABIDX_NKEYS; i++) {
+		idx->buckets[i] = malloc(idx->nbuckets * sizeof(struct tabidx_bucket));
+		if (!idx->buckets[i])
+			goto err;
+		for (k = 0; k < idx->nbuckets; k++)
+			idx->buckets[i][k].head = idx->buckets[i][k].tail = -1;
+	}
+	if (index_resize(idx, tb->nents) != 0)
+		goto err;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (index_append(idx, fs) != 0)
+			goto err;
+	}
+
+	DBG(TAB, ul_debugobj(tb, "index: %d entries, %zu buckets",
+				idx->nents, idx->nbuckets));
+	return idx;
+err:
+	free_index(idx);
+	return NULL;
+}
+
+/*
+ * Called by mnt_table_add_fs() after the new entry has been added to the end
+ * of the table.
+ */
+void mnt_table_index_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	struct libmnt_tabidx *idx = tb->idx;
+
+	if (!idx)
+		return;
+
+	/* too many collisions, let's rebuild it later */
+	if ((size_t) idx->nents >= idx->nbuckets * 2
+	    || index_append(idx, fs) != 0)
+		mnt_table_reset_index(tb);
+}
+
+/*
+ * Returns the number of entries with TAG= source, or -1 if the index is not
+ * available.
+ */
+int mnt_table_index_get_ntags(struct libmnt_table *tb)
+{
+	return tb->idx ? tb->idx->ntags : -1;
+}
+
+/*
+ * Initializes @itr to walk the entries with the @hash of the @key item. The
+ * index is built if necessary.
+ *
+ * Returns: 0 on success, 1 if the index is not available (the caller has to
+ * scan the table).
+ */
+int mnt_table_index_init_iter(struct libmnt_table *tb,
+			      struct libmnt_tabidx_iter *itr,
+			      int key, uint64_t hash, int direction)
+{
+	struct tabidx_bucket *bk;
+
+	if (!tb || key < 0 || key >= MNT_TABIDX_NKEYS)
+		return 1;
+
+	if (!tb->idx) {
+		if (tb->nents < MNT_TABIDX_MINENTS || ++tb->idx_lookups < 2)
+			return 1;
+		tb->idx = build_index(tb);
+		if (!tb->idx)
+			return 1;
+	}
+
+	bk = &tb->idx->buckets[key][hash & (tb->idx->nbuckets - 1)];
+
+	itr->key = key;
+	itr->direction = direction;
+	itr->cur = direction == MNT_ITER_FORWARD ? bk->head : bk->tail;
+	return 0;
+}
+
+/*
+ * Returns: the next candidate or NULL at the end.
+ */
+struct libmnt_fs *mnt_table_index_next(struct libmnt_table *tb,
+				       struct libmnt_tabidx_iter *itr)
+{
+	struct tabidx_link *ln;
+	struct libmnt_fs *fs;
+
+	if (!tb->idx || itr->cur < 0)
+		return NULL;
+
+	fs = tb->idx->ents[itr->cur];
+	ln = &tb->idx->links[itr->key][itr->cur];
+	itr->cur = itr->direction == MNT_ITER_FORWARD ? ln->next : ln->prev;
+	return fs;
+}
@@ -16,12 +16,14 @@
 #endif	/* HAVE_SCANDIRAT */
 
 #include <ctype.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 
 #include "fileutils.h"
+#include "mount-api-utils.h"
 #include "mangle.h"
 #include "mountP.h"
 #include "pathnames.h"
@@ -299,6 +301,193 @@ fail:
 	return rc;
 }
 
+/*
+ * Terminates and unmangles the field in place. Returns NULL for an empty field.
+ */
+static char *next_field_inplace(char **str)
+{
+	char *s = *str, *e;
+
+	e = (char *) skip_nonspearator(s);
+	if (e == s)
+		return NULL;
+	if (*e)
+		*e++ = '\0';
+	*str = e;
+
+	unmangle_string(s);
+	return s;
+}
+
+/*
+ * Returns 1 if @target is mountpoint of the pre-filter or it's below it.
+ */
+static int prefilter_match_target(struct libmnt_table *tb, const char *target)
+{
+	size_t len;
+
+	if (!tb->pf_target)
+		return 1;
+	if (!target)
+		return 0;
+	if (strcmp(tb->pf_target, "/") == 0)
+		return 1;
+
+	len = strlen(tb->pf_target);
+	return strncmp(target, tb->pf_target, len) == 0
+		&& (target[len] == '\0' || target[len] == '/');
+}
+
+/*
+ * Returns 1 if the already parsed @fs matches the pre-filter.
+ */
+static int prefilter_match_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	if (tb->pf_id >= 0 && tb->fmt == MNT_FMT_MOUNTINFO
+	    && mnt_fs_get_id(fs) != tb->pf_id)
+		return 0;
+	if (tb->pf_fstypes && !mnt_fs_match_fstype(fs, tb->pf_fstypes))
+		return 0;
+	return prefilter_match_target(tb, mnt_fs_get_target(fs));
+}
+
+/*
+ * Parses one line from a mountinfo file in place, the strings of @fs point
+ * to the line. The parser stops on the first field which does not match the
+ * table pre-filter.
+ *
+ * Returns: 0 on success, 1 if the line is filtered out, negative number in
+ * case of error.
+ */
+static int mnt_parse_mountinfo_line_inplace(struct libmnt_table *tb,
+					    struct libmnt_fs *fs, char *s)
+{
+	int rc = 0;
+	unsigned int maj, min;
+	char *p;
+
+	fs->flags |= MNT_FS_KERNEL | MNT_FS_LAZYOPTS;
+
+	/* (1) id */
+	s = (char *) next_s32(s, &fs->id, &rc);
+	if (!s || !*s || rc) {
+		DBG(TAB, ul_debug("tab parse error: [id]"));
+		goto fail;
+	}
+	if (tb->pf_id >= 0 && fs->id != tb->pf_id)
+		return 1;
+
+	s = (char *) skip_separator(s);
+
+	/* (2) parent */
+	s = (char *) next_s32(s, &fs->parent, &rc);
+	if (!s || !*s || rc) {
+		DBG(TAB, ul_debug("tab parse error: [parent]"));
+		goto fail;
+	}
+
+	s = (char *) skip_separator(s);
+
+	/* (3) maj:min */
+	if (sscanf(s, "%u:%u", &maj, &min) != 2) {
+		DBG(TAB, ul_debug("tab parse error: [maj:min]"));
+		goto fail;
+	}
+	fs->devno = makedev(maj, min);
+	s = (char *) skip_nonspearator(s);
+	s = (char *) skip_separator(s);
+
+	/* (4) mountroot */
+	fs->root = next_field_inplace(&s);
+	if (!fs->root) {
+		DBG(TAB, ul_debug("tab parse error: [mountroot]"));
+		goto fail;
+	}
+
+	s = (char *) skip_separator(s);
+
+	/* (5) target */
+	fs->target = next_field_inplace(&s);
+	if (!fs->target) {
+		DBG(TAB, ul_debug("tab parse error: [target]"));
+		goto fail;
+	}
+	if (!prefilter_match_target(tb, fs->target))
+		return 1;
+
+	s = (char *) skip_separator(s);
+
+	/* (6) vfs options (fs-independent) */
+	fs->vfs_optstr = next_field_inplace(&s);
+	if (!fs->vfs_optstr) {
+		DBG(TAB, ul_debug("tab parse error: [VFS options]"));
+		goto fail;
+	}
+
+	/* (7) optional fields, terminated by " - " */
+	if (strncmp(s, "- ", 2) == 0)
+		s += 2;
+	else {
+		p = strstr(s, " - ");
+		if (!p) {
+			DBG(TAB, ul_debug("mountinfo parse error: separator not found"));
+			return -EINVAL;
+		}
+		*p = '\0';
+		if (p > s)
+			fs->opt_fields = s;
+		s = p + 3;
+	}
+
+	s = (char *) skip_separator(s);
+
+	/* (8) FS type */
+	p = next_field_inplace(&s);
+	if (!p) {
+		DBG(TAB, ul_debug("tab parse error: [fstype]"));
+		goto fail;
+	}
+	if (tb->pf_fstypes && !mnt_match_fstype(p, tb->pf_fstypes))
+		return 1;
+	if ((rc = __mnt_fs_set_fstype_ptr(fs, p))) {
+		DBG(TAB, ul_debug("tab parse error: [fstype]"));
+		goto fail;
+	}
+
+	/* (9) source -- maybe empty string */
+	if (!*s) {
+		DBG(TAB, ul_debug("tab parse error: [source]"));
+		goto fail;
+	} else if (*s == ' ') {
+		if ((rc = mnt_fs_set_source(fs, ""))) {
+			DBG(TAB, ul_debug("tab parse error: [empty source]"));
+			goto fail;
+		}
+	} else {
+		p = next_field_inplace(&s);
+		if (!p || (rc = __mnt_fs_set_source_ptr(fs, p))) {
+			DBG(TAB, ul_debug("tab parse error: [regular source]"));
+			goto fail;
+		}
+	}
+
+	s = (char *) skip_separator(s);
+
+	/* (10) fs options (fs specific) */
+	fs->fs_optstr = next_field_inplace(&s);
+	if (!fs->fs_optstr) {
+		DBG(TAB, ul_debug("tab parse error: [FS options]"));
+		goto fail;
+	}
+
+	return 0;
+fail:
+	if (rc == 0)
+		rc = -EINVAL;
+	DBG(TAB, ul_debug("tab parse error on: '%s' [rc=%d]", s, rc));
+	return rc;
+}
+
 /*
  * Parses one line from utab file
  */
@@ -492,9 +681,12 @@ static int is_terminated_by_blank(const char *str)
  */
 static int next_comment_line(struct libmnt_parser *pa, char **last)
 {
-	if (getline(&pa->buf, &pa->bufsiz, pa->f) < 0)
+	ssize_t len = getline(&pa->buf, &pa->bufsiz, pa->f);
+
+	if (len < 0)
 		return feof(pa->f) ? 1 : -errno;
 
+	STAT_ADD(TAB_READ_BYTES, len);
 	pa->line++;
 	*last = strchr(pa->buf, '\n');
 
@@ -536,6 +728,7 @@ static int mnt_table_parse_next(struct libmnt_parser *pa,
 				struct libmnt_fs *fs)
 {
 	char *s;
+	ssize_t len;
 	int rc;
 
 	assert(tb);
@@ -545,8 +738,10 @@ static int mnt_table_parse_next(struct libmnt_parser *pa,
 	/* read the next non-blank non-comment line */
 next_line:
 	do {
-		if (getline(&pa->buf, &pa->bufsiz, pa->f) < 0)
+		len = getline(&pa->buf, &pa->bufsiz, pa->f);
+		if (len < 0)
 			return -EINVAL;
+		STAT_ADD(TAB_READ_BYTES, len);
 		pa->line++;
 		s = strchr(pa->buf, '\n');
 		if (!s) {
@@ -691,29 +886,13 @@ static int kernel_fs_postparse(struct libmnt_table *tb,
 	return rc;
 }
 
-/**
- * mnt_table_parse_stream:
- * @tb: tab pointer
- * @f: file stream
- * @filename: filename used for debug and error messages
- *
- * Returns: 0 on success, negative number in case of error.
- */
-int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filename)
+static int table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filename)
 {
 	int rc = -1;
 	int flags = 0;
 	pid_t tid = -1;
 	struct libmnt_parser pa = { .line = 0 };
 
-	assert(tb);
-	assert(f);
-	assert(filename);
-
-	DBG(TAB, ul_debugobj(tb, "%s: start parsing [entries=%d, filter=%s]",
-				filename, mnt_table_get_nents(tb),
-				tb->fltrcb ? "yes" : "not"));
-
 	pa.filename = filename;
 	pa.f = f;
 
@@ -739,6 +918,9 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 		/* parse */
 		rc = mnt_table_parse_next(&pa, tb, fs);
 
+		if (rc == 0 && !prefilter_match_fs(tb, fs))
+			rc = 1;	/* filtered out by pre-filter */
+
 		if (rc == 0 && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
 			rc = 1;	/* filtered out by callback... */
 
@@ -780,6 +962,244 @@ err:
 	return rc;
 }
 
+/* reads the rest of @f to a new buffer */
+static int read_stream(FILE *f, char **data, size_t *datasz)
+{
+	struct stat st;
+	char *buf = NULL;
+	size_t bufsz = 16384, sz = 0;
+
+	if (fileno(f) >= 0 && fstat(fileno(f), &st) == 0
+	    && S_ISREG(st.st_mode) && st.st_size > 0)
+		bufsz = st.st_size + 1;
+
+	do {
+		size_t ret;
+
+		if (sz == bufsz || !buf) {
+			char *tmp;
+
+			if (buf)
+				bufsz *= 2;
+			tmp = realloc(buf, bufsz);
+			if (!tmp) {
+				free(buf);
+				return -ENOMEM;
+			}
+			buf = tmp;
+		}
+
+		ret = fread(buf + sz, 1, bufsz - sz, f);
+		sz += ret;
+		if (ret == 0 && ferror(f)) {
+			free(buf);
+			return -errno;
+		}
+	} while (!feof(f));
+
+	STAT_ADD(TAB_READ_BYTES, sz);
+	*data = buf;
+	*datasz = sz;
+	return 0;
+}
+
+/* returns a copy of the first non-blank and non-comment line */
+static char *strdup_first_line(const char *buf, const char *end)
+{
+	const char *p = buf;
+
+	while (p < end) {
+		const char *s = p, *nl = memchr(p, '\n', end - p);
+
+		p = nl ? nl + 1 : end;
+		while (s < p && isblank((unsigned char) *s))
+			s++;
+		if (s < p && *s != '\n' && *s != '\r' && *s != '#')
+			return strndup(s, (nl ? nl : end) - s);
+	}
+	return NULL;
+}
+
+/*
+ * Parses mountinfo in place -- the whole file is read to one buffer and the
+ * strings of the entries point to the buffer. The buffer is deallocated with
+ * the last entry.
+ *
+ * The entry is allocated for the first line and it's reused for the next
+ * lines until it's added to the table, so the lines rejected by the
+ * pre-filter or by the filter callback do not allocate anything.
+ *
+ * Returns: 0 on success, negative number in case of error, or 1 if the file
+ * is not mountinfo, @data and @datasz are untouched in this case.
+ */
+static int table_parse_mountinfo_buffer(struct libmnt_table *tb, char **data,
+					size_t datasz, const char *filename)
+{
+	struct libmnt_strbuf *sb;
+	struct libmnt_fs *fs = NULL;
+	char *buf, *p, *end;
+	size_t line = 0;
+	pid_t tid = -1;
+	int rc = 0;
+
+	if (tb->fmt == MNT_FMT_GUESS) {
+		char *ln = strdup_first_line(*data, *data + datasz);
+		int fmt;
+
+		if (!ln)
+			return 1;
+		fmt = guess_table_format(ln);
+		free(ln);
+		if (fmt != MNT_FMT_MOUNTINFO)
+			return 1;
+		tb->fmt = MNT_FMT_MOUNTINFO;
+	}
+
+	buf = realloc(*data, datasz + 1);
+	if (!buf)
+		return -ENOMEM;
+	*data = NULL;
+
+	sb = mnt_new_strbuf(buf, datasz + 1);
+	if (!sb) {
+		free(buf);
+		return -ENOMEM;
+	}
+
+	buf[datasz] = '\0';
+	end = buf + datasz;
+
+	for (p = buf; p < end; ) {
+		char *s = p, *eol = memchr(p, '\n', end - p);
+
+		if (!eol)
+			eol = end;
+		*eol = '\0';
+		p = eol + 1;
+		line++;
+
+		if (eol > s && *(eol - 1) == '\r')
+			*(eol - 1) = '\0';
+		s = (char *) skip_blank(s);
+		if (!*s || *s == '#')
+			continue;
+
+		if (!fs) {
+			fs = mnt_new_fs();
+			if (!fs) {
+				rc = -ENOMEM;
+				break;
+			}
+		}
+		fs->strbuf = sb;
+		mnt_ref_strbuf(sb);
+
+		rc = mnt_parse_mountinfo_line_inplace(tb, fs, s);
+		if (rc < 0) {
+			DBG(TAB, ul_debugobj(tb, "%s:%zu: mountinfo parse error",
+						filename, line));
+			rc = tb->errcb ? tb->errcb(tb, filename, line) : 1;
+		}
+
+		if (rc == 0 && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+			rc = 1;	/* filtered out by callback... */
+
+		if (rc == 0) {
+			rc = mnt_table_add_fs(tb, fs);
+			if (rc == 0) {
+				rc = kernel_fs_postparse(tb, fs, &tid, filename);
+				if (rc)
+					mnt_table_remove_fs(tb, fs);
+			}
+		}
+
+		if (rc == 0 || fs->refcount > 1) {
+			/* owned by the table (or by the filter callback) */
+			mnt_unref_fs(fs);
+			fs = NULL;
+		} else
+			mnt_reset_fs(fs);
+
+		/* fatal errors, ignored on the last line */
+		if (rc < 0 && p < end) {
+			DBG(TAB, ul_debugobj(tb, "fatal error"));
+			break;
+		}
+		rc = 0;
+	}
+
+	mnt_unref_fs(fs);
+	mnt_unref_strbuf(sb);
+
+	DBG(TAB, ul_debugobj(tb, "%s: stop in-place parsing (%d entries, rc=%d)",
+				filename, mnt_table_get_nents(tb), rc));
+	return rc;
+}
+
+static int parse_stream(struct libmnt_table *tb, FILE *f, const char *filename)
+{
+	char *data = NULL;
+	size_t datasz = 0;
+	FILE *memf;
+	int rc;
+
+	DBG(TAB, ul_debugobj(tb, "%s: start parsing [entries=%d, filter=%s]",
+				filename, mnt_table_get_nents(tb),
+				tb->fltrcb ? "yes" : "not"));
+
+	/* mountinfo is parsed in place, comments are supported for fstab only */
+	if (tb->fmt != MNT_FMT_MOUNTINFO
+	    && (tb->fmt != MNT_FMT_GUESS || tb->comms))
+		return table_parse_stream(tb, f, filename);
+
+	rc = read_stream(f, &data, &datasz);
+	if (rc)
+		return rc;
+	if (!datasz) {
+		free(data);
+		return 0;
+	}
+
+	rc = table_parse_mountinfo_buffer(tb, &data, datasz, filename);
+	if (rc != 1) {
+		free(data);
+		return rc;
+	}
+
+	/* not mountinfo, use the line parser */
+	memf = fmemopen(data, datasz, "r");
+	if (!memf) {
+		rc = -errno;
+		free(data);
+		return rc;
+	}
+	rc = table_parse_stream(tb, memf, filename);
+	fclose(memf);
+	free(data);
+	return rc;
+}
+
+/**
+ * mnt_table_parse_stream:
+ * @tb: tab pointer
+ * @f: file stream
+ * @filename: filename used for debug and error messages
+ *
+ * Returns: 0 on success, negative number in case of error.
+ */
+int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filename)
+{
+	int rc;
+
+	assert(tb);
+	assert(f);
+	assert(filename);
+
+	STAT_ADD(TAB_PARSE, 1);
+	STAT_TIME(TAB_PARSE_NS, rc = parse_stream(tb, f, filename));
+	return rc;
+}
+
 /**
  * mnt_table_parse_file:
  * @tb: tab pointer
@@ -811,16 +1231,723 @@ int mnt_table_parse_file(struct libmnt_table *tb, const char *filename)
 	return rc;
 }
 
-static int mnt_table_parse_dir_filter(const struct dirent *d)
+/*
+ * Parses utab file under a shared lock. The updaters append new entries to
+ * the file and comment out the removed entries in place (see tab_update.c);
+ * the lock protects readers against a partially appended last line. The
+ * other updates (compaction, move and remount) replace the file by rename(2)
+ * and don't need the lock. The file is parsed without the lock if the lock
+ * file is not available (no update has been done yet, or read-only /run).
+ *
+ * Don't use it when the caller holds the update lock, flock() locks are per
+ * file descriptor and the shared lock would wait for the caller.
+ */
+int mnt_table_parse_utab(struct libmnt_table *tb, const char *filename)
 {
-	size_t namesz;
+	struct libmnt_lock *ml;
+	int rc;
 
-#ifdef _DIRENT_HAVE_D_TYPE
-	if (d->d_type != DT_UNKNOWN && d->d_type != DT_REG &&
-	    d->d_type != DT_LNK)
-		return 0;
-#endif
-	if (*d->d_name == '.')
+	if (!filename || !tb)
+		return -EINVAL;
+
+	tb->fmt = MNT_FMT_UTAB;
+
+	ml = mnt_new_lock(filename, 0);
+	if (ml) {
+		mnt_lock_use_simplelock(ml, TRUE);
+		mnt_lock_use_shared(ml, TRUE);
+		if (mnt_lock_file(ml) != 0) {
+			DBG(TAB, ul_debugobj(tb, "utab: parse without lock"));
+			mnt_unref_lock(ml);
+			ml = NULL;
+		}
+	}
+
+	rc = mnt_table_parse_file(tb, filename);
+
+	if (ml) {
+		mnt_unlock_file(ml);
+		mnt_unref_lock(ml);
+	}
+	return rc;
+}
+
+#ifdef HAVE_STATMOUNT_API
+/* fields returned for all mounts by kernels which support them */
+#define STATMOUNT_ALWAYS_MASK	(STATMOUNT_SB_BASIC | STATMOUNT_MNT_BASIC | \
+				 STATMOUNT_MNT_ROOT | STATMOUNT_MNT_POINT | \
+				 STATMOUNT_FS_TYPE | STATMOUNT_SB_SOURCE)
+
+#define STATMOUNT_DEFAULT_MASK	(STATMOUNT_ALWAYS_MASK | STATMOUNT_PROPAGATE_FROM | \
+				 STATMOUNT_MNT_OPTS | STATMOUNT_FS_SUBTYPE | \
+				 STATMOUNT_OPT_SEC_ARRAY)
+
+#define LISTMOUNT_NIDS		512
+
+/* the same order as in /proc/self/mountinfo */
+static int statmount_vfs_options(struct ul_statmount *sm, char **res)
+{
+	uint64_t attr = sm->mnt_attr, atime = attr & MOUNT_ATTR__ATIME;
+	int rc;
+
+	rc = mnt_optstr_append_option(res, attr & MOUNT_ATTR_RDONLY ? "ro" : "rw", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NOSUID))
+		rc = mnt_optstr_append_option(res, "nosuid", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NODEV))
+		rc = mnt_optstr_append_option(res, "nodev", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NOEXEC))
+		rc = mnt_optstr_append_option(res, "noexec", NULL);
+	if (!rc && atime == MOUNT_ATTR_NOATIME)
+		rc = mnt_optstr_append_option(res, "noatime", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NODIRATIME))
+		rc = mnt_optstr_append_option(res, "nodiratime", NULL);
+	if (!rc && atime == MOUNT_ATTR_RELATIME)
+		rc = mnt_optstr_append_option(res, "relatime", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NOSYMFOLLOW))
+		rc = mnt_optstr_append_option(res, "nosymfollow", NULL);
+	if (!rc && (attr & MOUNT_ATTR_IDMAP))
+		rc = mnt_optstr_append_option(res, "idmapped", NULL);
+	return rc;
+}
+
+static int statmount_fs_options(struct ul_statmount *sm, char **res)
+{
+	int rc = 0;
+
+	if (sm->mask & STATMOUNT_SB_BASIC) {
+		rc = mnt_optstr_append_option(res, sm->sb_flags & MS_RDONLY ? "ro" : "rw", NULL);
+		if (!rc && (sm->sb_flags & MS_SYNCHRONOUS))
+			rc = mnt_optstr_append_option(res, "sync", NULL);
+		if (!rc && (sm->sb_flags & MS_DIRSYNC))
+			rc = mnt_optstr_append_option(res, "dirsync", NULL);
+		if (!rc && (sm->sb_flags & MS_MANDLOCK))
+			rc = mnt_optstr_append_option(res, "mand", NULL);
+		if (!rc && (sm->sb_flags & MS_LAZYTIME))
+			rc = mnt_optstr_append_option(res, "lazytime", NULL);
+	}
+	if (!rc && (sm->mask & STATMOUNT_OPT_SEC_ARRAY)) {
+		const char *p = sm->str + sm->opt_sec_array;
+		uint32_t i;
+
+		for (i = 0; rc == 0 && i < sm->opt_sec_num; i++) {
+			rc = mnt_optstr_append_option(res, p, NULL);
+			p += strlen(p) + 1;
+		}
+	}
+	if (!rc && (sm->mask & STATMOUNT_MNT_OPTS))
+		rc = mnt_optstr_append_option(res, sm->str + sm->mnt_opts, NULL);
+	return rc;
+}
+
+static int statmount_opt_fields(struct ul_statmount *sm, char **res)
+{
+	char buf[128], *p = buf;
+	size_t sz = sizeof(buf);
+
+	*p = '\0';
+	if (sm->mnt_propagation & MS_SHARED)
+		p += snprintf(p, sz - (p - buf), "shared:%" PRIu64 " ",
+				sm->mnt_peer_group);
+	if (sm->mnt_propagation & MS_SLAVE) {
+		p += snprintf(p, sz - (p - buf), "master:%" PRIu64 " ",
+				sm->mnt_master);
+		if ((sm->mask & STATMOUNT_PROPAGATE_FROM) && sm->propagate_from
+		    && sm->propagate_from != sm->mnt_master)
+			p += snprintf(p, sz - (p - buf), "propagate_from:%" PRIu64 " ",
+					sm->propagate_from);
+	}
+	if (sm->mnt_propagation & MS_UNBINDABLE)
+		p += snprintf(p, sz - (p - buf), "unbindable ");
+
+	if (p == buf)
+		return 0;
+	*(p - 1) = '\0';	/* remove the last space */
+	*res = strdup(buf);
+	return *res ? 0 : -ENOMEM;
+}
+
+static int fs_from_statmount(struct libmnt_fs *fs, struct ul_statmount *sm)
+{
+	int rc = 0;
+
+	fs->flags |= MNT_FS_KERNEL;
+
+	if (sm->mask & STATMOUNT_MNT_BASIC) {
+		fs->uniq_id = sm->mnt_id;
+		fs->id = sm->mnt_id_old;
+		fs->parent = sm->mnt_parent_id_old;
+
+		rc = statmount_vfs_options(sm, &fs->vfs_optstr);
+		if (!rc)
+			rc = statmount_opt_fields(sm, &fs->opt_fields);
+	}
+	if (!rc)
+		rc = statmount_fs_options(sm, &fs->fs_optstr);
+	if (!rc && (fs->vfs_optstr || fs->fs_optstr))
+		fs->flags |= MNT_FS_LAZYOPTS;
+
+	if (sm->mask & STATMOUNT_SB_BASIC)
+		fs->devno = makedev(sm->sb_dev_major, sm->sb_dev_minor);
+
+	if (!rc && (sm->mask & STATMOUNT_MNT_ROOT))
+		rc = mnt_fs_set_root(fs, sm->str + sm->mnt_root);
+	if (!rc && (sm->mask & STATMOUNT_MNT_POINT))
+		rc = mnt_fs_set_target(fs, sm->str + sm->mnt_point);
+	if (!rc && (sm->mask & STATMOUNT_SB_SOURCE))
+		rc = mnt_fs_set_source(fs, sm->str + sm->sb_source);
+
+	if (!rc && (sm->mask & STATMOUNT_FS_TYPE)) {
+		char *type = NULL;
+
+		if (!(sm->mask & STATMOUNT_FS_SUBTYPE))
+			type = strdup(sm->str + sm->fs_type);
+		else if (asprintf(&type, "%s.%s", sm->str + sm->fs_type,
+					sm->str + sm->fs_subtype) < 0)
+			type = NULL;
+		if (!type)
+			rc = -ENOMEM;
+		else
+			rc = __mnt_fs_set_fstype_ptr(fs, type);
+	}
+	return rc;
+}
+
+/*
+ * Calls statmount(), the buffer is reallocated if necessary.
+ */
+static int do_statmount(uint64_t id, uint64_t mask,
+			struct ul_statmount **sm, size_t *smsz)
+{
+	STAT_ADD(STATMOUNT, 1);
+
+	while (ul_statmount(id, mask, *sm, *smsz, 0) != 0) {
+		struct ul_statmount *p;
+
+		STAT_ADD(STATMOUNT, 1);
+		if (errno != EOVERFLOW)
+			return -errno;
+		p = realloc(*sm, *smsz * 2);
+		if (!p)
+			return -ENOMEM;
+		*sm = p;
+		*smsz *= 2;
+	}
+	return 0;
+}
+
+/*
+ * Returns: 0 and the new entry in @res, 1 if the entry is filtered out, or
+ * negative number in case of error.
+ */
+static int statmount_new_fs(struct libmnt_table *tb, uint64_t id, uint64_t mask,
+			    struct ul_statmount **sm, size_t *smsz, pid_t *tid,
+			    struct libmnt_fs **res)
+{
+	struct libmnt_fs *fs;
+	int rc;
+
+	rc = do_statmount(id, mask, sm, smsz);
+	if (rc)
+		return rc;
+
+	fs = mnt_new_fs();
+	if (!fs)
+		return -ENOMEM;
+
+	rc = fs_from_statmount(fs, *sm);
+	if (rc == 0 && !prefilter_match_fs(tb, fs))
+		rc = 1;	/* filtered out by pre-filter */
+	if (rc == 0 && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+		rc = 1;	/* filtered out by callback... */
+	if (rc == 0)
+		rc = kernel_fs_postparse(tb, fs, tid, _PATH_PROC_MOUNTINFO);
+	if (rc == 0)
+		*res = fs;
+	else
+		mnt_unref_fs(fs);
+	return rc;
+}
+
+static int table_add_statmount(struct libmnt_table *tb, uint64_t id, uint64_t mask,
+			       struct ul_statmount **sm, size_t *smsz, pid_t *tid)
+{
+	struct libmnt_fs *fs = NULL;
+	int rc;
+
+	rc = statmount_new_fs(tb, id, mask, sm, smsz, tid, &fs);
+	if (rc == 0) {
+		rc = mnt_table_add_fs(tb, fs);
+		mnt_unref_fs(fs);
+	}
+	return rc < 0 ? rc : 0;
+}
+
+/*
+ * Returns: 0 on success, 1 if listmount() is not available, or negative
+ * number in case of error.
+ */
+static int table_fetch_listmount(struct libmnt_table *tb, uint64_t id, uint64_t mask)
+{
+	uint64_t ids[LISTMOUNT_NIDS], last = 0;
+	struct ul_statmount *sm;
+	size_t smsz = 4096;
+	size_t nents = 0;
+	pid_t tid = -1;
+	int rc = 0;
+
+	sm = malloc(smsz);
+	if (!sm)
+		return -ENOMEM;
+
+	if (tb->fmt == MNT_FMT_GUESS)
+		tb->fmt = MNT_FMT_MOUNTINFO;
+
+	/* listmount() returns the mounts below @id only */
+	if (id) {
+		rc = table_add_statmount(tb, id, mask, &sm, &smsz, &tid);
+		if (rc)
+			goto done;
+	}
+
+	do {
+		ssize_t i, n;
+
+		n = ul_listmount(id ? id : LSMT_ROOT, last, ids, LISTMOUNT_NIDS, 0);
+		STAT_ADD(LISTMOUNT, 1);
+		if (n < 0) {
+			rc = -errno;
+			break;
+		}
+		for (i = 0; i < n && rc == 0; i++) {
+			rc = table_add_statmount(tb, ids[i], mask, &sm, &smsz, &tid);
+			if (rc == -ENOENT)
+				rc = 0;		/* unmounted in the meantime */
+		}
+		nents += n;
+		if (rc || n < LISTMOUNT_NIDS)
+			break;
+		last = ids[n - 1];
+	} while (1);
+done:
+	free(sm);
+
+	if ((rc == -ENOSYS || rc == -EPERM) && !id && !nents) {
+		DBG(TAB, ul_debugobj(tb, "listmount() not available"));
+		rc = 1;
+	}
+	return rc;
+}
+
+struct refresh_ctl {
+	struct libmnt_table	*tb;
+	struct libmnt_tabdiff	*df;		/* or NULL */
+	struct libmnt_iter	itr;
+	struct libmnt_fs	*cur;		/* the next not compared table entry */
+
+	struct ul_statmount	*sm;
+	size_t			smsz;
+	pid_t			tid;
+	int			nchanges;
+};
+
+static inline int strings_differ(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a != b;
+	return strcmp(a, b) != 0;
+}
+
+/*
+ * Compares two versions of the same mount (the unique ID is the same).
+ */
+static int refresh_get_oper(struct libmnt_fs *old, struct libmnt_fs *new)
+{
+	if (!streq_paths(mnt_fs_get_target(old), mnt_fs_get_target(new))
+	    || mnt_fs_get_parent_id(old) != mnt_fs_get_parent_id(new))
+		return MNT_TABDIFF_MOVE;
+	if (strings_differ(mnt_fs_get_vfs_options(old), mnt_fs_get_vfs_options(new))
+	    || strings_differ(mnt_fs_get_fs_options(old), mnt_fs_get_fs_options(new)))
+		return MNT_TABDIFF_REMOUNT;
+	if (strings_differ(mnt_fs_get_optional_fields(old), mnt_fs_get_optional_fields(new)))
+		return MNT_TABDIFF_PROPAGATION;
+	return 0;
+}
+
+static int refresh_add_change(struct refresh_ctl *rf, struct libmnt_fs *old,
+			      struct libmnt_fs *new, int oper)
+{
+	rf->nchanges++;
+	return rf->df ? __mnt_tabdiff_add_entry(rf->df, old, new, oper) : 0;
+}
+
+static int refresh_umount(struct refresh_ctl *rf, struct libmnt_fs *fs)
+{
+	int rc = refresh_add_change(rf, fs, NULL, MNT_TABDIFF_UMOUNT);
+
+	if (!rc)
+		rc = mnt_table_remove_fs(rf->tb, fs);
+	return rc;
+}
+
+/*
+ * Applies the mount @id returned by listmount(). The IDs are applied in
+ * ascending order and the table is sorted by the IDs too, so the table entries
+ * with a lower ID are not mounted anymore.
+ */
+static int refresh_id(struct refresh_ctl *rf, uint64_t id)
+{
+	struct libmnt_table *tb = rf->tb;
+	struct libmnt_fs *fs = NULL, *old = NULL;
+	int rc = 0;
+
+	while (rc == 0 && rf->cur && rf->cur->uniq_id < id) {
+		old = rf->cur;
+		mnt_table_next_fs(tb, &rf->itr, &rf->cur);
+		rc = refresh_umount(rf, old);
+	}
+	if (rc)
+		return rc;
+
+	old = NULL;
+	if (rf->cur && rf->cur->uniq_id == id) {
+		old = rf->cur;
+		mnt_table_next_fs(tb, &rf->itr, &rf->cur);
+	}
+
+	rc = statmount_new_fs(tb, id, tb->lsmt_mask, &rf->sm, &rf->smsz, &rf->tid, &fs);
+	if (rc == -ENOENT)
+		rc = 1;		/* unmounted in the meantime */
+	if (rc < 0)
+		return rc;
+
+	if (rc == 1) {
+		/* not mounted or filtered out (e.g. moved out of the target) */
+		rc = old ? refresh_umount(rf, old) : 0;
+
+	} else if (!old) {
+		rc = refresh_add_change(rf, NULL, fs, MNT_TABDIFF_MOUNT);
+		if (!rc)
+			rc = mnt_table_insert_fs_before(tb, rf->cur, fs);
+	} else {
+		int oper = refresh_get_oper(old, fs);
+
+		if (oper) {
+			rc = refresh_add_change(rf, old, fs, oper);
+			if (!rc)
+				rc = mnt_table_insert_fs_before(tb, old, fs);
+			if (!rc)
+				rc = mnt_table_remove_fs(tb, old);
+		}
+	}
+	mnt_unref_fs(fs);
+	return rc;
+}
+
+static int cmp_fs_uniq_id(struct list_head *a, struct list_head *b,
+			  void *data __attribute__((__unused__)))
+{
+	struct libmnt_fs *x = list_entry(a, struct libmnt_fs, ents),
+			 *y = list_entry(b, struct libmnt_fs, ents);
+
+	return x->uniq_id < y->uniq_id ? -1 : x->uniq_id > y->uniq_id;
+}
+
+static int cmp_mount_id(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Reads the IDs of the subtree root (if any) and all mounts below into a
+ * sorted array.
+ */
+static int refresh_list_ids(struct libmnt_table *tb, uint64_t **ids, size_t *nids)
+{
+	uint64_t *list = NULL, last = 0;
+	size_t n = 0, sz = 0;
+	int rc = 0;
+
+	do {
+		ssize_t x;
+
+		if (sz - n < LISTMOUNT_NIDS + 1) {
+			uint64_t *tmp;
+
+			sz += LISTMOUNT_NIDS * 2;
+			tmp = realloc(list, sz * sizeof(*list));
+			if (!tmp) {
+				rc = -ENOMEM;
+				break;
+			}
+			list = tmp;
+		}
+		if (!n && tb->lsmt_id)
+			list[n++] = tb->lsmt_id;
+
+		x = ul_listmount(tb->lsmt_id ? tb->lsmt_id : LSMT_ROOT,
+				 last, list + n, LISTMOUNT_NIDS, 0);
+		STAT_ADD(LISTMOUNT, 1);
+		if (x < 0) {
+			/* the subtree root has been unmounted */
+			if (errno == ENOENT && tb->lsmt_id)
+				n = 0;
+			else
+				rc = -errno;
+			break;
+		}
+		n += x;
+		if (x < LISTMOUNT_NIDS)
+			break;
+		last = list[n - 1];
+	} while (1);
+
+	if (rc) {
+		free(list);
+		return rc;
+	}
+	/* the kernel does not promise the order */
+	qsort(list, n, sizeof(*list), cmp_mount_id);
+
+	*ids = list;
+	*nids = n;
+	return 0;
+}
+
+/*
+ * Returns: 0 on success (number of changes in @nchanges), 1 if the table cannot
+ * be updated by listmount(), or negative number in case of error.
+ */
+static int table_refresh_listmount(struct libmnt_table *tb, struct libmnt_tabdiff *df,
+				   int *nchanges)
+{
+	struct refresh_ctl rf = { .tb = tb, .df = df, .smsz = 4096, .tid = -1 };
+	uint64_t *ids = NULL;
+	size_t i, nids = 0;
+	struct libmnt_fs *fs;
+	int rc = 0;
+
+	/* all the entries have to be from listmount() */
+	mnt_reset_iter(&rf.itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &rf.itr, &fs) == 0) {
+		if (!fs->uniq_id) {
+			DBG(TAB, ul_debugobj(tb, "refresh: entry without ID"));
+			return 1;
+		}
+	}
+
+	rf.sm = malloc(rf.smsz);
+	if (!rf.sm)
+		return -ENOMEM;
+
+	rc = refresh_list_ids(tb, &ids, &nids);
+	if (rc)
+		goto done;
+
+	/* merge both lists in the ID order */
+	list_sort(&tb->ents, cmp_fs_uniq_id, NULL);
+
+	mnt_reset_iter(&rf.itr, MNT_ITER_FORWARD);
+	mnt_table_next_fs(tb, &rf.itr, &rf.cur);
+
+	for (i = 0; i < nids && rc == 0; i++) {
+		if (i && ids[i] == ids[i - 1])
+			continue;
+		rc = refresh_id(&rf, ids[i]);
+	}
+
+	/* not listed anymore */
+	while (rc == 0 && rf.cur) {
+		fs = rf.cur;
+		mnt_table_next_fs(tb, &rf.itr, &rf.cur);
+		rc = refresh_umount(&rf, fs);
+	}
+done:
+	free(ids);
+	free(rf.sm);
+
+	DBG(TAB, ul_debugobj(tb, "refresh: %d changes [rc=%d]", rf.nchanges, rc));
+	*nchanges = rf.nchanges;
+	return rc;
+}
+#endif /* HAVE_STATMOUNT_API */
+
+/**
+ * mnt_table_parse_listmount:
+ * @tb: table
+ * @id: unique mount ID of the subtree root (see mnt_fs_get_unique_id()) or 0
+ * @mask: STATMOUNT_* mask (see statmount(2)), or 0 for all the fields
+ *
+ * Reads the mounts from the kernel by listmount(2) and statmount(2) into @tb.
+ * Compared to mnt_table_parse_mtab() the kernel does not have to format and
+ * escape the mount table, and only the fields specified by @mask are returned
+ * by the kernel. The basic mount information (STATMOUNT_MNT_BASIC) is always
+ * requested.
+ *
+ * All the mounts in the current mount namespace are read if @id is 0, otherwise
+ * only @id and the mounts below @id. The parser filters (see
+ * mnt_table_set_parser_prefilter()) are applied to the entries too.
+ *
+ * If the kernel does not support listmount(2) and @id is zero, then
+ * /proc/self/mountinfo is parsed.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: ext-1
+ */
+int mnt_table_parse_listmount(struct libmnt_table *tb, uint64_t id, uint64_t mask)
+{
+	int rc = 1;
+
+	if (!tb)
+		return -EINVAL;
+
+#ifdef HAVE_STATMOUNT_API
+	if (!mask)
+		mask = STATMOUNT_DEFAULT_MASK;
+	mask |= STATMOUNT_MNT_BASIC;
+
+	DBG(TAB, ul_debugobj(tb, "listmount [id=%" PRIu64 ", mask=0x%" PRIx64 "]", id, mask));
+	rc = table_fetch_listmount(tb, id, mask);
+	if (rc == 0) {
+		tb->lsmt_id = id;
+		tb->lsmt_mask = mask;
+	}
+#endif
+	if (rc != 1)
+		return rc;
+	if (id)
+		return -ENOSYS;
+
+	return mnt_table_parse_file(tb, _PATH_PROC_MOUNTINFO);
+}
+
+/*
+ * Re-reads /proc/self/mountinfo and applies the differences to @tb.
+ */
+static int table_refresh_mountinfo(struct libmnt_table *tb, struct libmnt_tabdiff *df)
+{
+	struct libmnt_table *cur;
+	struct libmnt_fs *old, *new;
+	struct libmnt_iter itr;
+	int rc, oper, nchanges;
+
+	cur = mnt_new_table();
+	if (!cur)
+		return -ENOMEM;
+
+	mnt_table_set_cache(cur, tb->cache);
+	cur->fltrcb = tb->fltrcb;
+	cur->fltrcb_data = tb->fltrcb_data;
+
+	rc = mnt_table_set_parser_prefilter(cur, tb->pf_id, tb->pf_fstypes, tb->pf_target);
+	if (!rc)
+		rc = mnt_table_parse_file(cur, _PATH_PROC_MOUNTINFO);
+	if (!rc)
+		rc = mnt_diff_tables(df, tb, cur);
+	if (rc <= 0)
+		goto done;
+
+	nchanges = rc;
+	rc = 0;
+
+	/* the old entries are referenced by @df */
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (rc == 0 && mnt_tabdiff_next_change(df, &itr, &old, &new, &oper) == 0) {
+		switch (oper) {
+		case MNT_TABDIFF_MOUNT:
+			rc = mnt_table_move_fs(cur, tb, 0, NULL, new);
+			break;
+		case MNT_TABDIFF_UMOUNT:
+			rc = mnt_table_remove_fs(tb, old);
+			break;
+		default:
+			rc = mnt_table_remove_fs(cur, new);
+			if (!rc)
+				rc = mnt_table_insert_fs_before(tb, old, new);
+			if (!rc)
+				rc = mnt_table_remove_fs(tb, old);
+			break;
+		}
+	}
+	if (!rc)
+		rc = nchanges;
+done:
+	mnt_unref_table(cur);
+	return rc;
+}
+
+/**
+ * mnt_table_refresh_listmount:
+ * @tb: kernel mount table
+ * @df: diff handler or NULL
+ *
+ * Updates @tb to the current state of the kernel mount table, for example
+ * after mnt_monitor_next_change() reported a change of the kernel table. Only
+ * the new, modified and unmounted entries are added, replaced, or removed; the
+ * unchanged entries are kept in the table. The changes are returned in @df
+ * (if not NULL), the old versions of the entries are referenced by @df until
+ * the next use of @df.
+ *
+ * If @tb has been read by mnt_table_parse_listmount(), then the current list
+ * of the mount IDs is compared with the unique IDs of the table entries, and
+ * the mounts are read by statmount(2) by the ID, so the kernel does not have
+ * to format the whole mount table. The changed propagation flags are reported
+ * as MNT_TABDIFF_PROPAGATION in this case, and the entries are sorted by the
+ * unique ID. Otherwise /proc/self/mountinfo is parsed and compared with @tb
+ * (see mnt_diff_tables()).
+ *
+ * The parser filters (see mnt_table_set_parser_prefilter()) are applied to the
+ * new entries too.
+ *
+ * Returns: number of changes, negative number in case of error.
+ *
+ * Since: ext-1
+ */
+int mnt_table_refresh_listmount(struct libmnt_table *tb, struct libmnt_tabdiff *df)
+{
+	struct libmnt_tabdiff *tmp = NULL;
+	int rc = 1, nchanges = 0;
+
+	if (!tb || (tb->fmt != MNT_FMT_MOUNTINFO && tb->fmt != MNT_FMT_GUESS))
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "refresh [nents=%d]", tb->nents));
+
+	if (df)
+		__mnt_tabdiff_reset(df);
+#ifdef HAVE_STATMOUNT_API
+	if (tb->lsmt_mask)
+		rc = table_refresh_listmount(tb, df, &nchanges);
+#endif
+	if (rc != 1)
+		return rc ? rc : nchanges;
+
+	/* /proc/self/mountinfo cannot be restricted to the subtree */
+	if (tb->lsmt_id)
+		return -ENOSYS;
+
+	if (!df) {
+		df = tmp = mnt_new_tabdiff();
+		if (!df)
+			return -ENOMEM;
+	}
+	rc = table_refresh_mountinfo(tb, df);
+	mnt_free_tabdiff(tmp);
+	return rc;
+}
+
+static int mnt_table_parse_dir_filter(const struct dirent *d)
+{
+	size_t namesz;
+
+#ifdef _DIRENT_HAVE_D_TYPE
+	if (d->d_type != DT_UNKNOWN && d->d_type != DT_REG &&
+	    d->d_type != DT_LNK)
+		return 0;
+#endif
+	if (*d->d_name == '.')
 		return 0;
 
 #define MNT_MNTTABDIR_EXTSIZ	(sizeof(MNT_MNTTABDIR_EXT) - 1)
@@ -1039,6 +2166,61 @@ int mnt_table_set_parser_fltrcb(struct libmnt_table *tb,
 	return 0;
 }
 
+/**
+ * mnt_table_set_parser_prefilter:
+ * @tb: pointer to table
+ * @id: mount ID or -1
+ * @fstypes: filesystem types pattern (see mnt_match_fstype()) or NULL
+ * @target: mountpoint or NULL
+ *
+ * Sets a filter for mnt_table_parse_*() functions. Only entries with mount
+ * ID @id, entries matching @fstypes and entries mounted on @target or below
+ * @target are added to the table. The mount ID is ignored for files other
+ * than mountinfo. The filter is applied to the raw mountinfo fields, the
+ * rejected lines are not parsed and nothing is allocated for them.
+ *
+ * Note that the parent-child relationship between the entries is incomplete
+ * in the filtered table (see mnt_table_is_fs_mounted() or
+ * mnt_table_get_root_fs()). All the arguments are copied to @tb; use
+ * mnt_table_set_parser_prefilter(tb, -1, NULL, NULL) to remove the filter.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: ext-1
+ */
+int mnt_table_set_parser_prefilter(struct libmnt_table *tb, int id,
+				   const char *fstypes, const char *target)
+{
+	char *t = NULL, *p = NULL;
+
+	if (!tb)
+		return -EINVAL;
+	if (fstypes && !(t = strdup(fstypes)))
+		return -ENOMEM;
+	if (target) {
+		size_t sz;
+
+		p = strdup(target);
+		if (!p) {
+			free(t);
+			return -ENOMEM;
+		}
+		/* ignore trailing slashes, "/" is the root */
+		sz = strlen(p);
+		while (sz > 1 && p[sz - 1] == '/')
+			p[--sz] = '\0';
+	}
+
+	DBG(TAB, ul_debugobj(tb, "parser pre-filter: id=%d, fstypes=%s, target=%s",
+				id, t ? t : "", p ? p : ""));
+	free(tb->pf_fstypes);
+	free(tb->pf_target);
+	tb->pf_id = id < 0 ? -1 : id;
+	tb->pf_fstypes = t;
+	tb->pf_target = p;
+	return 0;
+}
+
 /**
  * mnt_table_parse_swaps:
  * @tb: table
@@ -1232,10 +2414,9 @@ read_utab:
 		if (!u_tb)
 			return -ENOMEM;
 
-		u_tb->fmt = MNT_FMT_UTAB;
 		mnt_table_set_parser_fltrcb(u_tb, tb->fltrcb, tb->fltrcb_data);
 
-		rc = mnt_table_parse_file(u_tb, utab);
+		rc = mnt_table_parse_utab(u_tb, utab);
 		priv_utab = 1;
 	}
 
@@ -29,7 +29,18 @@
 
 #include "mountP.h"
 #include "mangle.h"
+#include "strutils.h"
 #include "pathnames.h"
+#include "all-io.h"
+
+/*
+ * The utab is not rewritten on mount and umount. The new entries are appended
+ * to the file and the removed entries are commented out in place (the first
+ * byte of the line is overwritten by '#'), so the file is still a valid utab
+ * for all libmount versions. The file is compacted (rewritten) when the
+ * commented out lines are larger than the rest of the file.
+ */
+#define UTAB_COMPACT_MINSZ	(16 * 1024)
 
 struct libmnt_update {
 	char		*target;
@@ -684,6 +695,135 @@ leave:
 	return rc;
 }
 
+/*
+ * Appends @fs to utab.
+ *
+ * Returns: 0 on success, 1 if the file has to be rewritten, <0 on error.
+ */
+static int utab_append_entry(struct libmnt_update *upd, struct libmnt_fs *fs)
+{
+	char *buf = NULL;
+	size_t bufsz = 0;
+	struct stat st;
+	FILE *f;
+	int fd, rc;
+
+	fd = open(upd->filename, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC,
+			S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) != 0) {
+		rc = -errno;
+		goto done;
+	}
+	if (st.st_size == 0 && fchmod(fd, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH) != 0) {
+		rc = -errno;
+		goto done;
+	}
+	if (st.st_size) {
+		char c = 0;
+
+		/* the entry has to start on a new line */
+		if (pread(fd, &c, 1, st.st_size - 1) != 1 || c != '\n') {
+			rc = 1;
+			goto done;
+		}
+	}
+
+	/* compose the entry in memory, it's written by one write(2) */
+	f = open_memstream(&buf, &bufsz);
+	if (!f) {
+		rc = -errno;
+		goto done;
+	}
+	rc = fprintf_utab_fs(f, fs);
+	if (fclose(f) != 0 && !rc)
+		rc = -errno;
+	if (!rc)
+		rc = write_all(fd, buf, bufsz) ? -errno : 0;
+
+	DBG(UPDATE, ul_debugobj(upd, "%s: appended entry [rc=%d]",
+				upd->filename, rc));
+done:
+	free(buf);
+	close(fd);
+	return rc;
+}
+
+/* returns 1 if the utab @line is an entry for @target */
+static int utab_line_has_target(const char *line, const char *target)
+{
+	const char *p = line;
+
+	while (p && *p) {
+		while (*p == ' ')
+			p++;
+		if (!strncmp(p, "TARGET=", 7)) {
+			char *x = unmangle(p + 7, NULL);
+			int rc = x && streq_paths(x, target);
+
+			free(x);
+			return rc;
+		}
+		p = strchr(p, ' ');
+	}
+	return 0;
+}
+
+/*
+ * Comments out the last entry for @target in utab.
+ *
+ * Returns: 0 on success, 1 if the file has to be rewritten, <0 on error.
+ */
+static int utab_comment_entry(struct libmnt_update *upd, const char *target)
+{
+	char *line = NULL;
+	size_t linesz = 0, live = 0, dead = 0, foundsz = 0;
+	off_t off = 0, found = -1;
+	ssize_t len;
+	FILE *f;
+	int rc = 0;
+
+	f = fopen(upd->filename, "r+" UL_CLOEXECSTR);
+	if (!f)
+		return errno == ENOENT ? 0 : -errno;
+
+	while ((len = getline(&line, &linesz, f)) > 0) {
+		const char *p = skip_blank(line);
+
+		if (*p == '#' || *p == '\n' || !*p)
+			dead += len;
+		else {
+			live += len;
+			if (utab_line_has_target(p, target)) {
+				found = off;
+				foundsz = len;
+			}
+		}
+		off += len;
+	}
+	if (ferror(f))
+		rc = -EIO;
+	else if (found >= 0 && pwrite(fileno(f), "#", 1, found) != 1)
+		rc = -errno;
+
+	fclose(f);
+	free(line);
+
+	DBG(UPDATE, ul_debugobj(upd, "%s: entry %s [rc=%d]", upd->filename,
+				found >= 0 ? "commented out" : "not found", rc));
+	if (rc)
+		return rc;
+
+	/* the commented out entry is dead now */
+	if (found >= 0) {
+		dead += foundsz;
+		live -= foundsz;
+	}
+	return dead > max(live, (size_t) UTAB_COMPACT_MINSZ) ? 1 : 0;
+}
+
 static int add_file_entry(struct libmnt_table *tb, struct libmnt_update *upd)
 {
 	struct libmnt_fs *fs;
@@ -702,7 +842,7 @@ static int add_file_entry(struct libmnt_table *tb, struct libmnt_update *upd)
 
 static int update_add_entry(struct libmnt_update *upd)
 {
-	struct libmnt_table *tb;
+	struct libmnt_table *tb = NULL;
 	int rc = 0;
 
 	assert(upd);
@@ -715,10 +855,16 @@ static int update_add_entry(struct libmnt_update *upd)
 	if (rc)
 		return -MNT_ERR_LOCK;
 
-	tb = __mnt_new_table_from_file(upd->filename,
-			upd->userspace_only ? MNT_FMT_UTAB : MNT_FMT_MTAB, 1);
-	if (tb)
-		rc = add_file_entry(tb, upd);
+	if (upd->userspace_only)
+		rc = utab_append_entry(upd, upd->fs);
+
+	if (!upd->userspace_only || rc == 1) {
+		rc = 0;
+		tb = __mnt_new_table_from_file(upd->filename,
+				upd->userspace_only ? MNT_FMT_UTAB : MNT_FMT_MTAB, 1);
+		if (tb)
+			rc = add_file_entry(tb, upd);
+	}
 
 	mnt_unlock_file(upd->lock);
 	mnt_unref_table(tb);
@@ -727,7 +873,7 @@ static int update_add_entry(struct libmnt_update *upd)
 
 static int update_remove_entry(struct libmnt_update *upd)
 {
-	struct libmnt_table *tb;
+	struct libmnt_table *tb = NULL;
 	int rc = 0;
 
 	assert(upd);
@@ -740,13 +886,21 @@ static int update_remove_entry(struct libmnt_update *upd)
 	if (rc)
 		return -MNT_ERR_LOCK;
 
-	tb = __mnt_new_table_from_file(upd->filename,
-			upd->userspace_only ? MNT_FMT_UTAB : MNT_FMT_MTAB, 1);
-	if (tb) {
-		struct libmnt_fs *rem = mnt_table_find_target(tb, upd->target, MNT_ITER_BACKWARD);
-		if (rem) {
-			mnt_table_remove_fs(tb, rem);
-			rc = update_table(upd, tb);
+	if (upd->userspace_only) {
+		rc = utab_comment_entry(upd, upd->target);
+		if (rc == 1) {
+			/* compaction, the entry is already commented out */
+			tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+			rc = tb ? update_table(upd, tb) : 0;
+		}
+	} else {
+		tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_MTAB, 1);
+		if (tb) {
+			struct libmnt_fs *rem = mnt_table_find_target(tb, upd->target, MNT_ITER_BACKWARD);
+			if (rem) {
+				mnt_table_remove_fs(tb, rem);
+				rc = update_table(upd, tb);
+			}
 		}
 	}
 
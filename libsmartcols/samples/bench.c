@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Generates a large synthetic table and reports time spent to build, sort
+ * and print the table, and the peak memory usage. The output is written to
+ * /dev/null by default. The columns width calculation is part of the print
+ * for the default (human readable) output format; compare with --raw to see
+ * the calculation cost.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+#include "optutils.h"
+
+#include "libsmartcols.h"
+
+enum { COL_NAME, COL_NUM };		/* other columns are strings */
+
+struct bench {
+	size_t		nlines;
+	size_t		ncolumns;
+	size_t		depth;		/* 0 for list */
+	size_t		unicode;	/* % of cells with non-ASCII data */
+	int		sort;		/* column number or -1 */
+	uint64_t	seed;
+};
+
+static uint64_t rnd(struct bench *b)
+{
+	/* xorshift64, the same table for the same --seed */
+	b->seed ^= b->seed << 13;
+	b->seed ^= b->seed >> 7;
+	b->seed ^= b->seed << 17;
+	return b->seed;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *phase, double begin)
+{
+	fprintf(stderr, "%-10s %10.3f ms\n", phase, (now() - begin) * 1000.0);
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fprintf(out,
+		"\n %s [options]\n",
+		program_invocation_short_name);
+
+	fputs(" -n, --nlines <num>     number of lines (default 100000)\n", out);
+	fputs(" -c, --ncolumns <num>   number of columns (default 6)\n", out);
+	fputs(" -d, --depth <num>      tree depth (default 0, list)\n", out);
+	fputs(" -u, --unicode <num>    percent of cells with non-ASCII data (default 0)\n", out);
+	fputs(" -s, --sort <num>       sort by column (0 is NAME, 1 is numeric)\n", out);
+	fputs(" -S, --seed <num>       random seed\n", out);
+	fputs(" -o, --output <file>    write table to file (default /dev/null)\n", out);
+	fputs(" -J, --json             JSON output\n", out);
+	fputs(" -r, --raw              raw output\n", out);
+	fputs(" -E, --export           key=\"value\" output\n", out);
+	fputs(" -w, --width <num>      terminal width (default 200)\n", out);
+	fputs(" -h, --help             this help\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+static void setup_columns(struct bench *b, struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	size_t i;
+
+	cl = scols_table_new_column(tb, "NAME", 0, b->depth ? SCOLS_FL_TREE : 0);
+	if (!cl)
+		goto fail;
+	scols_column_set_data_type(cl, SCOLS_DATA_STRING);
+
+	cl = scols_table_new_column(tb, "NUM", 0, SCOLS_FL_RIGHT);
+	if (!cl)
+		goto fail;
+	scols_column_set_data_type(cl, SCOLS_DATA_U64);
+	scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
+
+	for (i = 2; i < b->ncolumns; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "STR%zu", i);
+		cl = scols_table_new_column(tb, name, 0.1, SCOLS_FL_TRUNC);
+		if (!cl)
+			goto fail;
+		scols_column_set_data_type(cl, SCOLS_DATA_STRING);
+	}
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static void gen_string(struct bench *b, char *buf, size_t bufsz)
+{
+	static const char *const wide[] = { "č", "ä", "日本", "─" };
+	size_t len = 1 + rnd(b) % 30, i;
+	char *p = buf;
+
+	if (b->unicode && rnd(b) % 100 < b->unicode) {
+		for (i = 0; i < len && (size_t) (p - buf) + 8 < bufsz; i++) {
+			const char *w = i % 3 ? NULL : wide[rnd(b) % ARRAY_SIZE(wide)];
+
+			if (w) {
+				strcpy(p, w);
+				p += strlen(w);
+			} else
+				*p++ = 'a' + rnd(b) % 26;
+		}
+	} else {
+		for (i = 0; i < len && (size_t) (p - buf) + 1 < bufsz; i++)
+			*p++ = 'a' + rnd(b) % 26;
+	}
+	*p = '\0';
+}
+
+static void add_lines(struct bench *b, struct libscols_table *tb)
+{
+	struct libscols_line **levels = NULL;
+	size_t i, level = 0;
+
+	if (b->depth)
+		levels = xcalloc(b->depth, sizeof(struct libscols_line *));
+
+	for (i = 0; i < b->nlines; i++) {
+		struct libscols_line *ln, *parent = NULL;
+		char buf[256];
+		uint64_t num;
+		size_t c;
+
+		if (b->depth) {
+			/* the next level, the same level or any upper level */
+			size_t max = min(level + 1, b->depth - 1);
+
+			level = i ? rnd(b) % (max + 1) : 0;
+			parent = level ? levels[level - 1] : NULL;
+		}
+
+		ln = scols_table_new_line(tb, parent);
+		if (!ln)
+			err(EXIT_FAILURE, "failed to create output line");
+		if (levels)
+			levels[level] = ln;
+
+		gen_string(b, buf, sizeof(buf));
+		if (scols_line_set_data(ln, COL_NAME, buf))
+			goto fail;
+
+		num = rnd(b) % 1000000000;
+		snprintf(buf, sizeof(buf), "%" PRIu64, num);
+		if (scols_line_set_data(ln, COL_NUM, buf))
+			goto fail;
+		scols_cell_set_sort_u64(scols_line_get_cell(ln, COL_NUM), num);
+
+		for (c = 2; c < b->ncolumns; c++) {
+			gen_string(b, buf, sizeof(buf));
+			if (scols_line_set_data(ln, c, buf))
+				goto fail;
+		}
+	}
+
+	free(levels);
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to set output data");
+}
+
+int main(int argc, char *argv[])
+{
+	struct libscols_table *tb;
+	struct rusage ru;
+	struct bench b = {
+		.nlines = 100000,
+		.ncolumns = 6,
+		.sort = -1,
+		.seed = 0x2545F4914F6CDD1DULL
+	};
+	const char *outfile = "/dev/null";
+	FILE *out;
+	size_t width = 200;
+	double begin;
+	int c;
+
+	static const struct option longopts[] = {
+		{ "nlines",   1, NULL, 'n' },
+		{ "ncolumns", 1, NULL, 'c' },
+		{ "depth",    1, NULL, 'd' },
+		{ "unicode",  1, NULL, 'u' },
+		{ "sort",     1, NULL, 's' },
+		{ "seed",     1, NULL, 'S' },
+		{ "output",   1, NULL, 'o' },
+		{ "json",     0, NULL, 'J' },
+		{ "raw",      0, NULL, 'r' },
+		{ "export",   0, NULL, 'E' },
+		{ "width",    1, NULL, 'w' },
+		{ "help",     0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
+		{ 'E', 'J', 'r' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
+
+	setlocale(LC_ALL, "");
+	scols_init_debug(0);
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	while((c = getopt_long(argc, argv, "c:d:Eho:Jn:rS:s:u:w:", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
+		switch(c) {
+		case 'n':
+			b.nlines = strtou32_or_err(optarg, "failed to parse number of lines");
+			break;
+		case 'c':
+			b.ncolumns = strtou32_or_err(optarg, "failed to parse number of columns");
+			if (b.ncolumns < 2)
+				errx(EXIT_FAILURE, "at least 2 columns required");
+			break;
+		case 'd':
+			b.depth = strtou32_or_err(optarg, "failed to parse tree depth");
+			break;
+		case 'u':
+			b.unicode = strtou32_or_err(optarg, "failed to parse unicode ratio");
+			break;
+		case 's':
+			b.sort = strtou32_or_err(optarg, "failed to parse sort column");
+			break;
+		case 'S':
+			b.seed = strtou64_or_err(optarg, "failed to parse seed");
+			if (!b.seed)
+				b.seed = 1;
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		case 'J':
+			scols_table_enable_json(tb, 1);
+			scols_table_set_name(tb, "bench");
+			break;
+		case 'r':
+			scols_table_enable_raw(tb, 1);
+			break;
+		case 'E':
+			scols_table_enable_export(tb, 1);
+			break;
+		case 'w':
+			width = strtou32_or_err(optarg, "failed to parse terminal width");
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (b.sort >= 0 && (size_t) b.sort >= b.ncolumns)
+		errx(EXIT_FAILURE, "sort column out of range");
+
+	out = fopen(outfile, "w" UL_CLOEXECSTR);
+	if (!out)
+		err(EXIT_FAILURE, "cannot open %s", outfile);
+
+	scols_table_set_stream(tb, out);
+	scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+	scols_table_set_termwidth(tb, width);
+
+	setup_columns(&b, tb);
+
+	begin = now();
+	add_lines(&b, tb);
+	report("build", begin);
+
+	if (b.sort >= 0) {
+		begin = now();
+		if (scols_sort_table(tb, scols_table_get_column(tb, b.sort)))
+			errx(EXIT_FAILURE, "failed to sort table");
+		report("sort", begin);
+	}
+
+	begin = now();
+	if (scols_print_table(tb))
+		errx(EXIT_FAILURE, "failed to print table");
+	if (fflush(out) != 0)
+		err(EXIT_FAILURE, "write failed");
+	report("print", begin);
+
+	begin = now();
+	scols_unref_table(tb);
+	report("free", begin);
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		fprintf(stderr, "%-10s %10ld kB\n", "maxrss", ru.ru_maxrss);
+
+	fclose(out);
+	return EXIT_SUCCESS;
+}
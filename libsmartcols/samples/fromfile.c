@@ -211,6 +211,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" -J, --json                     JSON output format\n", out);
 	fputs(" -r, --raw                      RAW output format\n", out);
 	fputs(" -E, --export                   use key=\"value\" output format\n", out);
+	fputs(" -B, --binary                   binary output format\n", out);
 	fputs(" -C, --colsep <str>             set columns separator\n", out);
 	fputs(" -w, --width <num>              hardcode terminal width\n", out);
 	fputs(" -p, --tree-parent-column <n>   parent column\n", out);
@@ -238,13 +239,14 @@ int main(int argc, char *argv[])
 		{ "json",   0, NULL, 'J' },
 		{ "raw",    0, NULL, 'r' },
 		{ "export", 0, NULL, 'E' },
+		{ "binary", 0, NULL, 'B' },
 		{ "colsep",  1, NULL, 'C' },
 		{ "help",   0, NULL, 'h' },
 		{ NULL, 0, NULL, 0 },
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
-		{ 'E', 'J', 'r' },
+		{ 'B', 'E', 'J', 'r' },
 		{ 'M', 'm' },
 		{ 0 }
 	};
@@ -257,7 +259,7 @@ int main(int argc, char *argv[])
 	if (!tb)
 		err(EXIT_FAILURE, "failed to create output table");
 
-	while((c = getopt_long(argc, argv, "hCc:Ei:JMmn:p:rw:", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "BhCc:Ei:JMmn:p:rw:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -298,6 +300,10 @@ int main(int argc, char *argv[])
 		case 'E':
 			scols_table_enable_export(tb, TRUE);
 			break;
+		case 'B':
+			scols_table_enable_binary(tb, TRUE);
+			scols_table_set_name(tb, "testtable");
+			break;
 		case 'C':
 			scols_table_set_column_separator(tb, optarg);
 			break;
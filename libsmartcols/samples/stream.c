@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+
+#include "libsmartcols.h"
+
+enum { COL_NUM, COL_NAME, COL_DATA };
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fprintf(out,
+		"\n %s [options]\n",
+		program_invocation_short_name);
+
+	fputs(" -n, --nlines <num>    number of lines (default 1000)\n", out);
+	fputs(" -s, --window <num>    streaming window (default library setting)\n", out);
+	fputs(" -N, --nostream        disable streaming\n", out);
+	fputs(" -J, --json            JSON output\n", out);
+	fputs(" -r, --raw             raw output\n", out);
+	fputs(" -w, --width <num>     hardcode terminal width\n", out);
+	fputs(" -h, --help            this help\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+static void setup_columns(struct libscols_table *tb)
+{
+	if (!scols_table_new_column(tb, "NUM", 0, SCOLS_FL_RIGHT))
+		goto fail;
+	if (!scols_table_new_column(tb, "NAME", 0, 0))
+		goto fail;
+	if (!scols_table_new_column(tb, "DATA", 0.5, SCOLS_FL_TRUNC))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static void add_line(struct libscols_table *tb, size_t i)
+{
+	struct libscols_line *ln = scols_table_new_line(tb, NULL);
+	char *p;
+
+	if (!ln)
+		err(EXIT_FAILURE, "failed to create output line");
+
+	xasprintf(&p, "%zu", i);
+	if (scols_line_refer_data(ln, COL_NUM, p))
+		goto fail;
+
+	xasprintf(&p, "name-%zu", i % 7 ? i % 100 : i);
+	if (scols_line_refer_data(ln, COL_NAME, p))
+		goto fail;
+
+	xasprintf(&p, "data-%0*zu-end", (int) (i % 23), i);
+	if (scols_line_refer_data(ln, COL_DATA, p))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output line");
+}
+
+int main(int argc, char *argv[])
+{
+	struct libscols_table *tb;
+	size_t i, nlines = 1000;
+	int c, stream = 1;
+
+	static const struct option longopts[] = {
+		{ "nlines",   1, NULL, 'n' },
+		{ "window",   1, NULL, 's' },
+		{ "nostream", 0, NULL, 'N' },
+		{ "json",     0, NULL, 'J' },
+		{ "raw",      0, NULL, 'r' },
+		{ "width",    1, NULL, 'w' },
+		{ "help",     0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	setlocale(LC_ALL, "");
+	scols_init_debug(0);
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	while((c = getopt_long(argc, argv, "hJNn:rs:w:", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'n':
+			nlines = strtou32_or_err(optarg, "failed to parse number of lines");
+			break;
+		case 's':
+			scols_table_set_streaming_window(tb,
+				strtou32_or_err(optarg, "failed to parse window"));
+			break;
+		case 'N':
+			stream = 0;
+			break;
+		case 'J':
+			scols_table_enable_json(tb, 1);
+			scols_table_set_name(tb, "stream");
+			break;
+		case 'r':
+			scols_table_enable_raw(tb, 1);
+			break;
+		case 'w':
+			scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+			scols_table_set_termwidth(tb, strtou32_or_err(optarg, "failed to parse terminal width"));
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	setup_columns(tb);
+	scols_table_enable_streaming(tb, stream);
+
+	/* the lines are printed (and deallocated) when the next line is added */
+	for (i = 0; i < nlines; i++)
+		add_line(tb, i);
+
+	scols_print_table(tb);
+	scols_unref_table(tb);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/*
+ * arena.c - per-table memory arena for lines and cells
+ *
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The lines created by scols_table_new_line(), their cells and the data set
+ * by scols_line_set_data() are usually released all together when the table
+ * is deallocated. The arena allocates them from large chunks to avoid
+ * malloc() and free() for every line and cell. The memory is never released
+ * one by one, the arena is deallocated when the table and all the
+ * arena lines are unreferenced (the application may keep a reference to the
+ * line longer than to the table).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "smartcolsP.h"
+
+#define ARENA_CHUNKSZ_MIN	(16 * 1024)
+#define ARENA_CHUNKSZ_MAX	(1024 * 1024)
+
+struct libscols_arena_chunk {
+	struct libscols_arena_chunk	*next;
+	size_t				size;	/* size of data[] */
+	size_t				used;
+	unsigned char			data[];
+};
+
+struct libscols_arena {
+	int				refcount;
+	size_t				chunksz;	/* size of the next chunk */
+	struct libscols_arena_chunk	*chunks;	/* the current chunk is the first */
+};
+
+struct libscols_arena *scols_new_arena(void)
+{
+	struct libscols_arena *ar = calloc(1, sizeof(*ar));
+
+	if (!ar)
+		return NULL;
+
+	DBG(TAB, ul_debugobj(ar, "arena: alloc"));
+	ar->refcount = 1;
+	ar->chunksz = ARENA_CHUNKSZ_MIN;
+	return ar;
+}
+
+void scols_ref_arena(struct libscols_arena *ar)
+{
+	if (ar)
+		ar->refcount++;
+}
+
+void scols_unref_arena(struct libscols_arena *ar)
+{
+	if (ar && --ar->refcount <= 0) {
+		DBG(TAB, ul_debugobj(ar, "arena: dealloc"));
+		while (ar->chunks) {
+			struct libscols_arena_chunk *ch = ar->chunks;
+
+			ar->chunks = ch->next;
+			free(ch);
+		}
+		free(ar);
+	}
+}
+
+static void *chunk_alloc(struct libscols_arena_chunk *ch, size_t len, size_t align)
+{
+	uintptr_t begin = (uintptr_t) ch->data + ch->used;
+	uintptr_t end;
+
+	begin = (begin + align - 1) & ~((uintptr_t) align - 1);
+	end = begin + len;
+
+	if (end < begin || end > (uintptr_t) ch->data + ch->size)
+		return NULL;
+
+	ch->used = end - (uintptr_t) ch->data;
+	return (void *) begin;
+}
+
+/*
+ * Returns uninitialized memory aligned to @align (power of 2). The memory is
+ * valid until the arena is deallocated.
+ */
+static void *arena_alloc(struct libscols_arena *ar, size_t len, size_t align)
+{
+	struct libscols_arena_chunk *ch;
+	size_t sz;
+	void *res;
+
+	if (ar->chunks) {
+		res = chunk_alloc(ar->chunks, len, align);
+		if (res)
+			return res;
+	}
+
+	if (len > SIZE_MAX - sizeof(*ch) - align)
+		return NULL;
+
+	sz = max(ar->chunksz, len + align);
+	ch = malloc(sizeof(*ch) + sz);
+	if (!ch)
+		return NULL;
+	STAT_ADD(ARENA_CHUNKS, 1);
+	ch->size = sz;
+	ch->used = 0;
+
+	if (sz > ar->chunksz && ar->chunks) {
+		/* oversized, keep the current chunk */
+		ch->next = ar->chunks->next;
+		ar->chunks->next = ch;
+	} else {
+		ch->next = ar->chunks;
+		ar->chunks = ch;
+		if (ar->chunksz < ARENA_CHUNKSZ_MAX)
+			ar->chunksz <<= 1;
+	}
+
+	return chunk_alloc(ch, len, align);
+}
+
+/*
+ * Returns zeroized memory with the default alignment.
+ */
+void *scols_arena_calloc(struct libscols_arena *ar, size_t len)
+{
+	void *res = arena_alloc(ar, len, sizeof(max_align_t));
+
+	if (res)
+		memset(res, 0, len);
+	return res;
+}
+
+char *scols_arena_strdup(struct libscols_arena *ar, const char *str)
+{
+	size_t sz = strlen(str) + 1;
+	char *res = arena_alloc(ar, sz, 1);
+
+	if (res)
+		memcpy(res, str, sz);
+	return res;
+}
@@ -14,14 +14,20 @@ struct libscols_buffer {
 
 struct libscols_buffer *new_buffer(size_t sz)
 {
-	struct libscols_buffer *buf = malloc(sz + sizeof(struct libscols_buffer));
+	struct libscols_buffer *buf = malloc(sizeof(struct libscols_buffer));
 
 	if (!buf)
 		return NULL;
 
-	buf->cur = buf->begin = ((char *) buf) + sizeof(struct libscols_buffer);
+	buf->begin = malloc(sz);
+	if (!buf->begin) {
+		free(buf);
+		return NULL;
+	}
+	buf->cur = buf->begin;
 	buf->encdata = NULL;
 	buf->bufsz = sz;
+	buf->art_idx = 0;
 
 	DBG(BUFF, ul_debugobj(buf, "alloc (size=%zu)", sz));
 	return buf;
@@ -33,6 +39,7 @@ void free_buffer(struct libscols_buffer *buf)
 		return;
 	DBG(BUFF, ul_debugobj(buf, "dealloc"));
 	free(buf->encdata);
+	free(buf->begin);
 	free(buf);
 }
 
@@ -48,6 +55,32 @@ int buffer_reset_data(struct libscols_buffer *buf)
 	return 0;
 }
 
+/*
+ * The buffer is allocated for the longest line when printing starts, but data
+ * generated by column fill functions (see scols_column_set_fillfunc()) are
+ * unknown at that time.
+ */
+static int buffer_enlarge(struct libscols_buffer *buf, size_t sz)
+{
+	size_t used = buf->cur - buf->begin;
+	char *tmp;
+
+	sz = max(sz, buf->bufsz * 2);
+	tmp = realloc(buf->begin, sz);
+	if (!tmp)
+		return -ENOMEM;
+
+	DBG(BUFF, ul_debugobj(buf, "enlarge (size=%zu)", sz));
+	buf->begin = tmp;
+	buf->cur = tmp + used;
+	buf->bufsz = sz;
+
+	/* allocated according to bufsz by buffer_get_safe_data() */
+	free(buf->encdata);
+	buf->encdata = NULL;
+	return 0;
+}
+
 int buffer_append_data(struct libscols_buffer *buf, const char *str)
 {
 	size_t maxsz, sz;
@@ -62,8 +95,11 @@ int buffer_append_data(struct libscols_buffer *buf, const char *str)
 	sz = strlen(str);
 	maxsz = buf->bufsz - (buf->cur - buf->begin);
 
-	if (maxsz <= sz)
-		return -EINVAL;
+	if (maxsz <= sz) {
+		int rc = buffer_enlarge(buf, buf->bufsz - maxsz + sz + 1);
+		if (rc)
+			return rc;
+	}
 	memcpy(buf->cur, str, sz + 1);
 	buf->cur += sz;
 	return 0;
@@ -41,6 +41,14 @@ static int count_cell_width(struct libscols_table *tb,
 	char *data;
 	int rc;
 
+	if (!scols_column_is_tree(cl) && !scols_column_is_customwrap(cl)) {
+		/* the cell data as they are, use the cached width */
+		struct libscols_cell *ce = scols_line_get_column_cell(ln, cl);
+
+		len = __scols_cell_get_width(ce, scols_table_is_noencoding(tb));
+		goto count;
+	}
+
 	rc = __cell_to_buffer(tb, ln, cl, buf);
 	if (rc)
 		return rc;
@@ -54,7 +62,7 @@ static int count_cell_width(struct libscols_table *tb,
 		len = mbs_width(data);
 	else
 		len = mbs_safe_width(data);
-
+count:
 	if (len == (size_t) -1)		/* ignore broken multibyte strings */
 		len = 0;
 	cl->width_max = max(len, cl->width_max);
@@ -113,8 +121,8 @@ static int count_column_width(struct libscols_table *tb,
 
 		data = scols_cell_get_data(&cl->header);
 		if (data) {
-			size_t len = scols_table_is_noencoding(tb) ?
-					mbs_width(data) : mbs_safe_width(data);
+			size_t len = __scols_cell_get_width(&cl->header,
+					scols_table_is_noencoding(tb));
 			cl->width_min = max(cl->width_min, len);
 		} else
 			no_header = 1;
@@ -180,6 +188,52 @@ done:
 	return rc;
 }
 
+/* flags set by the calculation are reverted by the next calculation */
+static void set_calc_flag(struct libscols_column *cl, int flag)
+{
+	cl->calc_flags |= flag & ~cl->flags;
+	cl->flags |= flag;
+}
+
+/*
+ * Reusable tables: returns 1 if data width and the terminal width are the same
+ * as in the previous calculation, and the previous result may be used.
+ */
+static int reuse_columns_width(struct libscols_table *tb, int changed)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+
+	if (!tb->reuse_valid || changed || tb->reuse_termwidth != tb->termwidth) {
+		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+		while (scols_table_next_column(tb, &itr, &cl) == 0)
+			cl->calc_flags = 0;
+		return 0;
+	}
+
+	DBG(TAB, ul_debugobj(tb, " reuse columns width"));
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		cl->flags |= cl->calc_flags;
+		cl->width = cl->width_final;
+	}
+	return 1;
+}
+
+static void save_columns_width(struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0)
+		cl->width_final = cl->width;
+
+	tb->reuse_termwidth = tb->termwidth;
+	tb->reuse_valid = 1;
+}
+
 /*
  * This is core of the scols_* voodoo...
  */
@@ -189,7 +243,7 @@ int __scols_calculate(struct libscols_table *tb, struct libscols_buffer *buf)
 	struct libscols_iter itr;
 	size_t width = 0, width_min = 0;	/* output width */
 	int stage, rc = 0;
-	int extremes = 0, group_ncolumns = 0;
+	int extremes = 0, group_ncolumns = 0, changed = 0;
 	size_t colsepsz;
 
 
@@ -203,6 +257,12 @@ int __scols_calculate(struct libscols_table *tb, struct libscols_buffer *buf)
 	if (has_groups(tb))
 		group_ncolumns = 1;
 
+	if (tb->reusable) {
+		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+		while (scols_table_next_column(tb, &itr, &cl) == 0)
+			cl->flags &= ~cl->calc_flags;
+	}
+
 	/* set basic columns width
 	 */
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
@@ -222,6 +282,15 @@ int __scols_calculate(struct libscols_table *tb, struct libscols_buffer *buf)
 		if (rc)
 			goto done;
 
+		if (tb->reusable) {
+			/* never reduce, the output would jitter */
+			if (cl->width < cl->width_data)
+				cl->width = cl->width_data;
+			else if (cl->width > cl->width_data)
+				changed = 1;
+			cl->width_data = cl->width;
+		}
+
 		is_last = is_last_column(cl);
 
 		width += cl->width + (is_last ? 0 : colsepsz);		/* separator for non-last column */
@@ -235,6 +304,9 @@ int __scols_calculate(struct libscols_table *tb, struct libscols_buffer *buf)
 		goto done;
 	}
 
+	if (tb->reusable && reuse_columns_width(tb, changed))
+		goto done;
+
 	/* be paranoid */
 	if (width_min > tb->termwidth && scols_table_is_maxout(tb)) {
 		DBG(TAB, ul_debugobj(tb, " min width larger than terminal! [width=%zu, term=%zu]", width_min, tb->termwidth));
@@ -415,7 +487,7 @@ int __scols_calculate(struct libscols_table *tb, struct libscols_buffer *buf)
 
 			/* hide zero width columns */
 			if (cl->width == 0)
-				cl->flags |= SCOLS_FL_HIDDEN;
+				set_calc_flag(cl, SCOLS_FL_HIDDEN);
 		}
 
 		/* the current stage is without effect, go to the next */
@@ -436,16 +508,18 @@ int __scols_calculate(struct libscols_table *tb, struct libscols_buffer *buf)
 			if (width - cl->width < tb->termwidth) {
 				size_t r =  width - tb->termwidth;
 
-				cl->flags |= SCOLS_FL_TRUNC;
+				set_calc_flag(cl, SCOLS_FL_TRUNC);
 				cl->width -= r;
 				width -= r;
 			} else {
-				cl->flags |= SCOLS_FL_HIDDEN;
+				set_calc_flag(cl, SCOLS_FL_HIDDEN);
 				width -= cl->width + colsepsz;
 			}
 		}
 	}
 done:
+	if (rc == 0 && tb->reusable && tb->is_term)
+		save_columns_width(tb);
 	tb->is_dummy_print = 0;
 	DBG(TAB, ul_debugobj(tb, "-----final width: %zu (rc=%d)-----", width, rc));
 	ON_DBG(TAB, dbg_columns(tb));
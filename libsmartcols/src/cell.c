@@ -25,6 +25,7 @@
 #include <ctype.h>
 
 #include "smartcolsP.h"
+#include "mbsalign.h"
 
 /*
  * The cell has no ref-counting, free() and new() functions. All is
@@ -45,7 +46,8 @@ int scols_reset_cell(struct libscols_cell *ce)
 		return -EINVAL;
 
 	/*DBG(CELL, ul_debugobj(ce, "reset"));*/
-	free(ce->data);
+	if (!ce->data_in_arena)
+		free(ce->data);
 	free(ce->color);
 	memset(ce, 0, sizeof(*ce));
 	return 0;
@@ -62,9 +64,48 @@ int scols_reset_cell(struct libscols_cell *ce)
  */
 int scols_cell_set_data(struct libscols_cell *ce, const char *data)
 {
+	if (!ce)
+		return -EINVAL;
+	if (ce->data_in_arena) {
+		ce->data = NULL;
+		ce->data_in_arena = 0;
+	}
+	ce->width_valid = 0;
+	if (data)
+		STAT_ADD(CELL_COPIES, 1);
 	return strdup_to_struct_member(ce, data, data);
 }
 
+/*
+ * The same as scols_cell_set_data(), but the copy of @data is allocated by
+ * the arena of the line. The arena is used only for the first data of the
+ * cell; the arena memory is never released one by one, so the data set
+ * again (e.g. refreshed reusable table) are allocated by malloc().
+ */
+int __scols_cell_set_arena_data(struct libscols_cell *ce,
+				struct libscols_arena *ar, const char *data)
+{
+	char *p = NULL;
+
+	if (!ce)
+		return -EINVAL;
+	if (ce->arena_used)
+		return scols_cell_set_data(ce, data);
+	if (data) {
+		p = scols_arena_strdup(ar, data);
+		if (!p)
+			return -ENOMEM;
+		STAT_ADD(CELL_COPIES, 1);
+	}
+	if (!ce->data_in_arena)
+		free(ce->data);
+	ce->data = p;
+	ce->data_in_arena = p ? 1 : 0;
+	ce->arena_used = 1;
+	ce->width_valid = 0;
+	return 0;
+}
+
 /**
  * scols_cell_refer_data:
  * @ce: a pointer to a struct libscols_cell instance
@@ -81,11 +122,42 @@ int scols_cell_refer_data(struct libscols_cell *ce, char *data)
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	if (!ce->data_in_arena)
+		free(ce->data);
 	ce->data = data;
+	ce->data_in_arena = 0;
+	ce->width_valid = 0;
 	return 0;
 }
 
+/*
+ * Returns the same as mbs_width() (if @noencoding) or mbs_safe_width() for
+ * the cell data. The width is cached in the cell, the printing calculates
+ * the width of the same data more than once.
+ */
+size_t __scols_cell_get_width(struct libscols_cell *ce, int noencoding)
+{
+	size_t sz;
+
+	if (!ce || !ce->data || !*ce->data)
+		return 0;
+	if (ce->width_valid && (ce->is_ascii || ce->width_noenc == !!noencoding))
+		return ce->width;
+
+	sz = strlen(ce->data);
+	if (mbs_printable_ascii_span(ce->data, sz) == sz) {
+		ce->is_ascii = 1;
+		ce->width = sz;
+	} else {
+		ce->is_ascii = 0;
+		ce->width = noencoding ? mbs_nwidth(ce->data, sz) :
+					 mbs_safe_nwidth(ce->data, sz, NULL);
+	}
+	ce->width_noenc = noencoding ? 1 : 0;
+	ce->width_valid = 1;
+	return ce->width;
+}
+
 /**
  * scols_cell_get_data:
  * @ce: a pointer to a struct libscols_cell instance
@@ -123,6 +195,68 @@ void *scols_cell_get_userdata(struct libscols_cell *ce)
 	return ce->userdata;
 }
 
+/**
+ * scols_cell_set_sort_u64:
+ * @ce: a pointer to a struct libscols_cell instance
+ * @num: sort key
+ *
+ * Sets the key used by scols_sort_table() for columns with SCOLS_DATA_U64
+ * type. The key is independent on the cell data, so for example the size in
+ * human readable format is possible to sort by the size in bytes.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_cell_set_sort_u64(struct libscols_cell *ce, uint64_t num)
+{
+	if (!ce)
+		return -EINVAL;
+	ce->sortkey.u64 = num;
+	ce->has_sortkey = 1;
+	return 0;
+}
+
+/**
+ * scols_cell_set_sort_s64:
+ * @ce: a pointer to a struct libscols_cell instance
+ * @num: sort key
+ *
+ * The same as scols_cell_set_sort_u64(), but for SCOLS_DATA_S64 columns.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_cell_set_sort_s64(struct libscols_cell *ce, int64_t num)
+{
+	if (!ce)
+		return -EINVAL;
+	ce->sortkey.s64 = num;
+	ce->has_sortkey = 1;
+	return 0;
+}
+
+/**
+ * scols_cell_set_sort_float:
+ * @ce: a pointer to a struct libscols_cell instance
+ * @num: sort key
+ *
+ * The same as scols_cell_set_sort_u64(), but for SCOLS_DATA_FLOAT columns.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_cell_set_sort_float(struct libscols_cell *ce, double num)
+{
+	if (!ce)
+		return -EINVAL;
+	ce->sortkey.fl = num;
+	ce->has_sortkey = 1;
+	return 0;
+}
+
 /**
  * scols_cmpstr_cells:
  * @a: pointer to cell
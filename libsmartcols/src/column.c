@@ -109,6 +109,7 @@ struct libscols_column *scols_copy_column(const struct libscols_column *cl)
 	ret->width_avg	= cl->width_avg;
 	ret->width_hint	= cl->width_hint;
 	ret->flags	= cl->flags;
+	ret->data_type	= cl->data_type;
 	ret->is_extreme = cl->is_extreme;
 	ret->is_groups  = cl->is_groups;
 
@@ -170,6 +171,9 @@ int scols_column_set_flags(struct libscols_column *cl, int flags)
 
 	DBG(COL, ul_debugobj(cl, "setting flags from 0%x to 0%x", cl->flags, flags));
 	cl->flags = flags;
+	cl->calc_flags = 0;
+	if (cl->table)
+		cl->table->reuse_valid = 0;
 	return 0;
 }
 
@@ -210,6 +214,46 @@ int scols_column_get_json_type(const struct libscols_column *cl)
 	return cl ? cl->json_type : -EINVAL;
 }
 
+/**
+ * scols_column_set_data_type:
+ * @cl: a pointer to a struct libscols_column instance
+ * @type: SCOLS_DATA_* type
+ *
+ * Sets the type of the column data. The typed columns are sorted by
+ * scols_sort_table() without the compare function (see
+ * scols_column_set_cmpfunc()), the library compares the native keys.
+ *
+ * The key is the value set by scols_cell_set_sort_u64() and friends, or the
+ * cell data converted to the number; cells without a valid key (or NULL data
+ * for SCOLS_DATA_STRING) are sorted before the others. The compare function
+ * has precedence if set.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_column_set_data_type(struct libscols_column *cl, int type)
+{
+	if (!cl || type < SCOLS_DATA_NONE || type > SCOLS_DATA_FLOAT)
+		return -EINVAL;
+
+	cl->data_type = type;
+	return 0;
+}
+
+/**
+ * scols_column_get_data_type:
+ * @cl: a pointer to a struct libscols_column instance
+ *
+ * Returns: SCOLS_DATA_* type or a negative value in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_column_get_data_type(const struct libscols_column *cl)
+{
+	return cl ? cl->data_type : -EINVAL;
+}
+
 
 /**
  * scols_column_get_table:
@@ -409,6 +453,42 @@ int scols_column_set_wrapfunc(struct libscols_column *cl,
 	return 0;
 }
 
+/**
+ * scols_column_set_fillfunc:
+ * @cl: a pointer to a struct libscols_column instance
+ * @fillfunc: function to generate the cell data
+ * @data: private data for @fillfunc
+ *
+ * The @fillfunc is called when the library needs the data of an empty cell
+ * for the first time; it's expected to set the data by scols_cell_set_data()
+ * or scols_cell_refer_data(). This allows to generate expensive data only for
+ * the lines and columns which are really printed (for example by
+ * scols_table_print_range() or if the column is hidden). Note that the width
+ * calculation for the human readable output and sorting need the data of all the
+ * lines.
+ *
+ * The cells are filled by scols_line_get_column_cell(), but not by
+ * scols_line_get_cell().
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_column_set_fillfunc(struct libscols_column *cl,
+			int (*fillfunc)(struct libscols_column *,
+					struct libscols_line *,
+					struct libscols_cell *,
+					void *),
+			void *data)
+{
+	if (!cl)
+		return -EINVAL;
+
+	cl->fillfunc = fillfunc;
+	cl->fillfunc_data = data;
+	return 0;
+}
+
 /**
  * scols_column_set_safechars:
  * @cl: a pointer to a struct libscols_column instance
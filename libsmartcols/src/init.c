@@ -8,7 +8,7 @@
 /**
  * SECTION: init
  * @title: Library initialization
- * @short_description: initialize debugging
+ * @short_description: initialize debugging and statistics
  *
  * The library debug stuff.
  */
@@ -31,6 +31,24 @@ UL_DEBUG_DEFINE_MASKNAMES(libsmartcols) =
 	{ NULL, 0, NULL }
 };
 
+UL_DEBUG_DEFINE_STATS(libsmartcols, __SCOLS_STAT_COUNT);
+UL_DEBUG_DEFINE_STATNAMES(libsmartcols) =
+{
+	[SCOLS_STAT_TABLE_ALLOC]  = { "table-alloc",	"allocated tables" },
+	[SCOLS_STAT_LINE_ALLOC]	  = { "line-alloc",	"allocated lines" },
+	[SCOLS_STAT_CELL_COPIES]  = { "cell-copies",	"copied cell data" },
+	[SCOLS_STAT_ARENA_CHUNKS] = { "arena-chunks",	"allocated arena chunks" },
+	[SCOLS_STAT_PRINT]	  = { "print",		"printed tables" },
+	[SCOLS_STAT_PRINT_NS]	  = { "print-ns",	"nanoseconds spent in printing" },
+	[SCOLS_STAT_CALCULATE_NS] = { "calculate-ns",	"nanoseconds spent in columns width calculation" },
+};
+
+static void scols_print_stats(void)
+{
+	ul_debug_print_stats("libsmartcols", UL_DEBUG_STATNAMES(libsmartcols),
+			UL_DEBUG_STATS(libsmartcols), __SCOLS_STAT_COUNT);
+}
+
 /**
  * scols_init_debug:
  * @mask: debug mask (0xffff to enable full debugging)
@@ -40,6 +58,10 @@ UL_DEBUG_DEFINE_MASKNAMES(libsmartcols) =
  *
  * Already initialized debugging stuff cannot be changed. Calling
  * this function twice has no effect.
+ *
+ * The function also reads the LIBSMARTCOLS_STATS environment variable; if
+ * set to a non-zero value, the statistics are enabled (see
+ * scols_enable_stats()) and printed to stderr at exit.
  */
 void scols_init_debug(int mask)
 {
@@ -47,6 +69,7 @@ void scols_init_debug(int mask)
 		return;
 
 	__UL_INIT_DEBUG_FROM_ENV(libsmartcols, SCOLS_DEBUG_, mask, LIBSMARTCOLS_DEBUG);
+	__UL_INIT_STATS_FROM_ENV(libsmartcols, LIBSMARTCOLS_STATS, scols_print_stats);
 
 	if (libsmartcols_debug_mask != SCOLS_DEBUG_INIT
 	    && libsmartcols_debug_mask != (SCOLS_DEBUG_HELP|SCOLS_DEBUG_INIT)) {
@@ -60,3 +83,57 @@ void scols_init_debug(int mask)
 	ON_DBG(HELP, ul_debug_print_masks("LIBSMARTCOLS_DEBUG",
 				UL_DEBUG_MASKNAMES(libsmartcols)));
 }
+
+/**
+ * scols_enable_stats:
+ * @enable: TRUE or FALSE
+ *
+ * Enables or disables the library statistics counters. The counters are
+ * global for all the tables and all threads. The counters are not reset,
+ * see scols_reset_stats().
+ *
+ * Returns: 0 on success.
+ *
+ * Since: ext-1
+ */
+int scols_enable_stats(int enable)
+{
+	libsmartcols_stats_enabled = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * scols_reset_stats:
+ *
+ * Sets all the statistics counters to zero.
+ *
+ * Since: ext-1
+ */
+void scols_reset_stats(void)
+{
+	size_t i;
+
+	for (i = 0; i < __SCOLS_STAT_COUNT; i++)
+		__atomic_store_n(&libsmartcols_stats[i], 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * scols_get_stat:
+ * @idx: counter number
+ * @name: returns name of the counter (or NULL)
+ * @value: returns value of the counter (or NULL)
+ *
+ * Returns the statistics counter, see scols_enable_stats(). The names are
+ * the same as printed for the LIBSMARTCOLS_STATS environment variable, the
+ * counters with "-ns" suffix are in nanoseconds.
+ *
+ * Returns: 0 on success, 1 if @idx is out of range.
+ *
+ * Since: ext-1
+ */
+int scols_get_stat(size_t idx, const char **name, unsigned long long *value)
+{
+	return ul_debug_get_stat(UL_DEBUG_STATNAMES(libsmartcols),
+			UL_DEBUG_STATS(libsmartcols), __SCOLS_STAT_COUNT,
+			idx, name, value);
+}
@@ -34,6 +34,16 @@
  *
  * Returns: a pointer to a new struct libscols_line instance.
  */
+static void init_line(struct libscols_line *ln)
+{
+	STAT_ADD(LINE_ALLOC, 1);
+	ln->refcount = 1;
+	INIT_LIST_HEAD(&ln->ln_lines);
+	INIT_LIST_HEAD(&ln->ln_children);
+	INIT_LIST_HEAD(&ln->ln_branch);
+	INIT_LIST_HEAD(&ln->ln_groups);
+}
+
 struct libscols_line *scols_new_line(void)
 {
 	struct libscols_line *ln;
@@ -43,11 +53,26 @@ struct libscols_line *scols_new_line(void)
 		return NULL;
 
 	DBG(LINE, ul_debugobj(ln, "alloc"));
-	ln->refcount = 1;
-	INIT_LIST_HEAD(&ln->ln_lines);
-	INIT_LIST_HEAD(&ln->ln_children);
-	INIT_LIST_HEAD(&ln->ln_branch);
-	INIT_LIST_HEAD(&ln->ln_groups);
+	init_line(ln);
+	return ln;
+}
+
+/*
+ * Allocates the line, its cells and the cells data from the arena. The line
+ * keeps a reference to the arena.
+ */
+struct libscols_line *__scols_new_arena_line(struct libscols_arena *ar)
+{
+	struct libscols_line *ln;
+
+	ln = scols_arena_calloc(ar, sizeof(*ln));
+	if (!ln)
+		return NULL;
+
+	DBG(LINE, ul_debugobj(ln, "alloc (arena)"));
+	init_line(ln);
+	ln->arena = ar;
+	scols_ref_arena(ar);
 	return ln;
 }
 
@@ -80,7 +105,10 @@ void scols_unref_line(struct libscols_line *ln)
 		scols_unref_group(ln->group);
 		scols_line_free_cells(ln);
 		free(ln->color);
-		free(ln);
+		if (ln->arena)
+			scols_unref_arena(ln->arena);
+		else
+			free(ln);
 		return;
 	}
 }
@@ -103,9 +131,11 @@ void scols_line_free_cells(struct libscols_line *ln)
 	for (i = 0; i < ln->ncells; i++)
 		scols_reset_cell(&ln->cells[i]);
 
-	free(ln->cells);
+	if (!ln->cells_in_arena)
+		free(ln->cells);
 	ln->ncells = 0;
 	ln->cells = NULL;
+	ln->cells_in_arena = 0;
 }
 
 /**
@@ -136,9 +166,21 @@ int scols_line_alloc_cells(struct libscols_line *ln, size_t n)
 
 	DBG(LINE, ul_debugobj(ln, "alloc %zu cells", n));
 
-	ce = realloc(ln->cells, n * sizeof(struct libscols_cell));
-	if (!ce)
-		return -errno;
+	if (ln->arena && (!ln->cells || ln->cells_in_arena)) {
+		/* the old cells are not released, but it's unusual to
+		 * resize the line more than once */
+		ce = scols_arena_calloc(ln->arena, n * sizeof(struct libscols_cell));
+		if (!ce)
+			return -ENOMEM;
+		if (ln->cells)
+			memcpy(ce, ln->cells,
+			       min(n, ln->ncells) * sizeof(struct libscols_cell));
+		ln->cells_in_arena = 1;
+	} else {
+		ce = realloc(ln->cells, n * sizeof(struct libscols_cell));
+		if (!ce)
+			return -errno;
+	}
 
 	if (n > ln->ncells)
 		memset(ce + ln->ncells, 0,
@@ -414,7 +456,9 @@ struct libscols_cell *scols_line_get_cell(struct libscols_line *ln,
  * @ln: a pointer to a struct libscols_line instance
  * @cl: pointer to cell
  *
- * Like scols_line_get_cell() by cell is referenced by column.
+ * Like scols_line_get_cell() by cell is referenced by column. If the cell is
+ * empty and the column has a fill function (see scols_column_set_fillfunc()),
+ * the function is called to fill the cell.
  *
  * Returns: the @n-th cell in @ln, NULL in case of an error.
  */
@@ -422,10 +466,22 @@ struct libscols_cell *scols_line_get_column_cell(
 			struct libscols_line *ln,
 			struct libscols_column *cl)
 {
+	struct libscols_cell *ce;
+
 	if (!ln || !cl)
 		return NULL;
 
-	return scols_line_get_cell(ln, cl->seqnum);
+	ce = scols_line_get_cell(ln, cl->seqnum);
+	if (ce && cl->fillfunc && !ce->data && !ce->fill_done) {
+		int rc;
+
+		ce->fill_done = 1;
+		rc = cl->fillfunc(cl, ln, ce, cl->fillfunc_data);
+		if (rc)
+			DBG(LINE, ul_debugobj(ln, "fill cell %zu failed [rc=%d]",
+						cl->seqnum, rc));
+	}
+	return ce;
 }
 
 /**
@@ -442,6 +498,8 @@ int scols_line_set_data(struct libscols_line *ln, size_t n, const char *data)
 
 	if (!ce)
 		return -EINVAL;
+	if (ln->arena)
+		return __scols_cell_set_arena_data(ce, ln->arena, data);
 	return scols_cell_set_data(ce, data);
 }
 
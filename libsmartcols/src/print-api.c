@@ -19,7 +19,7 @@ int scols_table_print_range(	struct libscols_table *tb,
 	struct libscols_iter itr;
 	int rc;
 
-	if (scols_table_is_tree(tb))
+	if (scols_table_is_tree(tb) || scols_table_is_binary(tb))
 		return -EINVAL;
 
 	DBG(TAB, ul_debugobj(tb, "printing range from API"));
@@ -98,7 +98,7 @@ int scols_table_print_range_to_string(
 }
 #endif
 
-static int do_print_table(struct libscols_table *tb, int *is_empty)
+static int __do_print_table(struct libscols_table *tb, int *is_empty)
 {
 	int rc = 0;
 	struct libscols_buffer *buf = NULL;
@@ -110,10 +110,15 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	if (is_empty)
 		*is_empty = 0;
 
+	if (tb->stream_buf)
+		return __scols_stream_finish(tb);
+
 	if (list_empty(&tb->tb_columns)) {
 		DBG(TAB, ul_debugobj(tb, "error -- no columns"));
 		return -EINVAL;
 	}
+	if (scols_table_is_binary(tb))
+		return __scols_print_binary(tb);
 	if (list_empty(&tb->tb_lines)) {
 		DBG(TAB, ul_debugobj(tb, "ignore -- no lines"));
 		if (scols_table_is_json(tb)) {
@@ -158,6 +163,15 @@ done:
 	return rc;
 }
 
+static int do_print_table(struct libscols_table *tb, int *is_empty)
+{
+	int rc;
+
+	STAT_ADD(PRINT, 1);
+	STAT_TIME(PRINT_NS, rc = __do_print_table(tb, is_empty));
+	return rc;
+}
+
 /**
  * scols_print_table:
  * @tb: table
@@ -171,7 +185,8 @@ int scols_print_table(struct libscols_table *tb)
 	int empty = 0;
 	int rc = do_print_table(tb, &empty);
 
-	if (rc == 0 && !empty && !scols_table_is_json(tb))
+	if (rc == 0 && !empty && !scols_table_is_json(tb)
+	    && !scols_table_is_binary(tb))
 		fputc('\n', tb->out);
 	return rc;
 }
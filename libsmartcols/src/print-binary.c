@@ -0,0 +1,137 @@
+/*
+ * print-binary.c - binary output format
+ *
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The format is designed for collectors which read the output periodically;
+ * it does not need any formatting on the library side (no widths, no
+ * encoding, no escaping) and no text parsing on the reader side. All the
+ * numbers are unsigned little-endian integers, the strings are stored as
+ * <u32 length><bytes> without the terminating zero, the length 0xffffffff
+ * is used for NULL.
+ *
+ *	header:	"SCOLSBIN"		magic, 8 bytes
+ *		<u32 version>		SCOLS_BINARY_VERSION
+ *		<string name>		table name (scols_table_set_name())
+ *		<u32 ncolumns>		number of the (not hidden) columns
+ *		ncolumns x {
+ *			<u32 json type>	SCOLS_JSON_*
+ *			<u32 data type>	SCOLS_DATA_*
+ *			<string name>	column name
+ *		}
+ *	line:	'L'
+ *		<u32 id>		line ID, starts at 1
+ *		<u32 parent id>		parent line ID, or 0
+ *		ncolumns x <string data>
+ *	end:	'E'
+ *
+ * The lines are in the table order (see scols_sort_table()), the tree is
+ * described by the parent IDs only.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "smartcolsP.h"
+
+#define SCOLS_BINARY_MAGIC	"SCOLSBIN"
+#define SCOLS_BINARY_VERSION	1
+#define SCOLS_BINARY_NULL	0xffffffffU
+
+static void put_u32(FILE *out, uint32_t num)
+{
+	unsigned char buf[4];
+
+	buf[0] = num & 0xff;
+	buf[1] = (num >> 8) & 0xff;
+	buf[2] = (num >> 16) & 0xff;
+	buf[3] = (num >> 24) & 0xff;
+	fwrite(buf, 1, sizeof(buf), out);
+}
+
+static int put_string(FILE *out, const char *str)
+{
+	size_t sz;
+
+	if (!str) {
+		put_u32(out, SCOLS_BINARY_NULL);
+		return 0;
+	}
+	sz = strlen(str);
+	if (sz >= SCOLS_BINARY_NULL)
+		return -EINVAL;
+	put_u32(out, (uint32_t) sz);
+	fwrite(str, 1, sz, out);
+	return 0;
+}
+
+static uint32_t line_id(struct libscols_line *ln)
+{
+	return ln ? (uint32_t) ln->outid : 0;
+}
+
+int __scols_print_binary(struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	struct libscols_line *ln;
+	struct libscols_iter itr;
+	uint32_t ncols = 0;
+	size_t id = 0;
+	int rc = 0;
+
+	assert(tb);
+
+	DBG(TAB, ul_debugobj(tb, "printing binary"));
+
+	/* the parent may be after the child in the table */
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_line(tb, &itr, &ln) == 0)
+		ln->outid = ++id;
+	if (id >= SCOLS_BINARY_NULL)
+		return -EOVERFLOW;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		if (!scols_column_is_hidden(cl))
+			ncols++;
+	}
+
+	fputs(SCOLS_BINARY_MAGIC, tb->out);
+	put_u32(tb->out, SCOLS_BINARY_VERSION);
+	rc = put_string(tb->out, tb->name);
+	put_u32(tb->out, ncols);
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (rc == 0 && scols_table_next_column(tb, &itr, &cl) == 0) {
+		if (scols_column_is_hidden(cl))
+			continue;
+		put_u32(tb->out, (uint32_t) cl->json_type);
+		put_u32(tb->out, (uint32_t) cl->data_type);
+		rc = put_string(tb->out, scols_cell_get_data(&cl->header));
+	}
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (rc == 0 && scols_table_next_line(tb, &itr, &ln) == 0) {
+		struct libscols_iter citr;
+
+		fputc('L', tb->out);
+		put_u32(tb->out, line_id(ln));
+		put_u32(tb->out, line_id(ln->parent));
+
+		scols_reset_iter(&citr, SCOLS_ITER_FORWARD);
+		while (rc == 0 && scols_table_next_column(tb, &citr, &cl) == 0) {
+			if (scols_column_is_hidden(cl))
+				continue;
+			rc = put_string(tb->out, scols_cell_get_data(
+					scols_line_get_column_cell(ln, cl)));
+		}
+	}
+
+	if (rc == 0)
+		fputc('E', tb->out);
+	if (rc == 0 && ferror(tb->out))
+		rc = -EIO;
+	return rc;
+}
@@ -32,10 +32,6 @@
  * fallback to be more robust and backwardly compatible.
  */
 #define titlepadding_symbol(tb)	((tb)->symbols->title_padding ? (tb)->symbols->title_padding : " ")
-#define branch_symbol(tb)	((tb)->symbols->tree_branch ? (tb)->symbols->tree_branch : "|-")
-#define vertical_symbol(tb)	((tb)->symbols->tree_vert ? (tb)->symbols->tree_vert : "| ")
-#define right_symbol(tb)	((tb)->symbols->tree_right ? (tb)->symbols->tree_right : "`-")
-
 #define grp_vertical_symbol(tb)	((tb)->symbols->group_vert ? (tb)->symbols->group_vert : "|")
 #define grp_horizontal_symbol(tb) ((tb)->symbols->group_horz ? (tb)->symbols->group_horz : "-")
 #define grp_m_first_symbol(tb)	((tb)->symbols->group_first_member ? (tb)->symbols->group_first_member : ",->")
@@ -78,7 +74,7 @@ static int is_next_columns_empty(
 		if (scols_column_is_tree(cl))
 			return 0;
 
-		ce = scols_line_get_cell(ln, cl->seqnum);
+		ce = scols_line_get_column_cell(ln, cl);
 		if (ce)
 			data = scols_cell_get_data(ce);
 		if (data && *data)
@@ -113,6 +109,17 @@ static int tree_ascii_art_to_buffer(struct libscols_table *tb,
 	return buffer_append_data(buf, art);
 }
 
+/* tree ASCII-art for the parent of @ln; precomputed by scols_walk_tree() */
+static int tree_parent_art_to_buffer(struct libscols_table *tb,
+				     struct libscols_line *ln,
+				     struct libscols_buffer *buf)
+{
+	if (tb->walking)
+		return buffer_append_data(buf, tb->walk_art);
+
+	return tree_ascii_art_to_buffer(tb, ln->parent, buf);
+}
+
 static int grpset_is_empty(	struct libscols_table *tb,
 				size_t idx,
 				size_t *rest)
@@ -321,7 +328,9 @@ static void print_empty_cell(struct libscols_table *tb,
 
 			if (art) {
 				/* whatever the rc, len_pad will be sensible */
-				tree_ascii_art_to_buffer(tb, ln, art);
+				if (tree_parent_art_to_buffer(tb, ln, art) == 0)
+					buffer_append_data(art, is_last_child(ln) ?
+							"  " : vertical_symbol(tb));
 				if (!list_empty(&ln->ln_branch) && has_pending_data(tb))
 					buffer_append_data(art, vertical_symbol(tb));
 				data = buffer_get_safe_data(tb, art, &len_pad, NULL);
@@ -709,7 +718,7 @@ int __cell_to_buffer(struct libscols_table *tb,
 
 	buffer_reset_data(buf);
 
-	ce = scols_line_get_cell(ln, cl->seqnum);
+	ce = scols_line_get_column_cell(ln, cl);
 	data = ce ? scols_cell_get_data(ce) : NULL;
 
 	if (!scols_column_is_tree(cl))
@@ -725,7 +734,7 @@ int __cell_to_buffer(struct libscols_table *tb,
 	 * Tree stuff
 	 */
 	if (!rc && ln->parent && !scols_table_is_json(tb)) {
-		rc = tree_ascii_art_to_buffer(tb, ln->parent, buf);
+		rc = tree_parent_art_to_buffer(tb, ln, buf);
 
 		if (!rc && is_last_child(ln))
 			rc = buffer_append_data(buf, right_symbol(tb));
@@ -767,7 +776,7 @@ static int print_line(struct libscols_table *tb,
 		rc = __cell_to_buffer(tb, ln, cl, buf);
 		if (rc == 0)
 			rc = print_data(tb, cl, ln,
-					scols_line_get_cell(ln, cl->seqnum),
+					scols_line_get_column_cell(ln, cl),
 					buf);
 		if (rc == 0 && cl->pending_data)
 			pending = 1;
@@ -786,7 +795,7 @@ static int print_line(struct libscols_table *tb,
 			if (scols_column_is_hidden(cl))
 				continue;
 			if (cl->pending_data) {
-				rc = print_pending_data(tb, cl, ln, scols_line_get_cell(ln, cl->seqnum));
+				rc = print_pending_data(tb, cl, ln, scols_line_get_column_cell(ln, cl));
 				if (rc == 0 && cl->pending_data)
 					pending = 1;
 			} else
@@ -1078,6 +1087,42 @@ static size_t strlen_line(struct libscols_line *ln)
 	return sz;
 }
 
+/*
+ * Estimates extra space necessary for tree, JSON or another output
+ * decoration.
+ */
+static size_t get_extra_bufsz(struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+	size_t sz = 0;
+
+	if (scols_table_is_tree(tb))
+		sz += tb->nlines * strlen(vertical_symbol(tb));
+
+	switch (tb->format) {
+	case SCOLS_FMT_RAW:
+		sz += tb->ncols;			/* separator between columns */
+		break;
+	case SCOLS_FMT_JSON:
+		sz += tb->nlines * 3;			/* indentation */
+		/* fallthrough */
+	case SCOLS_FMT_EXPORT:
+		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+
+		while (scols_table_next_column(tb, &itr, &cl) == 0) {
+			if (scols_column_is_hidden(cl))
+				continue;
+			sz += strlen(scols_cell_get_data(&cl->header));	/* data */
+			sz += 2;					/* separators */
+		}
+		break;
+	case SCOLS_FMT_HUMAN:
+		break;
+	}
+	return sz;
+}
+
 void __scols_cleanup_printing(struct libscols_table *tb, struct libscols_buffer *buf)
 {
 	if (!tb)
@@ -1128,38 +1173,10 @@ int __scols_initialize_printing(struct libscols_table *tb, struct libscols_buffe
 	if (!tb->is_term || tb->format != SCOLS_FMT_HUMAN || scols_table_is_tree(tb))
 		tb->header_repeat = 0;
 
-	/*
-	 * Estimate extra space necessary for tree, JSON or another output
-	 * decoration.
-	 */
-	if (scols_table_is_tree(tb))
-		extra_bufsz += tb->nlines * strlen(vertical_symbol(tb));
-
-	switch (tb->format) {
-	case SCOLS_FMT_RAW:
-		extra_bufsz += tb->ncols;			/* separator between columns */
-		break;
-	case SCOLS_FMT_JSON:
+	if (tb->format == SCOLS_FMT_JSON)
 		ul_jsonwrt_init(&tb->json, tb->out, 0);
-		extra_bufsz += tb->nlines * 3;		/* indentation */
-		/* fallthrough */
-	case SCOLS_FMT_EXPORT:
-	{
-		struct libscols_column *cl;
 
-		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-
-		while (scols_table_next_column(tb, &itr, &cl) == 0) {
-			if (scols_column_is_hidden(cl))
-				continue;
-			extra_bufsz += strlen(scols_cell_get_data(&cl->header));	/* data */
-			extra_bufsz += 2;						/* separators */
-		}
-		break;
-	}
-	case SCOLS_FMT_HUMAN:
-		break;
-	}
+	extra_bufsz = get_extra_bufsz(tb);
 
 	/*
 	 * Enlarge buffer if necessary, the buffer should be large enough to
@@ -1187,7 +1204,7 @@ int __scols_initialize_printing(struct libscols_table *tb, struct libscols_buffe
 		scols_groups_fix_members_order(tb);
 
 	if (tb->format == SCOLS_FMT_HUMAN) {
-		rc = __scols_calculate(tb, *buf);
+		STAT_TIME(CALCULATE_NS, rc = __scols_calculate(tb, *buf));
 		if (rc != 0)
 			goto err;
 	}
@@ -1198,3 +1215,127 @@ err:
 	return rc;
 }
 
+/*
+ * Streaming output -- the columns width is calculated when the number of
+ * lines is greater than the streaming window, then all lines except the last
+ * one (the application may still set its cells) are printed and removed from
+ * the table.
+ */
+static int stream_start(struct libscols_table *tb)
+{
+	struct libscols_buffer *buf = NULL;
+	int rc;
+
+	DBG(TAB, ul_debugobj(tb, "streaming start [lines=%zu]", tb->nlines));
+
+	tb->header_printed = 0;
+	rc = __scols_initialize_printing(tb, &buf);
+	if (rc)
+		return rc;
+	tb->stream_buf = buf;
+
+	if (scols_table_is_json(tb)) {
+		ul_jsonwrt_root_open(&tb->json);
+		ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
+	}
+
+	if (tb->format == SCOLS_FMT_HUMAN)
+		__scols_print_title(tb);
+
+	return __scols_print_header(tb, buf);
+}
+
+static int stream_print_line(struct libscols_table *tb,
+			     struct libscols_line *ln, int last)
+{
+	size_t sz = strlen_line(ln) + get_extra_bufsz(tb) + 1;
+	int rc;
+
+	/* the width has been calculated from the first lines only */
+	if (sz > buffer_get_size(tb->stream_buf)) {
+		struct libscols_buffer *buf = new_buffer(sz);
+
+		if (!buf)
+			return -ENOMEM;
+		free_buffer(tb->stream_buf);
+		tb->stream_buf = buf;
+	}
+
+	if (scols_table_is_json(tb))
+		ul_jsonwrt_object_open(&tb->json, NULL);
+
+	rc = print_line(tb, ln, tb->stream_buf);
+
+	if (scols_table_is_json(tb))
+		ul_jsonwrt_object_close(&tb->json);
+	else if (last == 0 && tb->no_linesep == 0) {
+		fputs(linesep(tb), tb->out);
+		tb->termlines_used++;
+	}
+
+	if (rc == 0 && !last && want_repeat_header(tb))
+		rc = __scols_print_header(tb, tb->stream_buf);
+	return rc;
+}
+
+static int stream_next_line(struct libscols_table *tb, int last)
+{
+	struct libscols_line *ln = list_first_entry(&tb->tb_lines,
+					struct libscols_line, ln_lines);
+	int rc = stream_print_line(tb, ln, last);
+
+	scols_table_remove_line(tb, ln);
+	tb->nstreamed++;
+	return rc;
+}
+
+/*
+ * Called by scols_table_add_line() in the streaming mode.
+ */
+int __scols_stream_lines(struct libscols_table *tb)
+{
+	int rc = 0;
+
+	assert(tb);
+
+	if (scols_table_is_tree(tb) || has_groups(tb)
+	    || scols_table_is_binary(tb)
+	    || list_empty(&tb->tb_columns))
+		return 0;	/* not supported, print it as usually */
+
+	if (!tb->stream_buf) {
+		if (tb->nlines <= tb->stream_window)
+			return 0;
+		rc = stream_start(tb);
+	}
+
+	while (rc == 0 && tb->nlines > 1)
+		rc = stream_next_line(tb, 0);
+	return rc;
+}
+
+/*
+ * Prints the rest of the streamed table.
+ */
+int __scols_stream_finish(struct libscols_table *tb)
+{
+	int rc = 0;
+
+	assert(tb);
+	assert(tb->stream_buf);
+
+	DBG(TAB, ul_debugobj(tb, "streaming finish [printed=%zu, rest=%zu]",
+				tb->nstreamed, tb->nlines));
+
+	while (rc == 0 && !list_empty(&tb->tb_lines))
+		rc = stream_next_line(tb, tb->nlines == 1);
+
+	if (scols_table_is_json(tb)) {
+		ul_jsonwrt_array_close(&tb->json);
+		ul_jsonwrt_root_close(&tb->json);
+	}
+
+	__scols_cleanup_printing(tb, tb->stream_buf);
+	tb->stream_buf = NULL;
+	return rc;
+}
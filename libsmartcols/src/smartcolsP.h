@@ -41,6 +41,25 @@ UL_DEBUG_DECLARE_MASK(libsmartcols);
 #define UL_DEBUG_CURRENT_MASK	UL_DEBUG_MASK(libsmartcols)
 #include "debugobj.h"
 
+/*
+ * Statistics, see scols_enable_stats()
+ */
+enum {
+	SCOLS_STAT_TABLE_ALLOC = 0,
+	SCOLS_STAT_LINE_ALLOC,
+	SCOLS_STAT_CELL_COPIES,
+	SCOLS_STAT_ARENA_CHUNKS,
+	SCOLS_STAT_PRINT,
+	SCOLS_STAT_PRINT_NS,
+	SCOLS_STAT_CALCULATE_NS,
+
+	__SCOLS_STAT_COUNT
+};
+
+UL_DEBUG_DECLARE_STATS(libsmartcols, __SCOLS_STAT_COUNT);
+#define STAT_ADD(c, n)	__UL_STAT_ADD(libsmartcols, SCOLS_STAT_, c, n)
+#define STAT_TIME(c, x)	__UL_STAT_TIME(libsmartcols, SCOLS_STAT_, c, x)
+
 /*
  * Generic iterator
  */
@@ -80,8 +99,25 @@ struct libscols_cell {
 	char	*color;
 	void    *userdata;
 	int	flags;
+	size_t	width;		/* cached display width of data */
+
+	union {
+		uint64_t	u64;
+		int64_t		s64;
+		double		fl;
+	} sortkey;		/* see scols_cell_set_sort_*() */
+
+	unsigned int	data_in_arena :1,	/* don't free() data */
+			width_valid :1,		/* width is up to date */
+			width_noenc :1,		/* width counted without encoding */
+			is_ascii :1,		/* data are printable ASCII only */
+			has_sortkey :1,		/* sortkey is set */
+			fill_done :1,		/* column fillfunc already called */
+			arena_used :1;		/* the first data from the arena */
 };
 
+extern size_t __scols_cell_get_width(struct libscols_cell *ce, int noencoding);
+
 extern int scols_line_move_cells(struct libscols_line *ln, size_t newn, size_t oldn);
 
 /*
@@ -97,13 +133,17 @@ struct libscols_column {
 	size_t  width_avg;	/* average width, used to detect extreme fields */
 	size_t	width_treeart;	/* size of the tree ascii art */
 	double	width_hint;	/* hint (N < 1 is in percent of termwidth) */
+	size_t	width_data;	/* width from data, for reusable tables */
+	size_t	width_final;	/* width from the previous print, for reusable tables */
 
 	size_t	extreme_sum;
 	int	extreme_count;
 
 	int	json_type;	/* SCOLS_JSON_* */
+	int	data_type;	/* SCOLS_DATA_* */
 
 	int	flags;
+	int	calc_flags;	/* flags set by width calculation */
 	char	*color;		/* default column color */
 	char	*safechars;	/* do not encode this bytes */
 
@@ -122,6 +162,11 @@ struct libscols_column {
 			char *, void *);
 	void *wrapfunc_data;
 
+	int (*fillfunc)(struct libscols_column *,
+			struct libscols_line *,
+			struct libscols_cell *,
+			void *);		/* generates cell data on demand */
+	void *fillfunc_data;
 
 	struct libscols_cell	header;
 	struct list_head	cl_columns;	/* member of table->tb_columns */
@@ -170,6 +215,7 @@ struct libscols_group {
 struct libscols_line {
 	int	refcount;
 	size_t	seqnum;
+	size_t	outid;		/* line ID in binary output */
 
 	void	*userdata;
 	char	*color;		/* default line color */
@@ -177,6 +223,9 @@ struct libscols_line {
 	struct libscols_cell	*cells;		/* array with data */
 	size_t			ncells;		/* number of cells */
 
+	struct libscols_arena	*arena;		/* line allocated by table arena */
+	unsigned int		cells_in_arena :1;
+
 	struct list_head	ln_lines;	/* member of table->tb_lines */
 	struct list_head	ln_branch;	/* head of line->ln_children */
 	struct list_head	ln_children;	/* member of line->ln_children or group->gr_children */
@@ -191,9 +240,13 @@ enum {
 	SCOLS_FMT_HUMAN = 0,		/* default, human readable */
 	SCOLS_FMT_RAW,			/* space separated */
 	SCOLS_FMT_EXPORT,		/* COLNAME="data" ... */
-	SCOLS_FMT_JSON			/* http://en.wikipedia.org/wiki/JSON */
+	SCOLS_FMT_JSON,			/* http://en.wikipedia.org/wiki/JSON */
+	SCOLS_FMT_BINARY		/* see print-binary.c */
 };
 
+/* default number of lines used to calculate width in streaming mode */
+#define SCOLS_STREAM_WINDOW	128
+
 /*
  * The table
  */
@@ -221,6 +274,11 @@ struct libscols_table {
 
 	size_t			ngrpchlds_pending;	/* groups with not yet printed children */
 	struct libscols_line	*walk_last_tree_root;	/* last root, used by scols_walk_() */
+	struct libscols_line	*walk_root;		/* root of the currently walked tree */
+	size_t			walk_nonlast;		/* number of not-last-child ancestors */
+	char			*walk_art;		/* tree art for the parent of the walked line */
+	size_t			walk_artlen;
+	size_t			walk_artsz;
 
 	struct libscols_column	*dflt_sort_column;	/* default sort column, set by scols_sort_table() */
 
@@ -234,6 +292,12 @@ struct libscols_table {
 	size_t	termlines_used;	/* printed line counter */
 	size_t	header_next;	/* where repeat header */
 
+	struct libscols_arena	*arena;		/* for lines and cells */
+	struct libscols_buffer	*stream_buf;	/* streaming started */
+	size_t	stream_window;	/* number of lines to calculate columns width */
+	size_t	nstreamed;	/* already printed and removed lines */
+	size_t	reuse_termwidth;	/* terminal width used for width_final */
+
 	const char *cur_color;	/* current active color when printing */
 
 	/* flags */
@@ -248,10 +312,14 @@ struct libscols_table {
 			header_printed  :1,	/* header already printed */
 			priv_symbols	:1,	/* default private symbols */
 			walk_last_done	:1,	/* last tree root walked */
+			walking		:1,	/* scols_walk_tree() in progress */
 			no_headings	:1,	/* don't print header */
 			no_encode	:1,	/* don't care about control and non-printable chars */
 			no_linesep	:1,	/* don't print line separator */
-			no_wrap		:1;	/* never wrap lines */
+			no_wrap		:1,	/* never wrap lines */
+			streaming	:1,	/* print lines when added */
+			reusable	:1,	/* printed repeatedly, keep columns width */
+			reuse_valid	:1;	/* columns width_final is up to date */
 };
 
 #define IS_ITER_FORWARD(_i)	((_i)->direction == SCOLS_ITER_FORWARD)
@@ -338,6 +406,21 @@ extern int scols_walk_tree(struct libscols_table *tb,
                     void *data);
 extern int scols_walk_is_last(struct libscols_table *tb, struct libscols_line *ln);
 
+/*
+ * arena.c
+ */
+struct libscols_arena;
+
+extern struct libscols_arena *scols_new_arena(void);
+extern void scols_ref_arena(struct libscols_arena *ar);
+extern void scols_unref_arena(struct libscols_arena *ar);
+extern void *scols_arena_calloc(struct libscols_arena *ar, size_t len);
+extern char *scols_arena_strdup(struct libscols_arena *ar, const char *str);
+
+extern struct libscols_line *__scols_new_arena_line(struct libscols_arena *ar);
+extern int __scols_cell_set_arena_data(struct libscols_cell *ce,
+			struct libscols_arena *ar, const char *data);
+
 /*
  * calculate.c
  */
@@ -354,6 +437,7 @@ extern int __cell_to_buffer(struct libscols_table *tb,
 void __scols_cleanup_printing(struct libscols_table *tb, struct libscols_buffer *buf);
 int __scols_initialize_printing(struct libscols_table *tb, struct libscols_buffer **buf);
 int __scols_print_tree(struct libscols_table *tb, struct libscols_buffer *buf);
+int __scols_print_binary(struct libscols_table *tb);
 int __scols_print_table(struct libscols_table *tb, struct libscols_buffer *buf);
 int __scols_print_header(struct libscols_table *tb, struct libscols_buffer *buf);
 int __scols_print_title(struct libscols_table *tb);
@@ -361,6 +445,13 @@ int __scols_print_range(struct libscols_table *tb,
                         struct libscols_buffer *buf,
                         struct libscols_iter *itr,
                         struct libscols_line *end);
+int __scols_stream_lines(struct libscols_table *tb);
+int __scols_stream_finish(struct libscols_table *tb);
+
+/* Fallback for the tree symbols, see also print.c */
+#define branch_symbol(tb)	((tb)->symbols->tree_branch ? (tb)->symbols->tree_branch : "|-")
+#define vertical_symbol(tb)	((tb)->symbols->tree_vert ? (tb)->symbols->tree_vert : "| ")
+#define right_symbol(tb)	((tb)->symbols->tree_right ? (tb)->symbols->tree_right : "`-")
 
 static inline int is_tree_root(struct libscols_line *ln)
 {
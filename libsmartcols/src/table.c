@@ -19,6 +19,7 @@
 
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <string.h>
 #include <termios.h>
@@ -74,8 +75,10 @@ struct libscols_table *scols_new_table(void)
 	if (!tb)
 		return NULL;
 
+	STAT_ADD(TABLE_ALLOC, 1);
 	tb->refcount = 1;
 	tb->out = stdout;
+	tb->stream_window = SCOLS_STREAM_WINDOW;
 
 	get_terminal_dimension(&c, &l);
 	tb->termwidth  = c > 0 ? c : 80;
@@ -125,12 +128,16 @@ void scols_unref_table(struct libscols_table *tb)
 {
 	if (tb && (--tb->refcount <= 0)) {
 		DBG(TAB, ul_debugobj(tb, "dealloc <-"));
+		if (tb->stream_buf)
+			__scols_cleanup_printing(tb, tb->stream_buf);
 		scols_table_remove_groups(tb);
 		scols_table_remove_lines(tb);
+		scols_unref_arena(tb->arena);
 		scols_table_remove_columns(tb);
 		scols_unref_symbols(tb->symbols);
 		scols_reset_cell(&tb->title);
 		free(tb->grpset);
+		free(tb->walk_art);
 		free(tb->linesep);
 		free(tb->colsep);
 		free(tb->name);
@@ -233,6 +240,7 @@ int scols_table_add_column(struct libscols_table *tb, struct libscols_column *cl
 
 	DBG(TAB, ul_debugobj(tb, "add column"));
 	list_add_tail(&cl->cl_columns, &tb->tb_columns);
+	tb->reuse_valid = 0;
 	cl->seqnum = tb->ncols++;
 	cl->table = tb;
 	scols_ref_column(cl);
@@ -275,6 +283,7 @@ int scols_table_remove_column(struct libscols_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "remove column"));
 	list_del_init(&cl->cl_columns);
+	tb->reuse_valid = 0;
 	tb->ncols--;
 	cl->table = NULL;
 	scols_unref_column(cl);
@@ -639,8 +648,11 @@ int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
 
 	DBG(TAB, ul_debugobj(tb, "add line"));
 	list_add_tail(&ln->ln_lines, &tb->tb_lines);
-	ln->seqnum = tb->nlines++;
+	ln->seqnum = tb->nstreamed + tb->nlines++;
 	scols_ref_line(ln);
+
+	if (tb->streaming)
+		return __scols_stream_lines(tb);
 	return 0;
 }
 
@@ -740,7 +752,13 @@ struct libscols_line *scols_table_new_line(struct libscols_table *tb,
 	if (!tb)
 		return NULL;
 
-	ln = scols_new_line();
+	/* the streamed lines are released one by one, don't use arena */
+	if (!tb->streaming && !tb->arena)
+		tb->arena = scols_new_arena();
+	if (!tb->streaming && tb->arena)
+		ln = __scols_new_arena_line(tb->arena);
+	else
+		ln = scols_new_line();
 	if (!ln)
 		return NULL;
 
@@ -1070,6 +1088,38 @@ int scols_table_enable_json(struct libscols_table *tb, int enable)
 	return 0;
 }
 
+/**
+ * scols_table_enable_binary:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable binary output format. The format is designed for
+ * applications which read the output periodically. It's composed from
+ * length-prefixed strings, so it does not require any escaping, encoding
+ * or column width calculation. The tree is described by parent IDs, see
+ * libsmartcols/src/print-binary.c for the format description. The parsable
+ * output formats are mutually exclusive.
+ *
+ * The binary format does not support streaming (see
+ * scols_table_enable_streaming()) and scols_table_print_range().
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_table_enable_binary(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "binary: %s", enable ? "ENABLE" : "DISABLE"));
+	if (enable)
+		tb->format = SCOLS_FMT_BINARY;
+	else if (tb->format == SCOLS_FMT_BINARY)
+		tb->format = 0;
+	return 0;
+}
+
 /**
  * scols_table_enable_export:
  * @tb: table
@@ -1209,6 +1259,124 @@ int scols_table_enable_minout(struct libscols_table *tb, int enable)
 	return 0;
 }
 
+/**
+ * scols_table_enable_streaming:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enables streaming output. The columns width is calculated from the first
+ * lines of the table (see scols_table_set_streaming_window()), the column
+ * headers and the width hints (see scols_column_set_whint()). All the next
+ * lines are printed to the table output stream by scols_table_add_line() and
+ * removed from the table. The line is printed when the next line is added,
+ * so the application has to set all the line cells before it adds the next
+ * line. The last lines and the table end are printed by scols_print_table().
+ *
+ * The already printed lines are unreferenced by the table, don't use them
+ * after the next line is added. The data which does not fit to the calculated
+ * width is printed in the same way as in non-streaming mode (truncated or
+ * wrapped if the column flags allow it).
+ *
+ * The streaming is not supported for tree-like output and for tables with
+ * groups; such tables are printed by scols_print_table() as usually.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_table_enable_streaming(struct libscols_table *tb, int enable)
+{
+	if (!tb || tb->stream_buf)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "streaming: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->streaming = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * scols_table_set_streaming_window:
+ * @tb: table
+ * @nlines: number of lines
+ *
+ * Sets the number of the first lines used to calculate the columns width in
+ * the streaming mode, the default is 128 lines. If the table is smaller, then
+ * it's printed by scols_print_table() as usually. The zero means that the
+ * columns width is calculated from the headers and width hints only and the
+ * lines are printed immediately.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_table_set_streaming_window(struct libscols_table *tb, size_t nlines)
+{
+	if (!tb || tb->stream_buf)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "streaming window: %zu", nlines));
+	tb->stream_window = nlines;
+	return 0;
+}
+
+/**
+ * scols_table_is_streaming:
+ * @tb: table
+ *
+ * Returns: 1 if streaming output is enabled or 0
+ *
+ * Since: ext-1
+ */
+int scols_table_is_streaming(const struct libscols_table *tb)
+{
+	return tb->streaming;
+}
+
+/**
+ * scols_table_enable_reusable:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enables the reusable mode for tables printed repeatedly, for example by
+ * top-like tools. The application keeps the table and updates the lines in
+ * place (e.g. by scols_line_refer_data()) before the next print.
+ *
+ * The columns width is never reduced in this mode, so the output does not
+ * jitter when data becomes shorter. The columns width is calculated from
+ * the data on each print, but the distribution of the width to the
+ * terminal is reused from the previous print if no column is wider than
+ * before and the terminal width has not been changed. Note that
+ * scols_table_reduce_termwidth() reduces the width on each print, use
+ * scols_table_set_termwidth() before the print in this case.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: ext-1
+ */
+int scols_table_enable_reusable(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "reusable: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->reusable = enable ? 1 : 0;
+	tb->reuse_valid = 0;
+	return 0;
+}
+
+/**
+ * scols_table_is_reusable:
+ * @tb: table
+ *
+ * Returns: 1 if reusable mode is enabled or 0
+ *
+ * Since: ext-1
+ */
+int scols_table_is_reusable(const struct libscols_table *tb)
+{
+	return tb->reusable;
+}
+
 /**
  * scols_table_enable_nowrap:
  * @tb: table
@@ -1367,6 +1535,19 @@ int scols_table_is_json(const struct libscols_table *tb)
 	return tb->format == SCOLS_FMT_JSON;
 }
 
+/**
+ * scols_table_is_binary:
+ * @tb: table
+ *
+ * Returns: 1 if binary output format is enabled.
+ *
+ * Since: ext-1
+ */
+int scols_table_is_binary(const struct libscols_table *tb)
+{
+	return tb->format == SCOLS_FMT_BINARY;
+}
+
 /**
  * scols_table_is_maxout
  * @tb: table
@@ -1464,8 +1645,8 @@ static int cells_cmp_wrapper_lines(struct list_head *a, struct list_head *b, voi
 
 	ra = list_entry(a, struct libscols_line, ln_lines);
 	rb = list_entry(b, struct libscols_line, ln_lines);
-	ca = scols_line_get_cell(ra, cl->seqnum);
-	cb = scols_line_get_cell(rb, cl->seqnum);
+	ca = scols_line_get_column_cell(ra, cl);
+	cb = scols_line_get_column_cell(rb, cl);
 
 	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
 }
@@ -1483,13 +1664,173 @@ static int cells_cmp_wrapper_children(struct list_head *a, struct list_head *b,
 
 	ra = list_entry(a, struct libscols_line, ln_children);
 	rb = list_entry(b, struct libscols_line, ln_children);
-	ca = scols_line_get_cell(ra, cl->seqnum);
-	cb = scols_line_get_cell(rb, cl->seqnum);
+	ca = scols_line_get_column_cell(ra, cl);
+	cb = scols_line_get_column_cell(rb, cl);
 
 	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
 }
 
 
+/*
+ * Native sort for columns with data type. The keys are copied to an array,
+ * so the compare functions don't need to lookup the cells or to convert the
+ * data for every comparison.
+ */
+struct sort_item {
+	union {
+		uint64_t	u64;
+		int64_t		s64;
+		double		fl;
+		const char	*str;
+	} key;
+	int		has_key;
+	size_t		idx;		/* original position, the sort is stable */
+	struct list_head *node;
+};
+
+static void get_sort_key(struct libscols_cell *ce, int type, struct sort_item *it)
+{
+	const char *data = scols_cell_get_data(ce);
+
+	it->has_key = 0;
+
+	if (type == SCOLS_DATA_STRING) {
+		it->key.str = data;
+		it->has_key = data != NULL;
+		return;
+	}
+	if (ce && ce->has_sortkey) {
+		switch (type) {
+		case SCOLS_DATA_U64:
+			it->key.u64 = ce->sortkey.u64;
+			break;
+		case SCOLS_DATA_S64:
+			it->key.s64 = ce->sortkey.s64;
+			break;
+		case SCOLS_DATA_FLOAT:
+			it->key.fl = ce->sortkey.fl;
+			break;
+		}
+		it->has_key = 1;
+		return;
+	}
+	if (!data || !*data)
+		return;
+
+	switch (type) {
+	case SCOLS_DATA_U64:
+		it->has_key = ul_strtou64(data, &it->key.u64, 10) == 0;
+		break;
+	case SCOLS_DATA_S64:
+		it->has_key = ul_strtos64(data, &it->key.s64, 10) == 0;
+		break;
+	case SCOLS_DATA_FLOAT:
+	{
+		char *end = NULL;
+
+		errno = 0;
+		it->key.fl = strtod(data, &end);
+		it->has_key = !errno && end != data && !*end;
+		break;
+	}
+	}
+}
+
+static inline int cmp_sort_items_nokey(const struct sort_item *a,
+				       const struct sort_item *b)
+{
+	if (!a->has_key && !b->has_key)
+		return cmp_numbers(a->idx, b->idx);
+	return a->has_key ? 1 : -1;
+}
+
+#define DEFINE_SORT_ITEMS_CMP(_name, _expr) \
+	static int _name(const void *x, const void *y) \
+	{ \
+		const struct sort_item *a = x, *b = y; \
+		int rc; \
+		\
+		if (!a->has_key || !b->has_key) \
+			return cmp_sort_items_nokey(a, b); \
+		rc = (_expr); \
+		return rc ? rc : cmp_numbers(a->idx, b->idx); \
+	}
+
+DEFINE_SORT_ITEMS_CMP(cmp_sort_items_str, strcmp(a->key.str, b->key.str))
+DEFINE_SORT_ITEMS_CMP(cmp_sort_items_u64, cmp_numbers(a->key.u64, b->key.u64))
+DEFINE_SORT_ITEMS_CMP(cmp_sort_items_s64, cmp_numbers(a->key.s64, b->key.s64))
+DEFINE_SORT_ITEMS_CMP(cmp_sort_items_float, cmp_numbers(a->key.fl, b->key.fl))
+
+/*
+ * Sorts the @head list of lines, the @offset is offset of the list member
+ * in struct libscols_line (ln_lines or ln_children).
+ */
+static int sort_lines_by_type(struct list_head *head, size_t offset,
+			      struct libscols_column *cl)
+{
+	int (*cmp)(const void *, const void *);
+	struct sort_item *items;
+	struct list_head *p;
+	size_t i, n = 0;
+
+	list_for_each(p, head)
+		n++;
+	if (n < 2)
+		return 0;
+
+	items = malloc(n * sizeof(*items));
+	if (!items)
+		return -ENOMEM;
+
+	i = 0;
+	list_for_each(p, head) {
+		struct libscols_line *ln =
+			(struct libscols_line *) ((char *) p - offset);
+
+		items[i].idx = i;
+		items[i].node = p;
+		get_sort_key(scols_line_get_column_cell(ln, cl),
+			     cl->data_type, &items[i]);
+		i++;
+	}
+
+	switch (cl->data_type) {
+	case SCOLS_DATA_U64:
+		cmp = cmp_sort_items_u64;
+		break;
+	case SCOLS_DATA_S64:
+		cmp = cmp_sort_items_s64;
+		break;
+	case SCOLS_DATA_FLOAT:
+		cmp = cmp_sort_items_float;
+		break;
+	case SCOLS_DATA_STRING:
+	default:
+		cmp = cmp_sort_items_str;
+		break;
+	}
+	qsort(items, n, sizeof(*items), cmp);
+
+	INIT_LIST_HEAD(head);
+	for (i = 0; i < n; i++)
+		list_add_tail(items[i].node, head);
+
+	free(items);
+	return 0;
+}
+
+static int sort_lines(struct list_head *head, size_t offset,
+		      struct libscols_column *cl)
+{
+	if (cl->cmpfunc) {
+		list_sort(head, offset == offsetof(struct libscols_line, ln_lines) ?
+				cells_cmp_wrapper_lines :
+				cells_cmp_wrapper_children, cl);
+		return 0;
+	}
+	return sort_lines_by_type(head, offset, cl);
+}
+
 static int sort_line_children(struct libscols_line *ln, struct libscols_column *cl)
 {
 	struct list_head *p;
@@ -1501,7 +1842,8 @@ static int sort_line_children(struct libscols_line *ln, struct libscols_column *
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->ln_branch, cells_cmp_wrapper_children, cl);
+		sort_lines(&ln->ln_branch,
+			   offsetof(struct libscols_line, ln_children), cl);
 	}
 
 	if (is_first_group_member(ln)) {
@@ -1511,7 +1853,8 @@ static int sort_line_children(struct libscols_line *ln, struct libscols_column *
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->group->gr_children, cells_cmp_wrapper_children, cl);
+		sort_lines(&ln->group->gr_children,
+			   offsetof(struct libscols_line, ln_children), cl);
 	}
 
 	return 0;
@@ -1522,7 +1865,7 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
 	struct libscols_line *ln;
 	struct libscols_iter itr;
 
-	if (!tb || !cl || !cl->cmpfunc)
+	if (!tb || !cl || (!cl->cmpfunc && !cl->data_type))
 		return -EINVAL;
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
@@ -1536,8 +1879,9 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
  * @tb: table
  * @cl: order by this column or NULL
  *
- * Orders the table by the column. See also scols_column_set_cmpfunc(). If the
- * tree output is enabled then children in the tree are recursively sorted too.
+ * Orders the table by the column. See also scols_column_set_cmpfunc() and
+ * scols_column_set_data_type(). If the tree output is enabled then children in
+ * the tree are recursively sorted too.
  *
  * The column @cl is saved as the default sort column to the @tb and the next time
  * is possible to call scols_sort_table(tb, NULL). The saved column is also used by
@@ -1547,15 +1891,19 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
  */
 int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
 {
+	int rc;
+
 	if (!tb)
 		return -EINVAL;
 	if (!cl)
 		cl = tb->dflt_sort_column;
-	if (!cl || !cl->cmpfunc)
+	if (!cl || (!cl->cmpfunc && !cl->data_type))
 		return -EINVAL;
 
 	DBG(TAB, ul_debugobj(tb, "sorting table by %zu column", cl->seqnum));
-	list_sort(&tb->tb_lines, cells_cmp_wrapper_lines, cl);
+	rc = sort_lines(&tb->tb_lines, offsetof(struct libscols_line, ln_lines), cl);
+	if (rc)
+		return rc;
 
 	if (scols_table_is_tree(tb))
 		__scols_sort_tree(tb, cl);
@@ -1,5 +1,44 @@
+#include <string.h>
+
 #include "smartcolsP.h"
 
+/*
+ * The tree ASCII-art for the children of @ln is the art of @ln's parent and
+ * the @ln's own symbol. It's maintained as a stack during the walk, so it's
+ * not necessary to follow all the parents for every line.
+ */
+static int walk_art_push(struct libscols_table *tb, struct libscols_line *ln)
+{
+	const char *art;
+	size_t sz;
+
+	if (!is_child(ln))
+		return 0;
+
+	art = is_last_child(ln) ? "  " : vertical_symbol(tb);
+	sz = strlen(art);
+
+	if (tb->walk_artlen + sz + 1 > tb->walk_artsz) {
+		size_t newsz = max(tb->walk_artsz * 2, tb->walk_artlen + sz + 1);
+		char *tmp = realloc(tb->walk_art, newsz);
+
+		if (!tmp)
+			return -ENOMEM;
+		tb->walk_art = tmp;
+		tb->walk_artsz = newsz;
+	}
+	memcpy(tb->walk_art + tb->walk_artlen, art, sz + 1);
+	tb->walk_artlen += sz;
+	return 0;
+}
+
+static void walk_art_reset(struct libscols_table *tb, size_t len)
+{
+	tb->walk_artlen = len;
+	if (tb->walk_art)
+		tb->walk_art[len] = '\0';
+}
+
 static int walk_line(struct libscols_table *tb,
 		     struct libscols_line *ln,
 		     struct libscols_column *cl,
@@ -25,9 +64,16 @@ static int walk_line(struct libscols_table *tb,
 	/* children */
 	if (rc == 0 && has_children(ln)) {
 		struct list_head *p;
+		size_t artlen = tb->walk_artlen;
+		int nonlast = is_child(ln) && !is_last_child(ln);
 
 		DBG(LINE, ul_debugobj(ln, " children walk"));
 
+		rc = walk_art_push(tb, ln);
+		if (rc)
+			return rc;
+		tb->walk_nonlast += nonlast;
+
 		list_for_each(p, &ln->ln_branch) {
 			struct libscols_line *chld = list_entry(p,
 					struct libscols_line, ln_children);
@@ -36,6 +82,9 @@ static int walk_line(struct libscols_table *tb,
 			if (rc)
 				break;
 		}
+
+		tb->walk_nonlast -= nonlast;
+		walk_art_reset(tb, artlen);
 	}
 
 	DBG(LINE, ul_debugobj(ln, "<- walk line done [rc=%d]", rc));
@@ -56,18 +105,13 @@ int scols_walk_is_last(struct libscols_table *tb, struct libscols_line *ln)
 	if (is_group_member(ln) && (!is_last_group_member(ln) || has_group_children(ln)))
 		return 0;
 	if (is_child(ln)) {
-		struct libscols_line *parent = ln->parent;
-
 		if (!is_last_child(ln))
 			return 0;
-		while (parent) {
-			if (is_child(parent) && !is_last_child(parent))
-				return 0;
-			if (!parent->parent)
-				break;
-			parent = parent->parent;
-		}
-		if (is_tree_root(parent) && !is_last_tree_root(tb, parent))
+		/* all the parents have to be the last children ... */
+		if (tb->walk_nonlast)
+			return 0;
+		/* ... in the last tree */
+		if (is_tree_root(tb->walk_root) && !is_last_tree_root(tb, tb->walk_root))
 			return 0;
 	}
 	if (is_group_child(ln) && !is_last_group_child(ln))
@@ -96,6 +140,9 @@ int scols_walk_tree(struct libscols_table *tb,
 	tb->ngrpchlds_pending = 0;
 	tb->walk_last_tree_root = NULL;
 	tb->walk_last_done = 0;
+	tb->walk_nonlast = 0;
+	walk_art_reset(tb, 0);
+	tb->walking = 1;
 
 	if (has_groups(tb))
 		scols_groups_reset_state(tb);
@@ -118,6 +165,7 @@ int scols_walk_tree(struct libscols_table *tb,
 
 		if (tb->walk_last_tree_root == ln)
 			tb->walk_last_done = 1;
+		tb->walk_root = ln;
 		rc = walk_line(tb, ln, cl, callback, data);
 
 		/* walk group's children */
@@ -138,6 +186,7 @@ int scols_walk_tree(struct libscols_table *tb,
 				struct libscols_line *chld =
 					list_entry(p, struct libscols_line, ln_children);
 
+				tb->walk_root = chld;
 				rc = walk_line(tb, chld, cl, callback, data);
 				if (rc)
 					break;
@@ -147,6 +196,8 @@ int scols_walk_tree(struct libscols_table *tb,
 
 	tb->ngrpchlds_pending = 0;
 	tb->walk_last_done = 0;
+	tb->walk_root = NULL;
+	tb->walking = 0;
 	DBG(TAB, ul_debugobj(tb, "<< walk end [rc=%d]", rc));
 	return rc;
 }
@@ -49,6 +49,9 @@
 #include <errno.h>
 #include <limits.h>
 #include <sys/types.h>
+#ifdef HAVE_PTHREAD_ATFORK
+#include <pthread.h>
+#endif
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
@@ -77,6 +80,9 @@
 #ifdef HAVE_NET_IF_DL_H
 #include <net/if_dl.h>
 #endif
+#ifdef HAVE_UUIDD
+#include <sys/mman.h>
+#endif
 #if defined(__linux__) && defined(HAVE_SYS_SYSCALL_H)
 #include <sys/syscall.h>
 #endif
@@ -207,8 +213,55 @@ static int get_node_id(unsigned char *node_id)
 	return 0;
 }
 
+/*
+ * The per-thread and per-process caches of the UUIDs (or random bytes) have
+ * to be dropped in the child after fork(). The fork ID is different in the
+ * parent and in the child.
+ *
+ * The fork handlers are not called for a child created by raw clone(), so
+ * the process ID is checked too. A spurious change of the ID (e.g. the
+ * first calls in more threads) only drops the caches.
+ */
+#ifdef HAVE_PTHREAD_ATFORK
+typedef unsigned int fork_id_t;
+
+static volatile fork_id_t fork_generation = 1;
+static volatile pid_t fork_pid;
+static volatile int atfork_registered;
+
+static void atfork_child(void)
+{
+	fork_generation++;
+}
+
+static fork_id_t get_fork_id(void)
+{
+	pid_t pid = getpid();
+
+	if (!atfork_registered) {
+		/* it does not matter if more threads register the handler */
+		atfork_registered = 1;
+		pthread_atfork(NULL, NULL, atfork_child);
+	}
+	if (fork_pid != pid) {
+		fork_pid = pid;
+		fork_generation++;
+	}
+	return fork_generation;
+}
+#else
+typedef pid_t fork_id_t;
+
+static fork_id_t get_fork_id(void)
+{
+	return getpid();
+}
+#endif
+
 /* Assume that the gettimeofday() has microsecond granularity */
 #define MAX_ADJUSTMENT 10
+/* Max. distance (in usec) of the reserved clock values from the current time */
+#define MAX_CLOCK_AHEAD 1000000
 /* Reserve a clock_seq value for the 'continuous clock' implementation */
 #define CLOCK_SEQ_CONT 0
 
@@ -292,7 +345,25 @@ static int get_clock(uint32_t *clock_high, uint32_t *clock_low,
 
 try_again:
 	gettimeofday(&tv, NULL);
-	if ((tv.tv_sec < last.tv_sec) ||
+	if (((tv.tv_sec < last.tv_sec) ||
+	     ((tv.tv_sec == last.tv_sec) &&
+	      (tv.tv_usec < last.tv_usec))) &&
+	    ((int64_t) (last.tv_sec - tv.tv_sec) * 1000000
+		+ (last.tv_usec - tv.tv_usec)) < MAX_CLOCK_AHEAD) {
+		/*
+		 * The last clock is in the future because of the reserved
+		 * clock values (bulk requests), continue after the reserved
+		 * values to keep the clock monotonic.
+		 */
+		adjustment++;
+		if (adjustment >= MAX_ADJUSTMENT) {
+			last.tv_usec += adjustment / MAX_ADJUSTMENT;
+			adjustment %= MAX_ADJUSTMENT;
+			last.tv_sec += last.tv_usec / 1000000;
+			last.tv_usec %= 1000000;
+		}
+		tv = last;
+	} else if ((tv.tv_sec < last.tv_sec) ||
 	    ((tv.tv_sec == last.tv_sec) &&
 	     (tv.tv_usec < last.tv_usec))) {
 		do {
@@ -402,32 +473,43 @@ static int get_clock_cont(uint32_t *clock_high,
 
 #if defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H)
 
-/*
- * Try using the uuidd daemon to generate the UUID
- *
- * Returns 0 on success, non-zero on failure.
- */
-static int get_uuid_via_daemon(int op, uuid_t out, int *num)
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+static int connect_daemon(void)
 {
-	char op_buf[64];
-	int op_len;
-	int s;
-	ssize_t ret;
-	int32_t reply_len = 0, expected = 16;
 	struct sockaddr_un srv_addr;
+	int s;
 
 	if (sizeof(UUIDD_SOCKET_PATH) > sizeof(srv_addr.sun_path))
 		return -1;
 
-	if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	if ((s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
 		return -1;
 
 	srv_addr.sun_family = AF_UNIX;
 	xstrncpy(srv_addr.sun_path, UUIDD_SOCKET_PATH, sizeof(srv_addr.sun_path));
 
 	if (connect(s, (const struct sockaddr *) &srv_addr,
-		    sizeof(struct sockaddr_un)) < 0)
-		goto fail;
+		    sizeof(struct sockaddr_un)) < 0) {
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+/*
+ * Send request @op to uuidd connected by @s and read the reply.
+ *
+ * Returns 0 on success, non-zero on failure.
+ */
+static int call_daemon(int s, int op, uuid_t out, int *num)
+{
+	char op_buf[64];
+	int op_len;
+	ssize_t ret;
+	int32_t reply_len = 0, expected = 16;
 
 	op_buf[0] = op;
 	op_len = 1;
@@ -435,32 +517,238 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 		memcpy(op_buf+1, num, sizeof(*num));
 		op_len += sizeof(*num);
 		expected += sizeof(*num);
-	}
+	} else if (op == UUIDD_OP_PERSISTENT)
+		expected = sizeof(int32_t);
 
-	ret = write(s, op_buf, op_len);
-	if (ret < 1)
-		goto fail;
+	/* don't kill the application by SIGPIPE if uuidd is gone */
+	ret = send(s, op_buf, op_len, MSG_NOSIGNAL);
+	if (ret < op_len)
+		return -1;
 
 	ret = read_all(s, (char *) &reply_len, sizeof(reply_len));
-	if (ret < 0)
-		goto fail;
+	if (ret != sizeof(reply_len))
+		return -1;
 
 	if (reply_len != expected)
-		goto fail;
+		return -1;
 
 	ret = read_all(s, op_buf, reply_len);
+	if (ret != expected)
+		return -1;
 
 	if (op == UUIDD_OP_BULK_TIME_UUID)
-		memcpy(op_buf+16, num, sizeof(int));
+		memcpy(num, op_buf+16, sizeof(int));
+	if (op != UUIDD_OP_PERSISTENT)
+		memcpy(out, op_buf, 16);
 
-	memcpy(out, op_buf, 16);
+	return 0;
+}
 
-	close(s);
-	return ((ret == expected) ? 0 : -1);
+/*
+ * The persistent connection to uuidd is shared by all threads; the thread
+ * which does not get the connection (it's used by another thread) falls back
+ * to a new connection for the request.
+ *
+ * The application may close (or dup2() over) the file descriptor behind our
+ * back, so the descriptor is used only if it's still the same socket. The
+ * connection is not used after fork(), the uuidd would get mixed requests
+ * from the parent and the child.
+ */
+static struct uuidd_conn {
+	int		fd;
+	dev_t		dev;
+	ino_t		ino;
+	fork_id_t	fork_id;
+	char		locked;
+	char		unsupported;	/* old uuidd without UUIDD_OP_PERSISTENT */
+	char		no_ring;	/* the ring is not available by the connection */
+} uuidd_conn = { .fd = -1 };
+
+static int uuidd_conn_is_ours(struct uuidd_conn *cn)
+{
+	struct stat st;
+
+	return fstat(cn->fd, &st) == 0 && S_ISSOCK(st.st_mode)
+	       && st.st_dev == cn->dev && st.st_ino == cn->ino;
+}
+
+static void uuidd_conn_close(struct uuidd_conn *cn)
+{
+	if (uuidd_conn_is_ours(cn))
+		close(cn->fd);
+	cn->fd = -1;
+}
 
+static int uuidd_conn_open(struct uuidd_conn *cn)
+{
+	struct stat st;
+
+	cn->fd = connect_daemon();
+	if (cn->fd < 0)
+		return -1;
+
+	if (fstat(cn->fd, &st) != 0
+	    || call_daemon(cn->fd, UUIDD_OP_PERSISTENT, NULL, NULL) != 0) {
+		/* the old uuidd closes the connection on unknown request */
+		cn->unsupported = 1;
+		close(cn->fd);
+		cn->fd = -1;
+		return -1;
+	}
+	cn->dev = st.st_dev;
+	cn->ino = st.st_ino;
+	cn->fork_id = get_fork_id();
+	cn->no_ring = 0;
+	return 0;
+}
+
+/*
+ * Returns 0 on success, 1 if the persistent connection is not usable, or -1
+ * if uuidd is not available.
+ */
+static int get_uuid_via_persistent(int op, uuid_t out, int *num)
+{
+	struct uuidd_conn *cn = &uuidd_conn;
+	int i, rc = 1;
+
+	if (cn->unsupported)
+		return 1;
+	if (__atomic_test_and_set(&cn->locked, __ATOMIC_ACQUIRE))
+		return 1;
+
+	if (cn->fd >= 0 && (cn->fork_id != get_fork_id() || !uuidd_conn_is_ours(cn)))
+		uuidd_conn_close(cn);
+
+	/* reconnect once, uuidd may be restarted */
+	for (i = 0; i < 2; i++) {
+		if (cn->fd < 0 && uuidd_conn_open(cn) != 0) {
+			rc = cn->unsupported ? 1 : -1;
+			break;
+		}
+		if (call_daemon(cn->fd, op, out, num) == 0) {
+			rc = 0;
+			break;
+		}
+		uuidd_conn_close(cn);
+		rc = -1;
+	}
+
+	__atomic_clear(&cn->locked, __ATOMIC_RELEASE);
+	return rc;
+}
+
+/*
+ * The shared ring (see uuidd.h) of the persistent connection. The ring is
+ * never unmapped, other threads may still claim the ranges from it. It's
+ * replaced (and the old memory is kept) only if uuidd has stopped updating
+ * it, after uuidd restart or when the connection has been closed.
+ */
+static struct uuidd_ring *uuidd_ring;
+
+/*
+ * Request the ring by the open connection @cn. Returns the mapped ring or
+ * NULL.
+ */
+static struct uuidd_ring *uuidd_conn_get_ring(struct uuidd_conn *cn)
+{
+	int32_t reply[2] = { 0, 0 };
+	char op = UUIDD_OP_RING;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct iovec iov = { .iov_base = reply, .iov_len = sizeof(reply) };
+	struct msghdr msg = {
+		.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = cbuf, .msg_controllen = sizeof(cbuf)
+	};
+	struct cmsghdr *cmsg;
+	struct uuidd_ring *ring = NULL;
+	struct stat st;
+	ssize_t ret;
+	int fd = -1;
+
+	if (send(cn->fd, &op, 1, MSG_NOSIGNAL) != 1)
+		goto fail;
+	do {
+		ret = recvmsg(cn->fd, &msg, MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+	if (ret <= 0)
+		goto fail;	/* the old uuidd closes the connection */
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+		    && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	if (ret < (ssize_t) sizeof(reply)
+	    && read_all(cn->fd, (char *) reply + ret, sizeof(reply) - ret)
+			!= (ssize_t) sizeof(reply) - ret)
+		goto fail;
+	if (reply[0] != sizeof(int32_t))
+		goto fail;
+
+	if (reply[1] == 1 && fd >= 0
+	    && fstat(fd, &st) == 0 && st.st_size == sizeof(struct uuidd_ring)) {
+		void *p = mmap(NULL, sizeof(struct uuidd_ring),
+			       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p != MAP_FAILED)
+			ring = p;
+	}
+	if (fd >= 0)
+		close(fd);
+	if (!ring)
+		cn->no_ring = 1;
+	return ring;
 fail:
+	if (fd >= 0)
+		close(fd);
+	uuidd_conn_close(cn);
+	cn->no_ring = 1;
+	return NULL;
+}
+
+/*
+ * Returns the new ring from uuidd, or NULL.
+ */
+static struct uuidd_ring *uuidd_request_ring(void)
+{
+	struct uuidd_conn *cn = &uuidd_conn;
+	struct uuidd_ring *ring = NULL;
+
+	if (cn->unsupported)
+		return NULL;
+	if (__atomic_test_and_set(&cn->locked, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	if (cn->fd >= 0 && (cn->fork_id != get_fork_id() || !uuidd_conn_is_ours(cn)))
+		uuidd_conn_close(cn);
+	if ((cn->fd >= 0 || uuidd_conn_open(cn) == 0) && !cn->no_ring) {
+		ring = uuidd_conn_get_ring(cn);
+		if (ring)
+			__atomic_store_n(&uuidd_ring, ring, __ATOMIC_RELEASE);
+	}
+
+	__atomic_clear(&cn->locked, __ATOMIC_RELEASE);
+	return ring;
+}
+
+/*
+ * Try using the uuidd daemon to generate the UUID
+ *
+ * Returns 0 on success, non-zero on failure.
+ */
+static int get_uuid_via_daemon(int op, uuid_t out, int *num)
+{
+	int s, rc;
+
+	rc = get_uuid_via_persistent(op, out, num);
+	if (rc <= 0)
+		return rc;
+
+	s = connect_daemon();
+	if (s < 0)
+		return -1;
+	rc = call_daemon(s, op, out, num);
 	close(s);
-	return -1;
+	return rc;
 }
 
 #else /* !defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H) */
@@ -472,13 +760,10 @@ static int get_uuid_via_daemon(int op __attribute__((__unused__)),
 }
 #endif
 
-static int __uuid_generate_time_internal(uuid_t out, int *num, uint32_t cont_offset)
+static void get_node(unsigned char *node)
 {
 	static unsigned char node_id[6];
 	static int has_init = 0;
-	struct uuid uu;
-	uint32_t	clock_mid;
-	int ret;
 
 	if (!has_init) {
 		if (get_node_id(node_id) <= 0) {
@@ -492,19 +777,37 @@ static int __uuid_generate_time_internal(uuid_t out, int *num, uint32_t cont_off
 		}
 		has_init = 1;
 	}
+	memcpy(node, node_id, 6);
+}
+
+static void pack_time_uuid(uuid_t out, uint32_t clock_high, uint32_t clock_low,
+			   uint16_t clock_seq)
+{
+	struct uuid uu;
+
+	uu.time_low = clock_low;
+	uu.time_mid = (uint16_t) clock_high;
+	uu.time_hi_and_version = ((clock_high >> 16) & 0x0FFF) | 0x1000;
+	uu.clock_seq = clock_seq | 0x8000;
+	get_node(uu.node);
+	uuid_pack(&uu, out);
+}
+
+static int __uuid_generate_time_internal(uuid_t out, int *num, uint32_t cont_offset)
+{
+	uint32_t	clock_mid, clock_low;
+	uint16_t	clock_seq;
+	int ret;
+
 	if (cont_offset) {
-		ret = get_clock_cont(&clock_mid, &uu.time_low, *num, cont_offset);
-		uu.clock_seq = CLOCK_SEQ_CONT;
+		ret = get_clock_cont(&clock_mid, &clock_low, *num, cont_offset);
+		clock_seq = CLOCK_SEQ_CONT;
 		if (ret != 0)	/* fallback to previous implpementation */
-			ret = get_clock(&clock_mid, &uu.time_low, &uu.clock_seq, num);
+			ret = get_clock(&clock_mid, &clock_low, &clock_seq, num);
 	} else {
-		ret = get_clock(&clock_mid, &uu.time_low, &uu.clock_seq, num);
+		ret = get_clock(&clock_mid, &clock_low, &clock_seq, num);
 	}
-	uu.clock_seq |= 0x8000;
-	uu.time_mid = (uint16_t) clock_mid;
-	uu.time_hi_and_version = ((clock_mid >> 16) & 0x0FFF) | 0x1000;
-	memcpy(uu.node, node_id, 6);
-	uuid_pack(&uu, out);
+	pack_time_uuid(out, clock_mid, clock_low, clock_seq);
 	return ret;
 }
 
@@ -518,11 +821,230 @@ int __uuid_generate_time_cont(uuid_t out, int *num, uint32_t cont_offset)
 	return __uuid_generate_time_internal(out, num, cont_offset);
 }
 
+/*
+ * In-process range of the clock values. The range is reserved by one
+ * get_clock() call (the clock file is locked and updated only once for the
+ * whole range) and the values are shared by all threads; the fast path is an
+ * atomic increment. The range is replaced by a new one after it's used, after
+ * UUID_TIME_RANGE_EXPIRE seconds (the timestamps should not be too old) or
+ * after fork(). The seqno is odd when the range is being replaced.
+ *
+ * The 64-bit atomic operations have to be supported by the CPU, otherwise
+ * every UUID is generated by get_clock().
+ */
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+# define HAVE_UUID_TIME_RANGE 1
+#endif
+
+#ifdef HAVE_UUID_TIME_RANGE
+#define UUID_TIME_RANGE_SIZE	(1 << 14)	/* 100ns ticks */
+#define UUID_TIME_RANGE_EXPIRE	1		/* seconds */
+
+struct uuid_time_range {
+	uint64_t	next;		/* next clock value */
+	uint64_t	end;		/* the first unreserved value */
+	int64_t		expire;		/* time() */
+	unsigned int	seqno;
+	int		ret;		/* get_clock() return code */
+	fork_id_t	fork_id;
+	uint16_t	clock_seq;
+	char		locked;
+};
+
+static struct uuid_time_range time_range;
+
+static int time_range_is_valid(struct uuid_time_range *tr)
+{
+	return __atomic_load_n(&tr->fork_id, __ATOMIC_SEQ_CST) == get_fork_id()
+	       && __atomic_load_n(&tr->expire, __ATOMIC_SEQ_CST) >= time(NULL)
+	       && __atomic_load_n(&tr->next, __ATOMIC_SEQ_CST)
+			< __atomic_load_n(&tr->end, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Generate UUID from the current range. Returns 0 on success, or -1 if the
+ * range is not usable.
+ */
+static int time_range_uuid(uuid_t out, int *ret)
+{
+	struct uuid_time_range *tr = &time_range;
+	unsigned int seqno;
+	uint64_t clock_reg, end;
+	uint16_t clock_seq;
+
+	seqno = __atomic_load_n(&tr->seqno, __ATOMIC_SEQ_CST);
+	if ((seqno & 1) || !time_range_is_valid(tr))
+		return -1;
+
+	end = __atomic_load_n(&tr->end, __ATOMIC_SEQ_CST);
+	clock_seq = __atomic_load_n(&tr->clock_seq, __ATOMIC_SEQ_CST);
+	*ret = __atomic_load_n(&tr->ret, __ATOMIC_SEQ_CST);
+
+	clock_reg = __atomic_fetch_add(&tr->next, 1, __ATOMIC_SEQ_CST);
+
+	/* the range has been replaced in the meantime */
+	if (__atomic_load_n(&tr->seqno, __ATOMIC_SEQ_CST) != seqno
+	    || clock_reg >= end)
+		return -1;
+
+	pack_time_uuid(out, clock_reg >> 32, (uint32_t) clock_reg, clock_seq);
+	return 0;
+}
+
+/*
+ * Reserve a new range. Returns 0 if the range is usable, or -1 if another
+ * thread is just reserving it.
+ */
+static int time_range_refill(void)
+{
+	struct uuid_time_range *tr = &time_range;
+	uint32_t clock_high, clock_low;
+	uint16_t clock_seq;
+	int num = UUID_TIME_RANGE_SIZE, ret;
+	uint64_t clock_reg;
+
+	if (__atomic_test_and_set(&tr->locked, __ATOMIC_ACQUIRE))
+		return -1;
+
+	/* another thread has been faster */
+	if (time_range_is_valid(tr))
+		goto done;
+
+	ret = get_clock(&clock_high, &clock_low, &clock_seq, &num);
+	clock_reg = ((uint64_t) clock_high << 32) | clock_low;
+
+	__atomic_fetch_add(&tr->seqno, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&tr->next, clock_reg, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&tr->end, clock_reg + UUID_TIME_RANGE_SIZE, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&tr->expire, (int64_t) time(NULL) + UUID_TIME_RANGE_EXPIRE, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&tr->ret, ret, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&tr->fork_id, get_fork_id(), __ATOMIC_SEQ_CST);
+	__atomic_store_n(&tr->clock_seq, clock_seq, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&tr->seqno, 1, __ATOMIC_SEQ_CST);
+done:
+	__atomic_clear(&tr->locked, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*
+ * Generate time-based UUID from the in-process range. Falls back to
+ * get_clock() for the single UUID if the range is being replaced by another
+ * thread.
+ */
+static int uuid_generate_time_inprocess(uuid_t out)
+{
+	int ret;
+
+	if (time_range_uuid(out, &ret) == 0)
+		return ret;
+	if (time_range_refill() == 0 && time_range_uuid(out, &ret) == 0)
+		return ret;
+
+	return __uuid_generate_time(out, NULL);
+}
+#else /* !HAVE_UUID_TIME_RANGE */
+static int time_range_uuid(uuid_t out __attribute__((__unused__)),
+			   int *ret __attribute__((__unused__)))
+{
+	return -1;
+}
+
+static int uuid_generate_time_inprocess(uuid_t out)
+{
+	return __uuid_generate_time(out, NULL);
+}
+#endif /* HAVE_UUID_TIME_RANGE */
+
+#if defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H) && defined(HAVE_UUID_TIME_RANGE)
+/*
+ * Returns the ring from uuidd (see uuidd_request_ring()), or NULL.
+ */
+static time_t uuidd_ring_tried;
+static unsigned int uuidd_ring_next;
+
+static struct uuidd_ring *get_uuidd_ring(void)
+{
+	struct uuidd_ring *ring = __atomic_load_n(&uuidd_ring, __ATOMIC_ACQUIRE);
+	time_t now = time(NULL);
+
+	if (ring && __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) == UUIDD_RING_MAGIC
+	    && __atomic_load_n(&ring->heartbeat, __ATOMIC_RELAXED) + UUIDD_RING_STALE >= now)
+		return ring;
+
+	/* try it once per second, the ring is optional */
+	if (__atomic_load_n(&uuidd_ring_tried, __ATOMIC_RELAXED) == now)
+		return NULL;
+	__atomic_store_n(&uuidd_ring_tried, now, __ATOMIC_RELAXED);
+
+	return uuidd_request_ring();
+}
+
+/*
+ * Claim a range from the uuidd ring. Returns 0 on success (the first UUID is
+ * in @out and the size of the range in @num), or -1.
+ */
+static int get_uuid_via_ring(uuid_t out, int *num)
+{
+	struct uuidd_ring *ring = get_uuidd_ring();
+	unsigned int start, i;
+	time_t now;
+
+	if (!ring)
+		return -1;
+
+	now = time(NULL);
+	if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != UUIDD_RING_MAGIC
+	    || ring->version != UUIDD_RING_VERSION
+	    || ring->nslots != UUIDD_RING_SLOTS
+	    || __atomic_load_n(&ring->heartbeat, __ATOMIC_RELAXED) + UUIDD_RING_STALE < now)
+		return -1;
+
+	/* spread the threads over the ring */
+	start = __atomic_fetch_add(&uuidd_ring_next, 1, __ATOMIC_RELAXED);
+
+	for (i = 0; i < UUIDD_RING_SLOTS; i++) {
+		struct uuidd_ring_slot *sl = &ring->slots[(start + i) % UUIDD_RING_SLOTS];
+		uint64_t seq, uu[2];
+		int64_t expire;
+		int32_t n;
+
+		seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;	/* claimed, not refilled yet */
+
+		expire = __atomic_load_n(&sl->expire, __ATOMIC_RELAXED);
+		n = __atomic_load_n(&sl->num, __ATOMIC_RELAXED);
+		uu[0] = __atomic_load_n(&sl->uuid[0], __ATOMIC_RELAXED);
+		uu[1] = __atomic_load_n(&sl->uuid[1], __ATOMIC_RELAXED);
+
+		if (expire < now || n < 1 || n > UUIDD_RING_RANGE)
+			continue;
+
+		/* the data are valid if nobody has claimed the slot in the meantime */
+		if (!__atomic_compare_exchange_n(&sl->seq, &seq, seq + 1, 0,
+						 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			continue;
+
+		memcpy(out, uu, sizeof(uuid_t));
+		*num = n;
+		return 0;
+	}
+	return -1;
+}
+#else
+static int get_uuid_via_ring(uuid_t out __attribute__((__unused__)),
+			     int *num __attribute__((__unused__)))
+{
+	return -1;
+}
+#endif /* HAVE_UUIDD && HAVE_SYS_UN_H && HAVE_UUID_TIME_RANGE */
+
 /*
  * Generate time-based UUID and store it to @out
  *
  * Tries to guarantee uniqueness of the generated UUIDs by obtaining them from the uuidd daemon,
- * or, if uuidd is not usable, by using the global clock state counter (see get_clock()).
+ * or, if uuidd is not usable, by using the global clock state counter (see get_clock() and
+ * the in-process range above).
  * If neither of these is possible (e.g. because of insufficient permissions), it generates
  * the UUID anyway, but returns -1. Otherwise, returns 0.
  */
@@ -538,6 +1060,7 @@ static int uuid_generate_time_generic(uuid_t out) {
 	THREAD_LOCAL struct uuid	uu;
 	THREAD_LOCAL time_t		last_time = 0;
 	time_t				now;
+	int				ret;
 
 	if (num > 0) { /* expire cache */
 		now = time(NULL);
@@ -546,6 +1069,10 @@ static int uuid_generate_time_generic(uuid_t out) {
 			num = 0;
 		}
 	}
+	/* uuidd has not been available, use the in-process range */
+	if (num <= 0 && time_range_uuid(out, &ret) == 0)
+		return ret;
+
 	if (num <= 0) { /* fill cache */
 		/*
 		 * num + OP_BULK provides a local cache in each application.
@@ -557,6 +1084,14 @@ static int uuid_generate_time_generic(uuid_t out) {
 		else if ((last_used < (cache_size / cs_factor)) && (cache_size > cs_min))
 			cache_size /= cs_factor;
 
+		/* the range from the uuidd ring, without a request */
+		if (get_uuid_via_ring(out, &num) == 0) {
+			last_time = time(NULL);
+			uuid_unpack(out, &uu);
+			cache_size = num--;
+			return 0;
+		}
+
 		num = cache_size;
 
 		if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
@@ -588,7 +1123,7 @@ static int uuid_generate_time_generic(uuid_t out) {
 		return 0;
 #endif
 
-	return __uuid_generate_time(out, NULL);
+	return uuid_generate_time_inprocess(out);
 }
 
 /*
@@ -608,32 +1143,60 @@ int uuid_generate_time_safe(uuid_t out)
 }
 
 
-int __uuid_generate_random(uuid_t out, int *num)
+static void set_random_version(unsigned char *out)
 {
-	uuid_t	buf;
 	struct uuid uu;
-	int i, n, r = 0;
+
+	uuid_unpack(out, &uu);
+
+	uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
+	uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
+		| 0x4000;
+	uuid_pack(&uu, out);
+}
+
+int __uuid_generate_random(uuid_t out, int *num)
+{
+	int i, n, r;
 
 	if (!num || !*num)
 		n = 1;
 	else
 		n = *num;
 
-	for (i = 0; i < n; i++) {
-		if (ul_random_get_bytes(buf, sizeof(buf)))
-			r = -1;
-		uuid_unpack(buf, &uu);
+	r = ul_random_pool_get_bytes(out, n * sizeof(uuid_t)) ? -1 : 0;
 
-		uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-		uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
-			| 0x4000;
-		uuid_pack(&uu, out);
+	for (i = 0; i < n; i++) {
+		set_random_version(out);
 		out += sizeof(uuid_t);
 	}
 
 	return r;
 }
 
+/*
+ * Generate @n random UUIDs to @out array. It's faster than @n
+ * uuid_generate_random() calls. Returns 0, or -1 if high-quality randomness
+ * has not been available.
+ */
+int uuid_generate_random_bulk(uuid_t *out, size_t n)
+{
+	size_t i;
+	int r;
+
+	if (!out || !n)
+		return 0;
+	if (n > SIZE_MAX / sizeof(uuid_t))
+		return -1;
+
+	r = ul_random_pool_get_bytes(out, n * sizeof(uuid_t)) ? -1 : 0;
+
+	for (i = 0; i < n; i++)
+		set_random_version(out[i]);
+
+	return r;
+}
+
 void uuid_generate_random(uuid_t out)
 {
 	int	num = 1;
@@ -655,6 +1218,93 @@ void uuid_generate(uuid_t out)
 		uuid_generate_time(out);
 }
 
+/*
+ * Generate time-based UUID version 6; it's version 1 UUID with the timestamp
+ * in big-endian order, so the UUIDs are sortable by time.
+ */
+void uuid_generate_time_v6(uuid_t out)
+{
+	struct uuid uu;
+	uint64_t clock_reg;
+
+	uuid_generate_time(out);
+	uuid_unpack(out, &uu);
+
+	clock_reg = ((uint64_t) (uu.time_hi_and_version & 0x0FFF) << 48)
+		    | ((uint64_t) uu.time_mid << 32)
+		    | uu.time_low;
+
+	uu.time_low = clock_reg >> 28;
+	uu.time_mid = (clock_reg >> 12) & 0xFFFF;
+	uu.time_hi_and_version = (clock_reg & 0x0FFF) | 0x6000;
+	uuid_pack(&uu, out);
+}
+
+/*
+ * UUID version 7 is 48-bit Unix time in milliseconds, 74 bits of the
+ * randomness and the version and variant bits. The first 30 random bits are
+ * used as a per-thread counter (the RFC 9562 "fixed bit-length dedicated
+ * counter" method), so the UUIDs generated by the thread are strictly
+ * ordered also within the same millisecond. The counter starts at a random
+ * value (with the most significant bit zero) in every millisecond. The time
+ * never goes back and is moved forward if the counter overflows.
+ */
+#define UUID_V7_COUNTER_BITS	30
+#define UUID_V7_COUNTER_MAX	((1U << UUID_V7_COUNTER_BITS) - 1)
+
+static uint32_t uuid_v7_counter_seed(void)
+{
+	uint32_t seed;
+
+	ul_random_pool_get_bytes(&seed, sizeof(seed));
+	return seed & (UUID_V7_COUNTER_MAX >> 1);
+}
+
+void uuid_generate_time_v7(uuid_t out)
+{
+	THREAD_LOCAL uint64_t	last_ms;
+	THREAD_LOCAL uint32_t	counter;
+	struct timeval		tv;
+	uint64_t		ms;
+	int			i;
+
+	gettimeofday(&tv, NULL);
+	ms = (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+	if (ms > last_ms) {
+		last_ms = ms;
+		counter = uuid_v7_counter_seed();
+	} else if (++counter > UUID_V7_COUNTER_MAX) {
+		last_ms++;
+		counter = uuid_v7_counter_seed();
+	}
+
+	ul_random_pool_get_bytes(out + 10, 6);
+
+	for (i = 5; i >= 0; i--)
+		out[5 - i] = (last_ms >> (i * 8)) & 0xFF;
+
+	out[6] = 0x70 | ((counter >> 26) & 0x0F);
+	out[7] = (counter >> 18) & 0xFF;
+	out[8] = 0x80 | ((counter >> 12) & 0x3F);
+	out[9] = (counter >> 4) & 0xFF;
+	out[10] = ((counter & 0x0F) << 4) | (out[10] & 0x0F);
+}
+
+/* sets the variant and @version bits of the name-based UUID from @hash */
+static void uuid_from_hash(uuid_t out, const unsigned char *hash, int version)
+{
+	uuid_t buf;
+	struct uuid uu;
+
+	memcpy(buf, hash, sizeof(buf));
+	uuid_unpack(buf, &uu);
+
+	uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
+	uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF) | (version << 12);
+	uuid_pack(&uu, out);
+}
+
 /*
  * Generate an MD5 hashed (predictable) UUID based on a well-known UUID
  * providing the namespace and an arbitrary binary string.
@@ -662,23 +1312,41 @@ void uuid_generate(uuid_t out)
 void uuid_generate_md5(uuid_t out, const uuid_t ns, const char *name, size_t len)
 {
 	UL_MD5_CTX ctx;
-	char hash[UL_MD5LENGTH];
-	uuid_t buf;
-	struct uuid uu;
+	unsigned char hash[UL_MD5LENGTH];
+
+	assert(sizeof(uuid_t) <= sizeof(hash));
 
 	ul_MD5Init(&ctx);
 	ul_MD5Update(&ctx, ns, sizeof(uuid_t));
 	ul_MD5Update(&ctx, (const unsigned char *)name, len);
-	ul_MD5Final((unsigned char *)hash, &ctx);
+	ul_MD5Final(hash, &ctx);
 
-	assert(sizeof(buf) <= sizeof(hash));
+	uuid_from_hash(out, hash, UUID_TYPE_DCE_MD5);
+}
 
-	memcpy(buf, hash, sizeof(buf));
-	uuid_unpack(buf, &uu);
+/*
+ * Generate MD5 hashed UUIDs for @n names in the same namespace. The context
+ * with the hashed namespace is prepared only once and copied for every name.
+ * If @lens is NULL, the names are NUL terminated strings.
+ */
+void uuid_generate_md5_many(uuid_t *out, const uuid_t ns,
+			    const char * const *names, const size_t *lens, size_t n)
+{
+	UL_MD5_CTX base;
+	unsigned char hash[UL_MD5LENGTH];
+	size_t i;
 
-	uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-	uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF) | 0x3000;
-	uuid_pack(&uu, out);
+	ul_MD5Init(&base);
+	ul_MD5Update(&base, ns, sizeof(uuid_t));
+
+	for (i = 0; i < n; i++) {
+		UL_MD5_CTX ctx = base;
+		size_t len = lens ? lens[i] : strlen(names[i]);
+
+		ul_MD5Update(&ctx, (const unsigned char *) names[i], len);
+		ul_MD5Final(hash, &ctx);
+		uuid_from_hash(out[i], hash, UUID_TYPE_DCE_MD5);
+	}
 }
 
 /*
@@ -688,21 +1356,38 @@ void uuid_generate_md5(uuid_t out, const uuid_t ns, const char *name, size_t len
 void uuid_generate_sha1(uuid_t out, const uuid_t ns, const char *name, size_t len)
 {
 	UL_SHA1_CTX ctx;
-	char hash[UL_SHA1LENGTH];
-	uuid_t buf;
-	struct uuid uu;
+	unsigned char hash[UL_SHA1LENGTH];
+
+	assert(sizeof(uuid_t) <= sizeof(hash));
 
 	ul_SHA1Init(&ctx);
 	ul_SHA1Update(&ctx, ns, sizeof(uuid_t));
 	ul_SHA1Update(&ctx, (const unsigned char *)name, len);
-	ul_SHA1Final((unsigned char *)hash, &ctx);
+	ul_SHA1Final(hash, &ctx);
 
-	assert(sizeof(buf) <= sizeof(hash));
+	uuid_from_hash(out, hash, UUID_TYPE_DCE_SHA1);
+}
 
-	memcpy(buf, hash, sizeof(buf));
-	uuid_unpack(buf, &uu);
+/*
+ * Generate SHA1 hashed UUIDs for @n names in the same namespace, see
+ * uuid_generate_md5_many().
+ */
+void uuid_generate_sha1_many(uuid_t *out, const uuid_t ns,
+			     const char * const *names, const size_t *lens, size_t n)
+{
+	UL_SHA1_CTX base;
+	unsigned char hash[UL_SHA1LENGTH];
+	size_t i;
 
-	uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-	uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF) | 0x5000;
-	uuid_pack(&uu, out);
+	ul_SHA1Init(&base);
+	ul_SHA1Update(&base, ns, sizeof(uuid_t));
+
+	for (i = 0; i < n; i++) {
+		UL_SHA1_CTX ctx = base;
+		size_t len = lens ? lens[i] : strlen(names[i]);
+
+		ul_SHA1Update(&ctx, (const unsigned char *) names[i], len);
+		ul_SHA1Final(hash, &ctx);
+		uuid_from_hash(out[i], hash, UUID_TYPE_DCE_SHA1);
+	}
 }
@@ -34,12 +34,113 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 
 #include "c.h"
 #include "uuidP.h"
 
+/*
+ * The 32 hex digits are decoded at once by SSE2 (always available on x86_64)
+ * or NEON (aarch64), the portable version decodes them one by one.
+ */
+#if defined(__GNUC__) && defined(__SSE2__)
+# define HAVE_UUID_PARSE_SSE2 1
+# include <emmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+# define HAVE_UUID_PARSE_NEON 1
+# include <arm_neon.h>
+#endif
+
+#ifdef HAVE_UUID_PARSE_SSE2
+/* decode 16 hex digits to nibbles, returns -1 on invalid digit */
+static inline int hex16_sse2(__m128i c, __m128i *val)
+{
+	__m128i l = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	/* the signed compare is fine, non-ASCII bytes are negative */
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+				      _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)),
+				      _mm_cmplt_epi8(l, _mm_set1_epi8('f' + 1)));
+
+	if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff)
+		return -1;
+
+	*val = _mm_or_si128(
+		_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+		_mm_and_si128(alpha, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
+	return 0;
+}
+
+static int parse_hex32(const char *hex, unsigned char *out)
+{
+	__m128i a, b, lo = _mm_set1_epi16(0x00ff);
+
+	if (hex16_sse2(_mm_loadu_si128((const __m128i *) hex), &a) ||
+	    hex16_sse2(_mm_loadu_si128((const __m128i *) (hex + 16)), &b))
+		return -1;
+
+	/* the nibble pairs (high nibble first) to bytes */
+	a = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(a, lo), 4), _mm_srli_epi16(a, 8));
+	b = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(b, lo), 4), _mm_srli_epi16(b, 8));
+	_mm_storeu_si128((__m128i *) out, _mm_packus_epi16(a, b));
+	return 0;
+}
+
+#elif defined(HAVE_UUID_PARSE_NEON)
+/* decode 16 hex digits to nibbles, @ok is cleared for invalid digits */
+static inline uint8x16_t hex16_neon(uint8x16_t c, uint8x16_t *ok)
+{
+	/* c - '0' < 10 for digits, (c | 0x20) - 'a' < 6 for letters */
+	uint8x16_t d = vsubq_u8(c, vdupq_n_u8('0'));
+	uint8x16_t a = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+	uint8x16_t is_digit = vcltq_u8(d, vdupq_n_u8(10));
+
+	*ok = vandq_u8(*ok, vorrq_u8(is_digit, vcltq_u8(a, vdupq_n_u8(6))));
+	return vbslq_u8(is_digit, d, vaddq_u8(a, vdupq_n_u8(10)));
+}
+
+static int parse_hex32(const char *hex, unsigned char *out)
+{
+	uint8x16x2_t c = vld2q_u8((const uint8_t *) hex);	/* even and odd digits */
+	uint8x16_t ok = vdupq_n_u8(0xff), hi, lo;
+
+	hi = hex16_neon(c.val[0], &ok);
+	lo = hex16_neon(c.val[1], &ok);
+	if (vminvq_u8(ok) != 0xff)
+		return -1;
+
+	vst1q_u8(out, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+	return 0;
+}
+
+#else
+static inline int hexval(unsigned char c)
+{
+	if ((unsigned char) (c - '0') < 10)
+		return c - '0';
+	c |= 0x20;
+	if ((unsigned char) (c - 'a') < 6)
+		return c - 'a' + 10;
+	return -1;
+}
+
+static int parse_hex32(const char *hex, unsigned char *out)
+{
+	unsigned char buf[16];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		int hi = hexval(hex[2 * i]), lo = hexval(hex[2 * i + 1]);
+
+		if (hi < 0 || lo < 0)
+			return -1;
+		buf[i] = (hi << 4) | lo;
+	}
+	memcpy(out, buf, sizeof(buf));
+	return 0;
+}
+#endif
+
 int uuid_parse(const char *in, uuid_t uu)
 {
 	size_t len = strlen(in);
@@ -51,50 +152,33 @@ int uuid_parse(const char *in, uuid_t uu)
 
 int uuid_parse_range(const char *in_start, const char *in_end, uuid_t uu)
 {
-	struct uuid	uuid;
-	int		i;
-	const char	*cp;
-	char		buf[3];
+	const char *cp = in_start;
+	char hex[32];
 
 	if ((in_end - in_start) != 36)
 		return -1;
-	for (i=0, cp = in_start; i <= 36; i++,cp++) {
-		if ((i == 8) || (i == 13) || (i == 18) ||
-		    (i == 23)) {
-			if (*cp == '-')
-				continue;
-			return -1;
-		}
-		if (i== 36)
-			if (*cp == 0)
-				continue;
-		if (!isxdigit(*cp))
-			return -1;
-	}
-	errno = 0;
-	uuid.time_low = strtoul(in_start, NULL, 16);
-
-	if (!errno)
-		uuid.time_mid = strtoul(in_start+9, NULL, 16);
-	if (!errno)
-		uuid.time_hi_and_version = strtoul(in_start+14, NULL, 16);
-	if (!errno)
-		uuid.clock_seq = strtoul(in_start+19, NULL, 16);
-	if (errno)
+	if (cp[8] != '-' || cp[13] != '-' || cp[18] != '-' || cp[23] != '-')
 		return -1;
 
-	cp = in_start+24;
-	buf[2] = 0;
-	for (i=0; i < 6; i++) {
-		buf[0] = *cp++;
-		buf[1] = *cp++;
+	/* the hex digits without the dashes */
+	memcpy(hex, cp, 8);
+	memcpy(hex + 8, cp + 9, 4);
+	memcpy(hex + 12, cp + 14, 4);
+	memcpy(hex + 16, cp + 19, 4);
+	memcpy(hex + 20, cp + 24, 12);
 
-		errno = 0;
-		uuid.node[i] = strtoul(buf, NULL, 16);
-		if (errno)
-			return -1;
-	}
+	return parse_hex32(hex, uu);
+}
 
-	uuid_pack(&uuid, uu);
-	return 0;
+size_t uuid_parse_many(const char * const *in, uuid_t *out, size_t n)
+{
+	size_t i, nerrs = 0;
+
+	for (i = 0; i < n; i++) {
+		if (uuid_parse(in[i], out[i]) != 0) {
+			uuid_clear(out[i]);
+			nerrs++;
+		}
+	}
+	return nerrs;
 }
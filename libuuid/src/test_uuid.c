@@ -64,6 +64,70 @@ static int test_uuid(const char * uuid, int isValid)
 	return 0;
 }
 
+/* parse and format the UUIDs by the batch functions */
+static int test_uuid_many(void)
+{
+	static const char *strs[] = {
+		"84949cc5-4701-4a84-895b-354c584a981b",
+		"01234567-89ab-cdef-0134-567890abcedf",
+		"84949cc5-4701-4a84-895b-354c584a981g",
+		"ffffffff-ffff-ffff-ffff-ffffffffffff"
+	};
+	uuid_t uus[ARRAY_SIZE(strs)];
+	char out[ARRAY_SIZE(strs)][UUID_STR_LEN];
+	size_t i, nerrs;
+	int failed = 0;
+
+	nerrs = uuid_parse_many(strs, uus, ARRAY_SIZE(strs));
+	uuid_unparse_many((const uuid_t *) uus, (char *) out, ARRAY_SIZE(strs));
+
+	printf("uuid_parse_many: %zu invalid\n", nerrs);
+	for (i = 0; i < ARRAY_SIZE(strs); i++) {
+		int ok = i == 2 ? uuid_is_null(uus[i]) : strcmp(strs[i], out[i]) == 0;
+
+		printf("%s -> %s, %s\n", strs[i], out[i], ok ? "OK" : "FAILED");
+		failed += !ok;
+	}
+	return failed + (nerrs != 1);
+}
+
+/* the batch hash functions have to return the same as the single ones */
+static int test_uuid_hash_many(void)
+{
+	static const char *names[] = {
+		"www.example.com",
+		"",
+		"a name longer than one hash block, so the name does not fit into "
+		"the first block together with the namespace",
+		"util-linux"
+	};
+	const uuid_t *ns = uuid_get_template("dns");
+	uuid_t md5[ARRAY_SIZE(names)], sha1[ARRAY_SIZE(names)], uu;
+	char str[UUID_STR_LEN];
+	size_t i;
+	int failed = 0;
+
+	uuid_generate_md5_many(md5, *ns, names, NULL, ARRAY_SIZE(names));
+	uuid_generate_sha1_many(sha1, *ns, names, NULL, ARRAY_SIZE(names));
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		int ok;
+
+		uuid_generate_md5(uu, *ns, names[i], strlen(names[i]));
+		ok = uuid_compare(uu, md5[i]) == 0;
+		uuid_unparse(md5[i], str);
+		printf("md5 %s, %s\n", str, ok ? "OK" : "FAILED");
+		failed += !ok;
+
+		uuid_generate_sha1(uu, *ns, names[i], strlen(names[i]));
+		ok = uuid_compare(uu, sha1[i]) == 0;
+		uuid_unparse(sha1[i], str);
+		printf("sha1 %s, %s\n", str, ok ? "OK" : "FAILED");
+		failed += !ok;
+	}
+	return failed;
+}
+
 static int check_uuids_in_file(const char *file)
 {
 	int fd, ret = 0;
@@ -107,6 +171,13 @@ main(int argc, char **argv)
 		failed += test_uuid("00000000-0000-0000-0000-000000000000", 1);
 		failed += test_uuid("01234567-89ab-cdef-0134-567890abcedf", 1);
 		failed += test_uuid("ffffffff-ffff-ffff-ffff-ffffffffffff", 1);
+		failed += test_uuid("/4949cc5-4701-4a84-895b-354c584a981b", 0);
+		failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981:", 0);
+		failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981@", 0);
+		failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981`", 0);
+		failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981G", 0);
+		failed += test_uuid_many();
+		failed += test_uuid_hash_many();
 	} else {
 		int i;
 
@@ -33,26 +33,88 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "uuidP.h"
 
+/*
+ * The hex digits are formatted at once by SSE2 (always available on x86_64)
+ * or NEON (aarch64), see also parse.c.
+ */
+#if defined(__GNUC__) && defined(__SSE2__)
+# define HAVE_UUID_UNPARSE_SSE2 1
+# include <emmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+# define HAVE_UUID_UNPARSE_NEON 1
+# include <arm_neon.h>
+#endif
+
 static char const hexdigits_lower[16] = "0123456789abcdef";
 static char const hexdigits_upper[16] = "0123456789ABCDEF";
 
-static void uuid_fmt(const uuid_t uuid, char *buf, char const *restrict fmt)
+#ifdef HAVE_UUID_UNPARSE_SSE2
+/* nibbles to hex digits */
+static inline __m128i hex16_sse2(__m128i n, __m128i alpha)
+{
+	__m128i over = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')),
+			    _mm_and_si128(over, alpha));
+}
+
+static void fmt_hex32(const uuid_t uuid, char *hex, char const *fmt)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *) uuid);
+	__m128i mask = _mm_set1_epi8(0x0f);
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+	__m128i lo = _mm_and_si128(v, mask);
+	/* distance between '9' + 1 and 'a' (or 'A') */
+	__m128i alpha = _mm_set1_epi8(fmt[10] - '0' - 10);
+
+	_mm_storeu_si128((__m128i *) hex, hex16_sse2(_mm_unpacklo_epi8(hi, lo), alpha));
+	_mm_storeu_si128((__m128i *) (hex + 16), hex16_sse2(_mm_unpackhi_epi8(hi, lo), alpha));
+}
+
+#elif defined(HAVE_UUID_UNPARSE_NEON)
+static void fmt_hex32(const uuid_t uuid, char *hex, char const *fmt)
+{
+	uint8x16_t v = vld1q_u8(uuid);
+	uint8x16_t tbl = vld1q_u8((const uint8_t *) fmt);
+	uint8x16x2_t out;
+
+	out.val[0] = vqtbl1q_u8(tbl, vshrq_n_u8(v, 4));
+	out.val[1] = vqtbl1q_u8(tbl, vandq_u8(v, vdupq_n_u8(0x0f)));
+	vst2q_u8((uint8_t *) hex, out);		/* interleave */
+}
+
+#else
+static void fmt_hex32(const uuid_t uuid, char *hex, char const *fmt)
 {
-	char *p = buf;
 	int i;
 
 	for (i = 0; i < 16; i++) {
-		if (i == 4 || i == 6 || i == 8 || i == 10) {
-			*p++ = '-';
-		}
-		size_t tmp = uuid[i];
-		*p++ = fmt[tmp >> 4];
-		*p++ = fmt[tmp & 15];
+		*hex++ = fmt[uuid[i] >> 4];
+		*hex++ = fmt[uuid[i] & 15];
 	}
-	*p = '\0';
+}
+#endif
+
+static void uuid_fmt(const uuid_t uuid, char *buf, char const *restrict fmt)
+{
+	char hex[32];
+
+	fmt_hex32(uuid, hex, fmt);
+
+	memcpy(buf, hex, 8);
+	buf[8] = '-';
+	memcpy(buf + 9, hex + 8, 4);
+	buf[13] = '-';
+	memcpy(buf + 14, hex + 12, 4);
+	buf[18] = '-';
+	memcpy(buf + 19, hex + 16, 4);
+	buf[23] = '-';
+	memcpy(buf + 24, hex + 20, 12);
+	buf[36] = '\0';
 }
 
 void uuid_unparse_lower(const uuid_t uu, char *out)
@@ -73,3 +135,11 @@ void uuid_unparse(const uuid_t uu, char *out)
 	uuid_fmt(uu, out, hexdigits_lower);
 #endif
 }
+
+void uuid_unparse_many(const uuid_t *uu, char *out, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++, out += UUID_STR_LEN)
+		uuid_unparse(uu[i], out);
+}
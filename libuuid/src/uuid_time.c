@@ -53,21 +53,73 @@
 
 #include "uuidP.h"
 
+/* Gregorian calendar (1582-10-15) based 100ns ticks to timeval */
+static void gregorian_to_unix(uint64_t clock_reg, struct timeval *tv)
+{
+	int64_t ticks = (int64_t) (clock_reg - ((((uint64_t) 0x01B21DD2) << 32) + 0x13814000));
+
+	tv->tv_sec = ticks / 10000000;
+	tv->tv_usec = (ticks % 10000000) / 10;
+	if (tv->tv_usec < 0) {
+		/* before 1970 */
+		tv->tv_sec--;
+		tv->tv_usec += 1000000;
+	}
+}
+
+static void uuid_time_v1(const struct uuid *uuid, struct timeval *tv)
+{
+	uint32_t		high;
+	uint64_t		clock_reg;
+
+	high = uuid->time_mid | ((uuid->time_hi_and_version & 0xFFF) << 16);
+	clock_reg = uuid->time_low | ((uint64_t) high << 32);
+
+	gregorian_to_unix(clock_reg, tv);
+}
+
+static void uuid_time_v6(const struct uuid *uuid, struct timeval *tv)
+{
+	uint64_t		clock_reg;
+
+	clock_reg = ((uint64_t) uuid->time_low << 28)
+		    | ((uint64_t) uuid->time_mid << 12)
+		    | (uuid->time_hi_and_version & 0xFFF);
+
+	gregorian_to_unix(clock_reg, tv);
+}
+
+static void uuid_time_v7(const uuid_t uu, struct timeval *tv)
+{
+	uint64_t		ms = 0;
+	size_t			i;
+
+	/* big-endian Unix time in milliseconds */
+	for (i = 0; i < 6; i++)
+		ms = (ms << 8) | uu[i];
+
+	tv->tv_sec = ms / 1000;
+	tv->tv_usec = (ms % 1000) * 1000;
+}
+
 time_t uuid_time(const uuid_t uu, struct timeval *ret_tv)
 {
 	struct timeval		tv;
 	struct uuid		uuid;
-	uint32_t		high;
-	uint64_t		clock_reg;
 
 	uuid_unpack(uu, &uuid);
 
-	high = uuid.time_mid | ((uuid.time_hi_and_version & 0xFFF) << 16);
-	clock_reg = uuid.time_low | ((uint64_t) high << 32);
-
-	clock_reg -= (((uint64_t) 0x01B21DD2) << 32) + 0x13814000;
-	tv.tv_sec = clock_reg / 10000000;
-	tv.tv_usec = (clock_reg % 10000000) / 10;
+	switch (uuid.time_hi_and_version >> 12) {
+	case UUID_TYPE_DCE_TIME_V6:
+		uuid_time_v6(&uuid, &tv);
+		break;
+	case UUID_TYPE_DCE_TIME_V7:
+		uuid_time_v7(uu, &tv);
+		break;
+	default:
+		uuid_time_v1(&uuid, &tv);
+		break;
+	}
 
 	if (ret_tv)
 		*ret_tv = tv;
@@ -156,10 +208,16 @@ main(int argc, char **argv)
 	case 4:
 		printf(" (random)\n");
 		break;
+	case 6:
+		printf(" (time based, v6)\n");
+		break;
+	case 7:
+		printf(" (Unix time based, v7)\n");
+		break;
 	default:
 		printf("\n");
 	}
-	if (type != 1) {
+	if (type != 1 && type != 6 && type != 7) {
 		printf("Warning: not a time-based UUID, so UUID time "
 		       "decoding will likely not work!\n");
 	}
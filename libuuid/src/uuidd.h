@@ -35,6 +35,8 @@
 #ifndef _UUID_UUIDD_H
 #define _UUID_UUIDD_H
 
+#include <stdint.h>
+
 #define UUIDD_DIR		_PATH_RUNSTATEDIR "/uuidd"
 #define UUIDD_SOCKET_PATH	UUIDD_DIR "/request"
 #define UUIDD_PIDFILE_PATH	UUIDD_DIR "/uuidd.pid"
@@ -46,7 +48,54 @@
 #define UUIDD_OP_RANDOM_UUID		3
 #define UUIDD_OP_BULK_TIME_UUID		4
 #define UUIDD_OP_BULK_RANDOM_UUID	5
-#define UUIDD_MAX_OP			UUIDD_OP_BULK_RANDOM_UUID
+#define UUIDD_OP_PERSISTENT		6	/* keep the connection open */
+#define UUIDD_OP_RING			7	/* shared ring for the connection */
+#define UUIDD_MAX_OP			UUIDD_OP_RING
+
+/*
+ * The shared ring of the time-based UUID ranges (uuidd --shared-ring).
+ *
+ * The client gets the ring by UUIDD_OP_RING request on a persistent
+ * connection; the ring is a sealed memfd passed by SCM_RIGHTS, it's shared
+ * only by the daemon and the client (and its children), and it's valid until
+ * the connection is closed. The client cannot claim the ranges deposited for
+ * the other clients.
+ *
+ * The daemon deposits reserved ranges of UUIDD_RING_RANGE clock values to the
+ * slots, the clients claim a range without any request to the daemon. The
+ * slot sequence number is even when the range is available, the client
+ * claims the range by compare-and-swap of the sequence number to the next
+ * (odd) value. The daemon deposits a new range to the claimed slots and
+ * replaces the expired ranges (claimed by the daemon in the same way) if the
+ * client still uses the ring.
+ *
+ * The slot is modified by the owner of the odd sequence number only, the
+ * sequence number is never decremented.
+ */
+#define UUIDD_RING_MAGIC	0x474e495244495555ULL	/* "UUIDRING" */
+#define UUIDD_RING_VERSION	2
+#define UUIDD_RING_SLOTS	16
+#define UUIDD_RING_RANGE	1024	/* UUIDs in the slot */
+#define UUIDD_RING_STALE	2	/* daemon is gone after <sec> */
+
+struct uuidd_ring_slot {
+	uint64_t	seq;
+	int64_t		expire;		/* time(), do not use after */
+	uint64_t	uuid[2];	/* the first UUID of the range */
+	int32_t		num;		/* number of UUIDs in the range */
+	int32_t		__pad0;
+	uint64_t	__pad1[3];	/* slot per cache line */
+};
+
+struct uuidd_ring {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	nslots;
+	int64_t		heartbeat;	/* time() of the last update by uuidd */
+	uint64_t	__pad[5];
+
+	struct uuidd_ring_slot slots[UUIDD_RING_SLOTS];
+};
 
 extern int __uuid_generate_time(uuid_t out, int *num);
 extern int __uuid_generate_time_cont(uuid_t out, int *num, uint32_t cont);
@@ -26,6 +26,7 @@
  */
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <time.h>
 #include <stdio.h>
@@ -52,6 +53,7 @@
 #include "strutils.h"
 #include "timeutils.h"
 #include "monotonic.h"
+#include "all-io.h"
 
 #ifdef FUZZ_TARGET
 #include "fuzz.h"
@@ -73,7 +75,18 @@
 # define LAST_TIMESTAMP_LEN 32
 #endif
 
-#define UCHUNKSIZE	16384	/* How much we read at once. */
+/*
+ * The whole [uw]tmp file, mmap()ed or (if not possible) read to memory.
+ * Records are aligned to the end of the file.
+ */
+struct wtmp_file {
+	char	*data;
+	size_t	size;		/* size of the data */
+	size_t	nrecs;		/* number of records */
+	size_t	cur;		/* number of not yet read records */
+
+	unsigned int mapped : 1;
+};
 
 struct last_control {
 	unsigned int lastb :1,	  /* Is this command 'lastb' */
@@ -175,95 +188,114 @@ static int which_time_format(const char *s)
 }
 #endif
 
-/*
- *	Read one utmp entry, return in new format.
- *	Automatically reposition file pointer.
- */
-static int uread(FILE *fp, struct utmpx *u,  int *quit, const char *filename)
+static int wtmp_open(struct wtmp_file *wf, const char *filename)
 {
-	static int utsize;
-	static char buf[UCHUNKSIZE];
-	char tmp[1024];
-	static off_t fpos;
-	static int bpos;
-	off_t o;
-
-	if (quit == NULL && u != NULL) {
-		/*
-		 *	Normal read.
-		 */
-		return fread(u, sizeof(struct utmpx), 1, fp);
-	}
+	struct stat st;
+	int fd;
 
-	if (u == NULL) {
-		/*
-		 *	Initialize and position.
-		 */
-		utsize = sizeof(struct utmpx);
-		fseeko(fp, 0, SEEK_END);
-		fpos = ftello(fp);
-		if (fpos == 0)
-			return 0;
-		o = ((fpos - 1) / UCHUNKSIZE) * UCHUNKSIZE;
-		if (fseeko(fp, o, SEEK_SET) < 0) {
-			warn(_("seek on %s failed"), filename);
-			return 0;
-		}
-		bpos = (int)(fpos - o);
-		if (fread(buf, bpos, 1, fp) != 1) {
-			warn(_("cannot read %s"), filename);
-			return 0;
-		}
-		fpos = o;
-		return 1;
-	}
+	memset(wf, 0, sizeof(*wf));
 
-	/*
-	 *	Read one struct. From the buffer if possible.
-	 */
-	bpos -= utsize;
-	if (bpos >= 0) {
-		memcpy(u, buf + bpos, sizeof(struct utmpx));
-		return 1;
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) != 0)
+		goto err;
+
+	if (S_ISREG(st.st_mode) && st.st_size > 0
+	    && (uintmax_t) st.st_size <= SIZE_MAX) {
+		wf->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (wf->data != MAP_FAILED) {
+			wf->size = st.st_size;
+			wf->mapped = 1;
+		} else
+			wf->data = NULL;
 	}
 
-	/*
-	 *	Oops we went "below" the buffer. We should be able to
-	 *	seek back UCHUNKSIZE bytes.
-	 */
-	fpos -= UCHUNKSIZE;
-	if (fpos < 0)
-		return 0;
+	/* pipes, etc. */
+	if (!wf->mapped) {
+		size_t bufsz = 0;
+		ssize_t rc;
 
-	/*
-	 *	Copy whatever is left in the buffer.
-	 */
-	memcpy(tmp + (-bpos), buf, utsize + bpos);
-	if (fseeko(fp, fpos, SEEK_SET) < 0) {
-		warn(_("seek on %s failed"), filename);
-		return 0;
+		do {
+			if (wf->size == bufsz) {
+				bufsz = bufsz ? bufsz * 2 : 64 * sizeof(struct utmpx);
+				wf->data = xrealloc(wf->data, bufsz);
+			}
+			rc = read_all(fd, wf->data + wf->size, bufsz - wf->size);
+			if (rc < 0)
+				goto err;
+			wf->size += rc;
+		} while (rc > 0);
 	}
 
-	/*
-	 *	Read another UCHUNKSIZE bytes.
-	 */
-	if (fread(buf, UCHUNKSIZE, 1, fp) != 1) {
-		warn(_("cannot read %s"), filename);
-		return 0;
+	close(fd);
+	wf->nrecs = wf->cur = wf->size / sizeof(struct utmpx);
+	return 0;
+err:
+	{
+		int errsv = errno;
+
+		free(wf->data);
+		close(fd);
+		return -errsv;
 	}
+}
 
-	/*
-	 *	The end of the UCHUNKSIZE byte buffer should be the first
-	 *	few bytes of the current struct utmp.
-	 */
-	memcpy(tmp, buf + UCHUNKSIZE + bpos, -bpos);
-	bpos += UCHUNKSIZE;
+static void wtmp_close(struct wtmp_file *wf)
+{
+	if (wf->mapped)
+		munmap(wf->data, wf->size);
+	else
+		free(wf->data);
+	memset(wf, 0, sizeof(*wf));
+}
+
+static inline const char *wtmp_record(const struct wtmp_file *wf, size_t idx)
+{
+	return wf->data + wf->size - (wf->nrecs - idx) * sizeof(struct utmpx);
+}
 
-	memcpy(u, tmp, sizeof(struct utmpx));
+static inline time_t wtmp_record_time(const struct wtmp_file *wf, size_t idx)
+{
+	struct utmpx u;
 
+	memcpy(&u.ut_tv, wtmp_record(wf, idx) + offsetof(struct utmpx, ut_tv),
+			sizeof(u.ut_tv));
+	return u.ut_tv.tv_sec;
+}
+
+/*
+ *	Read one utmp entry backwards, returns 1 on success and 0 on the
+ *	beginning of the file.
+ */
+static int wtmp_read_prev(struct wtmp_file *wf, struct utmpx *u)
+{
+	if (!wf->cur)
+		return 0;
+	wf->cur--;
+	memcpy(u, wtmp_record(wf, wf->cur), sizeof(struct utmpx));
 	return 1;
 }
 
+/*
+ *	Skip records newer than @until. The file is in chronological order,
+ *	so binary search is enough.
+ */
+static void wtmp_seek_until(struct wtmp_file *wf, time_t until)
+{
+	size_t lo = 0, hi = wf->cur;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (wtmp_record_time(wf, mid) <= until)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	wf->cur = lo;
+}
+
 #ifndef FUZZ_TARGET
 /*
  *	Print a short date.
@@ -651,7 +683,7 @@ static int is_phantom(const struct last_control *ctl, struct utmpx *ut)
 static void process_wtmp_file(const struct last_control *ctl,
 			      const char *filename)
 {
-	FILE *fp;		/* File pointer of wtmp file */
+	struct wtmp_file wf;	/* The wtmp file */
 
 	struct utmpx ut;	/* Current utmp entry */
 	struct utmplist *ulist = NULL;	/* All entries */
@@ -666,6 +698,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 
 	int c, x;		/* Scratch */
 	struct stat st;		/* To stat the [uw]tmp file */
+	int rc;
 	int quit = 0;		/* Flag */
 	int down = 0;		/* Down flag */
 
@@ -688,44 +721,41 @@ static void process_wtmp_file(const struct last_control *ctl,
 #endif
 
 	/*
-	 * Open the utmp file
+	 * Map the utmp file
 	 */
-	if ((fp = fopen(filename, "r")) == NULL)
+	rc = wtmp_open(&wf, filename);
+	if (rc) {
+		errno = -rc;
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
-
-	/*
-	 * Optimize the buffer size.
-	 */
-	setvbuf(fp, NULL, _IOFBF, UCHUNKSIZE);
+	}
 
 	/*
 	 * Read first structure to capture the time field
 	 */
-	if (uread(fp, &ut, NULL, filename) == 1)
+	if (wf.size >= sizeof(struct utmpx)) {
+		memcpy(&ut, wf.data, sizeof(struct utmpx));
 		begintime = ut.ut_tv.tv_sec;
-	else {
-		if (fstat(fileno(fp), &st) != 0)
+	} else {
+		if (stat(filename, &st) != 0)
 			err(EXIT_FAILURE, _("stat of %s failed"), filename);
 		begintime = st.st_ctime;
 		quit = 1;
 	}
 
-	/*
-	 * Go to end of file minus one structure
-	 * and/or initialize utmp reading code.
-	 */
-	uread(fp, NULL, NULL, filename);
+	if (ctl->until)
+		wtmp_seek_until(&wf, ctl->until);
 
 	/*
 	 * Read struct after struct backwards from the file.
 	 */
 	while (!quit) {
 
-		if (uread(fp, &ut, &quit, filename) != 1)
+		if (wtmp_read_prev(&wf, &ut) != 1)
 			break;
 
+		/* the rest of the file is older */
 		if (ctl->since && ut.ut_tv.tv_sec < ctl->since)
-			continue;
+			break;
 
 		if (ctl->until && ctl->until < ut.ut_tv.tv_sec)
 			continue;
@@ -914,7 +944,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 		free(tmp);
 	}
 
-	fclose(fp);
+	wtmp_close(&wf);
 
 	for (p = ulist; p; p = next) {
 		next = p->next;
@@ -923,8 +953,6 @@ static void process_wtmp_file(const struct last_control *ctl,
 }
 
 #ifdef FUZZ_TARGET
-# include "all-io.h"
-
 int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	struct last_control ctl = {
 		.showhost = TRUE,
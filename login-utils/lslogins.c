@@ -58,6 +58,7 @@
 #include "logindefs.h"
 #include "procutils.h"
 #include "timeutils.h"
+#include "all-io.h"
 
 /*
  * column description
@@ -255,9 +256,11 @@ static const struct lslogins_coldesc coldescs[] =
 struct lslogins_control {
 	struct utmpx *wtmp;
 	size_t wtmp_size;
+	void *wtmp_tree;	/* the last wtmp record for each user */
 
 	struct utmpx *btmp;
 	size_t btmp_size;
+	void *btmp_tree;	/* the last btmp record for each user */
 
 	int lastlogin_fd;
 
@@ -422,21 +425,40 @@ again:
 	return res;
 }
 
-static struct utmpx *get_last_wtmp(struct lslogins_control *ctl, const char *username)
+static int cmp_ut_user(const void *a, const void *b)
 {
-	size_t n = 0;
+	return strncmp(((const struct utmpx *) a)->ut_user,
+		       ((const struct utmpx *) b)->ut_user,
+		       sizeof(((const struct utmpx *) a)->ut_user));
+}
+
+/* returns tree with the last record for each user */
+static void *index_utmpx(struct utmpx *records, size_t nrecords)
+{
+	void *tree = NULL;
+	size_t i;
 
-	if (!username)
+	for (i = 0; i < nrecords; i++) {
+		struct utmpx **node = tsearch(&records[i], &tree, cmp_ut_user);
+
+		if (!node)
+			err_oom();
+		*node = &records[i];	/* the newer record wins */
+	}
+	return tree;
+}
+
+static struct utmpx *get_last_utmpx(void *tree, const char *username)
+{
+	struct utmpx key, **node;
+
+	if (!username || !tree)
 		return NULL;
 
-	n = ctl->wtmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->wtmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->wtmp + n;
-	} while (n--);
-	return NULL;
+	strncpy(key.ut_user, username, sizeof(key.ut_user));
+	node = tfind(&key, &tree, cmp_ut_user);
 
+	return node ? *node : NULL;
 }
 
 static int require_wtmp(void)
@@ -457,62 +479,49 @@ static int require_btmp(void)
 	return 0;
 }
 
-static struct utmpx *get_last_btmp(struct lslogins_control *ctl, const char *username)
-{
-	size_t n = 0;
-
-	if (!username)
-		return NULL;
-
-	n = ctl->btmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->btmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->btmp + n;
-	}while (n--);
-	return NULL;
-
-}
-
+/*
+ * Reads the whole file at once; getutxent() is too expensive for large
+ * files, as it locks the file for each record.
+ */
 static int parse_utmpx(const char *path, size_t *nrecords, struct utmpx **records)
 {
-	size_t i, imax = 0;
+	size_t imax = 0, sz = 0;
 	struct utmpx *ary = NULL;
 	struct stat st;
+	ssize_t rc;
+	int fd;
 
 	*nrecords = 0;
 	*records = NULL;
 
-	if (utmpxname(path) < 0)
-		return -errno;
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		goto fail;
 
 	/* optimize allocation according to file size, the realloc() below is
 	 * just fallback only */
-	if (stat(path, &st) == 0 && (size_t) st.st_size >= sizeof(struct utmpx)) {
+	if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(struct utmpx))
 		imax = st.st_size / sizeof(struct utmpx);
-		ary = xmalloc(imax * sizeof(struct utmpx));
-	}
+	else
+		imax = 64;
+	ary = xmalloc(imax * sizeof(struct utmpx));
 
-	for (i = 0; ; i++) {
-		struct utmpx *u;
-		errno = 0;
-		u = getutxent();
-		if (!u) {
-			if (errno)
-				goto fail;
-			break;
-		}
-		if (i == imax)
+	do {
+		if (sz == imax * sizeof(struct utmpx))
 			ary = xrealloc(ary, (imax *= 2) * sizeof(struct utmpx));
-		ary[i] = *u;
-	}
+		rc = read_all(fd, (char *) ary + sz, imax * sizeof(struct utmpx) - sz);
+		if (rc < 0)
+			goto fail;
+		sz += rc;
+	} while (rc > 0);
 
-	*nrecords = i;
+	close(fd);
+	*nrecords = sz / sizeof(struct utmpx);
 	*records = ary;
-	endutxent();
 	return 0;
 fail:
-	endutxent();
+	if (fd >= 0)
+		close(fd);
 	free(ary);
 	if (errno) {
 		if (errno != EACCES)
@@ -744,10 +753,8 @@ static struct lslogins_user *get_user_info(struct lslogins_control *ctl, const c
 
 	user = xcalloc(1, sizeof(struct lslogins_user));
 
-	if (ctl->wtmp)
-		user_wtmp = get_last_wtmp(ctl, pwd->pw_name);
-	if (ctl->btmp)
-		user_btmp = get_last_btmp(ctl, pwd->pw_name);
+	user_wtmp = get_last_utmpx(ctl->wtmp_tree, pwd->pw_name);
+	user_btmp = get_last_utmpx(ctl->btmp_tree, pwd->pw_name);
 
 	lckpwdf();
 	shadow = getspnam(pwd->pw_name);
@@ -1021,6 +1028,11 @@ static int get_ulist(struct lslogins_control *ctl, char *logins, char *groups)
 	return 0;
 }
 
+static void free_ut_node(void *node __attribute__((__unused__)))
+{
+	/* records are in lslogins_control.{w,b}tmp arrays */
+}
+
 static void free_ctl(struct lslogins_control *ctl)
 {
 	size_t n = 0;
@@ -1028,6 +1040,8 @@ static void free_ctl(struct lslogins_control *ctl)
 	if (!ctl)
 		return;
 
+	tdestroy(ctl->wtmp_tree, free_ut_node);
+	tdestroy(ctl->btmp_tree, free_ut_node);
 	free(ctl->wtmp);
 	free(ctl->btmp);
 
@@ -1697,10 +1711,13 @@ int main(int argc, char *argv[])
 
 	if (require_wtmp()) {
 		parse_utmpx(path_wtmp, &ctl->wtmp_size, &ctl->wtmp);
+		ctl->wtmp_tree = index_utmpx(ctl->wtmp, ctl->wtmp_size);
 		ctl->lastlogin_fd = open(path_lastlog, O_RDONLY, 0);
 	}
-	if (require_btmp())
+	if (require_btmp()) {
 		parse_utmpx(path_btmp, &ctl->btmp_size, &ctl->btmp);
+		ctl->btmp_tree = index_utmpx(ctl->btmp, ctl->btmp_size);
+	}
 
 	if (logins || groups)
 		get_ulist(ctl, logins, groups);
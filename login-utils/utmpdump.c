@@ -36,6 +36,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #ifdef HAVE_INOTIFY_INIT
 #include <sys/inotify.h>
 #endif
@@ -44,7 +45,9 @@
 #include "nls.h"
 #include "xalloc.h"
 #include "closestream.h"
+#include "optutils.h"
 #include "timeutils.h"
+#include "jsonwrt.h"
 
 static time_t strtotime(const char *s_time)
 {
@@ -95,36 +98,137 @@ static void xcleanse(char *s, int len)
 			*s = '?';
 }
 
+static const char *get_addr_string(struct utmpx *ut, char *buf, size_t bufsz)
+{
+	if (ut->ut_addr_v6[1] || ut->ut_addr_v6[2] || ut->ut_addr_v6[3])
+		return inet_ntop(AF_INET6, &(ut->ut_addr_v6), buf, bufsz);
+	return inet_ntop(AF_INET, &(ut->ut_addr_v6), buf, bufsz);
+}
+
+/*
+ * The records are usually sorted by time, so the string is generated only
+ * when the second changes; microseconds are patched in the cached string.
+ */
+static const char *get_time_string(struct utmpx *ut)
+{
+	static char time_string[40];
+	static char *usec;
+	static struct timeval last;
+	static int cached;
+
+	if (!cached || last.tv_sec != ut->ut_tv.tv_sec) {
+		last.tv_sec = ut->ut_tv.tv_sec;
+		last.tv_usec = ut->ut_tv.tv_usec;
+
+		if (strtimeval_iso(&last, ISO_TIMESTAMP_COMMA_GT, time_string,
+				   sizeof(time_string)) != 0) {
+			cached = 0;
+			return NULL;
+		}
+		/* cache only if there is the expected 6-digit usec */
+		usec = strchr(time_string, ',');
+		cached = usec && last.tv_usec >= 0 && last.tv_usec <= 999999;
+		return time_string;
+	}
+
+	if (last.tv_usec != ut->ut_tv.tv_usec) {
+		int32_t x = ut->ut_tv.tv_usec;
+		int i;
+
+		if (x < 0 || x > 999999) {
+			cached = 0;
+			return get_time_string(ut);
+		}
+		for (i = 6; i > 0; i--, x /= 10)
+			usec[i] = '0' + x % 10;
+		last.tv_usec = ut->ut_tv.tv_usec;
+	}
+	return time_string;
+}
+
+/* the same as "[%-<width>.<max>s] " */
+static char *put_field(char *p, const char *s, size_t max, size_t width)
+{
+	size_t len = strnlen(s, max);
+
+	*p++ = '[';
+	memcpy(p, s, len);
+	p += len;
+	for (; len < width; len++)
+		*p++ = ' ';
+	*p++ = ']';
+	*p++ = ' ';
+	return p;
+}
+
 static void print_utline(struct utmpx *ut, FILE *out)
 {
-	const char *addr_string;
+	const char *addr_string, *time_string;
 	char buffer[INET6_ADDRSTRLEN];
-	char time_string[40];
-	struct timeval tv;
+	char line[64 + sizeof(ut->ut_id) + sizeof(ut->ut_user) + sizeof(ut->ut_line)
+		  + sizeof(ut->ut_host) + INET6_ADDRSTRLEN + 40], *p;
 
-	if (ut->ut_addr_v6[1] || ut->ut_addr_v6[2] || ut->ut_addr_v6[3])
-		addr_string = inet_ntop(AF_INET6, &(ut->ut_addr_v6), buffer, sizeof(buffer));
-	else
-		addr_string = inet_ntop(AF_INET, &(ut->ut_addr_v6), buffer, sizeof(buffer));
-
-	tv.tv_sec = ut->ut_tv.tv_sec;
-	tv.tv_usec = ut->ut_tv.tv_usec;
+	addr_string = get_addr_string(ut, buffer, sizeof(buffer));
 
-	if (strtimeval_iso(&tv, ISO_TIMESTAMP_COMMA_GT, time_string,
-			   sizeof(time_string)) != 0)
+	time_string = get_time_string(ut);
+	if (!time_string)
 		return;
 	cleanse(ut->ut_id);
 	cleanse(ut->ut_user);
 	cleanse(ut->ut_line);
 	cleanse(ut->ut_host);
 
-	/*            type pid    id       user     line     host     addr    time */
-	fprintf(out, "[%d] [%05d] [%-4.4s] [%-*.*s] [%-*.*s] [%-*.*s] [%-15s] [%s]\n",
-	       ut->ut_type, ut->ut_pid, ut->ut_id,
-	       8, (int)sizeof(ut->ut_user), ut->ut_user,
-	       12, (int)sizeof(ut->ut_line), ut->ut_line,
-	       20, (int)sizeof(ut->ut_host), ut->ut_host,
-	       addr_string, time_string);
+	/* type pid */
+	p = line + sprintf(line, "[%d] [%05d] ", ut->ut_type, ut->ut_pid);
+
+	/* id user line host addr */
+	p = put_field(p, ut->ut_id, 4, 4);
+	p = put_field(p, ut->ut_user, sizeof(ut->ut_user), 8);
+	p = put_field(p, ut->ut_line, sizeof(ut->ut_line), 12);
+	p = put_field(p, ut->ut_host, sizeof(ut->ut_host), 20);
+	p = put_field(p, addr_string ? addr_string : "(null)", INET6_ADDRSTRLEN, 15);
+
+	/* time */
+	*p++ = '[';
+	p = stpcpy(p, time_string);
+	*p++ = ']';
+	*p++ = '\n';
+
+	ignore_result( fwrite(line, 1, p - line, out) );
+}
+
+#define json_value_field(_j, _n, _f) \
+	ul_jsonwrt_value_s_sized(_j, _n, _f, strnlen(_f, sizeof(_f)))
+
+static void print_utjson(struct utmpx *ut, struct ul_jsonwrt *json)
+{
+	const char *addr_string, *time_string;
+	char buffer[INET6_ADDRSTRLEN], num[sizeof(stringify_value(INT_MIN))];
+
+	addr_string = get_addr_string(ut, buffer, sizeof(buffer));
+	time_string = get_time_string(ut);
+
+	ul_jsonwrt_object_open(json, NULL);
+
+	ul_jsonwrt_value_u64(json, "type", (uint16_t) ut->ut_type);
+	snprintf(num, sizeof(num), "%d", ut->ut_pid);
+	ul_jsonwrt_value_raw(json, "pid", num);
+	json_value_field(json, "id", ut->ut_id);
+	json_value_field(json, "user", ut->ut_user);
+	json_value_field(json, "line", ut->ut_line);
+	json_value_field(json, "host", ut->ut_host);
+	ul_jsonwrt_value_s(json, "addr", addr_string);
+	ul_jsonwrt_value_s(json, "time", time_string);
+
+	ul_jsonwrt_object_close(json);
+}
+
+static void print_entry(struct utmpx *ut, FILE *out, struct ul_jsonwrt *json)
+{
+	if (json)
+		print_utjson(ut, json);
+	else
+		print_utline(ut, out);
 }
 
 #ifdef HAVE_INOTIFY_INIT
@@ -214,15 +318,49 @@ static int follow_by_inotify(FILE *in, const char *filename, FILE *out)
 }
 #endif /* HAVE_INOTIFY_INIT */
 
-static FILE *dump(FILE *in, const char *filename, int follow, FILE *out)
+/* returns 0 if the file has been dumped by mmap() */
+static int dump_mapped(FILE *in, FILE *out, struct ul_jsonwrt *json)
+{
+	struct utmpx ut;
+	struct stat st;
+	off_t pos;
+	char *data;
+	size_t i, n;
+
+	if (fstat(fileno(in), &st) != 0 || !S_ISREG(st.st_mode))
+		return -EINVAL;
+	pos = ftello(in);
+	if (pos < 0 || pos >= st.st_size || (uintmax_t) st.st_size > SIZE_MAX)
+		return -EINVAL;
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+	if (data == MAP_FAILED)
+		return -errno;
+	posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+	n = (st.st_size - pos) / sizeof(ut);
+	for (i = 0; i < n; i++) {
+		/* copy, the entry is modified by print functions */
+		memcpy(&ut, data + pos + i * sizeof(ut), sizeof(ut));
+		print_entry(&ut, out, json);
+	}
+
+	munmap(data, st.st_size);
+	return 0;
+}
+
+static FILE *dump(FILE *in, const char *filename, int follow, FILE *out,
+		  struct ul_jsonwrt *json)
 {
 	struct utmpx ut;
 
 	if (follow)
 		ignore_result( fseek(in, -10 * sizeof(ut), SEEK_END) );
 
+	else if (dump_mapped(in, out, json) == 0)
+		return in;
+
 	while (fread(&ut, sizeof(ut), 1, in) == 1)
-		print_utline(&ut, out);
+		print_entry(&ut, out, json);
 
 	if (!follow)
 		return in;
@@ -317,6 +455,7 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -f, --follow         output appended data as the file grows\n"), out);
+	fputs(_(" -J, --json           use JSON output format\n"), out);
 	fputs(_(" -r, --reverse        write back dumped data into utmp file\n"), out);
 	fputs(_(" -o, --output <file>  write to file instead of standard output\n"), out);
 	printf(USAGE_HELP_OPTIONS(22));
@@ -329,11 +468,13 @@ int main(int argc, char **argv)
 {
 	int c;
 	FILE *in = NULL, *out = NULL;
-	int reverse = 0, follow = 0;
+	int reverse = 0, follow = 0, json = 0;
 	const char *filename = NULL;
+	struct ul_jsonwrt jw;
 
 	static const struct option longopts[] = {
 		{ "follow",  no_argument,       NULL, 'f' },
+		{ "json",    no_argument,       NULL, 'J' },
 		{ "reverse", no_argument,       NULL, 'r' },
 		{ "output",  required_argument, NULL, 'o' },
 		{ "help",    no_argument,       NULL, 'h' },
@@ -346,7 +487,16 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "fro:hV", longopts, NULL)) != -1) {
+	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
+		{ 'J', 'f', 'r' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
+
+	while ((c = getopt_long(argc, argv, "fJro:hV", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'r':
 			reverse = 1;
@@ -356,6 +506,10 @@ int main(int argc, char **argv)
 			follow = 1;
 			break;
 
+		case 'J':
+			json = 1;
+			break;
+
 		case 'o':
 			out = fopen(optarg, "w");
 			if (!out)
@@ -377,7 +531,8 @@ int main(int argc, char **argv)
 
 	if (follow && (out != stdout || !isatty(STDOUT_FILENO))) {
 		setvbuf(out, NULL, _IOLBF, 0);
-	}
+	} else if (!follow && !reverse)
+		setvbuf(out, NULL, _IOFBF, 64 * 1024);
 
 	if (optind < argc) {
 		filename = argv[optind];
@@ -396,7 +551,16 @@ int main(int argc, char **argv)
 		undump(in, out);
 	} else {
 		fprintf(stderr, _("Utmp dump of %s\n"), filename);
-		in = dump(in, filename, follow, out);
+		if (json) {
+			ul_jsonwrt_init(&jw, out, 0);
+			ul_jsonwrt_root_open(&jw);
+			ul_jsonwrt_array_open(&jw, "utmp");
+		}
+		in = dump(in, filename, follow, out, json ? &jw : NULL);
+		if (json) {
+			ul_jsonwrt_array_close(&jw);
+			ul_jsonwrt_root_close(&jw);
+		}
 	}
 
 	if (out != stdout && close_stream(out))
@@ -18,6 +18,10 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #define OUTPUT_FULL		(1 << 0)
 #define OUTPUT_VALUE_ONLY	(1 << 1)
@@ -25,6 +29,7 @@
 #define OUTPUT_PRETTY_LIST	(1 << 3)		/* deprecated */
 #define OUTPUT_UDEV_LIST	(1 << 4)		/* deprecated */
 #define OUTPUT_EXPORT_LIST	(1 << 5)
+#define OUTPUT_STATS		(1 << 6)
 
 #define BLKID_EXIT_NOTFOUND	2	/* token or device not found */
 #define BLKID_EXIT_OTHER	4	/* bad usage or other error */
@@ -50,6 +55,10 @@ struct blkid_control {
 	int output;
 	uintmax_t offset;
 	uintmax_t size;
+	uintmax_t io_budget;
+	uintmax_t scan_step;
+	uint64_t io_budget_reads;
+	int nthreads;
 	char *show[128];
 	unsigned int
 		eval:1,
@@ -79,13 +88,14 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(	" -d, --no-encoding          don't encode non-printing characters\n"), out);
 	fputs(_(	" -g, --garbage-collect      garbage collect the blkid cache\n"), out);
 	fputs(_(	" -o, --output <format>      output format; can be one of:\n"
-			"                              value, device, export or full; (default: full)\n"), out);
+			"                              value, device, export, stats or full; (default: full)\n"), out);
 	fputs(_(	" -k, --list-filesystems     list all known filesystems/RAIDs and exit\n"), out);
 	fputs(_(	" -s, --match-tag <tag>      show specified tag(s) (default show all tags)\n"), out);
 	fputs(_(	" -t, --match-token <token>  find device with a specific token (NAME=value pair)\n"), out);
 	fputs(_(	" -l, --list-one             look up only first device with token specified by -t\n"), out);
 	fputs(_(	" -L, --label <label>        convert LABEL to device name\n"), out);
 	fputs(_(	" -U, --uuid <uuid>          convert UUID to device name\n"), out);
+	fputs(_(	"     --parallel <num>       probe all devices by <num> threads (0 means auto)\n"), out);
 	fputs(          "\n", out);
 	fputs(_(	"Low-level probing options:\n"), out);
 	fputs(_(	" -p, --probe                low-level superblocks probing (bypass cache)\n"), out);
@@ -93,9 +103,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(        " -H, --hint <value>         set hint for probing function\n"), out);
 	fputs(_(	" -S, --size <size>          overwrite device size\n"), out);
 	fputs(_(	" -O, --offset <offset>      probe at the given offset\n"), out);
+	fputs(_(	"     --scan <step>          probe at every <step> aligned offset of the device\n"), out);
 	fputs(_(	" -u, --usages <list>        filter by \"usage\" (e.g. -u filesystem,raid)\n"), out);
 	fputs(_(	" -n, --match-types <list>   filter by filesystem type (e.g. -n vfat,ext3)\n"), out);
 	fputs(_(	" -D, --no-part-details      don't print info from partition table\n"), out);
+	fputs(_(	"     --io-budget <size>[,<num>]\n"
+			"                            limit I/O per device to <size> bytes and <num> reads\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(28));
@@ -536,6 +549,13 @@ static int lowprobe_device(blkid_probe pr, const char *devname,
 	if (!rc)
 		nvals = blkid_probe_numof_values(pr);
 
+	if (blkid_probe_is_partial(pr))
+		warnx(_("%s: I/O budget exceeded, the result may be incomplete"),
+				devname);
+
+	if (ctl->output & OUTPUT_STATS)
+		goto done;
+
 	if (nvals && !first && ctl->output & (OUTPUT_UDEV_LIST | OUTPUT_EXPORT_LIST))
 		/* add extra line between output from devices */
 		fputc('\n', stdout);
@@ -580,6 +600,329 @@ done:
 	return 0;		/* success */
 }
 
+/*
+ * --scan, the probe window is moved across the device by --scan <step> and
+ * all signatures are reported with the window offset. The windows are probed
+ * by --parallel threads. A probe is not thread-safe and libblkid reads by
+ * lseek() and read(), so every thread has its own probe and file descriptor;
+ * the data are shared in the page cache.
+ */
+struct scan_sig {
+	uint64_t	offset;		/* window offset */
+	uint64_t	magic;		/* absolute offset of the magic string */
+	char		*type;
+	size_t		nvals;
+	char		**names;
+	char		**values;
+};
+
+struct scan_control {
+	struct blkid_control *ctl;
+	const char	*devname;
+	const char	*hint;
+	int		fltr_usage;
+	int		fltr_flag;
+	char		**fltr_type;
+
+	uint64_t	begin;		/* first window */
+	uint64_t	end;		/* end of the device */
+	uint64_t	next;		/* the next window offset */
+
+	struct scan_sig	*sigs;
+	size_t		nsigs;
+	int		error;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t	lock;		/* protects @next, @sigs and @error */
+#endif
+};
+
+static inline void scan_lock(struct scan_control *sc __attribute__((__unused__)))
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&sc->lock);
+#endif
+}
+
+static inline void scan_unlock(struct scan_control *sc __attribute__((__unused__)))
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&sc->lock);
+#endif
+}
+
+static blkid_probe new_scan_probe(struct scan_control *sc)
+{
+	struct blkid_control *ctl = sc->ctl;
+	blkid_probe pr = blkid_new_probe();
+
+	if (!pr)
+		return NULL;
+	if ((ctl->io_budget || ctl->io_budget_reads) &&
+	    blkid_probe_set_io_budget(pr, ctl->io_budget, ctl->io_budget_reads) != 0)
+		goto err;
+	if (sc->hint && blkid_probe_set_hint(pr, sc->hint, 0) != 0)
+		goto err;
+
+	blkid_probe_enable_superblocks(pr, 1);
+	blkid_probe_set_superblocks_flags(pr,
+			BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+			BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
+			BLKID_SUBLKS_USAGE | BLKID_SUBLKS_VERSION |
+			BLKID_SUBLKS_MAGIC);
+	if (sc->fltr_usage &&
+	    blkid_probe_filter_superblocks_usage(pr, sc->fltr_flag, sc->fltr_usage))
+		goto err;
+	if (sc->fltr_type &&
+	    blkid_probe_filter_superblocks_type(pr, sc->fltr_flag, sc->fltr_type))
+		goto err;
+
+	blkid_probe_enable_partitions(pr, 1);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_MAGIC);
+	return pr;
+err:
+	blkid_free_probe(pr);
+	return NULL;
+}
+
+/* adds the current result of @pr to the signatures list */
+static void scan_add_sig(struct scan_control *sc, blkid_probe pr, uint64_t offset)
+{
+	struct scan_sig sig = { .offset = offset, .magic = offset };
+	const char *name, *data;
+	size_t len;
+	int n, nvals = blkid_probe_numof_values(pr);
+
+	if (nvals <= 0)
+		return;
+	sig.names = xcalloc(nvals, sizeof(char *));
+	sig.values = xcalloc(nvals, sizeof(char *));
+
+	for (n = 0; n < nvals; n++) {
+		if (blkid_probe_get_value(pr, n, &name, &data, &len))
+			continue;
+		if (!strcmp(name, "SBMAGIC_OFFSET") || !strcmp(name, "PTMAGIC_OFFSET"))
+			sig.magic = offset + strtoumax(data, NULL, 10);
+		if (!strcmp(name, "TYPE") || !strcmp(name, "PTTYPE"))
+			sig.type = xstrndup(data, strnlen(data, len));
+		sig.names[sig.nvals] = xstrdup(name);
+		sig.values[sig.nvals++] = xstrndup(data, strnlen(data, len));
+	}
+
+	scan_lock(sc);
+	sc->sigs = xrealloc(sc->sigs, (sc->nsigs + 1) * sizeof(struct scan_sig));
+	sc->sigs[sc->nsigs++] = sig;
+	scan_unlock(sc);
+}
+
+static void *scan_worker(void *data)
+{
+	struct scan_control *sc = data;
+	struct blkid_control *ctl = sc->ctl;
+	blkid_probe pr;
+	int fd;
+
+	fd = open(sc->devname, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd < 0)
+		goto failed;
+	pr = new_scan_probe(sc);
+	if (!pr) {
+		close(fd);
+		goto failed;
+	}
+
+	for (;;) {
+		uint64_t offset, size;
+		int rc;
+
+		scan_lock(sc);
+		offset = sc->next;
+		if (offset < sc->end && !sc->error)
+			sc->next += ctl->scan_step;
+		scan_unlock(sc);
+
+		if (offset >= sc->end || sc->error)
+			break;
+
+		size = sc->end - offset;
+		if (ctl->size && ctl->size < size)
+			size = ctl->size;
+		if (blkid_probe_set_device(pr, fd, offset, size) != 0)
+			continue;
+
+		/* all signatures, like wipefs(8) */
+		while ((rc = blkid_do_probe(pr)) == 0)
+			scan_add_sig(sc, pr, offset);
+	}
+
+	blkid_free_probe(pr);
+	close(fd);
+	return NULL;
+failed:
+	warn(_("error: %s"), sc->devname);
+	scan_lock(sc);
+	sc->error = 1;
+	scan_unlock(sc);
+	return NULL;
+}
+
+static int cmp_scan_sigs(const void *a, const void *b)
+{
+	const struct scan_sig *x = a, *y = b;
+
+	if (x->offset != y->offset)
+		return x->offset < y->offset ? -1 : 1;
+	if (x->magic != y->magic)
+		return x->magic < y->magic ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Signatures at the end of the device (e.g. MD or DM integrity) are found in
+ * every window; report only the first one.
+ */
+static int scan_sig_is_dup(struct scan_control *sc, size_t idx)
+{
+	struct scan_sig *sig = &sc->sigs[idx];
+	size_t i;
+
+	for (i = 0; i < idx; i++) {
+		struct scan_sig *x = &sc->sigs[i];
+
+		if (x->magic == sig->magic && x->offset != sig->offset &&
+		    x->type && sig->type && strcmp(x->type, sig->type) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void print_scan_sig(struct blkid_control *ctl, const char *devname,
+			   struct scan_sig *sig, int first)
+{
+	char offset[32];
+	size_t i;
+	int num = 1;
+
+	if (!first && ctl->output & (OUTPUT_UDEV_LIST | OUTPUT_EXPORT_LIST))
+		fputc('\n', stdout);
+
+	snprintf(offset, sizeof(offset), "%" PRIu64, sig->offset);
+	if (!ctl->show[0] || has_item(ctl, "OFFSET"))
+		print_value(ctl, num++, devname, offset, "OFFSET", strlen(offset));
+
+	for (i = 0; i < sig->nvals; i++) {
+		const char *name = sig->names[i];
+
+		if (ctl->show[0] ? !has_item(ctl, name) :
+		    (strcmp(name, "SBMAGIC") == 0 || strcmp(name, "SBMAGIC_OFFSET") == 0 ||
+		     strcmp(name, "PTMAGIC") == 0 || strcmp(name, "PTMAGIC_OFFSET") == 0))
+			continue;
+		print_value(ctl, num++, devname, sig->values[i], name,
+				strlen(sig->values[i]));
+	}
+	if (num > 1 && !(ctl->output & (OUTPUT_VALUE_ONLY |
+				OUTPUT_UDEV_LIST | OUTPUT_EXPORT_LIST)))
+		printf("\n");
+}
+
+static int scan_device(struct scan_control *sc)
+{
+	struct blkid_control *ctl = sc->ctl;
+	struct stat st;
+	size_t i, nprinted = 0;
+	int fd;
+	static int first = 1;
+
+	fd = open(sc->devname, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		warn(_("error: %s"), sc->devname);
+		if (fd >= 0)
+			close(fd);
+		return BLKID_EXIT_NOTFOUND;
+	}
+	sc->begin = sc->next = ctl->offset;
+	sc->end = S_ISBLK(st.st_mode) ? (uint64_t) blkid_get_dev_size(fd) :
+					(uint64_t) st.st_size;
+	close(fd);
+
+	sc->sigs = NULL;
+	sc->nsigs = 0;
+	sc->error = 0;
+
+#ifdef HAVE_LIBPTHREAD
+	if (ctl->nthreads) {
+		uint64_t nwin = sc->end > sc->begin ?
+			(sc->end - sc->begin + ctl->scan_step - 1) / ctl->scan_step : 0;
+		long n = ctl->nthreads > 0 ? ctl->nthreads : sysconf(_SC_NPROCESSORS_ONLN);
+		size_t nthreads = n > 0 ? (size_t) n : 1, nrun;
+		pthread_t *threads;
+
+		if (nthreads > nwin)
+			nthreads = nwin ? nwin : 1;
+		threads = xcalloc(nthreads, sizeof(pthread_t));
+		pthread_mutex_init(&sc->lock, NULL);
+
+		for (nrun = 0; nrun < nthreads; nrun++) {
+			if (pthread_create(&threads[nrun], NULL, scan_worker, sc) != 0)
+				break;
+		}
+		if (!nrun)
+			scan_worker(sc);
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+
+		pthread_mutex_destroy(&sc->lock);
+		free(threads);
+	} else
+#endif
+		scan_worker(sc);
+
+	if (sc->nsigs)
+		qsort(sc->sigs, sc->nsigs, sizeof(struct scan_sig), cmp_scan_sigs);
+
+	for (i = 0; i < sc->nsigs; i++) {
+		struct scan_sig *sig = &sc->sigs[i];
+		size_t n;
+
+		if (!sc->error && !scan_sig_is_dup(sc, i)) {
+			print_scan_sig(ctl, sc->devname, sig, first);
+			first = 0;
+			nprinted++;
+		}
+		for (n = 0; n < sig->nvals; n++) {
+			free(sig->names[n]);
+			free(sig->values[n]);
+		}
+		free(sig->names);
+		free(sig->values);
+		free(sig->type);
+	}
+	free(sc->sigs);
+
+	if (sc->error)
+		return BLKID_EXIT_OTHER;
+	return nprinted ? 0 : BLKID_EXIT_NOTFOUND;
+}
+
+static void print_stats(blkid_probe pr)
+{
+	const char *name;
+	uint64_t calls, matches, nsec, reads, bytes, hits;
+	size_t idx;
+
+	printf("%-30s %8s %8s %12s %8s %12s %8s\n",
+		"PROBER", "CALLS", "MATCHES", "TIME-USEC", "READS", "BYTES", "HITS");
+
+	for (idx = 0; blkid_probe_get_stats(pr, idx, &name, &calls, &matches,
+				&nsec, &reads, &bytes, &hits) == 0; idx++) {
+		if (!calls)
+			continue;
+		printf("%-30s %8ju %8ju %12ju %8ju %12ju %8ju\n",
+			name, (uintmax_t) calls, (uintmax_t) matches,
+			(uintmax_t) (nsec / 1000), (uintmax_t) reads,
+			(uintmax_t) bytes, (uintmax_t) hits);
+	}
+}
+
 /* converts comma separated list to BLKID_USAGE_* mask */
 static int list_to_usage(const char *list, int *flag)
 {
@@ -678,6 +1021,11 @@ int main(int argc, char **argv)
 	unsigned int i;
 	int c;
 
+	enum {
+		OPT_PARALLEL = CHAR_MAX + 1,
+		OPT_IO_BUDGET,
+		OPT_SCAN
+	};
 	static const struct option longopts[] = {
 		{ "cache-file",	      required_argument, NULL, 'c' },
 		{ "no-encoding",      no_argument,	 NULL, 'd' },
@@ -697,6 +1045,9 @@ int main(int argc, char **argv)
 		{ "offset",	      required_argument, NULL, 'O' },
 		{ "usages",	      required_argument, NULL, 'u' },
 		{ "match-types",      required_argument, NULL, 'n' },
+		{ "parallel",	      required_argument, NULL, OPT_PARALLEL },
+		{ "io-budget",	      required_argument, NULL, OPT_IO_BUDGET },
+		{ "scan",	      required_argument, NULL, OPT_SCAN },
 		{ "version",	      no_argument,	 NULL, 'V' },
 		{ "help",	      no_argument,       NULL, 'h' },
 		{ NULL, 0, NULL, 0 }
@@ -778,6 +1129,8 @@ int main(int argc, char **argv)
 				ctl.output = OUTPUT_UDEV_LIST;
 			else if (!strcmp(optarg, "export"))
 				ctl.output = OUTPUT_EXPORT_LIST;
+			else if (!strcmp(optarg, "stats"))
+				ctl.output = OUTPUT_STATS;
 			else if (!strcmp(optarg, "full"))
 				ctl.output = 0;
 			else
@@ -822,6 +1175,34 @@ int main(int argc, char **argv)
 		case 'w':
 			/* ignore - backward compatibility */
 			break;
+		case OPT_PARALLEL:
+			ctl.nthreads = strtos32_or_err(optarg, _("invalid number of threads argument"));
+			if (ctl.nthreads < 0)
+				errx(BLKID_EXIT_OTHER, _("invalid number of threads argument: '%s'"), optarg);
+			if (ctl.nthreads == 0)
+				ctl.nthreads = -1;	/* auto */
+			break;
+		case OPT_IO_BUDGET:
+		{
+			char *str = xstrdup(optarg), *reads = strchr(str, ',');
+
+			if (reads) {
+				*reads++ = '\0';
+				ctl.io_budget_reads = strtou64_or_err(reads,
+						_("invalid I/O budget argument"));
+			}
+			if (*str)
+				ctl.io_budget = strtosize_or_err(str,
+						_("invalid I/O budget argument"));
+			free(str);
+			break;
+		}
+		case OPT_SCAN:
+			ctl.scan_step = strtosize_or_err(optarg, _("invalid scan step argument"));
+			if (!ctl.scan_step)
+				errx(BLKID_EXIT_OTHER, _("invalid scan step argument"));
+			ctl.lowprobe_superblocks = 1;
+			break;
 		case 'h':
 			usage();
 			break;
@@ -830,6 +1211,10 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* statistics are available for low-level probing only */
+	if (ctl.output == OUTPUT_STATS && !ctl.lowprobe_topology)
+		ctl.lowprobe_superblocks = 1;
+
 	if (ctl.lowprobe_topology || ctl.lowprobe_superblocks)
 		ctl.lowprobe = 1;
 
@@ -876,6 +1261,28 @@ int main(int argc, char **argv)
 			     _("The low-level probing mode "
 			       "requires a device"));
 
+		if (ctl.scan_step) {
+			struct scan_control sc = {
+				.ctl = &ctl,
+				.hint = hint,
+				.fltr_usage = fltr_usage,
+				.fltr_flag = fltr_flag,
+				.fltr_type = fltr_type
+			};
+
+			if (ctl.output & (OUTPUT_STATS | OUTPUT_DEVICE_ONLY))
+				errx(BLKID_EXIT_OTHER,
+				     _("The --scan mode does not support "
+				       "'stats' and 'device' output formats"));
+			for (i = 0; i < numdev; i++) {
+				sc.devname = devices[i];
+				err = scan_device(&sc);
+				if (err && err != BLKID_EXIT_NOTFOUND)
+					break;
+			}
+			goto exit;
+		}
+
 		/* automatically enable 'export' format for I/O Limits */
 		if (!ctl.output  && ctl.lowprobe_topology)
 			ctl.output = OUTPUT_EXPORT_LIST;
@@ -883,6 +1290,9 @@ int main(int argc, char **argv)
 		pr = blkid_new_probe();
 		if (!pr)
 			goto exit;
+		if ((ctl.io_budget || ctl.io_budget_reads) &&
+		    blkid_probe_set_io_budget(pr, ctl.io_budget, ctl.io_budget_reads) != 0)
+			goto exit;
 		if (hint && blkid_probe_set_hint(pr, hint, 0) != 0) {
 			warn(_("Failed to use probing hint: %s"), hint);
 			goto exit;
@@ -904,11 +1314,17 @@ int main(int argc, char **argv)
 				goto exit;
 		}
 
+		if (ctl.output & OUTPUT_STATS)
+			blkid_probe_enable_stats(pr, 1);
+
 		for (i = 0; i < numdev; i++) {
 			err = lowprobe_device(pr, devices[i], &ctl);
-			if (err)
+			/* statistics are aggregated for all devices */
+			if (err && !(ctl.output & OUTPUT_STATS))
 				break;
 		}
+		if (ctl.output & OUTPUT_STATS)
+			print_stats(pr);
 		blkid_free_probe(pr);
 	} else if (ctl.eval) {
 		/*
@@ -943,7 +1359,10 @@ int main(int argc, char **argv)
 		blkid_dev_iterate	iter;
 		blkid_dev		dev;
 
-		blkid_probe_all(cache);
+		if (ctl.nthreads)
+			blkid_probe_all_parallel(cache, ctl.nthreads < 0 ? 0 : ctl.nthreads);
+		else
+			blkid_probe_all(cache);
 
 		iter = blkid_dev_iterate_begin(cache);
 		blkid_dev_set_search(iter, search_type, search_value);
@@ -21,16 +21,24 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <ftw.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "c.h"
 #include "nls.h"
 #include "closestream.h"
 #include "xalloc.h"
 #include "strutils.h"
+#include "optutils.h"
 
 #include "libsmartcols.h"
 
@@ -42,6 +50,44 @@
    e.g. 128MB on x86_64. ( = N_PAGES_IN_WINDOW * 4096 ). */
 #define N_PAGES_IN_WINDOW ((size_t)(32 * 1024))
 
+/* Buffer for --load */
+#define FINCORE_LOAD_BUFSZ	(1024 * 1024)
+
+/* Number of files read by threads at once; the output is in the same order
+ * as files are specified or found by --recursive. */
+#define N_FILES_IN_BATCH 4096
+
+#ifndef HAVE_CACHESTAT
+
+# ifndef SYS_cachestat
+#  if defined(__alpha__)
+#   define SYS_cachestat 561
+#  else
+#   define SYS_cachestat 451
+#  endif
+# endif
+
+struct cachestat_range {
+	uint64_t off;
+	uint64_t len;
+};
+
+struct cachestat {
+	uint64_t nr_cache;
+	uint64_t nr_dirty;
+	uint64_t nr_writeback;
+	uint64_t nr_evicted;
+	uint64_t nr_recently_evicted;
+};
+
+static inline int cachestat(unsigned int fd,
+			    const struct cachestat_range *cstat_range,
+			    struct cachestat *cstat, unsigned int flags)
+{
+	return syscall(SYS_cachestat, fd, cstat_range, cstat, flags);
+}
+
+#endif /* HAVE_CACHESTAT */
 
 struct colinfo {
 	const char *name;
@@ -54,7 +100,16 @@ enum {
 	COL_PAGES,
 	COL_SIZE,
 	COL_FILE,
-	COL_RES
+	COL_RES,
+	COL_DIRTY_PAGES,
+	COL_DIRTY,
+	COL_WRITEBACK_PAGES,
+	COL_WRITEBACK,
+	COL_EVICTED_PAGES,
+	COL_EVICTED,
+	COL_RECENTLY_EVICTED_PAGES,
+	COL_RECENTLY_EVICTED,
+	COL_OFFSET
 };
 
 static struct colinfo infos[] = {
@@ -62,20 +117,70 @@ static struct colinfo infos[] = {
 	[COL_RES]    = { "RES",      5, SCOLS_FL_RIGHT, N_("file data resident in memory in bytes")},
 	[COL_SIZE]   = { "SIZE",     5, SCOLS_FL_RIGHT, N_("size of the file")},
 	[COL_FILE]   = { "FILE",     4, 0, N_("file name")},
+	[COL_DIRTY_PAGES] = { "DIRTY_PAGES", 1, SCOLS_FL_RIGHT, N_("number of dirty pages")},
+	[COL_DIRTY]  = { "DIRTY",    5, SCOLS_FL_RIGHT, N_("number of dirty bytes")},
+	[COL_WRITEBACK_PAGES] = { "WRITEBACK_PAGES", 1, SCOLS_FL_RIGHT, N_("number of pages marked for writeback")},
+	[COL_WRITEBACK] = { "WRITEBACK", 5, SCOLS_FL_RIGHT, N_("number of bytes marked for writeback")},
+	[COL_EVICTED_PAGES] = { "EVICTED_PAGES", 1, SCOLS_FL_RIGHT, N_("number of evicted pages")},
+	[COL_EVICTED] = { "EVICTED", 5, SCOLS_FL_RIGHT, N_("number of evicted bytes")},
+	[COL_RECENTLY_EVICTED_PAGES] = { "RECENTLY_EVICTED_PAGES", 1, SCOLS_FL_RIGHT, N_("number of recently evicted pages")},
+	[COL_RECENTLY_EVICTED] = { "RECENTLY_EVICTED", 5, SCOLS_FL_RIGHT, N_("number of recently evicted bytes")},
+	[COL_OFFSET] = { "OFFSET",   5, SCOLS_FL_RIGHT, N_("offset of the range in the file (for --histogram)")},
 };
 
 static int columns[ARRAY_SIZE(infos) * 2] = {-1};
 static size_t ncolumns;
 
+/* --histogram, one offset range of the file */
+struct fincore_range {
+	off_t size;			/* bytes of the file in the range */
+	struct cachestat cstat;
+};
+
+/* result for one file */
+struct fincore_state {
+	char *name;
+	struct stat sb;
+	struct cachestat cstat;		/* nr_cache only for mincore() */
+	int rc;				/* <0 on error, 0 success, 1 ignore */
+
+	struct fincore_range *ranges;	/* --histogram */
+	size_t nranges;
+
+	unsigned int has_cstat : 1;	/* all cachestat() counters */
+};
+
+enum {
+	FINCORE_NONE = 0,
+	FINCORE_LOAD,		/* --load */
+	FINCORE_EVICT		/* --evict */
+};
+
 struct fincore_control {
 	const size_t pagesize;
 
 	struct libscols_table *tb;		/* output */
 
+	struct fincore_state *files;		/* files read by threads */
+	size_t nfiles;
+	size_t next;				/* the next file to read */
+	size_t nthreads;			/* --parallel */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t lock;			/* protects @next */
+#endif
+	int status;				/* EXIT_* */
+	int no_cachestat;			/* cachestat() unsupported */
+	int action;				/* FINCORE_{LOAD,EVICT} */
+
+	off_t range_size;			/* --histogram */
+	struct fincore_state total;		/* --total */
+
 	unsigned int bytes : 1,
 		     noheadings : 1,
 		     raw : 1,
-		     json : 1;
+		     json : 1,
+		     recursive : 1,
+		     show_total : 1;
 };
 
 
@@ -106,10 +211,42 @@ static const struct colinfo *get_column_info(int num)
 	return &infos[ get_column_id(num) ];
 }
 
+static char *pages_to_string(struct fincore_control *ctl, int id, uint64_t pages)
+{
+	char *tmp;
+
+	switch (id) {
+	case COL_PAGES:
+	case COL_DIRTY_PAGES:
+	case COL_WRITEBACK_PAGES:
+	case COL_EVICTED_PAGES:
+	case COL_RECENTLY_EVICTED_PAGES:
+		xasprintf(&tmp, "%ju", (uintmax_t) pages);
+		break;
+	default:
+	{
+		uintmax_t res = (uintmax_t) pages * ctl->pagesize;
+
+		if (ctl->bytes)
+			xasprintf(&tmp, "%ju", res);
+		else
+			tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, res);
+		break;
+	}
+	}
+	return tmp;
+}
+
+/*
+ * Adds one line for the file, for the range of the file (@offset >= 0), or
+ * for the total.
+ */
 static int add_output_data(struct fincore_control *ctl,
 			   const char *name,
-			   off_t file_size,
-			   off_t count_incore)
+			   off_t offset,
+			   off_t size,
+			   const struct cachestat *cs,
+			   int has_cstat)
 {
 	size_t i;
 	char *tmp;
@@ -123,38 +260,58 @@ static int add_output_data(struct fincore_control *ctl,
 		err(EXIT_FAILURE, _("failed to allocate output line"));
 
 	for (i = 0; i < ncolumns; i++) {
-		int rc = 0;
+		int rc = 0, id = get_column_id(i);
+
+		tmp = NULL;
 
-		switch(get_column_id(i)) {
+		switch(id) {
 		case COL_FILE:
 			rc = scols_line_set_data(ln, i, name);
 			break;
 		case COL_PAGES:
-			xasprintf(&tmp, "%jd",  (intmax_t) count_incore);
-			rc = scols_line_refer_data(ln, i, tmp);
-			break;
 		case COL_RES:
+			tmp = pages_to_string(ctl, id, cs->nr_cache);
+			break;
+		case COL_DIRTY_PAGES:
+		case COL_DIRTY:
+			if (has_cstat)
+				tmp = pages_to_string(ctl, id, cs->nr_dirty);
+			break;
+		case COL_WRITEBACK_PAGES:
+		case COL_WRITEBACK:
+			if (has_cstat)
+				tmp = pages_to_string(ctl, id, cs->nr_writeback);
+			break;
+		case COL_EVICTED_PAGES:
+		case COL_EVICTED:
+			if (has_cstat)
+				tmp = pages_to_string(ctl, id, cs->nr_evicted);
+			break;
+		case COL_RECENTLY_EVICTED_PAGES:
+		case COL_RECENTLY_EVICTED:
+			if (has_cstat)
+				tmp = pages_to_string(ctl, id, cs->nr_recently_evicted);
+			break;
+		case COL_OFFSET:
+			if (offset < 0)
+				break;
+			/* fallthrough */
+		case COL_SIZE:
 		{
-			uintmax_t res = (uintmax_t) count_incore * ctl->pagesize;
+			off_t x = id == COL_SIZE ? size : offset;
 
 			if (ctl->bytes)
-				xasprintf(&tmp, "%ju", res);
+				xasprintf(&tmp, "%jd", (intmax_t) x);
 			else
-				tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, res);
-			rc = scols_line_refer_data(ln, i, tmp);
+				tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, x);
 			break;
 		}
-		case COL_SIZE:
-			if (ctl->bytes)
-				xasprintf(&tmp, "%jd", (intmax_t) file_size);
-			else
-				tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, file_size);
-			rc = scols_line_refer_data(ln, i, tmp);
-			break;
 		default:
 			return -EINVAL;
 		}
 
+		if (!rc && tmp)
+			rc = scols_line_refer_data(ln, i, tmp);
 		if (rc)
 			err(EXIT_FAILURE, _("failed to add output data"));
 	}
@@ -162,25 +319,103 @@ static int add_output_data(struct fincore_control *ctl,
 	return 0;
 }
 
+/*
+ * --load or --evict, handles all continuous ranges of not-resident (--load)
+ * or resident (--evict) pages in the window.
+ *
+ * POSIX_FADV_WILLNEED is not used for --load, the kernel limits the advice
+ * to the device readahead size and the rest of the range is silently
+ * ignored. The pages are read to the buffer instead.
+ */
+static int do_advise(struct fincore_control *ctl, int fd,
+		     const unsigned char *vec, size_t npages,
+		     off_t file_offset, const char *name)
+{
+	int want = ctl->action == FINCORE_EVICT ? 1 : 0;
+	char *buf = NULL;
+	size_t i = 0;
+	int rc = 0;
+
+	while (rc == 0 && i < npages) {
+		off_t off, end;
+		size_t start;
+
+		if ((vec[i] & 0x1) != want) {
+			i++;
+			continue;
+		}
+		for (start = i; i < npages && (vec[i] & 0x1) == want; i++);
+
+		off = file_offset + (off_t) start * ctl->pagesize;
+		end = file_offset + (off_t) i * ctl->pagesize;
+
+		if (ctl->action == FINCORE_EVICT) {
+#ifdef HAVE_POSIX_FADVISE
+			rc = posix_fadvise(fd, off, end - off, POSIX_FADV_DONTNEED);
+			if (rc) {
+				errno = rc;
+				warn(_("failed to do posix_fadvise: %s"), name);
+				rc = -errno;
+			}
+#endif
+			continue;
+		}
+
+		if (!buf)
+			buf = xmalloc(FINCORE_LOAD_BUFSZ);
+		while (off < end) {
+			ssize_t sz = pread(fd, buf, min((off_t) FINCORE_LOAD_BUFSZ,
+						end - off), off);
+			if (sz < 0) {
+				if (errno == EINTR)
+					continue;
+				warn(_("read failed: %s"), name);
+				rc = -errno;
+				break;
+			}
+			if (sz == 0)
+				break;		/* EOF */
+			off += sz;
+		}
+	}
+
+	free(buf);
+	return rc;
+}
+
 static int do_mincore(struct fincore_control *ctl,
+		      int fd,
 		      void *window, const size_t len,
-		      const char *name,
-		      off_t *count_incore)
+		      off_t file_offset,
+		      struct fincore_state *st)
 {
-	static unsigned char vec[N_PAGES_IN_WINDOW];
+	unsigned char vec[N_PAGES_IN_WINDOW];	/* per thread */
 	int n = (len / ctl->pagesize) + ((len % ctl->pagesize)? 1: 0);
 
 	if (mincore (window, len, vec) < 0) {
-		warn(_("failed to do mincore: %s"), name);
+		warn(_("failed to do mincore: %s"), st->name);
 		return -errno;
 	}
 
+	if (ctl->action != FINCORE_NONE) {
+		int rc = do_advise(ctl, fd, vec, n, file_offset, st->name);
+
+		if (rc)
+			return rc;
+	}
+
 	while (n > 0)
 	{
 		if (vec[--n] & 0x1)
 		{
 			vec[n] = 0;
-			(*count_incore)++;
+			st->cstat.nr_cache++;
+
+			if (st->ranges) {
+				off_t off = file_offset + (off_t) n * ctl->pagesize;
+
+				st->ranges[off / ctl->range_size].cstat.nr_cache++;
+			}
 		}
 	}
 
@@ -189,12 +424,10 @@ static int do_mincore(struct fincore_control *ctl,
 
 static int fincore_fd (struct fincore_control *ctl,
 		       int fd,
-		       const char *name,
-		       off_t file_size,
-		       off_t *count_incore)
+		       struct fincore_state *st)
 {
 	size_t window_size = N_PAGES_IN_WINDOW * ctl->pagesize;
-	off_t file_offset, len;
+	off_t file_offset, len, file_size = st->sb.st_size;
 	int rc = 0;
 
 	for (file_offset = 0; file_offset < file_size; file_offset += len) {
@@ -207,50 +440,274 @@ static int fincore_fd (struct fincore_control *ctl,
 		window = mmap(window, len, PROT_NONE, MAP_PRIVATE, fd, file_offset);
 		if (window == MAP_FAILED) {
 			rc = -EINVAL;
-			warn(_("failed to do mmap: %s"), name);
+			warn(_("failed to do mmap: %s"), st->name);
 			break;
 		}
 
-		rc = do_mincore(ctl, window, len, name, count_incore);
+		rc = do_mincore(ctl, fd, window, len, file_offset, st);
+		munmap (window, len);
 		if (rc)
 			break;
-
-		munmap (window, len);
 	}
 
 	return rc;
 }
 
 /*
- * Returns: <0 on error, 0 success, 1 ignore.
+ * The cachestat() syscall (since Linux 6.5) returns the counters without
+ * mapping of the file. Returns: 0 success, 1 unsupported, <0 on error.
+ */
+static int fincore_cachestat(struct fincore_control *ctl,
+			     int fd, struct fincore_state *st)
+{
+	struct cachestat_range cs_range = { 0, 0 };	/* whole file */
+
+	if (ctl->no_cachestat)
+		return 1;
+
+	if (cachestat(fd, &cs_range, &st->cstat, 0) == 0) {
+		size_t i;
+
+		for (i = 0; i < st->nranges; i++) {
+			cs_range.off = i * ctl->range_size;
+			cs_range.len = ctl->range_size;
+			if (cachestat(fd, &cs_range, &st->ranges[i].cstat, 0) != 0)
+				goto fail;
+		}
+		st->has_cstat = 1;
+		return 0;
+	}
+	if (errno == ENOSYS) {
+		ctl->no_cachestat = 1;	/* don't try it again */
+		return 1;
+	}
+	if (errno == EOPNOTSUPP)
+		return 1;		/* for example hugetlbfs */
+fail:
+	warn(_("failed to do cachestat: %s"), st->name);
+	return -errno;
+}
+
+static void init_ranges(struct fincore_control *ctl, struct fincore_state *st)
+{
+	size_t i;
+
+	st->nranges = (st->sb.st_size + ctl->range_size - 1) / ctl->range_size;
+	st->ranges = xcalloc(st->nranges, sizeof(struct fincore_range));
+
+	for (i = 0; i < st->nranges; i++) {
+		off_t off = i * ctl->range_size;
+
+		st->ranges[i].size = min(ctl->range_size, st->sb.st_size - off);
+	}
+}
+
+static void add_cachestat(struct cachestat *to, const struct cachestat *from)
+{
+	to->nr_cache += from->nr_cache;
+	to->nr_dirty += from->nr_dirty;
+	to->nr_writeback += from->nr_writeback;
+	to->nr_evicted += from->nr_evicted;
+	to->nr_recently_evicted += from->nr_recently_evicted;
+}
+
+/* --total, sums the file (and its ranges) to ctl->total */
+static void add_total(struct fincore_control *ctl, struct fincore_state *st)
+{
+	struct fincore_state *tt = &ctl->total;
+	size_t i;
+
+	tt->sb.st_size += st->sb.st_size;
+	add_cachestat(&tt->cstat, &st->cstat);
+	if (!st->has_cstat && st->sb.st_size)
+		tt->has_cstat = 0;
+
+	if (st->nranges > tt->nranges) {
+		tt->ranges = xrealloc(tt->ranges, st->nranges * sizeof(struct fincore_range));
+		memset(tt->ranges + tt->nranges, 0,
+			(st->nranges - tt->nranges) * sizeof(struct fincore_range));
+		tt->nranges = st->nranges;
+	}
+	for (i = 0; i < st->nranges; i++) {
+		tt->ranges[i].size += st->ranges[i].size;
+		add_cachestat(&tt->ranges[i].cstat, &st->ranges[i].cstat);
+	}
+}
+
+static void add_output_state(struct fincore_control *ctl, struct fincore_state *st)
+{
+	size_t i;
+
+	if (!ctl->range_size) {
+		add_output_data(ctl, st->name, -1, st->sb.st_size,
+				&st->cstat, st->has_cstat);
+		return;
+	}
+	for (i = 0; i < st->nranges; i++)
+		add_output_data(ctl, st->name, i * ctl->range_size,
+				st->ranges[i].size,
+				&st->ranges[i].cstat, st->has_cstat);
+}
+
+/*
+ * Sets st->rc: <0 on error, 0 success, 1 ignore.
  */
-static int fincore_name(struct fincore_control *ctl,
-			const char *name,
-			struct stat *sb,
-			off_t *count_incore)
+static void fincore_name(struct fincore_control *ctl,
+			 struct fincore_state *st)
 {
 	int fd;
 	int rc = 0;
 
-	if ((fd = open (name, O_RDONLY)) < 0) {
-		warn(_("failed to open: %s"), name);
-		return -errno;
+	if ((fd = open (st->name, O_RDONLY)) < 0) {
+		warn(_("failed to open: %s"), st->name);
+		st->rc = -errno;
+		return;
 	}
 
-	if (fstat (fd, sb) < 0) {
-		warn(_("failed to do fstat: %s"), name);
+	if (fstat (fd, &st->sb) < 0) {
+		warn(_("failed to do fstat: %s"), st->name);
+		st->rc = -errno;
 		close (fd);
-		return -errno;
+		return;
 	}
 
-	if (S_ISDIR(sb->st_mode))
+	if (S_ISDIR(st->sb.st_mode))
 		rc = 1;			/* ignore */
 
-	else if (sb->st_size)
-		rc = fincore_fd(ctl, fd, name, sb->st_size, count_incore);
+	else if (st->sb.st_size) {
+		if (ctl->range_size)
+			init_ranges(ctl, st);
+		/* the pages vector from mincore() is necessary for --load and --evict */
+		rc = ctl->action ? 1 : fincore_cachestat(ctl, fd, st);
+		if (rc == 1) {
+			memset(&st->cstat, 0, sizeof(st->cstat));
+			rc = fincore_fd(ctl, fd, st);
+		}
+	}
 
 	close (fd);
-	return rc;
+	st->rc = rc;
+}
+
+static void fincore_output(struct fincore_control *ctl, struct fincore_state *st)
+{
+	switch (st->rc) {
+	case 0:
+		add_output_state(ctl, st);
+		if (ctl->show_total)
+			add_total(ctl, st);
+		break;
+	case 1:
+		break; /* ignore */
+	default:
+		ctl->status = EXIT_FAILURE;
+		break;
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *fincore_worker(void *data)
+{
+	struct fincore_control *ctl = (struct fincore_control *) data;
+
+	while (1) {
+		size_t idx;
+
+		pthread_mutex_lock(&ctl->lock);
+		idx = ctl->next++;
+		pthread_mutex_unlock(&ctl->lock);
+
+		if (idx >= ctl->nfiles)
+			break;
+		fincore_name(ctl, &ctl->files[idx]);
+	}
+	return NULL;
+}
+#endif
+
+/*
+ * Reads all queued files by threads and adds them to the output in the
+ * original order.
+ */
+static void fincore_flush(struct fincore_control *ctl)
+{
+	size_t i, nrun = 0;
+
+	if (!ctl->nfiles)
+		return;
+#ifdef HAVE_LIBPTHREAD
+	{
+		size_t nthreads = min(ctl->nthreads, ctl->nfiles);
+		pthread_t *threads = xcalloc(nthreads, sizeof(pthread_t));
+
+		ctl->next = 0;
+		for (nrun = 0; nthreads > 1 && nrun < nthreads; nrun++) {
+			if (pthread_create(&threads[nrun], NULL, fincore_worker, ctl) != 0)
+				break;
+		}
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+	}
+#endif
+	for (i = 0; i < ctl->nfiles; i++) {
+		struct fincore_state *st = &ctl->files[i];
+
+		if (!nrun)
+			fincore_name(ctl, st);	/* no thread started */
+		fincore_output(ctl, st);
+		free(st->name);
+		free(st->ranges);
+	}
+	ctl->nfiles = 0;
+}
+
+static void fincore_add_file(struct fincore_control *ctl, const char *name)
+{
+	struct fincore_state *st;
+
+	if (ctl->nthreads < 2) {
+		struct fincore_state one = { .name = (char *) name };
+
+		fincore_name(ctl, &one);
+		fincore_output(ctl, &one);
+		free(one.ranges);
+		return;
+	}
+
+	if (!ctl->files)
+		ctl->files = xcalloc(N_FILES_IN_BATCH, sizeof(struct fincore_state));
+
+	st = &ctl->files[ctl->nfiles++];
+	memset(st, 0, sizeof(*st));
+	st->name = xstrdup(name);
+
+	if (ctl->nfiles == N_FILES_IN_BATCH)
+		fincore_flush(ctl);
+}
+
+/* nftw() does not support private data */
+static struct fincore_control *walk_ctl;
+
+static int walk_file(const char *name, const struct stat *sb __attribute__((__unused__)),
+		     int type, struct FTW *ftw __attribute__((__unused__)))
+{
+	switch (type) {
+	case FTW_F:
+		fincore_add_file(walk_ctl, name);
+		break;
+	case FTW_DNR:
+		warnx(_("failed to read directory: %s"), name);
+		walk_ctl->status = EXIT_FAILURE;
+		break;
+	case FTW_NS:
+		warnx(_("failed to do stat: %s"), name);
+		walk_ctl->status = EXIT_FAILURE;
+		break;
+	default:
+		break;	/* directories, symlinks */
+	}
+	return 0;
 }
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -264,9 +721,15 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -J, --json            use JSON output format\n"), out);
 	fputs(_(" -b, --bytes           print sizes in bytes rather than in human readable format\n"), out);
+	fputs(_(" -H, --histogram <size> print data for every <size> bytes of the files\n"), out);
+	fputs(_(" -j, --parallel <num>  read files by <num> threads (0 means auto)\n"), out);
 	fputs(_(" -n, --noheadings      don't print headings\n"), out);
 	fputs(_(" -o, --output <list>   output columns\n"), out);
+	fputs(_(" -R, --recursive       recursively check all files in directories\n"), out);
 	fputs(_(" -r, --raw             use raw output format\n"), out);
+	fputs(_(" -t, --total           print total for all files\n"), out);
+	fputs(_("     --evict           remove resident pages of the files from memory\n"), out);
+	fputs(_("     --load            read not resident pages of the files to memory\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(23));
@@ -274,7 +737,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out, USAGE_COLUMNS);
 
 	for (i = 0; i < ARRAY_SIZE(infos); i++)
-		fprintf(out, " %11s  %s\n", infos[i].name, _(infos[i].help));
+		fprintf(out, " %22s  %s\n", infos[i].name, _(infos[i].help));
 
 	printf(USAGE_MAN_TAIL("fincore(1)"));
 
@@ -285,17 +748,29 @@ int main(int argc, char ** argv)
 {
 	int c;
 	size_t i;
-	int rc = EXIT_SUCCESS;
 	char *outarg = NULL;
+	long nthreads = 1;
+
+	enum {
+		OPT_EVICT = CHAR_MAX + 1,
+		OPT_LOAD
+	};
 
 	struct fincore_control ctl = {
-		.pagesize = getpagesize()
+		.pagesize = getpagesize(),
+		.status = EXIT_SUCCESS
 	};
 
 	static const struct option longopts[] = {
 		{ "bytes",      no_argument, NULL, 'b' },
+		{ "histogram",  required_argument, NULL, 'H' },
+		{ "total",      no_argument, NULL, 't' },
+		{ "evict",      no_argument, NULL, OPT_EVICT },
+		{ "load",       no_argument, NULL, OPT_LOAD },
 		{ "noheadings", no_argument, NULL, 'n' },
 		{ "output",     required_argument, NULL, 'o' },
+		{ "parallel",   required_argument, NULL, 'j' },
+		{ "recursive",  no_argument, NULL, 'R' },
 		{ "version",    no_argument, NULL, 'V' },
 		{ "help",	no_argument, NULL, 'h' },
 		{ "json",       no_argument, NULL, 'J' },
@@ -303,16 +778,54 @@ int main(int argc, char ** argv)
 		{ NULL, 0, NULL, 0 },
 	};
 
+	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
+		{ OPT_EVICT, OPT_LOAD },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
+
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long (argc, argv, "bno:JrVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long (argc, argv, "bH:j:no:JRrtVh", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'b':
 			ctl.bytes = 1;
 			break;
+		case 'j':
+			nthreads = strtou32_or_err(optarg, _("invalid number of threads argument"));
+			if (nthreads == 0)
+				nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+			break;
+		case 'R':
+			ctl.recursive = 1;
+			break;
+		case 'H':
+			ctl.range_size = strtosize_or_err(optarg, _("invalid histogram range size"));
+			if (ctl.range_size < (off_t) ctl.pagesize
+			    || ctl.range_size % ctl.pagesize)
+				errx(EXIT_FAILURE, _("histogram range size has to be a multiple of page size"));
+			break;
+		case OPT_EVICT:
+#ifndef HAVE_POSIX_FADVISE
+			errx(EXIT_FAILURE, _("--evict is unsupported on this system"));
+#endif
+			ctl.action = FINCORE_EVICT;
+			break;
+		case OPT_LOAD:
+			ctl.action = FINCORE_LOAD;
+			break;
+		case 't':
+			ctl.show_total = 1;
+			/* TRANSLATORS: the FILE column of the --total line */
+			ctl.total.name = _("total");
+			ctl.total.has_cstat = 1;
+			break;
 		case 'n':
 			ctl.noheadings = 1;
 			break;
@@ -344,6 +857,8 @@ int main(int argc, char ** argv)
 		columns[ncolumns++] = COL_PAGES;
 		columns[ncolumns++] = COL_SIZE;
 		columns[ncolumns++] = COL_FILE;
+		if (ctl.range_size)
+			columns[ncolumns++] = COL_OFFSET;
 	}
 
 	if (outarg && string_add_to_idarray(outarg, columns, ARRAY_SIZE(columns),
@@ -377,7 +892,12 @@ int main(int argc, char ** argv)
 				scols_column_set_json_type(cl, SCOLS_JSON_STRING);
 				break;
 			case COL_SIZE:
+			case COL_OFFSET:
 			case COL_RES:
+			case COL_DIRTY:
+			case COL_WRITEBACK:
+			case COL_EVICTED:
+			case COL_RECENTLY_EVICTED:
 				if (!ctl.bytes)
 					break;
 				/* fallthrough */
@@ -388,25 +908,38 @@ int main(int argc, char ** argv)
 		}
 	}
 
+#ifdef HAVE_LIBPTHREAD
+	ctl.nthreads = nthreads > 0 ? (size_t) nthreads : 1;
+	pthread_mutex_init(&ctl.lock, NULL);
+#else
+	ctl.nthreads = 1;
+	(void) nthreads;
+#endif
+	walk_ctl = &ctl;
+
 	for(; optind < argc; optind++) {
 		char *name = argv[optind];
-		struct stat sb;
-		off_t count_incore = 0;
 
-		switch (fincore_name(&ctl, name, &sb, &count_incore)) {
-		case 0:
-			add_output_data(&ctl, name, sb.st_size, count_incore);
-			break;
-		case 1:
-			break; /* ignore */
-		default:
-			rc = EXIT_FAILURE;
-			break;
+		if (!ctl.recursive)
+			fincore_add_file(&ctl, name);
+		else if (nftw(name, walk_file, 20, FTW_PHYS) != 0) {
+			warn(_("failed to walk: %s"), name);
+			ctl.status = EXIT_FAILURE;
 		}
 	}
+	fincore_flush(&ctl);
+
+	if (ctl.show_total) {
+		add_output_state(&ctl, &ctl.total);
+		free(ctl.total.ranges);
+	}
 
 	scols_print_table(ctl.tb);
 	scols_unref_table(ctl.tb);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_destroy(&ctl.lock);
+#endif
+	free(ctl.files);
 
-	return rc;
+	return ctl.status;
 }
@@ -9,6 +9,9 @@
 #include <libmount.h>
 #include <blkid.h>
 #include <sys/utsname.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "nls.h"
 #include "c.h"
@@ -17,10 +20,27 @@
 
 #include "findmnt.h"
 
+/* max number of threads to probe the devices */
+#define VERIFY_MAX_THREADS	16
+
+/* on-disk FS type of the source device, see verify_prefetch() */
+struct verify_probe {
+	const char	*devname;	/* from the cache, sorted */
+	char		*fstype;
+	int		ambi;
+};
+
 struct verify_context {
 	struct libmnt_fs	*fs;
 	struct libmnt_table	*tb;
 
+	struct verify_probe	*probes;
+	size_t			nprobes;
+	size_t			next;	/* the next probe for the threads */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t		lock;
+#endif
+
 	char	**fs_ary;
 	size_t	fs_num;
 	size_t  fs_alloc;
@@ -405,11 +425,152 @@ static int read_kernel_filesystems(struct verify_context *vfy)
 	return rc;
 }
 
+static int cmp_probes(const void *a, const void *b)
+{
+	return strcmp(((const struct verify_probe *) a)->devname,
+		      ((const struct verify_probe *) b)->devname);
+}
+
+static struct verify_probe *get_probe(struct verify_context *vfy, const char *devname)
+{
+	struct verify_probe key = { .devname = devname };
+
+	if (!vfy->nprobes)
+		return NULL;
+	return bsearch(&key, vfy->probes, vfy->nprobes,
+		       sizeof(struct verify_probe), cmp_probes);
+}
+
+/* The same as mnt_get_fstype() with the cache, but independent of the cache */
+static void probe_device(struct verify_probe *pr)
+{
+	blkid_probe bp;
+	const char *data;
+	int rc;
+
+	bp = blkid_new_probe_from_filename(pr->devname);
+	if (!bp)
+		return;
+
+	blkid_probe_enable_superblocks(bp, 1);
+	blkid_probe_set_superblocks_flags(bp,
+			BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+			BLKID_SUBLKS_TYPE);
+	blkid_probe_enable_partitions(bp, 1);
+	blkid_probe_set_partitions_flags(bp, BLKID_PARTS_ENTRY_DETAILS);
+
+	rc = blkid_do_safeprobe(bp);
+	if (!rc && !blkid_probe_lookup_value(bp, "TYPE", &data, NULL))
+		pr->fstype = xstrdup(data);
+	pr->ambi = rc == -2;
+
+	blkid_free_probe(bp);
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *probe_worker(void *data)
+{
+	struct verify_context *vfy = (struct verify_context *) data;
+
+	while (1) {
+		size_t idx;
+
+		pthread_mutex_lock(&vfy->lock);
+		idx = vfy->next++;
+		pthread_mutex_unlock(&vfy->lock);
+
+		if (idx >= vfy->nprobes)
+			break;
+		probe_device(&vfy->probes[idx]);
+	}
+	return NULL;
+}
+#endif
+
+/*
+ * Probe all source devices of the filesystems @fss before the verification.
+ * The probing is mostly I/O latency (e.g. SAN), so the devices are probed
+ * by more threads at once. Every device is probed only once, and the
+ * verification (and its output) is still serial, in the table order.
+ *
+ * It's used only with the cache, like libmount, otherwise every entry is
+ * probed in verify_fstype() as usually.
+ */
+static void verify_prefetch(struct verify_context *vfy, struct libmnt_fs **fss, size_t nfss)
+{
+	size_t i, n, nrun = 0;
+
+	if (!cache || nfss < 2)
+		return;
+
+	vfy->probes = xcalloc(nfss, sizeof(struct verify_probe));
+
+	for (i = 0; i < nfss; i++) {
+		struct libmnt_fs *fs = fss[i];
+		const char *src;
+		struct stat sb;
+
+		if (mnt_fs_is_pseudofs(fs) || mnt_fs_is_netfs(fs))
+			continue;
+		src = mnt_resolve_spec(mnt_fs_get_source(fs), cache);
+		if (!src || stat(src, &sb) != 0 || S_ISDIR(sb.st_mode))
+			continue;
+		vfy->probes[vfy->nprobes++].devname = src;
+	}
+	if (vfy->nprobes < 2) {
+		vfy->nprobes = 0;
+		return;		/* nothing to do in parallel */
+	}
+
+	qsort(vfy->probes, vfy->nprobes, sizeof(struct verify_probe), cmp_probes);
+	for (i = 1, n = 1; i < vfy->nprobes; i++) {
+		if (strcmp(vfy->probes[i].devname, vfy->probes[n - 1].devname) != 0)
+			vfy->probes[n++] = vfy->probes[i];
+	}
+	vfy->nprobes = n;
+
+	/* initialize the library before the threads */
+	blkid_init_debug(0);
+
+#ifdef HAVE_LIBPTHREAD
+	{
+		size_t nthreads = min((size_t) VERIFY_MAX_THREADS, vfy->nprobes);
+		pthread_t *threads = xcalloc(nthreads, sizeof(pthread_t));
+
+		pthread_mutex_init(&vfy->lock, NULL);
+		vfy->next = 0;
+		for (nrun = 0; nthreads > 1 && nrun < nthreads; nrun++) {
+			if (pthread_create(&threads[nrun], NULL, probe_worker, vfy) != 0)
+				break;
+		}
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+		pthread_mutex_destroy(&vfy->lock);
+		free(threads);
+	}
+#endif
+	if (!nrun) {
+		/* no thread started */
+		for (i = 0; i < vfy->nprobes; i++)
+			probe_device(&vfy->probes[i]);
+	}
+}
+
+static void free_probes(struct verify_context *vfy)
+{
+	size_t i;
+
+	for (i = 0; i < vfy->nprobes; i++)
+		free(vfy->probes[i].fstype);
+	free(vfy->probes);
+}
+
 static int verify_fstype(struct verify_context *vfy)
 {
 	char *src = mnt_resolve_spec(mnt_fs_get_source(vfy->fs), cache);
 	char *realtype = NULL;
 	const char *type;
+	struct verify_probe *pr;
 	int ambi = 0, isauto = 0, isswap = 0;
 
 	if (!src)
@@ -442,7 +603,12 @@ static int verify_fstype(struct verify_context *vfy)
 		if (!isswap && !isauto && !none && !is_supported_filesystem(vfy, type))
 			verify_warn(vfy, _("%s seems unsupported by the current kernel"), type);
 	}
-	realtype = mnt_get_fstype(src, &ambi, cache);
+	pr = get_probe(vfy, src);
+	if (pr) {
+		realtype = pr->fstype;
+		ambi = pr->ambi;
+	} else
+		realtype = mnt_get_fstype(src, &ambi, cache);
 
 	if (!realtype) {
 		if (isauto)
@@ -513,6 +679,8 @@ int verify_table(struct libmnt_table *tb)
 {
 	struct verify_context vfy = { .nerrors = 0 };
 	struct libmnt_iter *itr;
+	struct libmnt_fs *fs, **fss = NULL;
+	size_t i, nfss = 0, nalloc = 0;
 	int rc = 0;		/* overall return code (alloc errors, etc.) */
 	int check_order = is_listall_mode();
 	static int has_read_fs = 0;
@@ -531,7 +699,22 @@ int verify_table(struct libmnt_table *tb)
 		has_read_fs = 1;
 	}
 
-	while (rc == 0 && (vfy.fs = get_next_fs(tb, itr))) {
+	while ((fs = get_next_fs(tb, itr))) {
+		if (nfss == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			fss = xrealloc(fss, nalloc * sizeof(struct libmnt_fs *));
+		}
+		fss[nfss++] = fs;
+
+		if (flags & FL_FIRSTONLY)
+			break;
+		flags |= FL_NOSWAPMATCH;
+	}
+
+	verify_prefetch(&vfy, fss, nfss);
+
+	for (i = 0; rc == 0 && i < nfss; i++) {
+		vfy.fs = fss[i];
 		vfy.target_printed = 0;
 		vfy.no_fsck = 0;
 
@@ -539,10 +722,6 @@ int verify_table(struct libmnt_table *tb)
 			rc = verify_order(&vfy);
 		if (!rc)
 			rc = verify_filesystem(&vfy);
-
-		if (flags & FL_FIRSTONLY)
-			break;
-		flags |= FL_NOSWAPMATCH;
 	}
 
 done:
@@ -560,6 +739,8 @@ done:
 
 
 	free_proc_filesystems(&vfy);
+	free_probes(&vfy);
+	free(fss);
 
 	return rc != 0 ? rc : vfy.nerrors + parse_nerrors;
 }
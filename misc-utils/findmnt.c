@@ -31,6 +31,7 @@
 #include <assert.h>
 #include <poll.h>
 #include <sys/statvfs.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #ifdef HAVE_LIBUDEV
 # include <libudev.h>
@@ -46,6 +47,7 @@
 #include "xalloc.h"
 #include "optutils.h"
 #include "mangle.h"
+#include "procutils.h"
 
 #include "findmnt.h"
 
@@ -579,7 +581,8 @@ static char *get_data(struct libmnt_fs *fs, int num)
 		if (!devno)
 			break;
 
-		if ((flags & FL_RAW) || (flags & FL_EXPORT) || (flags & FL_JSON))
+		if ((flags & FL_RAW) || (flags & FL_EXPORT) || (flags & FL_JSON)
+		    || (flags & FL_BINARY))
 			xasprintf(&str, "%u:%u", major(devno), minor(devno));
 		else
 			xasprintf(&str, "%3u:%-3u", major(devno), minor(devno));
@@ -810,18 +813,105 @@ static char **append_tabfile(char **files, int *nfiles, char *filename)
 	return files;
 }
 
+/* mount namespaces of the already added --task PIDs */
+static struct stat *mntns;
+static size_t nmntns;
+
+/*
+ * Returns 1 if the namespace of @pid has been already added, 0 if not, or -1
+ * if the namespace is unknown.
+ */
+static int is_mntns_added(pid_t pid)
+{
+	char path[sizeof("/proc/%d/ns/mnt") + sizeof(stringify_value(INT_MAX))];
+	struct stat st;
+	size_t i;
+
+	snprintf(path, sizeof(path), "/proc/%d/ns/mnt", (int) pid);
+	if (stat(path, &st) != 0)
+		return -1;
+
+	for (i = 0; i < nmntns; i++) {
+		if (mntns[i].st_ino == st.st_ino && mntns[i].st_dev == st.st_dev)
+			return 1;
+	}
+
+	mntns = xrealloc(mntns, sizeof(struct stat) * (nmntns + 1));
+	mntns[nmntns++] = st;
+	return 0;
+}
+
+/*
+ * The tasks in the same mount namespace share the mount table, so the table is
+ * read for the first task of the namespace only.
+ */
 static char **append_pid_tabfile(char **files, int *nfiles, pid_t pid)
 {
 	char *path = NULL;
 
+	if (is_mntns_added(pid) == 1)
+		return files;
+
 	xasprintf(&path, "/proc/%d/mountinfo", (int) pid);
 	return append_tabfile(files, nfiles, path);
 }
 
+/*
+ * Adds a mount table for each mount namespace on the system. The tasks with
+ * unknown namespace (usually insufficient permissions) are ignored.
+ */
+static char **append_allns_tabfiles(char **files, int *nfiles)
+{
+	struct proc_processes *ps;
+	pid_t pid;
+
+	ps = proc_open_processes();
+	if (!ps)
+		err(EXIT_FAILURE, _("cannot open /proc"));
+
+	while (proc_next_pid(ps, &pid) == 0) {
+		char *path = NULL;
+
+		if (is_mntns_added(pid) != 0)
+			continue;
+		xasprintf(&path, "/proc/%d/mountinfo", (int) pid);
+		files = append_tabfile(files, nfiles, path);
+	}
+
+	proc_close_processes(ps);
+	return files;
+}
+
+/*
+ * Asks libmount to not parse the entries which cannot match -t and --target.
+ * The --target pattern may be a regular file (see enable_extra_target_match()),
+ * so all the entries below the mountpoint of the pattern are necessary.
+ */
+static void set_parser_prefilter(struct libmnt_table *tb, int nfiles, int tabtype)
+{
+	const char *types = get_match(COL_FSTYPE);
+	char *mnt = NULL;
+
+	if (tabtype == TABTYPE_KERNEL && !nfiles
+	    && !(flags & FL_NOCACHE)
+	    && get_match(COL_TARGET) && !get_match(COL_SOURCE)) {
+		char *cn = mnt_resolve_path(get_match(COL_TARGET), NULL);
+
+		if (cn)
+			mnt = mnt_get_mountpoint(cn);
+		free(cn);
+	}
+
+	if (types || mnt)
+		mnt_table_set_parser_prefilter(tb, -1, types, mnt);
+	free(mnt);
+}
+
 /* calls libmount fstab/mtab/mountinfo parser */
 static struct libmnt_table *parse_tabfiles(char **files,
 					   int nfiles,
-					   int tabtype)
+					   int tabtype,
+					   int prefilter)
 {
 	struct libmnt_table *tb;
 	int rc = 0;
@@ -832,6 +922,8 @@ static struct libmnt_table *parse_tabfiles(char **files,
 		return NULL;
 	}
 	mnt_table_set_parser_errcb(tb, parser_errcb);
+	if (prefilter)
+		set_parser_prefilter(tb, nfiles, tabtype);
 
 	do {
 		/* NULL means that libmount will use default paths */
@@ -853,6 +945,11 @@ static struct libmnt_table *parse_tabfiles(char **files,
 			rc = mnt_table_parse_file(tb, path);
 			break;
 		}
+		if (rc && (flags & FL_ALLNS) && (rc == -ENOENT || rc == -ESRCH)) {
+			/* the task has been terminated in the meantime */
+			rc = 0;
+			continue;
+		}
 		if (rc) {
 			mnt_unref_table(tb);
 			warn(_("can't read %s"), path);
@@ -1242,7 +1339,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputc('\n', out);
 
 	fputs(_(" -A, --all              disable all built-in filters, print all filesystems\n"), out);
+	fputs(_("     --all-namespaces   read mount tables of all mount namespaces\n"), out);
 	fputs(_(" -a, --ascii            use ASCII chars for tree formatting\n"), out);
+	fputs(_("     --binary           use binary output format\n"), out);
 	fputs(_(" -b, --bytes            print sizes in bytes rather than in human readable format\n"), out);
 	fputs(_(" -C, --nocanonicalize   don't canonicalize when comparing paths\n"), out);
 	fputs(_(" -c, --canonicalize     canonicalize printed paths\n"), out);
@@ -1314,11 +1413,15 @@ int main(int argc, char *argv[])
 		FINDMNT_OPT_PSEUDO,
 		FINDMNT_OPT_REAL,
 		FINDMNT_OPT_VFS_ALL,
-		FINDMNT_OPT_SHADOWED
+		FINDMNT_OPT_SHADOWED,
+		FINDMNT_OPT_ALLNS,
+		FINDMNT_OPT_BINARY
 	};
 
 	static const struct option longopts[] = {
 		{ "all",	    no_argument,       NULL, 'A'		 },
+		{ "all-namespaces", no_argument,       NULL, FINDMNT_OPT_ALLNS	 },
+		{ "binary",	    no_argument,       NULL, FINDMNT_OPT_BINARY },
 		{ "ascii",	    no_argument,       NULL, 'a'		 },
 		{ "bytes",	    no_argument,       NULL, 'b'		 },
 		{ "canonicalize",   no_argument,       NULL, 'c'		 },
@@ -1366,9 +1469,11 @@ int main(int argc, char *argv[])
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
 		{ 'C', 'c'},			/* [no]canonicalize */
 		{ 'C', 'e' },			/* nocanonicalize, evaluate */
-		{ 'J', 'P', 'r','x' },		/* json,pairs,raw,verify */
+		{ 'J', 'P', 'r','x',		/* json,pairs,raw,verify */
+		  FINDMNT_OPT_BINARY },		/* binary */
 		{ 'M', 'T' },			/* mountpoint, target */
-		{ 'N','k','m','s' },		/* task,kernel,mtab,fstab */
+		{ 'N','k','m','s',		/* task,kernel,mtab,fstab */
+		  FINDMNT_OPT_ALLNS },		/* all-namespaces */
 		{ 'P','l','r','x' },		/* pairs,list,raw,verify */
 		{ 'p','x' },			/* poll,verify */
 		{ 'm','p','s' },		/* mtab,poll,fstab */
@@ -1540,6 +1645,13 @@ int main(int argc, char *argv[])
 		case FINDMNT_OPT_SHADOWED:
 			flags |= FL_SHADOWED;
 			break;
+		case FINDMNT_OPT_BINARY:
+			flags |= FL_BINARY;
+			break;
+		case FINDMNT_OPT_ALLNS:
+			flags |= FL_ALLNS;
+			tabtype = TABTYPE_KERNEL;
+			break;
 
 		case 'h':
 			usage();
@@ -1578,6 +1690,9 @@ int main(int argc, char *argv[])
 	if (!tabtype)
 		tabtype = verify ? TABTYPE_FSTAB : TABTYPE_KERNEL;
 
+	if (flags & FL_ALLNS)
+		tabfiles = append_allns_tabfiles(tabfiles, &ntabfiles);
+
 	if ((flags & FL_POLL) && ntabfiles > 1)
 		errx(EXIT_FAILURE, _("--poll accepts only one file, but more specified by --tab-file"));
 
@@ -1619,7 +1734,13 @@ int main(int argc, char *argv[])
 	 */
 	mnt_init_debug(0);
 
-	tb = parse_tabfiles(tabfiles, ntabfiles, tabtype);
+	/*
+	 * The entries may be filtered out by the parser if the output does not
+	 * depend on the other entries (tree, --invert, --uniq, --shadowed).
+	 */
+	tb = parse_tabfiles(tabfiles, ntabfiles, tabtype,
+			!verify && !force_tree
+			&& !(flags & (FL_TREE | FL_INVERT | FL_UNIQ | FL_SHADOWED | FL_POLL)));
 	if (!tb)
 		goto leave;
 
@@ -1665,10 +1786,11 @@ int main(int argc, char *argv[])
 	scols_table_enable_raw(table,        !!(flags & FL_RAW));
 	scols_table_enable_export(table,     !!(flags & FL_EXPORT));
 	scols_table_enable_json(table,       !!(flags & FL_JSON));
+	scols_table_enable_binary(table,     !!(flags & FL_BINARY));
 	scols_table_enable_ascii(table,      !!(flags & FL_ASCII));
 	scols_table_enable_noheadings(table, !!(flags & FL_NOHEADINGS));
 
-	if (flags & FL_JSON)
+	if (flags & (FL_JSON | FL_BINARY))
 		scols_table_set_name(table, "filesystems");
 
 	for (i = 0; i < ncolumns; i++) {
@@ -1691,7 +1813,7 @@ int main(int argc, char *argv[])
 			goto leave;
 		}
 
-		if (flags & FL_JSON) {
+		if (flags & (FL_JSON | FL_BINARY)) {
 			switch (id) {
 			case COL_SIZE:
 			case COL_AVAIL:
@@ -1754,6 +1876,7 @@ leave:
 	mnt_unref_cache(cache);
 
 	free(tabfiles);
+	free(mntns);
 #ifdef HAVE_LIBUDEV
 	udev_unref(udev);
 #endif
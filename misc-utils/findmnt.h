@@ -22,6 +22,7 @@ enum {
 	FL_REAL		= (1 << 18),
 	FL_VFS_ALL	= (1 << 19),
 	FL_SHADOWED	= (1 << 20),
+	FL_ALLNS	= (1 << 27),
 
 	/* basic table settings */
 	FL_ASCII	= (1 << 21),
@@ -30,6 +31,7 @@ enum {
 	FL_EXPORT	= (1 << 24),
 	FL_TREE		= (1 << 25),
 	FL_JSON		= (1 << 26),
+	FL_BINARY	= (1 << 28),
 };
 
 extern struct libmnt_cache *cache;
@@ -32,10 +32,15 @@
 #include <sys/resource.h>	/* getrlimit, getrusage */
 #include <fcntl.h>		/* posix_fadvise */
 #include <ftw.h>		/* ftw */
-#include <search.h>		/* tsearch() and friends */
 #include <signal.h>		/* SIG*, sigaction */
 #include <getopt.h>		/* getopt_long() */
 #include <ctype.h>		/* tolower() */
+#include <dirent.h>		/* fdopendir(), readdir() */
+#include <sys/mman.h>		/* mmap() */
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "nls.h"
 #include "c.h"
@@ -43,6 +48,10 @@
 #include "strutils.h"
 #include "monotonic.h"
 #include "optutils.h"
+#include "sha1.h"
+#include "fileutils.h"
+#include "closestream.h"
+#include "all-io.h"
 
 #include <regex.h>		/* regcomp(), regsearch() */
 
@@ -52,10 +61,31 @@
 
 static int quiet;		/* don't print anything */
 
+/* default size of the read buffers (--io-size) */
+#define HL_IO_SIZE	(1024 * 1024)
+
+/**
+ * enum digest_state - Digests already calculated for the file
+ * @HL_DIGEST_INTRO:  The @intro digest is ready
+ * @HL_DIGEST_FULL:   The @digest is ready
+ * @HL_DIGEST_FAILED: Cannot read the file
+ */
+enum digest_state {
+	HL_DIGEST_INTRO		= (1 << 0),
+	HL_DIGEST_FULL		= (1 << 1),
+	HL_DIGEST_FAILED	= (1 << 2)
+};
+
+/* size of the first and the last block for the intro digest */
+#define HL_DIGEST_BLOCKSZ	4096
+
 /**
  * struct file - Information about a file
  * @st:       The stat buffer associated with the file
  * @next:     Next file with the same size
+ * @digests:  Already calculated digests, see #enum digest_state
+ * @intro:    SHA-1 of the first and the last block of the file
+ * @digest:   SHA-1 of the whole file
  * @basename: The offset off the basename in the filename
  * @path:     The path of the file
  *
@@ -64,6 +94,9 @@ static int quiet;		/* don't print anything */
 struct file {
 	struct stat st;
 	struct file *next;
+	unsigned int digests;
+	unsigned char intro[UL_SHA1LENGTH];
+	unsigned char digest[UL_SHA1LENGTH];
 	struct link {
 		struct link *next;
 		int basename;
@@ -98,6 +131,9 @@ enum log_level {
  * @linked: The number of files replaced by a hardlink to a master
  * @xattr_comparisons: The number of extended attribute comparisons
  * @comparisons: The number of comparisons
+ * @digests: The number of files read to calculate the whole file digest
+ * @bytes_read: The number of bytes read to calculate digests and to compare files
+ * @links_mem: The memory used for the paths
  * @saved: The (exaggerated) amount of space saved
  * @start_time: The time we started at
  */
@@ -107,6 +143,9 @@ static struct statistics {
 	size_t linked;
 	size_t xattr_comparisons;
 	size_t comparisons;
+	size_t digests;
+	uintmax_t bytes_read;
+	size_t links_mem;
 	double saved;
 	struct timeval start_time;
 } stats;
@@ -125,6 +164,10 @@ static struct statistics {
  * @minimise: Chose the file with the lowest link count as master
  * @keep_oldest: Choose the file with oldest timestamp as master (default = FALSE)
  * @dry_run: Specifies whether hardlink should not link files (default = FALSE)
+ * @trust_digest: Link files with the same digest without comparison (default = FALSE)
+ * @nthreads: Number of threads to walk directories and calculate digests (default = 1)
+ * @cache: The digests cache file (default = NULL)
+ * @io_size: Size of the read buffers for digests and comparison (default = 1 MiB)
  * @min_size: Minimum size of files to consider. (default = 1 byte)
  */
 static struct options {
@@ -143,6 +186,10 @@ static struct options {
 	unsigned int minimise:1;
 	unsigned int keep_oldest:1;
 	unsigned int dry_run:1;
+	unsigned int trust_digest:1;
+	unsigned int nthreads;
+	const char *cache;
+	size_t io_size;
 	uintmax_t min_size;
 } opts = {
 	/* default setting */
@@ -151,17 +198,30 @@ static struct options {
 	.respect_time = TRUE,
 	.respect_xattrs = FALSE,
 	.keep_oldest = FALSE,
+	.nthreads = 1,
+	.io_size = HL_IO_SIZE,
 	.min_size = 1
 };
 
-/*
- * files
+/**
+ * struct file_table - All the files
+ * @files:  Array of all the files (inodes)
+ * @nfiles: Number of the files
+ * @filesz: Allocated size of @files
+ * @hash:   Open addressing hash table of the files, see compare_nodes_ino()
+ * @hashsz: Size of @hash, power of 2
  *
- * A binary tree of files, managed using tsearch(). To see which nodes
- * are considered equal, see compare_nodes()
+ * The files are added to the end of the array and to the hash. After the
+ * walk, the array is sorted by file_table_group() and the files with the
+ * same size are linked by &struct file.next, see file_table_walk().
  */
-static void *files;
-static void *files_by_ino;
+static struct file_table {
+	struct file **files;
+	size_t nfiles;
+	size_t filesz;
+	struct file **hash;
+	size_t hashsz;
+} ftab;
 
 /*
  * last_signal
@@ -171,6 +231,11 @@ static void *files_by_ino;
  */
 static int last_signal;
 
+#ifdef HAVE_LIBPTHREAD
+/* protects @stats, used only with --parallel */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 /**
  * jlog - Logging for hardlink
  * @level: The log level
@@ -216,33 +281,12 @@ static int regexec_any(struct regex_link *pregs, const char *what)
 	return FALSE;
 }
 
-/**
- * compare_nodes - Node comparison function
- * @_a: The first node (a #struct file)
- * @_b: The second node (a #struct file)
- *
- * Compare the two nodes for the binary tree.
- */
-static int compare_nodes(const void *_a, const void *_b)
-{
-	const struct file *a = _a;
-	const struct file *b = _b;
-	int diff = 0;
-
-	if (diff == 0)
-		diff = CMP(a->st.st_dev, b->st.st_dev);
-	if (diff == 0)
-		diff = CMP(a->st.st_size, b->st.st_size);
-
-	return diff;
-}
-
 /**
  * compare_nodes_ino - Node comparison function
  * @_a: The first node (a #struct file)
  * @_b: The second node (a #struct file)
  *
- * Compare the two nodes for the binary tree.
+ * Compare the two nodes for the hash of files.
  */
 static int compare_nodes_ino(const void *_a, const void *_b)
 {
@@ -271,6 +315,7 @@ static int compare_nodes_ino(const void *_a, const void *_b)
 static void print_stats(void)
 {
 	struct timeval end = { 0, 0 }, delta = { 0, 0 };
+	double secs;
 	char *ssz;
 
 	gettime_monotonic(&end);
@@ -287,6 +332,23 @@ static void print_stats(void)
 #endif
 	jlog(JLOG_SUMMARY, _("%-15s %zu files"), _("Compared:"),
 	     stats.comparisons);
+	jlog(JLOG_SUMMARY, _("%-15s %zu files"), _("Digested:"),
+	     stats.digests);
+
+	ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
+				   SIZE_SUFFIX_SPACE |
+				   SIZE_DECIMAL_2DIGITS, stats.bytes_read);
+	secs = delta.tv_sec + delta.tv_usec / 1000000.0;
+	if (secs > 0) {
+		char *rsz = size_to_human_string(SIZE_SUFFIX_3LETTER |
+						 SIZE_SUFFIX_SPACE |
+						 SIZE_DECIMAL_2DIGITS,
+						 stats.bytes_read / secs);
+		jlog(JLOG_SUMMARY, _("%-15s %s (%s/s)"), _("Read:"), ssz, rsz);
+		free(rsz);
+	} else
+		jlog(JLOG_SUMMARY, "%-15s %s", _("Read:"), ssz);
+	free(ssz);
 
 	ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
 				   SIZE_SUFFIX_SPACE |
@@ -295,6 +357,16 @@ static void print_stats(void)
 	jlog(JLOG_SUMMARY, "%-15s %s", _("Saved:"), ssz);
 	free(ssz);
 
+	ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
+				   SIZE_SUFFIX_SPACE |
+				   SIZE_DECIMAL_2DIGITS,
+				   ftab.nfiles * sizeof(struct file) +
+				   ftab.filesz * sizeof(struct file *) +
+				   ftab.hashsz * sizeof(struct file *) +
+				   stats.links_mem);
+	jlog(JLOG_INFO, "%-15s %s", _("Memory:"), ssz);
+	free(ssz);
+
 	jlog(JLOG_SUMMARY, _("%-15s %"PRId64".%06"PRId64" seconds"), _("Duration:"),
 	     (int64_t)delta.tv_sec, (int64_t)delta.tv_usec);
 }
@@ -320,6 +392,34 @@ static int handle_interrupt(void)
 	return FALSE;
 }
 
+/**
+ * is_interrupted - Check for SIGINT and SIGTERM
+ *
+ * The same as handle_interrupt(), but usable in threads; SIGUSR1 is
+ * ignored.
+ */
+static int is_interrupted(void)
+{
+	return last_signal == SIGINT || last_signal == SIGTERM;
+}
+
+/**
+ * stats_add_read - Update statistics about digests, usable in threads
+ * @digests: Number of the new full digests
+ * @bytes: Number of the read bytes
+ */
+static void stats_add_read(size_t digests, uintmax_t bytes)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&stats_lock);
+#endif
+	stats.digests += digests;
+	stats.bytes_read += bytes;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&stats_lock);
+#endif
+}
+
 #ifdef HAVE_SYS_XATTR_H
 
 /**
@@ -521,12 +621,10 @@ static int file_xattrs_equal(const struct file *a, const struct file *b)
  */
 static int file_contents_equal(const struct file *a, const struct file *b)
 {
-	FILE *fa = NULL;
-	FILE *fb = NULL;
-	char buf_a[8192];
-	char buf_b[8192];
+	static char *buf_a, *buf_b;	/* opts.io_size, allocated once */
+	int fa = -1, fb = -1;
 	int cmp = 0;		/* zero => equal */
-	off_t off = 0;		/* current offset */
+	ssize_t ca = 0, cb = 0;
 
 	assert(a->links != NULL);
 	assert(b->links != NULL);
@@ -536,52 +634,457 @@ static int file_contents_equal(const struct file *a, const struct file *b)
 
 	stats.comparisons++;
 
-	if ((fa = fopen(a->links->path, "rb")) == NULL)
+	if ((fa = open(a->links->path, O_RDONLY | O_CLOEXEC)) < 0)
 		goto err;
-	if ((fb = fopen(b->links->path, "rb")) == NULL)
+	if ((fb = open(b->links->path, O_RDONLY | O_CLOEXEC)) < 0)
 		goto err;
 
 #if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
-	posix_fadvise(fileno(fa), 0, 0, POSIX_FADV_SEQUENTIAL);
-	posix_fadvise(fileno(fb), 0, 0, POSIX_FADV_SEQUENTIAL);
+	posix_fadvise(fa, 0, 0, POSIX_FADV_SEQUENTIAL);
+	posix_fadvise(fb, 0, 0, POSIX_FADV_SEQUENTIAL);
 #endif
+	if (!buf_a) {
+		buf_a = xmalloc(opts.io_size);
+		buf_b = xmalloc(opts.io_size);
+	}
 
 	while (!handle_interrupt() && cmp == 0) {
-		size_t ca;
-		size_t cb;
-
-		ca = fread(buf_a, 1, sizeof(buf_a), fa);
-		if (ca < sizeof(buf_a) && ferror(fa))
+		ca = read_all(fa, buf_a, opts.io_size);
+		if (ca < 0)
 			goto err;
-
-		cb = fread(buf_b, 1, sizeof(buf_b), fb);
-		if (cb < sizeof(buf_b) && ferror(fb))
+		cb = read_all(fb, buf_b, opts.io_size);
+		if (cb < 0)
 			goto err;
 
-		off += ca;
+		stats.bytes_read += ca + cb;
 
 		if ((ca != cb || ca == 0)) {
 			cmp = CMP(ca, cb);
 			break;
 		}
+		/* the mismatch ends the comparison on the first different block */
 		cmp = memcmp(buf_a, buf_b, ca);
 	}
  out:
-	if (fa != NULL)
-		fclose(fa);
-	if (fb != NULL)
-		fclose(fb);
+	if (fa >= 0)
+		close(fa);
+	if (fb >= 0)
+		close(fb);
 	return !handle_interrupt() && cmp == 0;
  err:
-	if (fa == NULL || fb == NULL)
-		warn(_("cannot open %s"), fa ? b->links->path : a->links->path);
+	if (fa < 0 || fb < 0)
+		warn(_("cannot open %s"), fa >= 0 ? b->links->path : a->links->path);
 	else
 		warn(_("cannot read %s"),
-		     ferror(fa) ? a->links->path : b->links->path);
+		     ca < 0 ? a->links->path : b->links->path);
 	cmp = 1;
 	goto out;
 }
 
+/**
+ * file_digest_update - Add a part of the file to the digest
+ * @f: The file
+ * @fd: The file descriptor
+ * @ctx: The SHA-1 context
+ * @off: The offset of the part
+ * @len: The size of the part
+ * @buf: The read buffer
+ * @bufsz: The size of the buffer
+ *
+ * Returns: zero on success, -1 on error.
+ */
+static int file_digest_update(struct file *f, int fd, UL_SHA1_CTX *ctx,
+			      off_t off, off_t len,
+			      unsigned char *buf, size_t bufsz)
+{
+	while (len > 0) {
+		ssize_t sz;
+
+		if (is_interrupted())
+			return -1;
+
+		sz = pread(fd, buf, min((off_t) bufsz, len), off);
+		if (sz < 0 && errno == EINTR)
+			continue;
+		if (sz <= 0) {
+			if (sz == 0)
+				errno = EIO;	/* truncated */
+			warn(_("cannot read %s"), f->links->path);
+			return -1;
+		}
+		ul_SHA1Update(ctx, buf, sz);
+		off += sz;
+		len -= sz;
+	}
+	return 0;
+}
+
+/**
+ * file_digest - Calculate a digest of the file
+ * @f: The file
+ * @what: HL_DIGEST_INTRO or HL_DIGEST_FULL
+ *
+ * The digests are calculated only once for each file; the intro digest
+ * is cheap (two blocks), the full digest reads the whole file. It's
+ * usable in threads for different files.
+ *
+ * Returns: zero on success, -1 on error.
+ */
+static int file_digest(struct file *f, unsigned int what)
+{
+	unsigned char intro[HL_DIGEST_BLOCKSZ];
+	UL_SHA1_CTX ctx;
+	off_t size = f->st.st_size;
+	int fd, rc;
+
+	assert(f->links != NULL);
+
+	if (f->digests & HL_DIGEST_FAILED)
+		return -1;
+	if (f->digests & what)
+		return 0;
+
+	fd = open(f->links->path, O_RDONLY);
+	if (fd < 0) {
+		warn(_("cannot open %s"), f->links->path);
+		goto fail;
+	}
+
+	ul_SHA1Init(&ctx);
+
+	if (what == HL_DIGEST_INTRO) {
+		off_t len = min(size, (off_t) HL_DIGEST_BLOCKSZ);
+
+		rc = file_digest_update(f, fd, &ctx, 0, len, intro, sizeof(intro));
+		if (rc == 0 && size > len) {
+			off_t tail = max(len, size - HL_DIGEST_BLOCKSZ);
+
+			rc = file_digest_update(f, fd, &ctx, tail, size - tail,
+						intro, sizeof(intro));
+			len += size - tail;
+		}
+		if (rc == 0) {
+			ul_SHA1Final(f->intro, &ctx);
+			stats_add_read(0, len);
+		}
+	} else {
+		unsigned char *buf = xmalloc(opts.io_size);
+
+		jlog(JLOG_VERBOSE2, _("Digesting %s"), f->links->path);
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		rc = file_digest_update(f, fd, &ctx, 0, size, buf, opts.io_size);
+		if (rc == 0) {
+			ul_SHA1Final(f->digest, &ctx);
+			stats_add_read(1, size);
+		}
+		free(buf);
+	}
+
+	close(fd);
+	if (rc != 0)
+		goto fail;
+
+	f->digests |= what;
+	return 0;
+fail:
+	/* don't try it again (and don't repeat the warning) */
+	if (!is_interrupted())
+		f->digests |= HL_DIGEST_FAILED;
+	return -1;
+}
+
+/**
+ * file_digests_equal - Compare digests of two files
+ * @a: The first file
+ * @b: The second file
+ * @what: HL_DIGEST_INTRO or HL_DIGEST_FULL
+ *
+ * Returns: %TRUE if the digests are equal, %FALSE if they differ or
+ * if one of the files cannot be read.
+ */
+static int file_digests_equal(struct file *a, struct file *b, unsigned int what)
+{
+	/* the intro digest is calculated from the whole file */
+	if (what == HL_DIGEST_FULL && a->st.st_size <= HL_DIGEST_BLOCKSZ * 2)
+		return TRUE;
+
+	if (file_digest(a, what) != 0 || file_digest(b, what) != 0)
+		return FALSE;
+
+	return what == HL_DIGEST_INTRO ?
+		memcmp(a->intro, b->intro, sizeof(a->intro)) == 0 :
+		memcmp(a->digest, b->digest, sizeof(a->digest)) == 0;
+}
+
+/**
+ * file_contents_match - Check whether the contents of two files are equal
+ * @a: The first file
+ * @b: The second file
+ *
+ * The files are compared in stages, every stage is more expensive than the
+ * previous one: the digest of the first and the last block, the digest of
+ * the whole file and the byte-by-byte comparison (unless --trust-digest).
+ * The digests are cached, so every file is read at most once for the
+ * digests, independently on the number of files with the same size.
+ */
+static int file_contents_match(struct file *a, struct file *b)
+{
+	if (!file_digests_equal(a, b, HL_DIGEST_INTRO))
+		return FALSE;
+	if (!file_digests_equal(a, b, HL_DIGEST_FULL))
+		return FALSE;
+	if (opts.trust_digest)
+		return !handle_interrupt();
+
+	return file_contents_equal(a, b);
+}
+
+/*
+ * The digests cache (--cache)
+ *
+ * The file contains the digests from the previous run, the entries are
+ * sorted by device and inode numbers, the file is mmap-ed and searched by
+ * bsearch(). The entry is used only if the size, the modification time and
+ * the change time of the file are the same. The numbers are in the native
+ * byte order, the cache is not portable between architectures.
+ *
+ *	header:	struct cache_header
+ *	data:	nents x struct cache_entry
+ */
+#define HL_CACHE_MAGIC		"HLDIGEST"
+#define HL_CACHE_VERSION	1
+
+struct cache_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	entsz;		/* sizeof(struct cache_entry) */
+	uint64_t	nents;
+};
+
+struct cache_entry {
+	uint64_t	dev;
+	uint64_t	ino;
+	uint64_t	size;
+	int64_t		mtime_sec;
+	int64_t		ctime_sec;
+	uint32_t	mtime_nsec;
+	uint32_t	ctime_nsec;
+	uint32_t	digests;	/* HL_DIGEST_{INTRO,FULL} */
+	uint32_t	reserved;
+	unsigned char	intro[UL_SHA1LENGTH];
+	unsigned char	digest[UL_SHA1LENGTH];
+};
+
+static struct digest_cache {
+	void			*map;
+	size_t			mapsz;
+	const struct cache_entry *ents;
+	size_t			nents;
+
+	/* the new cache */
+	struct cache_entry	*new;
+	size_t			nnew;
+	size_t			newsz;
+} cache;
+
+static int cmp_cache_entries(const void *_a, const void *_b)
+{
+	const struct cache_entry *a = _a;
+	const struct cache_entry *b = _b;
+	int diff = CMP(a->dev, b->dev);
+
+	if (diff == 0)
+		diff = CMP(a->ino, b->ino);
+	return diff;
+}
+
+static void stat_to_cache_entry(const struct stat *st, struct cache_entry *e)
+{
+	memset(e, 0, sizeof(*e));
+	e->dev = st->st_dev;
+	e->ino = st->st_ino;
+	e->size = st->st_size;
+	e->mtime_sec = st->st_mtim.tv_sec;
+	e->mtime_nsec = st->st_mtim.tv_nsec;
+	e->ctime_sec = st->st_ctim.tv_sec;
+	e->ctime_nsec = st->st_ctim.tv_nsec;
+}
+
+/**
+ * cache_load - Map the digests cache
+ *
+ * The missing file is not an error, the cache is created at the end of
+ * the run. The broken file is ignored (and replaced).
+ */
+static void cache_load(void)
+{
+	const struct cache_header *hdr;
+	struct stat st;
+	int fd;
+
+	fd = open(opts.cache, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), opts.cache);
+		return;
+	}
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(*hdr))
+		goto bad;
+
+	cache.mapsz = st.st_size;
+	cache.map = mmap(NULL, cache.mapsz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (cache.map == MAP_FAILED) {
+		cache.map = NULL;
+		goto bad;
+	}
+
+	hdr = cache.map;
+	if (memcmp(hdr->magic, HL_CACHE_MAGIC, sizeof(hdr->magic)) != 0
+	    || hdr->version != HL_CACHE_VERSION
+	    || hdr->entsz != sizeof(struct cache_entry)
+	    || hdr->nents > (cache.mapsz - sizeof(*hdr)) / sizeof(struct cache_entry))
+		goto bad;
+
+	cache.ents = (const struct cache_entry *) (hdr + 1);
+	cache.nents = hdr->nents;
+	close(fd);
+
+	jlog(JLOG_VERBOSE1, _("Loaded %zu digests from %s"), cache.nents, opts.cache);
+	return;
+bad:
+	warnx(_("%s: ignore unsupported or broken cache"), opts.cache);
+	if (cache.map)
+		munmap(cache.map, cache.mapsz);
+	cache.map = NULL;
+	close(fd);
+}
+
+/**
+ * cache_lookup - Set digests of a file from the cache
+ * @f: The new file
+ */
+static void cache_lookup(struct file *f)
+{
+	const struct cache_entry *e;
+	struct cache_entry key;
+
+	if (!cache.nents)
+		return;
+
+	stat_to_cache_entry(&f->st, &key);
+	e = bsearch(&key, cache.ents, cache.nents, sizeof(key), cmp_cache_entries);
+	if (!e || e->size != key.size
+	    || e->mtime_sec != key.mtime_sec || e->mtime_nsec != key.mtime_nsec
+	    || e->ctime_sec != key.ctime_sec || e->ctime_nsec != key.ctime_nsec)
+		return;
+
+	if (e->digests & HL_DIGEST_INTRO) {
+		memcpy(f->intro, e->intro, sizeof(f->intro));
+		f->digests |= HL_DIGEST_INTRO;
+	}
+	if (e->digests & HL_DIGEST_FULL) {
+		memcpy(f->digest, e->digest, sizeof(f->digest));
+		f->digests |= HL_DIGEST_FULL;
+	}
+}
+
+/**
+ * cache_collector - Add a file to the new cache
+ * @f: The file
+ *
+ * Adds the digests of the file to the new cache. The linked files are
+ * stat-ed again, the change time is modified by linking.
+ */
+static void cache_collector(struct file *f)
+{
+	struct cache_entry *e;
+	struct stat st;
+
+	if (!(f->digests & (HL_DIGEST_INTRO | HL_DIGEST_FULL)))
+		return;
+	if (opts.dry_run)
+		st = f->st;	/* the links are moved also in dry-run mode */
+	else if (!f->links)
+		return;		/* replaced by links to another file */
+	else if (lstat(f->links->path, &st) != 0
+		 || st.st_dev != f->st.st_dev || st.st_ino != f->st.st_ino)
+		return;
+
+	if (cache.nnew == cache.newsz) {
+		cache.newsz = max(cache.newsz * 2, (size_t) 1024);
+		cache.new = xrealloc(cache.new, cache.newsz * sizeof(struct cache_entry));
+	}
+	e = &cache.new[cache.nnew++];
+
+	stat_to_cache_entry(&st, e);
+	e->digests = f->digests & (HL_DIGEST_INTRO | HL_DIGEST_FULL);
+	memcpy(e->intro, f->intro, sizeof(e->intro));
+	memcpy(e->digest, f->digest, sizeof(e->digest));
+}
+
+/**
+ * cache_save - Replace the digests cache
+ *
+ * The cache contains the digests of all the files from this run. The
+ * file is replaced atomically.
+ */
+static void cache_save(void)
+{
+	struct cache_header hdr = {
+		.version = HL_CACHE_VERSION,
+		.entsz = sizeof(struct cache_entry)
+	};
+	char *tmp = NULL;
+	FILE *out = NULL;
+	size_t i;
+	int fd;
+
+
+	for (i = 0; i < ftab.nfiles; i++)
+		cache_collector(ftab.files[i]);
+	if (cache.nnew)
+		qsort(cache.new, cache.nnew, sizeof(struct cache_entry), cmp_cache_entries);
+
+	memcpy(hdr.magic, HL_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.nents = cache.nnew;
+
+	xasprintf(&tmp, "%s.XXXXXX", opts.cache);
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0 || !(out = fdopen(fd, "w"))) {
+		if (fd >= 0)
+			close(fd);
+		warn(_("cannot create %s"), tmp);
+		goto done;
+	}
+	if (fwrite(&hdr, sizeof(hdr), 1, out) != 1
+	    || (cache.nnew && fwrite(cache.new, sizeof(struct cache_entry),
+				     cache.nnew, out) != cache.nnew)
+	    || close_stream(out) != 0) {
+		warn(_("write failed: %s"), tmp);
+		unlink(tmp);
+		goto done;
+	}
+	out = NULL;
+	if (rename(tmp, opts.cache) != 0) {
+		warn(_("cannot rename %s to %s"), tmp, opts.cache);
+		unlink(tmp);
+	} else
+		jlog(JLOG_VERBOSE1, _("Saved %zu digests to %s"), cache.nnew, opts.cache);
+done:
+	if (out)
+		fclose(out);
+	free(tmp);
+	free(cache.new);
+	cache.new = NULL;
+	cache.nnew = cache.newsz = 0;
+	if (cache.map)
+		munmap(cache.map, cache.mapsz);
+	cache.map = NULL;
+	cache.nents = 0;
+}
+
 /**
  * file_may_link_to - Check whether a file may replace another one
  * @a: The first file
@@ -591,7 +1094,7 @@ static int file_contents_equal(const struct file *a, const struct file *b)
  * together. If the two files are identical, the result will be FALSE,
  * as replacing a link with an identical one is stupid.
  */
-static int file_may_link_to(const struct file *a, const struct file *b)
+static int file_may_link_to(struct file *a, struct file *b)
 {
 	return (a->st.st_size != 0 &&
 		a->st.st_size == b->st.st_size &&
@@ -606,7 +1109,7 @@ static int file_may_link_to(const struct file *a, const struct file *b)
 		 || strcmp(a->links->path + a->links->basename,
 			   b->links->path + b->links->basename) == 0) &&
 		(!opts.respect_xattrs || file_xattrs_equal(a, b)) &&
-		file_contents_equal(a, b));
+		file_contents_match(a, b));
 }
 
 /**
@@ -711,50 +1214,176 @@ static int file_link(struct file *a, struct file *b)
 	return TRUE;
 }
 
+/* hash of (dev, ino) and the basename for --respect-name */
+static size_t file_hash(const struct file *f)
+{
+	uint64_t h = ((uint64_t) f->st.st_ino * 0x9E3779B97F4A7C15ULL)
+		     ^ ((uint64_t) f->st.st_dev * 0xC2B2AE3D27D4EB4FULL);
+
+	if (opts.respect_name) {
+		const char *p = f->links->path + f->links->basename;
+
+		for (; *p; p++)
+			h = (h ^ (unsigned char) *p) * 0x100000001B3ULL;
+	}
+	return h ^ (h >> 32);
+}
+
+static void file_table_rehash(size_t hashsz)
+{
+	size_t i;
+
+	free(ftab.hash);
+	ftab.hashsz = hashsz;
+	ftab.hash = xcalloc(hashsz, sizeof(struct file *));
+
+	for (i = 0; i < ftab.nfiles; i++) {
+		size_t h = file_hash(ftab.files[i]) & (hashsz - 1);
+
+		while (ftab.hash[h])
+			h = (h + 1) & (hashsz - 1);
+		ftab.hash[h] = ftab.files[i];
+	}
+}
+
 /**
- * inserter - Callback function for nftw()
+ * file_table_add - Add a file to the table of files
+ * @fil: The new file
+ *
+ * Returns: the already known file with the same inode (and the same
+ * basename for --respect-name), or @fil if the file has been added.
+ */
+static struct file *file_table_add(struct file *fil)
+{
+	size_t h;
+
+	/* keep the hash at most 3/4 full */
+	if ((ftab.nfiles + 1) * 4 > ftab.hashsz * 3)
+		file_table_rehash(max(ftab.hashsz * 2, (size_t) 1024));
+
+	h = file_hash(fil) & (ftab.hashsz - 1);
+	while (ftab.hash[h]) {
+		if (compare_nodes_ino(fil, ftab.hash[h]) == 0)
+			return ftab.hash[h];
+		h = (h + 1) & (ftab.hashsz - 1);
+	}
+
+	if (ftab.nfiles == ftab.filesz) {
+		ftab.filesz = max(ftab.filesz * 2, (size_t) 1024);
+		ftab.files = xrealloc(ftab.files, ftab.filesz * sizeof(struct file *));
+	}
+	ftab.files[ftab.nfiles++] = fil;
+	ftab.hash[h] = fil;
+	return fil;
+}
+
+/*
+ * Sorts the files by device and size, the files with the same size are
+ * sorted by file_compare(), the master file is the first.
+ */
+static int cmp_groups(const void *_a, const void *_b)
+{
+	const struct file *a = *(const struct file **) _a;
+	const struct file *b = *(const struct file **) _b;
+	int diff = 0;
+
+	if (diff == 0)
+		diff = CMP(a->st.st_dev, b->st.st_dev);
+	if (diff == 0)
+		diff = CMP(a->st.st_size, b->st.st_size);
+	if (diff == 0)
+		diff = file_compare(b, a);
+
+	return diff;
+}
+
+static inline int same_group(const struct file *a, const struct file *b)
+{
+	return a->st.st_dev == b->st.st_dev && a->st.st_size == b->st.st_size;
+}
+
+/**
+ * file_table_group - Link the files with the same size
+ *
+ * Called after the walk; the hash is not needed anymore.
+ */
+static void file_table_group(void)
+{
+	size_t i;
+
+	free(ftab.hash);
+	ftab.hash = NULL;
+	ftab.hashsz = 0;
+
+	if (!ftab.nfiles)
+		return;
+
+	qsort(ftab.files, ftab.nfiles, sizeof(struct file *), cmp_groups);
+
+	for (i = 0; i < ftab.nfiles; i++) {
+		struct file *f = ftab.files[i];
+
+		f->next = i + 1 < ftab.nfiles && same_group(f, ftab.files[i + 1]) ?
+				ftab.files[i + 1] : NULL;
+	}
+}
+
+/**
+ * file_table_walk - Call a function for all lists of files with the same size
+ * @fn: The function, called with the first file of the list
+ */
+static void file_table_walk(void (*fn)(struct file *))
+{
+	size_t i;
+
+	for (i = 0; i < ftab.nfiles; i++) {
+		if (i == 0 || !same_group(ftab.files[i - 1], ftab.files[i]))
+			fn(ftab.files[i]);
+	}
+}
+
+/**
+ * insert_file - Add a file to the table of files
  * @fpath: The path of the file being visited
  * @sb:    The stat information of the file
  * @typeflag: The type flag
  * @ftwbuf:   Contains current level of nesting and offset of basename
  *
- * Called by nftw() for the files. See the manual page for nftw() for
- * further information.
+ * Does not handle signals, so it's usable in the walker threads (with the
+ * walker locked).
  */
-static int inserter(const char *fpath, const struct stat *sb,
-		    int typeflag, struct FTW *ftwbuf)
+static void insert_file(const char *fpath, const struct stat *sb,
+			int typeflag, struct FTW *ftwbuf)
 {
-	struct file *fil;
-	struct file **node;
+	struct file *fil, *node;
 	size_t pathlen;
 	int included;
 	int excluded;
 
-	if (handle_interrupt())
-		return 1;
 	if (typeflag == FTW_DNR || typeflag == FTW_NS)
 		warn(_("cannot read %s"), fpath);
 	if (typeflag != FTW_F || !S_ISREG(sb->st_mode))
-		return 0;
+		return;
 
 	included = regexec_any(opts.include, fpath);
 	excluded = regexec_any(opts.exclude, fpath);
 
 	if ((opts.exclude && excluded && !included) ||
 	    (!opts.exclude && opts.include && !included))
-		return 0;
+		return;
 
 	stats.files++;
 
 	if ((uintmax_t) sb->st_size < opts.min_size) {
 		jlog(JLOG_VERBOSE1,
 		     _("Skipped %s (smaller than configured size)"), fpath);
-		return 0;
+		return;
 	}
 
 	jlog(JLOG_VERBOSE2, _("Visiting %s (file %zu)"), fpath, stats.files);
 
 	pathlen = strlen(fpath) + 1;
+	stats.links_mem += sizeof(struct link) + pathlen;
 
 	fil = xcalloc(1, sizeof(*fil));
 	fil->links = xcalloc(1, sizeof(struct link) + pathlen);
@@ -765,75 +1394,51 @@ static int inserter(const char *fpath, const struct stat *sb,
 
 	memcpy(fil->links->path, fpath, pathlen);
 
-	node = tsearch(fil, &files_by_ino, compare_nodes_ino);
+	node = file_table_add(fil);
 
-	if (node == NULL)
-		goto fail;
-
-	if (*node != fil) {
+	if (node != fil) {
 		/* Already known inode, add link to inode information */
-		assert((*node)->st.st_dev == sb->st_dev);
-		assert((*node)->st.st_ino == sb->st_ino);
+		assert(node->st.st_dev == sb->st_dev);
+		assert(node->st.st_ino == sb->st_ino);
 
-		fil->links->next = (*node)->links;
-		(*node)->links = fil->links;
+		fil->links->next = node->links;
+		node->links = fil->links;
 
 		free(fil);
-	} else {
-		/* New inode, insert into by-size table */
-		node = tsearch(fil, &files, compare_nodes);
-
-		if (node == NULL)
-			goto fail;
-
-		if (*node != fil) {
-			struct file *l;
-
-			if (file_compare(fil, *node) >= 0) {
-				fil->next = *node;
-				*node = fil;
-			} else {
-				for (l = *node; l != NULL; l = l->next) {
-					if (l->next != NULL
-					    && file_compare(fil, l->next) < 0)
-						continue;
-
-					fil->next = l->next;
-					l->next = fil;
-
-					break;
-				}
-			}
-		}
-	}
-
-	return 0;
+	} else if (opts.cache)
+		/* New inode */
+		cache_lookup(fil);
+}
 
- fail:
-	warn(_("cannot continue"));	/* probably ENOMEM */
+/**
+ * inserter - Callback function for nftw()
+ * @fpath: The path of the file being visited
+ * @sb:    The stat information of the file
+ * @typeflag: The type flag
+ * @ftwbuf:   Contains current level of nesting and offset of basename
+ *
+ * Called by nftw() for the files. See the manual page for nftw() for
+ * further information.
+ */
+static int inserter(const char *fpath, const struct stat *sb,
+		    int typeflag, struct FTW *ftwbuf)
+{
+	if (handle_interrupt())
+		return 1;
+	insert_file(fpath, sb, typeflag, ftwbuf);
 	return 0;
 }
 
 /**
- * visitor - Callback for twalk()
- * @nodep: Pointer to a pointer to a #struct file
- * @which: At which point this visit is (preorder, postorder, endorder)
- * @depth: The depth of the node in the tree
+ * visitor - Callback for file_table_walk()
+ * @master: The first file in the list of files with the same size
  *
- * Visit the nodes in the binary tree. For each node, call hardlinker()
- * on each #struct file in the linked list of #struct file instances located
- * at that node.
+ * Link the equal files in the linked list of #struct file instances.
  */
-static void visitor(const void *nodep, const VISIT which, const int depth)
+static void visitor(struct file *master)
 {
-	struct file *master = *(struct file **)nodep;
 	struct file *other;
 
-	(void)depth;
-
-	if (which != leaf && which != endorder)
-		return;
-
 	for (; master != NULL; master = master->next) {
 		if (handle_interrupt())
 			exit(EXIT_FAILURE);
@@ -857,6 +1462,312 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 	}
 }
 
+#ifdef HAVE_LIBPTHREAD
+/**
+ * struct walker - Shared state of the parallel directory walk
+ * @dirs:  Stack of the directories to be read
+ * @ndirs: Number of the directories in the stack
+ * @dirsz: Allocated size of the stack
+ * @busy:  Number of threads reading a directory
+ * @lock:  Protects the walker and the table of files (see insert_file())
+ * @cond:  Signals a new directory in the stack or the end of the walk
+ *
+ * The threads take the directories from the shared stack and push the
+ * subdirectories back, so an idle thread continues with any directory
+ * found by the other threads.
+ */
+static struct walker {
+	char **dirs;
+	size_t ndirs;
+	size_t dirsz;
+	size_t busy;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} walker = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+/* the walker has to be locked if there are threads */
+static void walker_push(char *path)
+{
+	if (walker.ndirs == walker.dirsz) {
+		walker.dirsz = max(walker.dirsz * 2, (size_t) 64);
+		walker.dirs = xrealloc(walker.dirs, walker.dirsz * sizeof(char *));
+	}
+	walker.dirs[walker.ndirs++] = path;
+	pthread_cond_signal(&walker.cond);
+}
+
+/**
+ * walker_read_dir - Read one directory
+ * @path: The path of the directory
+ *
+ * The entries are stat-ed relative to the directory file descriptor. The
+ * subdirectories are added to the walker stack and the files are added
+ * to the trees by insert_file(), the same as for nftw(FTW_PHYS).
+ */
+static void walker_read_dir(const char *path)
+{
+	size_t len = strlen(path);
+	const char *sep = len && path[len - 1] == '/' ? "" : "/";
+	struct dirent *d;
+	DIR *dir;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0 || !(dir = fdopendir(fd))) {
+		if (fd >= 0)
+			close(fd);
+		warn(_("cannot read %s"), path);
+		return;
+	}
+
+	while (!is_interrupted() && (d = readdir(dir))) {
+		struct FTW ftw = { .level = 0 };
+		struct stat st;
+		char *fpath;
+
+		if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+			continue;
+
+		xasprintf(&fpath, "%s%s%s", path, sep, d->d_name);
+
+		if (fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+			warn(_("cannot read %s"), fpath);
+			free(fpath);
+			continue;
+		}
+
+		pthread_mutex_lock(&walker.lock);
+		if (S_ISDIR(st.st_mode)) {
+			walker_push(fpath);
+			fpath = NULL;
+		} else {
+			ftw.base = len + strlen(sep);
+			insert_file(fpath, &st, FTW_F, &ftw);
+		}
+		pthread_mutex_unlock(&walker.lock);
+		free(fpath);
+	}
+
+	closedir(dir);
+}
+
+static void *walker_worker(void *data __attribute__((__unused__)))
+{
+	pthread_mutex_lock(&walker.lock);
+	while (1) {
+		char *path;
+
+		while (!walker.ndirs && walker.busy && !is_interrupted())
+			pthread_cond_wait(&walker.cond, &walker.lock);
+		if (!walker.ndirs || is_interrupted())
+			break;
+
+		path = walker.dirs[--walker.ndirs];
+		walker.busy++;
+		pthread_mutex_unlock(&walker.lock);
+
+		walker_read_dir(path);
+		free(path);
+
+		pthread_mutex_lock(&walker.lock);
+		walker.busy--;
+	}
+	/* wake up the others, the stack is empty and nobody is busy */
+	pthread_cond_broadcast(&walker.cond);
+	pthread_mutex_unlock(&walker.lock);
+	return NULL;
+}
+
+/**
+ * walk_parallel - Walk the directories by threads
+ * @paths: The directories and files from the command line
+ * @npaths: Number of @paths
+ */
+static void walk_parallel(char **paths, int npaths)
+{
+	pthread_t *threads;
+	size_t i, nrun;
+	int n;
+
+	for (n = 0; n < npaths; n++) {
+		struct stat st;
+
+		if (lstat(paths[n], &st) != 0) {
+			warn(_("cannot process %s"), paths[n]);
+			continue;
+		}
+		if (S_ISDIR(st.st_mode))
+			walker_push(xstrdup(paths[n]));
+		else {
+			const char *p = strrchr(paths[n], '/');
+			struct FTW ftw = { .base = p ? p - paths[n] + 1 : 0 };
+
+			insert_file(paths[n], &st, FTW_F, &ftw);
+		}
+	}
+
+	threads = xcalloc(opts.nthreads, sizeof(pthread_t));
+	for (nrun = 0; nrun < opts.nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, walker_worker, NULL) != 0)
+			break;
+	}
+	if (!nrun)
+		walker_worker(NULL);	/* no thread started */
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	/* interrupted */
+	for (i = 0; i < walker.ndirs; i++)
+		free(walker.dirs[i]);
+	free(walker.dirs);
+	walker.dirs = NULL;
+	walker.ndirs = walker.dirsz = 0;
+}
+
+/**
+ * struct digester - Shared state of the parallel digests calculation
+ * @what:   HL_DIGEST_INTRO or HL_DIGEST_FULL
+ * @files:  The files to be digested
+ * @nfiles: Number of the files
+ * @filesz: Allocated size of @files
+ * @next:   The next file to be digested by a thread
+ * @lock:   Protects @next
+ */
+static struct digester {
+	unsigned int what;
+	struct file **files;
+	size_t nfiles;
+	size_t filesz;
+	size_t next;
+	pthread_mutex_t lock;
+} digester = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/*
+ * Sorts the files with the same size by the attributes used by
+ * file_may_link_to() and by the intro digest for HL_DIGEST_FULL, the
+ * possible duplicates are neighbours in the sorted array.
+ */
+static int cmp_digest_key(const void *_a, const void *_b)
+{
+	const struct file *a = *(const struct file **) _a;
+	const struct file *b = *(const struct file **) _b;
+	int diff = 0;
+
+	if (diff == 0 && opts.respect_mode)
+		diff = CMP(a->st.st_mode, b->st.st_mode);
+	if (diff == 0 && opts.respect_owner)
+		diff = CMP(a->st.st_uid, b->st.st_uid);
+	if (diff == 0 && opts.respect_owner)
+		diff = CMP(a->st.st_gid, b->st.st_gid);
+	if (diff == 0 && opts.respect_time)
+		diff = CMP(a->st.st_mtime, b->st.st_mtime);
+	if (diff == 0 && digester.what == HL_DIGEST_FULL)
+		diff = memcmp(a->intro, b->intro, sizeof(a->intro));
+
+	return diff;
+}
+
+/**
+ * digest_collector - Callback for file_table_walk()
+ * @head: The first file in the list of files with the same size
+ *
+ * Adds files from the list of the files with the same size to the
+ * digester if there is another file which may be linked to it.
+ */
+static void digest_collector(struct file *head)
+{
+	struct file **list, *f;
+	size_t i, n = 0;
+
+	if (head->st.st_size == 0)
+		return;
+	if (digester.what == HL_DIGEST_FULL
+	    && head->st.st_size <= HL_DIGEST_BLOCKSZ * 2)
+		return;		/* see file_digests_equal() */
+
+	for (f = head; f != NULL; f = f->next) {
+		if (f->links && !(f->digests & HL_DIGEST_FAILED))
+			n++;
+	}
+	if (n < 2)
+		return;
+
+	list = xmalloc(n * sizeof(struct file *));
+	for (n = 0, f = head; f != NULL; f = f->next) {
+		if (f->links && !(f->digests & HL_DIGEST_FAILED))
+			list[n++] = f;
+	}
+	qsort(list, n, sizeof(struct file *), cmp_digest_key);
+
+	for (i = 0; i < n; i++) {
+		if ((i > 0 && cmp_digest_key(&list[i - 1], &list[i]) == 0) ||
+		    (i + 1 < n && cmp_digest_key(&list[i], &list[i + 1]) == 0)) {
+			if (digester.nfiles == digester.filesz) {
+				digester.filesz = max(digester.filesz * 2, (size_t) 1024);
+				digester.files = xrealloc(digester.files,
+						digester.filesz * sizeof(struct file *));
+			}
+			digester.files[digester.nfiles++] = list[i];
+		}
+	}
+	free(list);
+}
+
+static void *digest_worker(void *data __attribute__((__unused__)))
+{
+	while (!is_interrupted()) {
+		size_t idx;
+
+		pthread_mutex_lock(&digester.lock);
+		idx = digester.next++;
+		pthread_mutex_unlock(&digester.lock);
+
+		if (idx >= digester.nfiles)
+			break;
+		file_digest(digester.files[idx], digester.what);
+	}
+	return NULL;
+}
+
+/**
+ * digest_parallel - Calculate digests by threads
+ * @what: HL_DIGEST_INTRO or HL_DIGEST_FULL
+ *
+ * Calculates the digests for all the files where the digest will be
+ * required by visitor(). The linking is serial, visitor() uses the
+ * already calculated digests.
+ */
+static void digest_parallel(unsigned int what)
+{
+	pthread_t *threads;
+	size_t i, nrun;
+
+	digester.what = what;
+	digester.nfiles = digester.next = 0;
+	file_table_walk(digest_collector);
+
+	jlog(JLOG_VERBOSE2, _("Digesting %zu files by %u threads"),
+	     digester.nfiles, opts.nthreads);
+
+	threads = xcalloc(opts.nthreads, sizeof(pthread_t));
+	for (nrun = 0; nrun < min((size_t) opts.nthreads, digester.nfiles); nrun++) {
+		if (pthread_create(&threads[nrun], NULL, digest_worker, NULL) != 0)
+			break;
+	}
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	/* the rest (if no thread started) is calculated by visitor() */
+}
+#endif /* HAVE_LIBPTHREAD */
+
 /**
  * usage - Print the program help and exit
  */
@@ -891,6 +1802,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -i, --include <regex>      regular expression to include files/dirs\n"), out);
 	fputs(_(" -s, --minimum-size <size>  minimum size for files.\n"), out);
 	fputs(_(" -c, --content              compare only file contents, same as -pot\n"), out);
+	fputs(_(" -j, --parallel <num>       walk directories and read files by <num> threads\n"), out);
+	fputs(_("     --cache <file>         read and save the files digests to the file\n"), out);
+	fputs(_("     --io-size <size>       size of the read buffers (default 1M)\n"), out);
+	fputs(_("     --trust-digest         don't compare files with the same SHA-1 digest\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(28));
@@ -930,7 +1845,12 @@ static void register_regex(struct regex_link **pregs, const char *regex)
  */
 static int parse_options(int argc, char *argv[])
 {
-	static const char optstr[] = "VhvnfpotXcmMOx:i:s:q";
+	enum {
+		OPT_TRUST_DIGEST = CHAR_MAX + 1,
+		OPT_CACHE,
+		OPT_IO_SIZE
+	};
+	static const char optstr[] = "VhvnfpotXcmMOx:i:j:s:q";
 	static const struct option long_options[] = {
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -949,6 +1869,10 @@ static int parse_options(int argc, char *argv[])
 		{"minimum-size", required_argument, NULL, 's'},
 		{"content", no_argument, NULL, 'c'},
 		{"quiet", no_argument, NULL, 'q'},
+		{"parallel", required_argument, NULL, 'j'},
+		{"trust-digest", no_argument, NULL, OPT_TRUST_DIGEST},
+		{"cache", required_argument, NULL, OPT_CACHE},
+		{"io-size", required_argument, NULL, OPT_IO_SIZE},
 		{NULL, 0, NULL, 0}
 	};
 	static const ul_excl_t excl[] = {
@@ -1012,6 +1936,29 @@ static int parse_options(int argc, char *argv[])
 		case 's':
 			opts.min_size = strtosize_or_err(optarg, _("failed to parse size"));
 			break;
+		case 'j':
+			opts.nthreads = strtou32_or_err(optarg, _("invalid number of threads argument"));
+			if (opts.nthreads == 0) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+				opts.nthreads = n > 0 ? (unsigned int) n : 1;
+			}
+#ifndef HAVE_LIBPTHREAD
+			opts.nthreads = 1;
+#endif
+			break;
+		case OPT_TRUST_DIGEST:
+			opts.trust_digest = TRUE;
+			break;
+		case OPT_CACHE:
+			opts.cache = optarg;
+			break;
+		case OPT_IO_SIZE:
+			opts.io_size = strtosize_or_err(optarg, _("failed to parse size"));
+			if (opts.io_size < HL_DIGEST_BLOCKSZ)
+				errx(EXIT_FAILURE, _("the I/O size has to be at least %d bytes"),
+						HL_DIGEST_BLOCKSZ);
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1070,11 +2017,31 @@ int main(int argc, char *argv[])
 	gettime_monotonic(&stats.start_time);
 	stats.started = TRUE;
 
-	for (; optind < argc; optind++) {
-		if (nftw(argv[optind], inserter, 20, FTW_PHYS) == -1)
-			warn(_("cannot process %s"), argv[optind]);
+	if (opts.cache)
+		cache_load();
+
+#ifdef HAVE_LIBPTHREAD
+	if (opts.nthreads > 1) {
+		walk_parallel(argv + optind, argc - optind);
+		file_table_group();
+		if (!handle_interrupt())
+			digest_parallel(HL_DIGEST_INTRO);
+		if (!handle_interrupt())
+			digest_parallel(HL_DIGEST_FULL);
+		free(digester.files);
+	}
+#endif
+	if (opts.nthreads < 2) {
+		for (; optind < argc; optind++) {
+			if (nftw(argv[optind], inserter, 20, FTW_PHYS) == -1)
+				warn(_("cannot process %s"), argv[optind]);
+		}
+		file_table_group();
 	}
 
-	twalk(files, visitor);
+	file_table_walk(visitor);
+
+	if (opts.cache)
+		cache_save();
 	return 0;
 }
@@ -53,6 +53,7 @@
 
 #include "c.h"
 #include "closestream.h"
+#include "monotonic.h"
 #include "nls.h"
 #include "pidfd-utils.h"
 #include "procutils.h"
@@ -77,6 +78,12 @@ struct timeouts {
 	int sig;
 	struct list_head follow_ups;
 };
+
+/* signaled process waiting for the follow-up signals */
+struct kill_target {
+	pid_t pid;
+	int pidfd;
+};
 #endif
 
 struct kill_control {
@@ -86,8 +93,11 @@ struct kill_control {
 #ifdef HAVE_SIGQUEUE
 	union sigval sigdata;
 #endif
+	struct proc_snapshot *procs;	/* for names, read once */
 #ifdef UL_HAVE_PIDFD
 	struct list_head follow_ups;
+	struct kill_target *targets;
+	size_t ntargets;
 #endif
 	unsigned int
 		check_all:1,
@@ -378,48 +388,143 @@ static char **parse_arguments(int argc, char **argv, struct kill_control *ctl)
 }
 
 #ifdef UL_HAVE_PIDFD
-static int kill_with_timeout(const struct kill_control *ctl)
+static void init_siginfo(const struct kill_control *ctl, siginfo_t *info, int sig)
 {
-	int pfd, n;
-	struct pollfd p = { 0 };
-	siginfo_t info = { 0 };
-	struct list_head *entry;
-
-	info.si_code = SI_QUEUE;
-	info.si_signo = ctl->numsig;
-	info.si_uid = getuid();
-	info.si_pid = getpid();
-	info.si_value.sival_int =
+	memset(info, 0, sizeof(*info));
+	info->si_code = SI_QUEUE;
+	info->si_signo = sig;
+	info->si_uid = getuid();
+	info->si_pid = getpid();
+	info->si_value.sival_int =
 	    ctl->use_sigval != 0 ? ctl->use_sigval : ctl->numsig;
+}
+
+/*
+ * Sends the signal by pidfd and keeps the pidfd for the follow-up signals,
+ * see kill_follow_ups().
+ */
+static int kill_with_timeout(struct kill_control *ctl)
+{
+	siginfo_t info;
+	int pfd;
 
 	if ((pfd = pidfd_open(ctl->pid, 0)) < 0)
-		err(EXIT_FAILURE, _("pidfd_open() failed: %d"), ctl->pid);
-	p.fd = pfd;
-	p.events = POLLIN;
+		return -1;
+
+	init_siginfo(ctl, &info, ctl->numsig);
+	if (pidfd_send_signal(pfd, ctl->numsig, &info, 0) < 0) {
+		close(pfd);
+		return -1;
+	}
+
+	ctl->targets = xrealloc(ctl->targets,
+			(ctl->ntargets + 1) * sizeof(struct kill_target));
+	ctl->targets[ctl->ntargets].pid = ctl->pid;
+	ctl->targets[ctl->ntargets].pidfd = pfd;
+	ctl->ntargets++;
+	return 0;
+}
+
+/* returns milliseconds to @end for poll(), at least 0 */
+static int remaining_msec(const struct timeval *end)
+{
+	struct timeval now, diff;
+
+	gettime_monotonic(&now);
+	if (!timercmp(&now, end, <))
+		return 0;
+	timersub(end, &now, &diff);
+	return diff.tv_sec * 1000 + (diff.tv_usec + 999) / 1000;
+}
+
+/*
+ * Waits for all the signaled processes at once, the follow-up signal is sent
+ * to the processes still running after the timeout.
+ *
+ * Returns number of processes which cannot be signaled.
+ */
+static int kill_follow_ups(struct kill_control *ctl)
+{
+	struct list_head *entry;
+	struct pollfd *fds;
+	size_t i, nalive = ctl->ntargets;
+	int nerrs = 0;
+
+	if (!ctl->ntargets)
+		return 0;
+
+	fds = xcalloc(ctl->ntargets, sizeof(struct pollfd));
+	for (i = 0; i < ctl->ntargets; i++) {
+		fds[i].fd = ctl->targets[i].pidfd;
+		fds[i].events = POLLIN;
+	}
 
-	if (pidfd_send_signal(pfd, ctl->numsig, &info, 0) < 0)
-		err(EXIT_FAILURE, _("pidfd_send_signal() failed"));
 	list_for_each(entry, &ctl->follow_ups) {
 		struct timeouts *timeout;
+		struct timeval now, end, period;
+		siginfo_t info;
+
+		if (!nalive)
+			break;
 
 		timeout = list_entry(entry, struct timeouts, follow_ups);
-		n = poll(&p, 1, timeout->period);
-		if (n < 0)
-			err(EXIT_FAILURE, _("poll() failed"));
-		if (n == 0) {
-			info.si_signo = timeout->sig;
+		period.tv_sec = timeout->period / 1000;
+		period.tv_usec = (timeout->period % 1000) * 1000;
+		gettime_monotonic(&now);
+		timeradd(&now, &period, &end);
+
+		/* the exited processes are removed from the poll set */
+		while (nalive) {
+			int n = poll(fds, ctl->ntargets,
+				     timeout->period < 0 ? -1 : remaining_msec(&end));
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				err(EXIT_FAILURE, _("poll() failed"));
+			}
+			if (n == 0)
+				break;
+			for (i = 0; i < ctl->ntargets; i++) {
+				if (fds[i].fd < 0 || !fds[i].revents)
+					continue;
+				close(fds[i].fd);
+				fds[i].fd = -1;
+				nalive--;
+			}
+		}
+
+		init_siginfo(ctl, &info, timeout->sig);
+		for (i = 0; i < ctl->ntargets; i++) {
+			if (fds[i].fd < 0)
+				continue;
 			if (ctl->verbose)
 				printf(_("timeout, sending signal %d to pid %d\n"),
-					 timeout->sig, ctl->pid);
-			if (pidfd_send_signal(pfd, timeout->sig, &info, 0) < 0)
-				err(EXIT_FAILURE, _("pidfd_send_signal() failed"));
+					 timeout->sig, ctl->targets[i].pid);
+			if (pidfd_send_signal(fds[i].fd, timeout->sig, &info, 0) == 0)
+				continue;
+			if (errno != ESRCH) {
+				warn(_("pidfd_send_signal() failed: %d"), ctl->targets[i].pid);
+				nerrs++;
+			}
+			close(fds[i].fd);
+			fds[i].fd = -1;
+			nalive--;
 		}
 	}
-	return 0;
+
+	for (i = 0; i < ctl->ntargets; i++) {
+		if (fds[i].fd >= 0)
+			close(fds[i].fd);
+	}
+	free(fds);
+	free(ctl->targets);
+	ctl->targets = NULL;
+	ctl->ntargets = 0;
+	return nerrs;
 }
 #endif
 
-static int kill_verbose(const struct kill_control *ctl)
+static int kill_verbose(struct kill_control *ctl)
 {
 	int rc = 0;
 
@@ -472,22 +577,30 @@ int main(int argc, char **argv)
 				nerrs++;
 			ct++;
 		} else {
-			struct proc_processes *ps = proc_open_processes();
+			size_t i, nprocs;
 			int found = 0;
 
-			if (!ps)
-				continue;
-			if (!ctl.check_all)
-				proc_processes_filter_by_uid(ps, getuid());
+			/* all names are resolved by one /proc scan */
+			if (!ctl.procs) {
+				ctl.procs = proc_new_snapshot(PROC_SNAP_UID | PROC_SNAP_COMM);
+				if (!ctl.procs || proc_snapshot_read(ctl.procs) != 0)
+					err(EXIT_FAILURE, _("cannot read processes"));
+			}
 
-			proc_processes_filter_by_name(ps, ctl.arg);
-			while (proc_next_pid(ps, &ctl.pid) == 0) {
+			nprocs = proc_snapshot_get_nentries(ctl.procs);
+			for (i = 0; i < nprocs; i++) {
+				struct proc_entry *e = proc_snapshot_get_entry(ctl.procs, i);
+
+				if (!e->valid || strcmp(e->comm, ctl.arg) != 0)
+					continue;
+				if (!ctl.check_all && e->uid != getuid())
+					continue;
+				ctl.pid = e->pid;
 				if (kill_verbose(&ctl) != 0)
 					nerrs++;
 				ct++;
 				found = 1;
 			}
-			proc_close_processes(ps);
 
 			if (!found) {
 				nerrs++, ct++;
@@ -496,7 +609,12 @@ int main(int argc, char **argv)
 		}
 	}
 
+	proc_free_snapshot(ctl.procs);
+
 #ifdef UL_HAVE_PIDFD
+	if (ctl.timeout)
+		nerrs += kill_follow_ups(&ctl);
+
 	while (!list_empty(&ctl.follow_ups)) {
 		struct timeouts *x = list_entry(ctl.follow_ups.next,
 				                  struct timeouts, follow_ups);
@@ -53,6 +53,9 @@
 #include <pwd.h>
 #include <signal.h>
 #include <sys/uio.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "all-io.h"
 #include "c.h"
@@ -84,6 +87,12 @@ enum {
 	ALL_TYPES = TYPE_UDP | TYPE_TCP
 };
 
+/* messages sent by one sendmmsg() call for datagram sockets */
+#define LOGGER_BATCH_MAX	64
+
+/* stdin read buffer size */
+#define LOGGER_INPUT_BUFSZ	(256 * 1024)
+
 enum {
 	AF_UNIX_ERRORS_OFF = 0,
 	AF_UNIX_ERRORS_ON,
@@ -101,7 +110,9 @@ enum {
 	OPT_ID,
 	OPT_STRUCTURED_DATA_ID,
 	OPT_STRUCTURED_DATA_PARAM,
-	OPT_OCTET_COUNT
+	OPT_OCTET_COUNT,
+	OPT_QUEUE_SIZE,
+	OPT_QUEUE_POLICY
 };
 
 /* rfc5424 structured data */
@@ -112,11 +123,48 @@ struct structured_data {
 	struct list_head	sds;
 };
 
+#ifdef HAVE_SENDMMSG
+/* pending messages for datagram sockets */
+struct logger_batch {
+	struct mmsghdr	msgs[LOGGER_BATCH_MAX];
+	struct iovec	iov[LOGGER_BATCH_MAX];
+	char		*bufs[LOGGER_BATCH_MAX];
+	size_t		bufsz[LOGGER_BATCH_MAX];
+	size_t		nmsgs;
+};
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+/* queued stream socket message */
+struct logger_msg {
+	struct list_head	msgs;
+	size_t			len;
+	char			data[];
+};
+
+/* messages for stream sockets written by a thread */
+struct logger_queue {
+	pthread_t		thread;
+	pthread_mutex_t		lock;		/* protects all the below */
+	pthread_cond_t		nonempty;
+	pthread_cond_t		nonfull;
+
+	struct list_head	msgs;
+	size_t			bytes;		/* size of the queued messages */
+	size_t			nsent;
+	size_t			ndropped;
+	size_t			nreconnects;
+	unsigned int		done : 1;	/* no more messages */
+};
+#endif
+
 struct logger_ctl {
 	int fd;
 	int pri;
 	pid_t pid;			/* zero when unwanted */
 	char *hdr;			/* the syslog header (based on protocol) */
+	char *hdr_host;			/* cached hostname for the header */
+	char *hdr_tail;			/* cached rfc5424 header after timestamp */
 	char const *tag;
 	char *msgid;
 	char *unix_socket;		/* -u <path> or default to _PATH_DEVLOG */
@@ -124,10 +172,17 @@ struct logger_ctl {
 	char *port;
 	int socket_type;
 	size_t max_message_size;
+	size_t queue_size;		/* --queue-size limit in bytes */
 	struct list_head user_sds;	/* user defined rfc5424 structured data */
 	struct list_head reserved_sds;	/* standard rfc5424 structured data */
 
 	void (*syslogfp)(struct logger_ctl *ctl);
+#ifdef HAVE_SENDMMSG
+	struct logger_batch *batch;	/* used for stdin only */
+#endif
+#ifdef HAVE_LIBPTHREAD
+	struct logger_queue *queue;	/* used for --queue-size */
+#endif
 
 	unsigned int
 			unix_socket_errors:1,	/* whether to report or not errors */
@@ -138,7 +193,8 @@ struct logger_ctl {
 			rfc5424_tq:1,		/* include time quality markup */
 			rfc5424_host:1,		/* include hostname */
 			skip_empty_lines:1,	/* do not send empty lines when processing files */
-			octet_count:1;		/* use RFC6587 octet counting */
+			octet_count:1,		/* use RFC6587 octet counting */
+			queue_drop:1;		/* drop messages if the queue is full */
 };
 
 #define is_connected(_ctl)	((_ctl)->fd >= 0)
@@ -283,7 +339,10 @@ static int unix_socket(struct logger_ctl *ctl, const char *path, int *socket_typ
 	return fd;
 }
 
-static int inet_socket(const char *servername, const char *port, int *socket_type)
+/* with @quiet returns -1 on errors, used for reconnects from the queue
+ * thread where logger(1) should not exit */
+static int inet_socket(const char *servername, const char *port, int *socket_type,
+		       int quiet)
 {
 	int fd, errcode, i, type = -1;
 	struct addrinfo hints, *res;
@@ -307,6 +366,8 @@ static int inet_socket(const char *servername, const char *port, int *socket_typ
 			continue;
 		hints.ai_family = AF_UNSPEC;
 		errcode = getaddrinfo(servername, p, &hints, &res);
+		if (errcode != 0 && quiet)
+			return -1;
 		if (errcode != 0)
 			errx(EXIT_FAILURE, _("failed to resolve name %s port %s: %s"),
 			     servername, p, gai_strerror(errcode));
@@ -324,6 +385,8 @@ static int inet_socket(const char *servername, const char *port, int *socket_typ
 		break;
 	}
 
+	if (i == 0 && quiet)
+		return -1;
 	if (i == 0)
 		errx(EXIT_FAILURE, _("failed to connect to %s port %s"), servername, p);
 
@@ -403,6 +466,7 @@ static int journald_entry(struct logger_ctl *ctl, FILE *fp)
 static char const *rfc3164_current_time(void)
 {
 	static char time[32];
+	static time_t last = (time_t) -1;
 	struct timeval tv;
 	struct tm tm;
 	static char const * const monthnames[] = {
@@ -411,6 +475,9 @@ static char const *rfc3164_current_time(void)
 	};
 
 	logger_gettimeofday(&tv, NULL);
+	if (tv.tv_sec == last)
+		return time;
+	last = tv.tv_sec;
 	localtime_r(&tv.tv_sec, &tm);
 	snprintf(time, sizeof(time),"%s %2d %2.2d:%2.2d:%2.2d",
 		monthnames[tm.tm_mon], tm.tm_mday,
@@ -440,14 +507,299 @@ static char const *rfc3164_current_time(void)
  * it is too much for the logger utility. If octet-counting is
  * selected, we use that.
  */
+/* whether to send credentials with a different PID than logger(1) PID */
+static int want_credentials(const struct logger_ctl *ctl)
+{
+	return ctl->pid && !ctl->server && ctl->pid != getpid()
+	       && geteuid() == 0 && kill(ctl->pid, 0) == 0;
+}
+
+#ifdef HAVE_SENDMMSG
+/* sends all pending messages */
+static void logger_flush(struct logger_ctl *ctl)
+{
+	struct logger_batch *b = ctl->batch;
+	size_t done = 0;
+
+	if (!b || !b->nmsgs)
+		return;
+
+	while (done < b->nmsgs) {
+		int rc = sendmmsg(ctl->fd, b->msgs + done, b->nmsgs - done, MSG_NOSIGNAL);
+
+		if (rc < 0) {
+			/* reconnect, see write_output() */
+			logger_reopen(ctl);
+			rc = is_connected(ctl) ?
+				sendmmsg(ctl->fd, b->msgs + done, b->nmsgs - done, MSG_NOSIGNAL) : -1;
+			if (rc < 0) {
+				warn(_("send message failed"));
+				break;
+			}
+		}
+		done += rc;
+	}
+	b->nmsgs = 0;
+}
+
+/* copies the message to the batch, returns 0 when batched */
+static int logger_batch_add(struct logger_ctl *ctl, struct iovec *iov, int iovlen)
+{
+	struct logger_batch *b = ctl->batch;
+	size_t n, len = 0;
+	char *p;
+	int i;
+
+	if (!b || ctl->socket_type != TYPE_UDP)
+		return -1;
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+
+	n = b->nmsgs;
+	if (b->bufsz[n] < len) {
+		b->bufsz[n] = len;
+		b->bufs[n] = xrealloc(b->bufs[n], len);
+	}
+	for (p = b->bufs[n], i = 0; i < iovlen; i++)
+		p = mempcpy(p, iov[i].iov_base, iov[i].iov_len);
+
+	b->iov[n].iov_base = b->bufs[n];
+	b->iov[n].iov_len = len;
+	memset(&b->msgs[n], 0, sizeof(b->msgs[n]));
+	b->msgs[n].msg_hdr.msg_iov = &b->iov[n];
+	b->msgs[n].msg_hdr.msg_iovlen = 1;
+
+	if (++b->nmsgs == LOGGER_BATCH_MAX)
+		logger_flush(ctl);
+	return 0;
+}
+
+static void logger_batch_free(struct logger_ctl *ctl)
+{
+	size_t i;
+
+	if (!ctl->batch)
+		return;
+	logger_flush(ctl);
+	for (i = 0; i < LOGGER_BATCH_MAX; i++)
+		free(ctl->batch->bufs[i]);
+	free(ctl->batch);
+	ctl->batch = NULL;
+}
+#else
+# define logger_flush(ctl)			do { } while (0)
+# define logger_batch_add(ctl, iov, iovlen)	(-1)
+# define logger_batch_free(ctl)			do { } while (0)
+#endif /* HAVE_SENDMMSG */
+
+#ifdef HAVE_LIBPTHREAD
+/* sends @n messages, @done is set to the number of completely sent ones */
+static int queue_send_msgs(struct logger_ctl *ctl, struct logger_msg **m,
+			   size_t n, size_t *done)
+{
+	struct iovec iov[LOGGER_BATCH_MAX];
+	size_t i;
+
+	assert(n <= LOGGER_BATCH_MAX);
+
+	for (i = 0; i < n; i++) {
+		iov[i].iov_base = m[i]->data;
+		iov[i].iov_len = m[i]->len;
+	}
+
+	*done = 0;
+	while (*done < n) {
+		struct msghdr mh = {
+			.msg_iov = iov + *done,
+			.msg_iovlen = n - *done
+		};
+		ssize_t ret = sendmsg(ctl->fd, &mh, MSG_NOSIGNAL);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		while (*done < n && (size_t) ret >= iov[*done].iov_len) {
+			ret -= iov[*done].iov_len;
+			(*done)++;
+		}
+		if (ret) {
+			iov[*done].iov_base = (char *) iov[*done].iov_base + ret;
+			iov[*done].iov_len -= ret;
+		}
+	}
+	return 0;
+}
+
+static void *queue_worker(void *data)
+{
+	struct logger_ctl *ctl = data;
+	struct logger_queue *q = ctl->queue;
+	struct logger_msg *m[LOGGER_BATCH_MAX];
+
+	for (;;) {
+		size_t i, n = 0, sent = 0, dropped = 0, reconnects = 0;
+		int done;
+
+		pthread_mutex_lock(&q->lock);
+		while (list_empty(&q->msgs) && !q->done)
+			pthread_cond_wait(&q->nonempty, &q->lock);
+		while (n < LOGGER_BATCH_MAX && !list_empty(&q->msgs)) {
+			m[n] = list_entry(q->msgs.next, struct logger_msg, msgs);
+			list_del(&m[n]->msgs);
+			q->bytes -= m[n]->len;
+			n++;
+		}
+		pthread_cond_broadcast(&q->nonfull);
+		pthread_mutex_unlock(&q->lock);
+
+		if (!n)
+			break;
+
+		/* reconnect and re-send the partially sent message on errors */
+		while (sent < n) {
+			size_t x = 0;
+
+			if (is_connected(ctl)
+			    && queue_send_msgs(ctl, m + sent, n - sent, &x) == 0) {
+				sent = n;
+				break;
+			}
+			sent += x;
+
+			logger_reopen(ctl);
+			reconnects++;
+			if (is_connected(ctl))
+				continue;
+
+			pthread_mutex_lock(&q->lock);
+			done = q->done;
+			pthread_mutex_unlock(&q->lock);
+			if (done) {
+				/* don't wait for the server on exit */
+				dropped = n - sent;
+				break;
+			}
+			sleep(1);
+		}
+
+		for (i = 0; i < n; i++)
+			free(m[i]);
+
+		pthread_mutex_lock(&q->lock);
+		q->nsent += sent;
+		q->ndropped += dropped;
+		q->nreconnects += reconnects;
+		pthread_mutex_unlock(&q->lock);
+	}
+	return NULL;
+}
+
+/* copies the message to the queue, returns 0 when queued (or dropped) */
+static int logger_queue_add(struct logger_ctl *ctl, struct iovec *iov, int iovlen)
+{
+	struct logger_queue *q = ctl->queue;
+	struct logger_msg *m;
+	size_t len = 0;
+	char *p;
+	int i;
+
+	if (!q)
+		return -1;
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+
+	m = xmalloc(sizeof(*m) + len);
+	INIT_LIST_HEAD(&m->msgs);
+	m->len = len;
+	for (p = m->data, i = 0; i < iovlen; i++)
+		p = mempcpy(p, iov[i].iov_base, iov[i].iov_len);
+
+	pthread_mutex_lock(&q->lock);
+	if (q->bytes && q->bytes + len > ctl->queue_size) {
+		if (ctl->queue_drop) {
+			q->ndropped++;
+			pthread_mutex_unlock(&q->lock);
+			free(m);
+			return 0;
+		}
+		/* backpressure, wait for the thread */
+		while (q->bytes && q->bytes + len > ctl->queue_size)
+			pthread_cond_wait(&q->nonfull, &q->lock);
+	}
+	list_add_tail(&m->msgs, &q->msgs);
+	q->bytes += len;
+	pthread_cond_signal(&q->nonempty);
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
+
+static void logger_queue_start(struct logger_ctl *ctl)
+{
+	struct logger_queue *q;
+
+	if (ctl->noact || !is_connected(ctl) || ctl->socket_type != TYPE_TCP) {
+		warnx(_("--queue-size is supported for connected stream sockets only"));
+		return;
+	}
+
+	q = xcalloc(1, sizeof(*q));
+	INIT_LIST_HEAD(&q->msgs);
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->nonempty, NULL);
+	pthread_cond_init(&q->nonfull, NULL);
+
+	ctl->queue = q;
+	if (pthread_create(&q->thread, NULL, queue_worker, ctl) != 0)
+		err(EXIT_FAILURE, _("failed to create thread"));
+}
+
+/* waits for the queued messages and reports the counters */
+static void logger_queue_stop(struct logger_ctl *ctl)
+{
+	struct logger_queue *q = ctl->queue;
+
+	if (!q)
+		return;
+
+	pthread_mutex_lock(&q->lock);
+	q->done = 1;
+	pthread_cond_signal(&q->nonempty);
+	pthread_mutex_unlock(&q->lock);
+	pthread_join(q->thread, NULL);
+
+	fprintf(stderr, _("%s: %zu messages sent, %zu dropped, %zu reconnects\n"),
+			program_invocation_short_name,
+			q->nsent, q->ndropped, q->nreconnects);
+
+	pthread_cond_destroy(&q->nonfull);
+	pthread_cond_destroy(&q->nonempty);
+	pthread_mutex_destroy(&q->lock);
+	free(q);
+	ctl->queue = NULL;
+}
+# define logger_has_queue(ctl)			((ctl)->queue != NULL)
+#else
+# define logger_queue_add(ctl, iov, iovlen)	(-1)
+# define logger_queue_stop(ctl)			do { } while (0)
+# define logger_has_queue(ctl)			0
+static void logger_queue_start(struct logger_ctl *ctl __attribute__((__unused__)))
+{
+	warnx(_("--queue-size is not supported without threads"));
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static void write_output(struct logger_ctl *ctl, const char *const msg)
 {
 	struct iovec iov[4];
 	int iovlen = 0;
 	char *octet = NULL;
 
-	/* initial connect failed? */
-	if (!ctl->noact && !is_connected(ctl))
+	/* initial connect failed? (the queue thread reconnects itself) */
+	if (!ctl->noact && !is_connected(ctl) && !logger_has_queue(ctl))
 		logger_reopen(ctl);
 
 	/* 1) octen count */
@@ -462,7 +814,13 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 	/* 3) message */
 	iovec_add_string(iov, iovlen, msg, 0);
 
-	if (!ctl->noact && is_connected(ctl)) {
+	if (logger_has_queue(ctl)) {
+		if (!ctl->octet_count)
+			iovec_add_string(iov, iovlen, "\n", 1);
+		logger_queue_add(ctl, iov, iovlen);
+
+	} else if (!ctl->noact && is_connected(ctl)
+		   && logger_batch_add(ctl, iov, iovlen) != 0) {
 		struct msghdr message = { 0 };
 #ifdef SCM_CREDENTIALS
 		struct cmsghdr *cmhp;
@@ -486,8 +844,7 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 		 * force kernel to accept another valid PID than the real logger(1)
 		 * PID.
 		 */
-		if (ctl->pid && !ctl->server && ctl->pid != getpid()
-		    && geteuid() == 0 && kill(ctl->pid, 0) == 0) {
+		if (want_credentials(ctl)) {
 
 			message.msg_control = cbuf.control;
 			message.msg_controllen = CMSG_SPACE(sizeof(struct ucred));
@@ -534,23 +891,24 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 #define NILVALUE "-"
 static void syslog_rfc3164_header(struct logger_ctl *const ctl)
 {
-	char pid[30], *hostname;
+	char pid[30];
 
 	*pid = '\0';
 	if (ctl->pid)
 		snprintf(pid, sizeof(pid), "[%d]", ctl->pid);
 
-	if ((hostname = logger_xgethostname())) {
-		char *dot = strchr(hostname, '.');
-		if (dot)
-			*dot = '\0';
-	} else
-		hostname = xstrdup(NILVALUE);
+	/* the header is re-generated for each stdin line, cache the hostname */
+	if (!ctl->hdr_host) {
+		if ((ctl->hdr_host = logger_xgethostname())) {
+			char *dot = strchr(ctl->hdr_host, '.');
+			if (dot)
+				*dot = '\0';
+		} else
+			ctl->hdr_host = xstrdup(NILVALUE);
+	}
 
 	xasprintf(&ctl->hdr, "<%d>%.15s %s %.200s%s: ",
-		 ctl->pri, rfc3164_current_time(), hostname, ctl->tag, pid);
-
-	free(hostname);
+		 ctl->pri, rfc3164_current_time(), ctl->hdr_host, ctl->tag, pid);
 }
 
 static inline struct list_head *get_user_structured_data(struct logger_ctl *ctl)
@@ -755,35 +1113,45 @@ static int valid_structured_data_id(const char *str)
  * specified RFC5424. The rest of the field mappings should be
  * pretty clear from RFC5424. -- Rainer Gerhards, 2015-03-10
  */
-static void syslog_rfc5424_header(struct logger_ctl *const ctl)
+static char *rfc5424_current_time(void)
 {
+	static char fmt[64];
+	static time_t last = (time_t) -1;
+	struct timeval tv;
 	char *time;
+
+	logger_gettimeofday(&tv, NULL);
+
+	/* the format string is the same within a second */
+	if (tv.tv_sec != last) {
+		struct tm tm;
+		size_t i;
+
+		if (localtime_r(&tv.tv_sec, &tm) == NULL)
+			err(EXIT_FAILURE, _("localtime() failed"));
+
+		i = strftime(fmt, sizeof(fmt), "%Y-%m-%dT%H:%M:%S.%%06u%z ", &tm);
+		/* patch TZ info to comply with RFC3339 (we left SP at end) */
+		fmt[i - 1] = fmt[i - 2];
+		fmt[i - 2] = fmt[i - 3];
+		fmt[i - 3] = ':';
+		last = tv.tv_sec;
+	}
+	xasprintf(&time, fmt, tv.tv_usec);
+	return time;
+}
+
+/* the header fields after the timestamp, the same for all messages */
+static char *syslog_rfc5424_tail(struct logger_ctl *const ctl)
+{
 	char *hostname;
 	char const *app_name = ctl->tag;
 	char *procid;
 	char *const msgid = xstrdup(ctl->msgid ? ctl->msgid : NILVALUE);
 	char *structured = NULL;
+	char *tail;
 	struct list_head *sd;
 
-	if (ctl->rfc5424_time) {
-		struct timeval tv;
-		struct tm tm;
-
-		logger_gettimeofday(&tv, NULL);
-		if (localtime_r(&tv.tv_sec, &tm) != NULL) {
-			char fmt[64];
-			const size_t i = strftime(fmt, sizeof(fmt),
-						  "%Y-%m-%dT%H:%M:%S.%%06u%z ", &tm);
-			/* patch TZ info to comply with RFC3339 (we left SP at end) */
-			fmt[i - 1] = fmt[i - 2];
-			fmt[i - 2] = fmt[i - 3];
-			fmt[i - 3] = ':';
-			xasprintf(&time, fmt, tv.tv_usec);
-		} else
-			err(EXIT_FAILURE, _("localtime() failed"));
-	} else
-		time = xstrdup(NILVALUE);
-
 	if (ctl->rfc5424_host) {
 		if (!(hostname = logger_xgethostname()))
 			hostname = xstrdup(NILVALUE);
@@ -827,21 +1195,32 @@ static void syslog_rfc5424_header(struct logger_ctl *const ctl)
 	if (!structured)
 		structured = xstrdup(NILVALUE);
 
-	xasprintf(&ctl->hdr, "<%d>1 %s %s %s %s %s %s ",
-		ctl->pri,
-		time,
+	xasprintf(&tail, "%s %s %s %s %s ",
 		hostname,
 		app_name,
 		procid,
 		msgid,
 		structured);
 
-	free(time);
 	free(hostname);
 	/* app_name points to ctl->tag, do NOT free! */
 	free(procid);
 	free(msgid);
 	free(structured);
+	return tail;
+}
+
+static void syslog_rfc5424_header(struct logger_ctl *const ctl)
+{
+	char *time;
+
+	time = ctl->rfc5424_time ? rfc5424_current_time() : xstrdup(NILVALUE);
+
+	if (!ctl->hdr_tail)
+		ctl->hdr_tail = syslog_rfc5424_tail(ctl);
+
+	xasprintf(&ctl->hdr, "<%d>1 %s %s", ctl->pri, time, ctl->hdr_tail);
+	free(time);
 }
 
 static void parse_rfc5424_flags(struct logger_ctl *ctl, char *s)
@@ -899,7 +1278,8 @@ static void generate_syslog_header(struct logger_ctl *const ctl)
 static void __logger_open(struct logger_ctl *ctl)
 {
 	if (ctl->server) {
-		ctl->fd = inet_socket(ctl->server, ctl->port, &ctl->socket_type);
+		ctl->fd = inet_socket(ctl->server, ctl->port, &ctl->socket_type,
+				      logger_has_queue(ctl));
 	} else {
 		if (!ctl->unix_socket)
 			ctl->unix_socket = _PATH_DEVLOG;
@@ -965,6 +1345,36 @@ static void logger_command_line(struct logger_ctl *ctl, char **argv)
 	free(buf);
 }
 
+/* large stdin buffer, the pending messages are sent before read() blocks */
+struct logger_input {
+	char	*buf;
+	size_t	pos;
+	size_t	len;
+};
+
+static int input_fill(struct logger_ctl *ctl, struct logger_input *in)
+{
+	ssize_t ret;
+
+	logger_flush(ctl);
+	do {
+		ret = read(fileno(stdin), in->buf, LOGGER_INPUT_BUFSZ);
+	} while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+
+	if (ret <= 0)
+		return EOF;
+	in->len = ret;
+	in->pos = 1;
+	return (unsigned char) in->buf[0];
+}
+
+static inline int input_getc(struct logger_ctl *ctl, struct logger_input *in)
+{
+	if (in->pos < in->len)
+		return (unsigned char) in->buf[in->pos++];
+	return input_fill(ctl, in);
+}
+
 static void logger_stdin(struct logger_ctl *ctl)
 {
 	/* note: we re-generate the syslog header for each log message to
@@ -972,17 +1382,22 @@ static void logger_stdin(struct logger_ctl *ctl)
 	 */
 	int default_priority = ctl->pri;
 	char *buf = xmalloc(ctl->max_message_size + 2 + 2);
+	struct logger_input in = { .buf = xmalloc(LOGGER_INPUT_BUFSZ) };
 	int pri;
 	int c;
 	size_t i;
 
-	c = getchar();
+#ifdef HAVE_SENDMMSG
+	if (!ctl->noact && !want_credentials(ctl))
+		ctl->batch = xcalloc(1, sizeof(struct logger_batch));
+#endif
+	c = input_getc(ctl, &in);
 	while (c != EOF) {
 		i = 0;
 		if (ctl->prio_prefix && c == '<') {
 			pri = 0;
 			buf[i++] = c;
-			while (isdigit(c = getchar()) && pri <= 191) {
+			while (isdigit(c = input_getc(ctl, &in)) && pri <= 191) {
 				buf[i++] = c;
 				pri = pri * 10 + c - '0';
 			}
@@ -998,12 +1413,12 @@ static void logger_stdin(struct logger_ctl *ctl)
 				ctl->pri = default_priority;
 
 			if (c != EOF && c != '\n')
-				c = getchar();
+				c = input_getc(ctl, &in);
 		}
 
 		while (c != EOF && c != '\n' && i < ctl->max_message_size) {
 			buf[i++] = c;
-			c = getchar();
+			c = input_getc(ctl, &in);
 		}
 		buf[i] = '\0';
 
@@ -1013,9 +1428,11 @@ static void logger_stdin(struct logger_ctl *ctl)
 		}
 
 		if (c == '\n')	/* discard line terminator */
-			c = getchar();
+			c = input_getc(ctl, &in);
 	}
 
+	logger_batch_free(ctl);
+	free(in.buf);
 	free(buf);
 }
 
@@ -1024,6 +1441,8 @@ static void logger_close(const struct logger_ctl *ctl)
 	if (ctl->fd != -1 && close(ctl->fd) != 0)
 		err(EXIT_FAILURE, _("close failed"));
 	free(ctl->hdr);
+	free(ctl->hdr_host);
+	free(ctl->hdr_tail);
 }
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -1051,6 +1470,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -P, --port <port>        use this port for UDP or TCP connection\n"), out);
 	fputs(_(" -T, --tcp                use TCP only\n"), out);
 	fputs(_(" -d, --udp                use UDP only\n"), out);
+	fputs(_("     --queue-size <size>  queue messages for TCP and send them in background\n"), out);
+	fputs(_("     --queue-policy <block|drop>\n"
+		"                          what to do when the queue is full\n"), out);
 	fputs(_("     --rfc3164            use the obsolete BSD syslog protocol\n"), out);
 	fputs(_("     --rfc5424[=<snip>]   use the syslog protocol (the default for remote);\n"
 		"                            <snip> can be notime, or notq, and/or nohost\n"), out);
@@ -1128,6 +1550,8 @@ int main(int argc, char **argv)
 		{ "skip-empty",	   no_argument,	      0, 'e'		   },
 		{ "sd-id",         required_argument, 0, OPT_STRUCTURED_DATA_ID          },
 		{ "sd-param",      required_argument, 0, OPT_STRUCTURED_DATA_PARAM       },
+		{ "queue-size",    required_argument, 0, OPT_QUEUE_SIZE    },
+		{ "queue-policy",  required_argument, 0, OPT_QUEUE_POLICY  },
 #ifdef HAVE_LIBSYSTEMD
 		{ "journald",	   optional_argument, 0, OPT_JOURNALD	   },
 #endif
@@ -1240,6 +1664,18 @@ int main(int argc, char **argv)
 				errx(EXIT_FAILURE, _("invalid structured data parameter: '%s'"), optarg);
 			add_structured_data_param(get_user_structured_data(&ctl), optarg);
 			break;
+		case OPT_QUEUE_SIZE:
+			ctl.queue_size = strtosize_or_err(optarg,
+				_("failed to parse queue size"));
+			break;
+		case OPT_QUEUE_POLICY:
+			if (strcmp(optarg, "block") == 0)
+				ctl.queue_drop = 0;
+			else if (strcmp(optarg, "drop") == 0)
+				ctl.queue_drop = 1;
+			else
+				errx(EXIT_FAILURE, _("unsupported queue policy: %s"), optarg);
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -1285,6 +1721,8 @@ int main(int argc, char **argv)
 		abort();
 	}
 	logger_open(&ctl);
+	if (ctl.queue_size)
+		logger_queue_start(&ctl);
 	if (0 < argc) {
 		generate_syslog_header(&ctl);
 		logger_command_line(&ctl, argv);
@@ -1293,6 +1731,7 @@ int main(int argc, char **argv)
 		 * function to be used for file inputs. */
 		logger_stdin(&ctl);
 
+	logger_queue_stop(&ctl);
 	logger_close(&ctl);
 	return EXIT_SUCCESS;
 }
@@ -77,6 +77,7 @@ static char *binary_search (char *, char *);
 static int compare (char *, char *);
 static char *linear_search (char *, char *);
 static int look (char *, char *);
+static int look_keys (FILE *, int, char *, char *);
 static void print_from (char *, char *);
 static void __attribute__((__noreturn__)) usage(void);
 
@@ -86,11 +87,14 @@ main(int argc, char *argv[])
 	struct stat sb;
 	int ch, fd, termchar;
 	char *back, *file, *front, *p;
+	const char *keys = NULL;
+	FILE *keysf = NULL;
 
 	static const struct option longopts[] = {
 		{"alternative", no_argument, NULL, 'a'},
 		{"alphanum", no_argument, NULL, 'd'},
 		{"ignore-case", no_argument, NULL, 'f'},
+		{"keys", required_argument, NULL, 'k'},
 		{"terminate", required_argument, NULL, 't'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -112,7 +116,7 @@ main(int argc, char *argv[])
 	termchar = '\0';
 	string = NULL;		/* just for gcc */
 
-	while ((ch = getopt_long(argc, argv, "adft:Vh", longopts, NULL)) != -1)
+	while ((ch = getopt_long(argc, argv, "adfk:t:Vh", longopts, NULL)) != -1)
 		switch(ch) {
 		case 'a':
 			file = _PATH_WORDS_ALT;
@@ -123,6 +127,9 @@ main(int argc, char *argv[])
 		case 'f':
 			fflag = 1;
 			break;
+		case 'k':
+			keys = optarg;
+			break;
 		case 't':
 			termchar = *optarg;
 			break;
@@ -136,9 +143,10 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	switch (argc) {
+	switch (keys ? argc + 1 : argc) {
 	case 2:				/* Don't set -df for user. */
-		string = *argv++;
+		if (!keys)
+			string = *argv++;
 		file = *argv;
 		break;
 	case 1:				/* But set -df by default. */
@@ -150,7 +158,14 @@ main(int argc, char *argv[])
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (termchar != '\0' && (p = strchr(string, termchar)) != NULL)
+	if (keys) {
+		if (strcmp(keys, "-") == 0)
+			keysf = stdin;
+		else if (!(keysf = fopen(keys, "r" UL_CLOEXECSTR)))
+			err(EXIT_FAILURE, "%s", keys);
+	}
+
+	if (!keys && termchar != '\0' && (p = strchr(string, termchar)) != NULL)
 		*++p = '\0';
 
 	if ((fd = open(file, O_RDONLY, 0)) < 0 || fstat(fd, &sb))
@@ -165,26 +180,38 @@ main(int argc, char *argv[])
 #endif
 			err(EXIT_FAILURE, "%s", file);
 	back = front + sb.st_size;
+
+	if (keysf) {
+		ch = look_keys(keysf, termchar, front, back);
+		if (keysf != stdin)
+			fclose(keysf);
+		return ch;
+	}
 	return look(front, back);
 }
 
-static int
-look(char *front, char *back)
+/* Reformat string to avoid doing it multiple times later. */
+static size_t
+prepare_string(char *str)
 {
 	int ch;
 	char *readp, *writep;
 
-	/* Reformat string to avoid doing it multiple times later. */
-	if (dflag) {
-		for (readp = writep = string; (ch = *readp++) != 0;) {
-			if (isalnum(ch) || isblank(ch))
-				*(writep++) = ch;
-		}
-		*writep = '\0';
-		stringlen = writep - string;
-	} else
-		stringlen = strlen(string);
+	if (!dflag)
+		return strlen(str);
+
+	for (readp = writep = str; (ch = *readp++) != 0;) {
+		if (isalnum(ch) || isblank(ch))
+			*(writep++) = ch;
+	}
+	*writep = '\0';
+	return writep - str;
+}
 
+static int
+look(char *front, char *back)
+{
+	stringlen = prepare_string(string);
 	comparbuf = xmalloc(stringlen+1);
 
 	front = binary_search(front, back);
@@ -198,6 +225,78 @@ look(char *front, char *back)
 	return (front ? 0 : 1);
 }
 
+static int
+cmp_keys(const void *a, const void *b)
+{
+	const char *s1 = *(char * const *) a, *s2 = *(char * const *) b;
+
+	return fflag ? strcasecmp(s1, s2) : strcmp(s1, s2);
+}
+
+/*
+ * Search all the strings from @keys. The strings are sorted in the same
+ * order as the file, so every search starts where the search for the previous
+ * string ended, and all the strings are searched in one pass through the file.
+ */
+static int
+look_keys(FILE *keys, int termchar, char *front, char *back)
+{
+	char **strs = NULL, *line = NULL;
+	size_t i, nstrs = 0, nalloc = 0, sz = 0, maxlen = 0;
+	ssize_t len;
+	int rc = 1;
+
+	while ((len = getline(&line, &sz, keys)) >= 0) {
+		char *p;
+
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (termchar != '\0' && (p = strchr(line, termchar)) != NULL)
+			*++p = '\0';
+		if (!*line)
+			continue;
+		if (nstrs == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			strs = xrealloc(strs, nalloc * sizeof(char *));
+		}
+		strs[nstrs] = xstrdup(line);
+		maxlen = max(maxlen, prepare_string(strs[nstrs]));
+		nstrs++;
+	}
+	free(line);
+
+	if (!nstrs)
+		return 1;
+
+	qsort(strs, nstrs, sizeof(char *), cmp_keys);
+	comparbuf = xmalloc(maxlen + 1);
+
+	for (i = 0; i < nstrs; i++) {
+		char *p;
+
+		string = strs[i];
+		stringlen = strlen(string);
+
+		/* the same string again */
+		if (i && cmp_keys(&strs[i - 1], &strs[i]) == 0)
+			continue;
+
+		/* the next string is never before this one */
+		front = binary_search(front, back);
+		p = linear_search(front, back);
+		if (p) {
+			print_from(p, back);
+			rc = 0;
+		}
+	}
+
+	for (i = 0; i < nstrs; i++)
+		free(strs[i]);
+	free(comparbuf);
+	free(strs);
+	return rc;
+}
+
 
 /*
  * Binary search for "string" in memory between "front" and "back".
@@ -293,20 +392,17 @@ linear_search(char *front, char *back)
 static void
 print_from(char *front, char *back)
 {
-	int eol;
-
-	while (front < back && compare(front, back) == EQUAL) {
-		if (compare(front, back) == EQUAL) {
-			eol = 0;
-			while (front < back && !eol) {
-				if (putchar(*front) == EOF)
-					err(EXIT_FAILURE, "stdout");
-				if (*front++ == '\n')
-					eol = 1;
-			}
-		} else
-			SKIP_PAST_NEWLINE(front, back);
+	char *end = front;
+
+	/* find the end of the matching lines and write them at once */
+	while (end < back && compare(end, back) == EQUAL) {
+		char *eol = memchr(end, '\n', back - end);
+
+		end = eol ? eol + 1 : back;
 	}
+	if (end > front &&
+	    fwrite(front, 1, end - front, stdout) != (size_t) (end - front))
+		err(EXIT_FAILURE, "stdout");
 }
 
 /*
@@ -330,6 +426,20 @@ compare(char *s2, char *s2end) {
 	int i;
 	char *p;
 
+	/* no -d and -f, the line prefix is compared as is */
+	if (!dflag && !fflag) {
+		size_t n = min((size_t) stringlen, (size_t) (s2end - s2));
+
+		p = memchr(s2, '\n', n);
+		if (p)
+			n = p - s2;
+		i = memcmp(s2, string, n);
+		if (i == 0 && n < (size_t) stringlen)
+			i = -1;		/* the line is shorter than string */
+
+		return ((i > 0) ? LESS : (i < 0) ? GREATER : EQUAL);
+	}
+
 	/* copy, ignoring things that should be ignored */
 	p = comparbuf;
 	i = stringlen;
@@ -357,6 +467,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	FILE *out = stdout;
 	fputs(USAGE_HEADER, out);
 	fprintf(out, _(" %s [options] <string> [<file>...]\n"), program_invocation_short_name);
+	fprintf(out, _(" %s [options] --keys <file> [<file>]\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Display lines beginning with a specified string.\n"), out);
@@ -365,6 +476,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -a, --alternative        use the alternative dictionary\n"), out);
 	fputs(_(" -d, --alphanum           compare only blanks and alphanumeric characters\n"), out);
 	fputs(_(" -f, --ignore-case        ignore case differences when comparing\n"), out);
+	fputs(_(" -k, --keys <file>        read the strings from <file>, one per line\n"), out);
 	fputs(_(" -t, --terminate <char>   define the string-termination character\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
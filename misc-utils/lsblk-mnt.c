@@ -179,3 +179,14 @@ void lsblk_mnt_deinit(void)
 	mnt_unref_table(swaps);
 	mnt_unref_cache(mntcache);
 }
+
+/* Forces to read mount tables again (see lsblk --poll). The filesystems
+ * have to be already removed from all devices by
+ * lsblk_device_free_filesystems().
+ */
+void lsblk_mnt_reset(void)
+{
+	mnt_unref_table(mtab);
+	mnt_unref_table(swaps);
+	mtab = swaps = NULL;
+}
@@ -1,9 +1,14 @@
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <blkid.h>
 
 #ifdef HAVE_LIBUDEV
 # include <libudev.h>
 #endif
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "c.h"
 #include "xalloc.h"
@@ -11,12 +16,15 @@
 #include "path.h"
 #include "nls.h"
 #include "strutils.h"
+#include "pathnames.h"
+#include "fileutils.h"
 
 #include "lsblk.h"
 
-#ifdef HAVE_LIBUDEV
-static struct udev *udev;
+#ifndef HAVE_LIBUDEV
+struct udev;
 #endif
+static struct udev *udev;	/* global handler */
 
 void lsblk_device_free_properties(struct lsblk_devprop *p)
 {
@@ -44,87 +52,266 @@ void lsblk_device_free_properties(struct lsblk_devprop *p)
 	free(p);
 }
 
+/* returns property value, used for udev database and libudev */
+typedef const char *udev_getvalue_t(void *data, const char *name);
+
+static struct lsblk_devprop *new_udev_properties(udev_getvalue_t *get, void *dev)
+{
+	const char *data;
+	struct lsblk_devprop *prop = xcalloc(1, sizeof(*prop));
+
+	if ((data = get(dev, "ID_FS_LABEL_ENC"))) {
+		prop->label = xstrdup(data);
+		unhexmangle_string(prop->label);
+	}
+	if ((data = get(dev, "ID_FS_UUID_ENC"))) {
+		prop->uuid = xstrdup(data);
+		unhexmangle_string(prop->uuid);
+	}
+	if ((data = get(dev, "ID_PART_TABLE_UUID")))
+		prop->ptuuid = xstrdup(data);
+	if ((data = get(dev, "ID_PART_TABLE_TYPE")))
+		prop->pttype = xstrdup(data);
+	if ((data = get(dev, "ID_PART_ENTRY_NAME"))) {
+		prop->partlabel = xstrdup(data);
+		unhexmangle_string(prop->partlabel);
+	}
+	if ((data = get(dev, "ID_FS_TYPE")))
+		prop->fstype = xstrdup(data);
+	if ((data = get(dev, "ID_FS_VERSION")))
+		prop->fsversion = xstrdup(data);
+	if ((data = get(dev, "ID_PART_ENTRY_TYPE")))
+		prop->parttype = xstrdup(data);
+	if ((data = get(dev, "ID_PART_ENTRY_UUID")))
+		prop->partuuid = xstrdup(data);
+	if ((data = get(dev, "ID_PART_ENTRY_FLAGS")))
+		prop->partflags = xstrdup(data);
+
+	data = get(dev, "ID_WWN_WITH_EXTENSION");
+	if (!data)
+		data = get(dev, "ID_WWN");
+	if (data)
+		prop->wwn = xstrdup(data);
+
+	data = get(dev, "SCSI_IDENT_SERIAL");	/* sg3_utils do not use I_D prefix */
+	if (!data)
+		data = get(dev, "ID_SCSI_SERIAL");
+	if(!data)
+		data = get(dev, "ID_SERIAL_SHORT");
+	if(!data)
+		data = get(dev, "ID_SERIAL");
+	if (data) {
+		prop->serial = xstrdup(data);
+		normalize_whitespace((unsigned char *) prop->serial);
+	}
+
+	if ((data = get(dev, "ID_MODEL_ENC"))) {
+		prop->model = xstrdup(data);
+		unhexmangle_string(prop->model);
+		normalize_whitespace((unsigned char *) prop->model);
+	} else if ((data = get(dev, "ID_MODEL"))) {
+		prop->model = xstrdup(data);
+		normalize_whitespace((unsigned char *) prop->model);
+	}
+
+	return prop;
+}
+
+/*
+ * The udev database is read by one pass of the /run/udev/data directory. The
+ * "E:" lines (properties) of the block device files (b<maj>:<min>) are stored
+ * as "KEY=value\0" strings to one buffer, only the keys used by lsblk are
+ * kept. It's faster than udev_device_new_from_subsystem_sysname() per device,
+ * and it does not depend on libudev at all.
+ *
+ * The database is read-only after the load (see lsblk_devtree_prefetch_properties()).
+ */
+struct udevdb_entry {
+	dev_t	devno;
+	size_t	off;		/* properties in udevdb.buf */
+	size_t	sz;
+};
+
+static struct udevdb {
+	struct udevdb_entry	*ents;	/* sorted by devno */
+	size_t			nents;
+
+	char			*buf;
+	size_t			bufsz;	/* used */
+	size_t			bufmax;	/* allocated */
+
+	unsigned int		loaded : 1,
+				available : 1;
+} udevdb;
+
+static int is_udevdb_key(const char *key)
+{
+	return startswith(key, "ID_") || startswith(key, "SCSI_IDENT_SERIAL=");
+}
+
+static void udevdb_append(const char *data, size_t sz)
+{
+	if (udevdb.bufsz + sz > udevdb.bufmax) {
+		udevdb.bufmax = max(udevdb.bufmax * 2, udevdb.bufsz + sz + BUFSIZ);
+		udevdb.buf = xrealloc(udevdb.buf, udevdb.bufmax);
+	}
+	memcpy(udevdb.buf + udevdb.bufsz, data, sz);
+	udevdb.bufsz += sz;
+}
+
+static int cmp_udevdb_devno(const void *a, const void *b)
+{
+	dev_t x = ((const struct udevdb_entry *) a)->devno,
+	      y = ((const struct udevdb_entry *) b)->devno;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void udevdb_load(void)
+{
+	DIR *dir;
+	struct dirent *d;
+	char *line = NULL;
+	size_t linesz = 0, allocated = 0;
+
+	if (udevdb.loaded)
+		return;
+	udevdb.loaded = 1;
+
+	dir = opendir(_PATH_UDEV_DATA);
+	if (!dir)
+		return;
+
+	while ((d = xreaddir(dir))) {
+		struct udevdb_entry *ent;
+		unsigned int maj, min;
+		FILE *f;
+		int fd;
+
+		if (d->d_name[0] != 'b'
+		    || sscanf(d->d_name + 1, "%u:%u", &maj, &min) != 2)
+			continue;
+
+		fd = openat(dirfd(dir), d->d_name, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		f = fdopen(fd, "r" UL_CLOEXECSTR);
+		if (!f) {
+			close(fd);
+			continue;
+		}
+
+		if (udevdb.nents == allocated) {
+			allocated = max(allocated * 2, (size_t) 64);
+			udevdb.ents = xrealloc(udevdb.ents, allocated * sizeof(*ent));
+		}
+		ent = &udevdb.ents[udevdb.nents++];
+		ent->devno = makedev(maj, min);
+		ent->off = udevdb.bufsz;
+
+		while (getline(&line, &linesz, f) > 0) {
+			size_t sz;
+
+			if (!startswith(line, "E:") || !is_udevdb_key(line + 2))
+				continue;
+			sz = strcspn(line + 2, "\n");
+			line[2 + sz] = '\0';
+			udevdb_append(line + 2, sz + 1);
+		}
+		ent->sz = udevdb.bufsz - ent->off;
+		fclose(f);
+	}
+	free(line);
+	closedir(dir);
+
+	if (udevdb.nents)
+		qsort(udevdb.ents, udevdb.nents, sizeof(struct udevdb_entry),
+				cmp_udevdb_devno);
+	udevdb.available = 1;
+
+	DBG(DEV, ul_debug("udev database: %zu devices, %zu bytes",
+				udevdb.nents, udevdb.bufsz));
+}
+
+static void udevdb_free(void)
+{
+	free(udevdb.ents);
+	free(udevdb.buf);
+	memset(&udevdb, 0, sizeof(udevdb));
+}
+
+static const char *udevdb_get_value(void *data, const char *name)
+{
+	struct udevdb_entry *ent = (struct udevdb_entry *) data;
+	const char *p = udevdb.buf + ent->off, *end = p + ent->sz;
+	size_t len = strlen(name);
+
+	for (; p < end; p += strlen(p) + 1) {
+		if (strncmp(p, name, len) == 0 && p[len] == '=')
+			return p + len + 1;
+	}
+	return NULL;
+}
+
+static struct lsblk_devprop *get_properties_by_udevdb(struct lsblk_device *ld)
+{
+	struct udevdb_entry key, *ent;
+
+	if (ld->udev_requested)
+		return ld->properties;
+
+	udevdb_load();
+	if (!udevdb.available)
+		return NULL;
+
+	key.devno = makedev(ld->maj, ld->min);
+	ent = bsearch(&key, udevdb.ents, udevdb.nents,
+			sizeof(struct udevdb_entry), cmp_udevdb_devno);
+	if (!ent)
+		return NULL;		/* not in the database, try libudev */
+
+	lsblk_device_free_properties(ld->properties);
+	ld->properties = new_udev_properties(udevdb_get_value, ent);
+	ld->udev_requested = 1;
+
+	DBG(DEV, ul_debugobj(ld, "%s: found udev properties (database)", ld->name));
+	return ld->properties;
+}
+
+/* forces to read the udev database again (see lsblk --poll) */
+void lsblk_properties_refresh(void)
+{
+	udevdb_free();
+}
+
 #ifndef HAVE_LIBUDEV
-static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *dev
-				__attribute__((__unused__)))
+static struct lsblk_devprop *get_properties_by_udev(
+				struct udev *ud __attribute__((__unused__)),
+				struct lsblk_device *dev __attribute__((__unused__)))
 {
 	return NULL;
 }
 #else
-static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *ld)
+static const char *libudev_get_value(void *data, const char *name)
+{
+	return udev_device_get_property_value((struct udev_device *) data, name);
+}
+
+static struct lsblk_devprop *get_properties_by_udev(struct udev *ud,
+						     struct lsblk_device *ld)
 {
 	struct udev_device *dev;
 
 	if (ld->udev_requested)
 		return ld->properties;
-
-	if (!udev)
-		udev = udev_new();	/* global handler */
-	if (!udev)
+	if (!ud)
 		goto done;
 
-	dev = udev_device_new_from_subsystem_sysname(udev, "block", ld->name);
+	dev = udev_device_new_from_subsystem_sysname(ud, "block", ld->name);
 	if (dev) {
-		const char *data;
-		struct lsblk_devprop *prop;
-
 		if (ld->properties)
 			lsblk_device_free_properties(ld->properties);
-		prop = ld->properties = xcalloc(1, sizeof(*ld->properties));
-
-		if ((data = udev_device_get_property_value(dev, "ID_FS_LABEL_ENC"))) {
-			prop->label = xstrdup(data);
-			unhexmangle_string(prop->label);
-		}
-		if ((data = udev_device_get_property_value(dev, "ID_FS_UUID_ENC"))) {
-			prop->uuid = xstrdup(data);
-			unhexmangle_string(prop->uuid);
-		}
-		if ((data = udev_device_get_property_value(dev, "ID_PART_TABLE_UUID")))
-			prop->ptuuid = xstrdup(data);
-		if ((data = udev_device_get_property_value(dev, "ID_PART_TABLE_TYPE")))
-			prop->pttype = xstrdup(data);
-		if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_NAME"))) {
-			prop->partlabel = xstrdup(data);
-			unhexmangle_string(prop->partlabel);
-		}
-		if ((data = udev_device_get_property_value(dev, "ID_FS_TYPE")))
-			prop->fstype = xstrdup(data);
-		if ((data = udev_device_get_property_value(dev, "ID_FS_VERSION")))
-			prop->fsversion = xstrdup(data);
-		if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_TYPE")))
-			prop->parttype = xstrdup(data);
-		if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_UUID")))
-			prop->partuuid = xstrdup(data);
-		if ((data = udev_device_get_property_value(dev, "ID_PART_ENTRY_FLAGS")))
-			prop->partflags = xstrdup(data);
-
-		data = udev_device_get_property_value(dev, "ID_WWN_WITH_EXTENSION");
-		if (!data)
-			data = udev_device_get_property_value(dev, "ID_WWN");
-		if (data)
-			prop->wwn = xstrdup(data);
-
-		data = udev_device_get_property_value(dev, "SCSI_IDENT_SERIAL");	/* sg3_utils do not use I_D prefix */
-		if (!data)
-			data = udev_device_get_property_value(dev, "ID_SCSI_SERIAL");
-		if(!data)
-			data = udev_device_get_property_value(dev, "ID_SERIAL_SHORT");
-		if(!data)
-			data = udev_device_get_property_value(dev, "ID_SERIAL");
-		if (data) {
-			prop->serial = xstrdup(data);
-			normalize_whitespace((unsigned char *) prop->serial);
-		}
-
-		if ((data = udev_device_get_property_value(dev, "ID_MODEL_ENC"))) {
-			prop->model = xstrdup(data);
-			unhexmangle_string(prop->model);
-			normalize_whitespace((unsigned char *) prop->model);
-		} else if ((data = udev_device_get_property_value(dev, "ID_MODEL"))) {
-			prop->model = xstrdup(data);
-			normalize_whitespace((unsigned char *) prop->model);
-		}
+		ld->properties = new_udev_properties(libudev_get_value, dev);
 
 		udev_device_unref(dev);
 		DBG(DEV, ul_debugobj(ld, "%s: found udev properties", ld->name));
@@ -307,22 +494,133 @@ done:
 	return dev->properties;
 }
 
-struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev)
+static struct lsblk_devprop *get_properties(struct udev *ud,
+					    struct lsblk_device *dev)
 {
 	struct lsblk_devprop *p = NULL;
 
-	DBG(DEV, ul_debugobj(dev, "%s: properties requested", dev->filename));
 	if (lsblk->sysroot)
 		return get_properties_by_file(dev);
 
-	p = get_properties_by_udev(dev);
+	p = get_properties_by_udevdb(dev);
+	if (!p)
+		p = get_properties_by_udev(ud, dev);
 	if (!p)
 		p = get_properties_by_blkid(dev);
 	return p;
 }
 
+struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev)
+{
+	DBG(DEV, ul_debugobj(dev, "%s: properties requested", dev->filename));
+#ifdef HAVE_LIBUDEV
+	if (!udev && !lsblk->sysroot)
+		udev = udev_new();
+#endif
+	return get_properties(udev, dev);
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Parallel gathering of the properties for all devices in the tree
+ */
+struct prop_workers {
+	struct lsblk_device	**devs;
+	size_t			ndevs;
+	size_t			next;	/* the next device to read */
+
+	pthread_mutex_t		lock;	/* protects @next */
+};
+
+static void *prop_worker(void *data)
+{
+	struct prop_workers *wrk = (struct prop_workers *) data;
+	struct udev *ud = NULL;
+
+#ifdef HAVE_LIBUDEV
+	/* libudev context must not be shared between threads */
+	if (!lsblk->sysroot)
+		ud = udev_new();
+#endif
+	while (1) {
+		size_t idx;
+
+		pthread_mutex_lock(&wrk->lock);
+		idx = wrk->next++;
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (idx >= wrk->ndevs)
+			break;
+		get_properties(ud, wrk->devs[idx]);
+	}
+#ifdef HAVE_LIBUDEV
+	udev_unref(ud);
+#endif
+	return NULL;
+}
+
+/*
+ * Reads properties for all devices in the tree by @nthreads threads. The
+ * devices are independent, and the main thread does not touch the tree until
+ * all workers are done; the result is cached in the devices, so a later
+ * lsblk_device_get_properties() does not read anything.
+ */
+void lsblk_devtree_prefetch_properties(struct lsblk_devtree *tr, size_t nthreads)
+{
+	struct prop_workers wrk = { .ndevs = 0 };
+	struct lsblk_device *dev;
+	struct lsblk_iter itr;
+	pthread_t *threads;
+	size_t i, nrun;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0)
+		wrk.ndevs++;
+	if (nthreads > wrk.ndevs)
+		nthreads = wrk.ndevs;
+	if (nthreads < 2)
+		return;			/* read on demand */
+
+	wrk.devs = xcalloc(wrk.ndevs, sizeof(struct lsblk_device *));
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+
+	i = 0;
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0)
+		wrk.devs[i++] = dev;
+
+	/* initialize library debug masks and read udev database before threads */
+	blkid_init_debug(0);
+	if (!lsblk->sysroot)
+		udevdb_load();
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	DBG(DEV, ul_debug("reading properties for %zu devices by %zu threads",
+				wrk.ndevs, nthreads));
+
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, prop_worker, &wrk) != 0)
+			break;
+	}
+	/* if no thread started, the properties are read on demand */
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+	free(wrk.devs);
+}
+#else
+void lsblk_devtree_prefetch_properties(
+			struct lsblk_devtree *tr __attribute__((__unused__)),
+			size_t nthreads __attribute__((__unused__)))
+{
+}
+#endif /* HAVE_LIBPTHREAD */
+
 void lsblk_properties_deinit(void)
 {
+	udevdb_free();
 #ifdef HAVE_LIBUDEV
 	udev_unref(udev);
 #endif
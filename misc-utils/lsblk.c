@@ -36,6 +36,16 @@
 #include <grp.h>
 #include <ctype.h>
 #include <assert.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+#ifdef HAVE_LIBUDEV
+# include <libudev.h>
+#endif
 
 #include <blkid.h>
 
@@ -52,6 +62,7 @@
 #include "fileutils.h"
 #include "loopdev.h"
 #include "buffer.h"
+#include "jsonwrt.h"
 
 #include "lsblk.h"
 
@@ -61,6 +72,12 @@ UL_DEBUG_DEFINE_MASKNAMES(lsblk) = UL_DEBUG_EMPTY_MASKNAMES;
 #define LSBLK_EXIT_SOMEOK 64
 #define LSBLK_EXIT_ALLFAILED 32
 
+/* default seconds to wait for statvfs() on unresponsive (NFS, FUSE, ...) mountpoints */
+#define LSBLK_STATVFS_TIMEOUT	5
+
+/* --poll, receive buffer for one uevent message */
+#define LSBLK_UEVENT_BUFSZ	(8 * 1024)
+
 static int column_id_to_number(int id);
 
 /* column IDs */
@@ -132,6 +149,7 @@ enum {
 	LSBLK_EXPORT =		(1 << 3),
 	LSBLK_TREE =		(1 << 4),
 	LSBLK_JSON =		(1 << 5),
+	LSBLK_BINARY =		(1 << 6),
 };
 
 /* Types used for qsort() and JSON */
@@ -336,7 +354,62 @@ static int column_id_to_number(int id)
 	return -1;
 }
 
+/* Returns 1 if any output column is based on udev or blkid properties */
+static int has_properties_column(void)
+{
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++) {
+		switch (columns[i]) {
+		case COL_OWNER:
+		case COL_GROUP:
+		case COL_MODE:
+			if (lsblk->sysroot)
+				return 1;
+			break;
+		case COL_FSTYPE:
+		case COL_FSVERSION:
+		case COL_LABEL:
+		case COL_UUID:
+		case COL_PTUUID:
+		case COL_PTTYPE:
+		case COL_PARTTYPE:
+		case COL_PARTTYPENAME:
+		case COL_PARTLABEL:
+		case COL_PARTUUID:
+		case COL_PARTFLAGS:
+		case COL_WWN:
+		case COL_MODEL:
+		case COL_SERIAL:
+			return 1;
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+
 /* Checks for DM prefix in the device name */
+/* returns SCOLS_JSON_* for the column */
+static int get_column_json_type(struct colinfo *ci)
+{
+	switch (ci->type) {
+	case COLTYPE_SIZE:
+		if (!lsblk->bytes)
+			break;
+		/* fallthrough */
+	case COLTYPE_NUM:
+		return SCOLS_JSON_NUMBER;
+	case COLTYPE_BOOL:
+		return SCOLS_JSON_BOOLEAN;
+	default:
+		break;
+	}
+	/* multi-line cells (now used for MOUNTPOINTS) */
+	return ci->flags & SCOLS_FL_WRAP ?
+			SCOLS_JSON_ARRAY_STRING : SCOLS_JSON_STRING;
+}
+
 static int is_dm(const char *name)
 {
 	return strncmp(name, "dm-", 3) ? 0 : 1;
@@ -571,19 +644,12 @@ static char *mk_dm_name(const char *name)
 	return p;
 }
 
-/* stores data to scols cell userdata (invisible and independent on output)
- * to make the original values accessible for sort functions
+/* stores the original value as the cell sort key (invisible and independent
+ * on output), see SCOLS_DATA_U64 columns initialization in main()
  */
 static void set_sortdata_u64(struct libscols_line *ln, int col, uint64_t x)
 {
-	struct libscols_cell *ce = scols_line_get_cell(ln, col);
-	uint64_t *data;
-
-	if (!ce)
-		return;
-	data = xmalloc(sizeof(uint64_t));
-	*data = x;
-	scols_cell_set_userdata(ce, data);
+	scols_cell_set_sort_u64(scols_line_get_cell(ln, col), x);
 }
 
 /* do not modify *data on any error */
@@ -602,24 +668,232 @@ static void str2u64(const char *str, uint64_t *data)
 	*data = num;
 }
 
-static void unref_sortdata(struct libscols_table *tb)
+#ifdef HAVE_LIBPTHREAD
+/*
+ * statvfs() for more mountpoints, every call in a helper thread. The threads
+ * are not possible to cancel (the syscall may wait in the kernel forever), so
+ * on timeout the remaining threads are abandoned and the last thread
+ * deallocates the requests.
+ */
+struct vfs_request {
+	struct vfs_batch *batch;
+	const char	*mnt;
+	struct statvfs	st;
+	int		rc;		/* 0 or errno */
+	unsigned int	done : 1;
+};
+
+struct vfs_batch {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+
+	struct vfs_request *reqs;
+	char		**mnts;
+	size_t		nreqs;
+	size_t		pending;	/* not done requests */
+	size_t		refcount;	/* threads + caller */
+};
+
+static void unref_vfs_batch(struct vfs_batch *batch)
 {
-	struct libscols_iter *itr;
-	struct libscols_line *ln;
+	size_t i, refcount;
+
+	pthread_mutex_lock(&batch->lock);
+	refcount = --batch->refcount;
+	pthread_mutex_unlock(&batch->lock);
 
-	if (!tb || !lsblk->sort_col)
+	if (refcount)
 		return;
-	itr = scols_new_iter(SCOLS_ITER_FORWARD);
-	if (!itr)
+
+	pthread_cond_destroy(&batch->cond);
+	pthread_mutex_destroy(&batch->lock);
+	for (i = 0; i < batch->nreqs; i++)
+		free(batch->mnts[i]);
+	free(batch->mnts);
+	free(batch->reqs);
+	free(batch);
+}
+
+static void *statvfs_worker(void *data)
+{
+	struct vfs_request *req = (struct vfs_request *) data;
+	struct vfs_batch *batch = req->batch;
+	int rc;
+
+	rc = statvfs(req->mnt, &req->st) == 0 ? 0 : errno;
+
+	pthread_mutex_lock(&batch->lock);
+	req->rc = rc;
+	req->done = 1;
+	if (--batch->pending == 0)
+		pthread_cond_signal(&batch->cond);
+	pthread_mutex_unlock(&batch->lock);
+
+	unref_vfs_batch(batch);
+	return NULL;
+}
+
+/*
+ * Calls statvfs() for all @mnts at the same time and waits at most @timeout
+ * seconds (0 means no limit) for all of them. The @rcs[] are set to 0,
+ * -ETIMEDOUT or -errno.
+ */
+static void statvfs_timeout(const char **mnts, struct statvfs *sts, int *rcs,
+			    size_t n, int timeout)
+{
+	struct vfs_batch *batch;
+	struct timespec deadline;
+	size_t i;
+	int rc = 0;
+
+	batch = xcalloc(1, sizeof(*batch));
+	batch->reqs = xcalloc(n, sizeof(struct vfs_request));
+	batch->mnts = xcalloc(n, sizeof(char *));
+	batch->nreqs = n;
+	batch->refcount = 1;
+	pthread_mutex_init(&batch->lock, NULL);
+	pthread_cond_init(&batch->cond, NULL);
+
+	for (i = 0; i < n; i++) {
+		struct vfs_request *req = &batch->reqs[i];
+		pthread_t thread;
+
+		batch->mnts[i] = xstrdup(mnts[i]);
+		req->batch = batch;
+		req->mnt = batch->mnts[i];
+
+		pthread_mutex_lock(&batch->lock);
+		batch->refcount++;
+		batch->pending++;
+		pthread_mutex_unlock(&batch->lock);
+
+		if (pthread_create(&thread, NULL, statvfs_worker, req) != 0) {
+			statvfs_worker(req);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout;
+
+	pthread_mutex_lock(&batch->lock);
+	while (batch->pending && rc != ETIMEDOUT) {
+		if (timeout)
+			rc = pthread_cond_timedwait(&batch->cond, &batch->lock, &deadline);
+		else
+			pthread_cond_wait(&batch->cond, &batch->lock);
+	}
+	for (i = 0; i < n; i++) {
+		struct vfs_request *req = &batch->reqs[i];
+
+		if (!req->done) {
+			rcs[i] = -ETIMEDOUT;
+			continue;
+		}
+		rcs[i] = -req->rc;
+		if (rcs[i] == 0)
+			memcpy(&sts[i], &req->st, sizeof(struct statvfs));
+	}
+	pthread_mutex_unlock(&batch->lock);
+
+	unref_vfs_batch(batch);
+}
+#else
+static void statvfs_timeout(const char **mnts, struct statvfs *sts, int *rcs,
+			    size_t n, int timeout __attribute__((__unused__)))
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		rcs[i] = statvfs(mnts[i], &sts[i]) == 0 ? 0 : -errno;
+}
+#endif /* HAVE_LIBPTHREAD */
+
+/* Returns 1 if the filesystem statistics of the device are not read yet */
+static int need_vfs_attributes(struct lsblk_device *dev)
+{
+	return !dev->fsstat.f_blocks && !dev->fsstat_timeout && !dev->is_swap
+	       && lsblk_device_get_mountpoint(dev);
+}
+
+static void set_vfs_attributes(struct lsblk_device *dev, struct statvfs *st, int rc)
+{
+	if (rc == -ETIMEDOUT) {
+		DBG(DEV, ul_debugobj(dev, "%s: statvfs() timeout",
+					lsblk_device_get_mountpoint(dev)));
+		dev->fsstat_timeout = 1;
+	} else if (rc == 0)
+		memcpy(&dev->fsstat, st, sizeof(struct statvfs));
+}
+
+/* Returns 1 if any output column is based on statvfs() */
+static int has_vfs_column(void)
+{
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++) {
+		switch (columns[i]) {
+		case COL_FSSIZE:
+		case COL_FSAVAIL:
+		case COL_FSUSED:
+		case COL_FSUSEPERC:
+			return 1;
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Reads the filesystem statistics for all mounted devices in the tree at
+ * once, so the unresponsive mountpoints cost one timeout in total rather
+ * than one timeout for each of them.
+ */
+static void devtree_prefetch_vfs_attributes(struct lsblk_devtree *tr)
+{
+	struct lsblk_device **devs, *dev = NULL;
+	struct lsblk_iter itr;
+	struct statvfs *sts;
+	const char **mnts;
+	size_t i, n = 0;
+	int *rcs;
+
+	if (!has_vfs_column())
 		return;
-	while (scols_table_next_line(tb, itr, &ln) == 0) {
-		struct libscols_cell *ce = scols_line_get_column_cell(ln,
-								lsblk->sort_col);
-		void *data = scols_cell_get_userdata(ce);
-		free(data);
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0) {
+		if (need_vfs_attributes(dev))
+			n++;
 	}
+	if (!n)
+		return;
 
-	scols_free_iter(itr);
+	devs = xcalloc(n, sizeof(struct lsblk_device *));
+	mnts = xcalloc(n, sizeof(char *));
+	sts = xcalloc(n, sizeof(struct statvfs));
+	rcs = xcalloc(n, sizeof(int));
+
+	i = 0;
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0 && i < n) {
+		if (!need_vfs_attributes(dev))
+			continue;
+		devs[i] = dev;
+		mnts[i++] = lsblk_device_get_mountpoint(dev);
+	}
+
+	statvfs_timeout(mnts, sts, rcs, i, lsblk->fs_timeout);
+
+	while (i-- > 0)
+		set_vfs_attributes(devs[i], &sts[i], rcs[i]);
+
+	free(devs);
+	free(mnts);
+	free(sts);
+	free(rcs);
 }
 
 static char *get_vfs_attribute(struct lsblk_device *dev, int id)
@@ -627,11 +901,21 @@ static char *get_vfs_attribute(struct lsblk_device *dev, int id)
 	char *sizestr;
 	uint64_t vfs_attr = 0;
 
+	if (dev->fsstat_timeout)
+		return xstrdup("?");
+
 	if (!dev->fsstat.f_blocks) {
 		const char *mnt = lsblk_device_get_mountpoint(dev);
+		struct statvfs st;
+		int rc;
+
 		if (!mnt || dev->is_swap)
 			return NULL;
-		if (statvfs(mnt, &dev->fsstat) != 0)
+		statvfs_timeout(&mnt, &st, &rc, 1, lsblk->fs_timeout);
+		set_vfs_attributes(dev, &st, rc);
+		if (rc == -ETIMEDOUT)
+			return xstrdup("?");
+		if (rc != 0)
 			return NULL;
 	}
 
@@ -1183,6 +1467,8 @@ static void devtree_to_scols(struct lsblk_devtree *tr, struct libscols_table *ta
 	struct lsblk_iter itr;
 	struct lsblk_device *dev = NULL;
 
+	devtree_prefetch_vfs_attributes(tr);
+
 	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
 
 	while (lsblk_devtree_next_root(tr, &itr, &dev) == 0)
@@ -1246,6 +1532,9 @@ static int initialize_device(struct lsblk_device *dev,
 		return -1;
 	}
 
+	/* many attributes are read from "queue/" and "device/" */
+	ul_path_enable_subdirs(dev->sysfs, 1);
+
 	dev->maj = major(devno);
 	dev->min = minor(devno);
 	dev->size = 0;
@@ -1266,8 +1555,15 @@ static int initialize_device(struct lsblk_device *dev,
 		}
 	}
 
-	dev->npartitions = sysfs_blkdev_count_partitions(dev->sysfs, dev->name);
-	dev->nholders = ul_path_count_dirents(dev->sysfs, "holders");
+	/* The partitions and holders are used only to build the tree; note
+	 * that partitions don't have partitions. The slaves are necessary
+	 * to detect in-middle devices, and for some columns */
+	if (!lsblk->nodeps) {
+		if (!wholedisk)
+			dev->npartitions = sysfs_blkdev_count_partitions(dev->sysfs, dev->name);
+		if (!lsblk->inverse)
+			dev->nholders = ul_path_count_dirents(dev->sysfs, "holders");
+	}
 	dev->nslaves = ul_path_count_dirents(dev->sysfs, "slaves");
 
 	DBG(DEV, ul_debugobj(dev, "%s: npartitions=%d, nholders=%d, nslaves=%d",
@@ -1778,25 +2074,6 @@ static void parse_includes(const char *str0)
 	}
 }
 
-/*
- * see set_sortdata_u64() and columns initialization in main()
- */
-static int cmp_u64_cells(struct libscols_cell *a,
-			 struct libscols_cell *b,
-			 __attribute__((__unused__)) void *data)
-{
-	uint64_t *adata = (uint64_t *) scols_cell_get_userdata(a),
-		 *bdata = (uint64_t *) scols_cell_get_userdata(b);
-
-	if (adata == NULL && bdata == NULL)
-		return 0;
-	if (adata == NULL)
-		return -1;
-	if (bdata == NULL)
-		return 1;
-	return *adata == *bdata ? 0 : *adata >= *bdata ? 1 : -1;
-}
-
 static void device_set_dedupkey(
 			struct lsblk_device *dev,
 			struct lsblk_device *parent,
@@ -1834,6 +2111,560 @@ static void devtree_set_dedupkeys(struct lsblk_devtree *tr, int id)
 		device_set_dedupkey(dev, NULL, id);
 }
 
+/*
+ * Reads the devices specified on command line, or all devices, to the tree
+ */
+static int process_devices(struct lsblk_devtree *tr, char **devices, int ndevices)
+{
+	int i, cnt_err = 0;
+
+	if (!ndevices) {
+		int rc = lsblk->inverse ?
+			process_all_devices_inverse(tr) :
+			process_all_devices(tr);
+
+		return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	for (i = 0; i < ndevices; i++) {
+		if (process_one_device(tr, devices[i]) != 0)
+			cnt_err++;
+	}
+	return	cnt_err == ndevices ? LSBLK_EXIT_ALLFAILED :	/* all failed */
+		cnt_err		    ? LSBLK_EXIT_SOMEOK :	/* some ok */
+				      EXIT_SUCCESS;		/* all success */
+}
+
+/*
+ * Reads expensive data for all the devices at once and removes duplicates
+ */
+static void finalize_devtree(struct lsblk_devtree *tr)
+{
+	if (lsblk->nthreads && has_properties_column()) {
+		long n = lsblk->nthreads;
+
+		if (n < 0)
+			n = sysconf(_SC_NPROCESSORS_ONLN);
+		lsblk_devtree_prefetch_properties(tr, n > 0 ? (size_t) n : 1);
+	}
+
+	if (lsblk->dedup_id > -1) {
+		devtree_set_dedupkeys(tr, lsblk->dedup_id);
+		lsblk_devtree_deduplicate_devices(tr);
+	}
+}
+
+/*
+ * --poll
+ *
+ * The devices are monitored by block subsystem uevents (from udevd if it's
+ * running, otherwise from kernel) and by libmount monitor. The changes are
+ * printed as JSON objects, one per line.
+ *
+ * The snapshot is an array of rows (column data for all devices) sorted by
+ * devno; the output is difference between the previous and current snapshot.
+ * The device tree is re-read on uevents, but the properties (udev or blkid)
+ * are read again only for the devices where the uevent has been reported.
+ * On mount changes only the mount tables and filesystem statistics are reset.
+ */
+struct poll_row {
+	dev_t	devno;
+	char	**data;			/* ncolumns items */
+};
+
+struct poll_snapshot {
+	struct poll_row	*rows;		/* sorted by devno */
+	size_t		nrows;
+};
+
+struct lsblk_poll {
+	struct lsblk_devtree	*tr;
+	struct poll_snapshot	snap;
+	struct ul_jsonwrt	json;
+
+	char		**devices;	/* command line devices */
+	int		ndevices;
+
+	char		**changed;	/* kernel names from uevents */
+	size_t		nchanged;
+
+	struct libmnt_monitor	*mnmon;
+	int			uevent_fd;
+#ifdef HAVE_LIBUDEV
+	struct udev		*udev;
+	struct udev_monitor	*udmon;
+#endif
+	unsigned int	all_changed : 1;	/* uevents lost */
+};
+
+static int is_hidden_column(size_t num)
+{
+	int id = get_column_id(num);
+
+	return (lsblk->sort_hidden && lsblk->sort_id == id)
+	       || (lsblk->dedup_hidden && lsblk->dedup_id == id);
+}
+
+static void device_to_row(struct lsblk_device *dev, struct poll_row *row)
+{
+	struct lsblk_device *parent = dev->wholedisk;
+	size_t i;
+
+	if (!parent) {
+		struct lsblk_iter itr;
+
+		lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+		if (lsblk_device_next_parent(dev, &itr, &parent) != 0)
+			parent = NULL;
+	}
+
+	row->devno = makedev(dev->maj, dev->min);
+	row->data = xcalloc(ncolumns, sizeof(char *));
+
+	for (i = 0; i < ncolumns; i++) {
+		if (!is_hidden_column(i))
+			row->data[i] = device_get_data(dev, parent,
+						get_column_id(i), NULL);
+	}
+	ul_path_close_dirfd(dev->sysfs);
+}
+
+static int cmp_rows_devno(const void *a, const void *b)
+{
+	dev_t x = ((const struct poll_row *) a)->devno,
+	      y = ((const struct poll_row *) b)->devno;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void devtree_to_snapshot(struct lsblk_devtree *tr, struct poll_snapshot *snap)
+{
+	struct lsblk_iter itr;
+	struct lsblk_device *dev = NULL;
+	size_t n = 0;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0)
+		n++;
+
+	devtree_prefetch_vfs_attributes(tr);
+
+	snap->rows = n ? xcalloc(n, sizeof(struct poll_row)) : NULL;
+	snap->nrows = 0;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0 && snap->nrows < n)
+		device_to_row(dev, &snap->rows[snap->nrows++]);
+
+	if (snap->nrows)
+		qsort(snap->rows, snap->nrows, sizeof(struct poll_row), cmp_rows_devno);
+}
+
+static void free_snapshot(struct poll_snapshot *snap)
+{
+	size_t i, c;
+
+	for (i = 0; i < snap->nrows; i++) {
+		for (c = 0; c < ncolumns; c++)
+			free(snap->rows[i].data[c]);
+		free(snap->rows[i].data);
+	}
+	free(snap->rows);
+	snap->rows = NULL;
+	snap->nrows = 0;
+}
+
+static int rows_differ(struct poll_row *a, struct poll_row *b)
+{
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++) {
+		const char *x = a->data[i], *y = b->data[i];
+
+		if (!x && !y)
+			continue;
+		if (!x || !y || strcmp(x, y) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void print_row(struct ul_jsonwrt *js, const char *action, struct poll_row *row)
+{
+	size_t i;
+
+	ul_jsonwrt_root_open(js);
+	ul_jsonwrt_value_s(js, "action", action);
+
+	for (i = 0; i < ncolumns; i++) {
+		struct colinfo *ci = get_column_info(i);
+		char *data = row->data[i];
+
+		if (is_hidden_column(i))
+			continue;
+
+		switch (get_column_json_type(ci)) {
+		case SCOLS_JSON_NUMBER:
+			ul_jsonwrt_value_raw(js, ci->name, data);
+			break;
+		case SCOLS_JSON_BOOLEAN:
+			ul_jsonwrt_value_boolean(js, ci->name,
+				!data || !*data ? 0 :
+				*data == '0' ? 0 :
+				*data == 'N' || *data == 'n' ? 0 : 1);
+			break;
+		case SCOLS_JSON_ARRAY_STRING:
+			/* multi-line cells, see SCOLS_FL_WRAP */
+			ul_jsonwrt_array_open(js, ci->name);
+			if (!data)
+				ul_jsonwrt_value_s(js, NULL, NULL);
+			else do {
+				char *nl = strchr(data, '\n');
+
+				if (nl)
+					*nl = '\0';
+				ul_jsonwrt_value_s(js, NULL, data);
+				if (nl)
+					*nl = '\n';
+				data = nl ? nl + 1 : NULL;
+			} while (data);
+			ul_jsonwrt_array_close(js);
+			break;
+		default:
+			ul_jsonwrt_value_s(js, ci->name, data);
+			break;
+		}
+	}
+	ul_jsonwrt_root_close(js);
+}
+
+/* prints differences between @old and @new snapshots, returns number of lines */
+static size_t print_snapshot_diff(struct ul_jsonwrt *js,
+				  struct poll_snapshot *old,
+				  struct poll_snapshot *new)
+{
+	size_t i = 0, j = 0, count = 0;
+
+	while (i < old->nrows || j < new->nrows) {
+		struct poll_row *o = i < old->nrows ? &old->rows[i] : NULL,
+				*n = j < new->nrows ? &new->rows[j] : NULL;
+
+		if (!n || (o && o->devno < n->devno)) {
+			print_row(js, "remove", o);
+			count++;
+			i++;
+		} else if (!o || n->devno < o->devno) {
+			print_row(js, "add", n);
+			count++;
+			j++;
+		} else {
+			if (rows_differ(o, n)) {
+				print_row(js, "change", n);
+				count++;
+			}
+			i++;
+			j++;
+		}
+	}
+	return count;
+}
+
+static int poll_is_changed(struct lsblk_poll *p, const char *name)
+{
+	size_t i;
+
+	if (p->all_changed)
+		return 1;
+	for (i = 0; i < p->nchanged; i++) {
+		if (strcmp(p->changed[i], name) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void poll_add_changed(struct lsblk_poll *p, const char *name)
+{
+	if (!name || !*name || poll_is_changed(p, name))
+		return;
+
+	DBG(DEV, ul_debug("poll: uevent for %s", name));
+	p->changed = xrealloc(p->changed, (p->nchanged + 1) * sizeof(char *));
+	p->changed[p->nchanged++] = xstrdup(name);
+}
+
+static void poll_reset_changed(struct lsblk_poll *p)
+{
+	size_t i;
+
+	for (i = 0; i < p->nchanged; i++)
+		free(p->changed[i]);
+	free(p->changed);
+	p->changed = NULL;
+	p->nchanged = 0;
+	p->all_changed = 0;
+}
+
+static int open_kernel_uevents(void)
+{
+	struct sockaddr_nl nl = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1		/* kernel events */
+	};
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+			NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+	if (bind(fd, (struct sockaddr *) &nl, sizeof(nl)) != 0) {
+		int rc = -errno;
+
+		close(fd);
+		return rc;
+	}
+	return fd;
+}
+
+/* The message is "<action>@<devpath>\0" followed by "KEY=value\0" items */
+static void read_kernel_uevents(struct lsblk_poll *p)
+{
+	char buf[LSBLK_UEVENT_BUFSZ];
+
+	while (1) {
+		struct sockaddr_nl nl;
+		socklen_t nlsz = sizeof(nl);
+		const char *devpath = NULL;
+		int is_block = 0;
+		ssize_t sz;
+		char *s;
+
+		sz = recvfrom(p->uevent_fd, buf, sizeof(buf) - 1, 0,
+				(struct sockaddr *) &nl, &nlsz);
+		if (sz < 0) {
+			if (errno == ENOBUFS)
+				p->all_changed = 1;	/* overrun */
+			if (errno == EINTR || errno == ENOBUFS)
+				continue;
+			break;
+		}
+		if (nl.nl_pid != 0)
+			continue;		/* not from kernel */
+		buf[sz] = '\0';
+
+		for (s = buf; s < buf + sz; s += strlen(s) + 1) {
+			if (strcmp(s, "SUBSYSTEM=block") == 0)
+				is_block = 1;
+			else if (startswith(s, "DEVPATH="))
+				devpath = s + 8;
+		}
+		if (is_block && devpath && (s = strrchr(devpath, '/')))
+			poll_add_changed(p, s + 1);
+		else if (is_block)
+			p->all_changed = 1;
+	}
+}
+
+#ifdef HAVE_LIBUDEV
+static void read_udev_events(struct lsblk_poll *p)
+{
+	struct udev_device *dev;
+
+	while ((dev = udev_monitor_receive_device(p->udmon))) {
+		poll_add_changed(p, udev_device_get_sysname(dev));
+		udev_device_unref(dev);
+	}
+}
+
+/* The udev database is updated after kernel uevents; let's wait for udevd */
+static int open_udev_events(struct lsblk_poll *p)
+{
+	if (access(_PATH_UDEV_CONTROL, F_OK) != 0)
+		return -ENOENT;		/* udevd is not running */
+
+	p->udev = udev_new();
+	if (p->udev)
+		p->udmon = udev_monitor_new_from_netlink(p->udev, "udev");
+	if (!p->udmon
+	    || udev_monitor_filter_add_match_subsystem_devtype(p->udmon, "block", NULL) < 0
+	    || udev_monitor_enable_receiving(p->udmon) < 0) {
+		udev_monitor_unref(p->udmon);
+		udev_unref(p->udev);
+		p->udmon = NULL;
+		p->udev = NULL;
+		return -EINVAL;
+	}
+	return udev_monitor_get_fd(p->udmon);
+}
+#endif /* HAVE_LIBUDEV */
+
+static int poll_open_uevents(struct lsblk_poll *p __attribute__((__unused__)))
+{
+	int fd = -1;
+
+#ifdef HAVE_LIBUDEV
+	fd = open_udev_events(p);
+#endif
+	if (fd < 0)
+		fd = open_kernel_uevents();
+	return fd;
+}
+
+static void poll_read_uevents(struct lsblk_poll *p)
+{
+#ifdef HAVE_LIBUDEV
+	if (p->udmon) {
+		read_udev_events(p);
+		return;
+	}
+#endif
+	read_kernel_uevents(p);
+}
+
+/*
+ * Reads the tree again and moves properties from the old devices to the new
+ * devices, except the devices where uevent has been reported.
+ */
+static void poll_rebuild_devtree(struct lsblk_poll *p)
+{
+	struct lsblk_devtree *tr;
+	struct lsblk_iter itr;
+	struct lsblk_device *dev = NULL;
+
+	tr = lsblk_new_devtree();
+	if (!tr)
+		err(EXIT_FAILURE, _("failed to allocate device tree"));
+
+	/* re-scan /sys/dev/block and udev database */
+	sysfs_enable_devcache(0);
+	sysfs_enable_devcache(1);
+	lsblk_properties_refresh();
+
+	process_devices(tr, p->devices, p->ndevices);
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0) {
+		struct lsblk_device *old = lsblk_devtree_get_device(p->tr, dev->name);
+
+		if (!old || poll_is_changed(p, dev->name)
+		    || old->maj != dev->maj || old->min != dev->min)
+			continue;
+
+		dev->properties = old->properties;
+		dev->udev_requested = old->udev_requested;
+		dev->blkid_requested = old->blkid_requested;
+		dev->file_requested = old->file_requested;
+		old->properties = NULL;
+	}
+
+	finalize_devtree(tr);
+
+	lsblk_unref_devtree(p->tr);
+	p->tr = tr;
+}
+
+/* the next lsblk_device_get_filesystems() reads the mount tables again */
+static void poll_reset_mounts(struct lsblk_poll *p)
+{
+	struct lsblk_iter itr;
+	struct lsblk_device *dev = NULL;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(p->tr, &itr, &dev) == 0) {
+		lsblk_device_free_filesystems(dev);
+		memset(&dev->fsstat, 0, sizeof(dev->fsstat));
+	}
+	lsblk_mnt_reset();
+}
+
+static int poll_devices(struct lsblk_poll *p, int timeout)
+{
+	struct pollfd fds[2];
+	nfds_t nfds = 0, i;
+
+	p->uevent_fd = poll_open_uevents(p);
+	if (p->uevent_fd < 0) {
+		errno = -p->uevent_fd;
+		warn(_("cannot monitor block devices uevents"));
+		return -1;
+	}
+	fds[nfds].fd = p->uevent_fd;
+	fds[nfds++].events = POLLIN;
+
+	p->mnmon = mnt_new_monitor();
+	if (!p->mnmon || mnt_monitor_enable_kernel(p->mnmon, 1) < 0
+	    || mnt_monitor_get_fd(p->mnmon) < 0) {
+		warnx(_("failed to initialize libmount monitor"));
+		return -1;
+	}
+	fds[nfds].fd = mnt_monitor_get_fd(p->mnmon);
+	fds[nfds++].events = POLLIN;
+
+	ul_jsonwrt_init(&p->json, stdout, 0);
+	ul_jsonwrt_enable_compact(&p->json, 1);
+
+	/* the current state as "add" for all devices */
+	devtree_to_snapshot(p->tr, &p->snap);
+	for (i = 0; i < p->snap.nrows; i++)
+		print_row(&p->json, "add", &p->snap.rows[i]);
+	fflush(stdout);
+
+	while (1) {
+		struct poll_snapshot snap;
+		int uevent = 0, mount = 0, count;
+
+		count = poll(fds, nfds, timeout);
+		if (count == 0)
+			break;	/* timeout */
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("poll() failed"));
+			return -1;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			poll_read_uevents(p);
+			uevent = p->nchanged || p->all_changed;
+		}
+		if (fds[1].revents & POLLIN) {
+			while (mnt_monitor_next_change(p->mnmon, NULL, NULL) == 0)
+				mount = 1;
+		}
+		if (!uevent && !mount)
+			continue;
+
+		DBG(DEV, ul_debug("poll: %s%s changed",
+				uevent ? "devices " : "", mount ? "mounts " : ""));
+		if (mount)
+			poll_reset_mounts(p);
+		if (uevent)
+			poll_rebuild_devtree(p);
+		poll_reset_changed(p);
+
+		devtree_to_snapshot(p->tr, &snap);
+		if (print_snapshot_diff(&p->json, &p->snap, &snap))
+			fflush(stdout);
+		free_snapshot(&p->snap);
+		p->snap = snap;
+	}
+	return 0;
+}
+
+static void poll_deinit(struct lsblk_poll *p)
+{
+	free_snapshot(&p->snap);
+	poll_reset_changed(p);
+	mnt_unref_monitor(p->mnmon);
+#ifdef HAVE_LIBUDEV
+	if (p->udmon) {
+		udev_monitor_unref(p->udmon);
+		udev_unref(p->udev);
+	} else
+#endif
+	if (p->uevent_fd >= 0)
+		close(p->uevent_fd);
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -1872,7 +2703,13 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -w, --width <num>    specifies output width as number of characters\n"), out);
 	fputs(_(" -x, --sort <column>  sort output by <column>\n"), out);
 	fputs(_(" -z, --zoned          print zone model\n"), out);
+	fputs(_("     --binary         use binary output format\n"), out);
+	fputs(_("     --fs-timeout <sec>\n"
+		"                      upper limit in seconds to wait for filesystem statistics\n"), out);
+	fputs(_("     --parallel <num> read device properties by <num> threads (0 means auto)\n"), out);
+	fputs(_("     --poll           monitor changes, print them in JSON one device per line\n"), out);
 	fputs(_("     --sysroot <dir>  use specified directory as system root\n"), out);
+	fputs(_("     --timeout <num>  upper limit in milliseconds that --poll will block\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(22));
 
@@ -1899,21 +2736,28 @@ int main(int argc, char *argv[])
 		.sort_id = -1,
 		.dedup_id = -1,
 		.flags = LSBLK_TREE,
-		.tree_id = COL_NAME
+		.tree_id = COL_NAME,
+		.fs_timeout = LSBLK_STATVFS_TIMEOUT
 	};
 	struct lsblk_devtree *tr = NULL;
 	int c, status = EXIT_FAILURE;
 	char *outarg = NULL;
 	size_t i;
 	unsigned int width = 0;
-	int force_tree = 0, has_tree_col = 0;
+	int force_tree = 0, has_tree_col = 0, polling = 0, timeout = -1;
 
 	enum {
-		OPT_SYSROOT = CHAR_MAX + 1
+		OPT_SYSROOT = CHAR_MAX + 1,
+		OPT_BINARY,
+		OPT_FS_TIMEOUT,
+		OPT_PARALLEL,
+		OPT_POLL,
+		OPT_TIMEOUT
 	};
 
 	static const struct option longopts[] = {
 		{ "all",	no_argument,       NULL, 'a' },
+		{ "binary",     no_argument,       NULL, OPT_BINARY },
 		{ "bytes",      no_argument,       NULL, 'b' },
 		{ "nodeps",     no_argument,       NULL, 'd' },
 		{ "discard",    no_argument,       NULL, 'D' },
@@ -1931,14 +2775,18 @@ int main(int argc, char *argv[])
 		{ "raw",        no_argument,       NULL, 'r' },
 		{ "inverse",	no_argument,       NULL, 's' },
 		{ "fs",         no_argument,       NULL, 'f' },
+		{ "fs-timeout", required_argument, NULL, OPT_FS_TIMEOUT },
 		{ "exclude",    required_argument, NULL, 'e' },
 		{ "include",    required_argument, NULL, 'I' },
 		{ "topology",   no_argument,       NULL, 't' },
 		{ "paths",      no_argument,       NULL, 'p' },
 		{ "pairs",      no_argument,       NULL, 'P' },
+		{ "parallel",   required_argument, NULL, OPT_PARALLEL },
+		{ "poll",       no_argument,       NULL, OPT_POLL },
 		{ "scsi",       no_argument,       NULL, 'S' },
 		{ "sort",	required_argument, NULL, 'x' },
 		{ "sysroot",    required_argument, NULL, OPT_SYSROOT },
+		{ "timeout",    required_argument, NULL, OPT_TIMEOUT },
 		{ "tree",       optional_argument, NULL, 'T' },
 		{ "version",    no_argument,       NULL, 'V' },
 		{ "width",	required_argument, NULL, 'w' },
@@ -1948,7 +2796,7 @@ int main(int argc, char *argv[])
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'D','O' },
 		{ 'I','e' },
-		{ 'J', 'P', 'r' },
+		{ 'J', 'P', 'r', OPT_BINARY, OPT_POLL },
 		{ 'O','S' },
 		{ 'O','f' },
 		{ 'O','m' },
@@ -2089,6 +2937,27 @@ int main(int argc, char *argv[])
 		case OPT_SYSROOT:
 			lsblk->sysroot = optarg;
 			break;
+		case OPT_BINARY:
+			lsblk->flags |= LSBLK_BINARY;
+			break;
+		case OPT_FS_TIMEOUT:
+			lsblk->fs_timeout = strtos32_or_err(optarg, _("invalid timeout argument"));
+			if (lsblk->fs_timeout < 0)
+				errx(EXIT_FAILURE, _("invalid timeout argument: '%s'"), optarg);
+			break;
+		case OPT_PARALLEL:
+			lsblk->nthreads = strtos32_or_err(optarg, _("invalid number of threads argument"));
+			if (lsblk->nthreads < 0)
+				errx(EXIT_FAILURE, _("invalid number of threads argument: '%s'"), optarg);
+			if (lsblk->nthreads == 0)
+				lsblk->nthreads = -1;	/* auto */
+			break;
+		case OPT_POLL:
+			polling = 1;
+			break;
+		case OPT_TIMEOUT:
+			timeout = strtos32_or_err(optarg, _("invalid timeout argument"));
+			break;
 		case 'E':
 			lsblk->dedup_id = column_name_to_id(optarg, strlen(optarg));
 			if (lsblk->dedup_id >= 0)
@@ -2117,6 +2986,14 @@ int main(int argc, char *argv[])
 
 	if (force_tree)
 		lsblk->flags |= LSBLK_TREE;
+	if (timeout != -1 && !polling)
+		errx(EXIT_FAILURE, _("--timeout requires --poll"));
+	if (polling && lsblk->sysroot)
+		errx(EXIT_FAILURE, _("--poll is unsupported with --sysroot"));
+	if (polling) {
+		lsblk->flags |= LSBLK_JSON;	/* parsable data */
+		lsblk->flags &= ~LSBLK_TREE;
+	}
 
 	check_sysdevblock();
 
@@ -2172,9 +3049,10 @@ int main(int argc, char *argv[])
 	scols_table_enable_export(lsblk->table, !!(lsblk->flags & LSBLK_EXPORT));
 	scols_table_enable_ascii(lsblk->table, !!(lsblk->flags & LSBLK_ASCII));
 	scols_table_enable_json(lsblk->table, !!(lsblk->flags & LSBLK_JSON));
+	scols_table_enable_binary(lsblk->table, !!(lsblk->flags & LSBLK_BINARY));
 	scols_table_enable_noheadings(lsblk->table, !!(lsblk->flags & LSBLK_NOHEADINGS));
 
-	if (lsblk->flags & LSBLK_JSON)
+	if (lsblk->flags & (LSBLK_JSON | LSBLK_BINARY))
 		scols_table_set_name(lsblk->table, "blockdevices");
 	if (width) {
 		scols_table_set_termwidth(lsblk->table, width);
@@ -2215,11 +3093,10 @@ int main(int argc, char *argv[])
 		}
 		if (!lsblk->sort_col && lsblk->sort_id == id) {
 			lsblk->sort_col = cl;
-			scols_column_set_cmpfunc(cl,
-				ci->type == COLTYPE_NUM     ? cmp_u64_cells :
-				ci->type == COLTYPE_SIZE    ? cmp_u64_cells :
-			        ci->type == COLTYPE_SORTNUM ? cmp_u64_cells : scols_cmpstr_cells,
-				NULL);
+			scols_column_set_data_type(cl,
+				ci->type == COLTYPE_NUM     ? SCOLS_DATA_U64 :
+				ci->type == COLTYPE_SIZE    ? SCOLS_DATA_U64 :
+			        ci->type == COLTYPE_SORTNUM ? SCOLS_DATA_U64 : SCOLS_DATA_STRING);
 		}
 		/* multi-line cells (now used for MOUNTPOINTS) */
 		if (fl & SCOLS_FL_WRAP) {
@@ -2230,55 +3107,34 @@ int main(int argc, char *argv[])
 			scols_column_set_safechars(cl, "\n");
 		}
 
-		if (lsblk->flags & LSBLK_JSON) {
-			switch (ci->type) {
-			case COLTYPE_SIZE:
-				if (!lsblk->bytes)
-					break;
-				/* fallthrough */
-			case COLTYPE_NUM:
-				scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
-				break;
-			case COLTYPE_BOOL:
-				scols_column_set_json_type(cl, SCOLS_JSON_BOOLEAN);
-				break;
-			default:
-				if (fl & SCOLS_FL_WRAP)
-					scols_column_set_json_type(cl, SCOLS_JSON_ARRAY_STRING);
-				else
-					scols_column_set_json_type(cl, SCOLS_JSON_STRING);
-				break;
-			}
-		}
+		if (lsblk->flags & (LSBLK_JSON | LSBLK_BINARY))
+			scols_column_set_json_type(cl, get_column_json_type(ci));
 	}
 
 	tr = lsblk_new_devtree();
 	if (!tr)
 		err(EXIT_FAILURE, _("failed to allocate device tree"));
 
-	if (optind == argc) {
-		int rc = lsblk->inverse ?
-			process_all_devices_inverse(tr) :
-			process_all_devices(tr);
-
-		status = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
-	} else {
-		int cnt = 0, cnt_err = 0;
-
-		while (optind < argc) {
-			if (process_one_device(tr, argv[optind++]) != 0)
-				cnt_err++;
-			cnt++;
-		}
-		status = cnt == 0	? EXIT_FAILURE :	/* nothing */
-			 cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
-			 cnt_err	? LSBLK_EXIT_SOMEOK :	/* some ok */
-					  EXIT_SUCCESS;		/* all success */
-	}
-
-	if (lsblk->dedup_id > -1) {
-		devtree_set_dedupkeys(tr, lsblk->dedup_id);
-		lsblk_devtree_deduplicate_devices(tr);
+	/* all devices are read by one scan of /sys/dev/block */
+	if (!lsblk->sysroot)
+		sysfs_enable_devcache(1);
+
+	status = process_devices(tr, argv + optind, argc - optind);
+	finalize_devtree(tr);
+
+	if (polling) {
+		struct lsblk_poll p = {
+			.tr = tr,
+			.devices = argv + optind,
+			.ndevices = argc - optind,
+			.uevent_fd = -1
+		};
+
+		if (poll_devices(&p, timeout) != 0)
+			status = EXIT_FAILURE;
+		tr = p.tr;
+		poll_deinit(&p);
+		goto leave;
 	}
 
 	devtree_to_scols(tr, lsblk->table);
@@ -2291,14 +3147,12 @@ int main(int argc, char *argv[])
 	scols_print_table(lsblk->table);
 
 leave:
-	if (lsblk->sort_col)
-		unref_sortdata(lsblk->table);
-
 	scols_unref_table(lsblk->table);
 
 	lsblk_mnt_deinit();
 	lsblk_properties_deinit();
 	lsblk_unref_devtree(tr);
+	sysfs_enable_devcache(0);
 
 	return status;
 }
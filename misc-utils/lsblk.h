@@ -44,6 +44,8 @@ struct lsblk {
 
 	const char *sysroot;
 	int flags;			/* LSBLK_* */
+	int nthreads;			/* --parallel; 0: serial, -1: auto */
+	int fs_timeout;			/* --fs-timeout in seconds; 0: no limit */
 
 	unsigned int all_devices:1;	/* print all devices, including empty */
 	unsigned int bytes:1;		/* print SIZE in bytes */
@@ -138,7 +140,8 @@ struct lsblk_device {
 			is_printed : 1,
 			udev_requested : 1,
 			blkid_requested : 1,
-			file_requested : 1;
+			file_requested : 1,
+			fsstat_timeout : 1;	/* statvfs() does not respond */
 };
 
 #define device_is_partition(_x)		((_x)->wholedisk != NULL)
@@ -208,6 +211,7 @@ struct lsblk_iter {
 /* lsblk-mnt.c */
 extern void lsblk_mnt_init(void);
 extern void lsblk_mnt_deinit(void);
+extern void lsblk_mnt_reset(void);
 
 extern void lsblk_device_free_filesystems(struct lsblk_device *dev);
 extern const char *lsblk_device_get_mountpoint(struct lsblk_device *dev);
@@ -217,6 +221,8 @@ extern struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev,
 extern void lsblk_device_free_properties(struct lsblk_devprop *p);
 extern struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev);
 extern void lsblk_properties_deinit(void);
+extern void lsblk_properties_refresh(void);
+extern void lsblk_devtree_prefetch_properties(struct lsblk_devtree *tr, size_t nthreads);
 
 extern const char *lsblk_parttype_code_to_string(const char *code, const char *pttype);
 
@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -110,8 +111,64 @@ struct lock {
 		     blocked   :1;
 	uint64_t size;
 	int id;
+
+	ino_t inode;	/* used to find the path */
+	dev_t dev;
+};
+
+/* the locked files opened by a process */
+struct lock_fds {
+	struct lock_fd {
+		ino_t inode;	/* must be the first, see cmp_inode() */
+		uint64_t size;
+		char *path;
+		size_t pos;	/* readdir() order */
+	} *fds;			/* sorted by inode */
+	size_t nfds;
+	size_t nalloc;
+};
+
+static int cmp_inode(const void *a, const void *b)
+{
+	ino_t x = *(const ino_t *) a, y = *(const ino_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* the same file may be opened more times, the first descriptor wins */
+static int cmp_lock_fds(const void *a, const void *b)
+{
+	const struct lock_fd *x = a, *y = b;
+	int rc = cmp_inode(&x->inode, &y->inode);
+
+	if (rc == 0)
+		rc = x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+	return rc;
+}
+
+/* index of the lock holders by lock ID */
+struct lock_holder {
+	int id;
+	pid_t pid;
+	size_t pos;	/* locks list order */
 };
 
+static int cmp_lock_holders(const void *a, const void *b)
+{
+	const struct lock_holder *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static int cmp_lock_holder_id(const void *a, const void *b)
+{
+	const struct lock_holder *x = a, *y = b;
+
+	return x->id < y->id ? -1 : x->id > y->id ? 1 : 0;
+}
+
 static void rem_lock(struct lock *lock)
 {
 	if (!lock)
@@ -156,41 +213,37 @@ static char *get_fallback_filename(dev_t dev)
 }
 
 /*
- * Return the absolute path of a file from
- * a given inode number (and its size)
+ * Called by /proc snapshot for every lock owner. We know the pid so we don't
+ * have to iterate the *entire* filesystem searching for the damn file; the
+ * descriptors are read only once per process, and only the descriptors with
+ * a locked inode (sorted @data array) are kept.
  */
-static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+static int read_lock_fds(struct proc_snapshot *ps __attribute__((__unused__)),
+			 struct proc_entry *ent, int dir, void *data)
 {
-	struct stat sb;
+	ino_t *inodes = data;
+	struct lock_fds *lf;
 	struct dirent *dp;
 	DIR *dirp;
-	size_t len;
 	int fd;
-	char path[PATH_MAX], sym[PATH_MAX], *ret = NULL;
-
-	*size = 0;
-	memset(path, 0, sizeof(path));
-	memset(sym, 0, sizeof(sym));
-
-	/*
-	 * We know the pid so we don't have to
-	 * iterate the *entire* filesystem searching
-	 * for the damn file.
-	 */
-	sprintf(path, "/proc/%d/fd/", lock_pid);
-	if (!(dirp = opendir(path)))
-		return NULL;
 
-	if ((len = strlen(path)) >= (sizeof(path) - 2))
-		goto out;
+	/* no permissions to the descriptors is not an error, command
+	 * name is still usable */
+	fd = openat(dir, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+	if (!(dirp = fdopendir(fd))) {
+		close(fd);
+		return 0;
+	}
 
-	if ((fd = dirfd(dirp)) < 0 )
-		goto out;
+	lf = xcalloc(1, sizeof(*lf));
 
 	while ((dp = readdir(dirp))) {
-		if (!strcmp(dp->d_name, ".") ||
-		    !strcmp(dp->d_name, ".."))
-			continue;
+		struct lock_fd *x;
+		struct stat sb;
+		char sym[PATH_MAX];
+		ssize_t len;
 
 		errno = 0;
 
@@ -198,22 +251,74 @@ static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
 		if (!strtol(dp->d_name, (char **) NULL, 10) || errno)
 			continue;
 
-		if (!fstatat(fd, dp->d_name, &sb, 0)
-		    && inode != sb.st_ino)
+		if (fstatat(fd, dp->d_name, &sb, 0)
+		    || !bsearch(&sb.st_ino, inodes + 1, inodes[0],
+				sizeof(ino_t), cmp_inode))
 			continue;
 
 		if ((len = readlinkat(fd, dp->d_name, sym, sizeof(sym) - 1)) < 1)
-			goto out;
-
-		*size = sb.st_size;
+			continue;
 		sym[len] = '\0';
 
-		ret = xstrdup(sym);
-		break;
+		if (lf->nfds == lf->nalloc) {
+			lf->nalloc = lf->nalloc ? lf->nalloc * 2 : 8;
+			lf->fds = xrealloc(lf->fds, lf->nalloc * sizeof(struct lock_fd));
+		}
+		x = &lf->fds[lf->nfds];
+		x->inode = sb.st_ino;
+		x->size = sb.st_size;
+		x->path = xstrdup(sym);
+		x->pos = lf->nfds++;
 	}
-out:
+
 	closedir(dirp);
-	return ret;
+
+	if (lf->nfds > 1)
+		qsort(lf->fds, lf->nfds, sizeof(struct lock_fd), cmp_lock_fds);
+	ent->data = lf;
+	return 0;
+}
+
+/*
+ * Return the absolute path of a file from
+ * a given inode number (and its size)
+ */
+static char *get_filename_sz(struct proc_entry *ent, ino_t inode, size_t *size)
+{
+	struct lock_fds *lf = ent ? ent->data : NULL;
+	struct lock_fd *x;
+
+	*size = 0;
+	if (!lf || !lf->nfds)
+		return NULL;
+
+	x = bsearch(&inode, lf->fds, lf->nfds, sizeof(struct lock_fd), cmp_inode);
+	if (!x)
+		return NULL;
+
+	/* the first descriptor for the inode */
+	while (x > lf->fds && (x - 1)->inode == inode)
+		x--;
+
+	*size = x->size;
+	return xstrdup(x->path);
+}
+
+static void free_lock_fds(struct proc_snapshot *ps)
+{
+	size_t i, j, n = proc_snapshot_get_nentries(ps);
+
+	for (i = 0; i < n; i++) {
+		struct proc_entry *ent = proc_snapshot_get_entry(ps, i);
+		struct lock_fds *lf = ent->data;
+
+		if (!lf)
+			continue;
+		for (j = 0; j < lf->nfds; j++)
+			free(lf->fds[j].path);
+		free(lf->fds);
+		free(lf);
+	}
 }
 
 /*
@@ -230,15 +335,87 @@ static ino_t get_dev_inode(char *str, dev_t *dev)
 	return inum;
 }
 
+/*
+ * Read the lock owners from /proc in one pass, rather than to scan the owner's
+ * descriptors for each lock.
+ */
+static int get_lock_owners(struct list_head *locks)
+{
+	struct proc_snapshot *ps;
+	struct list_head *p, *pnext;
+	ino_t *inodes;
+	size_t n = 0;
+	int rc;
+
+	ps = proc_new_snapshot(PROC_SNAP_COMM);
+	if (!ps)
+		return -1;
+
+	/* inodes[0] is number of the sorted inodes */
+	list_for_each(p, locks)
+		n++;
+	inodes = xcalloc(n + 1, sizeof(ino_t));
+	n = 0;
+	list_for_each(p, locks) {
+		struct lock *l = list_entry(p, struct lock, locks);
+
+		inodes[++n] = l->inode;
+		if (l->pid > 0 && proc_snapshot_add_pid(ps, l->pid) != 0)
+			err(EXIT_FAILURE, _("failed to allocate memory"));
+	}
+	inodes[0] = n;
+	qsort(inodes + 1, n, sizeof(ino_t), cmp_inode);
+
+	proc_snapshot_set_reader(ps, read_lock_fds, inodes);
+	proc_snapshot_enable_threads(ps, 1);
+
+	rc = proc_snapshot_read(ps);
+	if (rc)
+		goto done;
+
+	list_for_each_safe(p, pnext, locks) {
+		struct lock *l = list_entry(p, struct lock, locks);
+		struct proc_entry *ent = NULL;
+		size_t sz;
+
+		/* OFD locks use -1 PID */
+		if (l->pid > 0) {
+			ent = proc_snapshot_find(ps, l->pid);
+			if (ent && ent->valid)
+				l->cmdname = xstrdup(ent->comm);
+			else
+				l->cmdname = xstrdup(_("(unknown)"));
+		} else
+			l->cmdname = xstrdup(_("(undefined)"));
+
+		l->path = get_filename_sz(ent, l->inode, &sz);
+
+		/* no permissions -- ignore */
+		if (!l->path && no_inaccessible) {
+			rem_lock(l);
+			continue;
+		}
+
+		if (!l->path) {
+			/* probably no permission to peek into l->pid's path */
+			l->path = get_fallback_filename(l->dev);
+			l->size = 0;
+		} else
+			l->size = sz;
+	}
+done:
+	free_lock_fds(ps);
+	proc_free_snapshot(ps);
+	free(inodes);
+	return rc;
+}
+
 static int get_local_locks(struct list_head *locks)
 {
 	int i;
-	ino_t inode = 0;
 	FILE *fp;
 	char buf[PATH_MAX], *tok = NULL;
-	size_t sz;
 	struct lock *l;
-	dev_t dev = 0;
 
 	if (!(fp = fopen(_PATH_PROC_LOCKS, "r")))
 		return -1;
@@ -281,16 +458,10 @@ static int get_local_locks(struct list_head *locks)
 				 * to the list, no need to worry now. OFD locks use -1 PID.
 				 */
 				l->pid = strtos32_or_err(tok, _("failed to parse pid"));
-				if (l->pid > 0) {
-					l->cmdname = proc_get_command_name(l->pid);
-					if (!l->cmdname)
-						l->cmdname = xstrdup(_("(unknown)"));
-				} else
-					l->cmdname = xstrdup(_("(undefined)"));
 				break;
 
 			case 5: /* device major:minor and inode number */
-				inode = get_dev_inode(tok, &dev);
+				l->inode = get_dev_inode(tok, &l->dev);
 				break;
 
 			case 6: /* start */
@@ -309,26 +480,12 @@ static int get_local_locks(struct list_head *locks)
 			}
 		}
 
-		l->path = get_filename_sz(inode, l->pid, &sz);
-
-		/* no permissions -- ignore */
-		if (!l->path && no_inaccessible) {
-			rem_lock(l);
-			continue;
-		}
-
-		if (!l->path) {
-			/* probably no permission to peek into l->pid's path */
-			l->path = get_fallback_filename(dev);
-			l->size = 0;
-		} else
-			l->size = sz;
-
 		list_add(&l->locks, locks);
 	}
 
 	fclose(fp);
-	return 0;
+
+	return list_empty(locks) ? 0 : get_lock_owners(locks);
 }
 
 static int column_name_to_id(const char *name, size_t namesz)
@@ -362,21 +519,54 @@ static inline struct colinfo *get_column_info(unsigned num)
 	return &infos[ get_column_id(num) ];
 }
 
-static pid_t get_blocker(int id, struct list_head *locks)
+static struct lock_holder *holders;
+static size_t nholders;
+
+static void index_lock_holders(struct list_head *locks)
 {
 	struct list_head *p;
+	size_t n = 0;
 
 	list_for_each(p, locks) {
 		struct lock *l = list_entry(p, struct lock, locks);
 
-		if (l->id == id && !l->blocked)
-			return l->pid;
+		if (!l->blocked)
+			n++;
 	}
+	if (!n)
+		return;
 
-	return 0;
+	holders = xcalloc(n, sizeof(struct lock_holder));
+	list_for_each(p, locks) {
+		struct lock *l = list_entry(p, struct lock, locks);
+
+		if (l->blocked)
+			continue;
+		holders[nholders].id = l->id;
+		holders[nholders].pid = l->pid;
+		holders[nholders].pos = nholders;
+		nholders++;
+	}
+	qsort(holders, nholders, sizeof(struct lock_holder), cmp_lock_holders);
 }
 
-static void add_scols_line(struct libscols_table *table, struct lock *l, struct list_head *locks)
+static pid_t get_blocker(int id)
+{
+	struct lock_holder key = { .id = id }, *x;
+
+	if (!nholders)
+		return 0;
+
+	x = bsearch(&key, holders, nholders, sizeof(struct lock_holder),
+		    cmp_lock_holder_id);
+	if (!x)
+		return 0;
+	while (x > holders && (x - 1)->id == id)
+		x--;
+	return x->pid;
+}
+
+static void add_scols_line(struct libscols_table *table, struct lock *l)
 {
 	size_t i;
 	struct libscols_line *line;
@@ -433,7 +623,7 @@ static void add_scols_line(struct libscols_table *table, struct lock *l, struct
 		case COL_BLOCKER:
 		{
 			pid_t bl = l->blocked && l->id ?
-						get_blocker(l->id, locks) : 0;
+						get_blocker(l->id) : 0;
 			if (bl)
 				xasprintf(&str, "%d", (int) bl);
 		}
@@ -497,6 +687,8 @@ static int show_locks(struct list_head *locks)
 
 	}
 
+	index_lock_holders(locks);
+
 	/* prepare data for output */
 	list_for_each(p, locks) {
 		struct lock *l = list_entry(p, struct lock, locks);
@@ -504,7 +696,7 @@ static int show_locks(struct list_head *locks)
 		if (pid && pid != l->pid)
 			continue;
 
-		add_scols_line(table, l, locks);
+		add_scols_line(table, l);
 	}
 
 	/* destroy the list */
@@ -512,6 +704,7 @@ static int show_locks(struct list_head *locks)
 		struct lock *l = list_entry(p, struct lock, locks);
 		rem_lock(l);
 	}
+	free(holders);
 
 	scols_print_table(table);
 	scols_unref_table(table);
@@ -0,0 +1,424 @@
+/*
+ * mntcached.c - maintain libmount cache snapshot
+ *
+ * Copyright (C) 2026 util-linux contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The daemon listens to the kernel block device uevents (libblkid cache
+ * monitor) and to the mount table changes (libmount monitor). After a change
+ * it writes the libblkid cache file and rebuilds the libmount cache snapshot
+ * with the tags of all block devices and the canonicalized sources of the
+ * mounted and fstab filesystems.
+ *
+ * The snapshot is preloaded by mnt_new_cache(). It is not necessary to care
+ * about the daemon state in libmount: a snapshot from a dead daemon is
+ * outdated (uevent sequence number, stat(2) of the paths) and libmount
+ * evaluates everything as usual.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#include <blkid.h>
+#include <libmount.h>
+
+#include "c.h"
+#include "nls.h"
+#include "all-io.h"
+#include "closestream.h"
+#include "strutils.h"
+#include "pathnames.h"
+#include "monotonic.h"
+
+/* libmount default, see mnt_new_cache() */
+#define MNTCACHED_RUNDIR	"/run/mount"
+#define MNTCACHED_SNAPSHOT	MNTCACHED_RUNDIR "/cache"
+#define MNTCACHED_PIDFILE	_PATH_RUNSTATEDIR "/mntcached.pid"
+
+/* wait for more events before the snapshot is rebuilt */
+#define MNTCACHED_SETTLE	100	/* msec */
+
+struct mntcached_cxt {
+	const char		*snapshot;	/* libmount snapshot path */
+	const char		*cleanup_pidfile;
+
+	blkid_cache		bcache;
+	struct libmnt_monitor	*mn;
+
+	unsigned int		settle;		/* msec */
+	struct timeval		deadline;	/* pending rebuild */
+
+	unsigned int	debug : 1,
+			quiet : 1,
+			no_fork : 1,
+			pending : 1;
+};
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fputs(USAGE_HEADER, out);
+	fprintf(out, _(" %s [options]\n"), program_invocation_short_name);
+	fputs(USAGE_SEPARATOR, out);
+	fputs(_("A daemon for maintaining block devices and mount cache snapshot.\n"), out);
+	fputs(USAGE_OPTIONS, out);
+	fputs(_(" -c, --cache-file <path> libblkid cache file\n"), out);
+	fputs(_(" -s, --snapshot <path>   libmount cache snapshot file\n"), out);
+	fputs(_(" -t, --settle <msec>     wait for more events before update\n"), out);
+	fputs(_(" -o, --oneshot           write the snapshot and exit\n"), out);
+	fputs(_(" -p, --pid <path>        path to pid file\n"), out);
+	fputs(_(" -P, --no-pid            do not create pid file\n"), out);
+	fputs(_(" -F, --no-fork           do not daemonize using double-fork\n"), out);
+	fputs(_(" -d, --debug             run in debugging mode\n"), out);
+	fputs(_(" -q, --quiet             turn on quiet mode\n"), out);
+	fputs(USAGE_SEPARATOR, out);
+	printf(USAGE_HELP_OPTIONS(25));
+	printf(USAGE_MAN_TAIL("mntcached(8)"));
+	exit(EXIT_SUCCESS);
+}
+
+static void __attribute__((__noreturn__)) all_done(const struct mntcached_cxt *cxt, int ret)
+{
+	if (cxt->cleanup_pidfile)
+		unlink(cxt->cleanup_pidfile);
+	exit(ret);
+}
+
+/* flock() is used, the lock is inherited by daemon() child */
+static int create_pidfile(struct mntcached_cxt *cxt, const char *pidfile_path)
+{
+	int fd;
+
+	fd = open(pidfile_path, O_CREAT | O_RDWR | O_CLOEXEC, 0664);
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot open %s"), pidfile_path);
+
+	while (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+		if (errno == EINTR)
+			continue;
+		if (errno == EWOULDBLOCK)
+			errx(EXIT_FAILURE, _("mntcached daemon is already running"));
+		err(EXIT_FAILURE, _("cannot lock %s"), pidfile_path);
+	}
+	cxt->cleanup_pidfile = pidfile_path;
+	return fd;
+}
+
+static void add_fs_source(struct libmnt_cache *cache, struct libmnt_fs *fs)
+{
+	const char *src, *tag, *val;
+
+	if (mnt_fs_is_pseudofs(fs) || mnt_fs_is_netfs(fs))
+		return;
+	if (mnt_fs_get_tag(fs, &tag, &val) == 0) {
+		ignore_result( mnt_resolve_tag(tag, val, cache) );
+		return;
+	}
+	src = mnt_fs_get_srcpath(fs);
+	if (src && *src == '/')
+		ignore_result( mnt_resolve_path(src, cache) );
+}
+
+/*
+ * The targets are not resolved; the mountinfo targets are canonical already
+ * and stat(2) on fstab targets may trigger automounts.
+ */
+static void add_table_sources(struct libmnt_cache *cache, int mounted)
+{
+	struct libmnt_table *tb = mnt_new_table();
+	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+	struct libmnt_fs *fs;
+	int rc;
+
+	if (!tb || !itr)
+		goto done;
+
+	rc = mounted ? mnt_table_parse_mtab(tb, NULL) :
+		       mnt_table_parse_fstab(tb, NULL);
+	if (rc)
+		goto done;
+
+	while (mnt_table_next_fs(tb, itr, &fs) == 0)
+		add_fs_source(cache, fs);
+done:
+	mnt_free_iter(itr);
+	mnt_unref_table(tb);
+}
+
+static int update_snapshot(struct mntcached_cxt *cxt)
+{
+	struct libmnt_cache *cache;
+	blkid_dev_iterate iter;
+	blkid_dev dev;
+	size_t ndevs = 0;
+	int rc;
+
+	/* the devices have been re-probed by the events */
+	blkid_flush_cache(cxt->bcache);
+
+	cache = mnt_new_cache();
+	if (!cache)
+		return -ENOMEM;
+
+	iter = blkid_dev_iterate_begin(cxt->bcache);
+	while (iter && blkid_dev_next(iter, &dev) == 0) {
+		const char *devname = blkid_dev_devname(dev);
+
+		ignore_result( mnt_resolve_path(devname, cache) );
+		mnt_cache_read_tags(cache, devname);
+		ndevs++;
+	}
+	blkid_dev_iterate_end(iter);
+
+	add_table_sources(cache, 1);
+	add_table_sources(cache, 0);
+
+	rc = mnt_cache_write_snapshot(cache, cxt->snapshot);
+	mnt_unref_cache(cache);
+
+	if (rc && !cxt->quiet)
+		warnx(_("cannot write %s: %s"), cxt->snapshot, strerror(-rc));
+	else if (!rc && cxt->debug)
+		fprintf(stderr, _("%s updated [%zu devices]\n"), cxt->snapshot, ndevs);
+	return rc;
+}
+
+/* rebuild the snapshot after the settle time, the deadline is not extended */
+static void schedule_update(struct mntcached_cxt *cxt)
+{
+	struct timeval now, settle = {
+		.tv_sec = cxt->settle / 1000,
+		.tv_usec = (cxt->settle % 1000) * 1000
+	};
+
+	if (cxt->pending)
+		return;
+	gettime_monotonic(&now);
+	timeradd(&now, &settle, &cxt->deadline);
+	cxt->pending = 1;
+}
+
+static int get_timeout(struct mntcached_cxt *cxt)
+{
+	struct timeval now, diff;
+
+	if (!cxt->pending)
+		return -1;
+
+	gettime_monotonic(&now);
+	if (!timercmp(&now, &cxt->deadline, <))
+		return 0;
+	timersub(&cxt->deadline, &now, &diff);
+	return diff.tv_sec * 1000 + (diff.tv_usec + 999) / 1000;
+}
+
+static void add_epoll_fd(int efd, int fd)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		err(EXIT_FAILURE, _("failed to add file descriptor to epoll"));
+}
+
+static void __attribute__((__noreturn__)) server_loop(struct mntcached_cxt *cxt)
+{
+	int efd, sigfd, bfd, mfd;
+	sigset_t sigmask;
+
+	sigemptyset(&sigmask);
+	sigaddset(&sigmask, SIGHUP);
+	sigaddset(&sigmask, SIGINT);
+	sigaddset(&sigmask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &sigmask, NULL);
+	if ((sigfd = signalfd(-1, &sigmask, SFD_CLOEXEC)) < 0)
+		err(EXIT_FAILURE, _("cannot set signal handler"));
+
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	if (efd < 0)
+		err(EXIT_FAILURE, _("cannot create epoll"));
+
+	bfd = blkid_cache_get_monitor_fd(cxt->bcache);
+	if (bfd < 0)
+		errx(EXIT_FAILURE, _("cannot monitor block devices"));
+
+	cxt->mn = mnt_new_monitor();
+	if (!cxt->mn || mnt_monitor_enable_kernel(cxt->mn, 1) != 0)
+		errx(EXIT_FAILURE, _("cannot monitor mount table"));
+	mfd = mnt_monitor_get_fd(cxt->mn);
+	if (mfd < 0)
+		errx(EXIT_FAILURE, _("cannot monitor mount table"));
+
+	add_epoll_fd(efd, sigfd);
+	add_epoll_fd(efd, bfd);
+	add_epoll_fd(efd, mfd);
+
+	/* the monitors are ready, nothing is missed since the initial scan */
+	blkid_probe_all(cxt->bcache);
+	update_snapshot(cxt);
+
+	while (1) {
+		struct epoll_event events[3];
+		int i, n;
+
+		n = epoll_wait(efd, events, ARRAY_SIZE(events), get_timeout(cxt));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, _("epoll_wait failed"));
+		}
+		if (n == 0 && cxt->pending) {
+			cxt->pending = 0;
+			update_snapshot(cxt);
+			continue;
+		}
+
+		for (i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == sigfd) {
+				struct signalfd_siginfo info;
+
+				if (read_all(sigfd, (char *) &info, sizeof(info))
+				    != (ssize_t) sizeof(info))
+					continue;
+				if (info.ssi_signo != SIGHUP)
+					all_done(cxt, EXIT_SUCCESS);
+				if (cxt->debug)
+					fprintf(stderr, _("rescan requested\n"));
+				blkid_probe_all(cxt->bcache);
+				schedule_update(cxt);
+
+			} else if (fd == bfd) {
+				if (blkid_cache_process_events(cxt->bcache) > 0)
+					schedule_update(cxt);
+
+			} else if (fd == mfd) {
+				mnt_monitor_event_cleanup(cxt->mn);
+				schedule_update(cxt);
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct mntcached_cxt cxt = {
+		.snapshot = MNTCACHED_SNAPSHOT,
+		.settle = MNTCACHED_SETTLE
+	};
+	const char *pidfile_path = MNTCACHED_PIDFILE;
+	const char *cachefile = NULL;
+	int c, fd_pidfile = -1, oneshot = 0, no_pid = 0;
+
+	static const struct option longopts[] = {
+		{"cache-file", required_argument, NULL, 'c'},
+		{"snapshot",   required_argument, NULL, 's'},
+		{"settle",     required_argument, NULL, 't'},
+		{"oneshot",    no_argument,       NULL, 'o'},
+		{"pid",        required_argument, NULL, 'p'},
+		{"no-pid",     no_argument,       NULL, 'P'},
+		{"no-fork",    no_argument,       NULL, 'F'},
+		{"debug",      no_argument,       NULL, 'd'},
+		{"quiet",      no_argument,       NULL, 'q'},
+		{"version",    no_argument,       NULL, 'V'},
+		{"help",       no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+
+	setlocale(LC_ALL, "");
+	bindtextdomain(PACKAGE, LOCALEDIR);
+	textdomain(PACKAGE);
+	close_stdout_atexit();
+
+	while ((c = getopt_long(argc, argv, "c:dFhoPp:qs:t:V", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'c':
+			cachefile = optarg;
+			break;
+		case 's':
+			cxt.snapshot = optarg;
+			break;
+		case 't':
+			cxt.settle = strtou32_or_err(optarg, _("failed to parse settle time"));
+			break;
+		case 'o':
+			oneshot = 1;
+			break;
+		case 'p':
+			pidfile_path = optarg;
+			break;
+		case 'P':
+			no_pid = 1;
+			break;
+		case 'F':
+			cxt.no_fork = 1;
+			break;
+		case 'd':
+			cxt.debug = 1;
+			break;
+		case 'q':
+			cxt.quiet = 1;
+			break;
+
+		case 'h':
+			usage();
+		case 'V':
+			print_version(EXIT_SUCCESS);
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (optind < argc) {
+		warnx(_("unexpected argument: %s"), argv[optind]);
+		errtryhelp(EXIT_FAILURE);
+	}
+
+	/* don't preload the previous (maybe outdated) snapshot */
+	if (setenv("LIBMOUNT_CACHE_SNAPSHOT", "", 1) != 0)
+		err(EXIT_FAILURE, _("failed to set the LIBMOUNT_CACHE_SNAPSHOT environment variable"));
+
+	if (strcmp(cxt.snapshot, MNTCACHED_SNAPSHOT) == 0)
+		mkdir(MNTCACHED_RUNDIR, S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH);
+
+	if (blkid_get_cache(&cxt.bcache, cachefile) != 0)
+		errx(EXIT_FAILURE, _("failed to read libblkid cache"));
+
+	if (oneshot) {
+		blkid_probe_all(cxt.bcache);
+		c = update_snapshot(&cxt);
+		blkid_put_cache(cxt.bcache);
+		return c ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (!no_pid && !cxt.debug)
+		fd_pidfile = create_pidfile(&cxt, pidfile_path);
+
+	if (!cxt.debug && !cxt.no_fork && daemon(0, 0))
+		err(EXIT_FAILURE, "daemon");
+
+	if (fd_pidfile >= 0) {
+		char buf[32];
+
+		snprintf(buf, sizeof(buf), "%8d\n", getpid());
+		if (ftruncate(fd_pidfile, 0))
+			err(EXIT_FAILURE, _("could not truncate file: %s"), pidfile_path);
+		write_all(fd_pidfile, buf, strlen(buf));
+		/* the lock is held while the file descriptor is open */
+	}
+
+	server_loop(&cxt);
+}
@@ -26,6 +26,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <search.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/param.h>
@@ -62,10 +64,160 @@ struct namei {
 	int		noent;		/* this item not existing (stores errno from stat()) */
 };
 
+/*
+ * The already resolved paths. The arguments usually share the prefixes
+ * (e.g. "namei -l /usr/lib/foo /usr/lib/bar"), so every path is lstat()-ed
+ * only once. The last element of the path is looked up by fstatat()
+ * relative to the cached O_PATH fd of the parent directory, so the kernel
+ * does not walk the whole path again for every element.
+ */
+struct namei_cache {
+	char		*path;		/* the key, as used for lstat() */
+	const char	*name;		/* the last element in 'path' */
+	struct namei_cache *parent;	/* the parent directory or NULL */
+
+	struct stat	st;
+	int		noent;		/* errno from fstatat() */
+	char		*sym;		/* symlink content */
+	ssize_t		symsz;		/* readlink() result */
+
+	int		dirfd;		/* directory fd or -1 */
+};
+
+/* maximal number of the directory fds kept open */
+#define NAMEI_CACHE_MAXFDS	256
+
+#ifndef O_PATH
+# define O_PATH		O_RDONLY
+#endif
+
 static int flags;
 static struct idcache *gcache;	/* groupnames */
 static struct idcache *ucache;	/* usernames */
 
+static void *cache_tree;
+static struct namei_cache *cache_fds[NAMEI_CACHE_MAXFDS];
+static size_t cache_nfds;
+
+static int cmp_cache(const void *a, const void *b)
+{
+	return strcmp(((const struct namei_cache *) a)->path,
+		      ((const struct namei_cache *) b)->path);
+}
+
+static struct namei_cache *cache_find(const char *path)
+{
+	struct namei_cache key = { .path = (char *) path }, **x;
+
+	x = tfind(&key, &cache_tree, cmp_cache);
+	return x ? *x : NULL;
+}
+
+static void cache_close_fds(void)
+{
+	size_t i;
+
+	for (i = 0; i < cache_nfds; i++) {
+		close(cache_fds[i]->dirfd);
+		cache_fds[i]->dirfd = -1;
+	}
+	cache_nfds = 0;
+}
+
+/* Returns the fd of the directory, or -1 if not available */
+static int cache_dirfd(struct namei_cache *dc)
+{
+	int pfd;
+
+	if (dc->dirfd >= 0)
+		return dc->dirfd;
+	if (dc->noent || !(S_ISDIR(dc->st.st_mode) || S_ISLNK(dc->st.st_mode)))
+		return -1;
+
+	/* all fds are in use; let's start again, the parents are re-opened */
+	if (cache_nfds == NAMEI_CACHE_MAXFDS)
+		cache_close_fds();
+
+	pfd = dc->parent ? cache_dirfd(dc->parent) : -1;
+	if (pfd >= 0)
+		dc->dirfd = openat(pfd, dc->name, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	else
+		dc->dirfd = open(dc->path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+
+	if (dc->dirfd >= 0)
+		cache_fds[cache_nfds++] = dc;
+	return dc->dirfd;
+}
+
+/* Returns the cached lstat() of @path */
+static struct namei_cache *cache_lookup(const char *path)
+{
+	struct namei_cache *nc = cache_find(path);
+	const char *p;
+	int dfd = -1;
+
+	if (nc)
+		return nc;
+
+	nc = xcalloc(1, sizeof(*nc));
+	nc->path = xstrdup(path);
+	nc->name = nc->path;
+	nc->dirfd = -1;
+
+	/* split to the parent directory and the last element */
+	p = strrchr(nc->path, '/');
+	if (p && p[1]) {
+		const char *end = p;
+		char *dir;
+
+		while (end > nc->path && *(end - 1) == '/')
+			end--;
+		dir = end == nc->path ? xstrdup("/") :
+				xstrndup(nc->path, end - nc->path);
+
+		nc->parent = cache_find(dir);
+		free(dir);
+		if (nc->parent)
+			dfd = cache_dirfd(nc->parent);
+		if (dfd >= 0)
+			nc->name = p + 1;
+	}
+
+	if (fstatat(dfd >= 0 ? dfd : AT_FDCWD, nc->name, &nc->st,
+		    AT_SYMLINK_NOFOLLOW) != 0)
+		nc->noent = errno;
+
+	else if (S_ISLNK(nc->st.st_mode)) {
+		char sym[PATH_MAX];
+
+		nc->symsz = readlinkat(dfd >= 0 ? dfd : AT_FDCWD, nc->name,
+					sym, sizeof(sym));
+		if (nc->symsz > 0) {
+			nc->sym = xmalloc(nc->symsz);
+			memcpy(nc->sym, sym, nc->symsz);
+		}
+	}
+
+	tsearch(nc, &cache_tree, cmp_cache);
+	return nc;
+}
+
+static void free_cache_entry(void *data)
+{
+	struct namei_cache *nc = data;
+
+	free(nc->path);
+	free(nc->sym);
+	free(nc);
+}
+
+static void free_cache(void)
+{
+	cache_close_fds();
+	tdestroy(cache_tree, free_cache_entry);
+	cache_tree = NULL;
+}
+
 static void
 free_namei(struct namei *nm)
 {
@@ -79,13 +231,12 @@ free_namei(struct namei *nm)
 }
 
 static void
-readlink_to_namei(struct namei *nm, const char *path)
+readlink_to_namei(struct namei *nm, const char *path, const struct namei_cache *nc)
 {
-	char sym[PATH_MAX];
-	ssize_t sz;
+	const char *sym = nc->sym;
+	ssize_t sz = nc->symsz;
 	int isrel = 0;
 
-	sz = readlink(path, sym, sizeof(sym));
 	if (sz < 1)
 		err(EXIT_FAILURE, _("failed to read symlink: %s"), path);
 	if (*sym != '/') {
@@ -141,6 +292,7 @@ static struct namei *
 new_namei(struct namei *parent, const char *path, const char *fname, int lev)
 {
 	struct namei *nm;
+	struct namei_cache *nc;
 
 	if (!fname)
 		return NULL;
@@ -151,13 +303,15 @@ new_namei(struct namei *parent, const char *path, const char *fname, int lev)
 	nm->level = lev;
 	nm->name = xstrdup(fname);
 
-	if (lstat(path, &nm->st) != 0) {
-		nm->noent = errno;
+	nc = cache_lookup(path);
+	if (nc->noent) {
+		nm->noent = nc->noent;
 		return nm;
 	}
+	nm->st = nc->st;
 
 	if (S_ISLNK(nm->st.st_mode))
-		readlink_to_namei(nm, path);
+		readlink_to_namei(nm, path, nc);
 	if (flags & NAMEI_OWNERS) {
 		add_uid(ucache, nm->st.st_uid);
 		add_gid(gcache, nm->st.st_gid);
@@ -444,6 +598,7 @@ main(int argc, char **argv)
 
 	free_idcache(ucache);
 	free_idcache(gcache);
+	free_cache();
 
 	return rc;
 }
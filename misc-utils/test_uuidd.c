@@ -22,17 +22,28 @@
  * to overwrite the built-in default then use:
  *
  *	make uuidd uuidgen runstatedir=/var/run
+ *
+ * The -m option selects the generator, the -b option reports the throughput
+ * and the latency of the generator calls, for example:
+ *
+ *	for t in 1 2 4 8; do test_uuidd -b -m time -p 1 -t $t -o 100000; done
+ *
+ * The "time" mode uses uuidd if it's running; the "time-local" and
+ * "time-cont" modes always use the local clock (the same code as uuidd). The
+ * continuous clock is not shared between processes, use "-p 1" for time-cont.
  */
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/shm.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include "uuid.h"
+#include "uuidd.h"
 #include "c.h"
 #include "xalloc.h"
 #include "strutils.h"
@@ -44,6 +55,36 @@ static size_t nprocesses = 4;
 static size_t nthreads = 4;
 static size_t nobjects = 4096;
 static size_t loglev = 1;
+static int bench;
+
+/* generators */
+enum {
+	MODE_TIME = 0,
+	MODE_TIME_V6,
+	MODE_TIME_V7,
+	MODE_TIME_LOCAL,
+	MODE_TIME_CONT,
+	MODE_RANDOM,
+	MODE_RANDOM_BULK
+};
+
+static const char *const modenames[] = {
+	[MODE_TIME]        = "time",
+	[MODE_TIME_V6]     = "time-v6",
+	[MODE_TIME_V7]     = "time-v7",
+	[MODE_TIME_LOCAL]  = "time-local",
+	[MODE_TIME_CONT]   = "time-cont",
+	[MODE_RANDOM]      = "random",
+	[MODE_RANDOM_BULK] = "random-bulk"
+};
+
+static int mode = MODE_TIME;
+
+#define BULK_SIZE	64		/* UUIDs per random-bulk call */
+#define CONT_OFFSET	7200		/* time-cont max_clock_offset */
+
+/* the continuous clock state is per-process, uuidd serializes the calls */
+static pthread_mutex_t cont_lock = PTHREAD_MUTEX_INITIALIZER;
 
 struct processentry {
 	pid_t		pid;
@@ -65,6 +106,7 @@ struct objectentry {
 	uuid_t		uuid;
 	pthread_t	tid;
 	pid_t		pid;
+	uint32_t	nsec;		/* latency of the generator call */
 	size_t		idx;
 };
 typedef struct objectentry object_t;
@@ -81,6 +123,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	printf("  -t <num>     number of nthreads (default:%zu)\n", nthreads);
 	printf("  -o <num>     number of nobjects (default:%zu)\n", nobjects);
 	printf("  -l <level>   log level (default:%zu)\n", loglev);
+	printf("  -m <mode>    generator: time, time-v6, time-v7, time-local, time-cont,\n"
+	       "               random or random-bulk (default:%s)\n", modenames[mode]);
+	printf("  -b           report throughput and latency\n");
 	printf("  -h           display help\n");
 
 	exit(EXIT_SUCCESS);
@@ -115,9 +160,40 @@ static void remove_segment(int id, void *address)
 	     id, address));
 }
 
+static uint64_t nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 static void object_uuid_create(object_t * object)
 {
-	uuid_generate_time(object->uuid);
+	int num = 1;
+
+	switch (mode) {
+	case MODE_TIME:
+		uuid_generate_time(object->uuid);
+		break;
+	case MODE_TIME_V6:
+		uuid_generate_time_v6(object->uuid);
+		break;
+	case MODE_TIME_V7:
+		uuid_generate_time_v7(object->uuid);
+		break;
+	case MODE_TIME_LOCAL:
+		__uuid_generate_time(object->uuid, &num);
+		break;
+	case MODE_TIME_CONT:
+		pthread_mutex_lock(&cont_lock);
+		__uuid_generate_time_cont(object->uuid, &num, CONT_OFFSET);
+		pthread_mutex_unlock(&cont_lock);
+		break;
+	case MODE_RANDOM:
+		uuid_generate_random(object->uuid);
+		break;
+	}
 }
 
 static void object_uuid_to_string(object_t * object, char **string_uuid)
@@ -133,14 +209,51 @@ static int object_uuid_compare(const void *object1, const void *object2)
 	return uuid_compare(*uuid1, *uuid2);
 }
 
+/* random-bulk, the latency of the UUID is the call latency / BULK_SIZE */
+static void create_uuids_bulk(thread_t *th)
+{
+	uuid_t uus[BULK_SIZE];
+	size_t i, j;
+
+	for (i = th->index; i < th->index + nobjects; i += BULK_SIZE) {
+		size_t n = min((size_t) BULK_SIZE, th->index + nobjects - i);
+		uint64_t begin = bench ? nsec_now() : 0;
+		uint32_t nsec;
+
+		uuid_generate_random_bulk(uus, n);
+		nsec = bench ? (nsec_now() - begin) / n : 0;
+
+		for (j = 0; j < n; j++) {
+			object_t *obj = &objects[i + j];
+
+			uuid_copy(obj->uuid, uus[j]);
+			obj->nsec = nsec;
+			obj->tid = th->tid;
+			obj->pid = th->proc->pid;
+			obj->idx = th->index + i + j;
+		}
+	}
+}
+
 static void *create_uuids(thread_t *th)
 {
 	size_t i;
 
+	if (mode == MODE_RANDOM_BULK) {
+		create_uuids_bulk(th);
+		return NULL;
+	}
+
 	for (i = th->index; i < th->index + nobjects; i++) {
 		object_t *obj = &objects[i];
 
-		object_uuid_create(obj);
+		if (bench) {
+			uint64_t begin = nsec_now();
+
+			object_uuid_create(obj);
+			obj->nsec = nsec_now() - begin;
+		} else
+			object_uuid_create(obj);
 		obj->tid = th->tid;
 		obj->pid = th->proc->pid;
 		obj->idx = th->index + i;
@@ -264,14 +377,57 @@ static void object_dump(size_t idx, object_t *obj)
 	fprintf(stderr, "}\n");
 }
 
+static int parse_mode(const char *str)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(modenames); i++) {
+		if (strcmp(str, modenames[i]) == 0)
+			return i;
+	}
+	errx(EXIT_FAILURE, "unsupported mode: %s", str);
+}
+
+static int cmp_nsec(const void *a, const void *b)
+{
+	uint32_t x = *((const uint32_t *) a), y = *((const uint32_t *) b);
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void report(uint64_t nsec)
+{
+	size_t i, n = 0, total = nprocesses * nthreads * nobjects;
+	uint32_t *lat = xcalloc(total, sizeof(uint32_t));
+
+	/* the objects of the not created threads are ignored */
+	for (i = 0; i < total; i++) {
+		if (objects[i].tid)
+			lat[n++] = objects[i].nsec;
+	}
+	if (!n) {
+		free(lat);
+		return;
+	}
+	qsort(lat, n, sizeof(uint32_t), cmp_nsec);
+
+	printf("%s: %zu processes, %zu threads, %zu UUIDs in %.3f s\n",
+	       modenames[mode], nprocesses, nthreads, n, nsec / 1e9);
+	printf("throughput: %.0f UUIDs/s\n", n / (nsec / 1e9));
+	printf("latency [ns]: p50 %u, p99 %u, p99.9 %u, max %u\n",
+	       lat[n / 2], lat[n * 99 / 100], lat[n * 999 / 1000], lat[n - 1]);
+	free(lat);
+}
+
 #define MSG_TRY_HELP "Try '-h' for help."
 
 int main(int argc, char *argv[])
 {
 	size_t i, nfailed = 0, nignored = 0;
+	uint64_t begin;
 	int c;
 
-	while (((c = getopt(argc, argv, "p:t:o:l:h")) != -1)) {
+	while (((c = getopt(argc, argv, "p:t:o:l:m:bh")) != -1)) {
 		switch (c) {
 		case 'p':
 			nprocesses = strtou32_or_err(optarg, "invalid nprocesses number argument");
@@ -285,6 +441,12 @@ int main(int argc, char *argv[])
 		case 'l':
 			loglev = strtou32_or_err(optarg, "invalid log level argument");
 			break;
+		case 'm':
+			mode = parse_mode(optarg);
+			break;
+		case 'b':
+			bench = 1;
+			break;
 		case 'h':
 			usage();
 			break;
@@ -296,6 +458,8 @@ int main(int argc, char *argv[])
 
 	if (optind != argc)
 		errx(EXIT_FAILURE, "bad usage\n" MSG_TRY_HELP);
+	if (mode == MODE_TIME_CONT && nprocesses > 1)
+		errx(EXIT_FAILURE, "time-cont mode requires one process (-p 1)");
 
 	if (loglev == 1)
 		fprintf(stderr, "requested: %zu processes, %zu threads, %zu objects per thread (%zu objects = %zu bytes)\n",
@@ -306,7 +470,10 @@ int main(int argc, char *argv[])
 	allocate_segment(&shmem_id, (void **)&objects,
 			 nprocesses * nthreads * nobjects, sizeof(object_t));
 
+	begin = nsec_now();
 	create_nprocesses();
+	if (bench)
+		report(nsec_now() - begin);
 
 	if (loglev >= 3) {
 		for (i = 0; i < nprocesses * nthreads * nobjects; i++)
@@ -23,6 +23,18 @@
  * | reply length (4 bytes) | uuid reply (16 bytes) | number (4 bytes) time bulk |
  *   or
  * | reply length (4 bytes) | pid or maxop number string length in ascii (up to 7 bytes) |
+ *   or
+ * | reply length (4 bytes) | 1 (4 bytes) persistent connection |
+ *   or
+ * | reply length (4 bytes) | 1 or 0 (4 bytes) shared ring (see uuidd.h) |
+ *
+ * The file descriptor of the shared ring is attached (SCM_RIGHTS) to the
+ * reply if the reply is 1.
+ *
+ * The server does not close the connection after the reply, the client may
+ * send more requests on the same connection. The UUIDD_OP_PERSISTENT request
+ * is used by the client to check that the server supports it; old servers
+ * close the connection on unknown request.
  */
 
 #include <stdio.h>
@@ -35,22 +47,28 @@
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <string.h>
 #include <getopt.h>
 #include <sys/signalfd.h>
+#include <sys/epoll.h>
 #include <poll.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "uuid.h"
 #include "uuidd.h"
 #include "all-io.h"
 #include "c.h"
 #include "closestream.h"
+#include "list.h"
 #include "strutils.h"
 #include "optutils.h"
 #include "monotonic.h"
 #include "timer.h"
+#include "xalloc.h"
 
 #ifdef HAVE_LIBSYSTEMD
 # include <systemd/sd-daemon.h>
@@ -67,6 +85,8 @@ enum {
 	UUIDD_PROT_BUFSZ = ((sizeof(uuidd_prot_num_t)) + (sizeof(uuid_t) * 63))
 };
 
+struct uuidd_worker;
+
 /* server loop control structure */
 struct uuidd_cxt_t {
 	const char	*cleanup_pidfile;
@@ -74,10 +94,54 @@ struct uuidd_cxt_t {
 	uint32_t	timeout;
 	uint32_t	cont_clock_offset;
 
+	int		listen_fd;
+	time_t		last_activity;	/* the last request, for --timeout */
+	size_t		nconns;		/* all open connections */
+	size_t		nworkers;
+	struct uuidd_worker *workers;
+
+	pthread_mutex_t	rings_lock;
+	struct list_head rings;		/* connections with a ring, --shared-ring */
+	size_t		nrings;
+
 	unsigned int	debug: 1,
 			quiet: 1,
 			no_fork: 1,
-			no_sock: 1;
+			no_sock: 1,
+			shared_ring: 1;
+};
+
+/* server worker thread */
+struct uuidd_worker {
+	struct uuidd_cxt_t *cxt;
+	pthread_t	thread;
+	int		epoll_fd;
+	struct list_head conns;		/* connections of the worker */
+	time_t		accept_paused;	/* don't accept() until, or 0 */
+
+	uuid_t		range;		/* the next reserved time-based UUID */
+	uuidd_prot_num_t range_num;	/* number of the reserved UUIDs */
+	time_t		range_expire;
+	int		range_ret;	/* return code of the reservation */
+};
+
+/* client connection */
+struct uuidd_conn {
+	int		fd;
+	uint32_t	events;		/* EPOLLIN or EPOLLOUT */
+	time_t		last;		/* the last activity */
+	struct list_head conns;		/* uuidd_worker->conns */
+
+	size_t		len;		/* used buf[] */
+	char		buf[64];	/* incoming requests */
+
+	char		*out;		/* replies not written yet */
+	size_t		outlen;
+	size_t		outsz;
+
+	struct uuidd_ring *ring;	/* UUIDD_OP_RING */
+	struct list_head rings;		/* uuidd_cxt_t->rings */
+	int		ring_wanted;	/* time-based UUID requested by socket */
 };
 
 struct uuidd_options_t {
@@ -108,6 +172,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -P, --no-pid            do not create pid file\n"), out);
 	fputs(_(" -F, --no-fork           do not daemonize using double-fork\n"), out);
 	fputs(_(" -S, --socket-activation do not create listening socket\n"), out);
+	fputs(_(" -W, --workers <num>     number of worker threads\n"), out);
+	fputs(_(" -R, --shared-ring       publish time-based UUIDs in shared memory\n"), out);
 	fputs(_(" -C, --cont-clock[=<NUM>[hd]]\n"), out);
 	fputs(_("                         activate continuous clock handling\n"), out);
 	fputs(_(" -d, --debug             run in debugging mode\n"), out);
@@ -341,28 +407,738 @@ static void timeout_handler(int sig __attribute__((__unused__)),
 		errx(EXIT_FAILURE, _("timed out"));
 }
 
+/*
+ * Time-based UUIDs are generated by bulk requests for the reserved range of
+ * UUIDD_RANGE_SIZE UUIDs per worker, so the workers don't have to serialize
+ * every request on the clock file lock. The range is dropped after
+ * UUIDD_RANGE_EXPIRE seconds to not return too old timestamps.
+ */
+#define UUIDD_RANGE_SIZE	256
+#define UUIDD_RANGE_EXPIRE	1
+
+static pthread_mutex_t uuidd_clock_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* add @n to the timestamp of the time-based UUID */
+static void uuid_time_add(uuid_t uu, uint32_t n)
+{
+	uint64_t clock_reg;
+
+	clock_reg = ((uint64_t) (((uu[6] & 0x0F) << 8) | uu[7]) << 48)
+		    | ((uint64_t) ((uu[4] << 8) | uu[5]) << 32)
+		    | ((uint32_t) uu[0] << 24) | (uu[1] << 16) | (uu[2] << 8) | uu[3];
+	clock_reg += n;
+
+	uu[0] = clock_reg >> 24;
+	uu[1] = clock_reg >> 16;
+	uu[2] = clock_reg >> 8;
+	uu[3] = clock_reg;
+	uu[4] = clock_reg >> 40;
+	uu[5] = clock_reg >> 32;
+	uu[6] = (uu[6] & 0xF0) | ((clock_reg >> 56) & 0x0F);
+	uu[7] = clock_reg >> 48;
+}
+
+static int generate_time(struct uuidd_worker *wrk, uuid_t uu, uuidd_prot_num_t *num)
+{
+	struct uuidd_cxt_t *cxt = wrk->cxt;
+	time_t now = time(NULL);
+	int ret = 0;
+
+	if (*num < 1 || *num > UUIDD_RANGE_SIZE / 2) {
+		/* large (or strange) request, don't use the range */
+		pthread_mutex_lock(&uuidd_clock_lock);
+		ret = __uuid_generate_time_cont(uu, num, cxt->cont_clock_offset);
+		pthread_mutex_unlock(&uuidd_clock_lock);
+		return ret;
+	}
+
+	if (*num > wrk->range_num || now > wrk->range_expire) {
+		uuidd_prot_num_t n = UUIDD_RANGE_SIZE;
+
+		pthread_mutex_lock(&uuidd_clock_lock);
+		wrk->range_ret = __uuid_generate_time_cont(wrk->range, &n,
+						cxt->cont_clock_offset);
+		pthread_mutex_unlock(&uuidd_clock_lock);
+		wrk->range_num = n;
+		wrk->range_expire = now + UUIDD_RANGE_EXPIRE;
+	}
+
+	memcpy(uu, wrk->range, sizeof(uuid_t));
+	uuid_time_add(wrk->range, *num);
+	wrk->range_num -= *num;
+
+	return wrk->range_ret;
+}
+
+/*
+ * Returns the reply for the request, or -1 for invalid request.
+ */
+static int handle_request(struct uuidd_worker *wrk, uuidd_prot_op_t op,
+			  uuidd_prot_num_t num, char *reply_buf, int32_t *reply_len)
+{
+	struct uuidd_cxt_t *uuidd_cxt = wrk->cxt;
+	char str[UUID_STR_LEN], *cp;
+	uuid_t uu;
+	int i, ret;
+
+	switch (op) {
+	case UUIDD_OP_GETPID:
+		sprintf(reply_buf, "%d", getpid());
+		*reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_GET_MAXOP:
+		sprintf(reply_buf, "%d", UUIDD_MAX_OP);
+		*reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_PERSISTENT:
+	{
+		int32_t yes = 1;
+
+		memcpy(reply_buf, &yes, sizeof(yes));
+		*reply_len = sizeof(yes);
+		break;
+	}
+	case UUIDD_OP_TIME_UUID:
+		num = 1;
+		ret = generate_time(wrk, uu, &num);
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated time UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		*reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_RANDOM_UUID:
+		num = 1;
+		__uuid_generate_random(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated random UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		*reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_BULK_TIME_UUID:
+		ret = generate_time(wrk, uu, &num);
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, P_("Generated time UUID %s "
+					   "and %d following\n",
+					   "Generated time UUID %s "
+					   "and %d following\n", num - 1),
+			       str, num - 1);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		*reply_len = sizeof(uu);
+		memcpy(reply_buf + *reply_len, &num, sizeof(num));
+		*reply_len += sizeof(num);
+		break;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+		if (num < 0)
+			num = 1;
+		if ((UUIDD_PROT_BUFSZ - sizeof(num)) < (size_t) (sizeof(uu) * num))
+			num = (UUIDD_PROT_BUFSZ - sizeof(num)) / sizeof(uu);
+		__uuid_generate_random((unsigned char *) reply_buf +
+				      sizeof(num), &num);
+		*reply_len = sizeof(num) + (sizeof(uu) * num);
+		memcpy(reply_buf, &num, sizeof(num));
+		if (uuidd_cxt->debug) {
+			fprintf(stderr, P_("Generated %d UUID:\n",
+					   "Generated %d UUIDs:\n", num), num);
+			cp = reply_buf + sizeof(num);
+			for (i = 0; i < num; i++) {
+				uuid_unparse((unsigned char *)cp, str);
+				fprintf(stderr, "\t%s\n", str);
+				cp += sizeof(uu);
+			}
+		}
+		break;
+	default:
+		if (uuidd_cxt->debug)
+			fprintf(stderr, _("Invalid operation %d\n"), op);
+		return -1;
+	}
+	return 0;
+}
+
+#ifdef HAVE_MEMFD_CREATE
+/*
+ * Deposit new ranges to the claimed slots and replace the expired ranges. All
+ * the ranges are reserved by one call to not write the clock file for every
+ * slot. The expired ranges are replaced only if the client uses the ring (or
+ * it has asked for time-based UUID by the socket). Nothing from the ring is
+ * trusted except the sequence numbers, the client can write to the ring.
+ * Returns the number of the slots claimed by the client.
+ */
+static size_t refill_ring(struct uuidd_cxt_t *uuidd_cxt, struct uuidd_conn *conn)
+{
+	struct uuidd_ring *ring = conn->ring;
+	struct uuidd_ring_slot *todo[UUIDD_RING_SLOTS];
+	size_t i, ntodo = 0, nclaimed = 0;
+	time_t now = time(NULL);
+	uuidd_prot_num_t num;
+	uuid_t uu;
+	int ret, wanted;
+
+	__atomic_store_n(&ring->heartbeat, (int64_t) now, __ATOMIC_RELEASE);
+
+	for (i = 0; i < UUIDD_RING_SLOTS; i++) {
+		if (__atomic_load_n(&ring->slots[i].seq, __ATOMIC_ACQUIRE) & 1)
+			nclaimed++;
+	}
+	wanted = __atomic_exchange_n(&conn->ring_wanted, 0, __ATOMIC_RELAXED);
+	if (nclaimed)
+		__atomic_store_n(&conn->last, now, __ATOMIC_RELAXED);
+
+	for (i = 0; i < UUIDD_RING_SLOTS; i++) {
+		struct uuidd_ring_slot *sl = &ring->slots[i];
+		uint64_t seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE);
+
+		if (!(seq & 1)
+		    && (__atomic_load_n(&sl->expire, __ATOMIC_RELAXED) > now
+			|| (!nclaimed && !wanted)
+			|| !__atomic_compare_exchange_n(&sl->seq, &seq, seq + 1, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_RELAXED)))
+			continue;	/* valid, unused, or just claimed by the client */
+		todo[ntodo++] = sl;
+	}
+	if (!ntodo)
+		return 0;
+
+	num = ntodo * UUIDD_RING_RANGE;
+	pthread_mutex_lock(&uuidd_clock_lock);
+	ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
+	pthread_mutex_unlock(&uuidd_clock_lock);
+	if (ret < 0) {
+		/* keep the slots claimed, try it again later */
+		if (!uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		return nclaimed;
+	}
+
+	for (i = 0; i < ntodo; i++) {
+		struct uuidd_ring_slot *sl = todo[i];
+		uint64_t u[2];
+
+		memcpy(u, uu, sizeof(u));
+		__atomic_store_n(&sl->uuid[0], u[0], __ATOMIC_RELAXED);
+		__atomic_store_n(&sl->uuid[1], u[1], __ATOMIC_RELAXED);
+		__atomic_store_n(&sl->num, UUIDD_RING_RANGE, __ATOMIC_RELAXED);
+		__atomic_store_n(&sl->expire, (int64_t) now + UUIDD_RANGE_EXPIRE,
+				 __ATOMIC_RELAXED);
+		__atomic_fetch_add(&sl->seq, 1, __ATOMIC_RELEASE);
+
+		uuid_time_add(uu, UUIDD_RING_RANGE);
+	}
+
+	if (uuidd_cxt->debug) {
+		char str[UUID_STR_LEN];
+
+		uuid_unparse(uu, str);
+		fprintf(stderr, _("Deposited %zu ranges to the ring %d, %zu claimed, next %s\n"),
+			ntodo, conn->fd, nclaimed, str);
+	}
+	return nclaimed;
+}
+
+#define UUIDD_RING_INTERVAL	10000	/* usec */
+#define UUIDD_MAX_RINGS		256
+
+static void *ring_loop(void *data)
+{
+	struct uuidd_cxt_t *uuidd_cxt = data;
+
+	while (1) {
+		struct list_head *p;
+		size_t nclaimed = 0;
+
+		pthread_mutex_lock(&uuidd_cxt->rings_lock);
+		list_for_each(p, &uuidd_cxt->rings) {
+			struct uuidd_conn *conn = list_entry(p, struct uuidd_conn, rings);
+
+			nclaimed += refill_ring(uuidd_cxt, conn);
+		}
+		pthread_mutex_unlock(&uuidd_cxt->rings_lock);
+
+		if (nclaimed)
+			__atomic_store_n(&uuidd_cxt->last_activity, time(NULL),
+					 __ATOMIC_RELAXED);
+		xusleep(UUIDD_RING_INTERVAL);
+	}
+	return NULL;
+}
+
+static void start_ring(struct uuidd_cxt_t *uuidd_cxt)
+{
+	pthread_t thread;
+
+	errno = pthread_create(&thread, NULL, ring_loop, uuidd_cxt);
+	if (errno)
+		err(EXIT_FAILURE, _("cannot create ring thread"));
+	if (uuidd_cxt->debug)
+		fprintf(stderr, _("shared rings enabled\n"));
+}
+
+/*
+ * Create the shared ring for the connection (see uuidd.h). The memory is
+ * sealed, so the client cannot resize it under the daemon. Returns the file
+ * descriptor of the ring, or -1.
+ */
+static int create_ring(struct uuidd_cxt_t *uuidd_cxt, struct uuidd_conn *conn)
+{
+	struct uuidd_ring *ring;
+	int fd;
+
+	if (conn->ring || __atomic_load_n(&uuidd_cxt->nrings, __ATOMIC_RELAXED)
+					>= UUIDD_MAX_RINGS)
+		return -1;
+
+	fd = memfd_create("uuidd-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, sizeof(*ring)) != 0
+	    || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)
+		goto fail;
+
+	ring = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED)
+		goto fail;
+
+	ring->magic = UUIDD_RING_MAGIC;
+	ring->version = UUIDD_RING_VERSION;
+	ring->nslots = UUIDD_RING_SLOTS;
+
+	conn->ring = ring;
+	conn->ring_wanted = 1;
+	refill_ring(uuidd_cxt, conn);
+
+	pthread_mutex_lock(&uuidd_cxt->rings_lock);
+	list_add_tail(&conn->rings, &uuidd_cxt->rings);
+	uuidd_cxt->nrings++;
+	pthread_mutex_unlock(&uuidd_cxt->rings_lock);
+	return fd;
+fail:
+	if (!uuidd_cxt->quiet)
+		warn(_("cannot create shared ring"));
+	close(fd);
+	return -1;
+}
+
+static void free_ring(struct uuidd_cxt_t *uuidd_cxt, struct uuidd_conn *conn)
+{
+	if (!conn->ring)
+		return;
+
+	pthread_mutex_lock(&uuidd_cxt->rings_lock);
+	list_del(&conn->rings);
+	uuidd_cxt->nrings--;
+	pthread_mutex_unlock(&uuidd_cxt->rings_lock);
+
+	munmap(conn->ring, sizeof(*conn->ring));
+	conn->ring = NULL;
+}
+#else
+static void start_ring(struct uuidd_cxt_t *uuidd_cxt __attribute__((__unused__)))
+{
+}
+
+static int create_ring(struct uuidd_cxt_t *uuidd_cxt __attribute__((__unused__)),
+		       struct uuidd_conn *conn __attribute__((__unused__)))
+{
+	return -1;
+}
+
+static void free_ring(struct uuidd_cxt_t *uuidd_cxt __attribute__((__unused__)),
+		      struct uuidd_conn *conn __attribute__((__unused__)))
+{
+}
+#endif /* HAVE_MEMFD_CREATE */
+
+/*
+ * Reply to UUIDD_OP_RING, the reply is 1 and the file descriptor of the ring
+ * is attached if the ring is available, or 0.
+ */
+static int reply_ring(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	int32_t reply[2] = { sizeof(int32_t), 0 };
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct iovec iov = { .iov_base = reply, .iov_len = sizeof(reply) };
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+	int fd = -1, rc;
+
+	memset(cbuf, 0, sizeof(cbuf));
+
+	if (wrk->cxt->shared_ring)
+		fd = create_ring(wrk->cxt, conn);
+	if (fd >= 0) {
+		struct cmsghdr *cmsg;
+
+		reply[1] = 1;
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	rc = sendmsg(conn->fd, &msg, MSG_NOSIGNAL) == (ssize_t) sizeof(reply) ? 0 : -1;
+	if (fd >= 0)
+		close(fd);
+	return rc;
+}
+
+static void close_conn(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	free_ring(wrk->cxt, conn);
+	epoll_ctl(wrk->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	list_del(&conn->conns);
+	__atomic_sub_fetch(&wrk->cxt->nconns, 1, __ATOMIC_RELAXED);
+	free(conn->out);
+	free(conn);
+}
+
+static int append_reply(struct uuidd_conn *conn, const void *data, size_t sz)
+{
+	if (conn->outlen + sz > conn->outsz) {
+		size_t n = max(conn->outlen + sz, conn->outsz * 2);
+		char *tmp = realloc(conn->out, n);
+
+		if (!tmp)
+			return -1;
+		conn->out = tmp;
+		conn->outsz = n;
+	}
+	memcpy(conn->out + conn->outlen, data, sz);
+	conn->outlen += sz;
+	return 0;
+}
+
+/*
+ * Write the replies, the socket is non-blocking. The connection waits for
+ * EPOLLOUT (and no more requests are read) until all the replies are written.
+ */
+static int flush_conn(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	struct epoll_event ev = { .data.ptr = conn };
+	size_t done = 0;
+
+	while (done < conn->outlen) {
+		ssize_t n = send(conn->fd, conn->out + done, conn->outlen - done,
+				 MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+		done += n;
+	}
+	if (done) {
+		conn->outlen -= done;
+		if (conn->outlen)
+			memmove(conn->out, conn->out + done, conn->outlen);
+		__atomic_store_n(&conn->last, time(NULL), __ATOMIC_RELAXED);
+	}
+
+	ev.events = conn->outlen ? EPOLLOUT : EPOLLIN;
+	if (ev.events != conn->events) {
+		if (epoll_ctl(wrk->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+			return -1;
+		conn->events = ev.events;
+	}
+	return 0;
+}
+
+/*
+ * Reply to all complete requests in the buffer; the client may send more
+ * requests (pipelining). Returns 1 if a request has to wait for the previous
+ * replies, 0 if all requests are done, or -1 if the connection has to be
+ * closed.
+ */
+static int handle_requests(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	struct uuidd_cxt_t *uuidd_cxt = wrk->cxt;
+	char reply_buf[UUIDD_PROT_BUFSZ];
+	size_t used = 0;
+	int rc = 0;
+
+	while (used < conn->len) {
+		uuidd_prot_op_t op = conn->buf[used];
+		uuidd_prot_num_t num = 0;
+		size_t sz = sizeof(op);
+		int32_t reply_len = 0;
+
+		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
+		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
+			sz += sizeof(num);
+			if (conn->len - used < sz)
+				break;		/* incomplete request */
+			memcpy(&num, conn->buf + used + sizeof(op), sizeof(num));
+			if (uuidd_cxt->debug)
+				fprintf(stderr, _("operation %d, incoming num = %d\n"),
+				       op, num);
+		} else if (op == UUIDD_OP_RING && conn->outlen) {
+			rc = 1;			/* the fd has to follow the replies */
+			break;
+		} else if (uuidd_cxt->debug)
+			fprintf(stderr, _("operation %d\n"), op);
+
+		used += sz;
+
+		if (op == UUIDD_OP_RING) {
+			if (reply_ring(wrk, conn) != 0)
+				return -1;
+			continue;
+		}
+		if (conn->ring && (op == UUIDD_OP_TIME_UUID || op == UUIDD_OP_BULK_TIME_UUID))
+			__atomic_store_n(&conn->ring_wanted, 1, __ATOMIC_RELAXED);
+
+		if (handle_request(wrk, op, num, reply_buf, &reply_len) != 0)
+			return -1;
+		if (append_reply(conn, &reply_len, sizeof(reply_len)) != 0 ||
+		    append_reply(conn, reply_buf, reply_len) != 0)
+			return -1;
+	}
+
+	conn->len -= used;
+	if (conn->len)
+		memmove(conn->buf, conn->buf + used, conn->len);
+	return rc;
+}
+
+/*
+ * Read from the client and reply, or write the rest of the replies. The client
+ * may keep the connection open for the next requests. Returns -1 if the
+ * connection has to be closed.
+ */
+static int handle_conn(struct uuidd_worker *wrk, struct uuidd_conn *conn,
+		       uint32_t events)
+{
+	struct uuidd_cxt_t *uuidd_cxt = wrk->cxt;
+	int rc;
+
+	if (events & EPOLLERR)
+		return -1;
+
+	if ((events & (EPOLLIN | EPOLLHUP)) && !conn->outlen) {
+		ssize_t len;
+
+		if (conn->len == sizeof(conn->buf))
+			return -1;	/* garbage */
+
+		len = read(conn->fd, conn->buf + conn->len, sizeof(conn->buf) - conn->len);
+		if (len <= 0) {
+			if (len < 0 && (errno == EINTR || errno == EAGAIN))
+				return 0;
+			if (len < 0)
+				warn(_("read failed"));
+			else if (conn->len)
+				warnx(_("error reading from client, len = %zu"), conn->len);
+			return -1;
+		}
+		conn->len += len;
+		__atomic_store_n(&conn->last, time(NULL), __ATOMIC_RELAXED);
+		__atomic_store_n(&uuidd_cxt->last_activity, conn->last, __ATOMIC_RELAXED);
+
+	} else if ((events & EPOLLHUP) && conn->outlen)
+		return -1;	/* the replies cannot be written */
+
+	do {
+		rc = handle_requests(wrk, conn);
+		if (rc < 0 || flush_conn(wrk, conn) != 0)
+			return -1;
+	} while (rc == 1 && !conn->outlen);
+
+	return 0;
+}
+
+/*
+ * Stop accept() for UUIDD_ACCEPT_BACKOFF seconds; the listening socket stays
+ * readable, so epoll would report it again and again when the connection
+ * cannot be accepted (e.g. EMFILE).
+ */
+#define UUIDD_ACCEPT_BACKOFF	1
+
+static void pause_accept(struct uuidd_worker *wrk)
+{
+	if (!wrk->cxt->quiet)
+		warn(_("cannot accept connection, paused for %d sec"), UUIDD_ACCEPT_BACKOFF);
+
+	epoll_ctl(wrk->epoll_fd, EPOLL_CTL_DEL, wrk->cxt->listen_fd, NULL);
+	wrk->accept_paused = time(NULL) + UUIDD_ACCEPT_BACKOFF;
+}
+
+static void resume_accept(struct uuidd_worker *wrk)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN | EPOLLEXCLUSIVE,
+		.data.ptr = NULL
+	};
+
+	if (epoll_ctl(wrk->epoll_fd, EPOLL_CTL_ADD, wrk->cxt->listen_fd, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot add listening socket to epoll"));
+	wrk->accept_paused = 0;
+}
+
+#define UUIDD_MAX_CONNS		1024
+#define UUIDD_CONN_TIMEOUT	60	/* sec, close idle connection */
+
+static void accept_conns(struct uuidd_worker *wrk)
+{
+	while (1) {
+		struct epoll_event ev = { .events = EPOLLIN };
+		struct uuidd_conn *conn;
+		int ns;
+
+		ns = accept4(wrk->cxt->listen_fd, NULL, NULL,
+			     SOCK_CLOEXEC | SOCK_NONBLOCK);
+		if (ns < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EMFILE || errno == ENFILE
+			    || errno == ENOBUFS || errno == ENOMEM)
+				pause_accept(wrk);
+			else if (errno != EAGAIN && errno != EWOULDBLOCK
+			    && errno != ECONNABORTED && !wrk->cxt->quiet)
+				warn("accept");
+			return;
+		}
+
+		/* the client falls back to the local generator */
+		if (__atomic_load_n(&wrk->cxt->nconns, __ATOMIC_RELAXED) >= UUIDD_MAX_CONNS) {
+			if (wrk->cxt->debug)
+				fprintf(stderr, _("too many connections\n"));
+			close(ns);
+			continue;
+		}
+
+		conn = calloc(1, sizeof(*conn));
+		if (!conn) {
+			close(ns);
+			continue;
+		}
+		conn->fd = ns;
+		conn->events = EPOLLIN;
+		conn->last = time(NULL);
+		ev.data.ptr = conn;
+		__atomic_store_n(&wrk->cxt->last_activity, conn->last, __ATOMIC_RELAXED);
+		if (epoll_ctl(wrk->epoll_fd, EPOLL_CTL_ADD, ns, &ev) < 0) {
+			close(ns);
+			free(conn);
+			continue;
+		}
+		list_add_tail(&conn->conns, &wrk->conns);
+		__atomic_add_fetch(&wrk->cxt->nconns, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/* close the connections without any request for UUIDD_CONN_TIMEOUT */
+static void close_idle_conns(struct uuidd_worker *wrk, time_t now)
+{
+	struct list_head *p, *pnext;
+
+	list_for_each_safe(p, pnext, &wrk->conns) {
+		struct uuidd_conn *conn = list_entry(p, struct uuidd_conn, conns);
+
+		if (__atomic_load_n(&conn->last, __ATOMIC_RELAXED) + UUIDD_CONN_TIMEOUT < now) {
+			if (wrk->cxt->debug)
+				fprintf(stderr, _("closing idle connection %d\n"), conn->fd);
+			close_conn(wrk, conn);
+		}
+	}
+}
+
+#define UUIDD_MAX_EVENTS	64
+#define UUIDD_MAX_WORKERS	4	/* default maximum */
+
+static void *worker_loop(void *data)
+{
+	struct uuidd_worker *wrk = data;
+	struct epoll_event events[UUIDD_MAX_EVENTS];
+	time_t last_check = time(NULL);
+
+	while (1) {
+		int i, n, timeout = -1;
+		time_t now;
+
+		if (wrk->accept_paused || !list_empty(&wrk->conns))
+			timeout = 1000;
+
+		n = epoll_wait(wrk->epoll_fd, events, ARRAY_SIZE(events), timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, _("epoll_wait failed"));
+		}
+		for (i = 0; i < n; i++) {
+			struct uuidd_conn *conn = events[i].data.ptr;
+
+			if (!conn)
+				accept_conns(wrk);
+			else if (handle_conn(wrk, conn, events[i].events) != 0)
+				close_conn(wrk, conn);
+		}
+
+		now = time(NULL);
+		if (wrk->accept_paused && now >= wrk->accept_paused)
+			resume_accept(wrk);
+		if (now != last_check) {
+			close_idle_conns(wrk, now);
+			last_check = now;
+		}
+	}
+	return NULL;
+}
+
+static void start_workers(struct uuidd_cxt_t *uuidd_cxt)
+{
+	size_t i;
+
+	uuidd_cxt->workers = xcalloc(uuidd_cxt->nworkers, sizeof(struct uuidd_worker));
+
+	for (i = 0; i < uuidd_cxt->nworkers; i++) {
+		struct uuidd_worker *wrk = &uuidd_cxt->workers[i];
+		struct epoll_event ev = {
+			.events = EPOLLIN | EPOLLEXCLUSIVE,
+			.data.ptr = NULL
+		};
+
+		wrk->cxt = uuidd_cxt;
+		INIT_LIST_HEAD(&wrk->conns);
+		wrk->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (wrk->epoll_fd < 0)
+			err(EXIT_FAILURE, _("cannot create epoll"));
+		if (epoll_ctl(wrk->epoll_fd, EPOLL_CTL_ADD, uuidd_cxt->listen_fd, &ev) < 0)
+			err(EXIT_FAILURE, _("cannot add listening socket to epoll"));
+
+		errno = pthread_create(&wrk->thread, NULL, worker_loop, wrk);
+		if (errno)
+			err(EXIT_FAILURE, _("cannot create worker thread"));
+	}
+	if (uuidd_cxt->debug)
+		fprintf(stderr, _("started %zu workers\n"), uuidd_cxt->nworkers);
+}
+
 static void server_loop(const char *socket_path, const char *pidfile_path,
 			struct uuidd_cxt_t *uuidd_cxt)
 {
-	struct sockaddr_un	from_addr;
-	socklen_t		fromlen;
-	int32_t			reply_len = 0;
 	uuid_t			uu;
-	char			reply_buf[UUIDD_PROT_BUFSZ], *cp;
-	uuidd_prot_op_t 	op;
-	char			str[UUID_STR_LEN];
-	int			i, ns, len;
-	uuidd_prot_num_t	num;		/* intentionally uninitialized */
+	char			reply_buf[UUIDD_PROT_BUFSZ];
+	uuidd_prot_num_t	num;
 	int			s = 0;
 	int			fd_pidfile = -1;
 	int			ret;
-	struct pollfd		pfd[2];
+	struct pollfd		pfd;
 	sigset_t		sigmask;
 	int			sigfd;
-	enum {
-				POLLFD_SIGNAL = 0,
-				POLLFD_SOCKET
-	};
 
 #ifdef HAVE_LIBSYSTEMD
 	if (!uuidd_cxt->no_sock)	/* no_sock implies no_fork and no_pid */
@@ -438,9 +1214,8 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	if ((sigfd = signalfd(-1, &sigmask, 0)) < 0)
 		err(EXIT_FAILURE, _("cannot set signal handler"));
 
-	pfd[POLLFD_SIGNAL].fd = sigfd;
-	pfd[POLLFD_SOCKET].fd = s;
-	pfd[POLLFD_SIGNAL].events = pfd[POLLFD_SOCKET].events = POLLIN | POLLERR | POLLHUP;
+	pfd.fd = sigfd;
+	pfd.events = POLLIN | POLLERR | POLLHUP;
 
 	num = 1;
 	if (uuidd_cxt->cont_clock_offset) {
@@ -451,128 +1226,43 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 				uuidd_cxt->cont_clock_offset);
 	}
 
+	/* more workers accept() from the same socket */
+	if (fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) < 0)
+		err(EXIT_FAILURE, _("cannot set non-blocking mode"));
+	uuidd_cxt->listen_fd = s;
+	uuidd_cxt->last_activity = time(NULL);
+	INIT_LIST_HEAD(&uuidd_cxt->rings);
+	pthread_mutex_init(&uuidd_cxt->rings_lock, NULL);
+
+	/* the workers inherit the blocked signals */
+	start_workers(uuidd_cxt);
+	if (uuidd_cxt->shared_ring)
+		start_ring(uuidd_cxt);
+
 	while (1) {
-		ret = poll(pfd, ARRAY_SIZE(pfd),
-				uuidd_cxt->timeout ?
-					(int) uuidd_cxt->timeout * 1000 : -1);
+		int timeout = -1;
+
+		if (uuidd_cxt->timeout) {
+			time_t idle = time(NULL) -
+				__atomic_load_n(&uuidd_cxt->last_activity, __ATOMIC_RELAXED);
+
+			if (idle >= (time_t) uuidd_cxt->timeout) {
+				if (uuidd_cxt->debug)
+					fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
+				all_done(uuidd_cxt, EXIT_SUCCESS);
+			}
+			timeout = (uuidd_cxt->timeout - idle) * 1000;
+		}
+
+		ret = poll(&pfd, 1, timeout);
 		if (ret < 0) {
-			if (errno == EAGAIN)
+			if (errno == EAGAIN || errno == EINTR)
 				continue;
 			warn(_("poll failed"));
 			all_done(uuidd_cxt, EXIT_FAILURE);
 		}
-		if (ret == 0) {		/* true when poll() times out */
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
-			all_done(uuidd_cxt, EXIT_SUCCESS);
-		}
-		if (pfd[POLLFD_SIGNAL].revents != 0)
+		if (ret > 0 && pfd.revents != 0)
 			handle_signal(uuidd_cxt, sigfd);
-		if (pfd[POLLFD_SOCKET].revents == 0)
-			continue;
-		fromlen = sizeof(from_addr);
-		ns = accept(s, (struct sockaddr *) &from_addr, &fromlen);
-		if (ns < 0) {
-			if ((errno == EAGAIN) || (errno == EINTR))
-				continue;
-			err(EXIT_FAILURE, "accept");
-		}
-		len = read(ns, &op, sizeof(op));
-		if (len != sizeof(op)) {
-			if (len < 0)
-				warn(_("read failed"));
-			else
-				warnx(_("error reading from client, len = %d"),
-						len);
-			goto shutdown_socket;
-		}
-		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
-			if (read_all(ns, (char *) &num, sizeof(num)) != sizeof(num))
-				goto shutdown_socket;
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("operation %d, incoming num = %d\n"),
-				       op, num);
-		} else if (uuidd_cxt->debug)
-			fprintf(stderr, _("operation %d\n"), op);
-
-		switch (op) {
-		case UUIDD_OP_GETPID:
-			sprintf(reply_buf, "%d", getpid());
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_GET_MAXOP:
-			sprintf(reply_buf, "%d", UUIDD_MAX_OP);
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_TIME_UUID:
-			num = 1;
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated time UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_RANDOM_UUID:
-			num = 1;
-			__uuid_generate_random(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated random UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_BULK_TIME_UUID:
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, P_("Generated time UUID %s "
-						   "and %d following\n",
-						   "Generated time UUID %s "
-						   "and %d following\n", num - 1),
-				       str, num - 1);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			memcpy(reply_buf + reply_len, &num, sizeof(num));
-			reply_len += sizeof(num);
-			break;
-		case UUIDD_OP_BULK_RANDOM_UUID:
-			if (num < 0)
-				num = 1;
-			if ((sizeof(reply_buf) - sizeof(num)) < (size_t) (sizeof(uu) * num))
-				num = (sizeof(reply_buf) - sizeof(num)) / sizeof(uu);
-			__uuid_generate_random((unsigned char *) reply_buf +
-					      sizeof(num), &num);
-			reply_len = sizeof(num) + (sizeof(uu) * num);
-			memcpy(reply_buf, &num, sizeof(num));
-			if (uuidd_cxt->debug) {
-				fprintf(stderr, P_("Generated %d UUID:\n",
-						   "Generated %d UUIDs:\n", num), num);
-				cp = reply_buf + sizeof(num);
-				for (i = 0; i < num; i++) {
-					uuid_unparse((unsigned char *)cp, str);
-					fprintf(stderr, "\t%s\n", str);
-					cp += sizeof(uu);
-				}
-			}
-			break;
-		default:
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("Invalid operation %d\n"), op);
-			goto shutdown_socket;
-		}
-		write_all(ns, (char *) &reply_len, sizeof(num));
-		write_all(ns, reply_buf, reply_len);
-	shutdown_socket:
-		close(ns);
 	}
 }
 
@@ -616,6 +1306,8 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 		{"no-pid", no_argument, NULL, 'P'},
 		{"no-fork", no_argument, NULL, 'F'},
 		{"socket-activation", no_argument, NULL, 'S'},
+		{"workers", required_argument, NULL, 'W'},
+		{"shared-ring", no_argument, NULL, 'R'},
 		{"cont-clock", optional_argument, NULL, 'C'},
 		{"debug", no_argument, NULL, 'd'},
 		{"quiet", no_argument, NULL, 'q'},
@@ -632,7 +1324,7 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 	int c;
 
-	while ((c = getopt_long(argc, argv, "p:s:T:krtn:PFSC::dqVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "p:s:T:krtn:PFRSC::dqVW:h", longopts, NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
 		case 'C':
@@ -687,6 +1379,16 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 			uuidd_cxt->timeout = strtou32_or_err(optarg,
 						_("failed to parse --timeout"));
 			break;
+		case 'R':
+#ifndef HAVE_MEMFD_CREATE
+			errx(EXIT_FAILURE, _("--shared-ring is not supported"));
+#endif
+			uuidd_cxt->shared_ring = 1;
+			break;
+		case 'W':
+			uuidd_cxt->nworkers = str2num_or_err(optarg, 10,
+						_("failed to parse --workers"), 1, 1024);
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -725,6 +1427,12 @@ int main(int argc, char **argv)
 
 	parse_options(argc, argv, &uuidd_cxt, &uuidd_opts);
 
+	if (!uuidd_cxt.nworkers) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		uuidd_cxt.nworkers = ncpus > 0 ? min(ncpus, (long) UUIDD_MAX_WORKERS) : 1;
+	}
+
 	if (strlen(uuidd_opts.socket_path) >= sizeof(((struct sockaddr_un *)0)->sun_path))
 		errx(EXIT_FAILURE, _("socket name too long: %s"), uuidd_opts.socket_path);
 
@@ -17,6 +17,18 @@
 #include "nls.h"
 #include "c.h"
 #include "closestream.h"
+#include "strutils.h"
+#include "xalloc.h"
+
+/* output formats */
+enum {
+	UUIDGEN_FMT_TEXT = 0,	/* 1b4e28ba-2fa1-11d2-883f-b9a761bde3fb */
+	UUIDGEN_FMT_HEX,	/* 1b4e28ba2fa111d2883fb9a761bde3fb */
+	UUIDGEN_FMT_BINARY	/* 16 bytes */
+};
+
+/* UUIDs generated and written at once for --count */
+#define UUIDGEN_BATCH	1024
 
 static void __attribute__((__noreturn__)) usage(void)
 {
@@ -31,12 +43,16 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -r, --random        generate random-based uuid\n"), out);
 	fputs(_(" -t, --time          generate time-based uuid\n"), out);
+	fputs(_(" -6, --time-v6       generate time-based uuid, version 6\n"), out);
+	fputs(_(" -7, --time-v7       generate time-based uuid, version 7\n"), out);
 	fputs(_(" -n, --namespace ns  generate hash-based uuid in this namespace\n"), out);
 	printf(_("                       available namespaces: %s\n"), "@dns @url @oid @x500");
 	fputs(_(" -N, --name name     generate hash-based uuid from this name\n"), out);
 	fputs(_(" -m, --md5           generate md5 hash\n"), out);
 	fputs(_(" -s, --sha1          generate sha1 hash\n"), out);
 	fputs(_(" -x, --hex           interpret name as hex string\n"), out);
+	fputs(_(" -C, --count num     generate more uuids\n"), out);
+	fputs(_(" -F, --format fmt    output format: text, hex or binary\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(21));
 	printf(USAGE_MAN_TAIL("uuidgen(1)"));
@@ -79,19 +95,98 @@ badstring:
 	return value2;
 }
 
+static int parse_format(const char *str)
+{
+	if (strcmp(str, "text") == 0)
+		return UUIDGEN_FMT_TEXT;
+	if (strcmp(str, "hex") == 0)
+		return UUIDGEN_FMT_HEX;
+	if (strcmp(str, "binary") == 0)
+		return UUIDGEN_FMT_BINARY;
+
+	warnx(_("unsupported output format: '%s'"), str);
+	errtryhelp(EXIT_FAILURE);
+}
+
+static void generate_uuids(int do_type, uuid_t *uus, size_t n,
+			   const uuid_t ns, const char *name, size_t namelen)
+{
+	size_t i;
+
+	if (do_type == UUID_TYPE_DCE_RANDOM) {
+		uuid_generate_random_bulk(uus, n);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		switch (do_type) {
+		case UUID_TYPE_DCE_TIME:
+			uuid_generate_time(uus[i]);
+			break;
+		case UUID_TYPE_DCE_TIME_V6:
+			uuid_generate_time_v6(uus[i]);
+			break;
+		case UUID_TYPE_DCE_TIME_V7:
+			uuid_generate_time_v7(uus[i]);
+			break;
+		case UUID_TYPE_DCE_MD5:
+			uuid_generate_md5(uus[i], ns, name, namelen);
+			break;
+		case UUID_TYPE_DCE_SHA1:
+			uuid_generate_sha1(uus[i], ns, name, namelen);
+			break;
+		default:
+			uuid_generate(uus[i]);
+			break;
+		}
+	}
+}
+
+/* returns the output size */
+static size_t format_uuids(int fmt, const uuid_t *uus, size_t n, char *buf)
+{
+	static const char hexdigits[] = "0123456789abcdef";
+	char *p = buf;
+	size_t i, j;
+
+	for (i = 0; i < n; i++) {
+		switch (fmt) {
+		case UUIDGEN_FMT_BINARY:
+			memcpy(p, uus[i], sizeof(uuid_t));
+			p += sizeof(uuid_t);
+			break;
+		case UUIDGEN_FMT_HEX:
+			for (j = 0; j < sizeof(uuid_t); j++) {
+				*p++ = hexdigits[uus[i][j] >> 4];
+				*p++ = hexdigits[uus[i][j] & 0xf];
+			}
+			*p++ = '\n';
+			break;
+		default:
+			uuid_unparse(uus[i], p);	/* overwrite the \0 */
+			p += UUID_STR_LEN - 1;
+			*p++ = '\n';
+			break;
+		}
+	}
+	return p - buf;
+}
+
 int
 main (int argc, char *argv[])
 {
 	int    c;
-	int    do_type = 0, is_hex = 0;
-	char   str[UUID_STR_LEN];
-	char   *namespace = NULL, *name = NULL;
+	int    do_type = 0, is_hex = 0, fmt = UUIDGEN_FMT_TEXT;
+	char   *namespace = NULL, *name = NULL, *buf;
 	size_t namelen = 0;
-	uuid_t ns, uu;
+	uint64_t count = 1;
+	uuid_t ns, *uus;
 
 	static const struct option longopts[] = {
 		{"random", no_argument, NULL, 'r'},
 		{"time", no_argument, NULL, 't'},
+		{"time-v6", no_argument, NULL, '6'},
+		{"time-v7", no_argument, NULL, '7'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
 		{"namespace", required_argument, NULL, 'n'},
@@ -99,6 +194,8 @@ main (int argc, char *argv[])
 		{"md5", no_argument, NULL, 'm'},
 		{"sha1", no_argument, NULL, 's'},
 		{"hex", no_argument, NULL, 'x'},
+		{"count", required_argument, NULL, 'C'},
+		{"format", required_argument, NULL, 'F'},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -107,7 +204,7 @@ main (int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "rtVhn:N:msx", longopts, NULL)) != -1)
+	while ((c = getopt_long(argc, argv, "rtVhn:N:msx67C:F:", longopts, NULL)) != -1)
 		switch (c) {
 		case 't':
 			do_type = UUID_TYPE_DCE_TIME;
@@ -115,6 +212,12 @@ main (int argc, char *argv[])
 		case 'r':
 			do_type = UUID_TYPE_DCE_RANDOM;
 			break;
+		case '6':
+			do_type = UUID_TYPE_DCE_TIME_V6;
+			break;
+		case '7':
+			do_type = UUID_TYPE_DCE_TIME_V7;
+			break;
 		case 'n':
 			namespace = optarg;
 			break;
@@ -130,6 +233,12 @@ main (int argc, char *argv[])
 		case 'x':
 			is_hex = 1;
 			break;
+		case 'C':
+			count = strtou64_or_err(optarg, _("invalid count argument"));
+			break;
+		case 'F':
+			fmt = parse_format(optarg);
+			break;
 
 		case 'h':
 			usage();
@@ -165,15 +274,7 @@ main (int argc, char *argv[])
 			name = unhex(name, &namelen);
 	}
 
-	switch (do_type) {
-	case UUID_TYPE_DCE_TIME:
-		uuid_generate_time(uu);
-		break;
-	case UUID_TYPE_DCE_RANDOM:
-		uuid_generate_random(uu);
-		break;
-	case UUID_TYPE_DCE_MD5:
-	case UUID_TYPE_DCE_SHA1:
+	if (namespace) {
 		if (namespace[0] == '@' && namespace[1] != '\0') {
 			const uuid_t *uuidptr;
 
@@ -189,20 +290,23 @@ main (int argc, char *argv[])
 				errtryhelp(EXIT_FAILURE);
 			}
 		}
-		if (do_type == UUID_TYPE_DCE_MD5)
-			uuid_generate_md5(uu, ns, name, namelen);
-		else
-			uuid_generate_sha1(uu, ns, name, namelen);
-		break;
-	default:
-		uuid_generate(uu);
-		break;
 	}
 
-	uuid_unparse(uu, str);
+	uus = xmalloc(min(count, (uint64_t) UUIDGEN_BATCH) * sizeof(uuid_t));
+	buf = xmalloc(min(count, (uint64_t) UUIDGEN_BATCH) * UUID_STR_LEN);
 
-	printf("%s\n", str);
+	while (count) {
+		size_t n = min(count, (uint64_t) UUIDGEN_BATCH), len;
+
+		generate_uuids(do_type, uus, n, ns, name, namelen);
+		len = format_uuids(fmt, (const uuid_t *) uus, n, buf);
+		if (fwrite(buf, 1, len, stdout) != len)
+			err(EXIT_FAILURE, _("write failed"));
+		count -= n;
+	}
 
+	free(uus);
+	free(buf);
 	if (is_hex)
 		free(name);
 
@@ -86,7 +86,8 @@ struct control {
 	unsigned int
 		json:1,
 		no_headings:1,
-		raw:1;
+		raw:1,
+		stream:1;
 };
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -101,6 +102,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	puts(_(" -n, --noheadings       don't print headings"));
 	puts(_(" -o, --output <list>    COLUMNS to display (see below)"));
 	puts(_(" -r, --raw              use the raw output format"));
+	puts(_(" -s, --stream           print the lines immediately"));
 	printf(USAGE_HELP_OPTIONS(24));
 
 	fputs(USAGE_COLUMNS, stdout);
@@ -213,6 +215,12 @@ static void fill_table_row(struct libscols_table *tb, char const *const uuid)
 			case UUID_TYPE_DCE_SHA1:
 				str = xstrdup(_("sha1-based"));
 				break;
+			case UUID_TYPE_DCE_TIME_V6:
+				str = xstrdup(_("time-v6"));
+				break;
+			case UUID_TYPE_DCE_TIME_V7:
+				str = xstrdup(_("time-v7"));
+				break;
 			default:
 				str = xstrdup(_("unknown"));
 			}
@@ -222,7 +230,10 @@ static void fill_table_row(struct libscols_table *tb, char const *const uuid)
 				str = xstrdup(_("invalid"));
 				break;
 			}
-			if (variant == UUID_VARIANT_DCE && type == UUID_TYPE_DCE_TIME) {
+			if (variant == UUID_VARIANT_DCE
+			    && (type == UUID_TYPE_DCE_TIME
+				|| type == UUID_TYPE_DCE_TIME_V6
+				|| type == UUID_TYPE_DCE_TIME_V7)) {
 				struct timeval tv;
 				char date_buf[ISO_BUFSIZ];
 
@@ -258,6 +269,14 @@ static void print_output(struct control const *const ctrl, int argc,
 	scols_table_enable_noheadings(tb, ctrl->no_headings);
 	scols_table_enable_raw(tb, ctrl->raw);
 
+	/*
+	 * Don't keep all the lines in memory. The raw and JSON output does not
+	 * depend on the other lines; the columns widths in the human readable
+	 * output are calculated from the first lines only.
+	 */
+	if (ctrl->stream || ctrl->raw || ctrl->json)
+		scols_table_enable_streaming(tb, 1);
+
 	for (i = 0; i < ncolumns; i++) {
 		const struct colinfo *col = get_column_info(i);
 
@@ -291,6 +310,7 @@ int main(int argc, char **argv)
 		{"noheadings", no_argument,       NULL, 'n'},
 		{"output",     required_argument, NULL, 'o'},
 		{"raw",        no_argument,       NULL, 'r'},
+		{"stream",     no_argument,       NULL, 's'},
 		{"version",    no_argument,       NULL, 'V'},
 		{"help",       no_argument,       NULL, 'h'},
 		{NULL, 0, NULL, 0}
@@ -306,7 +326,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "Jno:rVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "Jno:rsVh", longopts, NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
 		case 'J':
@@ -321,6 +341,9 @@ int main(int argc, char **argv)
 		case 'r':
 			ctrl.raw = 1;
 			break;
+		case 's':
+			ctrl.stream = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -86,6 +86,29 @@ enum {
 	ALL_DIRS = BIN_DIR | MAN_DIR | SRC_DIR
 };
 
+/*
+ * The directory entries hashed by the names which may match in
+ * filename_equal(): the whole name, and for man and source directories also
+ * the name up to every '.' (e.g. "ls.1.gz" is hashed as "ls.1.gz", "ls" and
+ * "ls.1"), optionally without the "s." prefix in source directories.
+ */
+struct wh_dirkey {
+	const char	*key;		/* in names[idx] */
+	size_t		keysz;
+	size_t		idx;		/* index to names[] */
+	struct wh_dirkey *next;		/* the next in the bucket */
+};
+
+struct wh_dirindex {
+	char		**names;	/* in readdir() order */
+	size_t		nnames;
+
+	struct wh_dirkey *keys;
+	size_t		nkeys;
+	struct wh_dirkey **buckets;
+	size_t		nbuckets;	/* power of 2 */
+};
+
 /* directories */
 struct wh_dirlist {
 	int	type;
@@ -93,6 +116,7 @@ struct wh_dirlist {
 	ino_t	st_ino;
 	char	*path;
 
+	struct wh_dirindex *index;	/* read on the first lookup */
 	struct wh_dirlist *next;
 };
 
@@ -365,6 +389,20 @@ static void construct_dirlist(struct wh_dirlist **ls,
 	}
 }
 
+static void free_dirindex(struct wh_dirindex *di)
+{
+	size_t i;
+
+	if (!di)
+		return;
+	for (i = 0; i < di->nnames; i++)
+		free(di->names[i]);
+	free(di->names);
+	free(di->keys);
+	free(di->buckets);
+	free(di);
+}
+
 static void free_dirlist(struct wh_dirlist **ls0, int type)
 {
 	struct wh_dirlist *prev = NULL, *next, *ls = *ls0;
@@ -377,6 +415,7 @@ static void free_dirlist(struct wh_dirlist **ls0, int type)
 		if (ls->type & type) {
 			next = ls->next;
 			DBG(LIST, ul_debugobj(*ls0, " free: %s", ls->path));
+			free_dirindex(ls->index);
 			free(ls->path);
 			free(ls);
 			ls = next;
@@ -427,34 +466,144 @@ static int filename_equal(const char *cp, const char *dp, int type)
 	return 0;
 }
 
-static void findin(const char *dir, const char *pattern, int *count,
-		   char **wait, int type)
+/* FNV-1a */
+static size_t dirkey_hash(const char *key, size_t sz)
 {
-	DIR *dirp;
+	uint32_t h = 2166136261U;
+
+	while (sz--) {
+		h ^= (unsigned char) *key++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void dirindex_add_key(struct wh_dirindex *di, size_t idx,
+			     const char *key, size_t keysz)
+{
+	struct wh_dirkey *k = &di->keys[di->nkeys++];
+
+	k->key = key;
+	k->keysz = keysz;
+	k->idx = idx;
+}
+
+static void dirindex_add_keys(struct wh_dirindex *di, size_t idx, int type)
+{
+	const char *name = di->names[idx], *p;
+
+	for (;;) {
+		dirindex_add_key(di, idx, name, strlen(name));
+
+		if (!(type & BIN_DIR)) {
+			for (p = strchr(name, '.'); p; p = strchr(p + 1, '.'))
+				dirindex_add_key(di, idx, name, p - name);
+		}
+		if (!(type & SRC_DIR) || name[0] != 's' || name[1] != '.')
+			break;
+		name += 2;	/* see filename_equal() */
+	}
+}
+
+static size_t dirindex_count_keys(const char *name, int type)
+{
+	size_t n = 0;
+
+	for (;;) {
+		n++;
+		if (!(type & BIN_DIR)) {
+			const char *p;
+
+			for (p = strchr(name, '.'); p; p = strchr(p + 1, '.'))
+				n++;
+		}
+		if (!(type & SRC_DIR) || name[0] != 's' || name[1] != '.')
+			break;
+		name += 2;
+	}
+	return n;
+}
+
+static struct wh_dirindex *read_dirindex(const char *dir, int type)
+{
+	struct wh_dirindex *di;
+	size_t i, nalloc = 0, nkeys = 0;
 	struct dirent *dp;
+	DIR *dirp;
 
 	dirp = opendir(dir);
 	if (dirp == NULL)
+		return NULL;
+
+	DBG(SEARCH, ul_debug("reading '%s'", dir));
+
+	di = xcalloc(1, sizeof(*di));
+	while ((dp = readdir(dirp)) != NULL) {
+		if (di->nnames == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			di->names = xrealloc(di->names, nalloc * sizeof(char *));
+		}
+		di->names[di->nnames++] = xstrdup(dp->d_name);
+		nkeys += dirindex_count_keys(dp->d_name, type);
+	}
+	closedir(dirp);
+
+	di->keys = xmalloc(max(nkeys, (size_t) 1) * sizeof(struct wh_dirkey));
+	for (i = 0; i < di->nnames; i++)
+		dirindex_add_keys(di, i, type);
+
+	for (di->nbuckets = 16; di->nbuckets < di->nkeys; di->nbuckets <<= 1);
+	di->buckets = xcalloc(di->nbuckets, sizeof(struct wh_dirkey *));
+
+	/* add in the reverse order, so the buckets are in readdir() order */
+	for (i = di->nkeys; i > 0; i--) {
+		struct wh_dirkey *k = &di->keys[i - 1];
+		size_t b = dirkey_hash(k->key, k->keysz) & (di->nbuckets - 1);
+
+		k->next = di->buckets[b];
+		di->buckets[b] = k;
+	}
+
+	DBG(SEARCH, ul_debug(" %zu names, %zu keys", di->nnames, di->nkeys));
+	return di;
+}
+
+static void findin(struct wh_dirlist *ls, const char *pattern, int *count,
+		   char **wait)
+{
+	const char *dir = ls->path;
+	struct wh_dirkey *k;
+	size_t sz = strlen(pattern), last = SIZE_MAX;
+
+	if (!ls->index)
+		ls->index = read_dirindex(dir, ls->type);
+	if (!ls->index)
 		return;
 
 	DBG(SEARCH, ul_debug("find '%s' in '%s'", pattern, dir));
 
-	while ((dp = readdir(dirp)) != NULL) {
-		if (!filename_equal(pattern, dp->d_name, type))
+	k = ls->index->buckets[dirkey_hash(pattern, sz) & (ls->index->nbuckets - 1)];
+	for (; k; k = k->next) {
+		const char *name = ls->index->names[k->idx];
+
+		/* the keys of the same name follow each other */
+		if (k->idx == last || k->keysz != sz || memcmp(k->key, pattern, sz))
+			continue;
+		if (!filename_equal(pattern, name, ls->type))
 			continue;
+		last = k->idx;
 
 		if (uflag && *count == 0)
-			xasprintf(wait, "%s/%s", dir, dp->d_name);
+			xasprintf(wait, "%s/%s", dir, name);
 
 		else if (uflag && *count == 1 && *wait) {
-			printf("%s: %s %s/%s", pattern, *wait, dir,  dp->d_name);
+			printf("%s: %s %s/%s", pattern, *wait, dir, name);
 			free(*wait);
 			*wait = NULL;
 		} else
-			printf(" %s/%s", dir, dp->d_name);
+			printf(" %s/%s", dir, name);
 		++(*count);
 	}
-	closedir(dirp);
 }
 
 static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
@@ -480,7 +629,7 @@ static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
 
 	for (; ls; ls = ls->next) {
 		if ((ls->type & want) && ls->path)
-			findin(ls->path, patbuf, &count, &wait, ls->type);
+			findin(ls, patbuf, &count, &wait);
 	}
 
 	free(wait);
@@ -30,6 +30,9 @@
 #include <string.h>
 #include <limits.h>
 #include <libgen.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include <blkid.h>
 #include <libsmartcols.h>
@@ -61,6 +64,14 @@ struct wipe_desc {
 
 };
 
+/* --parallel device */
+struct wipe_device {
+	char		*devname;
+	struct wipe_desc *wipes;		/* detected or erased signatures */
+
+	unsigned int	reread : 1;		/* postponed BLKRRPART */
+};
+
 struct wipe_control {
 	char		*devname;
 	const char	*type_pattern;		/* -t <pattern> */
@@ -74,6 +85,9 @@ struct wipe_control {
 	char		**reread;		/* devices to BLKRRPART */
 	size_t		nrereads;		/* size of reread */
 
+	struct wipe_device *dev;		/* --parallel current device */
+	size_t		nthreads;		/* --parallel */
+
 	unsigned int	noact : 1,
 			all : 1,
 			quiet : 1,
@@ -474,8 +488,8 @@ static void do_wipe_real(struct wipe_control *ctl, blkid_probe pr,
 		err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
 		     ctl->devname, w->type, (intmax_t)w->offset);
 
-	if (ctl->quiet)
-		return;
+	if (ctl->quiet || ctl->dev)
+		return;		/* --parallel prints summary */
 
 	printf(P_("%s: %zd byte was erased at offset 0x%08jx (%s): ",
 		  "%s: %zd bytes were erased at offset 0x%08jx (%s): ",
@@ -591,6 +605,16 @@ static int do_wipe(struct wipe_control *ctl)
 		if (wp->is_parttable)
 			reread = 1;
 		wiped = 1;
+
+		if (ctl->dev) {
+			/* keep it for the summary */
+			struct wipe_desc **last = &ctl->dev->wipes;
+
+			while (*last)
+				last = &(*last)->next;
+			*last = wp;
+			continue;
+		}
 	done:
 		if (!wiped && len) {
 			/* if the offset has not been wiped (probably because
@@ -621,7 +645,9 @@ static int do_wipe(struct wipe_control *ctl)
 
 #ifdef BLKRRPART
 	if (reread && (mode & O_EXCL)) {
-		if (ctl->ndevs > 1) {
+		if (ctl->dev)
+			ctl->dev->reread = 1;	/* when all devices are erased */
+		else if (ctl->ndevs > 1) {
 			/*
 			 * We're going to probe more device, let's postpone
 			 * re-read PT ioctl until all is erased to avoid
@@ -645,6 +671,151 @@ static int do_wipe(struct wipe_control *ctl)
 	return 0;
 }
 
+static void reread_device(struct wipe_control *ctl)
+{
+#ifdef BLKRRPART
+	int fd = open(ctl->devname, O_RDONLY);
+
+	if (fd >= 0) {
+		rereadpt(fd, ctl->devname);
+		close(fd);
+	}
+#else
+	(void) ctl;
+#endif
+}
+
+/*
+ * --parallel: the devices are probed or erased by threads; every thread
+ * uses its own copy of the control struct.
+ */
+struct wipe_queue {
+	struct wipe_control	*ctl;
+	struct wipe_device	*devs;
+	size_t			ndevs;
+	size_t			next;
+	int			action;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t		lock;		/* protects @next */
+#endif
+};
+
+enum {
+	ACT_PROBE = 0,
+	ACT_WIPE,
+	ACT_REREAD
+};
+
+static void wipe_queue_item(struct wipe_queue *q, struct wipe_device *dev)
+{
+	struct wipe_control ctl = *q->ctl;
+
+	ctl.devname = dev->devname;
+	ctl.dev = dev;
+
+	switch (q->action) {
+	case ACT_PROBE:
+		dev->wipes = read_offsets(&ctl);
+		break;
+	case ACT_WIPE:
+		do_wipe(&ctl);
+		break;
+	case ACT_REREAD:
+		if (dev->reread)
+			reread_device(&ctl);
+		break;
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *wipe_worker(void *data)
+{
+	struct wipe_queue *q = (struct wipe_queue *) data;
+
+	while (1) {
+		size_t idx;
+
+		pthread_mutex_lock(&q->lock);
+		idx = q->next++;
+		pthread_mutex_unlock(&q->lock);
+
+		if (idx >= q->ndevs)
+			break;
+		wipe_queue_item(q, &q->devs[idx]);
+	}
+	return NULL;
+}
+#endif
+
+static void wipe_queue_run(struct wipe_queue *q, int action)
+{
+	size_t i, nrun = 0;
+
+	q->action = action;
+	q->next = 0;
+#ifdef HAVE_LIBPTHREAD
+	{
+		size_t nthreads = min(q->ctl->nthreads, q->ndevs);
+		pthread_t *threads = xcalloc(nthreads, sizeof(pthread_t));
+
+		for (nrun = 0; nthreads > 1 && nrun < nthreads; nrun++) {
+			if (pthread_create(&threads[nrun], NULL, wipe_worker, q) != 0)
+				break;
+		}
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+	}
+#endif
+	if (!nrun) {
+		/* no thread started */
+		for (i = 0; i < q->ndevs; i++)
+			wipe_queue_item(q, &q->devs[i]);
+	}
+}
+
+static void init_columns(struct wipe_control *ctl)
+{
+	if (ctl->parsable) {
+		/* keep it backward compatible */
+		columns[ncolumns++] = COL_OFFSET;
+		columns[ncolumns++] = COL_UUID;
+		columns[ncolumns++] = COL_LABEL;
+		columns[ncolumns++] = COL_TYPE;
+	} else {
+		/* default, may be modified by -O <list> */
+		columns[ncolumns++] = COL_DEVICE;
+		columns[ncolumns++] = COL_OFFSET;
+		columns[ncolumns++] = COL_TYPE;
+		columns[ncolumns++] = COL_UUID;
+		columns[ncolumns++] = COL_LABEL;
+	}
+}
+
+/* Prints signatures found (or erased) by threads in the original order */
+static void wipe_queue_output(struct wipe_queue *q)
+{
+	struct wipe_control *ctl = q->ctl;
+	size_t i;
+
+	for (i = 0; i < q->ndevs; i++) {
+		ctl->devname = q->devs[i].devname;
+		add_to_output(ctl, q->devs[i].wipes);
+	}
+	finalize_output(ctl);
+}
+
+static void wipe_queue_free(struct wipe_queue *q)
+{
+	size_t i;
+
+	for (i = 0; i < q->ndevs; i++)
+		free_wipe(q->devs[i].wipes);
+	free(q->devs);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_destroy(&q->lock);
+#endif
+}
 
 static void __attribute__((__noreturn__))
 usage(void)
@@ -669,6 +840,7 @@ usage(void)
 	puts(_(" -p, --parsable      print out in parsable instead of printable format"));
 	puts(_(" -q, --quiet         suppress output messages"));
 	puts(_(" -t, --types <list>  limit the set of filesystem, RAIDs or partition tables"));
+	puts(_("     --parallel <num> probe or erase <num> devices at once (0 means auto)"));
 	printf(
 	     _("     --lock[=<mode>] use exclusive device lock (%s, %s or %s)\n"), "yes", "no", "nonblock");
 
@@ -689,12 +861,15 @@ usage(void)
 int
 main(int argc, char **argv)
 {
-	struct wipe_control ctl = { .devname = NULL };
+	struct wipe_control ctl = { .devname = NULL, .nthreads = 1 };
+	struct wipe_queue q = { .ctl = &ctl };
 	int c;
 	size_t i;
 	char *outarg = NULL;
+	long nthreads = 1;
 	enum {
 		OPT_LOCK = CHAR_MAX + 1,
+		OPT_PARALLEL
 	};
 	static const struct option longopts[] = {
 	    { "all",       no_argument,       NULL, 'a' },
@@ -711,11 +886,13 @@ main(int argc, char **argv)
 	    { "json",      no_argument,       NULL, 'J'},
 	    { "noheadings",no_argument,       NULL, 'i'},
 	    { "output",    required_argument, NULL, 'O'},
+	    { "parallel",  required_argument, NULL, OPT_PARALLEL },
 	    { NULL,        0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'O','a','o' },
+		{ 'o', OPT_PARALLEL },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -773,6 +950,11 @@ main(int argc, char **argv)
 				ctl.lockmode = optarg;
 			}
 			break;
+		case OPT_PARALLEL:
+			nthreads = strtou32_or_err(optarg, _("invalid number of threads argument"));
+			if (nthreads == 0)
+				nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -791,24 +973,27 @@ main(int argc, char **argv)
 	if (ctl.backup && !(ctl.all || ctl.offsets))
 		warnx(_("The --backup option is meaningless in this context"));
 
+#ifdef HAVE_LIBPTHREAD
+	ctl.nthreads = nthreads > 0 ? (size_t) nthreads : 1;
+#else
+	(void) nthreads;
+#endif
+	if (ctl.nthreads > 1 && argc - optind > 1) {
+		q.ndevs = argc - optind;
+		q.devs = xcalloc(q.ndevs, sizeof(struct wipe_device));
+		for (i = 0; i < q.ndevs; i++)
+			q.devs[i].devname = argv[optind + i];
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_init(&q.lock, NULL);
+#endif
+		blkid_init_debug(0);
+	}
+
 	if (!ctl.all && !ctl.offsets) {
 		/*
 		 * Print only
 		 */
-		if (ctl.parsable) {
-			/* keep it backward compatible */
-			columns[ncolumns++] = COL_OFFSET;
-			columns[ncolumns++] = COL_UUID;
-			columns[ncolumns++] = COL_LABEL;
-			columns[ncolumns++] = COL_TYPE;
-		} else {
-			/* default, may be modified by -O <list> */
-			columns[ncolumns++] = COL_DEVICE;
-			columns[ncolumns++] = COL_OFFSET;
-			columns[ncolumns++] = COL_TYPE;
-			columns[ncolumns++] = COL_UUID;
-			columns[ncolumns++] = COL_LABEL;
-		}
+		init_columns(&ctl);
 
 		if (outarg
 		    && string_add_to_idarray(outarg, columns, ARRAY_SIZE(columns),
@@ -817,6 +1002,13 @@ main(int argc, char **argv)
 
 		init_output(&ctl);
 
+		if (q.devs) {
+			wipe_queue_run(&q, ACT_PROBE);
+			wipe_queue_output(&q);
+			wipe_queue_free(&q);
+			return EXIT_SUCCESS;
+		}
+
 		while (optind < argc) {
 			struct wipe_desc *wp;
 
@@ -833,6 +1025,19 @@ main(int argc, char **argv)
 		 */
 		ctl.ndevs = argc - optind;
 
+		if (q.devs) {
+			/* all is erased before BLKRRPART, see do_wipe() */
+			wipe_queue_run(&q, ACT_WIPE);
+			wipe_queue_run(&q, ACT_REREAD);
+			if (!ctl.quiet) {
+				init_columns(&ctl);
+				init_output(&ctl);
+				wipe_queue_output(&q);
+			}
+			wipe_queue_free(&q);
+			return EXIT_SUCCESS;
+		}
+
 		while (optind < argc) {
 			ctl.devname = argv[optind++];
 			do_wipe(&ctl);
@@ -844,13 +1049,8 @@ main(int argc, char **argv)
 		 * postponed until all is done to avoid conflicts.
 		 */
 		for (i = 0; i < ctl.nrereads; i++) {
-			char *devname = ctl.reread[i];
-			int fd = open(devname, O_RDONLY);
-
-			if (fd >= 0) {
-				rereadpt(fd, devname);
-				close(fd);
-			}
+			ctl.devname = ctl.reread[i];
+			reread_device(&ctl);
 		}
 		free(ctl.reread);
 #endif
@@ -34,7 +34,9 @@
 #include "closestream.h"
 #include "strutils.h"
 #include "procutils.h"
+#include "optutils.h"
 #include "sched_attr.h"
+#include "sched_pidlist.h"
 
 
 /* control struct */
@@ -47,6 +49,8 @@ struct chrt_ctl {
 	uint64_t deadline;
 	uint64_t period;
 
+	struct sched_pidlist *pids;		/* --pid-file or --cgroup */
+
 	unsigned int all_tasks : 1,		/* all threads of the PID */
 		     reset_on_fork : 1,		/* SCHED_RESET_ON_FORK or SCHED_FLAG_RESET_ON_FORK */
 		     altered : 1,		/* sched_set**() used */
@@ -61,10 +65,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Set policy:\n"
 	" chrt [options] <priority> <command> [<arg>...]\n"
-	" chrt [options] --pid <priority> <pid>\n"), out);
+	" chrt [options] --pid <priority> <pid>\n"
+	" chrt [options] --pid-file <file> | --cgroup <path> <priority>\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Get policy:\n"
-	" chrt [options] -p <pid>\n"), out);
+	" chrt [options] -p <pid>\n"
+	" chrt [options] --pid-file <file> | --cgroup <path>\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Policy options:\n"), out);
@@ -87,6 +93,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -a, --all-tasks      operate on all the tasks (threads) for a given pid\n"), out);
 	fputs(_(" -m, --max            show min and max valid priorities\n"), out);
 	fputs(_(" -p, --pid            operate on existing given pid\n"), out);
+	fputs(_("     --pid-file <file>\n"
+		"                      operate on PIDs listed in file (\"-\" for stdin)\n"), out);
+	fputs(_("     --cgroup <path>  operate on all processes in the cgroup\n"), out);
 	fputs(_(" -v, --verbose        display status information\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -150,6 +159,8 @@ static void show_sched_pid_info(struct chrt_ctl *ctl, pid_t pid)
 		if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0) {
 			if (errno == ENOSYS)
 				goto fallback;
+			if (errno == ESRCH && ctl->pids)
+				return;
 			err(EXIT_FAILURE, _("failed to get pid %d's policy"), pid);
 		}
 
@@ -171,6 +182,8 @@ fallback:
 		struct sched_param sp;
 
 		policy = sched_getscheduler(pid);
+		if (policy == -1 && errno == ESRCH && ctl->pids)
+			return;
 		if (policy == -1)
 			err(EXIT_FAILURE, _("failed to get pid %d's policy"), pid);
 
@@ -213,7 +226,12 @@ fallback:
 
 static void show_sched_info(struct chrt_ctl *ctl)
 {
-	if (ctl->all_tasks) {
+	if (ctl->pids) {
+		size_t i;
+
+		for (i = 0; i < ctl->pids->npids; i++)
+			show_sched_pid_info(ctl, ctl->pids->pids[i]);
+	} else if (ctl->all_tasks) {
 #ifdef __linux__
 		pid_t tid;
 		struct proc_tasks *ts = proc_open_tasks(ctl->pid);
@@ -321,9 +339,16 @@ static int set_sched_one(struct chrt_ctl *ctl, pid_t pid)
 }
 #endif /* HAVE_SCHED_SETATTR */
 
+static int set_sched_pidlist_one(pid_t pid, void *data)
+{
+	return set_sched_one((struct chrt_ctl *) data, pid);
+}
+
 static void set_sched(struct chrt_ctl *ctl)
 {
-	if (ctl->all_tasks) {
+	if (ctl->pids)
+		sched_pidlist_apply(ctl->pids, set_sched_pidlist_one, ctl);
+	else if (ctl->all_tasks) {
 #ifdef __linux__
 		pid_t tid;
 		struct proc_tasks *ts = proc_open_tasks(ctl->pid);
@@ -348,8 +373,13 @@ static void set_sched(struct chrt_ctl *ctl)
 int main(int argc, char **argv)
 {
 	struct chrt_ctl _ctl = { .pid = -1, .policy = SCHED_RR }, *ctl = &_ctl;
-	int c;
+	const char *pidfile = NULL, *cgroup = NULL;
+	int c, rc = EXIT_SUCCESS;
 
+	enum {
+		OPT_PIDFILE = CHAR_MAX + 1,
+		OPT_CGROUP
+	};
 	static const struct option longopts[] = {
 		{ "all-tasks",  no_argument, NULL, 'a' },
 		{ "batch",	no_argument, NULL, 'b' },
@@ -357,6 +387,8 @@ int main(int argc, char **argv)
 		{ "fifo",	no_argument, NULL, 'f' },
 		{ "idle",	no_argument, NULL, 'i' },
 		{ "pid",	no_argument, NULL, 'p' },
+		{ "pid-file",	required_argument, NULL, OPT_PIDFILE },
+		{ "cgroup",	required_argument, NULL, OPT_CGROUP },
 		{ "help",	no_argument, NULL, 'h' },
 		{ "max",        no_argument, NULL, 'm' },
 		{ "other",	no_argument, NULL, 'o' },
@@ -369,6 +401,11 @@ int main(int argc, char **argv)
 		{ "version",	no_argument, NULL, 'V' },
 		{ NULL,		no_argument, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'p', OPT_PIDFILE, OPT_CGROUP },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -377,6 +414,8 @@ int main(int argc, char **argv)
 
 	while((c = getopt_long(argc, argv, "+abdD:fiphmoP:T:rRvV", longopts, NULL)) != -1)
 	{
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			ctl->all_tasks = 1;
@@ -413,6 +452,12 @@ int main(int argc, char **argv)
 			errno = 0;
 			ctl->pid = strtos32_or_err(argv[argc - 1], _("invalid PID argument"));
 			break;
+		case OPT_PIDFILE:
+			pidfile = optarg;
+			break;
+		case OPT_CGROUP:
+			cgroup = optarg;
+			break;
 		case 'r':
 			ctl->policy = SCHED_RR;
 			break;
@@ -438,16 +483,33 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (((ctl->pid > -1) && argc - optind < 1) ||
-	    ((ctl->pid == -1) && argc - optind < 2)) {
-		warnx(_("bad usage"));
-		errtryhelp(EXIT_FAILURE);
-}
+	if (pidfile || cgroup) {
+		/*
+		 * chrt --pid-file|--cgroup [<priority>]
+		 */
+		if (argc - optind > 1) {
+			warnx(_("bad usage"));
+			errtryhelp(EXIT_FAILURE);
+		}
+		ctl->pids = sched_pidlist_new(pidfile, cgroup, ctl->all_tasks);
 
-	if ((ctl->pid > -1) && (ctl->verbose || argc - optind == 1)) {
-		show_sched_info(ctl);
-		if (argc - optind == 1)
-			return EXIT_SUCCESS;
+		if (ctl->verbose || argc == optind) {
+			show_sched_info(ctl);
+			if (argc == optind)
+				goto done;
+		}
+	} else {
+		if (((ctl->pid > -1) && argc - optind < 1) ||
+		    ((ctl->pid == -1) && argc - optind < 2)) {
+			warnx(_("bad usage"));
+			errtryhelp(EXIT_FAILURE);
+		}
+
+		if ((ctl->pid > -1) && (ctl->verbose || argc - optind == 1)) {
+			show_sched_info(ctl);
+			if (argc - optind == 1)
+				return EXIT_SUCCESS;
+		}
 	}
 
 	errno = 0;
@@ -472,7 +534,7 @@ int main(int argc, char **argv)
 	if (ctl->runtime || ctl->deadline || ctl->period)
 		errx(EXIT_FAILURE, _("SCHED_DEADLINE is unsupported"));
 #endif
-	if (ctl->pid == -1)
+	if (ctl->pid == -1 && !ctl->pids)
 		ctl->pid = 0;
 	if (ctl->priority < sched_get_priority_min(ctl->policy) ||
 	    sched_get_priority_max(ctl->policy) < ctl->priority)
@@ -489,6 +551,12 @@ int main(int argc, char **argv)
 		execvp(argv[0], argv);
 		errexec(argv[0]);
 	}
-
-	return EXIT_SUCCESS;
+done:
+	if (ctl->pids) {
+		if (ctl->altered)
+			rc = sched_pidlist_report(ctl->pids,
+					_("failed to set policy"), ctl->verbose);
+		sched_pidlist_free(ctl->pids);
+	}
+	return rc;
 }
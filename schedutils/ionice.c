@@ -18,6 +18,7 @@
 #include "strutils.h"
 #include "c.h"
 #include "closestream.h"
+#include "sched_pidlist.h"
 
 static int tolerant;
 
@@ -68,10 +69,12 @@ static int parse_ioclass(const char *str)
 	return -1;
 }
 
-static void ioprio_print(int pid, int who)
+static void ioprio_print(int pid, int who, int ignore_exited)
 {
 	int ioprio = ioprio_get(who, pid);
 
+	if (ioprio == -1 && errno == ESRCH && ignore_exited)
+		return;
 	if (ioprio == -1)
 		err(EXIT_FAILURE, _("ioprio_get failed"));
 	else {
@@ -89,6 +92,19 @@ static void ioprio_print(int pid, int who)
 	}
 }
 
+struct ioprio_pidlist_data {
+	int ioclass;
+	int data;
+};
+
+static int ioprio_pidlist_set(pid_t pid, void *data)
+{
+	struct ioprio_pidlist_data *d = data;
+
+	return ioprio_set(IOPRIO_WHO_PROCESS, pid,
+			  IOPRIO_PRIO_VALUE(d->ioclass, d->data));
+}
+
 static void ioprio_setid(int which, int ioclass, int data, int who)
 {
 	int rc = ioprio_set(who, which,
@@ -105,6 +121,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,  _(" %1$s [options] -p <pid>...\n"
 			" %1$s [options] -P <pgid>...\n"
 			" %1$s [options] -u <uid>...\n"
+			" %1$s [options] --pid-file <file> | --cgroup <path>\n"
 			" %1$s [options] <command>\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -119,6 +136,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -P, --pgid <pgrp>...   act on already running processes in these groups\n"), out);
 	fputs(_(" -t, --ignore           ignore failures\n"), out);
 	fputs(_(" -u, --uid <uid>...     act on already running processes owned by these users\n"), out);
+	fputs(_("     --pid-file <file>  act on processes listed in file (\"-\" for stdin)\n"), out);
+	fputs(_("     --cgroup <path>    act on all processes in the cgroup\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(24));
@@ -131,16 +150,22 @@ static void __attribute__((__noreturn__)) usage(void)
 int main(int argc, char **argv)
 {
 	int data = 4, set = 0, ioclass = IOPRIO_CLASS_BE, c;
-	int which = 0, who = 0;
-	const char *invalid_msg = NULL;
+	int which = 0, who = 0, rc = EXIT_SUCCESS;
+	const char *invalid_msg = NULL, *pidfile = NULL, *cgroup = NULL;
 
+	enum {
+		OPT_PIDFILE = CHAR_MAX + 1,
+		OPT_CGROUP
+	};
 	static const struct option longopts[] = {
 		{ "classdata", required_argument, NULL, 'n' },
 		{ "class",     required_argument, NULL, 'c' },
 		{ "help",      no_argument,       NULL, 'h' },
 		{ "ignore",    no_argument,       NULL, 't' },
 		{ "pid",       required_argument, NULL, 'p' },
+		{ "pid-file",  required_argument, NULL, OPT_PIDFILE },
 		{ "pgid",      required_argument, NULL, 'P' },
+		{ "cgroup",    required_argument, NULL, OPT_CGROUP },
 		{ "uid",       required_argument, NULL, 'u' },
 		{ "version",   no_argument,       NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
@@ -171,7 +196,7 @@ int main(int argc, char **argv)
 			set |= 2;
 			break;
 		case 'p':
-			if (who)
+			if (who || pidfile || cgroup)
 				errx(EXIT_FAILURE,
 				     _("can handle only one of pid, pgid or uid at once"));
 			invalid_msg = _("invalid PID argument");
@@ -179,7 +204,7 @@ int main(int argc, char **argv)
 			who = IOPRIO_WHO_PROCESS;
 			break;
 		case 'P':
-			if (who)
+			if (who || pidfile || cgroup)
 				errx(EXIT_FAILURE,
 				     _("can handle only one of pid, pgid or uid at once"));
 			invalid_msg = _("invalid PGID argument");
@@ -187,13 +212,23 @@ int main(int argc, char **argv)
 			who = IOPRIO_WHO_PGRP;
 			break;
 		case 'u':
-			if (who)
+			if (who || pidfile || cgroup)
 				errx(EXIT_FAILURE,
 				     _("can handle only one of pid, pgid or uid at once"));
 			invalid_msg = _("invalid UID argument");
 			which = strtos32_or_err(optarg, invalid_msg);
 			who = IOPRIO_WHO_USER;
 			break;
+		case OPT_PIDFILE:
+		case OPT_CGROUP:
+			if (who || pidfile || cgroup)
+				errx(EXIT_FAILURE,
+				     _("can handle only one of pid, pgid or uid at once"));
+			if (c == OPT_PIDFILE)
+				pidfile = optarg;
+			else
+				cgroup = optarg;
+			break;
 		case 't':
 			tolerant = 1;
 			break;
@@ -226,20 +261,46 @@ int main(int argc, char **argv)
 			break;
 	}
 
-	if (!set && !which && optind == argc)
+	if (pidfile || cgroup) {
+		/*
+		 * ionice [-c CLASS] --pid-file|--cgroup
+		 */
+		struct sched_pidlist *ls = sched_pidlist_new(pidfile, cgroup, 0);
+		size_t i;
+
+		if (optind != argc) {
+			warnx(_("bad usage"));
+			errtryhelp(EXIT_FAILURE);
+		}
+		if (!set) {
+			for (i = 0; i < ls->npids; i++)
+				ioprio_print(ls->pids[i], IOPRIO_WHO_PROCESS, 1);
+		} else {
+			struct ioprio_pidlist_data d = {
+				.ioclass = ioclass,
+				.data = data
+			};
+
+			sched_pidlist_apply(ls, ioprio_pidlist_set, &d);
+			if (!tolerant)
+				rc = sched_pidlist_report(ls,
+						_("ioprio_set failed"), 0);
+		}
+		sched_pidlist_free(ls);
+	} else if (!set && !which && optind == argc)
 		/*
 		 * ionice without options, print the current ioprio
 		 */
-		ioprio_print(0, IOPRIO_WHO_PROCESS);
+		ioprio_print(0, IOPRIO_WHO_PROCESS, 0);
 	else if (!set && who) {
 		/*
 		 * ionice -p|-P|-u ID [ID ...]
 		 */
-		ioprio_print(which, who);
+		ioprio_print(which, who, 0);
 
 		for(; argv[optind]; ++optind) {
 			which = strtos32_or_err(argv[optind], invalid_msg);
-			ioprio_print(which, who);
+			ioprio_print(which, who, 0);
 		}
 	} else if (set && who) {
 		/*
@@ -263,5 +324,5 @@ int main(int argc, char **argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	return EXIT_SUCCESS;
+	return rc;
 }
@@ -0,0 +1,228 @@
+/*
+ * sched_pidlist.c - bulk mode (--pid-file, --cgroup) for the schedutils
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as
+ * published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The list of the processes is read at once, sorted and deduplicated, so
+ * every task gets exactly one "set" syscall. Processes which exit before
+ * they are updated are not failures (it's usual in busy cgroups), all other
+ * failures are counted and reported by one message at the end.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c.h"
+#include "nls.h"
+#include "xalloc.h"
+#include "strutils.h"
+#include "pathnames.h"
+#include "procutils.h"
+#include "sched_pidlist.h"
+
+static void add_pid(struct sched_pidlist *ls, pid_t pid, size_t *alloc)
+{
+	if (ls->npids == *alloc) {
+		*alloc = *alloc ? *alloc * 2 : 256;
+		ls->pids = xrealloc(ls->pids, *alloc * sizeof(pid_t));
+	}
+	ls->pids[ls->npids++] = pid;
+}
+
+/* One PID per line, empty lines and #comments are ignored */
+static void read_pids(struct sched_pidlist *ls, FILE *f,
+		      const char *filename, size_t *alloc)
+{
+	char buf[BUFSIZ];
+	size_t lineno = 0;
+
+	while (fgets(buf, sizeof(buf), f)) {
+		const char *p = skip_space(buf);
+		char *end = NULL;
+		long num;
+
+		lineno++;
+		if (!*p || *p == '#')
+			continue;
+
+		errno = 0;
+		num = strtol(p, &end, 10);
+		if (errno || end == p || num <= 0 || num > INT_MAX)
+			goto bad;
+		p = skip_space(end);
+		if (*p && *p != '#')
+			goto bad;
+
+		add_pid(ls, (pid_t) num, alloc);
+		continue;
+bad:
+		errx(EXIT_FAILURE, _("%s:%zu: invalid PID"), filename, lineno);
+	}
+
+	if (ferror(f))
+		err(EXIT_FAILURE, _("cannot read %s"), filename);
+}
+
+/* Relative cgroup paths are also tried below /sys/fs/cgroup */
+static FILE *open_cgroup_file(const char *cgroup, const char *name, char **path)
+{
+	size_t sz = strlen(cgroup);
+	const char *sep = sz && cgroup[sz - 1] == '/' ? "" : "/";
+	FILE *f;
+
+	xasprintf(path, "%s%s%s", cgroup, sep, name);
+	f = fopen(*path, "r" UL_CLOEXECSTR);
+
+	if (!f && errno == ENOENT && *cgroup != '/') {
+		free(*path);
+		xasprintf(path, _PATH_SYS_CGROUP "/%s%s%s", cgroup, sep, name);
+		f = fopen(*path, "r" UL_CLOEXECSTR);
+	}
+	return f;
+}
+
+static void read_cgroup(struct sched_pidlist *ls, const char *cgroup,
+			int all_tasks, size_t *alloc)
+{
+	char *path = NULL;
+	FILE *f;
+
+	if (all_tasks) {
+		/* cgroup v2 or v1 */
+		f = open_cgroup_file(cgroup, "cgroup.threads", &path);
+		if (!f && errno == ENOENT) {
+			free(path);
+			f = open_cgroup_file(cgroup, "tasks", &path);
+		}
+	} else
+		f = open_cgroup_file(cgroup, "cgroup.procs", &path);
+
+	if (!f)
+		err(EXIT_FAILURE, _("cannot open %s"), path);
+
+	read_pids(ls, f, path, alloc);
+	fclose(f);
+	free(path);
+}
+
+/* Add threads of all processes in the list */
+static void add_tasks(struct sched_pidlist *ls, size_t *alloc)
+{
+	size_t i, nprocs = ls->npids;
+
+	for (i = 0; i < nprocs; i++) {
+		pid_t tid, pid = ls->pids[i];
+		struct proc_tasks *ts = proc_open_tasks(pid);
+
+		/* keep the PID, the failure is counted by sched_pidlist_apply() */
+		if (!ts)
+			continue;
+		while (!proc_next_tid(ts, &tid))
+			if (tid != pid)
+				add_pid(ls, tid, alloc);
+		proc_close_tasks(ts);
+	}
+}
+
+static int cmp_pids(const void *a, const void *b)
+{
+	pid_t x = *(const pid_t *) a, y = *(const pid_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Read the list from @pidfile ("-" for stdin) or from @cgroup directory. For
+ * @all_tasks the list contains all threads of the processes.
+ */
+struct sched_pidlist *sched_pidlist_new(const char *pidfile,
+					const char *cgroup,
+					int all_tasks)
+{
+	struct sched_pidlist *ls = xcalloc(1, sizeof(*ls));
+	size_t i, n, alloc = 0;
+
+	if (cgroup)
+		read_cgroup(ls, cgroup, all_tasks, &alloc);
+	else if (strcmp(pidfile, "-") == 0)
+		read_pids(ls, stdin, _("stdin"), &alloc);
+	else {
+		FILE *f = fopen(pidfile, "r" UL_CLOEXECSTR);
+
+		if (!f)
+			err(EXIT_FAILURE, _("cannot open %s"), pidfile);
+		read_pids(ls, f, pidfile, &alloc);
+		fclose(f);
+
+		if (all_tasks)
+			add_tasks(ls, &alloc);
+	}
+
+	if (ls->npids > 1) {
+		qsort(ls->pids, ls->npids, sizeof(pid_t), cmp_pids);
+
+		for (i = 1, n = 1; i < ls->npids; i++)
+			if (ls->pids[i] != ls->pids[n - 1])
+				ls->pids[n++] = ls->pids[i];
+		ls->npids = n;
+	}
+	return ls;
+}
+
+void sched_pidlist_free(struct sched_pidlist *ls)
+{
+	if (!ls)
+		return;
+	free(ls->pids);
+	free(ls);
+}
+
+/*
+ * Call @set_one() for all processes in the list; it returns -1 and sets errno
+ * on error.
+ */
+void sched_pidlist_apply(struct sched_pidlist *ls,
+			 int (*set_one)(pid_t pid, void *data),
+			 void *data)
+{
+	size_t i;
+
+	for (i = 0; i < ls->npids; i++) {
+		errno = 0;
+		if (set_one(ls->pids[i], data) == 0)
+			continue;
+		if (errno == ESRCH) {
+			ls->nexited++;
+			continue;
+		}
+		if (!ls->nfailed++) {
+			ls->failed_pid = ls->pids[i];
+			ls->failed_errno = errno;
+		}
+	}
+}
+
+/* Returns exit code */
+int sched_pidlist_report(struct sched_pidlist *ls, const char *errmsg, int verbose)
+{
+	if (verbose)
+		printf(_("%zu of %zu processes updated, %zu failed, %zu exited\n"),
+				ls->npids - ls->nfailed - ls->nexited, ls->npids,
+				ls->nfailed, ls->nexited);
+	if (!ls->nfailed)
+		return EXIT_SUCCESS;
+
+	errno = ls->failed_errno;
+	warn(_("%s for %zu of %zu processes (first pid %d)"),
+			errmsg, ls->nfailed, ls->npids, ls->failed_pid);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,41 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as
+ * published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef UTIL_LINUX_SCHED_PIDLIST_H
+#define UTIL_LINUX_SCHED_PIDLIST_H
+
+#include <sys/types.h>
+
+/*
+ * List of processes for the --pid-file and --cgroup bulk mode of chrt,
+ * ionice and uclampset.
+ */
+struct sched_pidlist {
+	pid_t	*pids;		/* sorted, without duplicates */
+	size_t	npids;
+
+	size_t	nfailed;	/* set_one() failed */
+	size_t	nexited;	/* process has gone in the meantime (ESRCH) */
+	pid_t	failed_pid;	/* the first failed process */
+	int	failed_errno;	/* and its errno */
+};
+
+extern struct sched_pidlist *sched_pidlist_new(const char *pidfile,
+					       const char *cgroup,
+					       int all_tasks);
+extern void sched_pidlist_free(struct sched_pidlist *ls);
+
+extern void sched_pidlist_apply(struct sched_pidlist *ls,
+				int (*set_one)(pid_t pid, void *data),
+				void *data);
+extern int sched_pidlist_report(struct sched_pidlist *ls,
+				const char *errmsg, int verbose);
+
+#endif /* UTIL_LINUX_SCHED_PIDLIST_H */
@@ -26,6 +26,7 @@
 #include <sched.h>
 #include <stddef.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "cpuset.h"
 #include "nls.h"
@@ -34,6 +35,8 @@
 #include "procutils.h"
 #include "c.h"
 #include "closestream.h"
+#include "optutils.h"
+#include "pathnames.h"
 
 struct taskset {
 	pid_t		pid;		/* task PID */
@@ -41,6 +44,11 @@ struct taskset {
 	size_t		setsize;
 	char		*buf;		/* buffer for conversion from mask to string */
 	size_t		buflen;
+
+	size_t		nchanged;	/* bulk mode: tasks updated */
+	size_t		ngone;		/* bulk mode: tasks exited meanwhile */
+	size_t		nfailed;	/* bulk mode: errors */
+
 	unsigned int	use_list:1,	/* use list rather than masks */
 			get_only:1;	/* print the mask, but not modify */
 };
@@ -61,6 +69,8 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -a, --all-tasks         operate on all the tasks (threads) for a given pid\n"
 		" -p, --pid               operate on existing given pid\n"
 		" -c, --cpu-list          display and specify cpus in list format\n"
+		" -F, --pids-from <file>  operate on PIDs read from file ('-' for stdin)\n"
+		" -g, --cgroup <path>     operate on all processes in a cgroup\n"
 		));
 	printf(USAGE_HELP_OPTIONS(25));
 
@@ -136,12 +146,125 @@ static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 	}
 }
 
+/*
+ * Bulk mode: apply the already parsed mask to @pid, no per-task re-read
+ * and report, only counters for the final summary.
+ */
+static void bulk_task(struct taskset *ts, pid_t pid, size_t setsize, cpu_set_t *set)
+{
+	int rc;
+
+	ts->pid = pid;
+
+	if (ts->get_only) {
+		rc = sched_getaffinity(pid, ts->setsize, ts->set);
+		if (rc == 0)
+			print_affinity(ts, FALSE);
+	} else
+		rc = sched_setaffinity(pid, setsize, set);
+
+	if (rc == 0)
+		ts->nchanged++;
+	else if (errno == ESRCH)
+		ts->ngone++;		/* exited since the list was read */
+	else {
+		warn(ts->get_only ? _("failed to get pid %d's affinity") :
+				    _("failed to set pid %d's affinity"), pid);
+		ts->nfailed++;
+	}
+}
+
+static void bulk_pid(struct taskset *ts, pid_t pid, int all_tasks,
+		     size_t setsize, cpu_set_t *set)
+{
+	struct proc_tasks *tasks;
+	pid_t tid;
+
+	if (!all_tasks) {
+		bulk_task(ts, pid, setsize, set);
+		return;
+	}
+
+	tasks = proc_open_tasks(pid);
+	if (!tasks) {
+		ts->ngone++;
+		return;
+	}
+	while (!proc_next_tid(tasks, &tid))
+		bulk_task(ts, tid, setsize, set);
+	proc_close_tasks(tasks);
+}
+
+/*
+ * Reads whitespace separated PIDs from @f; empty lines and '#' comments are
+ * ignored. If @all_tasks is set, all threads of the PIDs are affected.
+ */
+static void bulk_taskset(struct taskset *ts, FILE *f, const char *name,
+			 int all_tasks, size_t setsize, cpu_set_t *set)
+{
+	char *line = NULL;
+	size_t sz = 0, lineno = 0;
+
+	while (getline(&line, &sz, f) != -1) {
+		char *p = line;
+
+		lineno++;
+		while (*p) {
+			char *end = NULL;
+			long num;
+
+			while (isspace((unsigned char) *p))
+				p++;
+			if (!*p || *p == '#')
+				break;
+
+			errno = 0;
+			num = strtol(p, &end, 10);
+			if (errno || end == p || num <= 0 || num > INT32_MAX
+			    || (*end && !isspace((unsigned char) *end))) {
+				warnx(_("%s: %zu: invalid PID"), name, lineno);
+				ts->nfailed++;
+				break;
+			}
+			bulk_pid(ts, (pid_t) num, all_tasks, setsize, set);
+			p = end;
+		}
+	}
+	free(line);
+
+	if (ferror(f))
+		err(EXIT_FAILURE, _("read failed: %s"), name);
+}
+
+static FILE *open_cgroup_tasks(const char *cgroup, int all_tasks, char **name)
+{
+	FILE *f = NULL;
+
+	/* cgroup v2 lists threads in cgroup.threads, v1 in tasks */
+	if (all_tasks) {
+		xasprintf(name, "%s/cgroup.threads", cgroup);
+		f = fopen(*name, "r" UL_CLOEXECSTR);
+		if (!f && errno == ENOENT) {
+			free(*name);
+			xasprintf(name, "%s/tasks", cgroup);
+			f = fopen(*name, "r" UL_CLOEXECSTR);
+		}
+	} else {
+		xasprintf(name, "%s/cgroup.procs", cgroup);
+		f = fopen(*name, "r" UL_CLOEXECSTR);
+	}
+	if (!f)
+		err(EXIT_FAILURE, _("cannot open %s"), *name);
+	return f;
+}
+
 int main(int argc, char **argv)
 {
 	cpu_set_t *new_set;
 	pid_t pid = 0;
 	int c, all_tasks = 0;
-	int ncpus;
+	int ncpus, rc = EXIT_SUCCESS;
+	const char *pids_from = NULL, *cgroup = NULL;
 	size_t new_setsize, nbits;
 	struct taskset ts;
 
@@ -149,10 +272,17 @@ int main(int argc, char **argv)
 		{ "all-tasks",	0, NULL, 'a' },
 		{ "pid",	0, NULL, 'p' },
 		{ "cpu-list",	0, NULL, 'c' },
+		{ "pids-from",	1, NULL, 'F' },
+		{ "cgroup",	1, NULL, 'g' },
 		{ "help",	0, NULL, 'h' },
 		{ "version",	0, NULL, 'V' },
 		{ NULL,		0, NULL,  0  }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'F', 'g', 'p' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -161,7 +291,10 @@ int main(int argc, char **argv)
 
 	memset(&ts, 0, sizeof(ts));
 
-	while ((c = getopt_long(argc, argv, "+apchV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "+acF:g:phV", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			all_tasks = 1;
@@ -173,6 +306,12 @@ int main(int argc, char **argv)
 		case 'c':
 			ts.use_list = 1;
 			break;
+		case 'F':
+			pids_from = optarg;
+			break;
+		case 'g':
+			cgroup = optarg;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -183,7 +322,12 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if ((!pid && argc - optind < 2)
+	if (pids_from || cgroup) {
+		if (argc - optind > 1) {
+			warnx(_("bad usage"));
+			errtryhelp(EXIT_FAILURE);
+		}
+	} else if ((!pid && argc - optind < 2)
 	    || (pid && (argc - optind < 1 || argc - optind > 2))) {
 		warnx(_("bad usage"));
 		errtryhelp(EXIT_FAILURE);
@@ -215,19 +359,56 @@ int main(int argc, char **argv)
 	if (!new_set)
 		err(EXIT_FAILURE, _("cpuset_alloc failed"));
 
-	if (argc - optind == 1)
-		ts.get_only = 1;
+	if (pids_from || cgroup)
+		ts.get_only = argc == optind;
+	else
+		ts.get_only = argc - optind == 1;
 
-	else if (ts.use_list) {
+	/* the mask is parsed only once, also in bulk mode */
+	if (!ts.get_only && ts.use_list) {
 		if (cpulist_parse(argv[optind], new_set, new_setsize, 0))
 			errx(EXIT_FAILURE, _("failed to parse CPU list: %s"),
 			     argv[optind]);
-	} else if (cpumask_parse(argv[optind], new_set, new_setsize)) {
+	} else if (!ts.get_only
+		   && cpumask_parse(argv[optind], new_set, new_setsize)) {
 		errx(EXIT_FAILURE, _("failed to parse CPU mask: %s"),
 		     argv[optind]);
 	}
 
-	if (all_tasks && pid) {
+	if (pids_from || cgroup) {
+		char *name = NULL;
+		FILE *f;
+
+		if (pids_from && strcmp(pids_from, "-") == 0)
+			f = stdin;
+		else if (pids_from) {
+			f = fopen(pids_from, "r" UL_CLOEXECSTR);
+			if (!f)
+				err(EXIT_FAILURE, _("cannot open %s"), pids_from);
+		} else if (*cgroup == '/')
+			f = open_cgroup_tasks(cgroup, all_tasks, &name);
+		else {
+			char *path;
+
+			xasprintf(&path, _PATH_SYS_CGROUP "/%s", cgroup);
+			f = open_cgroup_tasks(path, all_tasks, &name);
+			free(path);
+		}
+
+		/* cgroup.threads and tasks already list all the threads */
+		bulk_taskset(&ts, f, name ? name : pids_from,
+			     all_tasks && !name, new_setsize, new_set);
+		if (f != stdin)
+			fclose(f);
+		free(name);
+
+		if (!ts.get_only)
+			printf(_("affinity set for %zu tasks, %zu exited, %zu failed\n"),
+			       ts.nchanged, ts.ngone, ts.nfailed);
+		if (ts.nfailed)
+			rc = EXIT_FAILURE;
+
+	} else if (all_tasks && pid) {
 		struct proc_tasks *tasks = proc_open_tasks(pid);
 		while (!proc_next_tid(tasks, &ts.pid))
 			do_taskset(&ts, new_setsize, new_set);
@@ -241,11 +422,11 @@ int main(int argc, char **argv)
 	cpuset_free(ts.set);
 	cpuset_free(new_set);
 
-	if (!pid) {
+	if (!pid && !pids_from && !cgroup) {
 		argv += optind + 1;
 		execvp(argv[0], argv);
 		errexec(argv[0]);
 	}
 
-	return EXIT_SUCCESS;
+	return rc;
 }
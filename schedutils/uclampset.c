@@ -25,10 +25,12 @@
 #include <stdlib.h>
 
 #include "closestream.h"
+#include "optutils.h"
 #include "path.h"
 #include "pathnames.h"
 #include "procutils.h"
 #include "sched_attr.h"
+#include "sched_pidlist.h"
 #include "strutils.h"
 
 #define NOT_SET		-2U
@@ -38,6 +40,7 @@ struct uclampset {
 	unsigned int util_max;
 
 	pid_t pid;
+	struct sched_pidlist *pids;		/* --pid-file or --cgroup */
 	unsigned int	all_tasks:1,		/* all threads of the PID */
 			system:1,
 			util_min_set:1,		/* indicates -m option was passed */
@@ -54,7 +57,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
 		_(" %1$s [options]\n"
-		  " %1$s [options] --pid <pid> | --system | <command> <arg>...\n"),
+		  " %1$s [options] --pid <pid> | --system | <command> <arg>...\n"
+		  " %1$s [options] --pid-file <file> | --cgroup <path>\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -65,6 +69,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -M <value>           util_max value to set\n"), out);
 	fputs(_(" -a, --all-tasks      operate on all the tasks (threads) for a given pid\n"), out);
 	fputs(_(" -p, --pid <pid>      operate on existing given pid\n"), out);
+	fputs(_("     --pid-file <file>\n"
+		"                      operate on PIDs listed in file (\"-\" for stdin)\n"), out);
+	fputs(_("     --cgroup <path>  operate on all processes in the cgroup\n"), out);
 	fputs(_(" -s, --system         operate on system\n"), out);
 	fputs(_(" -R, --reset-on-fork  set reset-on-fork flag\n"), out);
 	fputs(_(" -v, --verbose        display status information\n"), out);
@@ -79,7 +86,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
-static void show_uclamp_pid_info(pid_t pid, char *cmd)
+static void show_uclamp_pid_info(pid_t pid, char *cmd, int tolerant)
 {
 	struct sched_attr sa;
 	char *comm;
@@ -88,8 +95,12 @@ static void show_uclamp_pid_info(pid_t pid, char *cmd)
 	if (!pid)
 		pid = getpid();
 
-	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0)
+	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0) {
+		/* the process has exited in the meantime */
+		if (tolerant && errno == ESRCH)
+			return;
 		err(EXIT_FAILURE, _("failed to get pid %d's uclamp values"), pid);
+	}
 
 	if (cmd)
 		comm = cmd;
@@ -133,6 +144,11 @@ static void show_uclamp_info(struct uclampset *ctl)
 {
 	if (ctl->system) {
 		show_uclamp_system_info();
+	} else if (ctl->pids) {
+		size_t i;
+
+		for (i = 0; i < ctl->pids->npids; i++)
+			show_uclamp_pid_info(ctl->pids->pids[i], NULL, 1);
 	} else if (ctl->all_tasks) {
 		pid_t tid;
 		struct proc_tasks *ts = proc_open_tasks(ctl->pid);
@@ -141,11 +157,11 @@ static void show_uclamp_info(struct uclampset *ctl)
 			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
 
 		while (!proc_next_tid(ts, &tid))
-			show_uclamp_pid_info(tid, NULL);
+			show_uclamp_pid_info(tid, NULL, 0);
 
 		proc_close_tasks(ts);
 	} else {
-		show_uclamp_pid_info(ctl->pid, ctl->cmd);
+		show_uclamp_pid_info(ctl->pid, ctl->cmd, 0);
 	}
 }
 
@@ -153,8 +169,12 @@ static int set_uclamp_one(struct uclampset *ctl, pid_t pid)
 {
 	struct sched_attr sa;
 
-	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0)
+	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0) {
+		/* for --pid-file and --cgroup errors are reported later */
+		if (ctl->pids)
+			return -1;
 		err(EXIT_FAILURE, _("failed to get pid %d's uclamp values"), pid);
+	}
 
 	if (ctl->util_min_set)
 		sa.sched_util_min = ctl->util_min;
@@ -172,9 +192,16 @@ static int set_uclamp_one(struct uclampset *ctl, pid_t pid)
 	return sched_setattr(pid, &sa, 0);
 }
 
+static int set_uclamp_pidlist_one(pid_t pid, void *data)
+{
+	return set_uclamp_one((struct uclampset *) data, pid);
+}
+
 static void set_uclamp_pid(struct uclampset *ctl)
 {
-	if (ctl->all_tasks) {
+	if (ctl->pids)
+		sched_pidlist_apply(ctl->pids, set_uclamp_pidlist_one, ctl);
+	else if (ctl->all_tasks) {
 		pid_t tid;
 		struct proc_tasks *ts = proc_open_tasks(ctl->pid);
 
@@ -226,11 +253,18 @@ int main(int argc, char **argv)
 		.cmd = NULL
 	};
 	struct uclampset *ctl = &_ctl;
-	int c;
+	const char *pidfile = NULL, *cgroup = NULL;
+	int c, rc = EXIT_SUCCESS;
 
+	enum {
+		OPT_PIDFILE = CHAR_MAX + 1,
+		OPT_CGROUP
+	};
 	static const struct option longopts[] = {
 		{ "all-tasks",		no_argument, NULL, 'a' },
 		{ "pid",		required_argument, NULL, 'p' },
+		{ "pid-file",		required_argument, NULL, OPT_PIDFILE },
+		{ "cgroup",		required_argument, NULL, OPT_CGROUP },
 		{ "system",		no_argument, NULL, 's' },
 		{ "reset-on-fork",	no_argument, NULL, 'R' },
 		{ "help",		no_argument, NULL, 'h' },
@@ -238,6 +272,11 @@ int main(int argc, char **argv)
 		{ "version",		no_argument, NULL, 'V' },
 		{ NULL,			no_argument, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'p', 's', OPT_PIDFILE, OPT_CGROUP },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -246,6 +285,8 @@ int main(int argc, char **argv)
 
 	while((c = getopt_long(argc, argv, "+asRp:hm:M:vV", longopts, NULL)) != -1)
 	{
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			ctl->all_tasks = 1;
@@ -254,6 +295,12 @@ int main(int argc, char **argv)
 			errno = 0;
 			ctl->pid = strtos32_or_err(optarg, _("invalid PID argument"));
 			break;
+		case OPT_PIDFILE:
+			pidfile = optarg;
+			break;
+		case OPT_CGROUP:
+			cgroup = optarg;
+			break;
 		case 's':
 			ctl->system = 1;
 			break;
@@ -288,25 +335,29 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	if (pidfile || cgroup)
+		ctl->pids = sched_pidlist_new(pidfile, cgroup, ctl->all_tasks);
+
 	/* all_tasks implies --pid */
-	if (ctl->all_tasks && ctl->pid == -1) {
+	if (ctl->all_tasks && ctl->pid == -1 && !ctl->pids) {
 		errno = EINVAL;
 		err(EXIT_FAILURE, _("missing -p option"));
 	}
 
 	if (!ctl->util_min_set && !ctl->util_max_set) {
 		/* -p or -s must be passed */
-		if (!ctl->system && ctl->pid == -1) {
+		if (!ctl->system && ctl->pid == -1 && !ctl->pids) {
 			usage();
 			exit(EXIT_FAILURE);
 		}
 
 		show_uclamp_info(ctl);
+		sched_pidlist_free(ctl->pids);
 		return EXIT_SUCCESS;
 	}
 
 	/* ensure there's a command to execute if no -s or -p */
-	if (!ctl->system && ctl->pid == -1) {
+	if (!ctl->system && ctl->pid == -1 && !ctl->pids) {
 		if (argc <= optind) {
 			errno = EINVAL;
 			err(EXIT_FAILURE, _("no cmd to execute"));
@@ -332,5 +383,10 @@ int main(int argc, char **argv)
 		errexec(ctl->cmd);
 	}
 
-	return EXIT_SUCCESS;
+	if (ctl->pids) {
+		rc = sched_pidlist_report(ctl->pids,
+				_("failed to set uclamp values"), ctl->verbose);
+		sched_pidlist_free(ctl->pids);
+	}
+	return rc;
 }
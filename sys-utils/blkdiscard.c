@@ -41,12 +41,17 @@
 #ifdef HAVE_LIBBLKID
 # include <blkid.h>
 #endif
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "nls.h"
 #include "strutils.h"
 #include "c.h"
 #include "closestream.h"
 #include "monotonic.h"
+#include "sysfs.h"
+#include "xalloc.h"
 
 #ifndef BLKDISCARD
 # define BLKDISCARD	_IO(0x12,119)
@@ -66,6 +71,86 @@ enum {
 	ACT_SECURE
 };
 
+/* default --step for --queue-depth if not provided by the device */
+#define DISCARD_QUEUE_STEP	(1ULL << 30)
+
+/*
+ * The ranges for --queue-depth; every thread takes the next step-sized range
+ * and calls the ioctl, so the device has more requests in flight.
+ */
+struct discard_queue {
+	int fd;
+	int act;
+	const char *path;
+
+	uint64_t next;		/* begin of the next range */
+	uint64_t end;
+	uint64_t step;
+
+	uint64_t done;		/* bytes for the progress report */
+	uint64_t total;
+	struct timeval last;	/* the last progress report */
+	unsigned int verbose : 1;
+
+	int error;		/* errno of the first failed ioctl */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t lock;
+#endif
+};
+
+static const char *act_ioctl_name(int act)
+{
+	switch (act) {
+	case ACT_ZEROOUT:
+		return "BLKZEROOUT";
+	case ACT_SECURE:
+		return "BLKSECDISCARD";
+	case ACT_DISCARD:
+	default:
+		return "BLKDISCARD";
+	}
+}
+
+static int discard_range(int fd, int act, uint64_t range[2])
+{
+	switch (act) {
+	case ACT_ZEROOUT:
+		return ioctl(fd, BLKZEROOUT, range);
+	case ACT_SECURE:
+		return ioctl(fd, BLKSECDISCARD, range);
+	case ACT_DISCARD:
+	default:
+		return ioctl(fd, BLKDISCARD, range);
+	}
+}
+
+/*
+ * Reads the discard (or write zeroes) limits of the device from sysfs; the
+ * queue attributes are available for the whole-disk only.
+ */
+static void get_discard_limits(dev_t devno, int act,
+			       uint64_t *granularity, uint64_t *max_bytes)
+{
+	struct path_cxt *pc;
+	dev_t disk = 0;
+
+	*granularity = *max_bytes = 0;
+
+	if (sysfs_devno_to_wholedisk(devno, NULL, 0, &disk) != 0 || !disk)
+		return;
+	pc = ul_new_sysfs_path(disk, NULL, NULL);
+	if (!pc)
+		return;
+
+	if (act == ACT_ZEROOUT)
+		ul_path_read_u64(pc, max_bytes, "queue/write_zeroes_max_bytes");
+	else {
+		ul_path_read_u64(pc, granularity, "queue/discard_granularity");
+		ul_path_read_u64(pc, max_bytes, "queue/discard_max_bytes");
+	}
+	ul_unref_path(pc);
+}
+
 static void print_stats(int act, char *path, uint64_t stats[])
 {
 	switch (act) {
@@ -81,6 +166,97 @@ static void print_stats(int act, char *path, uint64_t stats[])
 	}
 }
 
+#ifdef HAVE_LIBPTHREAD
+static void print_progress(struct discard_queue *q)
+{
+	int pc = q->total ? (int) (q->done * 100 / q->total) : 100;
+
+	switch (q->act) {
+	case ACT_ZEROOUT:
+		printf(_("%s: Zero-filled %" PRIu64 " of %" PRIu64 " bytes (%d%%)\n"),
+			q->path, q->done, q->total, pc);
+		break;
+	case ACT_SECURE:
+	case ACT_DISCARD:
+		printf(_("%s: Discarded %" PRIu64 " of %" PRIu64 " bytes (%d%%)\n"),
+			q->path, q->done, q->total, pc);
+		break;
+	}
+	fflush(stdout);
+}
+
+static void *discard_worker(void *data)
+{
+	struct discard_queue *q = data;
+
+	for (;;) {
+		uint64_t range[2];
+		struct timeval now;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->error || q->next >= q->end) {
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+		/* the ranges end on step boundaries */
+		range[0] = q->next;
+		range[1] = min(q->end, (range[0] / q->step + 1) * q->step) - range[0];
+		q->next += range[1];
+		pthread_mutex_unlock(&q->lock);
+
+		if (discard_range(q->fd, q->act, range)) {
+			pthread_mutex_lock(&q->lock);
+			if (!q->error)
+				q->error = errno;
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+
+		pthread_mutex_lock(&q->lock);
+		q->done += range[1];
+		/* reporting progress at most once per second */
+		if (q->verbose) {
+			gettime_monotonic(&now);
+			if (now.tv_sec > q->last.tv_sec &&
+			    (now.tv_usec >= q->last.tv_usec || now.tv_sec > q->last.tv_sec + 1)) {
+				print_progress(q);
+				q->last = now;
+			}
+		}
+		pthread_mutex_unlock(&q->lock);
+	}
+	return NULL;
+}
+
+static int discard_parallel(struct discard_queue *q, unsigned int depth)
+{
+	pthread_t *threads;
+	unsigned int i, nrun;
+
+	pthread_mutex_init(&q->lock, NULL);
+	gettime_monotonic(&q->last);
+
+	threads = xcalloc(depth, sizeof(pthread_t));
+	for (nrun = 0; nrun < depth; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, discard_worker, q) != 0)
+			break;
+	}
+	if (!nrun)
+		discard_worker(q);
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	pthread_mutex_destroy(&q->lock);
+
+	if (q->error) {
+		errno = q->error;
+		return -1;
+	}
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -96,6 +272,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -o, --offset <num>  offset in bytes to discard from\n"), out);
 	fputs(_(" -l, --length <num>  length of bytes to discard from the offset\n"), out);
 	fputs(_(" -p, --step <num>    size of the discard iterations within the offset\n"), out);
+	fputs(_(" -q, --queue-depth <num>\n"
+		"                     number of the discard iterations in flight\n"), out);
 	fputs(_(" -s, --secure        perform secure discard\n"), out);
 	fputs(_(" -z, --zeroout       zero-fill rather than discard\n"), out);
 	fputs(_(" -v, --verbose       print aligned length and offset\n"), out);
@@ -156,6 +334,7 @@ int main(int argc, char **argv)
 	struct stat sb;
 	struct timeval now = { 0 }, last = { 0 };
 	int act = ACT_DISCARD;
+	unsigned int depth = 1;
 
 	static const struct option longopts[] = {
 	    { "help",      no_argument,       NULL, 'h' },
@@ -164,6 +343,7 @@ int main(int argc, char **argv)
 	    { "force",     no_argument,       NULL, 'f' },
 	    { "length",    required_argument, NULL, 'l' },
 	    { "step",      required_argument, NULL, 'p' },
+	    { "queue-depth", required_argument, NULL, 'q' },
 	    { "secure",    no_argument,       NULL, 's' },
 	    { "verbose",   no_argument,       NULL, 'v' },
 	    { "zeroout",   no_argument,       NULL, 'z' },
@@ -179,7 +359,7 @@ int main(int argc, char **argv)
 	range[1] = ULLONG_MAX;
 	step = 0;
 
-	while ((c = getopt_long(argc, argv, "hfVsvo:l:p:z", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hfVsvo:l:p:q:z", longopts, NULL)) != -1) {
 		switch(c) {
 		case 'f':
 			force = 1;
@@ -196,6 +376,15 @@ int main(int argc, char **argv)
 			step = strtosize_or_err(optarg,
 					_("failed to parse step"));
 			break;
+		case 'q':
+			depth = strtou32_or_err(optarg,
+					_("failed to parse queue depth"));
+			if (!depth)
+				errx(EXIT_FAILURE, _("queue depth must be greater than zero"));
+#ifndef HAVE_LIBPTHREAD
+			depth = 1;
+#endif
+			break;
 		case 's':
 			act = ACT_SECURE;
 			break;
@@ -251,6 +440,20 @@ int main(int argc, char **argv)
 	if (end < range[0] || end > blksize)
 		end = blksize;
 
+	if (depth > 1) {
+		uint64_t gran, maxbytes;
+
+		/* the ranges in flight are aligned to the discard granularity */
+		get_discard_limits(sb.st_rdev, act, &gran, &maxbytes);
+		if (!step)
+			step = maxbytes ? maxbytes : DISCARD_QUEUE_STEP;
+		if (gran > (uint64_t) secsize && step % gran)
+			step = step > gran ? step / gran * gran : gran;
+		if (verbose)
+			printf(_("%s: %u ranges of %" PRIu64 " bytes in flight\n"),
+				path, depth, step);
+	}
+
 	range[1] = (step > 0) ? step : end - range[0];
 
 	/* check length alignment to the sector size */
@@ -286,24 +489,35 @@ int main(int argc, char **argv)
 	stats[0] = range[0], stats[1] = 0;
 	gettime_monotonic(&last);
 
+#ifdef HAVE_LIBPTHREAD
+	if (depth > 1) {
+		struct discard_queue q = {
+			.fd = fd,
+			.act = act,
+			.path = path,
+			.next = range[0],
+			.end = end,
+			.step = step,
+			.total = end - range[0],
+			.verbose = verbose ? 1 : 0
+		};
+
+		if (discard_parallel(&q, depth) != 0)
+			err(EXIT_FAILURE, _("%s: %s ioctl failed"), path, act_ioctl_name(act));
+		if (verbose) {
+			stats[1] = q.done;
+			print_stats(act, path, stats);
+		}
+		close(fd);
+		return EXIT_SUCCESS;
+	}
+#endif
 	for (/* nothing */; range[0] < end; range[0] += range[1]) {
 		if (range[0] + range[1] > end)
 			range[1] = end - range[0];
 
-		switch (act) {
-		case ACT_ZEROOUT:
-			if (ioctl(fd, BLKZEROOUT, &range))
-				 err(EXIT_FAILURE, _("%s: BLKZEROOUT ioctl failed"), path);
-			break;
-		case ACT_SECURE:
-			if (ioctl(fd, BLKSECDISCARD, &range))
-				err(EXIT_FAILURE, _("%s: BLKSECDISCARD ioctl failed"), path);
-			break;
-		case ACT_DISCARD:
-			if (ioctl(fd, BLKDISCARD, &range))
-				err(EXIT_FAILURE, _("%s: BLKDISCARD ioctl failed"), path);
-			break;
-		}
+		if (discard_range(fd, act, range))
+			err(EXIT_FAILURE, _("%s: %s ioctl failed"), path, act_ioctl_name(act));
 
 		stats[1] += range[1];
 
@@ -36,6 +36,10 @@
 #include <linux/fs.h>
 #include <linux/blkzoned.h>
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
 #include "nls.h"
 #include "strutils.h"
 #include "xalloc.h"
@@ -44,6 +48,7 @@
 #include "blkdev.h"
 #include "sysfs.h"
 #include "optutils.h"
+#include "jsonwrt.h"
 
 /*
  * These ioctls are defined in linux/blkzoned.h starting with kernel 5.5.
@@ -82,8 +87,12 @@ struct blkzone_control {
 	uint64_t length;
 	uint32_t count;
 
+	unsigned int nthreads;		/* --parallel */
+	struct ul_jsonwrt json;		/* --json */
+
 	unsigned int force : 1;
 	unsigned int verbose : 1;
+	unsigned int use_json : 1;
 };
 
 static const struct blkzone_command commands[] = {
@@ -158,9 +167,9 @@ static int init_device(struct blkzone_control *ctl, int mode)
 }
 
 /*
- * Get the device zone size indicated by chunk sectors).
+ * Read the queue attribute of the whole-disk device.
  */
-static unsigned long blkdev_chunk_sectors(const char *dname)
+static uint64_t blkdev_queue_u64(const char *dname, const char *attr)
 {
 	struct path_cxt *pc = NULL;
 	dev_t devno = sysfs_devname_to_devno(dname);
@@ -188,12 +197,20 @@ static unsigned long blkdev_chunk_sectors(const char *dname)
 			goto done;
 	}
 
-	rc = ul_path_read_u64(pc, &sz, "queue/chunk_sectors");
+	rc = ul_path_read_u64(pc, &sz, attr);
 done:
 	ul_unref_path(pc);
 	return rc == 0 ? sz : 0;
 }
 
+/*
+ * Get the device zone size indicated by chunk sectors).
+ */
+static unsigned long blkdev_chunk_sectors(const char *dname)
+{
+	return blkdev_queue_u64(dname, "queue/chunk_sectors");
+}
+
 #if HAVE_DECL_BLK_ZONE_REP_CAPACITY
 #define has_zone_capacity(zi)	((zi)->flags & BLK_ZONE_REP_CAPACITY)
 #define zone_capacity(z)	(z)->capacity
@@ -206,6 +223,7 @@ done:
  * blkzone report
  */
 #define DEF_REPORT_LEN		(1U << 12) /* 4k zones per report (256k kzalloc) */
+#define MAX_REPORT_LEN		(1U << 20) /* 1M zones per report (64M buffer) */
 
 static const char *type_text[] = {
 	"RESERVED",
@@ -232,7 +250,8 @@ static int blkzone_report(struct blkzone_control *ctl)
 	uint64_t capacity_sum = 0;
 	struct blk_zone_report *zi;
 	unsigned long zonesize;
-	uint32_t i, nr_zones;
+	uint32_t i, nr_zones, report_len;
+	uint64_t dev_zones;
 	int fd;
 
 	fd = init_device(ctl, O_RDONLY);
@@ -252,18 +271,34 @@ static int blkzone_report(struct blkzone_control *ctl)
 	else
 		nr_zones = 1 + (ctl->total_sectors - ctl->offset) / zonesize;
 
+	/*
+	 * Read all the zones by one ioctl if possible; the kernel returns
+	 * at most the number of zones on the device.
+	 */
+	dev_zones = blkdev_queue_u64(ctl->devname, "queue/nr_zones");
+	if (dev_zones)
+		report_len = min((uint64_t) min(nr_zones, MAX_REPORT_LEN), dev_zones);
+	else
+		report_len = min(nr_zones, DEF_REPORT_LEN);
+
 	zi = xmalloc(sizeof(struct blk_zone_report) +
-		     (DEF_REPORT_LEN * sizeof(struct blk_zone)));
+		     ((size_t) report_len * sizeof(struct blk_zone)));
+
+	if (ctl->use_json) {
+		ul_jsonwrt_root_open(&ctl->json);
+		if (!only_capacity_sum)
+			ul_jsonwrt_array_open(&ctl->json, "zones");
+	}
 
 	while (nr_zones && ctl->offset < ctl->total_sectors) {
 
-		zi->nr_zones = min(nr_zones, DEF_REPORT_LEN);
+		zi->nr_zones = min(nr_zones, report_len);
 		zi->sector = ctl->offset;
 
 		if (ioctl(fd, BLKREPORTZONE, zi) == -1)
 			err(EXIT_FAILURE, _("%s: BLKREPORTZONE ioctl failed"), ctl->devname);
 
-		if (ctl->verbose)
+		if (ctl->verbose && !ctl->use_json)
 			printf(_("Found %d zones from 0x%"PRIx64"\n"),
 				zi->nr_zones, ctl->offset);
 
@@ -298,6 +333,21 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 			if (only_capacity_sum) {
 				capacity_sum += cap;
+			} else if (ctl->use_json) {
+				struct ul_jsonwrt *js = &ctl->json;
+
+				ul_jsonwrt_object_open(js, NULL);
+				ul_jsonwrt_value_u64(js, "start", start);
+				ul_jsonwrt_value_u64(js, "len", len);
+				ul_jsonwrt_value_u64(js, "cap", cap);
+				ul_jsonwrt_value_u64(js, "wptr", (type == 0x1) ? 0 : wp - start);
+				ul_jsonwrt_value_boolean(js, "reset", entry->reset);
+				ul_jsonwrt_value_boolean(js, "non-seq", entry->non_seq);
+				ul_jsonwrt_value_s(js, "cond",
+					condition_str[cond & (ARRAY_SIZE(condition_str) - 1)]);
+				ul_jsonwrt_value_s(js, "type",
+					type < ARRAY_SIZE(type_text) ? type_text[type] : NULL);
+				ul_jsonwrt_object_close(js);
 			} else {
 				printf(_("  start: 0x%09"PRIx64", len 0x%06"PRIx64
 					", cap 0x%06"PRIx64", wptr 0x%06"PRIx64
@@ -314,7 +364,13 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 	}
 
-	if (only_capacity_sum)
+	if (ctl->use_json) {
+		if (only_capacity_sum)
+			ul_jsonwrt_value_u64(&ctl->json, "capacity", capacity_sum);
+		else
+			ul_jsonwrt_array_close(&ctl->json);
+		ul_jsonwrt_root_close(&ctl->json);
+	} else if (only_capacity_sum)
 		printf(_("0x%09"PRIx64"\n"), capacity_sum);
 
 	free(zi);
@@ -323,6 +379,90 @@ static int blkzone_report(struct blkzone_control *ctl)
 	return 0;
 }
 
+#ifdef HAVE_LIBPTHREAD
+/*
+ * For --parallel the range is split to batches of zones, the threads take
+ * the next batch and call the ioctl for it. The batches do not overlap.
+ */
+struct zone_queue {
+	struct blkzone_control *ctl;
+	int fd;
+
+	uint64_t next;		/* next sector */
+	uint64_t end;
+	uint64_t batch;		/* sectors per ioctl */
+
+	int error;		/* errno of the first failed ioctl */
+	pthread_mutex_t lock;
+};
+
+static void *zone_worker(void *data)
+{
+	struct zone_queue *q = data;
+
+	for (;;) {
+		struct blk_zone_range za;
+
+		pthread_mutex_lock(&q->lock);
+		if (q->error || q->next >= q->end) {
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+		za.sector = q->next;
+		za.nr_sectors = min(q->batch, q->end - q->next);
+		q->next += za.nr_sectors;
+		pthread_mutex_unlock(&q->lock);
+
+		if (ioctl(q->fd, q->ctl->command->ioctl_cmd, &za) == -1) {
+			pthread_mutex_lock(&q->lock);
+			if (!q->error)
+				q->error = errno;
+			pthread_mutex_unlock(&q->lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+static int zone_action_parallel(struct blkzone_control *ctl, int fd,
+				struct blk_zone_range *za, unsigned long zonesize)
+{
+	struct zone_queue q = {
+		.ctl = ctl,
+		.fd = fd,
+		.next = za->sector,
+		.end = za->sector + za->nr_sectors
+	};
+	uint64_t nzones = (za->nr_sectors + zonesize - 1) / zonesize;
+	pthread_t *threads;
+	unsigned int i, nrun;
+
+	/* more batches than threads to balance slow zones */
+	q.batch = max(nzones / (ctl->nthreads * 8), (uint64_t) 1) * zonesize;
+
+	pthread_mutex_init(&q.lock, NULL);
+
+	threads = xcalloc(ctl->nthreads, sizeof(pthread_t));
+	for (nrun = 0; nrun < ctl->nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, zone_worker, &q) != 0)
+			break;
+	}
+	if (!nrun)
+		zone_worker(&q);
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	pthread_mutex_destroy(&q.lock);
+
+	if (q.error) {
+		errno = q.error;
+		return -1;
+	}
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 /*
  * blkzone reset, open, close, and finish.
  */
@@ -331,7 +471,7 @@ static int blkzone_action(struct blkzone_control *ctl)
 	struct blk_zone_range za = { .sector = 0 };
 	unsigned long zonesize;
 	uint64_t zlen;
-	int fd;
+	int fd, rc;
 
 	zonesize = blkdev_chunk_sectors(ctl->devname);
 	if (!zonesize)
@@ -366,7 +506,17 @@ static int blkzone_action(struct blkzone_control *ctl)
 	za.sector = ctl->offset;
 	za.nr_sectors = zlen;
 
-	if (ioctl(fd, ctl->command->ioctl_cmd, &za) == -1)
+#ifdef HAVE_LIBPTHREAD
+	/* the whole device is reset by one command ("reset all") in kernel */
+	if (ctl->nthreads > 1 && zlen > zonesize &&
+	    !(za.sector == 0 && zlen == ctl->total_sectors &&
+	      ctl->command->ioctl_cmd == BLKRESETZONE))
+		rc = zone_action_parallel(ctl, fd, &za, zonesize);
+	else
+#endif
+		rc = ioctl(fd, ctl->command->ioctl_cmd, &za);
+
+	if (rc == -1)
 		err(EXIT_FAILURE, _("%s: %s ioctl failed"),
 		    ctl->devname, ctl->command->ioctl_name);
 	else if (ctl->verbose)
@@ -399,6 +549,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -l, --length <sectors> maximum sectors to act (in 512-byte sectors)\n"), out);
 	fputs(_(" -c, --count <number>   maximum number of zones\n"), out);
 	fputs(_(" -f, --force            enforce on block devices used by the system\n"), out);
+	fputs(_(" -j, --parallel <num>   act on zone ranges by <num> threads\n"), out);
+	fputs(_(" -J, --json             use JSON output format for report and capacity\n"), out);
 	fputs(_(" -v, --verbose          display more details\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(24));
@@ -423,6 +575,8 @@ int main(int argc, char **argv)
 	    { "length",  required_argument, NULL, 'l' }, /* max of sectors to operate on */
 	    { "offset",  required_argument, NULL, 'o' }, /* starting LBA */
 	    { "force",   no_argument,       NULL, 'f' },
+	    { "json",    no_argument,       NULL, 'J' },
+	    { "parallel", required_argument, NULL, 'j' },
 	    { "verbose", no_argument,       NULL, 'v' },
 	    { "version", no_argument,       NULL, 'V' },
 	    { NULL, 0, NULL, 0 }
@@ -438,6 +592,7 @@ int main(int argc, char **argv)
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	close_stdout_atexit();
+	ul_jsonwrt_init(&ctl.json, stdout, 0);
 
 	if (argc >= 2 && *argv[1] != '-') {
 		ctl.command = name_to_command(argv[1]);
@@ -447,7 +602,7 @@ int main(int argc, char **argv)
 		argc--;
 	}
 
-	while ((c = getopt_long(argc, argv, "hc:l:o:fvV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hc:j:Jl:o:fvV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -467,6 +622,21 @@ int main(int argc, char **argv)
 		case 'f':
 			ctl.force = 1;
 			break;
+		case 'j':
+			ctl.nthreads = strtou32_or_err(optarg,
+					_("invalid number of threads argument"));
+			if (ctl.nthreads == 0) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+				ctl.nthreads = n > 0 ? (unsigned int) n : 1;
+			}
+#ifndef HAVE_LIBPTHREAD
+			ctl.nthreads = 1;
+#endif
+			break;
+		case 'J':
+			ctl.use_json = 1;
+			break;
 		case 'v':
 			ctl.verbose = 1;
 			break;
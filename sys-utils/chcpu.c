@@ -32,6 +32,9 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "cpuset.h"
 #include "nls.h"
@@ -42,6 +45,7 @@
 #include "path.h"
 #include "closestream.h"
 #include "optutils.h"
+#include "monotonic.h"
 
 #define EXCL_ERROR "--{configure,deconfigure,disable,dispatch,enable}"
 
@@ -66,18 +70,120 @@ enum {
 	CMD_CPU_DISPATCH_VERTICAL,
 };
 
-/* returns:   0 = success
+struct chcpu_control {
+	unsigned int	nthreads;	/* --parallel */
+	unsigned int	latency : 1;	/* --latency */
+};
+
+/* one online/offline write */
+struct cpu_job {
+	int		cpu;
+	int		configured;	/* -1 if unknown */
+	int		error;		/* errno */
+	struct timeval	time;		/* write latency */
+};
+
+static void cpu_job_write(struct path_cxt *sys, struct cpu_job *job, int enable)
+{
+	struct timeval start, end;
+
+	gettime_monotonic(&start);
+	errno = 0;
+	if (ul_path_writef_string(sys, enable ? "1" : "0", "cpu%d/online", job->cpu) != 0)
+		job->error = errno ? errno : EIO;
+	gettime_monotonic(&end);
+	timersub(&end, &start, &job->time);
+}
+
+static void cpu_jobs_write(struct path_cxt *sys, struct cpu_job *jobs, size_t njobs,
+			   int enable)
+{
+	size_t i;
+
+	for (i = 0; i < njobs; i++)
+		cpu_job_write(sys, &jobs[i], enable);
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * For --parallel the writes are issued by a pool of threads. The kernel
+ * serializes the hotplug operations itself (a busy write is restarted), so
+ * the threads only overlap the waiting for the lock and the per-CPU work
+ * which the kernel does outside of it. The path handler is not thread-safe,
+ * every thread has its own.
+ */
+struct cpu_queue {
+	struct cpu_job	*jobs;
+	size_t		njobs;
+	size_t		next;		/* atomic */
+	int		enable;
+};
+
+static void *cpu_worker(void *data)
+{
+	struct cpu_queue *q = data;
+	struct path_cxt *sys = ul_new_path(_PATH_SYS_CPU);
+
+	for (;;) {
+		size_t i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED);
+
+		if (i >= q->njobs)
+			break;
+		if (!sys)
+			q->jobs[i].error = ENOMEM;
+		else
+			cpu_job_write(sys, &q->jobs[i], q->enable);
+	}
+	ul_unref_path(sys);
+	return NULL;
+}
+
+static void cpu_jobs_write_parallel(struct path_cxt *sys, struct cpu_job *jobs,
+				    size_t njobs, int enable, unsigned int nthreads)
+{
+	struct cpu_queue q = { .jobs = jobs, .njobs = njobs, .enable = enable };
+	pthread_t *threads;
+	unsigned int i, nrun;
+
+	nthreads = min(nthreads, (unsigned int) njobs);
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, cpu_worker, &q) != 0)
+			break;
+	}
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	/* no thread, or the threads failed to finish the queue */
+	if (q.next < njobs)
+		cpu_jobs_write(sys, jobs + q.next, njobs - q.next, enable);
+}
+#endif /* HAVE_LIBPTHREAD */
+
+/*
+ * The CPUs are checked first, then all the writes are issued (by more threads
+ * for --parallel) and the results are reported in the CPU order.
+ *
+ * returns:   0 = success
  *          < 0 = failure
  *          > 0 = partial success
  */
-static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize, int enable)
+static int cpu_enable(const struct chcpu_control *ctl, struct path_cxt *sys,
+		      cpu_set_t *cpu_set, size_t setsize, int enable)
 {
+	struct cpu_job *jobs;
+	size_t i, njobs = 0;
 	int cpu;
-	int online, rc;
-	int configured = -1;
+	int online;
 	int fails = 0;
+	int nonline = onlinecpus ? num_online_cpus() : 0;
+
+	jobs = xcalloc(maxcpus, sizeof(struct cpu_job));
 
 	for (cpu = 0; cpu < maxcpus; cpu++) {
+		int configured = -1;
+
 		if (!CPU_ISSET_S(cpu, setsize, cpu_set))
 			continue;
 		if (ul_path_accessf(sys, F_OK, "cpu%d", cpu) != 0) {
@@ -102,34 +208,61 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 		}
 		if (ul_path_accessf(sys, F_OK, "cpu%d/configure", cpu) == 0)
 			ul_path_readf_s32(sys, &configured, "cpu%d/configure", cpu);
+		if (!enable && onlinecpus) {
+			/* keep the last one, the writes are not done yet */
+			if (nonline == 1) {
+				warnx(_("CPU %u disable failed (last enabled CPU)"), cpu);
+				fails++;
+				continue;
+			}
+			nonline--;
+		}
+		jobs[njobs].cpu = cpu;
+		jobs[njobs].configured = configured;
+		njobs++;
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	if (ctl->nthreads > 1 && njobs > 1)
+		cpu_jobs_write_parallel(sys, jobs, njobs, enable, ctl->nthreads);
+	else
+#endif
+		cpu_jobs_write(sys, jobs, njobs, enable);
+
+	for (i = 0; i < njobs; i++) {
+		struct cpu_job *job = &jobs[i];
+		double ms = job->time.tv_sec * 1000.0 + job->time.tv_usec / 1000.0;
+
+		cpu = job->cpu;
+		errno = job->error;
+
 		if (enable) {
-			rc = ul_path_writef_string(sys, "1", "cpu%d/online", cpu);
-			if (rc != 0 && configured == 0) {
+			if (job->error && job->configured == 0) {
 				warn(_("CPU %u enable failed (CPU is deconfigured)"), cpu);
 				fails++;
-			} else if (rc != 0) {
+			} else if (job->error) {
 				warn(_("CPU %u enable failed"), cpu);
 				fails++;
-			} else
+			} else if (ctl->latency)
+				printf(_("CPU %u enabled in %.3f ms\n"), cpu, ms);
+			else
 				printf(_("CPU %u enabled\n"), cpu);
 		} else {
-			if (onlinecpus && num_online_cpus() == 1) {
-				warnx(_("CPU %u disable failed (last enabled CPU)"), cpu);
+			if (job->error) {
+				warn(_("CPU %u disable failed"), cpu);
 				fails++;
 				continue;
 			}
-			rc = ul_path_writef_string(sys, "0", "cpu%d/online", cpu);
-			if (rc != 0) {
-				warn(_("CPU %u disable failed"), cpu);
-				fails++;
-			} else {
+			if (ctl->latency)
+				printf(_("CPU %u disabled in %.3f ms\n"), cpu, ms);
+			else
 				printf(_("CPU %u disabled\n"), cpu);
-				if (onlinecpus)
-					CPU_CLR_S(cpu, setsize, onlinecpus);
-			}
+			if (onlinecpus)
+				CPU_CLR_S(cpu, setsize, onlinecpus);
 		}
 	}
 
+	free(jobs);
 	return fails == 0 ? 0 : fails == maxcpus ? -1 : 1;
 }
 
@@ -252,6 +385,8 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -g, --deconfigure <cpu-list>  deconfigure cpus\n"
 		" -p, --dispatch <mode>         set dispatching mode\n"
 		" -r, --rescan                  trigger rescan of cpus\n"
+		" -j, --parallel <num>          enable or disable cpus by <num> threads\n"
+		"     --latency                 print time of every enable or disable\n"
 		), stdout);
 	printf(USAGE_HELP_OPTIONS(31));
 
@@ -264,9 +399,13 @@ int main(int argc, char *argv[])
 	struct path_cxt *sys = NULL;	/* _PATH_SYS_CPU handler */
 	cpu_set_t *cpu_set = NULL;
 	size_t setsize;
+	struct chcpu_control ctl = { .nthreads = 1 };
 	int cmd = -1;
 	int c, rc;
 
+	enum {
+		OPT_LATENCY = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{ "configure",	required_argument, NULL, 'c' },
 		{ "deconfigure",required_argument, NULL, 'g' },
@@ -274,6 +413,8 @@ int main(int argc, char *argv[])
 		{ "dispatch",	required_argument, NULL, 'p' },
 		{ "enable",	required_argument, NULL, 'e' },
 		{ "help",	no_argument,       NULL, 'h' },
+		{ "latency",	no_argument,       NULL, OPT_LATENCY },
+		{ "parallel",	required_argument, NULL, 'j' },
 		{ "rescan",	no_argument,       NULL, 'r' },
 		{ "version",	no_argument,       NULL, 'V' },
 		{ NULL,		0, NULL, 0 }
@@ -308,7 +449,7 @@ int main(int argc, char *argv[])
 
 	setsize = CPU_ALLOC_SIZE(maxcpus);
 
-	while ((c = getopt_long(argc, argv, "c:d:e:g:hp:rV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "c:d:e:g:hj:p:rV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -341,6 +482,21 @@ int main(int argc, char *argv[])
 		case 'r':
 			cmd = CMD_CPU_RESCAN;
 			break;
+		case 'j':
+			ctl.nthreads = strtou32_or_err(optarg,
+					_("invalid number of threads argument"));
+			if (ctl.nthreads == 0) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+				ctl.nthreads = n > 0 ? (unsigned int) n : 1;
+			}
+#ifndef HAVE_LIBPTHREAD
+			ctl.nthreads = 1;
+#endif
+			break;
+		case OPT_LATENCY:
+			ctl.latency = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -358,10 +514,10 @@ int main(int argc, char *argv[])
 
 	switch (cmd) {
 	case CMD_CPU_ENABLE:
-		rc = cpu_enable(sys, cpu_set, maxcpus, 1);
+		rc = cpu_enable(&ctl, sys, cpu_set, maxcpus, 1);
 		break;
 	case CMD_CPU_DISABLE:
-		rc = cpu_enable(sys, cpu_set, maxcpus, 0);
+		rc = cpu_enable(&ctl, sys, cpu_set, maxcpus, 0);
 		break;
 	case CMD_CPU_CONFIGURE:
 		rc = cpu_configure(sys, cpu_set, maxcpus, 1);
@@ -23,6 +23,7 @@
 #include <getopt.h>
 #include <assert.h>
 #include <dirent.h>
+#include <sys/time.h>
 
 #include "c.h"
 #include "nls.h"
@@ -32,11 +33,13 @@
 #include "optutils.h"
 #include "closestream.h"
 #include "xalloc.h"
+#include "monotonic.h"
 
 /* partial success, otherwise we return regular EXIT_{SUCCESS,FAILURE} */
 #define CHMEM_EXIT_SOMEOK		64
 
 #define _PATH_SYS_MEMORY		"/sys/devices/system/memory"
+#define _PATH_SYS_NODE			"/sys/devices/system/node"
 
 struct chmem_desc {
 	struct path_cxt	*sysmem;	/* _PATH_SYS_MEMORY handler */
@@ -46,6 +49,8 @@ struct chmem_desc {
 	uint64_t	start;
 	uint64_t	end;
 	uint64_t	size;
+	uint64_t	nchanged;	/* number of successfully changed blocks */
+	int		node;		/* NUMA node or -1 */
 	unsigned int	use_blocks : 1;
 	unsigned int	is_size	   : 1;
 	unsigned int	verbose	   : 1;
@@ -172,17 +177,51 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 			warnx(_("Could only disable %s of memory"), sizestr);
 		free(sizestr);
 	}
+	desc->nchanged = desc->size - size;
 	return size == 0 ? 0 : size == desc->size ? -1 : 1;
 }
 
+static uint64_t dir_to_index(const struct dirent *de)
+{
+	return strtou64_or_err(de->d_name + 6, _("Failed to parse index"));
+}
+
+/* returns position of the first block with index >= @start */
+static int first_block(struct chmem_desc *desc, uint64_t start)
+{
+	int lo = 0, hi = desc->ndirs;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (dir_to_index(desc->dirs[mid]) < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 {
 	char *name, *onoff, line[BUFSIZ], str[BUFSIZ];
-	uint64_t index, todo;
+	uint64_t index, todo, total;
 	const char *zn;
-	int i, rc;
+	int i, first, rc;
 
-	todo = desc->end - desc->start + 1;
+	first = first_block(desc, desc->start);
+
+	/* blocks from other nodes are not requested */
+	if (desc->node >= 0) {
+		for (total = 0, i = first; i < desc->ndirs; i++) {
+			if (dir_to_index(desc->dirs[i]) > desc->end)
+				break;
+			total++;
+		}
+	} else
+		total = desc->end - desc->start + 1;
+
+	todo = total;
 	onoff = enable ? "online" : "offline";
 
 	if (enable && zone_id >= 0) {
@@ -192,11 +231,9 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			onoff = "online_kernel";
 	}
 
-	for (i = 0; i < desc->ndirs; i++) {
+	for (i = first; i < desc->ndirs; i++) {
 		name = desc->dirs[i]->d_name;
-		index = strtou64_or_err(name + 6, _("Failed to parse index"));
-		if (index < desc->start)
-			continue;
+		index = dir_to_index(desc->dirs[i]);
 		if (index > desc->end)
 			break;
 		idxtostr(desc, index, str, sizeof(str));
@@ -243,10 +280,12 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			else
 				fprintf(stdout, _("%s disabled\n"), str);
 		}
-		if (rc == 0)
+		if (rc == 0) {
+			desc->nchanged++;
 			todo--;
+		}
 	}
-	return todo == 0 ? 0 : todo == desc->end - desc->start + 1 ? -1 : 1;
+	return todo == 0 ? 0 : todo == total ? -1 : 1;
 }
 
 static int filter(const struct dirent *de)
@@ -274,6 +313,64 @@ fail:
 	err(EXIT_FAILURE, _("Failed to read %s"), _PATH_SYS_MEMORY);
 }
 
+static int cmp_index(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * Removes blocks which don't belong to @desc->node from @desc->dirs. The
+ * node<N>/memory<M> links are read only once, so the rest of the code works
+ * with the node blocks only.
+ */
+static void filter_node(struct chmem_desc *desc)
+{
+	struct path_cxt *sysnode;
+	struct dirent *de;
+	uint64_t *idx = NULL;
+	size_t nidx = 0, nalloc = 0;
+	DIR *dir;
+	int i, n;
+
+	sysnode = ul_new_path(_PATH_SYS_NODE "/node%d", desc->node);
+	if (!sysnode)
+		err(EXIT_FAILURE, _("failed to initialize %s handler"), _PATH_SYS_NODE);
+	dir = ul_path_opendir(sysnode, NULL);
+	if (!dir)
+		err(EXIT_FAILURE, _("cannot open NUMA node %d"), desc->node);
+
+	while ((de = readdir(dir))) {
+		if (!filter(de))
+			continue;
+		if (nidx == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			idx = xrealloc(idx, nalloc * sizeof(*idx));
+		}
+		idx[nidx++] = dir_to_index(de);
+	}
+	closedir(dir);
+	ul_unref_path(sysnode);
+
+	if (nidx)
+		qsort(idx, nidx, sizeof(*idx), cmp_index);
+
+	for (i = 0, n = 0; i < desc->ndirs; i++) {
+		uint64_t x = dir_to_index(desc->dirs[i]);
+
+		if (nidx && bsearch(&x, idx, nidx, sizeof(*idx), cmp_index))
+			desc->dirs[n++] = desc->dirs[i];
+		else
+			free(desc->dirs[i]);
+	}
+	desc->ndirs = n;
+	free(idx);
+
+	if (!desc->ndirs)
+		errx(EXIT_FAILURE, _("no memory blocks on NUMA node %d"), desc->node);
+}
+
 static void parse_single_param(struct chmem_desc *desc, char *str)
 {
 	if (desc->use_blocks) {
@@ -346,6 +443,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -e, --enable       enable memory\n"), out);
 	fputs(_(" -d, --disable      disable memory\n"), out);
 	fputs(_(" -b, --blocks       use memory blocks\n"), out);
+	fputs(_(" -n, --node <num>   use memory blocks of the NUMA node only\n"), out);
 	fputs(_(" -z, --zone <name>  select memory zone (see below)\n"), out);
 	fputs(_(" -v, --verbose      verbose output\n"), out);
 	printf(USAGE_HELP_OPTIONS(20));
@@ -364,6 +462,7 @@ int main(int argc, char **argv)
 	struct chmem_desc _desc = { 0 }, *desc = &_desc;
 	int cmd = CMD_NONE, zone_id = -1;
 	char *zone = NULL;
+	struct timeval start;
 	int c, rc;
 
 	static const struct option longopts[] = {
@@ -371,6 +470,7 @@ int main(int argc, char **argv)
 		{"disable",	no_argument,		NULL, 'd'},
 		{"enable",	no_argument,		NULL, 'e'},
 		{"help",	no_argument,		NULL, 'h'},
+		{"node",	required_argument,	NULL, 'n'},
 		{"verbose",	no_argument,		NULL, 'v'},
 		{"version",	no_argument,		NULL, 'V'},
 		{"zone",	required_argument,	NULL, 'z'},
@@ -394,8 +494,9 @@ int main(int argc, char **argv)
 		err(EXIT_FAILURE, _("failed to initialize %s handler"), _PATH_SYS_MEMORY);
 
 	read_info(desc);
+	desc->node = -1;
 
-	while ((c = getopt_long(argc, argv, "bdehvVz:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "bdehn:vVz:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -409,6 +510,11 @@ int main(int argc, char **argv)
 		case 'b':
 			desc->use_blocks = 1;
 			break;
+		case 'n':
+			desc->node = strtos32_or_err(optarg, _("failed to parse node number"));
+			if (desc->node < 0)
+				errx(EXIT_FAILURE, _("invalid node number: %s"), optarg);
+			break;
 		case 'v':
 			desc->verbose = 1;
 			break;
@@ -447,11 +553,29 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (desc->node >= 0)
+		filter_node(desc);
+
+	gettime_monotonic(&start);
+
 	if (desc->is_size)
 		rc = chmem_size(desc, cmd == CMD_MEMORY_ENABLE ? 1 : 0, zone_id);
 	else
 		rc = chmem_range(desc, cmd == CMD_MEMORY_ENABLE ? 1 : 0, zone_id);
 
+	if (desc->verbose) {
+		struct timeval now, diff;
+
+		gettime_monotonic(&now);
+		timersub(&now, &start, &diff);
+		if (cmd == CMD_MEMORY_ENABLE)
+			fprintf(stdout, _("%"PRIu64" memory blocks enabled in %ld.%06ld seconds\n"),
+				desc->nchanged, (long) diff.tv_sec, (long) diff.tv_usec);
+		else
+			fprintf(stdout, _("%"PRIu64" memory blocks disabled in %ld.%06ld seconds\n"),
+				desc->nchanged, (long) diff.tv_sec, (long) diff.tv_usec);
+	}
+
 	ul_unref_path(desc->sysmem);
 
 	return rc == 0 ? EXIT_SUCCESS :
@@ -35,6 +35,7 @@
 #include "monotonic.h"
 #include "mangle.h"
 #include "pager.h"
+#include "jsonwrt.h"
 
 /* Close the log.  Currently a NOP. */
 #define SYSLOG_ACTION_CLOSE          0
@@ -59,6 +60,9 @@
 /* Return size of the log buffer */
 #define SYSLOG_ACTION_SIZE_BUFFER   10
 
+/* stdout buffer size, all records are written through the buffer */
+#define DMESG_OUTBUF_SIZE	(256 * 1024)
+
 /*
  * Color scheme
  */
@@ -161,6 +165,20 @@ enum {
 };
 #define is_timefmt(c, f) ((c)->time_fmt == (DMESG_TIMEFTM_ ##f))
 
+/*
+ * The broken-down time and the formatted strings for the last second; the
+ * records are usually dense, so localtime() and strftime() are called once
+ * per second rather than once per record.
+ */
+struct dmesg_tmcache {
+	time_t		time;
+	struct tm	tm;
+	char		ctime[64];		/* for --ctime, or empty */
+	char		iso[ISO_BUFSIZ];	/* date and time for --time-format=iso */
+	char		isozone[16];		/* timezone for --time-format=iso */
+	unsigned int	valid:1;
+};
+
 struct dmesg_control {
 	/* bit arrays -- see include/bitops.h */
 	char levels[ARRAY_SIZE(level_names) / NBBY + 1];
@@ -168,6 +186,7 @@ struct dmesg_control {
 
 	struct timeval	lasttime;	/* last printed timestamp */
 	struct tm	lasttm;		/* last localtime */
+	struct dmesg_tmcache tmcache;	/* localtime of the last record */
 	struct timeval	boot_time;	/* system boot time */
 	time_t		suspended_time;	/* time spent in suspended state */
 
@@ -183,6 +202,13 @@ struct dmesg_control {
 	time_t		since;		/* filter records by time */
 	time_t		until;		/* filter records by time */
 
+	uint64_t	since_seq;	/* --since-seq or from cursor file */
+	uint64_t	next_seq;	/* sequence number after the last record */
+	const char	*cursor_file;	/* --cursor-file */
+	int		cursor_fd;
+
+	struct ul_jsonwrt jfmt;		/* --json or --ndjson */
+
 	/*
 	 * For the --file option we mmap whole file. The unnecessary (already
 	 * printed) pages are always unmapped. The result is that we have in
@@ -202,8 +228,10 @@ struct dmesg_control {
 			decode:1,	/* use "facility: level: " prefix */
 			pager:1,	/* pipe output into a pager */
 			color:1,	/* colorize messages */
-			force_prefix:1;	/* force timestamp and decode prefix
+			force_prefix:1,	/* force timestamp and decode prefix
 					   on each line */
+			seq:1,		/* --since-seq or --cursor-file */
+			json:1;		/* --json or --ndjson */
 	int		indent;		/* due to timestamps if newline */
 };
 
@@ -214,6 +242,9 @@ struct dmesg_record {
 	int		level;
 	int		facility;
 	struct timeval  tv;
+	uint64_t	seq;		/* kmsg sequence number */
+	const char	*caller;	/* kmsg caller ID (e.g. "T123") */
+	size_t		caller_size;
 
 	const char	*next;		/* buffer with next unparsed record */
 	size_t		next_size;	/* size of the next buffer */
@@ -226,6 +257,9 @@ struct dmesg_record {
 		(_r)->level = -1; \
 		(_r)->tv.tv_sec = 0; \
 		(_r)->tv.tv_usec = 0; \
+		(_r)->seq = 0; \
+		(_r)->caller = NULL; \
+		(_r)->caller_size = 0; \
 	} while (0)
 
 static int read_kmsg(struct dmesg_control *ctl);
@@ -282,6 +316,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -F, --file <file>           use the file instead of the kernel log buffer\n"), out);
 	fputs(_(" -f, --facility <list>       restrict output to defined facilities\n"), out);
 	fputs(_(" -H, --human                 human readable output\n"), out);
+	fputs(_(" -J, --json                  use JSON output format\n"), out);
+	fputs(_("     --ndjson                use JSON output format, one record per line\n"), out);
 	fputs(_(" -k, --kernel                display kernel messages\n"), out);
 	fprintf(out,
 	      _(" -L, --color[=<when>]        colorize messages (%s, %s or %s)\n"), "auto", "always", "never");
@@ -307,6 +343,8 @@ static void __attribute__((__noreturn__)) usage(void)
 		"                               [delta|reltime|ctime|notime|iso]\n"
 		"Suspending/resume will make ctime and iso timestamps inaccurate.\n"), out);
 	fputs(_("     --since <time>          display the lines since the specified time\n"), out);
+	fputs(_("     --since-seq <num>       display the records since the kmsg sequence number\n"), out);
+	fputs(_("     --cursor-file <file>    continue after the last record from the previous run\n"), out);
 	fputs(_("     --until <time>          display the lines until the specified time\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -619,6 +657,29 @@ static int fwrite_hex(const char *buf, size_t size, FILE *out)
 	return 0;
 }
 
+/*
+ * Returns number of the leading chars which are printed without any
+ * conversion (printable ASCII, or all chars for --noescape); the line
+ * breaks are handled by safe_fwrite() if indentation is required.
+ */
+static inline size_t plain_span(struct dmesg_control *ctl,
+				const char *buf, size_t size, int indent)
+{
+	size_t n;
+
+	for (n = 0; n < size; n++) {
+		unsigned char c = (unsigned char) buf[n];
+
+		if (c == '\n' && indent)
+			break;
+		if (ctl->noesc)
+			continue;
+		if (c == '\0' || c >= 0x80 || (!isprint(c) && !isspace(c)))
+			break;
+	}
+	return n;
+}
+
 /*
  * Prints to 'out' and non-printable chars are replaced with \x<hex> sequences.
  */
@@ -633,7 +694,15 @@ static void safe_fwrite(struct dmesg_control *ctl, const char *buf, size_t size,
 	for (i = 0; i < size; i++) {
 		const char *p = buf + i;
 		int rc, hex = 0;
-		size_t len = 1;
+		size_t len = plain_span(ctl, p, size - i, indent);
+
+		if (len) {
+			/* fast path, write all the plain chars at once */
+			rc = fwrite(p, 1, len, out) != len;
+			i += len - 1;
+			goto done;
+		}
+		len = 1;
 
 		if (!ctl->noesc) {
 			if (*p == '\0') {
@@ -673,7 +742,7 @@ doprint:
 				rc |= 1;
 		} else
 			rc = fwrite(p, 1, len, out) != len;
-
+done:
 		if (rc != 0) {
 			if (errno != EPIPE)
 				err(EXIT_FAILURE, _("write failed"));
@@ -742,7 +811,8 @@ static int get_next_syslog_record(struct dmesg_control *ctl,
 			continue;	/* error or empty line? */
 
 		if (*begin == '<') {
-			if (ctl->fltr_lev || ctl->fltr_fac || ctl->decode || ctl->color)
+			if (ctl->fltr_lev || ctl->fltr_fac || ctl->decode || ctl->color
+			    || ctl->json)
 				begin = parse_faclev(begin + 1, &rec->facility,
 						     &rec->level);
 			else
@@ -833,25 +903,40 @@ static void raw_print(struct dmesg_control *ctl, const char *buf, size_t size)
 		putchar('\n');
 }
 
+static struct dmesg_tmcache *record_tmcache(struct dmesg_control *ctl,
+					    struct dmesg_record *rec)
+{
+	struct dmesg_tmcache *tc = &ctl->tmcache;
+	time_t t = record_time(ctl, rec);
+
+	if (!tc->valid || tc->time != t) {
+		if (!localtime_r(&t, &tc->tm))
+			memset(&tc->tm, 0, sizeof(tc->tm));
+		tc->time = t;
+		tc->valid = 1;
+		*tc->ctime = '\0';
+		*tc->iso = '\0';
+	}
+	return tc;
+}
+
 static struct tm *record_localtime(struct dmesg_control *ctl,
 				   struct dmesg_record *rec,
 				   struct tm *tm)
 {
-	time_t t = record_time(ctl, rec);
-	return localtime_r(&t, tm);
+	*tm = record_tmcache(ctl, rec)->tm;
+	return tm;
 }
 
-static char *record_ctime(struct dmesg_control *ctl,
-			  struct dmesg_record *rec,
-			  char *buf, size_t bufsiz)
+static const char *record_ctime(struct dmesg_control *ctl,
+				struct dmesg_record *rec)
 {
-	struct tm tm;
-
-	record_localtime(ctl, rec, &tm);
+	struct dmesg_tmcache *tc = record_tmcache(ctl, rec);
 
-	if (strftime(buf, bufsiz, "%a %b %e %H:%M:%S %Y", &tm) == 0)
-		*buf = '\0';
-	return buf;
+	if (!*tc->ctime &&
+	    strftime(tc->ctime, sizeof(tc->ctime), "%a %b %e %H:%M:%S %Y", &tc->tm) == 0)
+		*tc->ctime = '\0';
+	return tc->ctime;
 }
 
 static char *short_ctime(struct tm *tm, char *buf, size_t bufsiz)
@@ -861,17 +946,28 @@ static char *short_ctime(struct tm *tm, char *buf, size_t bufsiz)
 	return buf;
 }
 
+/* The same as strtimeval_iso(ISO_TIMESTAMP_COMMA_T), but only the
+ * microseconds are formatted for every record. */
 static char *iso_8601_time(struct dmesg_control *ctl, struct dmesg_record *rec,
 			   char *buf, size_t bufsz)
 {
-	struct timeval tv = {
-		.tv_sec = ctl->boot_time.tv_sec + ctl->suspended_time + rec->tv.tv_sec,
-		.tv_usec = rec->tv.tv_usec
-	};
+	struct dmesg_tmcache *tc = record_tmcache(ctl, rec);
+	int len;
+
+	if (!*tc->iso) {
+		if (strtm_iso(&tc->tm, ISO_DATE | ISO_TIME | ISO_T,
+			      tc->iso, sizeof(tc->iso)) != 0 ||
+		    strtm_iso(&tc->tm, ISO_TIMEZONE,
+			      tc->isozone, sizeof(tc->isozone)) != 0) {
+			*tc->iso = '\0';
+			return NULL;
+		}
+	}
 
-	if (strtimeval_iso(&tv,	ISO_TIMESTAMP_COMMA_T, buf, bufsz) != 0)
+	len = snprintf(buf, bufsz, "%s,%06ld%s", tc->iso,
+		       (long) rec->tv.tv_usec, tc->isozone);
+	if (len < 0 || (size_t) len >= bufsz)
 		return NULL;
-
 	return buf;
 }
 
@@ -906,6 +1002,42 @@ static const char *get_subsys_delimiter(const char *mesg, size_t mesg_size)
 	return NULL;
 }
 
+/*
+ * The records are written as objects in "dmesg" array for --json, or every
+ * record as an independent object on one line for --ndjson.
+ */
+static void print_json_record(struct dmesg_control *ctl,
+			      struct dmesg_record *rec)
+{
+	struct ul_jsonwrt *js = &ctl->jfmt;
+	char buf[64];
+
+	if (js->compact)
+		ul_jsonwrt_root_open(js);
+	else
+		ul_jsonwrt_object_open(js, NULL);
+
+	if (ctl->method == DMESG_METHOD_KMSG)
+		ul_jsonwrt_value_u64(js, "seq", rec->seq);
+	if (rec->facility > -1 && rec->facility < (int) ARRAY_SIZE(facility_names))
+		ul_jsonwrt_value_s(js, "facility", facility_names[rec->facility].name);
+	if (rec->level > -1 && rec->level < (int) ARRAY_SIZE(level_names))
+		ul_jsonwrt_value_s(js, "level", level_names[rec->level].name);
+	if (!is_timefmt(ctl, NONE)) {
+		snprintf(buf, sizeof(buf), "%ld.%06ld",
+			 (long) rec->tv.tv_sec, (long) rec->tv.tv_usec);
+		ul_jsonwrt_value_raw(js, "time", buf);
+	}
+	if (rec->caller)
+		ul_jsonwrt_value_s_sized(js, "caller", rec->caller, rec->caller_size);
+	ul_jsonwrt_value_s_sized(js, "message", rec->mesg, rec->mesg_size);
+
+	if (js->compact)
+		ul_jsonwrt_root_close(js);
+	else
+		ul_jsonwrt_object_close(js);
+}
+
 static void print_record(struct dmesg_control *ctl,
 			 struct dmesg_record *rec)
 {
@@ -920,6 +1052,11 @@ static void print_record(struct dmesg_control *ctl,
 	if (!accept_record(ctl, rec))
 		return;
 
+	if (ctl->json) {
+		print_json_record(ctl, rec);
+		return;
+	}
+
 	if (!rec->mesg_size) {
 		putchar('\n');
 		return;
@@ -956,11 +1093,11 @@ static void print_record(struct dmesg_control *ctl,
 		break;
 	case DMESG_TIMEFTM_CTIME:
 		ctl->indent = snprintf(tsbuf, sizeof(tsbuf), "[%s] ",
-				      record_ctime(ctl, rec, buf, sizeof(buf)));
+				      record_ctime(ctl, rec));
 		break;
 	case DMESG_TIMEFTM_CTIME_DELTA:
 		ctl->indent = snprintf(tsbuf, sizeof(tsbuf), "[%s <%12.06f>] ",
-				      record_ctime(ctl, rec, buf, sizeof(buf)),
+				      record_ctime(ctl, rec),
 				      record_count_delta(ctl, rec));
 		break;
 	case DMESG_TIMEFTM_DELTA:
@@ -1141,8 +1278,13 @@ static int init_kmsg(struct dmesg_control *ctl)
 	 * the last SYSLOG_ACTION_CLEAR was issued.
 	 *
 	 * ... otherwise SYSLOG_ACTION_CLEAR will have no effect for kmsg.
+	 *
+	 * The kmsg does not support seek to a sequence number, so for
+	 * --since-seq and --cursor-file read from the first record and
+	 * skip the old records in parse_kmsg_record().
 	 */
-	lseek(ctl->kmsg, 0, ctl->end ? SEEK_END : SEEK_DATA);
+	lseek(ctl->kmsg, 0, ctl->seq ? SEEK_SET :
+			    ctl->end ? SEEK_END : SEEK_DATA);
 
 	/*
 	 * Old kernels (<3.5) can successfully open /dev/kmsg for read-only,
@@ -1192,7 +1334,7 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 
 	/* A) priority and facility */
 	if (ctl->fltr_lev || ctl->fltr_fac || ctl->decode ||
-	    ctl->raw || ctl->color)
+	    ctl->raw || ctl->color || ctl->json)
 		p = parse_faclev(p, &rec->facility, &rec->level);
 	else
 		p = skip_item(p, end, ",");
@@ -1200,6 +1342,17 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 		goto mesg;
 
 	/* B) sequence number */
+	if (ctl->seq || ctl->json) {
+		char *e;
+
+		errno = 0;
+		rec->seq = strtoull(p, &e, 10);
+		if (errno || e == p)
+			return -1;
+		if (ctl->seq && rec->seq < ctl->since_seq)
+			return 1;	/* already printed */
+		ctl->next_seq = rec->seq + 1;
+	}
 	p = skip_item(p, end, ",;");
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
@@ -1212,8 +1365,22 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
 
-	/* D) optional fields (ignore) */
-	p = skip_item(p, end, ";");
+	/* D) optional fields (ignore all but caller ID for JSON) */
+	if (ctl->json) {
+		const char *f = p;
+
+		p = skip_item(p, end, ";");
+		while (f < p) {
+			const char *next = skip_item(f, p, ",;");
+
+			if (next - f > 8 && strncmp(f, "caller=", 7) == 0) {
+				rec->caller = f + 7;
+				rec->caller_size = next - 1 - rec->caller;
+			}
+			f = next;
+		}
+	} else
+		p = skip_item(p, end, ";");
 
 mesg:
 	/* E) message text */
@@ -1248,6 +1415,45 @@ mesg:
 	return 0;
 }
 
+/*
+ * The cursor file contains the sequence number of the next record (the
+ * first not yet printed record). The --since-seq has higher priority than
+ * the cursor from the file (@keep_seq).
+ */
+static void load_cursor(struct dmesg_control *ctl, int keep_seq)
+{
+	char buf[32];
+	ssize_t sz;
+
+	ctl->cursor_fd = open(ctl->cursor_file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (ctl->cursor_fd < 0)
+		err(EXIT_FAILURE, _("cannot open %s"), ctl->cursor_file);
+
+	sz = read_all(ctl->cursor_fd, buf, sizeof(buf) - 1);
+	if (sz < 0)
+		err(EXIT_FAILURE, _("cannot read %s"), ctl->cursor_file);
+	buf[sz] = '\0';
+
+	rtrim_whitespace((unsigned char *) buf);
+	if (*buf && !keep_seq)
+		ctl->since_seq = strtou64_or_err(buf, _("invalid cursor file content"));
+	ctl->next_seq = ctl->since_seq;
+}
+
+static void save_cursor(struct dmesg_control *ctl)
+{
+	char buf[32];
+	int len;
+
+	/* records are already printed, flush before the cursor is moved */
+	fflush(stdout);
+
+	len = snprintf(buf, sizeof(buf), "%" PRIu64 "\n", ctl->next_seq);
+	if (pwrite(ctl->cursor_fd, buf, len, 0) != len
+	    || ftruncate(ctl->cursor_fd, len) != 0)
+		err(EXIT_FAILURE, _("cannot write %s"), ctl->cursor_file);
+}
+
 /*
  * Note that each read() call for /dev/kmsg returns always one record. It means
  * that we don't have to read whole message buffer before the records parsing.
@@ -1276,12 +1482,17 @@ static int read_kmsg(struct dmesg_control *ctl)
 		*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
 
 		if (parse_kmsg_record(ctl, &rec,
-				      ctl->kmsg_buf, (size_t) sz) == 0)
+				      ctl->kmsg_buf, (size_t) sz) == 0) {
 			print_record(ctl, &rec);
+			if (ctl->follow && ctl->cursor_file)
+				save_cursor(ctl);
+		}
 
 		sz = read_kmsg_one(ctl);
 	}
 
+	if (ctl->cursor_file)
+		save_cursor(ctl);
 	return 0;
 }
 
@@ -1333,6 +1544,7 @@ int main(int argc, char *argv[])
 	int  console_level = 0;
 	int  klog_rc = 0;
 	int  delta = 0;
+	int  since_seq = 0;
 	ssize_t n;
 	static struct dmesg_control ctl = {
 		.filename = NULL,
@@ -1347,7 +1559,10 @@ int main(int argc, char *argv[])
 		OPT_TIME_FORMAT = CHAR_MAX + 1,
 		OPT_NOESC,
 		OPT_SINCE,
-		OPT_UNTIL
+		OPT_UNTIL,
+		OPT_SINCE_SEQ,
+		OPT_CURSOR_FILE,
+		OPT_NDJSON
 	};
 
 	static const struct option longopts[] = {
@@ -1363,10 +1578,14 @@ int main(int argc, char *argv[])
 		{ "follow",        no_argument,       NULL, 'w' },
 		{ "follow-new",    no_argument,       NULL, 'W' },
 		{ "human",         no_argument,       NULL, 'H' },
+		{ "json",          no_argument,       NULL, 'J' },
+		{ "ndjson",        no_argument,       NULL, OPT_NDJSON },
 		{ "help",          no_argument,	      NULL, 'h' },
 		{ "kernel",        no_argument,       NULL, 'k' },
 		{ "level",         required_argument, NULL, 'l' },
 		{ "since",	   required_argument, NULL, OPT_SINCE },
+		{ "since-seq",     required_argument, NULL, OPT_SINCE_SEQ },
+		{ "cursor-file",   required_argument, NULL, OPT_CURSOR_FILE },
 		{ "syslog",        no_argument,       NULL, 'S' },
 		{ "raw",           no_argument,       NULL, 'r' },
 		{ "read-clear",    no_argument,	      NULL, 'c' },
@@ -1386,10 +1605,13 @@ int main(int argc, char *argv[])
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
 		{ 'C','D','E','c','n','r' },	/* clear,off,on,read-clear,level,raw*/
-		{ 'H','r' },			/* human, raw */
+		{ 'H','J','r' },		/* human, json, raw */
+		{ 'J','r', OPT_NDJSON },	/* json, raw, ndjson */
 		{ 'L','r' },			/* color, raw */
 		{ 'S','w' },			/* syslog,follow */
 		{ 'T','r' },			/* ctime, raw */
+		{ 'W', OPT_SINCE_SEQ },		/* follow-new, since-seq */
+		{ 'W', OPT_CURSOR_FILE },	/* follow-new, cursor-file */
 		{ 'd','r' },			/* delta, raw */
 		{ 'e','r' },			/* reltime, raw */
 		{ 'r','x' },			/* raw, decode */
@@ -1402,8 +1624,9 @@ int main(int argc, char *argv[])
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	close_stdout_atexit();
+	ul_jsonwrt_init(&ctl.jfmt, stdout, 0);
 
-	while ((c = getopt_long(argc, argv, "CcDdEeF:f:HhkL::l:n:iPprSs:TtuVWwx",
+	while ((c = getopt_long(argc, argv, "CcDdEeF:f:HhJkL::l:n:iPprSs:TtuVWwx",
 				longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
@@ -1437,6 +1660,13 @@ int main(int argc, char *argv[])
 					     ctl.facilities, parse_facility) < 0)
 				return EXIT_FAILURE;
 			break;
+		case 'J':
+			ctl.json = 1;
+			break;
+		case OPT_NDJSON:
+			ctl.json = 1;
+			ul_jsonwrt_enable_compact(&ctl.jfmt, 1);
+			break;
 		case 'H':
 			ctl.time_fmt = DMESG_TIMEFTM_RELTIME;
 			colormode = UL_COLORMODE_AUTO;
@@ -1523,6 +1753,14 @@ int main(int argc, char *argv[])
 			ctl.until = (time_t) (p / 1000000);
 			break;
 		}
+		case OPT_SINCE_SEQ:
+			ctl.since_seq = strtou64_or_err(optarg, _("invalid sequence number"));
+			ctl.seq = since_seq = 1;
+			break;
+		case OPT_CURSOR_FILE:
+			ctl.cursor_file = optarg;
+			ctl.seq = 1;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1564,7 +1802,7 @@ int main(int argc, char *argv[])
 		}
 
 
-	ctl.color = colors_init(colormode, "dmesg") ? 1 : 0;
+	ctl.color = !ctl.json && colors_init(colormode, "dmesg") ? 1 : 0;
 	if (ctl.follow)
 		nopager = 1;
 	ctl.pager = nopager ? 0 : ctl.pager;
@@ -1577,6 +1815,12 @@ int main(int argc, char *argv[])
 		if (ctl.method == DMESG_METHOD_KMSG && init_kmsg(&ctl) != 0)
 			ctl.method = DMESG_METHOD_SYSLOG;
 
+		if (ctl.seq && ctl.method != DMESG_METHOD_KMSG)
+			errx(EXIT_FAILURE, _("--since-seq and --cursor-file are supported "
+				"only when reading messages from /dev/kmsg"));
+		if (ctl.cursor_file)
+			load_cursor(&ctl, since_seq);
+
 		if (ctl.raw
 		    && ctl.method != DMESG_METHOD_KMSG
 		    && (ctl.fltr_lev || ctl.fltr_fac))
@@ -1589,9 +1833,23 @@ int main(int argc, char *argv[])
 
 		if (ctl.pager)
 			pager_redirect();
+		/*
+		 * The default stdio buffer is small for large logs; --follow
+		 * uses line buffered output (see init_kmsg()).
+		 */
+		if (!ctl.follow)
+			setvbuf(stdout, NULL, _IOFBF, DMESG_OUTBUF_SIZE);
+		if (ctl.json && !ctl.jfmt.compact) {
+			ul_jsonwrt_root_open(&ctl.jfmt);
+			ul_jsonwrt_array_open(&ctl.jfmt, "dmesg");
+		}
 		n = read_buffer(&ctl, &buf);
 		if (n > 0)
 			print_buffer(&ctl, buf, n);
+		if (ctl.json && !ctl.jfmt.compact) {
+			ul_jsonwrt_array_close(&ctl.jfmt);
+			ul_jsonwrt_root_close(&ctl.jfmt);
+		}
 		if (!ctl.mmap_buff)
 			free(buf);
 		if (ctl.kmsg >= 0)
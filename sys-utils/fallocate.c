@@ -34,6 +34,14 @@
 #include <limits.h>
 #include <string.h>
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
 #ifndef HAVE_FALLOCATE
 # include <sys/syscall.h>
 #endif
@@ -72,6 +80,7 @@
 #include "closestream.h"
 #include "xalloc.h"
 #include "optutils.h"
+#include "monotonic.h"
 
 static int verbose;
 static char *filename;
@@ -82,6 +91,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
 	      _(" %s [options] <filename>\n"), program_invocation_short_name);
+	fprintf(out,
+	      _(" %s [options] --batch <file>\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Preallocate space to, or deallocate space from a file.\n"), out);
@@ -90,6 +101,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --collapse-range remove a range from the file\n"), out);
 	fputs(_(" -d, --dig-holes      detect zeroes and replace with holes\n"), out);
 	fputs(_(" -i, --insert-range   insert a hole at range, shifting existing data\n"), out);
+	fputs(_(" -j, --parallel <num> use <num> threads for --dig-holes or --batch\n"), out);
 	fputs(_(" -l, --length <num>   length for range operations, in bytes\n"), out);
 	fputs(_(" -n, --keep-size      maintain the apparent size of the file\n"), out);
 	fputs(_(" -o, --offset <num>   offset for range operations, in bytes\n"), out);
@@ -99,6 +111,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -x, --posix          use posix_fallocate(3) instead of fallocate(2)\n"), out);
 #endif
 	fputs(_(" -v, --verbose        verbose mode\n"), out);
+	fputs(_("     --batch <file>   process files listed in <file>\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(22));
@@ -121,15 +134,19 @@ static loff_t cvtnum(char *s)
 	return x;
 }
 
-static void xfallocate(int fd, int mode, off_t offset, off_t length)
+static int do_fallocate(int fd, int mode, off_t offset, off_t length)
 {
-	int error;
-
 #ifdef HAVE_FALLOCATE
-	error = fallocate(fd, mode, offset, length);
+	return fallocate(fd, mode, offset, length);
 #else
-	error = syscall(SYS_fallocate, fd, mode, offset, length);
+	return syscall(SYS_fallocate, fd, mode, offset, length);
 #endif
+}
+
+static void xfallocate(int fd, int mode, off_t offset, off_t length)
+{
+	int error = do_fallocate(fd, mode, offset, length);
+
 	/*
 	 * EOPNOTSUPP: The FALLOC_FL_KEEP_SIZE is unsupported
 	 * ENOSYS: The filesystem does not support sys_fallocate
@@ -151,39 +168,119 @@ static void xposix_fallocate(int fd, off_t offset, off_t length)
 }
 #endif
 
-/* The real buffer size has to be bufsize + sizeof(uintptr_t) */
-static int is_nul(void *buf, size_t bufsize)
+/*
+ * Returns 1 if the buffer contains only zeros. The data are OR-ed in 64-byte
+ * steps and tested once per step, the buffers are usually zero or non-zero
+ * in the first step.
+ */
+#if defined(__GNUC__) && defined(__SSE2__)
+static int is_nul(const void *buf, size_t bufsize)
+{
+	const unsigned char *p = buf;
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; bufsize >= 64; bufsize -= 64, p += 64) {
+		__m128i v = _mm_or_si128(
+			_mm_or_si128(_mm_loadu_si128((const __m128i *) p),
+				     _mm_loadu_si128((const __m128i *) (p + 16))),
+			_mm_or_si128(_mm_loadu_si128((const __m128i *) (p + 32)),
+				     _mm_loadu_si128((const __m128i *) (p + 48))));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xffff)
+			return 0;
+	}
+	for (; bufsize; bufsize--, p++) {
+		if (*p)
+			return 0;
+	}
+	return 1;
+}
+#else
+static int is_nul(const void *buf, size_t bufsize)
 {
-	typedef uintptr_t word;
-	void const *vp;
-	char const *cbuf = buf, *cp;
-	word const *wp = buf;
+	const unsigned char *p = buf;
+
+	for (; bufsize >= 8 * sizeof(uint64_t); bufsize -= 8 * sizeof(uint64_t)) {
+		uint64_t w[8], v = 0;
+		size_t i;
+
+		memcpy(w, p, sizeof(w));
+		for (i = 0; i < ARRAY_SIZE(w); i++)
+			v |= w[i];
+		if (v)
+			return 0;
+		p += sizeof(w);
+	}
+	for (; bufsize; bufsize--, p++) {
+		if (*p)
+			return 0;
+	}
+	return 1;
+}
+#endif
+
+/* read size for --dig-holes, rounded up to the filesystem I/O block size */
+#define DIG_BUFSIZ		(1024 * 1024)
 
-	/* set sentinel */
-	memset((char *) buf + bufsize, '\1', sizeof(word));
+/* the file is split to ranges of this size for --parallel */
+#define DIG_PARALLEL_STEP	(256 * 1024 * 1024)
 
-	/* Find first nonzero *word*, or the word with the sentinel.  */
-	while (*wp++ == 0)
-		continue;
+/* O_DIRECT offsets, sizes and buffers alignment */
+#define DIG_DIRECT_ALIGN	4096
 
-	/* Find the first nonzero *byte*, or the sentinel.  */
-	vp = wp - 1;
-	cp = vp;
+struct dig_control {
+	int	fd;		/* read-write, holes are punched by this fd */
+	int	dfd;		/* O_DIRECT read-only fd or -1 */
+	size_t	blksz;		/* hole detection granularity */
+	size_t	bufsz;		/* read size */
 
-	while (*cp++ == 0)
-		continue;
+	off_t	next;		/* begin of the next range (--parallel) */
+	off_t	end;
+	off_t	step;
+
+	uintmax_t ct;		/* bytes converted to holes */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t lock;
+#endif
+};
+
+static char *dig_alloc_buffer(struct dig_control *ctl)
+{
+	char *buf;
 
-	return cbuf + bufsize < cp;
+	if (posix_memalign((void **) &buf, DIG_DIRECT_ALIGN, ctl->bufsz) != 0)
+		err_oom();
+	return buf;
 }
 
-static void dig_holes(int fd, off_t file_off, off_t len)
+/*
+ * Reads up to @len bytes from @off. The O_DIRECT fd is used for aligned
+ * offsets only; if the filesystem refuses the request then *direct is
+ * zeroed and the page cache is used for the rest of the range.
+ */
+static ssize_t dig_read(struct dig_control *ctl, char *buf, size_t len,
+			off_t off, int *direct)
+{
+	if (*direct && off % DIG_DIRECT_ALIGN == 0) {
+		size_t dlen = min(ctl->bufsz,
+				  (len + DIG_DIRECT_ALIGN - 1) & ~((size_t) DIG_DIRECT_ALIGN - 1));
+		ssize_t rsz = pread(ctl->dfd, buf, dlen, off);
+
+		if (rsz >= 0 || errno != EINVAL)
+			return rsz;
+		*direct = 0;
+	}
+	return pread(ctl->fd, buf, len, off);
+}
+
+/* Dig holes in <file_off, file_end), returns number of converted bytes */
+static uintmax_t dig_range(struct dig_control *ctl, char *buf,
+			   off_t file_off, off_t file_end)
 {
-	off_t file_end = len ? file_off + len : 0;
 	off_t hole_start = 0, hole_sz = 0;
 	uintmax_t ct = 0;
-	size_t  bufsz;
-	char *buf;
-	struct stat st;
+	int fd = ctl->fd;
+	int direct = ctl->dfd >= 0;
 #if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
 	off_t cache_start = file_off;
 	/*
@@ -197,63 +294,62 @@ static void dig_holes(int fd, off_t file_off, off_t len)
 	const size_t cachesz = getpagesize() * 256;
 #endif
 
-	if (fstat(fd, &st) != 0)
-		err(EXIT_FAILURE, _("stat of %s failed"), filename);
-
-	bufsz = st.st_blksize;
-
-	if (lseek(fd, file_off, SEEK_SET) < 0)
-		err(EXIT_FAILURE, _("seek on %s failed"), filename);
-
-	/* buffer + extra space for is_nul() sentinel */
-	buf = xmalloc(bufsz + sizeof(uintptr_t));
-	while (file_end == 0 || file_off < file_end) {
+	while (file_off < file_end) {
 		/*
 		 * Detect data area (skip holes)
 		 */
 		off_t end, off;
+		int clipped = 0;
 
 		off = lseek(fd, file_off, SEEK_DATA);
-		if ((off == -1 && errno == ENXIO) ||
-		    (file_end && off >= file_end))
+		if ((off == -1 && errno == ENXIO) || off >= file_end)
 			break;
 
 		end = lseek(fd, off, SEEK_HOLE);
-		if (file_end && end > file_end)
+		if (end > file_end) {
 			end = file_end;
+			clipped = 1;
+		}
 
 		if (off < 0 || end < 0)
 			break;
 
 #if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
-		(void) posix_fadvise(fd, off, end, POSIX_FADV_SEQUENTIAL);
+		if (!direct)
+			(void) posix_fadvise(fd, off, end - off, POSIX_FADV_SEQUENTIAL);
 #endif
 		/*
 		 * Dig holes in the area
 		 */
 		while (off < end) {
-			ssize_t rsz = pread(fd, buf, bufsz, off);
+			size_t i, len = min(ctl->bufsz, (size_t) (end - off));
+			ssize_t rsz = dig_read(ctl, buf, len, off, &direct);
+
 			if (rsz < 0 && errno)
 				err(EXIT_FAILURE, _("%s: read failed"), filename);
-			if (end && rsz > 0 && off > end - rsz)
+			if (rsz > 0 && off > end - rsz)
 				rsz = end - off;
 			if (rsz <= 0)
 				break;
 
-			if (is_nul(buf, rsz)) {
-				if (!hole_sz)				/* new hole detected */
-					hole_start = off;
-				hole_sz += rsz;
-			 } else if (hole_sz) {
-				xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
-					   hole_start, hole_sz);
-				ct += hole_sz;
-				hole_sz = hole_start = 0;
+			for (i = 0; i < (size_t) rsz; i += ctl->blksz) {
+				size_t sz = min(ctl->blksz, (size_t) rsz - i);
+
+				if (is_nul(buf + i, sz)) {
+					if (!hole_sz)			/* new hole detected */
+						hole_start = off + i;
+					hole_sz += sz;
+				} else if (hole_sz) {
+					xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
+						   hole_start, hole_sz);
+					ct += hole_sz;
+					hole_sz = hole_start = 0;
+				}
 			}
 
 #if defined(POSIX_FADV_DONTNEED) && defined(HAVE_POSIX_FADVISE)
 			/* discard cached data */
-			if (off - cache_start > (off_t) cachesz) {
+			if (!direct && off - cache_start > (off_t) cachesz) {
 				size_t clen = off - cache_start;
 
 				clen = (clen / cachesz) * cachesz;
@@ -265,25 +361,353 @@ static void dig_holes(int fd, off_t file_off, off_t len)
 		}
 		if (hole_sz) {
 			off_t alloc_sz = hole_sz;
-			if (off >= end)
-				alloc_sz += st.st_blksize;		/* meet block boundary */
+
+			/* meet block boundary, but don't touch data behind the range */
+			if (off >= end && !clipped)
+				alloc_sz += ctl->blksz;
 			xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
 					hole_start, alloc_sz);
 			ct += hole_sz;
+			hole_sz = hole_start = 0;
 		}
 		file_off = off;
 	}
 
+	return ct;
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *dig_worker(void *data)
+{
+	struct dig_control *ctl = data;
+	char *buf = dig_alloc_buffer(ctl);
+
+	for (;;) {
+		off_t begin, end;
+		uintmax_t ct;
+
+		pthread_mutex_lock(&ctl->lock);
+		if (ctl->next >= ctl->end) {
+			pthread_mutex_unlock(&ctl->lock);
+			break;
+		}
+		begin = ctl->next;
+		end = min(ctl->end, begin + ctl->step);
+		ctl->next = end;
+		pthread_mutex_unlock(&ctl->lock);
+
+		ct = dig_range(ctl, buf, begin, end);
+
+		pthread_mutex_lock(&ctl->lock);
+		ctl->ct += ct;
+		pthread_mutex_unlock(&ctl->lock);
+	}
+
 	free(buf);
+	return NULL;
+}
+
+static void dig_parallel(struct dig_control *ctl, unsigned int nthreads)
+{
+	pthread_t *threads;
+	unsigned int i, nrun;
+
+	pthread_mutex_init(&ctl->lock, NULL);
+
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, dig_worker, ctl) != 0)
+			break;
+	}
+	if (!nrun)
+		dig_worker(ctl);
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	pthread_mutex_destroy(&ctl->lock);
+}
+#endif /* HAVE_LIBPTHREAD */
+
+static void dig_holes(int fd, off_t file_off, off_t len, unsigned int nthreads)
+{
+	struct dig_control ctl = { .fd = fd, .dfd = -1 };
+	struct stat st;
+
+	if (fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), filename);
+
+	if (lseek(fd, file_off, SEEK_SET) < 0)
+		err(EXIT_FAILURE, _("seek on %s failed"), filename);
+
+	ctl.blksz = st.st_blksize;
+	ctl.bufsz = max((size_t) DIG_BUFSIZ / ctl.blksz, (size_t) 1) * ctl.blksz;
+	ctl.end = len ? file_off + len : st.st_size;
+
+#ifdef O_DIRECT
+	/* read by O_DIRECT to avoid page cache, the blocks have to be aligned */
+	if (ctl.blksz % DIG_DIRECT_ALIGN == 0)
+		ctl.dfd = open(filename, O_RDONLY | O_DIRECT | O_CLOEXEC);
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+	if (nthreads > 1 && ctl.end - file_off > DIG_PARALLEL_STEP) {
+		ctl.next = file_off;
+		/* the ranges begin on I/O block boundaries */
+		ctl.step = DIG_PARALLEL_STEP - DIG_PARALLEL_STEP % ctl.blksz;
+		dig_parallel(&ctl, nthreads);
+	} else
+#endif
+	{
+		char *buf = dig_alloc_buffer(&ctl);
+
+		ctl.ct = dig_range(&ctl, buf, file_off, ctl.end);
+		free(buf);
+	}
+	(void) nthreads;
+
+	if (ctl.dfd >= 0)
+		close(ctl.dfd);
 
 	if (verbose) {
-		char *str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, ct);
+		char *str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, ctl.ct);
 		fprintf(stdout, _("%s: %s (%ju bytes) converted to sparse holes.\n"),
-				filename, str, ct);
+				filename, str, ctl.ct);
 		free(str);
 	}
 }
 
+/* default number of threads for --batch */
+#define BATCH_NTHREADS		4
+
+/* private --batch mode flag, not used by fallocate(2) */
+#define BATCH_POSIX		(1 << 30)
+
+struct batch_file {
+	char	*path;
+	off_t	length;
+	int	mode;		/* FALLOC_FL_* or BATCH_POSIX */
+};
+
+struct batch_control {
+	struct batch_file *files;
+	size_t	nfiles;
+	size_t	next;		/* the next file for a thread */
+	off_t	offset;		/* --offset */
+
+	uintmax_t bytes;	/* successfully processed bytes */
+	size_t	nfailed;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t lock;
+#endif
+};
+
+static const struct batch_mode {
+	const char *name;
+	int mode;
+} batch_modes[] = {
+	{ "allocate",       0 },
+	{ "collapse-range", FALLOC_FL_COLLAPSE_RANGE },
+	{ "insert-range",   FALLOC_FL_INSERT_RANGE },
+	{ "keep-size",      FALLOC_FL_KEEP_SIZE },
+	{ "posix",          BATCH_POSIX },
+	{ "punch-hole",     FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE },
+	{ "zero-range",     FALLOC_FL_ZERO_RANGE }
+};
+
+static long batch_mode_to_flag(const char *name, size_t namesz)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(batch_modes); i++) {
+		const char *cn = batch_modes[i].name;
+
+		if (!strncmp(name, cn, namesz) && !cn[namesz])
+			return batch_modes[i].mode;
+	}
+	warnx(_("unknown mode: %s"), name);
+	return -1;
+}
+
+/*
+ * The batch file format is "<filename> [<length> [<mode>,...]]" per line,
+ * the default length is --length and the default mode is defined by the
+ * command line options. Empty lines and lines starting with '#' are ignored.
+ */
+static void batch_read(struct batch_control *bc, const char *batch,
+		       off_t def_length, int def_mode)
+{
+	FILE *f;
+	char *line = NULL;
+	size_t sz = 0, nalloc = 0, lineno = 0;
+
+	if (strcmp(batch, "-") == 0)
+		f = stdin;
+	else if (!(f = fopen(batch, "r" UL_CLOEXECSTR)))
+		err(EXIT_FAILURE, _("cannot open %s"), batch);
+
+	while (getline(&line, &sz, f) >= 0) {
+		char *path, *length, *mode, *x;
+		struct batch_file *bf;
+
+		lineno++;
+		path = strtok_r(line, " \t\n", &x);
+		if (!path || *path == '#')
+			continue;
+		length = strtok_r(NULL, " \t\n", &x);
+		mode = length ? strtok_r(NULL, " \t\n", &x) : NULL;
+
+		if (bc->nfiles == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			bc->files = xrealloc(bc->files, nalloc * sizeof(*bf));
+		}
+		bf = &bc->files[bc->nfiles];
+		bf->path = xstrdup(path);
+		bf->length = length ? cvtnum(length) : def_length;
+		bf->mode = def_mode;
+
+		if (bf->length == -2LL)
+			errx(EXIT_FAILURE, _("%s:%zu: no length specified"), batch, lineno);
+		if (bf->length <= 0)
+			errx(EXIT_FAILURE, _("%s:%zu: invalid length value specified"), batch, lineno);
+		if (mode) {
+			unsigned long mask = 0;
+
+			if (string_to_bitmask(mode, &mask, batch_mode_to_flag))
+				errx(EXIT_FAILURE, _("%s:%zu: invalid mode"), batch, lineno);
+			if ((mask & BATCH_POSIX) && mask != BATCH_POSIX)
+				errx(EXIT_FAILURE, _("%s:%zu: posix mode cannot be combined"), batch, lineno);
+			bf->mode = mask;
+		}
+		bc->nfiles++;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+}
+
+/* Returns 0 on success, or -1 and errno */
+static int batch_file_fallocate(struct batch_control *bc, struct batch_file *bf)
+{
+	int fd, rc;
+
+	fd = open(bf->path, O_RDWR | O_CLOEXEC | (!(bf->mode & ~BATCH_POSIX) ? O_CREAT : 0),
+		  S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+	if (fd < 0)
+		return -1;
+
+	if (bf->mode & BATCH_POSIX) {
+#ifdef HAVE_POSIX_FALLOCATE
+		rc = posix_fallocate(fd, bc->offset, bf->length);
+		if (rc) {
+			errno = rc;
+			rc = -1;
+		}
+#else
+		errno = ENOSYS;
+		rc = -1;
+#endif
+	} else
+		rc = do_fallocate(fd, bf->mode, bc->offset, bf->length);
+
+	if (close_fd(fd) != 0 && !rc)
+		rc = -1;
+	return rc;
+}
+
+static void *batch_worker(void *data)
+{
+	struct batch_control *bc = data;
+
+	for (;;) {
+		struct batch_file *bf;
+		int rc;
+
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_lock(&bc->lock);
+#endif
+		bf = bc->next < bc->nfiles ? &bc->files[bc->next++] : NULL;
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_unlock(&bc->lock);
+#endif
+		if (!bf)
+			break;
+
+		rc = batch_file_fallocate(bc, bf);
+		if (rc)
+			warn(_("%s: fallocate failed"), bf->path);
+		else if (verbose > 1)
+			printf(_("%s: %ju bytes\n"), bf->path, (uintmax_t) bf->length);
+
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_lock(&bc->lock);
+#endif
+		if (rc)
+			bc->nfailed++;
+		else
+			bc->bytes += bf->length;
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_unlock(&bc->lock);
+#endif
+	}
+	return NULL;
+}
+
+static int fallocate_batch(const char *batch, off_t offset, off_t length,
+			   int mode, unsigned int nthreads)
+{
+	struct batch_control bc = { .offset = offset };
+	struct timeval start, end;
+	double sec;
+	size_t i;
+
+	batch_read(&bc, batch, length, mode);
+	gettime_monotonic(&start);
+
+#ifdef HAVE_LIBPTHREAD
+	nthreads = min((size_t) nthreads, bc.nfiles);
+	if (nthreads > 1) {
+		pthread_t *threads = xcalloc(nthreads, sizeof(pthread_t));
+		unsigned int nrun;
+
+		pthread_mutex_init(&bc.lock, NULL);
+		for (nrun = 0; nrun < nthreads; nrun++) {
+			if (pthread_create(&threads[nrun], NULL, batch_worker, &bc) != 0)
+				break;
+		}
+		if (!nrun)
+			batch_worker(&bc);
+		for (i = 0; i < nrun; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+		pthread_mutex_destroy(&bc.lock);
+	} else
+#endif
+		batch_worker(&bc);
+	(void) nthreads;
+
+	gettime_monotonic(&end);
+	sec = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+	if (verbose) {
+		char *str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, bc.bytes);
+		char *rate = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE,
+						  sec > 0 ? bc.bytes / sec : bc.bytes);
+
+		printf(_("%zu of %zu files (%s) processed in %.3f seconds, %s/s\n"),
+			bc.nfiles - bc.nfailed, bc.nfiles, str, sec, rate);
+		free(str);
+		free(rate);
+	}
+
+	for (i = 0; i < bc.nfiles; i++)
+		free(bc.files[i].path);
+	free(bc.files);
+
+	return bc.nfailed ? -1 : 0;
+}
+
 int main(int argc, char **argv)
 {
 	int	c;
@@ -291,9 +715,14 @@ int main(int argc, char **argv)
 	int	mode = 0;
 	int	dig = 0;
 	int posix = 0;
+	unsigned int nthreads = 0;
 	loff_t	length = -2LL;
 	loff_t	offset = 0;
+	const char *batch = NULL;
 
+	enum {
+		OPT_BATCH = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 	    { "help",           no_argument,       NULL, 'h' },
 	    { "version",        no_argument,       NULL, 'V' },
@@ -302,17 +731,20 @@ int main(int argc, char **argv)
 	    { "collapse-range", no_argument,       NULL, 'c' },
 	    { "dig-holes",      no_argument,       NULL, 'd' },
 	    { "insert-range",   no_argument,       NULL, 'i' },
+	    { "parallel",       required_argument, NULL, 'j' },
 	    { "zero-range",     no_argument,       NULL, 'z' },
 	    { "offset",         required_argument, NULL, 'o' },
 	    { "length",         required_argument, NULL, 'l' },
 	    { "posix",          no_argument,       NULL, 'x' },
 	    { "verbose",        no_argument,       NULL, 'v' },
+	    { "batch",          required_argument, NULL, OPT_BATCH },
 	    { NULL, 0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
 		{ 'c', 'd', 'p', 'z' },
 		{ 'c', 'n' },
+		{ 'd', OPT_BATCH },
 		{ 'x', 'c', 'd', 'i', 'n', 'p', 'z'},
 		{ 0 }
 	};
@@ -323,7 +755,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "hvVncpdizxl:o:", longopts, NULL))
+	while ((c = getopt_long(argc, argv, "hvVncpdizxj:l:o:", longopts, NULL))
 			!= -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
@@ -338,6 +770,13 @@ int main(int argc, char **argv)
 		case 'i':
 			mode |= FALLOC_FL_INSERT_RANGE;
 			break;
+		case 'j':
+			nthreads = strtou32_or_err(optarg, _("invalid number of threads argument"));
+			if (nthreads == 0) {
+				long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+				nthreads = ncpus > 0 ? ncpus : 1;
+			}
+			break;
 		case 'l':
 			length = cvtnum(optarg);
 			break;
@@ -363,6 +802,9 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose++;
 			break;
+		case OPT_BATCH:
+			batch = optarg;
+			break;
 
 		case 'h':
 			usage();
@@ -373,6 +815,21 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (batch) {
+		if (optind != argc)
+			errx(EXIT_FAILURE, _("unexpected number of arguments"));
+		if (length != -2LL && length <= 0)
+			errx(EXIT_FAILURE, _("invalid length value specified"));
+		if (offset < 0)
+			errx(EXIT_FAILURE, _("invalid offset value specified"));
+		if (posix)
+			mode = BATCH_POSIX;
+
+		return fallocate_batch(batch, offset, length, mode,
+				       nthreads ? nthreads : BATCH_NTHREADS) == 0 ?
+			EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	if (optind == argc)
 		errx(EXIT_FAILURE, _("no filename specified"));
 
@@ -405,7 +862,7 @@ int main(int argc, char **argv)
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
 
 	if (dig)
-		dig_holes(fd, offset, length);
+		dig_holes(fd, offset, length, nthreads ? nthreads : 1);
 #ifdef HAVE_POSIX_FALLOCATE
 	else if (posix)
 		xposix_fallocate(fd, offset, length);
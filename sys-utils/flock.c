@@ -38,11 +38,16 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#ifdef HAVE_INOTIFY_INIT1
+# include <sys/inotify.h>
+#endif
 
 #include "c.h"
 #include "nls.h"
 #include "strutils.h"
 #include "closestream.h"
+#include "env.h"
+#include "xalloc.h"
 #include "monotonic.h"
 #include "timer.h"
 
@@ -52,7 +57,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	printf(
 		_(" %1$s [options] <file>|<directory> <command> [<argument>...]\n"
 		  " %1$s [options] <file>|<directory> -c <command>\n"
-		  " %1$s [options] <file descriptor number>\n"),
+		  " %1$s [options] <file descriptor number>\n"
+		  " %1$s [options] --slots <number> <directory> <command> [<argument>...]\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, stdout);
@@ -68,6 +74,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(  " -o, --close              close file descriptor before running command\n"), stdout);
 	fputs(_(  " -c, --command <command>  run a single command string through the shell\n"), stdout);
 	fputs(_(  " -F, --no-fork            execute command without forking\n"), stdout);
+	fputs(_(  "     --slots <number>     lock the first free of <number> files in <directory>\n"), stdout);
 	fputs(_(  "     --verbose            increase verbosity\n"), stdout);
 	fputs(USAGE_SEPARATOR, stdout);
 	printf(USAGE_HELP_OPTIONS(26));
@@ -116,6 +123,126 @@ static int open_file(const char *filename, int *flags)
 	return fd;
 }
 
+/* flock() which is interrupted only by the timeout */
+static int flock_wait(int fd, int op)
+{
+	while (flock(fd, op)) {
+		if (errno != EINTR || timeout_expired)
+			return -1;
+	}
+	return 0;
+}
+
+static void __attribute__((__noreturn__)) lock_failed(const char *name,
+						      int conflict_exit_code,
+						      int verbose)
+{
+	switch (errno) {
+	case EWOULDBLOCK:
+		if (verbose)
+			warnx(_("failed to get lock"));
+		exit(conflict_exit_code);
+	case EINTR:
+		if (verbose)
+			warnx(_("timeout while waiting to get lock"));
+		exit(conflict_exit_code);
+	default:
+		warn("%s", name);
+		exit((errno == ENOLCK || errno == ENOMEM) ? EX_OSERR : EX_DATAERR);
+	}
+}
+
+/*
+ * --slots: lock the first free of <dir>/slot.<n> files. The waiting processes
+ * are queued by the lock on the directory, and only the first of them waits
+ * for a free slot. It's woken up by inotify when a slot file is closed, so
+ * the slots are not polled and the waiters don't compete for a released slot.
+ */
+static int lock_slot(const char *dir, unsigned int nslots, int block,
+		     int conflict_exit_code, int verbose, unsigned int *slot)
+{
+	int dfd, ifd = -1, *fds, fd = -1;
+	unsigned int i;
+
+	dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dfd < 0 && errno == ENOENT &&
+	    (mkdir(dir, 0777) == 0 || errno == EEXIST))
+		dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dfd < 0) {
+		warn(_("cannot open lock directory %s"), dir);
+		exit(errno == ENOMEM || errno == EMFILE || errno == ENFILE ?
+				EX_OSERR : EX_NOINPUT);
+	}
+
+	/* the files are kept open, close() would wake up the waiter */
+	fds = xcalloc(nslots, sizeof(int));
+	for (i = 0; i < nslots; i++) {
+		char name[sizeof("slot.") + 10];
+
+		snprintf(name, sizeof(name), "slot.%u", i);
+		fds[i] = openat(dfd, name, O_RDONLY | O_NOCTTY | O_CREAT, 0666);
+		if (fds[i] < 0) {
+			warn(_("cannot open lock file %s/%s"), dir, name);
+			exit(errno == ENOMEM || errno == EMFILE || errno == ENFILE ?
+					EX_OSERR : EX_CANTCREAT);
+		}
+	}
+
+	if (!block) {
+		if (flock_wait(dfd, LOCK_EX) != 0)
+			lock_failed(dir, conflict_exit_code, verbose);
+#ifdef HAVE_INOTIFY_INIT1
+		ifd = inotify_init1(IN_CLOEXEC);
+		if (ifd >= 0 && inotify_add_watch(ifd, dir, IN_CLOSE) < 0) {
+			close(ifd);
+			ifd = -1;
+		}
+#endif
+	}
+
+	do {
+		for (i = 0; i < nslots; i++) {
+			if (flock(fds[i], LOCK_EX | LOCK_NB) == 0) {
+				fd = fds[i];
+				break;
+			}
+			if (errno != EWOULDBLOCK)
+				lock_failed(dir, conflict_exit_code, verbose);
+		}
+		if (fd >= 0)
+			break;
+		if (block)
+			lock_failed(dir, conflict_exit_code, verbose);
+
+		if (ifd < 0) {
+			/* no inotify, wait for a slot selected by PID */
+			i = getpid() % nslots;
+			if (flock_wait(fds[i], LOCK_EX) != 0)
+				lock_failed(dir, conflict_exit_code, verbose);
+			fd = fds[i];
+		} else {
+			char buf[1024]
+				__attribute__ ((__aligned__(__alignof__(struct inotify_event))));
+
+			/* any close in the directory; let's try all slots again */
+			if (read(ifd, buf, sizeof(buf)) < 0 && errno == EINTR &&
+			    timeout_expired)
+				lock_failed(dir, conflict_exit_code, verbose);
+		}
+	} while (fd < 0);
+
+	*slot = i;
+	for (i = 0; i < nslots; i++) {
+		if (fds[i] != fd)
+			close(fds[i]);
+	}
+	free(fds);
+	if (ifd >= 0)
+		close(ifd);
+	close(dfd);		/* the next waiter */
+	return fd;
+}
+
 static void __attribute__((__noreturn__)) run_program(char **cmd_argv)
 {
 	execvp(cmd_argv[0], cmd_argv);
@@ -138,6 +265,7 @@ int main(int argc, char *argv[])
 	int no_fork = 0;
 	int status;
 	int verbose = 0;
+	unsigned int nslots = 0, slot = 0;
 	struct timeval time_start, time_done;
 	/*
 	 * The default exit code for lock conflict or timeout
@@ -147,7 +275,8 @@ int main(int argc, char *argv[])
 	char **cmd_argv = NULL, *sh_c_argv[4];
 	const char *filename = NULL;
 	enum {
-		OPT_VERBOSE = CHAR_MAX + 1
+		OPT_VERBOSE = CHAR_MAX + 1,
+		OPT_SLOTS
 	};
 	static const struct option long_options[] = {
 		{"shared", no_argument, NULL, 's'},
@@ -161,6 +290,7 @@ int main(int argc, char *argv[])
 		{"close", no_argument, NULL, 'o'},
 		{"no-fork", no_argument, NULL, 'F'},
 		{"verbose", no_argument, NULL, OPT_VERBOSE},
+		{"slots", required_argument, NULL, OPT_SLOTS},
 		{"help", no_argument, NULL, 'h'},
 		{"version", no_argument, NULL, 'V'},
 		{NULL, 0, NULL, 0}
@@ -218,6 +348,11 @@ int main(int argc, char *argv[])
 		case OPT_VERBOSE:
 			verbose = 1;
 			break;
+		case OPT_SLOTS:
+			nslots = strtou32_or_err(optarg, _("invalid number of slots"));
+			if (!nslots)
+				errx(EX_USAGE, _("the number of slots must be greater than zero"));
+			break;
 
 		case 'V':
 			print_version(EX_OK);
@@ -231,6 +366,9 @@ int main(int argc, char *argv[])
 	if (no_fork && do_close)
 		errx(EX_USAGE,
 			_("the --no-fork and --close options are incompatible"));
+	if (nslots && type != LOCK_EX)
+		errx(EX_USAGE,
+			_("the --slots option requires an exclusive lock"));
 
 	if (argc > optind + 1) {
 		/* Run command */
@@ -252,8 +390,11 @@ int main(int argc, char *argv[])
 		}
 
 		filename = argv[optind];
-		fd = open_file(filename, &open_flags);
+		if (!nslots)
+			fd = open_file(filename, &open_flags);
 
+	} else if (nslots) {
+		errx(EX_USAGE, _("the --slots option requires a directory and a command"));
 	} else if (optind < argc) {
 		/* Use provided file descriptor */
 		fd = strtos32_or_err(argv[optind], _("bad file descriptor"));
@@ -278,7 +419,11 @@ int main(int argc, char *argv[])
 
 	if (verbose)
 		gettime_monotonic(&time_start);
-	while (flock(fd, type | block)) {
+	if (nslots)
+		fd = lock_slot(filename, nslots, block, conflict_exit_code,
+			       verbose, &slot);
+
+	while (!nslots && flock(fd, type | block)) {
 		switch (errno) {
 		case EWOULDBLOCK:
 			/* -n option set and failed to lock. */
@@ -342,6 +487,14 @@ int main(int argc, char *argv[])
 		pid_t w, f;
 		/* Clear any inherited settings */
 		signal(SIGCHLD, SIG_DFL);
+		if (nslots) {
+			char buf[11];
+
+			snprintf(buf, sizeof(buf), "%u", slot);
+			xsetenv("FLOCK_SLOT", buf, 1);
+			if (verbose)
+				printf(_("%s: got slot %u\n"), program_invocation_short_name, slot);
+		}
 		if (verbose)
 			printf(_("%s: executing %s\n"), program_invocation_short_name, cmd_argv[0]);
 
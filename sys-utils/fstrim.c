@@ -32,12 +32,18 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <getopt.h>
+#include <time.h>
+#include <inttypes.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/vfs.h>
 #include <linux/fs.h>
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
 #include "nls.h"
 #include "xalloc.h"
 #include "strutils.h"
@@ -47,6 +53,9 @@
 #include "sysfs.h"
 #include "optutils.h"
 #include "statfs_magic.h"
+#include "monotonic.h"
+#include "mangle.h"
+#include "fileutils.h"
 
 #include <libmount.h>
 
@@ -60,12 +69,39 @@ struct fstrim_range {
 #define FITRIM		_IOWR('X', 121, struct fstrim_range)
 #endif
 
+#define FSTRIM_DEFAULT_CHUNK	(1ULL << 30)	/* for --rate or --max-latency */
+#define FSTRIM_MIN_CHUNK	(1ULL << 20)
+
+/*
+ * The state for --if-changed, one line for every trimmed filesystem:
+ *
+ *	<mountpoint> <fsid> <time of the last trim> <free blocks>
+ *
+ * The mountpoint is encoded as in fstab.
+ */
+struct fstrim_state {
+	char *target;
+	uint64_t fsid;
+	int64_t time;
+	uint64_t bfree;
+};
+
 struct fstrim_control {
 	struct fstrim_range range;
+	unsigned int nthreads;		/* --parallel */
+
+	uint64_t chunk_size;		/* --chunk-size, or 0 */
+	uint64_t rate;			/* --rate, bytes per second */
+	unsigned int max_latency;	/* --max-latency, milliseconds */
+
+	const char *statefile;		/* --state-file */
+	struct fstrim_state *states;
+	size_t nstates;
 
 	unsigned int verbose : 1,
 		     quiet_unsupp : 1,
-		     dryrun : 1;
+		     dryrun : 1,
+		     if_changed : 1;
 };
 
 static int is_directory(const char *path, int silent)
@@ -85,6 +121,115 @@ static int is_directory(const char *path, int silent)
 	return 1;
 }
 
+static uint64_t usec_since(const struct timeval *tv)
+{
+	struct timeval now, diff;
+
+	gettime_monotonic(&now);
+	timersub(&now, tv, &diff);
+	return (uint64_t) diff.tv_sec * 1000000 + diff.tv_usec;
+}
+
+/*
+ * Calls FITRIM for the range in chunks. The next chunk is delayed to keep
+ * the trimmed bytes below --rate, and the chunk size is halved when the
+ * ioctl takes longer than --max-latency (and doubled again up to
+ * --chunk-size when it's fast).
+ *
+ * Returns 0 on success, or -1 and errno is set. The range->len is set to
+ * the sum of the trimmed bytes.
+ */
+static int fitrim_chunked(struct fstrim_control *ctl, int fd,
+			  const char *path, struct fstrim_range *range)
+{
+	struct timeval begin;
+	struct statfs vfs;
+	uint64_t pos = range->start, end, chunk = ctl->chunk_size, trimmed = 0;
+	int tail = 0;
+
+	/*
+	 * FITRIM stops at the end of the filesystem, but we need the end to
+	 * stop the loop. The size from statfs() does not include all metadata
+	 * (it's smaller than the filesystem), so the rest of the range behind
+	 * this size is discarded by the last FITRIM.
+	 */
+	if (fstatfs(fd, &vfs) != 0)
+		return -1;
+	end = (uint64_t) vfs.f_blocks * vfs.f_bsize;
+	if (range->len < end - min(pos, end))
+		end = pos + range->len;
+	else
+		tail = 1;
+
+	gettime_monotonic(&begin);
+
+	while (pos < end) {
+		struct fstrim_range r = {
+			.start = pos,
+			.len = min(chunk, end - pos),
+			.minlen = range->minlen
+		};
+		struct timeval t0;
+		uint64_t usec;
+
+		gettime_monotonic(&t0);
+		if (ioctl(fd, FITRIM, &r))
+			return -1;
+		usec = usec_since(&t0);
+
+		if (ctl->verbose)
+			printf(_("%s: chunk %" PRIu64 "+%" PRIu64 ": %" PRIu64
+				 " bytes trimmed in %" PRIu64 ".%03" PRIu64 " ms\n"),
+				path, pos, min(chunk, end - pos), (uint64_t) r.len,
+				usec / 1000, usec % 1000);
+
+		pos += min(chunk, end - pos);
+		trimmed += r.len;
+
+		if (ctl->max_latency) {
+			uint64_t limit = (uint64_t) ctl->max_latency * 1000;
+
+			if (usec > limit && chunk / 2 >= FSTRIM_MIN_CHUNK)
+				chunk /= 2;
+			else if (usec < limit / 2 && chunk * 2 <= ctl->chunk_size)
+				chunk *= 2;
+		}
+
+		if (ctl->rate && pos < end) {
+			/* expected time for the trimmed bytes */
+			uint64_t want = trimmed / ctl->rate * 1000000
+				+ trimmed % ctl->rate * 1000000 / ctl->rate;
+			uint64_t done = usec_since(&begin);
+
+			while (want > done) {
+				uint64_t x = min(want - done, (uint64_t) 1000000);
+
+				xusleep((useconds_t) x);
+				done += x;
+			}
+		}
+	}
+
+	if (tail) {
+		struct fstrim_range r = {
+			.start = max(pos, end),
+			.len = range->len - min(range->len, max(pos, end) - range->start),
+			.minlen = range->minlen
+		};
+
+		/* EINVAL if the filesystem is not larger than statfs() size */
+		if (r.len) {
+			if (ioctl(fd, FITRIM, &r) == 0)
+				trimmed += r.len;
+			else if (errno != EINVAL)
+				return -1;
+		}
+	}
+
+	range->len = trimmed;
+	return 0;
+}
+
 /* returns: 0 = success, 1 = unsupported, < 0 = error */
 static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const char *devname)
 {
@@ -117,7 +262,8 @@ static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const
 	}
 
 	errno = 0;
-	if (ioctl(fd, FITRIM, &range)) {
+	if (ctl->chunk_size ? fitrim_chunked(ctl, fd, path, &range) :
+			      ioctl(fd, FITRIM, &range)) {
 		switch (errno) {
 		case EBADF:
 		case ENOTTY:
@@ -156,6 +302,182 @@ done:
 	return rc;
 }
 
+/*
+ * The filesystems for --all; sorted by whole-disk devno if trimmed in
+ * parallel. The devno is zero for stacked devices (device-mapper, MD, ...),
+ * these share one group as they may be on the same physical disks.
+ */
+struct fstrim_item {
+	struct libmnt_fs *fs;
+	dev_t disk;
+	size_t idx;		/* original order */
+	int rc;
+
+	uint64_t fsid;		/* --if-changed */
+	uint64_t bfree;
+};
+
+struct fstrim_queue {
+	struct fstrim_control *ctl;
+	struct fstrim_item *items;
+	size_t nitems;
+	size_t next;		/* first not yet trimmed item */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t lock;
+#endif
+};
+
+static void load_state(struct fstrim_control *ctl)
+{
+	FILE *f = fopen(ctl->statefile, "r" UL_CLOEXECSTR);
+	char buf[PATH_MAX * 4 + 128];
+	size_t sz = 0;
+
+	if (!f) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), ctl->statefile);
+		return;
+	}
+	while (fgets(buf, sizeof(buf), f)) {
+		struct fstrim_state st;
+		char *tgt = NULL;
+
+		if (*buf == '#')
+			continue;
+		if (sscanf(buf, "%ms %" SCNx64 " %" SCNd64 " %" SCNu64,
+			   &tgt, &st.fsid, &st.time, &st.bfree) != 4) {
+			free(tgt);
+			continue;
+		}
+		unmangle_string(tgt);
+		st.target = tgt;
+
+		if (ctl->nstates == sz) {
+			sz = sz ? sz * 2 : 16;
+			ctl->states = xrealloc(ctl->states, sz * sizeof(st));
+		}
+		ctl->states[ctl->nstates++] = st;
+	}
+	fclose(f);
+}
+
+static void save_state(struct fstrim_control *ctl)
+{
+	char *tmp = NULL;
+	FILE *out = NULL;
+	size_t i;
+	int fd;
+
+	xasprintf(&tmp, "%s.XXXXXX", ctl->statefile);
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0 || !(out = fdopen(fd, "w"))) {
+		if (fd >= 0)
+			close(fd);
+		warn(_("cannot create %s"), tmp);
+		goto done;
+	}
+	fchmod(fd, 0644);
+
+	fputs("# fstrim state: <mountpoint> <fsid> <time> <free blocks>\n", out);
+	for (i = 0; i < ctl->nstates; i++) {
+		struct fstrim_state *st = &ctl->states[i];
+		char *tgt = mangle(st->target);
+
+		if (!tgt)
+			continue;
+		fprintf(out, "%s %" PRIx64 " %" PRId64 " %" PRIu64 "\n",
+			tgt, st->fsid, st->time, st->bfree);
+		free(tgt);
+	}
+	if (close_stream(out) != 0) {
+		out = NULL;
+		warn(_("write failed: %s"), tmp);
+		unlink(tmp);
+		goto done;
+	}
+	out = NULL;
+	if (rename(tmp, ctl->statefile) != 0) {
+		warn(_("cannot rename %s to %s"), tmp, ctl->statefile);
+		unlink(tmp);
+	}
+done:
+	if (out)
+		fclose(out);
+	free(tmp);
+}
+
+static int get_fsinfo(const char *path, uint64_t *fsid, uint64_t *bfree)
+{
+	struct statfs vfs;
+	uint32_t id[2];
+
+	if (statfs(path, &vfs) != 0)
+		return -errno;
+
+	memcpy(id, &vfs.f_fsid, sizeof(id));
+	*fsid = ((uint64_t) id[0] << 32) | id[1];
+	*bfree = vfs.f_bfree;
+	return 0;
+}
+
+static struct fstrim_state *get_state(struct fstrim_control *ctl,
+				      const char *path, uint64_t fsid)
+{
+	size_t i;
+
+	for (i = 0; i < ctl->nstates; i++) {
+		struct fstrim_state *st = &ctl->states[i];
+
+		if (st->fsid == fsid && strcmp(st->target, path) == 0)
+			return st;
+	}
+	return NULL;
+}
+
+/* returns 1 if the number of free blocks is the same as after the last trim */
+static int is_unchanged(struct fstrim_control *ctl, const char *path,
+			uint64_t fsid, uint64_t bfree)
+{
+	struct fstrim_state *st = get_state(ctl, path, fsid);
+
+	if (!st || st->bfree != bfree)
+		return 0;
+	if (ctl->verbose)
+		printf(_("%s: skipped, free space unchanged since the last trim\n"), path);
+	return 1;
+}
+
+static void set_state(struct fstrim_control *ctl, const char *path,
+		      uint64_t fsid, uint64_t bfree)
+{
+	struct fstrim_state *st;
+
+	if (ctl->dryrun)
+		return;
+
+	st = get_state(ctl, path, fsid);
+	if (!st) {
+		ctl->states = xrealloc(ctl->states, (ctl->nstates + 1) *
+					sizeof(struct fstrim_state));
+		st = &ctl->states[ctl->nstates++];
+		st->target = xstrdup(path);
+		st->fsid = fsid;
+	}
+	st->time = time(NULL);
+	st->bfree = bfree;
+}
+
+static void free_state(struct fstrim_control *ctl)
+{
+	size_t i;
+
+	for (i = 0; i < ctl->nstates; i++)
+		free(ctl->states[i].target);
+	free(ctl->states);
+	ctl->states = NULL;
+	ctl->nstates = 0;
+}
+
 static int has_discard(const char *devname, struct path_cxt **wholedisk)
 {
 	struct path_cxt *pc = NULL;
@@ -263,6 +585,105 @@ static int uniq_fs_source_cmp(
 	return !mnt_fs_streq_srcpath(a, mnt_fs_get_srcpath(b));
 }
 
+static dev_t get_trim_disk(const char *devname)
+{
+	struct path_cxt *pc;
+	dev_t dev, disk = 0;
+
+	dev = sysfs_devname_to_devno(devname);
+	if (!dev || sysfs_devno_to_wholedisk(dev, NULL, 0, &disk) != 0 || !disk)
+		return 0;
+
+	pc = ul_new_sysfs_path(disk, NULL, NULL);
+	if (!pc)
+		return 0;
+	if (ul_path_count_dirents(pc, "slaves") > 0)
+		disk = 0;
+	ul_unref_path(pc);
+
+	return disk;
+}
+
+static void fstrim_item(struct fstrim_control *ctl, struct fstrim_item *it)
+{
+	const char *tgt = mnt_fs_get_target(it->fs);
+
+	/*
+	 * We're able to detect that the device supports discard, but
+	 * things also depend on filesystem or device mapping, for
+	 * example LUKS (by default) does not support FSTRIM.
+	 *
+	 * This is reason why we ignore EOPNOTSUPP and ENOTTY errors
+	 * from discard ioctl.
+	 */
+	it->rc = fstrim_filesystem(ctl, tgt, mnt_fs_get_srcpath(it->fs));
+	if (it->rc == 1 && !ctl->quiet_unsupp)
+		warnx(_("%s: the discard operation is not supported"), tgt);
+}
+
+#ifdef HAVE_LIBPTHREAD
+static int cmp_items_disk(const void *a, const void *b)
+{
+	const struct fstrim_item *x = a, *y = b;
+
+	if (x->disk != y->disk)
+		return x->disk < y->disk ? -1 : 1;
+	return x->idx < y->idx ? -1 : x->idx > y->idx ? 1 : 0;
+}
+
+/* trims all filesystems on one disk, then continues with the next disk */
+static void *fstrim_worker(void *data)
+{
+	struct fstrim_queue *q = data;
+
+	for (;;) {
+		size_t i, first;
+		dev_t disk;
+
+		pthread_mutex_lock(&q->lock);
+		first = q->next;
+		if (first < q->nitems) {
+			disk = q->items[first].disk;
+			while (q->next < q->nitems && q->items[q->next].disk == disk)
+				q->next++;
+		}
+		i = q->next;
+		pthread_mutex_unlock(&q->lock);
+
+		if (first >= q->nitems)
+			break;
+		for (; first < i; first++)
+			fstrim_item(q->ctl, &q->items[first]);
+	}
+	return NULL;
+}
+
+static void fstrim_parallel(struct fstrim_queue *q)
+{
+	pthread_t *threads;
+	size_t i, nrun;
+
+	for (i = 0; i < q->nitems; i++)
+		q->items[i].disk = get_trim_disk(mnt_fs_get_srcpath(q->items[i].fs));
+	qsort(q->items, q->nitems, sizeof(struct fstrim_item), cmp_items_disk);
+
+	pthread_mutex_init(&q->lock, NULL);
+
+	threads = xcalloc(q->ctl->nthreads, sizeof(pthread_t));
+	for (nrun = 0; nrun < q->ctl->nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, fstrim_worker, q) != 0)
+			break;
+	}
+	if (!nrun)
+		fstrim_worker(q);
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	pthread_mutex_destroy(&q->lock);
+}
+#endif /* HAVE_LIBPTHREAD */
+
 /*
  * -1 = tab empty
  *  0 = all success
@@ -276,6 +697,8 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	struct libmnt_table *tab;
 	struct libmnt_cache *cache = NULL;
 	struct path_cxt *wholedisk = NULL;
+	struct fstrim_queue q = { .ctl = ctl };
+	size_t i;
 	int cnt = 0, cnt_err = 0;
 	int fstab = 0;
 
@@ -374,30 +797,43 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 
 	mnt_reset_iter(itr, MNT_ITER_BACKWARD);
 
-	/* Do FITRIM */
+	q.items = xcalloc(mnt_table_get_nents(tab) ? : 1, sizeof(struct fstrim_item));
 	while (mnt_table_next_fs(tab, itr, &fs) == 0) {
-		const char *src = mnt_fs_get_srcpath(fs),
-			   *tgt = mnt_fs_get_target(fs);
-		int rc;
+		struct fstrim_item *it = &q.items[q.nitems];
 
-		cnt++;
+		if (ctl->if_changed) {
+			const char *tgt = mnt_fs_get_target(fs);
 
-		/*
-		 * We're able to detect that the device supports discard, but
-		 * things also depend on filesystem or device mapping, for
-		 * example LUKS (by default) does not support FSTRIM.
-		 *
-		 * This is reason why we ignore EOPNOTSUPP and ENOTTY errors
-		 * from discard ioctl.
-		 */
-		rc = fstrim_filesystem(ctl, tgt, src);
-		if (rc < 0)
-		       cnt_err++;
-		else if (rc == 1 && !ctl->quiet_unsupp)
-			warnx(_("%s: the discard operation is not supported"), tgt);
+			if (get_fsinfo(tgt, &it->fsid, &it->bfree) == 0 &&
+			    is_unchanged(ctl, tgt, it->fsid, it->bfree))
+				continue;
+		}
+		it->fs = fs;
+		it->idx = q.nitems;
+		q.nitems++;
 	}
 	mnt_free_iter(itr);
 
+	/* Do FITRIM */
+#ifdef HAVE_LIBPTHREAD
+	if (ctl->nthreads > 1 && q.nitems > 1)
+		fstrim_parallel(&q);
+	else
+#endif
+	for (i = 0; i < q.nitems; i++)
+		fstrim_item(ctl, &q.items[i]);
+
+	for (i = 0; i < q.nitems; i++) {
+		struct fstrim_item *it = &q.items[i];
+
+		cnt++;
+		if (it->rc < 0)
+			cnt_err++;
+		else if (it->rc == 0 && ctl->if_changed)
+			set_state(ctl, mnt_fs_get_target(it->fs), it->fsid, it->bfree);
+	}
+	free(q.items);
+
 	ul_unref_path(wholedisk);
 	mnt_unref_table(tab);
 	mnt_unref_cache(cache);
@@ -460,6 +896,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -v, --verbose            print number of discarded bytes\n"), out);
 	fputs(_("     --quiet-unsupported  suppress error messages if trim unsupported\n"), out);
 	fputs(_(" -n, --dry-run            does everything, but trim\n"), out);
+	fputs(_("     --if-changed         skip filesystems with unchanged free space\n"), out);
+	fputs(_("     --state-file <file>  state for --if-changed (default " _PATH_FSTRIM_STATE ")\n"), out);
+	fputs(_("     --parallel <num>     trim filesystems on <num> disks at once (for --all)\n"), out);
+	fputs(_("     --chunk-size <num>   discard by chunks of the specified size\n"), out);
+	fputs(_("     --rate <num>         limit discarded bytes per second\n"), out);
+	fputs(_("     --max-latency <ms>   shrink chunks if discard takes longer\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(21));
@@ -480,7 +922,13 @@ int main(int argc, char **argv)
 			.range = { .len = ULLONG_MAX }
 	};
 	enum {
-		OPT_QUIET_UNSUPP = CHAR_MAX + 1
+		OPT_QUIET_UNSUPP = CHAR_MAX + 1,
+		OPT_PARALLEL,
+		OPT_CHUNK_SIZE,
+		OPT_RATE,
+		OPT_MAX_LATENCY,
+		OPT_IF_CHANGED,
+		OPT_STATE_FILE
 	};
 
 	static const struct option longopts[] = {
@@ -495,6 +943,12 @@ int main(int argc, char **argv)
 	    { "verbose",   no_argument,       NULL, 'v' },
 	    { "quiet-unsupported", no_argument,       NULL, OPT_QUIET_UNSUPP },
 	    { "dry-run",   no_argument,       NULL, 'n' },
+	    { "parallel",  required_argument, NULL, OPT_PARALLEL },
+	    { "chunk-size", required_argument, NULL, OPT_CHUNK_SIZE },
+	    { "rate",      required_argument, NULL, OPT_RATE },
+	    { "max-latency", required_argument, NULL, OPT_MAX_LATENCY },
+	    { "if-changed", no_argument,      NULL, OPT_IF_CHANGED },
+	    { "state-file", required_argument, NULL, OPT_STATE_FILE },
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -547,6 +1001,39 @@ int main(int argc, char **argv)
 		case OPT_QUIET_UNSUPP:
 			ctl.quiet_unsupp = 1;
 			break;
+		case OPT_PARALLEL:
+			ctl.nthreads = strtou32_or_err(optarg,
+					_("invalid number of threads argument"));
+			if (ctl.nthreads == 0) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+				ctl.nthreads = n > 0 ? (unsigned int) n : 1;
+			}
+#ifndef HAVE_LIBPTHREAD
+			ctl.nthreads = 1;
+#endif
+			break;
+		case OPT_CHUNK_SIZE:
+			ctl.chunk_size = strtosize_or_err(optarg,
+					_("failed to parse chunk size"));
+			if (ctl.chunk_size < FSTRIM_MIN_CHUNK)
+				errx(EXIT_FAILURE, _("chunk size must be at least %llu bytes"),
+						FSTRIM_MIN_CHUNK);
+			break;
+		case OPT_RATE:
+			ctl.rate = strtosize_or_err(optarg,
+					_("failed to parse rate"));
+			break;
+		case OPT_IF_CHANGED:
+			ctl.if_changed = 1;
+			break;
+		case OPT_STATE_FILE:
+			ctl.statefile = optarg;
+			break;
+		case OPT_MAX_LATENCY:
+			ctl.max_latency = strtou32_or_err(optarg,
+					_("failed to parse maximal latency"));
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -567,17 +1054,54 @@ int main(int argc, char **argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (all)
-		return fstrim_all(&ctl, tabs);	/* MNT_EX_* codes */
+	if ((ctl.rate || ctl.max_latency) && !ctl.chunk_size)
+		ctl.chunk_size = FSTRIM_DEFAULT_CHUNK;
+
+	if (ctl.if_changed) {
+		if (!ctl.statefile) {
+			ctl.statefile = _PATH_FSTRIM_STATE;
+			ul_mkdir_p(_PATH_FSTRIM_STATEDIR, 0755);
+		}
+		load_state(&ctl);
+	}
+
+	if (all) {
+		rc = fstrim_all(&ctl, tabs);	/* MNT_EX_* codes */
+		goto done;
+	}
 
 	if (!is_directory(path, 0))
 		return EXIT_FAILURE;
 
-	rc = fstrim_filesystem(&ctl, path, NULL);
+	if (ctl.if_changed) {
+		uint64_t fsid = 0, bfree = 0;
+		char *rpath = realpath(path, NULL);
+
+		if (rpath && get_fsinfo(rpath, &fsid, &bfree) == 0) {
+			if (is_unchanged(&ctl, rpath, fsid, bfree))
+				rc = 0;
+			else {
+				rc = fstrim_filesystem(&ctl, path, NULL);
+				if (rc == 0)
+					set_state(&ctl, rpath, fsid, bfree);
+			}
+		} else
+			rc = fstrim_filesystem(&ctl, path, NULL);
+		free(rpath);
+	} else
+		rc = fstrim_filesystem(&ctl, path, NULL);
+
 	if (rc == 1 && ctl.quiet_unsupp)
 		rc = 0;
 	if (rc == 1)
 		warnx(_("%s: the discard operation is not supported"), path);
 
-	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	rc = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+done:
+	if (ctl.if_changed) {
+		if (!ctl.dryrun)
+			save_state(&ctl);
+		free_state(&ctl);
+	}
+	return rc;
 }
@@ -198,6 +198,9 @@ static int do_rtc_read_ioctl(int rtc_fd, struct tm *tm)
 	return 0;
 }
 
+/* Pause between the RTC reads when waiting for the tick (microseconds) */
+#define RTC_BUSYWAIT_PAUSE	1000
+
 /*
  * Wait for the top of a clock tick by reading /dev/rtc in a busy loop
  * until we see it. This function is used for rtc drivers without ioctl
@@ -239,6 +242,8 @@ static int busywait_for_rtc_clock_tick(const struct hwclock_control *ctl,
 			warnx(_("Timed out waiting for time change."));
 			return 1;
 		}
+		/* Don't burn the CPU, the tick is detected within the pause */
+		xusleep(RTC_BUSYWAIT_PAUSE);
 	} while (1);
 
 	if (rc)
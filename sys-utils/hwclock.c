@@ -294,7 +294,7 @@ static int read_adjtime(const struct hwclock_control *ctl,
  * once per second, right on the falling edge of the update flag.
  *
  * We wait (up to one second) either blocked waiting for an rtc device or in
- * a CPU spin loop. The former is probably not very accurate.
+ * a polling loop. The former is probably not very accurate.
  *
  * Return 0 if it worked, nonzero if it didn't.
  */
@@ -1064,7 +1064,7 @@ manipulate_clock(const struct hwclock_control *ctl, const time_t set_time,
 		 * Synchronization failure MUST exit, because all drift
 		 * operations are invalid without it.
 		 */
-		if (synchronize_to_clock_tick(ctl))
+		if (!ctl->nosync && synchronize_to_clock_tick(ctl))
 			return EXIT_FAILURE;
 		read_hardware_clock(ctl, &hclock_valid, &hclocktime.tv_sec);
 		gettimeofday(&read_time, NULL);
@@ -1073,6 +1073,17 @@ manipulate_clock(const struct hwclock_control *ctl, const time_t set_time,
 			warnx(_("RTC read returned an invalid value."));
 			return EXIT_FAILURE;
 		}
+		/*
+		 * Without the synchronization the RTC was read somewhere
+		 * within the second; use the middle of the second, the
+		 * result is accurate to +/- 0.5 seconds.
+		 */
+		if (ctl->nosync) {
+			hclocktime = time_inc(hclocktime, 0.5);
+			if (ctl->verbose)
+				printf(_("Not synchronized to the clock tick, "
+					 "accuracy is +/- 0.5 seconds\n"));
+		}
 		/*
 		 * Calculate and apply drift correction to the Hardware Clock
 		 * time for everything except --show
@@ -1192,6 +1203,7 @@ usage(void)
 	puts(_("     --epoch <year>   epoch input for --setepoch"));
 #endif
 	puts(_("     --update-drift   update the RTC drift factor"));
+	puts(_("     --nosync         do not wait for the RTC clock tick"));
 	printf(_(
 	       "     --noadjfile      do not use %1$s\n"), _PATH_ADJTIME);
 	printf(_(
@@ -1229,6 +1241,7 @@ int main(int argc, char **argv)
 		OPT_GET,
 		OPT_GETEPOCH,
 		OPT_NOADJFILE,
+		OPT_NOSYNC,
 		OPT_PREDICT,
 		OPT_SET,
 		OPT_SETEPOCH,
@@ -1256,6 +1269,7 @@ int main(int argc, char **argv)
 		{ "epoch",        required_argument, NULL, OPT_EPOCH      },
 #endif
 		{ "noadjfile",    no_argument,       NULL, OPT_NOADJFILE  },
+		{ "nosync",       no_argument,       NULL, OPT_NOSYNC     },
 		{ "directisa",    no_argument,       NULL, OPT_DIRECTISA  },
 		{ "test",         no_argument,       NULL, OPT_TEST       },
 		{ "date",         required_argument, NULL, OPT_DATE       },
@@ -1371,6 +1385,9 @@ int main(int argc, char **argv)
 		case OPT_NOADJFILE:
 			ctl.noadjfile = 1;
 			break;
+		case OPT_NOSYNC:
+			ctl.nosync = 1;
+			break;
 		case OPT_DIRECTISA:
 			ctl.directisa = 1;
 			break;
@@ -1431,6 +1448,11 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	if (ctl.nosync && !ctl.show && !ctl.get) {
+		warnx(_("--nosync requires --show or --get"));
+		exit(EXIT_FAILURE);
+	}
+
 	if (ctl.noadjfile && !ctl.utc && !ctl.local_opt) {
 		warnx(_("With --noadjfile, you must specify "
 			"either --utc or --localtime"));
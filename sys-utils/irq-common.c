@@ -21,6 +21,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <locale.h>
 #include <stdio.h>
@@ -175,12 +176,17 @@ static struct libscols_line *new_scols_line(struct libscols_table *table)
 	return line;
 }
 
-static void add_scols_line(struct irq_output *out,
+static void set_scols_line(struct irq_output *out,
 			   struct irq_info *info,
-			   struct libscols_table *table)
+			   struct libscols_table *table,
+			   struct libscols_line *line)
 {
 	size_t i;
-	struct libscols_line *line = new_scols_line(table);
+
+	if (!line)
+		line = new_scols_line(table);
+	if (!line)
+		err_oom();
 
 	for (i = 0; i < out->ncolumns; i++) {
 		char *str = NULL;
@@ -207,130 +213,210 @@ static void add_scols_line(struct irq_output *out,
 	}
 }
 
-static char *remove_repeated_spaces(char *str)
+/* copies @str to @buf, all whitespace sequences are replaced by one space */
+static size_t copy_squeezed(char *buf, size_t bufsz, const char *str, const char *end)
 {
-	char *inp = str, *outp = str;
-	uint8_t prev_space = 0;
-
-	while (*inp) {
-		if (isspace(*inp)) {
-			if (!prev_space) {
-				*outp++ = ' ';
-				prev_space = 1;
-			}
+	size_t n = 0;
+	int prev_space = 0;
+
+	while (str < end && isspace((unsigned char) *str))
+		str++;
+	while (end > str && isspace((unsigned char) *(end - 1)))
+		end--;
+
+	for (; str < end && n + 1 < bufsz; str++) {
+		if (isspace((unsigned char) *str)) {
+			if (prev_space)
+				continue;
+			buf[n++] = ' ';
+			prev_space = 1;
 		} else {
-			*outp++ = *inp;
+			buf[n++] = *str;
 			prev_space = 0;
 		}
-		++inp;
 	}
-	*outp = '\0';
-	return str;
+	buf[n] = '\0';
+	return n;
 }
 
-/*
- * irqinfo - parse the system's interrupts
- */
-static struct irq_stat *get_irqinfo(int softirq)
+/* reads whole @fd to the reused stat->buf */
+static int read_irqfile(struct irq_stat *stat, int fd)
 {
-	FILE *irqfile;
-	char *line = NULL, *tmp;
 	size_t len = 0;
-	struct irq_stat *stat;
-	struct irq_info *curr;
 
-	/* NAME + ':' + 11 bytes/cpu + IRQ_NAME_LEN */
-	stat = xcalloc(1, sizeof(*stat));
+	for (;;) {
+		ssize_t ret;
 
-	stat->irq_info = xmalloc(sizeof(*stat->irq_info) * IRQ_INFO_LEN);
-	stat->nr_irq_info = IRQ_INFO_LEN;
-
-	if (softirq)
-		irqfile = fopen(_PATH_PROC_SOFTIRQS, "r");
-	else
-		irqfile = fopen(_PATH_PROC_INTERRUPTS, "r");
-	if (!irqfile) {
-		warn(_("cannot open %s"), _PATH_PROC_INTERRUPTS);
-		goto free_stat;
+		if (stat->bufsz - len < BUFSIZ) {
+			stat->bufsz = stat->bufsz ? stat->bufsz * 2 : 64 * 1024;
+			stat->buf = xrealloc(stat->buf, stat->bufsz);
+		}
+		ret = read(fd, stat->buf + len, stat->bufsz - len - 1);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -errno;
+		}
+		if (ret == 0)
+			break;
+		len += ret;
 	}
+	stat->buf[len] = '\0';
+	return 0;
+}
 
-	/* read header firstly */
-	if (getline(&line, &len, irqfile) < 0) {
-		warn(_("cannot read %s"), _PATH_PROC_INTERRUPTS);
-		goto close_file;
+/* parses unsigned decimal number and skips leading blanks; returns NULL if no number */
+static inline char *scan_count(char *p, unsigned long *num)
+{
+	unsigned long x = 0;
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (!isdigit((unsigned char) *p))
+		return NULL;
+	do
+		x = x * 10 + (*p++ - '0');
+	while (isdigit((unsigned char) *p));
+
+	*num = x;
+	return p;
+}
+
+/*
+ * Updates @stat from the system's interrupts. The previous sample is kept in
+ * @stat, so the deltas are computed directly and names are allocated only
+ * for new or changed interrupts.
+ */
+static int update_irqinfo(struct irq_stat *stat, int softirq)
+{
+	const char *path = softirq ? _PATH_PROC_SOFTIRQS : _PATH_PROC_INTERRUPTS;
+	char *line, *next, *tmp;
+	size_t i, nr_irq = 0, nr_cpu = 0;
+	int fd, rc, first;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		warn(_("cannot open %s"), path);
+		return -errno;
+	}
+	rc = read_irqfile(stat, fd);
+	close(fd);
+	if (rc < 0 || !*stat->buf) {
+		warn(_("cannot read %s"), path);
+		return rc ? rc : -EINVAL;
 	}
 
+	/* header line */
+	line = stat->buf;
+	next = strchr(line, '\n');
+	if (next)
+		*next++ = '\0';
+
 	tmp = line;
 	while ((tmp = strstr(tmp, "CPU")) != NULL) {
 		tmp += 3;	/* skip this "CPU", find next */
-		stat->nr_active_cpu++;
+		nr_cpu++;
 	}
 
-	stat->cpus =  xcalloc(stat->nr_active_cpu, sizeof(struct irq_cpu));
+	first = !stat->cpus;
+	if (nr_cpu != stat->nr_active_cpu) {
+		/* CPU hotplug, the counters don't match anymore */
+		free(stat->cpus);
+		stat->cpus = xcalloc(nr_cpu, sizeof(struct irq_cpu));
+		stat->nr_active_cpu = nr_cpu;
+		first = 1;
+	}
 
-	/* parse each line of _PATH_PROC_INTERRUPTS */
-	while (getline(&line, &len, irqfile) >= 0) {
-		unsigned long count;
+	/* keep the previous total in delta until all lines are parsed */
+	for (i = 0; i < stat->nr_active_cpu; i++) {
+		stat->cpus[i].delta = stat->cpus[i].total;
+		stat->cpus[i].total = 0;
+	}
+	stat->total_irq = 0;
+	stat->delta_irq = 0;
+
+	/* parse each line */
+	for (line = next; line && *line; line = next) {
+		struct irq_info *curr;
+		char *irq, desc[BUFSIZ];
+		unsigned long total = 0;
 		size_t index;
-		int length;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
 
 		tmp = strchr(line, ':');
 		if (!tmp)
 			continue;
+		*tmp++ = '\0';
+		irq = line;
+		while (isspace((unsigned char) *irq))
+			irq++;
 
-		length = strlen(line);
-
-		curr = stat->irq_info + stat->nr_irq++;
-		memset(curr, 0, sizeof(*curr));
-		*tmp = '\0';
-		curr->irq = xstrdup(line);
-		ltrim_whitespace((unsigned char *)curr->irq);
-
-		tmp += 1;
-		for (index = 0; (index < stat->nr_active_cpu) && (tmp - line < length); index++) {
-			struct irq_cpu *cpu = &stat->cpus[index];
-
-			sscanf(tmp, " %10lu", &count);
-			curr->total += count;
-			cpu->total += count;
-			stat->total_irq += count;
-
-			tmp += 11;
+		if (nr_irq == stat->nr_irq_info) {
+			stat->nr_irq_info = stat->nr_irq_info ? stat->nr_irq_info * 2 : IRQ_INFO_LEN;
+			stat->irq_info = xrealloc(stat->irq_info,
+						  sizeof(*stat->irq_info) * stat->nr_irq_info);
 		}
+		curr = &stat->irq_info[nr_irq];
 
-		/* softirq always has no desc, add additional desc for softirq */
-		if (softirq)
-			get_softirq_desc(curr);
-		else {
-			if (tmp - line < length) {
-				/* strip all space before desc */
-				while (isspace(*tmp))
-					tmp++;
-				tmp = remove_repeated_spaces(tmp);
-				rtrim_whitespace((unsigned char *)tmp);
-				curr->name = xstrdup(tmp);
-			} else /* no irq name string, we have to set '\0' here */
-				curr->name = xstrdup("");
+		if (nr_irq >= stat->nr_irq || strcmp(curr->irq, irq) != 0) {
+			/* new interrupt at this position */
+			if (nr_irq < stat->nr_irq) {
+				free(curr->irq);
+				free(curr->name);
+			}
+			memset(curr, 0, sizeof(*curr));
+			curr->irq = xstrdup(irq);
+			if (softirq)
+				/* softirq always has no desc, add additional desc for softirq */
+				get_softirq_desc(curr);
+			curr->is_new = 1;
+		} else
+			curr->is_new = first;
+
+		for (index = 0; index < stat->nr_active_cpu; index++) {
+			unsigned long count;
+			char *end = scan_count(tmp, &count);
+
+			if (!end)
+				break;
+			tmp = end;
+			total += count;
+			stat->cpus[index].total += count;
 		}
 
-		if (stat->nr_irq == stat->nr_irq_info) {
-			stat->nr_irq_info *= 2;
-			stat->irq_info = xrealloc(stat->irq_info,
-						  sizeof(*stat->irq_info) * stat->nr_irq_info);
+		if (!softirq) {
+			copy_squeezed(desc, sizeof(desc), tmp, tmp + strlen(tmp));
+			if (!curr->name || strcmp(curr->name, desc) != 0) {
+				free(curr->name);
+				curr->name = xstrdup(desc);
+			}
 		}
+
+		curr->delta = curr->is_new ? 0 : total - curr->total;
+		curr->total = total;
+		stat->total_irq += total;
+		stat->delta_irq += curr->delta;
+		nr_irq++;
 	}
-	fclose(irqfile);
-	free(line);
-	return stat;
 
- close_file:
-	fclose(irqfile);
- free_stat:
-	free(stat->irq_info);
-	free(stat->cpus);
-	free(stat);
-	free(line);
-	return NULL;
+	/* remove disappeared interrupts */
+	for (i = nr_irq; i < stat->nr_irq; i++) {
+		free(stat->irq_info[i].irq);
+		free(stat->irq_info[i].name);
+	}
+	stat->nr_irq = nr_irq;
+
+	for (i = 0; i < stat->nr_active_cpu; i++) {
+		struct irq_cpu *cpu = &stat->cpus[i];
+
+		cpu->delta = first ? 0 : cpu->total - cpu->delta;
+	}
+	if (first)
+		stat->delta_irq = 0;
+	return 0;
 }
 
 void free_irqstat(struct irq_stat *stat)
@@ -347,6 +433,7 @@ void free_irqstat(struct irq_stat *stat)
 
 	free(stat->irq_info);
 	free(stat->cpus);
+	free(stat->buf);
 	free(stat);
 }
 
@@ -420,7 +507,6 @@ void set_sort_func_by_key(struct irq_output *out, char c)
 }
 
 struct libscols_table *get_scols_cpus_table(struct irq_output *out,
-					struct irq_stat *prev,
 					struct irq_stat *curr)
 {
 	struct libscols_table *table;
@@ -429,15 +515,6 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	char colname[sizeof("cpu") + sizeof(stringify_value(LONG_MAX))];
 	size_t i;
 
-	if (prev) {
-		for (i = 0; i < curr->nr_active_cpu; i++) {
-			struct irq_cpu *pre = &prev->cpus[i];
-			struct irq_cpu *cur = &curr->cpus[i];
-
-			cur->delta = cur->total - pre->total;
-		}
-	}
-
 	table = scols_new_table();
 	if (!table) {
 		warn(_("failed to initialize output table"));
@@ -500,53 +577,67 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	return NULL;
 }
 
+/*
+ * Returns a new table, or updates lines of the reused @table if specified.
+ *
+ * The @xstat is updated by the current interrupts if it's already allocated
+ * by the previous call, so deltas are since the previous call.
+ */
 struct libscols_table *get_scols_table(struct irq_output *out,
-					      struct irq_stat *prev,
 					      struct irq_stat **xstat,
-					      int softirq)
+					      int softirq,
+					      struct libscols_table *table)
 {
-	struct libscols_table *table;
+	struct libscols_line *line = NULL;
+	struct libscols_iter *itr = NULL;
 	struct irq_info *result;
 	struct irq_stat *stat;
 	size_t size;
 	size_t i;
 
 	/* the stats */
-	stat = get_irqinfo(softirq);
-	if (!stat)
+	stat = xstat && *xstat ? *xstat : xcalloc(1, sizeof(*stat));
+	if (update_irqinfo(stat, softirq) != 0) {
+		if (!xstat || stat != *xstat)
+			free_irqstat(stat);
 		return NULL;
+	}
+	if (xstat)
+		*xstat = stat;
 
 	size = sizeof(*stat->irq_info) * stat->nr_irq;
-	result = xmalloc(size);
+	result = xmalloc(size ? size : 1);
 	memcpy(result, stat->irq_info, size);
 
-	if (prev) {
-		stat->delta_irq = 0;
-		for (i = 0; i < stat->nr_irq; i++) {
-			struct irq_info *cur = &result[i];
-			struct irq_info *pre = &prev->irq_info[i];
-
-			cur->delta = cur->total - pre->total;
-			stat->delta_irq += cur->delta;
-		}
-	}
 	sort_result(out, result, stat->nr_irq);
 
-	table = new_scols_table(out);
+	if (table) {
+		itr = scols_new_iter(SCOLS_ITER_FORWARD);
+		if (!itr)
+			err_oom();
+	} else
+		table = new_scols_table(out);
 	if (!table) {
 		free(result);
-		free_irqstat(stat);
+		if (!xstat)
+			free_irqstat(stat);
 		return NULL;
 	}
 
-	for (i = 0; i < stat->nr_irq; i++)
-		add_scols_line(out, &result[i], table);
+	for (i = 0; i < stat->nr_irq; i++) {
+		if (itr && scols_table_next_line(table, itr, &line) != 0)
+			line = NULL;
+		set_scols_line(out, &result[i], table, line);
+	}
+
+	/* remove lines of the disappeared irqs */
+	while (itr && scols_table_next_line(table, itr, &line) == 0)
+		scols_table_remove_line(table, line);
 
+	scols_free_iter(itr);
 	free(result);
 
-	if (xstat)
-		*xstat = stat;
-	else
+	if (!xstat)
 		free_irqstat(stat);
 
 	return table;
@@ -19,6 +19,7 @@ struct irq_info {
 	char *name;			/* descriptive name of this irq */
 	unsigned long total;		/* total count since system start up */
 	unsigned long delta;		/* delta count since previous update */
+	unsigned int is_new:1;		/* not in the previous update */
 };
 
 struct irq_cpu {
@@ -34,6 +35,9 @@ struct irq_stat {
 	size_t nr_active_cpu;		/* number of active cpu */
 	unsigned long total_irq;	/* total irqs */
 	unsigned long delta_irq;	/* delta irqs */
+
+	char *buf;			/* /proc file content, reused */
+	size_t bufsz;
 };
 
 
@@ -61,12 +65,11 @@ void set_sort_func_by_name(struct irq_output *out, const char *name);
 void set_sort_func_by_key(struct irq_output *out, const char c);
 
 struct libscols_table *get_scols_table(struct irq_output *out,
-                                              struct irq_stat *prev,
                                               struct irq_stat **xstat,
-                                              int softirq);
+                                              int softirq,
+                                              struct libscols_table *table);
 
 struct libscols_table *get_scols_cpus_table(struct irq_output *out,
-                                        struct irq_stat *prev,
                                         struct irq_stat *curr);
 
 #endif /* UTIL_LINUX_H_IRQ_COMMON */
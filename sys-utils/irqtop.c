@@ -76,7 +76,8 @@ struct irqtop_ctl {
 	char		*hostname;
 
 	struct itimerspec timer;
-	struct irq_stat	*prev_stat;
+	struct irq_stat	*stat;		/* updated on refresh */
+	struct libscols_table *table;	/* irqs table, updated on refresh */
 
 	unsigned int request_exit:1;
 	unsigned int softirq:1;
@@ -103,18 +104,26 @@ static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 	time_t now = time(NULL);
 	char timestr[64], *data, *data0, *p;
 
-	/* make irqs table */
-	table = get_scols_table(out, ctl->prev_stat, &stat, ctl->softirq);
+	/* make or update irqs table */
+	table = get_scols_table(out, &ctl->stat, ctl->softirq, ctl->table);
 	if (!table) {
 		ctl->request_exit = 1;
 		return 1;
 	}
-	scols_table_enable_maxout(table, 1);
-	scols_table_enable_nowrap(table, 1);
-	scols_table_reduce_termwidth(table, 1);
+	stat = ctl->stat;
+	if (!ctl->table) {
+		scols_table_enable_maxout(table, 1);
+		scols_table_enable_nowrap(table, 1);
+		scols_table_reduce_termwidth(table, 1);
+		scols_table_enable_reusable(table, 1);
+		ctl->table = table;
+	}
+	/* scols_table_reduce_termwidth() reduces the width on each print */
+	if (ctl->cols > 0)
+		scols_table_set_termwidth(table, ctl->cols);
 
 	/* make cpus table */
-	cpus = get_scols_cpus_table(out, ctl->prev_stat, stat);
+	cpus = get_scols_cpus_table(out, stat);
 	scols_table_reduce_termwidth(cpus, 1);
 
 	/* print header */
@@ -127,6 +136,7 @@ static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 	scols_print_table_to_string(cpus, &data);
 	wprintw(ctl->win, "%s\n\n", data);
 	free(data);
+	scols_unref_table(cpus);
 
 	/* print irqs table */
 	scols_print_table_to_string(table, &data0);
@@ -144,12 +154,6 @@ static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 
 	wprintw(ctl->win, "%s", data);
 	free(data0);
-
-	/* clean up */
-	scols_unref_table(table);
-	if (ctl->prev_stat)
-		free_irqstat(ctl->prev_stat);
-	ctl->prev_stat = stat;
 	return 0;
 }
 
@@ -361,7 +365,8 @@ int main(int argc, char **argv)
 	ctl.hostname = xgethostname();
 	event_loop(&ctl, &out);
 
-	free_irqstat(ctl.prev_stat);
+	scols_unref_table(ctl.table);
+	free_irqstat(ctl.stat);
 	free(ctl.hostname);
 
 	if (is_tty)
@@ -26,6 +26,7 @@
 #include "xalloc.h"
 #include "canonicalize.h"
 #include "pathnames.h"
+#include "monotonic.h"
 
 enum {
 	A_CREATE = 1,		/* setup a new device */
@@ -37,6 +38,7 @@ enum {
 	A_SET_CAPACITY,		/* set device capacity */
 	A_SET_DIRECT_IO,	/* set accessing backing file by direct io */
 	A_SET_BLOCKSIZE,	/* set logical block size of the loop device */
+	A_CREATE_BATCH,		/* setup devices for files from --batch file */
 };
 
 enum {
@@ -58,6 +60,7 @@ enum {
 static int no_headings;
 static int raw;
 static int json;
+static int autotune;
 
 struct colinfo {
 	const char *name;
@@ -414,6 +417,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --set-capacity <loopdev>  resize the device\n"), out);
 	fputs(_(" -j, --associated <file>       list all devices associated with <file>\n"), out);
 	fputs(_(" -L, --nooverlap               avoid possible conflict between devices\n"), out);
+	fputs(_("     --batch <file>            set up devices for all files listed in <file>\n"), out);
 
 	/* commands options */
 	fputs(USAGE_SEPARATOR, out);
@@ -423,8 +427,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -P, --partscan                create a partitioned loop device\n"), out);
 	fputs(_(" -r, --read-only               set up a read-only loop device\n"), out);
 	fputs(_("     --direct-io[=<on|off>]    open backing file with O_DIRECT\n"), out);
+	fputs(_("     --auto-tune               use direct I/O if the backing file supports it\n"), out);
 	fputs(_("     --show                    print device name after setup (with -f)\n"), out);
-	fputs(_(" -v, --verbose                 verbose mode\n"), out);
+	fputs(_(" -v, --verbose                 verbose mode (attach time with --batch)\n"), out);
 
 	/* output options */
 	fputs(USAGE_SEPARATOR, out);
@@ -568,6 +573,8 @@ static int create_loop(struct loopdev_cxt *lc,
 			warn(_("%s: failed to use backing file"), file);
 			break;
 		}
+		if (autotune && loopcxt_autotune(lc) < 0)
+			warn(_("%s: failed to probe direct I/O support"), file);
 		errno = 0;
 		rc = loopcxt_setup_device(lc);
 		if (rc == 0)
@@ -589,14 +596,101 @@ static int create_loop(struct loopdev_cxt *lc,
 	return rc;
 }
 
+/* losetup --auto-tune --verbose */
+static void report_autotune(struct loopdev_cxt *lc)
+{
+	uint64_t blocksize = 0;
+
+	if (loopcxt_get_blocksize(lc, &blocksize) != 0)
+		blocksize = 0;
+	printf(_("%s: direct I/O %s, logical sector size %ju\n"),
+		loopcxt_get_device(lc),
+		loopcxt_is_dio(lc) ? _("on") : _("off"),
+		blocksize);
+}
+
+/*
+ * losetup --batch <file>, one backing file per line; the /dev/loop-control
+ * is open only once for all the devices.
+ */
+static int create_loops_batch(struct loopdev_cxt *lc, const char *batchfile,
+		       int nooverlap, int lo_flags, int flags,
+		       uint64_t offset, uint64_t sizelimit, uint64_t blocksize,
+		       int set_dio, unsigned long use_dio, int verbose)
+{
+	struct timeval start, begin, end, delta;
+	FILE *f = stdin;
+	char *buf = NULL;
+	size_t bufsz = 0, count = 0;
+	int res = 0;
+
+	if (strcmp(batchfile, "-") != 0) {
+		f = fopen(batchfile, "r" UL_CLOEXECSTR);
+		if (!f)
+			err(EXIT_FAILURE, _("cannot open %s"), batchfile);
+	}
+
+	/* it's not fatal, find unused device opens it for each call otherwise */
+	loopcxt_open_control(lc);
+	gettime_monotonic(&start);
+	end = start;
+
+	while (getline(&buf, &bufsz, f) != -1) {
+		char *file = (char *) skip_blank(buf);
+		int rc;
+
+		rtrim_whitespace((unsigned char *) file);
+		if (!*file || *file == '#')
+			continue;
+
+		gettime_monotonic(&begin);
+		ignore_result( loopcxt_set_device(lc, NULL) );
+		rc = create_loop(lc, nooverlap, lo_flags, flags, file,
+				 offset, sizelimit, blocksize);
+		if (rc == 0 && set_dio && loopcxt_ioctl_dio(lc, use_dio)) {
+			warn(_("%s: set direct io failed"), loopcxt_get_device(lc));
+			rc = -1;
+		}
+		if (rc) {
+			res = -1;
+			continue;
+		}
+		gettime_monotonic(&end);
+		count++;
+
+		warn_size(file, sizelimit, offset, flags);
+		if (verbose) {
+			timersub(&end, &begin, &delta);
+			printf(_("%s: %s attached in %.3f ms\n"),
+				loopcxt_get_device(lc), file,
+				delta.tv_sec * 1000.0 + delta.tv_usec / 1000.0);
+		} else
+			printf("%s %s\n", loopcxt_get_device(lc), file);
+		if (autotune && verbose)
+			report_autotune(lc);
+	}
+
+	if (verbose) {
+		timersub(&end, &start, &delta);
+		printf(P_("%zu device attached in %.3f ms\n",
+			  "%zu devices attached in %.3f ms\n", count),
+			count, delta.tv_sec * 1000.0 + delta.tv_usec / 1000.0);
+	}
+
+	free(buf);
+	if (f != stdin)
+		fclose(f);
+	return res;
+}
+
 int main(int argc, char **argv)
 {
 	struct loopdev_cxt lc;
 	int act = 0, flags = 0, no_overlap = 0, c;
 	char *file = NULL;
 	uint64_t offset = 0, sizelimit = 0, blocksize = 0;
-	int res = 0, showdev = 0, lo_flags = 0;
-	char *outarg = NULL;
+	int res = 0, showdev = 0, lo_flags = 0, verbose = 0;
+	char *outarg = NULL, *batchfile = NULL;
 	int list = 0;
 	unsigned long use_dio = 0, set_dio = 0, set_blocksize = 0;
 
@@ -605,10 +699,14 @@ int main(int argc, char **argv)
 		OPT_SHOW,
 		OPT_RAW,
 		OPT_DIO,
-		OPT_OUTPUT_ALL
+		OPT_OUTPUT_ALL,
+		OPT_BATCH,
+		OPT_AUTOTUNE
 	};
 	static const struct option longopts[] = {
 		{ "all",          no_argument,       NULL, 'a'           },
+		{ "auto-tune",    no_argument,       NULL, OPT_AUTOTUNE  },
+		{ "batch",        required_argument, NULL, OPT_BATCH     },
 		{ "set-capacity", required_argument, NULL, 'c'           },
 		{ "detach",       required_argument, NULL, 'd'           },
 		{ "detach-all",   no_argument,       NULL, 'D'           },
@@ -635,9 +733,9 @@ int main(int argc, char **argv)
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
-		{ 'D','a','c','d','f','j' },
-		{ 'D','c','d','f','l' },
-		{ 'D','c','d','f','O' },
+		{ 'D','a','c','d','f','j',OPT_BATCH },
+		{ 'D','c','d','f','l',OPT_BATCH },
+		{ 'D','c','d','f','O',OPT_BATCH },
 		{ 'J',OPT_RAW },
 		{ 0 }
 	};
@@ -730,6 +828,14 @@ int main(int argc, char **argv)
 				use_dio = parse_switch(optarg, _("argument error"), "on", "off", NULL);
 			break;
 		case 'v':
+			verbose = 1;
+			break;
+		case OPT_BATCH:
+			act = A_CREATE_BATCH;
+			batchfile = optarg;
+			break;
+		case OPT_AUTOTUNE:
+			autotune = 1;
 			break;
 		case OPT_SIZELIMIT:			/* --sizelimit */
 			sizelimit = strtosize_or_err(optarg, _("failed to parse size"));
@@ -771,6 +877,9 @@ int main(int argc, char **argv)
 		columns[ncolumns++] = COL_LOGSEC;
 	}
 
+	if (act == A_CREATE_BATCH && optind < argc)
+		errx(EXIT_FAILURE, _("unexpected arguments"));
+
 	if (act == A_FIND_FREE && optind < argc) {
 		/*
 		 * losetup -f <backing_file>
@@ -826,13 +935,13 @@ int main(int argc, char **argv)
 	}
 
 	if (act != A_CREATE &&
-	    (sizelimit || lo_flags || showdev))
+	    (showdev || (act != A_CREATE_BATCH && (sizelimit || lo_flags || autotune))))
 		errx(EXIT_FAILURE,
 			_("the options %s are allowed during loop device setup only"),
-			"--{sizelimit,partscan,read-only,show}");
+			"--{sizelimit,partscan,read-only,show,auto-tune}");
 
 	if ((flags & LOOPDEV_FL_OFFSET) &&
-	    act != A_CREATE && (act != A_SHOW || !file))
+	    act != A_CREATE && act != A_CREATE_BATCH && (act != A_SHOW || !file))
 		errx(EXIT_FAILURE, _("the option --offset is not allowed in this context"));
 
 	if (outarg && string_add_to_idarray(outarg, columns, ARRAY_SIZE(columns),
@@ -849,8 +958,15 @@ int main(int argc, char **argv)
 			warn_size(file, sizelimit, offset, flags);
 			if (set_dio)
 				goto lo_set_dio;
+			if (autotune && verbose)
+				report_autotune(&lc);
 		}
 		break;
+	case A_CREATE_BATCH:
+		res = create_loops_batch(&lc, batchfile, no_overlap, lo_flags,
+				flags, offset, sizelimit, blocksize,
+				set_dio, use_dio, verbose);
+		break;
 	case A_DELETE:
 		res = delete_loop(&lc);
 		while (optind < argc) {
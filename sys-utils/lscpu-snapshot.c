@@ -0,0 +1,817 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * lscpu-snapshot.c - store and reuse gathered CPU information
+ *
+ * The snapshot is a text file, one "<name> <value>" per line. The file starts
+ * with a key (kernel, boot ID and possible/present/online CPU masks); if any
+ * key item does not match with the current system the snapshot is ignored
+ * and rewritten. The rest of the file describes the lscpu context, "@<name>"
+ * lines start a new object (CPU type, CPU, cache, ...).
+ */
+#include <stddef.h>
+#include <inttypes.h>
+#include <sys/utsname.h>
+
+#include "lscpu.h"
+#include "fileutils.h"
+#include "closestream.h"
+
+#define SNAP_MAGIC	"lscpu-snapshot"
+#define SNAP_VERSION	1
+
+enum {
+	SNAP_KEY_MACHINE = 0,
+	SNAP_KEY_RELEASE,
+	SNAP_KEY_VERSION,
+	SNAP_KEY_BOOT,
+	SNAP_KEY_SYSROOT,
+	SNAP_KEY_KERNELMAX,
+	SNAP_KEY_POSSIBLE,
+	SNAP_KEY_PRESENT,
+	SNAP_KEY_ONLINE,
+
+	__SNAP_KEY_COUNT
+};
+
+static const char *const snap_keys[] = {
+	[SNAP_KEY_MACHINE]	= "key.machine",
+	[SNAP_KEY_RELEASE]	= "key.release",
+	[SNAP_KEY_VERSION]	= "key.version",
+	[SNAP_KEY_BOOT]		= "key.boot",
+	[SNAP_KEY_SYSROOT]	= "key.sysroot",
+	[SNAP_KEY_KERNELMAX]	= "key.kernel_max",
+	[SNAP_KEY_POSSIBLE]	= "key.possible",
+	[SNAP_KEY_PRESENT]	= "key.present",
+	[SNAP_KEY_ONLINE]	= "key.online"
+};
+
+/* objects */
+enum {
+	SNAP_OBJ_CXT = 0,
+	SNAP_OBJ_ARCH,
+	SNAP_OBJ_VIRT,
+	SNAP_OBJ_TYPE,
+	SNAP_OBJ_CPU,
+	SNAP_OBJ_CACHE,
+	SNAP_OBJ_ECACHE,
+	SNAP_OBJ_NODE,
+	SNAP_OBJ_VUL
+};
+
+/* field types */
+enum {
+	SNAP_STR = 0,	/* char * */
+	SNAP_INT,	/* int */
+	SNAP_UINT,	/* unsigned int */
+	SNAP_SIZE,	/* size_t */
+	SNAP_U64,	/* uint64_t */
+	SNAP_FLOAT	/* float, stored as hex bits to be exact and locale independent */
+};
+
+struct snap_field {
+	const char	*name;
+	int		type;
+	size_t		offset;
+};
+
+#define SNAP_FIELD(_s, _f, _t)	{ #_f, _t, offsetof(struct _s, _f) }
+
+static const struct snap_field arch_fields[] = {
+	SNAP_FIELD(lscpu_arch, name, SNAP_STR)
+};
+
+static const struct snap_field virt_fields[] = {
+	SNAP_FIELD(lscpu_virt, cpuflag, SNAP_STR),
+	SNAP_FIELD(lscpu_virt, hypervisor, SNAP_STR),
+	SNAP_FIELD(lscpu_virt, vendor, SNAP_INT),
+	SNAP_FIELD(lscpu_virt, type, SNAP_INT)
+};
+
+static const struct snap_field cputype_fields[] = {
+	SNAP_FIELD(lscpu_cputype, vendor, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, vendor_id, SNAP_INT),
+	SNAP_FIELD(lscpu_cputype, bios_vendor, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, machinetype, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, family, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, model, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, modelname, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, bios_modelname, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, revision, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, stepping, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, bogomips, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, flags, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, mtid, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, addrsz, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, dispatching, SNAP_INT),
+	SNAP_FIELD(lscpu_cputype, freqboost, SNAP_INT),
+	SNAP_FIELD(lscpu_cputype, physsockets, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, physchips, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, physcoresperchip, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, nthreads_per_core, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, ncores_per_socket, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, nsockets_per_book, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, nbooks_per_drawer, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, ndrawers_per_system, SNAP_SIZE),
+	SNAP_FIELD(lscpu_cputype, dynamic_mhz, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, static_mhz, SNAP_STR),
+	SNAP_FIELD(lscpu_cputype, nr_socket_on_cluster, SNAP_SIZE)
+};
+
+static const struct snap_field cpu_fields[] = {
+	SNAP_FIELD(lscpu_cpu, bogomips, SNAP_STR),
+	SNAP_FIELD(lscpu_cpu, mhz, SNAP_STR),
+	SNAP_FIELD(lscpu_cpu, dynamic_mhz, SNAP_STR),
+	SNAP_FIELD(lscpu_cpu, static_mhz, SNAP_STR),
+	SNAP_FIELD(lscpu_cpu, mhz_max_freq, SNAP_FLOAT),
+	SNAP_FIELD(lscpu_cpu, mhz_min_freq, SNAP_FLOAT),
+	SNAP_FIELD(lscpu_cpu, mhz_cur_freq, SNAP_FLOAT),
+	SNAP_FIELD(lscpu_cpu, coreid, SNAP_INT),
+	SNAP_FIELD(lscpu_cpu, socketid, SNAP_INT),
+	SNAP_FIELD(lscpu_cpu, bookid, SNAP_INT),
+	SNAP_FIELD(lscpu_cpu, drawerid, SNAP_INT),
+	SNAP_FIELD(lscpu_cpu, polarization, SNAP_INT),
+	SNAP_FIELD(lscpu_cpu, address, SNAP_INT),
+	SNAP_FIELD(lscpu_cpu, configured, SNAP_INT)
+};
+
+static const struct snap_field cache_fields[] = {
+	SNAP_FIELD(lscpu_cache, id, SNAP_INT),
+	SNAP_FIELD(lscpu_cache, nth, SNAP_INT),
+	SNAP_FIELD(lscpu_cache, name, SNAP_STR),
+	SNAP_FIELD(lscpu_cache, type, SNAP_STR),
+	SNAP_FIELD(lscpu_cache, allocation_policy, SNAP_STR),
+	SNAP_FIELD(lscpu_cache, write_policy, SNAP_STR),
+	SNAP_FIELD(lscpu_cache, level, SNAP_INT),
+	SNAP_FIELD(lscpu_cache, size, SNAP_U64),
+	SNAP_FIELD(lscpu_cache, ways_of_associativity, SNAP_UINT),
+	SNAP_FIELD(lscpu_cache, physical_line_partition, SNAP_UINT),
+	SNAP_FIELD(lscpu_cache, number_of_sets, SNAP_UINT),
+	SNAP_FIELD(lscpu_cache, coherency_line_size, SNAP_UINT),
+	SNAP_FIELD(lscpu_cache, index, SNAP_SIZE)
+};
+
+static const struct snap_field vul_fields[] = {
+	SNAP_FIELD(lscpu_vulnerability, name, SNAP_STR),
+	SNAP_FIELD(lscpu_vulnerability, text, SNAP_STR)
+};
+
+/*
+ * Key
+ */
+static void free_key(char **key)
+{
+	size_t i;
+
+	for (i = 0; i < __SNAP_KEY_COUNT; i++)
+		free(key[i]);
+}
+
+static void read_key(struct lscpu_cxt *cxt, char **key)
+{
+	struct utsname uts;
+	size_t i;
+
+	memset(key, 0, __SNAP_KEY_COUNT * sizeof(char *));
+
+	if (uname(&uts) == 0) {
+		key[SNAP_KEY_MACHINE] = xstrdup(uts.machine);
+		key[SNAP_KEY_RELEASE] = xstrdup(uts.release);
+		key[SNAP_KEY_VERSION] = xstrdup(uts.version);
+	}
+	ul_path_read_string(cxt->procfs, &key[SNAP_KEY_BOOT], "sys/kernel/random/boot_id");
+	if (cxt->prefix)
+		key[SNAP_KEY_SYSROOT] = xstrdup(cxt->prefix);
+
+	ul_path_read_string(cxt->syscpu, &key[SNAP_KEY_KERNELMAX], "kernel_max");
+	ul_path_read_string(cxt->syscpu, &key[SNAP_KEY_POSSIBLE], "possible");
+	ul_path_read_string(cxt->syscpu, &key[SNAP_KEY_PRESENT], "present");
+	ul_path_read_string(cxt->syscpu, &key[SNAP_KEY_ONLINE], "online");
+
+	for (i = 0; i < __SNAP_KEY_COUNT; i++) {
+		if (!key[i])
+			key[i] = xstrdup("");
+	}
+}
+
+/*
+ * Writer
+ */
+static void write_string(FILE *f, const char *name, const char *str)
+{
+	fputs(name, f);
+	fputc(' ', f);
+
+	for (; str && *str; str++) {
+		if (*str == '\\')
+			fputs("\\\\", f);
+		else if (*str == '\n')
+			fputs("\\n", f);
+		else
+			fputc(*str, f);
+	}
+	fputc('\n', f);
+}
+
+static void write_cpuset(struct lscpu_cxt *cxt, FILE *f,
+			 const char *name, cpu_set_t *set)
+{
+	size_t len = 7 * cxt->maxcpus + 1;
+	char *buf = xmalloc(len);
+
+	write_string(f, name, cpulist_create(buf, len, set, cxt->setsize));
+	free(buf);
+}
+
+static void write_fields(FILE *f, const struct snap_field *fields, size_t nfields,
+			 const void *obj)
+{
+	size_t i;
+
+	for (i = 0; i < nfields; i++) {
+		const struct snap_field *fl = &fields[i];
+		const void *data = (const char *) obj + fl->offset;
+
+		switch (fl->type) {
+		case SNAP_STR:
+		{
+			const char *str = *((char * const *) data);
+
+			if (str)
+				write_string(f, fl->name, str);
+			break;
+		}
+		case SNAP_INT:
+			fprintf(f, "%s %d\n", fl->name, *((const int *) data));
+			break;
+		case SNAP_UINT:
+			fprintf(f, "%s %u\n", fl->name, *((const unsigned int *) data));
+			break;
+		case SNAP_SIZE:
+			fprintf(f, "%s %zu\n", fl->name, *((const size_t *) data));
+			break;
+		case SNAP_U64:
+			fprintf(f, "%s %" PRIu64 "\n", fl->name, *((const uint64_t *) data));
+			break;
+		case SNAP_FLOAT:
+		{
+			uint32_t bits;
+
+			memcpy(&bits, data, sizeof(bits));
+			fprintf(f, "%s %08" PRIx32 "\n", fl->name, bits);
+			break;
+		}
+		}
+	}
+}
+
+static void write_cpusets(struct lscpu_cxt *cxt, FILE *f, const char *name,
+			  cpu_set_t **ary, size_t items)
+{
+	size_t i;
+
+	for (i = 0; ary && i < items; i++) {
+		if (ary[i])
+			write_cpuset(cxt, f, name, ary[i]);
+	}
+}
+
+static void write_caches(struct lscpu_cxt *cxt, FILE *f, const char *obj,
+			 struct lscpu_cache *caches, size_t ncaches)
+{
+	size_t i;
+
+	for (i = 0; i < ncaches; i++) {
+		struct lscpu_cache *ca = &caches[i];
+
+		fprintf(f, "%s\n", obj);
+		write_fields(f, cache_fields, ARRAY_SIZE(cache_fields), ca);
+		if (ca->sharedmap)
+			write_cpuset(cxt, f, "sharedmap", ca->sharedmap);
+	}
+}
+
+static size_t get_cputype_index(struct lscpu_cxt *cxt, struct lscpu_cputype *ct)
+{
+	size_t i;
+
+	for (i = 0; i < cxt->ncputypes; i++) {
+		if (cxt->cputypes[i] == ct)
+			break;
+	}
+	return i;
+}
+
+static void write_context(struct lscpu_cxt *cxt, FILE *f, char **key)
+{
+	size_t i;
+
+	fprintf(f, SNAP_MAGIC " %d\n", SNAP_VERSION);
+	for (i = 0; i < __SNAP_KEY_COUNT; i++)
+		write_string(f, snap_keys[i], key[i]);
+
+	fprintf(f, "maxcpus %d\n", cxt->maxcpus);
+	fprintf(f, "npossibles %zu\n", cxt->npossibles);
+	if (cxt->present)
+		write_cpuset(cxt, f, "present", cxt->present);
+	if (cxt->online)
+		write_cpuset(cxt, f, "online", cxt->online);
+	fprintf(f, "is_cluster %d\n", cxt->is_cluster);
+
+	if (cxt->arch) {
+		fputs("@arch\n", f);
+		write_fields(f, arch_fields, ARRAY_SIZE(arch_fields), cxt->arch);
+		fprintf(f, "bit32 %d\n", cxt->arch->bit32 ? 1 : 0);
+		fprintf(f, "bit64 %d\n", cxt->arch->bit64 ? 1 : 0);
+	}
+	if (cxt->virt) {
+		fputs("@virt\n", f);
+		write_fields(f, virt_fields, ARRAY_SIZE(virt_fields), cxt->virt);
+	}
+
+	for (i = 0; i < cxt->ncputypes; i++) {
+		struct lscpu_cputype *ct = cxt->cputypes[i];
+
+		fputs("@type\n", f);
+		write_fields(f, cputype_fields, ARRAY_SIZE(cputype_fields), ct);
+		fprintf(f, "has_freq %d\n", ct->has_freq ? 1 : 0);
+		fprintf(f, "has_configured %d\n", ct->has_configured ? 1 : 0);
+		fprintf(f, "has_polarization %d\n", ct->has_polarization ? 1 : 0);
+		fprintf(f, "has_addresses %d\n", ct->has_addresses ? 1 : 0);
+		write_cpusets(cxt, f, "coremap", ct->coremaps, ct->ncores);
+		write_cpusets(cxt, f, "socketmap", ct->socketmaps, ct->nsockets);
+		write_cpusets(cxt, f, "bookmap", ct->bookmaps, ct->nbooks);
+		write_cpusets(cxt, f, "drawermap", ct->drawermaps, ct->ndrawers);
+	}
+
+	for (i = 0; i < cxt->npossibles; i++) {
+		struct lscpu_cpu *cpu = cxt->cpus[i];
+
+		if (!cpu)
+			continue;
+		fprintf(f, "@cpu %zu %d\n", i, cpu->logical_id);
+		if (cpu->type)
+			fprintf(f, "type %zu\n", get_cputype_index(cxt, cpu->type));
+		write_fields(f, cpu_fields, ARRAY_SIZE(cpu_fields), cpu);
+	}
+
+	write_caches(cxt, f, "@cache", cxt->caches, cxt->ncaches);
+	write_caches(cxt, f, "@ecache", cxt->ecaches, cxt->necaches);
+
+	for (i = 0; i < cxt->nnodes; i++) {
+		fprintf(f, "@node %d\n", cxt->idx2nodenum[i]);
+		if (cxt->nodemaps[i])
+			write_cpuset(cxt, f, "map", cxt->nodemaps[i]);
+	}
+
+	for (i = 0; i < cxt->nvuls; i++) {
+		fputs("@vulnerability\n", f);
+		write_fields(f, vul_fields, ARRAY_SIZE(vul_fields), &cxt->vuls[i]);
+	}
+}
+
+/*
+ * Writes the gathered information to @filename, the file is replaced
+ * atomically. Returns 0 on success or negative errno.
+ */
+int lscpu_write_snapshot(struct lscpu_cxt *cxt, const char *filename)
+{
+	char *key[__SNAP_KEY_COUNT];
+	char *dir, *tmpname = NULL;
+	FILE *f;
+	int rc = 0;
+
+	DBG(GATHER, ul_debugobj(cxt, "writing snapshot %s", filename));
+
+	dir = xstrdup(filename);
+	stripoff_last_component(dir);
+
+	f = xfmkstemp(&tmpname, *dir ? dir : ".", "lscpu");
+	if (!f) {
+		rc = -errno;
+		goto done;
+	}
+
+	read_key(cxt, key);
+	write_context(cxt, f, key);
+	free_key(key);
+
+	if (fchmod(fileno(f), 0644) != 0 || close_stream(f) != 0)
+		rc = errno ? -errno : -EIO;
+	else if (rename(tmpname, filename) != 0)
+		rc = -errno;
+	if (rc)
+		unlink(tmpname);
+done:
+	DBG(GATHER, ul_debugobj(cxt, "snapshot write [rc=%d]", rc));
+	free(tmpname);
+	free(dir);
+	return rc;
+}
+
+/*
+ * Reader
+ */
+static void unescape_string(char *str)
+{
+	char *p = str;
+
+	for (; *str; str++) {
+		if (*str == '\\' && *(str + 1)) {
+			str++;
+			*p++ = *str == 'n' ? '\n' : *str;
+		} else
+			*p++ = *str;
+	}
+	*p = '\0';
+}
+
+/* reads the next line, returns NULL on EOF; @value is never NULL */
+static char *next_line(FILE *f, char **buf, size_t *bufsz, char **value)
+{
+	ssize_t len = getline(buf, bufsz, f);
+	char *p;
+
+	if (len <= 0)
+		return NULL;
+	if ((*buf)[len - 1] == '\n')
+		(*buf)[len - 1] = '\0';
+
+	p = strchr(*buf, ' ');
+	if (p) {
+		*p++ = '\0';
+		unescape_string(p);
+	} else
+		p = *buf + strlen(*buf);
+
+	*value = p;
+	return *buf;
+}
+
+static cpu_set_t *parse_cpuset(struct lscpu_cxt *cxt, const char *str)
+{
+	cpu_set_t *set;
+
+	if (cxt->maxcpus <= 0)
+		return NULL;
+
+	set = cpuset_alloc(cxt->maxcpus, NULL, NULL);
+	if (!set)
+		err(EXIT_FAILURE, _("failed to callocate cpu set"));
+	CPU_ZERO_S(cxt->setsize, set);
+
+	if (*str && cpulist_parse(str, set, cxt->setsize, 1) != 0) {
+		cpuset_free(set);
+		return NULL;
+	}
+	return set;
+}
+
+/* returns 1 if @name is not in @fields, 0 on success or negative errno */
+static int parse_field(const struct snap_field *fields, size_t nfields,
+		       void *obj, const char *name, const char *value)
+{
+	size_t i;
+
+	for (i = 0; i < nfields; i++) {
+		const struct snap_field *fl = &fields[i];
+		void *data = (char *) obj + fl->offset;
+		int32_t s32;
+		uint32_t u32;
+		uint64_t u64;
+
+		if (strcmp(fl->name, name) != 0)
+			continue;
+
+		switch (fl->type) {
+		case SNAP_STR:
+			free(*((char **) data));
+			*((char **) data) = xstrdup(value);
+			return 0;
+		case SNAP_INT:
+			if (ul_strtos32(value, &s32, 10) != 0)
+				return -EINVAL;
+			*((int *) data) = s32;
+			return 0;
+		case SNAP_UINT:
+			if (ul_strtou32(value, &u32, 10) != 0)
+				return -EINVAL;
+			*((unsigned int *) data) = u32;
+			return 0;
+		case SNAP_SIZE:
+			if (ul_strtou64(value, &u64, 10) != 0 || u64 > SIZE_MAX)
+				return -EINVAL;
+			*((size_t *) data) = (size_t) u64;
+			return 0;
+		case SNAP_U64:
+			if (ul_strtou64(value, &u64, 10) != 0)
+				return -EINVAL;
+			*((uint64_t *) data) = u64;
+			return 0;
+		case SNAP_FLOAT:
+			if (ul_strtou32(value, &u32, 16) != 0)
+				return -EINVAL;
+			memcpy(data, &u32, sizeof(u32));
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int parse_flag(const char *value)
+{
+	return strcmp(value, "1") == 0 ? 1 : 0;
+}
+
+/* adds @set to the array of the maps */
+static int add_cpuset(struct lscpu_cxt *cxt, cpu_set_t ***ary, size_t *items,
+		      const char *value)
+{
+	cpu_set_t *set = parse_cpuset(cxt, value);
+
+	if (!set)
+		return -EINVAL;
+	*ary = xrealloc(*ary, (*items + 1) * sizeof(cpu_set_t *));
+	(*ary)[(*items)++] = set;
+	return 0;
+}
+
+static struct lscpu_cache *new_cache(struct lscpu_cache **caches, size_t *ncaches)
+{
+	struct lscpu_cache *ca;
+
+	*caches = xrealloc(*caches, (*ncaches + 1) * sizeof(struct lscpu_cache));
+	ca = &(*caches)[(*ncaches)++];
+	memset(ca, 0, sizeof(*ca));
+	return ca;
+}
+
+/* starts a new object, returns the object or NULL on error */
+static void *parse_object(struct lscpu_cxt *cxt, const char *name,
+			  const char *value, int *objtype)
+{
+	if (strcmp(name, "@arch") == 0 && !cxt->arch) {
+		*objtype = SNAP_OBJ_ARCH;
+		return cxt->arch = xcalloc(1, sizeof(struct lscpu_arch));
+	}
+	if (strcmp(name, "@virt") == 0 && !cxt->virt) {
+		*objtype = SNAP_OBJ_VIRT;
+		return cxt->virt = xcalloc(1, sizeof(struct lscpu_virt));
+	}
+	if (strcmp(name, "@type") == 0) {
+		struct lscpu_cputype *ct = lscpu_new_cputype();
+
+		lscpu_add_cputype(cxt, ct);
+		lscpu_unref_cputype(ct);
+		*objtype = SNAP_OBJ_TYPE;
+		return ct;
+	}
+	if (strcmp(name, "@cpu") == 0) {
+		size_t idx;
+		int id;
+
+		if (sscanf(value, "%zu %d", &idx, &id) != 2
+		    || idx >= cxt->npossibles || cxt->cpus[idx] || id < 0)
+			return NULL;
+		*objtype = SNAP_OBJ_CPU;
+		return cxt->cpus[idx] = lscpu_new_cpu(id);
+	}
+	if (strcmp(name, "@cache") == 0) {
+		*objtype = SNAP_OBJ_CACHE;
+		return new_cache(&cxt->caches, &cxt->ncaches);
+	}
+	if (strcmp(name, "@ecache") == 0) {
+		*objtype = SNAP_OBJ_ECACHE;
+		return new_cache(&cxt->ecaches, &cxt->necaches);
+	}
+	if (strcmp(name, "@node") == 0) {
+		int32_t num;
+
+		if (ul_strtos32(value, &num, 10) != 0)
+			return NULL;
+		cxt->nodemaps = xrealloc(cxt->nodemaps,
+				(cxt->nnodes + 1) * sizeof(cpu_set_t *));
+		cxt->idx2nodenum = xrealloc(cxt->idx2nodenum,
+				(cxt->nnodes + 1) * sizeof(int));
+		cxt->nodemaps[cxt->nnodes] = NULL;
+		cxt->idx2nodenum[cxt->nnodes] = num;
+		*objtype = SNAP_OBJ_NODE;
+		return &cxt->nodemaps[cxt->nnodes++];
+	}
+	if (strcmp(name, "@vulnerability") == 0) {
+		struct lscpu_vulnerability *vu;
+
+		cxt->vuls = xrealloc(cxt->vuls,
+				(cxt->nvuls + 1) * sizeof(struct lscpu_vulnerability));
+		vu = &cxt->vuls[cxt->nvuls++];
+		memset(vu, 0, sizeof(*vu));
+		*objtype = SNAP_OBJ_VUL;
+		return vu;
+	}
+	return NULL;
+}
+
+static int parse_context_field(struct lscpu_cxt *cxt, const char *name, const char *value)
+{
+	int32_t num;
+	uint64_t u64;
+
+	if (strcmp(name, "maxcpus") == 0) {
+		if (cxt->maxcpus || ul_strtos32(value, &num, 10) != 0 || num <= 0)
+			return -EINVAL;
+		cxt->maxcpus = num;
+		cxt->setsize = CPU_ALLOC_SIZE(cxt->maxcpus);
+	} else if (strcmp(name, "npossibles") == 0) {
+		if (cxt->cpus || ul_strtou64(value, &u64, 10) != 0
+		    || u64 == 0 || u64 > (uint64_t) cxt->maxcpus)
+			return -EINVAL;
+		cxt->npossibles = u64;
+		cxt->cpus = xcalloc(cxt->npossibles, sizeof(struct lscpu_cpu *));
+	} else if (strcmp(name, "present") == 0 && !cxt->present) {
+		cxt->present = parse_cpuset(cxt, value);
+		if (!cxt->present)
+			return -EINVAL;
+		cxt->npresents = CPU_COUNT_S(cxt->setsize, cxt->present);
+	} else if (strcmp(name, "online") == 0 && !cxt->online) {
+		cxt->online = parse_cpuset(cxt, value);
+		if (!cxt->online)
+			return -EINVAL;
+		cxt->nonlines = CPU_COUNT_S(cxt->setsize, cxt->online);
+	} else if (strcmp(name, "is_cluster") == 0)
+		cxt->is_cluster = parse_flag(value);
+	else
+		return -EINVAL;
+	return 0;
+}
+
+static int parse_cputype_field(struct lscpu_cxt *cxt, struct lscpu_cputype *ct,
+			       const char *name, const char *value)
+{
+	if (strcmp(name, "has_freq") == 0)
+		ct->has_freq = parse_flag(value);
+	else if (strcmp(name, "has_configured") == 0)
+		ct->has_configured = parse_flag(value);
+	else if (strcmp(name, "has_polarization") == 0)
+		ct->has_polarization = parse_flag(value);
+	else if (strcmp(name, "has_addresses") == 0)
+		ct->has_addresses = parse_flag(value);
+	else if (strcmp(name, "coremap") == 0)
+		return add_cpuset(cxt, &ct->coremaps, &ct->ncores, value);
+	else if (strcmp(name, "socketmap") == 0)
+		return add_cpuset(cxt, &ct->socketmaps, &ct->nsockets, value);
+	else if (strcmp(name, "bookmap") == 0)
+		return add_cpuset(cxt, &ct->bookmaps, &ct->nbooks, value);
+	else if (strcmp(name, "drawermap") == 0)
+		return add_cpuset(cxt, &ct->drawermaps, &ct->ndrawers, value);
+	else
+		return parse_field(cputype_fields, ARRAY_SIZE(cputype_fields),
+				   ct, name, value) == 0 ? 0 : -EINVAL;
+	return 0;
+}
+
+static int parse_line(struct lscpu_cxt *cxt, const char *name, const char *value,
+		      int objtype, void *obj)
+{
+	switch (objtype) {
+	case SNAP_OBJ_CXT:
+		return parse_context_field(cxt, name, value);
+	case SNAP_OBJ_ARCH:
+	{
+		struct lscpu_arch *ar = obj;
+
+		if (strcmp(name, "bit32") == 0)
+			ar->bit32 = parse_flag(value);
+		else if (strcmp(name, "bit64") == 0)
+			ar->bit64 = parse_flag(value);
+		else if (parse_field(arch_fields, ARRAY_SIZE(arch_fields), obj, name, value))
+			return -EINVAL;
+		return 0;
+	}
+	case SNAP_OBJ_VIRT:
+		return parse_field(virt_fields, ARRAY_SIZE(virt_fields),
+				   obj, name, value) == 0 ? 0 : -EINVAL;
+	case SNAP_OBJ_TYPE:
+		return parse_cputype_field(cxt, obj, name, value);
+	case SNAP_OBJ_CPU:
+		if (strcmp(name, "type") == 0) {
+			uint64_t idx;
+
+			if (ul_strtou64(value, &idx, 10) != 0 || idx >= cxt->ncputypes)
+				return -EINVAL;
+			return lscpu_cpu_set_type(obj, cxt->cputypes[idx]);
+		}
+		return parse_field(cpu_fields, ARRAY_SIZE(cpu_fields),
+				   obj, name, value) == 0 ? 0 : -EINVAL;
+	case SNAP_OBJ_CACHE:
+	case SNAP_OBJ_ECACHE:
+		if (strcmp(name, "sharedmap") == 0) {
+			struct lscpu_cache *ca = obj;
+
+			if (ca->sharedmap)
+				return -EINVAL;
+			ca->sharedmap = parse_cpuset(cxt, value);
+			return ca->sharedmap ? 0 : -EINVAL;
+		}
+		return parse_field(cache_fields, ARRAY_SIZE(cache_fields),
+				   obj, name, value) == 0 ? 0 : -EINVAL;
+	case SNAP_OBJ_NODE:
+		if (strcmp(name, "map") == 0) {
+			cpu_set_t **map = obj;
+
+			if (*map)
+				return -EINVAL;
+			*map = parse_cpuset(cxt, value);
+			return *map ? 0 : -EINVAL;
+		}
+		return -EINVAL;
+	case SNAP_OBJ_VUL:
+		return parse_field(vul_fields, ARRAY_SIZE(vul_fields),
+				   obj, name, value) == 0 ? 0 : -EINVAL;
+	}
+	return -EINVAL;
+}
+
+/* the snapshot has to be usable in the same way as gathered data */
+static int verify_context(struct lscpu_cxt *cxt)
+{
+	size_t i;
+
+	if (!cxt->cpus || !cxt->arch || !cxt->ncputypes)
+		return -EINVAL;
+	for (i = 0; i < cxt->ncaches; i++) {
+		if (!cxt->caches[i].name || !cxt->caches[i].type)
+			return -EINVAL;
+	}
+	for (i = 0; i < cxt->necaches; i++) {
+		if (!cxt->ecaches[i].name || !cxt->ecaches[i].type)
+			return -EINVAL;
+	}
+	for (i = 0; i < cxt->nvuls; i++) {
+		if (!cxt->vuls[i].name || !cxt->vuls[i].text)
+			return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * Reads context from @filename. Returns 0 on success, 1 if the snapshot does
+ * not exist or it's obsolete, or negative errno. The context is reset on
+ * error (so ready to gather information from the system).
+ */
+int lscpu_read_snapshot(struct lscpu_cxt *cxt, const char *filename)
+{
+	char *key[__SNAP_KEY_COUNT];
+	char *line, *value, *buf = NULL;
+	size_t i, bufsz = 0;
+	int rc = 0, objtype = SNAP_OBJ_CXT;
+	void *obj = cxt;
+	FILE *f;
+
+	DBG(GATHER, ul_debugobj(cxt, "reading snapshot %s", filename));
+
+	f = fopen(filename, "r" UL_CLOEXECSTR);
+	if (!f)
+		return errno == ENOENT ? 1 : -errno;
+
+	line = next_line(f, &buf, &bufsz, &value);
+	if (!line || strcmp(line, SNAP_MAGIC) != 0
+	    || strcmp(value, stringify_value(SNAP_VERSION)) != 0) {
+		DBG(GATHER, ul_debugobj(cxt, " unsupported snapshot"));
+		rc = 1;
+		goto done;
+	}
+
+	read_key(cxt, key);
+	for (i = 0; rc == 0 && i < __SNAP_KEY_COUNT; i++) {
+		line = next_line(f, &buf, &bufsz, &value);
+		if (!line || strcmp(line, snap_keys[i]) != 0
+		    || strcmp(value, key[i]) != 0) {
+			DBG(GATHER, ul_debugobj(cxt, " %s changed", snap_keys[i]));
+			rc = 1;
+		}
+	}
+	free_key(key);
+	if (rc)
+		goto done;
+
+	while (rc == 0 && (line = next_line(f, &buf, &bufsz, &value))) {
+		if (*line == '@') {
+			obj = cxt->cpus ? parse_object(cxt, line, value, &objtype) : NULL;
+			if (!obj)
+				rc = -EINVAL;
+		} else
+			rc = parse_line(cxt, line, value, objtype, obj);
+	}
+	if (rc == 0)
+		rc = verify_context(cxt);
+	if (rc)
+		DBG(GATHER, ul_debugobj(cxt, " parse error at '%s'", buf));
+done:
+	free(buf);
+	fclose(f);
+
+	if (rc)
+		lscpu_reset_context(cxt);
+
+	DBG(GATHER, ul_debugobj(cxt, "snapshot read [rc=%d]", rc));
+	return rc;
+}
@@ -7,6 +7,10 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
 #include "lscpu.h"
 
 /* add @set to the @ary, unnecessary set is deallocated. */
@@ -30,6 +34,20 @@ static int add_cpuset_to_array(cpu_set_t **ary, size_t *items, cpu_set_t *set, s
 	return 1;
 }
 
+/* returns 1 if CPU @num is in any set of the @ary */
+static int is_cpu_in_array(cpu_set_t **ary, size_t items, int num, size_t setsize)
+{
+	size_t i;
+
+	if (!ary)
+		return 0;
+	for (i = 0; i < items; i++) {
+		if (ary[i] && CPU_ISSET_S(num, setsize, ary[i]))
+			return 1;
+	}
+	return 0;
+}
+
 static void free_cpuset_array(cpu_set_t **ary, int items)
 {
 	int i;
@@ -112,6 +130,17 @@ static int cputype_read_topology(struct lscpu_cxt *cxt, struct lscpu_cputype *ct
 			continue;
 
 		num = cpu->logical_id;
+
+		/* The maps are the same for all CPUs in the map, so don't read
+		 * them again if the CPU is already in all the maps. */
+		if (is_cpu_in_array(ct->coremaps, ct->ncores, num, cxt->setsize)
+		    && is_cpu_in_array(ct->socketmaps, ct->nsockets, num, cxt->setsize)
+		    && (!ct->bookmaps
+			|| is_cpu_in_array(ct->bookmaps, ct->nbooks, num, cxt->setsize))
+		    && (!ct->drawermaps
+			|| is_cpu_in_array(ct->drawermaps, ct->ndrawers, num, cxt->setsize)))
+			continue;
+
 		if (ul_path_accessf(sys, F_OK,
 					"cpu%d/topology/thread_siblings", num) != 0)
 			continue;
@@ -370,17 +399,46 @@ static int read_sparc_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	return 0;
 }
 
-static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+/*
+ * Returns already known cache cache/index<@idx> of the CPU; the index is the
+ * same for all CPUs which share the cache (the kernel sorts the caches by
+ * level and type).
+ */
+static struct lscpu_cache *get_shared_cache(struct lscpu_cxt *cxt,
+				struct lscpu_cpu *cpu, size_t idx)
+{
+	size_t i;
+
+	for (i = 0; i < cxt->ncaches; i++) {
+		struct lscpu_cache *ca = &cxt->caches[i];
+
+		if (ca->index == idx && ca->name && ca->sharedmap &&
+		    CPU_ISSET_S(cpu->logical_id, cxt->setsize, ca->sharedmap))
+			return ca;
+	}
+	return NULL;
+}
+
+/*
+ * The @hint is number of caches of the previous CPU, usually all CPUs have
+ * the same number of caches, so check the last index and the next one only.
+ */
+static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu, size_t *hint)
 {
 	char buf[256];
 	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 	size_t i, ncaches = 0;
 
+	if (*hint && ul_path_accessf(sys, F_OK,
+				"cpu%d/cache/index%zu", num, *hint - 1) == 0)
+		ncaches = *hint;
+
 	while (ul_path_accessf(sys, F_OK,
 				"cpu%d/cache/index%zu",
 				num, ncaches) == 0)
 		ncaches++;
+	*hint = ncaches;
 
 	if (ncaches == 0 && ul_path_accessf(sys, F_OK,
 				"cpu%d/l1_icache_size", num) == 0)
@@ -392,6 +450,10 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 		struct lscpu_cache *ca;
 		int id, level;
 
+		/* already read for another CPU */
+		if (get_shared_cache(cxt, cpu, i))
+			continue;
+
 		if (ul_path_readf_s32(sys, &id, "cpu%d/cache/index%zu/id", num, i) != 0)
 			id = -1;
 		if (ul_path_readf_s32(sys, &level, "cpu%d/cache/index%zu/level", num, i) != 0)
@@ -423,6 +485,7 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 				snprintf(buf, sizeof(buf), "L%d", ca->level);
 
 			ca->name = xstrdup(buf);
+			ca->index = i;
 
 			ul_path_readf_u32(sys, &ca->ways_of_associativity,
 					"cpu%d/cache/index%zu/ways_of_associativity", num, i);
@@ -455,9 +518,8 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	return 0;
 }
 
-static int read_ids(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_ids(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 
 	if (ul_path_accessf(sys, F_OK, "cpu%d/topology", num) != 0)
@@ -477,9 +539,8 @@ static int read_ids(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	return 0;
 }
 
-static int read_polarization(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_polarization(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 	char mode[64];
 
@@ -501,14 +562,12 @@ static int read_polarization(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	else
 		cpu->polarization = POLAR_UNKNOWN;
 
-	if (cpu->type)
-		cpu->type->has_polarization = 1;
+	cpu->has_polarization = 1;
 	return 0;
 }
 
-static int read_address(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_address(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 
 	if (ul_path_accessf(sys, F_OK, "cpu%d/address", num) != 0)
@@ -517,14 +576,12 @@ static int read_address(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	DBG(CPU, ul_debugobj(cpu, "#%d reading address", num));
 
 	ul_path_readf_s32(sys, &cpu->address, "cpu%d/address", num);
-	if (cpu->type)
-		cpu->type->has_addresses = 1;
+	cpu->has_address = 1;
 	return 0;
 }
 
-static int read_configure(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_configure(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 
 	if (ul_path_accessf(sys, F_OK, "cpu%d/configure", num) != 0)
@@ -533,14 +590,12 @@ static int read_configure(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	DBG(CPU, ul_debugobj(cpu, "#%d reading configure", num));
 
 	ul_path_readf_s32(sys, &cpu->configured, "cpu%d/configure", num);
-	if (cpu->type)
-		cpu->type->has_configured = 1;
+	cpu->has_configured = 1;
 	return 0;
 }
 
-static int read_mhz(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+static int read_mhz(struct path_cxt *sys, struct lscpu_cpu *cpu)
 {
-	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 	int mhz;
 
@@ -564,9 +619,6 @@ static int read_mhz(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	if (cpu->mhz_cur_freq > cpu->mhz_max_freq)
 		cpu->mhz_cur_freq = cpu->mhz_max_freq;
 
-	if (cpu->type && (cpu->mhz_min_freq || cpu->mhz_max_freq))
-		cpu->type->has_freq = 1;
-
 	return 0;
 }
 
@@ -622,36 +674,177 @@ float lsblk_cputype_get_scalmhz(struct lscpu_cxt *cxt, struct lscpu_cputype *ct)
 	return fcur / fmax * 100;
 }
 
+/* per-CPU attributes, independent on other CPUs */
+static int read_cpu_attrs(struct path_cxt *sys, struct lscpu_cpu *cpu)
+{
+	int rc;
+
+	DBG(CPU, ul_debugobj(cpu, "#%d reading topology", cpu->logical_id));
+
+	rc = read_ids(sys, cpu);
+	if (!rc)
+		rc = read_polarization(sys, cpu);
+	if (!rc)
+		rc = read_address(sys, cpu);
+	if (!rc)
+		rc = read_configure(sys, cpu);
+	if (!rc)
+		rc = read_mhz(sys, cpu);
+	return rc;
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Parallel reading of the per-CPU attributes on machines with many CPUs
+ */
+#define LSCPU_PARALLEL_MINCPUS	64	/* don't start threads for less CPUs */
+#define LSCPU_PARALLEL_MAXTHREADS	16
+
+struct attrs_workers {
+	struct lscpu_cxt	*cxt;
+	size_t			next;	/* the next CPU to read */
+	int			rc;
+
+	pthread_mutex_t		lock;	/* protects @next and @rc */
+};
+
+static void *attrs_worker(void *data)
+{
+	struct attrs_workers *wrk = (struct attrs_workers *) data;
+	struct lscpu_cxt *cxt = wrk->cxt;
+	struct path_cxt *sys;
+	int rc = 0;
+
+	/* path_cxt is not thread-safe (buffers, dirfd cache) */
+	sys = ul_new_path(_PATH_SYS_CPU);
+	if (!sys)
+		rc = -ENOMEM;
+	else {
+		if (cxt->prefix)
+			ul_path_set_prefix(sys, cxt->prefix);
+		ul_path_enable_subdirs(sys, 1);
+		/* open the directory before the first *f() call, the path
+		 * buffer is used to compose the directory path too */
+		ul_path_get_dirfd(sys);
+	}
+
+	while (rc == 0) {
+		struct lscpu_cpu *cpu;
+		size_t idx;
+
+		pthread_mutex_lock(&wrk->lock);
+		idx = wrk->rc ? cxt->npossibles : wrk->next++;
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (idx >= cxt->npossibles)
+			break;
+		cpu = cxt->cpus[idx];
+		if (cpu && cpu->type)
+			rc = read_cpu_attrs(sys, cpu);
+	}
+
+	if (rc) {
+		pthread_mutex_lock(&wrk->lock);
+		wrk->rc = rc;
+		pthread_mutex_unlock(&wrk->lock);
+	}
+	ul_unref_path(sys);
+	return NULL;
+}
+
+/*
+ * Returns 1 if attributes have been read by threads, or 0 if the caller has to
+ * read them. The CPUs are independent and the main thread does not touch
+ * them until all workers are done.
+ */
+static int read_cpus_attrs_parallel(struct lscpu_cxt *cxt, int *rc)
+{
+	struct attrs_workers wrk = { .cxt = cxt };
+	pthread_t *threads;
+	long ncpus;
+	size_t i, nthreads, nrun;
+
+	if (cxt->npossibles < LSCPU_PARALLEL_MINCPUS)
+		return 0;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus < 2)
+		return 0;
+	nthreads = min((size_t) ncpus, (size_t) LSCPU_PARALLEL_MAXTHREADS);
+
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	DBG(GATHER, ul_debugobj(cxt, "reading %zu CPUs by %zu threads",
+				cxt->npossibles, nthreads));
+
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, attrs_worker, &wrk) != 0)
+			break;
+	}
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+
+	if (!nrun)
+		return 0;	/* no thread started, read it serially */
+	*rc = wrk.rc;
+	return 1;
+}
+#else
+static int read_cpus_attrs_parallel(
+			struct lscpu_cxt *cxt __attribute__((__unused__)),
+			int *rc __attribute__((__unused__)))
+{
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 int lscpu_read_topology(struct lscpu_cxt *cxt)
 {
-	size_t i;
+	size_t i, hint = 0;
 	int rc = 0;
 
+	/* opendir() based cache for the cpu<N>/ directories */
+	ul_path_enable_subdirs(cxt->syscpu, 1);
 
 	for (i = 0; i < cxt->ncputypes; i++)
 		rc += cputype_read_topology(cxt, cxt->cputypes[i]);
 
+	if (rc == 0 && !read_cpus_attrs_parallel(cxt, &rc)) {
+		for (i = 0; rc == 0 && i < cxt->npossibles; i++) {
+			struct lscpu_cpu *cpu = cxt->cpus[i];
+
+			if (cpu && cpu->type)
+				rc = read_cpu_attrs(cxt->syscpu, cpu);
+		}
+	}
+
+	/* merge the per-CPU results to the types, and read the shared
+	 * caches (the list of the caches is global) */
 	for (i = 0; rc == 0 && i < cxt->npossibles; i++) {
 		struct lscpu_cpu *cpu = cxt->cpus[i];
+		struct lscpu_cputype *ct;
 
 		if (!cpu || !cpu->type)
 			continue;
-
-		DBG(CPU, ul_debugobj(cpu, "#%d reading topology", cpu->logical_id));
-
-		rc = read_ids(cxt, cpu);
-		if (!rc)
-			rc = read_polarization(cxt, cpu);
-		if (!rc)
-			rc = read_address(cxt, cpu);
-		if (!rc)
-			rc = read_configure(cxt, cpu);
-		if (!rc)
-			rc = read_mhz(cxt, cpu);
-		if (!rc)
-			rc = read_caches(cxt, cpu);
+		ct = cpu->type;
+		if (cpu->has_polarization)
+			ct->has_polarization = 1;
+		if (cpu->has_address)
+			ct->has_addresses = 1;
+		if (cpu->has_configured)
+			ct->has_configured = 1;
+		if (cpu->mhz_min_freq || cpu->mhz_max_freq)
+			ct->has_freq = 1;
+
+		rc = read_caches(cxt, cpu, &hint);
 	}
 
+	ul_path_enable_subdirs(cxt->syscpu, 0);
+
 	lscpu_sort_caches(cxt->caches, cxt->ncaches);
 	DBG(GATHER, ul_debugobj(cxt, " L1d: %zu", lscpu_get_cache_full_size(cxt, "L1d", NULL)));
 	DBG(GATHER, ul_debugobj(cxt, " L1i: %zu", lscpu_get_cache_full_size(cxt, "L1i", NULL)));
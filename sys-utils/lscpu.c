@@ -236,19 +236,11 @@ static struct lscpu_cxt *lscpu_new_context(void)
 	return xcalloc(1, sizeof(struct lscpu_cxt));
 }
 
-static void lscpu_free_context(struct lscpu_cxt *cxt)
+/* deallocates all gathered information, paths and options are untouched */
+void lscpu_reset_context(struct lscpu_cxt *cxt)
 {
 	size_t i;
 
-	if (!cxt)
-		return;
-
-	DBG(MISC, ul_debugobj(cxt, "freeing context"));
-
-	DBG(MISC, ul_debugobj(cxt, " de-initialize paths"));
-	ul_unref_path(cxt->syscpu);
-	ul_unref_path(cxt->procfs);
-
 	DBG(MISC, ul_debugobj(cxt, " freeing cpus"));
 	for (i = 0; i < cxt->npossibles; i++) {
 		lscpu_unref_cpu(cxt->cpus[i]);
@@ -283,6 +275,37 @@ static void lscpu_free_context(struct lscpu_cxt *cxt)
 	lscpu_free_caches(cxt->ecaches, cxt->necaches);
 	lscpu_free_caches(cxt->caches, cxt->ncaches);
 
+	cxt->maxcpus = 0;
+	cxt->setsize = 0;
+	cxt->ncputypes = cxt->npossibles = cxt->npresents = cxt->nonlines = 0;
+	cxt->cputypes = NULL;
+	cxt->cpus = NULL;
+	cxt->present = cxt->online = NULL;
+	cxt->arch = NULL;
+	cxt->virt = NULL;
+	cxt->vuls = NULL;
+	cxt->nvuls = 0;
+	cxt->caches = cxt->ecaches = NULL;
+	cxt->ncaches = cxt->necaches = 0;
+	cxt->nnodes = 0;
+	cxt->idx2nodenum = NULL;
+	cxt->nodemaps = NULL;
+	cxt->is_cluster = 0;
+}
+
+static void lscpu_free_context(struct lscpu_cxt *cxt)
+{
+	if (!cxt)
+		return;
+
+	DBG(MISC, ul_debugobj(cxt, "freeing context"));
+
+	DBG(MISC, ul_debugobj(cxt, " de-initialize paths"));
+	ul_unref_path(cxt->syscpu);
+	ul_unref_path(cxt->procfs);
+
+	lscpu_reset_context(cxt);
+
 	free(cxt);
 }
 
@@ -1160,6 +1183,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -x, --hex               print hexadecimal masks rather than lists of CPUs\n"), out);
 	fputs(_(" -y, --physical          print physical instead of logical IDs\n"), out);
 	fputs(_("     --output-all        print all available columns for -e, -p or -C\n"), out);
+	fputs(_("     --snapshot <file>   reuse CPU information from file if the system has not changed\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(25));
 
@@ -1183,9 +1207,11 @@ int main(int argc, char *argv[])
 	int columns[ARRAY_SIZE(coldescs_cpu)];
 	int cpu_modifier_specified = 0;
 	char *outarg = NULL;
+	const char *snapshot = NULL;
 	size_t i, ncolumns = 0;
 	enum {
 		OPT_OUTPUT_ALL = CHAR_MAX + 1,
+		OPT_SNAPSHOT,
 	};
 	static const struct option longopts[] = {
 		{ "all",        no_argument,       NULL, 'a' },
@@ -1202,6 +1228,7 @@ int main(int argc, char *argv[])
 		{ "hex",	no_argument,	   NULL, 'x' },
 		{ "version",	no_argument,	   NULL, 'V' },
 		{ "output-all",	no_argument,	   NULL, OPT_OUTPUT_ALL },
+		{ "snapshot",	required_argument, NULL, OPT_SNAPSHOT },
 		{ NULL,		0, NULL, 0 }
 	};
 
@@ -1272,6 +1299,9 @@ int main(int argc, char *argv[])
 		case OPT_OUTPUT_ALL:
 			all = 1;
 			break;
+		case OPT_SNAPSHOT:
+			snapshot = optarg;
+			break;
 
 		case 'h':
 			usage();
@@ -1316,18 +1346,23 @@ int main(int argc, char *argv[])
 
 	lscpu_context_init_paths(cxt);
 
-	lscpu_read_cpulists(cxt);
-	lscpu_read_cpuinfo(cxt);
-	cxt->arch = lscpu_read_architecture(cxt);
+	if (!snapshot || lscpu_read_snapshot(cxt, snapshot) != 0) {
+		lscpu_read_cpulists(cxt);
+		lscpu_read_cpuinfo(cxt);
+		cxt->arch = lscpu_read_architecture(cxt);
+
+		lscpu_read_archext(cxt);
+		lscpu_read_vulnerabilities(cxt);
+		lscpu_read_numas(cxt);
+		lscpu_read_topology(cxt);
 
-	lscpu_read_archext(cxt);
-	lscpu_read_vulnerabilities(cxt);
-	lscpu_read_numas(cxt);
-	lscpu_read_topology(cxt);
+		lscpu_decode_arm(cxt);
 
-	lscpu_decode_arm(cxt);
+		cxt->virt = lscpu_read_virtualization(cxt);
 
-	cxt->virt = lscpu_read_virtualization(cxt);
+		if (snapshot && lscpu_write_snapshot(cxt, snapshot) != 0)
+			warn(_("cannot write snapshot %s"), snapshot);
+	}
 
 	switch(cxt->mode) {
 	case LSCPU_OUTPUT_SUMMARY:
@@ -51,6 +51,7 @@ struct lscpu_cache {
 	unsigned int	number_of_sets;
 	unsigned int	coherency_line_size;
 
+	size_t		index;		/* cache/index<N> in sysfs */
 	cpu_set_t	*sharedmap;
 };
 
@@ -142,6 +143,10 @@ struct lscpu_cpu {
 	int	polarization;	/* POLAR_* */
 	int	address;	/* physical cpu address */
 	int	configured;	/* cpu configured */
+
+	unsigned int	has_polarization : 1,	/* see lscpu_read_topology() */
+			has_address : 1,
+			has_configured : 1;
 };
 
 struct lscpu_arch {
@@ -289,6 +294,10 @@ void lscpu_free_architecture(struct lscpu_arch *ar);
 struct lscpu_virt *lscpu_read_virtualization(struct lscpu_cxt *cxt);
 void lscpu_free_virtualization(struct lscpu_virt *virt);
 
+void lscpu_reset_context(struct lscpu_cxt *cxt);
+int lscpu_read_snapshot(struct lscpu_cxt *cxt, const char *filename);
+int lscpu_write_snapshot(struct lscpu_cxt *cxt, const char *filename);
+
 struct lscpu_cpu *lscpu_new_cpu(int id);
 void lscpu_ref_cpu(struct lscpu_cpu *cpu);
 void lscpu_unref_cpu(struct lscpu_cpu *cpu);
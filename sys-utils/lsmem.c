@@ -32,9 +32,18 @@
 #include <inttypes.h>
 #include <assert.h>
 #include <optutils.h>
+#include <all-io.h>
 #include <libsmartcols.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #define _PATH_SYS_MEMORY		"/sys/devices/system/memory"
+#define _PATH_SYS_NODE			"/sys/devices/system/node"
+
+/* use threads to read attributes for at least this number of blocks */
+#define LSMEM_PARALLEL_MINBLOCKS	1024
+#define LSMEM_PARALLEL_MAXTHREADS	16
 
 #define MEMORY_STATE_ONLINE		0
 #define MEMORY_STATE_OFFLINE		1
@@ -67,6 +76,8 @@ struct lsmem {
 	struct path_cxt		*sysmem;		/* _PATH_SYS_MEMORY directory handler */
 	struct dirent		**dirs;
 	int			ndirs;
+	int			*nodes;			/* node for dirs[], or -1 */
+	int			dirfd;			/* sysmem directory */
 	struct memory_block	*blocks;
 	int			nblocks;
 	uint64_t		block_size;
@@ -88,7 +99,10 @@ struct lsmem {
 				split_by_state : 1,
 				split_by_removable : 1,
 				split_by_zones : 1,
-				have_zones : 1;
+				have_zones : 1,
+				want_removable : 1,	/* attributes to read */
+				want_node : 1,
+				want_zones : 1;
 };
 
 
@@ -188,6 +202,17 @@ static inline int get_column_id(int num)
 	return columns[num];
 }
 
+static int has_column(int id)
+{
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++) {
+		if (columns[i] == id)
+			return 1;
+	}
+	return 0;
+}
+
 static inline struct coldesc *get_column_desc(int num)
 {
 	return &coldescs[ get_column_id(num) ];
@@ -332,14 +357,18 @@ static void print_summary(struct lsmem *lsmem)
 	}
 }
 
-static int memory_block_get_node(struct lsmem *lsmem, char *name)
+/*
+ * All the functions below are called from the threads; they use only the
+ * sysmem directory fd and don't modify @lsmem.
+ */
+static int memory_block_get_node(struct lsmem *lsmem, const char *name)
 {
 	struct dirent *de;
 	DIR *dir;
-	int node;
+	int node, fd;
 
-	dir = ul_path_opendir(lsmem->sysmem, name);
-	if (!dir)
+	fd = openat(lsmem->dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0 || !(dir = fdopendir(fd)))
 		err(EXIT_FAILURE, _("Failed to open %s"), name);
 
 	node = -1;
@@ -358,11 +387,34 @@ static int memory_block_get_node(struct lsmem *lsmem, char *name)
 	return node;
 }
 
-static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
+/* reads "<name>/<attr>" without the trailing newline */
+static ssize_t memory_block_read_attr(struct lsmem *lsmem, const char *name,
+				      const char *attr, char *buf, size_t bufsz)
+{
+	char path[PATH_MAX];
+	ssize_t sz;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", name, attr);
+	fd = openat(lsmem->dirfd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	sz = read_all(fd, buf, bufsz - 1);
+	close(fd);
+	if (sz < 0)
+		return sz;
+	if (sz > 0 && buf[sz - 1] == '\n')
+		sz--;
+	buf[sz] = '\0';
+	return sz;
+}
+
+static int memory_block_read_attrs(struct lsmem *lsmem, int idx,
 				    struct memory_block *blk)
 {
-	char *line = NULL;
-	int i, x = 0, rc = 0;
+	const char *name = lsmem->dirs[idx]->d_name;
+	char line[BUFSIZ];
+	int i, rc = 0;
 
 	memset(blk, 0, sizeof(*blk));
 
@@ -374,40 +426,111 @@ static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 	if (errno)
 		rc = -errno;
 
-	if (ul_path_readf_s32(lsmem->sysmem, &x, "%s/removable", name) == 0)
-		blk->removable = x == 1;
+	if (lsmem->want_removable
+	    && memory_block_read_attr(lsmem, name, "removable", line, sizeof(line)) > 0)
+		blk->removable = strcmp(line, "1") == 0;
 
-	if (ul_path_readf_string(lsmem->sysmem, &line, "%s/state", name) > 0 && line) {
+	if (memory_block_read_attr(lsmem, name, "state", line, sizeof(line)) > 0) {
 		if (strcmp(line, "offline") == 0)
 			blk->state = MEMORY_STATE_OFFLINE;
 		else if (strcmp(line, "online") == 0)
 			blk->state = MEMORY_STATE_ONLINE;
 		else if (strcmp(line, "going-offline") == 0)
 			blk->state = MEMORY_STATE_GOING_OFFLINE;
-		free(line);
 	}
 
-	if (lsmem->have_nodes)
-		blk->node = memory_block_get_node(lsmem, name);
+	if (lsmem->want_node) {
+		blk->node = lsmem->nodes ? lsmem->nodes[idx] : -1;
+		if (blk->node < 0)
+			blk->node = memory_block_get_node(lsmem, name);
+	}
 
 	blk->nr_zones = 0;
-	if (lsmem->have_zones
-	    && ul_path_readf_string(lsmem->sysmem, &line, "%s/valid_zones", name) > 0
-	    && line) {
-
-		char *token = strtok(line, " ");
+	if (lsmem->want_zones
+	    && memory_block_read_attr(lsmem, name, "valid_zones", line, sizeof(line)) > 0) {
+		char *token, *save = NULL;
 
+		token = strtok_r(line, " ", &save);
 		for (i = 0; token && i < MAX_NR_ZONES; i++) {
 			blk->zones[i] = zone_name_to_id(token);
 			blk->nr_zones++;
-			token = strtok(NULL, " ");
+			token = strtok_r(NULL, " ", &save);
 		}
-		free(line);
 	}
 
 	return rc;
 }
 
+#ifdef HAVE_LIBPTHREAD
+struct attrs_workers {
+	struct lsmem		*lsmem;
+	struct memory_block	*blks;
+
+	pthread_mutex_t		lock;	/* protects @next */
+	int			next;
+};
+
+static void *attrs_worker(void *data)
+{
+	struct attrs_workers *wrk = data;
+
+	for (;;) {
+		int idx;
+
+		pthread_mutex_lock(&wrk->lock);
+		idx = wrk->next++;
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (idx >= wrk->lsmem->ndirs)
+			break;
+		memory_block_read_attrs(wrk->lsmem, idx, &wrk->blks[idx]);
+	}
+	return NULL;
+}
+
+/*
+ * Returns 1 if the blocks have been read by threads, or 0 if the caller has
+ * to read them.
+ */
+static int read_blocks_parallel(struct lsmem *lsmem, struct memory_block *blks)
+{
+	struct attrs_workers wrk = { .lsmem = lsmem, .blks = blks };
+	pthread_t *threads;
+	size_t i, nthreads, nrun;
+	long ncpus;
+
+	if (lsmem->ndirs < LSMEM_PARALLEL_MINBLOCKS)
+		return 0;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus < 2)
+		return 0;
+	nthreads = min((size_t) ncpus, (size_t) LSMEM_PARALLEL_MAXTHREADS);
+
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		if (pthread_create(&threads[nrun], NULL, attrs_worker, &wrk) != 0)
+			break;
+	}
+	for (i = 0; i < nrun; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+
+	return nrun ? 1 : 0;
+}
+#else
+static int read_blocks_parallel(
+			struct lsmem *lsmem __attribute__((__unused__)),
+			struct memory_block *blks __attribute__((__unused__)))
+{
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static int is_mergeable(struct lsmem *lsmem, struct memory_block *blk)
 {
 	struct memory_block *curr;
@@ -450,11 +573,12 @@ static void free_info(struct lsmem *lsmem)
 	for (i = 0; i < lsmem->ndirs; i++)
 		free(lsmem->dirs[i]);
 	free(lsmem->dirs);
+	free(lsmem->nodes);
 }
 
 static void read_info(struct lsmem *lsmem)
 {
-	struct memory_block blk;
+	struct memory_block *blks;
 	char buf[128];
 	int i;
 
@@ -466,20 +590,29 @@ static void read_info(struct lsmem *lsmem)
 	if (errno)
 		err(EXIT_FAILURE, _("failed to read memory block size"));
 
+	/* the blocks are independent, read them first and merge later */
+	blks = xcalloc(lsmem->ndirs, sizeof(struct memory_block));
+	if (!read_blocks_parallel(lsmem, blks)) {
+		for (i = 0; i < lsmem->ndirs; i++)
+			memory_block_read_attrs(lsmem, i, &blks[i]);
+	}
+
 	for (i = 0; i < lsmem->ndirs; i++) {
-		memory_block_read_attrs(lsmem, lsmem->dirs[i]->d_name, &blk);
-		if (blk.state == MEMORY_STATE_ONLINE)
+		struct memory_block *blk = &blks[i];
+
+		if (blk->state == MEMORY_STATE_ONLINE)
 			lsmem->mem_online += lsmem->block_size;
 		else
 			lsmem->mem_offline += lsmem->block_size;
-		if (is_mergeable(lsmem, &blk)) {
+		if (is_mergeable(lsmem, blk)) {
 			lsmem->blocks[lsmem->nblocks - 1].count++;
 			continue;
 		}
 		lsmem->nblocks++;
-		lsmem->blocks = xrealloc(lsmem->blocks, lsmem->nblocks * sizeof(blk));
-		*&lsmem->blocks[lsmem->nblocks - 1] = blk;
+		lsmem->blocks = xrealloc(lsmem->blocks, lsmem->nblocks * sizeof(*blk));
+		lsmem->blocks[lsmem->nblocks - 1] = *blk;
 	}
+	free(blks);
 }
 
 static int memory_block_filter(const struct dirent *de)
@@ -489,7 +622,73 @@ static int memory_block_filter(const struct dirent *de)
 	return isdigit_string(de->d_name + 6);
 }
 
-static void read_basic_info(struct lsmem *lsmem)
+static int cmp_dir_index(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = strtoumax((*(struct dirent * const *) b)->d_name + 6, NULL, 10);
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * The node<N>/memory<M> links map all the blocks to the nodes by a few
+ * directory reads, rather than to read all memory<M>/ directories. Blocks not
+ * found in the map are resolved later from the block directory.
+ */
+static void read_nodes_map(struct lsmem *lsmem, const char *prefix)
+{
+	struct path_cxt *sysnode;
+	struct dirent *de;
+	DIR *dir;
+	int i;
+
+	sysnode = ul_new_path(_PATH_SYS_NODE);
+	if (!sysnode)
+		err(EXIT_FAILURE, _("failed to initialize %s handler"), _PATH_SYS_NODE);
+	if (prefix && ul_path_set_prefix(sysnode, prefix) != 0)
+		err(EXIT_FAILURE, _("invalid argument to --sysroot"));
+
+	dir = ul_path_opendir(sysnode, NULL);
+	if (!dir)
+		goto done;
+
+	lsmem->nodes = xmalloc(lsmem->ndirs * sizeof(int));
+	for (i = 0; i < lsmem->ndirs; i++)
+		lsmem->nodes[i] = -1;
+
+	while ((de = readdir(dir))) {
+		struct dirent *xde;
+		DIR *xdir;
+		int node;
+
+		if (strncmp("node", de->d_name, 4) != 0
+		    || !isdigit_string(de->d_name + 4))
+			continue;
+		node = strtol(de->d_name + 4, NULL, 10);
+
+		xdir = ul_path_opendir(sysnode, de->d_name);
+		if (!xdir)
+			continue;
+		while ((xde = readdir(xdir))) {
+			struct dirent **x;
+			uint64_t idx;
+
+			if (!memory_block_filter(xde))
+				continue;
+			idx = strtoumax(xde->d_name + 6, NULL, 10);
+			x = bsearch(&idx, lsmem->dirs, lsmem->ndirs,
+				    sizeof(struct dirent *), cmp_dir_index);
+			if (x)
+				lsmem->nodes[x - lsmem->dirs] = node;
+		}
+		closedir(xdir);
+	}
+	closedir(dir);
+done:
+	ul_unref_path(sysnode);
+}
+
+static void read_basic_info(struct lsmem *lsmem, const char *prefix)
 {
 	char dir[PATH_MAX];
 
@@ -502,12 +701,26 @@ static void read_basic_info(struct lsmem *lsmem)
 	if (lsmem->ndirs <= 0)
 		err(EXIT_FAILURE, _("Failed to read %s"), dir);
 
+	lsmem->dirfd = ul_path_get_dirfd(lsmem->sysmem);
+	if (lsmem->dirfd < 0)
+		err(EXIT_FAILURE, _("Failed to open %s"), dir);
+
 	if (memory_block_get_node(lsmem, lsmem->dirs[0]->d_name) != -1)
 		lsmem->have_nodes = 1;
 
 	/* The valid_zones sysmem attribute was introduced with kernel 3.18 */
 	if (ul_path_access(lsmem->sysmem, F_OK, "memory0/valid_zones") == 0)
 		lsmem->have_zones = 1;
+
+	/* read only the attributes necessary for the output */
+	lsmem->want_removable = has_column(COL_REMOVABLE) || lsmem->split_by_removable;
+	lsmem->want_node = lsmem->have_nodes
+			   && (has_column(COL_NODE) || lsmem->split_by_node);
+	lsmem->want_zones = lsmem->have_zones
+			   && (has_column(COL_ZONES) || lsmem->split_by_zones);
+
+	if (lsmem->want_node)
+		read_nodes_map(lsmem, prefix);
 }
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -672,7 +885,7 @@ int main(int argc, char **argv)
 
 	/* Shortcut to avoid scols machinery on --summary=only */
 	if (lsmem->want_table == 0 && lsmem->want_summary) {
-		read_basic_info(lsmem);
+		read_basic_info(lsmem, prefix);
 		read_info(lsmem);
 		print_summary(lsmem);
 		return EXIT_SUCCESS;
@@ -753,7 +966,7 @@ int main(int argc, char **argv)
 	/*
 	 * Read data and print output
 	 */
-	read_basic_info(lsmem);
+	read_basic_info(lsmem, prefix);
 	read_info(lsmem);
 
 	if (lsmem->want_table) {
@@ -24,9 +24,11 @@
 #include <assert.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <wchar.h>
+#include <search.h>
 #include <libsmartcols.h>
 #include <libmount.h>
 
@@ -164,8 +166,6 @@ struct lsns_process {
 	uid_t uid;
 
 	ino_t            ns_ids[ARRAY_SIZE(ns_names)];
-	ino_t            ns_pids[ARRAY_SIZE(ns_names)];
-	ino_t            ns_oids[ARRAY_SIZE(ns_names)];
 
 	struct list_head ns_siblings[ARRAY_SIZE(ns_names)];
 
@@ -173,13 +173,12 @@ struct lsns_process {
 
 	struct libscols_line *outline;
 	struct lsns_process *parent;
-
-	int netnsid;
 };
 
 struct lsns {
 	struct list_head processes;
 	struct list_head namespaces;
+	void		*ns_tree;	/* namespaces by inode (tsearch) */
 
 	pid_t	fltr_pid;	/* filter out by PID */
 	ino_t	fltr_ns;	/* filter out by namespace */
@@ -264,7 +263,7 @@ static inline const struct colinfo *get_column_info(unsigned num)
 	return &infos[ get_column_id(num) ];
 }
 
-static int get_ns_ino(int dir, const char *nsname, ino_t *ino, ino_t *pino, ino_t *oino)
+static int get_ns_ino(int dir, const char *nsname, ino_t *ino)
 {
 	struct stat st;
 	char path[16];
@@ -274,13 +273,26 @@ static int get_ns_ino(int dir, const char *nsname, ino_t *ino, ino_t *pino, ino_
 	if (fstatat(dir, path, &st, 0) != 0)
 		return -errno;
 	*ino = st.st_ino;
+	return 0;
+}
 
+/*
+ * The parent and owner are the same for all processes in the namespace, so
+ * the ioctls are called only once for each namespace, and only if necessary.
+ */
+static int get_ns_relatives(pid_t pid, const char *nsname, ino_t *pino, ino_t *oino)
+{
 	*pino = 0;
 	*oino = 0;
 
 #ifdef HAVE_LINUX_NSFS_H
+	struct stat st;
+	char path[PATH_MAX];
 	int fd, pfd, ofd;
-	fd = openat(dir, path, 0);
+
+	snprintf(path, sizeof(path), "/proc/%d/ns/%s", (int) pid, nsname);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
 	if (fd < 0)
 		return -errno;
 	if (strcmp(nsname, "pid") == 0 || strcmp(nsname, "user") == 0) {
@@ -318,31 +330,6 @@ static int get_ns_ino(int dir, const char *nsname, ino_t *ino, ino_t *pino, ino_
 	return 0;
 }
 
-static int parse_proc_stat(FILE *fp, pid_t *pid, char *state, pid_t *ppid)
-{
-	char *line = NULL, *p;
-	size_t len = 0;
-	int rc;
-
-	if (getline(&line, &len, fp) < 0) {
-		rc = -errno;
-		goto error;
-	}
-
-	p = strrchr(line, ')');
-	if (p == NULL ||
-	    sscanf(line, "%d (", pid) != 1 ||
-	    sscanf(p, ") %c %d*[^\n]", state, ppid) != 2) {
-		rc = -EINVAL;
-		goto error;
-	}
-	rc = 0;
-
-error:
-	free(line);
-	return rc;
-}
-
 #ifdef HAVE_LINUX_NET_NAMESPACE_H
 static int netnsid_cache_find(ino_t netino, int *netnsid)
 {
@@ -456,63 +443,45 @@ static int get_netnsid_via_netlink(int dir, const char *path)
 	return netnsid;
 }
 
-static int get_netnsid(int dir, ino_t netino)
+static int get_netnsid(pid_t pid, ino_t netino)
 {
 	int netnsid;
 
 	if (!netnsid_cache_find(netino, &netnsid)) {
-		netnsid = get_netnsid_via_netlink(dir, "ns/net");
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "/proc/%d/ns/net", (int) pid);
+		netnsid = get_netnsid_via_netlink(AT_FDCWD, path);
 		netnsid_cache_add(netino, netnsid);
 	}
 
 	return netnsid;
 }
 #else
-static int get_netnsid(int dir __attribute__((__unused__)),
+static int get_netnsid(pid_t pid __attribute__((__unused__)),
 		       ino_t netino __attribute__((__unused__)))
 {
 	return LSNS_NETNS_UNUSABLE;
 }
 #endif /* HAVE_LINUX_NET_NAMESPACE_H */
 
-static int read_process(struct lsns *ls, pid_t pid)
+/*
+ * Called by the /proc snapshot, maybe from more threads -- it must not touch
+ * anything else than the process.
+ */
+static int read_process(struct proc_snapshot *ps __attribute__((__unused__)),
+			struct proc_entry *ent, int dir, void *data)
 {
-	struct lsns_process *p = NULL;
-	char buf[BUFSIZ];
-	DIR *dir;
-	int rc = 0, fd;
-	FILE *f = NULL;
+	struct lsns *ls = data;
+	struct lsns_process *p;
 	size_t i;
-	struct stat st;
-
-	DBG(PROC, ul_debug("reading %d", (int) pid));
-
-	snprintf(buf, sizeof(buf), "/proc/%d", pid);
-	dir = opendir(buf);
-	if (!dir)
-		return -errno;
+	int rc = 0;
 
 	p = xcalloc(1, sizeof(*p));
-	p->netnsid = LSNS_NETNS_UNUSABLE;
-
-	if (fstat(dirfd(dir), &st) == 0) {
-		p->uid = st.st_uid;
-		add_uid(uid_cache, st.st_uid);
-	}
-
-	fd = openat(dirfd(dir), "stat", O_RDONLY);
-	if (fd < 0) {
-		rc = -errno;
-		goto done;
-	}
-	if (!(f = fdopen(fd, "r"))) {
-		rc = -errno;
-		goto done;
-	}
-	rc = parse_proc_stat(f, &p->pid, &p->state, &p->ppid);
-	if (rc < 0)
-		goto done;
-	rc = 0;
+	p->pid = ent->pid;
+	p->ppid = ent->ppid;
+	p->state = ent->state;
+	p->uid = ent->uid;
 
 	for (i = 0; i < ARRAY_SIZE(p->ns_ids); i++) {
 		INIT_LIST_HEAD(&p->ns_siblings[i]);
@@ -520,64 +489,111 @@ static int read_process(struct lsns *ls, pid_t pid)
 		if (!ls->fltr_types[i])
 			continue;
 
-		rc = get_ns_ino(dirfd(dir), ns_names[i], &p->ns_ids[i],
-				&p->ns_pids[i], &p->ns_oids[i]);
+		rc = get_ns_ino(dir, ns_names[i], &p->ns_ids[i]);
 		if (rc && rc != -EACCES && rc != -ENOENT)
-			goto done;
-		if (i == LSNS_ID_NET)
-			p->netnsid = get_netnsid(dirfd(dir), p->ns_ids[i]);
+			break;
 		rc = 0;
 	}
 
 	INIT_LIST_HEAD(&p->processes);
 
-	DBG(PROC, ul_debugobj(p, "new pid=%d", p->pid));
-	list_add_tail(&p->processes, &ls->processes);
-done:
-	if (f)
-		fclose(f);
-	closedir(dir);
 	if (rc)
 		free(p);
+	else
+		ent->data = p;
 	return rc;
 }
 
+static int cmp_process_pids(const void *a, const void *b)
+{
+	const struct lsns_process *x = *(struct lsns_process * const *) a,
+				  *y = *(struct lsns_process * const *) b;
+
+	return cmp_numbers(x->pid, y->pid);
+}
+
 static int read_processes(struct lsns *ls)
 {
-	struct proc_processes *proc = NULL;
-	pid_t pid;
+	struct proc_snapshot *ps;
+	size_t i, n;
 	int rc = 0;
 
+	struct lsns_process **procs = NULL;
+	size_t nprocs = 0;
+	int fields = 0, need_uid;
+
 	DBG(PROC, ul_debug("opening /proc"));
 
-	if (!(proc = proc_open_processes())) {
-		rc = -errno;
-		goto done;
+	/* read only what is necessary for the output */
+	need_uid = has_column(COL_UID) || has_column(COL_USER);
+	if (need_uid)
+		fields |= PROC_SNAP_UID;
+	if (ls->tree || has_column(COL_PPID))
+		fields |= PROC_SNAP_STAT;
+
+	ps = proc_new_snapshot(fields);
+	if (!ps)
+		return -errno;
+
+	proc_snapshot_set_reader(ps, read_process, ls);
+	proc_snapshot_enable_threads(ps, 1);
+
+	rc = proc_snapshot_read(ps);
+	n = proc_snapshot_get_nentries(ps);
+	if (ls->tree && !rc)
+		procs = xcalloc(n, sizeof(struct lsns_process *));
+
+	/* the caches are not thread-safe, so serialize it here */
+	for (i = 0; i < n; i++) {
+		struct proc_entry *ent = proc_snapshot_get_entry(ps, i);
+		struct lsns_process *p = ent->data;
+
+		if (!p)
+			continue;
+		if (rc) {
+			free(p);
+			continue;
+		}
+
+		if (need_uid)
+			add_uid(uid_cache, p->uid);
+		if (procs)
+			procs[nprocs++] = p;
+
+		DBG(PROC, ul_debugobj(p, "new pid=%d", p->pid));
+		list_add_tail(&p->processes, &ls->processes);
 	}
 
-	while (proc_next_pid(proc, &pid) == 0) {
-		rc = read_process(ls, pid);
-		if (rc && rc != -EACCES && rc != -ENOENT)
-			break;
-		rc = 0;
+	/* parent->child relation for the tree, @procs are sorted by PID */
+	for (i = 0; i < nprocs; i++) {
+		struct lsns_process key = { .pid = procs[i]->ppid }, *k = &key,
+				    **x;
+
+		x = bsearch(&k, procs, nprocs, sizeof(struct lsns_process *),
+			    cmp_process_pids);
+		if (x)
+			procs[i]->parent = *x;
 	}
-done:
+
 	DBG(PROC, ul_debug("closing /proc"));
-	proc_close_processes(proc);
+	free(procs);
+	proc_free_snapshot(ps);
 	return rc;
 }
 
-static struct lsns_namespace *get_namespace(struct lsns *ls, ino_t ino)
+static int cmp_namespace_ids(const void *a, const void *b)
 {
-	struct list_head *p;
+	return cmp_numbers(((const struct lsns_namespace *) a)->id,
+			   ((const struct lsns_namespace *) b)->id);
+}
 
-	list_for_each(p, &ls->namespaces) {
-		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
+static struct lsns_namespace *get_namespace(struct lsns *ls, ino_t ino)
+{
+	struct lsns_namespace key = { .id = ino };
+	void **x;
 
-		if (ns->id == ino)
-			return ns;
-	}
-	return NULL;
+	x = tfind(&key, &ls->ns_tree, cmp_namespace_ids);
+	return x ? *x : NULL;
 }
 
 static int namespace_has_process(struct lsns_namespace *ns, pid_t pid)
@@ -610,27 +626,19 @@ static struct lsns_namespace *add_namespace(struct lsns *ls, int type, ino_t ino
 	ns->id = ino;
 	ns->parentid = parent_ino;
 	ns->ownerid = owner_ino;
+	ns->netnsid = LSNS_NETNS_UNUSABLE;
 
+	if (!tsearch(ns, &ls->ns_tree, cmp_namespace_ids))
+		err(EXIT_FAILURE, _("failed to allocate namespace"));
 	list_add_tail(&ns->namespaces, &ls->namespaces);
 	return ns;
 }
 
-static int add_process_to_namespace(struct lsns *ls, struct lsns_namespace *ns, struct lsns_process *proc)
+static int add_process_to_namespace(struct lsns_namespace *ns, struct lsns_process *proc)
 {
-	struct list_head *p;
-
 	DBG(NS, ul_debugobj(ns, "add process [%p] pid=%d to %s[%ju]",
 		proc, proc->pid, ns_names[ns->type], (uintmax_t)ns->id));
 
-	list_for_each(p, &ls->processes) {
-		struct lsns_process *xproc = list_entry(p, struct lsns_process, processes);
-
-		if (xproc->pid == proc->ppid)		/* my parent */
-			proc->parent = xproc;
-		else if (xproc->ppid == proc->pid)	/* my child */
-			xproc->parent = proc;
-	}
-
 	list_add_tail(&proc->ns_siblings[ns->type], &ns->processes);
 	ns->nprocs++;
 
@@ -663,6 +671,7 @@ static int netnsid_xasputs(char **str, int netnsid)
 static int read_namespaces(struct lsns *ls)
 {
 	struct list_head *p;
+	int need_relatives = has_column(COL_PNS) || has_column(COL_ONS);
 
 	DBG(NS, ul_debug("reading namespace"));
 
@@ -675,12 +684,19 @@ static int read_namespaces(struct lsns *ls)
 			if (proc->ns_ids[i] == 0)
 				continue;
 			if (!(ns = get_namespace(ls, proc->ns_ids[i]))) {
+				ino_t pino = 0, oino = 0;
+
+				if (need_relatives)
+					get_ns_relatives(proc->pid, ns_names[i],
+							 &pino, &oino);
 				ns = add_namespace(ls, i, proc->ns_ids[i],
-						   proc->ns_pids[i], proc->ns_oids[i]);
+						   pino, oino);
 				if (!ns)
 					return -ENOMEM;
+				if (i == LSNS_ID_NET && has_column(COL_NETNSID))
+					ns->netnsid = get_netnsid(proc->pid, ns->id);
 			}
-			add_process_to_namespace(ls, ns, proc);
+			add_process_to_namespace(ns, proc);
 		}
 	}
 
@@ -815,7 +831,7 @@ static void add_scols_line(struct lsns *ls, struct libscols_table *table,
 			break;
 		case COL_NETNSID:
 			if (ns->type == LSNS_ID_NET)
-				netnsid_xasputs(&str, proc->netnsid);
+				netnsid_xasputs(&str, ns->netnsid);
 			break;
 		case COL_NSFS:
 			nsfs_xasputs(&str, ns, ls->tab, ls->no_wrap ? ',' : '\n');
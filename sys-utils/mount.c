@@ -478,6 +478,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	" -c, --no-canonicalize   don't canonicalize paths\n"
 	" -f, --fake              dry run; skip the mount(2) syscall\n"
 	" -F, --fork              fork off for each device (use with -a)\n"
+	"     --parallel <num>    mount up to <num> devices in parallel (use with -a)\n"
 	" -T, --fstab <path>      alternative file to /etc/fstab\n"));
 	fprintf(out, _(
 	" -i, --internal-only     don't call the mount.<type> helpers\n"));
@@ -627,7 +628,8 @@ int main(int argc, char **argv)
 		MOUNT_OPT_SOURCE,
 		MOUNT_OPT_OPTMODE,
 		MOUNT_OPT_OPTSRC,
-		MOUNT_OPT_OPTSRC_FORCE
+		MOUNT_OPT_OPTSRC_FORCE,
+		MOUNT_OPT_PARALLEL
 	};
 
 	static const struct option longopts[] = {
@@ -668,6 +670,7 @@ int main(int argc, char **argv)
 		{ "options-mode",     required_argument, NULL, MOUNT_OPT_OPTMODE     },
 		{ "options-source",   required_argument, NULL, MOUNT_OPT_OPTSRC      },
 		{ "options-source-force",   no_argument, NULL, MOUNT_OPT_OPTSRC_FORCE},
+		{ "parallel",         required_argument, NULL, MOUNT_OPT_PARALLEL    },
 		{ "namespace",        required_argument, NULL, 'N'                   },
 		{ NULL, 0, NULL, 0 }
 	};
@@ -865,6 +868,11 @@ int main(int argc, char **argv)
 		case MOUNT_OPT_OPTSRC_FORCE:
 			optmode |= MNT_OMODE_FORCE;
 			break;
+		case MOUNT_OPT_PARALLEL:
+			if (mnt_context_set_parallel(cxt,
+				strtos32_or_err(optarg, _("invalid parallel mounts number"))))
+				errx(MNT_EX_USAGE, _("invalid parallel mounts number: '%s'"), optarg);
+			break;
 
 		case 'h':
 			mnt_free_context(cxt);
@@ -41,6 +41,8 @@
 #include "closestream.h"
 #include "namespace.h"
 #include "exec_shell.h"
+#include "optutils.h"
+#include "pidfd-utils.h"
 
 static struct namespace_file {
 	int nstype;
@@ -80,6 +82,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -a, --all              enter all namespaces\n"), out);
 	fputs(_(" -t, --target <pid>     target process to get namespaces from\n"), out);
+	fputs(_("     --pidfd <fd>       target process specified by pidfd file descriptor\n"), out);
 	fputs(_(" -m, --mount[=<file>]   enter mount namespace\n"), out);
 	fputs(_(" -u, --uts[=<file>]     enter UTS namespace (hostname etc)\n"), out);
 	fputs(_(" -i, --ipc[=<file>]     enter System V IPC namespace\n"), out);
@@ -106,6 +109,7 @@ static void __attribute__((__noreturn__)) usage(void)
 }
 
 static pid_t namespace_target_pid = 0;
+static int target_pidfd = -1;
 static int root_fd = -1;
 static int wd_fd = -1;
 
@@ -146,6 +150,76 @@ static void open_namespace_fd(int nstype, const char *path)
 	assert(nsfile->nstype);
 }
 
+#ifdef UL_HAVE_PIDFD
+/* returns PID of the process referred by pidfd @fd */
+static pid_t pidfd_get_pid(int fd)
+{
+	char path[PATH_MAX], *line = NULL;
+	size_t sz = 0;
+	int pid = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+	f = fopen(path, "r" UL_CLOEXECSTR);
+	if (!f)
+		err(EXIT_FAILURE, _("cannot open %s"), path);
+
+	while (getline(&line, &sz, f) > 0) {
+		if (sscanf(line, "Pid: %d", &pid) == 1)
+			break;
+	}
+	free(line);
+	fclose(f);
+
+	if (pid == 0)
+		errx(EXIT_FAILURE, _("%d is not a pidfd"), fd);
+	if (pid < 0)
+		errx(EXIT_FAILURE, _("the pidfd %d process has exited"), fd);
+	return pid;
+}
+
+/*
+ * Open pidfd for --target, failure is not fatal (kernel older than 5.3).
+ */
+static void open_target_pidfd(void)
+{
+	if (target_pidfd < 0 && namespace_target_pid)
+		target_pidfd = pidfd_open(namespace_target_pid, 0);
+}
+
+/*
+ * The /proc/<pid> paths are reused if the target process exits, make sure
+ * they have been opened for the process referred by the pidfd.
+ */
+static void check_target_alive(void)
+{
+	if (target_pidfd >= 0 && pidfd_send_signal(target_pidfd, 0, NULL, 0) != 0)
+		err(EXIT_FAILURE, _("target process %d"), (int) namespace_target_pid);
+}
+
+/*
+ * Enter the @namespaces of the target process by one setns() call on the
+ * process pidfd (since Linux 5.8). It's atomic, the kernel enters the user
+ * namespace in the right order, and it saves open() and setns() for every
+ * namespace. Returns 0 on success, or -errno if the old way has to be used.
+ */
+static int enter_by_pidfd(int namespaces)
+{
+	if (target_pidfd < 0)
+		return -ENOSYS;
+	if (setns(target_pidfd, namespaces) != 0)
+		return -errno;
+	return 0;
+}
+#else
+static inline void open_target_pidfd(void) { }
+static inline void check_target_alive(void) { }
+static inline int enter_by_pidfd(int namespaces __attribute__((__unused__)))
+{
+	return -ENOSYS;
+}
+#endif /* UL_HAVE_PIDFD */
+
 static int get_ns_ino(const char *path, ino_t *ino)
 {
 	struct stat st;
@@ -207,13 +281,15 @@ static void continue_as_child(void)
 int main(int argc, char *argv[])
 {
 	enum {
-		OPT_PRESERVE_CRED = CHAR_MAX + 1
+		OPT_PRESERVE_CRED = CHAR_MAX + 1,
+		OPT_PIDFD
 	};
 	static const struct option longopts[] = {
 		{ "all", no_argument, NULL, 'a' },
 		{ "help", no_argument, NULL, 'h' },
 		{ "version", no_argument, NULL, 'V'},
 		{ "target", required_argument, NULL, 't' },
+		{ "pidfd", required_argument, NULL, OPT_PIDFD },
 		{ "mount", optional_argument, NULL, 'm' },
 		{ "uts", optional_argument, NULL, 'u' },
 		{ "ipc", optional_argument, NULL, 'i' },
@@ -233,9 +309,15 @@ int main(int argc, char *argv[])
 #endif
 		{ NULL, 0, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 't', OPT_PIDFD },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	struct namespace_file *nsfile;
 	int c, pass, namespaces = 0, setgroups_nerrs = 0, preserve_cred = 0;
+	int pidfd_ns = 0;
 	bool do_rd = false, do_wd = false, force_uid = false, force_gid = false;
 	bool do_all = false;
 	int do_fork = -1; /* unknown yet */
@@ -253,6 +335,9 @@ int main(int argc, char *argv[])
 	while ((c =
 		getopt_long(argc, argv, "+ahVt:m::u::i::n::p::C::U::T::S:G:r::w::FZ",
 			    longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			do_all = true;
@@ -261,6 +346,14 @@ int main(int argc, char *argv[])
 			namespace_target_pid =
 			    strtoul_or_err(optarg, _("failed to parse pid"));
 			break;
+		case OPT_PIDFD:
+#ifdef UL_HAVE_PIDFD
+			target_pidfd = strtou32_or_err(optarg, _("failed to parse pidfd"));
+			namespace_target_pid = pidfd_get_pid(target_pidfd);
+#else
+			errx(EXIT_FAILURE, _("--pidfd is not supported"));
+#endif
+			break;
 		case 'm':
 			if (optarg)
 				open_namespace_fd(CLONE_NEWNS, optarg);
@@ -364,6 +457,8 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+	open_target_pidfd();
+
 	if (do_all) {
 		if (!namespace_target_pid)
 			errx(EXIT_FAILURE, _("no target PID specified for --all"));
@@ -382,16 +477,31 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	/*
+	 * The namespaces of the target process are entered by its pidfd if
+	 * no namespace is specified by file (the pidfd setns() call is all or
+	 * nothing, so it cannot be mixed with the two passes below).
+	 */
+	if (namespaces) {
+		for (nsfile = namespace_files; nsfile->nstype; nsfile++) {
+			if (nsfile->fd >= 0)
+				break;
+		}
+		if (!nsfile->nstype)
+			pidfd_ns = namespaces;
+	}
+
 	/*
 	 * Open remaining namespace and directory descriptors.
 	 */
-	for (nsfile = namespace_files; nsfile->nstype; nsfile++)
+	for (nsfile = namespace_files; nsfile->nstype && !pidfd_ns; nsfile++)
 		if (nsfile->nstype & namespaces)
 			open_namespace_fd(nsfile->nstype, NULL);
 	if (do_rd)
 		open_target_fd(&root_fd, "root", NULL);
 	if (do_wd)
 		open_target_fd(&wd_fd, "cwd", NULL);
+	check_target_alive();
 
 	/*
 	 * Update namespaces variable to contain all requested namespaces
@@ -413,6 +523,24 @@ int main(int argc, char *argv[])
 			setgroups_nerrs++;
 	}
 
+	if (pidfd_ns) {
+		if (enter_by_pidfd(pidfd_ns) == 0) {
+			if ((pidfd_ns & CLONE_NEWPID) && do_fork == -1)
+				do_fork = 1;
+		} else {
+			/* old kernel or an error, use the namespace files
+			 * (and report the error for the file) */
+			for (nsfile = namespace_files; nsfile->nstype; nsfile++)
+				if (nsfile->nstype & pidfd_ns)
+					open_namespace_fd(nsfile->nstype, NULL);
+			check_target_alive();
+		}
+	}
+	if (target_pidfd >= 0) {
+		close(target_pidfd);
+		target_pidfd = -1;
+	}
+
 	/*
 	 * Now that we know which namespaces we want to enter, enter
 	 * them.  Do this in two passes, not entering the user
@@ -35,6 +35,8 @@
 #include "strutils.h"
 #include "list.h"
 #include "closestream.h"
+#include "optutils.h"
+#include "procutils.h"
 
 #ifndef RLIMIT_RTTIME
 # define RLIMIT_RTTIME 15
@@ -108,6 +110,8 @@ enum {
 	COL_SOFT,
 	COL_HARD,
 	COL_UNITS,
+	COL_PID,
+	COL_COMMAND,
 };
 
 /* column names */
@@ -125,6 +129,8 @@ static struct colinfo infos[] = {
 	[COL_SOFT]    = { "SOFT",        0.1,  SCOLS_FL_RIGHT, N_("soft limit")},
 	[COL_HARD]    = { "HARD",        1,    SCOLS_FL_RIGHT, N_("hard limit (ceiling)")},
 	[COL_UNITS]   = { "UNITS",       0.1,  SCOLS_FL_TRUNC, N_("units")},
+	[COL_PID]     = { "PID",         5,    SCOLS_FL_RIGHT, N_("process ID")},
+	[COL_COMMAND] = { "COMMAND",     0.2,  SCOLS_FL_TRUNC, N_("command name")},
 };
 
 static int columns[ARRAY_SIZE(infos) * 2];
@@ -141,6 +147,23 @@ static int ncolumns;
 static pid_t pid; /* calling process (default) */
 static int verbose;
 
+/*
+ * --all-pids and --pids: the limits of many processes are read by the /proc
+ * snapshot reader (possibly in more threads); every process gets one array of
+ * the limits in the order of prlimit_bulk->lims.
+ */
+struct prlimit_bulk {
+	struct prlimit	**lims;
+	size_t		nlims;
+};
+
+struct prlimit_proc {
+	struct prlimit	*failed;	/* failed to set this limit */
+	int		failed_errno;
+
+	struct rlimit	rlims[];
+};
+
 #ifndef HAVE_PRLIMIT
 # include <sys/syscall.h>
 static int prlimit(pid_t p, int resource,
@@ -168,6 +191,8 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(_("\nGeneral Options:\n"), out);
 	fputs(_(" -p, --pid <pid>        process id\n"
+		"     --all-pids         operate on all processes\n"
+		"     --pids <file>      operate on processes listed in file (\"-\" for stdin)\n"
 		" -o, --output <list>    define which output columns to use\n"
 		"     --noheadings       don't print headings\n"
 		"     --raw              use the raw output format\n"
@@ -216,13 +241,16 @@ static inline struct colinfo *get_column_info(unsigned num)
 	return &infos[ get_column_id(num) ];
 }
 
-static void add_scols_line(struct libscols_table *table, struct prlimit *l)
+static void add_scols_line(struct libscols_table *table,
+			   struct prlimit_desc *desc, struct rlimit *rlim,
+			   pid_t id, const char *comm)
 {
 	int i;
 	struct libscols_line *line;
 
 	assert(table);
-	assert(l);
+	assert(desc);
+	assert(rlim);
 
 	line = scols_table_new_line(table, NULL);
 	if (!line)
@@ -233,28 +261,35 @@ static void add_scols_line(struct libscols_table *table, struct prlimit *l)
 
 		switch (get_column_id(i)) {
 		case COL_RES:
-			if (l->desc->name)
-				str = xstrdup(l->desc->name);
+			if (desc->name)
+				str = xstrdup(desc->name);
 			break;
 		case COL_HELP:
-			if (l->desc->help)
-				str = xstrdup(_(l->desc->help));
+			if (desc->help)
+				str = xstrdup(_(desc->help));
 			break;
 		case COL_SOFT:
-			if (l->rlim.rlim_cur == RLIM_INFINITY)
+			if (rlim->rlim_cur == RLIM_INFINITY)
 				str = xstrdup(_("unlimited"));
 			else
-				xasprintf(&str, "%llu", (unsigned long long) l->rlim.rlim_cur);
+				xasprintf(&str, "%llu", (unsigned long long) rlim->rlim_cur);
 			break;
 		case COL_HARD:
-			if (l->rlim.rlim_max == RLIM_INFINITY)
+			if (rlim->rlim_max == RLIM_INFINITY)
 				str = xstrdup(_("unlimited"));
 			else
-				xasprintf(&str, "%llu", (unsigned long long) l->rlim.rlim_max);
+				xasprintf(&str, "%llu", (unsigned long long) rlim->rlim_max);
 			break;
 		case COL_UNITS:
-			if (l->desc->unit)
-				str = xstrdup(_(l->desc->unit));
+			if (desc->unit)
+				str = xstrdup(_(desc->unit));
+			break;
+		case COL_PID:
+			xasprintf(&str, "%d", (int) id);
+			break;
+		case COL_COMMAND:
+			if (comm)
+				str = xstrdup(comm);
 			break;
 		default:
 			break;
@@ -289,10 +324,9 @@ static void rem_prlim(struct prlimit *lim)
 	free(lim);
 }
 
-static int show_limits(struct list_head *lims)
+static struct libscols_table *new_table(void)
 {
 	int i;
-	struct list_head *p, *pnext;
 	struct libscols_table *table;
 
 	table = scols_new_table();
@@ -308,13 +342,28 @@ static int show_limits(struct list_head *lims)
 		if (!scols_table_new_column(table, col->name, col->whint, col->flags))
 			err(EXIT_FAILURE, _("failed to allocate output column"));
 	}
+	return table;
+}
+
+static int show_limits(struct list_head *lims)
+{
+	struct list_head *p, *pnext;
+	struct libscols_table *table = new_table();
+	pid_t id = pid ? pid : getpid();
+	char *comm = NULL;
+	int i;
+
+	for (i = 0; i < ncolumns; i++)
+		if (get_column_id(i) == COL_COMMAND)
+			comm = proc_get_command_name(id);
 
 	list_for_each_safe(p, pnext, lims) {
 		struct prlimit *lim = list_entry(p, struct prlimit, lims);
 
-		add_scols_line(table, lim);
+		add_scols_line(table, lim->desc, &lim->rlim, id, comm);
 		rem_prlim(lim);
 	}
+	free(comm);
 
 	scols_print_table(table);
 	scols_unref_table(table);
@@ -340,6 +389,20 @@ static void get_unknown_hardsoft(struct prlimit *lim)
 		lim->rlim.rlim_max = old.rlim_max;
 }
 
+static void print_new_limit(struct prlimit_desc *desc, pid_t id, struct rlimit *new)
+{
+	printf(_("New %s limit for pid %d: "), desc->name, id);
+	if (new->rlim_cur == RLIM_INFINITY)
+		printf("<%s", _("unlimited"));
+	else
+		printf("<%ju", (uintmax_t)new->rlim_cur);
+
+	if (new->rlim_max == RLIM_INFINITY)
+		printf(":%s>\n", _("unlimited"));
+	else
+		printf(":%ju>\n", (uintmax_t)new->rlim_max);
+}
+
 static void do_prlimit(struct list_head *lims)
 {
 	struct list_head *p, *pnext;
@@ -361,19 +424,8 @@ static void do_prlimit(struct list_head *lims)
 		} else
 			old = &lim->rlim;
 
-		if (verbose && new) {
-			printf(_("New %s limit for pid %d: "), lim->desc->name,
-				pid ? pid : getpid());
-			if (new->rlim_cur == RLIM_INFINITY)
-				printf("<%s", _("unlimited"));
-			else
-				printf("<%ju", (uintmax_t)new->rlim_cur);
-
-			if (new->rlim_max == RLIM_INFINITY)
-				printf(":%s>\n", _("unlimited"));
-			else
-				printf(":%ju>\n", (uintmax_t)new->rlim_max);
-		}
+		if (verbose && new)
+			print_new_limit(lim->desc, pid ? pid : getpid(), new);
 
 		if (prlimit(pid, lim->desc->resource, new, old) == -1)
 			err(EXIT_FAILURE, lim->modify ?
@@ -386,6 +438,193 @@ static void do_prlimit(struct list_head *lims)
 	}
 }
 
+/*
+ * The /proc snapshot reader, may be called by more threads. It calls prlimit()
+ * once for every resource (twice if only one of soft and hard limits is
+ * modified). The output is generated later by do_prlimit_bulk().
+ */
+static int read_proc_limits(struct proc_snapshot *ps __attribute__((__unused__)),
+			    struct proc_entry *ent,
+			    int dirfd __attribute__((__unused__)),
+			    void *data)
+{
+	struct prlimit_bulk *blk = data;
+	struct prlimit_proc *pp;
+	size_t i;
+
+	pp = xcalloc(1, sizeof(*pp) + blk->nlims * sizeof(struct rlimit));
+
+	for (i = 0; i < blk->nlims; i++) {
+		struct prlimit *lim = blk->lims[i];
+		struct rlimit *new = NULL, *old = &pp->rlims[i];
+		int rc = 0;
+
+		if (lim->modify) {
+			new = &pp->rlims[i];
+			old = NULL;
+			*new = lim->rlim;
+
+			if (lim->modify != (PRLIMIT_HARD | PRLIMIT_SOFT)) {
+				struct rlimit cur;
+
+				rc = prlimit(ent->pid, lim->desc->resource, NULL, &cur);
+				if (rc == 0 && !(lim->modify & PRLIMIT_SOFT))
+					new->rlim_cur = cur.rlim_cur;
+				else if (rc == 0)
+					new->rlim_max = cur.rlim_max;
+			}
+		}
+		if (rc == 0)
+			rc = prlimit(ent->pid, lim->desc->resource, new, old);
+		if (rc == 0)
+			continue;
+
+		if (errno == ESRCH || !lim->modify) {
+			/* gone or not accessible process is not an error */
+			rc = errno == EPERM ? -EACCES : -errno;
+			free(pp);
+			return rc;
+		}
+		if (!pp->failed) {
+			pp->failed = lim;
+			pp->failed_errno = errno;
+		}
+	}
+
+	ent->data = pp;
+	return 0;
+}
+
+/* whitespace separated PIDs, e.g. cgroup.procs or pgrep(1) output */
+static size_t add_pids_from_file(struct proc_snapshot *ps, const char *filename)
+{
+	FILE *f;
+	size_t n = 0;
+	int num, rc;
+
+	if (strcmp(filename, "-") == 0)
+		f = stdin;
+	else {
+		f = fopen(filename, "r" UL_CLOEXECSTR);
+		if (!f)
+			err(EXIT_FAILURE, _("cannot open %s"), filename);
+	}
+
+	while ((rc = fscanf(f, "%d", &num)) == 1 && num > 0) {
+		if (proc_snapshot_add_pid(ps, (pid_t) num) != 0)
+			err(EXIT_FAILURE, _("failed to allocate memory"));
+		n++;
+	}
+	if (rc != EOF || ferror(f))
+		errx(EXIT_FAILURE, _("%s: invalid PID list"), filename);
+
+	if (f != stdin)
+		fclose(f);
+	return n;
+}
+
+/*
+ * prlimit --all-pids | --pids <file>
+ *
+ * The failures to set a limit do not stop the update of the other processes;
+ * they are reported by one message at the end.
+ */
+static int do_prlimit_bulk(struct list_head *lims, const char *filename)
+{
+	struct prlimit_bulk blk = { .nlims = 0 };
+	struct libscols_table *table = NULL;
+	struct proc_snapshot *ps;
+	struct list_head *p, *pnext;
+	struct prlimit *failed = NULL;
+	size_t i, j, n, nfailed = 0, nskipped = 0;
+	int rc, fields = 0, failed_errno = 0;
+	pid_t failed_pid = 0;
+
+	list_for_each(p, lims)
+		blk.nlims++;
+	blk.lims = xcalloc(blk.nlims, sizeof(struct prlimit *));
+
+	i = 0;
+	list_for_each(p, lims) {
+		struct prlimit *lim = list_entry(p, struct prlimit, lims);
+
+		if (lim->modify == (PRLIMIT_HARD | PRLIMIT_SOFT) &&
+		    lim->rlim.rlim_cur > lim->rlim.rlim_max &&
+		    (lim->rlim.rlim_cur != RLIM_INFINITY ||
+		     lim->rlim.rlim_max != RLIM_INFINITY))
+			errx(EXIT_FAILURE, _("the soft limit %s cannot exceed the hard limit"),
+					lim->desc->name);
+		if (!lim->modify && !table)
+			table = new_table();
+		blk.lims[i++] = lim;
+	}
+
+	for (i = 0; i < (size_t) ncolumns; i++)
+		if (get_column_id(i) == COL_COMMAND)
+			fields |= PROC_SNAP_COMM;
+
+	ps = proc_new_snapshot(fields);
+	if (!ps)
+		err(EXIT_FAILURE, _("cannot open /proc"));
+
+	/* an empty list means no process, not all processes */
+	if (filename && !add_pids_from_file(ps, filename))
+		goto done;
+
+	proc_snapshot_set_reader(ps, read_proc_limits, &blk);
+	proc_snapshot_enable_threads(ps, 1);
+
+	rc = proc_snapshot_read(ps);
+	if (rc) {
+		errno = -rc;
+		err(EXIT_FAILURE, _("failed to read processes"));
+	}
+
+	n = proc_snapshot_get_nentries(ps);
+	for (i = 0; i < n; i++) {
+		struct proc_entry *ent = proc_snapshot_get_entry(ps, i);
+		struct prlimit_proc *pp = ent->data;
+
+		if (!ent->valid || !pp) {
+			nskipped++;
+			continue;
+		}
+		for (j = 0; j < blk.nlims; j++) {
+			struct prlimit *lim = blk.lims[j];
+
+			if (!lim->modify)
+				add_scols_line(table, lim->desc, &pp->rlims[j],
+					       ent->pid, ent->comm);
+			else if (verbose)
+				print_new_limit(lim->desc, ent->pid, &pp->rlims[j]);
+		}
+		if (pp->failed && !nfailed++) {
+			failed = pp->failed;
+			failed_errno = pp->failed_errno;
+			failed_pid = ent->pid;
+		}
+		free(pp);
+	}
+
+	if (table)
+		scols_print_table(table);
+	if (verbose && nskipped)
+		warnx(_("%zu processes skipped (exited or not accessible)"), nskipped);
+	if (nfailed) {
+		errno = failed_errno;
+		warn(_("failed to set the %s resource limit for %zu of %zu processes (first pid %d)"),
+				failed->desc->name, nfailed, n - nskipped, failed_pid);
+	}
+done:
+	scols_unref_table(table);
+	proc_free_snapshot(ps);
+	free(blk.lims);
+	list_for_each_safe(p, pnext, lims)
+		rem_prlim(list_entry(p, struct prlimit, lims));
+
+	return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static int get_range(char *str, rlim_t *soft, rlim_t *hard, int *found)
 {
 	char *end = NULL;
@@ -485,17 +724,22 @@ static int add_prlim(char *ops, struct list_head *lims, size_t id)
 
 int main(int argc, char **argv)
 {
-	int opt;
+	int opt, all_pids = 0;
+	const char *pids_file = NULL;
 	struct list_head lims;
 
 	enum {
 		VERBOSE_OPTION = CHAR_MAX + 1,
 		RAW_OPTION,
-		NOHEADINGS_OPTION
+		NOHEADINGS_OPTION,
+		ALLPIDS_OPTION,
+		PIDS_OPTION
 	};
 
 	static const struct option longopts[] = {
 		{ "pid",	required_argument, NULL, 'p' },
+		{ "all-pids",	no_argument,       NULL, ALLPIDS_OPTION },
+		{ "pids",	required_argument, NULL, PIDS_OPTION },
 		{ "output",     required_argument, NULL, 'o' },
 		{ "as",         optional_argument, NULL, 'v' },
 		{ "core",       optional_argument, NULL, 'c' },
@@ -520,6 +764,11 @@ int main(int argc, char **argv)
 		{ "verbose",    no_argument, NULL, VERBOSE_OPTION },
 		{ NULL, 0, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'p', ALLPIDS_OPTION, PIDS_OPTION },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -537,6 +786,9 @@ int main(int argc, char **argv)
 	while((opt = getopt_long(argc, argv,
 				 "+c::d::e::f::i::l::m::n::q::r::s::t::u::v::x::y::p:o:vVh",
 				 longopts, NULL)) != -1) {
+
+		err_exclusive_options(opt, longopts, excl, excl_st);
+
 		switch(opt) {
 		case 'c':
 			add_prlim(optarg, &lims, CORE);
@@ -599,6 +851,12 @@ int main(int argc, char **argv)
 			if (ncolumns < 0)
 				return EXIT_FAILURE;
 			break;
+		case ALLPIDS_OPTION:
+			all_pids = 1;
+			break;
+		case PIDS_OPTION:
+			pids_file = optarg;
+			break;
 		case NOHEADINGS_OPTION:
 			no_headings = 1;
 			break;
@@ -619,7 +877,16 @@ int main(int argc, char **argv)
 	}
 	if (argc > optind && pid)
 		errx(EXIT_FAILURE, _("options --pid and COMMAND are mutually exclusive"));
-	if (!ncolumns) {
+	if (argc > optind && (all_pids || pids_file))
+		errx(EXIT_FAILURE, _("options --all-pids, --pids and COMMAND are mutually exclusive"));
+
+	if (!ncolumns && (all_pids || pids_file)) {
+		columns[ncolumns++] = COL_PID;
+		columns[ncolumns++] = COL_COMMAND;
+		columns[ncolumns++] = COL_RES;
+		columns[ncolumns++] = COL_SOFT;
+		columns[ncolumns++] = COL_HARD;
+	} else if (!ncolumns) {
 		/* default columns */
 		columns[ncolumns++] = COL_RES;
 		columns[ncolumns++] = COL_HELP;
@@ -638,6 +905,9 @@ int main(int argc, char **argv)
 			add_prlim(NULL, &lims, n);
 	}
 
+	if (all_pids || pids_file)
+		return do_prlimit_bulk(&lims, pids_file);
+
 	do_prlimit(&lims);
 
 	if (!list_empty(&lims))
@@ -44,9 +44,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include "nls.h"
 #include "c.h"
 #include "closestream.h"
+#include "pathnames.h"
+#include "procutils.h"
+#include "strutils.h"
+#include "xalloc.h"
 
 static const char *idtype[] = {
 	[PRIO_PROCESS]	= N_("process ID"),
@@ -54,6 +59,20 @@ static const char *idtype[] = {
 	[PRIO_USER]	= N_("user ID"),
 };
 
+/* the arguments are not IDs, but lists of process IDs */
+enum {
+	RENICE_ARG_ID = 0,
+	RENICE_ARG_CGROUP,	/* cgroup directory */
+	RENICE_ARG_FILE		/* file with PIDs */
+};
+
+struct renice_control {
+	int	prio;
+
+	unsigned int	quiet : 1,	/* don't print old and new priority */
+			threads : 1;	/* all threads of the processes */
+};
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -61,7 +80,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 	      _(" %1$s [-n] <priority> [-p|--pid] <pid>...\n"
 		" %1$s [-n] <priority>  -g|--pgrp <pgid>...\n"
-		" %1$s [-n] <priority>  -u|--user <user>...\n"),
+		" %1$s [-n] <priority>  -u|--user <user>...\n"
+		" %1$s [-n] <priority>  -c|--cgroup <path>...\n"
+		" %1$s [-n] <priority>  -f|--file <file>...\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -72,6 +93,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --pid              interpret arguments as process ID (default)\n"), out);
 	fputs(_(" -g, --pgrp             interpret arguments as process group ID\n"), out);
 	fputs(_(" -u, --user             interpret arguments as username or user ID\n"), out);
+	fputs(_(" -c, --cgroup           interpret arguments as cgroup directories\n"), out);
+	fputs(_(" -f, --file             interpret arguments as files with process IDs\n"), out);
+	fputs(_(" -t, --threads          alter all threads of the processes\n"), out);
+	fputs(_(" -q, --quiet            don't print the old and new priority\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(24));
 	printf(USAGE_MAN_TAIL("renice(1)"));
@@ -89,13 +114,22 @@ static int getprio(const int which, const int who, int *prio)
 	return 0;
 }
 
-static int donice(const int which, const int who, const int prio)
+static int donice(const struct renice_control *ctl, const int which, const int who)
 {
 	int oldprio, newprio;
 
+	/* the bulk mode, only one syscall for every target */
+	if (ctl->quiet) {
+		if (setpriority(which, who, ctl->prio) < 0) {
+			warn(_("failed to set priority for %d (%s)"), who, idtype[which]);
+			return 1;
+		}
+		return 0;
+	}
+
 	if (getprio(which, who, &oldprio) != 0)
 		return 1;
-	if (setpriority(which, who, prio) < 0) {
+	if (setpriority(which, who, ctl->prio) < 0) {
 		warn(_("failed to set priority for %d (%s)"), who, idtype[which]);
 		return 1;
 	}
@@ -106,14 +140,128 @@ static int donice(const int which, const int who, const int prio)
 	return 0;
 }
 
+/* the nice value is per thread on Linux, PRIO_PROCESS alters only @pid thread */
+static int donice_process(const struct renice_control *ctl, pid_t pid)
+{
+	struct proc_tasks *ts;
+	pid_t tid;
+	int errs = 0;
+
+	if (!ctl->threads)
+		return donice(ctl, PRIO_PROCESS, pid);
+
+	ts = proc_open_tasks(pid);
+	if (!ts) {
+		warn(_("cannot read threads of %d"), pid);
+		return 1;
+	}
+	while (proc_next_tid(ts, &tid) == 0)
+		errs |= donice(ctl, PRIO_PROCESS, tid);
+	proc_close_tasks(ts);
+	return errs;
+}
+
+/*
+ * Reads PIDs from @f, one per line; empty lines and lines starting with '#'
+ * are ignored. With @tids the IDs are threads already.
+ */
+static int donice_stream(const struct renice_control *ctl, FILE *f,
+			 const char *name, int tids)
+{
+	char *line = NULL;
+	size_t sz = 0, lineno = 0;
+	int errs = 0;
+
+	while (getline(&line, &sz, f) >= 0) {
+		char *p = (char *) skip_space(line), *end = NULL;
+		long id;
+
+		lineno++;
+		if (!*p || *p == '#')
+			continue;
+		errno = 0;
+		id = strtol(p, &end, 10);
+		if (errno || end == p || id <= 0 || *skip_space(end)) {
+			warnx(_("%s: parse error at line %zu"), name, lineno);
+			errs = 1;
+			continue;
+		}
+		if (tids)
+			errs |= donice(ctl, PRIO_PROCESS, (pid_t) id);
+		else
+			errs |= donice_process(ctl, (pid_t) id);
+	}
+	free(line);
+	return errs;
+}
+
+static int donice_file(const struct renice_control *ctl, const char *filename)
+{
+	FILE *f;
+	int errs;
+
+	if (strcmp(filename, "-") == 0)
+		return donice_stream(ctl, stdin, _("stdin"), 0);
+
+	f = fopen(filename, "r" UL_CLOEXECSTR);
+	if (!f) {
+		warn(_("cannot open %s"), filename);
+		return 1;
+	}
+	errs = donice_stream(ctl, f, filename, 0);
+	fclose(f);
+	return errs;
+}
+
+/*
+ * The cgroup is a directory; relative paths which do not exist are
+ * interpreted relative to the cgroup filesystem mountpoint. The threads are
+ * read from cgroup.threads (not available for cgroups v1, then the threads
+ * of the processes from cgroup.procs are used).
+ */
+static int donice_cgroup(const struct renice_control *ctl, const char *path)
+{
+	char *dir = NULL, *fname = NULL;
+	FILE *f = NULL;
+	int errs = 0, tids = 0;
+
+	if (*path != '/' && access(path, F_OK) != 0)
+		xasprintf(&dir, "%s/%s", _PATH_SYS_CGROUP, path);
+	else
+		dir = xstrdup(path);
+
+	if (ctl->threads) {
+		xasprintf(&fname, "%s/cgroup.threads", dir);
+		f = fopen(fname, "r" UL_CLOEXECSTR);
+		tids = 1;
+	}
+	if (!f) {
+		free(fname);
+		xasprintf(&fname, "%s/cgroup.procs", dir);
+		f = fopen(fname, "r" UL_CLOEXECSTR);
+		tids = 0;
+	}
+	if (!f) {
+		warn(_("cannot open %s"), fname);
+		errs = 1;
+	} else {
+		errs = donice_stream(ctl, f, fname, tids);
+		fclose(f);
+	}
+	free(fname);
+	free(dir);
+	return errs;
+}
+
 /*
  * Change the priority (the nice value) of processes
  * or groups of processes which are already running.
  */
 int main(int argc, char **argv)
 {
-	int which = PRIO_PROCESS;
-	int who = 0, prio, errs = 0;
+	struct renice_control ctl = { .prio = 0 };
+	int which = PRIO_PROCESS, argtype = RENICE_ARG_ID;
+	int who = 0, errs = 0;
 	char *endptr = NULL;
 
 	setlocale(LC_ALL, "");
@@ -145,7 +293,7 @@ int main(int argc, char **argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	prio = strtol(*argv, &endptr, 10);
+	ctl.prio = strtol(*argv, &endptr, 10);
 	if (*endptr) {
 		warnx(_("invalid priority '%s'"), *argv);
 		errtryhelp(EXIT_FAILURE);
@@ -156,14 +304,41 @@ int main(int argc, char **argv)
 	for (; argc > 0; argc--, argv++) {
 		if (strcmp(*argv, "-g") == 0 || strcmp(*argv, "--pgrp") == 0) {
 			which = PRIO_PGRP;
+			argtype = RENICE_ARG_ID;
 			continue;
 		}
 		if (strcmp(*argv, "-u") == 0 || strcmp(*argv, "--user") == 0) {
 			which = PRIO_USER;
+			argtype = RENICE_ARG_ID;
 			continue;
 		}
 		if (strcmp(*argv, "-p") == 0 || strcmp(*argv, "--pid") == 0) {
 			which = PRIO_PROCESS;
+			argtype = RENICE_ARG_ID;
+			continue;
+		}
+		if (strcmp(*argv, "-c") == 0 || strcmp(*argv, "--cgroup") == 0) {
+			argtype = RENICE_ARG_CGROUP;
+			continue;
+		}
+		if (strcmp(*argv, "-f") == 0 || strcmp(*argv, "--file") == 0) {
+			argtype = RENICE_ARG_FILE;
+			continue;
+		}
+		if (strcmp(*argv, "-t") == 0 || strcmp(*argv, "--threads") == 0) {
+			ctl.threads = 1;
+			continue;
+		}
+		if (strcmp(*argv, "-q") == 0 || strcmp(*argv, "--quiet") == 0) {
+			ctl.quiet = 1;
+			continue;
+		}
+		if (argtype == RENICE_ARG_CGROUP) {
+			errs |= donice_cgroup(&ctl, *argv);
+			continue;
+		}
+		if (argtype == RENICE_ARG_FILE) {
+			errs |= donice_file(&ctl, *argv);
 			continue;
 		}
 		if (which == PRIO_USER) {
@@ -188,7 +363,10 @@ int main(int argc, char **argv)
 				continue;
 			}
 		}
-		errs |= donice(which, who, prio);
+		if (which == PRIO_PROCESS)
+			errs |= donice_process(&ctl, who);
+		else
+			errs |= donice(&ctl, which, who);
 	}
 	return errs != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -11,6 +11,7 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <stdbool.h>
 
 #include <libsmartcols.h>
 
@@ -23,6 +24,8 @@
 #include "strutils.h"
 #include "optutils.h"
 #include "closestream.h"
+#include "monotonic.h"
+#include "all-io.h"
 
 #include "swapheader.h"
 #include "swapprober.h"
@@ -621,12 +624,32 @@ err:
 	return -1;
 }
 
-static int do_swapon(const struct swapon_ctl *ctl,
-		     const struct swap_prop *prop,
-		     const char *spec,
-		     int canonic)
+static double timeval_diff_ms(const struct timeval *a, const struct timeval *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000.0 + (b->tv_usec - a->tv_usec) / 1000.0;
+}
+
+/* swapon_checks() with the time report for --all --verbose */
+static int swapon_checks_timed(const struct swapon_ctl *ctl, struct swap_device *dev)
+{
+	struct timeval start, end;
+	int rc;
+
+	gettime_monotonic(&start);
+	rc = swapon_checks(ctl, dev);
+	if (ctl->verbose) {
+		gettime_monotonic(&end);
+		warnx(_("%s: checked in %.3f ms"), dev->path,
+				timeval_diff_ms(&start, &end));
+	}
+	return rc;
+}
+
+/* calls swapon(2) for already checked device */
+static int swapon_device(const struct swapon_ctl *ctl,
+			 const struct swap_prop *prop,
+			 const char *path)
 {
-	struct swap_device dev = { .path = NULL };
 	int status;
 	int flags = 0;
 	int priority;
@@ -634,18 +657,8 @@ static int do_swapon(const struct swapon_ctl *ctl,
 	assert(ctl);
 	assert(prop);
 
-	if (!canonic) {
-		dev.path = mnt_resolve_spec(spec, mntcache);
-		if (!dev.path)
-			return cannot_find(spec);
-	} else
-		dev.path = spec;
-
 	priority = prop->priority;
 
-	if (swapon_checks(ctl, &dev))
-		return -1;
-
 #ifdef SWAP_FLAG_PREFER
 	if (priority >= 0) {
 		if (priority > SWAP_FLAG_PRIO_MASK)
@@ -674,15 +687,38 @@ static int do_swapon(const struct swapon_ctl *ctl,
 	}
 
 	if (ctl->verbose)
-		printf(_("swapon %s\n"), dev.path);
+		printf(_("swapon %s\n"), path);
 
-	status = swapon(dev.path, flags);
+	status = swapon(path, flags);
 	if (status < 0)
-		warn(_("%s: swapon failed"), dev.path);
+		warn(_("%s: swapon failed"), path);
 
 	return status;
 }
 
+static int do_swapon(const struct swapon_ctl *ctl,
+		     const struct swap_prop *prop,
+		     const char *spec,
+		     int canonic)
+{
+	struct swap_device dev = { .path = NULL };
+
+	assert(ctl);
+	assert(prop);
+
+	if (!canonic) {
+		dev.path = mnt_resolve_spec(spec, mntcache);
+		if (!dev.path)
+			return cannot_find(spec);
+	} else
+		dev.path = spec;
+
+	if (swapon_checks(ctl, &dev))
+		return -1;
+
+	return swapon_device(ctl, prop, dev.path);
+}
+
 static int swapon_by_label(struct swapon_ctl *ctl, const char *label)
 {
 	char *device = mnt_resolve_tag("LABEL", label, mntcache);
@@ -735,11 +771,97 @@ static int parse_options(struct swap_prop *props, const char *options)
 }
 
 
+/*
+ * The swapon --all checks (read the header, maybe rewrite the signature or
+ * reinitialize the swap area) are done by child processes for more devices
+ * at the same time. The children's messages are forwarded in the fstab
+ * order, and the devices are activated in the fstab order too, because the
+ * order defines the default priorities.
+ */
+#define SWAPON_MAX_CHECKS	16
+
+struct swapon_entry {
+	const char	*device;	/* canonical path */
+	struct swap_prop prop;		/* per device setting */
+	pid_t		pid;		/* checking process, or 0 */
+	int		fd;		/* stderr of the checking process */
+	bool		started;	/* start_checks() already called */
+};
+
+static void start_checks(const struct swapon_ctl *ctl, struct swapon_entry *ent)
+{
+	int pipefd[2];
+
+	ent->started = true;
+	if (pipe(pipefd) != 0)
+		return;			/* check it in the main process */
+
+	fflush(stdout);
+	fflush(stderr);
+
+	switch ((ent->pid = fork())) {
+	case -1:
+		ent->pid = 0;
+		close(pipefd[0]);
+		close(pipefd[1]);
+		break;
+	case 0: /* child */
+	{
+		struct swap_device dev = { .path = ent->device };
+
+		close(pipefd[0]);
+		if (dup2(pipefd[1], STDERR_FILENO) < 0)
+			_exit(EXIT_FAILURE);
+		close(pipefd[1]);
+		_exit(swapon_checks_timed(ctl, &dev) == 0 ?
+				EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	default: /* parent */
+		close(pipefd[1]);
+		ent->fd = pipefd[0];
+		break;
+	}
+}
+
+/* returns swapon_checks() result */
+static int finish_checks(const struct swapon_ctl *ctl, struct swapon_entry *ent)
+{
+	char buf[BUFSIZ];
+	ssize_t sz;
+	int status = 0;
+
+	if (!ent->pid) {
+		struct swap_device dev = { .path = ent->device };
+
+		return swapon_checks_timed(ctl, &dev);
+	}
+
+	while ((sz = read(ent->fd, buf, sizeof(buf))) != 0) {
+		if (sz < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			break;
+		}
+		write_all(STDERR_FILENO, buf, sz);
+	}
+	close(ent->fd);
+
+	while (waitpid(ent->pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			warn(_("waitpid failed"));
+			return -1;
+		}
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
 static int swapon_all(struct swapon_ctl *ctl)
 {
 	struct libmnt_table *tb = get_fstab();
 	struct libmnt_iter *itr;
 	struct libmnt_fs *fs;
+	struct swapon_entry *ents = NULL;
+	size_t i, j, nents = 0;
 	int status = 0;
 
 	if (!tb)
@@ -789,15 +911,54 @@ static int swapon_all(struct swapon_ctl *ctl)
 			continue;
 		}
 
-		/* swapon */
-		status |= do_swapon(ctl, &prop, device, TRUE);
+		ents = xrealloc(ents, (nents + 1) * sizeof(*ents));
+		ents[nents].device = device;
+		ents[nents].prop = prop;
+		ents[nents].pid = 0;
+		ents[nents].fd = -1;
+		ents[nents].started = false;
+		nents++;
 	}
-
 	mnt_free_iter(itr);
+
+	for (i = 0; i < nents; i++) {
+		struct timeval start, end;
+		int rc;
+
+		/* keep SWAPON_MAX_CHECKS checks running; the same device
+		 * more times in fstab is checked in the main process when
+		 * it's its turn */
+		for (j = i; j < nents && j < i + SWAPON_MAX_CHECKS; j++) {
+			size_t k;
+
+			if (ents[j].started)
+				continue;
+			for (k = 0; k < j; k++) {
+				if (strcmp(ents[k].device, ents[j].device) == 0)
+					break;
+			}
+			if (k == j)
+				start_checks(ctl, &ents[j]);
+			ents[j].started = true;
+		}
+
+		rc = finish_checks(ctl, &ents[i]);
+		if (rc == 0) {
+			gettime_monotonic(&start);
+			rc = swapon_device(ctl, &ents[i].prop, ents[i].device);
+			if (ctl->verbose && rc == 0) {
+				gettime_monotonic(&end);
+				warnx(_("%s: activated in %.3f ms"), ents[i].device,
+						timeval_diff_ms(&start, &end));
+			}
+		}
+		status |= rc;
+	}
+
+	free(ents);
 	return status;
 }
 
-
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
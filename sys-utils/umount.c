@@ -333,19 +333,48 @@ done:
 	return rc;
 }
 
+/* called by mnt_context_umount_recursive() after each umount */
+static int umount_batch_cb(struct libmnt_context *cxt,
+			   struct libmnt_fs *fs __attribute__((__unused__)),
+			   int rc)
+{
+	rc = mk_exit_code(cxt, rc);
+
+	if (rc == MNT_EX_SUCCESS && mnt_context_is_verbose(cxt))
+		success_message(cxt);
+	return rc;
+}
+
 static int umount_recursive(struct libmnt_context *cxt, const char *spec)
 {
 	struct libmnt_table *tb;
 	struct libmnt_fs *fs;
 	int rc;
 
+	/* it's always real mountpoint, don't assume that the target maybe a device */
+	mnt_context_disable_swapmatch(cxt, 1);
+
+	/* non-root users may need to drop permissions for each umount, see
+	 * umount_one() */
+	if (!mnt_context_is_restricted(cxt)) {
+		rc = mnt_context_umount_recursive(cxt, spec, umount_batch_cb);
+		if (rc == -ENOENT) {
+			rc = MNT_EX_USAGE;
+			if (!quiet)
+				warnx(access(spec, F_OK) == 0 ?
+					_("%s: not mounted") :
+					_("%s: not found"), spec);
+		} else if (rc < 0) {
+			warnx(_("%s: failed to read mount table"), spec);
+			rc = MNT_EX_SOFTWARE;
+		}
+		return rc;
+	}
+
 	tb = new_mountinfo(cxt);
 	if (!tb)
 		return MNT_EX_SOFTWARE;
 
-	/* it's always real mountpoint, don't assume that the target maybe a device */
-	mnt_context_disable_swapmatch(cxt, 1);
-
 	fs = mnt_table_find_target(tb, spec, MNT_ITER_BACKWARD);
 	if (fs)
 		rc = umount_do_recurse(cxt, tb, fs);
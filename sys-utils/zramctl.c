@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <unistd.h>
 
 #include <libsmartcols.h>
 
@@ -39,6 +40,9 @@
 #include "strv.h"
 #include "path.h"
 #include "pathnames.h"
+#include "cpuset.h"
+
+#define _PATH_SYS_NODE	"/sys/devices/system/node"
 
 /*#define CONFIG_ZRAM_DEBUG*/
 
@@ -68,7 +72,11 @@ enum {
 	COL_MEMLIMIT,
 	COL_MEMUSED,
 	COL_MIGRATED,
-	COL_MOUNTPOINT
+	COL_MOUNTPOINT,
+	COL_FAILED_READS,
+	COL_FAILED_WRITES,
+	COL_INVALID_IO,
+	COL_NOTIFY_FREE
 };
 
 static const struct colinfo infos[] = {
@@ -84,6 +92,10 @@ static const struct colinfo infos[] = {
 	[COL_MEMUSED]   = { "MEM-USED",     5, SCOLS_FL_RIGHT, N_("memory zram have been consumed to store compressed data") },
 	[COL_MIGRATED]  = { "MIGRATED",     5, SCOLS_FL_RIGHT, N_("number of objects migrated by compaction") },
 	[COL_MOUNTPOINT]= { "MOUNTPOINT",0.10, SCOLS_FL_TRUNC, N_("where the device is mounted") },
+	[COL_FAILED_READS] = { "FAILED-READS", 3, SCOLS_FL_RIGHT, N_("number of failed reads") },
+	[COL_FAILED_WRITES]= { "FAILED-WRITES",3, SCOLS_FL_RIGHT, N_("number of failed writes") },
+	[COL_INVALID_IO]   = { "INVALID-IO",   3, SCOLS_FL_RIGHT, N_("number of non-page-size-aligned I/O requests") },
+	[COL_NOTIFY_FREE]  = { "NOTIFY-FREE",  3, SCOLS_FL_RIGHT, N_("number of freed pages notifications") },
 };
 
 static int columns[ARRAY_SIZE(infos) * 2] = {-1};
@@ -96,7 +108,9 @@ enum {
 	MM_MEM_LIMIT,
 	MM_MEM_USED_MAX,
 	MM_ZERO_PAGES,
-	MM_NUM_MIGRATED
+	MM_NUM_MIGRATED,
+
+	MM_NSTATS
 };
 
 static const char *mm_stat_names[] = {
@@ -109,17 +123,43 @@ static const char *mm_stat_names[] = {
 	[MM_NUM_MIGRATED]    = "num_migrated"
 };
 
+enum {
+	IO_FAILED_READS = 0,
+	IO_FAILED_WRITES,
+	IO_INVALID_IO,
+	IO_NOTIFY_FREE,
+
+	IO_NSTATS
+};
+
+/* all mm_stat and io_stat numbers, used for --rate */
+#define ZRAM_NSTATS	(MM_NSTATS + IO_NSTATS)
+
 struct zram {
 	char	devname[32];
 	struct	path_cxt *sysfs;	/* device specific sysfs directory */
 	char	**mm_stat;
+	char	**io_stat;
+
+	uint64_t stats[ZRAM_NSTATS];	/* the first --rate sample */
 
 	unsigned int mm_stat_probed : 1,
+		     io_stat_probed : 1,
 		     control_probed : 1,
 		     has_control : 1;	/* has /sys/class/zram-control/ */
 };
 
+/* device settings for --size */
+struct zram_params {
+	uint64_t	size;
+	uint64_t	nstreams;
+	uint64_t	writeback_limit;
+	const char	*algorithm;
+	const char	*recomp_algorithm;
+};
+
 static unsigned int raw, no_headings, inbytes;
+static unsigned int rate;		/* --rate interval in seconds */
 static struct path_cxt *__control;
 
 static int get_column_id(int num)
@@ -152,8 +192,11 @@ static void zram_reset_stat(struct zram *z)
 {
 	if (z) {
 		strv_free(z->mm_stat);
+		strv_free(z->io_stat);
 		z->mm_stat = NULL;
+		z->io_stat = NULL;
 		z->mm_stat_probed = 0;
+		z->io_stat_probed = 0;
 	}
 }
 
@@ -393,8 +436,109 @@ static char *get_mm_stat(struct zram *z, size_t idx, int bytes)
 	return NULL;
 }
 
+/* Linux >= 4.1 uses /sys/block/zram<id>/io_stat */
+static char *get_io_stat(struct zram *z, size_t idx)
+{
+	struct path_cxt *sysfs;
+	char *str = NULL;
+
+	assert(idx < IO_NSTATS);
+	assert(z);
+
+	sysfs = zram_get_sysfs(z);
+	if (!sysfs)
+		return NULL;
+
+	if (!z->io_stat && !z->io_stat_probed) {
+		if (ul_path_read_string(sysfs, &str, "io_stat") > 0 && str) {
+			z->io_stat = strv_split(str, " ");
+			if (strv_length(z->io_stat) < IO_NSTATS) {
+				strv_free(z->io_stat);
+				z->io_stat = NULL;
+			}
+		}
+		z->io_stat_probed = 1;
+		free(str);
+	}
+
+	return z->io_stat ? xstrdup(z->io_stat[idx]) : NULL;
+}
+
+/*
+ * Reads all mm_stat and io_stat numbers to @stats; unsupported counters
+ * are zero.
+ */
+static void zram_read_stats(struct zram *z, uint64_t *stats)
+{
+	size_t i;
+
+	zram_reset_stat(z);
+	memset(stats, 0, ZRAM_NSTATS * sizeof(uint64_t));
+
+	for (i = 0; i < MM_NSTATS; i++) {
+		char *str = get_mm_stat(z, i, 1);
+
+		if (str)
+			ul_strtou64(str, &stats[i], 10);
+		free(str);
+	}
+	for (i = 0; i < IO_NSTATS; i++) {
+		char *str = get_io_stat(z, i);
+
+		if (str)
+			ul_strtou64(str, &stats[MM_NSTATS + i], 10);
+		free(str);
+	}
+}
+
+/* returns index to the stats[] for columns printed as rate, or -1 */
+static int column_to_stat(int id)
+{
+	switch (id) {
+	case COL_ORIG_SIZE:
+		return MM_ORIG_DATA_SIZE;
+	case COL_COMP_SIZE:
+		return MM_COMPR_DATA_SIZE;
+	case COL_MEMTOTAL:
+		return MM_MEM_USED_TOTAL;
+	case COL_ZEROPAGES:
+		return MM_ZERO_PAGES;
+	case COL_MIGRATED:
+		return MM_NUM_MIGRATED;
+	case COL_FAILED_READS:
+		return MM_NSTATS + IO_FAILED_READS;
+	case COL_FAILED_WRITES:
+		return MM_NSTATS + IO_FAILED_WRITES;
+	case COL_INVALID_IO:
+		return MM_NSTATS + IO_INVALID_IO;
+	case COL_NOTIFY_FREE:
+		return MM_NSTATS + IO_NOTIFY_FREE;
+	}
+	return -1;
+}
+
+/* per-second change of the counter since the first sample */
+static char *get_stat_rate(struct zram *z, const uint64_t *stats, int idx)
+{
+	int64_t delta = (int64_t) (stats[idx] - z->stats[idx]) / (int64_t) rate;
+	char *str, *res = NULL;
+
+	if (inbytes || idx >= MM_NSTATS
+	    || idx == MM_ZERO_PAGES || idx == MM_NUM_MIGRATED) {
+		xasprintf(&res, "%"PRId64, delta);
+		return res;
+	}
+
+	str = size_to_human_string(SIZE_SUFFIX_1LETTER,
+				   delta < 0 ? (uint64_t) -delta : (uint64_t) delta);
+	xasprintf(&res, "%s%s", delta < 0 ? "-" : "", str);
+	free(str);
+	return res;
+}
+
 static void fill_table_row(struct libscols_table *tb, struct zram *z)
 {
+	uint64_t stats[ZRAM_NSTATS];
 	static struct libscols_line *ln;
 	struct path_cxt *sysfs;
 	size_t i;
@@ -413,8 +557,19 @@ static void fill_table_row(struct libscols_table *tb, struct zram *z)
 	if (!ln)
 		err(EXIT_FAILURE, _("failed to allocate output line"));
 
+	if (rate)
+		zram_read_stats(z, stats);
+
 	for (i = 0; i < (size_t) ncolumns; i++) {
 		char *str = NULL;
+		int idx;
+
+		if (rate && (idx = column_to_stat(get_column_id(i))) >= 0) {
+			str = get_stat_rate(z, stats, idx);
+			if (scols_line_refer_data(ln, i, str))
+				err(EXIT_FAILURE, _("failed to add output data"));
+			continue;
+		}
 
 		switch (get_column_id(i)) {
 		case COL_NAME:
@@ -476,6 +631,18 @@ static void fill_table_row(struct libscols_table *tb, struct zram *z)
 		case COL_MIGRATED:
 			str = get_mm_stat(z, MM_NUM_MIGRATED, inbytes);
 			break;
+		case COL_FAILED_READS:
+			str = get_io_stat(z, IO_FAILED_READS);
+			break;
+		case COL_FAILED_WRITES:
+			str = get_io_stat(z, IO_FAILED_WRITES);
+			break;
+		case COL_INVALID_IO:
+			str = get_io_stat(z, IO_INVALID_IO);
+			break;
+		case COL_NOTIFY_FREE:
+			str = get_io_stat(z, IO_NOTIFY_FREE);
+			break;
 		}
 		if (str && scols_line_refer_data(ln, i, str))
 			err(EXIT_FAILURE, _("failed to add output data"));
@@ -485,7 +652,8 @@ static void fill_table_row(struct libscols_table *tb, struct zram *z)
 static void status(struct zram *z)
 {
 	struct libscols_table *tb;
-	size_t i;
+	struct zram **zrams = NULL;
+	size_t i, nzrams = 0;
 	DIR *dir;
 	struct dirent *d;
 
@@ -507,12 +675,15 @@ static void status(struct zram *z)
 
 	if (z) {
 		/* just one device specified */
+		if (rate) {
+			zram_read_stats(z, z->stats);
+			sleep(rate);
+		}
 		fill_table_row(tb, z);
 		goto print_table;
 	}
 
 	/* list all used devices */
-	z = new_zram(NULL);
 	if (!(dir = opendir(_PATH_DEV)))
 		err(EXIT_FAILURE, _("cannot open %s"), _PATH_DEV);
 
@@ -520,18 +691,140 @@ static void status(struct zram *z)
 		int n;
 		if (sscanf(d->d_name, "zram%d", &n) != 1)
 			continue;
+		if (!z)
+			z = new_zram(NULL);
 		zram_set_devname(z, NULL, n);
-		if (zram_exist(z) && zram_used(z))
+		if (!zram_exist(z) || !zram_used(z))
+			continue;
+		if (!rate) {
 			fill_table_row(tb, z);
+			continue;
+		}
+		/* keep the devices to print the differences later */
+		zram_read_stats(z, z->stats);
+		zrams = xrealloc(zrams, (nzrams + 1) * sizeof(struct zram *));
+		zrams[nzrams++] = z;
+		z = NULL;
 	}
 	closedir(dir);
 	free_zram(z);
 
+	if (nzrams) {
+		sleep(rate);
+		for (i = 0; i < nzrams; i++) {
+			fill_table_row(tb, zrams[i]);
+			free_zram(zrams[i]);
+		}
+		free(zrams);
+	}
+
 print_table:
 	scols_print_table(tb);
 	scols_unref_table(tb);
 }
 
+static void zram_setup(struct zram *z, const struct zram_params *p, uint64_t nstreams)
+{
+	if (zram_set_u64parm(z, "reset", 1))
+		err(EXIT_FAILURE, _("%s: failed to reset"), z->devname);
+
+	if (nstreams &&
+	    zram_set_u64parm(z, "max_comp_streams", nstreams))
+		err(EXIT_FAILURE, _("%s: failed to set number of streams"), z->devname);
+
+	if (p->algorithm &&
+	    zram_set_strparm(z, "comp_algorithm", p->algorithm))
+		err(EXIT_FAILURE, _("%s: failed to set algorithm"), z->devname);
+
+	/* the secondary algorithm has to be set before disksize */
+	if (p->recomp_algorithm) {
+		char *str;
+
+		xasprintf(&str, "algo=%s", p->recomp_algorithm);
+		if (zram_set_strparm(z, "recomp_algorithm", str))
+			err(EXIT_FAILURE, _("%s: failed to set recompression algorithm"),
+				z->devname);
+		free(str);
+	}
+
+	if (zram_set_u64parm(z, "disksize", p->size))
+		err(EXIT_FAILURE, _("%s: failed to set disksize (%ju bytes)"),
+			z->devname, (uintmax_t) p->size);
+
+	/* the limit is in 4K units regardless of the page size */
+	if (p->writeback_limit &&
+	    (zram_set_u64parm(z, "writeback_limit_enable", 1) ||
+	     zram_set_u64parm(z, "writeback_limit", p->writeback_limit / 4096)))
+		err(EXIT_FAILURE, _("%s: failed to set writeback limit"), z->devname);
+}
+
+static int node_filter(const struct dirent *d)
+{
+	return strncmp(d->d_name, "node", 4) == 0 && isdigit_string(d->d_name + 4);
+}
+
+/* returns the number of CPUs of the NUMA node, or 0 */
+static uint64_t get_node_ncpus(const char *node)
+{
+	struct path_cxt *pc;
+	cpu_set_t *set;
+	size_t setsize;
+	char *str = NULL;
+	uint64_t n = 0;
+
+	pc = ul_new_path(_PATH_SYS_NODE "/%s", node);
+	if (!pc)
+		return 0;
+	set = cpuset_alloc(get_max_number_of_cpus(), &setsize, NULL);
+	if (set && ul_path_read_string(pc, &str, "cpulist") > 0
+	    && cpulist_parse(str, set, setsize, 0) == 0)
+		n = CPU_COUNT_S(setsize, set);
+
+	free(str);
+	cpuset_free(set);
+	ul_unref_path(pc);
+	return n;
+}
+
+/*
+ * Sets up one device for each NUMA node, the number of streams follows the
+ * number of the node CPUs if not specified by --streams and supported by
+ * kernel. Systems without NUMA get one device.
+ */
+static void create_per_node(const struct zram_params *p)
+{
+	struct dirent **nodes = NULL;
+	int i, nnodes;
+
+	nnodes = scandir(_PATH_SYS_NODE, &nodes, node_filter, versionsort);
+	if (nnodes <= 0)
+		nnodes = 0;
+
+	for (i = 0; i < nnodes || (i == 0 && nnodes == 0); i++) {
+		uint64_t nstreams = p->nstreams;
+		struct zram *z;
+
+		z = find_free_zram();
+		if (!z)
+			errx(EXIT_FAILURE, _("no free zram device found"));
+
+		/* recent kernels use per-CPU streams without max_comp_streams */
+		if (nnodes && !nstreams
+		    && ul_path_access(zram_get_sysfs(z), F_OK, "max_comp_streams") == 0)
+			nstreams = get_node_ncpus(nodes[i]->d_name);
+
+		DBG(fprintf(stderr, "%s: setup for %s (%ju streams)", z->devname,
+				nnodes ? nodes[i]->d_name : "system", (uintmax_t) nstreams));
+		zram_setup(z, p, nstreams);
+		printf("%s\n", z->devname);
+		free_zram(z);
+	}
+
+	for (i = 0; i < nnodes; i++)
+		free(nodes[i]);
+	free(nodes);
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -557,6 +850,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -r, --reset               reset all specified devices\n"), out);
 	fputs(_(" -s, --size <size>         device size\n"), out);
 	fputs(_(" -t, --streams <number>    number of compression streams\n"), out);
+	fputs(_("     --create-per-node     set up a device for each NUMA node\n"), out);
+	fputs(_("     --recompress-algorithm <alg>\n"
+		"                           secondary compression algorithm\n"), out);
+	fputs(_("     --writeback-limit <size>\n"
+		"                           limit on the data written to the backing device\n"), out);
+	fputs(_("     --rate <seconds>      print statistics as per-second rate\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(27));
@@ -582,34 +881,42 @@ enum {
 	A_STATUS,
 	A_CREATE,
 	A_FINDONLY,
-	A_RESET
+	A_RESET,
+	A_CREATE_NODES
 };
 
 int main(int argc, char **argv)
 {
-	uintmax_t size = 0, nstreams = 0;
-	char *algorithm = NULL;
-	int rc = 0, c, find = 0, act = A_NONE;
+	struct zram_params params = { 0 };
+	int rc = 0, c, find = 0, per_node = 0, act = A_NONE;
 	struct zram *zram = NULL;
 
 	enum {
 		OPT_RAW = CHAR_MAX + 1,
-		OPT_LIST_TYPES
+		OPT_LIST_TYPES,
+		OPT_PER_NODE,
+		OPT_RECOMP_ALG,
+		OPT_WB_LIMIT,
+		OPT_RATE
 	};
 
 	static const struct option longopts[] = {
 		{ "algorithm", required_argument, NULL, 'a' },
 		{ "bytes",     no_argument, NULL, 'b' },
+		{ "create-per-node", no_argument, NULL, OPT_PER_NODE },
 		{ "find",      no_argument, NULL, 'f' },
 		{ "help",      no_argument, NULL, 'h' },
 		{ "output",    required_argument, NULL, 'o' },
 		{ "output-all",no_argument, NULL, OPT_LIST_TYPES },
 		{ "noheadings",no_argument, NULL, 'n' },
 		{ "reset",     no_argument, NULL, 'r' },
+		{ "rate",      required_argument, NULL, OPT_RATE },
 		{ "raw",       no_argument, NULL, OPT_RAW },
+		{ "recompress-algorithm", required_argument, NULL, OPT_RECOMP_ALG },
 		{ "size",      required_argument, NULL, 's' },
 		{ "streams",   required_argument, NULL, 't' },
 		{ "version",   no_argument, NULL, 'V' },
+		{ "writeback-limit", required_argument, NULL, OPT_WB_LIMIT },
 		{ NULL, 0, NULL, 0 }
 	};
 
@@ -631,7 +938,7 @@ int main(int argc, char **argv)
 
 		switch (c) {
 		case 'a':
-			algorithm = optarg;
+			params.algorithm = optarg;
 			break;
 		case 'b':
 			inbytes = 1;
@@ -651,11 +958,26 @@ int main(int argc, char **argv)
 				columns[ncolumns] = ncolumns;
 			break;
 		case 's':
-			size = strtosize_or_err(optarg, _("failed to parse size"));
+			params.size = strtosize_or_err(optarg, _("failed to parse size"));
 			act = A_CREATE;
 			break;
 		case 't':
-			nstreams = strtou64_or_err(optarg, _("failed to parse streams"));
+			params.nstreams = strtou64_or_err(optarg, _("failed to parse streams"));
+			break;
+		case OPT_PER_NODE:
+			per_node = 1;
+			break;
+		case OPT_RECOMP_ALG:
+			params.recomp_algorithm = optarg;
+			break;
+		case OPT_WB_LIMIT:
+			params.writeback_limit = strtosize_or_err(optarg,
+						_("failed to parse writeback limit"));
+			break;
+		case OPT_RATE:
+			rate = strtou32_or_err(optarg, _("failed to parse rate interval"));
+			if (!rate)
+				errx(EXIT_FAILURE, _("rate interval must be greater than zero"));
 			break;
 		case 'r':
 			act = A_RESET;
@@ -679,14 +1001,28 @@ int main(int argc, char **argv)
 	if (find && optind < argc)
 		errx(EXIT_FAILURE, _("option --find is mutually exclusive "
 				     "with <device>"));
+	if (per_node) {
+		if (act != A_CREATE)
+			errx(EXIT_FAILURE, _("option --create-per-node must be "
+					     "combined with --size"));
+		if (optind < argc)
+			errx(EXIT_FAILURE, _("option --create-per-node is mutually "
+					     "exclusive with <device>"));
+		act = A_CREATE_NODES;
+	}
 	if (act == A_NONE)
 		act = find ? A_FINDONLY : A_STATUS;
+	if (rate && act != A_STATUS)
+		errx(EXIT_FAILURE, _("option --rate is supported for status output only"));
 
 	if (act != A_RESET && optind + 1 < argc)
 		errx(EXIT_FAILURE, _("only one <device> at a time is allowed"));
 
-	if ((act == A_STATUS || act == A_FINDONLY) && (algorithm || nstreams))
-		errx(EXIT_FAILURE, _("options --algorithm and --streams "
+	if ((act == A_STATUS || act == A_FINDONLY || act == A_RESET)
+	    && (params.algorithm || params.nstreams
+		|| params.recomp_algorithm || params.writeback_limit))
+		errx(EXIT_FAILURE, _("options --algorithm, --streams, "
+				     "--recompress-algorithm and --writeback-limit "
 				     "must be combined with --size"));
 
 	ul_path_init_debug();
@@ -747,24 +1083,14 @@ int main(int argc, char **argv)
 				err(EXIT_FAILURE, "%s", zram->devname);
 		}
 
-		if (zram_set_u64parm(zram, "reset", 1))
-			err(EXIT_FAILURE, _("%s: failed to reset"), zram->devname);
-
-		if (nstreams &&
-		    zram_set_u64parm(zram, "max_comp_streams", nstreams))
-			err(EXIT_FAILURE, _("%s: failed to set number of streams"), zram->devname);
-
-		if (algorithm &&
-		    zram_set_strparm(zram, "comp_algorithm", algorithm))
-			err(EXIT_FAILURE, _("%s: failed to set algorithm"), zram->devname);
-
-		if (zram_set_u64parm(zram, "disksize", size))
-			err(EXIT_FAILURE, _("%s: failed to set disksize (%ju bytes)"),
-				zram->devname, size);
+		zram_setup(zram, &params, params.nstreams);
 		if (find)
 			printf("%s\n", zram->devname);
 		free_zram(zram);
 		break;
+	case A_CREATE_NODES:
+		create_per_node(&params);
+		break;
 	}
 
 	ul_unref_path(__control);
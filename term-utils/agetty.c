@@ -165,8 +165,11 @@ struct issue {
 #ifdef AGETTY_RELOAD
 	char *mem_old;
 #endif
+	struct ifaddrs *addrs;		/* for \4 and \6, one snapshot per issue */
+
 	unsigned int do_tcsetattr : 1,
-		     do_tcrestore : 1;
+		     do_tcrestore : 1,
+		     has_addrs : 1;
 };
 
 /*
@@ -2001,6 +2004,10 @@ static void eval_issue_file(struct issue *ie,
 	issuedir_read(ie, _PATH_SYSCONFSTATICDIR "/" _PATH_ISSUE_DIRNAME, op, tp);
 
 done:
+	if (ie->addrs)
+		freeifaddrs(ie->addrs);
+	ie->addrs = NULL;
+	ie->has_addrs = 0;
 
 #ifdef AGETTY_RELOAD
 	if (netlink_groups != 0)
@@ -2849,18 +2856,24 @@ static void output_special_char(struct issue *ie,
 	case '6':
 	{
 		sa_family_t family = c == '4' ? AF_INET : AF_INET6;
-		struct ifaddrs *addrs = NULL;
 		char iface[128];
 
-		if (getifaddrs(&addrs))
+		/* The addresses are read only once for all the escapes in the
+		 * issue; the next evaluation (e.g. after a netlink event)
+		 * reads a fresh list.
+		 */
+		if (!ie->has_addrs) {
+			ie->has_addrs = 1;
+			if (getifaddrs(&ie->addrs))
+				ie->addrs = NULL;
+		}
+		if (!ie->addrs)
 			break;
 
 		if (get_escape_argument(fp, iface, sizeof(iface)))
-			output_iface_ip(ie, addrs, iface, family);
+			output_iface_ip(ie, ie->addrs, iface, family);
 		else
-			output_iface_ip(ie, addrs, NULL, family);
-
-		freeifaddrs(addrs);
+			output_iface_ip(ie, ie->addrs, NULL, family);
 
 		if (c == '4')
 			netlink_groups |= RTMGRP_IPV4_IFADDR;
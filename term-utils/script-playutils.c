@@ -35,6 +35,9 @@ enum {
 	REPLAY_TIMING_MULTI		/* multiple streams in format "<type> <delta> <offset|etc> */
 };
 
+/* number of timing steps between seek index marks */
+#define REPLAY_MARK_STEPS	1024
+
 struct replay_log {
 	const char	*streams;	/* 'I'nput, 'O'utput or both */
 	const char	*filename;
@@ -54,10 +57,25 @@ struct replay_step {
 	struct replay_log *data;
 };
 
+/*
+ * Seek index, positions in the timing file and in all logs for every
+ * REPLAY_MARK_STEPS-th step. Built on the first seek.
+ */
+struct replay_mark {
+	struct timeval	time;		/* recording time before the step */
+	off_t		timing_offset;
+	int		timing_line;
+	off_t		*log_offsets;	/* per replay_setup.logs */
+};
+
 struct replay_setup {
 	struct replay_log	*logs;
 	size_t			nlogs;
 
+	struct replay_mark	*marks;	/* seek index */
+	size_t			nmarks;
+	struct timeval		seek_rest;	/* already skipped part of the next delay */
+
 	struct replay_step	step;	/* current step */
 
 	FILE			*timing_fp;
@@ -110,6 +128,13 @@ void replay_free_setup(struct replay_setup *stp)
 	if (!stp)
 		return;
 
+	if (stp->marks) {
+		size_t i;
+
+		for (i = 0; i < stp->nmarks; i++)
+			free(stp->marks[i].log_offsets);
+		free(stp->marks);
+	}
 	free(stp->logs);
 	free(stp->step.name);
 	free(stp->step.value);
@@ -378,6 +403,211 @@ static int replay_seek_log(struct replay_log *log, size_t move)
 	return fseek(log->fp, move, SEEK_CUR) == (off_t) -1 ? -errno : 0;
 }
 
+/* reads the next entry from timing file; returns: 0 = success, <0 = error, 1 = EOF */
+static int read_timing_step(struct replay_setup *stp, struct replay_step *step)
+{
+	int rc = 1;
+
+	if (feof(stp->timing_fp))
+		return 1;
+
+	DBG(TIMING, ul_debug("reading next step"));
+
+	replay_reset_step(step);
+	stp->timing_line++;
+
+	switch (stp->timing_format) {
+	case REPLAY_TIMING_SIMPLE:
+		/* old format is the same as new format, but without <type> prefix */
+		rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
+		if (rc == 0)
+			step->type = stp->default_type;
+		break;
+	case REPLAY_TIMING_MULTI:
+		rc = fscanf(stp->timing_fp, "%c ", &step->type);
+		if (rc != 1)
+			rc = -EINVAL;
+		else
+			rc = read_multistream_step(step,
+					stp->timing_fp,
+					step->type);
+		break;
+	}
+
+	if (rc < 0 && feof(stp->timing_fp))
+		rc = 1;
+	return rc;
+}
+
+static void replay_add_mark(struct replay_setup *stp, const struct timeval *tm,
+			    off_t timing_offset, int timing_line,
+			    const off_t *log_offsets)
+{
+	struct replay_mark *mark;
+
+	if (stp->nmarks % 64 == 0)
+		stp->marks = xrealloc(stp->marks, (stp->nmarks + 64) * sizeof(*mark));
+	mark = &stp->marks[stp->nmarks++];
+
+	mark->time = *tm;
+	mark->timing_offset = timing_offset;
+	mark->timing_line = timing_line;
+	mark->log_offsets = xmalloc(stp->nlogs * sizeof(off_t));
+	memcpy(mark->log_offsets, log_offsets, stp->nlogs * sizeof(off_t));
+}
+
+/* set timing file and all logs to the position described by @mark */
+static int replay_goto_mark(struct replay_setup *stp, struct replay_mark *mark)
+{
+	size_t i;
+
+	clearerr(stp->timing_fp);
+	if (fseeko(stp->timing_fp, mark->timing_offset, SEEK_SET) != 0)
+		return -errno;
+	stp->timing_line = mark->timing_line;
+
+	for (i = 0; i < stp->nlogs; i++) {
+		struct replay_log *log = &stp->logs[i];
+
+		if (log->noseek)
+			continue;
+		clearerr(log->fp);
+		if (fseeko(log->fp, mark->log_offsets[i], SEEK_SET) != 0)
+			return -errno;
+	}
+	return 0;
+}
+
+/*
+ * Reads whole timing file and collects positions of the logs, the data logs
+ * are not read. The original position is restored.
+ */
+static int replay_build_index(struct replay_setup *stp)
+{
+	struct replay_step step = { .type = 0 };
+	struct replay_mark start;
+	struct timeval tm;
+	off_t *offsets;
+	size_t i, nsteps = 0;
+	int rc;
+
+	DBG(TIMING, ul_debug("building seek index"));
+
+	offsets = xcalloc(stp->nlogs, sizeof(off_t));
+	for (i = 0; i < stp->nlogs; i++) {
+		if (!stp->logs[i].noseek)
+			offsets[i] = ftello(stp->logs[i].fp);
+	}
+	timerclear(&start.time);
+	start.timing_offset = ftello(stp->timing_fp);
+	start.timing_line = stp->timing_line;
+	start.log_offsets = xmalloc(stp->nlogs * sizeof(off_t));
+	memcpy(start.log_offsets, offsets, stp->nlogs * sizeof(off_t));
+
+	timerclear(&tm);
+	do {
+		struct replay_log *log;
+
+		if (nsteps++ % REPLAY_MARK_STEPS == 0)
+			replay_add_mark(stp, &tm, ftello(stp->timing_fp),
+					stp->timing_line, offsets);
+
+		rc = read_timing_step(stp, &step);
+		if (rc)
+			break;
+		timerinc(&tm, &step.delay);
+
+		log = replay_get_stream_log(stp, step.type);
+		if (log && !log->noseek)
+			offsets[log - stp->logs] += step.size;
+	} while (rc == 0);
+
+	free(step.name);
+	free(step.value);
+
+	if (rc == 1)
+		rc = replay_goto_mark(stp, &start);
+	free(start.log_offsets);
+	free(offsets);
+
+	DBG(TIMING, ul_debug("seek index: %zu marks [rc=%d]", stp->nmarks, rc));
+	return rc;
+}
+
+/*
+ * Skips the steps before @tm (time since the start of the recording) without
+ * reading the data logs. The next step delay is shortened to the remaining
+ * time. Returns: 0 = success, <0 = error, 1 = @tm is behind the end.
+ */
+int replay_seek_time(struct replay_setup *stp, const struct timeval *tm)
+{
+	struct replay_step *step = &stp->step;
+	struct replay_mark *mark;
+	struct timeval cur;
+	size_t lo, hi;
+	int rc;
+
+	assert(stp);
+	assert(stp->timing_fp);
+	assert(tm);
+
+	if (!stp->marks) {
+		rc = replay_build_index(stp);
+		if (rc)
+			return rc;
+	}
+	if (!stp->nmarks)
+		return 1;
+
+	/* last mark at or before @tm */
+	lo = 0;
+	hi = stp->nmarks;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+
+		if (timercmp(&stp->marks[mid].time, tm, >))
+			hi = mid;
+		else
+			lo = mid;
+	}
+	mark = &stp->marks[lo];
+	rc = replay_goto_mark(stp, mark);
+	if (rc)
+		return rc;
+
+	cur = mark->time;
+	for (;;) {
+		struct replay_log *log;
+		struct timeval next;
+		off_t offset = ftello(stp->timing_fp);
+		int line = stp->timing_line;
+
+		rc = read_timing_step(stp, step);
+		if (rc)
+			break;
+
+		timeradd(&cur, &step->delay, &next);
+		if (timercmp(&next, tm, >)) {
+			/* unread the step, it is the first one to replay */
+			if (fseeko(stp->timing_fp, offset, SEEK_SET) != 0)
+				return -errno;
+			stp->timing_line = line;
+			timersub(tm, &cur, &stp->seek_rest);
+			break;
+		}
+		cur = next;
+
+		log = replay_get_stream_log(stp, step->type);
+		if (log)
+			replay_seek_log(log, step->size);
+	}
+
+	DBG(TIMING, ul_debug("seek to %"PRId64".%06"PRId64" [rc=%d line=%d]",
+			(int64_t) tm->tv_sec, (int64_t) tm->tv_usec,
+			rc, stp->timing_line));
+	return rc;
+}
+
 /* returns next step with pointer to the right log file for specified streams (e.g.
  * "IOS" for in/out/signals) or all streams if stream is NULL.
  *
@@ -401,38 +631,9 @@ int replay_get_next_step(struct replay_setup *stp, char *streams, struct replay_
 	do {
 		struct replay_log *log = NULL;
 
-		rc = 1;	/* done */
-		if (feof(stp->timing_fp))
-			break;
-
-		DBG(TIMING, ul_debug("reading next step"));
-
-		replay_reset_step(step);
-		stp->timing_line++;
-
-		switch (stp->timing_format) {
-		case REPLAY_TIMING_SIMPLE:
-			/* old format is the same as new format, but without <type> prefix */
-			rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
-			if (rc == 0)
-				step->type = stp->default_type;
-			break;
-		case REPLAY_TIMING_MULTI:
-			rc = fscanf(stp->timing_fp, "%c ", &step->type);
-			if (rc != 1)
-				rc = -EINVAL;
-			else
-				rc = read_multistream_step(step,
-						stp->timing_fp,
-						step->type);
-			break;
-		}
-
-		if (rc) {
-			if (rc < 0 && feof(stp->timing_fp))
-				rc = 1;
+		rc = read_timing_step(stp, step);
+		if (rc)
 			break;		/* error or EOF */
-		}
 
 		DBG(TIMING, ul_debug(" step entry is '%c'", step->type));
 
@@ -463,6 +664,15 @@ done:
 	if (timerisset(&ignored_delay))
 		timerinc(&step->delay, &ignored_delay);
 
+	/* the first step after seek */
+	if (timerisset(&stp->seek_rest)) {
+		if (timercmp(&step->delay, &stp->seek_rest, >))
+			timersub(&step->delay, &stp->seek_rest, &step->delay);
+		else
+			timerclear(&step->delay);
+		timerclear(&stp->seek_rest);
+	}
+
 	DBG(TIMING, ul_debug("reading next step done [rc=%d delay=%"PRId64".%06"PRId64
 			     "(ignored=%"PRId64".%06"PRId64") size=%zu]",
 			rc,
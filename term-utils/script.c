@@ -103,6 +103,12 @@ enum {
 	SCRIPT_FMT_TIMING_MULTI,	/* (advanced) multiple streams in format "<type> <delta> <offset|etc> */
 };
 
+/* buffered mode (--flush-interval) log buffer size */
+#define SCRIPT_LOG_BUFSIZ	(64 * 1024)
+
+/* buffered mode merges chunks of the same stream within this time to one entry */
+#define SCRIPT_COALESCE_USEC	10000
+
 struct script_log {
 	FILE	*fp;			/* file pointer (handler) */
 	int	format;			/* SCRIPT_FMT_* */
@@ -110,6 +116,11 @@ struct script_log {
 	struct timeval oldtime;		/* previous entry log time (SCRIPT_FMT_TIMING_* only) */
 	struct timeval starttime;
 
+	/* not yet written timing entry (buffered mode only) */
+	struct timeval pendtime;	/* time of the first chunk */
+	size_t	pendsz;			/* size of all chunks */
+	char	pendident;		/* stream identifier */
+
 	unsigned int	initialized : 1;
 };
 
@@ -134,6 +145,8 @@ struct script_control {
 	int ttycols;
 	int ttylines;
 
+	struct timeval flush_interval;	/* buffered mode if set */
+
 	struct ul_pty *pty;	/* pseudo-terminal */
 	pid_t child;		/* child pid */
 	int childstatus;	/* child process exit value */
@@ -142,6 +155,7 @@ struct script_control {
 	 append:1,		/* append output */
 	 rc_wanted:1,		/* return child exit value */
 	 flush:1,		/* flush after each write */
+	 flush_armed:1,		/* flush requested by mainloop callback */
 	 quiet:1,		/* suppress most output */
 	 force:1,		/* write output to links */
 	 isterm:1;		/* is child process running as terminal */
@@ -208,6 +222,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --command <command>       run command rather than interactive shell\n"), out);
 	fputs(_(" -e, --return                  return exit code of the child process\n"), out);
 	fputs(_(" -f, --flush                   run flush after each write\n"), out);
+	fputs(_("     --flush-interval <time>   buffer logs and flush them at most every <time>\n"), out);
 	fputs(_("     --force                   use output file even when it is a link\n"), out);
 	fputs(_(" -E, --echo <when>             echo input in session (auto, always or never)\n"), out);
 	fputs(_(" -o, --output-limit <size>     terminate if output files exceed size\n"), out);
@@ -274,6 +289,45 @@ static struct script_log *log_associate(struct script_control *ctl,
 	return log;
 }
 
+/* writes timing entry for @bytes of the stream @ident logged at @tm */
+static ssize_t log_write_timing(struct script_log *log, char ident,
+				const struct timeval *tm, size_t bytes)
+{
+	struct timeval delta;
+	ssize_t ssz;
+
+	timersub(tm, &log->oldtime, &delta);
+
+	if (log->format == SCRIPT_FMT_TIMING_MULTI)
+		ssz = fprintf(log->fp, "%c %"PRId64".%06"PRId64" %zd\n",
+			ident,
+			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec, bytes);
+	else
+		ssz = fprintf(log->fp, "%"PRId64".%06"PRId64" %zd\n",
+			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec, bytes);
+	if (ssz < 0)
+		return -errno;
+
+	log->oldtime = *tm;
+	return ssz;
+}
+
+/* writes timing entry merged in buffered mode */
+static ssize_t log_write_pending(struct script_log *log)
+{
+	ssize_t ssz;
+
+	if (!log->pendsz)
+		return 0;
+
+	DBG(IO, ul_debug("  log pending timing info [%c, %zu bytes]",
+				log->pendident, log->pendsz));
+
+	ssz = log_write_timing(log, log->pendident, &log->pendtime, log->pendsz);
+	log->pendsz = 0;
+	return ssz;
+}
+
 static int log_close(struct script_control *ctl,
 		      struct script_log *log,
 		      const char *msg,
@@ -286,6 +340,8 @@ static int log_close(struct script_control *ctl,
 
 	DBG(MISC, ul_debug("closing %s", log->filename));
 
+	log_write_pending(log);
+
 	switch (log->format) {
 	case SCRIPT_FMT_RAW:
 	{
@@ -335,6 +391,7 @@ static int log_flush(struct script_control *ctl __attribute__((__unused__)), str
 
 	DBG(MISC, ul_debug("flushing %s", log->filename));
 
+	log_write_pending(log);
 	fflush(log->fp);
 	return 0;
 }
@@ -384,6 +441,8 @@ static int log_start(struct script_control *ctl,
 		warn(_("cannot open %s"), log->filename);
 		return -errno;
 	}
+	if (timerisset(&ctl->flush_interval))
+		setvbuf(log->fp, NULL, _IOFBF, SCRIPT_LOG_BUFSIZ);
 
 	/* write header, etc. */
 	switch (log->format) {
@@ -467,30 +526,34 @@ static ssize_t log_write(struct script_control *ctl,
 		break;
 
 	case SCRIPT_FMT_TIMING_SIMPLE:
+	case SCRIPT_FMT_TIMING_MULTI:
 		DBG(IO, ul_debug("  log timing info"));
 
 		gettime_monotonic(&now);
-		timersub(&now, &log->oldtime, &delta);
-		ssz = fprintf(log->fp, "%"PRId64".%06"PRId64" %zd\n",
-			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec, bytes);
-		if (ssz < 0)
-			return -errno;
-
-		log->oldtime = now;
-		break;
-
-	case SCRIPT_FMT_TIMING_MULTI:
-		DBG(IO, ul_debug("  log multi-stream timing info"));
 
-		gettime_monotonic(&now);
-		timersub(&now, &log->oldtime, &delta);
-		ssz = fprintf(log->fp, "%c %"PRId64".%06"PRId64" %zd\n",
-			stream->ident,
-			(int64_t)delta.tv_sec, (int64_t)delta.tv_usec, bytes);
-		if (ssz < 0)
-			return -errno;
+		if (!timerisset(&ctl->flush_interval)) {
+			ssz = log_write_timing(log, stream->ident, &now, bytes);
+			if (ssz < 0)
+				return ssz;
+			break;
+		}
 
-		log->oldtime = now;
+		/* buffered mode, merge with the previous chunk if possible */
+		if (log->pendsz) {
+			timersub(&now, &log->pendtime, &delta);
+			if (log->pendident == stream->ident
+			    && delta.tv_sec == 0
+			    && delta.tv_usec < SCRIPT_COALESCE_USEC) {
+				log->pendsz += bytes;
+				break;
+			}
+			ssz = log_write_pending(log);
+			if (ssz < 0)
+				return ssz;
+		}
+		log->pendtime = now;
+		log->pendsz = bytes;
+		log->pendident = stream->ident;
 		break;
 	default:
 		break;
@@ -498,6 +561,15 @@ static ssize_t log_write(struct script_control *ctl,
 
 	if (ctl->flush)
 		fflush(log->fp);
+	else if (timerisset(&ctl->flush_interval) && !ctl->flush_armed) {
+		struct timeval next;
+
+		/* flush later from mainloop callback */
+		gettime_monotonic(&now);
+		timeradd(&now, &ctl->flush_interval, &next);
+		ul_pty_set_mainloop_time(ctl->pty, &next);
+		ctl->flush_armed = 1;
+	}
 	return ssz;
 }
 
@@ -538,6 +610,8 @@ static ssize_t __attribute__ ((__format__ (__printf__, 3, 4)))
 	assert(log->format == SCRIPT_FMT_TIMING_MULTI);
 	DBG(IO, ul_debug("  writing signal to multi-stream timing"));
 
+	log_write_pending(log);
+
 	gettime_monotonic(&now);
 	timersub(&now, &log->oldtime, &delta);
 
@@ -579,6 +653,8 @@ static ssize_t log_info(struct script_control *ctl, const char *name, const char
 	assert(log->format == SCRIPT_FMT_TIMING_MULTI);
 	DBG(IO, ul_debug("  writing info to multi-stream log"));
 
+	log_write_pending(log);
+
 	if (msgfmt) {
 		int rc;
 		va_start(ap, msgfmt);
@@ -734,6 +810,18 @@ static int callback_flush_logs(void *data)
 	return 0;
 }
 
+static int callback_mainloop(void *data)
+{
+	struct script_control *ctl = (struct script_control *) data;
+
+	DBG(IO, ul_debug("flush interval expired"));
+
+	ul_pty_set_mainloop_time(ctl->pty, NULL);
+	ctl->flush_armed = 0;
+
+	return callback_flush_logs(data);
+}
+
 static void die_if_link(struct script_control *ctl, const char *filename)
 {
 	struct stat s;
@@ -758,7 +846,10 @@ int main(int argc, char **argv)
 	const char *outfile = NULL, *infile = NULL;
 	const char *timingfile = NULL, *shell = NULL, *command = NULL;
 
-	enum { FORCE_OPTION = CHAR_MAX + 1 };
+	enum {
+		FORCE_OPTION = CHAR_MAX + 1,
+		FLUSH_INTERVAL_OPTION
+	};
 
 	static const struct option longopts[] = {
 		{"append", no_argument, NULL, 'a'},
@@ -766,6 +857,7 @@ int main(int argc, char **argv)
 		{"echo", required_argument, NULL, 'E'},
 		{"return", no_argument, NULL, 'e'},
 		{"flush", no_argument, NULL, 'f'},
+		{"flush-interval", required_argument, NULL, FLUSH_INTERVAL_OPTION},
 		{"force", no_argument, NULL, FORCE_OPTION,},
 		{"log-in", required_argument, NULL, 'I'},
 		{"log-out", required_argument, NULL, 'O'},
@@ -781,6 +873,7 @@ int main(int argc, char **argv)
 	};
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'T', 't' },
+		{ 'f', FLUSH_INTERVAL_OPTION },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -829,6 +922,12 @@ int main(int argc, char **argv)
 		case 'f':
 			ctl.flush = 1;
 			break;
+		case FLUSH_INTERVAL_OPTION:
+			strtotimeval_or_err(optarg, &ctl.flush_interval,
+					_("failed to parse flush interval"));
+			if (!timerisset(&ctl.flush_interval))
+				errx(EXIT_FAILURE, _("invalid flush interval: '%s'"), optarg);
+			break;
 		case FORCE_OPTION:
 			ctl.force = 1;
 			break;
@@ -926,6 +1025,8 @@ int main(int argc, char **argv)
 	cb->log_stream_activity = callback_log_stream_activity;
 	cb->log_signal = callback_log_signal;
 	cb->flush_logs = callback_flush_logs;
+	if (timerisset(&ctl.flush_interval))
+		cb->mainloop = callback_mainloop;
 
 	if (!ctl.quiet) {
 		printf(_("Script started"));
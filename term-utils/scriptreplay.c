@@ -66,6 +66,7 @@ usage(void)
 	fputs(_("     --summary           display overview about recorded session and exit\n"), out);
 	fputs(_(" -d, --divisor <num>     speed up or slow down execution with time divisor\n"), out);
 	fputs(_(" -m, --maxdelay <num>    wait at most this many seconds between updates\n"), out);
+	fputs(_("     --seek <time>       start replay at the given time of the session\n"), out);
 	fputs(_(" -x, --stream <name>     stream type (out, in, signal or info)\n"), out);
 	fputs(_(" -c, --cr-mode <type>    CR char mode (auto, never, always)\n"), out);
 	printf(USAGE_HELP_OPTIONS(25));
@@ -142,7 +143,7 @@ int
 main(int argc, char *argv[])
 {
 	static const struct timeval mindelay = { .tv_sec = 0, .tv_usec = 100 };
-	struct timeval maxdelay;
+	struct timeval maxdelay, seek;
 
 	int isterm;
 	struct termios saved;
@@ -158,7 +159,8 @@ main(int argc, char *argv[])
 	int diviopt = FALSE, idx;
 	int ch, rc, crmode = REPLAY_CRMODE_AUTO, summary = 0;
 	enum {
-		OPT_SUMMARY = CHAR_MAX + 1
+		OPT_SUMMARY = CHAR_MAX + 1,
+		OPT_SEEK
 	};
 
 	static const struct option longopts[] = {
@@ -173,6 +175,7 @@ main(int argc, char *argv[])
 		{ "maxdelay",	required_argument,	0, 'm' },
 		{ "stream",     required_argument,	0, 'x' },
 		{ "summary",    no_argument,            0, OPT_SUMMARY },
+		{ "seek",       required_argument,      0, OPT_SEEK },
 		{ "version",	no_argument,		0, 'V' },
 		{ "help",	no_argument,		0, 'h' },
 		{ NULL,		0, 0, 0 }
@@ -195,6 +198,7 @@ main(int argc, char *argv[])
 
 	replay_init_debug();
 	timerclear(&maxdelay);
+	timerclear(&seek);
 
 	while ((ch = getopt_long(argc, argv, "B:c:I:O:T:t:s:d:m:x:Vh", longopts, NULL)) != -1) {
 
@@ -247,6 +251,9 @@ main(int argc, char *argv[])
 		case OPT_SUMMARY:
 			summary = 1;
 			break;
+		case OPT_SEEK:
+			strtotimeval_or_err(optarg, &seek, _("failed to parse seek time argument"));
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -307,6 +314,14 @@ main(int argc, char *argv[])
 		replay_set_delay_max(setup, &maxdelay);
 	replay_set_delay_min(setup, &mindelay);
 
+	if (timerisset(&seek)) {
+		rc = replay_seek_time(setup, &seek);
+		if (rc < 0)
+			err(EXIT_FAILURE, _("%s: line %d: timing file error"),
+					replay_get_timing_file(setup),
+					replay_get_timing_line(setup));
+	}
+
 	isterm = setterm(&saved);
 
 	do {
@@ -43,8 +43,12 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <limits.h>
 #include <dirent.h>
 #include <errno.h>
 #include <paths.h>
@@ -56,6 +60,8 @@
 #include "nls.h"
 #include "closestream.h"
 #include "pathnames.h"
+#include "xalloc.h"
+#include "monotonic.h"
 #include "ttymsg.h"
 
 #define ERR_BUFLEN	(MAXNAMLEN + 1024)
@@ -190,3 +196,212 @@ ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
 		_exit(EXIT_SUCCESS);
 	return NULL;
 }
+
+/* terminal with not yet finished write */
+struct ttymsg_slow {
+	char	*line;
+	size_t	done;		/* already written bytes */
+};
+
+static int broadcast_open(char *line, struct ttymsg_stats *st)
+{
+	char device[MAXNAMLEN];
+	int fd, len;
+
+	len = snprintf(device, sizeof(device), "%s%s", _PATH_DEV, line);
+	if (len < 0 || (size_t) len >= sizeof(device)) {
+		warnx(_("excessively long line arg"));
+		st->nfailed++;
+		return -1;
+	}
+
+	/* see ttymsg() for the ignored errors */
+	fd = open(device, O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno == EBUSY || errno == EACCES)
+			st->nskipped++;
+		else {
+			warn("%s", device);
+			st->nfailed++;
+		}
+	}
+	return fd;
+}
+
+/*
+ * Returns 1 if the message has been written, 0 if the write would block, or
+ * -1 on error.
+ */
+static int broadcast_write(int fd, struct ttymsg_slow *tty,
+			   const char *msg, size_t len,
+			   struct ttymsg_stats *st)
+{
+	while (tty->done < len) {
+		ssize_t ret = write(fd, msg + tty->done, len - tty->done);
+
+		if (ret > 0) {
+			tty->done += ret;
+			continue;
+		}
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret == 0 || errno == EAGAIN)
+			return 0;
+
+		/* slip line or the line just went away */
+		if (errno == ENODEV || errno == EIO)
+			st->nskipped++;
+		else {
+			warn(_("write failed: %s%s"), _PATH_DEV, tty->line);
+			st->nfailed++;
+		}
+		return -1;
+	}
+
+	st->ndelivered++;
+	return 1;
+}
+
+/*
+ * Waits for the slow terminals and writes as much as possible; the finished
+ * terminals are removed from @pfds and @slow.
+ *
+ * Returns -1 if @deadline has been reached, otherwise 0.
+ */
+static int broadcast_poll(struct pollfd *pfds, struct ttymsg_slow *slow,
+			  size_t *nslow, const char *msg, size_t len,
+			  struct timeval *deadline, struct ttymsg_stats *st)
+{
+	struct timeval now, left;
+	long long ms;
+	size_t i, n;
+	int rc;
+
+	gettime_monotonic(&now);
+	if (!timercmp(&now, deadline, <))
+		return -1;
+	timersub(deadline, &now, &left);
+	ms = (long long) left.tv_sec * 1000 + (left.tv_usec + 999) / 1000;
+
+	rc = poll(pfds, *nslow, ms > INT_MAX ? INT_MAX : (int) ms);
+	if (rc < 0)
+		return errno == EINTR ? 0 : -1;
+
+	for (i = 0, n = 0; rc > 0 && i < *nslow; i++) {
+		int done = 0;
+
+		if (pfds[i].revents & POLLOUT)
+			done = broadcast_write(pfds[i].fd, &slow[i], msg, len, st);
+		else if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			st->nskipped++;
+			done = 1;
+		}
+		if (done) {
+			close(pfds[i].fd);
+			continue;
+		}
+		pfds[n] = pfds[i];
+		slow[n] = slow[i];
+		n++;
+	}
+	if (rc > 0)
+		*nslow = n;
+	return 0;
+}
+
+/*
+ * Writes @msg to all terminals in @lines at once. The terminals are opened in
+ * non-blocking mode and the slow ones are multiplexed by poll(2), so one
+ * blocked terminal does not delay the others. All the writes have to be
+ * finished within @tmout seconds in total.
+ *
+ * If @background is true and some terminal is not finished by the first
+ * write, then one child process serves all the slow terminals and the
+ * function returns immediately (the slow terminals are counted in
+ * st->npending). Otherwise it waits and @st is complete.
+ */
+void ttymsg_broadcast(const char *msg, size_t len, char **lines, size_t nlines,
+		      int tmout, int background, struct ttymsg_stats *st)
+{
+	struct pollfd *pfds;
+	struct ttymsg_slow *slow;
+	struct timeval deadline;
+	struct rlimit rl;
+	size_t i, nslow = 0, maxslow = 256;
+	int forked = 0;
+
+	memset(st, 0, sizeof(*st));
+	st->nttys = nlines;
+	if (!nlines)
+		return;
+
+	/* keep some file descriptors for the rest of the process */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur > 64)
+		maxslow = rl.rlim_cur == RLIM_INFINITY ? nlines : rl.rlim_cur - 32;
+	maxslow = min(maxslow, nlines);
+
+	pfds = xcalloc(maxslow, sizeof(struct pollfd));
+	slow = xcalloc(maxslow, sizeof(struct ttymsg_slow));
+
+	gettime_monotonic(&deadline);
+	deadline.tv_sec += tmout;
+
+	for (i = 0; i < nlines; i++) {
+		int fd;
+
+		while (nslow == maxslow &&
+		       broadcast_poll(pfds, slow, &nslow, msg, len, &deadline, st) == 0)
+			;
+		if (nslow == maxslow) {
+			st->ntimedout += nlines - i;
+			break;
+		}
+
+		fd = broadcast_open(lines[i], st);
+		if (fd < 0)
+			continue;
+
+		slow[nslow].line = lines[i];
+		slow[nslow].done = 0;
+		if (broadcast_write(fd, &slow[nslow], msg, len, st) != 0) {
+			close(fd);
+			continue;
+		}
+		pfds[nslow].fd = fd;
+		pfds[nslow].events = POLLOUT;
+		nslow++;
+	}
+
+	if (nslow && background) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			warn(_("fork failed"));
+		else if (pid > 0) {
+			st->npending = nslow;
+			nslow = 0;
+			goto done;
+		} else {
+			sigset_t sigmask;
+
+			forked = 1;
+			signal(SIGALRM, SIG_DFL);
+			signal(SIGTERM, SIG_DFL);
+			sigemptyset(&sigmask);
+			sigprocmask(SIG_SETMASK, &sigmask, NULL);
+		}
+	}
+
+	while (nslow &&
+	       broadcast_poll(pfds, slow, &nslow, msg, len, &deadline, st) == 0)
+		;
+	st->ntimedout += nslow;
+done:
+	for (i = 0; i < nslow + st->npending; i++)
+		close(pfds[i].fd);
+	free(pfds);
+	free(slow);
+
+	if (forked)
+		_exit(EXIT_SUCCESS);
+}
@@ -3,4 +3,16 @@
 
 char *ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout);
 
+struct ttymsg_stats {
+	size_t	nttys;		/* all terminals */
+	size_t	ndelivered;	/* the whole message written */
+	size_t	npending;	/* still written by background process */
+	size_t	nskipped;	/* not accessible, or the line went away */
+	size_t	ntimedout;	/* not finished in time */
+	size_t	nfailed;	/* unexpected errors */
+};
+
+void ttymsg_broadcast(const char *msg, size_t len, char **lines, size_t nlines,
+		      int tmout, int background, struct ttymsg_stats *st);
+
 #endif /* UTIL_LINUX_TERM_TTYMSG_H */
@@ -94,6 +94,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -g, --group <group>     only send message to group\n"), out);
 	fputs(_(" -n, --nobanner          do not print banner, works only for root\n"), out);
+	fputs(_(" -s, --stats             wait for all terminals and print delivery statistics\n"), out);
 	fputs(_(" -t, --timeout <timeout> write timeout in seconds\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(25));
@@ -181,11 +182,11 @@ static int is_gr_member(const char *login, const struct group_workspace *buf)
 int main(int argc, char **argv)
 {
 	int ch;
-	struct iovec iov;
 	struct utmpx *utmpptr;
-	char *p;
-	char line[sizeof(utmpptr->ut_line) + 1];
-	int print_banner = TRUE;
+	struct ttymsg_stats st;
+	char **lines = NULL;
+	size_t i, nlines = 0, linesz = 0;
+	int print_banner = TRUE, stats = 0;
 	struct group_workspace *group_buf = NULL;
 	char *mbuf, *fname = NULL;
 	size_t mbufsize;
@@ -195,6 +196,7 @@ int main(int argc, char **argv)
 
 	static const struct option longopts[] = {
 		{ "nobanner",	no_argument,		NULL, 'n' },
+		{ "stats",	no_argument,		NULL, 's' },
 		{ "timeout",	required_argument,	NULL, 't' },
 		{ "group",	required_argument,	NULL, 'g' },
 		{ "version",	no_argument,		NULL, 'V' },
@@ -207,7 +209,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((ch = getopt_long(argc, argv, "nt:g:Vh", longopts, NULL)) != -1) {
+	while ((ch = getopt_long(argc, argv, "nst:g:Vh", longopts, NULL)) != -1) {
 		switch (ch) {
 		case 'n':
 			if (geteuid() == 0)
@@ -215,6 +217,9 @@ int main(int argc, char **argv)
 			else
 				warnx(_("--nobanner is available only for root"));
 			break;
+		case 's':
+			stats = 1;
+			break;
 		case 't':
 			timeout = strtou32_or_err(optarg, _("invalid timeout argument"));
 			if (timeout < 1)
@@ -244,8 +249,6 @@ int main(int argc, char **argv)
 
 	mbuf = makemsg(fname, mvec, mvecsz, &mbufsize, print_banner);
 
-	iov.iov_base = mbuf;
-	iov.iov_len = mbufsize;
 	while((utmpptr = getutxent())) {
 		if (!utmpptr->ut_user[0])
 			continue;
@@ -264,11 +267,29 @@ int main(int argc, char **argv)
 		if (group_buf && !is_gr_member(utmpptr->ut_user, group_buf))
 			continue;
 
-		mem2strcpy(line, utmpptr->ut_line, sizeof(utmpptr->ut_line), sizeof(line));
-		if ((p = ttymsg(&iov, 1, line, timeout)) != NULL)
-			warnx("%s", p);
+		if (nlines == linesz) {
+			linesz = linesz ? linesz * 2 : 64;
+			lines = xrealloc(lines, linesz * sizeof(char *));
+		}
+		lines[nlines] = xmalloc(sizeof(utmpptr->ut_line) + 1);
+		mem2strcpy(lines[nlines], utmpptr->ut_line,
+			   sizeof(utmpptr->ut_line), sizeof(utmpptr->ut_line) + 1);
+		nlines++;
 	}
 	endutxent();
+
+	/* all terminals at once, the slow ones do not block the others */
+	ttymsg_broadcast(mbuf, mbufsize, lines, nlines, timeout, !stats, &st);
+
+	if (stats)
+		printf(_("Message delivered to %zu of %zu terminals "
+			 "(%zu skipped, %zu timed out, %zu failed).\n"),
+			st.ndelivered, st.nttys,
+			st.nskipped, st.ntimedout, st.nfailed);
+
+	for (i = 0; i < nlines; i++)
+		free(lines[i]);
+	free(lines);
 	free(mbuf);
 	free_group_workspace(group_buf);
 	exit(EXIT_SUCCESS);
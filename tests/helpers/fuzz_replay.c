@@ -0,0 +1,275 @@
+/*
+ * fuzz_replay.c - replay fuzzers corpus by LLVMFuzzerTestOneInput()
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * The program is linked with the fuzz targets instead of the fuzzing engine.
+ * Every input is processed as is (to catch crashes also without the engine).
+ * With --timing, the input is then repeated to measure how the time grows
+ * with the input size. The parsers are line or record oriented, so the time
+ * should grow linearly; inputs where the time grows more than --limit times
+ * faster are reported as pathological.
+ *
+ * The standard output of the targets is redirected to /dev/null.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "c.h"
+#include "all-io.h"
+#include "nls.h"
+#include "xalloc.h"
+#include "strutils.h"
+#include "fuzz.h"
+
+/* don't replay more than this for one input */
+#define REPLAY_MAX_SIZE		(64 * 1024 * 1024)
+
+/* the smallest replayed input, the time of smaller inputs is noise */
+#define REPLAY_MIN_SIZE		4096
+
+struct replay {
+	size_t	loops;		/* number of runs, the best time is used */
+	size_t	scale;		/* the big input is scale * the small input */
+	double	limit;		/* accepted growth above linear */
+	int	timing;		/* measure the time */
+	int	verbose;
+
+	size_t	ninputs;
+	size_t	nbad;
+	FILE	*out;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the best time of @loops runs */
+static double run(struct replay *rp, const uint8_t *data, size_t size)
+{
+	double best = 0;
+	size_t i;
+
+	for (i = 0; i < rp->loops; i++) {
+		double t = now();
+
+		LLVMFuzzerTestOneInput(data, size);
+		t = now() - t;
+		if (i == 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+/*
+ * Returns @data repeated @n times; text inputs are terminated by a newline
+ * to keep the repeated lines separated.
+ */
+static uint8_t *repeat(const uint8_t *data, size_t size, size_t n, size_t *res)
+{
+	int text = size && !memchr(data, '\0', size) && data[size - 1] != '\n';
+	size_t unit = size + (text ? 1 : 0), i;
+	uint8_t *buf = xmalloc(unit * n);
+
+	for (i = 0; i < n; i++) {
+		memcpy(buf + i * unit, data, size);
+		if (text)
+			buf[i * unit + size] = '\n';
+	}
+	*res = unit * n;
+	return buf;
+}
+
+static void replay_input(struct replay *rp, const char *name,
+			 const uint8_t *data, size_t size)
+{
+	size_t base = 1, smallsz, bigsz;
+	uint8_t *small, *big;
+	double t1, t2, ratio;
+
+	rp->ninputs++;
+
+	/* crash test, the same as the fuzzer does */
+	LLVMFuzzerTestOneInput(data, size);
+
+	if (!rp->timing || !size)
+		return;
+	while (base * size < REPLAY_MIN_SIZE)
+		base *= 2;
+	if (base * size * rp->scale > REPLAY_MAX_SIZE) {
+		if (rp->verbose)
+			fprintf(rp->out, "%s: %zu bytes, too large to scale\n",
+					name, size);
+		return;
+	}
+
+	small = repeat(data, size, base, &smallsz);
+	big = repeat(data, size, base * rp->scale, &bigsz);
+
+	t1 = run(rp, small, smallsz);
+	t2 = run(rp, big, bigsz);
+	ratio = t1 > 0 ? t2 / t1 : 0;
+
+	if (rp->verbose)
+		fprintf(rp->out, "%s: %zu bytes, %.1f us, %.1f us for %zux, %.1fx\n",
+				name, size, t1 * 1e6, t2 * 1e6, rp->scale, ratio);
+
+	if (ratio > rp->scale * rp->limit) {
+		fprintf(rp->out, "%s: time grows %.1fx for %zux larger input\n",
+				name, ratio, rp->scale);
+		rp->nbad++;
+	}
+	free(small);
+	free(big);
+}
+
+static void replay_file(struct replay *rp, const char *filename)
+{
+	struct stat st;
+	uint8_t *data;
+	ssize_t sz;
+	int fd;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, "cannot open %s", filename);
+
+	data = xmalloc(st.st_size ? st.st_size : 1);
+	sz = read_all(fd, (char *) data, st.st_size);
+	if (sz < 0)
+		err(EXIT_FAILURE, "cannot read %s", filename);
+	close(fd);
+
+	replay_input(rp, filename, data, sz);
+	free(data);
+}
+
+static int filter_entry(const struct dirent *d)
+{
+	return *d->d_name != '.';
+}
+
+static void replay_path(struct replay *rp, const char *path)
+{
+	struct dirent **ents;
+	struct stat st;
+	int i, n;
+
+	if (stat(path, &st) != 0)
+		err(EXIT_FAILURE, "stat of %s failed", path);
+	if (!S_ISDIR(st.st_mode)) {
+		replay_file(rp, path);
+		return;
+	}
+
+	/* sorted, for reproducible output */
+	n = scandir(path, &ents, filter_entry, alphasort);
+	if (n < 0)
+		err(EXIT_FAILURE, "cannot read directory %s", path);
+	for (i = 0; i < n; i++) {
+		char *name;
+
+		xasprintf(&name, "%s/%s", path, ents[i]->d_name);
+		replay_path(rp, name);
+		free(name);
+		free(ents[i]);
+	}
+	free(ents);
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+
+	fprintf(out, "\n %s [options] <file|directory>...\n",
+			program_invocation_short_name);
+
+	fputs(" -l, --loops <num>      number of runs for every input (default 3)\n", out);
+	fputs(" -s, --scale <num>      size of the large input (default 16)\n", out);
+	fputs(" -L, --limit <num>      accepted growth above linear (default 4)\n", out);
+	fputs(" -t, --timing           measure how the time grows with the input size\n", out);
+	fputs(" -v, --verbose          print time for every input\n", out);
+	fputs(" -h, --help             this help\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct replay rp = {
+		.loops = 3,
+		.scale = 16,
+		.limit = 4
+	};
+	int c, fd;
+
+	static const struct option longopts[] = {
+		{ "loops",   1, NULL, 'l' },
+		{ "scale",   1, NULL, 's' },
+		{ "limit",   1, NULL, 'L' },
+		{ "timing",  0, NULL, 't' },
+		{ "verbose", 0, NULL, 'v' },
+		{ "help",    0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	while ((c = getopt_long(argc, argv, "hL:l:s:tv", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'l':
+			rp.loops = strtou32_or_err(optarg, "failed to parse loops");
+			if (!rp.loops)
+				errx(EXIT_FAILURE, "at least 1 loop required");
+			break;
+		case 's':
+			rp.scale = strtou32_or_err(optarg, "failed to parse scale");
+			if (rp.scale < 2)
+				errx(EXIT_FAILURE, "scale has to be at least 2");
+			break;
+		case 'L':
+			rp.limit = strtod_or_err(optarg, "failed to parse limit");
+			break;
+		case 't':
+			rp.timing = 1;
+			break;
+		case 'v':
+			rp.verbose = 1;
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	if (optind == argc)
+		errx(EXIT_FAILURE, "no input specified");
+
+	fd = dup(STDOUT_FILENO);
+	if (fd < 0 || !(rp.out = fdopen(fd, "w")))
+		err(EXIT_FAILURE, "cannot duplicate stdout");
+	if (!freopen("/dev/null", "w", stdout))
+		err(EXIT_FAILURE, "cannot open /dev/null");
+
+	for (; optind < argc; optind++)
+		replay_path(&rp, argv[optind]);
+
+	fprintf(rp.out, "%zu inputs, %zu pathological\n", rp.ninputs, rp.nbad);
+	fclose(rp.out);
+
+	return rp.nbad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc32.h"
+#include "crc32c.h"
+
+/*
+ * Reads data from stdin and prints crc32 and crc32c checksums. The data are
+ * checksummed by one call and also by chunks of various sizes and alignments;
+ * all results have to be the same.
+ */
+int main(void)
+{
+	unsigned char *buf = NULL;
+	size_t len = 0, sz = 0, chunk;
+	uint32_t crc, crcc;
+
+	while (!feof(stdin) && !ferror(stdin)) {
+		if (len + BUFSIZ > sz) {
+			sz = len + BUFSIZ * 2;
+			buf = realloc(buf, sz + 1);
+			if (!buf)
+				return EXIT_FAILURE;
+		}
+		len += fread(buf + 1 + len, 1, BUFSIZ, stdin);
+	}
+	fclose(stdin);
+
+	if (!buf)
+		buf = calloc(1, 1);
+
+	crc = ul_crc32(~0U, buf + 1, len) ^ ~0U;
+	crcc = crc32c(~0U, buf + 1, len) ^ ~0U;
+
+	for (chunk = 1; chunk <= len + 1; chunk = chunk * 3 + 1) {
+		uint32_t x = ~0U, y = ~0U;
+		size_t off;
+
+		/* unaligned data */
+		memmove(buf, buf + 1, len);
+		for (off = 0; off < len; off += chunk) {
+			size_t n = len - off < chunk ? len - off : chunk;
+
+			x = ul_crc32(x, buf + off, n);
+			y = crc32c(y, buf + off, n);
+		}
+		memmove(buf + 1, buf, len);
+
+		if ((x ^ ~0U) != crc || (y ^ ~0U) != crcc) {
+			fprintf(stderr, "checksum mismatch for %zu-bytes chunks\n", chunk);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("%08x %08x\n", crc, crcc);
+	free(buf);
+	return EXIT_SUCCESS;
+}
@@ -90,6 +90,9 @@
 /* number of lines to allocate */
 #define	NALLOC			64
 
+/* input is read by blocks of this size */
+#define	INPUT_BUFSIZ		(64 * 1024)
+
 #if HAS_FEATURE_ADDRESS_SANITIZER || defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
 # define COL_DEALLOCATE_ON_EXIT
 #endif
@@ -129,7 +132,16 @@ struct col_alloc {
 };
 #endif
 
+/* Block-read input; only non-ASCII bytes are decoded by mbrtowc(). */
+struct col_input {
+	char		*buf;
+	size_t		len;		/* amount of data in buf */
+	size_t		pos;		/* first unread byte */
+	unsigned int	eof:1;		/* no more data to read */
+};
+
 struct col_ctl {
+	struct col_input in;		/* standard input */
 	struct col_line *lines;
 	struct col_line *l;		/* current line */
 	size_t max_bufd_lines;		/* max # lines to keep in memory */
@@ -189,10 +201,95 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
+/* The output is byte-oriented, ASCII is written without conversion. */
 static inline void col_putchar(wchar_t ch)
 {
-	if (putwchar(ch) == WEOF)
-		err(EXIT_FAILURE, _("write failed"));
+	if (0 <= ch && ch < 0x80) {
+		if (putchar(ch) == EOF)
+			err(EXIT_FAILURE, _("write failed"));
+	} else {
+		char buf[MB_LEN_MAX];
+		mbstate_t st;
+		size_t n;
+
+		memset(&st, 0, sizeof(st));
+		n = wcrtomb(buf, ch, &st);
+		if (n == (size_t) -1 || fwrite(buf, 1, n, stdout) != n)
+			err(EXIT_FAILURE, _("write failed"));
+	}
+}
+
+static inline int col_isgraph(wint_t ch)
+{
+	if (ch < 0x80)
+		return 0x20 < ch && ch < 0x7f;
+	return iswgraph(ch);
+}
+
+static inline int col_width(wint_t ch)
+{
+	if (0x20 < ch && ch < 0x7f)
+		return 1;
+	return wcwidth(ch);
+}
+
+static int fill_input(struct col_input *in)
+{
+	size_t rest = in->len - in->pos, sz;
+
+	if (in->eof)
+		return 0;
+	if (rest)
+		memmove(in->buf, in->buf + in->pos, rest);
+	in->pos = 0;
+	in->len = rest;
+
+	sz = fread(in->buf + rest, 1, INPUT_BUFSIZ - rest, stdin);
+	if (sz == 0) {
+		in->eof = 1;
+		return 0;
+	}
+	in->len += sz;
+	return 1;
+}
+
+/*
+ * Returns 1 and the next character, 0 on end of file, or -1 for an illegal
+ * multibyte sequence; the byte is not consumed in this case.
+ */
+static int col_getwc(struct col_input *in, wint_t *wc)
+{
+	for (;;) {
+		if (in->pos < in->len) {
+			unsigned char b = in->buf[in->pos];
+			mbstate_t st;
+			wchar_t w;
+			size_t n;
+
+			if (b < 0x80) {
+				in->pos++;
+				*wc = b;
+				return 1;
+			}
+			memset(&st, 0, sizeof(st));
+			n = mbrtowc(&w, in->buf + in->pos, in->len - in->pos, &st);
+			if (n == (size_t) -1)
+				return -1;
+			if (n != (size_t) -2) {
+				in->pos += n;
+				*wc = w;
+				return 1;
+			}
+			/* incomplete sequence */
+			if (in->eof || (!fill_input(in) && in->pos < in->len)) {
+				in->pos = in->len;
+				return 0;
+			}
+			continue;
+		}
+		if (!fill_input(in))
+			return 0;
+	}
 }
 
 /*
@@ -345,7 +442,7 @@ static struct col_line *alloc_line(struct col_ctl *ctl)
 	size_t i;
 
 	if (!ctl->line_freelist) {
-		l = xmalloc(sizeof(struct col_line) * NALLOC);
+		l = xcalloc(NALLOC, sizeof(struct col_line));
 #ifdef COL_DEALLOCATE_ON_EXIT
 		if (ctl->alloc_root == NULL) {
 			ctl->alloc_root = xcalloc(1, sizeof(struct col_alloc));
@@ -365,7 +462,11 @@ static struct col_line *alloc_line(struct col_ctl *ctl)
 	l = ctl->line_freelist;
 	ctl->line_freelist = l->l_next;
 
-	memset(l, 0, sizeof(struct col_line));
+	/* keep the characters buffer from the previous use */
+	l->l_prev = l->l_next = NULL;
+	l->l_line_len = 0;
+	l->l_max_col = 0;
+	l->l_needs_sort = 0;
 	return l;
 }
 
@@ -382,12 +483,11 @@ static void flush_lines(struct col_ctl *ctl, ssize_t nflush)
 	while (0 <= --nflush) {
 		l = ctl->lines;
 		ctl->lines = l->l_next;
-		if (l->l_line) {
+		if (l->l_line_len) {
 			flush_blanks(ctl);
 			flush_line(ctl, l);
 		}
 		ctl->nblank_lines++;
-		free(l->l_line);
 		free_line(ctl, l);
 	}
 	if (ctl->lines)
@@ -396,6 +496,8 @@ static void flush_lines(struct col_ctl *ctl, ssize_t nflush)
 
 static int handle_not_graphic(struct col_ctl *ctl, struct col_lines *lns)
 {
+	wint_t next;
+
 	switch (lns->ch) {
 	case BS:
 		if (lns->cur_col == 0)
@@ -409,7 +511,9 @@ static int handle_not_graphic(struct col_ctl *ctl, struct col_lines *lns)
 		lns->cur_col = 0;
 		return 1;
 	case ESC:
-		switch (getwchar()) {	/* just ignore EOF */
+		if (col_getwc(&ctl->in, &next) != 1)
+			next = WEOF;
+		switch (next) {		/* just ignore EOF */
 		case RLF:
 			lns->cur_line -= 2;
 			break;
@@ -590,9 +694,12 @@ static void parse_options(struct col_ctl *ctl, int argc, char **argv)
 static void free_line_allocations(struct col_alloc *root)
 {
 	struct col_alloc *next;
+	size_t i;
 
 	while (root) {
 		next = root->next;
+		for (i = 0; i < NALLOC; i++)
+			free(root->l[i].l_line);
 		free(root->l);
 		free(root);
 		root = next;
@@ -603,7 +710,7 @@ static void free_line_allocations(struct col_alloc *root)
 static void process_char(struct col_ctl *ctl, struct col_lines *lns)
 {
                 /* Deal printable characters */
-                if (!iswgraph(lns->ch) && handle_not_graphic(ctl, lns))
+                if (!col_isgraph(lns->ch) && handle_not_graphic(ctl, lns))
                         return;
 
                 /* Must stuff ch in a line - are we at the right one? */
@@ -628,7 +735,7 @@ static void process_char(struct col_ctl *ctl, struct col_lines *lns)
                         lns->c->c_column = lns->cur_col;
                 else
                         lns->c->c_column = 0;
-                lns->c->c_width = wcwidth(lns->ch);
+                lns->c->c_width = col_width(lns->ch);
 
                 /*
                  * If things are put in out of order, they will need sorting
@@ -664,22 +771,21 @@ int main(int argc, char **argv)
 
 	parse_options(&ctl, argc, argv);
 
-	while (feof(stdin) == 0) {
-		errno = 0;
+	ctl.in.buf = xmalloc(INPUT_BUFSIZ);
+
+	for (;;) {
 		/* Get character */
-		lns.ch = getwchar();
+		int rc = col_getwc(&ctl.in, &lns.ch);
 
-		if (lns.ch == WEOF) {
-			if (errno == EILSEQ) {
+		if (rc != 1) {
+			if (rc < 0) {
 				/* Illegal multibyte sequence */
-				int c;
+				unsigned char c;
 				char buf[5];
 				size_t len, i;
 
-				c = getchar();
-				if (c == EOF)
-					break;
-				sprintf(buf, "\\x%02x", (unsigned char) c);
+				c = ctl.in.buf[ctl.in.pos++];
+				sprintf(buf, "\\x%02x", c);
 				len = strlen(buf);
 				for (i = 0; i < len; i++) {
 					lns.ch = buf[i];
@@ -699,6 +805,7 @@ int main(int argc, char **argv)
 	if (lns.max_line == 0 && lns.cur_col == 0) {
 #ifdef COL_DEALLOCATE_ON_EXIT
 		free_line_allocations(ctl.alloc_root);
+		free(ctl.in.buf);
 #endif
 		return EXIT_SUCCESS;	/* no lines, so just exit */
 	}
@@ -718,6 +825,7 @@ int main(int argc, char **argv)
 	flush_blanks(&ctl);
 #ifdef COL_DEALLOCATE_ON_EXIT
 	free_line_allocations(ctl.alloc_root);
+	free(ctl.in.buf);
 #endif
 	return ret;
 }
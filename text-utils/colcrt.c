@@ -43,12 +43,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 
 #include "nls.h"
 #include "c.h"
 #include "widechar.h"
 #include "closestream.h"
+#include "xalloc.h"
 
 /*
  * colcrt - replaces col for crts with new nroff esp. when using tbl.
@@ -65,14 +67,20 @@
 
 enum { OUTPUT_COLS = 132 };
 
+#define INPUT_BUFSIZ	(64 * 1024)
+
 struct colcrt_control {
 	FILE		*f;
+	char		*buf;			/* input buffer */
+	size_t		len;			/* amount of data in buf */
+	size_t		pos;			/* first unread byte */
 	wchar_t		line[OUTPUT_COLS + 1];
 	wchar_t		line_under[OUTPUT_COLS + 1];
 	unsigned int	print_nl:1,
 			need_line_under:1,
 			no_underlining:1,
-			half_lines:1;
+			half_lines:1,
+			eof:1;
 };
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -96,6 +104,83 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
+static int fill_input(struct colcrt_control *ctl)
+{
+	size_t rest = ctl->len - ctl->pos, sz;
+
+	if (ctl->eof)
+		return 0;
+	if (rest)
+		memmove(ctl->buf, ctl->buf + ctl->pos, rest);
+	ctl->pos = 0;
+	ctl->len = rest;
+
+	sz = fread(ctl->buf + rest, 1, INPUT_BUFSIZ - rest, ctl->f);
+	if (sz == 0) {
+		ctl->eof = 1;
+		return 0;
+	}
+	ctl->len += sz;
+	return 1;
+}
+
+/*
+ * The input is read by blocks and only non-ASCII bytes are decoded. Like
+ * getwc(), WEOF is returned for an illegal multibyte sequence too.
+ */
+static wint_t colcrt_getwc(struct colcrt_control *ctl)
+{
+	for (;;) {
+		if (ctl->pos < ctl->len) {
+			unsigned char b = ctl->buf[ctl->pos];
+			mbstate_t st;
+			wchar_t wc;
+			size_t n;
+
+			if (b < 0x80) {
+				ctl->pos++;
+				return b;
+			}
+			memset(&st, 0, sizeof(st));
+			n = mbrtowc(&wc, ctl->buf + ctl->pos, ctl->len - ctl->pos, &st);
+			if (n == (size_t) -1)
+				return WEOF;
+			if (n != (size_t) -2) {
+				ctl->pos += n;
+				return wc;
+			}
+		}
+		if (!fill_input(ctl))
+			return WEOF;
+	}
+}
+
+/* The output is byte-oriented, ASCII is written without conversion. */
+static void colcrt_putws(const wchar_t *s)
+{
+	for (; *s; s++) {
+		char buf[MB_LEN_MAX];
+		mbstate_t st;
+		size_t n;
+
+		if (*s < 0x80) {
+			putchar(*s);
+			continue;
+		}
+		memset(&st, 0, sizeof(st));
+		n = wcrtomb(buf, *s, &st);
+		if (n != (size_t) -1)
+			fwrite(buf, 1, n, stdout);
+	}
+}
+
+static inline int colcrt_isprint(wint_t c)
+{
+	if (c < 0x80)
+		return 0x20 <= c && c < 0x7f;
+	return iswprint(c);
+}
+
 static void trim_trailing_spaces(wchar_t *s)
 {
 	size_t size;
@@ -115,10 +200,10 @@ static void output_lines(struct colcrt_control *ctl, int col)
 {
 	/* first line */
 	trim_trailing_spaces(ctl->line);
-	fputws(ctl->line, stdout);
+	colcrt_putws(ctl->line);
 
 	if (ctl->print_nl)
-		fputwc(L'\n', stdout);
+		putchar('\n');
 	if (!ctl->half_lines && !ctl->no_underlining)
 		ctl->print_nl = 0;
 
@@ -129,12 +214,12 @@ static void output_lines(struct colcrt_control *ctl, int col)
 		ctl->need_line_under = 0;
 		ctl->line_under[col] = L'\0';
 		trim_trailing_spaces(ctl->line_under);
-		fputws(ctl->line_under, stdout);
-		fputwc(L'\n', stdout);
+		colcrt_putws(ctl->line_under);
+		putchar('\n');
 		wmemset(ctl->line_under, L' ', OUTPUT_COLS);
 
 	} else if (ctl->half_lines && 0 < col)
-		fputwc(L'\n', stdout);
+		putchar('\n');
 }
 
 static int rubchars(struct colcrt_control *ctl, int col, int n)
@@ -152,37 +237,27 @@ static void colcrt(struct colcrt_control *ctl)
 {
 	int col;
 	wint_t c = 0;
-	long old_pos;
 
 	ctl->print_nl = 1;
 	if (ctl->half_lines)
-		fputwc(L'\n', stdout);
+		putchar('\n');
 
 	for (col = 0; /* nothing */; col++) {
 		if (OUTPUT_COLS - 1 < col) {
 			output_lines(ctl, col);
-			errno = 0;
-			old_pos = ftell(ctl->f);
-
-			while (getwc(ctl->f) != L'\n') {
-				long new_pos;
 
-				if (ferror(ctl->f) || feof(ctl->f))
+			/* skip the rest of the line, stop on error */
+			while ((c = colcrt_getwc(ctl)) != L'\n') {
+				if (c == WEOF)
 					return;
-				new_pos = ftell(ctl->f);
-				if (old_pos == new_pos) {
-					if (fseek(ctl->f, 1, SEEK_CUR) < 1)
-						return;
-				} else
-					old_pos = new_pos;
 			}
 			col = -1;
 			continue;
 		}
-		c = getwc(ctl->f);
+		c = colcrt_getwc(ctl);
 		switch (c) {
 		case 033:	/* ESC */
-			c = getwc(ctl->f);
+			c = colcrt_getwc(ctl);
 			if (c == L'8') {
 				col = rubchars(ctl, col, 1);
 				continue;
@@ -214,7 +289,7 @@ static void colcrt(struct colcrt_control *ctl)
 			}
 			continue;
 		default:
-			if (!iswprint(c)) {
+			if (!colcrt_isprint(c)) {
 				col--;
 				continue;
 			}
@@ -275,7 +350,11 @@ int main(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
+	ctl.buf = xmalloc(INPUT_BUFSIZ);
+
 	do {
+		ctl.len = ctl.pos = 0;
+		ctl.eof = 0;
 		wmemset(ctl.line, L'\0', OUTPUT_COLS);
 		wmemset(ctl.line_under, L' ', OUTPUT_COLS);
 
@@ -292,5 +371,6 @@ int main(int argc, char **argv)
 			fclose(ctl.f);
 	} while (argc > 0);
 
+	free(ctl.buf);
 	return EXIT_SUCCESS;
 }
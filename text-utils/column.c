@@ -34,6 +34,8 @@
  */
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <ctype.h>
 #include <stdio.h>
@@ -41,7 +43,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "nls.h"
 #include "c.h"
@@ -445,16 +451,19 @@ static void modify_table(struct column_control *ctl)
 static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 {
 	wchar_t *wcdata, *sv = NULL, *wcs = wcs0;
-	size_t n = 0, nchars = 0;
+	size_t n = 0, nchars = 0, len0 = 0;
 	struct libscols_line *ln = NULL;
 
 	if (!ctl->tab)
 		init_table(ctl);
+	if (ctl->maxncols)
+		len0 = wcslen(wcs0);
 	do {
 		char *data;
 
 		if (ctl->maxncols && n + 1 == ctl->maxncols)
-			wcdata = wcs0 + nchars;
+			/* the rest of the line; empty if the line ends with the previous cell */
+			wcdata = wcs0 + min(nchars, len0);
 		else
 			wcdata = local_wcstok(ctl, wcs, &sv);
 
@@ -585,6 +594,685 @@ static int read_input(struct column_control *ctl, FILE *fp)
 	return rc;
 }
 
+/*
+ * Streaming table output
+ *
+ * The table mode stores all the input in a libsmartcols table. It's
+ * unnecessary for simple tables (without JSON, tree, hidden, truncated,
+ * wrapped or reordered columns) where only the width of the columns has to be
+ * known before the first line is printed. The input files are mapped to
+ * memory and read twice; the first pass counts the width of the columns (by
+ * threads for large inputs) and the second pass prints the lines. The output
+ * is the same as from libsmartcols.
+ *
+ * Lines with printable ASCII chars only are split without conversion to wide
+ * chars, and the width of the cells is the number of bytes.
+ */
+#define STREAM_PARALLEL_MINSIZE		(16 * 1024 * 1024)
+#define STREAM_PARALLEL_CHUNKSIZE	(4 * 1024 * 1024)
+#define STREAM_PARALLEL_MAXTHREADS	16
+
+struct stream_map {
+	char	*data;
+	size_t	size;
+};
+
+struct stream_cell {
+	size_t	off;		/* offset in stream_line->buf */
+	size_t	len;		/* number of bytes */
+	size_t	width;		/* number of terminal cells */
+};
+
+struct stream_line {
+	char	*buf;		/* cells data */
+	size_t	bufsz;
+	char	*tmp;		/* the line to convert to wide chars */
+	size_t	tmpsz;
+
+	struct stream_cell *cells;
+	size_t	ncells;
+	size_t	maxcells;
+};
+
+struct stream_scan {
+	size_t	*widths;	/* the widest cell in the columns */
+	size_t	ncols;
+	size_t	nlines;		/* number of table lines */
+
+	struct stream_line ln;
+};
+
+struct column_stream {
+	struct stream_map *maps;
+	size_t	nmaps;
+
+	char	*separator;	/* the input separator if ASCII only */
+	struct stream_scan sc;
+	char	*right;		/* right aligned columns */
+};
+
+static void stream_line_reserve(char **buf, size_t *bufsz, size_t sz)
+{
+	if (*bufsz < sz) {
+		*bufsz = sz;
+		*buf = xrealloc(*buf, *bufsz);
+	}
+}
+
+static void stream_add_cell(struct stream_line *ln, size_t off, size_t len, size_t width)
+{
+	struct stream_cell *ce;
+
+	if (ln->ncells == ln->maxcells) {
+		ln->maxcells += 32;
+		ln->cells = xrealloc(ln->cells, ln->maxcells * sizeof(struct stream_cell));
+	}
+	ce = &ln->cells[ln->ncells++];
+	ce->off = off;
+	ce->len = len;
+	ce->width = width;
+}
+
+static void stream_free_line(struct stream_line *ln)
+{
+	free(ln->buf);
+	free(ln->tmp);
+	free(ln->cells);
+}
+
+/* printable ASCII and tabs; the other chars require conversion */
+static int is_plain_line(const char *p, size_t sz)
+{
+	const unsigned char *s = (const unsigned char *) p;
+	size_t i;
+
+	for (i = 0; i < sz; i++) {
+		if ((s[i] < 0x20 && s[i] != '\t') || s[i] > 0x7e)
+			return 0;
+	}
+	return 1;
+}
+
+/* the same as skip_space() in read_input() */
+static int is_empty_line(const char *p, size_t sz)
+{
+	const char *end = p + sz;
+
+	while (p < end && isspace((unsigned char) *p))
+		p++;
+	return p == end || *p == '\0';
+}
+
+static char *local_strtok(struct column_control const *const ctl,
+			  struct column_stream const *const st,
+			  char *p, char **state)
+{
+	char *result;
+
+	if (ctl->greedy)
+		return strtok_r(p, st->separator, state);
+	if (!p) {
+		if (!*state)
+			return NULL;
+		p = *state;
+	}
+	result = p;
+	p = strpbrk(result, st->separator);
+	if (!p)
+		*state = NULL;
+	else {
+		*p = '\0';
+		*state = p + 1;
+	}
+	return result;
+}
+
+/* see add_line_to_table(), the cells point to the copy of the line */
+static void stream_split_plain(struct column_control *ctl,
+			       struct column_stream *st,
+			       struct stream_line *ln,
+			       const char *data, size_t sz)
+{
+	char *str, *tok, *sv = NULL;
+	size_t n = 0, nchars = 0;
+
+	stream_line_reserve(&ln->buf, &ln->bufsz, sz + 1);
+	memcpy(ln->buf, data, sz);
+	ln->buf[sz] = '\0';
+	str = ln->buf;
+
+	do {
+		size_t len;
+
+		if (ctl->maxncols && n + 1 == ctl->maxncols)
+			tok = ln->buf + min(nchars, sz);
+		else
+			tok = local_strtok(ctl, st, str, &sv);
+		if (!tok)
+			break;
+
+		len = strlen(tok);
+		nchars += len + 1;
+
+		/* tabs are not separators in the last cell or for --separator */
+		stream_add_cell(ln, tok - ln->buf, len,
+				memchr(tok, '\t', len) ? mbs_width(tok) : len);
+		n++;
+		str = NULL;
+		if (ctl->maxncols && n == ctl->maxncols)
+			break;
+	} while (1);
+}
+
+/* see read_input() and add_line_to_table() */
+static void stream_split_wide(struct column_control *ctl,
+			      struct stream_line *ln,
+			      const char *data, size_t sz)
+{
+	wchar_t *wcs0, *wcs, *wcdata, *sv = NULL;
+	size_t n = 0, nchars = 0, len0, used = 0;
+
+	stream_line_reserve(&ln->tmp, &ln->tmpsz, sz + 1);
+	memcpy(ln->tmp, data, sz);
+	ln->tmp[sz] = '\0';
+
+	wcs0 = mbs_to_wcs(ln->tmp);
+	if (!wcs0) {
+		size_t tmpsz = 0;
+		char *tmp = mbs_invalid_encode(ln->tmp, &tmpsz);
+
+		if (!tmp)
+			err(EXIT_FAILURE, _("read failed"));
+		wcs0 = mbs_to_wcs(tmp);
+		free(tmp);
+		if (!wcs0)
+			err(EXIT_FAILURE, _("read failed"));
+	}
+	len0 = wcslen(wcs0);
+	wcs = wcs0;
+
+	do {
+		char *str;
+		size_t len;
+
+		if (ctl->maxncols && n + 1 == ctl->maxncols)
+			wcdata = wcs0 + min(nchars, len0);
+		else
+			wcdata = local_wcstok(ctl, wcs, &sv);
+		if (!wcdata)
+			break;
+
+		nchars += wcslen(wcdata) + 1;
+
+		str = wcs_to_mbs(wcdata);
+		if (!str)
+			err(EXIT_FAILURE, _("failed to allocate output data"));
+		len = strlen(str);
+		stream_line_reserve(&ln->buf, &ln->bufsz, used + len + 1);
+		memcpy(ln->buf + used, str, len + 1);
+		stream_add_cell(ln, used, len, mbs_width(str));
+		used += len + 1;
+		free(str);
+
+		n++;
+		wcs = NULL;
+		if (ctl->maxncols && n == ctl->maxncols)
+			break;
+	} while (1);
+
+	free(wcs0);
+}
+
+static size_t stream_split_line(struct column_control *ctl,
+				struct column_stream *st,
+				struct stream_line *ln,
+				const char *data, size_t sz)
+{
+	ln->ncells = 0;
+
+	if (st->separator && is_plain_line(data, sz))
+		stream_split_plain(ctl, st, ln, data, sz);
+	else
+		stream_split_wide(ctl, ln, data, sz);
+
+	return ln->ncells;
+}
+
+static void stream_scan_lines(struct column_control *ctl,
+			      struct column_stream *st,
+			      struct stream_scan *sc,
+			      const char *p, const char *end)
+{
+	while (p < end) {
+		const char *eol = memchr(p, '\n', end - p);
+		size_t i, n, sz = (eol ? eol : end) - p;
+
+		if (is_empty_line(p, sz)) {
+			if (ctl->keep_empty_lines)
+				sc->nlines++;
+		} else if ((n = stream_split_line(ctl, st, &sc->ln, p, sz))) {
+			if (sc->ncols < n) {
+				sc->widths = xrealloc(sc->widths, n * sizeof(size_t));
+				memset(sc->widths + sc->ncols, 0,
+					(n - sc->ncols) * sizeof(size_t));
+				sc->ncols = n;
+			}
+			for (i = 0; i < n; i++)
+				sc->widths[i] = max(sc->widths[i], sc->ln.cells[i].width);
+			sc->nlines++;
+		}
+		if (!eol)
+			break;
+		p = eol + 1;
+	}
+}
+
+static void stream_merge_scan(struct stream_scan *res, struct stream_scan *sc)
+{
+	size_t i;
+
+	if (res->ncols < sc->ncols) {
+		res->widths = xrealloc(res->widths, sc->ncols * sizeof(size_t));
+		memset(res->widths + res->ncols, 0,
+			(sc->ncols - res->ncols) * sizeof(size_t));
+		res->ncols = sc->ncols;
+	}
+	for (i = 0; i < sc->ncols; i++)
+		res->widths[i] = max(res->widths[i], sc->widths[i]);
+	res->nlines += sc->nlines;
+}
+
+#ifdef HAVE_LIBPTHREAD
+struct stream_chunk {
+	const char	*begin;
+	const char	*end;
+};
+
+struct scan_workers {
+	struct column_control	*ctl;
+	struct column_stream	*st;
+	struct stream_chunk	*chunks;
+	size_t			nchunks;
+
+	pthread_mutex_t		lock;	/* protects @next */
+	size_t			next;
+};
+
+struct scan_worker {
+	pthread_t		thread;
+	struct scan_workers	*wrk;
+	struct stream_scan	sc;
+};
+
+static void *scan_worker(void *data)
+{
+	struct scan_worker *me = data;
+	struct scan_workers *wrk = me->wrk;
+
+	for (;;) {
+		size_t idx;
+
+		pthread_mutex_lock(&wrk->lock);
+		idx = wrk->next++;
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (idx >= wrk->nchunks)
+			break;
+		stream_scan_lines(wrk->ctl, wrk->st, &me->sc,
+				wrk->chunks[idx].begin, wrk->chunks[idx].end);
+	}
+	return NULL;
+}
+
+/* splits the maps to chunks, a chunk ends with a newline */
+static size_t stream_get_chunks(struct column_stream *st, struct stream_chunk **chunks)
+{
+	size_t i, n = 0, max = 0;
+
+	*chunks = NULL;
+
+	for (i = 0; i < st->nmaps; i++) {
+		const char *p = st->maps[i].data,
+			   *end = p + st->maps[i].size;
+
+		while (p < end) {
+			const char *e = p + STREAM_PARALLEL_CHUNKSIZE;
+
+			if (e >= end)
+				e = end;
+			else {
+				e = memchr(e, '\n', end - e);
+				e = e ? e + 1 : end;
+			}
+			if (n == max) {
+				max += 64;
+				*chunks = xrealloc(*chunks, max * sizeof(struct stream_chunk));
+			}
+			(*chunks)[n].begin = p;
+			(*chunks)[n].end = e;
+			n++;
+			p = e;
+		}
+	}
+	return n;
+}
+
+/*
+ * Returns 1 if the input has been scanned by threads, or 0 if the caller has
+ * to scan it.
+ */
+static int stream_scan_parallel(struct column_control *ctl, struct column_stream *st)
+{
+	struct scan_workers wrk = { .ctl = ctl, .st = st };
+	struct scan_worker *workers;
+	size_t i, total = 0, nthreads, nrun;
+	long ncpus;
+
+	for (i = 0; i < st->nmaps; i++)
+		total += st->maps[i].size;
+	if (total < STREAM_PARALLEL_MINSIZE)
+		return 0;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus < 2)
+		return 0;
+
+	wrk.nchunks = stream_get_chunks(st, &wrk.chunks);
+	nthreads = min((size_t) ncpus, (size_t) STREAM_PARALLEL_MAXTHREADS);
+	nthreads = min(nthreads, wrk.nchunks);
+
+	workers = xcalloc(nthreads, sizeof(struct scan_worker));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (nrun = 0; nrun < nthreads; nrun++) {
+		workers[nrun].wrk = &wrk;
+		if (pthread_create(&workers[nrun].thread, NULL,
+				   scan_worker, &workers[nrun]) != 0)
+			break;
+	}
+	for (i = 0; i < nrun; i++) {
+		pthread_join(workers[i].thread, NULL);
+		stream_merge_scan(&st->sc, &workers[i].sc);
+		free(workers[i].sc.widths);
+		stream_free_line(&workers[i].sc.ln);
+	}
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(workers);
+	free(wrk.chunks);
+
+	return nrun ? 1 : 0;
+}
+#else
+static int stream_scan_parallel(
+			struct column_control *ctl __attribute__((__unused__)),
+			struct column_stream *st __attribute__((__unused__)))
+{
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
+static int is_stream_possible(struct column_control *ctl)
+{
+	return ctl->mode == COLUMN_MODE_TABLE
+	       && !ctl->json
+	       && !ctl->tree
+	       && !ctl->tab_order
+	       && !ctl->tab_coltrunc
+	       && !ctl->tab_colnoextrem
+	       && !ctl->tab_colwrap
+	       && !ctl->tab_colhide
+	       && !ctl->header_repeat;
+}
+
+static void stream_unmap_inputs(struct column_stream *st)
+{
+	size_t i;
+
+	for (i = 0; i < st->nmaps; i++) {
+		if (st->maps[i].size)
+			munmap(st->maps[i].data, st->maps[i].size);
+	}
+	free(st->maps);
+	st->maps = NULL;
+	st->nmaps = 0;
+}
+
+/* returns 0 if all the input files (or stdin) are regular files mapped to memory */
+static int stream_map_inputs(struct column_stream *st, char **files)
+{
+	size_t i, nfiles = files && *files ? strv_length(files) : 1;
+
+	st->maps = xcalloc(nfiles, sizeof(struct stream_map));
+
+	for (i = 0; i < nfiles; i++) {
+		struct stream_map *m = &st->maps[i];
+		struct stat sb;
+		int fd = files && *files ? open(files[i], O_RDONLY | O_CLOEXEC) : STDIN_FILENO;
+
+		if (fd < 0)
+			goto fail;
+		if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)
+		    || (uintmax_t) sb.st_size > SIZE_MAX)
+			goto fail_fd;
+
+		/* stdin may be already read */
+		if (fd == STDIN_FILENO && lseek(fd, 0, SEEK_CUR) != 0)
+			goto fail_fd;
+
+		if (sb.st_size) {
+			m->data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (m->data == MAP_FAILED)
+				goto fail_fd;
+			m->size = sb.st_size;
+			posix_madvise(m->data, m->size, POSIX_MADV_SEQUENTIAL);
+		}
+		st->nmaps++;
+		if (fd != STDIN_FILENO)
+			close(fd);
+		continue;
+fail_fd:
+		if (fd != STDIN_FILENO)
+			close(fd);
+fail:
+		stream_unmap_inputs(st);
+		return -1;
+	}
+	return 0;
+}
+
+/* see apply_columnflag_from_list(); returns -1 for the last column */
+static int stream_set_right(struct column_control *ctl, struct column_stream *st)
+{
+	char **all, **one;
+
+	st->right = xcalloc(st->sc.ncols, 1);
+	if (!ctl->tab_colright)
+		return 0;
+
+	if (strcmp(ctl->tab_colright, "0") == 0)
+		memset(st->right, 1, st->sc.ncols);
+
+	all = split_or_error(ctl->tab_colright, _("failed to parse --table-right list"));
+
+	STRV_FOREACH(one, all) {
+		uint32_t colnum = 0;
+
+		if (isdigit_string(*one))
+			colnum = strtou32_or_err(*one, _("failed to parse column")) - 1;
+		else {
+			char **name;
+
+			STRV_FOREACH(name, ctl->tab_colnames) {
+				if (strcasecmp(*name, *one) == 0)
+					break;
+				colnum++;
+			}
+			if (!name || !*name)
+				errx(EXIT_FAILURE, _("undefined column name '%s'"), *one);
+		}
+		if (colnum < st->sc.ncols)
+			st->right[colnum] = 1;
+	}
+	strv_free(all);
+
+	/* libsmartcols enlarges the last column if right aligned */
+	return st->right[st->sc.ncols - 1] ? -1 : 0;
+}
+
+/* see count_column_width() in libsmartcols */
+static void stream_set_widths(struct column_control *ctl, struct column_stream *st)
+{
+	size_t i, nnames = strv_length(ctl->tab_colnames);
+
+	for (i = 0; i < st->sc.ncols; i++) {
+		size_t min = 1;
+
+		if (i < nnames)
+			min = max(mbs_width(ctl->tab_colnames[i]), min);
+		else if (st->sc.widths[i] == 0)
+			continue;	/* no header and data */
+
+		st->sc.widths[i] = max(st->sc.widths[i], min);
+	}
+}
+
+static void stream_print_padding(size_t n)
+{
+	static const char spaces[] = "                                ";
+
+	while (n) {
+		size_t x = min(n, sizeof(spaces) - 1);
+
+		fwrite(spaces, 1, x, stdout);
+		n -= x;
+	}
+}
+
+/* see print_data() in libsmartcols */
+static void stream_print_cell(struct column_control *ctl, struct column_stream *st,
+			      size_t col, const char *data, size_t len, size_t width)
+{
+	size_t colwidth = st->sc.widths[col];
+	int right = st->right[col] && width;
+
+	if (right && width < colwidth)
+		stream_print_padding(colwidth - width);
+	if (width)
+		fwrite(data, 1, len, stdout);
+	if (col + 1 == st->sc.ncols)
+		return;
+	if (!right && width < colwidth)
+		stream_print_padding(colwidth - width);
+	fputs(ctl->output_separator, stdout);
+}
+
+static void stream_print_header(struct column_control *ctl, struct column_stream *st)
+{
+	size_t i, nnames = strv_length(ctl->tab_colnames);
+
+	for (i = 0; i < st->sc.ncols; i++) {
+		const char *name = i < nnames ? ctl->tab_colnames[i] : "";
+
+		stream_print_cell(ctl, st, i, name, strlen(name), mbs_width(name));
+	}
+	fputc('\n', stdout);
+}
+
+static void stream_print_lines(struct column_control *ctl, struct column_stream *st,
+			       const char *p, const char *end)
+{
+	struct stream_line *ln = &st->sc.ln;
+
+	while (p < end) {
+		const char *eol = memchr(p, '\n', end - p);
+		size_t i, n = 0, sz = (eol ? eol : end) - p;
+
+		if (is_empty_line(p, sz)) {
+			if (!ctl->keep_empty_lines)
+				goto next;
+		} else if (!(n = stream_split_line(ctl, st, ln, p, sz)))
+			goto next;
+
+		for (i = 0; i < st->sc.ncols; i++) {
+			if (i < n)
+				stream_print_cell(ctl, st, i, ln->buf + ln->cells[i].off,
+						  ln->cells[i].len, ln->cells[i].width);
+			else
+				stream_print_cell(ctl, st, i, NULL, 0, 0);
+		}
+		fputc('\n', stdout);
+next:
+		if (!eol)
+			break;
+		p = eol + 1;
+	}
+}
+
+/*
+ * Returns 0 if the table has been printed, or -1 if the input has to be read
+ * by read_input().
+ */
+static int stream_table(struct column_control *ctl, char **files)
+{
+	struct column_stream st = { .maps = NULL };
+	size_t i;
+	int rc = -1;
+
+	if (!is_stream_possible(ctl) || stream_map_inputs(&st, files) != 0)
+		return -1;
+
+	if (ctl->input_separator)
+		st.separator = wcs_to_mbs(ctl->input_separator);
+	if (st.separator && !is_plain_line(st.separator, strlen(st.separator))) {
+		free(st.separator);
+		st.separator = NULL;
+	}
+
+	/* the first pass */
+	if (!stream_scan_parallel(ctl, &st)) {
+		for (i = 0; i < st.nmaps; i++)
+			stream_scan_lines(ctl, &st, &st.sc, st.maps[i].data,
+					st.maps[i].data + st.maps[i].size);
+	}
+
+	if (ctl->tab_colnames) {
+		size_t nnames = strv_length(ctl->tab_colnames);
+
+		if (st.sc.ncols < nnames) {
+			st.sc.widths = xrealloc(st.sc.widths, nnames * sizeof(size_t));
+			memset(st.sc.widths + st.sc.ncols, 0,
+				(nnames - st.sc.ncols) * sizeof(size_t));
+			st.sc.ncols = nnames;
+		}
+	}
+
+	if (!st.sc.nlines) {
+		rc = 0;		/* nothing to print */
+		goto done;
+	}
+	if (!st.sc.ncols)	/* empty lines only, libsmartcols returns error */
+		goto done;
+	if (stream_set_right(ctl, &st) != 0)
+		goto done;
+	stream_set_widths(ctl, &st);
+
+	/* the second pass */
+	if (ctl->tab_colnames && !ctl->tab_noheadings)
+		stream_print_header(ctl, &st);
+	for (i = 0; i < st.nmaps; i++)
+		stream_print_lines(ctl, &st, st.maps[i].data,
+				st.maps[i].data + st.maps[i].size);
+	rc = 0;
+done:
+	stream_unmap_inputs(&st);
+	stream_free_line(&st.sc.ln);
+	free(st.sc.widths);
+	free(st.separator);
+	free(st.right);
+	return rc;
+}
+
 
 static void columnate_fillrows(struct column_control *ctl)
 {
@@ -859,6 +1547,9 @@ int main(int argc, char **argv)
 	if (ctl.tab_colnames == NULL && ctl.json)
 		errx(EXIT_FAILURE, _("option --table-columns required for --json"));
 
+	if (stream_table(&ctl, argv) == 0)
+		return EXIT_SUCCESS;
+
 	if (!*argv)
 		eval += read_input(&ctl, stdin);
 	else
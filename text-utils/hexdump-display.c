@@ -34,6 +34,7 @@
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
 #include <ctype.h>
@@ -45,6 +46,7 @@
 #include "c.h"
 #include "nls.h"
 #include "colors.h"
+#include "blkdev.h"
 
 static void doskip(const char *, int, struct hexdump *);
 static u_char *get(struct hexdump *);
@@ -54,6 +56,13 @@ enum _vflag vflag = FIRST;
 static off_t address;			/* address/offset in stream */
 static off_t eaddress;			/* end address */
 
+/* regular file or block device on stdin mapped to memory */
+static u_char *mapdata;
+static size_t mapsize;
+static size_t mappos;			/* the current offset in the map */
+
+#define DUP_CHUNK_SIZE	(64 * 1024)	/* bytes compared at once by skip_dups() */
+
 static const char *color_cond(struct hexdump_pr *pr, unsigned char *bp, int bcnt)
 {
 	register struct list_head *p;
@@ -237,6 +246,128 @@ static void bpad(struct hexdump_pr *pr)
 		;
 }
 
+/*
+ * Specialized printers for the built-in formats, see fast_format(). The output
+ * is the same as from print() for the parsed format units, including the
+ * blank padding at the end of data.
+ */
+static const char hexchars[] = "0123456789abcdef";
+
+/* the same as "%0<width>llx" */
+static char *put_hex(char *p, unsigned long long val, int width)
+{
+	char tmp[sizeof(val) * 2];
+	int n = 0;
+
+	do {
+		tmp[n++] = hexchars[val & 0xf];
+		val >>= 4;
+	} while (val);
+
+	for (; width > n; width--)
+		*p++ = '0';
+	while (n)
+		*p++ = tmp[--n];
+	return p;
+}
+
+static char *put_uint16(char *p, const unsigned char *bp)
+{
+	uint16_t val;
+
+	memcpy(&val, bp, sizeof(val));
+	p[0] = hexchars[(val >> 12) & 0xf];
+	p[1] = hexchars[(val >> 8) & 0xf];
+	p[2] = hexchars[(val >> 4) & 0xf];
+	p[3] = hexchars[val & 0xf];
+	return p + 4;
+}
+
+/* "%07.7_ax " 8/2 "%04x " "\n" or "%07.7_ax " 8/2 "   %04x " "\n" */
+static size_t fast_hex2(char *buf, const unsigned char *bp, int nbytes, int wide)
+{
+	char *p = put_hex(buf, address, 7);
+	int i;
+
+	*p++ = ' ';
+	for (i = 0; i < 16; i += 2) {
+		if (wide) {
+			memcpy(p, "   ", 3);
+			p += 3;
+		}
+		if (i < nbytes)
+			p = put_uint16(p, bp + i);
+		else {
+			memcpy(p, "    ", 4);
+			p += 4;
+		}
+		if (i < 14)
+			*p++ = ' ';
+	}
+	*p++ = '\n';
+	return p - buf;
+}
+
+/* "%08.8_ax  " 8/1 "%02x " "  " 8/1 "%02x " and "  |" 16/1 "%_p" "|\n" */
+static size_t fast_canonical(char *buf, const unsigned char *bp, int nbytes)
+{
+	static char printable[256];
+	char *p = put_hex(buf, address, 8);
+	int i;
+
+	if (!printable['.']) {
+		for (i = 0; i < 256; i++)
+			printable[i] = isprint(i) ? i : '.';
+	}
+
+	*p++ = ' ';
+	*p++ = ' ';
+	for (i = 0; i < 16; i++) {
+		if (i < nbytes) {
+			*p++ = hexchars[bp[i] >> 4];
+			*p++ = hexchars[bp[i] & 0xf];
+		} else {
+			*p++ = ' ';
+			*p++ = ' ';
+		}
+		if (i == 7) {
+			*p++ = ' ';
+			*p++ = ' ';
+		} else if (i < 15)
+			*p++ = ' ';
+	}
+	memcpy(p, "  |", 3);
+	p += 3;
+	for (i = 0; i < nbytes; i++)
+		*p++ = printable[bp[i]];
+	*p++ = '|';
+	*p++ = '\n';
+	return p - buf;
+}
+
+static void display_fast(struct hexdump *hex, const unsigned char *bp)
+{
+	char buf[128];
+	int nbytes = hex->blocksize;
+	size_t sz = 0;
+
+	if (eaddress && eaddress - address < nbytes)
+		nbytes = eaddress - address;
+
+	switch (hex->fast) {
+	case HEXDUMP_FAST_HEX2:
+		sz = fast_hex2(buf, bp, nbytes, 0);
+		break;
+	case HEXDUMP_FAST_HEX2X:
+		sz = fast_hex2(buf, bp, nbytes, 1);
+		break;
+	case HEXDUMP_FAST_CANONICAL:
+		sz = fast_canonical(buf, bp, nbytes);
+		break;
+	}
+	fwrite(buf, 1, sz, stdout);
+}
+
 void display(struct hexdump *hex)
 {
 	register struct list_head *fs;
@@ -250,6 +381,10 @@ void display(struct hexdump *hex)
 	struct list_head *p, *q, *r;
 
 	while ((bp = get(hex)) != NULL) {
+		if (hex->fast) {
+			display_fast(hex, bp);
+			continue;
+		}
 		fs = &hex->fshead; savebp = bp; saveaddress = address;
 
 		list_for_each(p, fs) {
@@ -324,6 +459,94 @@ void display(struct hexdump *hex)
 
 static char **_argv;
 
+static void unmap_input(void)
+{
+	if (mapdata)
+		munmap(mapdata, mapsize);
+	mapdata = NULL;
+	mapsize = mappos = 0;
+}
+
+/* maps stdin to memory if possible, otherwise stdin is read by fread() */
+static void map_input(void)
+{
+	struct stat st;
+	unsigned long long size = 0;
+	off_t off;
+	void *data;
+	int fd = fileno(stdin);
+
+	unmap_input();
+
+	if (fd < 0 || fstat(fd, &st) != 0)
+		return;
+	if (S_ISREG(st.st_mode))
+		size = st.st_size;
+	else if (!S_ISBLK(st.st_mode) || blkdev_get_size(fd, &size) != 0)
+		return;
+
+	off = ftello(stdin);
+	if (off < 0 || (unsigned long long) off > size || size > SIZE_MAX)
+		return;
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return;
+	posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+	mapdata = data;
+	mapsize = size;
+	mappos = off;
+}
+
+static size_t read_input(u_char *buf, size_t sz)
+{
+	if (!mapdata)
+		return fread(buf, sizeof(unsigned char), sz, stdin);
+
+	sz = min(sz, mapsize - mappos);
+	memcpy(buf, mapdata + mappos, sz);
+	mappos += sz;
+	return sz;
+}
+
+/*
+ * Returns the number of the following blocks in the map which are the same as
+ * @prev. A run of duplicate blocks is data repeating with the period of the
+ * block size, so the blocks are compared with their predecessors by large
+ * memcmp() calls.
+ */
+static size_t skip_dups(struct hexdump *hex, const u_char *prev)
+{
+	size_t bs = hex->blocksize, n, nblocks, chunk;
+	const u_char *p = mapdata + mappos;
+
+	nblocks = (mapsize - mappos) / bs;
+	if (hex->length != -1)
+		nblocks = min(nblocks, (size_t) hex->length / bs);
+	if (!nblocks || memcmp(p, prev, bs) != 0)
+		return 0;
+
+	chunk = max(DUP_CHUNK_SIZE / bs, (size_t) 1);
+
+	for (n = 1; n < nblocks; ) {
+		size_t x = min(chunk, nblocks - n);
+
+		if (memcmp(p + n * bs, p + (n - 1) * bs, x * bs) == 0) {
+			n += x;
+			continue;
+		}
+		while (memcmp(p + n * bs, p + (n - 1) * bs, bs) == 0)
+			n++;
+		break;
+	}
+
+	mappos += n * bs;
+	if (hex->length != -1)
+		hex->length -= n * bs;
+	return n;
+}
+
 static u_char *
 get(struct hexdump *hex)
 {
@@ -366,8 +589,20 @@ get(struct hexdump *hex)
 			warnx(_("all input file arguments failed"));
 			goto retnul;
 		}
-		n = fread((char *)curp + nread, sizeof(unsigned char),
-		    hex->length == -1 ? need : min(hex->length, need), stdin);
+		if (mapdata && need == hex->blocksize
+		    && (vflag == DUP || vflag == WAIT)) {
+			size_t ndups = skip_dups(hex, savp);
+
+			if (ndups) {
+				if (vflag == WAIT)
+					printf("*\n");
+				vflag = DUP;
+				address += ndups * hex->blocksize;
+				continue;
+			}
+		}
+		n = read_input(curp + nread,
+		    hex->length == -1 ? need : min(hex->length, need));
 		if (!n) {
 			if (ferror(stdin))
 				warn("%s", _argv[-1]);
@@ -395,6 +630,7 @@ get(struct hexdump *hex)
 			nread += n;
 	}
 retnul:
+	unmap_input();
 	free (curp);
 	free (savp);
 	return NULL;
@@ -427,8 +663,10 @@ int next(char **argv, struct hexdump *hex)
 			doskip(statok ? *_argv : "stdin", statok, hex);
 		if (*_argv)
 			++_argv;
-		if (!hex->skip)
+		if (!hex->skip) {
+			map_input();
 			return(1);
+		}
 	}
 	/* NOTREACHED */
 }
@@ -474,6 +474,74 @@ isint:				cs[3] = '\0';
 	}
 }
 
+static int fu_equal(struct hexdump_fu *a, struct hexdump_fu *b)
+{
+	return a->reps == b->reps && a->bcnt == b->bcnt
+	       && a->flags == b->flags && strcmp(a->fmt, b->fmt) == 0;
+}
+
+static int fs_equal(struct hexdump_fs *a, struct hexdump_fs *b)
+{
+	struct list_head *p, *q;
+
+	for (p = a->fulist.next, q = b->fulist.next;
+	     p != &a->fulist && q != &b->fulist;
+	     p = p->next, q = q->next) {
+		if (!fu_equal(list_entry(p, struct hexdump_fu, fulist),
+			      list_entry(q, struct hexdump_fu, fulist)))
+			return 0;
+	}
+	return p == &a->fulist && q == &b->fulist;
+}
+
+/* compares the format strings with the already parsed formats */
+static int is_format(struct hexdump *hex, const char *const *fmts)
+{
+	struct hexdump *tmp = xcalloc(1, sizeof(struct hexdump));
+	struct list_head *p, *q;
+	int rc;
+
+	INIT_LIST_HEAD(&tmp->fshead);
+	for (; *fmts; fmts++)
+		add_fmt(*fmts, tmp);
+
+	for (p = hex->fshead.next, q = tmp->fshead.next;
+	     p != &hex->fshead && q != &tmp->fshead;
+	     p = p->next, q = q->next) {
+		if (!fs_equal(list_entry(p, struct hexdump_fs, fslist),
+			      list_entry(q, struct hexdump_fs, fslist)))
+			break;
+	}
+	rc = p == &hex->fshead && q == &tmp->fshead;
+
+	hex_free(tmp);
+	return rc;
+}
+
+/*
+ * Returns HEXDUMP_FAST_* if the formats are the same as any built-in format
+ * with a specialized printer in display(). It has to be called before
+ * rewrite_rules().
+ */
+int fast_format(struct hexdump *hex)
+{
+	static const char *const hex2[] =
+		{ HEXDUMP_FMT_OFFSET, HEXDUMP_FMT_HEX2, NULL };
+	static const char *const hex2x[] =
+		{ HEXDUMP_FMT_OFFSET, HEXDUMP_FMT_HEX2X, NULL };
+	static const char *const canonical[] =
+		{ HEXDUMP_FMT_CANON_OFFSET, HEXDUMP_FMT_CANON_HEX,
+		  HEXDUMP_FMT_CANON_TEXT, NULL };
+
+	if (is_format(hex, hex2))
+		return HEXDUMP_FAST_HEX2;
+	if (is_format(hex, hex2x))
+		return HEXDUMP_FAST_HEX2X;
+	if (is_format(hex, canonical))
+		return HEXDUMP_FAST_CANONICAL;
+	return HEXDUMP_FAST_NONE;
+}
+
 /* [!]color[:string|:hex_number|:oct_number][@offt|@offt_start-offt_end],... */
 static struct list_head *color_fmt(char *cfmt, int bcnt)
 {
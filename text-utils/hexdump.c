@@ -54,14 +54,12 @@
 #include "xalloc.h"
 #include "closestream.h"
 
-void hex_free(struct hexdump *);
-
 int
 parse_args(int argc, char **argv, struct hexdump *hex)
 {
 	int ch;
 	int colormode = UL_COLORMODE_UNDEF;
-	char *hex_offt = "\"%07.7_Ax\n\"";
+	char *hex_offt = HEXDUMP_FMT_OFFSET;
 
 
 	static const struct option longopts[] = {
@@ -84,9 +82,9 @@ parse_args(int argc, char **argv, struct hexdump *hex)
 
 	if (!strcmp(program_invocation_short_name, "hd")) {
 		/* Canonical format */
-		add_fmt("\"%08.8_Ax\n\"", hex);
-		add_fmt("\"%08.8_ax  \" 8/1 \"%02x \" \"  \" 8/1 \"%02x \" ", hex);
-		add_fmt("\"  |\" 16/1 \"%_p\" \"|\\n\"", hex);
+		add_fmt(HEXDUMP_FMT_CANON_OFFSET, hex);
+		add_fmt(HEXDUMP_FMT_CANON_HEX, hex);
+		add_fmt(HEXDUMP_FMT_CANON_TEXT, hex);
 	}
 
 	while ((ch = getopt_long(argc, argv, "bcCde:f:L::n:os:vxhV", longopts, NULL)) != -1) {
@@ -100,9 +98,9 @@ parse_args(int argc, char **argv, struct hexdump *hex)
 			add_fmt("\"%07.7_ax \" 16/1 \"%3_c \" \"\\n\"", hex);
 			break;
 		case 'C':
-			add_fmt("\"%08.8_Ax\n\"", hex);
-			add_fmt("\"%08.8_ax  \" 8/1 \"%02x \" \"  \" 8/1 \"%02x \" ", hex);
-			add_fmt("\"  |\" 16/1 \"%_p\" \"|\\n\"", hex);
+			add_fmt(HEXDUMP_FMT_CANON_OFFSET, hex);
+			add_fmt(HEXDUMP_FMT_CANON_HEX, hex);
+			add_fmt(HEXDUMP_FMT_CANON_TEXT, hex);
 			break;
 		case 'd':
 			add_fmt(hex_offt, hex);
@@ -135,7 +133,7 @@ parse_args(int argc, char **argv, struct hexdump *hex)
 			break;
 		case 'x':
 			add_fmt(hex_offt, hex);
-			add_fmt("\"%07.7_ax \" 8/2 \"   %04x \" \"\\n\"", hex);
+			add_fmt(HEXDUMP_FMT_HEX2X, hex);
 			break;
 
 		case 'h':
@@ -149,7 +147,7 @@ parse_args(int argc, char **argv, struct hexdump *hex)
 
 	if (list_empty(&hex->fshead)) {
 		add_fmt(hex_offt, hex);
-		add_fmt("\"%07.7_ax \" 8/2 \"%04x \" \"\\n\"", hex);
+		add_fmt(HEXDUMP_FMT_HEX2, hex);
 	}
 	colors_init (colormode, "hexdump");
 	return optind;
@@ -206,6 +204,7 @@ int main(int argc, char **argv)
 	close_stdout_atexit();
 
 	argv += parse_args(argc, argv, hex);
+	hex->fast = fast_format(hex);
 
 	/* figure out the data block size */
 	hex->blocksize = 0;
@@ -86,12 +86,29 @@ struct hexdump_fs {			/* format strings */
 	int bcnt;
 };
 
+/* built-in formats */
+#define HEXDUMP_FMT_OFFSET		"\"%07.7_Ax\n\""
+#define HEXDUMP_FMT_HEX2		"\"%07.7_ax \" 8/2 \"%04x \" \"\\n\""
+#define HEXDUMP_FMT_HEX2X		"\"%07.7_ax \" 8/2 \"   %04x \" \"\\n\""
+#define HEXDUMP_FMT_CANON_OFFSET	"\"%08.8_Ax\n\""
+#define HEXDUMP_FMT_CANON_HEX		"\"%08.8_ax  \" 8/1 \"%02x \" \"  \" 8/1 \"%02x \" "
+#define HEXDUMP_FMT_CANON_TEXT		"\"  |\" 16/1 \"%_p\" \"|\\n\""
+
+/* built-in formats with a specialized printer, see fast_format() */
+enum {
+	HEXDUMP_FAST_NONE = 0,
+	HEXDUMP_FAST_HEX2,		/* default */
+	HEXDUMP_FAST_HEX2X,		/* -x */
+	HEXDUMP_FAST_CANONICAL		/* -C */
+};
+
 struct hexdump {
   struct list_head fshead;				/* head of format strings */
   ssize_t blocksize;			/* data block size */
   int exitval;				/* final exit value */
   ssize_t length;			/* max bytes to read */
   off_t skip;				/* bytes to skip */
+  int fast;				/* HEXDUMP_FAST_* */
 };
 
 extern struct hexdump_fu *endfu;
@@ -104,6 +121,8 @@ void add_fmt(const char *, struct hexdump *);
 void rewrite_rules(struct hexdump_fs *, struct hexdump *);
 void addfile(char *, struct hexdump *);
 void display(struct hexdump *);
+int fast_format(struct hexdump *);
+void hex_free(struct hexdump *);
 void __attribute__((__noreturn__)) usage(void);
 void conv_c(struct hexdump_pr *, u_char *);
 void conv_u(struct hexdump_pr *, u_char *);
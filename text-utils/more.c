@@ -66,6 +66,10 @@
 #include <paths.h>
 #include <getopt.h>
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
 #if defined(HAVE_NCURSESW_TERM_H)
 # include <ncursesw/term.h>
 #elif defined(HAVE_NCURSES_TERM_H)
@@ -107,6 +111,9 @@
 #define INIT_BUF	80
 #define COMMAND_BUF	200
 #define REGERR_BUF	NUM_COLUMNS
+#define INDEX_STEP	256		/* lines per line index entry */
+#define SCAN_BUF	(1024 * 1024)	/* read size for line index and search */
+#define SEARCH_POLL	4096		/* lines searched between signal checks */
 
 #define TERM_AUTO_RIGHT_MARGIN    "am"
 #define TERM_BACKSPACE            "cub1"
@@ -156,10 +163,43 @@ struct number_command {
 	more_key_commands key;
 };
 
+/*
+ * Line index of a regular file; every INDEX_STEP-th line offset is collected
+ * in background, so going backwards or to +<number> does not need to read
+ * the whole file from the beginning.
+ */
+struct line_index {
+	int fd;				/* file descriptor for pread() */
+	char *buf;			/* read buffer */
+	off_t scanned;			/* number of already indexed bytes */
+	size_t nlines;			/* number of already indexed lines */
+	off_t *offsets;			/* offsets of lines 0, INDEX_STEP, ... */
+	size_t noffsets;		/* number of valid @offsets entries */
+	size_t alloc;			/* number of allocated @offsets entries */
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+	pthread_mutex_t lock;		/* protects @offsets, @noffsets and @stop */
+#endif
+	int done;			/* whole file indexed */
+	int stop;			/* thread should terminate */
+	int threaded;			/* index is collected by thread */
+};
+
+/* Large-buffer reader for search() */
+struct search_scan {
+	int fd;				/* file descriptor for pread() */
+	char *buf;			/* read buffer */
+	size_t len;			/* amount of data in @buf */
+	size_t off;			/* current position in @buf */
+	off_t base;			/* file offset of @buf */
+	unsigned int eof:1;		/* nothing more to read */
+};
+
 struct more_control {
 	struct termios output_tty;	/* output terminal */
 	struct termios original_tty;	/* original terminal settings */
 	FILE *current_file;		/* currently open input file */
+	struct line_index *lineidx;	/* line index of current_file or NULL */
 	off_t file_position;		/* file position */
 	off_t file_size;		/* file size */
 	int argv_position;		/* argv[] position */
@@ -371,20 +411,146 @@ static void more_fseek(struct more_control *ctl, off_t pos)
 	fseeko(ctl->current_file, pos, SEEK_SET);
 }
 
+/* The position is counted here, ftello() for every char is expensive. */
 static int more_getc(struct more_control *ctl)
 {
 	int ret = getc(ctl->current_file);
-	ctl->file_position = ftello(ctl->current_file);
+	if (ret != EOF)
+		ctl->file_position++;
 	return ret;
 }
 
 static int more_ungetc(struct more_control *ctl, int c)
 {
 	int ret = ungetc(c, ctl->current_file);
-	ctl->file_position = ftello(ctl->current_file);
+	if (ret != EOF)
+		ctl->file_position--;
 	return ret;
 }
 
+static inline void index_lock(struct line_index *idx __attribute__((__unused__)))
+{
+#ifdef HAVE_LIBPTHREAD
+	if (idx->threaded)
+		pthread_mutex_lock(&idx->lock);
+#endif
+}
+
+static inline void index_unlock(struct line_index *idx __attribute__((__unused__)))
+{
+#ifdef HAVE_LIBPTHREAD
+	if (idx->threaded)
+		pthread_mutex_unlock(&idx->lock);
+#endif
+}
+
+static void index_add(struct line_index *idx, off_t pos)
+{
+	if (idx->noffsets == idx->alloc) {
+		idx->alloc = idx->alloc ? idx->alloc * 2 : 1024;
+		idx->offsets = xrealloc(idx->offsets,
+					idx->alloc * sizeof(*idx->offsets));
+	}
+	idx->offsets[idx->noffsets++] = pos;
+}
+
+/* Indexes next block of the file, returns 0 at the end of the file. */
+static int index_scan_block(struct line_index *idx)
+{
+	const char *p, *end;
+	ssize_t sz;
+
+	sz = pread(idx->fd, idx->buf, SCAN_BUF, idx->scanned);
+	if (sz < 0 && errno == EINTR)
+		return 1;
+	if (sz <= 0) {
+		idx->done = 1;
+		return 0;
+	}
+
+	index_lock(idx);
+	end = idx->buf + sz;
+	for (p = idx->buf; (p = memchr(p, '\n', end - p)) != NULL; p++) {
+		if (++idx->nlines % INDEX_STEP == 0)
+			index_add(idx, idx->scanned + (p - idx->buf) + 1);
+	}
+	index_unlock(idx);
+
+	idx->scanned += sz;
+	return 1;
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *index_thread(void *data)
+{
+	struct line_index *idx = data;
+	int stop = 0;
+
+	while (!stop && index_scan_block(idx)) {
+		index_lock(idx);
+		stop = idx->stop;
+		index_unlock(idx);
+	}
+	return NULL;
+}
+#endif
+
+static void index_open(struct more_control *ctl)
+{
+	struct line_index *idx = xcalloc(1, sizeof(*idx));
+
+	idx->fd = fileno(ctl->current_file);
+	idx->buf = xmalloc(SCAN_BUF);
+	index_add(idx, 0);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&idx->lock, NULL);
+	idx->threaded = 1;
+	if (pthread_create(&idx->thread, NULL, index_thread, idx) != 0)
+		idx->threaded = 0;
+#endif
+	ctl->lineidx = idx;
+}
+
+static void index_close(struct more_control *ctl)
+{
+	struct line_index *idx = ctl->lineidx;
+
+	if (!idx)
+		return;
+#ifdef HAVE_LIBPTHREAD
+	if (idx->threaded) {
+		index_lock(idx);
+		idx->stop = 1;
+		index_unlock(idx);
+		pthread_join(idx->thread, NULL);
+		idx->threaded = 0;
+	}
+	pthread_mutex_destroy(&idx->lock);
+#endif
+	free(idx->offsets);
+	free(idx->buf);
+	free(idx);
+	ctl->lineidx = NULL;
+}
+
+/* Returns the nearest indexed line before or at @line and its offset. */
+static int index_lookup(struct line_index *idx, int line, off_t *pos)
+{
+	size_t n = line / INDEX_STEP;
+
+	if (!idx->threaded) {
+		while (!idx->done && idx->noffsets <= n)
+			index_scan_block(idx);
+	}
+	index_lock(idx);
+	if (n >= idx->noffsets)
+		n = idx->noffsets - 1;
+	*pos = idx->offsets[n];
+	index_unlock(idx);
+
+	return n * INDEX_STEP;
+}
+
 static void print_separator(const int c, int n)
 {
 	while (n--)
@@ -476,6 +642,8 @@ static void checkf(struct more_control *ctl, char *fs)
 	more_ungetc(ctl, c);
 	if ((ctl->file_size = st.st_size) == 0)
 		ctl->file_size = ~((off_t)0);
+	if (S_ISREG(st.st_mode))
+		index_open(ctl);
 }
 
 static void prepare_line_buffer(struct more_control *ctl)
@@ -773,6 +941,7 @@ static void __attribute__((__noreturn__)) more_exit(struct more_control *ctl)
 	free(ctl->shell_line);
 	free(ctl->line_buf);
 	free(ctl->go_home);
+	index_close(ctl);
 	if (ctl->current_file)
 		fclose(ctl->current_file);
 	del_curterm(cur_term);
@@ -1315,6 +1484,19 @@ static void skip_lines(struct more_control *ctl)
 	}
 }
 
+/* Move to the @line of the file; the index is used if available */
+static void jump_to_line(struct more_control *ctl, int line)
+{
+	off_t pos = 0;
+
+	ctl->current_line = 0;
+	if (ctl->lineidx)
+		ctl->current_line = index_lookup(ctl->lineidx, line, &pos);
+	more_fseek(ctl, pos);
+	ctl->next_jump = line - ctl->current_line;
+	skip_lines(ctl);
+}
+
 /*  Clear the screen */
 static void more_clear_screen(struct more_control *ctl)
 {
@@ -1341,6 +1523,59 @@ static void read_line(struct more_control *ctl)
 	*p = '\0';
 }
 
+static int scan_fill(struct search_scan *sc)
+{
+	ssize_t sz;
+
+	sc->base += sc->len;
+	sc->off = sc->len = 0;
+	do {
+		sz = pread(sc->fd, sc->buf, SCAN_BUF, sc->base);
+	} while (sz < 0 && errno == EINTR);
+
+	if (sz <= 0) {
+		sc->eof = 1;
+		return 0;
+	}
+	sc->len = sz;
+	return 1;
+}
+
+/* The same as read_line(), but reads from the search buffer. */
+static void scan_read_line(struct more_control *ctl, struct search_scan *sc)
+{
+	size_t n = 0, max = ctl->line_sz - 1;
+
+	for (;;) {
+		const char *p, *nl;
+		size_t avail, sz;
+
+		if (sc->off == sc->len && !scan_fill(sc))
+			break;
+
+		p = sc->buf + sc->off;
+		nl = memchr(p, '\n', sc->len - sc->off);
+		avail = (nl ? nl : sc->buf + sc->len) - p;
+		sz = min(avail, max - n);
+
+		memcpy(ctl->line_buf + n, p, sz);
+		n += sz;
+		sc->off += sz;
+
+		if (n == max && sz < avail) {
+			sc->off++;		/* read_line() drops this char */
+			break;
+		}
+		if (nl) {
+			sc->off++;
+			ctl->current_line++;
+			break;
+		}
+	}
+	ctl->line_buf[n] = '\0';
+	ctl->file_position = sc->base + sc->off;
+}
+
 static int more_poll(struct more_control *ctl, int timeout)
 {
 	struct pollfd pfd[2];
@@ -1396,8 +1631,9 @@ static void search(struct more_control *ctl, char buf[], int n)
 	off_t line2 = startline;
 	off_t line3;
 	int lncount;
-	int saveln, rc;
+	int saveln, rc, not_found;
 	regex_t re;
+	struct search_scan *sc = NULL;
 
 	if (buf != ctl->previous_search) {
 		free(ctl->previous_search);
@@ -1416,11 +1652,22 @@ static void search(struct more_control *ctl, char buf[], int n)
 		more_error(ctl, s);
 		return;
 	}
-	while (!feof(ctl->current_file)) {
+	/* regular files are read by large blocks */
+	if (ctl->lineidx && !ctl->no_tty_in) {
+		sc = xcalloc(1, sizeof(*sc));
+		sc->fd = fileno(ctl->current_file);
+		sc->buf = xmalloc(SCAN_BUF);
+		sc->base = ctl->file_position;
+		sc->eof = feof(ctl->current_file) ? 1 : 0;
+	}
+	while (sc ? !sc->eof : !feof(ctl->current_file)) {
 		line3 = line2;
 		line2 = line1;
 		line1 = ctl->file_position;
-		read_line(ctl);
+		if (sc)
+			scan_read_line(ctl, sc);
+		else
+			read_line(ctl);
 		lncount++;
 		if (regexec(&re, ctl->line_buf, 0, NULL, 0) == 0 && --n == 0) {
 			if ((1 < lncount && ctl->no_tty_in) || 3 < lncount) {
@@ -1452,14 +1699,22 @@ static void search(struct more_control *ctl, char buf[], int n)
 			}
 			break;
 		}
-		more_poll(ctl, 1);
+		if (!sc)
+			more_poll(ctl, 1);
+		else if (lncount % SEARCH_POLL == 0)
+			more_poll(ctl, 0);
 	}
 	/* Move ctrl+c signal handling back to more_key_command(). */
 	signal(SIGINT, SIG_DFL);
 	sigaddset(&ctl->sigset, SIGINT);
 	sigprocmask(SIG_BLOCK, &ctl->sigset, NULL);
 	regfree(&re);
-	if (feof(ctl->current_file)) {
+	not_found = sc ? n != 0 : feof(ctl->current_file);
+	if (sc) {
+		free(sc->buf);
+		free(sc);
+	}
+	if (not_found) {
 		if (!ctl->no_tty_in) {
 			ctl->current_line = saveln;
 			more_fseek(ctl, startline);
@@ -1563,9 +1818,7 @@ static int skip_backwards(struct more_control *ctl, int nlines)
 	ctl->next_jump = ctl->current_line - (ctl->lines_per_screen * (nlines + 1)) - 1;
 	if (ctl->next_jump < 0)
 		ctl->next_jump = 0;
-	more_fseek(ctl, 0);
-	ctl->current_line = 0;
-	skip_lines(ctl);
+	jump_to_line(ctl, ctl->next_jump);
 	return ctl->lines_per_screen;
 }
 
@@ -1879,7 +2132,9 @@ static void display_file(struct more_control *ctl, int left)
 	ctl->current_line = 0;
 	if (ctl->first_file) {
 		ctl->first_file = 0;
-		if (ctl->next_jump)
+		if (ctl->next_jump && ctl->lineidx)
+			jump_to_line(ctl, ctl->next_jump);
+		else if (ctl->next_jump)
 			skip_lines(ctl);
 		if (ctl->search_at_start) {
 			search(ctl, ctl->next_search, 1);
@@ -1920,6 +2175,7 @@ static void display_file(struct more_control *ctl, int left)
 			screen(ctl, left);
 	}
 	fflush(NULL);
+	index_close(ctl);
 	fclose(ctl->current_file);
 	ctl->current_file = NULL;
 	ctl->screen_start.line_num = ctl->screen_start.row_num = 0;
@@ -48,6 +48,7 @@
 #endif
 #include <termios.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <regex.h>
 #include <stdio.h>
 #include <string.h>
@@ -85,6 +86,7 @@
 #define	READBUF		LINE_MAX	/* size of input buffer */
 #define CMDBUF		255		/* size of command buffer */
 #define	PG_TABSIZE	8		/* spaces consumed by tab character */
+#define	INDEX_CHUNK	(64 * 1024)	/* index entries mapped at once */
 
 #define	cuc(c)		((c) & 0377)
 
@@ -113,6 +115,14 @@ static struct {
 	char addon;
 } cmd;
 
+/* Index table for input, one entry per line, mapped from a temporary file */
+struct line_index {
+	FILE *file;
+	off_t *pos;			/* mapped entries */
+	size_t used;			/* number of valid entries */
+	size_t alloc;			/* number of mapped entries */
+};
+
 /* Position of file arguments on argv[] to main() */
 static struct {
 	int first;
@@ -893,6 +903,52 @@ static void __attribute__((__noreturn__)) tmperr(FILE *f, const char *ftype)
 	quit(++exitstatus);
 }
 
+static int index_open(struct line_index *idx)
+{
+	memset(idx, 0, sizeof(*idx));
+	idx->file = tmpfile();
+	return idx->file ? 0 : -1;
+}
+
+static void index_close(struct line_index *idx)
+{
+	if (idx->pos)
+		munmap(idx->pos, idx->alloc * sizeof(off_t));
+	fclose(idx->file);
+}
+
+/* Append an entry; the file is extended and mapped by INDEX_CHUNK entries. */
+static void index_add(struct line_index *idx, off_t pos)
+{
+	if (idx->used == idx->alloc) {
+		size_t alloc = idx->alloc + INDEX_CHUNK;
+		void *p = MAP_FAILED;
+
+		if (ftruncate(fileno(idx->file), alloc * sizeof(off_t)) == 0)
+			p = mmap(NULL, alloc * sizeof(off_t),
+				 PROT_READ | PROT_WRITE, MAP_SHARED,
+				 fileno(idx->file), 0);
+		if (p == MAP_FAILED) {
+			warn(_("Cannot create temporary file"));
+			quit(++exitstatus);
+		}
+		if (idx->pos)
+			munmap(idx->pos, idx->alloc * sizeof(off_t));
+		idx->pos = p;
+		idx->alloc = alloc;
+	}
+	idx->pos[idx->used++] = pos;
+}
+
+static off_t index_get(struct line_index *idx, off_t line)
+{
+	if (line < 0 || (size_t) line >= idx->used) {
+		warnx(_("Unexpected EOF in %s file"), "index");
+		quit(++exitstatus);
+	}
+	return idx->pos[line];
+}
+
 /* Read the file and respond to user input.  Beware: long and ugly. */
 static void pgfile(FILE *f, const char *name)
 {
@@ -920,9 +976,10 @@ static void pgfile(FILE *f, const char *name)
 	char b[READBUF + 1];
 	char *p;
 	/*   fbuf	an exact copy of the input file as it gets read
-	 *   find	index table for input, one entry per line
 	 *   save	for the s command, to save to a file */
-	FILE *fbuf, *find, *save;
+	FILE *fbuf, *save;
+	/* index table for input, one entry per line */
+	struct line_index find;
 
 	if (ontty == 0) {
 		/* Just copy stdin to stdout. */
@@ -940,8 +997,7 @@ static void pgfile(FILE *f, const char *name)
 		fbuf = f;
 		nobuf = 1;
 	}
-	find = tmpfile();
-	if (fbuf == NULL || find == NULL) {
+	if (fbuf == NULL || index_open(&find) != 0) {
 		warn(_("Cannot create temporary file"));
 		quit(++exitstatus);
 	}
@@ -962,15 +1018,11 @@ static void pgfile(FILE *f, const char *name)
 	for (line = startline;;) {
 		/* Get a line from input file or buffer. */
 		if (line < bline) {
-			fseeko(find, line * sizeof pos, SEEK_SET);
-			if (fread(&pos, sizeof pos, 1, find) == 0)
-				tmperr(find, "index");
-			fseeko(find, (off_t)0, SEEK_END);
+			pos = index_get(&find, line);
 			fseeko(fbuf, pos, SEEK_SET);
 			if (fgets(b, READBUF, fbuf) == NULL)
 				tmperr(fbuf, "buffer");
 		} else if (eofline == 0) {
-			fseeko(find, (off_t)0, SEEK_END);
 			do {
 				if (!nobuf)
 					fseeko(fbuf, (off_t)0, SEEK_END);
@@ -1004,7 +1056,7 @@ static void pgfile(FILE *f, const char *name)
 
 				if (!nobuf)
 					fputs(b, fbuf);
-				fwrite_all(&pos, sizeof pos, 1, find);
+				index_add(&find, pos);
 				if (!fflag) {
 					oldpos = pos;
 					p = b;
@@ -1012,9 +1064,7 @@ static void pgfile(FILE *f, const char *name)
 							     p))
 					       != '\0') {
 						pos = oldpos + (p - b);
-						fwrite_all(&pos,
-							   sizeof pos,
-							   1, find);
+						index_add(&find, pos);
 						fline++;
 						bline++;
 					}
@@ -1159,12 +1209,7 @@ static void pgfile(FILE *f, const char *name)
 				if (line <= 0)
 					goto notfound_bw;
 				while (line) {
-					fseeko(find, --line * sizeof pos,
-					       SEEK_SET);
-					if (fread(&pos, sizeof pos, 1, find) ==
-					    0)
-						tmperr(find, "index");
-					fseeko(find, (off_t)0, SEEK_END);
+					pos = index_get(&find, --line);
 					fseeko(fbuf, pos, SEEK_SET);
 					if (fgets(b, READBUF, fbuf) == NULL)
 						tmperr(fbuf, "buffer");
@@ -1214,7 +1259,6 @@ static void pgfile(FILE *f, const char *name)
 					goto newcmd;
 				}
 				/* Advance to EOF. */
-				fseeko(find, (off_t)0, SEEK_END);
 				for (;;) {
 					if (!nobuf)
 						fseeko(fbuf, (off_t)0,
@@ -1226,7 +1270,7 @@ static void pgfile(FILE *f, const char *name)
 					}
 					if (!nobuf)
 						fputs(b, fbuf);
-					fwrite_all(&pos, sizeof pos, 1, find);
+					index_add(&find, pos);
 					if (!fflag) {
 						oldpos = pos;
 						p = b;
@@ -1234,9 +1278,7 @@ static void pgfile(FILE *f, const char *name)
 								     p))
 						       != '\0') {
 							pos = oldpos + (p - b);
-							fwrite_all(&pos,
-								   sizeof pos,
-								   1, find);
+							index_add(&find, pos);
 							fline++;
 							bline++;
 						}
@@ -1367,7 +1409,7 @@ static void pgfile(FILE *f, const char *name)
 							sh = "/bin/sh";
 						if (!nobuf)
 							fclose(fbuf);
-						fclose(find);
+						index_close(&find);
 						if (isatty(0) == 0) {
 							close(0);
 							open(tty, O_RDONLY);
@@ -1453,7 +1495,7 @@ static void pgfile(FILE *f, const char *name)
 		if (eof)
 			break;
 	}
-	fclose(find);
+	index_close(&find);
 	if (!nobuf)
 		fclose(fbuf);
 }
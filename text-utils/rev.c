@@ -57,6 +57,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <getopt.h>
+#include <wchar.h>
 
 #include "nls.h"
 #include "xalloc.h"
@@ -64,6 +65,8 @@
 #include "c.h"
 #include "closestream.h"
 
+#define REV_BUFSIZ	(256 * 1024)	/* initial buffer size for the byte mode */
+
 static void sig_handler(int signo __attribute__ ((__unused__)))
 {
 	_exit(EXIT_SUCCESS);
@@ -79,6 +82,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("Reverse lines characterwise.\n"), out);
 
 	fputs(USAGE_OPTIONS, out);
+	fputs(_(" -0, --zero     zero termination, use NUL as line separator\n"), out);
 	printf(USAGE_HELP_OPTIONS(16));
 	printf(USAGE_MAN_TAIL("rev(1)"));
 
@@ -96,16 +100,210 @@ static void reverse_str(wchar_t *str, size_t n)
 	}
 }
 
+/*
+ * The same as fgetws(), but the line is terminated by @sep and it may contain
+ * L'\0'. Returns number of the read chars.
+ */
+static size_t read_line(wchar_t sep, wchar_t *str, size_t n, FILE *stream)
+{
+	size_t r = 0;
+
+	while (r < n) {
+		wint_t c = fgetwc(stream);
+
+		if (c == WEOF)
+			break;
+		str[r++] = c;
+		if ((wchar_t) c == sep)
+			break;
+	}
+	str[r] = 0;
+	return r;
+}
+
+static void write_line(const wchar_t *str, size_t n, FILE *stream)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		fputwc(str[i], stream);
+}
+
+static int rev_wide(FILE *fp, const char *filename, wchar_t sep)
+{
+	static wchar_t *buf;
+	static size_t bufsiz;
+	uintmax_t line = 0;
+	size_t len;
+
+	if (!buf) {
+		bufsiz = BUFSIZ;
+		buf = xmalloc((bufsiz + 1) * sizeof(wchar_t));
+	}
+
+	while ((len = read_line(sep, buf, bufsiz, fp)) > 0) {
+		/* Extend input buffer if it failed getting the whole line */
+		while (buf[len - 1] != sep && len == bufsiz) {
+			size_t n;
+
+			bufsiz *= 2;
+			buf = xrealloc(buf, (bufsiz + 1) * sizeof(wchar_t));
+
+			n = read_line(sep, &buf[len], bufsiz - len, fp);
+			if (!n)
+				break;
+			len += n;
+		}
+		if (ferror(fp))
+			break;
+
+		reverse_str(buf, buf[len - 1] == sep ? len - 1 : len);
+		write_line(buf, len, stdout);
+		line++;
+	}
+	if (ferror(fp)) {
+		warn("%s: %ju", filename, line);
+		return -1;
+	}
+	return 0;
+}
+
+static int is_ascii(const char *str, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if ((unsigned char) str[i] >= 0x80)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Reverses @n bytes of @str to @out, multibyte sequences are copied as
+ * they are. Returns -1 for invalid sequences.
+ */
+static int reverse_bytes(const char *str, size_t n, char *out)
+{
+	size_t i = 0;
+
+	if (is_ascii(str, n)) {
+		for (i = 0; i < n; i++)
+			out[n - 1 - i] = str[i];
+		return 0;
+	}
+
+	while (i < n) {
+		size_t clen = 1;
+
+		if ((unsigned char) str[i] >= 0x80) {
+			mbstate_t st;
+
+			memset(&st, 0, sizeof(st));
+			clen = mbrtowc(NULL, str + i, n - i, &st);
+			if (clen == (size_t) -1 || clen == (size_t) -2)
+				return -1;
+		}
+		memcpy(out + n - i - clen, str + i, clen);
+		i += clen;
+	}
+	return 0;
+}
+
+/*
+ * Byte mode for UTF-8 and single-byte locales where a byte lower than 0x80
+ * is always a char. The input is read by large blocks and only non-ASCII
+ * chars are decoded (to keep multibyte sequences in the original order).
+ */
+static int rev_bytes(FILE *fp, const char *filename, char sep)
+{
+	static char *buf, *out;
+	static size_t bufsiz;
+	size_t len = 0;
+	uintmax_t line = 0;
+	int fd = fileno(fp), eof = 0;
+
+	if (!buf) {
+		bufsiz = REV_BUFSIZ;
+		buf = xmalloc(bufsiz);
+		out = xmalloc(bufsiz);
+	}
+
+	while (!eof) {
+		const char *p, *end;
+		char *o;
+		ssize_t n;
+
+		n = read(fd, buf + len, bufsiz - len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			warn("%s: %ju", filename, line);
+			return -1;
+		}
+		if (n == 0)
+			eof = 1;
+		len += n;
+
+		for (p = buf, end = buf + len, o = out; p < end; ) {
+			const char *e = memchr(p, sep, end - p);
+			size_t sz;
+
+			if (!e && !eof)
+				break;		/* incomplete line */
+			sz = (e ? e : end) - p;
+
+			if (reverse_bytes(p, sz, o) != 0) {
+				fwrite(out, 1, o - out, stdout);
+				errno = EILSEQ;
+				warn("%s: %ju", filename, line);
+				return -1;
+			}
+			o += sz;
+			if (e)
+				*o++ = sep;
+			p += sz + (e ? 1 : 0);
+			line++;
+		}
+		fwrite(out, 1, o - out, stdout);
+
+		/* keep the incomplete line */
+		len = end - p;
+		if (len)
+			memmove(buf, p, len);
+		if (len == bufsiz) {
+			bufsiz *= 2;
+			buf = xrealloc(buf, bufsiz);
+			out = xrealloc(out, bufsiz);
+		}
+	}
+	return 0;
+}
+
+static int use_bytes(void)
+{
+#ifdef HAVE_WIDECHAR
+	if (MB_CUR_MAX == 1)
+		return 1;
+# ifdef HAVE_LANGINFO_H
+	return strcmp(nl_langinfo(CODESET), "UTF-8") == 0;
+# else
+	return 0;
+# endif
+#else
+	return 1;
+#endif
+}
+
 int main(int argc, char *argv[])
 {
 	char const *filename = "stdin";
-	wchar_t *buf;
-	size_t len, bufsiz = BUFSIZ;
 	FILE *fp = stdin;
-	int ch, rval = EXIT_SUCCESS;
-	uintmax_t line;
+	int ch, bytes, rval = EXIT_SUCCESS;
+	char sep = '\n';
 
 	static const struct option longopts[] = {
+		{ "zero",       no_argument,       NULL, '0' },
 		{ "version",    no_argument,       NULL, 'V' },
 		{ "help",       no_argument,       NULL, 'h' },
 		{ NULL,         0, NULL, 0 }
@@ -119,8 +317,11 @@ int main(int argc, char *argv[])
 	signal(SIGINT, sig_handler);
 	signal(SIGTERM, sig_handler);
 
-	while ((ch = getopt_long(argc, argv, "Vh", longopts, NULL)) != -1)
+	while ((ch = getopt_long(argc, argv, "0Vh", longopts, NULL)) != -1)
 		switch(ch) {
+		case '0':
+			sep = '\0';
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -132,9 +333,11 @@ int main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	buf = xmalloc(bufsiz * sizeof(wchar_t));
+	bytes = use_bytes();
 
 	do {
+		int rc;
+
 		if (*argv) {
 			if ((fp = fopen(*argv, "r")) == NULL) {
 				warn(_("cannot open %s"), *argv );
@@ -145,42 +348,15 @@ int main(int argc, char *argv[])
 			filename = *argv++;
 		}
 
-		line = 0;
-		while (fgetws(buf, bufsiz, fp)) {
-			len = wcslen(buf);
-
-			if (len == 0)
-				continue;
-
-			/* This is my hack from setpwnam.c -janl */
-			while (buf[len-1] != '\n' && !feof(fp)) {
-				/* Extend input buffer if it failed getting the whole line */
-				/* So now we double the buffer size */
-				bufsiz *= 2;
-
-				buf = xrealloc(buf, bufsiz * sizeof(wchar_t));
-
-				/* And fill the rest of the buffer */
-				if (!fgetws(&buf[len], bufsiz/2, fp))
-					break;
-
-				len = wcslen(buf);
-			}
-			if (buf[len - 1] == '\n')
-				buf[len--] = '\0';
-			reverse_str(buf, len);
-			fputws(buf, stdout);
-			line++;
-		}
-		if (ferror(fp)) {
-			warn("%s: %ju", filename, line);
+		if (bytes)
+			rc = rev_bytes(fp, filename, sep);
+		else
+			rc = rev_wide(fp, filename, (wchar_t) sep);
+		if (rc)
 			rval = EXIT_FAILURE;
-		}
 		if (fp != stdin)
 			fclose(fp);
 	} while(*argv);
 
-	free(buf);
 	return rval;
 }
-